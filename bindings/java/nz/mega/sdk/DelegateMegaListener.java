@@ -16,6 +16,7 @@
 package nz.mega.sdk;
 
 import java.util.ArrayList;
+import java.util.LinkedHashMap;
 
 /**
  * Listener to receive and send events to the app.
@@ -27,6 +28,9 @@ class DelegateMegaListener extends MegaListener {
     MegaApiJava megaApi;
     MegaListenerInterface listener;
 
+    // latest onTransferUpdate of each transfer not delivered yet, by tag
+    private final LinkedHashMap<Integer, MegaTransfer> pendingUpdates = new LinkedHashMap<Integer, MegaTransfer>();
+
     DelegateMegaListener(MegaApiJava megaApi, MegaListenerInterface listener) {
         this.megaApi = megaApi;
         this.listener = listener;
@@ -197,11 +201,27 @@ class DelegateMegaListener extends MegaListener {
     public void onTransferUpdate(MegaApi api, MegaTransfer transfer) {
         if (listener != null) {
             final MegaTransfer megaTransfer = transfer.copy();
-            megaApi.runCallback(new Runnable() {
-                public void run() {
-                    listener.onTransferUpdate(megaApi, megaTransfer);
-                }
-            });
+            boolean post;
+            synchronized (pendingUpdates) {
+                post = pendingUpdates.isEmpty();
+                pendingUpdates.put(megaTransfer.getTag(), megaTransfer);
+            }
+
+            // a single callback delivers all the updates received until it runs
+            if (post) {
+                megaApi.runCallback(new Runnable() {
+                    public void run() {
+                        ArrayList<MegaTransfer> updates;
+                        synchronized (pendingUpdates) {
+                            updates = new ArrayList<MegaTransfer>(pendingUpdates.values());
+                            pendingUpdates.clear();
+                        }
+                        for (MegaTransfer update : updates) {
+                            listener.onTransferUpdate(megaApi, update);
+                        }
+                    }
+                });
+            }
         }
     }
     
@@ -18,6 +18,9 @@ package nz.mega.sdk;
 import nz.mega.sdk.MegaApi;
 import nz.mega.sdk.MegaTransfer;
 
+import java.util.ArrayList;
+import java.util.LinkedHashMap;
+
 /**
  * Interface to receive information about transfers.
  * <p>
@@ -33,6 +36,9 @@ class DelegateMegaTransferListener extends MegaTransferListener {
     MegaTransferListenerInterface listener;
     boolean singleListener;
 
+    // latest onTransferUpdate of each transfer not delivered yet, by tag
+    private final LinkedHashMap<Integer, MegaTransfer> pendingUpdates = new LinkedHashMap<Integer, MegaTransfer>();
+
     DelegateMegaTransferListener(MegaApiJava megaApi, MegaTransferListenerInterface listener, boolean singleListener) {
         this.megaApi = megaApi;
         this.listener = listener;
@@ -119,11 +125,27 @@ class DelegateMegaTransferListener extends MegaTransferListener {
     public void onTransferUpdate(MegaApi api, MegaTransfer transfer) {
         if (listener != null) {
             final MegaTransfer megaTransfer = transfer.copy();
-            megaApi.runCallback(new Runnable() {
-                public void run() {
-                    listener.onTransferUpdate(megaApi, megaTransfer);
-                }
-            });
+            boolean post;
+            synchronized (pendingUpdates) {
+                post = pendingUpdates.isEmpty();
+                pendingUpdates.put(megaTransfer.getTag(), megaTransfer);
+            }
+
+            // a single callback delivers all the updates received until it runs
+            if (post) {
+                megaApi.runCallback(new Runnable() {
+                    public void run() {
+                        ArrayList<MegaTransfer> updates;
+                        synchronized (pendingUpdates) {
+                            updates = new ArrayList<MegaTransfer>(pendingUpdates.values());
+                            pendingUpdates.clear();
+                        }
+                        for (MegaTransfer update : updates) {
+                            listener.onTransferUpdate(megaApi, update);
+                        }
+                    }
+                });
+            }
         }
     }
 
@@ -1,6 +1,18 @@
 #define ENABLE_CHAT
 
 %module(directors="1") mega
+
+#ifdef SWIGJAVA
+%begin %{
+#ifndef _WIN32
+// SDK threads are attached to the JVM once, on their first callback, rather than
+// attached and detached around every callback. See keepThreadAttached()
+#define SWIG_JAVA_NO_DETACH_CURRENT_THREAD
+#define SWIG_JAVA_ATTACH_CURRENT_THREAD_AS_DAEMON
+#endif
+%}
+#endif
+
 %{
 #define ENABLE_CHAT
 #include "megaapi.h"
@@ -118,6 +130,37 @@ extern "C" jint JNIEXPORT JNICALL JNI_OnLoad(JavaVM *jvm, void *reserved)
 
     return JNI_VERSION_1_6;
 }
+
+#ifndef _WIN32
+#include <pthread.h>
+
+static pthread_key_t detachKey;
+static pthread_once_t detachKeyOnce = PTHREAD_ONCE_INIT;
+
+static void detachFromJVM(void*)
+{
+    MEGAjvm->DetachCurrentThread();
+}
+
+static void createDetachKey()
+{
+    pthread_key_create(&detachKey, detachFromJVM);
+}
+
+// called from callbacks, with the thread already attached: detach it when it exits
+static void keepThreadAttached()
+{
+    pthread_once(&detachKeyOnce, createDetachKey);
+    if (!pthread_getspecific(detachKey))
+    {
+        pthread_setspecific(detachKey, MEGAjvm);
+    }
+}
+#else
+static void keepThreadAttached()
+{
+}
+#endif
 #endif
 %}
 
@@ -276,6 +319,7 @@ extern "C" jint JNIEXPORT JNICALL JNI_OnLoad(JavaVM *jvm, void *reserved)
 %feature("director") mega::MegaGlobalListener;
 %feature("director") mega::MegaListener;
 %feature("director") mega::MegaTreeProcessor;
+%feature("director") mega::MegaNodeViewVisitor;
 %feature("director") mega::MegaGfxProcessor;
 
 
@@ -288,6 +332,13 @@ extern "C" jint JNIEXPORT JNICALL JNI_OnLoad(JavaVM *jvm, void *reserved)
 %}
 #endif
 
+// every listener callback receives the MegaApi first
+%typemap(directorin, descriptor="L$packagepath/$javaclassname;") mega::MegaApi *api
+%{
+    keepThreadAttached();
+    *(($&1_ltype)&$input) = ($1_ltype) $1;
+%}
+
 %apply (char *STRING, size_t LENGTH) {(char *bitmapData, size_t size)};
 %typemap(directorin, descriptor="[B") (char *bitmapData, size_t size)
 %{ 
@@ -358,6 +409,7 @@ extern "C" jint JNIEXPORT JNICALL JNI_OnLoad(JavaVM *jvm, void *reserved)
 %newobject mega::MegaTransferList::copy;
 %newobject mega::MegaNode::copy;
 %newobject mega::MegaNodeList::copy;
+%newobject mega::MegaNodeView::copy;
 %newobject mega::MegaChildrenList::copy;
 %newobject mega::MegaShare::copy;
 %newobject mega::MegaShareList::copy;
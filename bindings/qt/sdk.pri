@@ -128,6 +128,10 @@ CONFIG(USE_POLL) {
     DEFINES += USE_POLL
 }
 
+CONFIG(USE_EPOLL) {
+    DEFINES += USE_EPOLL
+}
+
 CONFIG(USE_CONSOLE) {
     win32 {
 
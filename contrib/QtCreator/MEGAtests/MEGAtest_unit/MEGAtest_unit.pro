@@ -45,6 +45,8 @@ else {
 
 SOURCES += \
 ../../../../tests/unit/AttrMap_test.cpp \
+../../../../tests/unit/BackoffTimer_test.cpp \
+../../../../tests/unit/BandwidthScheduler_test.cpp \
 ../../../../tests/unit/ChunkMacMap_test.cpp \
 ../../../../tests/unit/Commands_test.cpp \
 ../../../../tests/unit/Crypto_test.cpp \
@@ -57,6 +59,7 @@ SOURCES += \
 ../../../../tests/unit/MegaApi_test.cpp \
 ../../../../tests/unit/PayCrypter_test.cpp \
 ../../../../tests/unit/PendingContactRequest_test.cpp \
+../../../../tests/unit/Raid_test.cpp \
 ../../../../tests/unit/Serialization_test.cpp \
 ../../../../tests/unit/Share_test.cpp \
 ../../../../tests/unit/Sync_test.cpp \
@@ -2840,7 +2840,7 @@ void exec_sendDeferred(autocomplete::ACState& s)
 void exec_codeTimings(autocomplete::ACState& s)
 {
     bool reset = s.extractflag("-reset");
-    cout << client->performanceStats.report(reset, client->httpio, client->waiter, client->reqs) << flush;
+    cout << client->performanceStats.report(reset, client->httpio, client->waiter, client->reqs, client->mAsyncQueue, client->mNodeManager) << flush;
 }
 
 #endif
@@ -2876,6 +2876,224 @@ void setAppendAndUploadOnCompletedUploads(string local_path, int count, bool all
 
 std::deque<std::function<void()>> mainloopActions;
 
+// Scripted benchmark: the commands of a file are run one after the other, each one timed
+// until the client has nothing left to do for it (no commands queued or in flight, no transfers,
+// no fetchnodes or sync scan in progress).  Statistics are written in JSON when all are done.
+struct BenchmarkRun
+{
+    struct Result
+    {
+        string command;
+        std::chrono::steady_clock::duration elapsed{};
+        m_off_t downloaded = 0;
+        m_off_t uploaded = 0;
+        bool timedOut = false;
+    };
+
+    std::deque<string> pending;
+    vector<Result> results;
+    string outputFile;      // empty for the console
+    std::chrono::seconds timeout{600};
+    bool quitWhenDone = false;
+
+    // command in progress
+    bool running = false;
+    Result current;
+    std::chrono::steady_clock::time_point started;
+};
+
+static unique_ptr<BenchmarkRun> benchmarkRun;
+
+static bool benchmarkClientIdle()
+{
+    if (prompt != COMMAND
+        || !client->reqs.idle()
+        || client->fetchingnodes
+        || (client->loggedin() != NOTLOGGEDIN && !client->statecurrent)
+        || !client->transfers[GET].empty() || !client->transfers[PUT].empty()
+        || !appxferq[GET].empty() || !appxferq[PUT].empty())
+    {
+        return false;
+    }
+
+#ifdef ENABLE_SYNC
+    if (client->syncscanstate || client->syncadding)
+    {
+        return false;
+    }
+
+    bool scanning = false;
+    client->syncs.forEachRunningSync([&scanning](Sync* sync)
+    {
+        scanning = scanning || sync->state() == SYNC_INITIALSCAN;
+    });
+    return !scanning;
+#else
+    return true;
+#endif
+}
+
+// a command as recorded in the statistics: without the password of a login
+static string benchmarkCommandName(const string& line)
+{
+    if (line.compare(0, 6, "login ") == 0)
+    {
+        auto secondSpace = line.find(' ', line.find_first_not_of(' ', 6));
+        return line.substr(0, secondSpace);
+    }
+    return line;
+}
+
+static void benchmarkReport(const BenchmarkRun& run)
+{
+    JSONWriter json;
+    json.beginobject();
+    json.beginarray("commands");
+
+    std::chrono::steady_clock::duration total{};
+    m_off_t totalDownloaded = 0;
+    m_off_t totalUploaded = 0;
+    for (const BenchmarkRun::Result& r : run.results)
+    {
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(r.elapsed).count();
+        m_off_t bytes = r.downloaded + r.uploaded;
+
+        json.beginobject();
+        json.arg_stringWithEscapes("command", r.command);
+        json.arg("latencyMs", m_off_t(ms));
+        json.arg("downloadedBytes", r.downloaded);
+        json.arg("uploadedBytes", r.uploaded);
+        json.arg("bytesPerSecond", ms ? m_off_t(bytes * 1000 / ms) : m_off_t(0));
+        if (r.timedOut)
+        {
+            json.arg("timedOut", m_off_t(1));
+        }
+        json.endobject();
+
+        total += r.elapsed;
+        totalDownloaded += r.downloaded;
+        totalUploaded += r.uploaded;
+    }
+    json.endarray();
+
+    auto totalMs = std::chrono::duration_cast<std::chrono::milliseconds>(total).count();
+    json.arg("totalMs", m_off_t(totalMs));
+    json.arg("downloadedBytes", totalDownloaded);
+    json.arg("uploadedBytes", totalUploaded);
+    json.arg("bytesPerSecond", totalMs ? m_off_t((totalDownloaded + totalUploaded) * 1000 / totalMs) : m_off_t(0));
+    json.endobject();
+
+    if (run.outputFile.empty())
+    {
+        cout << json.getstring() << endl;
+    }
+    else
+    {
+        ofstream f(run.outputFile);
+        f << json.getstring() << endl;
+        cout << "Benchmark results written to " << run.outputFile << endl;
+    }
+}
+
+// called from the main loop: completes the current command once the client is idle, and starts the next ones.
+// Returns true when the run is over and megacli should quit
+static bool benchmarkStep()
+{
+    BenchmarkRun& run = *benchmarkRun;
+    for (;;)
+    {
+        if (run.running)
+        {
+            auto elapsed = std::chrono::steady_clock::now() - run.started;
+            bool timedOut = elapsed > run.timeout;
+            if (!timedOut && !benchmarkClientIdle())
+            {
+                return false;
+            }
+
+            run.current.elapsed = elapsed;
+            run.current.timedOut = timedOut;
+            run.current.downloaded = client->httpio->downloadedBytes - run.current.downloaded;
+            run.current.uploaded = client->httpio->uploadedBytes - run.current.uploaded;
+            cout << "Benchmark: " << run.current.command << (timedOut ? " timed out after " : " took ")
+                 << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << " ms" << endl;
+            run.results.push_back(std::move(run.current));
+            run.running = false;
+        }
+
+        if (run.pending.empty())
+        {
+            benchmarkReport(run);
+            bool quit = run.quitWhenDone;
+            benchmarkRun.reset();
+            return quit;
+        }
+
+        string line = std::move(run.pending.front());
+        run.pending.pop_front();
+
+        run.current = BenchmarkRun::Result();
+        run.current.command = benchmarkCommandName(line);
+        run.current.downloaded = client->httpio->downloadedBytes;
+        run.current.uploaded = client->httpio->uploadedBytes;
+        run.running = true;
+        run.started = std::chrono::steady_clock::now();
+
+        vector<char> l(line.begin(), line.end());
+        l.push_back(0);
+        process_line(l.data());
+    }
+}
+
+static bool benchmarkStart(const string& commandFile, const string& outputFile, int timeoutSeconds, bool quitWhenDone)
+{
+    ifstream f(commandFile);
+    if (!f)
+    {
+        cout << "Unable to open " << commandFile << endl;
+        return false;
+    }
+
+    unique_ptr<BenchmarkRun> run(new BenchmarkRun);
+    for (string line; getline(f, line); )
+    {
+        // one command per line, # for comments
+        line.erase(0, line.find_first_not_of(" \t"));
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (!line.empty() && line[0] != '#')
+        {
+            run->pending.push_back(line);
+        }
+    }
+
+    run->outputFile = outputFile;
+    run->quitWhenDone = quitWhenDone;
+    if (timeoutSeconds > 0)
+    {
+        run->timeout = std::chrono::seconds(timeoutSeconds);
+    }
+
+    cout << "Benchmark: running " << run->pending.size() << " commands from " << commandFile << endl;
+    benchmarkRun = std::move(run);
+    return true;
+}
+
+void exec_benchmark(autocomplete::ACState& s)
+{
+    string outputFile;
+    string timeout;
+    s.extractflagparam("-output", outputFile);
+    s.extractflagparam("-timeout", timeout);
+
+    if (benchmarkRun)
+    {
+        cout << "A benchmark is already running" << endl;
+        return;
+    }
+
+    benchmarkStart(s.words[1].s, outputFile, timeout.empty() ? 0 : atoi(timeout.c_str()), false);
+}
+
 #ifdef USE_FILESYSTEM
 fs::path pathFromLocalPath(const string& s, bool mustexist)
 {
@@ -4211,7 +4429,7 @@ autocomplete::ACN autocompleteSyntax()
                 opt(either(flag("-console"), flag("-noconsole"))),
                 opt(either(flag("-nofile"), sequence(flag("-file"), localFSFile())))
 #ifdef USE_ROTATIVEPERFORMANCELOGGER
-                ,opt(sequence(flag("-rotative_performance_logger_file"), localFSFile(), opt(flag("-rotative_performance_logger_toconsole")), opt(flag("-rotative_performance_logger_exerciseOutput"))))
+                ,opt(sequence(flag("-rotative_performance_logger_file"), localFSFile(), opt(flag("-rotative_performance_logger_toconsole")), opt(flag("-rotative_performance_logger_exerciseOutput")), opt(sequence(flag("-rotative_performance_logger_ring"), param("retainMB")))))
 #endif
                 ));
 
@@ -4268,6 +4486,7 @@ autocomplete::ACN autocompleteSyntax()
 #endif
     p->Add(exec_help, either(text("help"), text("h"), text("?")));
     p->Add(exec_quit, either(text("quit"), text("q"), text("exit")));
+    p->Add(exec_benchmark, sequence(text("benchmark"), opt(sequence(flag("-output"), localFSFile())), opt(sequence(flag("-timeout"), param("seconds"))), localFSFile("commandfile")));
 
     p->Add(exec_find, sequence(text("find"), text("raided")));
     p->Add(exec_findemptysubfoldertrees, sequence(text("findemptysubfoldertrees"), opt(flag("-movetotrash"))));
@@ -6422,9 +6641,17 @@ void exec_debug(autocomplete::ACState& s)
 
         bool exerciseOutput = s.extractflag("-rotative_performance_logger_exerciseOutput");
 
+        string retainMB;
+        bool ring = s.extractflagparam("-rotative_performance_logger_ring", retainMB);
+
         // singletons...
         RotativePerformanceLogger::Instance().initialize(".", rpl_filename.c_str(), toconsole);
 
+        if (ring)
+        {
+            RotativePerformanceLogger::Instance().setCompressedRing(size_t(atoll(retainMB.c_str())) * 1024 * 1024);
+        }
+
         if (exerciseOutput)
         {
             // two competing threads, both logging, so we're not just paused during gzipping
@@ -9597,6 +9824,12 @@ void megacli()
         // command editing loop - exits when a line is submitted or the engine requires the CPU
         for (;;)
         {
+            if (benchmarkRun && !benchmarkRun->running)
+            {
+                // the first command of a benchmark is due
+                break;
+            }
+
             int w = client->wait();
 
             if (w & Waiter::HAVESTDIN)
@@ -9694,6 +9927,15 @@ void megacli()
             mainloopActions.pop_front();
         }
 
+        if (benchmarkRun && benchmarkStep())
+        {
+#ifndef NO_READLINE
+            rl_callback_handler_remove();
+#endif /* ! NO_READLINE */
+            delete client;
+            client = nullptr;
+            return;
+        }
     }
 }
 
@@ -9835,6 +10077,21 @@ int main(int argc, char* argv[])
 
     client->mFilenameAnomalyReporter.reset(new AnomalyReporter()); // on by default
 
+    // megacli --benchmark <commandfile> [--benchmark-output <jsonfile>] [--benchmark-timeout <seconds>]
+    // runs the commands of the file as the benchmark command does, and quits
+    string benchmarkFile, benchmarkOutput;
+    int benchmarkTimeout = 0;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--benchmark")) benchmarkFile = argv[i + 1];
+        else if (!strcmp(argv[i], "--benchmark-output")) benchmarkOutput = argv[i + 1];
+        else if (!strcmp(argv[i], "--benchmark-timeout")) benchmarkTimeout = atoi(argv[i + 1]);
+    }
+    if (!benchmarkFile.empty() && !benchmarkStart(benchmarkFile, benchmarkOutput, benchmarkTimeout, true))
+    {
+        return EXIT_FAILURE;
+    }
+
     megacli();
 
     delete client;
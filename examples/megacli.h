@@ -386,6 +386,7 @@ void exec_autocomplete(autocomplete::ACState& s);
 void exec_history(autocomplete::ACState& s);
 void exec_help(autocomplete::ACState& s);
 void exec_quit(autocomplete::ACState& s);
+void exec_benchmark(autocomplete::ACState& s);
 void exec_find(autocomplete::ACState& s);
 #ifdef USE_FILESYSTEM
 void exec_treecompare(autocomplete::ACState& s);
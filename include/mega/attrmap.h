@@ -27,19 +27,114 @@
 namespace mega {
 
 // maps attribute names to attribute values
-struct attr_map : map<nameid, string>
+// kept as a vector sorted by name rather than a std::map: nodes carry only a
+// handful of attributes, so a single contiguous allocation per node is both
+// smaller and faster to search than one tree node per attribute
+struct attr_map
 {
+    typedef nameid key_type;
+    typedef string mapped_type;
+    typedef pair<nameid, string> value_type;
+    typedef vector<value_type>::iterator iterator;
+    typedef vector<value_type>::const_iterator const_iterator;
+    typedef vector<value_type>::size_type size_type;
+
     attr_map() {}
 
     attr_map(nameid key, string value)
     {
-        (*this)[key] = value;
+        mValues.emplace_back(key, std::move(value));
     }
 
     attr_map(map<nameid, string>&& m)
     {
-        m.swap(*this);
+        mValues.reserve(m.size());
+        for (auto& it : m)
+        {
+            mValues.emplace_back(it.first, std::move(it.second));
+        }
+    }
+
+    iterator begin() { return mValues.begin(); }
+    iterator end() { return mValues.end(); }
+    const_iterator begin() const { return mValues.begin(); }
+    const_iterator end() const { return mValues.end(); }
+
+    size_type size() const { return mValues.size(); }
+    bool empty() const { return mValues.empty(); }
+    void clear() { mValues.clear(); }
+    void swap(attr_map& other) { mValues.swap(other.mValues); }
+
+    iterator find(nameid key)
+    {
+        auto it = lowerBound(key);
+        return it != mValues.end() && it->first == key ? it : mValues.end();
+    }
+
+    const_iterator find(nameid key) const
+    {
+        return const_cast<attr_map*>(this)->find(key);
+    }
+
+    size_type count(nameid key) const { return find(key) != end() ? 1 : 0; }
+
+    string& operator[](nameid key)
+    {
+        return emplace(key, string()).first->second;
     }
+
+    void reserve(size_type n) { mValues.reserve(n); }
+
+    pair<iterator, bool> emplace(nameid key, string value)
+    {
+        // attributes are mostly added in order (unserialization, JSON
+        // parsing of sorted output), so appending is the common case
+        if (mValues.empty() || mValues.back().first < key)
+        {
+            mValues.emplace_back(key, std::move(value));
+            return std::make_pair(mValues.end() - 1, true);
+        }
+
+        auto it = lowerBound(key);
+        if (it != mValues.end() && it->first == key)
+        {
+            return std::make_pair(it, false);
+        }
+        return std::make_pair(mValues.emplace(it, key, std::move(value)), true);
+    }
+
+    pair<iterator, bool> insert(value_type value)
+    {
+        return emplace(value.first, std::move(value.second));
+    }
+
+    iterator erase(const_iterator it)
+    {
+        return mValues.erase(it);
+    }
+
+    size_type erase(nameid key)
+    {
+        auto it = find(key);
+        if (it == mValues.end())
+        {
+            return 0;
+        }
+        mValues.erase(it);
+        return 1;
+    }
+
+    bool operator==(const attr_map& other) const { return mValues == other.mValues; }
+    bool operator!=(const attr_map& other) const { return mValues != other.mValues; }
+
+private:
+    iterator lowerBound(nameid key)
+    {
+        return std::lower_bound(mValues.begin(), mValues.end(), key,
+                                [](const value_type& v, nameid k) { return v.first < k; });
+    }
+
+    vector<value_type> mValues;
 };
 
 struct MEGA_API AttrMap
@@ -70,16 +70,47 @@ public:
 class MEGA_API BackoffTimerTracked;
 
 // This class keeps track of a group of BackoffTimerTracked, which register and deregister themselves.
-// Timers are in the multimap when they have non-0 non-NEVER timeouts set, giving us a much smaller group should we need to iterate it.
+// Timers are tracked when they have non-0 non-NEVER timeouts set, giving us a much smaller group should we need to iterate it.
+// They are kept in a hierarchical timer wheel: each level has SLOTS buckets, each bucket covering SLOTS times the span of the
+// buckets on the level below. Timers are linked into their bucket intrusively, so adding and removing one is O(1), and only
+// the buckets reached by the clock are visited (cascading down a level as their window starts), so the cost of update()
+// does not depend on how many timers are waiting in backoff.
 class MEGA_API BackoffTimerGroupTracker
 {
-    std::multimap<dstime, BackoffTimerTracked*> timeouts;
+    static const unsigned SLOT_BITS = 6;
+    static const unsigned SLOTS = 1 << SLOT_BITS;
+    static const unsigned LEVELS = 4;
+
+    // buckets of timers per level, and a bitmap of the non-empty ones
+    BackoffTimerTracked* mSlots[LEVELS][SLOTS];
+    uint64_t mOccupied[LEVELS];
+
+    // timers already due, and those too far in the future for the top level
+    BackoffTimerTracked* mExpired;
+    BackoffTimerTracked* mOverflow;
+
+    // time the wheel has been advanced to
+    dstime mNow;
+
+    size_t mCount;
+
+    void place(BackoffTimerTracked* bt);
+    void link(BackoffTimerTracked*& list, BackoffTimerTracked* bt, int slot);
+    void unlink(BackoffTimerTracked* bt);
+    void replace(BackoffTimerTracked*& list);
+    void cascade();
+    void advance(dstime now);
+
+    // lower bound of the soonest timeout still in the wheel (NEVER if none)
+    dstime nextevent() const;
 
 public:
-    typedef std::multimap<dstime, BackoffTimerTracked*>::iterator Iter;
+    BackoffTimerGroupTracker();
 
-    inline Iter add(BackoffTimerTracked* bt);
-    inline void remove(Iter i) { timeouts.erase(i); }
+    void add(BackoffTimerTracked* bt);
+    void remove(BackoffTimerTracked* bt);
+
+    size_t size() const { return mCount; }
 
     // Find out the soonest (non-0 and non-NEVER) timeout in the group.
     // For transfers, it calls set(0) on any timed out timers, as the old code did.
@@ -94,7 +125,14 @@ class MEGA_API BackoffTimerTracked
     bool mIsEnabled;
     BackoffTimer bt;
     BackoffTimerGroupTracker& mTracker;
-    BackoffTimerGroupTracker::Iter mTrackerPos;
+
+    // position in the tracker's timer wheel
+    friend class BackoffTimerGroupTracker;
+    dstime mTimeout = 0;
+    BackoffTimerTracked* mPrev = nullptr;
+    BackoffTimerTracked* mNext = nullptr;
+    BackoffTimerTracked** mList = nullptr;
+    int mSlot = -1;
 
     void untrack();
     void track();
@@ -118,17 +156,11 @@ public:
     inline bool enabled()           { return mIsEnabled; }
 };
 
-inline auto BackoffTimerGroupTracker::add(BackoffTimerTracked* bt) -> Iter
-{
-    return timeouts.emplace(bt->nextset() ? bt->nextset() : NEVER, bt);
-}
-
 inline void BackoffTimerTracked::untrack()
 {
-    if (mIsEnabled && bt.nextset() != 0 && bt.nextset() != NEVER)
+    if (mList)
     {
-        mTracker.remove(mTrackerPos);
-        mTrackerPos = BackoffTimerGroupTracker::Iter();
+        mTracker.remove(this);
     }
 }
 
@@ -136,7 +168,7 @@ inline void BackoffTimerTracked::track()
 {
     if (mIsEnabled && bt.nextset() != 0 && bt.nextset() != NEVER)
     {
-        mTrackerPos = mTracker.add(this);
+        mTracker.add(this);
     }
 }
 
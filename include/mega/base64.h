@@ -30,6 +30,7 @@ class MEGA_API Base64
 {
     static byte to64(byte);
     static byte from64(byte);
+    static size_t decodeScalar(const char*, size_t, byte*, size_t);
 
 public:
     static int btoa(const string&, string&);
@@ -39,6 +40,14 @@ public:
     static string atob(const string&);
     static int atob(const char*, byte*, int);   // deprecated
 
+    // bulk conversions between caller-provided buffers, vectorized where the CPU supports it
+    static size_t encodedLength(size_t binaryLength) { return (binaryLength * 4 + 2) / 3; }
+    // writes encodedLength(len) characters, without a terminating NUL
+    static size_t encode(const byte*, size_t len, char*);
+    // decodes up to `len` characters, stopping early at the first one outside the alphabet,
+    // and writes at most `blen` bytes (exactly what atob() produces for the same string)
+    static size_t decode(const char*, size_t len, byte*, size_t blen);
+
     static void itoa(int64_t, string *);
     static int64_t atoi(string *);
 };
@@ -61,10 +61,23 @@ public:
     // some commands are guaranteed to work if we query without specifying a SID (eg. gmf)
     bool suppressSID;
 
+    // someone is waiting on this one: its batch is sent without lingering for more commands
+    bool interactive = false;
+
+    // doesn't depend on, and isn't depended on by, any other command (eg. fetching a download URL),
+    // so it may go in a batch of its own that is in flight alongside the ordered ones
+    bool independent = false;
+
     void cmd(const char*);
     void notself(MegaClient*);
     virtual void cancel(void);
 
+    // room for the expected size of the command
+    void reserve(size_t);
+
+    // the response was processed and the command won't be sent again: its buffer can go to another command
+    void recyclebuffer();
+
     void arg(const char*, const char*, int = 1);
     void arg(const char*, const byte*, int);
     void arg(const char*, NodeHandle);
@@ -438,6 +451,25 @@ public:
     CommandKeyCR(MegaClient*, node_vector*, node_vector*, const char*);
 };
 
+// node keys of a large subtree for its share(s), sent TreeProcShareKeys::MAX_NODES_PER_COMMAND
+// nodes at a time: each command queues the next one when it completes, so only one chunk is
+// encoded at any time
+class MEGA_API CommandShareNodeKeys : public Command
+{
+    handle mShare;      // UNDEF: every share above each node
+    std::shared_ptr<const vector<handle>> mNodes;
+    size_t mNext;       // first node of the next command
+    bool mHasKeys = false;
+
+    CommandShareNodeKeys(MegaClient*, handle share, std::shared_ptr<const vector<handle>> nodes, size_t first);
+
+public:
+    bool procresult(Result) override;
+
+    // queue the command for the nodes from 'first' on (skipping those that are gone)
+    static void queue(MegaClient*, handle share, std::shared_ptr<const vector<handle>> nodes, size_t first = 0);
+};
+
 class MEGA_API CommandMoveNode : public Command
 {
 public:
@@ -451,6 +483,7 @@ private:
     bool mCanChangeVault;
     syncdel_t syncdel;
     Completion completion;
+    vector<handle> mMoreNodeKeys;   // sent after the move (see TreeProcShareKeys::get())
 
 public:
     bool procresult(Result) override;
@@ -601,6 +634,14 @@ class MEGA_API CommandPutNodes : public Command
 public:
     using Completion = std::function<void(const Error&, targettype_t, vector<NewNode>&, bool targetOverride, int tag)>;
 
+    // one of several putnodes coalesced into a single command: owns the next `count` entries of nn
+    struct BatchedCompletion
+    {
+        int tag;
+        size_t count;
+        Completion completion;
+    };
+
 private:
     friend class MegaClient;
     vector<NewNode> nn;
@@ -610,8 +651,22 @@ private:
     NodeHandle targethandle;
     Completion mResultFunction;
 
+    // kept to resend requests on their own, if a batch of them fails
+    VersioningOption mVersioningOption;
+    bool mCanChangeVault;
+
+    // when not empty, results are split back per original request
+    vector<BatchedCompletion> mBatch;
+
+    // the file attributes sent with each upload of nn: they have been taken from the NewNodes
+    // (and the pending media attributes), so a request of a failed batch is resent with them
+    vector<string> mFileAttributes;
+
     void removePendingDBRecordsAndTempFiles();
+    void removePendingDBRecordsAndTempFiles(int ptag);
     void performAppCallback(Error e, vector<NewNode>&, bool targetOverride = false);
+    Error parseresult(bool& empty);
+    bool procbatchresult(Result);
 
 public:
 
@@ -643,11 +698,13 @@ class MEGA_API CommandSetShare : public Command
     string msg;
     string personal_representation;
     bool mWritable = false;
+    vector<handle> mMoreNodeKeys;   // sent once the share exists (see TreeProcShareKeys::get())
 
 
     std::function<void(Error, bool writable)> completion;
 
     bool procuserresult(MegaClient*);
+    void sendmorenodekeys();
 
 public:
     bool procresult(Result) override;
@@ -1494,6 +1551,9 @@ class CommandSE : public Command // intermediary class to avoid code duplication
 protected:
     bool procresultid(const Result& r, handle& id, m_time_t& ts, handle* u, handle* s = nullptr, int64_t* o = nullptr) const;
     bool procerrorcode(const Result& r, Error& e) const;
+
+    // read the members of an object already entered, up to its end
+    bool procjsonobject(handle& id, m_time_t& ts, handle* u, handle* s = nullptr, int64_t* o = nullptr) const;
 };
 
 class Set;
@@ -1547,6 +1607,35 @@ private:
     std::function<void(Error, const SetElement*)> mCompletion;
 };
 
+class MEGA_API CommandPutSetElements : public CommandSE
+{
+public:
+    // `results` holds one entry per requested Element: API_OK for those in `els`, in the same order,
+    // and the error of those that could not be sent
+    CommandPutSetElements(MegaClient*, vector<SetElement>&& els, const vector<pair<string, string>>& encrDetails,
+                          vector<int64_t>&& results,
+                          std::function<void(Error, const vector<const SetElement*>*, const vector<int64_t>*)> completion);
+    bool procresult(Result) override;
+
+private:
+    unique_ptr<vector<SetElement>> mElements; // use a pointer to avoid defining SetElement in this header
+    vector<int64_t> mResults;
+    std::function<void(Error, const vector<const SetElement*>*, const vector<int64_t>*)> mCompletion;
+};
+
+class MEGA_API CommandRemoveSetElements : public CommandSE
+{
+public:
+    CommandRemoveSetElements(MegaClient*, handle sid, vector<handle>&& eids,
+                             std::function<void(Error, const vector<int64_t>*)> completion);
+    bool procresult(Result) override;
+
+private:
+    handle mSetId = UNDEF;
+    vector<handle> mElementIds;
+    std::function<void(Error, const vector<int64_t>*)> mCompletion;
+};
+
 class MEGA_API CommandRemoveSetElement : public CommandSE
 {
 public:
@@ -93,6 +93,14 @@ private:
     CryptoPP::GCM<CryptoPP::AES>::Encryption aesgcm_e;
     CryptoPP::GCM<CryptoPP::AES>::Decryption aesgcm_d;
 
+    // set once setkey() has expanded the schedules for the current key
+    bool mKeySet = false;
+
+    // number of counter blocks ctr_crypt() hands to Crypto++ per call
+    static const unsigned CTR_BATCH_BLOCKS = 8;
+
+    void cbcmac_blocks(const byte* data, unsigned len, byte* mac);
+
 public:
     static byte zeroiv[CryptoPP::AES::BLOCKSIZE];
 
@@ -313,6 +321,9 @@ public:
 
     void ctr_crypt(byte *, unsigned, m_off_t, ctr_iv, byte *mac, bool encrypt, bool initmac = true);
 
+    // out of place: src is left untouched, and neither buffer needs padding
+    void ctr_crypt(const byte* src, byte* dst, unsigned, m_off_t, ctr_iv, byte *mac, bool encrypt, bool initmac = true);
+
     static void setint64(int64_t, byte*);
 
     static void xorblock(const byte*, byte*);
@@ -466,13 +477,18 @@ public:
     void get(std::string*);
 };
 
+// IEEE CRC32, bit-identical to CryptoPP::CRC32 (get() writes the native-endian value and resets)
+// Uses carry-less multiply folding (PCLMULQDQ) or the ARMv8 CRC instructions when available.
 class MEGA_API HashCRC32
 {
-    CryptoPP::CRC32 hash;
+    uint32_t crc = 0xFFFFFFFF;
 
 public:
     void add(const byte*, unsigned);
     void get(byte*);
+
+    // advance a raw (pre/post-inverted by the caller) CRC register over len bytes
+    static uint32_t update(uint32_t crc, const byte* data, size_t len);
 };
 
 /**
@@ -66,6 +66,68 @@ public:
     bool put(uint32_t, string*);
     bool put(uint32_t, Cacheable *, SymmCipher*);
 
+    // as put() of a record, when it is already serialized in 'data' (which is encrypted in place)
+    bool putserialized(uint32_t, Cacheable*, string* data, SymmCipher*);
+
+    // a record for put() of several records: parentid is the dbid of the record it belongs
+    // under (0 at the top), so that getbyparent() can find it
+    struct Record
+    {
+        uint32_t id;
+        uint32_t parentid;
+        string content;
+    };
+
+    // update or add several records, in order
+    virtual bool put(const std::vector<Record>&);
+
+    // serialize, encrypt and put several records of the same type in one go.
+    // records are assigned their dbid in order, so a record can refer to the dbid of an earlier one
+    bool put(uint32_t, const std::vector<Cacheable*>&, SymmCipher*);
+
+    // get the records put under a parentid, as (id, content). False if the table can't look them up
+    virtual bool getbyparent(uint32_t, std::vector<std::pair<uint32_t, string>>&) { return false; }
+    bool getbyparent(uint32_t, std::vector<std::pair<uint32_t, string>>&, SymmCipher*);
+
+    // whether every record was put with a parentid, so that getbyparent() finds them all
+    virtual bool indexedbyparent() { return false; }
+
+    // delete the records under a parentid, and theirs, recursively
+    virtual bool delbyparent(uint32_t) { return false; }
+
+    // the highest id in use, for nextid when the records are not all read through next()
+    virtual uint32_t maxid() { return 0; }
+
+    // user alerts, kept apart from the other records and indexed by timestamp, so that they can
+    // be read a page at a time. 'seen' is kept outside the content, so that seealerts() can set it
+    struct AlertRecord
+    {
+        uint32_t id;
+        int64_t ts;
+        bool seen;
+        string content;
+    };
+
+    // add or update an alert. False if the table can't store alerts apart
+    virtual bool putalert(const AlertRecord&) { return false; }
+    bool putalert(uint32_t type, int64_t ts, bool seen, Cacheable*, SymmCipher*);
+
+    // the stored alerts from the offset-th newest one, newest first. False if the table can't store alerts apart
+    virtual bool getalerts(uint64_t, uint64_t, std::vector<AlertRecord>&) { return false; }
+    bool getalerts(uint64_t offset, uint64_t limit, std::vector<AlertRecord>&, SymmCipher*);
+
+    // the number of stored alerts, or of those not seen. -1 if the table can't store alerts apart
+    virtual int64_t countalerts(bool) { return -1; }
+
+    // delete a stored alert
+    virtual bool delalert(uint32_t) { return false; }
+
+    // mark all the stored alerts as seen
+    virtual bool seealerts() { return false; }
+
+    // delete the stored alerts but the newest ones
+    virtual bool trimalerts(uint64_t) { return false; }
+
     // delete specific record
     virtual bool del(uint32_t) = 0;
 
@@ -84,6 +146,9 @@ public:
     // permanantly remove all database info
     virtual void remove() = 0;
 
+    // refresh the statistics of the query planner where they are stale (cheap otherwise)
+    virtual void optimize() = 0;
+
     // whether an unmatched begin() has been issued
     virtual bool inTransaction() const = 0;
 
@@ -97,6 +162,16 @@ public:
     DBTableTransactionCommitter *getTransactionCommitter() const;
 };
 
+// Orders of children that the DB can apply by itself: folders first, then by the key
+// (name in natural order, or creation time with ties by name), ascending or descending
+enum class ChildrenOrder
+{
+    NAME_ASC,
+    NAME_DESC,
+    CTIME_ASC,
+    CTIME_DESC,
+};
+
 class MEGA_API DBTableNodes
 {
 public:
@@ -104,29 +179,62 @@ public:
     // add or update a node
     virtual bool put(Node* node) = 0;
 
+    // add or update several nodes, given the output of serializeNode() for each of them (in order)
+    virtual bool put(const std::vector<Node*>& nodes, const std::vector<std::string>& serializedNodes) = 0;
+
+    // whether nodes are stored with Node::serializeCompact(), or with Node::serialize() in a
+    // legacy DB that older versions of the SDK may still open
+    virtual bool compactNodes() const = 0;
+
+    // serialize the node in the format of this table
+    bool serializeNode(Node* node, string* d) const;
+
     // remove one node from 'nodes' table
     virtual bool remove(NodeHandle nodehandle) = 0;
 
     // remove all nodes from 'nodes' table (truncate)
     virtual bool removeNodes() = 0;
 
+    // remove the descendants of 'ancestorHandle' (not the node itself) from 'nodes' table, at once
+    virtual bool removeSubtree(NodeHandle ancestorHandle) = 0;
+
+    struct VersionsRecord
+    {
+        NodeHandle file;
+        NodeHandle newestVersion;   // parent of the older versions, if any
+        std::string counter;        // serialized NodeCounter of the newest version, covering the older ones
+    };
+
+    // the files below 'ancestorHandle' that have versions, with one query
+    virtual bool getVersions(NodeHandle ancestorHandle, std::vector<VersionsRecord>& versions) = 0;
+
+    // remove all the versions below 'ancestorHandle' from 'nodes' table, at once
+    virtual bool removeVersions(NodeHandle ancestorHandle) = 0;
+
     // get nodes and queries about nodes
     virtual bool getNode(NodeHandle nodehandle, NodeSerialized& nodeSerialized) = 0;
     virtual bool getNodesByOrigFingerprint(const std::string& fingerprint, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes) = 0;
     virtual bool getChildren(NodeHandle parentHandle, std::vector<std::pair<NodeHandle, NodeSerialized>>& children, CancelToken cancelFlag) = 0;
     virtual bool getChildrenFromType(NodeHandle parentHandle, nodetype_t nodeType, std::vector<std::pair<NodeHandle, NodeSerialized>>& children, CancelToken cancelFlag) = 0;
+    // children of 'parentHandle' in 'order', skipping the first 'offset' and returning at most 'limit'
+    virtual bool getChildrenPage(NodeHandle parentHandle, ChildrenOrder order, uint64_t offset, uint64_t limit, std::vector<std::pair<NodeHandle, NodeSerialized>>& children, CancelToken cancelFlag) = 0;
     virtual uint64_t getNumberOfChildren(NodeHandle parentHandle) = 0;
-    virtual bool searchForNodesByName(const std::string& name, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes, CancelToken cancelFlag) = 0;
+    // 'ancestorHandle' restricts the results to its subtree, if defined
+    virtual bool searchForNodesByName(const std::string& name, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes, NodeHandle ancestorHandle, CancelToken cancelFlag) = 0;
     virtual bool searchForNodesByNameNoRecursive(const std::string& name, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes, NodeHandle parentHandle, CancelToken cancelFlag) = 0;
     virtual bool searchInShareOrOutShareByName(const std::string& name, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes, ShareType_t shareType, CancelToken cancelFlag) = 0;
     virtual bool getRecentNodes(unsigned maxcount, m_time_t since, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes) = 0;
     virtual bool getNodesByFingerprint(const std::string& fingerprint, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes) = 0;
     virtual bool getNodeByFingerprint(const std::string& fingerprint, mega::NodeSerialized& node) = 0;
+    // calls 'fingerprintCallback' with the serialized fingerprint of every node
+    virtual bool getAllFingerprints(std::function<void(const std::string&)> fingerprintCallback) = 0;
+    // all nodes matching any of 'fingerprints', resolved with as few queries as possible
+    virtual bool getNodesByFingerprints(const std::vector<std::string>& fingerprints, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes) = 0;
     virtual bool getRootNodes(std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes) = 0;
     virtual bool getNodesWithSharesOrLink(std::vector<std::pair<NodeHandle, NodeSerialized>>&, ShareType_t shareType) = 0;
     virtual bool getFavouritesHandles(NodeHandle node, uint32_t count, std::vector<mega::NodeHandle>& nodes) = 0;
     virtual bool childNodeByNameType(NodeHandle parentHandle, const std::string& name, nodetype_t nodeType, std::pair<NodeHandle, NodeSerialized>& node) = 0;
-    virtual bool getNodesByMimetype(MimeType_t mimeType, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes, CancelToken cancelFlag) = 0;
+    virtual bool getNodesByMimetype(MimeType_t mimeType, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes, NodeHandle ancestorHandle, CancelToken cancelFlag) = 0;
 
     virtual bool isAncestor(NodeHandle node, NodeHandle ancestror, CancelToken cancelFlag) = 0;
 
@@ -141,11 +249,24 @@ public:
 
     virtual bool getNodeSizeTypeAndFlags(NodeHandle node, m_off_t& size, nodetype_t& nodeType, uint64_t& oldFlags) = 0;
 
+    // serialized NodeCounter of the node, without reading the node itself
+    virtual bool getNodeCounter(NodeHandle node, std::string& nodeCounterBlob) = 0;
+
     virtual void updateCounter(NodeHandle nodeHandle, const std::string& nodeCounterBlob) = 0;
 
     virtual void updateCounterAndFlags(NodeHandle nodeHandle, uint64_t flags, const std::string& nodeCounterBlob) = 0;
 
     virtual void createIndexes() = 0;
+
+    // -- concurrent reads --
+
+    // Read-only connection to the same DB, for queries made while the client's lock is released.
+    // It only sees committed data, so it's nullptr if there are uncommitted changes to the nodes
+    // (or no connection is available). It goes back to the pool when released, from any thread
+    virtual std::shared_ptr<DBTableNodes> getReader() = 0;
+
+    // count of changes to the nodes made through this connection
+    virtual uint64_t getNodesWrites() const = 0;
 };
 
 class MEGA_API DBTableTransactionCommitter
@@ -265,6 +386,21 @@ struct MEGA_API DbAccess
     virtual const LocalPath& rootPath() const = 0;
 
     int currentDbVersion;
+
+    // Tuning of the DBs opened from now on. 0 (the default of every field) lets the DB layer pick
+    // a value for the size of the DB file being opened
+    struct Tuning
+    {
+        // bytes of the file read through memory mapping, -1 for none
+        int64_t mmapSize = 0;
+
+        // page cache of each connection, in KB
+        int64_t cacheSizeKb = 0;
+
+        // pages in the write-ahead log that trigger a checkpoint
+        int walCheckpointPages = 0;
+    };
+    Tuning tuning;
 };
 
 // Convenience.
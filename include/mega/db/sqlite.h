@@ -37,22 +37,79 @@ protected:
     sqlite3_stmt* mDelStmt = nullptr;
     sqlite3_stmt* mPutStmt = nullptr;
 
+    // multi-row INSERT for put() of several records: PUT_BATCH_ROWS rows per statement
+    sqlite3_stmt* mPutBatchStmt = nullptr;
+    static const size_t PUT_BATCH_ROWS = 64;
+    sqlite3_stmt* mGetByParentStmt = nullptr;
+
 public:
     void rewind() override;
     bool next(uint32_t*, string*) override;
     bool get(uint32_t, string*) override;
     bool put(uint32_t, char*, unsigned) override;
+    bool put(const std::vector<Record>&) override;
+    bool getbyparent(uint32_t, std::vector<std::pair<uint32_t, string>>&) override;
+    bool indexedbyparent() override;
+    bool delbyparent(uint32_t) override;
+    uint32_t maxid() override;
     bool del(uint32_t) override;
     void truncate() override;
     void begin() override;
     void commit() override;
     void abort() override;
     void remove() override;
+    void optimize() override;
 
     SqliteDbTable(PrnGen &rng, sqlite3*, FileSystemAccess &fsAccess, const LocalPath &path, const bool checkAlwaysTransacted);
     virtual ~SqliteDbTable();
 
     bool inTransaction() const override;
+
+    // set the connection up with values from SqliteDbAccess::resolveTuning(), and
+    // checkpoint from a worker thread, if it writes
+    void applyTuning(const DbAccess::Tuning& tuning);
+
+protected:
+    DbAccess::Tuning mTuning;
+
+private:
+    // With synchronous=NORMAL, WAL checkpoints are where the disk is synced. SQLite runs them in the
+    // thread that commits (the client's, mostly), so they are moved to a worker thread, shared by
+    // all the databases, which is told to checkpoint one when a commit leaves its WAL big enough.
+    // The worker checkpoints through a connection of its own, open only while it does
+    class WalCheckpointer
+    {
+    public:
+        static WalCheckpointer& instance();
+        ~WalCheckpointer();
+
+        // checkpoint the database of table, at path
+        void request(const SqliteDbTable* table, const string& path);
+
+        // drop the requests of table, and wait for its checkpoint if one is running
+        void cancel(const SqliteDbTable* table);
+
+    private:
+        WalCheckpointer();
+
+        std::mutex mMutex;
+        std::condition_variable mConditionVariable;
+        std::deque<std::pair<const SqliteDbTable*, string>> mPending;
+        const SqliteDbTable* mRunning = nullptr;
+        bool mShutdown = false;
+        std::thread mThread;
+
+        void loop();
+        static void checkpoint(const string& path);
+    };
+
+    // pages in the WAL that trigger a checkpoint, 0 if the worker doesn't checkpoint this database
+    int mWalCheckpointPages = 0;
+
+    // at ten times the pages of a checkpoint, the committing thread checkpoints by itself
+    static int walHook(void* param, sqlite3* db, const char* dbName, int pages);
+    void startWalCheckpointer();
+    void stopWalCheckpointer();
 };
 
 /**
@@ -69,31 +126,55 @@ public:
     bool getNodesWithSharesOrLink(std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes, ShareType_t shareType) override;
     bool getChildren(NodeHandle parentHandle, std::vector<std::pair<NodeHandle, NodeSerialized>>& children, CancelToken cancelFlag) override;
     bool getChildrenFromType(NodeHandle parentHandle, nodetype_t nodeType, std::vector<std::pair<NodeHandle, NodeSerialized>>& children, mega::CancelToken cancelFlag) override;
+    bool getChildrenPage(NodeHandle parentHandle, ChildrenOrder order, uint64_t offset, uint64_t limit, std::vector<std::pair<NodeHandle, NodeSerialized>>& children, CancelToken cancelFlag) override;
     uint64_t getNumberOfChildren(NodeHandle parentHandle) override;
     // If a cancelFlag is passed, it must be kept alive until this method returns.
-    bool searchForNodesByName(const std::string& name, std::vector<std::pair<NodeHandle, NodeSerialized>> &nodes, CancelToken cancelFlag) override;
+    bool searchForNodesByName(const std::string& name, std::vector<std::pair<NodeHandle, NodeSerialized>> &nodes, NodeHandle ancestorHandle, CancelToken cancelFlag) override;
     bool searchForNodesByNameNoRecursive(const std::string& name, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes, NodeHandle parentHandle, CancelToken cancelFlag) override;
     bool searchInShareOrOutShareByName(const std::string& name, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes, ShareType_t shareType, CancelToken cancelFlag) override;
     bool getNodesByFingerprint(const std::string& fingerprint, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes) override;
     bool getNodeByFingerprint(const std::string& fingerprint, mega::NodeSerialized& node) override;
+    bool getNodesByFingerprints(const std::vector<std::string>& fingerprints, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes) override;
+    bool getAllFingerprints(std::function<void(const std::string&)> fingerprintCallback) override;
     bool getRecentNodes(unsigned maxcount, m_time_t since, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes) override;
     bool getFavouritesHandles(NodeHandle node, uint32_t count, std::vector<mega::NodeHandle>& nodes) override;
     bool childNodeByNameType(NodeHandle parentHanlde, const std::string& name, nodetype_t nodeType, std::pair<NodeHandle, NodeSerialized>& node) override;
     bool getNodeSizeTypeAndFlags(NodeHandle node, m_off_t& size, nodetype_t& nodeType, uint64_t &oldFlags) override;
+    bool getNodeCounter(NodeHandle node, std::string& nodeCounterBlob) override;
     bool isAncestor(mega::NodeHandle node, mega::NodeHandle ancestor, CancelToken cancelFlag) override;
     uint64_t getNumberOfNodes() override;
     uint64_t getNumberOfChildrenByType(NodeHandle parentHandle, nodetype_t nodeType) override;
-    bool getNodesByMimetype(MimeType_t mimeType, std::vector<std::pair<mega::NodeHandle, mega::NodeSerialized> >& nodes, CancelToken cancelFlag) override;
+    bool getNodesByMimetype(MimeType_t mimeType, std::vector<std::pair<mega::NodeHandle, mega::NodeSerialized> >& nodes, NodeHandle ancestorHandle, CancelToken cancelFlag) override;
     bool put(Node* node) override;
+    bool put(const std::vector<Node*>& nodes, const std::vector<std::string>& serializedNodes) override;
     bool remove(mega::NodeHandle nodehandle) override;
     bool removeNodes() override;
+    bool removeSubtree(NodeHandle ancestorHandle) override;
+    bool getVersions(NodeHandle ancestorHandle, std::vector<VersionsRecord>& versions) override;
+    bool removeVersions(NodeHandle ancestorHandle) override;
 
     void updateCounter(NodeHandle nodeHandle, const std::string& nodeCounterBlob) override;
     void updateCounterAndFlags(NodeHandle nodeHandle, uint64_t flags, const std::string& nodeCounterBlob) override;
     void createIndexes() override;
 
+    std::shared_ptr<DBTableNodes> getReader() override;
+    uint64_t getNodesWrites() const override;
+
+    // Access to table `alerts`
+    bool putalert(const AlertRecord&) override;
+    bool getalerts(uint64_t offset, uint64_t limit, std::vector<AlertRecord>&) override;
+    int64_t countalerts(bool unseenOnly) override;
+    bool delalert(uint32_t) override;
+    bool seealerts() override;
+    bool trimalerts(uint64_t keep) override;
+
+    // `statecache` and `alerts` together
+    void truncate() override;
+    uint32_t maxid() override;
+
+    void commit() override;
     void remove() override;
-    SqliteAccountState(PrnGen &rng, sqlite3*, FileSystemAccess &fsAccess, const mega::LocalPath &path, const bool checkAlwaysTransacted);
+    SqliteAccountState(PrnGen &rng, sqlite3*, FileSystemAccess &fsAccess, const mega::LocalPath &path, const bool checkAlwaysTransacted, const bool nameIndex = false, const bool compactNodes = true);
     void finalise();
     virtual ~SqliteAccountState();
 
@@ -101,32 +182,79 @@ public:
     // If the progress callback returns non-zero, the operation is interrupted
     static int progressHandler(void *);
 
+    // Segment of a node in the `path` column: its handle in Base64
+    static std::string pathSegment(handle h);
+
 private:
     // Iterate over a SQL query row by row and fill the map
     // Allow at least the following containers:
     bool processSqlQueryNodes(sqlite3_stmt *stmt, std::vector<std::pair<mega::NodeHandle, mega::NodeSerialized>>& nodes);
 
-    // if add a new sqlite3_stmt update finalise()
-    sqlite3_stmt* mStmtPutNode = nullptr;
-    sqlite3_stmt* mStmtUpdateNode = nullptr;
-    sqlite3_stmt* mStmtUpdateNodeAndFlags = nullptr;
-    sqlite3_stmt* mStmtTypeAndSizeNode = nullptr;
-    sqlite3_stmt* mStmtGetNode = nullptr;
-    sqlite3_stmt* mStmtChildren = nullptr;
-    sqlite3_stmt* mStmtChildrenFromType = nullptr;
-    sqlite3_stmt* mStmtNumChildren = nullptr;
-    sqlite3_stmt* mStmtNodeByName = nullptr;
-    sqlite3_stmt* mStmtNodeByNameNoRecursive = nullptr;
-    sqlite3_stmt* mStmtInShareOutShareByName = nullptr;
-    sqlite3_stmt* mStmtNodeByMimeType = nullptr;
-    sqlite3_stmt* mStmtNodesByFp = nullptr;
-    sqlite3_stmt* mStmtNodeByFp = nullptr;
-    sqlite3_stmt* mStmtNodeByOrigFp = nullptr;
-    sqlite3_stmt* mStmtChildNode = nullptr;
-    sqlite3_stmt* mStmtIsAncestor = nullptr;
-    sqlite3_stmt* mStmtNumChild = nullptr;
-    sqlite3_stmt* mStmtRecents = nullptr;
-    sqlite3_stmt* mStmtFavourites = nullptr;
+    // Write the row of a node whose Node::serialize() output is 'nodeSerialized'
+    bool putSerialized(Node* node, const std::string& nodeSerialized);
+
+    // Keep the node's folded name in `nodesname`, returns the result of the step
+    int putName(Node* node);
+
+    // Run a statement that changes `alerts`, binding 'value' to its parameter if it has one
+    bool execalerts(const std::string& sql, int64_t value);
+
+    // The `path` column holds the handles of the node's ancestors, from the top, and its own,
+    // each as a fixed-size segment: a subtree is the range of paths that extend its root's one.
+    // A node whose parent isn't stored yet gets the parent's segment alone as prefix, and
+    // put() fixes up the stored descendants of any node whose path changes (moves, late parents)
+    bool getPath(NodeHandle nodeHandle, std::string& path);
+    int movePaths(const std::string& oldPath, const std::string& newPath);
+
+    // Range of the paths below 'ancestorHandle', false if it isn't stored
+    bool subtreePaths(NodeHandle ancestorHandle, std::string& lower, std::string& upper);
+
+    // Remove the nodes below 'ancestorHandle' that match 'condition' (an SQL "AND ..." clause, or empty)
+    bool removeInSubtree(NodeHandle ancestorHandle, const std::string& condition);
+
+    // Condition on `n1` matching the GLOB pattern bound to '?', and the pattern for a substring
+    std::string nameMatch() const;
+    std::string namePattern(const std::string& name) const;
+
+    // true if `nodesname` (FTS5 trigram index over the folded names) is available and maintained
+    bool mNameIndex = false;
+
+    // false in a legacy DB (see DbAccess::LEGACY_DB_VERSION)
+    bool mCompactNodes = true;
+
+    // Changes to the nodes, in total and as of the last commit: readers can't be handed out in between
+    uint64_t mNodesWrites = 0;
+    uint64_t mCommittedNodesWrites = 0;
+
+    // Read-only connections of getReader(), opened on demand (each with a private cache, so it
+    // reads on its own WAL snapshot). Shared with the readers in use, which may outlive this table
+    struct ReaderPool
+    {
+        std::mutex mMutex;
+        std::vector<std::unique_ptr<SqliteAccountState>> mIdle;
+        size_t mNumOpen = 0;
+        bool mClosed = false;
+    };
+    std::shared_ptr<ReaderPool> mReaders;
+    PrnGen& mRng;
+
+    // close the idle readers, and the ones in use once released
+    void closeReaders();
+
+    static const size_t MAX_READERS = 4;
+
+    // Prepared statements by SQL text, compiled on first use and finalized by finalise()
+    std::map<std::string, sqlite3_stmt*> mStatements;
+
+    // Cached statement for 'sql', already reset. Callers reset it again once done
+    // (statements with a variable SQL text, like getNodesByFingerprints(), bypass the cache)
+    int prepare(const std::string& sql, sqlite3_stmt*& stmt);
+
+    // In DEBUG builds, log the EXPLAIN QUERY PLAN output of every statement when it's compiled
+    void logQueryPlan(const std::string& sql);
+
+    // queries slower than this are logged with their stats in any build (all of them in DEBUG builds)
+    static const int SLOW_QUERY_MS = 100;
 
     // how many SQLite instructions will be executed between callbacks to the progress handler
     // (tests with a value of 1000 results on a callback every 1.2ms on a desktop PC)
@@ -161,8 +289,30 @@ public:
 
 private:
     bool openDBAndCreateStatecache(sqlite3 **db, FileSystemAccess& fsAccess, const string& name, mega::LocalPath &dbPath, const int flags);
+    // Create (and fill from `nodes`, for DBs that predate it) the index of node names
+    bool createNameIndex(sqlite3* db);
+    // Add and fill the `path` column of `nodes`, for DBs that predate it
+    bool addNodesPath(sqlite3* db);
+    // Add and fill the `namekey` column (naturalsortingKey() of the name) of `nodes`, for DBs that predate it
+    bool addNodesNameKey(sqlite3* db);
+    // Add the `parentid` column of `statecache`, for DBs that predate it, and index it
+    bool addStatecacheParent(sqlite3* db);
+    // Create the table of user alerts, indexed by timestamp
+    bool createAlertsTable(sqlite3* db);
     bool renameDBFiles(mega::FileSystemAccess& fsAccess, mega::LocalPath& legacyPath, mega::LocalPath& dbPath);
     void removeDBFiles(mega::FileSystemAccess& fsAccess, mega::LocalPath& dbPath);
+
+    // `tuning`, with the values left to the DB layer chosen for the size of the DB file
+    DbAccess::Tuning resolveTuning(FileSystemAccess& fsAccess, const LocalPath& dbPath) const;
+
+    // memory mapping only pays off once a DB outgrows the page cache, and needs address space to spare
+    static const int64_t MMAP_MIN_DB_SIZE = 64ll << 20;
+    static const int64_t MMAP_MAX_SIZE = 1ll << 30;
+    // SQLite's defaults, for small DBs
+    static const int64_t MIN_CACHE_SIZE_KB = 2000;
+    static const int MIN_WAL_CHECKPOINT_PAGES = 1000;
+    static const int64_t MAX_CACHE_SIZE_KB = 64 << 10;
+    static const int MAX_WAL_CHECKPOINT_PAGES = 10000;
 };
 
 } // namespace
@@ -46,7 +46,14 @@ struct MEGA_API FileAttributeFetchChannel
     faf_map fafs[2];
     error e;
 
+    // order of the fetches queued, see FileAttributeFetch::seq
+    uint64_t nextseq;
+
+    // fetches queued to an idle channel wait this long for others to join them in the same POST
+    static const dstime COALESCE_DS = 1;
+
     // dispatch new and retrying attributes by POSTing to existing URL
+    // the most recently requested go first: those are the ones the app is showing
     void dispatch();
 
     // parse fetch result and remove completed attributes from pending
@@ -66,6 +73,7 @@ struct MEGA_API FileAttributeFetch
     fatype type;
     int retries;
     int tag;
+    uint64_t seq;
 
     FileAttributeFetch(handle, string, fatype, int);
 };
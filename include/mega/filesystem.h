@@ -193,6 +193,11 @@ public:
     void append(const LocalPath& additionalPath);
     void appendWithSeparator(const LocalPath& additionalPath, bool separatorAlways);
     void prependWithSeparator(const LocalPath& additionalPath);
+
+    // replaces this path with the components joined root first, allocating the result once.
+    // equivalent to clearing and prepending each component from the leaf up, as LocalNode paths are built.
+    void assignComponents(const vector<const LocalPath*>& components);
+
     LocalPath prependNewWithSeparator(const LocalPath& additionalPath) const;
     void trimNonDriveTrailingSeparator();
     bool findNextSeparator(size_t& separatorBytePos) const;
@@ -250,6 +255,9 @@ public:
     bool operator==(const LocalPath& p) const { return localpath == p.localpath; }
     bool operator!=(const LocalPath& p) const { return localpath != p.localpath; }
     bool operator<(const LocalPath& p) const { return localpath < p.localpath; }
+
+    // consistent with operator==
+    size_t hash() const { return std::hash<string_type>()(localpath); }
 };
 
 class RemotePath
@@ -408,6 +416,14 @@ struct MEGA_API AsyncIOContext
 // map a request tag with pending paths of temporary files
 typedef map<int, vector<LocalPath> > pendingfiles_map;
 
+// read-only view of part of a file, unmapped on destruction (see FileAccess::fmap())
+struct MEGA_API MappedFileRange
+{
+    virtual ~MappedFileRange() { }
+
+    const byte* data = nullptr;
+};
+
 struct MEGA_API DirAccess;
 
 // generic host file/directory access interface
@@ -419,6 +435,9 @@ struct MEGA_API FileAccess
     // mtime of a file opened for reading
     m_time_t mtime = 0;
 
+    // inode change time, 0 where the platform doesn't report one
+    m_time_t ctime = 0;
+
     // local filesystem record id (survives renames & moves)
     handle fsid = 0;
     bool fsidvalid = false;
@@ -465,6 +484,15 @@ struct MEGA_API FileAccess
     // absolute position read to byte buffer
     bool frawread(byte *, unsigned, m_off_t, bool caller_opened = false);
 
+    // read count blocks of len bytes each, at ascending positions, back to back into dst.
+    // Blocks that share or neighbour a page are fetched with a single read.
+    bool frawreadv(byte* dst, unsigned len, const m_off_t* positions, unsigned count, bool caller_opened = false);
+
+    // map len bytes at pos, to be read once sequentially, opening and closing like fread().
+    // nullptr if the platform can't or the range is past the end: read with fread() then.
+    // The file must not shrink while mapped (reading would fault), nor live on a network filesystem.
+    virtual std::unique_ptr<MappedFileRange> fmap(unsigned len, m_off_t pos) { return nullptr; }
+
     // After a successful nonblocking fopen(), call openf() to really open the file (by localname)
     // (this is a lazy-type approach in case we don't actually need to open the file after finding out type/size/mtime).
     // If the size or mtime changed, it will fail.
@@ -476,9 +504,16 @@ struct MEGA_API FileAccess
     // absolute position write
     virtual bool fwrite(const byte *, unsigned, m_off_t) = 0;
 
+    // absolute position gather write: count buffers laid out back to back from pos
+    virtual bool fwritev(const byte* const* bufs, const unsigned* lens, unsigned count, m_off_t pos);
+
     // Truncate a file.
     virtual bool ftruncate() = 0;
 
+    // reserve the disk space of a file opened for writing that will grow to size, leaving its size as is.
+    // false only if the volume lacks the space: not being able to reserve it is fine.
+    virtual bool fpreallocate(m_off_t) { return true; }
+
     FileAccess(Waiter *waiter);
     virtual ~FileAccess();
 
@@ -544,6 +579,10 @@ struct Notification
     LocalNode* localnode = nullptr;
     bool recursive = false;
 
+    // stands for the notifications of the children of this folder, folded into it
+    // because they were storming: its known children are checked and it is rescanned
+    bool folded = false;
+
     Notification() {}
 
     Notification(dstime ts, const LocalPath& p, LocalNode* ln, bool recursive)
@@ -555,19 +594,65 @@ struct Notification
     }
 };
 
-struct NotificationDeque : ThreadSafeDeque<Notification>
+// Thread safe queue of notifications that coalesces them as they are queued, so that a separate
+// thread can receive filesystem notifications as soon as they are available.
+// A notification for a path that is already queued replaces the queued one, taking its place at the
+// back and the flags of both. Once FOLD_CHILDREN_THRESHOLD notifications for the children of the same
+// folder are queued, they are folded into one for the folder, which takes those that follow too.
+struct NotificationDeque
 {
-    void replaceLocalNodePointers(LocalNode* check, LocalNode* newvalue)
+    bool peekFront(Notification&);
+    // copies of the first max notifications, without removing them
+    void peekFront(size_t max, std::vector<Notification>&);
+    bool popFront(Notification&);
+    void unpopFront(const Notification&);
+    void pushBack(Notification&&);
+    bool empty();
+    size_t size();
+
+    void replaceLocalNodePointers(LocalNode* check, LocalNode* newvalue);
+
+    static const size_t FOLD_CHILDREN_THRESHOLD = 512;
+
+private:
+    struct Key
     {
-        std::lock_guard<std::mutex> g(m);
-        for (auto& n : mNotifications)
-        {
-            if (n.localnode == check)
-            {
-                n.localnode = newvalue;
-            }
-        }
-    }
+        LocalNode* localnode;
+        LocalPath path;
+
+        bool operator==(const Key& other) const { return localnode == other.localnode && path == other.path; }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const { return std::hash<LocalNode*>()(key.localnode) ^ key.path.hash(); }
+    };
+
+    struct Entry
+    {
+        Notification notification;
+
+        // cleared when replaced or folded: skipped when it gets to the front
+        bool live;
+    };
+
+    // entries stay put in a deque as it grows or shrinks at the ends, so the maps can point to them
+    std::deque<Entry> mNotifications;
+    std::unordered_map<Key, Entry*, KeyHash> mLive;
+
+    // live entries per parent folder, to detect when they storm
+    std::unordered_map<Key, size_t, KeyHash> mChildren;
+
+    std::mutex m;
+
+    static Key keyOf(const Notification&);
+    // the folder the notification is in, false if it has none
+    static bool parentKeyOf(const Notification&, Key&);
+
+    void skipDead();
+    void add(Notification&&, bool front);
+    void remove(Entry&);
+    void fold(const Key& parent, dstime timestamp);
 };
 
 // filesystem change notification, highly coupled to Syncs and LocalNodes.
@@ -621,6 +706,20 @@ public:
     virtual ~DirNotify() {}
 
     bool empty();
+
+    // counters across syncs for the performance report: notifications queued, those
+    // coalesced into others, and the checkpath() calls made for those processed
+    struct Stats
+    {
+        uint64_t received = 0;
+        uint64_t coalesced = 0;
+        uint64_t checkpaths = 0;
+    };
+    static Stats stats(bool reset);
+
+    static std::atomic<uint64_t> sReceived;
+    static std::atomic<uint64_t> sCoalesced;
+    static std::atomic<uint64_t> sCheckpaths;
 };
 #endif
 
@@ -671,6 +770,10 @@ struct MEGA_API FileSystemAccess : public EventTrigger
     // copy file, overwrite target, set mtime
     virtual bool copylocal(const LocalPath&, const LocalPath&, m_time_t) = 0;
 
+    // as copylocal(), but sharing the data blocks of the source (reflink) where the filesystem
+    // can, or copying inside the kernel. Falls back to copylocal().
+    virtual bool cloneFile(const LocalPath& source, const LocalPath& target, m_time_t mtime);
+
     // delete file
     virtual bool unlinklocal(const LocalPath&) = 0;
 
@@ -754,6 +857,15 @@ struct MEGA_API FileSystemAccess : public EventTrigger
     // True if the filesystem indicated by the specified path has stable FSIDs.
     virtual bool fsStableIDs(const LocalPath& path) const = 0;
 
+    // Current position of the change journal (NTFS's USN journal) of the volume holding path.
+    // Returns false where there is no journal we can read.
+    virtual bool changeJournalPosition(const LocalPath& path, handle& journalId, m_off_t& position) const;
+
+    // Reports each journal record after position: the item's fsid, its folder's fsid and its name.
+    // Returns false if the journal can't be replayed from there (recreated, or purged past position).
+    virtual bool readChangeJournal(const LocalPath& path, handle journalId, m_off_t position,
+                                   std::function<void(handle, handle, const LocalPath&)> f) const;
+
     virtual bool initFilesystemNotificationSystem();
 #endif // ENABLE_SYNC
 
@@ -782,6 +894,24 @@ struct MEGA_API FileSystemAccess : public EventTrigger
     // On success, the number of free bytes available to the caller.
     // On failure, zero.
     virtual m_off_t availableDiskSpace(const LocalPath& drivePath) = 0;
+
+    // Async writes queued on this thread between these calls may be held back and reach
+    // the OS together at the outermost asyncwritesend(). They nest. No-op by default.
+    virtual void asyncwritesbegin() { }
+    virtual void asyncwritesend() { }
+};
+
+// asyncwritesbegin() / asyncwritesend() for a scope
+class MEGA_API AsyncWriteBatch
+{
+public:
+    AsyncWriteBatch(FileSystemAccess& fsaccess) : mFsAccess(fsaccess) { mFsAccess.asyncwritesbegin(); }
+    ~AsyncWriteBatch() { mFsAccess.asyncwritesend(); }
+
+    MEGA_DISABLE_COPY_MOVE(AsyncWriteBatch);
+
+private:
+    FileSystemAccess& mFsAccess;
 };
 
 enum FilenameAnomalyType
@@ -845,6 +975,7 @@ struct MEGA_API FSNode
     bool isSymlink = false;
     bool isBlocked = false;
     FileFingerprint fingerprint; // includes size, mtime
+    m_time_t ctime = 0;          // 0 if unknown
 
     bool equivalentTo(const FSNode& n) const
     {
@@ -880,6 +1011,7 @@ struct MEGA_API FSNode
         f.isSymlink = isSymlink;
         f.isBlocked = isBlocked;
         f.fingerprint = fingerprint;
+        f.ctime = ctime;
         return f;
     }
 
@@ -904,6 +1036,37 @@ private:
     string toName_of_localname_cached;
 };
 
+// Where files with a given content fingerprint were last seen on this machine (completed
+// downloads, synced files), so a download of the same content can be served by a local copy.
+// Entries are hints only: callers must re-fingerprint the file before trusting it.
+class MEGA_API LocalFingerprintIndex
+{
+public:
+    explicit LocalFingerprintIndex(size_t maxEntries = 100000);
+
+    // record (or refresh) the path holding this content; the oldest entries go once full
+    void add(const FileFingerprint& fingerprint, const LocalPath& path);
+    void remove(const FileFingerprint& fingerprint);
+    bool find(const FileFingerprint& fingerprint, LocalPath& path) const;
+
+    void clear();
+    size_t size() const;
+
+private:
+    struct Entry
+    {
+        LocalPath path;
+        uint64_t seq;
+    };
+
+    size_t mMaxEntries;
+    uint64_t mSeq = 0;
+    std::map<FileFingerprint, Entry, FileFingerprintCmp> mEntries;
+
+    // insertion order for eviction; stale (re-added/removed) records are skipped by seq
+    std::deque<std::pair<FileFingerprint, uint64_t>> mOrder;
+};
+
 class MEGA_API ScanService
 {
 public:
@@ -918,7 +1081,8 @@ public:
             bool followSymlinks,
             LocalPath targetPath,
             handle expectedFsid,
-            map<LocalPath, FSNode>&& priorScanChildren);
+            map<LocalPath, FSNode>&& priorScanChildren,
+            bool networkFilesystem);
 
         MEGA_DISABLE_COPY_MOVE(ScanRequest);
 
@@ -966,13 +1130,26 @@ public:
         // fsid that the target path should still referene
         handle mExpectedFsid;
 
+        // Scanned under the (lower) network parallelism limit.
+        const bool mNetworkFilesystem;
+
     }; // ScanRequest
 
     // For convenience.
     using RequestPtr = std::shared_ptr<ScanRequest>;
 
     // Issue a scan for the given target.
-    RequestPtr queueScan(LocalPath targetPath, handle expectedFsid, bool followSymlinks, map<LocalPath, FSNode>&& priorScanChildren);
+    // Urgent scans (directories the engine is waiting on) are taken before any other.
+    RequestPtr queueScan(LocalPath targetPath,
+                         handle expectedFsid,
+                         bool followSymlinks,
+                         map<LocalPath, FSNode>&& priorScanChildren,
+                         FileSystemType fsType = FS_UNKNOWN,
+                         bool urgent = false);
+
+    // Worker threads, and how many of them may scan network filesystems at once.
+    // Takes effect when the shared worker is next created (no service alive).
+    static void setParallelism(unsigned numThreads, unsigned networkScans);
 
     // Track performance (debug only)
     static CodeCounter::ScopeStats syncScanTime;
@@ -982,34 +1159,61 @@ private:
     using ScanRequestPtr = std::shared_ptr<ScanRequest>;
 
     // Processes scan requests.
+    //
+    // Each thread owns a queue, fed round-robin, and steals from the back
+    // of the others' when its own is empty. Urgent requests and requests
+    // for network filesystems have shared queues of their own.
     class Worker
     {
     public:
-        Worker(size_t numThreads = 1);
+        Worker(size_t numThreads = 1, size_t networkScans = 1);
 
         ~Worker();
 
         MEGA_DISABLE_COPY_MOVE(Worker);
 
         // Queues a scan request for processing.
-        void queue(ScanRequestPtr request);
+        void queue(ScanRequestPtr request, bool urgent);
 
     private:
+        struct Queue
+        {
+            std::mutex mLock;
+            std::deque<ScanRequestPtr> mPending;
+        };
+
         // Thread entry point.
-        void loop();
+        void loop(size_t index);
+
+        // Waits for a request this thread may run, nullptr on termination.
+        ScanRequestPtr take(size_t index);
 
         // Processes a scan request.
-        ScanResult scan(ScanRequestPtr request, unsigned& nFingerprinted);
+        ScanResult scan(FileSystemAccess& fsAccess, ScanRequestPtr request, unsigned& nFingerprinted);
+
+        static ScanRequestPtr popFront(Queue& queue);
+        static ScanRequestPtr popBack(Queue& queue);
 
-        // Filesystem access.
-        std::unique_ptr<FileSystemAccess> mFsAccess;
+        // Per-thread queues of local filesystem requests.
+        std::vector<std::unique_ptr<Queue>> mQueues;
+        size_t mNextQueue = 0;
 
-        // Pending scan requests.
-        std::deque<ScanRequestPtr> mPending;
+        Queue mUrgent;
+        Queue mNetwork;
 
-        // Guards access to the above.
-        std::mutex mPendingLock;
-        std::condition_variable mPendingNotifier;
+        // Guards the counters below, which say what can be taken.
+        std::mutex mStateLock;
+        std::condition_variable mStateNotifier;
+
+        // Queued local requests (in mUrgent or mQueues) not yet taken.
+        size_t mLocalQueued = 0;
+
+        // Queued and running network requests.
+        size_t mNetworkQueued = 0;
+        size_t mNetworkRunning = 0;
+        const size_t mNetworkScans;
+
+        bool mTerminating = false;
 
         // Worker threads.
         std::vector<std::thread> mThreads;
@@ -1026,6 +1230,10 @@ private:
     // Synchronizes access to the above.
     static std::mutex mWorkerLock;
 
+    // Worker sizing, see setParallelism().
+    static unsigned mNumThreads;
+    static unsigned mNetworkScans;
+
 }; // ScanService
 
 // True if type denotes a network filesystem.
@@ -22,6 +22,8 @@
 #ifndef GFX_H
 #define GFX_H 1
 
+#include <atomic>
+#include <condition_variable>
 #include <mutex>
 
 #include "megawaiter.h"
@@ -49,6 +51,9 @@ public:
 
     // resulting images
     vector<string *> images;
+
+    // lower values are processed first (see GfxProc::gendimensionsputfa)
+    int priority = 0;
 };
 
 class MEGA_API GfxJobQueue
@@ -56,11 +61,19 @@ class MEGA_API GfxJobQueue
     protected:
         std::deque<GfxJob *> jobs;
         std::mutex mutex;
+        std::condition_variable cv;
+        bool closed = false;
 
     public:
         GfxJobQueue();
+
+        // jobs are kept sorted by priority, in arrival order among the same priority
         void push(GfxJob *job);
         GfxJob *pop();
+
+        // blocks until there is a job, returns NULL once the queue is closed
+        GfxJob *waitpop();
+        void close();
 };
 
 // Interface for graphic processor provider used by GfxProc
@@ -75,6 +88,8 @@ public: // read and store bitmap
     virtual bool readbitmap(FileSystemAccess*, const LocalPath&, int) = 0;
 
     // resize stored bitmap and store result as JPEG
+    // GfxProc asks for the sizes from the largest to the smallest, so the stored bitmap
+    // can be replaced by the resized one to derive the next size from it
     virtual bool resizebitmap(int, int, string* result) = 0;
 
     // free stored bitmap
@@ -86,6 +101,10 @@ public: // read and store bitmap
     // list of supported video extensions (NULL if no pre-filtering is needed)
     virtual const char* supportedvideoformats() = 0;
 
+    // list of extensions that may take long to decode, like PDF documents (NULL if none)
+    // GfxProc processes them on a lane of their own when it has one, so they don't hold back the rest
+    virtual const char* supportedslowformats() { return NULL; }
+
     // coordinate transformation
     static void transform(int&, int&, int&, int&, int&, int&);
 
@@ -99,18 +118,35 @@ protected:
 // bitmap graphics processor
 class MEGA_API GfxProc
 {
-    bool finished;
-    WAIT_CLASS waiter;
+    // processing thread with its own provider
+    struct Worker
+    {
+        Worker(GfxProc* p, IGfxProvider* gp, std::mutex* m, GfxJobQueue* q) : proc(p), provider(gp), providerMutex(m), queue(q) {}
+
+        GfxProc* proc;
+        IGfxProvider* provider;
+        std::mutex* providerMutex;  // NULL if the provider is only used by this worker
+        GfxJobQueue* queue;
+        THREAD_CLASS thread;
+    };
+
+    std::atomic<bool> finished;
     std::mutex mutex;
-    THREAD_CLASS thread;
     bool threadstarted = false;
     SymmCipher mCheckEventsKey;
     GfxJobQueue requests;
+    GfxJobQueue slowRequests;   // files of supportedslowformats(), if there is a slow lane provider
     GfxJobQueue responses;
     std::unique_ptr<IGfxProvider>  mGfxProvider;
+    std::vector<std::unique_ptr<IGfxProvider>> mExtraProviders;
+    std::unique_ptr<IGfxProvider> mSlowLaneProvider;
+    std::vector<std::unique_ptr<Worker>> mWorkers;
 
     static void *threadEntryPoint(void *param);
-    void loop();
+    void loop(IGfxProvider& provider, std::mutex* providerMutex, GfxJobQueue& queue);
+
+    // whether the filename looks like one of supportedslowformats()
+    bool isslow(const LocalPath&);
 
 public:
     // synchronously processes the results of gendimensionsputfa() (if any) in a thread safe manner
@@ -145,11 +181,18 @@ public:
 
     MegaClient* client;
 
-    // start a thread that will do the processing
+    // one more processing thread, with its own provider instance (call before startProcessingThread)
+    // jobs are shared by all threads, so the providers must not share state among them
+    void addProvider(std::unique_ptr<IGfxProvider>);
+
+    // a thread of its own, with its own provider, for the files of supportedslowformats() (call before startProcessingThread)
+    void addSlowLaneProvider(std::unique_ptr<IGfxProvider>);
+
+    // start the threads that will do the processing
     void startProcessingThread();
 
     // The provided IGfxProvider implements library specific image processing
-    // Thread safety among IGfxProvider methods is guaranteed by GfxProc
+    // Thread safety among the methods of each IGfxProvider is guaranteed by GfxProc
     GfxProc(std::unique_ptr<IGfxProvider>);
     virtual ~GfxProc();
 };
@@ -49,6 +49,7 @@ public:
 
     const char* supportedformats() override;
     const char* supportedvideoformats() override;
+    const char* supportedslowformats() override;
 
     GfxProviderFreeImage();
     ~GfxProviderFreeImage();
@@ -42,15 +42,17 @@ public:
     // PdfiumReader member method calling init() is responsible for locking pdfMutex
     static void init();
 
+    // The first page is rendered scaled down for its shorter side to be 'size' (0: at the page size), and
+    // given up if it would be larger than MAX_PDF_RENDER_SIZE in any dimension or take longer than MAX_PDF_RENDER_SECONDS
 #ifdef _WIN32
     // BGRA format, 4 bytes per pixel (32bits), byte order: blue, green, red, alpha.
     // init() is called internally if library is not initialized.
     // workingDirFolder : Path to create a temporary file.
-    static unique_ptr<char[]> readBitmapFromPdf(int &w, int &h, int &orientation, const LocalPath &path, FileSystemAccess* fa, const LocalPath &workingDirFolder);
+    static unique_ptr<char[]> readBitmapFromPdf(int &w, int &h, int &orientation, int size, const LocalPath &path, FileSystemAccess* fa, const LocalPath &workingDirFolder);
 #else
     // Returns a bitmap in BGRA format, 4 bytes per pixel (32bits), byte order: blue, green, red, alpha.
     // init() is called internally if library is not initialized.
-    static unique_ptr<char[]> readBitmapFromPdf(int &w, int &h, int &orientation, const LocalPath &path, FileSystemAccess* fa);
+    static unique_ptr<char[]> readBitmapFromPdf(int &w, int &h, int &orientation, int size, const LocalPath &path, FileSystemAccess* fa);
 #endif
     // It decreases the initializations internal counter and destroys the library once it reaches zero.
     static void destroy();
@@ -58,6 +58,9 @@ public:
     bool mModified = false;
     bool mSending = false;
 
+    // seconds the next keep-alive beat is brought forward by
+    int mKeepAliveJitter = 0;
+
 protected:
     handle mLastItemUpdated = UNDEF; // handle of node most recently updated
 
@@ -115,10 +118,27 @@ public:
 
 private:
     static constexpr int MAX_HEARBEAT_SECS_DELAY = 60*30; // max time to wait before a heartbeat for unchanged backup
+    static constexpr int HEARTBEAT_JITTER_SECS = 60*3; // max time a keep-alive heartbeat is brought forward
+    static constexpr int HEARTBEAT_BATCH_WINDOW_SECS = 60*5; // keep-alives due this soon join heartbeats being sent
+
+    struct HeartBeat
+    {
+        std::shared_ptr<HeartBeatSyncInfo> hbs;
+        handle backupId;
+        CommandBackupPutHeartBeat::SPHBStatus status;
+        int8_t progress;
+        uint32_t pendingUps;
+        uint32_t pendingDowns;
+        m_time_t lastAction;
+        handle lastItemUpdated;
+    };
 
     Syncs& syncs;
 
-    void beatBackupInfo(UnifiedSync& us);
+    m_time_t mLastScan = -1;
+
+    bool updateBackupInfo(UnifiedSync& us);
+    HeartBeat prepareBeat(UnifiedSync& us, m_time_t now);
 };
 
 #endif
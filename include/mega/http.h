@@ -23,6 +23,7 @@
 #define MEGA_HTTP_H 1
 
 #include <atomic>
+#include <random>
 #include "types.h"
 #include "waiter.h"
 #include "backofftimer.h"
@@ -194,6 +195,9 @@ public:
     m_off_t lastRequestSpeed();
     dstime requestElapsedDs();
 
+    // time from requestStarted() to the first data of the request (0 until some arrives)
+    dstime requestFirstByteDs() { return mRequestFirstByte; }
+
 protected:
     // a circular buffer of bytes received/transmitted per decisecond
     std::array<m_off_t, SPEED_MEAN_MAX_INTERVAL_DS> mCircularBuf;
@@ -209,6 +213,74 @@ protected:
     m_off_t mRequestPos = 0;
     dstime mRequestStart = 0;
     dstime mLastRequestUpdate = 0;
+    dstime mRequestFirstByte = 0;
+};
+
+// token buckets for the upload and download limits, shared by all the HttpIO instances of the
+// process. each refill is split between the categories with active requests by weight, then
+// evenly between their requests. credit a request can't hold spills over to a pool that any
+// request may draw from, so bandwidth one category leaves unused goes to the others.
+class MEGA_API BandwidthScheduler
+{
+public:
+    enum Category
+    {
+        USER,
+        SYNC,
+        BACKUP,
+        STREAMING,
+        NUM_CATEGORIES
+    };
+
+    // tokens a bucket can hold, in ds of its rate
+    static const dstime BURST_DS = 5;
+
+    // lower bound for what a bucket can hold, so that a write callback always fits
+    static const m_off_t MIN_BURST = 65536;
+
+    // requests idle for this long stop receiving a share
+    static const dstime IDLE_DS = 20;
+
+    BandwidthScheduler();
+
+    static BandwidthScheduler& instance();
+
+    // bytes per second, 0 for no limit
+    void setlimit(direction_t d, m_off_t bps);
+    m_off_t getlimit(direction_t d) const;
+
+    void setweight(Category c, unsigned weight);
+    unsigned getweight(Category c) const;
+
+    // bytes of len that the request may transfer now (0: wait for a refill).
+    // if !partial, either all of them are granted (overdrawing its credit) or none.
+    size_t acquire(direction_t d, const void* request, Category c, size_t len, bool partial, dstime now);
+
+    // add the tokens accrued since the last refill
+    void refill(direction_t d, dstime now);
+
+    // the request is gone
+    void release(const void* request);
+
+private:
+    struct Flow
+    {
+        Category category;
+        m_off_t credit;
+        dstime lastactive;
+    };
+
+    struct Bucket
+    {
+        std::atomic<m_off_t> limit{0};
+        m_off_t spare = 0;
+        dstime lastrefill = 0;
+        std::map<const void*, Flow> flows;
+    };
+
+    mutable std::mutex mMutex;
+    Bucket mBuckets[2];
+    std::array<unsigned, NUM_CATEGORIES> mWeights;
 };
 
 extern std::mutex g_APIURL_default_mutex;
@@ -258,6 +330,10 @@ struct MEGA_API HttpIO : public EventTrigger
     m_off_t uploadSpeed;
     void updateuploadspeed(m_off_t size = 0);
 
+    // transfer data moved since the start (as reported to the speed controllers above)
+    m_off_t downloadedBytes = 0;
+    m_off_t uploadedBytes = 0;
+
     // data receive timeout (ds)
     static const int NETWORKTIMEOUT;
 
@@ -300,12 +376,152 @@ struct MEGA_API HttpIO : public EventTrigger
     // get max upload speed
     virtual m_off_t getmaxuploadspeed();
 
+    // multiplex concurrent requests to the same host over shared HTTP/2 connections (https only)
+    virtual bool setmultiplexing(bool enable);
+
+    // whether JSON input purged by the caller while the request is in flight is accounted for
+    virtual bool supportsincrementalresponses() const { return false; }
+
     virtual bool cacheresolvedurls(const std::vector<string>&, std::vector<string>&&) { return false; }
 
+    // start resolving the hosts of URLs that will be requested soon
+    virtual void prefetchdns(const std::vector<string>&) { }
+
     HttpIO();
     virtual ~HttpIO() { }
 };
 
+// Decorator of a real HttpIO that makes the network worse in a controlled way, so that the transfer
+// and scheduling heuristics can be measured reproducibly: requests are sent after an extra latency,
+// their completion is held until their size at the emulated bandwidth has gone by, and some of them
+// fail as network errors.  Conditions can be set for all requests and overridden for the URLs that
+// contain a given string (a host, or a part of it), at any time and from any thread.
+// The resolution is that of the client loop (it wakes up every decisecond at most for these events).
+class MEGA_API EmulatedNetworkHttpIO : public HttpIO
+{
+public:
+    struct Conditions
+    {
+        unsigned latencyMs = 0;             // before each request is sent
+        unsigned jitterMs = 0;              // random extra latency, up to this
+        m_off_t bytesPerSecond = 0;         // throughput of each request, 0 for no cap
+        unsigned lossPercent = 0;           // requests that fail (after the latency) with no HTTP status
+    };
+
+    explicit EmulatedNetworkHttpIO(std::unique_ptr<HttpIO> inner, unsigned seed = 0);
+    ~EmulatedNetworkHttpIO() override;
+
+    void setConditions(const Conditions&);
+    void setUrlConditions(const string& urlPart, const Conditions&);
+    void clearUrlConditions();
+
+    // requests failed on purpose so far
+    uint64_t injectedFailures() const;
+
+    HttpIO& inner() { return *mInner; }
+
+    void post(HttpReq*, const char* = NULL, unsigned = 0) override;
+    void cancel(HttpReq*) override;
+    m_off_t postpos(void*) override;
+    bool doio(void) override;
+    void addevents(Waiter*, int) override;
+    int checkevents(Waiter*) override;
+    void lock() override;
+    void unlock() override;
+    void disconnect() override;
+    void setuseragent(string*) override;
+    Proxy* getautoproxy() override;
+    bool setmaxdownloadspeed(m_off_t bpslimit) override;
+    bool setmaxuploadspeed(m_off_t bpslimit) override;
+    m_off_t getmaxdownloadspeed() override;
+    m_off_t getmaxuploadspeed() override;
+    bool setmultiplexing(bool enable) override;
+    bool supportsincrementalresponses() const override;
+    bool cacheresolvedurls(const std::vector<string>&, std::vector<string>&&) override;
+    void prefetchdns(const std::vector<string>&) override;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // waiting for its latency to be sent
+    struct Pending
+    {
+        const char* data;
+        unsigned len;
+        Clock::time_point due;
+        bool fail;
+    };
+
+    // sent to the inner HttpIO; once it completes, held until the emulated transfer time is over
+    struct Sent
+    {
+        Clock::time_point sent;
+        m_off_t bytesPerSecond;
+        bool held = false;
+        Clock::time_point heldUntil;
+        reqstatus_t status = REQ_INFLIGHT;
+    };
+
+    Conditions conditionsFor(const string& url);
+    bool releaseDue(Clock::time_point now);
+    void holdCompleted(Clock::time_point now);
+    bool nextDue(Clock::time_point& due) const;
+    void pushState();
+    void pullState();
+
+    std::unique_ptr<HttpIO> mInner;
+    std::map<HttpReq*, Pending> mPending;
+    std::map<HttpReq*, Sent> mSent;
+
+    mutable std::mutex mConditionsMutex;
+    Conditions mConditions;
+    std::vector<std::pair<string, Conditions>> mUrlConditions;
+    std::mt19937 mRandom;
+    std::atomic<uint64_t> mInjectedFailures{0};
+};
+
+// Process-wide cache of the buffers that transfer chunks are downloaded into and
+// decrypted/reassembled from (HttpReqDL, RaidBufferManager pieces, TransferSlot handoffs).
+// Buffers are rounded up to a size class (four classes per power of two) and kept on a
+// free list when released, up to maxCachedBytes, so steady-state transfers stop hitting the heap.
+// Buffers obtained from allocate() must be returned with release(), never delete[].
+class MEGA_API TransferBufferPool
+{
+public:
+    struct Stats
+    {
+        uint64_t allocations = 0;     // calls to allocate()
+        uint64_t poolHits = 0;        // allocations satisfied from a free list
+        uint64_t releases = 0;        // calls to release() with a non-null buffer
+        uint64_t discards = 0;        // released buffers freed because the cache was full or they were too big
+        size_t cachedBytes = 0;       // capacity currently held on the free lists
+        size_t cachedBuffers = 0;
+        size_t outstandingBytes = 0;  // capacity currently handed out
+    };
+
+    // returns a buffer with room for at least len bytes (NULL for len 0)
+    static byte* allocate(size_t len);
+
+    // returns a buffer from allocate() to the pool (NULL is ignored)
+    static void release(byte* b);
+
+    // upper bound on bytes kept on the free lists; lowering it trims immediately
+    static void setMaxCachedBytes(size_t bytes);
+    static size_t maxCachedBytes();
+
+    // give all cached buffers back to the OS
+    static void trim();
+
+    // counters are cumulative until reset; the cached/outstanding gauges are never reset
+    static Stats stats(bool reset = false);
+
+    // size actually reserved for a request of len bytes
+    static size_t capacityFor(size_t len);
+
+    // requests above this size are allocated and freed directly
+    static const size_t MAXPOOLEDSIZE = 64 * 1024 * 1024;
+};
+
 // outgoing HTTP request
 struct MEGA_API HttpReq
 {
@@ -338,18 +554,40 @@ struct MEGA_API HttpReq
     // if the out payload includes a fetch nodes command
     bool includesFetchingNodes = false;
 
+    // the caller parses and purges the input as it arrives: don't reserve room for all of it
+    bool incremental = false;
+
+    // share of the bandwidth limits this request competes for
+    BandwidthScheduler::Category bandwidthcategory = BandwidthScheduler::USER;
+
     byte* buf;
     m_off_t buflen, bufpos, notifiedbufpos;
 
     // we assume that API responses are smaller than 4 GB
     m_off_t contentlength;
 
+    // the response body came compressed (Content-Encoding), and whether contentlength
+    // is that of the decoded body (Original-Content-Length) rather than of what was sent
+    bool contentencoded = false;
+    bool decodedlength = false;
+
     // time left related to a bandwidth overquota
     m_time_t timeleft;
 
     // Content-Type of the response
     string contenttype;
 
+    // where the time of the request went, in ms from sending it, as far as the HttpIO measures it (0 if unknown):
+    // name resolution, connection setup and TLS handshake (if it opened a connection) and the first byte of the response
+    struct Timings
+    {
+        unsigned dns = 0;
+        unsigned connect = 0;
+        unsigned tls = 0;
+        unsigned firstByte = 0;
+        bool newConnection = false;
+    } timings;
+
     // HttpIO implementation-specific identifier for this connection
     void* httpiohandle;
 
@@ -379,6 +617,9 @@ struct MEGA_API HttpReq
     char* data();
     size_t size();
 
+    // memory held by the request and response bodies (for memory reports)
+    size_t bufferedBytes() const;
+
     // a buffer that the HttpReq filled in.   This struct owns the buffer (so HttpReq no longer has it).
     struct http_buf_t
     {
@@ -388,7 +629,7 @@ struct MEGA_API HttpReq
         size_t start;
         size_t end;
 
-        http_buf_t(byte* b, size_t s, size_t e);  // takes ownership of the byte*, which must have been allocated with new[]
+        http_buf_t(byte* b, size_t s, size_t e);  // takes ownership of the byte*, which must have been allocated with TransferBufferPool::allocate()
         ~http_buf_t();
         void swap(http_buf_t& other);
         bool isNull();
@@ -400,6 +641,16 @@ struct MEGA_API HttpReq
     // give up ownership of the buffer for client to use.  The caller is the new owner of the http_buf_t, and the HttpReq no longer has the buffer or any info about it.
     http_buf_t* release_buf();
 
+    // segmented receive for streamed binary responses of unknown consumption pace: when nonzero, data is
+    // received into pooled buffers of this size (a multiple of the cipher block size) instead of `in`.
+    // Each full buffer is queued in `segments`, ready to become a FilePiece without a copy.
+    // In this mode inpurge is the part of the current buffer already taken by the caller.
+    unsigned segmentsize = 0;
+    vector<http_buf_t*> segments;
+
+    // hand over the current segment from the first byte not yet taken (segmented receive)
+    http_buf_t* releasesegment();
+
     // set amount of purgeable data at 0
     void purge(size_t);
 
@@ -473,6 +724,9 @@ public:
     // len must be < 2^31
     virtual byte* nextbuffer(unsigned datasize) = 0;
 
+    // where to read the plaintext of the buffer just returned by nextbuffer(), if not from it
+    virtual const byte* nextsource(unsigned datasize) { return nullptr; }
+
     bool encrypt(m_off_t pos, m_off_t npos, string& urlSuffix);
 
 private:
@@ -488,10 +742,14 @@ class MEGA_API EncryptBufferByChunks : public EncryptByChunks
     // specialisation for encrypting a whole contiguous buffer by chunks
     byte *chunkstart;
 
+    // plaintext read from here instead, if not null
+    const byte* sourcestart;
+
     byte* nextbuffer(unsigned bufsize) override;
+    const byte* nextsource(unsigned bufsize) override;
 
 public:
-    EncryptBufferByChunks(byte* b, SymmCipher* k, chunkmac_map* m, uint64_t iv);
+    EncryptBufferByChunks(byte* b, SymmCipher* k, chunkmac_map* m, uint64_t iv, const byte* source = nullptr);
 };
 
 // file chunk I/O
@@ -499,6 +757,9 @@ struct MEGA_API HttpReqXfer : public HttpReq
 {
     unsigned size;
 
+    // time spent encrypting or decrypting the data of this request on a worker thread (us), until the slot collects it
+    std::atomic<uint64_t> cryptoUs{0};
+
     virtual void prepare(const char*, SymmCipher*, uint64_t, m_off_t, m_off_t) = 0;
 
     HttpReqXfer() : HttpReq(true), size(0) { }
@@ -509,11 +770,14 @@ struct MEGA_API HttpReqUL : public HttpReqXfer
 {
     chunkmac_map mChunkmacs;
 
+    // mapped plaintext of the chunk, encrypted straight into out by prepare() (see FileAccess::fmap())
+    std::unique_ptr<MappedFileRange> mSource;
+
     void prepare(const char*, SymmCipher*, uint64_t, m_off_t, m_off_t);
 
     m_off_t transferred(MegaClient*);
 
-    ~HttpReqUL() { }
+    ~HttpReqUL();
 };
 
 // file chunk download
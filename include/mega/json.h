@@ -105,6 +105,9 @@ struct MEGA_API JSON
     // copy JSON-delimited string
     static void copystring(string*, const char*);
 
+    // compare a JSON-delimited string (eg. from getvalue()) without copying it
+    static bool equalstring(const string&, const char*);
+
     // Strip whitspace from a string in a JSON-safe manner.
     static string stripWhitespace(const string& text);
     static string stripWhitespace(const char* text);
@@ -160,12 +163,28 @@ public:
     size_t size() const;
     void clear() { mJson.clear(); }
 
+    // make room for about this much more output, to avoid growing the buffer piecemeal
+    void reserve(size_t);
+
+    // reuse a buffer that an earlier writer on this thread handed over with recycle()
+    void reusebuffer();
+
+    // hand over the buffer for reuse, leaving this writer empty
+    void recycle();
+
 protected:
     string escape(const char* data, size_t length) const;
 
 private:
     static const int MAXDEPTH = 8;
 
+    // buffers kept for reuse per thread, and the largest one worth keeping
+    static const size_t MAX_RECYCLED = 8;
+    static const size_t MAX_RECYCLED_CAPACITY = 1024 * 1024;
+
+    // base64-encode straight into the output
+    void appendbase64(const byte*, int);
+
     int elements();
 
     string mJson;
@@ -173,6 +192,45 @@ private:
     signed char mLevel;
 }; // JSONWriter
 
+// finds the complete elements of a JSON array while the document is still arriving,
+// so they can be parsed (and their input dropped) before the rest of it is there.
+// the array must follow a fixed prefix, e.g. [{"f":[ for the nodes of a fetchnodes response.
+// only object and array elements are delimited.
+class MEGA_API JSONArrayScanner
+{
+public:
+    explicit JSONArrayScanner(const string& prefix);
+
+    enum Status
+    {
+        INCOMPLETE, // no further complete element yet
+        ELEMENTS,   // [begin, end) holds one or more comma-separated elements
+        ENDED,      // the array is closed, begin is the offset of its ']'
+        MISMATCH    // the input doesn't start with the prefix
+    };
+
+    // data/len is the input not yet consumed
+    Status next(const char* data, size_t len, size_t& begin, size_t& end);
+
+    // the caller dropped the first n bytes of its input
+    void consumed(size_t n);
+
+    bool started() const { return mStarted; }
+
+private:
+    string mPrefix;
+    bool mStarted = false;
+    bool mEnded = false;
+    bool mInString = false;
+    bool mEscape = false;
+    int mDepth = 0;
+
+    // offsets into the unconsumed input
+    size_t mScan = 0;       // next byte to scan
+    size_t mBegin = 0;      // first byte not yet returned
+    size_t mLastEnd = 0;    // end of the last complete element
+};
+
 } // namespace
 
 #endif
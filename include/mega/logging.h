@@ -93,10 +93,12 @@
 #include <atomic>
 #include <cassert>
 #include <cstring>
+#include <functional>
 #include <iostream>
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 // define MEGA_QT_LOGGING to support QString
@@ -624,6 +626,148 @@ public:
     }
 };
 
+// A log statement captured as data rather than text: the (static) format string
+// acts as the message id, and the arguments are stored by value in a fixed-size
+// record so that producing one never allocates. Formatting into text happens
+// later, usually on the RotativePerformanceLogger thread.
+// Placeholders in the format string are written as "{}".
+struct LogRecord
+{
+    static const unsigned MAX_ARGS = 8;
+    static const size_t TEXT_CHARS = 64;   // shared by all string arguments; longer ones are truncated
+
+    enum ArgType : uint8_t { ARG_INT, ARG_UINT, ARG_DOUBLE, ARG_POINTER, ARG_TEXT };
+
+    struct Arg
+    {
+        ArgType type;
+        uint16_t textLength;    // for ARG_TEXT, the text starts at `u` within `text`
+        union
+        {
+            long long i;
+            unsigned long long u;
+            double d;
+            const void* p;
+        };
+    };
+
+    const char* format = nullptr;   // must have static storage duration
+    const char* file = nullptr;
+    int line = 0;
+    LogLevel level = logInfo;
+    unsigned numArgs = 0;
+    unsigned textUsed = 0;
+    long long timestampUs = 0;      // microseconds since the epoch, set on submission
+    std::thread::id thread;
+    Arg args[MAX_ARGS];
+    char text[TEXT_CHARS];
+
+    LogRecord() = default;
+    LogRecord(LogLevel l, const char* f, int ln, const char* fmt)
+        : format(fmt), file(f), line(ln), level(l)
+    {
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value>::type add(T v)
+    {
+        if (std::is_signed<T>::value) addInt(static_cast<long long>(v));
+        else addUInt(static_cast<unsigned long long>(v));
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type add(T v)
+    {
+        if (Arg* a = nextArg(ARG_DOUBLE)) a->d = static_cast<double>(v);
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_enum<T>::value>::type add(T v)
+    {
+        addInt(static_cast<long long>(v));
+    }
+
+    template<typename T>
+    void add(const T* v)
+    {
+        if (Arg* a = nextArg(ARG_POINTER)) a->p = v;
+    }
+
+    void add(const char* v)
+    {
+        addText(v ? v : "(NULL)", v ? strlen(v) : 6);
+    }
+
+    void add(const std::string& v)
+    {
+        addText(v.data(), v.size());
+    }
+
+    // the message with all placeholders substituted (without file and line)
+    std::string toString() const;
+
+private:
+    Arg* nextArg(ArgType type)
+    {
+        if (numArgs >= MAX_ARGS) return nullptr;
+        Arg* a = &args[numArgs++];
+        a->type = type;
+        return a;
+    }
+
+    void addInt(long long v)
+    {
+        if (Arg* a = nextArg(ARG_INT)) a->i = v;
+    }
+
+    void addUInt(unsigned long long v)
+    {
+        if (Arg* a = nextArg(ARG_UINT)) a->u = v;
+    }
+
+    void addText(const char* v, size_t len);
+};
+
+inline void addLogRecordArgs(LogRecord&)
+{
+}
+
+template<typename T, typename... Rest>
+void addLogRecordArgs(LogRecord& r, const T& first, const Rest&... rest)
+{
+    r.add(first);
+    addLogRecordArgs(r, rest...);
+}
+
+// Fast path for hot debug logging (transfers, sync). Records go into a
+// fixed-size lock-free ring when a drainer (the RotativePerformanceLogger) is
+// active, and are formatted on its thread. Without a drainer, or when the ring
+// is full, the record is formatted immediately and sent through SimpleLogger,
+// so nothing is lost; it just costs what an ordinary LOG_ statement costs.
+class StructuredLog
+{
+public:
+    template<typename... Args>
+    static void write(LogLevel level, const char* file, int line, const char* format, const Args&... args)
+    {
+        if (SimpleLogger::mThreadLocalLoggingDisabled) return;
+        LogRecord r(level, file, line, format);
+        addLogRecordArgs(r, args...);
+        submit(r);
+    }
+
+    static void submit(LogRecord& r);
+
+    // Pops every queued record and passes it to `f`. Only one thread may drain.
+    static size_t drain(const std::function<void(const LogRecord&)>& f);
+
+    static void setDrainerActive(bool active);
+    static bool drainerActive();
+
+    // number of records that were formatted immediately because the ring was full
+    static unsigned long long overflowCount();
+};
+
 // source file leaf name - maybe to be compile time calculated one day
 template<std::size_t N> inline const char* log_file_leafname( const char (&fullpath)[N]) {
     for (auto i = N - 1; --i; )
@@ -637,29 +781,51 @@ template<std::size_t N> inline const char* log_file_leafname( const char (&fullp
 std::ostream& operator <<(std::ostream&, const std::system_error&);
 std::ostream& operator <<(std::ostream&, const std::error_code&);
 
+// Compile-time ceiling for the LOG_ and LOGF_ macros. Statements above this level
+// are removed by the compiler, e.g. -DMEGA_LOG_COMPILED_LEVEL=3 drops all debug
+// and verbose logging. The runtime level is still checked below the ceiling.
+#ifndef MEGA_LOG_COMPILED_LEVEL
+#define MEGA_LOG_COMPILED_LEVEL 5
+#endif
+
+#define MEGA_LOG_ENABLED(level) \
+    (MEGA_LOG_COMPILED_LEVEL >= (level) && ::mega::SimpleLogger::logCurrentLevel >= (level))
+
 #define LOG_verbose \
-    if (::mega::SimpleLogger::logCurrentLevel >= ::mega::logMax) \
+    if (MEGA_LOG_ENABLED(::mega::logMax)) \
         ::mega::SimpleLogger(::mega::logMax, ::mega::log_file_leafname(__FILE__), __LINE__)
 
 #define LOG_debug \
-    if (::mega::SimpleLogger::logCurrentLevel >= ::mega::logDebug) \
+    if (MEGA_LOG_ENABLED(::mega::logDebug)) \
         ::mega::SimpleLogger(::mega::logDebug, ::mega::log_file_leafname(__FILE__), __LINE__)
 
 #define LOG_info \
-    if (::mega::SimpleLogger::logCurrentLevel >= ::mega::logInfo) \
+    if (MEGA_LOG_ENABLED(::mega::logInfo)) \
         ::mega::SimpleLogger(::mega::logInfo, ::mega::log_file_leafname(__FILE__), __LINE__)
 
 #define LOG_warn \
-    if (::mega::SimpleLogger::logCurrentLevel >= ::mega::logWarning) \
+    if (MEGA_LOG_ENABLED(::mega::logWarning)) \
         ::mega::SimpleLogger(::mega::logWarning, ::mega::log_file_leafname(__FILE__), __LINE__)
 
 #define LOG_err \
-    if (::mega::SimpleLogger::logCurrentLevel >= ::mega::logError) \
+    if (MEGA_LOG_ENABLED(::mega::logError)) \
         ::mega::SimpleLogger(::mega::logError, ::mega::log_file_leafname(__FILE__), __LINE__)
 
 #define LOG_fatal \
     ::mega::SimpleLogger(::mega::logFatal, ::mega::log_file_leafname(__FILE__), __LINE__)
 
+// Structured variants: LOGF_debug("Connection {} received {} bytes", i, n);
+// The format must be a string literal. See StructuredLog.
+#define MEGA_LOGF(level, ...) \
+    do { if (MEGA_LOG_ENABLED(level)) \
+        ::mega::StructuredLog::write(level, ::mega::log_file_leafname(__FILE__), __LINE__, __VA_ARGS__); } while (0)
+
+#define LOGF_verbose(...) MEGA_LOGF(::mega::logMax, __VA_ARGS__)
+#define LOGF_debug(...) MEGA_LOGF(::mega::logDebug, __VA_ARGS__)
+#define LOGF_info(...) MEGA_LOGF(::mega::logInfo, __VA_ARGS__)
+#define LOGF_warn(...) MEGA_LOGF(::mega::logWarning, __VA_ARGS__)
+#define LOGF_err(...) MEGA_LOGF(::mega::logError, __VA_ARGS__)
+
 #if (defined(ANDROID) || defined(__ANDROID__))
 inline void crashlytics_log(const char* msg)
 {
@@ -25,7 +25,12 @@
 #include "types.h"
 #include "json.h"
 #include "filesystem.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <thread>
 
 namespace mega {
 
@@ -79,7 +84,12 @@ struct MEGA_API MediaProperties
     static bool isMediaFilenameExt(const std::string& ext);
 
     // Open the specified local file with mediainfoLib and get its video parameters.  This function fills in the names but not the IDs
-    void extractMediaPropertyFileAttributes(LocalPath& localFilename, FileSystemAccess* fa);
+    // If verifiedFile is given (opened with fopen(localFilename) already), it is read instead, provided the file has not changed since
+    void extractMediaPropertyFileAttributes(LocalPath& localFilename, FileSystemAccess* fa, FileAccess* verifiedFile = nullptr);
+
+    // Same, reading through fa: with verified, fa was opened with fopen(localFilename) already and is only reopened
+    // if the file has not changed since; otherwise localFilename is opened with it
+    void extractMediaPropertyFileAttributes(LocalPath& localFilename, FileAccess* fa, bool verified);
 
     // Look up the IDs of the codecs and container, and encode and encrypt all the info into a string with file attribute 8, and possibly file attribute 9.
     std::string convertMediaPropertyFileAttributes(uint32_t attributekey[4], MediaFileInfo& mediaInfo);
@@ -159,6 +169,52 @@ struct MediaFileInfo::queuedvp
     // the key to use for XXTEA encryption (which is not the same as the file data key)
     uint32_t fakey[4];
 };
+
+// Process-wide pool for media property extraction.
+// MediaInfo may read several megabytes and seek around a file before it finds the moov atom or the
+// matroska cues, so transfers hand the file to a worker here instead of holding the client thread, and
+// the client's waiter is notified when the properties are ready.  The client polls done on its own thread.
+class MEGA_API MediaExtractionService
+{
+public:
+    struct Request
+    {
+        LocalPath localPath;
+        std::unique_ptr<FileAccess> fileAccess;
+        bool verified = false;
+
+        // written by the worker before done is set
+        MediaProperties vp;
+        std::atomic<bool> done { false };
+
+    private:
+        friend class MediaExtractionService;
+        Waiter* waiter = nullptr;  // guarded by the service mutex, cleared by cancel()
+        bool cancelled = false;
+    };
+    typedef std::shared_ptr<Request> RequestPtr;
+
+    static MediaExtractionService& instance();
+
+    // queue an extraction reading localPath through fileAccess (see MediaProperties::extractMediaPropertyFileAttributes)
+    // waiter (may be null) is notified once request->done is set
+    RequestPtr extract(const LocalPath& localPath, std::unique_ptr<FileAccess> fileAccess, bool verified, Waiter* waiter);
+
+    // the request's waiter is no longer notified, and a request still queued is not extracted at all
+    void cancel(const RequestPtr& request);
+
+    explicit MediaExtractionService(unsigned threadCount);
+    ~MediaExtractionService();
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mConditionVariable;
+    std::deque<RequestPtr> mQueue;
+    std::vector<std::thread> mThreads;
+    bool mShutdown = false;
+
+    void threadLoop();
+};
 #endif
 
 } // namespace
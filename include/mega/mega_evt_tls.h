@@ -99,6 +99,9 @@ struct evt_tls_s {
 
     QUEUE q;
     BIO     *ssl_bio; //the ssl BIO used only by openSSL
+
+    //the kernel encrypts the data sent (see evt_tls_enable_ktls_tx)
+    int ktls_tx;
 };
 
 
@@ -138,6 +141,11 @@ void evt_ctx_set_writer(evt_ctx_t *ctx, net_wrtr my_writer);
 void evt_ctx_set_reader(evt_ctx_t *ctx, net_rdr my_reader);
 void evt_ctx_set_nio(evt_ctx_t *ctx, net_rdr my_reader, net_wrtr my_writer);
 
+/*restrict the sessions of this ctx to the ones evt_tls_enable_ktls_tx can
+hand to the kernel (TLS 1.2 without renegotiation, AES-GCM preferred).
+Return 1 if kernel TLS is supported in this build, 0 otherwise */
+int evt_ctx_prepare_ktls(evt_ctx_t *ctx);
+
 /*clean up the resources held by async tls engine, This also closes endpoints
 if any left */
 void evt_ctx_free(evt_ctx_t *ctx);
@@ -165,6 +173,13 @@ Upon completion, `evt_handshake_cb is called, status == 0 for failure and
 int evt_tls_accept( evt_tls_t *tls, evt_handshake_cb cb);
 
 
+/*Linux only: once the handshake is over, hand the keys used to send to the
+kernel (TCP_ULP "tls") for the socket `fd`, so `evt_tls_write` passes the text
+as is to the writer and the kernel encrypts it. Everything written by the
+handshake must have reached the socket already. No close_notify is sent
+afterwards. Return 1 if the kernel encrypts the data sent, 0 otherwise */
+int evt_tls_enable_ktls_tx(evt_tls_t *tls, int fd);
+
 /*Perform wrapping of text and do network write, `evt_write_cb` is called on
 completion and status is used for status */
 int evt_tls_write(evt_tls_t *c, void *msg, size_t str_len, evt_write_cb on_write);
@@ -113,6 +113,9 @@ struct MEGA_API MegaApp
     // node fetch result
     virtual void fetchnodes_result(const Error&) { }
 
+    // nodes loaded from the local cache, still catching up with the action packets
+    virtual void nodes_cached() { }
+
     // nodes now (nearly) current
     virtual void nodes_current() { }
 
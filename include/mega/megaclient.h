@@ -220,6 +220,9 @@ std::ostream& operator<<(std::ostream &os, const SCSN &scsn);
 
 struct SyncdownContext
 {
+    // visit every folder, not only those flagged by setSyncdownPending()
+    bool mFullWalk = true;
+
     bool mBackupActionsPerformed = false;
     bool mBackupForeignChangeDetected = false;
 }; // SyncdownContext
@@ -259,6 +262,51 @@ struct FileAttributesPending : public mapWithLookupExisting<UploadHandle, Upload
 
 class MegaClient;
 
+// Bounded cache of the resolutions made by MegaClient::nodeByPath(), failed ones included.
+// An entry depends on the nodes its path went through and on the names looked up in them, so
+// it's dropped when one of those nodes is renamed, moved or removed, or a node with one of
+// those names shows up in them (see NodeManager::notifyPurge())
+class MEGA_API NodePathCache
+{
+public:
+    using Key = std::pair<NodeHandle, std::string>;     // starting node, path
+    using Lookup = std::pair<NodeHandle, std::string>;  // parent, normalized child name
+
+    explicit NodePathCache(size_t maxEntries = 10000);
+
+    // false if the path isn't cached. A path cached as not resolving gives an undef 'result'
+    bool get(const Key& key, NodeHandle& result);
+
+    void put(const Key& key, NodeHandle result, const std::vector<NodeHandle>& nodes, const std::vector<Lookup>& lookups);
+
+    // 'node', named 'name' in 'parent', has been added, renamed, moved or removed
+    void invalidate(NodeHandle node, NodeHandle parent, const std::string& name);
+
+    void clear();
+
+    size_t size() const { return mEntries.size(); }
+
+    // approximate memory held by the cache (for memory reports)
+    size_t approximateSize() const;
+
+private:
+    struct Entry
+    {
+        NodeHandle result;
+        std::vector<NodeHandle> nodes;
+        std::vector<Lookup> lookups;
+        std::list<Key>::iterator lru;
+    };
+
+    void erase(const Key& key);
+
+    size_t mMaxEntries;
+    std::map<Key, Entry> mEntries;
+    std::list<Key> mLru;    // most recently used first
+    std::map<NodeHandle, std::set<Key>> mByNode;
+    std::map<Lookup, std::set<Key>> mByLookup;
+};
+
 /**
  * @brief The NodeManager class
  *
@@ -281,6 +329,11 @@ public:
     // set interface to access to "nodes" table to nullptr, it's called just after sctable.reset()
     void reset();
 
+    // Lock on the client held by a caller off the client thread. Queries given one release it
+    // while they run on a read-only connection to the DB, if there's one available (see DBTableNodes::getReader())
+    // It must be held once (not recursively), since it's released and acquired again
+    using ClientLock = std::unique_lock<std::recursive_timed_mutex>;
+
     // Take node ownership
     bool addNode(Node* node, bool notify, bool isFetching = false);
     bool updateNode(Node* node);
@@ -298,15 +351,38 @@ public:
     // read children from type (folder or file) from DB and load them in memory
     node_vector getChildrenFromType(const Node *parent, nodetype_t type, CancelToken cancelToken);
 
+    // read a page of the children of 'parent', sorted and sliced by the DB, and load only those in memory.
+    // Returns false if the DB can't be trusted for it (node changes not written yet): sort in memory instead
+    bool getChildrenPage(const Node *parent, ChildrenOrder order, uint64_t offset, uint64_t limit, node_vector& children, CancelToken cancelToken);
+
     // get up to "maxcount" nodes, not older than "since", ordered by creation time
-    // Note: nodes are read from DB and loaded in memory
-    node_vector getRecentNodes(unsigned maxcount, m_time_t since);
+    // Note: nodes are read from DB and loaded in memory, unless the recent nodes kept from a previous call cover the query
+    node_vector getRecentNodes(unsigned maxcount, m_time_t since, ClientLock* unlockable = nullptr);
 
     // Search nodes containing 'searchString' in its name
     // Returned nodes are children of 'nodeHandle' (at any level)
     // If 'nodeHandle' is UNDEF, search includes the whole account
     // If a cancelFlag is passed, it must be kept alive until this method returns
-    node_vector search(NodeHandle nodeHandle, const char *searchString, CancelToken cancelFlag, bool recursive);
+    node_vector search(NodeHandle nodeHandle, const char *searchString, CancelToken cancelFlag, bool recursive, ClientLock* unlockable = nullptr);
+
+    // Like search(), but the nodes are passed to 'onPage' as they are loaded, up to 'pageSize' at a time.
+    // With 'unlockable', the lock is also released between pages, so a long search doesn't stall the client.
+    // If nodes are written meanwhile, the query runs again and the nodes already passed are skipped.
+    // Returns false if the search didn't complete (cancelled, or the table was reset)
+    using NodePage = std::function<void(const node_vector&)>;
+    bool searchPaged(NodeHandle nodeHandle, const char *searchString, CancelToken cancelFlag, bool recursive, size_t pageSize, const NodePage& onPage, ClientLock* unlockable = nullptr);
+
+    // Walk the subtree of 'root' (excluded) breadth-first, reading the children of up to 'prefetch' folders
+    // at a time from DB, in DB order, and passing each batch to 'onBatch'. Files the walk had to load are
+    // unloaded again after their batch, so memory doesn't grow with the size of the tree.
+    // With 'unlockable', the lock is released between batches ('onBatch' may release it too, while it
+    // works on copies of the nodes). Folders removed meanwhile are skipped.
+    // Returns false if 'onBatch' returned false, or the walk was cancelled or couldn't complete
+    using NodeBatch = std::function<bool(const node_vector&)>;
+    bool walkTree(NodeHandle root, size_t prefetch, CancelToken cancelFlag, const NodeBatch& onBatch, ClientLock* unlockable = nullptr);
+
+    // identifies the content of the nodes table: it changes when nodes are written or the table is replaced
+    std::pair<uint64_t, uint64_t> tableVersion() const;
 
     node_vector getInSharesWithName(const char *searchString, CancelToken cancelFlag);
     node_vector getOutSharesWithName(const char *searchString, CancelToken cancelFlag);
@@ -316,6 +392,10 @@ public:
     node_vector getNodesByOrigFingerprint(const std::string& fingerprint, Node *parent);
     Node *getNodeByFingerprint(FileFingerprint &fingerprint);
 
+    // Resolve many fingerprints against the DB in bulk, loading the matching nodes, so that
+    // later getNodeByFingerprint()/getNodesByFingerprint() calls for them are served from RAM
+    void preloadFingerprints(const std::vector<FileFingerprint>& fingerprints);
+
     // Return a first level child node whose name matches with 'name'
     // Valid values for nodeType: FILENODE, FOLDERNODE
     // Note: if not found among children loaded in RAM (and not all children are loaded), it will search in DB
@@ -331,7 +411,7 @@ public:
     node_vector getNodesWithPendingOutShares();
     node_vector getNodesWithLinks();
 
-    node_vector getNodesByMimeType(MimeType_t mimeType, NodeHandle ancestorHandle, CancelToken cancelFlag);
+    node_vector getNodesByMimeType(MimeType_t mimeType, NodeHandle ancestorHandle, CancelToken cancelFlag, ClientLock* unlockable = nullptr);
 
     std::vector<NodeHandle> getFavouritesNodeHandles(NodeHandle node, uint32_t count);
     size_t getNumberOfChildrenFromNode(NodeHandle parentHandle);
@@ -341,6 +421,7 @@ public:
     size_t getNumberOfChildrenByType(NodeHandle parentHandle, nodetype_t nodeType);
 
     // true if 'node' is a child node of 'ancestor', false otherwise.
+    // Answered from memory if the node is loaded (so are all its ancestors), from DB otherwise
     bool isAncestor(NodeHandle nodehandle, NodeHandle ancestor, CancelToken cancelFlag);
 
     // Clean 'changed' flag from all nodes
@@ -362,8 +443,39 @@ public:
     // process notified/changed nodes from 'mNodeNotify': dump changes to DB
     void notifyPurge();
 
+    // Remove 'root' and its subtree as a TreeProcDel would, without loading the subtree: the
+    // descendants are dropped from DB with one statement and from RAM in bulk, and only 'root' is
+    // notified as removed. Descendants in RAM that something else refers to (shares, links, syncs,
+    // transfers, pending notifications) are still notified and removed one by one.
+    // Returns false, doing nothing, if the subtree is small or the DB can't be trusted for it
+    bool removeSubtree(Node* root);
+
+    // smaller subtrees are removed node by node
+    static const size_t MIN_BULK_REMOVED_NODES = 1000;
+
+    // Remove all the versions in the cloud drive, once the API has removed them (CommandDelVersions):
+    // one query finds them and another removes them from DB, and their files are notified once, for
+    // their counters. Versions in RAM go node by node, as do those the action packets remove first
+    void removeVersions();
+
     size_t nodeNotifySize() const;
 
+    // while a batch is open, the counters of ancestors are still updated right away, but each
+    // ancestor is queued for notification once per batch rather than once per update
+    class CounterBatch
+    {
+    public:
+        explicit CounterBatch(NodeManager& nodeManager);
+        ~CounterBatch();
+
+    private:
+        NodeManager& mNodeManager;
+        bool mWasBatching;
+    };
+
+    // queue the ancestors whose counters changed during the current batch for notification
+    void flushCounterNotifications();
+
     // Returns if cache has been loaded
     bool hasCacheLoaded();
 
@@ -377,6 +489,9 @@ public:
     // return the counter for all root nodes (cloud+inbox+rubbish)
     NodeCounter getCounterOfRootNodes();
 
+    // counter of a node, read from the 'counter' column if the node isn't in memory (the node isn't loaded)
+    bool getCounterByHandle(NodeHandle handle, NodeCounter& counter);
+
     // update the counter of 'n' when its parent is updated (from 'oldParent' to 'n.parent')
     void updateCounter(Node &n, Node *oldParent);
 
@@ -396,12 +511,55 @@ public:
     // Node has received last updates and it's ready to store in DB
     void saveNodeInDb(Node *node);
 
+    // store many nodes in DB, serializing them on the worker threads
+    void saveNodesInDb(const node_vector& nodes);
+
+    // fewer nodes are not worth handing to the worker threads
+    static const size_t MIN_PARALLEL_SERIALIZED_NODES = 256;
+
     // write all nodes into DB (used for migration from legacy to NOD DB schema)
     void dumpNodes();
 
     // This method only can be used in Megacli for testing purposes
     uint64_t getNumberNodesInRam() const;
 
+    // Limit of nodes kept in RAM (0: no limit). Beyond it, evictNodes() unloads the nodes not used
+    // recently that can be loaded again from DB on demand
+    void setMaxNodesInRam(uint64_t maxNodes);
+
+    // Unload nodes down to the limit, CLOCK-wise: a node is skipped once after being looked up.
+    // Nodes are never evicted while pinned: root nodes, shares and links, nodes still encrypted or
+    // pending notification, synced or being transferred, and those with children in RAM.
+    // Only to be called when nobody holds a Node* (ie. between iterations of MegaClient::exec())
+    void evictNodes();
+
+    // Read the children of up to 'folders' subfolders of each folder listed by the app (the first ones
+    // in the listing that aren't loaded yet), on a worker thread through a read-only connection to the DB,
+    // so opening one of them next doesn't wait for the DB. 0 (default) disables it
+    void setChildrenPrefetch(unsigned folders);
+
+    // start a prefetch for the subfolders in 'listed', unless one is in progress
+    void prefetchChildren(const node_vector& listed);
+
+    // load the children read by a finished prefetch, if nothing was written to DB meanwhile and they fit
+    // in the limit of nodes in RAM. Only to be called between iterations of MegaClient::exec()
+    void applyChildrenPrefetch();
+
+    struct CacheStats
+    {
+        uint64_t hits = 0;      // lookups served by nodes in RAM
+        uint64_t misses = 0;    // nodes loaded from DB
+        uint64_t evictions = 0;
+    };
+    CacheStats getCacheStats(bool reset);
+
+    // add the approximate memory held by the nodes in RAM and the indexes over them.
+    // Big collections are sampled, so it's cheap enough to be polled
+    void addMemoryUsage(MemoryReport& report) const;
+
+    // resolutions of MegaClient::nodeByPath(), only valid while no node is pending notification
+    NodePathCache& pathCache() { return mPathCache; }
+
     // Add new relationship between parent and child
     void addChild(NodeHandle parent, NodeHandle child, Node *node);
     // remove relationship between parent and child
@@ -455,6 +613,35 @@ private:
     // interface to handle accesses to "nodes" table
     DBTableNodes* mTable = nullptr;
 
+    // incremented by setTable(), to tell apart the tables before and after an unlocked query
+    uint64_t mTableGeneration = 0;
+
+    // see setMaxNodesInRam(), evictNodes()
+    uint64_t mMaxNodesInRam = 0;
+    CacheStats mCacheStats;
+    // next node to be visited by evictNodes()
+    NodeHandle mEvictionHand;
+
+    // handles of nodes referenced by transfers (which may keep a Node*) or direct reads
+    std::set<NodeHandle> getPinnedNodes() const;
+    bool isEvictable(const Node& node, const std::set<NodeHandle>& pinned) const;
+    void evictNode(NodeManagerNodes::iterator position);
+
+    // nodes visited by a call to evictNodes(), at most
+    static const size_t MAX_EVICTION_STEPS = 10000;
+
+    // see setChildrenPrefetch(): the children read by the worker, by folder, and the state of the
+    // table they were read from
+    unsigned mChildrenPrefetchFolders = 0;
+    struct ChildrenPrefetch
+    {
+        std::atomic<bool> done{false};
+        uint64_t tableGeneration = 0;
+        uint64_t nodesWrites = 0;
+        std::vector<std::pair<NodeHandle, std::vector<std::pair<NodeHandle, NodeSerialized>>>> children;
+    };
+    std::shared_ptr<ChildrenPrefetch> mChildrenPrefetch;
+
     // root nodes (files, vault, rubbish)
     struct Rootnodes
     {
@@ -472,6 +659,7 @@ private:
     public:
         bool allFingerprintsAreLoaded(const FileFingerprint *fingerprint) const;
         void setAllFingerprintLoaded(const FileFingerprint *fingerprint);
+        void unsetAllFingerprintLoaded(const FileFingerprint *fingerprint);
         void clear();
 
     private:
@@ -480,17 +668,65 @@ private:
         std::set<FileFingerprint, FileFingerprintCmp> mAllFingerprintsLoaded;
     };
 
+    // Bloom filter over the serialized fingerprints of every node in the account,
+    // so lookups of fingerprints that don't exist (most of the upload dedup checks)
+    // are answered without querying the DB. It never yields false negatives while valid.
+    class FingerprintFilter
+    {
+    public:
+        // size the filter for 'expectedEntries' and clear it (leaves it valid)
+        void reset(uint64_t expectedEntries);
+        void invalidate();
+        bool isValid() const { return mValid; }
+
+        void add(const std::string& fingerprint);
+        bool mayContain(const std::string& fingerprint) const;
+
+        size_t sizeInBytes() const { return mBits.capacity() * sizeof(uint64_t); }
+
+    private:
+        static const unsigned BITS_PER_ENTRY = 10;
+        static const unsigned NUM_HASHES = 7;
+
+        std::vector<uint64_t> mBits;
+        bool mValid = false;
+    };
+
+    FingerprintFilter mFingerprintFilter;
+
+    // (re)build mFingerprintFilter from the fingerprints stored in DB
+    void rebuildFingerprintFilter();
+
+    // false if the filter proves no node in DB has the (serialized) fingerprint, so the query can be skipped
+    bool fingerprintMayBeInDb(const std::string& fingerprint) const;
+
     // Stores nodes that have been loaded in RAM from DB (not necessarily all of them)
-    std::map<NodeHandle, NodeManagerNode> mNodes;
+    NodeManagerNodes mNodes;
 
     uint64_t mNodesInRam = 0;
 
     // nodes that have changed and are pending to notify to app and dump to DB
     node_vector mNodeNotify;
 
+    // set by CounterBatch, and ancestors with changed counters not queued in 'mNodeNotify' yet
+    bool mBatchingCounters = false;
+    node_vector mCounterNotify;
+
     // holds references to unknown parent nodes until those are received (delayed-parents: dp)
     std::map<NodeHandle,  set<Node*>> mNodesWithMissingParent;
 
+    NodePathCache mPathCache;
+
+    // recent file nodes (see getRecentNodes()), newest first: all of them from mRecentNodesFrom on.
+    // Kept from the last query made to the DB and updated as nodes are notified
+    std::set<std::pair<m_time_t, NodeHandle>, std::greater<std::pair<m_time_t, NodeHandle>>> mRecentNodes;
+    m_time_t mRecentNodesFrom = std::numeric_limits<m_time_t>::max();
+    static const size_t MAX_RECENT_NODES = 10000;
+    bool getRecentNodesInMemory(unsigned maxcount, m_time_t since, node_vector& nodes);
+    void updateRecentNodes(Node* n);
+    void setRecentNodesFrom(m_time_t from);
+    void clearRecentNodes();
+
     Node* getNodeInRAM(NodeHandle handle);
     void saveNodeInRAM(Node* node, bool isRootnode);    // takes ownership
     node_vector getNodesWithSharesOrLink(ShareType_t shareType);
@@ -529,6 +765,22 @@ private:
     // If a valid object is passed, it must be kept alive until this method returns.
     node_vector processUnserializedNodes(const std::vector<std::pair<NodeHandle, NodeSerialized>>& nodesFromTable, NodeHandle ancestorHandle = NodeHandle(), CancelToken cancelFlag = CancelToken());
 
+    // Run 'query' and process its results. With 'unlockable', it runs on a reader with the lock released,
+    // if possible. The reader sees the DB as last committed, so its results are only processed if no node
+    // has been written since (otherwise they could miss nodes or bring back removed ones): the query
+    // runs again on mTable then. Returns no nodes if the table was reset meanwhile (ie. logout)
+    using TableQuery = std::function<bool(DBTableNodes&, std::vector<std::pair<NodeHandle, NodeSerialized>>&)>;
+    node_vector getNodesFromTable(const TableQuery& query, ClientLock* unlockable, CancelToken cancelFlag);
+
+    // the query part of getNodesFromTable(). Returns false if the table was reset meanwhile, or cancelled
+    bool queryTable(const TableQuery& query, ClientLock* unlockable, CancelToken cancelFlag, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodesFromTable);
+
+    // query of search() and searchPaged()
+    static TableQuery searchQuery(NodeHandle nodeHandle, const std::string& name, CancelToken cancelFlag, bool recursive);
+
+    // parent handle stored in a serialized node, without unserializing it (see unserializeNode())
+    static NodeHandle parentHandleOf(const NodeSerialized& nodeSerialized);
+
     // node temporary in memory, which will be removed upon write to DB
     unique_ptr<Node> mNodeToWriteInDb;
 
@@ -641,6 +893,7 @@ public:
     void login(const char*, const byte*, const char* = NULL);
 
     // user login: e-mail, password, salt
+    // (the key derivation runs on KeyDerivationService, the login command is sent once it completes)
     void login2(const char*, const char*, string *, const char* = NULL);
 
     // user login: e-mail, derivedkey, 2FA pin
@@ -772,6 +1025,13 @@ public:
     // update node attributes
     error setattr(Node*, attr_map&& updates, CommandSetAttr::Completion&& c, bool canChangeVault);
 
+    // the outcome of each node of a bulk operation
+    using BulkCompletion = std::function<void(vector<pair<NodeHandle, Error>>&&)>;
+
+    // update the attributes of many nodes: the commands are queued together, and 'c' is called
+    // once, when the last of them completes, with the result of every node (local failures too)
+    void setattrs(vector<pair<Node*, attr_map>>&& updates, bool canChangeVault, BulkCompletion&& c);
+
     // prefix and encrypt attribute json
     static void makeattr(SymmCipher*, string*, const char*, int = -1);
 
@@ -795,6 +1055,9 @@ public:
     // move node to new parent folder
     error rename(Node*, Node*, syncdel_t, NodeHandle prevparenthandle, const char *newName, bool canChangeVault, CommandMoveNode::Completion&& c);
 
+    // move many nodes to the same parent folder, completing as setattrs() does
+    void renames(const vector<Node*>& nodes, Node* p, bool canChangeVault, BulkCompletion&& c);
+
     // Queue commands (if needed) to remvoe any outshares (or pending outshares) below the specified node
     void removeOutSharesFromSubtree(Node* n, int tag);
 
@@ -816,8 +1079,9 @@ public:
     void setBlocked(bool value);
 
     // enqueue/abort direct read
-    void pread(Node*, m_off_t, m_off_t, void*);
-    void pread(handle, SymmCipher* key, int64_t, m_off_t, m_off_t, void*, bool = false,  const char* = NULL, const char* = NULL, const char* = NULL);
+    // a sequential read gets the whole read-ahead window from the start (see DirectReadNode::sequentialreadahead)
+    void pread(Node*, m_off_t, m_off_t, void*, bool sequential = false);
+    void pread(handle, SymmCipher* key, int64_t, m_off_t, m_off_t, void*, bool = false,  const char* = NULL, const char* = NULL, const char* = NULL, bool sequential = false);
     void preadabort(Node*, m_off_t = -1, m_off_t = -1);
     void preadabort(handle, m_off_t = -1, m_off_t = -1);
 
@@ -826,9 +1090,66 @@ public:
 
     MegaClientAsyncQueue mAsyncQueue;
 
+    // password derivations handed to KeyDerivationService, completed in order from exec()
+    struct PendingKeyDerivation
+    {
+        KeyDerivationService::RequestPtr request;
+        std::function<void(const string& derivedKey)> completion;
+    };
+    std::deque<PendingKeyDerivation> mPendingKeyDerivations;
+
+#ifdef USE_MEDIAINFO
+    // media property extractions handed to MediaExtractionService, completed from exec() as they finish
+    struct PendingMediaExtraction
+    {
+        MediaExtractionService::RequestPtr request;
+        std::function<void(MediaProperties& vp)> completion;
+    };
+    std::deque<PendingMediaExtraction> mPendingMediaExtractions;
+#endif
+
+    // upload completions waiting to be sent together, one entry per target/versioning/vault combination
+    struct PutnodesBatch
+    {
+        NodeHandle target;
+        VersioningOption vo;
+        bool canChangeVault;
+        dstime startedDs = 0;
+        vector<NewNode> nodes;
+        vector<CommandPutNodes::BatchedCompletion> completions;
+    };
+    vector<PutnodesBatch> mPutnodesBatches;
+    void sendPutnodesBatch(PutnodesBatch&);
+    void deriveKeyAsync(const string& password, const string& salt, unsigned iterations, size_t keyLength,
+                        std::function<void(const string& derivedKey)> completion);
+    void checkKeyDerivations();
+    void cancelKeyDerivations();
+
+#ifdef USE_MEDIAINFO
+    void extractMediaPropertiesAsync(const LocalPath& localPath, std::unique_ptr<FileAccess> fileAccess, bool verified,
+                                     std::function<void(MediaProperties& vp)> completion);
+    void checkMediaExtractions();
+    void cancelMediaExtractions();
+#endif
+
     // number of parallel connections per transfer (PUT/GET)
     unsigned char connections[2];
 
+    // let non-raid transfers vary their connection count (starting from connections[]) on measured throughput
+    bool autoconnections[2] = { false, false };
+
+    // total connections all transfer slots may use, for the slots in auto mode to share out
+    unsigned connectionbudget = 24;
+
+    // serve downloads from a local file with the same fingerprint, when one is known
+    bool localdownloaddedup = false;
+
+    // local files by fingerprint, fed by completed downloads and sync scans (when localdownloaddedup)
+    LocalFingerprintIndex localFingerprints;
+
+    // start filling a fresh download's temp file from a known local copy of its content, if any, on a worker thread
+    void startDownloadFromLocalCopy(Transfer*);
+
     // helpfer function for preparing a putnodes call for new node
     error putnodes_prepareOneFile(NewNode* newnode, Node* parentNode, const char *utf8Name, const UploadToken& binaryUploadToken,
                                   byte *theFileKey, char *megafingerprint, const char *fingerprintOriginal,
@@ -848,12 +1169,33 @@ public:
     // send files/folders to user
     void putnodes(const char*, vector<NewNode>&&, int tag, CommandPutNodes::Completion&& completion = nullptr);
 
+    // complete an upload, coalescing with other completed uploads to the same target into one putnodes
+    void putnodesBatched(NodeHandle, VersioningOption vo, vector<NewNode>&&, int tag, bool canChangeVault, CommandPutNodes::Completion&& completion = nullptr);
+
+    // send the putnodes gathered by putnodesBatched(): all of them if a cs request is going out
+    // anyway, otherwise those that have waited PUTNODES_BATCH_WINDOW_DS for more completions
+    void flushPutnodesBatches();
+
+    // when the oldest putnodes batch is due, or NEVER
+    dstime nextPutnodesBatchDs() const;
+
+    // max nodes coalesced into a single putnodes
+    static const size_t MAXPUTNODESBATCH;
+    static const dstime PUTNODES_BATCH_WINDOW_DS = 2;
+
     // attach file attribute to upload or node handle
     void putfa(NodeOrUploadHandle, fatype, SymmCipher*, int tag, std::unique_ptr<string>);
 
     // queue file attribute retrieval
     error getfa(handle h, string *fileattrstring, const string &nodekey, fatype, int = 0);
 
+    // cancel the retrieval of the attributes of type 't' of the nodes not in 'keep' (ie. those
+    // scrolled out of view), and return the nodes cancelled
+    void cancelgetfaexcept(fatype t, const std::set<handle>& keep, std::vector<handle>& cancelled);
+
+    // handle of the attribute of type 't' and its storage cluster
+    static bool fileattributehandle(const string *fileattrstring, fatype t, handle* fah, int* cluster);
+
     // notify delayed upload completion subsystem about new file attribute
     void checkfacompletion(UploadHandle, Transfer* = NULL, bool uploadCompleted = false);
 
@@ -867,6 +1209,11 @@ public:
     // queue a user attribute retrieval
     void getua(User* u, const attr_t at = ATTR_UNKNOWN, int ctag = -1);
 
+    // getua() retrievals in flight, by user and attribute, with the tags of the requests
+    // coalesced into them, which receive the same result
+    std::map<pair<string, attr_t>, vector<int>> mPendingGetUA;
+    void replyPendingGetUA(const pair<string, attr_t>& key, std::function<void()> reply);
+
     // queue a user attribute retrieval (for non-contacts)
     void getua(const char* email_handle, const attr_t at = ATTR_UNKNOWN, const char *ph = NULL, int ctag = -1);
 
@@ -1206,6 +1553,9 @@ public:
     // set max upload speed
     bool setmaxuploadspeed(m_off_t bpslimit);
 
+    // share connections between concurrent requests to the same host (HTTP/2)
+    bool setmultiplexing(bool enable);
+
     // get max download speed
     m_off_t getmaxdownloadspeed();
 
@@ -1239,6 +1589,13 @@ public:
     // finish downloaded chunks in order
     bool orderdownloadedchunks;
 
+    // how transfer request sizes are chosen (RequestSizeController::POLICY_STATIC by default)
+    RequestSizeController::Policy requestSizePolicy = RequestSizeController::POLICY_STATIC;
+
+    // encrypt large uploads from local filesystems straight from a file mapping (FileAccess::fmap())
+    // rather than from a read copy. Off by default: a source truncated while mapped faults the process.
+    bool mapuploadsources = false;
+
     // retry API_ESSL errors
     bool retryessl;
 
@@ -1306,6 +1663,9 @@ public:
     // root URL for Website
     static const string MEGAURL;
 
+    // start of a fetchnodes response, up to its first node
+    static const string FETCHNODES_PREFIX;
+
     // newsignup link URL prefix
     static const char* newsignupLinkPrefix();
 
@@ -1525,7 +1885,7 @@ public:
     bool isprivatehandle(handle*);
 
     // add direct read
-    void queueread(handle, bool, SymmCipher*, int64_t, m_off_t, m_off_t, void*, const char* = NULL, const char* = NULL, const char* = NULL);
+    void queueread(handle, bool, SymmCipher*, int64_t, m_off_t, m_off_t, void*, const char* = NULL, const char* = NULL, const char* = NULL, bool sequential = false);
 
     // execute pending direct reads
     bool execdirectreads();
@@ -1574,6 +1934,24 @@ public:
     // there is data to commit to the database when possible
     bool pendingsccommit;
 
+    // size and hash of the serialization last stored for the user, pcr and chat records of the
+    // statecache, by dbid, so that updatesc() skips the ones notified without a persisted change
+    std::unordered_map<uint32_t, std::pair<size_t, size_t>> mScStoredRecords;
+
+    // Group commits of the statecache: the commit for a new scsn can wait until the first one
+    // waiting is mScCommitMaxLagDs old or mScCommitMaxPending scsn are waiting, so one commit
+    // covers several batches of action packets. The DB still only commits at a complete scsn,
+    // so a crash loses the last batches (fetched again from the server), never consistency.
+    // A lag of 0 (the default) commits every scsn, as before
+    dstime mScCommitMaxLagDs = 0;
+    unsigned mScCommitMaxPending = 0;
+    void setScCommitGrouping(dstime maxLagDs, unsigned maxPending);
+
+    // when the statecache DB is next optimized (see DbTable::optimize()), once the client is idle
+    dstime mNextDbOptimizeDs = 0;
+    static const dstime DB_OPTIMIZE_DELAY_DS = 600;  // after login
+    static const dstime DB_OPTIMIZE_INTERVAL_DS = 36000;
+
     // transfer cache table
     unique_ptr<DbTable> tctable;
 
@@ -1591,9 +1969,24 @@ public:
     bool fetchingnodes;
     int fetchnodestag;
 
+    // delimits the nodes of a fetchnodes response while it downloads, so they are loaded as they arrive
+    unique_ptr<JSONArrayScanner> mFetchNodesScanner;
+
+    // the previous state was purged and nodes were loaded before the fetchnodes response completed
+    bool mFetchNodesStreamed = false;
+
+    // a streamed fetchnodes failed to parse: the retry parses the complete response instead
+    bool mFetchNodesStreamFailed = false;
+
+    // load the nodes received so far, dropping their input; false on a parse error
+    bool readfetchnodesstream();
+
     // have we just completed fetching new nodes?  (ie, caught up on all the historic actionpackets since the fetchnodes)
     bool statecurrent;
 
+    // action packets applied per exec() iteration while catching up (!statecurrent)
+    static const size_t MAX_CATCHUP_PACKETS_PER_EXEC = 1000;
+
     // File Attribute upload system.  These can come from:
     //  - upload transfers
     //  - app requests to attach a thumbnail/preview to a node
@@ -1611,6 +2004,30 @@ public:
     // ourselves in cases where many clients get 500s for a while and then recover at the same time
     bool pendingcs_serverBusySent = false;
 
+    // the cs requests carrying the parallel batches of independent commands, one per reqs.parallel(i)
+    struct ParallelCs
+    {
+        explicit ParallelCs(PrnGen& rng) : bt(rng) { }
+
+        unique_ptr<HttpReq> req;
+        BackoffTimer bt;
+
+        // kept across retries, so the server can tell a repeated batch
+        string id;
+
+        // the app was told this lane is retrying
+        bool retrying = false;
+    };
+    vector<unique_ptr<ParallelCs>> parallelcs;
+
+    // send, retry and process the parallel cs requests
+    void execparallelcs();
+    bool parallelcsready() const;
+    bool parallelcsinflight() const;
+
+    // the URL of a cs request with the given request id
+    string csurl(const char* id, size_t idlen, bool suppressSID);
+
     // pending HTTP requests
     pendinghttp_map pendinghttp;
 
@@ -1635,6 +2052,20 @@ public:
     void updatesc();
     void finalizesc(bool);
 
+    // put a user, pcr or chat in the statecache, unless it serializes as it was stored last
+    // (then 'unchanged' is incremented). delsc() removes one
+    bool putsc(uint32_t type, Cacheable* record, size_t& unchanged);
+    bool delsc(uint32_t dbid);
+    void notescrecord(uint32_t dbid, const string& data);
+
+    // commit the statecache at a complete scsn and start the next transaction
+    void commitsc();
+
+    // true if the commit for the scsn just received is left to a later, grouped one
+    bool deferScCommit();
+    unsigned mScCommitsDeferred = 0;
+    dstime mScCommitDeferredSince = 0;
+
     // truncates status table
     void initStatusTable();
 
@@ -1717,6 +2148,13 @@ public:
     vector<string> cachedfiles;
     vector<uint32_t> cachedfilesdbids;
 
+    // cached files are resumed up to RESUME_FILES_BATCH per loop iteration, so a long queue
+    // doesn't hold up startup: the ones before cachedfilesresumed are done
+    static const size_t RESUME_FILES_BATCH = 1000;
+    size_t cachedfilesresumed = 0;
+    bool cachedfilespending() const;
+    void resumecachedfiles(size_t max);
+
     // database IDs of cached files and transfers
     // waiting for the completion of a putnodes
     pendingdbid_map pendingtcids;
@@ -1771,6 +2209,9 @@ public:
     // update transfer in the persistent cache
     void transfercacheadd(Transfer*, TransferDbCommitter*);
 
+    // add transfer to the cache if its progress was not written for a while
+    void transfercacheprogress(Transfer*, TransferDbCommitter*);
+
     // remove a transfer from the persistent cache
     void transfercachedel(Transfer*, TransferDbCommitter* committer);
 
@@ -1808,7 +2249,7 @@ public:
 #endif /* ENABLE_SYNC */
 
     // get a vector of recent actions in the account
-    recentactions_vector getRecentActions(unsigned maxcount, m_time_t since);
+    recentactions_vector getRecentActions(unsigned maxcount, m_time_t since, NodeManager::ClientLock* unlockable = nullptr);
 
     // determine if the file is a video, photo, or media (video or photo).  If the extension (with trailing .) is not precalculated, pass null
     bool nodeIsMedia(const Node*, bool *isphoto, bool *isvideo) const;
@@ -1854,8 +2295,18 @@ public:
     // scan required flag
     bool syncdownrequired;
 
+    // remote changes flagged on their LocalNodes: syncdown() only the marked paths
+    bool syncdownpartial = false;
+
+    // even partial syncdowns walk the whole tree when this is reached, as a consistency check
+    dstime mNextSyncdownFullWalkDs = 0;
+    static const dstime SYNCDOWN_FULL_WALK_INTERVAL_DS = 3000;
+
     bool syncuprequired;
 
+    // Sync::cachenodes() left records for later to keep its passes short: don't wait
+    bool syncstatecachepending = false;
+
     // block local fs updates processing while locked ops are in progress
     bool syncfsopsfailed;
 
@@ -1934,7 +2385,10 @@ public:
 
     // start downloading/copy missing files, create missing directories
     bool syncdown(LocalNode*, LocalPath&, SyncdownContext& cxt);
-    bool syncdown(LocalNode*, LocalPath&);
+    bool syncdown(LocalNode*, LocalPath&, bool fullWalk = true);
+
+    // flag the LocalNodes whose remote children are affected by a change of this node
+    void setsyncdownpending(Node*);
 
     // move nodes to //bin/SyncDebris/yyyy-mm-dd/ or unlink directly
     void movetosyncdebris(Node*, bool unlink, bool canChangeVault);
@@ -1992,7 +2446,42 @@ public:
 #endif
 
     // process object arrays by the API server
-    int readnodes(JSON*, int, putsource_t, vector<NewNode>*, bool modifiedByThisClient, bool applykeys);
+    // finishBatch: false if more nodes of the same list follow (skips share merging and orphan checks)
+    int readnodes(JSON*, int, putsource_t, vector<NewNode>*, bool modifiedByThisClient, bool applykeys, bool finishBatch = true);
+
+    // the key and attributes of one node of a fetchnodes response, decrypted on a worker thread
+    struct PredecryptedNode
+    {
+        handle h = UNDEF;
+        bool decrypted = false;
+        string key;
+        AttrMap attrs;
+    };
+
+    // decrypt the nodes of the array at 'j' that are keyed to our own user, spreading them over
+    // the worker threads; 'nodes' gets an entry per element, in order, or none if not worthwhile
+    void predecryptnodes(const JSON& j, vector<PredecryptedNode>& nodes);
+    static void predecryptnode(const char* object, handle me, SymmCipher& masterKey, SymmCipher& nodeCipher, PredecryptedNode& node);
+
+    // fewer nodes are not worth handing to the worker threads
+    static const size_t MIN_PREDECRYPTED_NODES = 256;
+
+    // decrypt a symmetric node key with 'keyCipher', then the node's attributes with that key
+    static bool decryptnode(const char* k, nodetype_t t, const string& attrString, SymmCipher& keyCipher, SymmCipher& nodeCipher, PredecryptedNode& node);
+
+    // RSA-decrypt the share keys and our own node keys of the array at 'j' on the worker threads,
+    // so that decryptkey() finds them in mPredecryptedRsaKeys instead of decrypting them one by one
+    void predecryptrsakeys(const JSON& j);
+    static void collectrsakeys(const char* object, handle me, vector<string>& keys);
+
+    // fewer RSA keys than this are decrypted by decryptkey() as they are found
+    static const size_t MIN_PREDECRYPTED_RSA_KEYS = 2;
+
+    // base64 RSA-encrypted key -> its first FILENODEKEYLENGTH decrypted bytes
+    std::map<string, string> mPredecryptedRsaKeys;
+
+    // split [0, count) into one share per worker thread plus one for this thread, and wait for all of them
+    void parallelfor(size_t count, const std::function<void(size_t begin, size_t end, SymmCipher&)>& work);
 
     void readok(JSON*);
     void readokelement(JSON*);
@@ -2106,8 +2595,13 @@ public:
     // apply keys
     void applykeys();
 
-    // send andy key rewrites prepared when keys were applied
+    // Node::applykey() on each node, with the decryption spread over the worker threads when there are many
+    void applynodekeys(const vector<Node*>& nodes);
+
+    // send andy key rewrites prepared when keys were applied, coalesced (each node once)
+    // and split into commands of at most MAX_KEY_REWRITES_PER_COMMAND nodes
     void sendkeyrewrites();
+    static const size_t MAX_KEY_REWRITES_PER_COMMAND = 10000;
 
     // symmetric password challenge
     int checktsid(byte* sidbuf, unsigned len);
@@ -2128,8 +2622,8 @@ public:
     void queuepubkeyreq(User*, std::unique_ptr<PubKeyAction>);
     void queuepubkeyreq(const char*, std::unique_ptr<PubKeyAction>);
 
-    // rewrite foreign keys of the node (tree)
-    void rewriteforeignkeys(Node* n);
+    // rewrite foreign keys of the node (tree); !send: only queue them for sendkeyrewrites()
+    void rewriteforeignkeys(Node* n, bool send = true);
 
     // simple string hash
     static void stringhash(const char*, byte*, SymmCipher*);
@@ -2275,27 +2769,40 @@ public:
     // Keep track of high level operation counts and times, for performance analysis
     struct PerformanceStats
     {
-        CodeCounter::ScopeStats execFunction = { "MegaClient_exec" };
-        CodeCounter::ScopeStats transferslotDoio = { "TransferSlot_doio" };
+        // these also feed Metrics; the ones run on every loop of the client thread are sampled
+        CodeCounter::ScopeStats execFunction = { "MegaClient_exec", 16 };
+        CodeCounter::ScopeStats transferslotDoio = { "TransferSlot_doio", 16 };
         CodeCounter::ScopeStats execdirectreads = { "execdirectreads" };
         CodeCounter::ScopeStats transferComplete = { "transfer_complete" };
         CodeCounter::ScopeStats megaapiSendPendingTransfers = { "megaapi_sendtransfers" };
-        CodeCounter::ScopeStats prepareWait = { "MegaClient_prepareWait" };
-        CodeCounter::ScopeStats doWait = { "MegaClient_doWait" };
-        CodeCounter::ScopeStats checkEvents = { "MegaClient_checkEvents" };
+        CodeCounter::ScopeStats prepareWait = { "MegaClient_prepareWait", 16 };
+        CodeCounter::ScopeStats doWait = { "MegaClient_doWait", 16 };
+        CodeCounter::ScopeStats checkEvents = { "MegaClient_checkEvents", 16 };
         CodeCounter::ScopeStats applyKeys = { "MegaClient_applyKeys" };
         CodeCounter::ScopeStats dispatchTransfers = { "dispatchTransfers" };
         CodeCounter::ScopeStats csResponseProcessingTime = { "cs batch response processing" };
         CodeCounter::ScopeStats csSuccessProcessingTime = { "cs batch received processing" };
         CodeCounter::ScopeStats scProcessingTime = { "sc processing" };
+        CodeCounter::ScopeStats readNodes = { "MegaClient_readnodes" };
+        CodeCounter::ScopeStats predecryptNodes = { "MegaClient_predecryptnodes" };
+        CodeCounter::ScopeStats saveNodeInDb = { "NodeManager_saveNodeInDb", 16 };
+        CodeCounter::ScopeStats saveNodesInDb = { "NodeManager_saveNodesInDb" };
+        CodeCounter::ScopeStats nodeCounters = { "NodeManager_initCounters" };
+        CodeCounter::ScopeStats createIndexes = { "NodeManager_createIndexes" };
         uint64_t transferStarts = 0, transferFinishes = 0;
         uint64_t transferTempErrors = 0, transferFails = 0;
         uint64_t prepwaitImmediate = 0, prepwaitZero = 0, prepwaitHttpio = 0, prepwaitFsaccess = 0, nonzeroWait = 0;
         CodeCounter::DurationSum csRequestWaitTime;
         CodeCounter::DurationSum transfersActiveTime;
-        std::string report(bool reset, HttpIO* httpio, Waiter* waiter, const RequestDispatcher& reqs);
+        std::string report(bool reset, HttpIO* httpio, Waiter* waiter, RequestDispatcher& reqs, MegaClientAsyncQueue& asyncQueue, NodeManager& nodeManager);
     } performanceStats;
 
+    // per-iteration breakdown of the client loop, see MegaApi::setSlowLoopThreshold
+    ExecLoopProfiler loopProfiler;
+
+    // approximate memory held by the nodes, syncs, transfers, requests and alerts of the client
+    void addMemoryUsage(MemoryReport& report);
+
     std::string getDeviceidHash();
 
     /**
@@ -2368,6 +2875,13 @@ public:
     // generate "aer" command
     void removeSetElement(handle sid, handle eid, std::function<void(Error)> completion);
 
+    // generate "aepb" command, creating new Elements of the same Set; completion receives the Elements
+    // created and the error of each requested Element
+    void putSetElements(vector<SetElement>&& els, std::function<void(Error, const vector<const SetElement*>*, const vector<int64_t>*)> completion);
+
+    // generate "aerb" command; completion receives the error of each requested Element
+    void removeSetElements(handle sid, vector<handle>&& eids, std::function<void(Error, const vector<int64_t>*)> completion);
+
     // handle "aesp" parameter, part of 'f'/ "fetch nodes" response
     bool procaesp();
 
@@ -2398,6 +2912,9 @@ public:
     // return all available Elements in a Set, indexed by eid
     const map<handle, SetElement>* getSetElements(handle sid) const;
 
+    // return up to `count` Elements of Set sid, skipping the first `offset`, sorted by order (then by id)
+    vector<const SetElement*> getSetElements(handle sid, size_t offset, size_t count) const;
+
     // add new SetElement or replace exisiting one
     const SetElement* addOrUpdateSetElement(SetElement&& el);
 
@@ -30,6 +30,7 @@
 namespace mega {
 
 typedef map<LocalPath, LocalNode*> localnode_map;
+typedef std::unordered_multimap<size_t, LocalNode*> localnode_hashindex;
 typedef map<const string*, Node*, StringCmp> remotenode_map;
 
 struct MEGA_API NodeCore
@@ -118,8 +119,12 @@ public:
     std::unique_ptr<Node> mNode;
     std::unique_ptr<std::map<NodeHandle, Node*>> mChildren;
     bool mAllChildrenHandleLoaded = false;
+    // set when the node is looked up, cleared as the eviction hand passes by (see NodeManager::evictNodes())
+    bool mReferenced = true;
 };
-typedef std::map<NodeHandle, NodeManagerNode>::iterator NodePosition;
+typedef std::unordered_map<NodeHandle, NodeManagerNode, NodeHandleHash> NodeManagerNodes;
+// Rehashing invalidates the iterators of NodeManagerNodes, not the addresses of its elements
+typedef NodeManagerNodes::value_type* NodePosition;
 
 // filesystem node
 struct MEGA_API Node : public NodeCore, FileFingerprint
@@ -150,6 +155,10 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
     // try to resolve node key string
     bool applykey();
 
+    // the subkey of the node key string that can be decrypted now, and the cipher for it
+    // (null if none is available yet)
+    const char* selectkey(SymmCipher*& sc);
+
     // set up nodekey in a static SymmCipher
     SymmCipher* nodecipher();
 
@@ -195,6 +204,10 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
     // decrypt node attribute string
     static byte* decryptattr(SymmCipher*, const char*, size_t);
 
+    // same, but decrypts into the caller's reusable buffer instead of allocating;
+    // the result points into arena and is valid until arena is next modified
+    static byte* decryptattr(SymmCipher*, const char*, size_t, string& arena);
+
     // parse node attributes from an incoming buffer, this function must be called after call decryptattr
     static void parseattr(byte*, AttrMap&, m_off_t, m_time_t&, string&, string&, FileFingerprint&);
 
@@ -246,6 +259,9 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
 
     void setkeyfromjson(const char*);
 
+    // install a node key and attributes decrypted ahead of time (see MegaClient::predecryptnodes())
+    void setdecryptedkey(string& decryptedKey, AttrMap& decryptedAttrs);
+
     void setUndecryptedKey(const std::string &undecryptedKey);
 
     void setfingerprint();
@@ -261,10 +277,10 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
     // own position in NodeManager::mFingerPrints (only valid for file nodes)
     // It's used for speeding up node removing at NodeManager::removeFingerprint
     FingerprintPosition mFingerPrintPosition;
-    // own position in NodeManager::mNodes. The map can have an element of type NodeManagerNode
+    // own element in NodeManager::mNodes. The map can have an element of type NodeManagerNode
     // previously Node exists
     // It's used for speeding up get children when Node parent is known
-    NodePosition mNodePosition;
+    NodePosition mNodePosition = nullptr;
 
 #ifdef ENABLE_SYNC
     // related synced item or NULL
@@ -295,6 +311,49 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
 
     bool serialize(string*) override;
 
+    // Compact blob, as stored in the nodes table: a marker that no legacy blob (serialize()) starts with,
+    // a directory of (field, length) pairs, then the fields. Numbers are stored with Serialize64 and
+    // absent fields take no space, and any field can be read without decoding the rest (blobField())
+    bool serializeCompact(string*);
+
+    enum BlobField : uint8_t
+    {
+        BLOB_TYPE,
+        BLOB_SIZE,
+        BLOB_HANDLE,
+        BLOB_PARENT,
+        BLOB_OWNER,
+        BLOB_CTIME,
+        BLOB_KEY,
+        BLOB_FILEATTRS,
+        BLOB_SHARES,    // as in legacy blobs: number of shares, share key and shares
+        BLOB_ATTRS,
+        BLOB_LINK,      // auth key length and data, then as in legacy blobs
+        BLOB_ENCRYPTED, // as in legacy blobs: node key and attribute string, while undecrypted
+        BLOB_FIELDS
+    };
+
+    // data and length of each field of a compact blob, indexed by BlobField (null data if absent)
+    typedef std::pair<const char*, size_t> BlobSpan;
+    typedef std::array<BlobSpan, BLOB_FIELDS> BlobSpans;
+
+    // first bytes of a compact blob: legacy ones start with the size, or -type
+    static const m_off_t COMPACT_BLOB_MARKER;
+
+    static bool isCompactBlob(const string& blob);
+
+    // locate all the fields of a compact blob with one pass over its directory
+    static bool blobFields(const string& blob, BlobSpans& fields);
+
+    // locate 'field' in a compact blob: false if it's absent, the blob is malformed or it's a legacy one
+    static bool blobField(const string& blob, BlobField field, const char*& data, size_t& length);
+
+    // read a number field of a compact blob
+    static bool blobNumber(const string& blob, BlobField field, uint64_t& value);
+
+    // name and size (-type, for folders) of the node in a compact blob, decoding only those fields
+    static bool blobNameAndSize(const string& blob, string& name, m_off_t& size);
+
     Node(MegaClient&, NodeHandle, NodeHandle, nodetype_t, m_off_t, handle, const char*, m_time_t);
     ~Node();
 
@@ -313,6 +372,9 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
 
     static uint64_t getDBFlag(uint64_t oldFlags, bool isInRubbish, bool isVersion);
 
+    // approximate memory held by the node (for memory reports)
+    size_t approximateSize() const;
+
 private:
     // full folder/file key, symmetrically or asymmetrically encrypted
     // node crypto keys (raw or cooked -
@@ -330,6 +392,13 @@ private:
 
     static nameid getExtensionNameId(const std::string& ext);
 
+    // validity checks (and a last decryption attempt) before serializing
+    bool serializable();
+
+    void serializeShares(string* d) const;
+    void serializeLink(string* d) const;
+    void serializeEncrypted(string* d) const;
+
  public:
     enum
     {
@@ -379,11 +448,17 @@ struct MEGA_API LocalNode : public File
     // for botched filesystems with legacy secondary ("short") names
     // Filesystem notifications could arrive with long or short names, and we need to recognise which LocalNode corresponds.
     std::unique_ptr<LocalPath> slocalname;   // null means either the entry has no shortname or it's the same as the (normal) longname
-    localnode_map schildren;
+
+    // children by name hash: lookups compare names only on collision, the map above keeps
+    // the name order for iteration (maintained by setnameparent(), allocated with the first child)
+    std::unique_ptr<localnode_hashindex> childrenhash;
+
+    // children with a differing slocalname, by its hash (allocated on first use: most
+    // filesystems have no short names)
+    std::unique_ptr<localnode_hashindex> schildren;
 
     // local filesystem node ID (inode...) for rename/move detection
     handle fsid = mega::UNDEF;
-    handlelocalnode_map::iterator fsid_it{};
 
     // related cloud node, if any
     crossref_ptr<Node, LocalNode> node;
@@ -394,6 +469,10 @@ struct MEGA_API LocalNode : public File
     // FILENODE or FOLDERNODE
     nodetype_t type = TYPE_UNKNOWN;
 
+    // inode change time when the fingerprint was last taken, 0 if unknown
+    // (persisted, so a cold start can trust the fingerprint of an untouched file)
+    m_time_t ctime = 0;
+
     // detection of deleted filesystem records
     int scanseqno = 0;
 
@@ -419,6 +498,24 @@ struct MEGA_API LocalNode : public File
 
         // set after the cloud node is created
         bool needsRescan : 1;
+
+        // the remote children changed since the last syncdown() of this folder
+        bool syncdownPending : 1;
+
+        // some folder below this one has syncdownPending set
+        bool syncdownPendingBelow : 1;
+
+        // the children are in the state cache, not loaded yet (see Sync::loadstatecachechildren())
+        bool childrenUnloaded : 1;
+
+        // this node is the one the fsidnode index holds for fsid
+        bool fsidIndexed : 1;
+
+        // the children were looked up since the last sweep of Sync::unloadColdLocalNodes()
+        bool childrenUsed : 1;
+
+        // consecutive stability checks that found the file still changing (see bumpunstableds())
+        unsigned unstableChecks : 3;
     };
 
     // current subtree sync state: current and displayed
@@ -434,6 +531,7 @@ struct MEGA_API LocalNode : public File
     // timer to delay upload start
     dstime nagleds = 0;
     void bumpnagleds();
+    void bumpunstableds();
 
     // if delage > 0, own iterator inside MegaClient::localsyncnotseen
     localnode_set::iterator notseen_it{};
@@ -442,12 +540,19 @@ struct MEGA_API LocalNode : public File
     void getlocalpath(LocalPath&) const;
     LocalPath getLocalPath() const;
 
+    // approximate memory held by the node, without its children (for memory reports)
+    size_t approximateSize() const;
+
     // For debugging duplicate LocalNodes from older SDK versions
     string debugGetParentList();
 
     // return child node by name   (TODO: could this be ambiguous, especially with case insensitive filesystems)
     LocalNode* childbyname(LocalPath*);
 
+    // children[name] / schildren[name], nullptr if absent
+    LocalNode* findchild(const LocalPath& name) const;
+    LocalNode* findschild(const LocalPath& sname) const;
+
 #ifdef USE_INOTIFY
     // node-specific DirNotify tag
     handle dirnotifytag = mega::UNDEF;
@@ -471,6 +576,7 @@ struct MEGA_API LocalNode : public File
     void init(nodetype_t, LocalNode*, const LocalPath&, std::unique_ptr<LocalPath>);
 
     bool serialize(string*) override;
+    uint32_t parentdbid() const override;
     static LocalNode* unserialize( Sync* sync, const string* sData );
 
     ~LocalNode();
@@ -478,6 +584,9 @@ struct MEGA_API LocalNode : public File
     void detach(const bool recreate = false);
 
     void setSubtreeNeedsRescan(bool includeFiles);
+
+    // flag this folder for syncdown() and mark the path to it from the sync root
+    void setSyncdownPending();
 };
 
 template <> inline NewNode*& crossref_other_ptr_ref<LocalNode, NewNode>(LocalNode* p) { return p->newnode.ptr; }
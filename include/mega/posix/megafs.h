@@ -43,11 +43,17 @@
 #include <aio.h>
 #endif
 
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
 #include "mega.h"
 
 #define DEBRISFOLDER ".debris"
 
 namespace mega {
+class PosixDirNotify;
+
 struct MEGA_API PosixDirAccess : public DirAccess
 {
     DIR* dp;
@@ -82,6 +88,48 @@ public:
     string lastname;
 #endif
 
+#if defined(ENABLE_SYNC) && defined(USE_FANOTIFY)
+    // one filesystem-wide mark serves every sync root on that filesystem,
+    // events are matched against the roots here rather than per-directory watches
+    int fanotifyfd = -1;
+
+    struct FanotifyRoot
+    {
+        PosixDirNotify* dirnotify;
+        LocalNode* root;
+
+        // absolute, without trailing separator
+        string path;
+    };
+
+    struct FanotifyFilesystem
+    {
+        // the directory the mark was added through
+        int mountfd = -1;
+
+        // directories below a root on another filesystem aren't covered by the mark
+        dev_t dev = 0;
+
+        vector<FanotifyRoot> roots;
+
+        // the directories below the roots, by handle and by path: the mark reports the whole
+        // filesystem, events in any other directory are dropped on a lookup here
+        map<string, string> dirpaths;
+        map<string, string> dirhandles;
+    };
+
+    // by fsid
+    map<pair<int, int>, FanotifyFilesystem> fanotifyfilesystems;
+
+    bool fanotifyadd(PosixDirNotify*, LocalNode* root, const LocalPath& rootpath);
+    void fanotifyremove(PosixDirNotify*);
+    int fanotifyevents();
+
+    // record or forget the directory at path and all those below it
+    static void fanotifyadddirs(FanotifyFilesystem&, const string& path);
+    static void fanotifydeldirs(FanotifyFilesystem&, const string& path);
+#endif
+
 #ifdef USE_IOS
     static char *appbasepath;
 #endif
@@ -102,6 +150,7 @@ public:
 
     bool renamelocal(const LocalPath&, const LocalPath&, bool) override;
     bool copylocal(const LocalPath&, const LocalPath&, m_time_t) override;
+    bool cloneFile(const LocalPath& source, const LocalPath& target, m_time_t mtime) override;
     bool rubbishlocal(string*);
     bool unlinklocal(const LocalPath&) override;
     bool rmdirlocal(const LocalPath&) override;
@@ -148,16 +197,82 @@ public:
     bool hardLink(const LocalPath& source, const LocalPath& target) override;
 
     m_off_t availableDiskSpace(const LocalPath& drivePath) override;
+
+#ifdef HAVE_LIBURING
+    void asyncwritesbegin() override;
+    void asyncwritesend() override;
+#endif
 };
 
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(HAVE_LIBURING)
 struct MEGA_API PosixAsyncIOContext : public AsyncIOContext
 {
     PosixAsyncIOContext();
     virtual ~PosixAsyncIOContext();
     virtual void finish();
 
+#ifdef HAVE_AIO_RT
     struct aiocb *aiocb;
+#endif
+
+#ifdef HAVE_LIBURING
+    // queued in the io_uring and not completed yet
+    bool inRing = false;
+#endif
+};
+#endif
+
+#ifdef HAVE_LIBURING
+// io_uring shared by the async reads and writes of all PosixFileAccess.
+// The ring posts its completions to an eventfd, waited on by a thread that
+// finishes the contexts and wakes their waiters, so no exec loop ever blocks.
+class MEGA_API PosixIoUring
+{
+public:
+    // the ring, nullptr if the kernel does not provide io_uring
+    static PosixIoUring* instance();
+
+    // false if the operation of the context could not be queued
+    bool submit(PosixAsyncIOContext*, int fd);
+
+    // while held, submit() only queues: the operations queued by this thread
+    // reach the kernel in one io_uring_enter() when the last hold is released
+    void hold();
+    void release();
+
+    // hand the queued operations to the kernel
+    void flush();
+
+    ~PosixIoUring();
+
+private:
+    PosixIoUring();
+
+    // thread body: reap the completions each time the eventfd is signalled
+    void reap();
+
+    // hand the queued operations to the kernel, with mSubmitMutex held.
+    // queued operations can't be taken back: if the kernel keeps refusing them,
+    // the ring is abandoned and they finish as failed, to be retried
+    bool submitqueued();
+
+    struct io_uring mRing;
+    int mEventFd = -1;
+    bool mReady = false;
+    std::atomic<bool> mStop{false};
+
+    // set when submissions failed for good: new operations don't use the ring
+    std::atomic<bool> mAbandoned{false};
+
+    // submissions come from the threads of all the clients
+    std::mutex mSubmitMutex;
+    std::thread mReaper;
+
+    // queued, in order, and not handed to the kernel yet
+    std::deque<PosixAsyncIOContext*> mQueued;
+
+    static const unsigned QUEUE_DEPTH = 256;
+    static const int MAX_SUBMIT_ATTEMPTS = 5;
 };
 #endif
 
@@ -180,8 +295,11 @@ public:
     void updatelocalname(const LocalPath&, bool force) override;
     bool fread(string *, unsigned, unsigned, m_off_t);
     bool fwrite(const byte *, unsigned, m_off_t) override;
+    bool fwritev(const byte* const* bufs, const unsigned* lens, unsigned count, m_off_t pos) override;
+    std::unique_ptr<MappedFileRange> fmap(unsigned len, m_off_t pos) override;
 
     bool ftruncate() override;
+    bool fpreallocate(m_off_t) override;
 
     bool sysread(byte *, unsigned, m_off_t) override;
     bool sysstat(m_time_t*, m_off_t*) override;
@@ -198,12 +316,22 @@ public:
 
     ~PosixFileAccess();
 
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(HAVE_LIBURING)
 protected:
     virtual AsyncIOContext* newasynccontext();
+#endif
+
+#ifdef HAVE_AIO_RT
     static void asyncopfinished(union sigval sigev_value);
 #endif
 
+#ifdef HAVE_LIBURING
+    friend class PosixIoUring;
+
+    // completion of an operation queued in the io_uring, res as in io_uring_cqe
+    static void uringopfinished(PosixAsyncIOContext*, int res);
+#endif
+
 private:
     bool mFollowSymLinks = true;
 
@@ -215,10 +343,16 @@ class MEGA_API PosixDirNotify : public DirNotify
 public:
     PosixFileSystemAccess* fsaccess;
 
+#ifdef USE_FANOTIFY
+    // covered by a filesystem-wide fanotify mark: no per-directory inotify watches
+    bool fanotify = false;
+#endif
+
     void addnotify(LocalNode*, const LocalPath&) override;
     void delnotify(LocalNode*) override;
 
     PosixDirNotify(const LocalPath&, const LocalPath&, Sync* s);
+    ~PosixDirNotify();
 };
 #endif
 
@@ -92,7 +92,12 @@ protected:
     string useragent;
     CURLM* curlm[3];
 
-    CURLSH* curlsh;
+    // TLS sessions and cURL's DNS cache, shared by all the instances in the process so that
+    // a connection one client opens can resume a session another one negotiated
+    static CURLSH* curlsh;
+    static std::mutex curlshMutexes[CURL_LOCK_DATA_LAST];
+    static void curlsh_lock(CURL*, curl_lock_data, curl_lock_access, void*);
+    static void curlsh_unlock(CURL*, curl_lock_data, void*);
 #ifdef MEGA_USE_C_ARES
     ares_channel ares;
 #endif
@@ -112,6 +117,17 @@ protected:
     std::map<string, CurlDNSEntry> dnscache;
     int pkpErrors;
 
+    // hosts with a prefetch lookup in flight
+    std::set<string> dnsprefetches;
+
+    // requests that found a prefetched address in the cache
+    uint64_t dnsprefetchhits = 0;
+
+    // responses that came compressed, with their size as received and once decoded
+    uint64_t encodedresponses = 0;
+    uint64_t encodedbytes = 0;
+    uint64_t decodedbytes = 0;
+
     void send_pending_requests();
     void drop_pending_requests();
 
@@ -152,11 +168,19 @@ protected:
 #ifdef USE_OPENSSL
     static CURLcode ssl_ctx_function(CURL*, void*, void*);
     static int cert_verify_callback(X509_STORE_CTX*, void*);
+
+    // SHA-256 of the SubjectPublicKeyInfo of the keys that passed the pinning check, with the
+    // pin set ('a' API, 's' SFU stats) they matched.  Shared by all the instances in the process.
+    static std::set<string> pinnedkeys;
+    static std::mutex pinnedkeysMutex;
 #endif
 
 #ifdef MEGA_USE_C_ARES
     static void proxy_ready_callback(void*, int, int, struct hostent*);
     static void ares_completed_callback(void*, int, int, struct hostent*);
+#if ARES_VERSION >= 0x011000
+    static void ares_prefetch_callback(void*, int, int, struct ares_addrinfo*);
+#endif
 #endif
 
     static void send_request(CurlHttpContext*);
@@ -195,12 +219,19 @@ protected:
     void closecurlevents(direction_t d);
     void processcurlevents(direction_t d);
     SockInfoMap curlsockets[3];
+#ifdef USE_EPOLL
+    // whether curlsockets[d] is registered with the waiter; kept in sync by socket_callback while set
+    bool curlsocketswatched[3];
+    void watchcurlsockets(direction_t d, bool watch);
+#endif
     m_time_t curltimeoutreset[3];
     bool arerequestspaused[3];
+    bool multiplexing = false;
+    // whether the multi handles were changed from libcurl's defaults for multiplexing
+    bool multiplexingset = false;
+    void applymultiplexing();
     int numconnections[3];
     set<CURL *>pausedrequests[3];
-    m_off_t partialdata[2];
-    m_off_t maxspeed[2];
 
 public:
     void post(HttpReq*, const char* = 0, unsigned = 0) override;
@@ -229,11 +260,20 @@ public:
     // get max download speed
     m_off_t getmaxdownloadspeed() override;
 
+    // HTTP/2 multiplexing, if this libcurl supports it
+    bool setmultiplexing(bool enable) override;
+
+    // bufpos counts purged input as well
+    bool supportsincrementalresponses() const override { return true; }
+
     // get max upload speed
     m_off_t getmaxuploadspeed() override;
 
     bool cacheresolvedurls(const std::vector<string>& urls, std::vector<string>&& ips) override;
 
+    // resolve the hosts of tempurls ahead of their first request (needs c-ares 1.16 for the TTLs)
+    void prefetchdns(const std::vector<string>& urls) override;
+
     CurlHttpIO();
     ~CurlHttpIO();
 
@@ -242,16 +282,45 @@ public:
     bool mSocketsWaitEvent_curl_call_needed = false;
 #endif
 
+    // how transfer requests (GET/PUT) got their connection: reused warm from the
+    // pool, or opened cold and paying TCP (and TLS, for https) setup first
+    struct ConnectionStats
+    {
+        uint64_t warm = 0;
+        uint64_t cold = 0;
+        uint64_t coldSetupMs = 0;
+
+        // time to the first response byte, from the start of the request
+        uint64_t firstByte = 0;
+        uint64_t firstByteMs = 0;
+    };
+    ConnectionStats connectionStats[2];
+    std::string connectionStatsReport(bool reset);
+
+    // idle transfer connections are kept this long, so the next file to the same storage
+    // servers (typically within one folder transfer) skips the handshake
+    static const long WARMCONNECTION_MAXAGE_S = 300;
+
+    // with multiplexing on, concurrent streams allowed on one connection before curl opens another
+    static const long MULTIPLEX_MAX_STREAMS = 32;
+
+    // when both addresses of a host are cached, IPv4 is attempted this long after IPv6 unless
+    // that connected first (RFC 8305 connection attempt delay)
+    static const long HAPPY_EYEBALLS_DELAY_MS = 250;
+
 private:
     static int instanceCount;
     friend class MegaClient;
-    CodeCounter::ScopeStats countCurlHttpIOAddevents = { "curl-httpio-addevents" };
-    CodeCounter::ScopeStats countAddCurlEventsCode = { "curl-add-events" };
-    CodeCounter::ScopeStats countProcessCurlEventsCode = { "curl-process-events" };
+    void recordconnection(CURL*, direction_t, HttpReq*);
+    void recordencodedresponse(CURL*, HttpReq*);
+    // run on every loop of the client thread: sampled
+    CodeCounter::ScopeStats countCurlHttpIOAddevents = { "curl-httpio-addevents", 16 };
+    CodeCounter::ScopeStats countAddCurlEventsCode = { "curl-add-events", 16 };
+    CodeCounter::ScopeStats countProcessCurlEventsCode = { "curl-process-events", 16 };
 
 #ifdef MEGA_USE_C_ARES
-    CodeCounter::ScopeStats countAddAresEventsCode = { "ares-add-events" };
-    CodeCounter::ScopeStats countProcessAresEventsCode = { "ares-process-events" };
+    CodeCounter::ScopeStats countAddAresEventsCode = { "ares-add-events", 16 };
+    CodeCounter::ScopeStats countProcessAresEventsCode = { "ares-process-events", 16 };
 #endif
 };
 
@@ -264,6 +333,11 @@ struct MEGA_API CurlHttpContext
     CurlHttpIO* httpio;
 
     struct curl_slist *headers;
+
+    // cached IPv4 address to race against the IPv6 one in hostip, and its CURLOPT_RESOLVE entry
+    string raceipv4;
+    struct curl_slist *resolve;
+
     bool isIPv6;
     bool isCachedIp;
     string hostname;
@@ -290,7 +364,14 @@ struct MEGA_API CurlDNSEntry
     string ipv6;
     dstime ipv6timestamp;
 
+    // record TTLs, known for prefetched addresses (0: expiry as per DNS_CACHE_EXPIRES)
+    dstime ipv4ttl = 0;
+    dstime ipv6ttl = 0;
+
     bool mNeedsResolvingAgain = false;
+
+    // resolved ahead of the first request to the host, which hasn't been made yet
+    bool mPrefetched = false;
 };
 
 } // namespace
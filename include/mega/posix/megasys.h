@@ -45,6 +45,7 @@
 #include <sstream>
 #include <fstream>
 #include <map>
+#include <unordered_map>
 #include <deque>
 #include <set>
 #include <iterator>
@@ -111,6 +112,15 @@
     #include <sys/inotify.h>
 #endif
 
+#ifdef USE_FANOTIFY
+    #include <sys/fanotify.h>
+
+    // directory handle + name reporting appeared in Linux 5.9
+    #ifndef FAN_REPORT_DFID_NAME
+        #undef USE_FANOTIFY
+    #endif
+#endif
+
 #include <sys/select.h>
 
 #include <curl/curl.h>
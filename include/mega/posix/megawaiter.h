@@ -25,7 +25,11 @@
 #include "mega/waiter.h"
 #include <mutex>
 
-#ifndef USE_POLL
+#ifdef USE_EPOLL
+    #include <sys/epoll.h>
+#endif
+
+#if !defined(USE_POLL) && !defined(USE_EPOLL)
     #define MEGA_FD_ZERO FD_ZERO
     #define MEGA_FD_SET FD_SET
     #define MEGA_FD_ISSET FD_ISSET
@@ -54,7 +58,7 @@ struct PosixWaiter : public Waiter
     mega_fd_set_t rfds, wfds, efds;
     mega_fd_set_t ignorefds;
 
-#ifdef USE_POLL
+#if defined(USE_POLL) || defined(USE_EPOLL)
 
     static void clear_fdset(mega_fd_set_t *s)
     {
@@ -78,10 +82,36 @@ struct PosixWaiter : public Waiter
 
     void notify();
 
+#ifdef USE_EPOLL
+    // persistent registrations, applied to the epoll set on the next wait() so only changes reach the kernel.
+    // fds added to rfds/wfds/efds still work for a single wait(); afterwards those sets hold the ready fds.
+    void watchfd(int fd, bool read, bool write);
+    void unwatchfd(int fd);
+#endif
+
 protected:
-    int m_pipe[2];
-    std::mutex mMutex;
-    bool alreadyNotified = false;
+    // the wait() is left through an eventfd where available (one read empties it), or a pipe
+    int mEventFd = -1;
+    int m_pipe[2] = { -1, -1 };
+
+    // set by the first notify() of a wait cycle, the only one that writes to the fd
+    std::atomic<bool> mNotified{false};
+
+    int wakeupfd() const
+    {
+        return mEventFd >= 0 ? mEventFd : m_pipe[0];
+    }
+
+#ifdef USE_EPOLL
+    int mEpollFd = -1;
+    std::map<int, uint32_t> mWatched;       // persistent events by fd
+    std::map<int, uint32_t> mTransient;     // events from rfds/wfds/efds for the current wait()
+    std::map<int, uint32_t> mRegistered;    // events currently in the epoll set
+    std::set<int> mPending;                 // fds whose registration may need updating
+    std::vector<epoll_event> mEvents;
+
+    void applyepoll(int fd, bool force);
+#endif
 };
 } // namespace
 
@@ -114,6 +114,15 @@ namespace mega {
         // returns how far we are through the file on average, including uncombined data
         m_off_t progress() const;
 
+        // memory of the pieces held, received but not written yet (for memory reports)
+        size_t bufferedBytes(size_t& pieces) const;
+
+        // Rebuild `count` consecutive sectors of a missing part by xoring the sectors at `offset` in every
+        // present (non-null) input buffer.  dest advances by destStride per sector, so a whole column of
+        // a combined output piece can be recovered in one pass (destStride == RAIDLINE).
+        // Uses SSE2 or NEON where the target supports them.
+        static void recoverSectorsFromParity(byte* dest, size_t destStride, byte* const inputbufs[], size_t offset, size_t count);
+
         RaidBufferManager();
         ~RaidBufferManager();
 
@@ -176,7 +185,6 @@ namespace mega {
         // take raid input part buffers and combine to form the asyncoutputbuffers
         void combineRaidParts(unsigned connectionNum);
         FilePiece* combineRaidParts(size_t partslen, size_t bufflen, m_off_t filepos, FilePiece& prevleftoverchunk);
-        void recoverSectorFromParity(byte* dest, byte* inputbufs[], unsigned offset);
         void combineLastRaidLine(byte* dest, size_t nbytes);
         void rollInputBuffers(size_t dataToDiscard);
         virtual void bufferWriteCompletedAction(FilePiece& r);
@@ -190,6 +198,124 @@ namespace mega {
     };
 
 
+    // Sizes each connection's next (non-raid) transfer request from what its previous requests achieved,
+    // instead of the fixed MAX_REQ_SIZE / upload speed heuristics.
+    // A request aims to last long enough that its setup round trip is a small fraction of it
+    // (RTT_MULTIPLE round trips, and at least MIN_REQ_DURATION_DS), at the throughput recently measured on that channel.
+    // Sizes at most double from one request to the next, and each recent failure halves the target duration,
+    // so flaky links retry less data.
+    class MEGA_API RequestSizeController
+    {
+    public:
+        enum Policy
+        {
+            POLICY_STATIC = 0,     // the original fixed-size heuristics
+            POLICY_ADAPTIVE = 1,   // per-channel throughput/RTT feedback
+        };
+
+        // bounds for the sizes chosen
+        static const m_off_t MIN_REQ_SIZE;
+        static const m_off_t MAX_REQ_SIZE;
+
+        // shortest request aimed for, normally and with recent failures
+        static const dstime MIN_REQ_DURATION_DS;
+        static const dstime MIN_FLAKY_DURATION_DS;
+
+        // round trips per request aimed for
+        static const unsigned RTT_MULTIPLE;
+
+        void setConnections(unsigned connections);
+
+        // a request was posted on this connection
+        void requestStarted(unsigned connectionNum);
+
+        // a request on this connection finished: its size, total duration and time to first byte
+        // (only the first call after requestStarted counts, as a finished request may be revisited while its data is written)
+        void requestCompleted(unsigned connectionNum, m_off_t bytes, dstime elapsedDs, dstime firstByteDs);
+
+        // a request on this connection failed and will be retried
+        void requestFailed(unsigned connectionNum);
+
+        // size for the next request on this connection, at most ceiling; 0 when there is no measurement yet
+        m_off_t nextRequestSize(unsigned connectionNum, m_off_t ceiling);
+
+        // how the last size for this connection was chosen, for logging
+        const std::string& lastDecision(unsigned connectionNum) const;
+
+    private:
+        struct Channel
+        {
+            m_off_t throughput = 0;   // bytes per second, smoothed
+            dstime rtt = 0;           // time to first byte, smoothed
+            m_off_t lastSize = 0;
+            unsigned failures = 0;    // recent failures, forgiven one per successful request
+            bool inflight = false;
+            std::string decision;
+        };
+        std::vector<Channel> mChannels;
+    };
+
+    // Decides when a raid part request has stalled for long enough that its lines are better rebuilt from the
+    // other five parts: when it has received nothing for longer than PERCENTILE % of the recent part requests
+    // of the transfer took to complete (and at least MIN_STALL_DS), instead of at half the transfer timeout.
+    // At most MAX_HEDGES parts are swapped this way until the transfer makes progress again.
+    class MEGA_API RaidHedgeController
+    {
+    public:
+        static const unsigned PERCENTILE;
+        static const size_t MIN_SAMPLES;
+        static const size_t MAX_SAMPLES;
+        static const dstime MIN_STALL_DS;
+        static const unsigned MAX_HEDGES;
+
+        void setConnections(unsigned connections);
+
+        // a request was posted on this connection
+        void requestStarted(unsigned connectionNum);
+
+        // a request on this connection finished after elapsedDs (only the first call after requestStarted counts)
+        void requestCompleted(unsigned connectionNum, dstime elapsedDs);
+
+        // silence after which a part is rebuilt from its peers, 0 while there are too few samples
+        dstime stallThresholdDs() const;
+
+        // whether a part that has received nothing for stalledDs should be swapped; counts the swap if so
+        bool shouldHedge(dstime stalledDs);
+
+        // the transfer made progress, so further swaps are allowed
+        void progressed();
+
+    private:
+        std::deque<dstime> mDurations;
+        std::vector<bool> mInflight;
+        unsigned mHedges = 0;
+    };
+
+    // Chooses the number of connections for a non-raid transfer by probing: every so often it tries one
+    // connection more (or, alternately, one fewer) and keeps the change only if the measured throughput
+    // gained at least MIN_GAIN_PERCENT (or lost less than that). A rejected probe is followed by HOLD_DS without probing.
+    class MEGA_API ConnectionCountController
+    {
+    public:
+        // time for the (5 second window) transfer speed to reflect a change
+        static const dstime SETTLE_DS;
+
+        // wait after a probe that didn't pay off
+        static const dstime HOLD_DS;
+
+        static const unsigned MIN_GAIN_PERCENT;
+
+        // connection count wanted, given the current count, the speed measured with it and the most allowed now
+        unsigned evaluate(unsigned current, m_off_t speed, unsigned limit, dstime now);
+
+    private:
+        dstime mLastChange = 0;
+        dstime mHoldUntil = 0;
+        m_off_t mSpeedBefore = 0;
+        unsigned mCountBefore = 0;   // count before the probe under evaluation, 0 if none
+        bool mProbeUp = true;
+    };
+
     class MEGA_API TransferBufferManager : public RaidBufferManager
     {
     public:
@@ -200,7 +326,8 @@ namespace mega {
         m_off_t& transferPos(unsigned connectionNum) override;
 
         // Get the file position to upload/download to on the specified connection
-        std::pair<m_off_t, m_off_t> nextNPosForConnection(unsigned connectionNum, m_off_t maxDownloadRequestSize, unsigned connectionCount, bool& newBufferSupplied, bool& pauseConnectionForRaid, m_off_t uploadspeed);
+        // adaptiveRequestSize, when not 0, replaces the static request size heuristics (see RequestSizeController)
+        std::pair<m_off_t, m_off_t> nextNPosForConnection(unsigned connectionNum, m_off_t maxDownloadRequestSize, unsigned connectionCount, bool& newBufferSupplied, bool& pauseConnectionForRaid, m_off_t uploadspeed, m_off_t adaptiveRequestSize = 0);
 
         TransferBufferManager();
 
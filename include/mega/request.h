@@ -36,10 +36,20 @@ private:
     JSON json;
     size_t processindex = 0;
 
+    // serialized size of the commands
+    size_t bytes = 0;
+
 public:
     void add(Command*);
 
     size_t size() const;
+    size_t byteSize() const { return bytes; }
+
+    // when the first command was added
+    dstime queuedDs = 0;
+
+    // contains a command that shouldn't wait for others to join the batch
+    bool interactive = false;
 
     void get(string*, bool& suppressSID) const;
 
@@ -74,16 +84,61 @@ class MEGA_API RequestDispatcher
     bool clearWhenSafe = false;
 
     static const int MAX_COMMANDS = 10000;
+    static const int MAX_PARALLEL_BATCHES = 8;
+
+public:
+    // when a batch is closed, and how long a partial one may wait for more commands
+    struct BatchPolicy
+    {
+        size_t maxCommands = MAX_COMMANDS;
+        size_t maxBytes = 0;    // 0 for no limit
+        dstime lingerDs = 0;    // 0 to send as soon as possible
+    };
+
+private:
+    BatchPolicy mPolicy;
+
+    // independent commands go in these, each sent on its own connection while the ordered
+    // batches above are in flight.  Only the first mParallelUsed get new commands.
+    vector<unique_ptr<RequestDispatcher>> mParallel;
+    size_t mParallelUsed = 0;
+
+    // commands queued or in flight
+    size_t load() const;
 
 public:
     RequestDispatcher();
 
+    void setBatchPolicy(const BatchPolicy& policy);
+    const BatchPolicy& batchPolicy() const { return mPolicy; }
+
+    // whether the next batch should go now: it is closed or holds an interactive command,
+    // or it has lingered long enough.  Otherwise nextSendDs() is when it will be ready.
+    bool readyToSend(dstime now) const;
+    dstime nextSendDs() const;
+
+    // batches sent, by number of commands and by bytes (bucket i: up to 2^i, the last one open-ended)
+    static const int BATCH_HISTOGRAM_BUCKETS = 16;
+    std::array<uint64_t, BATCH_HISTOGRAM_BUCKETS> batchCommandsHistogram = {};
+    std::array<uint64_t, BATCH_HISTOGRAM_BUCKETS> batchBytesHistogram = {};
+    std::string batchSizeReport(bool reset);
+
+    // allow up to n batches of independent commands in flight besides the ordered one (0 to keep everything in order)
+    void setParallelBatches(size_t n);
+    size_t parallelBatches() const { return mParallel.size(); }
+    RequestDispatcher& parallel(size_t i) { return *mParallel[i]; }
+    const RequestDispatcher& parallel(size_t i) const { return *mParallel[i]; }
+
     // Queue a command to be send to MEGA. Some commands must go in their own batch (in case other commands fail the whole batch), determined by the Command's `batchSeparately` field.
     void add(Command*);
 
+    // these refer to the ordered batches only
     bool cmdspending() const;
     bool cmdsInflight() const;
 
+    // no command queued or in flight, in any batch
+    bool idle() const;
+
     Command* getCurrentCommand(bool currSeqtagSeen);
 
     bool cmdsinflight() const { return inflightreq.size(); }
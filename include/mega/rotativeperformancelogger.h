@@ -60,6 +60,11 @@ public:
     void setArchiveNumbered();
     void setArchiveTimestamps(long int maxFileAgeSeconds);
 
+    // Switch to ring mode: log text is compressed as it is written into segment
+    // files of about `segmentBytes` (compressed), and the oldest are deleted so all
+    // of them together stay within `retainBytes`. Pass 0 to go back to the plain file.
+    void setCompressedRing(size_t retainBytes, size_t segmentBytes = 4 * 1024 * 1024);
+
     void flushAndClose();
     bool cleanLogs();
 
@@ -34,6 +34,7 @@ class MEGA_API ShareNodeKeys
     string keys;
 
     int addshare(Node*);
+    void appendkey(int share, const byte* key, int keylen);
 
 public:
     // a convenience function for calling the full add() below when working with Node*
@@ -44,6 +45,11 @@ public:
     // The result is suitable for sending all the collected keys for each share, per Node, to the API.
     void add(const string& nodekey, handle nodehandle, Node*, int, const byte* = NULL, int = 0);
 
+    // adds a node key that was already encrypted with the share key of sn
+    void addencrypted(Node* sn, handle nodehandle, const string& encryptedkey);
+
+    bool empty() const { return keys.empty(); }
+
     void get(Command*, bool skiphandles = false);
 };
 } // namespace
@@ -118,6 +118,11 @@ public:
     // uniquely identifies the filesystem, we check this is unchanged.
     fsfp_t mFilesystemFingerprint;
 
+    // change journal position up to which the sync's state cache was known to be current,
+    // so that a restart replays the journal from there instead of rescanning (0 if none)
+    handle mChangeJournalId = 0;
+    m_off_t mChangeJournalPosition = 0;
+
     // type of the sync, defaults to bidirectional
     Type mSyncType;
 
@@ -199,6 +204,9 @@ struct UnifiedSync
 
     // Update remote location
     bool updateSyncRemoteLocation(Node* n, bool forceCallback);
+
+    // limit of LocalNodes the running sync keeps in RAM (0: no limit), see Sync::unloadColdLocalNodes()
+    uint64_t mMaxLocalNodesInRam = 0;
 private:
     friend class Sync;
     friend struct Syncs;
@@ -245,6 +253,88 @@ public:
     MegaClient* client() const { return mClient; }
 };
 
+// Order in which a backup's initial uploads are queued (see Syncs::orderBackupUploads())
+enum BackupUploadOrder
+{
+    BACKUP_UPLOAD_ORDER_FIFO = 0,           // as found by the scan
+    BACKUP_UPLOAD_ORDER_NEWEST_FIRST = 1,   // most recently modified files first
+    BACKUP_UPLOAD_ORDER_SMALLEST_FIRST = 2, // smallest files first
+    BACKUP_UPLOAD_ORDER_WEIGHTED = 3,       // recent and small files first, weighing both alike
+};
+
+// What a running sync is waiting on and has been busy with, to see why it is slow to converge
+// (see Syncs::syncStats()).  Times are in milliseconds, since the sync was started.
+struct SyncStats
+{
+    // notifications queued for checkpath(), and transient failures waiting for a retry
+    size_t notificationsPending = 0;
+    size_t retriesPending = 0;
+
+    // LocalNode records waiting to be written to / removed from the state cache
+    size_t statecacheWritesPending = 0;
+    size_t statecacheDeletesPending = 0;
+
+    size_t uploadsPending = 0;
+    size_t downloadsPending = 0;
+
+    uint64_t checkpathCalls = 0;
+    uint64_t checkpathTime = 0;
+    uint64_t syncdownCalls = 0;
+    uint64_t syncdownTime = 0;
+    uint64_t syncupCalls = 0;
+    uint64_t syncupTime = 0;
+    uint64_t cachenodesCalls = 0;
+    uint64_t cachenodesTime = 0;
+
+    // rescans of the whole tree after notifications failed
+    uint64_t fullRescans = 0;
+};
+
+// While enabled, records the timed operations of the syncs (the most recent MAX_EVENTS of them),
+// for export in Chrome's trace event format (chrome://tracing, Perfetto).
+class MEGA_API SyncTrace
+{
+public:
+    void enable(bool enable);
+    bool enabled() const { return mEnabled; }
+
+    void add(const char* name, handle backupId, std::chrono::high_resolution_clock::time_point start,
+             std::chrono::high_resolution_clock::duration timeSpent);
+
+    // one complete ("X") event per operation, with the sync's backup id as thread id
+    string exportChromeTrace() const;
+
+    static const size_t MAX_EVENTS = 100000;
+
+private:
+    struct Event
+    {
+        const char* name;
+        handle backupId;
+        int64_t start;      // microseconds since the trace was enabled
+        int64_t duration;   // microseconds
+    };
+
+    bool mEnabled = false;
+    std::chrono::high_resolution_clock::time_point mEpoch;
+    std::deque<Event> mEvents;
+};
+
+// Times one operation of a sync into its figures, and into the trace when enabled
+class SyncOpTimer
+{
+public:
+    SyncOpTimer(Sync& sync, CodeCounter::CallStats& stats, const char* name);
+    ~SyncOpTimer();
+
+    MEGA_DISABLE_COPY_MOVE(SyncOpTimer);
+
+private:
+    Sync& mSync;
+    const char* mName;
+    CodeCounter::CallTimer mTimer;
+};
+
 class MEGA_API Sync
 {
 public:
@@ -291,9 +381,43 @@ public:
     // recursively add children
     void addstatecachechildren(uint32_t, idlocalnode_map*, LocalPath&, LocalNode*, int);
 
+    // the state cache is indexed by parent: LocalNodes are loaded a folder at a time, on demand
+    bool statecachelazy = false;
+
+    // load the children of a folder from the state cache if not loaded yet (and of its subfolders, if recurse)
+    void loadstatecachechildren(LocalNode*, bool recurse);
+
+    // Unload the file children of folders not looked at recently, down to a margin below
+    // mUnifiedSync.mMaxLocalNodesInRam, CLOCK-wise: a folder is skipped once after its children
+    // are looked up. Their records stay in the state cache, read again by loadstatecachechildren().
+    void unloadColdLocalNodes();
+
+    // more LocalNodes in RAM than the limit?
+    bool overLocalNodeBudget() const;
+
+    // unload the file children of the folder that are synced and idle, returns how many
+    size_t unloadchildren(LocalNode*);
+
+    // load the unloaded file synced to h (and the rest of its folder), so that a remote change finds it
+    void loadunloadedfile(NodeHandle h);
+
+    // cloud handles of the unloaded files, by the handle of their folder's cloud node
+    std::unordered_map<NodeHandle, NodeHandle, NodeHandleHash> mUnloadedFiles;
+
+    // the LocalNodes being deleted are only unloaded
+    bool mUnloadingLocalNodes = false;
+
+    // next time unloadColdLocalNodes() may sweep, and the folders one sweep visits at most
+    dstime mNextUnloadDs = 0;
+    static const dstime UNLOAD_INTERVAL_DS = 600;
+    static const size_t MAX_UNLOAD_STEPS = 100000;
+
     // Caches all synchronized LocalNode
     void cachenodes();
 
+    // records written by one cachenodes() call while the sync is active
+    static const size_t STATECACHE_WRITES_PER_CALL = 20000;
+
     // change state, signal to application
     void changestate(syncstate_t, SyncError newSyncError, bool newEnableFlag, bool notifyApp, bool keepSyncDb);
 
@@ -303,6 +427,22 @@ public:
     // process and remove one directory notification queue item from *notify
     dstime procscanq(int);
 
+    // have the files of the next due notifications in the queue fingerprinted in the background
+    void prefetchfingerprints(int);
+
+    // fingerprint l from fa (opened at path), using the prefetched fingerprint if still current
+    bool genfingerprint(LocalNode* l, FileAccess* fa, const LocalPath& path);
+
+    // notifications looked at by one prefetchfingerprints() call
+    static const size_t PREFETCH_NOTIFICATIONS = 32;
+
+    // time spent on this sync, reported by Syncs::syncStats()
+    CodeCounter::CallStats mCheckpathTime;
+    CodeCounter::CallStats mSyncdownTime;
+    CodeCounter::CallStats mSyncupTime;
+    CodeCounter::CallStats mCachenodesTime;
+    uint64_t mFullRescans = 0;
+
     // recursively look for vanished child nodes and delete them
     void deletemissing(LocalNode*);
 
@@ -323,6 +463,19 @@ public:
     // LocalNode
     bool scan(LocalPath, FileAccess*);
 
+    // Stands in for the initial scan: queues the paths the filesystem's change journal reports
+    // as changed since the position saved in the config. False if the journal can't tell.
+    bool replayChangeJournal();
+
+    // Saves the journal position read at the previous call, as the state cache reflects it by now.
+    void recordChangeJournalPosition();
+
+    // journal position read by the last recordChangeJournalPosition(), saved by the next one
+    handle mPendingJournalId = 0;
+    m_off_t mPendingJournalPosition = 0;
+    dstime mNextJournalCheckDs = 0;
+    static const dstime JOURNAL_CHECK_INTERVAL_DS = 3000;
+
     // rescan sequence number (incremented when a full rescan or a new
     // notification batch starts)
     int scanseqno = 0;
@@ -581,6 +734,66 @@ private:
     HMACSHA256 mSigner;
 }; // SyncConfigIOContext
 
+// Fingerprints files named by the syncs' pending notifications ahead of checkpath(), on a small
+// pool of threads shared by all syncs, so that the file reads of different syncs overlap.
+// The threads only read files: LocalNodes, the fsid map and move detection stay on the sync thread,
+// which adopts a fingerprint only if the file still has the size, mtime and fsid it was computed for.
+class MEGA_API FingerprintPrefetcher
+{
+public:
+    FingerprintPrefetcher() = default;
+    ~FingerprintPrefetcher();
+
+    MEGA_DISABLE_COPY_MOVE(FingerprintPrefetcher);
+
+    // queue the file at path (absolute) for sync, false if too many are pending
+    bool queue(Sync* sync, const LocalPath& path);
+
+    // the fingerprint computed for the file at path, if fa (opened) still matches it. Forgets the path.
+    bool take(const LocalPath& path, const FileAccess& fa, FileFingerprint& fingerprint);
+
+    // forget everything queued or computed for sync
+    void cancel(Sync* sync);
+
+    // pending and computed fingerprints held at once, across syncs
+    static const size_t MAX_ENTRIES = 1024;
+
+    // threads started on first use, at most
+    static const unsigned MAX_THREADS = 4;
+
+private:
+    struct Entry
+    {
+        Sync* sync;
+        bool done;
+
+        // attributes of the file when it was fingerprinted
+        m_off_t size;
+        m_time_t mtime;
+        handle fsid;
+        bool fsidvalid;
+
+        FileFingerprint fingerprint;
+    };
+
+    struct PathHash
+    {
+        size_t operator()(const LocalPath& path) const { return path.hash(); }
+    };
+
+    void loop();
+
+    std::mutex mLock;
+    std::condition_variable mNotifier;
+
+    // paths to fingerprint, skipped if no longer in mEntries
+    std::deque<LocalPath> mPending;
+    std::unordered_map<LocalPath, Entry, PathHash> mEntries;
+
+    bool mTerminating = false;
+    std::vector<std::thread> mThreads;
+};
+
 struct Syncs
 {
     // Retrieve a copy of configured sync settings (thread safe)
@@ -603,6 +816,18 @@ struct Syncs
     // returns a copy of the config, for thread safety
     bool syncConfigByBackupId(handle backupId, SyncConfig&) const;
 
+    // what the running sync is waiting on and has spent its time on, false if it is not running
+    bool syncStats(handle backupId, SyncStats&) const;
+
+    // limit the LocalNodes of the sync kept in RAM (0: no limit), false if there is no such sync
+    bool setMaxLocalNodesInRam(handle backupId, uint64_t maxNodes);
+
+    // a remote change to n: load its LocalNode first, if it was unloaded
+    void loadUnloadedLocalNode(Node* n);
+
+    // sort uploads of mirroring backups per mBackupUploadOrder, before they are queued
+    void orderBackupUploads(localnode_vector&) const;
+
     void forEachUnifiedSync(std::function<void(UnifiedSync&)> f);
     void forEachRunningSync(std::function<void(Sync* s)>);
     bool forEachRunningSync_shortcircuit(std::function<bool(Sync* s)>);
@@ -711,6 +936,15 @@ public:
     // by setting this flag
     bool mBackupRestrictionsEnabled = true;
 
+    // timed sync operations, while enabled
+    SyncTrace mTrace;
+
+    // queueing order of the uploads of backups that are still mirroring
+    BackupUploadOrder mBackupUploadOrder = BACKUP_UPLOAD_ORDER_FIFO;
+
+    // some sync has unloaded LocalNodes (see Sync::unloadColdLocalNodes())
+    bool mLocalNodesUnloaded = false;
+
 private:
     friend class Sync;
     friend struct UnifiedSync;
@@ -747,6 +981,9 @@ private:
     // Syncs should have a separate fsaccess for thread safety
     unique_ptr<FileSystemAccess>& fsaccess;
 
+    // fingerprints files for checkpath() ahead of time, for all syncs (outlives them)
+    FingerprintPrefetcher mFingerprintPrefetcher;
+
     // pseudo-random number generator
     PrnGen rng;
 
@@ -286,8 +286,14 @@ public:
         bool mode : 1;
         bool options : 1;
         bool schedOcurr : 1;
+        bool peers : 1;
+        bool title : 1;
+        bool ownPriv : 1;
     } changed;
 
+    // true if the peers (and their privileges) are the ones in `other`, in any order
+    bool samePeers(const userpriv_vector* other) const;
+
     // return false if failed
     bool setNodeUserAccess(handle h, handle uh, bool revoke = false);
     bool addOrUpdateChatOptions(int speakRequest = -1, int waitingRoom = -1, int openInvite = -1);
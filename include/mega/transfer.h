@@ -44,6 +44,102 @@ struct TransferCategory
 
 class TransferDbCommitter;
 
+// When a transfer reached each stage of its latest attempt, and where the time of its connections
+// went, to tell what a slow transfer was waiting for. Not persisted: a resumed transfer starts over.
+struct MEGA_API TransferTimeline
+{
+    enum Stage
+    {
+        QUEUED,         // the Transfer was created
+        STARTED,        // it got a slot (the latest one, if retried)
+        URL_REQUESTED,  // the temporary URLs were requested (not if cached from a previous attempt)
+        URL_RECEIVED,
+        CONNECTED,      // the first request had its connection (and TLS) up
+        FIRST_BYTE,     // the first data arrived
+        COMPLETED,      // all the data was transferred and verified
+        NUM_STAGES
+    };
+
+    // per connection of the slot (a raid part, for raid downloads)
+    struct Connection
+    {
+        uint64_t requests = 0;
+        uint64_t bytes = 0;
+
+        // time from sending each request to its completion, and the parts of it measured by the HttpIO
+        // (name resolution, connection setup and TLS only on the requests that opened a connection)
+        uint64_t requestMs = 0;
+        uint64_t dnsMs = 0;
+        uint64_t connectMs = 0;
+        uint64_t tlsMs = 0;
+        uint64_t firstByteMs = 0;
+        uint64_t newConnections = 0;
+
+        // dropped for being slow or stalled (raid downloads switch to the other parts)
+        uint64_t slowResets = 0;
+
+        // speed of the latest request
+        m_off_t lastSpeed = 0;
+
+        // milliseconds since the epoch when the request in flight was sent
+        int64_t requestStart = 0;
+    };
+
+    // milliseconds since the epoch, 0 if not reached
+    std::array<int64_t, NUM_STAGES> stages;
+
+    std::vector<Connection> connections;
+    unsigned attempts = 0;
+
+    // time spent encrypting or decrypting (mostly on the worker threads), and on synchronous reads and writes of the local file
+    uint64_t cryptoUs = 0;
+    uint64_t diskUs = 0;
+
+    TransferTimeline() { stages.fill(0); }
+
+    // records the stage, unless it was reached earlier
+    void mark(Stage stage, int64_t when = now());
+
+    // a new slot: the stages after QUEUED, and the connections, are for the new attempt
+    void restart();
+
+    // collects a completed request of connection i
+    void requestCompleted(int i, const HttpReqXfer& req, m_off_t speed);
+
+    // JSON object with the stages, the connections and the times above, which also has the stages
+    // as Chrome trace events ("traceEvents") for chrome://tracing or Perfetto, on a thread named by tag
+    string toJson(int tag) const;
+
+    static const char* stageName(int stage);
+    static int64_t now();
+};
+
+// fills a download's temp file from a local file with the same content, on a worker thread.
+// the worker only touches this object; the client reads the outcome once done is set.
+struct MEGA_API LocalDownloadCopy
+{
+    LocalPath source;
+    LocalPath target;
+    FileFingerprint fingerprint;
+
+    // the transfer's key, CTR IV and expected MAC, so the copy can be checked against the node
+    std::array<byte, SymmCipher::KEYLENGTH> key;
+    int64_t ctriv = 0;
+    int64_t metamac = 0;
+
+    // set by the client when the transfer goes away: the worker stops and removes the target
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> done{false};
+
+    // once done: the target holds the whole content, and its MAC matched
+    bool copied = false;
+
+    void run();
+
+private:
+    bool copy(FileSystemAccess&);
+};
+
 // pending/active up/download ordered by file fingerprint (size - mtime - sparse CRC)
 struct MEGA_API Transfer : public FileFingerprint
 {
@@ -101,7 +197,9 @@ struct MEGA_API Transfer : public FileFingerprint
     int tag;
 
     // signal failure.  Either the transfer's slot or the transfer itself (including slot) will be deleted.
-    void failed(const Error&, TransferDbCommitter&, dstime = 0);
+    // keepUploadSession: the failure didn't invalidate the upload URL, so a retried upload continues
+    // at the first unfinished chunk instead of starting over with a new one
+    void failed(const Error&, TransferDbCommitter&, dstime = 0, bool keepUploadSession = false);
 
     // signal completion
     void complete(TransferDbCommitter&);
@@ -122,13 +220,17 @@ struct MEGA_API Transfer : public FileFingerprint
     // transfer state
     bool finished;
 
-    // temp URLs for upload/download data.  They can be cached.  For uploads, a new url means any previously uploaded data is abandoned.
+    // temp URLs for upload/download data.  They can be cached.  For uploads, a new url means any previously uploaded data is abandoned,
+    // so the url is kept (and cached with the chunkmacs) across failures that leave it valid.
     // downloads can have 6 for raid, 1 for non-raid.  Uploads always have 1
     std::vector<string> tempurls;
 
     // context of the async fopen operation
     AsyncIOContext* asyncopencontext;
 
+    // local copy serving this download, if one was tried (see MegaClient::localdownloaddedup)
+    std::shared_ptr<LocalDownloadCopy> localcopy;
+
     // timestamp of the start of the transfer
     m_time_t lastaccesstime;
 
@@ -140,6 +242,12 @@ struct MEGA_API Transfer : public FileFingerprint
 
     bool skipserialization;
 
+    // progress is written to the transfer cache at most every PROGRESS_CACHE_INTERVAL_DS:
+    // when it was last written, and whether newer progress is waiting for the next write
+    static const dstime PROGRESS_CACHE_INTERVAL_DS = 50;
+    dstime progressCachedDs = 0;
+    bool progressNotCached = false;
+
     Transfer(MegaClient*, direction_t);
     virtual ~Transfer();
 
@@ -150,10 +258,18 @@ struct MEGA_API Transfer : public FileFingerprint
     static Transfer* unserialize(MegaClient *, string*, transfer_map *);
 
     // examine a file on disk for video/audio attributes to attach to the file, on upload/download
-    void addAnyMissingMediaFileAttributes(Node* node, LocalPath& localpath);
+    // (through verifiedFile, if the caller has just checked the file with it).  The file is examined
+    // on MediaExtractionService; an upload's putnodes is held until its attributes are known
+    void addAnyMissingMediaFileAttributes(Node* node, LocalPath& localpath, std::unique_ptr<FileAccess> verifiedFile = nullptr);
+
+    // user transfers outrank sync ones, backups come last
+    BandwidthScheduler::Category bandwidthcategory() const;
 
     // whether the Transfer needs to remove itself from the list it's in (for quick shutdown we can skip)
     bool mOptimizedDelete = false;
+
+    // when each stage was reached, and the breakdown of the time of its connections
+    TransferTimeline timeline;
 };
 
 
@@ -205,16 +321,53 @@ public:
                                                    TransferDbCommitter& committer);
     Transfer *transferat(direction_t direction, unsigned int position);
 
+    // something that may make a queued transfer dispatchable has happened (list change, slot freed, state change)
+    void schedulingChanged() { ++mSchedulingChanges; }
+
+    // a direction found idle is rescanned after a change, once the earliest backoff expires, or after this long
+    static const dstime MAX_IDLE_DS = 10;
+
     std::array<transfer_list, 2> transfers;
     MegaClient *client;
     uint64_t currentpriority;
 
 private:
+    // per direction: whether the last scan found nothing to start, and until when that holds
+    unsigned mSchedulingChanges = 0;
+    std::array<bool, 2> mIdle = {{ false, false }};
+    std::array<unsigned, 2> mIdleChanges = {{ 0, 0 }};
+    std::array<dstime, 2> mIdleUntilDs = {{ 0, 0 }};
+
     void prepareIncreasePriority(Transfer *transfer, transfer_list::iterator srcit, transfer_list::iterator dstit, TransferDbCommitter& committer);
     void prepareDecreasePriority(Transfer *transfer, transfer_list::iterator it, transfer_list::iterator dstit);
     bool isReady(Transfer *transfer);
 };
 
+// bounded cache of decrypted ranges already delivered for a node, shared by its DirectReads
+class MEGA_API DirectReadCache
+{
+public:
+    static const size_t DEFAULT_MAX_BYTES = 16 * 1024 * 1024;
+
+    explicit DirectReadCache(size_t maxBytes = DEFAULT_MAX_BYTES);
+
+    // keep a copy of [pos, pos + len); parts already cached are skipped, oldest ranges evicted beyond the limit
+    void add(m_off_t pos, const byte* data, size_t len);
+
+    // append to out the bytes cached contiguously from pos, at most maxLen; returns how many
+    size_t read(m_off_t pos, size_t maxLen, string& out) const;
+
+    size_t size() const { return mBytes; }
+    void clear();
+
+private:
+    // non-overlapping ranges by start position, and their insertion order for eviction
+    map<m_off_t, string> mRanges;
+    deque<m_off_t> mOrder;
+    size_t mBytes = 0;
+    size_t mMaxBytes;
+};
+
 struct MEGA_API DirectReadSlot
 {
     m_off_t pos;
@@ -225,8 +378,14 @@ struct MEGA_API DirectReadSlot
     static const int TIMEOUT_DS = 100;
     static const int TEMPURL_TIMEOUT_DS = 3000;
 
+    // responses are received into pooled segments that are handed to drbuf whole; a partly filled one
+    // is only copied out if no full segment has been handed over on that connection for this long
+    static const unsigned RECEIVE_SEGMENT_SIZE = 256 * 1024;
+    static const dstime PARTIAL_SEGMENT_DELAY_DS = 1;
+
     DirectRead* dr;
     std::vector<HttpReq*> reqs;
+    std::vector<dstime> lastHandoffDs;
 
     drs_list::iterator drs_it;
     SpeedController speedController;
@@ -241,6 +400,7 @@ struct MEGA_API DirectReadSlot
 private:
     std::string adjustURLPort(std::string url);
     bool processAnyOutputPieces();
+    bool processCachedPrefix();
 };
 
 struct MEGA_API DirectRead
@@ -262,9 +422,33 @@ struct MEGA_API DirectRead
 
     int reqtag;
 
+    // request size chosen by the node's read-ahead window when this read was queued
+    m_off_t maxrequestsize;
+
+    // start of the range served from the node's cache, delivered before any network data
+    string cachedprefix;
+
+    // another read of the node whose fetch covers this read's next bytes: they are passed on by it
+    // (see fanout) instead of being requested again, until it ends and this read fetches the rest itself
+    DirectRead* leader;
+    std::vector<DirectRead*> followers;
+
+    // file position of the next byte to deliver, and the end of the range
+    m_off_t nextpos() const;
+    m_off_t endpos() const;
+
+    // pass the bytes [pos, pos + len) just delivered by this read on to the followers waiting for them
+    void fanout(byte* data, m_off_t len, m_off_t pos, m_off_t speed, m_off_t meanSpeed);
+
+    // set up drbuf to fetch whatever the cached prefix doesn't cover
+    void startbuffering();
+
+    // queue for fetching if the node has tempurls already (otherwise the API command result will)
+    void queuefetch();
+
     void abort();
 
-    DirectRead(DirectReadNode*, m_off_t, m_off_t, int, void*);
+    DirectRead(DirectReadNode*, m_off_t, m_off_t, int, void*, bool sequential = false);
     ~DirectRead();
 };
 
@@ -291,6 +475,25 @@ struct MEGA_API DirectReadNode
 
     dr_list reads;
 
+    // decrypted data recently delivered, so seeks back into it are served without refetching
+    DirectReadCache cache;
+
+    // request size for new reads: doubles while reads continue where the previous one stopped,
+    // back to the minimum on a seek
+    static const m_off_t MIN_READAHEAD = 2 * 1024 * 1024;
+    static const m_off_t MAX_READAHEAD = 16 * 1024 * 1024;
+    m_off_t readahead;
+
+    // file position just past the last byte delivered to the app, or -1
+    m_off_t lastreadend;
+
+    // adapt the read-ahead window to a read starting at offset and return it
+    m_off_t readaheadfor(m_off_t offset);
+
+    // window for a read known to be sequential: the maximum from the start, ending on a
+    // ChunkedHash boundary so requests don't split the chunks that are MAC'd together
+    m_off_t sequentialreadahead(m_off_t offset);
+
     MegaClient* client;
 
     handledrn_map::iterator hdrn_it;
@@ -300,7 +503,7 @@ struct MEGA_API DirectReadNode
     void cmdresult(const Error&, dstime = 0);
 
     // enqueue new read
-    void enqueue(m_off_t, m_off_t, int, void*);
+    void enqueue(m_off_t, m_off_t, int, void*, bool sequential = false);
 
     // dispatch all reads
     void dispatch();
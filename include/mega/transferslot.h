@@ -71,6 +71,9 @@ struct MEGA_API TransferSlot
     // maximum gap between chunks for uploads
     static const m_off_t MAX_GAP_SIZE;
 
+    // max bytes gathered from adjacent decrypted pieces into one download write
+    static const m_off_t MAX_COALESCED_WRITE;
+
     m_off_t maxRequestSize;
 
     m_off_t progressreported;
@@ -97,6 +100,12 @@ struct MEGA_API TransferSlot
     vector<SpeedController> mReqSpeeds;
     SpeedController mTransferSpeed;
 
+    // per-channel request sizing when the client uses RequestSizeController::POLICY_ADAPTIVE
+    RequestSizeController mRequestSizes;
+
+    // swaps raid parts that stall for longer than their peers' requests usually take
+    RaidHedgeController mRaidHedges;
+
     // only swap channels twice for speed issues, to prevent endless non-progress (counter is reset if we make overall progress, ie data reassembled)
     unsigned mRaidChannelSwapsForSlowness = 0;
 
@@ -106,12 +115,23 @@ struct MEGA_API TransferSlot
     // async IO operations
     AsyncIOContext** asyncIO;
 
+    // upload chunks are mapped rather than read (see MegaClient::mapuploadsources)
+    bool mMappedReads = false;
+
+    // smallest upload whose chunks are mapped
+    static const m_off_t MIN_MAPPED_UPLOAD;
+
     // handle I/O for this slot
     void doio(MegaClient*, TransferDbCommitter&);
 
     // helper for doio to delay connection creation until we know if it's raid or non-raid
     bool createconnectionsonce();
 
+    // in auto connection mode, add or remove (idle) connections as mConnectionCount decides
+    void adjustconnections(MegaClient*);
+    ConnectionCountController mConnectionCount;
+    int mWantedConnections = 0;
+
     // disconnect and reconnect all open connections for this transfer
     void disconnect();
 
@@ -144,6 +164,9 @@ private:
     bool checkMetaMacWithMissingLateEntries();
     bool tryRaidRecoveryFromHttpGetError(unsigned i, bool incrementErrors);
 
+    // hand the plaintext already read into reqs[i]->out to a worker thread for encryption and chunk MACs
+    void queueUploadEncryption(MegaClient* client, int i, m_off_t pos, m_off_t npos);
+
     // returns true if connection haven't received data recently (set incrementErrors) or if slower than other connections (reset incrementErrors)
     bool testForSlowRaidConnection(unsigned connectionNum, bool& incrementErrors);
 };
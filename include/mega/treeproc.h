@@ -50,6 +50,13 @@ class MEGA_API TreeProcApplyKey : public TreeProc
 {
 public:
     void proc(MegaClient*, Node*);
+
+    // decrypt the nodes collected by proc() (in parallel if there are many) and notify those
+    // that could be decrypted
+    void apply(MegaClient*);
+
+private:
+    vector<Node*> mNodes;
 };
 
 class MEGA_API TreeProcCopy : public TreeProc
@@ -66,12 +73,22 @@ public:
 
 class MEGA_API TreeProcShareKeys : public TreeProc
 {
-    ShareNodeKeys snk;
+    vector<Node*> nodes;
     Node* sn;
 
 public:
+    // most nodes whose keys are sent in one command (the rest follow in CommandShareNodeKeys)
+    static const size_t MAX_NODES_PER_COMMAND = 10000;
+
     void proc(MegaClient*, Node*);
-    void get(Command*);
+
+    // adds the keys of the first MAX_NODES_PER_COMMAND nodes to the command, and returns the
+    // handles of the others, for the command to send once it succeeded
+    vector<handle> get(Command*, MegaClient*);
+
+    // add the keys of the nodes for their shares (only sn if set); for a single share with
+    // many nodes, the keys are encrypted on the worker threads
+    static void add(MegaClient*, ShareNodeKeys&, Node* sn, Node* const* nodes, size_t count);
 
     TreeProcShareKeys(Node* = NULL);
 };
@@ -75,8 +75,10 @@ typedef unsigned char byte;
 
 #include <memory>
 #include <string>
+#include <atomic>
 #include <chrono>
 #include <mutex>
+#include <unordered_map>
 
 namespace mega {
 
@@ -140,6 +142,7 @@ struct PendingContactRequest;
 class TransferList;
 struct Achievement;
 class SyncConfig;
+struct MappedFileRange;
 
 namespace UserAlert
 {
@@ -289,6 +292,12 @@ inline bool operator!=(NodeHandle a, handle b) { return a.ne(b); }
 inline bool operator!=(NodeHandle a, NodeHandle b) { return a.ne(b); }
 std::ostream& operator<<(std::ostream&, NodeHandle h);
 
+// consistent with operator==, which compares the 6 bytes of the handle only
+struct NodeHandleHash
+{
+    size_t operator()(NodeHandle h) const { return std::hash<handle>()(h.as8byte()); }
+};
+
 struct UploadHandle
 {
     handle h = 0xFFFFFFFFFFFFFFFF;
@@ -398,6 +407,9 @@ public:
 
     virtual bool serialize(string*) = 0;
 
+    // dbid of the record this one belongs under, for DbTable::getbyparent()
+    virtual uint32_t parentdbid() const { return 0; }
+
     uint32_t dbid = 0;
     bool notified = false;
 };
@@ -521,7 +533,7 @@ typedef enum { SYNCDEL_NONE, SYNCDEL_DELETED, SYNCDEL_INFLIGHT, SYNCDEL_BIN,
 
 typedef vector<LocalNode*> localnode_vector;
 
-typedef map<handle, LocalNode*> handlelocalnode_map;
+typedef std::unordered_map<handle, LocalNode*> handlelocalnode_map;
 
 typedef set<LocalNode*> localnode_set;
 
@@ -852,6 +864,131 @@ unique_ptr<T> make_unique(constructorArgs&&... args)
     return (unique_ptr<T>(new T(std::forward<constructorArgs>(args)...)));
 }
 
+// Process-wide counters, gauges and latency histograms, always collected (unlike CodeCounter::ScopeStats reports).
+// Counters and histograms are updated without locks on a shard of the calling thread, and snapshot() adds the
+// shards up.  Metrics are registered by name, once (a name registered again gets the same metric), and the
+// handles are cheap to copy: keep them in statics or long-lived members.
+class MEGA_API Metrics
+{
+public:
+    enum Type { COUNTER, GAUGE, HISTOGRAM };
+
+    static const unsigned MAX_METRICS = 256;
+
+    class Timer;
+
+    // log-linear buckets of microseconds: exact below 8, then 8 per power of two (12.5% wide) up to 2^37
+    static const unsigned HISTOGRAM_SUB_BITS = 3;
+    static const unsigned HISTOGRAM_MAX_EXPONENT = 36;
+    static const unsigned HISTOGRAM_BUCKETS = ((HISTOGRAM_MAX_EXPONENT - HISTOGRAM_SUB_BITS + 2) << HISTOGRAM_SUB_BITS);
+
+    class MEGA_API Counter
+    {
+    public:
+        void add(uint64_t n = 1) const;
+
+    private:
+        friend class Metrics;
+        unsigned mId = MAX_METRICS;     // not registered (registry full): updates are ignored
+    };
+
+    class MEGA_API Gauge
+    {
+    public:
+        void set(int64_t value) const;
+        void add(int64_t delta) const;
+
+    private:
+        friend class Metrics;
+        unsigned mId = MAX_METRICS;
+    };
+
+    // only one in sampleEvery values is recorded, snapshots scale the figures back
+    class MEGA_API Histogram
+    {
+    public:
+        void record(std::chrono::steady_clock::duration d) const;
+
+        // whether the next value of the calling thread is to be recorded
+        bool sample() const;
+
+    private:
+        friend class Metrics;
+        friend class Timer;
+        unsigned mId = MAX_METRICS;
+        unsigned mSampleEvery = 1;
+        void recordSampled(uint64_t microseconds) const;
+    };
+
+    // records the time from its construction to stop() or its destruction (the clock is only read for sampled values)
+    class MEGA_API Timer
+    {
+    public:
+        explicit Timer(const Histogram& h);
+        ~Timer() { stop(); }
+        void stop();
+
+    private:
+        const Histogram& mHistogram;
+        bool mSampled;
+        std::chrono::steady_clock::time_point mStart;
+    };
+
+    static Counter counter(const std::string& name, const std::string& help);
+    static Gauge gauge(const std::string& name, const std::string& help);
+    static Histogram histogram(const std::string& name, const std::string& help, unsigned sampleEvery = 1);
+
+    struct Entry
+    {
+        std::string name;
+        std::string help;
+        Type type = COUNTER;
+        int64_t value = 0;                  // counter or gauge value, or the number of values of a histogram
+        uint64_t sumMicroseconds = 0;       // histogram
+        std::vector<uint64_t> buckets;      // histogram, HISTOGRAM_BUCKETS counts
+
+        // upper bound of the bucket holding that percentile (0 to 100) of the values of a histogram
+        uint64_t percentileMicroseconds(double percentile) const;
+    };
+
+    // figures of all the threads, sampled histograms scaled to the estimated totals
+    static std::vector<Entry> snapshot();
+
+    // Prometheus / OpenMetrics text exposition
+    static std::string toOpenMetrics(const std::vector<Entry>& entries);
+
+    static unsigned bucketOf(uint64_t microseconds);
+    static uint64_t bucketLowerBound(unsigned bucket);
+};
+
+// Approximate memory held by the main structures of a client, by subsystem.
+// Figures are estimates: container overheads are guessed from their sizes and big
+// collections are sampled, so they are cheap enough to be polled in production.
+struct MEGA_API MemoryReport
+{
+    // approximate size of an element of the node-based standard containers, with the heap overhead
+    static const size_t CONTAINER_NODE_OVERHEAD = 4 * sizeof(void*);
+
+    struct Entry
+    {
+        std::string subsystem;
+        uint64_t objects = 0;
+        uint64_t bytes = 0;
+    };
+    std::vector<Entry> entries;
+
+    // heap memory of a string (none if it fits in the string itself)
+    static size_t heapBytes(const std::string& s);
+
+    // adds up to the entry of the subsystem, if it's there already
+    void add(const std::string& subsystem, uint64_t objects, uint64_t bytes);
+
+    uint64_t totalBytes() const;
+
+    // {"subsystems":[{"name":...,"objects":...,"bytes":...},...],"bytes":total}
+    std::string toJson() const;
+};
+
 //#define MEGA_MEASURE_CODE   // uncomment this to track time spent in major subsystems, and log it every 2 minutes, with extra control from megacli
 
 namespace CodeCounter
@@ -864,6 +1001,9 @@ namespace CodeCounter
 
     struct ScopeStats
     {
+        // always collected, see Metrics
+        Metrics::Histogram histogram;
+
 #ifdef MEGA_MEASURE_CODE
         uint64_t count = 0;
         uint64_t starts = 0;
@@ -871,7 +1011,8 @@ namespace CodeCounter
         high_resolution_clock::duration timeSpent{};
         high_resolution_clock::duration longest{};
         std::string name;
-        ScopeStats(std::string s) : name(std::move(s)) {}
+        ScopeStats(std::string s, unsigned sampleEvery = 1)
+            : histogram(Metrics::histogram(s, "Time spent in " + s, sampleEvery)), name(std::move(s)) {}
 
         inline string report(bool reset = false)
         {
@@ -889,7 +1030,8 @@ namespace CodeCounter
             return s;
         }
 #else
-        ScopeStats(std::string s) {}
+        ScopeStats(std::string s, unsigned sampleEvery = 1)
+            : histogram(Metrics::histogram(s, "Time spent in " + s, sampleEvery)) {}
 #endif
     };
 
@@ -914,15 +1056,40 @@ namespace CodeCounter
 #endif
     };
 
+    // Number of calls to a block of code and the sum of the time they took, always collected (unlike ScopeStats),
+    // for figures reported through the API.  Timed with CallTimer.
+    struct CallStats
+    {
+        uint64_t count = 0;
+        high_resolution_clock::duration timeSpent{};
+
+        uint64_t milliseconds() const { return uint64_t(duration_cast<std::chrono::milliseconds>(timeSpent).count()); }
+    };
+
+    struct CallTimer
+    {
+        CallStats& stats;
+        high_resolution_clock::time_point blockStart;
+
+        CallTimer(CallStats& s) : stats(s), blockStart(high_resolution_clock::now()) {}
+        ~CallTimer()
+        {
+            ++stats.count;
+            stats.timeSpent += high_resolution_clock::now() - blockStart;
+        }
+    };
+
     struct ScopeTimer
     {
+        Metrics::Timer metricsTimer;
+
 #ifdef MEGA_MEASURE_CODE
         ScopeStats& scope;
         high_resolution_clock::time_point blockStart;
         high_resolution_clock::duration diff{};
         bool done = false;
 
-        ScopeTimer(ScopeStats& sm) : scope(sm), blockStart(high_resolution_clock::now())
+        ScopeTimer(ScopeStats& sm) : metricsTimer(sm.histogram), scope(sm), blockStart(high_resolution_clock::now())
         {
             ++scope.starts;
         }
@@ -936,6 +1103,8 @@ namespace CodeCounter
         }
         void complete()
         {
+            metricsTimer.stop();
+
             // can be called early in which case the destructor's call is ignored
             if (!done)
             {
@@ -948,8 +1117,8 @@ namespace CodeCounter
             }
         }
 #else
-        ScopeTimer(ScopeStats& sm) {}
-        void complete() {}
+        ScopeTimer(ScopeStats& sm) : metricsTimer(sm.histogram) {}
+        void complete() { metricsTimer.stop(); }
 #endif
     };
 }
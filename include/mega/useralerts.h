@@ -91,6 +91,12 @@ namespace UserAlert
     static Base* unserializeNewUpdSched(string*, unsigned id);
     using handle_alerttype_map_t = map<handle, nameid>;
 
+    // alerts about the nodes of a share list the handles of this many of them, and count the rest
+    static const size_t MAX_LISTED_NODES = 100;
+
+    // append 'handles' to 'listed' while it's below MAX_LISTED_NODES, and count the rest in 'notListed'
+    void appendListed(vector<handle>& listed, size_t& notListed, const vector<handle>& handles);
+
     struct Base : public Cacheable
     {
         // shared fields from the notification or action
@@ -237,6 +243,14 @@ namespace UserAlert
         vector<handle> fileNodeHandles;
         vector<handle> folderNodeHandles;
 
+        // the nodes beyond MAX_LISTED_NODES, read from the node DB when needed
+        // (see MegaApi::getUserAlertNodes())
+        size_t fileNodesNotListed = 0;
+        size_t folderNodesNotListed = 0;
+
+        size_t fileCount() const { return fileNodeHandles.size() + fileNodesNotListed; }
+        size_t folderCount() const { return folderNodeHandles.size() + folderNodesNotListed; }
+
         NewSharedNodes(UserAlertRaw& un, unsigned int id);
         NewSharedNodes(handle uh, handle ph, m_time_t timestamp, unsigned int id,
                        vector<handle>&& fileHandles, vector<handle>&& folderHandles);
@@ -250,6 +264,9 @@ namespace UserAlert
     struct RemovedSharedNode : public Base
     {
         vector<handle> nodeHandles;
+        size_t nodesNotListed = 0; // beyond MAX_LISTED_NODES
+
+        size_t count() const { return nodeHandles.size() + nodesNotListed; }
 
         RemovedSharedNode(UserAlertRaw& un, unsigned int id);
         RemovedSharedNode(handle uh, m_time_t timestamp, unsigned int id,
@@ -498,26 +515,33 @@ private:
     bool provisionalmode;
     std::vector<UserAlert::Base*> provisionals;
 
+    // the nodes noted under a parent for a user: all are counted, but only the first
+    // MAX_LISTED_NODES of each kind are kept, as the alert made of them lists no more.
+    // The others are told by their Node::changed flags (see findNotedSharedNode())
     struct ff {
         m_time_t timestamp = 0;
         UserAlert::handle_alerttype_map_t alertTypePerFileNode;
         UserAlert::handle_alerttype_map_t alertTypePerFolderNode;
+        size_t filesNotListed = 0;
+        size_t foldersNotListed = 0;
+        nameid alertTypeNotListed = 0;
 
-        vector<handle> fileHandles() const
+        bool empty() const
         {
-            vector<handle> v;
-            std::transform(alertTypePerFileNode.begin(), alertTypePerFileNode.end(), std::back_inserter(v), [](const pair<handle, nameid>& p) { return p.first; });
-            return v;
+            return alertTypePerFileNode.empty() && alertTypePerFolderNode.empty() && !filesNotListed && !foldersNotListed;
         }
 
-        vector<handle> folderHandles() const
+        // append the handles of 'nodes' to 'v', which the alert made of them takes over
+        static void appendHandles(const UserAlert::handle_alerttype_map_t& nodes, vector<handle>& v)
         {
-            vector<handle> v;
-            std::transform(alertTypePerFolderNode.begin(), alertTypePerFolderNode.end(), std::back_inserter(v), [](const pair<handle, nameid>& p) { return p.first; });
-            return v;
+            v.reserve(v.size() + nodes.size());
+            for (auto& p : nodes)
+            {
+                v.push_back(p.first);
+            }
         }
     };
-    using notedShNodesMap = map<pair<handle, handle>, ff>;
+    using notedShNodesMap = map<pair<handle, handle>, ff>; // by (parent, user)
     notedShNodesMap notedSharedNodes;
     notedShNodesMap deletedSharedNodesStash;
     bool notingSharedNodes;
@@ -529,19 +553,27 @@ private:
     void clearNotedSharedMembers();
 
     void trimAlertsToMaxCount(); // mark as removed the excess from 200
+
+    // where the DB table stores alerts apart (see DbTable::putalert()), it keeps the newest
+    // MAX_STORED_ALERTS and only the newest ALERTS_IN_MEMORY are kept in `alerts`
+    static const size_t MAX_STORED_ALERTS = 200;
+    static const size_t ALERTS_IN_MEMORY = 50;
+    bool storedApart() const;
+    void evictAlerts(); // drop the oldest alerts from memory, down to ALERTS_IN_MEMORY
+    UserAlert::Base* unserialize(string* d, uint32_t dbid);
     void notifyAlert(UserAlert::Base* alert, bool seen, int tag);
 
     UserAlert::Base* findAlertToCombineWith(const UserAlert::Base* a, nameid t) const;
 
     bool containsRemovedNodeAlert(handle nh, const UserAlert::Base* a) const;
-    // Returns param `a` downcasted if `nh` is found and erased; `nullptr` otherwise
-    UserAlert::NewSharedNodes* eraseNodeHandleFromNewShareNodeAlert(handle nh, UserAlert::Base* a);
-    // Returns param `a` downcasted if `nh` is found and erased; `nullptr` otherwise
-    UserAlert::RemovedSharedNode* eraseNodeHandleFromRemovedSharedNode(handle nh, UserAlert::Base* a);
-    pair<bool, UserAlert::handle_alerttype_map_t::difference_type>
-        findNotedSharedNodeIn(handle nodeHandle, const notedShNodesMap& notedSharedNodesMap) const;
+    // Returns param `a` downcasted if `n` is found and erased; `nullptr` otherwise
+    UserAlert::NewSharedNodes* eraseNodeHandleFromNewShareNodeAlert(Node* n, UserAlert::Base* a);
+    // Returns param `a` downcasted if `n` is found and erased; `nullptr` otherwise
+    UserAlert::RemovedSharedNode* eraseNodeHandleFromRemovedSharedNode(Node* n, UserAlert::Base* a);
+    // the entry `n` is noted in, or end(); in O(log) of the entries
+    notedShNodesMap::const_iterator findNotedSharedNode(const Node* n, const notedShNodesMap& notedSharedNodesMap) const;
     bool isSharedNodeNotedAsRemoved(handle nodeHandleToFind) const;
-    bool isSharedNodeNotedAsRemovedFrom(handle nodeHandleToFind, const notedShNodesMap& notedSharedNodesMap) const;
+    bool isSharedNodeNotedAsRemovedFrom(const Node* n, const notedShNodesMap& notedSharedNodesMap) const;
     bool removeNotedSharedNodeFrom(notedShNodesMap::iterator itToNodeToRemove, Node* node, notedShNodesMap& notedSharedNodesMap);
     bool removeNotedSharedNodeFrom(Node* n, notedShNodesMap& notedSharedNodesMap);
     bool setNotedSharedNodeToUpdate(Node* n);
@@ -588,6 +620,12 @@ public:
     void initscalerts(); // persist alerts received from sc50
     void purgescalerts(); // persist alerts from action packets
     bool unserializeAlert(string* d, uint32_t dbid);
+    void loadStoredAlerts(); // once `statecache` is read: move its alerts to their store, and load the newest
+
+    // the alerts from the offset-th newest one, newest first. Those out of `alerts` are read from
+    // their store into 'loaded', which owns them
+    void getAlerts(size_t offset, size_t count, vector<UserAlert::Base*>& result, vector<unique_ptr<UserAlert::Base>>& loaded);
+    size_t unseenCount() const;
 
     // stash removal-alert noted nodes
     void convertStashedDeletedSharedNodes();
@@ -605,6 +643,9 @@ public:
 
     // re-init eg. on logout
     void clear();
+
+    // add the approximate memory held by the alerts
+    void addMemoryUsage(MemoryReport& report) const;
 };
 
 
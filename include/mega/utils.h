@@ -23,9 +23,11 @@
 #define MEGA_UTILS_H 1
 
 #include <type_traits>
+#include <atomic>
 #include <condition_variable>
 #include <thread>
 #include <mutex>
+#include <unordered_set>
 
 #include "types.h"
 
@@ -80,6 +82,10 @@ struct MEGA_API ChunkedHash
 
     static m_off_t chunkfloor(m_off_t);
     static m_off_t chunkceil(m_off_t, m_off_t limit = -1);
+
+    // chunk number containing position p, and the start position of chunk number i
+    static size_t chunkindex(m_off_t p);
+    static m_off_t chunkpos(size_t i);
 };
 
 /**
@@ -433,6 +439,9 @@ public:
     static string toUpperUtf8(const string& text);
     static string toLowerUtf8(const string& text);
 
+    // all bytes below 0x80 (so the text is its own NFC/NFD form, one code point per byte)
+    static bool isAscii(const char* data, size_t size);
+
     // Platform-independent case-insensitive comparison.
     static int icasecmp(const std::string& lhs,
                         const std::string& rhs,
@@ -486,6 +495,14 @@ std::string webdavnameescape(const std::string &value);
 
 void tolower_string(std::string& str);
 
+// natural order of names (case-insensitive, digits compared by numeric value):
+// negative if i goes first, positive if j goes first, 0 if they are equivalent
+int naturalsorting_compare(const char *i, const char *j);
+
+// collation key for naturalsorting_compare(): comparing two keys bytewise
+// (memcmp, std::string::compare, SQLite BLOB order) gives the natural order
+std::string naturalsortingKey(const std::string& name);
+
 #ifdef __APPLE__
 int macOSmajorVersion();
 #endif
@@ -517,7 +534,13 @@ class chunkmac_map
         bool isMacsmacSoFar() { return finished && offset == unsigned(-1); }
     };
 
-    map<m_off_t, ChunkMAC> mMacMap;
+    // Entries are stored contiguously, indexed by chunk number (see ChunkedHash::chunkindex)
+    // relative to mFirstIndex.  mPresent flags which slots actually hold an entry.
+    // Slots in front of the macsmac-so-far entry are trimmed as the collapsing advances.
+    vector<ChunkMAC> mMacs;
+    vector<bool> mPresent;
+    size_t mFirstIndex = 0;
+    size_t mCount = 0;
 
     // we collapse the leading consecutive entries, for large files.
     // this is the map key for how far that collapsing has progressed
@@ -525,6 +548,45 @@ class chunkmac_map
 
     m_off_t progresscontiguous = 0;
 
+    // returns the entry for the chunk starting at pos, creating it if necessary
+    ChunkMAC& entryAt(m_off_t pos);
+
+    // returns the entry for the chunk starting at pos, or nullptr if there is none
+    ChunkMAC* findEntry(m_off_t pos);
+
+    void eraseEntry(m_off_t pos);
+
+    // index (into mMacs) of the first present slot at or after i, or mMacs.size()
+    size_t nextPresent(size_t i) const;
+
+    // drop leading slots that no longer hold an entry
+    void trimFront();
+
+public:
+    // A contiguous run of finished chunk macs, snapshotted so that it can be folded
+    // into the macsmac on a worker thread while the transfer carries on.
+    // The CBC chain is inherently serial, so segments of one transfer are folded one at a time, in order.
+    struct MacsmacSegment
+    {
+        // macsmacSoFarPos when the segment was taken
+        m_off_t prevSoFarPos = -1;
+
+        // position of the last chunk in the segment, which becomes the new macsmac-so-far entry
+        m_off_t endPos = -1;
+
+        // on input the macsmac so far (zeros if none); on output the folded result
+        byte mac[SymmCipher::BLOCKSIZE];
+
+        std::vector<std::array<byte, SymmCipher::BLOCKSIZE>> macs;
+        std::atomic<bool> done{false};
+
+        // safe to call on any thread, with a cipher keyed with the transfer key
+        void fold(SymmCipher& cipher);
+    };
+
+private:
+    std::shared_ptr<MacsmacSegment> mPendingSegment;
+
 
 public:
     int64_t macsmac(SymmCipher *cipher);
@@ -539,35 +601,165 @@ public:
     bool finishedAt(m_off_t pos);
     m_off_t updateContiguousProgress(m_off_t fileSize);
     void updateMacsmacProgress(SymmCipher *cipher);
+
+    // Asynchronous alternative to updateMacsmacProgress: returns the next segment to fold
+    // (or nullptr if there is nothing worth folding, or a segment is still in flight).
+    // The map itself is unchanged until applyMacsmacSegment() picks up the finished result,
+    // so macsmac() and serialize() stay correct in the meantime.
+    std::shared_ptr<MacsmacSegment> nextMacsmacSegment();
+    bool applyMacsmacSegment();
     void copyEntriesTo(chunkmac_map& other);
     void copyEntryTo(m_off_t pos, chunkmac_map& other);
     void debugLogOuputMacs();
 
-    void ctr_encrypt(m_off_t chunkid, SymmCipher *cipher, byte *chunkstart, unsigned chunksize, m_off_t startpos, int64_t ctriv, bool finishesChunk);
+    // plain: where to read the chunk from instead of chunkstart, if not null
+    void ctr_encrypt(m_off_t chunkid, SymmCipher *cipher, byte *chunkstart, unsigned chunksize, m_off_t startpos, int64_t ctriv, bool finishesChunk, const byte* plain = nullptr);
     void ctr_decrypt(m_off_t chunkid, SymmCipher *cipher, byte *chunkstart, unsigned chunksize, m_off_t startpos, int64_t ctriv, bool finishesChunk);
 
     size_t size() const
     {
-        return mMacMap.size();
+        return mCount;
     }
     void clear()
     {
-        mMacMap.clear();
+        mMacs.clear();
+        mPresent.clear();
+        mFirstIndex = 0;
+        mCount = 0;
         macsmacSoFarPos = -1;
         progresscontiguous = 0;
+        mPendingSegment.reset();
     }
     void swap(chunkmac_map& other) {
-        mMacMap.swap(other.mMacMap);
+        mMacs.swap(other.mMacs);
+        mPresent.swap(other.mPresent);
+        std::swap(mFirstIndex, other.mFirstIndex);
+        std::swap(mCount, other.mCount);
+        mPendingSegment.swap(other.mPendingSegment);
         std::swap(macsmacSoFarPos, other.macsmacSoFarPos);
         std::swap(progresscontiguous, other.progresscontiguous);
     }
 };
 
+// Wire encoding of one field for CacheableWriter::serializefields() and CacheableReader::unserializefields(),
+// the same as the matching serializeXXX() / unserializeXXX() call: arithmetic types as their raw bytes
+// (serializei64, serializehandle, serializebool, ...) and strings with a 16 bit length (serializestring).
+// minsize() is what the field takes at least, so a record's fixed part is bounds-checked once.
+template<typename T, typename = void>
+struct CacheableField;
+
+template<typename T>
+struct CacheableField<T, typename std::enable_if<std::is_arithmetic<T>::value>::type>
+{
+    static size_t minsize() { return sizeof(T); }
+    static size_t size(const T&) { return sizeof(T); }
+    static char* write(char* out, const T& field) { memcpy(out, &field, sizeof(T)); return out + sizeof(T); }
+    static bool read(const char*& ptr, const char*, T& field) { field = MemAccess::get<T>(ptr); ptr += sizeof(T); return true; }
+};
+
+template<>
+struct CacheableField<string>
+{
+    static size_t minsize() { return sizeof(unsigned short); }
+    static size_t size(const string& field) { return sizeof(unsigned short) + (unsigned short)field.size(); }
+    static char* write(char* out, const string& field)
+    {
+        unsigned short ll = (unsigned short)field.size();
+        memcpy(out, &ll, sizeof(ll));
+        memcpy(out + sizeof(ll), field.data(), ll);
+        return out + sizeof(ll) + ll;
+    }
+    static bool read(const char*& ptr, const char* end, string& field)
+    {
+        unsigned short ll = MemAccess::get<unsigned short>(ptr);
+        if (ptr + sizeof(ll) + ll > end)
+        {
+            return false;
+        }
+        field.assign(ptr + sizeof(ll), ll);
+        ptr += sizeof(ll) + ll;
+        return true;
+    }
+};
+
+namespace cacheablefields {
+
+template<typename... Fields>
+struct MinSize;
+
+template<>
+struct MinSize<>
+{
+    static size_t get() { return 0; }
+};
+
+template<typename T, typename... Rest>
+struct MinSize<T, Rest...>
+{
+    static size_t get() { return CacheableField<typename std::decay<T>::type>::minsize() + MinSize<Rest...>::get(); }
+};
+
+inline size_t size()
+{
+    return 0;
+}
+
+template<typename T, typename... Rest>
+size_t size(const T& field, const Rest&... rest)
+{
+    return CacheableField<T>::size(field) + size(rest...);
+}
+
+inline char* write(char* out)
+{
+    return out;
+}
+
+template<typename T, typename... Rest>
+char* write(char* out, const T& field, const Rest&... rest)
+{
+    return write(CacheableField<T>::write(out, field), rest...);
+}
+
+inline bool read(const char*&, const char*)
+{
+    return true;
+}
+
+// a field may use the data up to 'end' less what the fields after it take at least
+template<typename T, typename... Rest>
+bool read(const char*& ptr, const char* end, T&& field, Rest&&... rest)
+{
+    return CacheableField<typename std::decay<T>::type>::read(ptr, end - MinSize<Rest...>::get(), field)
+        && read(ptr, end, std::forward<Rest>(rest)...);
+}
+
+} // namespace cacheablefields
+
 struct CacheableWriter
 {
     CacheableWriter(string& d);
     string& dest;
 
+    // a node handle in its 6 bytes, as serializenodehandle()
+    struct NodeHandle
+    {
+        enum { SIZE = 6 };
+        handle h;
+    };
+
+    // append a record (or a run of fields of one) in a single step: the space for all of them is
+    // reserved at once and they are written in order, as the individual serializeXXX() calls would
+    template<typename... Fields>
+    void serializefields(const Fields&... fields)
+    {
+        size_t at = dest.size();
+        dest.resize(at + cacheablefields::size(fields...));
+        char* end = cacheablefields::write(&dest[at], fields...);
+        assert(end == &dest[0] + dest.size());
+        (void)end;
+    }
+
     void serializebinary(byte* data, size_t len);
     void serializecstr(const char* field, bool storeNull);  // may store the '\0' also for backward compatibility. Only use for utf8!  (std::string storing double byte chars will only store 1 byte)
     void serializepstr(const string* field);  // uses string size() not strlen
@@ -603,6 +795,29 @@ struct CacheableReader
     const char* end;
     unsigned fieldnum;
 
+    // a node handle in its 6 bytes, as unserializenodehandle()
+    struct NodeHandle
+    {
+        handle& h;
+    };
+
+    // counterpart of CacheableWriter::serializefields(): the fixed part of the fields is bounds-checked
+    // once, then only the variable length ones are; nothing is consumed if the fixed part is too short
+    template<typename... Fields>
+    bool unserializefields(Fields&&... fields)
+    {
+        if (size_t(end - ptr) < cacheablefields::MinSize<Fields...>::get())
+        {
+            return false;
+        }
+        if (!cacheablefields::read(ptr, end, std::forward<Fields>(fields)...))
+        {
+            return false;
+        }
+        fieldnum += unsigned(sizeof...(Fields));
+        return true;
+    }
+
     bool unserializebinary(byte* data, size_t len);
     bool unserializecstr(string& s, bool removeNull); // set removeNull if this field stores the terminating '\0' at the end
     bool unserializestring(string& s);
@@ -630,6 +845,31 @@ struct CacheableReader
     bool hasdataleft() { return end > ptr; }
 };
 
+template<>
+struct CacheableField<CacheableWriter::NodeHandle>
+{
+    static size_t minsize() { return CacheableWriter::NodeHandle::SIZE; }
+    static size_t size(const CacheableWriter::NodeHandle&) { return CacheableWriter::NodeHandle::SIZE; }
+    static char* write(char* out, const CacheableWriter::NodeHandle& field)
+    {
+        memcpy(out, &field.h, CacheableWriter::NodeHandle::SIZE);
+        return out + CacheableWriter::NodeHandle::SIZE;
+    }
+};
+
+template<>
+struct CacheableField<CacheableReader::NodeHandle>
+{
+    static size_t minsize() { return CacheableWriter::NodeHandle::SIZE; }
+    static bool read(const char*& ptr, const char*, const CacheableReader::NodeHandle& field)
+    {
+        field.h = 0;
+        memcpy(&field.h, ptr, CacheableWriter::NodeHandle::SIZE);
+        ptr += CacheableWriter::NodeHandle::SIZE;
+        return true;
+    }
+};
+
 template<typename T, typename U>
 void hashCombine(T& seed, const U& v)
 {
@@ -655,10 +895,50 @@ struct MegaClientAsyncQueue
     void push(std::function<void(SymmCipher&)> f, bool discardable);
     void clearDiscardable();
 
+    // While a Batch is alive, push() collects the work locally, and it is all handed to the
+    // workers in one go (one lock, one wakeup) when the outermost Batch ends.
+    // Only used on the client thread, eg. around a round of TransferSlot::doio() calls,
+    // so that the pieces of all active transfers are queued together.
+    struct Batch
+    {
+        explicit Batch(MegaClientAsyncQueue& q);
+        ~Batch();
+
+    private:
+        MegaClientAsyncQueue& mQueue;
+    };
+
+    // number of entries waiting for a worker, and the peak since the last call with reset
+    size_t queueDepth();
+    size_t peakQueueDepth(bool reset);
+
+    // workers running its entries (the shared ones, in shared mode)
+    size_t threadCount() const;
+
+    // true while a Batch holds back what's pushed (client thread only)
+    bool batching() const { return mBatchDepth > 0; }
+
+    // Queues created afterwards (with threads) are served by the process-wide SharedAsyncWorkers
+    // instead of threads of their own. For processes hosting many clients
+    static void setSharedWorkers(bool shared);
+    bool sharedWorkers() const { return mShared; }
+
     MegaClientAsyncQueue(Waiter& w, unsigned threadCount);
     ~MegaClientAsyncQueue();
 
 private:
+    friend class SharedAsyncWorkers;
+    static std::atomic<bool> sSharedWorkers;
+    bool mShared = false;
+    unsigned mRunning = 0;      // entries being run by shared workers (under mMutex)
+    bool mReady = false;        // in the list of SharedAsyncWorkers (under its mutex)
+
+    // shared mode: a worker pins the queue (so it isn't deleted), runs its oldest entry, if any,
+    // and unpins it, which tells whether entries are left
+    void pin();
+    void runOne(SymmCipher& cipher);
+    bool unpin();
+
     Waiter& mWaiter;
     std::mutex mMutex;
     std::condition_variable mConditionVariable;
@@ -675,10 +955,228 @@ private:
     std::deque<Entry> mQueue;
     std::vector<std::thread> mThreads;
     SymmCipher mZeroThreadsCipher;
+    size_t mPeakQueueDepth = 0;
+
+    // client thread only
+    unsigned mBatchDepth = 0;
+    std::deque<Entry> mBatched;
+    void flushBatch();
 
     void asyncThreadLoop();
 };
 
+// Process-wide workers for the MegaClientAsyncQueues in shared mode. Queues with entries wait
+// in a ready list, and each worker takes the first, runs one of its entries and puts it back at
+// the end if it has more: clients are served in turn, whatever the length of their queues.
+class MEGA_API SharedAsyncWorkers
+{
+public:
+    static SharedAsyncWorkers& instance();
+
+    // 'queue' has entries to run
+    void ready(MegaClientAsyncQueue& queue);
+
+    // 'queue' is going away, and it has no entries left
+    void remove(MegaClientAsyncQueue& queue);
+
+    size_t threadCount() const { return mThreads.size(); }
+
+    explicit SharedAsyncWorkers(unsigned threadCount);
+    ~SharedAsyncWorkers();
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mConditionVariable;
+    std::deque<MegaClientAsyncQueue*> mReady;
+    std::vector<std::thread> mThreads;
+    bool mShutdown = false;
+    unsigned mRemoving = 0;
+
+    void threadLoop();
+};
+
+// Process-wide settings and stats of the threads started by the SDK, by role.
+// Pools take their size from here as they start (if one is configured), and every thread applies
+// the CPU affinity and nice level of its role when it starts (Linux only, ignored elsewhere).
+// Threads report the time they spend on work items (Busy), and pools their queued items.
+class MEGA_API ThreadTopology
+{
+public:
+    enum Role
+    {
+        CLIENT = 0,     // MegaApi thread, running MegaClient::exec()
+        CRYPTO,         // MegaClientAsyncQueue workers
+        GFX,            // GfxProc threads
+        SCAN,           // ScanService workers
+        FINGERPRINT,    // FingerprintPrefetcher workers of syncs
+        NUM_ROLES
+    };
+
+    struct Settings
+    {
+        unsigned poolSize = 0;      // 0: the pool's own default
+        std::vector<int> cpus;      // empty: any CPU
+        int nice = 0;               // 0: inherited
+    };
+
+    // only affects the threads started afterwards
+    static void configure(Role role, const Settings& settings);
+    static Settings settings(Role role);
+
+    // the configured size of the pool, or 'defaultSize'
+    static unsigned poolSize(Role role, unsigned defaultSize);
+
+    // called by the threads of 'role' when they start and before they end
+    static void threadStarted(Role role);
+    static void threadStopped(Role role);
+
+    // accounts the lifetime of the object as busy time of a thread of 'role'
+    class Busy
+    {
+    public:
+        explicit Busy(Role role);
+        ~Busy();
+
+    private:
+        Role mRole;
+        std::chrono::steady_clock::time_point mStart;
+    };
+
+    // items queued (positive) or taken (negative) for the threads of 'role'
+    static void queued(Role role, long long delta);
+
+    struct Stats
+    {
+        unsigned threads = 0;
+        long long queueDepth = 0;
+        double utilization = 0;     // busy time over the time of all its threads, since the previous reset
+    };
+    static Stats stats(Role role, bool reset);
+};
+
+// Process-wide pool for PBKDF2-HMAC-SHA512 password derivations.
+// When many MegaClient instances in one process log in together, each 100000-iteration derivation
+// runs on a shared worker instead of the client thread, and the client's waiter is notified when
+// the key is ready.  The client polls done on its own thread and consumes derivedKey from there.
+class MEGA_API KeyDerivationService
+{
+public:
+    struct Request
+    {
+        string password;           // wiped once derived, or when cancelled
+        string salt;
+        unsigned iterations = 0;
+        size_t keyLength = 0;
+
+        // written by the worker before done is set
+        string derivedKey;
+        std::atomic<bool> done { false };
+
+    private:
+        friend class KeyDerivationService;
+        Waiter* waiter = nullptr;  // guarded by the service mutex, cleared by cancel()
+        bool cancelled = false;
+    };
+    typedef std::shared_ptr<Request> RequestPtr;
+
+    static KeyDerivationService& instance();
+
+    // queue a derivation; waiter (may be null) is notified once request->done is set
+    RequestPtr derive(const string& password, const string& salt, unsigned iterations, size_t keyLength, Waiter* waiter);
+
+    // the request's waiter is no longer notified, and a request still queued is not derived at all
+    void cancel(const RequestPtr& request);
+
+    // derivations queued but not yet picked up by a worker
+    size_t queueDepth();
+
+    explicit KeyDerivationService(unsigned threadCount);
+    ~KeyDerivationService();
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mConditionVariable;
+    std::deque<RequestPtr> mQueue;
+    std::vector<std::thread> mThreads;
+    bool mShutdown = false;
+
+    void threadLoop();
+};
+
+// Where the time of each iteration of the client loop goes: from MegaClient::wait() to the end of the
+// following exec(), less the time blocked in the waiter. Every iteration feeds the "MegaClient_loop"
+// histogram of Metrics. An iteration longer than the slow threshold is logged with its top contributors,
+// and the time of each subsystem in slow iterations is added to the "MegaClient_slowLoop_<section>" counters.
+// Sections nest: time is charged to the innermost one only. Used on the client thread only.
+class MEGA_API ExecLoopProfiler
+{
+public:
+    enum Section { OTHER, TRANSFERS, SC, CS, SYNC, GFX, DB_COMMIT, HTTPIO, WAIT, NUM_SECTIONS };
+
+    class Scope
+    {
+    public:
+        Scope(ExecLoopProfiler& profiler, Section section);
+        ~Scope() { stop(); }
+
+        // can be called early, in which case the destructor's call is ignored
+        void stop();
+
+    private:
+        ExecLoopProfiler& mProfiler;
+        Section mPrevious;
+        bool mStopped = false;
+    };
+
+    struct Iteration
+    {
+        std::chrono::steady_clock::duration total{};
+        std::array<std::chrono::steady_clock::duration, NUM_SECTIONS> sections{};
+
+        // "812 ms: sc 640 ms, db commit 150 ms, other 22 ms"
+        string describe(unsigned topContributors = 3) const;
+    };
+
+    ExecLoopProfiler();
+
+    void beginIteration();
+    void endIteration();
+
+    // 0 to disable the slow iteration breakdown (the histogram is still fed)
+    void setSlowThreshold(std::chrono::milliseconds threshold) { mSlowThreshold = threshold; }
+    std::chrono::milliseconds slowThreshold() const { return mSlowThreshold; }
+
+    // time a section may take per iteration before its work should be resumed in the next one
+    // (0, the default, is no limit). Checked by the work itself, with overBudget()
+    void setBudget(Section section, std::chrono::milliseconds budget) { mBudgets[section] = budget; }
+    bool overBudget(Section section) const;
+
+    uint64_t iterations() const { return mIterations; }
+    uint64_t slowIterations() const { return mSlowIterations; }
+
+    // the most recent slow iterations, oldest first
+    const std::deque<Iteration>& recentSlowIterations() const { return mRecentSlow; }
+
+    static const char* sectionName(Section section);
+
+private:
+    void switchTo(Section section);
+
+    Section mCurrent = OTHER;
+    bool mInIteration = false;
+    std::chrono::steady_clock::time_point mSectionStart;
+    Iteration mIteration;
+
+    std::chrono::milliseconds mSlowThreshold{500};
+    std::array<std::chrono::milliseconds, NUM_SECTIONS> mBudgets{};
+    uint64_t mIterations = 0;
+    uint64_t mSlowIterations = 0;
+    std::deque<Iteration> mRecentSlow;
+
+    Metrics::Histogram mHistogram;
+    std::array<Metrics::Counter, NUM_SECTIONS> mSlowCounters;
+};
+
 template<class T>
 struct ThreadSafeDeque
 {
@@ -956,6 +1454,32 @@ bool readLines(const std::string& input, string_vector& destination);
 bool wildcardMatch(const string& text, const string& pattern);
 bool wildcardMatch(const char* text, const char* pattern);
 
+// Patterns in the syntax of wildcardMatch(), compiled for testing many texts against all of
+// them: patterns without wildcards are hashed, the rest are kept in a trie by their literal
+// prefix, so a text is only matched against the patterns whose prefix it starts with.
+class MEGA_API WildcardPatterns
+{
+public:
+    void add(const string& pattern);
+    void clear();
+    bool empty() const;
+
+    // does text match any of the patterns?
+    bool matches(const string& text) const;
+
+private:
+    struct PrefixNode
+    {
+        map<char, unique_ptr<PrefixNode>> children;
+
+        // patterns whose literal prefix ends here
+        vector<string> patterns;
+    };
+
+    std::unordered_set<string> mLiterals;
+    PrefixNode mPrefixes;
+};
+
 struct MEGA_API FileSystemAccess;
 
 // generate a new drive id
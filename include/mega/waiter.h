@@ -64,10 +64,39 @@ struct MEGA_API Waiter
     // force a wakeup
     virtual void notify() = 0;
 
+    // threads forcing wakeups, counted for the performance report
+    enum NotifySource
+    {
+        NOTIFY_ASYNCQUEUE,
+        NOTIFY_GFX,
+        NOTIFY_SCAN,
+        NOTIFY_DIRNOTIFY,
+        NOTIFY_FILEIO,
+        NOTIFY_OTHER,
+        NOTIFY_SOURCES
+    };
+
+    // force a wakeup on behalf of 'source'
+    void notifyBy(NotifySource source);
+
+    // wakeups requested by each source, and the ones that reached the OS
+    // (the rest found a wakeup already pending for the current wait)
+    struct NotifyStats
+    {
+        uint64_t bySource[NOTIFY_SOURCES] = {};
+        uint64_t signalled = 0;
+    };
+    NotifyStats notifyStats(bool reset);
+    static const char* notifySourceName(NotifySource source);
+
     static const int NEEDEXEC = 1;
     static const int HAVESTDIN = 2;
 
     virtual ~Waiter() { }
+
+protected:
+    std::atomic<uint64_t> mNotifyCount[NOTIFY_SOURCES] {};
+    std::atomic<uint64_t> mSignalled{0};
 };
 } // namespace
 
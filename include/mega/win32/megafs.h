@@ -102,6 +102,11 @@ public:
 
     bool fsStableIDs(const LocalPath& path) const override;
 
+    bool changeJournalPosition(const LocalPath& path, handle& journalId, m_off_t& position) const override;
+
+    bool readChangeJournal(const LocalPath& path, handle journalId, m_off_t position,
+                           std::function<void(handle, handle, const LocalPath&)> f) const override;
+
     std::set<WinDirNotify*> dirnotifys;
 #endif
 
@@ -178,6 +183,7 @@ public:
     bool fwrite(const byte *, unsigned, m_off_t);
 
     bool ftruncate() override;
+    bool fpreallocate(m_off_t) override;
 
     bool sysread(byte *, unsigned, m_off_t) override;
     bool sysstat(m_time_t*, m_off_t*) override;
@@ -52,6 +52,7 @@
 #include <string>   // the MEGA SDK assumes writable, contiguous string::data()
 #include <sstream>
 #include <map>
+#include <unordered_map>
 #include <deque>
 #include <set>
 #include <iterator>
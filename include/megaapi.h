@@ -52,9 +52,12 @@ typedef uint64_t MegaHandle;
 class MegaListener;
 class MegaRequestListener;
 class MegaTransferListener;
+class MegaTransferProgressList;
 class MegaScheduledCopyListener;
 class MegaGlobalListener;
 class MegaTreeProcessor;
+class MegaNodeView;
+class MegaNodeViewVisitor;
 class MegaAccountDetails;
 class MegaAchievementsDetails;
 class MegaPricing;
@@ -70,6 +73,7 @@ class MegaEvent;
 class MegaTransfer;
 class MegaScheduledCopy;
 class MegaSync;
+class MegaSyncStats;
 class MegaStringList;
 class MegaNodeList;
 class MegaUserList;
@@ -90,6 +94,8 @@ class MegaScheduledFlags;
 class MegaScheduledRules;
 class MegaIntegerMap;
 class MegaIntegerList;
+class MegaMetricsSnapshot;
+class MegaMemoryReport;
 
 #if defined(SWIG)
     #define MEGA_DEPRECATED
@@ -901,7 +907,8 @@ class MegaNode
          * @param changeType The type of change to check. It can be one of the following values:
          *
          * - MegaNode::CHANGE_TYPE_REMOVED         = 0x01
-         * Check if the node is being removed
+         * Check if the node is being removed. When a big folder is removed, its descendants
+         * may not be notified separately: they are removed with it
          *
          * - MegaNode::CHANGE_TYPE_ATTRIBUTES      = 0x02
          * Check if an attribute of the node has changed, usually the namespace name
@@ -2289,6 +2296,168 @@ public:
     virtual int size() const;
 };
 
+/**
+ * @brief Figures of the SDK metrics at one point in time
+ *
+ * The SDK keeps process-wide counters, gauges and latency histograms of its main code paths
+ * (the loop of the client thread, network events, transfer I/O, processing of server responses...)
+ * all the time. Some very frequent ones are sampled, and their figures are estimates.
+ *
+ * @see MegaApi::getMetricsSnapshot
+ */
+class MegaMetricsSnapshot
+{
+public:
+    enum
+    {
+        TYPE_COUNTER = 0,       // Monotonic count
+        TYPE_GAUGE = 1,         // Current value
+        TYPE_HISTOGRAM = 2,     // Distribution of durations
+    };
+
+    virtual ~MegaMetricsSnapshot();
+    virtual MegaMetricsSnapshot *copy() const;
+
+    /**
+     * @brief Returns the number of metrics
+     * @return Number of metrics
+     */
+    virtual int size() const;
+
+    /**
+     * @brief Returns the name of the metric at the position i
+     *
+     * The MegaMetricsSnapshot retains the ownership of the returned string.
+     *
+     * @param i Position of the metric
+     * @return Name of the metric, or NULL if the index is not valid
+     */
+    virtual const char *getName(int i) const;
+
+    /**
+     * @brief Returns the type of the metric at the position i
+     * @param i Position of the metric
+     * @return One of the TYPE_* values, or -1 if the index is not valid
+     */
+    virtual int getType(int i) const;
+
+    /**
+     * @brief Returns the value of the metric at the position i
+     *
+     * For TYPE_HISTOGRAM, it's the number of durations recorded.
+     *
+     * @param i Position of the metric
+     * @return Value of the metric, or 0 if the index is not valid
+     */
+    virtual long long getValue(int i) const;
+
+    /**
+     * @brief Returns the sum of the durations recorded by the histogram at the position i
+     * @param i Position of the metric
+     * @return Sum in microseconds, or 0 if the metric is not a histogram
+     */
+    virtual long long getSumMicroseconds(int i) const;
+
+    /**
+     * @brief Returns a percentile of the durations recorded by the histogram at the position i
+     *
+     * The value is the upper bound of the bucket holding that percentile; buckets are at most 12.5% wide.
+     *
+     * @param i Position of the metric
+     * @param percentile Percentile, from 0 to 100 (for example 99 for the 99th percentile)
+     * @return Duration in microseconds, or 0 if the metric is not a histogram or is empty
+     */
+    virtual long long getPercentileMicroseconds(int i, double percentile) const;
+
+    /**
+     * @brief Returns all the metrics in the Prometheus / OpenMetrics text format
+     *
+     * Metric names get the "mega_" prefix, counters the "_total" suffix and histograms,
+     * exported in seconds, the "_seconds" suffix.
+     *
+     * You take the ownership of the returned value. Use delete [] to free it.
+     *
+     * @return Metrics in OpenMetrics text format
+     */
+    virtual char *toOpenMetrics() const;
+};
+
+/**
+ * @brief Approximate memory used by the main subsystems of the SDK at one point in time
+ *
+ * The figures are estimates: the sizes of big collections (like the nodes in RAM or the
+ * LocalNodes of the syncs) are extrapolated from samples, and the overhead of the containers
+ * and the heap is guessed. They are meant to follow trends and spot leaks, not to match
+ * the memory reported by the OS.
+ *
+ * Subsystems reported:
+ * - "nodes": nodes loaded in RAM, with their attributes, keys and shares
+ * - "nodeFingerprints": index of nodes by fingerprint
+ * - "nodePathCache": cached resolutions of paths to nodes
+ * - "recentNodes": cached recent file nodes
+ * - "localNodes": local items of the running syncs
+ * - "transferBuffers": downloaded pieces of transfers and streaming reads, waiting to be written
+ * - "httpRequests": bodies of the ongoing HTTP requests and responses
+ * - "userAlerts": user alerts
+ * - "transferBufferPool": free transfer buffers kept for reuse (shared by all MegaApi objects)
+ * - "streamingBuffers": buffers of the local HTTP and FTP servers (shared by all MegaApi objects)
+ *
+ * @see MegaApi::getMemoryReport
+ */
+class MegaMemoryReport
+{
+public:
+    virtual ~MegaMemoryReport();
+    virtual MegaMemoryReport *copy() const;
+
+    /**
+     * @brief Returns the number of subsystems in the report
+     * @return Number of subsystems
+     */
+    virtual int size() const;
+
+    /**
+     * @brief Returns the name of the subsystem at the position i
+     *
+     * The MegaMemoryReport retains the ownership of the returned string.
+     *
+     * @param i Position of the subsystem
+     * @return Name of the subsystem, or NULL if the index is not valid
+     */
+    virtual const char *getSubsystem(int i) const;
+
+    /**
+     * @brief Returns the number of objects held by the subsystem at the position i
+     * @param i Position of the subsystem
+     * @return Number of objects, or 0 if the index is not valid
+     */
+    virtual long long getObjects(int i) const;
+
+    /**
+     * @brief Returns the approximate memory held by the subsystem at the position i
+     * @param i Position of the subsystem
+     * @return Bytes, or 0 if the index is not valid
+     */
+    virtual long long getBytes(int i) const;
+
+    /**
+     * @brief Returns the approximate memory held by all the subsystems in the report
+     * @return Bytes
+     */
+    virtual long long getTotalBytes() const;
+
+    /**
+     * @brief Returns the report in JSON format
+     *
+     * The format is {"subsystems":[{"name":"nodes","objects":1234,"bytes":567890},...],"bytes":total}
+     *
+     * You take the ownership of the returned value. Use delete [] to free it.
+     *
+     * @return Report in JSON format
+     */
+    virtual char *toJson() const;
+};
+
 /**
  * @brief Represents the outbound sharing of a folder with a user in MEGA
  *
@@ -2481,6 +2650,9 @@ public:
         CHANGE_TYPE_CHAT_OPTIONS    = 0x08,
         CHANGE_TYPE_SCHED_MEETING   = 0x10,
         CHANGE_TYPE_SCHED_OCURR     = 0x20,
+        CHANGE_TYPE_PARTICIPANTS    = 0x40,
+        CHANGE_TYPE_TITLE           = 0x80,
+        CHANGE_TYPE_OWN_PRIV        = 0x100,
     };
 
     virtual ~MegaTextChat();
@@ -2612,6 +2784,15 @@ public:
      * - MegaTextChat::CHANGE_TYPE_SCHED_OCURR     = 0x20
      * Check if scheduled meetings occurrences have changed
      *
+     * - MegaTextChat::CHANGE_TYPE_PARTICIPANTS     = 0x40
+     * Check if the list of peers or their privileges have changed
+     *
+     * - MegaTextChat::CHANGE_TYPE_TITLE            = 0x80
+     * Check if the title has changed
+     *
+     * - MegaTextChat::CHANGE_TYPE_OWN_PRIV         = 0x100
+     * Check if the privilege of the current user has changed
+     *
      * @return true if this chat has an specific change
      */
     virtual bool hasChanged(int changeType) const;
@@ -2641,6 +2822,15 @@ public:
      *
      * - MegaTextChat::CHANGE_TYPE_SCHED_OCURR     = 0x20
      * Check if scheduled meetings occurrences have changed
+     *
+     * - MegaTextChat::CHANGE_TYPE_PARTICIPANTS     = 0x40
+     * Check if the list of peers or their privileges have changed
+     *
+     * - MegaTextChat::CHANGE_TYPE_TITLE            = 0x80
+     * Check if the title has changed
+     *
+     * - MegaTextChat::CHANGE_TYPE_OWN_PRIV         = 0x100
+     * Check if the privilege of the current user has changed
      */
     virtual int getChanges() const;
 
@@ -3491,6 +3681,40 @@ class MegaNodeList
          * @param node MegaNode to be added. The node inserted is a copy from 'node'
          */
         virtual void addNode(MegaNode* node);
+
+        /**
+         * @brief Returns the handle of the node at the position i in the MegaNodeList
+         *
+         * For the lists received in MegaListener::onNodesUpdate and MegaGlobalListener::onNodesUpdate
+         * this doesn't build the MegaNode, which is only created the first time MegaNodeList::get
+         * is called for that position.
+         *
+         * @param i Position of the node in the list
+         * @return Handle of the node, or INVALID_HANDLE if the index is >= the size of the list
+         */
+        virtual MegaHandle getHandle(int i) const;
+
+        /**
+         * @brief Returns the changes of the node at the position i in the MegaNodeList
+         *
+         * As MegaNode::getChanges, without building the MegaNode for the lists received
+         * in MegaListener::onNodesUpdate and MegaGlobalListener::onNodesUpdate.
+         *
+         * @param i Position of the node in the list
+         * @return Bit field with the changes of the node, 0 if the index is >= the size of the list
+         */
+        virtual int getChanges(int i) const;
+
+        /**
+         * @brief Returns the handle of the parent of the node at the position i in the MegaNodeList
+         *
+         * As MegaNode::getParentHandle, without building the MegaNode for the lists received
+         * in MegaListener::onNodesUpdate and MegaGlobalListener::onNodesUpdate.
+         *
+         * @param i Position of the node in the list
+         * @return Handle of the parent node, or INVALID_HANDLE if it has none or the index is >= the size of the list
+         */
+        virtual MegaHandle getParentHandle(int i) const;
 };
 
 /**
@@ -3634,6 +3858,63 @@ class MegaTransferList
         virtual int size();
 };
 
+/**
+ * @brief Progress of the active transfers at a point in time
+ *
+ * Received in MegaTransferListener::onTransfersProgress and MegaListener::onTransfersProgress
+ * when transfer updates are aggregated, see MegaApi::setTransferUpdatePolicy.
+ *
+ * Objects of this class are immutable.
+ */
+class MegaTransferProgressList
+{
+    public:
+        virtual ~MegaTransferProgressList();
+
+        virtual MegaTransferProgressList* copy() const;
+
+        /**
+         * @brief Returns the number of transfers in the list
+         * @return Number of transfers in the list
+         */
+        virtual int size() const;
+
+        /**
+         * @brief Returns the tag of the transfer at the position i, as MegaTransfer::getTag
+         * @param i Position of the transfer in the list
+         * @return Tag of the transfer, 0 if the index is >= the size of the list
+         */
+        virtual int getTag(int i) const;
+
+        /**
+         * @brief Returns the type of the transfer at the position i, as MegaTransfer::getType
+         * @param i Position of the transfer in the list
+         * @return MegaTransfer::TYPE_DOWNLOAD or MegaTransfer::TYPE_UPLOAD, -1 if the index is >= the size of the list
+         */
+        virtual int getType(int i) const;
+
+        /**
+         * @brief Returns the bytes transferred so far by the transfer at the position i
+         * @param i Position of the transfer in the list
+         * @return Transferred bytes, 0 if the index is >= the size of the list
+         */
+        virtual long long getTransferredBytes(int i) const;
+
+        /**
+         * @brief Returns the size of the transfer at the position i
+         * @param i Position of the transfer in the list
+         * @return Total bytes of the transfer, 0 if the index is >= the size of the list
+         */
+        virtual long long getTotalBytes(int i) const;
+
+        /**
+         * @brief Returns the current speed of the transfer at the position i, in bytes per second
+         * @param i Position of the transfer in the list
+         * @return Speed of the transfer, 0 if the index is >= the size of the list
+         */
+        virtual long long getSpeed(int i) const;
+};
+
 /**
  * @brief List of MegaContactRequest objects
  *
@@ -4173,7 +4454,12 @@ class MegaRequest
             TYPE_DEL_SCHEDULED_MEETING                                      = 159,
             TYPE_FETCH_SCHEDULED_MEETING                                    = 160,
             TYPE_FETCH_SCHEDULED_MEETING_OCCURRENCES                        = 161,
-            TOTAL_OF_REQUEST_TYPES                                          = 162,
+            TYPE_SET_ATTR_NODES                                             = 162,
+            TYPE_MOVE_NODES                                                 = 163,
+            TYPE_SEARCH                                                     = 164,
+            TYPE_PUT_SET_ELEMENTS                                           = 165,
+            TYPE_REMOVE_SET_ELEMENTS                                        = 166,
+            TOTAL_OF_REQUEST_TYPES                                          = 167,
         };
 
         virtual ~MegaRequest();
@@ -5014,10 +5300,40 @@ class MegaRequest
          *
          * This value is valid for these requests:
          * - MegaApi::fetchSet
+         * - MegaApi::createSetElement
+         * - MegaApi::createSetElements - The Elements created
          *
          * @return lis of elements in the requested MegaSet, or null if Set not found
          */
         virtual MegaSetElementList* getMegaSetElementList() const;
+
+        /**
+         * @brief Returns a list of nodes
+         *
+         * The SDK retains the ownership of the returned value. It will be valid until
+         * the MegaRequest object is deleted.
+         *
+         * This value is valid for these requests:
+         * - MegaApi::searchAsync - In onRequestUpdate, the nodes found since the previous update.
+         * In onRequestFinish, all the nodes found, in the requested order
+         *
+         * @return List of nodes
+         */
+        virtual MegaNodeList* getMegaNodeList() const;
+
+        /**
+         * @brief Returns a list of integers
+         *
+         * The SDK retains the ownership of the returned value. It will be valid until
+         * the MegaRequest object is deleted.
+         *
+         * This value is valid for these requests:
+         * - MegaApi::createSetElements - The error code of each requested Element, in order
+         * - MegaApi::removeSetElements - The error code of each requested Element, in order
+         *
+         * @return List of integers
+         */
+        virtual MegaIntegerList* getMegaIntegerList() const;
 };
 
 /**
@@ -5052,6 +5368,7 @@ public:
                                               // or -1 if there isn't any operation in progress.
         EVENT_RELOADING                 = 16, // (automatic) reload forced by server (-6 on sc channel)
         EVENT_RELOAD                    = 17, // App should force a reload when receives this event
+        EVENT_NODES_CACHED              = 18, // Nodes loaded from the local cache can be browsed, still catching up
     };
 
     enum
@@ -5635,6 +5952,35 @@ class MegaTransfer
          */
         virtual MegaCancelToken* getCancelToken();
 
+        /**
+         * @brief Returns where the time of the transfer went, to find out why it is slow
+         *
+         * The timeline is a JSON object with:
+         * - "stages": when the latest attempt of the transfer reached each stage, in milliseconds
+         *   since the epoch (0 if not reached): "queued", "started" (got a slot), "urlRequested",
+         *   "urlReceived" (0 if the URLs were cached), "connected", "firstByte" and "completed"
+         * - "attempts": number of times the transfer was started
+         * - "connections": for each connection of the latest attempt (each raid part, for raid
+         *   downloads) the requests done, bytes, total time of the requests and the parts of it
+         *   spent on DNS, connection setup, TLS and until the first byte ("requestMs", "dnsMs",
+         *   "connectMs", "tlsMs", "firstByteMs"), the new connections opened, the times it was
+         *   dropped for being slow ("slowResets") and the speed of its latest request ("lastSpeed")
+         * - "cryptoUs" and "diskUs": time spent encrypting or decrypting the data, and reading
+         *   or writing the local file, in microseconds
+         * - "traceEvents": the stages as events in Chrome's trace event format, so the same string
+         *   can be loaded in chrome://tracing or Perfetto (the thread id is the tag of the transfer)
+         *
+         * The timeline is updated with each MegaTransferListener::onTransferUpdate, and is empty
+         * for transfers that don't go through the transfer engine (streaming, folder transfers).
+         * The DNS, connection and first byte figures are only available with the cURL HTTP client.
+         *
+         * The MegaTransfer object retains the ownership of the returned string. It will be valid
+         * until the MegaTransfer object is deleted.
+         *
+         * @return JSON object with the timeline of the transfer, or an empty string
+         */
+        virtual const char* getTimeline() const;
+
         /**
          * @brief Returns a string that identify the recursive operation stage
          *
@@ -6641,6 +6987,89 @@ class MegaSyncList
         virtual void addSync(MegaSync* sync);
 };
 
+/**
+ * @brief Figures that show what a running sync is waiting on and has spent its time on
+ *
+ * Queue depths are taken when the object is created. Call counts and times accumulate
+ * from the moment the sync was started.
+ *
+ * Objects of this class are immutable.
+ *
+ * @see MegaApi::getSyncStats
+ */
+class MegaSyncStats
+{
+public:
+    enum
+    {
+        OPERATION_CHECKPATH = 0,    // checking a local path after a filesystem notification
+        OPERATION_SYNCDOWN = 1,     // applying the cloud tree to the local one
+        OPERATION_SYNCUP = 2,       // applying the local tree to the cloud one
+        OPERATION_STATECACHE = 3,   // writing the sync's state cache database
+    };
+
+    virtual ~MegaSyncStats();
+
+    virtual MegaSyncStats *copy() const;
+
+    /**
+     * @brief Returns the identifier of the sync these figures belong to
+     * @return Backup id of the sync
+     */
+    virtual MegaHandle getBackupId() const;
+
+    /**
+     * @brief Returns the number of filesystem notifications waiting to be processed
+     * @return Number of pending notifications
+     */
+    virtual long long getNotificationsPending() const;
+
+    /**
+     * @brief Returns the number of local paths waiting to be retried after a transient error
+     * @return Number of pending retries
+     */
+    virtual long long getRetriesPending() const;
+
+    /**
+     * @brief Returns the number of state cache records waiting to be written or removed
+     * @return Number of pending state cache writes and removals
+     */
+    virtual long long getStateCachePending() const;
+
+    /**
+     * @brief Returns the number of uploads of the sync that have not finished yet
+     * @return Number of pending uploads
+     */
+    virtual long long getUploadsPending() const;
+
+    /**
+     * @brief Returns the number of downloads of the sync that have not finished yet
+     * @return Number of pending downloads
+     */
+    virtual long long getDownloadsPending() const;
+
+    /**
+     * @brief Returns how many times the sync performed an operation
+     * @param operation One of the OPERATION_* values
+     * @return Number of calls
+     */
+    virtual long long getCallCount(int operation) const;
+
+    /**
+     * @brief Returns the time the sync spent on an operation
+     * @param operation One of the OPERATION_* values
+     * @return Time spent, in milliseconds
+     */
+    virtual long long getTimeSpent(int operation) const;
+
+    /**
+     * @brief Returns how many times the whole sync was rescanned because filesystem
+     * notifications failed
+     * @return Number of full rescans
+     */
+    virtual long long getFullRescans() const;
+};
+
 
 
 #endif // ENABLE_SYNC
@@ -7222,6 +7651,97 @@ protected:
         friend class MegaApiImpl;
 };
 
+/**
+ * @brief Read-only view of a node of the account
+ *
+ * Unlike MegaNode, a MegaNodeView doesn't copy anything: its getters read the node kept by the
+ * SDK. It's only valid during the MegaNodeViewVisitor::visit callback that receives it, and the
+ * same object can be reused for the next node, so it must not be stored. Strings returned by its
+ * getters have the same lifetime. Use MegaNodeView::copy to keep a node beyond the callback.
+ *
+ * Objects of this class can't be created by the app.
+ */
+class MegaNodeView
+{
+    public:
+        virtual ~MegaNodeView();
+
+        /**
+         * @brief Returns the handle of the node
+         * @return Handle of the node
+         */
+        virtual MegaHandle getHandle() const;
+
+        /**
+         * @brief Returns the handle of the parent of the node
+         * @return Handle of the parent node, or INVALID_HANDLE if it has no parent
+         */
+        virtual MegaHandle getParentHandle() const;
+
+        /**
+         * @brief Returns the type of the node (see MegaNode::getType)
+         * @return Type of the node
+         */
+        virtual int getType() const;
+
+        /**
+         * @brief Returns the name of the node
+         *
+         * The SDK retains the ownership of the returned value. It's only valid during the
+         * MegaNodeViewVisitor::visit callback that received this object.
+         *
+         * @return Name of the node
+         */
+        virtual const char* getName() const;
+
+        /**
+         * @brief Returns the size of the node (see MegaNode::getSize)
+         * @return Size of the node
+         */
+        virtual int64_t getSize() const;
+
+        /**
+         * @brief Returns the creation time of the node in MEGA (in seconds since the epoch)
+         * @return Creation time of the node
+         */
+        virtual int64_t getCreationTime() const;
+
+        /**
+         * @brief Returns the modification time of the file that was uploaded to MEGA (in seconds since the epoch)
+         * @return Modification time of the file, or 0 for folders
+         */
+        virtual int64_t getModificationTime() const;
+
+        /**
+         * @brief Returns a MegaNode with the full information of the node
+         *
+         * You take the ownership of the returned value
+         *
+         * @return Copy of the node
+         */
+        virtual MegaNode* copy() const;
+};
+
+/**
+ * @brief Interface to receive MegaNodeView objects
+ *
+ * An implementation of this class can be passed to MegaApi::visitChildren
+ *
+ * The callbacks are received in the thread that calls MegaApi::visitChildren, while the SDK is
+ * locked, so they should return quickly and must not wait for any other call to the SDK.
+ */
+class MegaNodeViewVisitor
+{
+    public:
+        /**
+         * @brief Function that will be called for every visited node
+         * @param node View of the node, only valid during this call
+         * @return true to continue visiting nodes, false to stop
+         */
+        virtual bool visit(MegaNodeView* node);
+        virtual ~MegaNodeViewVisitor();
+};
+
 /**
  * @brief Interface to process node trees
  *
@@ -7546,6 +8066,21 @@ class MegaTransferListener
          */
         virtual void onTransferTemporaryError(MegaApi *api, MegaTransfer *transfer, MegaError* error);
 
+        /**
+         * @brief This function is called with the progress of all the active transfers at once
+         *
+         * It's only called when transfer updates are aggregated (see MegaApi::setTransferUpdatePolicy),
+         * and only for globally registered listeners. In that mode, onTransferUpdate is not called
+         * for mere progress, only for changes of state or priority.
+         *
+         * The SDK retains the ownership of the transfers parameter.
+         * Don't use it after this functions returns.
+         *
+         * @param api MegaApi object that started the transfers
+         * @param transfers Progress of the active transfers
+         */
+        virtual void onTransfersProgress(MegaApi *api, MegaTransferProgressList* transfers);
+
         virtual ~MegaTransferListener();
 
         /**
@@ -7714,6 +8249,12 @@ class MegaGlobalListener
          * list, use MegaNodeList::copy. If you want to save only some of the MegaNode objects, use MegaNode::copy
          * for those nodes.
          *
+         * The MegaNode objects of the list are only built when MegaNodeList::get is called for them.
+         * MegaNodeList::getHandle, MegaNodeList::getChanges and MegaNodeList::getParentHandle are much
+         * cheaper for large updates when only some of the nodes are of interest.
+         *
+         * @see MegaApi::setNodesUpdateCoalescing
+         *
          * @param api MegaApi object connected to the account
          * @param nodes List that contains the new or updated nodes
          */
@@ -7901,6 +8442,11 @@ class MegaGlobalListener
          *     It's needed to call MegaApi::getUserData in order to retrieve the deadline/warnings
          *     timestamps. @see MegaApi::getOverquotaDeadlineTs and MegaApi::getOverquotaWarningsTs.
          *
+         * - MegaEvent::EVENT_NODES_CACHED: when the nodes have been loaded from the local cache.
+         * They can be browsed and used for local operations (thumbnails in cache, streaming...)
+         * while the changes made since the last session are applied. MegaEvent::EVENT_NODES_CURRENT
+         * follows once all of them have been received.
+         *
          * - MegaEvent::EVENT_NODES_CURRENT: when all external changes have been received
          *
          * - MegaEvent::EVENT_MEDIA_INFO_READY: when codec-mappings have been received
@@ -8123,6 +8669,21 @@ class MegaListener
          */
         virtual void onTransferTemporaryError(MegaApi *api, MegaTransfer *transfer, MegaError* error);
 
+        /**
+         * @brief This function is called with the progress of all the active transfers at once
+         *
+         * It's only called when transfer updates are aggregated (see MegaApi::setTransferUpdatePolicy),
+         * and only for globally registered listeners. In that mode, onTransferUpdate is not called
+         * for mere progress, only for changes of state or priority.
+         *
+         * The SDK retains the ownership of the transfers parameter.
+         * Don't use it after this functions returns.
+         *
+         * @param api MegaApi object that started the transfers
+         * @param transfers Progress of the active transfers
+         */
+        virtual void onTransfersProgress(MegaApi *api, MegaTransferProgressList* transfers);
+
         /**
         * @brief This function is called when there are new or updated contacts in the account
         *
@@ -8160,6 +8721,12 @@ class MegaListener
          * list, use MegaNodeList::copy. If you want to save only some of the MegaNode objects, use MegaNode::copy
          * for those nodes.
          *
+         * The MegaNode objects of the list are only built when MegaNodeList::get is called for them.
+         * MegaNodeList::getHandle, MegaNodeList::getChanges and MegaNodeList::getParentHandle are much
+         * cheaper for large updates when only some of the nodes are of interest.
+         *
+         * @see MegaApi::setNodesUpdateCoalescing
+         *
          * @param api MegaApi object connected to the account
          * @param nodes List that contains the new or updated nodes
          */
@@ -8490,6 +9057,11 @@ class MegaListener
          *     It's needed to call MegaApi::getUserData in order to retrieve the deadline/warnings
          *     timestamps. @see MegaApi::getOverquotaDeadlineTs and MegaApi::getOverquotaWarningsTs.
          *
+         * - MegaEvent::EVENT_NODES_CACHED: when the nodes have been loaded from the local cache.
+         * They can be browsed and used for local operations (thumbnails in cache, streaming...)
+         * while the changes made since the last session are applied. MegaEvent::EVENT_NODES_CURRENT
+         * follows once all of them have been received.
+         *
          * - MegaEvent::EVENT_NODES_CURRENT: when all external changes have been received
          *
          * - MegaEvent::EVENT_MEDIA_INFO_READY: when codec-mappings have been received
@@ -8611,6 +9183,32 @@ public:
      */
     virtual char *encryptFile(const char* inputFilepath, int64_t startPos, int64_t* length, const char* outputFilepath, bool adjustsizeonly);
 
+    /**
+     * @brief Encrypt the whole file into several pieces, in parallel
+     *
+     * Call this function instead of MegaBackgroundMediaUpload::encryptFile to prepare all the
+     * encrypted data at once, when there is space for it on the device. The file is split into
+     * consecutive pieces of about pieceSize bytes (rounded up to fit the MEGA internal chunking
+     * algorithm, as MegaBackgroundMediaUpload::encryptFile does), and up to 'threads' of them are
+     * encrypted at the same time. Each piece is stored in its own file, named outputFilepathPrefix
+     * followed by the index of the piece (0, 1, 2...), and can be uploaded independently of the others,
+     * for instance by concurrent background URL sessions.
+     *
+     * Like MegaBackgroundMediaUpload::encryptFile, the file is read and written a small piece at a time,
+     * so that RAM usage is not excessive.
+     *
+     * You take ownership of the returned value.
+     *
+     * @param inputFilepath The file to encrypt (and the one that is ultimately being uploaded).
+     * @param pieceSize The approximate number of bytes of each piece.
+     * @param outputFilepathPrefix The prefix of the names of the new files that store the pieces.
+     * @param threads The maximum number of pieces being encrypted at the same time.
+     * @return If the function succeeds, the suffixes to append to the URL when uploading each piece,
+     *         in the order of the pieces. Otherwise NULL, and an error will have been logged. Pieces
+     *         already written when the error happened are left on disk.
+     */
+    virtual MegaStringList* encryptFileInPieces(const char* inputFilepath, int64_t pieceSize, const char* outputFilepathPrefix, int threads);
+
     /**
      * @brief Retrieves the value of the uploadURL once it has been successfully requested via MegaApi::backgroundMediaUploadRequestUploadURL
      *
@@ -8875,6 +9473,13 @@ class MegaApi
             PAYMENT_METHOD_WIRE_TRANSFER = 999
         };
 
+        enum {
+            BACKUP_UPLOAD_ORDER_FIFO = 0,
+            BACKUP_UPLOAD_ORDER_NEWEST_FIRST = 1,
+            BACKUP_UPLOAD_ORDER_SMALLEST_FIRST = 2,
+            BACKUP_UPLOAD_ORDER_WEIGHTED = 3
+        };
+
         enum {
             TRANSFER_METHOD_NORMAL = 0,
             TRANSFER_METHOD_ALTERNATIVE_PORT = 1,
@@ -11223,6 +11828,31 @@ class MegaApi
          */
         void moveNode(MegaNode* node, MegaNode* newParent, const char* newName, MegaRequestListener *listener = NULL);
 
+        /**
+         * @brief Move many nodes to the same folder of the MEGA account
+         *
+         * The moves of all the nodes are sent together, and the request finishes once, when
+         * all of them have completed. Unlike moveNode, nodes that can't be moved directly
+         * aren't copied and removed instead: they fail with their own error.
+         *
+         * The associated request type with this request is MegaRequest::TYPE_MOVE_NODES
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getMegaHandleList - Returns the handles of the nodes to move
+         * - MegaRequest::getParentHandle - Returns the handle of the new parent for the nodes
+         *
+         * Valid data in the MegaRequest object received in onRequestFinish:
+         * - MegaRequest::getMegaStringMap - Returns, for each node that couldn't be moved, its
+         * handle in Base64 as the key and the error code as the value
+         *
+         * onRequestFinish is called with MegaError::API_OK if every node was moved, otherwise
+         * with the error of one of the nodes that failed.
+         *
+         * @param nodes Nodes to move
+         * @param newParent New parent for the nodes
+         * @param listener MegaRequestListener to track this request
+         */
+        void moveNodes(MegaNodeList* nodes, MegaNode* newParent, MegaRequestListener *listener = NULL);
+
         /**
          * @brief Copy a node in the MEGA account
          *
@@ -12057,6 +12687,74 @@ class MegaApi
          */
         void cancelGetPreview(MegaNode* node, MegaRequestListener *listener = NULL);
 
+        /**
+         * @brief Cancel the retrieval of the thumbnails of all nodes but the ones in a list
+         *
+         * This is intended for galleries: when the view is scrolled, the thumbnails requested
+         * for the cells that are no longer visible can be cancelled at once, so the ones of the
+         * visible cells are received earlier. The requests cancelled finish with the error
+         * MegaError::API_EINCOMPLETE.
+         *
+         * Besides, the thumbnails requested the latest are always requested first to the
+         * storage servers, and those requested together are retrieved in the same connection.
+         *
+         * The associated request type with this request is MegaRequest::TYPE_CANCEL_ATTR_FILE
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getParamType - Returns MegaApi::ATTR_TYPE_THUMBNAIL
+         * - MegaRequest::getMegaHandleList - Returns the handles of the nodes to keep
+         * - MegaRequest::getFlag - Returns true
+         *
+         * Valid data in the MegaRequest object received in onRequestFinish when the error code
+         * is MegaError::API_OK:
+         * - MegaRequest::getNumber - Returns the number of nodes whose thumbnail was cancelled
+         *
+         * @param nodeHandles Handles of the nodes whose thumbnails are still wanted (NULL for none)
+         * @param listener MegaRequestListener to track this request
+         *
+         * @see MegaApi::getThumbnail
+         */
+        void cancelGetThumbnailsExcept(MegaHandleList *nodeHandles, MegaRequestListener *listener = NULL);
+
+        /**
+         * @brief Cancel the retrieval of the previews of all nodes but the ones in a list
+         *
+         * See MegaApi::cancelGetThumbnailsExcept
+         *
+         * The associated request type with this request is MegaRequest::TYPE_CANCEL_ATTR_FILE
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getParamType - Returns MegaApi::ATTR_TYPE_PREVIEW
+         * - MegaRequest::getMegaHandleList - Returns the handles of the nodes to keep
+         * - MegaRequest::getFlag - Returns true
+         *
+         * Valid data in the MegaRequest object received in onRequestFinish when the error code
+         * is MegaError::API_OK:
+         * - MegaRequest::getNumber - Returns the number of nodes whose preview was cancelled
+         *
+         * @param nodeHandles Handles of the nodes whose previews are still wanted (NULL for none)
+         * @param listener MegaRequestListener to track this request
+         *
+         * @see MegaApi::getPreview
+         */
+        void cancelGetPreviewsExcept(MegaHandleList *nodeHandles, MegaRequestListener *listener = NULL);
+
+        /**
+         * @brief Keep the thumbnails and previews retrieved in a disk cache
+         *
+         * Thumbnails and previews never change (a new one gets a new handle), so with the cache,
+         * MegaApi::getThumbnail, MegaApi::getPreview and MegaApi::getNodeAttribute copy them from
+         * it if they were retrieved before, even in previous executions of the app, instead of
+         * downloading them again. When the cache exceeds the maximum size, the files used the
+         * least recently are removed.
+         *
+         * The files already in the folder are kept, so the same folder should be used in
+         * every execution.
+         *
+         * @param path Folder for the cache (it's created if needed), or NULL to disable it
+         * @param maxSize Maximum size of the cache (in bytes)
+         * @return True if the cache is ready (or disabled, if path is NULL)
+         */
+        bool setFileAttributesCache(const char *path, long long maxSize);
+
         /**
          * @brief Set the thumbnail of a MegaNode
          *
@@ -12288,6 +12986,37 @@ class MegaApi
          */
         void setCustomNodeAttribute(MegaNode *node, const char *attrName, const char* value, MegaRequestListener *listener = NULL);
 
+        /**
+         * @brief Set a custom attribute for many nodes
+         *
+         * The updates of all the nodes are sent together, and the request finishes once, when
+         * all of them have completed.
+         *
+         * The associated request type with this request is MegaRequest::TYPE_SET_ATTR_NODES
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getMegaHandleList - Returns the handles of the nodes that receive the attribute
+         * - MegaRequest::getName - Returns the name of the custom attribute
+         * - MegaRequest::getText - Returns the text for the attribute
+         *
+         * Valid data in the MegaRequest object received in onRequestFinish:
+         * - MegaRequest::getMegaStringMap - Returns, for each node that failed, its handle
+         * in Base64 as the key and the error code as the value
+         *
+         * onRequestFinish is called with MegaError::API_OK if every node got the attribute,
+         * otherwise with the error of one of the nodes that failed.
+         *
+         * The attribute name must be an UTF8 string with between 1 and 7 bytes
+         * If the attribute already has a value, it will be replaced
+         * If value is NULL, the attribute will be removed from the nodes
+         *
+         * @param nodes Nodes that will receive the attribute
+         * @param attrName Name of the custom attribute.
+         * The length of this parameter must be between 1 and 7 UTF8 bytes
+         * @param value Value for the attribute
+         * @param listener MegaRequestListener to track this request
+         */
+        void setNodesCustomAttribute(MegaNodeList *nodes, const char *attrName, const char* value, MegaRequestListener *listener = NULL);
+
         /**
          * @brief Set s4 attribute for the node
          *
@@ -13933,6 +14662,47 @@ class MegaApi
          */
         void startDownload(MegaNode* node, const char* localPath, const char *customName, const char *appData, bool startFirst, MegaCancelToken *cancelToken, MegaTransferListener *listener = NULL);
 
+        /**
+         * @brief Upload many files or folders to the same folder in MEGA at once
+         *
+         * This is equivalent to calling MegaApi::startUpload for each local path, with no custom
+         * name and modification time and isSourceTemporary false, but much cheaper when thousands
+         * of transfers are started: they are created and queued together, and the SDK handles
+         * them in as few passes as possible.
+         *
+         * Each item is still a separate MegaTransfer, reported to the listener as usual.
+         *
+         * @param localPaths Local paths of the files or folders
+         * @param parent Parent node for the files or folders in the MEGA account
+         * @param appData Custom app data to save in every MegaTransfer object
+         *  + If you don't need this param provide NULL as value
+         * @param startFirst puts the transfers on top of the upload queue
+         * @param cancelToken MegaCancelToken to be able to cancel the transfers.
+         * App retains the ownership of this param.
+         * @param listener MegaTransferListener to track the transfers
+         */
+        void startUploads(MegaStringList* localPaths, MegaNode* parent, const char* appData, bool startFirst, MegaCancelToken* cancelToken, MegaTransferListener* listener = NULL);
+
+        /**
+         * @brief Download many files or folders from MEGA into the same local folder at once
+         *
+         * This is equivalent to calling MegaApi::startDownload for each node with no custom name,
+         * but much cheaper when thousands of transfers are started: they are created and queued
+         * together, and the SDK handles them in as few passes as possible.
+         *
+         * Each item is still a separate MegaTransfer, reported to the listener as usual.
+         *
+         * @param nodes MegaNode objects of the files or folders
+         * @param localFolder Local folder for the files or folders, which keep their names in MEGA
+         * @param appData Custom app data to save in every MegaTransfer object
+         *  + If you don't need this param provide NULL as value
+         * @param startFirst puts the transfers on top of the download queue
+         * @param cancelToken MegaCancelToken to be able to cancel the transfers.
+         * App retains the ownership of this param.
+         * @param listener MegaTransferListener to track the transfers
+         */
+        void startDownloads(MegaNodeList* nodes, const char* localFolder, const char* appData, bool startFirst, MegaCancelToken* cancelToken, MegaTransferListener* listener = NULL);
+
         /**
          * @brief Start an streaming download for a file in MEGA
          *
@@ -14373,62 +15143,346 @@ class MegaApi
          *  - TRANSFER_METHOD_AUTO_ALTERNATIVE = 4
          * The SDK selects the transfer method automatically starting with alternative port 8080.
          *
-         * @param method Selected transfer method for downloads
+         * @param method Selected transfer method for downloads
+         */
+        void setDownloadMethod(int method);
+
+        /**
+         * @brief Set the transfer method for uploads
+         *
+         * Valid methods are:
+         * - TRANSFER_METHOD_NORMAL = 0
+         * HTTP transfers using port 80. Data is already encrypted.
+         *
+         * - TRANSFER_METHOD_ALTERNATIVE_PORT = 1
+         * HTTP transfers using port 8080. Data is already encrypted.
+         *
+         * - TRANSFER_METHOD_AUTO = 2
+         * The SDK selects the transfer method automatically
+         *
+         * - TRANSFER_METHOD_AUTO_NORMAL = 3
+         * The SDK selects the transfer method automatically starting with port 80.
+         *
+         * - TRANSFER_METHOD_AUTO_ALTERNATIVE = 4
+         * The SDK selects the transfer method automatically starting with alternative port 8080.
+         *
+         * @param method Selected transfer method for uploads
+         */
+        void setUploadMethod(int method);
+
+        /**
+         * @brief Set the maximum download speed in bytes per second
+         *
+         * Currently, this method is only available using the cURL-based network layer.
+         * It doesn't work with WinHTTP. You can check if the function will have effect
+         * by checking the return value. If it's true, the value will be applied. Otherwise,
+         * this function returns false.
+         *
+         * A value <= 0 means unlimited speed
+         *
+         * @param bpslimit Download speed in bytes per second
+         * @return true if the network layer allows to control the download speed, otherwise false
+         */
+        bool setMaxDownloadSpeed(long long bpslimit);
+
+        /**
+         * @brief Set the maximum upload speed in bytes per second
+         *
+         * Currently, this method is only available using the cURL-based network layer.
+         * It doesn't work with WinHTTP. You can check if the function will have effect
+         * by checking the return value. If it's true, the value will be applied. Otherwise,
+         * this function returns false.
+         *
+         * A value <= 0 means unlimited speed
+         *
+         * @param bpslimit Upload speed in bytes per second
+         * @return true if the network layer allows to control the upload speed, otherwise false
+         */
+        bool setMaxUploadSpeed(long long bpslimit);
+
+        /**
+         * @brief Multiplex concurrent requests to the same host over shared HTTP/2 connections
+         *
+         * When enabled, API requests and transfer connections to the same server share
+         * persistent connections instead of opening a TCP+TLS connection each. This only
+         * applies to HTTPS requests (see MegaApi::useHttpsOnly), and requires the cURL-based
+         * network layer built with HTTP/2 support. It is disabled by default, which leaves
+         * the network library's own connection reuse unchanged.
+         *
+         * @param enable True to enable HTTP/2 multiplexing, false to disable it
+         * @return true if the network layer supports the setting, otherwise false
+         */
+        bool setHttp2Multiplexing(bool enable);
+
+        /**
+         * @brief Set how commands are grouped into requests to the API
+         *
+         * Commands queued while a request is in flight are sent together in the next one.
+         * This sets limits for those batches, and how long a partial batch may wait for more
+         * commands before it is sent, which helps bursts of small commands (eg. renames or
+         * moves) that would otherwise be sent in many tiny requests. Commands someone is
+         * directly waiting for, like the ones that start transfers or streaming, are never
+         * held back.
+         *
+         * @param maxCommands Maximum number of commands per request (up to 10000, the default)
+         * @param maxBytes Maximum size of a request in bytes, 0 (the default) for no limit
+         * @param lingerMs Time a partial batch may wait for more commands, 0 (the default) to send it right away
+         */
+        void setRequestBatching(int maxCommands, long long maxBytes, int lingerMs);
+
+        /**
+         * @brief Group the commits of the local cache
+         *
+         * By default, the local cache is committed to disk every time a batch of updates from
+         * the server has been applied. Each commit writes to disk on the SDK thread, which can
+         * take long on slow storage. This lets the commit for a batch wait for the following
+         * ones, up to maxLagMs after the first batch waiting or until maxPending batches are
+         * waiting, so that one commit covers all of them.
+         *
+         * The cache always commits at a complete batch, so it stays consistent: if the app is
+         * killed, at most the batches still waiting are lost, and they are fetched again from
+         * the server at the next start.
+         *
+         * @param maxLagMs Maximum time a batch waits for a commit, 0 (the default) to commit every batch
+         * @param maxPending Maximum number of batches waiting for a commit, 0 for no limit
+         */
+        void setLocalCacheCommitGrouping(int maxLagMs, int maxPending);
+
+        /**
+         * @brief Tune the access to the local cache
+         *
+         * By default, these values are chosen from the size of the local cache, which grows with
+         * the account: big caches get a bigger page cache, fewer checkpoints of the write-ahead
+         * log and, on 64-bit systems, memory-mapped reads. Servers with very large accounts and
+         * memory to spare may want bigger values.
+         *
+         * The settings apply to the caches opened afterwards, ie. from the next login or fetchnodes.
+         *
+         * @param mmapSizeBytes Bytes of the cache file read through memory mapping, -1 for none, 0 for the default
+         * @param cacheSizeKb Page cache per connection to the cache, in KB, 0 for the default
+         * @param walCheckpointPages Pages (4 KB) the write-ahead log grows to before it's checkpointed, 0 for the default
+         */
+        void setLocalCacheTuning(long long mmapSizeBytes, long long cacheSizeKb, int walCheckpointPages);
+
+        /**
+         * @brief Set how many extra requests to the API may be in flight at the same time
+         *
+         * Requests to the API are normally sent one after another, each one when the
+         * response to the previous one has arrived. Commands that don't depend on any other,
+         * like the ones that get the URLs for transfers and streaming, may instead be sent in
+         * up to this many additional requests at once, which saves round trips on high-latency
+         * connections. The rest of the commands keep their order.
+         * @param count Number of additional requests (up to 8), 0 to send every command in order (the default)
+         */
+        void setParallelRequests(int count);
+
+        /**
+         * @brief Start folder downloads before the whole folder has been explored
+         *
+         * By default, a folder download first walks the entire folder, then creates all the
+         * local folders, and only then starts downloading files. For very large folders that
+         * means a long wait, and keeping every file of the folder in memory until then.
+         *
+         * With a batch size, the folder is explored a part at a time: once a batch of this many
+         * files and folders has been gathered, its local folders are created and its downloads
+         * started while the next part is explored. MegaTransferListener::onFolderTransferUpdate
+         * then reports the stages MegaTransfer::STAGE_SCAN and MegaTransfer::STAGE_CREATE_TREE
+         * for each batch.
+         *
+         * The setting applies to folder downloads started afterwards.
+         *
+         * @param nodes Files and folders per batch, 0 (the default) to explore the whole folder first
+         */
+        void setFolderDownloadBatchSize(int nodes);
+
+        /**
+         * @brief Merge the node updates of a burst into a single onNodesUpdate
+         *
+         * By default, onNodesUpdate is called once for each group of server notifications
+         * processed by the SDK, so a large operation can arrive in many callbacks that
+         * report the same nodes again and again.
+         *
+         * When enabled, the updates arriving during one pass of the SDK thread are delivered
+         * together in one onNodesUpdate, with one entry per node holding all its changes.
+         * The MegaNode objects then reflect the state of the nodes at the end of the pass;
+         * removed nodes are reported as they were when they were removed.
+         *
+         * @param enable True to merge the node updates, false (the default) to deliver them as they arrive
+         */
+        void setNodesUpdateCoalescing(bool enable);
+
+        /**
+         * @brief Run the callbacks of the listeners registered with the MegaApi on separate threads
+         *
+         * By default, every callback runs on the SDK thread, so a slow listener (say, one writing
+         * to its own database in onTransferUpdate) holds up the whole SDK while it runs.
+         *
+         * With dispatch threads, every callback of the listeners added with MegaApi::addListener,
+         * MegaApi::addRequestListener, MegaApi::addTransferListener, MegaApi::addGlobalListener,
+         * MegaApi::httpServerAddListener and MegaApi::ftpServerAddListener is queued and run on these
+         * threads instead. Each listener still gets its callbacks one at a time and in order. When a
+         * listener falls behind, onTransferUpdate callbacks still pending for the same transfer are
+         * replaced by the latest one.
+         *
+         * The objects received in dispatched callbacks are copies, valid until the callback returns,
+         * and MegaApi::getCurrentRequest and similar functions don't apply to them. The listeners passed
+         * to each request, transfer or scheduled copy, and the MegaScheduledCopyListener objects, are
+         * still called on the thread that raises the callback.
+         *
+         * Once one of the remove*Listener functions returns, no callback is running or will run
+         * for that listener, unless it's called from that listener's own callback.
+         *
+         * @param threads Number of dispatch threads, 0 (the default) to run the callbacks on the SDK thread
+         */
+        void setListenerDispatchThreads(int threads);
+
+        /**
+         * @brief Limit how often transfer progress is reported
+         *
+         * By default, MegaTransferListener::onTransferUpdate is called for every active transfer
+         * on every progress tick, which adds up to a lot of callbacks with many concurrent transfers.
+         *
+         * With a minimum interval and/or a minimum byte delta, a transfer only reports progress
+         * once both have been reached since its previous report. MegaTransfer::getDeltaSize then
+         * covers all the progress since that report. Changes of state or priority and the end of
+         * a transfer are still reported straight away.
+         *
+         * With aggregate set, progress is not reported per transfer at all. Instead,
+         * MegaTransferListener::onTransfersProgress and MegaListener::onTransfersProgress receive
+         * the progress of all the active transfers in one call, at most once per interval
+         * (once per second if the interval is 0).
+         *
+         * The interval has a resolution of 100 ms.
+         *
+         * @param minIntervalMs Minimum time between progress reports of a transfer, 0 for no minimum
+         * @param minBytes Minimum progress between reports of a transfer, 0 for no minimum
+         * @param aggregate True to report the progress of all transfers together
+         */
+        void setTransferUpdatePolicy(int minIntervalMs, long long minBytes, bool aggregate);
+
+        /**
+         * @brief Set when an iteration of the SDK loop is reported as slow
+         *
+         * The time of every iteration of the loop of the SDK thread (not counting the time
+         * it waits for events) is recorded in the MegaClient_loop histogram of
+         * MegaApi::getMetricsSnapshot. An iteration that takes longer than this threshold is
+         * also logged as a warning, with the subsystems that took most of it (transfers,
+         * action packets, API responses, syncs, thumbnail generation, local cache commits...).
+         * The time of each subsystem in slow iterations is added up in the
+         * MegaClient_slowLoop_<subsystem> counters.
+         *
+         * Slow iterations hold the SDK mutex, so they are what delays synchronous calls
+         * to MegaApi from the app.
+         *
+         * @param milliseconds Threshold (500 by default), 0 to disable the report
+         */
+        void setSlowLoopThreshold(int milliseconds);
+
+        /**
+         * @brief Get the approximate memory used by the main subsystems of this MegaApi
+         *
+         * The report covers the nodes in RAM and their indexes, the LocalNodes of the syncs,
+         * the buffers of the transfers and of the HTTP requests and the user alerts, plus the
+         * transfer and streaming buffers shared by all the MegaApi objects of the process.
+         *
+         * It's cheap enough to be polled periodically in production: big collections are
+         * sampled. It takes the SDK mutex for a short while.
+         *
+         * You take the ownership of the returned value.
+         *
+         * @return Memory report
+         */
+        MegaMemoryReport *getMemoryReport();
+
+        enum {
+            THREAD_POOL_CLIENT = 0,         // Thread of each MegaApi, running its requests and transfers
+            THREAD_POOL_CRYPTO = 1,         // Workers of each MegaApi that encrypt and decrypt transfer data
+            THREAD_POOL_GFX = 2,            // Threads of each MegaApi that create thumbnails and previews
+            THREAD_POOL_SCAN = 3,           // Workers shared by all syncs that scan local folders
+            THREAD_POOL_FINGERPRINT = 4,    // Workers shared by all syncs that fingerprint local files
+        };
+
+        /**
+         * @brief Configure a pool of threads of the SDK
+         *
+         * The configuration is process-wide, and applies to the threads that start after this
+         * call, so it should be done before creating any MegaApi object.
+         *
+         * The size of THREAD_POOL_CLIENT can't be changed (one thread per MegaApi).
+         * THREAD_POOL_CRYPTO is sized per MegaApi, replacing the workerThreadCount
+         * passed to the constructor, unless that one is 0.
+         *
+         * THREAD_POOL_GFX is sized per MegaApi too (one thread by default). It only applies
+         * to the graphics library built into the SDK: a MegaGfxProcessor provided by the app
+         * is always used from a single thread. The images of uploads are created before the
+         * missing ones of existing files, and thumbnails before previews.
+         *
+         * The CPU affinity and the nice level are only applied on Linux (and Android).
+         *
+         * @param pool Pool to configure (one of the THREAD_POOL_* values)
+         * @param size Number of threads of the pool, 0 for the default of the SDK
+         * @param cpus CPUs the threads of the pool may run on, NULL or empty for any CPU
+         * @param niceLevel Nice level of the threads of the pool, 0 to keep the one of the process
+         * @return false if the pool is not valid
          */
-        void setDownloadMethod(int method);
+        static bool setThreadPoolConfig(int pool, int size, MegaIntegerList *cpus = NULL, int niceLevel = 0);
 
         /**
-         * @brief Set the transfer method for uploads
-         *
-         * Valid methods are:
-         * - TRANSFER_METHOD_NORMAL = 0
-         * HTTP transfers using port 80. Data is already encrypted.
-         *
-         * - TRANSFER_METHOD_ALTERNATIVE_PORT = 1
-         * HTTP transfers using port 8080. Data is already encrypted.
+         * @brief Get the number of running threads of a pool, for all the MegaApi objects of the process
+         * @param pool Pool (one of the THREAD_POOL_* values)
+         * @return Number of running threads
+         */
+        static int getThreadPoolThreadCount(int pool);
+
+        /**
+         * @brief Get the number of work items waiting for the threads of a pool
          *
-         * - TRANSFER_METHOD_AUTO = 2
-         * The SDK selects the transfer method automatically
+         * THREAD_POOL_CLIENT doesn't report it: see MegaApi::getNumPendingRequests and the transfer queues.
          *
-         * - TRANSFER_METHOD_AUTO_NORMAL = 3
-         * The SDK selects the transfer method automatically starting with port 80.
+         * @param pool Pool (one of the THREAD_POOL_* values)
+         * @return Number of queued work items
+         */
+        static long long getThreadPoolQueueDepth(int pool);
+
+        /**
+         * @brief Get how busy the threads of a pool have been
          *
-         * - TRANSFER_METHOD_AUTO_ALTERNATIVE = 4
-         * The SDK selects the transfer method automatically starting with alternative port 8080.
+         * The value is the time spent on work items, over the total running time of the
+         * threads of the pool, since the previous call with reset = true (or since start).
          *
-         * @param method Selected transfer method for uploads
+         * @param pool Pool (one of the THREAD_POOL_* values)
+         * @param reset True to start a new measurement period
+         * @return Utilization, from 0 to 1
          */
-        void setUploadMethod(int method);
+        static double getThreadPoolUtilization(int pool, bool reset = false);
 
         /**
-         * @brief Set the maximum download speed in bytes per second
+         * @brief Get the current figures of the SDK metrics, for all the MegaApi objects of the process
          *
-         * Currently, this method is only available using the cURL-based network layer.
-         * It doesn't work with WinHTTP. You can check if the function will have effect
-         * by checking the return value. If it's true, the value will be applied. Otherwise,
-         * this function returns false.
+         * Metrics are always collected, at a very low cost. They can also be exported in the
+         * Prometheus / OpenMetrics text format with MegaMetricsSnapshot::toOpenMetrics.
          *
-         * A value <= 0 means unlimited speed
+         * You take the ownership of the returned value.
          *
-         * @param bpslimit Download speed in bytes per second
-         * @return true if the network layer allows to control the download speed, otherwise false
+         * @return Snapshot of the metrics
          */
-        bool setMaxDownloadSpeed(long long bpslimit);
+        static MegaMetricsSnapshot *getMetricsSnapshot();
 
         /**
-         * @brief Set the maximum upload speed in bytes per second
+         * @brief Share the crypto workers among all the MegaApi objects of the process
          *
-         * Currently, this method is only available using the cURL-based network layer.
-         * It doesn't work with WinHTTP. You can check if the function will have effect
-         * by checking the return value. If it's true, the value will be applied. Otherwise,
-         * this function returns false.
+         * By default, each MegaApi starts its own THREAD_POOL_CRYPTO threads. In processes
+         * hosting many accounts, that adds up to a lot of threads. With shared workers, the
+         * MegaApi objects created afterwards queue their work to a single process-wide pool
+         * instead. Its size is the one set for THREAD_POOL_CRYPTO with MegaApi::setThreadPoolConfig,
+         * or the number of CPUs by default. Accounts are served in turn, so one with a long
+         * queue doesn't delay the others, and each account keeps its own state and queue.
          *
-         * A value <= 0 means unlimited speed
+         * MegaApi objects created with workerThreadCount = 0 keep doing that work synchronously.
          *
-         * @param bpslimit Upload speed in bytes per second
-         * @return true if the network layer allows to control the upload speed, otherwise false
+         * @param enable True to share the workers, false (the default) for workers per MegaApi
          */
-        bool setMaxUploadSpeed(long long bpslimit);
+        static void setSharedWorkers(bool enable);
 
         /**
          * @brief Get the maximum download speed in bytes per second
@@ -15198,6 +16252,84 @@ class MegaApi
          */
         MegaSync *getSyncByBackupId(MegaHandle backupId);
 
+        /**
+         * @brief Get figures that show why a synchronization is slow to converge
+         *
+         * They say what the sync is waiting on (queued notifications, state cache writes,
+         * transfers) and how much time it has spent on each of its operations.
+         *
+         * You take the ownership of the returned value
+         *
+         * @param backupId Identifier of the Sync (unique per user, provided by API)
+         * @return Figures of the sync, or NULL if it is not running
+         */
+        MegaSyncStats *getSyncStats(MegaHandle backupId);
+
+        /**
+         * @brief Start or stop recording the operations of all syncs for MegaApi::exportSyncTrace
+         *
+         * Enabling tracing discards anything recorded before. Only the most recent
+         * operations are kept.
+         *
+         * @param enable True to start recording, false to stop
+         */
+        void setSyncTracing(bool enable);
+
+        /**
+         * @brief Export the sync operations recorded since tracing was enabled
+         *
+         * The result is JSON in Chrome's trace event format, which chrome://tracing and
+         * Perfetto load. Each sync is shown as a thread named by its backup id.
+         *
+         * You take the ownership of the returned value
+         *
+         * @return JSON trace
+         */
+        char *exportSyncTrace();
+
+        /**
+         * @brief Set the order in which backups queue the uploads of their initial copy
+         *
+         * While a backup is mirroring its local folder, the files found in each pass are
+         * queued for upload in this order, so that the most valuable ones are in the cloud
+         * first. Uploads that are queued already keep their position.
+         *
+         * Valid values for this parameter are:
+         * - MegaApi::BACKUP_UPLOAD_ORDER_FIFO = 0
+         * In the order they are found (default)
+         *
+         * - MegaApi::BACKUP_UPLOAD_ORDER_NEWEST_FIRST = 1
+         * Most recently modified files first
+         *
+         * - MegaApi::BACKUP_UPLOAD_ORDER_SMALLEST_FIRST = 2
+         * Smallest files first
+         *
+         * - MegaApi::BACKUP_UPLOAD_ORDER_WEIGHTED = 3
+         * Recently modified and small files first, weighing age and size alike
+         *
+         * @param order Order of the uploads
+         */
+        void setBackupUploadOrder(int order);
+
+        /**
+         * @brief Limit the number of files and folders of a synchronization kept in memory
+         *
+         * Once the synchronization is idle and has more than \c maxNodes items in memory, the
+         * synced files of the folders not used recently are unloaded to its local cache. They are
+         * loaded again when a change, inside that folder or to its files in the cloud, needs them.
+         *
+         * This is meant for huge synchronizations on devices with little memory. Backups are not
+         * limited, and moving an unloaded file out of its folder is handled as a copy and a
+         * deletion rather than as a move, which can be slower.
+         *
+         * By default, there is no limit.
+         *
+         * @param backupId Identifier of the Sync (unique per user, provided by API)
+         * @param maxNodes Maximum number of items in memory, or 0 for no limit
+         * @return False if there is no synchronization with that backupId
+         */
+        bool setMaxSyncNodesInRam(MegaHandle backupId, long long maxNodes);
+
         /**
          * @brief getSyncByNode Get the synchronization associated with a node
          *
@@ -15466,6 +16598,35 @@ class MegaApi
          */
         long long getNumNodes();
 
+        /**
+         * @brief Limit the number of nodes kept in memory
+         *
+         * Nodes are stored in the local cache and loaded in memory when they are needed. Once
+         * there are more than \c maxNodes in memory, the ones not used recently are unloaded,
+         * unless the SDK needs them (ie. root nodes, shares, and nodes being synced or transferred).
+         * They are loaded again on demand.
+         *
+         * By default, there is no limit.
+         *
+         * @param maxNodes Maximum number of nodes in memory, or 0 for no limit
+         */
+        void setMaxNodesInRam(long long maxNodes);
+
+        /**
+         * @brief Prefetch the children of the folders listed by the app
+         *
+         * When enabled, after MegaApi::getChildren or MegaApi::getChildrenPage, the children of
+         * up to \c folders of the listed folders (the first ones in the listing) are read from the
+         * local cache in the background and loaded in memory, so browsing into one of them is faster.
+         * The prefetched nodes count towards the limit set by MegaApi::setMaxNodesInRam, and they
+         * are discarded if the account changes meanwhile.
+         *
+         * By default, it is disabled.
+         *
+         * @param folders Maximum number of folders prefetched per listing, or 0 to disable it
+         */
+        void setChildrenPrefetch(int folders);
+
         enum { ORDER_NONE = 0, ORDER_DEFAULT_ASC, ORDER_DEFAULT_DESC,
             ORDER_SIZE_ASC, ORDER_SIZE_DESC,
             ORDER_CREATION_ASC, ORDER_CREATION_DESC,
@@ -15782,6 +16943,48 @@ class MegaApi
          */
         MegaNodeList* getChildrenFromType(MegaNode* p, int type, int order = ORDER_DEFAULT_ASC, MegaCancelToken *cancelToken = nullptr);
 
+        /**
+         * @brief Get a page of the children of a MegaNode
+         *
+         * The result is the same as taking the elements [offset, offset + limit) of the list
+         * returned by MegaApi::getChildren for the same order, but only the nodes of the page
+         * are loaded and returned. For MegaApi::ORDER_DEFAULT_ASC, MegaApi::ORDER_DEFAULT_DESC,
+         * MegaApi::ORDER_CREATION_ASC and MegaApi::ORDER_CREATION_DESC the sorting and slicing
+         * are done by the local cache (nodes with equal keys come in handle order, so consecutive
+         * pages don't overlap). Other orders sort all the children in memory as MegaApi::getChildren does.
+         *
+         * If the parent node doesn't exist or it isn't a folder, this function
+         * returns an empty list
+         *
+         * You take the ownership of the returned value
+         *
+         * @param parent Parent node
+         * @param order Order for the returned list (see MegaApi::getChildren)
+         * @param offset Number of children to skip, in the requested order
+         * @param limit Maximum number of children to return
+         * @param cancelToken MegaCancelToken to be able to cancel the processing at any time.
+         * @return List with up to 'limit' child MegaNode objects
+         */
+        MegaNodeList* getChildrenPage(MegaNode *parent, int order, long long offset, int limit, MegaCancelToken *cancelToken = nullptr);
+
+        /**
+         * @brief Visit the children of a MegaNode without copying them
+         *
+         * Each child is passed to MegaNodeViewVisitor::visit as a MegaNodeView, which reads the
+         * node kept by the SDK instead of copying it into a MegaNode. This avoids the copies
+         * of MegaApi::getChildren when only a few fields of a large folder are needed
+         * (e.g. to fill a list in the bindings).
+         *
+         * The visitor is called synchronously, in the calling thread, while the SDK is locked.
+         *
+         * @param parent Parent node
+         * @param visitor MegaNodeViewVisitor that will receive the children
+         * @param order Order in which the children are visited (see MegaApi::getChildren)
+         * @return false if the parent doesn't exist or isn't a folder, or the visitor stopped
+         * the visit. true otherwise
+         */
+        bool visitChildren(MegaNode *parent, MegaNodeViewVisitor *visitor, int order = ORDER_NONE);
+
         /**
          * @brief Returns true if the node has children
          * @return true if the node has children
@@ -15941,10 +17144,40 @@ class MegaApi
         *
         * You take the ownership of the returned value
         *
-        * @return List of MegaUserAlert objects
+        * @return List of MegaUserAlert objects, oldest first
         */
         MegaUserAlertList* getUserAlerts();
 
+        /**
+        * @brief Get a page of the MegaUserAlerts for the logged in user, newest first
+        *
+        * With a local cache, the SDK only keeps the most recent alerts in memory, and reads
+        * older ones from the cache. Those are given a new MegaUserAlert::getId each time they
+        * are read.
+        *
+        * You take the ownership of the returned value
+        *
+        * @param offset Number of alerts to skip, from the newest one
+        * @param count Maximum number of alerts to return
+        * @return List of MegaUserAlert objects, newest first
+        */
+        MegaUserAlertList* getUserAlerts(int offset, int count);
+
+        /**
+        * @brief Get the nodes of a MegaUserAlert::TYPE_NEWSHAREDNODES alert
+        *
+        * MegaUserAlert::getHandle lists up to 100 folders and 100 files of an alert, while
+        * MegaUserAlert::getNumber counts all of them. This function returns them all: those
+        * not listed are read from the local node cache, as the children of the parent folder
+        * that the user of the alert added from the time of the alert on.
+        *
+        * You take the ownership of the returned value
+        *
+        * @param alert Alert of type MegaUserAlert::TYPE_NEWSHAREDNODES
+        * @return List of the nodes still available, folders first
+        */
+        MegaNodeList* getUserAlertNodes(MegaUserAlert* alert);
+
         /**
          * @brief Get the number of unread user alerts for the logged in user
          *
@@ -17283,6 +18516,59 @@ class MegaApi
          */
         MegaNodeList* searchByType(MegaNode *node, const char *searchString, MegaCancelToken *cancelToken, bool recursive = true, int order = ORDER_NONE, int type = FILE_TYPE_DEFAULT, int target = SEARCH_TARGET_ALL);
 
+        /**
+         * @brief Search nodes in the background, receiving the results as they are found
+         *
+         * It takes the same search parameters as MegaApi::searchByType, but it returns immediately.
+         * The search runs on a thread of its own and the client keeps working meanwhile.
+         *
+         * Searches by name deliver the nodes found in pages, through onRequestUpdate, in no particular
+         * order. When the search ends, onRequestFinish receives all of them, in the requested order.
+         * Searches by type only (no search string) and those in the share roots only (targets
+         * MegaApi::SEARCH_TARGET_INSHARE and MegaApi::SEARCH_TARGET_OUTSHARE, not recursive) deliver
+         * all their results in a single update.
+         *
+         * Only one search runs at a time: a new call cancels the search in progress, which finishes
+         * with MegaError::API_EINCOMPLETE. That suits type-ahead search: call this method for every
+         * change of the search string. When the new search string contains the previous one and the
+         * rest of parameters don't change, the new search only filters the previous results, as long
+         * as no node has changed since (and none of them includes the wildcards '*', '?' or '[').
+         *
+         * The associated request type with this request is MegaRequest::TYPE_SEARCH
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getNodeHandle - Returns the handle of the parent node, if any
+         * - MegaRequest::getText - Returns the search string
+         * - MegaRequest::getFlag - Returns true if the search is recursive
+         * - MegaRequest::getNumber - Returns the order of the results
+         * - MegaRequest::getParamType - Returns the type of nodes
+         * - MegaRequest::getAccess - Returns the search target
+         *
+         * Valid data in the MegaRequest object received in onRequestUpdate:
+         * - MegaRequest::getMegaNodeList - Returns the nodes found since the previous update
+         * - MegaRequest::getTransferredBytes - Returns the number of nodes found so far
+         *
+         * Valid data in the MegaRequest object received in onRequestFinish when the error code
+         * is MegaError::API_OK:
+         * - MegaRequest::getMegaNodeList - Returns all the nodes found, in the requested order
+         *
+         * On the onRequestFinish error, the error code associated to the MegaError can be:
+         * - MegaError::API_EARGS - Invalid parameters (see MegaApi::searchByType)
+         * - MegaError::API_ENOENT - The parent node doesn't exist
+         * - MegaError::API_EACCESS - There are no nodes to search (ie. not logged in)
+         * - MegaError::API_EINCOMPLETE - Superseded by a newer search
+         *
+         * @param node The parent node of the tree to explore, or NULL to search in a target
+         * @param searchString Search string. The search is case-insensitive
+         * @param recursive True if you want to search recursively in the node tree.
+         * False if you want to search in the children of the node only
+         * @param order Order for the final list. See MegaApi::searchByType for the valid values
+         * @param type Type of nodes requested in the search. See MegaApi::searchByType
+         * @param target Target type where this method will search, if no node is provided.
+         * See MegaApi::searchByType
+         * @param listener MegaRequestListener to track this request
+         */
+        void searchAsync(MegaNode *node, const char *searchString, bool recursive = true, int order = ORDER_NONE, int type = FILE_TYPE_DEFAULT, int target = SEARCH_TARGET_ALL, MegaRequestListener *listener = NULL);
+
         /**
          * @brief Return a list of buckets, each bucket containing a list of recently added/modified nodes
          *
@@ -17350,6 +18636,32 @@ class MegaApi
          */
         bool processMegaTree(MegaNode* node, MegaTreeProcessor* processor, bool recursive = 1);
 
+        /**
+         * @brief Process a large node tree reading it folder by folder from the local cache
+         *
+         * Unlike MegaApi::processMegaTree, the tree is visited breadth-first: the children of a folder
+         * are processed, in the order they are stored, before the nodes in its subfolders. The node
+         * passed as parameter is not processed. Files that weren't already loaded in memory are released
+         * again once processed, so the memory used doesn't grow with the size of the tree.
+         *
+         * When called from a thread other than the SDK thread, the SDK isn't blocked while the
+         * MegaTreeProcessor is working on the nodes.
+         *
+         * This function only supports nodes of the logged in account or folder link.
+         *
+         * @param node The parent node of the tree to explore
+         * @param processor MegaTreeProcessor that will receive callbacks for every node in the tree
+         * @param prefetch Number of folders whose children are read in a single step. Larger values
+         * mean fewer steps, at the cost of keeping more nodes in memory at a time
+         * @param threads Number of threads calling MegaTreeProcessor::processMegaNode. With more than one,
+         * the processor must be thread-safe and the calls for the nodes of a step can come in any order
+         *
+         * @return True if all nodes were processed. False otherwise (the operation can be
+         * cancelled by MegaTreeProcessor::processMegaNode(), and fails if the node isn't found
+         * or the account is logged out meanwhile)
+         */
+        bool processMegaTreeStreamed(MegaNode* node, MegaTreeProcessor* processor, int prefetch = 1, int threads = 1);
+
         /**
          * @brief Create a MegaNode that represents a file of a different account
          *
@@ -18512,7 +19824,10 @@ class MegaApi
          * will be still active even if the server is stopped and started again.
          *
          * @param bufferSize Maximum buffer size (in bytes) or a number <= 0 to use the
-         * internal default value
+         * internal default value. By default, the buffer of each stream is sized to keep
+         * some seconds of playback (according to the bitrate of media files) or of download
+         * (according to the throughput of the connection), within a global memory limit
+         * shared by all streams.
          */
         void httpServerSetMaxBufferSize(int bufferSize);
 
@@ -18561,6 +19876,65 @@ class MegaApi
          */
         int httpServerGetMaxOutputSize();
 
+        /**
+         * @brief Set the number of event loops of the HTTP proxy server
+         *
+         * By default, the HTTP proxy server handles all its connections in a single thread.
+         * With more than one event loop, each loop runs in its own thread and listens on the
+         * same port, and new connections are spread across them by the operating system.
+         * That allows many concurrent clients (i.e. a WebDAV gateway) to use more than one core.
+         *
+         * Each connection stays in the loop that accepted it, including the data of its
+         * streaming transfer.
+         *
+         * This is only available on systems supporting SO_REUSEPORT. Otherwise, or if the
+         * port can't be shared, the server uses a single event loop.
+         *
+         * The new value will be taken into account the next time the HTTP proxy server is
+         * started. It's possible to call this function before the server has been started.
+         *
+         * @param loops Number of event loops (a number < 1 is the same as 1)
+         */
+        void httpServerSetEventLoops(int loops);
+
+        /**
+         * @brief Get the number of event loops of the HTTP proxy server
+         *
+         * See MegaApi::httpServerSetEventLoops
+         *
+         * @return Number of event loops
+         */
+        int httpServerGetEventLoops();
+
+        /**
+         * @brief Let the kernel encrypt the data sent by the HTTP proxy server with TLS
+         *
+         * When the server uses TLS (see MegaApi::httpServerStart), the data sent to clients is
+         * encrypted by the SDK. When this option is enabled, after the handshake of each
+         * connection the keys to send are handed to the kernel (kernel TLS), which encrypts the
+         * data from then on, saving CPU time and a copy of the data.
+         *
+         * This is only available on Linux, with the "tls" kernel module loaded. To make the
+         * sessions suitable, the server negotiates TLS 1.2 and prefers AES-GCM ciphers. For
+         * other sessions, the SDK keeps encrypting the data. Connections using kernel TLS are
+         * closed without sending a TLS close_notify alert.
+         *
+         * The new value will be taken into account the next time the HTTP proxy server is
+         * started. It's possible to call this function before the server has been started.
+         *
+         * @param enable True to let the kernel encrypt the data sent
+         */
+        void httpServerEnableKernelTls(bool enable);
+
+        /**
+         * @brief Check if the HTTP proxy server lets the kernel encrypt the data sent with TLS
+         *
+         * See MegaApi::httpServerEnableKernelTls
+         *
+         * @return True if the kernel encrypts the data sent, where supported
+         */
+        bool httpServerIsKernelTlsEnabled();
+
         /**
          * @brief Start an FTP server in specified port
          *
@@ -18777,7 +20151,10 @@ class MegaApi
          * will be still active even if the server is stopped and started again.
          *
          * @param bufferSize Maximum buffer size (in bytes) or a number <= 0 to use the
-         * internal default value
+         * internal default value. By default, the buffer of each stream is sized to keep
+         * some seconds of playback (according to the bitrate of media files) or of download
+         * (according to the throughput of the connection), within a global memory limit
+         * shared by all streams.
          */
         void ftpServerSetMaxBufferSize(int bufferSize);
 
@@ -18826,6 +20203,81 @@ class MegaApi
          */
         int ftpServerGetMaxOutputSize();
 
+        /**
+         * @brief Reply to STOR commands without waiting for the upload to MEGA
+         *
+         * By default, the FTP server answers a STOR command when the file received through
+         * the data channel has been uploaded to MEGA, so clients sending several files wait
+         * for each upload before sending the next one.
+         *
+         * When this option is enabled, the FTP server answers as soon as the file has been
+         * received, while the upload continues in the background. Clients can then send the
+         * next files in the meantime, but they aren't notified if an upload fails (the
+         * failure is only logged) and the uploaded file could not be available yet right
+         * after the answer.
+         *
+         * It's possible to call this function even before the server has been started,
+         * and the value will be still active even if the server is stopped and started again.
+         *
+         * @param enable True to answer STOR commands before the upload finishes
+         */
+        void ftpServerSetUploadPipelining(bool enable);
+
+        /**
+         * @brief Check if the FTP server answers STOR commands before the upload finishes
+         *
+         * See MegaApi::ftpServerSetUploadPipelining
+         *
+         * @return True if the FTP server answers STOR commands before the upload finishes
+         */
+        bool ftpServerIsUploadPipelining();
+
+        /**
+         * @brief Let the kernel encrypt the data sent by the FTP server with TLS
+         *
+         * It applies to the control and data connections of an FTP server using TLS
+         * (see MegaApi::ftpServerStart), with the same requirements and behavior as
+         * MegaApi::httpServerEnableKernelTls.
+         *
+         * The new value will be taken into account the next time the FTP server is
+         * started. It's possible to call this function before the server has been started.
+         *
+         * @param enable True to let the kernel encrypt the data sent
+         */
+        void ftpServerEnableKernelTls(bool enable);
+
+        /**
+         * @brief Check if the FTP server lets the kernel encrypt the data sent with TLS
+         *
+         * See MegaApi::ftpServerEnableKernelTls
+         *
+         * @return True if the kernel encrypts the data sent, where supported
+         */
+        bool ftpServerIsKernelTlsEnabled();
+
+        /**
+         * @brief Keep the data streamed by the HTTP and FTP proxy servers in a disk cache
+         *
+         * By default, the proxy servers only buffer in memory the data of the ongoing requests
+         * (see MegaApi::httpServerSetMaxBufferSize), so each new request of a range of a file
+         * (ie. a seek of a media player) downloads it again from MEGA.
+         *
+         * With the cache, the data received is also written to disk, indexed by node and range.
+         * The parts of a request already in the cache are served from it, and only the missing
+         * ones are downloaded. When the cache exceeds the maximum size, the files used the least
+         * recently are removed. Both servers share the cache.
+         *
+         * The cache only lasts while the MegaApi object exists: the files already in the folder
+         * are removed when it's set.
+         *
+         * The new cache is used by the requests received after this call.
+         *
+         * @param path Folder for the cache (it's created if needed), or NULL to disable it
+         * @param maxSize Maximum size of the cache (in bytes)
+         * @return True if the cache is ready (or disabled, if path is NULL)
+         */
+        bool setStreamingCache(const char *path, long long maxSize);
+
 #endif
 
         /**
@@ -20360,6 +21812,59 @@ class MegaApi
          */
         void removeSetElement(MegaHandle sid, MegaHandle eid, MegaRequestListener* listener = nullptr);
 
+        /**
+         * @brief Request creation of multiple Elements for a Set, with a single request to the API
+         *
+         * The associated request type with this request is MegaRequest::TYPE_PUT_SET_ELEMENTS
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getTotalBytes - Returns the id of the Set
+         * - MegaRequest::getMegaHandleList - Returns the file-nodes of the new Elements
+         * - MegaRequest::getMegaStringList - Returns the names of the new Elements, if any
+         *
+         * Valid data in the MegaRequest object received in onRequestFinish when the error code
+         * is MegaError::API_OK:
+         * - MegaRequest::getMegaSetElementList - Returns the Elements created
+         * - MegaRequest::getMegaIntegerList - Returns the error code of each requested Element, in the
+         * order of the nodes. An Element was created if and only if its error code is MegaError::API_OK
+         *
+         * On the onRequestFinish error, the error code associated to the MegaError can be:
+         * - MegaError::API_ENOENT - Set could not be found.
+         * - MegaError::API_EARGS - No nodes, or different number of nodes and names.
+         * - MegaError::API_EINTERNAL - Received answer could not be read or decrypted.
+         * - MegaError::API_EACCESS - Permissions Error (from API).
+         *
+         * @param sid the id of the Set that will own the new Elements
+         * @param nodes the handles of the file-nodes that will be represented by the new Elements
+         * @param names the names that should be given to the new Elements, in the order of the nodes; it
+         * can be null, and an empty string leaves the Element without name
+         * @param listener MegaRequestListener to track this request
+         */
+        void createSetElements(MegaHandle sid, const MegaHandleList* nodes, const MegaStringList* names = nullptr, MegaRequestListener* listener = nullptr);
+
+        /**
+         * @brief Request to remove multiple Elements of a Set, with a single request to the API
+         *
+         * The associated request type with this request is MegaRequest::TYPE_REMOVE_SET_ELEMENTS
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getTotalBytes - Returns the id of the Set
+         * - MegaRequest::getMegaHandleList - Returns the ids of the Elements to be removed
+         *
+         * Valid data in the MegaRequest object received in onRequestFinish when the error code
+         * is MegaError::API_OK:
+         * - MegaRequest::getMegaIntegerList - Returns the error code of each requested Element, in order
+         *
+         * On the onRequestFinish error, the error code associated to the MegaError can be:
+         * - MegaError::API_ENOENT - Set could not be found.
+         * - MegaError::API_EARGS - No Elements were given.
+         * - MegaError::API_EINTERNAL - Received answer could not be read.
+         * - MegaError::API_EACCESS - Permissions Error (from API).
+         *
+         * @param sid the id of the Set that owns the Elements
+         * @param eids the ids of the Elements to be removed
+         * @param listener MegaRequestListener to track this request
+         */
+        void removeSetElements(MegaHandle sid, const MegaHandleList* eids, MegaRequestListener* listener = nullptr);
+
         /**
          * @brief Get a list of all Sets available for current user.
          *
@@ -20415,6 +21920,24 @@ class MegaApi
          */
         MegaSetElementList* getSetElements(MegaHandle sid);
 
+        /**
+         * @brief Get a page of the Elements in the Set with given id, for current user.
+         *
+         * The Elements are sorted by their order (see MegaSetElement::order), then by id, so
+         * consecutive pages return each Element once while the Set does not change.
+         *
+         * The response value is stored as a MegaSetElementList.
+         *
+         * You take the ownership of the returned value
+         *
+         * @param sid the id of the Set owning the Elements
+         * @param offset the number of Elements to skip
+         * @param count the maximum number of Elements to return
+         *
+         * @return up to count Elements in that Set (an empty list past its end)
+         */
+        MegaSetElementList* getSetElements(MegaHandle sid, unsigned offset, unsigned count);
+
         /**
          * @brief Get a particular Element in a particular Set, for current user.
          *
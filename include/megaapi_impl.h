@@ -105,10 +105,12 @@ using MegaGfxProvider = GfxProviderExternal;
     #endif
 #endif
 
+class FileAttributeCache;
 #ifdef HAVE_LIBUV
 class MegaTCPServer;
 class MegaHTTPServer;
 class MegaFTPServer;
+class StreamingCache;
 #endif
 
 typedef std::vector<int8_t> MegaSmallIntVector;
@@ -263,7 +265,8 @@ public:
     bool isCancelledByFolderTransferToken();
 
     // check if we have received onTransferFinishCallback for every transfersTotalCount
-    bool allSubtransfersResolved()              { return  transfersFinishedCount >= transfersTotalCount; }
+    // (and no more sub-transfers are to come)
+    bool allSubtransfersResolved()              { return  !mMoreSubtransfersExpected && transfersFinishedCount >= transfersTotalCount; }
 
     // setter/getter for transfersTotalCount
     void setTransfersTotalCount (size_t count)  { transfersTotalCount = count; }
@@ -298,6 +301,9 @@ protected:
     // flag to notify STAGE_TRANSFERRING_FILES to apps, when all sub-transfers have been queued in SDK core already
     bool startedTransferring = false;
 
+    // set while sub-transfers are sent in batches, until the last batch is sent
+    bool mMoreSubtransfersExpected = false;
+
     // If the thread was started, it queues a completion before exiting
     // That will be executed when the queued request is procesed
     // We also keep a pointer to it here, so cancel() can execute it early.
@@ -350,7 +356,7 @@ protected:
         string folderName;
 
         // Only figure out the fs type per folder (and on the worker thread), as it is expensive
-		FileSystemType fsType;
+		FileSystemType fsType = FS_UNKNOWN;
 
         // If there is already a cloud node with this name for this parent, this is set
         // It also becomes set after we have created a cloud node for this folder
@@ -382,7 +388,8 @@ protected:
     };
     Tree mUploadTree;
 
-    /* Scan entire tree recursively, and retrieve folder structure and files to be uploaded.
+    /* Scan entire tree, and retrieve folder structure and files to be uploaded.
+     * Folders are listed and fingerprinted in parallel, on the ScanService's threads.
      * A putnodes command can only add subtrees under same target, so in case we need to add
      * subtrees under different targets, this method will generate a subtree for each one.
      * This happens on the worker thread.
@@ -396,6 +403,18 @@ protected:
     enum batchResult { batchResult_cancelled, batchResult_requestSent, batchResult_batchesComplete, batchResult_stillRecursing };
     batchResult createNextFolderBatch(Tree& tree, vector<NewNode>& newnodes, bool isBatchRootLevel);
 
+    // Folder batches grow while full ones come back well within FOLDER_BATCH_TARGET_MS, and shrink
+    // when they take much longer, between MIN_FOLDER_BATCH and MAX_FOLDER_BATCH nodes.
+    // The encrypted keys and attributes of a batch are also capped, as names can be long.
+    static const size_t MIN_FOLDER_BATCH = 100;
+    static const size_t MAX_FOLDER_BATCH = 4 * MAXNODESUPLOAD;
+    static const size_t MAX_FOLDER_BATCH_BYTES = 1 << 20;
+    static const long long FOLDER_BATCH_TARGET_MS = 2000;
+    size_t mFolderBatchSize = MAXNODESUPLOAD;
+    size_t mFolderBatchBytes = 0;
+    bool folderBatchFull(const vector<NewNode>& newnodes) const;
+    void adaptFolderBatchSize(size_t sent, std::chrono::milliseconds elapsed);
+
     // Iterate through all pending files of each uploaded folder, and start all upload transfers
     bool genUploadTransfersForFiles(Tree& tree, TransferQueue& transferQueue);
 };
@@ -480,6 +499,7 @@ protected:
 
     // backup instance related
     handle currentHandle;
+    handle previousHandle; // last complete backup, unchanged files are copied from it
     std::string currentName;
     std::list<LocalPath> pendingFolders;
     std::vector<MegaTransfer *> failedTransfers;
@@ -503,6 +523,10 @@ protected:
     bool checkCompletion();
     bool isBusy() const;
     int64_t getLastBackupTime();
+    handle getLastCompleteBackup();
+    MegaNode* getPreviousFolder(const LocalPath& localPath);
+    void uploadFile(const LocalPath& localPath, MegaNode* parent, FileSystemType fsType);
+    void copyUnchangedFiles(handle parent, vector<std::pair<handle, LocalPath>>&& files, FileSystemType fsType);
     long long getNextStartTimeDs(long long oldStartTimeds = -1) const;
 
     std::string epochdsToString(int64_t rawtimeds) const;
@@ -575,6 +599,27 @@ protected:
 
     // Iterate through all pending files, and start all download transfers
     bool genDownloadTransfersForFiles(FileSystemType fsType, TransferQueue& transferQueue);
+
+    // Create the folders of mLocalTree on the worker thread, then start its downloads.
+    // When streaming, the next batch is explored and started in turn.
+    void startBatch(FileSystemType fsType);
+
+    // Streaming mode: folders still to explore (depth first, which keeps this short),
+    // and files and folders gathered per batch (0 when not streaming)
+    struct PendingFolder
+    {
+        unique_ptr<MegaNode> node;
+        LocalPath localPath;
+    };
+    vector<PendingFolder> mPendingFolders;
+    size_t mBatchSize = 0;
+    unsigned mFileAddedCount = 0;
+
+    // Streaming mode: explore pending folders into mLocalTree until it holds a batch
+    scanFolder_result expandNextBatch(FileSystemType fsType);
+
+    // Streaming mode: no more batches. Completes now if no sub-transfer is outstanding.
+    void endBatches(Error e, bool cancelledByUser);
 };
 
 class MegaNodePrivate : public MegaNode, public Cacheable
@@ -656,6 +701,10 @@ class MegaNodePrivate : public MegaNode, public Cacheable
         static MegaNode *fromNode(Node *node);
         MegaNode *copy() override;
 
+        // MegaNode::CHANGE_TYPE_* bits of the pending changes of a node
+        static int changesOf(const Node *node);
+        void setChanges(int changes);
+
         char *serialize() override;
         bool serialize(string*) override;
         static MegaNodePrivate* unserialize(string*);
@@ -706,6 +755,25 @@ class MegaNodePrivate : public MegaNode, public Cacheable
         bool mIsNodeKeyDecrypted = false;
 };
 
+// points at a Node, which must stay alive (and the client locked) while it's in use
+class MegaNodeViewPrivate : public MegaNodeView
+{
+public:
+    void setNode(Node* node) { mNode = node; }
+
+    MegaHandle getHandle() const override;
+    MegaHandle getParentHandle() const override;
+    int getType() const override;
+    const char* getName() const override;
+    int64_t getSize() const override;
+    int64_t getCreationTime() const override;
+    int64_t getModificationTime() const override;
+    MegaNode* copy() const override;
+
+private:
+    Node* mNode = nullptr;
+};
+
 
 class MegaSetPrivate : public MegaSet
 {
@@ -917,6 +985,41 @@ private:
     vector<int64_t> mIntegers;
 };
 
+class MegaMetricsSnapshotPrivate : public MegaMetricsSnapshot
+{
+public:
+    MegaMetricsSnapshotPrivate(vector<Metrics::Entry>&& entries);
+    MegaMetricsSnapshot *copy() const override;
+    int size() const override;
+    const char *getName(int i) const override;
+    int getType(int i) const override;
+    long long getValue(int i) const override;
+    long long getSumMicroseconds(int i) const override;
+    long long getPercentileMicroseconds(int i, double percentile) const override;
+    char *toOpenMetrics() const override;
+
+private:
+    vector<Metrics::Entry> mEntries;
+    const Metrics::Entry* entry(int i) const;
+};
+
+class MegaMemoryReportPrivate : public MegaMemoryReport
+{
+public:
+    MegaMemoryReportPrivate(MemoryReport&& report);
+    MegaMemoryReport *copy() const override;
+    int size() const override;
+    const char *getSubsystem(int i) const override;
+    long long getObjects(int i) const override;
+    long long getBytes(int i) const override;
+    long long getTotalBytes() const override;
+    char *toJson() const override;
+
+private:
+    MemoryReport mReport;
+    const MemoryReport::Entry* entry(int i) const;
+};
+
 class MegaSharePrivate : public MegaShare
 {
 	public:
@@ -1004,6 +1107,9 @@ class MegaTransferPrivate : public MegaTransfer, public Cacheable
         void setForeignOverquota(bool backupTransfer);
         void setForceNewUpload(bool forceNewUpload);
         void setStreamingTransfer(bool streamingTransfer);
+        // streaming transfer that reads the rest of the file in order (i.e. FTP RETR)
+        void setSequentialRead(bool sequentialRead);
+        bool isSequentialRead() const;
         void setLastBytes(char *lastBytes);
         void setLastError(const MegaError *e);
         void setFolderTransferTag(int tag);
@@ -1073,6 +1179,9 @@ class MegaTransferPrivate : public MegaTransfer, public Cacheable
         MegaCancelToken* getCancelToken() override;
         bool isRecursive() const { return recursiveOperation.get() != nullptr; }
 
+        void setTimeline(const TransferTimeline& timeline);
+        const char* getTimeline() const override;
+
         CancelToken& accessCancelToken() { return mCancelToken.cancelFlag; }
 
         // for uploads, we fingerprint the file before queueing
@@ -1081,6 +1190,10 @@ class MegaTransferPrivate : public MegaTransfer, public Cacheable
         nodetype_t fingerprint_filetype = TYPE_UNKNOWN;
         FileFingerprint fingerprint_onDisk;
 
+        // transferred bytes and time of the last progress reported to the listeners
+        m_off_t progressNotifiedBytes = 0;
+        dstime progressNotifiedTime = 0;
+
 protected:
         int type;
         int tag;
@@ -1096,6 +1209,7 @@ protected:
             bool backupTransfer : 1;
             bool foreignOverquota : 1;
             bool forceNewUpload : 1;
+            bool sequentialRead : 1;
         };
 
         int64_t startTime;
@@ -1131,6 +1245,10 @@ protected:
 
         bool mTargetOverride;
 
+        // copied from the Transfer with each update; the JSON is made when first asked for
+        TransferTimeline mTimeline;
+        mutable string mTimelineJson;
+
     public:
         // use shared_ptr here so callbacks can use a weak_ptr
         // to protect against the operation being cancelled in the meantime
@@ -1381,6 +1499,28 @@ class MegaSyncListPrivate : public MegaSyncList
         int s;
 };
 
+class MegaSyncStatsPrivate : public MegaSyncStats
+{
+public:
+    MegaSyncStatsPrivate(handle backupId, const SyncStats& stats);
+
+    MegaSyncStats *copy() const override;
+
+    MegaHandle getBackupId() const override;
+    long long getNotificationsPending() const override;
+    long long getRetriesPending() const override;
+    long long getStateCachePending() const override;
+    long long getUploadsPending() const override;
+    long long getDownloadsPending() const override;
+    long long getCallCount(int operation) const override;
+    long long getTimeSpent(int operation) const override;
+    long long getFullRescans() const override;
+
+private:
+    handle mBackupId;
+    SyncStats mStats;
+};
+
 #endif // ENABLE_SYNC
 
 
@@ -1512,6 +1652,12 @@ class MegaRequestPrivate : public MegaRequest
         MegaSetElementList* getMegaSetElementList() const override;
         void setMegaSetElementList(std::unique_ptr<MegaSetElementList> els);
 
+        MegaNodeList* getMegaNodeList() const override;
+        void setMegaNodeList(std::unique_ptr<MegaNodeList> nodes);
+
+        MegaIntegerList* getMegaIntegerList() const override;
+        void setMegaIntegerList(std::unique_ptr<MegaIntegerList> integers);
+
 protected:
         std::shared_ptr<AccountDetails> accountDetails;
         MegaPricingPrivate *megaPricing;
@@ -1566,6 +1712,8 @@ protected:
         unique_ptr<MegaBannerListPrivate> mBannerList;
         unique_ptr<MegaSet> mMegaSet;
         unique_ptr<MegaSetElementList> mMegaSetElementList;
+        unique_ptr<MegaNodeList> mNodeList;
+        unique_ptr<MegaIntegerList> mIntegerList;
 
     public:
         shared_ptr<ExecuteOnce> functionToExecute;
@@ -2069,6 +2217,36 @@ class MegaNodeListPrivate : public MegaNodeList
 		int s;
 };
 
+// The list given to onNodesUpdate: handles, changes and parents are known upfront,
+// the MegaNode of a position is only built when it's first asked for.
+class MegaNodeUpdateListPrivate : public MegaNodeListPrivate
+{
+    public:
+        struct Update
+        {
+            MegaHandle handle;
+            MegaHandle parentHandle;
+            int changes;
+
+            // valid while the list is being delivered
+            Node* node = nullptr;
+
+            // as the node was, for nodes that are gone by delivery
+            unique_ptr<MegaNode> snapshot;
+        };
+
+        MegaNodeUpdateListPrivate(Node** nodes, int size);
+        MegaNodeUpdateListPrivate(vector<Update>&& updates);
+
+        MegaNode* get(int i) const override;
+        MegaHandle getHandle(int i) const override;
+        int getChanges(int i) const override;
+        MegaHandle getParentHandle(int i) const override;
+
+    private:
+        vector<Update> mUpdates;
+};
+
 class MegaChildrenListsPrivate : public MegaChildrenLists
 {
     public:
@@ -2128,6 +2306,33 @@ class MegaTransferListPrivate : public MegaTransferList
 		int s;
 };
 
+class MegaTransferProgressListPrivate : public MegaTransferProgressList
+{
+    public:
+        struct Entry
+        {
+            int tag;
+            int type;
+            long long transferredBytes;
+            long long totalBytes;
+            long long speed;
+        };
+
+        MegaTransferProgressListPrivate(vector<Entry>&& entries);
+
+        MegaTransferProgressList* copy() const override;
+        int size() const override;
+        int getTag(int i) const override;
+        int getType(int i) const override;
+        long long getTransferredBytes(int i) const override;
+        long long getTotalBytes(int i) const override;
+        long long getSpeed(int i) const override;
+
+    private:
+        vector<Entry> mEntries;
+        const Entry* entry(int i) const;
+};
+
 class MegaContactRequestListPrivate : public MegaContactRequestList
 {
     public:
@@ -2227,6 +2432,8 @@ public:
     bool analyseMediaInfo(const char* inputFilepath) override;
     char *encryptFile(const char* inputFilepath, int64_t startPos, m_off_t* length, const char *outputFilepath,
                      bool adjustsizeonly) override;
+    MegaStringList* encryptFileInPieces(const char* inputFilepath, int64_t pieceSize, const char* outputFilepathPrefix,
+                                        int threads) override;
     char *getUploadURL() override;
 
     bool serialize(string* s);
@@ -2300,13 +2507,98 @@ private:
     MegaFilePut() {}
 };
 
-//Thread safe request queue
+// Multiple producers, single consumer: push() never takes a lock, and the
+// consumer takes everything pushed so far with a single atomic exchange.
+template <typename T>
+class MpscInbox
+{
+    public:
+        MpscInbox() = default;
+        MEGA_DISABLE_COPY_MOVE(MpscInbox);
+
+        ~MpscInbox()
+        {
+            takeAll([](T*) {});
+        }
+
+        void push(T* value)
+        {
+            Link* link = new Link{value, mHead.load(std::memory_order_relaxed)};
+            while (!mHead.compare_exchange_weak(link->next, link, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        // all the values in a single exchange, kept in their order
+        void push(const std::vector<T*>& values)
+        {
+            if (values.empty())
+            {
+                return;
+            }
+
+            Link* oldest = new Link{values.front(), nullptr};
+            Link* newest = oldest;
+            for (size_t i = 1; i < values.size(); i++)
+            {
+                newest = new Link{values[i], newest};
+            }
+
+            oldest->next = mHead.load(std::memory_order_relaxed);
+            while (!mHead.compare_exchange_weak(oldest->next, newest, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        bool empty() const
+        {
+            return !mHead.load(std::memory_order_acquire);
+        }
+
+        // f is called for each value, oldest first
+        template <typename F>
+        void takeAll(F f)
+        {
+            Link* newest = mHead.exchange(nullptr, std::memory_order_acquire);
+
+            Link* oldest = nullptr;
+            while (newest)
+            {
+                Link* next = newest->next;
+                newest->next = oldest;
+                oldest = newest;
+                newest = next;
+            }
+
+            while (oldest)
+            {
+                Link* next = oldest->next;
+                f(oldest->value);
+                delete oldest;
+                oldest = next;
+            }
+        }
+
+    private:
+        struct Link
+        {
+            T* value;
+            Link* next;
+        };
+
+        std::atomic<Link*> mHead{nullptr};
+};
+
+// Thread safe request queue. App threads push to a lock-free inbox, which the
+// MegaApi thread moves to the queue in batches as it pops.
 class RequestQueue
 {
     protected:
+        // only ever touched with the mutex locked
         std::deque<MegaRequestPrivate *> requests;
         std::mutex mutex;
 
+        MpscInbox<MegaRequestPrivate> inbox;
+
+        // move what was pushed since the last call behind the queued requests
+        void drainInbox();
+
     public:
         RequestQueue();
         void push(MegaRequestPrivate *request);
@@ -2318,38 +2610,159 @@ class RequestQueue
 };
 
 
-//Thread safe transfer queue
+//Thread safe transfer queue, fed through a lock-free inbox like RequestQueue
 class TransferQueue
 {
     protected:
+        // only ever touched with the mutex locked
         std::deque<MegaTransferPrivate *> transfers;
         std::mutex mutex;
-        int lastPushedTransferTag = 0;
+        std::atomic<int> lastPushedTransferTag{0};
+
+        MpscInbox<MegaTransferPrivate> inbox;
+        void drainInbox();
 
     public:
         TransferQueue();
         void push(MegaTransferPrivate *transfer);
+        void push(const std::vector<MegaTransferPrivate *>& batch);
         void push_front(MegaTransferPrivate *transfer);
         MegaTransferPrivate * pop();
+
+        // true if the next transfer goes the same way as 'type' to or from the same parent,
+        // so that it's best handled in the same pass
+        bool nextIsRelated(int type, MegaHandle parentHandle, const string& parentPath);
+
+        // append the cloud fingerprints of up to 'max' file uploads at the head of the queue
+        void peekUploadFingerprints(size_t max, std::vector<FileFingerprint>& fingerprints);
         bool empty();
         size_t size();
         void clear();
 
-        /**
-         * @brief pops and returns transfer up to the designated one
-         * @param lastQueuedTransfer position of the last transfer to pop
-         * @param direction directio of transfers to pop
-         * @return
-         */
-        std::vector<MegaTransferPrivate *> popUpTo(int lastQueuedTransfer, int direction);
-
         void removeWithFolderTag(int folderTag, std::function<void(MegaTransferPrivate *)> callback);
         void removeListener(MegaTransferListener *listener);
-        int getLastPushedTag() const;
         void setAllCancelled(CancelToken t, int direction);
 };
 
 
+// Runs app listener callbacks on its own threads, so a slow listener doesn't stall
+// the SDK thread. The callbacks of a listener run one at a time, in the order posted.
+class ListenerDispatcher
+{
+    public:
+        ListenerDispatcher(unsigned threads);
+
+        // runs what was already posted, then stops
+        ~ListenerDispatcher();
+
+        MEGA_DISABLE_COPY_MOVE(ListenerDispatcher);
+
+        void post(const void* listener, std::function<void()> f);
+
+        // as post(), but once the listener is falling behind, a callback still pending
+        // for the same key is replaced by this one (the latest progress wins)
+        void postCoalesced(const void* listener, int key, std::function<void()> f);
+
+        // drop the callbacks pending for the listener, and wait for the one running,
+        // unless it is the caller
+        void forget(const void* listener);
+
+        // pending callbacks of a listener from which updates are coalesced
+        static const size_t COALESCE_BACKLOG = 64;
+
+    private:
+        struct Callback
+        {
+            bool coalescable;
+            int key;
+            std::function<void()> f;
+        };
+
+        struct Strand
+        {
+            std::deque<Callback> callbacks;
+            bool running = false;
+            std::thread::id runningOn;
+        };
+
+        void push(const void* listener, Callback&& callback);
+        void run();
+
+        std::mutex mMutex;
+        std::condition_variable mWork;
+        std::condition_variable mIdle;
+        std::map<const void*, Strand> mStrands;
+
+        // listeners with callbacks to run and none running
+        std::deque<const void*> mReady;
+
+        bool mStop = false;
+        std::vector<std::thread> mThreads;
+};
+
+// Delivers one event to sets of app listeners: posted to the dispatcher when there is one,
+// otherwise called right away. Posted callbacks run once the objects of the event may have
+// changed or gone, so share() gives them copies, while direct calls get the objects themselves.
+class ListenerFanout
+{
+    public:
+        explicit ListenerFanout(ListenerDispatcher* dispatcher) : mDispatcher(dispatcher) {}
+
+        template <typename T>
+        std::shared_ptr<T> share(T* object) const
+        {
+            if (!mDispatcher || !object)
+            {
+                return std::shared_ptr<T>(object, [](T*) {});
+            }
+            return std::shared_ptr<T>(object->copy());
+        }
+
+        std::shared_ptr<string> share(string* s) const
+        {
+            return mDispatcher ? std::make_shared<string>(*s) : std::shared_ptr<string>(s, [](string*) {});
+        }
+
+        // listeners may unregister themselves from their callback
+        template <typename L, typename F>
+        void call(const set<L*>& listeners, F f) const
+        {
+            for (typename set<L*>::const_iterator it = listeners.begin(); it != listeners.end(); )
+            {
+                L* l = *it++;
+                if (mDispatcher)
+                {
+                    mDispatcher->post(l, [f, l]() { f(l); });
+                }
+                else
+                {
+                    f(l);
+                }
+            }
+        }
+
+        // as call(), with ListenerDispatcher::postCoalesced()
+        template <typename L, typename F>
+        void callCoalesced(const set<L*>& listeners, int key, F f) const
+        {
+            for (typename set<L*>::const_iterator it = listeners.begin(); it != listeners.end(); )
+            {
+                L* l = *it++;
+                if (mDispatcher)
+                {
+                    mDispatcher->postCoalesced(l, key, [f, l]() { f(l); });
+                }
+                else
+                {
+                    f(l);
+                }
+            }
+        }
+
+    private:
+        ListenerDispatcher* mDispatcher;
+};
+
 class MegaApiImpl : public MegaApp
 {
     public:
@@ -2496,6 +2909,7 @@ class MegaApiImpl : public MegaApp
         bool createLocalFolder(const char *path);
         static Error createLocalFolder_unlocked(LocalPath & localPath, FileSystemAccess& fsaccess);
         void moveNode(MegaNode* node, MegaNode* newParent, MegaRequestListener *listener = NULL);
+        void moveNodes(MegaNodeList* nodes, MegaNode* newParent, MegaRequestListener *listener = NULL);
         void moveNode(MegaNode* node, MegaNode* newParent, const char *newName, MegaRequestListener *listener = NULL);
         void copyNode(MegaNode* node, MegaNode *newParent, MegaRequestListener *listener = NULL);
         void copyNode(MegaNode* node, MegaNode *newParent, const char* newName, MegaRequestListener *listener = NULL);
@@ -2522,6 +2936,9 @@ class MegaApiImpl : public MegaApp
         void setThumbnailByHandle(MegaNode* node, MegaHandle attributehandle, MegaRequestListener *listener = NULL);
         void getPreview(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener = NULL);
 		void cancelGetPreview(MegaNode* node, MegaRequestListener *listener = NULL);
+        void cancelGetThumbnailsExcept(MegaHandleList* nodeHandles, MegaRequestListener *listener = NULL);
+        void cancelGetPreviewsExcept(MegaHandleList* nodeHandles, MegaRequestListener *listener = NULL);
+        bool setFileAttributesCache(const char* path, long long maxSize);
         void setPreview(MegaNode* node, const char *srcFilePath, MegaRequestListener *listener = NULL);
         void putPreview(MegaBackgroundMediaUpload* node, const char *srcFilePath, MegaRequestListener *listener = NULL);
         void setPreviewByHandle(MegaNode* node, MegaHandle attributehandle, MegaRequestListener *listener = NULL);
@@ -2549,6 +2966,7 @@ class MegaApiImpl : public MegaApp
         void setDriveName(const char* pathToDrive, const char *driveName, MegaRequestListener *listener = NULL);
         void getUserEmail(MegaHandle handle, MegaRequestListener *listener = NULL);
         void setCustomNodeAttribute(MegaNode *node, const char *attrName, const char *value, MegaRequestListener *listener = NULL);
+        void setNodesCustomAttribute(MegaNodeList *nodes, const char *attrName, const char *value, MegaRequestListener *listener = NULL);
         void setNodeS4(MegaNode *node, const char *value, MegaRequestListener *listener = NULL);
         void setNodeDuration(MegaNode *node, int secs, MegaRequestListener *listener = NULL);
         void setNodeLabel(MegaNode *node, int label, MegaRequestListener *listener = NULL);
@@ -2607,8 +3025,10 @@ class MegaApiImpl : public MegaApp
         void startUpload(bool startFirst, const char* localPath, MegaNode* parent, const char* fileName, const char* targetUser, int64_t mtime, int folderTransferTag, bool isBackup, const char* appData, bool isSourceFileTemporary, bool forceNewUpload, FileSystemType fsType, CancelToken cancelToken, MegaTransferListener* listener);
         MegaTransferPrivate* createUploadTransfer(bool startFirst, const char *localPath, MegaNode *parent, const char *fileName, const char *targetUser, int64_t mtime, int folderTransferTag, bool isBackup, const char *appData, bool isSourceFileTemporary, bool forceNewUpload, FileSystemType fsType, CancelToken cancelToken, MegaTransferListener *listener, const FileFingerprint* preFingerprintedFile = nullptr);
         void startDownload (bool startFirst, MegaNode *node, const char* localPath, const char *customName, int folderTransferTag, const char *appData, CancelToken cancelToken, MegaTransferListener *listener);
+        void startUploads(MegaStringList* localPaths, MegaNode* parent, const char* appData, bool startFirst, CancelToken cancelToken, MegaTransferListener* listener);
+        void startDownloads(MegaNodeList* nodes, const char* localFolder, const char* appData, bool startFirst, CancelToken cancelToken, MegaTransferListener* listener);
         MegaTransferPrivate* createDownloadTransfer(bool startFirst, MegaNode *node, const char* localPath, const char *customName, int folderTransferTag, const char *appData, CancelToken cancelToken, MegaTransferListener *listener, FileSystemType fsType);
-        void startStreaming(MegaNode* node, m_off_t startPos, m_off_t size, MegaTransferListener *listener);
+        void startStreaming(MegaNode* node, m_off_t startPos, m_off_t size, MegaTransferListener *listener, bool sequential = false);
         void setStreamingMinimumRate(int bytesPerSecond);
         void retryTransfer(MegaTransfer *transfer, MegaTransferListener *listener = NULL);
         void cancelTransfer(MegaTransfer *transfer, MegaRequestListener *listener=NULL);
@@ -2628,6 +3048,23 @@ class MegaApiImpl : public MegaApp
         void setUploadMethod(int method);
         bool setMaxDownloadSpeed(m_off_t bpslimit);
         bool setMaxUploadSpeed(m_off_t bpslimit);
+        bool setHttp2Multiplexing(bool enable);
+        void setRequestBatching(int maxCommands, long long maxBytes, int lingerMs);
+        void setLocalCacheCommitGrouping(int maxLagMs, int maxPending);
+        void setLocalCacheTuning(long long mmapSizeBytes, long long cacheSizeKb, int walCheckpointPages);
+        void setParallelRequests(int count);
+        void setFolderDownloadBatchSize(int nodes);
+        void setNodesUpdateCoalescing(bool enable);
+        void setListenerDispatchThreads(int threads);
+        void setTransferUpdatePolicy(int minIntervalMs, long long minBytes, bool aggregate);
+        void setSlowLoopThreshold(int milliseconds);
+        MegaMemoryReport* getMemoryReport();
+        static bool setThreadPoolConfig(int pool, int size, MegaIntegerList *cpus, int niceLevel);
+        static int getThreadPoolThreadCount(int pool);
+        static long long getThreadPoolQueueDepth(int pool);
+        static double getThreadPoolUtilization(int pool, bool reset);
+        static MegaMetricsSnapshot* getMetricsSnapshot();
+        static void setSharedWorkers(bool enable);
         int getMaxDownloadSpeed();
         int getMaxUploadSpeed();
         int getCurrentDownloadSpeed();
@@ -2651,12 +3088,15 @@ class MegaApiImpl : public MegaApp
         void fetchSet(MegaHandle sid, MegaRequestListener* listener = nullptr);
         void putSetElement(MegaHandle sid, MegaHandle eid, MegaHandle node, int optionFlags, int64_t order, const char* name, MegaRequestListener* listener = nullptr);
         void removeSetElement(MegaHandle sid, MegaHandle eid, MegaRequestListener* listener = nullptr);
+        void createSetElements(MegaHandle sid, const MegaHandleList* nodes, const MegaStringList* names, MegaRequestListener* listener = nullptr);
+        void removeSetElements(MegaHandle sid, const MegaHandleList* eids, MegaRequestListener* listener = nullptr);
 
         MegaSetList* getSets();
         MegaSet* getSet(MegaHandle sid);
         MegaHandle getSetCover(MegaHandle sid);
         unsigned getSetElementCount(MegaHandle sid);
         MegaSetElementList* getSetElements(MegaHandle sid);
+        MegaSetElementList* getSetElements(MegaHandle sid, unsigned offset, unsigned count);
         MegaSetElement* getSetElement(MegaHandle sid, MegaHandle eid);
 
 #ifdef ENABLE_SYNC
@@ -2694,6 +3134,11 @@ class MegaApiImpl : public MegaApp
         bool isSyncing();
 
         MegaSync *getSyncByBackupId(mega::MegaHandle backupId);
+        MegaSyncStats *getSyncStats(mega::MegaHandle backupId);
+        void setSyncTracing(bool enable);
+        char *exportSyncTrace();
+        void setBackupUploadOrder(int order);
+        bool setMaxSyncNodesInRam(mega::MegaHandle backupId, long long maxNodes);
         MegaSync *getSyncByNode(MegaNode *node);
         MegaSync *getSyncByPath(const char * localPath);
         char *getBlockedPath();
@@ -2716,6 +3161,8 @@ class MegaApiImpl : public MegaApp
         void resetTotalUploads();
         void updateStats();
         long long getNumNodes();
+        void setMaxNodesInRam(long long maxNodes);
+        void setChildrenPrefetch(int folders);
         long long getTotalDownloadedBytes();
         long long getTotalUploadedBytes();
         long long getTotalDownloadBytes();
@@ -2732,6 +3179,8 @@ class MegaApiImpl : public MegaApp
         bool hasVersions(MegaNode *node);
         void getFolderInfo(MegaNode *node, MegaRequestListener *listener);
         MegaNodeList* getChildrenFromType(MegaNode* p, int type, int order = 1, CancelToken cancelToken = CancelToken());
+        MegaNodeList* getChildrenPage(MegaNode *parent, int order, long long offset, int limit, CancelToken cancelToken = CancelToken());
+        bool visitChildren(MegaNode *parent, MegaNodeViewVisitor *visitor, int order);
         bool hasChildren(MegaNode *parent);
         MegaNode *getChildNode(MegaNode *parent, const char* name);
         MegaNode* getChildNodeOfType(MegaNode *parent, const char *name, int type = TYPE_UNKNOWN);
@@ -2744,6 +3193,8 @@ class MegaApiImpl : public MegaApp
         MegaUserList* getContacts();
         MegaUser* getContact(const char* uid);
         MegaUserAlertList* getUserAlerts();
+        MegaUserAlertList* getUserAlerts(int offset, int count);
+        MegaNodeList* getUserAlertNodes(MegaUserAlert* alert);
         int getNumUnreadUserAlerts();
         MegaNodeList *getInShares(MegaUser* user, int order);
         MegaNodeList *getInShares(int order);
@@ -2803,9 +3254,11 @@ class MegaApiImpl : public MegaApp
 
         MegaRecentActionBucketList* getRecentActions(unsigned days = 90, unsigned maxnodes = 500);
         void getRecentActionsAsync(unsigned days, unsigned maxnodes, MegaRequestListener *listener = NULL);
+        void searchAsync(MegaNode *node, const char *searchString, bool recursive, int order, int type, int target, MegaRequestListener *listener = NULL);
 
         MegaNodeList* search(MegaNode *node, const char *searchString, CancelToken cancelToken, bool recursive = true, int order = MegaApi::ORDER_NONE, int type = MegaApi::FILE_TYPE_DEFAULT, int target = MegaApi::SEARCH_TARGET_ALL);
         bool processMegaTree(MegaNode* node, MegaTreeProcessor* processor, bool recursive = 1);
+        bool processMegaTreeStreamed(MegaNode* node, MegaTreeProcessor* processor, int prefetch, int threads);
 
         MegaNode *createForeignFileNode(MegaHandle handle, const char *key, const char *name, m_off_t size, m_off_t mtime,
                                        MegaHandle parentHandle, const char *privateauth, const char *publicauth, const char *chatauth);
@@ -2923,6 +3376,10 @@ class MegaApiImpl : public MegaApp
         int httpServerGetMaxBufferSize();
         void httpServerSetMaxOutputSize(int outputSize);
         int httpServerGetMaxOutputSize();
+        void httpServerSetEventLoops(int loops);
+        int httpServerGetEventLoops();
+        void httpServerEnableKernelTls(bool enable);
+        bool httpServerIsKernelTlsEnabled();
 
         // permissions
         void httpServerEnableFileServer(bool enable);
@@ -2959,6 +3416,10 @@ class MegaApiImpl : public MegaApp
         int ftpServerGetMaxBufferSize();
         void ftpServerSetMaxOutputSize(int outputSize);
         int ftpServerGetMaxOutputSize();
+        void ftpServerSetUploadPipelining(bool enable);
+        bool ftpServerIsUploadPipelining();
+        void ftpServerEnableKernelTls(bool enable);
+        bool ftpServerIsKernelTlsEnabled();
 
         // permissions
         void ftpServerSetRestrictedMode(int mode);
@@ -2972,6 +3433,10 @@ class MegaApiImpl : public MegaApp
         void fireOnFtpStreamingTemporaryError(MegaTransferPrivate *transfer, unique_ptr<MegaErrorPrivate> e);
         void fireOnFtpStreamingFinish(MegaTransferPrivate *transfer, unique_ptr<MegaErrorPrivate> e);
 
+        // disk cache for the HTTP and FTP servers
+        bool setStreamingCache(const char* path, long long maxSize);
+        shared_ptr<StreamingCache> getStreamingCache();
+
 #endif
 
 #ifdef ENABLE_CHAT
@@ -3136,7 +3601,8 @@ protected:
         void processTransferFailed(Transfer *tr, MegaTransferPrivate *transfer, const Error &e, dstime timeleft);
         void processTransferRemoved(Transfer *tr, MegaTransferPrivate *transfer, const Error &e);
 
-        node_vector searchInNodeManager(MegaHandle nodeHandle, const char* searchString, int type, CancelToken cancelToken, bool recursive);
+        // With 'unlockable', the lock may be released while the DB is queried (see NodeManager::ClientLock)
+        node_vector searchInNodeManager(MegaHandle nodeHandle, const char* searchString, int type, CancelToken cancelToken, bool recursive, NodeManager::ClientLock* unlockable = nullptr);
         bool isValidTypeNode(Node *node, int type);
 
         MegaApi *api;
@@ -3164,10 +3630,17 @@ protected:
         unique_ptr<MegaNode> mLastKnownVaultNode;
         unique_ptr<MegaNode> mLastKnownRubbishNode;
 
+        // nodes returned by getNodeByHandle(), served without locking sdkMutex until nodes_updated() reports them
+        static const size_t NODE_SNAPSHOT_MAX = 10000;
+        mutex mNodeSnapshotMutex;
+        std::map<handle, unique_ptr<MegaNode>> mNodeSnapshot;
+
 #ifdef HAVE_LIBUV
         MegaHTTPServer *httpServer;
         int httpServerMaxBufferSize;
         int httpServerMaxOutputSize;
+        int httpServerEventLoops;
+        bool httpServerKernelTls;
         bool httpServerEnableFiles;
         bool httpServerEnableFolders;
         bool httpServerOfflineAttributeEnabled;
@@ -3178,12 +3651,19 @@ protected:
         MegaFTPServer *ftpServer;
         int ftpServerMaxBufferSize;
         int ftpServerMaxOutputSize;
+        bool ftpServerUploadPipelining;
+        bool ftpServerKernelTls;
         int ftpServerRestrictedMode;
         set<MegaTransferListener *> ftpServerListeners;
+
+        shared_ptr<StreamingCache> mStreamingCache;
 #endif
 
         map<int, MegaScheduledCopyController *> backupsMap;
 
+        // persistent cache of thumbnails and previews, see setFileAttributesCache
+        shared_ptr<FileAttributeCache> mFileAttributeCache;
+
         RequestQueue requestQueue;
         TransferQueue transferQueue;
         map<int, MegaRequestPrivate *> requestMap;
@@ -3213,13 +3693,69 @@ protected:
         set<MegaGlobalListener *> globalListeners;
         set<MegaListener *> listeners;
         retryreason_t waitingRequest;
-        vector<string> excludedNames;
-        vector<string> excludedPaths;
+        WildcardPatterns excludedNames;
+        WildcardPatterns excludedPathPatterns;
+        vector<LocalPath> excludedPaths;
         long long syncLowerSizeLimit;
         long long syncUpperSizeLimit;
         std::recursive_timed_mutex sdkMutex;
         using SdkMutexGuard = std::unique_lock<std::recursive_timed_mutex>;   // (equivalent to typedef)
         std::atomic<bool> syncPathStateLockTimeout{ false };
+
+        // files and folders per batch of a streaming folder download, 0 to explore the folder first
+        std::atomic<int> mFolderDownloadBatchSize{ 0 };
+
+        // set when the callbacks of app listeners run on their own threads. Dispatchers replaced
+        // by another one stay alive, draining what was posted to them, until the MegaApiImpl goes.
+        std::atomic<ListenerDispatcher*> mListenerDispatcher{ nullptr };
+        vector<unique_ptr<ListenerDispatcher>> mListenerDispatchers;
+        std::mutex mListenerDispatchersMutex;
+
+        // after the listener is no longer registered: drop its queued callbacks
+        void forgetListener(const void* listener);
+
+        // progress reports of transfers, see MegaApi::setTransferUpdatePolicy
+        std::atomic<dstime> mTransferUpdateIntervalDs{ 0 };
+        std::atomic<long long> mTransferUpdateMinBytes{ 0 };
+        std::atomic<bool> mTransferUpdatesAggregated{ false };
+        dstime mNextTransfersProgressDs = 0;
+        bool throttleTransferProgress(MegaTransferPrivate* transfer);
+        void fireOnTransfersProgress();
+
+        // node updates merged per node until the end of the current pass of the SDK thread
+        std::atomic<bool> mCoalesceNodesUpdates{ false };
+        vector<MegaNodeUpdateListPrivate::Update> mPendingNodesUpdates;
+        map<MegaHandle, size_t> mPendingNodesUpdateIndex;
+        void flushNodesUpdates();
+
+        // searches of searchAsync(): they run one at a time on their own thread, and a new one cancels the previous
+        struct AsyncSearch
+        {
+            int tag = 0;
+            MegaHandle node = INVALID_HANDLE;
+            string searchString;
+            bool recursive = true;
+            int order = MegaApi::ORDER_NONE;
+            int type = MegaApi::FILE_TYPE_DEFAULT;
+            int target = MegaApi::SEARCH_TARGET_ALL;
+            CancelToken cancelToken;
+        };
+        static const size_t ASYNC_SEARCH_PAGE_SIZE = 200;
+        std::thread mSearchThread;
+        std::mutex mSearchMutex;
+        std::condition_variable mSearchConditionVariable;
+        unique_ptr<AsyncSearch> mNextSearch;
+        CancelToken mRunningSearch;
+        bool mSearchThreadExit = false;
+        // results of the last search completed, for the next one to filter if it only narrows it (search thread only)
+        unique_ptr<AsyncSearch> mLastSearch;
+        std::pair<uint64_t, uint64_t> mLastSearchTableVersion;
+        vector<NodeHandle> mLastSearchResults;
+        error startSearch(unique_ptr<AsyncSearch> search);
+        void stopSearchThread();
+        void searchThreadLoop();
+        void runSearch(AsyncSearch& search);
+        bool refinesLastSearch(const AsyncSearch& search);
         MegaTransferPrivate *currentTransfer;
         MegaRequestPrivate *activeRequest;
         MegaTransferPrivate *activeTransfer;
@@ -3315,6 +3851,7 @@ protected:
         // user attribute update notification
         void userattr_update(User*, int, const char*) override;
 
+        void nodes_cached() override;
         void nodes_current() override;
         void catchup_result() override;
         void key_modified(handle, attr_t) override;
@@ -3422,7 +3959,8 @@ protected:
         void reqstat_progress(int permilprogress) override;
 
         // for internal use - for worker threads to run something on MegaApiImpl's thread, such as calls to onFire() functions
-        void executeOnThread(shared_ptr<ExecuteOnce>);
+        // 'first' queues it before other requests; otherwise it goes after them, so several posts keep their order
+        void executeOnThread(shared_ptr<ExecuteOnce>, bool first = true);
 
 #ifdef ENABLE_CHAT
         // chat-related commandsresult
@@ -3524,6 +4062,13 @@ protected:
         void sendPendingScRequest();
         void sendPendingRequests();
         unsigned sendPendingTransfers(TransferQueue *queue, MegaRecursiveOperation* = nullptr);
+
+        // max queued uploads whose fingerprints are resolved together by sendPendingTransfers
+        static const size_t MAX_FINGERPRINT_PRELOAD = 500;
+
+        // max transfers handled in one pass of sendPendingTransfers while they share their parent
+        // (the pass still ends after 100 ms)
+        static const unsigned MAX_RELATED_TRANSFERS_PER_PASS = 1000;
         void updateBackups();
 
         //Internal
@@ -3532,6 +4077,7 @@ protected:
 
         void getNodeAttribute(MegaNode* node, int type, const char *dstFilePath, MegaRequestListener *listener = NULL);
         void cancelGetNodeAttribute(MegaNode *node, int type, MegaRequestListener *listener = NULL);
+        void cancelGetNodeAttributesExcept(MegaHandleList* nodeHandles, int type, MegaRequestListener *listener = NULL);
         void setNodeAttribute(MegaNode* node, int type, const char *srcFilePath, MegaHandle attributehandle, MegaRequestListener *listener = NULL);
         void putNodeAttribute(MegaBackgroundMediaUpload* bu, int type, const char *srcFilePath, MegaRequestListener *listener = NULL);
         void setUserAttr(int type, const char *value, MegaRequestListener *listener = NULL);
@@ -3585,7 +4131,94 @@ public:
     virtual bool read(byte *buffer, unsigned size);
 };
 
+// Disk cache of the file attributes (thumbnails, previews) retrieved, with a file per attribute
+// named after its handle. Attributes never change, so it's kept between sessions: init() indexes
+// the files already in the folder. When the total exceeds the size limit, the least recently
+// used are removed. All methods are thread-safe.
+class FileAttributeCache
+{
+public:
+    FileAttributeCache(const LocalPath& folder, m_off_t maxSize);
+
+    // creates the folder, or indexes the files in it (the most recently modified are kept)
+    bool init();
+
+    // copies the attribute 'fah' to 'destination', returns false if it isn't cached
+    bool copyTo(handle fah, const LocalPath& destination);
+
+    void write(handle fah, const char* data, size_t len);
+
+private:
+    struct Entry
+    {
+        m_off_t size = 0;
+        std::list<handle>::iterator lru;
+    };
+
+    LocalPath pathOf(handle fah) const;
+    void add(handle fah, m_off_t size);
+    void drop(handle fah);
+
+    std::mutex mMutex;
+    MegaFileSystemAccess mFsAccess;
+    LocalPath mFolder;
+    m_off_t mMaxSize;
+    m_off_t mSize = 0;
+    std::map<handle, Entry> mEntries;
+    // most recently used first
+    std::list<handle> mLru;
+};
+
 #ifdef HAVE_LIBUV
+// Disk cache of the data streamed by the HTTP and FTP servers, shared by all their connections.
+// There's a file per node, holding the ranges of it received so far. When the total exceeds the
+// size limit, the least recently used nodes are dropped. The index of ranges is kept in memory
+// only, so the folder is emptied by init(). All methods are thread-safe.
+class StreamingCache
+{
+public:
+    StreamingCache(const LocalPath& folder, m_off_t maxSize);
+
+    // creates the folder, or removes what's there
+    bool init();
+
+    // copies up to 'len' bytes of node 'h' cached from 'pos' on. Returns the count (0 if 'pos' isn't cached)
+    size_t read(MegaHandle h, m_off_t pos, char* buf, size_t len);
+
+    // stores 'len' bytes of node 'h' from 'pos' on
+    void write(MegaHandle h, m_off_t pos, const char* buf, size_t len);
+
+    // start of the first range of node 'h' cached beyond 'pos', or -1 if none
+    m_off_t nextCached(MegaHandle h, m_off_t pos);
+
+    // path of the file of node 'h' if it holds the whole range [start, end), to read it directly
+    bool cachedFile(MegaHandle h, m_off_t start, m_off_t end, LocalPath& path);
+
+    m_off_t cachedSize();
+
+private:
+    struct Entry
+    {
+        // cached ranges, as start -> end (not included). They don't overlap nor touch each other
+        std::map<m_off_t, m_off_t> ranges;
+        m_off_t size = 0;
+        std::list<MegaHandle>::iterator lru;
+    };
+
+    LocalPath pathOf(MegaHandle h) const;
+    Entry& touch(MegaHandle h);
+    void drop(MegaHandle h);
+
+    std::mutex mMutex;
+    MegaFileSystemAccess mFsAccess;
+    LocalPath mFolder;
+    m_off_t mMaxSize;
+    m_off_t mSize = 0;
+    std::map<MegaHandle, Entry> mEntries;
+    // most recently used first
+    std::list<MegaHandle> mLru;
+};
+
 class StreamingBuffer
 {
 public:
@@ -3605,9 +4238,9 @@ public:
     uv_buf_t nextBuffer();
     // Increase the free data counter
     void freeData(size_t len);
-    // Set upper bound limit for capacity
+    // Set upper bound limit for capacity (0 to follow the media bitrate and the throughput)
     void setMaxBufferSize(unsigned int bufferSize);
-    // Set upper bound limit for chunk size to write to the consumer
+    // Set upper bound limit for chunk size to write to the consumer (0 to follow the capacity)
     void setMaxOutputSize(unsigned int outputSize);
     // Set file size
     void setFileSize(m_off_t fileSize);
@@ -3621,9 +4254,31 @@ public:
     static const unsigned int MAX_BUFFER_SIZE = 2097152;
     static const unsigned int MAX_OUTPUT_SIZE = MAX_BUFFER_SIZE / 10;
 
+    // Adaptive sizing: seconds of playback (or of download) to keep buffered
+    static const unsigned int BUFFERED_SECONDS = 30;
+    // Adaptive sizing: upper bound limit for the capacity of a single buffer
+    static const size_t MAX_ADAPTIVE_BUFFER_SIZE = 67108864;
+    // Adaptive sizing: upper bound limit for the memory of all buffers together
+    static const size_t MAX_TOTAL_BUFFER_SIZE = 268435456;
+
+    // Memory currently allocated by all buffers
+    static size_t totalAllocated();
+    // Number of buffers with memory allocated
+    static size_t totalBuffers();
+
 private:
     // Rate between partial file size and its duration (only for media files)
     m_off_t partialDuration(m_off_t partialSize) const;
+    // Bytes per second received by append() since the buffer was initialized
+    m_off_t getThroughput() const;
+    // Capacity limit for the current bitrate and throughput
+    size_t targetCapacity() const;
+    // (Re)allocate the buffer, taking the memory from the global budget
+    void allocate(size_t capacity);
+    void release();
+
+    static std::atomic<size_t> sTotalAllocated;
+    static std::atomic<size_t> sTotalBuffers;
 
 protected:
     // Circular buffer to store data to feed the consumer
@@ -3642,6 +4297,14 @@ protected:
     size_t maxBufferSize;
     // Upper bound limit for chunk size to write to the consumer
     size_t maxOutputSize;
+    // Limits not set explicitly, so they follow the bitrate and the throughput
+    bool adaptiveBufferSize;
+    bool adaptiveOutputSize;
+    // Capacity requested in init() (it can grow up to this when the buffer is drained)
+    size_t requestedCapacity;
+    // Data received since init() to measure the throughput
+    m_off_t receivedBytes;
+    std::chrono::steady_clock::time_point receiveStart;
 
     // File size
     m_off_t fileSize;
@@ -3650,6 +4313,7 @@ protected:
 };
 
 class MegaTCPServer;
+struct MegaTCPLoop;
 class MegaTCPContext : public MegaTransferListener, public MegaRequestListener
 {
 public:
@@ -3691,12 +4355,35 @@ public:
     m_off_t nodesize;
     int resultCode;
 
+    // streaming cache, if enabled when the stream started (see MegaTCPServer::feedStreaming)
+    shared_ptr<StreamingCache> streamingCache;
+    // end of the range requested to MEGA by the last streaming transfer
+    m_off_t streamingTo = -1;
+    // that transfer completed, but it stopped before a cached range (the rest must be requested)
+    bool streamingPartFinished = false;
+
+    // additional event loop that accepted the connection (NULL for the main loop of the server)
+    MegaTCPLoop *loop = nullptr;
+};
+
+// Additional event loop of a MegaTCPServer, listening on the same port (SO_REUSEPORT)
+// and owning the connections it accepts
+struct MegaTCPLoop
+{
+    MegaTCPServer *server = nullptr;
+    uv_loop_t uv_loop;
+    uv_tcp_t listener;
+    uv_async_t exit_handle;
+    MegaThread thread;
+    list<MegaTCPContext*> connections;
+    int remainingcloseevents = 0;
 };
 
 class MegaTCPServer
 {
 protected:
     static void *threadEntryPoint(void *param);
+    static void *loopEntryPoint(void *param);
     static http_parser_settings parsercfg;
 
     uv_loop_t uv_loop;
@@ -3720,6 +4407,20 @@ protected:
     bool closing;
     int remainingcloseevents;
 
+    // Number of event loops (connections are spread across them by the kernel)
+    int eventLoops;
+
+    // TLS records are encrypted by the kernel after the handshake, where supported
+    bool kernelTls;
+    std::vector<std::unique_ptr<MegaTCPLoop>> extraLoops;
+
+    static bool enableReusePort(uv_tcp_t *handle);
+    void startExtraLoops(const struct sockaddr *address, uv_connection_cb onNewClientCB);
+    void stopExtraLoops();
+    static void onLoopCloseRequested(uv_async_t* handle);
+    static list<MegaTCPContext*>& connectionsOf(MegaTCPContext *tcpctx);
+    static int& closeEventsOf(MegaTCPContext *tcpctx);
+
 #ifdef ENABLE_EVT_TLS
     // TLS
     bool evtrequirescleaning;
@@ -3764,6 +4465,12 @@ protected:
 
     void answer(MegaTCPContext* tcpctx, const char *rsp, size_t rlen);
 
+    // Feeds 'buffer' with the data of 'node' from 'start' to 'end' (not included): the part in the
+    // streaming cache is copied while it fits, and the first part not cached is requested to MEGA,
+    // up to the next cached range. Returns false if the buffer filled up (resume when it has space).
+    // 'sequential' is set by clients that read to the end (FTP RETR), see MegaApiImpl::startStreaming
+    static bool feedStreaming(MegaTCPContext* tcpctx, StreamingBuffer& buffer, MegaNode* node, m_off_t start, m_off_t end, bool sequential = false);
+
 
     //virtual methods:
     virtual void processReceivedData(MegaTCPContext *tcpctx, ssize_t nread, const uv_buf_t * buf);
@@ -3791,6 +4498,15 @@ public:
     void setMaxOutputSize(int outputSize);
     int getMaxBufferSize();
     int getMaxOutputSize();
+    // 0 if not set, so buffers adapt to each stream
+    int getMaxBufferSizeSetting();
+    int getMaxOutputSizeSetting();
+    // Takes effect when the server is started
+    void setEventLoops(int loops);
+    int getEventLoops();
+    // Takes effect when the server is started
+    void setKernelTls(bool enable);
+    bool isKernelTls();
     void setRestrictedMode(int mode);
     int getRestrictedMode();
     bool isHandleAllowed(handle h);
@@ -3809,6 +4525,7 @@ public:
 
 class MegaTCServer;
 class MegaHTTPServer;
+struct MegaHTTPFileSend;
 class MegaHTTPContext : public MegaTCPContext
 {
 
@@ -3845,6 +4562,18 @@ public:
 
     // WEBDAV related
     int depth;
+    // PROPFIND response streamed in chunks (see MegaHTTPServer::fillPropFind):
+    // folders still to list, and XML generated that didn't fit in the buffer
+    struct PropFindFolder
+    {
+        std::unique_ptr<MegaNode> node;
+        std::string url;
+        int levels;
+        long long offset;
+    };
+    std::vector<PropFindFolder> propFindFolders;
+    std::string propFindPending;
+    bool propFindStreaming = false;
     std::string lastheader;
     std::string subpathrelative;
     const char *messageBody;
@@ -3861,6 +4590,14 @@ public:
     uv_mutex_t mutex_responses;
     std::list<std::string> responses;
 
+#ifndef _WIN32
+    // local copy of the node sent with sendfile() after the headers (see MegaHTTPServer::openLocalCopy)
+    uv_file localFile = -1;
+    m_off_t localFileOffset = 0;
+    MegaHTTPFileSend *localFileSend = nullptr;
+    int localFileTimeouts = 0;
+#endif
+
     virtual void onTransferStart(MegaApi *, MegaTransfer *transfer);
     virtual bool onTransferData(MegaApi *, MegaTransfer *transfer, char *buffer, size_t size);
     virtual void onTransferFinish(MegaApi* api, MegaTransfer *transfer, MegaError *e);
@@ -3900,6 +4637,18 @@ protected:
     static void sendNextBytes(MegaHTTPContext *httpctx);
     static int streamNode(MegaHTTPContext *httpctx);
 
+#ifndef _WIN32
+    // Zero-copy path for plain HTTP: a synced file or the streaming cache holding the range
+    // is sent from disk to the socket, without DirectRead nor StreamingBuffer
+    static const m_off_t LOCAL_FILE_CHUNK = 16777216;
+    static const int LOCAL_FILE_SEND_TIMEOUT = 2; // seconds blocked on a stalled client before retrying
+    static const int LOCAL_FILE_MAX_TIMEOUTS = 30;
+    static uv_file openLocalCopy(MegaHTTPContext *httpctx, m_off_t start, m_off_t end);
+    static void sendLocalFile(MegaHTTPContext *httpctx);
+    static void onLocalFileSent(uv_fs_t *req);
+    static void closeLocalFile(uv_file file);
+#endif
+
     //Utility funcitons
     static std::string getHTTPMethodName(int httpmethod);
     static std::string getHTTPErrorString(int errorcode);
@@ -3909,6 +4658,15 @@ protected:
     static std::string getWebDavPropFindResponseForNode(std::string baseURL, std::string subnodepath, MegaNode *node, MegaHTTPContext* httpctx);
     static std::string getWebDavProfFindNodeContents(MegaNode *node, std::string baseURL, bool offlineAttribute);
 
+    // PROPFIND of folders is sent with chunked encoding, listing children by pages
+    // while the buffer has space, so memory doesn't grow with the size of the tree
+    static const int PROPFIND_DEPTH_INFINITY = std::numeric_limits<int>::max();
+    static const int PROPFIND_PAGE_SIZE = 100;
+    static const size_t PROPFIND_BUFFER_SIZE = 262144;
+    static void startPropFind(std::string baseURL, std::string subnodepath, MegaNode *node, MegaHTTPContext* httpctx);
+    static void fillPropFind(MegaHTTPContext* httpctx);
+    static void appendChunk(std::string& out, const std::string& data);
+
     static void returnHttpCodeBasedOnRequestError(MegaHTTPContext* httpctx, MegaError *e, bool synchronous = true);
     static void returnHttpCode(MegaHTTPContext* httpctx, int errorCode, std::string errorMessage = string(), bool synchronous = true);
 
@@ -4030,6 +4788,9 @@ protected:
     int dataportBegin;
     int dataPortEnd;
 
+    // answer STOR once the file is received, the upload to MEGA goes on in the background
+    bool uploadPipelining;
+
     std::string getListingLineFromNode(MegaNode *child, std::string nameToShow = string());
 
     MegaNode *getBaseFolderNode(std::string path);
@@ -4050,6 +4811,9 @@ public:
 
     std::string newNameAfterMove;
 
+    void setUploadPipelining(bool enable);
+    bool isUploadPipelining() const;
+
     MegaFTPServer(MegaApiImpl *megaApi, string basePath, int dataportBegin, int dataPortEnd, bool useTLS = false, std::string certificatepath = std::string(), std::string keypath = std::string());
     virtual ~MegaFTPServer();
 
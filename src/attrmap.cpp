@@ -105,6 +105,9 @@ void AttrMap::serialize(string* d) const
     unsigned char l;
     unsigned short ll;
 
+    // name length byte, up to 8 name bytes and the value length per record
+    d->reserve(d->size() + storagesize(static_cast<int>(1 + 8 + sizeof ll)) + 1);
+
     for (attr_map::const_iterator it = map.begin(); it != map.end(); it++)
     {
         if ((l = (unsigned char)nameid2string(it->first, buf)))
@@ -137,31 +137,228 @@ TimerWithBackoff::TimerWithBackoff(PrnGen &rng, int tag)
 }
 
 
-void BackoffTimerGroupTracker::update(dstime* waituntil, bool transfers)
+BackoffTimerGroupTracker::BackoffTimerGroupTracker()
+    : mExpired(nullptr)
+    , mOverflow(nullptr)
+    , mNow(0)
+    , mCount(0)
 {
-    // This function performs a similar action as calling BackoffTimer::update for all the timers in the group,
-    // which is to say, the `waituntil` parameter will be updated with the soonest time that we would need to
-    // wake up from any of the timers in this group, should any of them be in a back-off state.
-    // There are also some side-effects specfic to transfers which are preserved from the old system.
+    for (unsigned l = 0; l < LEVELS; l++)
+    {
+        for (unsigned s = 0; s < SLOTS; s++)
+        {
+            mSlots[l][s] = nullptr;
+        }
+        mOccupied[l] = 0;
+    }
+}
 
-    vector<BackoffTimerTracked*> v;
-    v.reserve(timeouts.size());
+void BackoffTimerGroupTracker::add(BackoffTimerTracked* bt)
+{
+    if (!mCount)
+    {
+        // nothing in the wheel, so its clock can just catch up
+        mNow = Waiter::ds;
+    }
 
-    if (transfers)
+    bt->mTimeout = bt->nextset();
+    place(bt);
+    mCount++;
+}
+
+void BackoffTimerGroupTracker::remove(BackoffTimerTracked* bt)
+{
+    unlink(bt);
+    mCount--;
+}
+
+void BackoffTimerGroupTracker::place(BackoffTimerTracked* bt)
+{
+    dstime t = bt->mTimeout;
+
+    if (t <= mNow)
+    {
+        link(mExpired, bt, -1);
+        return;
+    }
+
+    // the lowest level whose window (shared with the clock) contains the timeout
+    for (unsigned l = 0; l < LEVELS; l++)
+    {
+        if (!((t ^ mNow) >> (SLOT_BITS * (l + 1))))
+        {
+            unsigned s = (t >> (SLOT_BITS * l)) & (SLOTS - 1);
+            link(mSlots[l][s], bt, int(l * SLOTS + s));
+            mOccupied[l] |= uint64_t(1) << s;
+            return;
+        }
+    }
+
+    link(mOverflow, bt, -1);
+}
+
+void BackoffTimerGroupTracker::link(BackoffTimerTracked*& list, BackoffTimerTracked* bt, int slot)
+{
+    bt->mPrev = nullptr;
+    bt->mNext = list;
+    if (list)
+    {
+        list->mPrev = bt;
+    }
+    list = bt;
+    bt->mList = &list;
+    bt->mSlot = slot;
+}
+
+void BackoffTimerGroupTracker::unlink(BackoffTimerTracked* bt)
+{
+    if (bt->mPrev)
+    {
+        bt->mPrev->mNext = bt->mNext;
+    }
+    else
+    {
+        *bt->mList = bt->mNext;
+    }
+
+    if (bt->mNext)
+    {
+        bt->mNext->mPrev = bt->mPrev;
+    }
+
+    if (bt->mSlot >= 0 && !*bt->mList)
+    {
+        mOccupied[bt->mSlot / SLOTS] &= ~(uint64_t(1) << (bt->mSlot % SLOTS));
+    }
+
+    bt->mPrev = nullptr;
+    bt->mNext = nullptr;
+    bt->mList = nullptr;
+    bt->mSlot = -1;
+}
+
+// re-file a whole bucket against the current time (the caller clears its occupied bit)
+void BackoffTimerGroupTracker::replace(BackoffTimerTracked*& list)
+{
+    BackoffTimerTracked* bt = list;
+    list = nullptr;
+
+    while (bt)
+    {
+        BackoffTimerTracked* next = bt->mNext;
+        place(bt);
+        bt = next;
+    }
+}
+
+// the clock has just entered a new level 0 window: bring down the buckets whose window starts now, from the top
+void BackoffTimerGroupTracker::cascade()
+{
+    if (!(mNow & ((dstime(1) << (SLOT_BITS * LEVELS)) - 1)))
+    {
+        replace(mOverflow);
+    }
+
+    for (unsigned l = LEVELS; --l > 0; )
     {
-        for (auto t : timeouts)
+        if (!(mNow & ((dstime(1) << (SLOT_BITS * l)) - 1)))
         {
-            // put the ones to work on in a vector, as working on them changes their position in the map
-            if (t.first <= Waiter::ds)
+            unsigned s = (mNow >> (SLOT_BITS * l)) & (SLOTS - 1);
+            mOccupied[l] &= ~(uint64_t(1) << s);
+            replace(mSlots[l][s]);
+        }
+    }
+}
+
+void BackoffTimerGroupTracker::advance(dstime now)
+{
+    while (mNow < now)
+    {
+        if (mOccupied[0])
+        {
+            // expire the buckets of the current window that the clock goes past
+            dstime end = mNow | (SLOTS - 1);
+            unsigned from = (mNow & (SLOTS - 1)) + 1;
+            mNow = std::min(now, end);
+
+            for (unsigned s = from; s <= (mNow & (SLOTS - 1)); s++)
             {
-                v.push_back(t.second);
+                if (mOccupied[0] & (uint64_t(1) << s))
+                {
+                    mOccupied[0] &= ~(uint64_t(1) << s);
+                    replace(mSlots[0][s]);
+                }
             }
-            else
+
+            if (mNow == now)
+            {
+                break;
+            }
+
+            mNow = end + 1;
+        }
+        else
+        {
+            // nothing due in this window, skip straight to the next bucket that needs cascading
+            dstime next = nextevent();
+            if (next > now)
             {
+                mNow = now;
                 break;
             }
+
+            mNow = next;
         }
 
+        cascade();
+    }
+}
+
+dstime BackoffTimerGroupTracker::nextevent() const
+{
+    // all occupied buckets lie ahead of the clock on their level, and lower levels come first
+    for (unsigned l = 0; l < LEVELS; l++)
+    {
+        if (mOccupied[l])
+        {
+            unsigned s = 0;
+            while (!(mOccupied[l] & (uint64_t(1) << s)))
+            {
+                s++;
+            }
+
+            dstime window = mNow & ~((dstime(1) << (SLOT_BITS * (l + 1))) - 1);
+            return window | (dstime(s) << (SLOT_BITS * l));
+        }
+    }
+
+    if (mOverflow)
+    {
+        uint64_t next = ((uint64_t(mNow) >> (SLOT_BITS * LEVELS)) + 1) << (SLOT_BITS * LEVELS);
+        return next < NEVER ? dstime(next) : NEVER;
+    }
+
+    return NEVER;
+}
+
+void BackoffTimerGroupTracker::update(dstime* waituntil, bool transfers)
+{
+    // This function performs a similar action as calling BackoffTimer::update for all the timers in the group,
+    // which is to say, the `waituntil` parameter will be updated with the soonest time that we would need to
+    // wake up from any of the timers in this group, should any of them be in a back-off state.
+    // There are also some side-effects specfic to transfers which are preserved from the old system.
+
+    advance(Waiter::ds);
+
+    // put the ones to work on in a vector, as working on them changes their position in the wheel
+    vector<BackoffTimerTracked*> v;
+    for (BackoffTimerTracked* bt = mExpired; bt; bt = bt->mNext)
+    {
+        v.push_back(bt);
+    }
+
+    if (transfers)
+    {
         for (auto t : v)
         {
             t->update(waituntil);
@@ -172,29 +369,21 @@ void BackoffTimerGroupTracker::update(dstime* waituntil, bool transfers)
                 LOG_debug << "Disabling armed transfer backoff";
             }
         }
-
     }
     else
     {
-        // put the ones to work on in a vector, as working on them changes their position in the map
-        for (auto t : timeouts)
-        {
-            if (t.second->armed())
-            {
-                v.push_back(t.second);
-            }
-            if (t.first > Waiter::ds)
-            {
-                break;
-            }
-        }
-
         for (auto t : v)
         {
             // update may set next=1 so we can't just call the first one.
             t->update(waituntil);
         }
+    }
 
+    // wake up no later than the soonest bucket still pending (exact for timers due within the current level 0 window)
+    dstime next = nextevent();
+    if (next < *waituntil)
+    {
+        *waituntil = next;
     }
 }
 
@@ -22,7 +22,225 @@
 #include "mega/base64.h"
 #include "mega/utils.h"
 
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define MEGA_BASE64_AVX2 1
+#elif defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define MEGA_BASE64_NEON 1
+#endif
+
 namespace mega {
+
+namespace {
+
+// The vector kernels only handle whole blocks of valid input and report how much they consumed
+// (a multiple of 3 bytes or 4 characters); the scalar code finishes the rest, so the output is
+// always identical to the byte-by-byte conversion.
+
+#if MEGA_BASE64_AVX2
+// 24 bytes to 32 characters per step, splitting the 6-bit groups with multiplies (W. Mula's method)
+__attribute__((target("avx2")))
+size_t encodeAvx2(const byte* b, size_t len, char* a)
+{
+    const __m256i shuffle = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                             1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+
+    // offset to add to each 6-bit value, indexed by its range (see below)
+    const __m256i offsets = _mm256_setr_epi8(71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -17, 32, 65, 0, 0,
+                                             71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -17, 32, 65, 0, 0);
+    size_t done = 0;
+
+    // each step reads 28 bytes (two 16-byte loads, 12 bytes apart)
+    for (; len - done >= 28; done += 24, a += 32)
+    {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + done));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + done + 12));
+        __m256i in = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), shuffle);
+
+        __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+        __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+        __m256i idx = _mm256_or_si256(t0, t1);
+
+        // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+        __m256i range = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+        range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx), _mm256_set1_epi8(13)));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(a), _mm256_add_epi8(idx, _mm256_shuffle_epi8(offsets, range)));
+    }
+
+    return done;
+}
+
+__attribute__((target("avx2")))
+inline __m256i inRange(__m256i c, char first, char last)
+{
+    return _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8(char(first - 1))),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8(char(last + 1)), c));
+}
+
+// 32 characters to 24 bytes per step, stopping at the first block with a character outside the alphabet
+__attribute__((target("avx2")))
+size_t decodeAvx2(const char* a, size_t len, byte* b, size_t blen)
+{
+    size_t done = 0;
+
+    for (; len - done >= 32 && blen >= 24; done += 32, b += 24, blen -= 24)
+    {
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + done));
+
+        __m256i upper = inRange(c, 'A', 'Z');
+        __m256i lower = inRange(c, 'a', 'z');
+        __m256i digit = inRange(c, '0', '9');
+        __m256i is62 = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('-')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('+')));
+        __m256i is63 = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('_')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('/')));
+
+        __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, _mm256_or_si256(is62, is63)));
+        if (_mm256_movemask_epi8(valid) != -1)
+        {
+            break;
+        }
+
+        __m256i shift = _mm256_or_si256(_mm256_and_si256(upper, _mm256_set1_epi8(-'A')),
+                        _mm256_or_si256(_mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a')),
+                                        _mm256_and_si256(digit, _mm256_set1_epi8(52 - '0'))));
+        __m256i v = _mm256_and_si256(_mm256_add_epi8(c, shift), _mm256_or_si256(upper, _mm256_or_si256(lower, digit)));
+        v = _mm256_or_si256(v, _mm256_and_si256(is62, _mm256_set1_epi8(62)));
+        v = _mm256_or_si256(v, _mm256_and_si256(is63, _mm256_set1_epi8(63)));
+
+        // 4 x 6 bits -> 24 bits per 32-bit lane, then keep the 3 significant bytes of each in order
+        v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+        v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+        v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(b), _mm256_castsi256_si128(v));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(b + 16), _mm256_extracti128_si256(v, 1));
+    }
+
+    return done;
+}
+
+const bool hasavx2 = __builtin_cpu_supports("avx2");
+
+size_t encodeVector(const byte* b, size_t len, char* a)
+{
+    return hasavx2 ? encodeAvx2(b, len, a) : 0;
+}
+
+size_t decodeVector(const char* a, size_t len, byte* b, size_t blen)
+{
+    return hasavx2 ? decodeAvx2(a, len, b, blen) : 0;
+}
+#elif MEGA_BASE64_NEON
+const byte alphabet[64] = {
+    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P',
+    'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z', 'a', 'b', 'c', 'd', 'e', 'f',
+    'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v',
+    'w', 'x', 'y', 'z', '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '-', '_',
+};
+
+// Base64::from64() for 0..127
+const byte values[128] = {
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,  62, 255,  62, 255,  63,
+     52,  53,  54,  55,  56,  57,  58,  59,  60,  61, 255, 255, 255, 255, 255, 255,
+    255,   0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,
+     15,  16,  17,  18,  19,  20,  21,  22,  23,  24,  25, 255, 255, 255, 255,  63,
+    255,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,  36,  37,  38,  39,  40,
+     41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51, 255, 255, 255, 255, 255,
+};
+
+uint8x16x4_t loadTable(const byte* t)
+{
+    uint8x16x4_t r;
+    r.val[0] = vld1q_u8(t);
+    r.val[1] = vld1q_u8(t + 16);
+    r.val[2] = vld1q_u8(t + 32);
+    r.val[3] = vld1q_u8(t + 48);
+    return r;
+}
+
+// 48 bytes to 64 characters per step, deinterleaving the 3-byte groups on load
+size_t encodeVector(const byte* b, size_t len, char* a)
+{
+    const uint8x16x4_t table = loadTable(alphabet);
+    const uint8x16_t mask = vdupq_n_u8(63);
+    size_t done = 0;
+
+    for (; len - done >= 48; done += 48, a += 64)
+    {
+        uint8x16x3_t in = vld3q_u8(b + done);
+        uint8x16x4_t out;
+
+        out.val[0] = vshrq_n_u8(in.val[0], 2);
+        out.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), mask);
+        out.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), mask);
+        out.val[3] = vandq_u8(in.val[2], mask);
+
+        for (int i = 0; i < 4; i++)
+        {
+            out.val[i] = vqtbl4q_u8(table, out.val[i]);
+        }
+
+        vst4q_u8(reinterpret_cast<uint8_t*>(a), out);
+    }
+
+    return done;
+}
+
+// 64 characters to 48 bytes per step, stopping at the first block with a character outside the alphabet
+size_t decodeVector(const char* a, size_t len, byte* b, size_t blen)
+{
+    const uint8x16x4_t low = loadTable(values);
+    const uint8x16x4_t high = loadTable(values + 64);
+    size_t done = 0;
+
+    for (; len - done >= 64 && blen >= 48; done += 64, b += 48, blen -= 48)
+    {
+        uint8x16x4_t c = vld4q_u8(reinterpret_cast<const uint8_t*>(a + done));
+        uint8x16_t bad = vdupq_n_u8(0);
+
+        for (int i = 0; i < 4; i++)
+        {
+            // out-of-range indices give 0 in vqtbl and leave the lane alone in vqtbx; non-ASCII is invalid
+            uint8x16_t v = vqtbl4q_u8(low, c.val[i]);
+            v = vqtbx4q_u8(v, high, vsubq_u8(c.val[i], vdupq_n_u8(64)));
+            v = vorrq_u8(v, vcgeq_u8(c.val[i], vdupq_n_u8(128)));
+            bad = vorrq_u8(bad, v);
+            c.val[i] = v;
+        }
+
+        if (vmaxvq_u8(bad) > 63)
+        {
+            break;
+        }
+
+        uint8x16x3_t out;
+        out.val[0] = vorrq_u8(vshlq_n_u8(c.val[0], 2), vshrq_n_u8(c.val[1], 4));
+        out.val[1] = vorrq_u8(vshlq_n_u8(c.val[1], 4), vshrq_n_u8(c.val[2], 2));
+        out.val[2] = vorrq_u8(vshlq_n_u8(c.val[2], 6), c.val[3]);
+        vst3q_u8(b, out);
+    }
+
+    return done;
+}
+#else
+size_t encodeVector(const byte*, size_t, char*)
+{
+    return 0;
+}
+
+size_t decodeVector(const char*, size_t, byte*, size_t)
+{
+    return 0;
+}
+#endif
+
+} // anonymous
+
 // modified base64 conversion (no trailing '=' and '-_' instead of '+/')
 unsigned char Base64::to64(byte c)
 {
@@ -85,7 +303,7 @@ unsigned char Base64::from64(byte c)
 int Base64::atob(const string &in, string &out)
 {
     out.resize(in.size() * 3 / 4 + 3);
-    out.resize(Base64::atob(in.data(), (byte *) out.data(), (int)out.size()));
+    out.resize(decode(in.data(), in.size(), (byte *) out.data(), out.size()));
 
     return (int)out.size();
 }
@@ -94,22 +312,37 @@ std::string Base64::atob(const std::string &in)
 {
     string out;
     out.resize(in.size() * 3 / 4 + 3);
-    out.resize(Base64::atob(in.data(), (byte *) out.data(), (int)out.size()));
+    out.resize(decode(in.data(), in.size(), (byte *) out.data(), out.size()));
 
     return out;
 }
 
 int Base64::atob(const char* a, byte* b, int blen)
+{
+    // the length is unknown, so no vector reads past the end: the string ends at the first invalid character
+    return blen > 0 ? (int)decodeScalar(a, SIZE_MAX, b, size_t(blen)) : 0;
+}
+
+size_t Base64::decode(const char* a, size_t len, byte* b, size_t blen)
+{
+    size_t done = decodeVector(a, len, b, blen);
+    size_t p = done / 4 * 3;
+
+    return p + decodeScalar(a + done, len - done, b + p, blen - p);
+}
+
+size_t Base64::decodeScalar(const char* a, size_t len, byte* b, size_t blen)
 {
     byte c[4]={};
     int i;
-    int p = 0;
+    size_t p = 0;
+    size_t pos = 0;
 
     for (;;)
     {
         for (i = 0; i < 4; i++)
         {
-            if ((c[i] = from64(*a++)) == 255)
+            if ((c[i] = (pos < len) ? from64(static_cast<byte>(a[pos++])) : static_cast<byte>(255)) == 255)
             {
                 break;
             }
@@ -204,8 +437,8 @@ int64_t Base64::atoi(string *val)
 
 int Base64::btoa(const string &in, string &out)
 {
-    out.resize(in.size() * 4 / 3 + 4);
-    out.resize(Base64::btoa((const byte*) in.data(), (int)in.size(), (char *) out.data()));
+    out.resize(encodedLength(in.size()));
+    out.resize(encode((const byte*) in.data(), in.size(), (char *) out.data()));
 
     return (int)out.size();
 }
@@ -213,23 +446,31 @@ int Base64::btoa(const string &in, string &out)
 std::string Base64::btoa(const string &in)
 {
     string out;
-    out.resize(in.size() * 4 / 3 + 4);
-    out.resize(Base64::btoa((const byte*) in.data(), (int)in.size(), (char *) out.data()));
+    out.resize(encodedLength(in.size()));
+    out.resize(encode((const byte*) in.data(), in.size(), (char *) out.data()));
 
     return out;
 }
 
 int Base64::btoa(const byte* b, int blen, char* a)
 {
-    int p = 0;
+    int p = blen > 0 ? (int)encode(b, size_t(blen), a) : 0;
 
-    for (;;)
-    {
-        if (blen <= 0)
-        {
-            break;
-        }
+    a[p] = 0;
+
+    return p;
+}
 
+size_t Base64::encode(const byte* b, size_t blen, char* a)
+{
+    size_t done = encodeVector(b, blen, a);
+    size_t p = done / 3 * 4;
+
+    b += done;
+    blen -= done;
+
+    while (blen)
+    {
         a[p++] = to64(static_cast<byte>(*b >> 2));
         a[p++] = to64(static_cast<byte>((*b << 4) | (((blen > 1) ? b[1] : 0) >> 4)));
 
@@ -251,8 +492,6 @@ int Base64::btoa(const byte* b, int blen, char* a)
         b += 3;
     }
 
-    a[p] = 0;
-
     return p;
 }
 
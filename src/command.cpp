@@ -33,6 +33,7 @@ Command::Command()
     tag = 0;
     batchSeparately = false;
     suppressSID = false;
+    jsonWriter.reusebuffer();
 }
 
 Command::~Command()
@@ -118,7 +119,14 @@ bool Command::checkError(Error& errorDetails, JSON& json)
 bool Command::cacheresolvedurls(const std::vector<string>& urls, std::vector<string>&& ips)
 {
     // cache resolved URLs if received
-    return client->httpio->cacheresolvedurls(urls, std::move(ips));
+    if (client->httpio->cacheresolvedurls(urls, std::move(ips)))
+    {
+        return true;
+    }
+
+    // otherwise resolve them while the transfer gets ready
+    client->httpio->prefetchdns(urls);
+    return false;
 }
 
 // Store ips from response in the vector passed
@@ -147,6 +155,16 @@ void Command::cmd(const char* cmd)
     jsonWriter.cmd(cmd);
 }
 
+void Command::reserve(size_t len)
+{
+    jsonWriter.reserve(len);
+}
+
+void Command::recyclebuffer()
+{
+    jsonWriter.recycle();
+}
+
 void Command::notself(MegaClient *client)
 {
     jsonWriter.notself(client);
@@ -198,6 +198,7 @@ CommandGetFA::CommandGetFA(MegaClient *client, int p, handle fahref)
     part = p;
 
     cmd("ufa");
+    independent = true;
     arg("fah", (byte*)&fahref, sizeof fahref);
 
     if (client->usehttps)
@@ -348,6 +349,8 @@ CommandPutFile::CommandPutFile(MegaClient* client, TransferSlot* ctslot, int ms)
     tslot = ctslot;
 
     cmd("u");
+    interactive = true;
+    independent = true;
 
     if (client->usehttps)
     {
@@ -459,6 +462,7 @@ bool CommandPutFile::procresult(Result r)
                         LOG_err << "Unpaired IPs received for URLs in `u` command. URLs: " << tempurls.size() << " IPs: " << tempips.size();
                     }
 
+                    tslot->transfer->timeline.mark(TransferTimeline::URL_RECEIVED);
                     tslot->transfer->tempurls = tempurls;
                     tslot->transferbuf.setIsRaid(tslot->transfer, tempurls, tslot->transfer->pos, tslot->maxRequestSize);
                     tslot->starttime = tslot->lastdata = client->waiter->ds;
@@ -555,6 +559,8 @@ CommandDirectRead::CommandDirectRead(MegaClient *client, DirectReadNode* cdrn)
     drn = cdrn;
 
     cmd("g");
+    interactive = true;
+    independent = true;
     arg(drn->p ? "n" : "p", (byte*)&drn->h, MegaClient::NODEHANDLE);
     arg("g", 1); // server will provide download URL(s)/token(s) (if skipped, only information about the file)
     arg("v", 2);  // version 2: server can supply details for cloudraid files
@@ -638,6 +644,7 @@ bool CommandDirectRead::procresult(Result r)
                         if (drn)
                         {
                             drn->tempurls.swap(tempurls);
+                            client->httpio->prefetchdns(drn->tempurls);
                             e.setErrorCode(API_OK);
                         }
                     }
@@ -702,6 +709,8 @@ CommandGetFile::CommandGetFile(MegaClient *client, const byte* key, size_t keySi
                                bool singleUrl, Cb &&completion)
 {
     cmd("g");
+    interactive = true;
+    independent = true;
     arg(p ? "n" : "p", (byte*)&h, MegaClient::NODEHANDLE);
     arg("g", 1); // server will provide download URL(s)/token(s) (if skipped, only information about the file)
     if (!singleUrl)
@@ -970,6 +979,8 @@ CommandPutNodes::CommandPutNodes(MegaClient* client, NodeHandle th,
                                  vector<NewNode>&& newnodes, int ctag, putsource_t csource, const char *cauth,
                                  Completion&& resultFunction, bool canChangeVault)
   : mResultFunction(resultFunction)
+  , mVersioningOption(vo)
+  , mCanChangeVault(canChangeVault)
 {
     byte key[FILENODEKEYLENGTH];
 
@@ -981,6 +992,15 @@ CommandPutNodes::CommandPutNodes(MegaClient* client, NodeHandle th,
     nn = std::move(newnodes);
     type = userhandle ? USER_HANDLE : NODE_HANDLE;
     source = csource;
+
+    // most of a node is its encrypted attributes and key in base64, plus the share keys
+    size_t estimate = 256;
+    for (auto& n : nn)
+    {
+        estimate += 192 + (n.attrstring ? n.attrstring->size() : 0) * 4 / 3 + n.nodekey.size() * 4 / 3;
+    }
+    reserve(estimate);
+
     cmd("p");
     notself(client);
 
@@ -1044,6 +1064,8 @@ CommandPutNodes::CommandPutNodes(MegaClient* client, NodeHandle th,
 
     beginarray("n");
 
+    mFileAttributes.resize(nn.size());
+
     for (unsigned i = 0; i < nn.size(); i++)
     {
         beginobject();
@@ -1084,6 +1106,8 @@ CommandPutNodes::CommandPutNodes(MegaClient* client, NodeHandle th,
                 {
                     arg("fa", s.c_str(), 1);
                 }
+
+                mFileAttributes[i] = std::move(s);
         }
 
         if (!ISUNDEF(nn[i].parenthandle))
@@ -1153,7 +1177,12 @@ CommandPutNodes::CommandPutNodes(MegaClient* client, NodeHandle th,
 // add new nodes and handle->node handle mapping
 void CommandPutNodes::removePendingDBRecordsAndTempFiles()
 {
-    pendingdbid_map::iterator it = client->pendingtcids.find(tag);
+    removePendingDBRecordsAndTempFiles(tag);
+}
+
+void CommandPutNodes::removePendingDBRecordsAndTempFiles(int ptag)
+{
+    pendingdbid_map::iterator it = client->pendingtcids.find(ptag);
     if (it != client->pendingtcids.end())
     {
         if (client->tctable)
@@ -1170,7 +1199,7 @@ void CommandPutNodes::removePendingDBRecordsAndTempFiles()
         }
         client->pendingtcids.erase(it);
     }
-    pendingfiles_map::iterator pit = client->pendingfiles.find(tag);
+    pendingfiles_map::iterator pit = client->pendingfiles.find(ptag);
     if (pit != client->pendingfiles.end())
     {
         vector<LocalPath> &pfs = pit->second;
@@ -1185,11 +1214,153 @@ void CommandPutNodes::removePendingDBRecordsAndTempFiles()
 void CommandPutNodes::performAppCallback(Error e, vector<NewNode>& newnodes, bool targetOverride)
 {
     if (mResultFunction) mResultFunction(e, type, newnodes, targetOverride, tag);
-	else client->app->putnodes_result(e, type, newnodes, targetOverride, tag);
+    else client->app->putnodes_result(e, type, newnodes, targetOverride, tag);
+}
+
+// the "f" (new nodes) and "f2" (versions) of a successful response
+Error CommandPutNodes::parseresult(bool& empty)
+{
+    Error e = API_EINTERNAL;
+    bool noexit = true;
+    empty = false;
+    while (noexit)
+    {
+        switch (client->json.getnameid())
+        {
+            case 'f':
+                empty = !memcmp(client->json.pos, "[]", 2);
+                if (client->readnodes(&client->json, 1, source, &nn, true, true))  // do apply keys to received nodes only as we go for command response, much much faster for many small responses
+                {
+                    e = API_OK;
+                }
+                else
+                {
+                    LOG_err << "Parse error (readnodes)";
+                    e = API_EINTERNAL;
+                    noexit = false;
+                }
+                break;
+
+            case MAKENAMEID2('f', '2'):
+                if (!client->readnodes(&client->json, 1, PUTNODES_APP, nullptr, false, true))  // do apply keys to received nodes only as we go for command response, much much faster for many small responses
+                {
+                    LOG_err << "Parse error (readversions)";
+                    e = API_EINTERNAL;
+                    noexit = false;
+                }
+                break;
+
+            default:
+                if (client->json.storeobject())
+                {
+                    continue;
+                }
+
+                e = API_EINTERNAL;
+                LOG_err << "Parse error (PutNodes)";
+
+                // fall through
+            case EOO:
+                noexit = false;
+                break;
+        }
+    }
+    return e;
+}
+
+// results of putnodes coalesced by MegaClient::putnodesBatched: each request gets its own nodes back,
+// as if it had been sent alone. The ones the batch didn't add are sent again on their own,
+// so a failure of the batch as a whole never becomes the result of a request that might succeed,
+// and a request only fails with the error the server gives for it. The checks of the single
+// putnodes path that concern the target (overquota, syncdown) are done once for the whole batch.
+bool CommandPutNodes::procbatchresult(Result r)
+{
+    bool overquota = false;
+
+    if (r.wasErrorOrOK())
+    {
+        if (r.wasError(API_EOVERQUOTA))
+        {
+            // no request of the batch would fit on its own either
+            LOG_debug << "Batched putnodes error " << r.errorOrOK();
+            overquota = true;
+
+            if (client->isPrivateNode(targethandle))
+            {
+                client->activateoverquota(0, false);
+            }
+        }
+        else
+        {
+            LOG_debug << "Batched putnodes error " << r.errorOrOK() << ", resending each request on its own";
+        }
+    }
+    else
+    {
+        bool empty;
+        if (parseresult(empty) != API_OK)
+        {
+            LOG_warn << "Batched putnodes response incomplete, resending the requests it didn't add";
+        }
+        client->sendkeyrewrites();
+
+#ifdef ENABLE_SYNC
+        if (!targethandle.isUndef())
+        {
+            Node *parent = client->nodeByHandle(targethandle);
+            if (parent && parent->localnode)
+            {
+                // see procresult()
+                client->syncdownrequired = true;
+            }
+        }
+#endif
+    }
+
+    Node *tempNode = !nn.empty() ? client->nodebyhandle(nn.front().mAddedHandle) : nullptr;
+    bool targetOverride = (tempNode && tempNode->parenthandle != targethandle.as8byte());
+
+    size_t next = 0;
+    for (auto& b : mBatch)
+    {
+        vector<NewNode> part;
+        part.reserve(b.count);
+        for (size_t i = 0; i < b.count && next < nn.size(); i++, next++)
+        {
+            part.push_back(std::move(nn[next]));
+
+            if (!mFileAttributes[next].empty())
+            {
+                part.back().fileattributes.reset(new string(std::move(mFileAttributes[next])));
+            }
+        }
+
+        bool anyAdded = std::any_of(part.begin(), part.end(), [](const NewNode& n) { return n.added; });
+        if (!anyAdded && !overquota)
+        {
+            client->reqs.add(new CommandPutNodes(client, targethandle, NULL, mVersioningOption, std::move(part), b.tag,
+                                                 PUTNODES_APP, nullptr, std::move(b.completion), mCanChangeVault));
+            continue;
+        }
+
+        removePendingDBRecordsAndTempFiles(b.tag);
+
+        Error e = overquota ? Error(API_EOVERQUOTA) : Error(API_OK);
+        client->restag = b.tag;
+        if (b.completion) b.completion(e, type, part, !overquota && targetOverride, b.tag);
+        else client->app->putnodes_result(e, type, part, !overquota && targetOverride, b.tag);
+    }
+
+    return true;
 }
 
 bool CommandPutNodes::procresult(Result r)
 {
+    if (!mBatch.empty())
+    {
+        return procbatchresult(r);
+    }
+
     removePendingDBRecordsAndTempFiles();
 
     if (r.wasErrorOrOK())
@@ -1249,51 +1420,8 @@ bool CommandPutNodes::procresult(Result r)
 #endif
     }
 
-    Error e = API_EINTERNAL;
-    bool noexit = true;
-    bool empty = false;
-    while (noexit)
-    {
-        switch (client->json.getnameid())
-        {
-            case 'f':
-                empty = !memcmp(client->json.pos, "[]", 2);
-                if (client->readnodes(&client->json, 1, source, &nn, true, true))  // do apply keys to received nodes only as we go for command response, much much faster for many small responses
-                {
-                    e = API_OK;
-                }
-                else
-                {
-                    LOG_err << "Parse error (readnodes)";
-                    e = API_EINTERNAL;
-                    noexit = false;
-                }
-                break;
-
-            case MAKENAMEID2('f', '2'):
-                if (!client->readnodes(&client->json, 1, PUTNODES_APP, nullptr, false, true))  // do apply keys to received nodes only as we go for command response, much much faster for many small responses
-                {
-                    LOG_err << "Parse error (readversions)";
-                    e = API_EINTERNAL;
-                    noexit = false;
-                }
-                break;
-
-            default:
-                if (client->json.storeobject())
-                {
-                    continue;
-                }
-
-                e = API_EINTERNAL;
-                LOG_err << "Parse error (PutNodes)";
-
-                // fall through
-            case EOO:
-                noexit = false;
-                break;
-        }
-    }
+    bool empty;
+    Error e = parseresult(empty);
 
     client->sendkeyrewrites();
 
@@ -1364,7 +1492,7 @@ CommandMoveNode::CommandMoveNode(MegaClient* client, Node* n, Node* t, syncdel_t
 
     TreeProcShareKeys tpsk;
     client->proctree(n, &tpsk);
-    tpsk.get(this);
+    mMoreNodeKeys = tpsk.get(this, client);
 
     tag = 0;
     completion = move(c);
@@ -1455,6 +1583,11 @@ bool CommandMoveNode::procresult(Result r)
         {
             client->sendevent(99439, "Unexpected move error", 0);
         }
+
+        if (r.wasError(API_OK) && !mMoreNodeKeys.empty())
+        {
+            CommandShareNodeKeys::queue(client, UNDEF, std::make_shared<const vector<handle>>(move(mMoreNodeKeys)));
+        }
     }
     if (completion) completion(h, r.errorOrOK());
     return r.wasErrorOrOK();
@@ -1536,6 +1669,12 @@ CommandDelVersions::CommandDelVersions(MegaClient* client)
 
 bool CommandDelVersions::procresult(Result r)
 {
+    if (r.wasError(API_OK))
+    {
+        // not to wait for an action packet per version
+        client->mNodeManager.removeVersions();
+    }
+
     client->app->unlinkversions_result(r.errorOrOK());
     return r.wasErrorOrOK();
 }
@@ -2047,7 +2186,7 @@ CommandSetShare::CommandSetShare(MegaClient* client, Node* n, User* u, accesslev
         // the new share's nodekeys for this user: generate node list
         TreeProcShareKeys tpsk(n);
         client->proctree(n, &tpsk);
-        tpsk.get(this);
+        mMoreNodeKeys = tpsk.get(this, client);
     }
 }
 
@@ -2095,6 +2234,11 @@ bool CommandSetShare::procresult(Result r)
 {
     if (r.wasErrorOrOK())
     {
+        if (r.wasError(API_OK))
+        {
+            sendmorenodekeys();
+        }
+
         completion(r.errorOrOK(), mWritable);
         return true;
     }
@@ -2162,6 +2306,7 @@ bool CommandSetShare::procresult(Result r)
                 break;
 
             case EOO:
+                sendmorenodekeys();
                 completion(API_OK, mWritable);
                 return true;
 
@@ -2174,6 +2319,14 @@ bool CommandSetShare::procresult(Result r)
     }
 }
 
+void CommandSetShare::sendmorenodekeys()
+{
+    if (!mMoreNodeKeys.empty())
+    {
+        CommandShareNodeKeys::queue(client, sh, std::make_shared<const vector<handle>>(move(mMoreNodeKeys)));
+    }
+}
+
 CommandSetPendingContact::CommandSetPendingContact(MegaClient* client, const char* temail, opcactions_t action, const char* msg, const char* oemail, handle contactLink, Completion completion)
 {
     cmd("upc");
@@ -3593,7 +3746,7 @@ bool CommandGetUA::procresult(Result r)
                     if (!client->json.storeobject())
                     {
                         LOG_err << "Error in CommandGetUA. Parse error";
-                        client->app->getua_result(API_EINTERNAL);
+                        mCompletionErr(API_EINTERNAL);
                         if (client->fetchingkeys && at == ATTR_SIG_RSA_PUBK && u && u->userhandle == client->me)
                         {
                             client->initializekeys(); // we have now all the required data
@@ -3800,6 +3953,68 @@ CommandKeyCR::CommandKeyCR(MegaClient* /*client*/, node_vector* rshares, node_ve
     endarray();
 }
 
+CommandShareNodeKeys::CommandShareNodeKeys(MegaClient* client, handle share, std::shared_ptr<const vector<handle>> nodes, size_t first)
+    : mShare(share)
+    , mNodes(move(nodes))
+{
+    Node* sn = ISUNDEF(share) ? nullptr : client->nodebyhandle(share);
+
+    vector<Node*> batch;
+    size_t i = first;
+
+    if (ISUNDEF(share) || (sn && sn->sharekey))
+    {
+        for (; i < mNodes->size() && batch.size() < TreeProcShareKeys::MAX_NODES_PER_COMMAND; i++)
+        {
+            Node* n = client->nodebyhandle((*mNodes)[i]);
+            if (n && n->keyApplied() && (!sn || n->isbelow(sn)))
+            {
+                batch.push_back(n);
+            }
+        }
+    }
+    else
+    {
+        // the share is gone
+        i = mNodes->size();
+    }
+
+    mNext = i;
+
+    cmd("k");
+
+    ShareNodeKeys snk;
+    TreeProcShareKeys::add(client, snk, sn, batch.data(), batch.size());
+    snk.get(this);
+    mHasKeys = !snk.empty();
+}
+
+void CommandShareNodeKeys::queue(MegaClient* client, handle share, std::shared_ptr<const vector<handle>> nodes, size_t first)
+{
+    while (first < nodes->size())
+    {
+        std::unique_ptr<CommandShareNodeKeys> c(new CommandShareNodeKeys(client, share, nodes, first));
+        first = c->mNext;
+
+        if (c->mHasKeys)
+        {
+            client->reqs.add(c.release());
+            return;
+        }
+    }
+}
+
+bool CommandShareNodeKeys::procresult(Result r)
+{
+    if (r.wasStrictlyError())
+    {
+        LOG_warn << "Failed to send share node keys: " << r.errorOrOK();
+    }
+
+    queue(client, mShare, mNodes, mNext);
+    return true;
+}
+
 // a == ACCESS_UNKNOWN: request public key for user handle and respond with
 // share key for sn
 // otherwise: request public key for user handle and continue share creation
@@ -5813,7 +6028,16 @@ bool CommandFetchNodes::procresult(Result r)
     WAIT_CLASS::bumpds();
     client->fnstats.timeToLastByte = Waiter::ds - client->fnstats.startTime;
 
-    client->purgenodesusersabortsc(true);
+    if (client->mFetchNodesStreamed)
+    {
+        // purged when the first nodes arrived, which are loaded already
+        client->mFetchNodesStreamed = false;
+    }
+    else
+    {
+        client->purgenodesusersabortsc(true);
+    }
+    client->mFetchNodesStreamFailed = false;
 
     if (r.wasErrorOrOK())
     {
@@ -6952,9 +7176,11 @@ bool CommandChatInvite::procresult(Result r)
         }
 
         chat->userpriv->push_back(userpriv_pair(uh, priv));
+        chat->changed.peers = true;
 
         if (!title.empty())  // only if title was set for this chatroom, update it
         {
+            chat->changed.title = chat->changed.title || chat->title != title;
             chat->title = title;
         }
 
@@ -7006,6 +7232,7 @@ bool CommandChatRemove::procresult(Result r)
                 if (upvit->first == uh)
                 {
                     chat->userpriv->erase(upvit);
+                    chat->changed.peers = true;
                     if (chat->userpriv->empty())
                     {
                         delete chat->userpriv;
@@ -7028,8 +7255,10 @@ bool CommandChatRemove::procresult(Result r)
         if (uh == client->me)
         {
             chat->priv = PRIV_RM;
+            chat->changed.ownPriv = true;
 
             // clear the list of peers (if re-invited, peers will be re-added)
+            chat->changed.peers = chat->changed.peers || chat->userpriv;
             delete chat->userpriv;
             chat->userpriv = NULL;
         }
@@ -7203,6 +7432,7 @@ bool CommandChatUpdatePermissions::procresult(Result r)
                 {
                     chat->userpriv->erase(upvit);
                     chat->userpriv->push_back(userpriv_pair(uh, priv));
+                    chat->changed.peers = true;
                     found = true;
                     break;
                 }
@@ -7218,6 +7448,7 @@ bool CommandChatUpdatePermissions::procresult(Result r)
         else
         {
             chat->priv = priv;
+            chat->changed.ownPriv = true;
         }
 
         chat->setTag(tag ? tag : -1);
@@ -7292,6 +7523,7 @@ bool CommandChatSetTitle::procresult(Result r)
         }
 
         TextChat *chat = client->chats[chatid];
+        chat->changed.title = chat->changed.title || chat->title != title;
         chat->title = title;
 
         chat->setTag(tag ? tag : -1);
@@ -9052,67 +9284,67 @@ bool CommandDismissBanner::procresult(Result r)
 
 bool CommandSE::procresultid(const Result& r, handle& id, m_time_t& ts, handle* u, handle* s, int64_t* o) const
 {
-    if (r.hasJsonObject())
+    return r.hasJsonObject() && procjsonobject(id, ts, u, s, o);
+}
+
+bool CommandSE::procjsonobject(handle& id, m_time_t& ts, handle* u, handle* s, int64_t* o) const
+{
+    for (;;)
     {
-        for (;;)
+        switch (client->json.getnameid())
         {
-            switch (client->json.getnameid())
-            {
-            case MAKENAMEID2('i', 'd'):
-                id = client->json.gethandle(MegaClient::SETHANDLE);
-                break;
-
-            case MAKENAMEID1('u'):
-                if (u)
-                {
-                    *u = client->json.gethandle(MegaClient::USERHANDLE);
-                }
-                else if(!client->json.storeobject())
-                {
-                    return false;
-                }
-                break;
+        case MAKENAMEID2('i', 'd'):
+            id = client->json.gethandle(MegaClient::SETHANDLE);
+            break;
 
-            case MAKENAMEID1('s'):
-                if (s)
-                {
-                    *s = client->json.gethandle(MegaClient::SETHANDLE);
-                }
-                else if(!client->json.storeobject())
-                {
-                    return false;
-                }
-                break;
+        case MAKENAMEID1('u'):
+            if (u)
+            {
+                *u = client->json.gethandle(MegaClient::USERHANDLE);
+            }
+            else if(!client->json.storeobject())
+            {
+                return false;
+            }
+            break;
 
-            case MAKENAMEID2('t', 's'):
-                ts = client->json.getint();
-                break;
+        case MAKENAMEID1('s'):
+            if (s)
+            {
+                *s = client->json.gethandle(MegaClient::SETHANDLE);
+            }
+            else if(!client->json.storeobject())
+            {
+                return false;
+            }
+            break;
 
-            case MAKENAMEID1('o'):
-                if (o)
-                {
-                    *o = client->json.getint();
-                }
-                else if (!client->json.storeobject())
-                {
-                    return false;
-                }
-                break;
+        case MAKENAMEID2('t', 's'):
+            ts = client->json.getint();
+            break;
 
-            default:
-                if (!client->json.storeobject())
-                {
-                    return false;
-                }
-                break;
+        case MAKENAMEID1('o'):
+            if (o)
+            {
+                *o = client->json.getint();
+            }
+            else if (!client->json.storeobject())
+            {
+                return false;
+            }
+            break;
 
-            case EOO:
-                return true;
+        default:
+            if (!client->json.storeobject())
+            {
+                return false;
             }
+            break;
+
+        case EOO:
+            return true;
         }
     }
-
-    return false;
 }
 
 bool CommandSE::procerrorcode(const Result& r, Error& e) const
@@ -9337,6 +9569,159 @@ bool CommandPutSetElement::procresult(Result r)
     return parsedOk;
 }
 
+CommandPutSetElements::CommandPutSetElements(MegaClient* cl, vector<SetElement>&& els, const vector<pair<string, string>>& encrDetails,
+                                             vector<int64_t>&& results,
+                                             std::function<void(Error, const vector<const SetElement*>*, const vector<int64_t>*)> completion)
+    : mElements(new vector<SetElement>(move(els))), mResults(move(results)), mCompletion(completion)
+{
+    assert(!mElements->empty() && mElements->size() == encrDetails.size());
+
+    cmd("aepb");
+    arg("s", (byte*)&mElements->front().set(), MegaClient::SETHANDLE);
+
+    beginarray("e");
+    for (size_t i = 0; i < mElements->size(); ++i)
+    {
+        const SetElement& el = mElements->at(i);
+        const string& encrKey = encrDetails[i].first;
+        const string& encrAttrs = encrDetails[i].second;
+
+        beginobject();
+        arg("h", (byte*)&el.node(), MegaClient::NODEHANDLE);
+        arg("k", (byte*)encrKey.c_str(), (int)encrKey.size());
+        if (!encrAttrs.empty())
+        {
+            arg("at", (byte*)encrAttrs.c_str(), (int)encrAttrs.size());
+        }
+        endobject();
+    }
+    endarray();
+
+    notself(cl); // don't process its Action Packets after sending this
+}
+
+bool CommandPutSetElements::procresult(Result r)
+{
+    Error e = API_OK;
+    if (procerrorcode(r, e) || !r.hasJsonArray())
+    {
+        bool parsedOk = r.wasErrorOrOK();
+        if (mCompletion)
+        {
+            mCompletion(parsedOk ? e : Error(API_EINTERNAL), nullptr, nullptr);
+        }
+        return parsedOk;
+    }
+
+    // the response has one item per Element sent, in the same order: its error, or its id
+    vector<const SetElement*> added;
+    size_t sent = 0;
+    bool parsedOk = true;
+    for (int64_t& result : mResults)
+    {
+        if (result != API_OK)
+        {
+            continue;   // not sent
+        }
+
+        SetElement& el = mElements->at(sent++);
+        if (!parsedOk)
+        {
+            result = API_EINTERNAL;
+        }
+        else if (client->json.isnumeric())
+        {
+            result = client->json.getint();
+        }
+        else
+        {
+            handle elementId = 0;
+            m_time_t ts = 0;
+            int64_t order = 0;
+            parsedOk = client->json.enterobject()
+                    && procjsonobject(elementId, ts, nullptr, nullptr, &order)
+                    && client->json.leaveobject();
+
+            if (!parsedOk)
+            {
+                LOG_err << "Sets: Failed to parse \"aepb\" response";
+                result = API_EINTERNAL;
+                continue;
+            }
+
+            el.setId(elementId);
+            el.setTs(ts);
+            el.setOrder(order);
+            added.push_back(client->addOrUpdateSetElement(move(el)));
+        }
+    }
+
+    if (mCompletion)
+    {
+        mCompletion(parsedOk ? API_OK : API_EINTERNAL, &added, &mResults);
+    }
+
+    return parsedOk;
+}
+
+CommandRemoveSetElements::CommandRemoveSetElements(MegaClient* cl, handle sid, vector<handle>&& eids,
+                                                   std::function<void(Error, const vector<int64_t>*)> completion)
+    : mSetId(sid), mElementIds(move(eids)), mCompletion(completion)
+{
+    cmd("aerb");
+    arg("s", (byte*)&sid, MegaClient::SETHANDLE);
+
+    beginarray("e");
+    for (handle eid : mElementIds)
+    {
+        element(eid, MegaClient::SETELEMENTHANDLE);
+    }
+    endarray();
+
+    notself(cl); // don't process its Action Packets after sending this
+}
+
+bool CommandRemoveSetElements::procresult(Result r)
+{
+    Error e = API_OK;
+    if (procerrorcode(r, e) || !r.hasJsonArray())
+    {
+        bool parsedOk = r.wasErrorOrOK();
+        if (mCompletion)
+        {
+            mCompletion(parsedOk ? e : Error(API_EINTERNAL), nullptr);
+        }
+        return parsedOk;
+    }
+
+    // the response has the error of each Element, in the order they were sent
+    vector<int64_t> results(mElementIds.size(), API_EINTERNAL);
+    bool parsedOk = true;
+    for (size_t i = 0; i < mElementIds.size() && parsedOk; ++i)
+    {
+        parsedOk = client->json.isnumeric();
+        if (!parsedOk)
+        {
+            LOG_err << "Sets: Failed to parse \"aerb\" response";
+            break;
+        }
+
+        results[i] = client->json.getint();
+        if (results[i] == API_OK && !client->deleteSetElement(mSetId, mElementIds[i]))
+        {
+            LOG_err << "Sets: Failed to remove Element in `aerb` command response";
+            results[i] = API_ENOENT;
+        }
+    }
+
+    if (mCompletion)
+    {
+        mCompletion(parsedOk ? API_OK : API_EINTERNAL, &results);
+    }
+
+    return parsedOk;
+}
+
 CommandRemoveSetElement::CommandRemoveSetElement(MegaClient* cl, handle sid, handle eid, std::function<void(Error)> completion)
     : mSetId(sid), mElementId(eid), mCompletion(completion)
 {
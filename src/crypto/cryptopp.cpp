@@ -21,6 +21,14 @@
 
 #include "mega.h"
 
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define MEGA_CRC32_PCLMUL 1
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define MEGA_CRC32_ARM 1
+#endif
+
 namespace mega {
 #ifndef htobe64
 #define htobe64(x) (((uint64_t)htonl((uint32_t)((x) >> 32))) | (((uint64_t)htonl((uint32_t)x)) << 32))
@@ -65,27 +73,35 @@ byte SymmCipher::zeroiv[BLOCKSIZE];
 
 void SymmCipher::setkey(const byte* newkey, int type)
 {
-    memcpy(key, newkey, KEYLENGTH);
+    byte k[KEYLENGTH];
+    memcpy(k, newkey, KEYLENGTH);
 
     if (!type)
     {
-        xorblock(newkey + KEYLENGTH, key);
+        xorblock(newkey + KEYLENGTH, k);
     }
 
-    aesecb_e.SetKey(key, KEYLENGTH);
-    aesecb_d.SetKey(key, KEYLENGTH);
+    // rekeying with the key already set keeps the expanded schedules
+    if (!mKeySet || memcmp(k, key, KEYLENGTH))
+    {
+        memcpy(key, k, KEYLENGTH);
+        mKeySet = true;
+
+        aesecb_e.SetKey(key, KEYLENGTH);
+        aesecb_d.SetKey(key, KEYLENGTH);
 
-    aescbc_e.SetKeyWithIV(key, KEYLENGTH, zeroiv);
-    aescbc_d.SetKeyWithIV(key, KEYLENGTH, zeroiv);
+        aescbc_e.SetKeyWithIV(key, KEYLENGTH, zeroiv);
+        aescbc_d.SetKeyWithIV(key, KEYLENGTH, zeroiv);
 
-    aesccm8_e.SetKeyWithIV(key, KEYLENGTH, zeroiv);
-    aesccm8_d.SetKeyWithIV(key, KEYLENGTH, zeroiv);
+        aesccm16_e.SetKeyWithIV(key, KEYLENGTH, zeroiv);
+        aesccm16_d.SetKeyWithIV(key, KEYLENGTH, zeroiv);
 
-    aesccm16_e.SetKeyWithIV(key, KEYLENGTH, zeroiv);
-    aesccm16_d.SetKeyWithIV(key, KEYLENGTH, zeroiv);
+        aesccm8_e.SetKeyWithIV(key, KEYLENGTH, zeroiv);
+        aesccm8_d.SetKeyWithIV(key, KEYLENGTH, zeroiv);
 
-    aesgcm_e.SetKeyWithIV(key, KEYLENGTH, zeroiv);
-    aesgcm_d.SetKeyWithIV(key, KEYLENGTH, zeroiv);
+        aesgcm_e.SetKeyWithIV(key, KEYLENGTH, zeroiv);
+        aesgcm_d.SetKeyWithIV(key, KEYLENGTH, zeroiv);
+    }
 }
 
 bool SymmCipher::setkey(const string* key)
@@ -465,6 +481,12 @@ SymmCipher& SymmCipher::operator=(const SymmCipher& ref)
 // decryption: data must be padded to BLOCKSIZE
 // len must be < 2^31
 void SymmCipher::ctr_crypt(byte* data, unsigned len, m_off_t pos, ctr_iv ctriv, byte* mac, bool encrypt, bool initmac)
+{
+    ctr_crypt(data, data, len, pos, ctriv, mac, encrypt, initmac);
+}
+
+// as above, reading from src and writing to dst: neither needs padding when they differ
+void SymmCipher::ctr_crypt(const byte* src, byte* dst, unsigned len, m_off_t pos, ctr_iv ctriv, byte* mac, bool encrypt, bool initmac)
 {
     assert(!(pos & (KEYLENGTH - 1)));
 
@@ -479,8 +501,75 @@ void SymmCipher::ctr_crypt(byte* data, unsigned len, m_off_t pos, ctr_iv ctriv,
         memcpy(mac + sizeof ctriv, ctr, sizeof ctriv);
     }
 
-    while ((int)len > 0)
+    // bulk path: whole blocks are processed CTR_BATCH_BLOCKS at a time, so that
+    // Crypto++ can pipeline the keystream through AES-NI/ARMv8-CE (selected at runtime)
+    // and the CBC-MAC chain is computed in one call instead of per block
+    byte ctrs[CTR_BATCH_BLOCKS * BLOCKSIZE], stream[CTR_BATCH_BLOCKS * BLOCKSIZE];
+
+    while (len >= (unsigned)BLOCKSIZE)
+    {
+        unsigned blocks = len / BLOCKSIZE;
+
+        if (blocks > CTR_BATCH_BLOCKS)
+        {
+            blocks = CTR_BATCH_BLOCKS;
+        }
+
+        unsigned bytes = blocks * BLOCKSIZE;
+
+        for (unsigned i = 0; i < blocks; i++)
+        {
+            memcpy(ctrs + i * BLOCKSIZE, ctr, BLOCKSIZE);
+            incblock(ctr);
+        }
+
+        aesecb_e.ProcessData(stream, ctrs, bytes);
+
+        if (encrypt && mac)
+        {
+            cbcmac_blocks(src, bytes, mac);
+        }
+
+        if (src == dst)
+        {
+            for (unsigned i = 0; i < bytes; i += BLOCKSIZE)
+            {
+                xorblock(stream + i, dst + i);
+            }
+        }
+        else
+        {
+            for (unsigned i = 0; i < bytes; i += BLOCKSIZE)
+            {
+                xorblock(src + i, stream + i);
+            }
+
+            memcpy(dst, stream, bytes);
+        }
+
+        if (!encrypt && mac)
+        {
+            cbcmac_blocks(dst, bytes, mac);
+        }
+
+        len -= bytes;
+        src += bytes;
+        dst += bytes;
+    }
+
+    // trailing partial block, on a padded copy when out of place
+    if ((int)len > 0)
     {
+        byte last[BLOCKSIZE];
+        byte* data = dst;
+
+        if (src != dst)
+        {
+            memset(last, 0, BLOCKSIZE);
+            memcpy(last, src, len);
+            data = last;
+        }
+
         if (encrypt)
         {
             if(mac)
@@ -499,26 +588,30 @@ void SymmCipher::ctr_crypt(byte* data, unsigned len, m_off_t pos, ctr_iv ctriv,
 
             if (mac)
             {
-                if (len >= (unsigned)BLOCKSIZE)
-                {
-                    xorblock(data, mac);
-                }
-                else
-                {
-                    xorblock(data, mac, len);
-                }
-
+                xorblock(data, mac, int(len));
                 ecb_encrypt(mac);
             }
         }
 
-        len -= BLOCKSIZE;
-        data += BLOCKSIZE;
-
-        incblock(ctr);
+        if (data != dst)
+        {
+            memcpy(dst, data, len);
+        }
     }
 }
 
+// fold whole blocks into a CBC-MAC, leaving the last chained block in mac
+void SymmCipher::cbcmac_blocks(const byte* data, unsigned len, byte* mac)
+{
+    byte out[CTR_BATCH_BLOCKS * BLOCKSIZE];
+
+    assert(!(len & (BLOCKSIZE - 1)) && len <= sizeof out);
+
+    aescbc_e.Resynchronize(mac);
+    aescbc_e.ProcessData(out, data, len);
+    memcpy(mac, out + len - BLOCKSIZE, BLOCKSIZE);
+}
+
 static void rsaencrypt(Integer* key, Integer* m)
 {
     *m = a_exp_b_mod_c(*m, key[AsymmCipher::PUB_E], key[AsymmCipher::PUB_PQ]);
@@ -842,14 +935,186 @@ void HashSHA256::get(std::string *retStr)
     hash.Final((byte*)retStr->data());
 }
 
+namespace {
+
+struct CRC32Table
+{
+    uint32_t t[256];
+
+    CRC32Table()
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+            {
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+    }
+};
+
+const CRC32Table crc32table;
+
+uint32_t crc32_bytes(uint32_t crc, const byte* data, size_t len)
+{
+    while (len--)
+    {
+        crc = crc32table.t[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#ifdef MEGA_CRC32_PCLMUL
+// Folding with carry-less multiplication, per Intel's "Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ Instruction" with the bit-reflected IEEE constants.
+// Requires len >= 64 and a multiple of 16.
+__attribute__((target("pclmul,sse4.1")))
+uint32_t crc32_pclmul(uint32_t crc, const byte* buf, size_t len)
+{
+    alignas(16) static const uint64_t k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+    alignas(16) static const uint64_t k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+    alignas(16) static const uint64_t k5k0[] = { 0x0163cd6124, 0x0000000000 };
+    alignas(16) static const uint64_t poly[] = { 0x01db710641, 0x01f7011641 };
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(int(crc)));
+    x0 = _mm_load_si128((const __m128i*)k1k2);
+
+    buf += 64;
+    len -= 64;
+
+    // fold four lanes in parallel
+    while (len >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        buf += 64;
+        len -= 64;
+    }
+
+    // fold the four lanes into one
+    x0 = _mm_load_si128((const __m128i*)k3k4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    while (len >= 16)
+    {
+        x2 = _mm_loadu_si128((const __m128i*)buf);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        buf += 16;
+        len -= 16;
+    }
+
+    // 128 -> 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128((const __m128i*)poly);
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return uint32_t(_mm_extract_epi32(x1, 1));
+}
+
+// checked on first use: __builtin_cpu_supports() needs __builtin_cpu_init() to have run,
+// which is not guaranteed from another static initializer
+bool haspclmul()
+{
+    static const bool supported = []()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+    }();
+    return supported;
+}
+#endif
+
+} // anonymous
+
+uint32_t HashCRC32::update(uint32_t crc, const byte* data, size_t len)
+{
+#ifdef MEGA_CRC32_PCLMUL
+    if (len >= 64 && haspclmul())
+    {
+        size_t n = len & ~size_t(15);
+        crc = crc32_pclmul(crc, data, n);
+        data += n;
+        len -= n;
+    }
+#elif defined(MEGA_CRC32_ARM)
+    for (; len >= 8; data += 8, len -= 8)
+    {
+        uint64_t v;
+        memcpy(&v, data, sizeof v);
+        crc = __crc32d(crc, v);
+    }
+#endif
+    return crc32_bytes(crc, data, len);
+}
+
 void HashCRC32::add(const byte* data, unsigned len)
 {
-    hash.Update(data, len);
+    crc = update(crc, data, len);
 }
 
 void HashCRC32::get(byte* out)
 {
-    hash.Final(out);
+    uint32_t result = crc ^ 0xFFFFFFFF;
+    memcpy(out, &result, sizeof result);
+    crc = 0xFFFFFFFF;
 }
 
 HMACSHA256::HMACSHA256(const byte *key, size_t length)
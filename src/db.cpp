@@ -20,6 +20,7 @@
  */
 
 #include "mega/db.h"
+#include "mega/node.h"
 #include "mega/utils.h"
 #include "mega/logging.h"
 
@@ -49,14 +50,134 @@ bool DbTable::put(uint32_t type, Cacheable* record, SymmCipher* key)
         return true;
     }
 
-    PaddedCBC::encrypt(rng, &data, key);
+    return putserialized(type, record, &data, key);
+}
+
+bool DbTable::putserialized(uint32_t type, Cacheable* record, string* data, SymmCipher* key)
+{
+    PaddedCBC::encrypt(rng, data, key);
 
     if (!record->dbid)
     {
         record->dbid = (nextid += IDSPACING) | type;
     }
 
-    return put(record->dbid, &data);
+    return put(record->dbid, data);
+}
+
+bool DbTable::put(const std::vector<Record>& records)
+{
+    bool result = true;
+    for (const Record& record : records)
+    {
+        result = put(record.id, (char*)record.content.data(), unsigned(record.content.size())) && result;
+    }
+    return result;
+}
+
+bool DbTable::put(uint32_t type, const std::vector<Cacheable*>& records, SymmCipher* key)
+{
+    std::vector<Record> encrypted;
+    encrypted.reserve(records.size());
+
+    for (Cacheable* record : records)
+    {
+        string data;
+
+        if (!record->serialize(&data))
+        {
+            // as for a single record, skip it and keep saving the rest
+            LOG_warn << "Serialization failed: " << type;
+            continue;
+        }
+
+        PaddedCBC::encrypt(rng, &data, key);
+
+        if (!record->dbid)
+        {
+            record->dbid = (nextid += IDSPACING) | type;
+        }
+
+        encrypted.push_back(Record{record->dbid, record->parentdbid(), std::move(data)});
+    }
+
+    return put(encrypted);
+}
+
+bool DbTable::getbyparent(uint32_t parentid, std::vector<std::pair<uint32_t, string>>& records, SymmCipher* key)
+{
+    if (!getbyparent(parentid, records))
+    {
+        return false;
+    }
+
+    for (auto it = records.begin(); it != records.end(); )
+    {
+        if (PaddedCBC::decrypt(&it->second, key))
+        {
+            ++it;
+        }
+        else
+        {
+            LOG_warn << "Decryption failed: " << it->first;
+            it = records.erase(it);
+        }
+    }
+
+    return true;
+}
+
+bool DbTable::putalert(uint32_t type, int64_t ts, bool seen, Cacheable* record, SymmCipher* key)
+{
+    AlertRecord alert{0, ts, seen, string()};
+
+    if (!record->serialize(&alert.content))
+    {
+        // as for the other records, skip it and let the SDK continue
+        LOG_warn << "Serialization failed: " << type;
+        return true;
+    }
+
+    PaddedCBC::encrypt(rng, &alert.content, key);
+
+    uint32_t dbid = record->dbid ? record->dbid : (nextid + IDSPACING) | type;
+    alert.id = dbid;
+
+    if (!putalert(alert))
+    {
+        return false;
+    }
+
+    if (!record->dbid)
+    {
+        record->dbid = dbid;
+        nextid += IDSPACING;
+    }
+
+    return true;
+}
+
+bool DbTable::getalerts(uint64_t offset, uint64_t limit, std::vector<AlertRecord>& alerts, SymmCipher* key)
+{
+    if (!getalerts(offset, limit, alerts))
+    {
+        return false;
+    }
+
+    for (auto it = alerts.begin(); it != alerts.end(); )
+    {
+        if (PaddedCBC::decrypt(&it->content, key))
+        {
+            ++it;
+        }
+        else
+        {
+            LOG_warn << "Decryption failed: " << it->id;
+            it = alerts.erase(it);
+        }
+    }
+
+    return true;
 }
 
 // get next record, decrypt and unpad
@@ -118,7 +239,13 @@ void DbTable::checkCommitter(DBTableTransactionCommitter*)
     assert(mTransactionCommitter);
 }
 
-const int DbAccess::LEGACY_DB_VERSION = 12;
+bool DBTableNodes::serializeNode(Node* node, string* d) const
+{
+    return compactNodes() ? node->serializeCompact(d) : node->serialize(d);
+}
+
+// 14: nodes are stored with Node::serializeCompact(), which versions using 13 can't read
+const int DbAccess::LEGACY_DB_VERSION = 13;
 const int DbAccess::DB_VERSION = DbAccess::LEGACY_DB_VERSION + 1;
 const int DbAccess::LAST_DB_VERSION_WITHOUT_NOD = 12;
 
@@ -119,12 +119,13 @@ SqliteDbTable *SqliteDbAccess::open(PrnGen &rng, FileSystemAccess &fsAccess, con
         return nullptr;
     }
 
-    return new SqliteDbTable(rng,
-                             db,
-                             fsAccess,
-                             dbPath,
-                             (flags & DB_OPEN_FLAG_TRANSACTED) > 0);
-
+    SqliteDbTable* table = new SqliteDbTable(rng,
+                                             db,
+                                             fsAccess,
+                                             dbPath,
+                                             (flags & DB_OPEN_FLAG_TRANSACTED) > 0);
+    table->applyTuning(resolveTuning(fsAccess, dbPath));
+    return table;
 }
 
 DbTable *SqliteDbAccess::openTableWithNodes(PrnGen &rng, FileSystemAccess &fsAccess, const string &name, const int flags)
@@ -140,7 +141,7 @@ DbTable *SqliteDbAccess::openTableWithNodes(PrnGen &rng, FileSystemAccess &fsAcc
     std::string sql = "CREATE TABLE IF NOT EXISTS nodes (nodehandle int64 PRIMARY KEY NOT NULL, "
                       "parenthandle int64, name text, fingerprint BLOB, origFingerprint BLOB, "
                       "type tinyint, size int64, share tinyint, fav tinyint, mimetype tinyint, "
-                      "ctime int64, flags int64, counter BLOB NOT NULL, node BLOB NOT NULL)";
+                      "ctime int64, flags int64, counter BLOB NOT NULL, node BLOB NOT NULL, path text, namekey BLOB)";
     int result = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
     if (result)
     {
@@ -149,6 +150,34 @@ DbTable *SqliteDbAccess::openTableWithNodes(PrnGen &rng, FileSystemAccess &fsAcc
         return nullptr;
     }
 
+    if (!addNodesPath(db) || !addNodesNameKey(db) || !createAlertsTable(db))
+    {
+        sqlite3_close(db);
+        return nullptr;
+    }
+
+    // With WAL, NORMAL only skips the sync of each commit, not of checkpoints: a power loss can lose
+    // the last commits, never corrupt the DB. The state cache commits the scsn with the nodes, so it
+    // comes back consistent, and bulk loads don't wait for the disk at every commit
+#if !(TARGET_OS_IPHONE)
+    result = sqlite3_exec(db, "PRAGMA synchronous=NORMAL;", nullptr, nullptr, nullptr);
+    if (result)
+    {
+        LOG_err << "PRAGMA synchronous error " << sqlite3_errmsg(db);
+    }
+#endif
+
+    // Unlike the indexes of createIndexes(), put() needs this one while the nodes are loaded
+    result = sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS pathindex on nodes (path)", nullptr, nullptr, nullptr);
+    if (result)
+    {
+        LOG_debug << "Data base error while creating index (pathindex): " << sqlite3_errmsg(db);
+        sqlite3_close(db);
+        return nullptr;
+    }
+
+    bool nameIndex = createNameIndex(db);
+
 #if __ANDROID__
     // Android doesn't provide a temporal directory -> change default policy for temp
     // store (FILE=1) to avoid failures on large queries, so it relies on MEMORY=2
@@ -161,11 +190,53 @@ DbTable *SqliteDbAccess::openTableWithNodes(PrnGen &rng, FileSystemAccess &fsAcc
     }
 #endif
 
-    return new SqliteAccountState(rng,
-                                db,
-                                fsAccess,
-                                dbPath,
-                                (flags & DB_OPEN_FLAG_TRANSACTED) > 0);
+    // a legacy DB keeps the format older versions can read, until the API grants the upgrade
+    bool compactNodes = currentDbVersion == DB_VERSION;
+
+    SqliteAccountState* table = new SqliteAccountState(rng,
+                                                       db,
+                                                       fsAccess,
+                                                       dbPath,
+                                                       (flags & DB_OPEN_FLAG_TRANSACTED) > 0,
+                                                       nameIndex,
+                                                       compactNodes);
+    table->applyTuning(resolveTuning(fsAccess, dbPath));
+    return table;
+}
+
+DbAccess::Tuning SqliteDbAccess::resolveTuning(FileSystemAccess& fsAccess, const LocalPath& dbPath) const
+{
+    // the DB grows with the account
+    int64_t dbSize = 0;
+    std::unique_ptr<FileAccess> fileAccess = fsAccess.newfileaccess();
+    if (fileAccess->fopen(dbPath))
+    {
+        dbSize = fileAccess->size;
+    }
+
+    Tuning resolved = tuning;
+    if (!resolved.mmapSize)
+    {
+        resolved.mmapSize = (sizeof(void*) >= 8 && dbSize >= MMAP_MIN_DB_SIZE) ? std::min(dbSize * 2, int64_t(MMAP_MAX_SIZE)) : -1;
+    }
+
+    if (!resolved.cacheSizeKb)
+    {
+        // a sixteenth of the DB
+        resolved.cacheSizeKb = std::max(int64_t(MIN_CACHE_SIZE_KB), std::min(dbSize >> 14, int64_t(MAX_CACHE_SIZE_KB)));
+    }
+
+    if (!resolved.walCheckpointPages)
+    {
+        // 1/256 of the DB, in 4 KB pages
+        int64_t pages = dbSize >> 20;
+        resolved.walCheckpointPages = static_cast<int>(std::max(int64_t(MIN_WAL_CHECKPOINT_PAGES), std::min(pages, int64_t(MAX_WAL_CHECKPOINT_PAGES))));
+    }
+
+    LOG_debug << "DB tuning for " << dbPath << " (" << dbSize << " bytes): mmap_size " << resolved.mmapSize
+              << ", cache_size " << resolved.cacheSizeKb << " KB, WAL checkpoint at " << resolved.walCheckpointPages << " pages";
+
+    return resolved;
 }
 
 bool SqliteDbAccess::probe(FileSystemAccess& fsAccess, const string& name) const
@@ -217,7 +288,7 @@ bool SqliteDbAccess::openDBAndCreateStatecache(sqlite3 **db, FileSystemAccess &f
     }
 #endif /* ! TARGET_OS_IPHONE */
 
-    string sql = "CREATE TABLE IF NOT EXISTS statecache (id INTEGER PRIMARY KEY ASC NOT NULL, content BLOB NOT NULL)";
+    string sql = "CREATE TABLE IF NOT EXISTS statecache (id INTEGER PRIMARY KEY ASC NOT NULL, content BLOB NOT NULL, parentid INTEGER)";
 
     result = sqlite3_exec(*db, sql.c_str(), nullptr, nullptr, nullptr);
     if (result)
@@ -228,6 +299,217 @@ bool SqliteDbAccess::openDBAndCreateStatecache(sqlite3 **db, FileSystemAccess &f
         return false;
     }
 
+    if (!addStatecacheParent(*db))
+    {
+        sqlite3_close(*db);
+        return false;
+    }
+
+    return true;
+}
+
+bool SqliteDbAccess::addStatecacheParent(sqlite3* db)
+{
+    sqlite3_stmt* stmt = nullptr;
+    bool exists = sqlite3_prepare_v2(db, "SELECT parentid FROM statecache LIMIT 0", -1, &stmt, nullptr) == SQLITE_OK;
+    sqlite3_finalize(stmt);
+
+    // records from before the column stay NULL until they are put again
+    int result = exists ? SQLITE_OK : sqlite3_exec(db, "ALTER TABLE statecache ADD COLUMN parentid INTEGER", nullptr, nullptr, nullptr);
+    if (result == SQLITE_OK)
+    {
+        // NULLs are indexed too, as DbTable::indexedbyparent() looks for them
+        result = sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS statecacheparentindex ON statecache (parentid)", nullptr, nullptr, nullptr);
+    }
+
+    if (result)
+    {
+        LOG_err << "Unable to index the records of 'statecache' by parent: " << sqlite3_errmsg(db);
+        return false;
+    }
+
+    return true;
+}
+
+bool SqliteDbAccess::createAlertsTable(sqlite3* db)
+{
+    // the alerts of DBs that predate the table are in `statecache`: MegaClient::fetchsc() moves them
+    int result = sqlite3_exec(db, "CREATE TABLE IF NOT EXISTS alerts (id INTEGER PRIMARY KEY NOT NULL, "
+                                  "ts int64 NOT NULL, seen tinyint NOT NULL, content BLOB NOT NULL)", nullptr, nullptr, nullptr);
+    if (result == SQLITE_OK)
+    {
+        result = sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS alertsindex ON alerts (ts DESC, id DESC)", nullptr, nullptr, nullptr);
+    }
+
+    if (result)
+    {
+        LOG_err << "Unable to create table 'alerts': " << sqlite3_errmsg(db);
+        return false;
+    }
+
+    return true;
+}
+
+// SQL function that folds its argument as Utils::toLowerUtf8() does
+static void utf8LowerFunction(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+    assert(argc == 1);
+    const unsigned char* text = sqlite3_value_text(argv[0]);
+    if (!text)
+    {
+        sqlite3_result_null(context);
+        return;
+    }
+
+    string lower = Utils::toLowerUtf8(string(reinterpret_cast<const char*>(text), sqlite3_value_bytes(argv[0])));
+    sqlite3_result_text(context, lower.c_str(), static_cast<int>(lower.size()), SQLITE_TRANSIENT);
+}
+
+bool SqliteDbAccess::createNameIndex(sqlite3* db)
+{
+    // Nodes from before the index existed are added when it's created, so check first
+    sqlite3_stmt* stmt = nullptr;
+    bool exists = false;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'nodesname'", -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        exists = sqlite3_step(stmt) == SQLITE_ROW;
+    }
+    sqlite3_finalize(stmt);
+
+    if (exists)
+    {
+        // the table needs FTS5 to be read or written
+        bool usable = sqlite3_prepare_v2(db, "SELECT rowid FROM nodesname LIMIT 0", -1, &stmt, nullptr) == SQLITE_OK;
+        sqlite3_finalize(stmt);
+        if (!usable)
+        {
+            LOG_warn << "Unable to use the index of node names, searching by name won't use it: " << sqlite3_errmsg(db);
+        }
+        return usable;
+    }
+
+    // Trigram tokens let GLOB '*term*' use the index. Names are stored already case-folded,
+    // so the tokenizer is case sensitive (GLOB only uses the index in that mode)
+    int result = sqlite3_exec(db, "CREATE VIRTUAL TABLE nodesname USING fts5(name, tokenize = 'trigram case_sensitive 1')", nullptr, nullptr, nullptr);
+    if (result)
+    {
+        // FTS5 or its trigram tokenizer (SQLite 3.34) not available: searches scan the nodes table
+        LOG_warn << "Unable to create the index of node names, searching by name won't use it: " << sqlite3_errmsg(db);
+        return false;
+    }
+
+    if (sqlite3_create_function(db, "utf8lower", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr, utf8LowerFunction, nullptr, nullptr) == SQLITE_OK)
+    {
+        result = sqlite3_exec(db, "INSERT INTO nodesname (rowid, name) SELECT nodehandle, utf8lower(name) FROM nodes", nullptr, nullptr, nullptr);
+    }
+    else
+    {
+        result = SQLITE_ERROR;
+    }
+
+    if (result)
+    {
+        LOG_err << "Unable to fill the index of node names: " << sqlite3_errmsg(db);
+        sqlite3_exec(db, "DROP TABLE IF EXISTS nodesname", nullptr, nullptr, nullptr);
+        return false;
+    }
+
+    return true;
+}
+
+// SQL function returning SqliteAccountState::pathSegment() for a handle
+static void pathSegmentFunction(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+    assert(argc == 1);
+    handle h = static_cast<handle>(sqlite3_value_int64(argv[0]));
+    string segment = SqliteAccountState::pathSegment(h);
+    sqlite3_result_text(context, segment.c_str(), static_cast<int>(segment.size()), SQLITE_TRANSIENT);
+}
+
+bool SqliteDbAccess::addNodesPath(sqlite3* db)
+{
+    sqlite3_stmt* stmt = nullptr;
+    bool exists = sqlite3_prepare_v2(db, "SELECT path FROM nodes LIMIT 0", -1, &stmt, nullptr) == SQLITE_OK;
+    sqlite3_finalize(stmt);
+
+    if (exists)
+    {
+        return true;
+    }
+
+    LOG_debug << "Adding the path of every node to the database";
+
+    // Walk down from the nodes whose parent isn't stored (root nodes, inshares and orphans)
+    std::string sql = "BEGIN; "
+                      "ALTER TABLE nodes ADD COLUMN path text; "
+                      "CREATE TEMP TABLE nodespath (nodehandle int64 PRIMARY KEY NOT NULL, path text); "
+                      "WITH RECURSIVE p(nodehandle, path) AS ("
+                      "SELECT n.nodehandle, CASE WHEN n.parenthandle = " + std::to_string(static_cast<int64_t>(UNDEF)) + " THEN '' "
+                      "ELSE nodepathsegment(n.parenthandle) END || nodepathsegment(n.nodehandle) FROM nodes n "
+                      "WHERE NOT EXISTS (SELECT 1 FROM nodes a WHERE a.nodehandle = n.parenthandle) "
+                      "UNION ALL SELECT c.nodehandle, p.path || nodepathsegment(c.nodehandle) FROM nodes c "
+                      "INNER JOIN p ON c.parenthandle = p.nodehandle) "
+                      "INSERT INTO nodespath SELECT nodehandle, path FROM p; "
+                      "UPDATE nodes SET path = (SELECT path FROM nodespath WHERE nodespath.nodehandle = nodes.nodehandle); "
+                      "DROP TABLE nodespath; "
+                      "COMMIT;";
+
+    int result = sqlite3_create_function(db, "nodepathsegment", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr, pathSegmentFunction, nullptr, nullptr);
+    if (result == SQLITE_OK)
+    {
+        result = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+    }
+
+    if (result)
+    {
+        LOG_err << "Unable to add the path of the nodes to the database: " << sqlite3_errmsg(db);
+        sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+        return false;
+    }
+
+    return true;
+}
+
+// SQL function returning naturalsortingKey() of a name
+static void naturalSortingKeyFunction(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+    assert(argc == 1);
+    const char* name = reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
+    string key = naturalsortingKey(name ? name : "");
+    sqlite3_result_blob(context, key.data(), static_cast<int>(key.size()), SQLITE_TRANSIENT);
+}
+
+bool SqliteDbAccess::addNodesNameKey(sqlite3* db)
+{
+    sqlite3_stmt* stmt = nullptr;
+    bool exists = sqlite3_prepare_v2(db, "SELECT namekey FROM nodes LIMIT 0", -1, &stmt, nullptr) == SQLITE_OK;
+    sqlite3_finalize(stmt);
+
+    if (exists)
+    {
+        return true;
+    }
+
+    LOG_debug << "Adding the sorting key of every node name to the database";
+
+    std::string sql = "BEGIN; "
+                      "ALTER TABLE nodes ADD COLUMN namekey BLOB; "
+                      "UPDATE nodes SET namekey = naturalsortingkey(name); "
+                      "COMMIT;";
+
+    int result = sqlite3_create_function(db, "naturalsortingkey", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr, naturalSortingKeyFunction, nullptr, nullptr);
+    if (result == SQLITE_OK)
+    {
+        result = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+    }
+
+    if (result)
+    {
+        LOG_err << "Unable to add the sorting key of the node names to the database: " << sqlite3_errmsg(db);
+        sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+        return false;
+    }
+
     return true;
 }
 
@@ -327,16 +609,224 @@ SqliteDbTable::~SqliteDbTable()
     sqlite3_finalize(pStmt);
     sqlite3_finalize(mDelStmt);
     sqlite3_finalize(mPutStmt);
+    sqlite3_finalize(mPutBatchStmt);
+    sqlite3_finalize(mGetByParentStmt);
 
     if (inTransaction())
     {
         abort();
     }
 
+    stopWalCheckpointer();
     sqlite3_close(db);
     LOG_debug << "Database closed " << dbfile;
 }
 
+void SqliteDbTable::applyTuning(const DbAccess::Tuning& tuning)
+{
+    mTuning = tuning;
+
+    if (!db)
+    {
+        return;
+    }
+
+    if (mTuning.mmapSize > 0)
+    {
+        std::string sql = "PRAGMA mmap_size=" + std::to_string(mTuning.mmapSize) + ";";
+        if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK)
+        {
+            LOG_err << "PRAGMA mmap_size error " << sqlite3_errmsg(db);
+        }
+    }
+
+    if (mTuning.cacheSizeKb > 0)
+    {
+        // negative: size in KB rather than in pages
+        std::string sql = "PRAGMA cache_size=-" + std::to_string(mTuning.cacheSizeKb) + ";";
+        if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK)
+        {
+            LOG_err << "PRAGMA cache_size error " << sqlite3_errmsg(db);
+        }
+    }
+
+#if !(TARGET_OS_IPHONE)
+    // only WAL (see openDBAndCreateStatecache()) checkpoints, and read-only connections never write
+    if (!mWalCheckpointPages && sqlite3_db_readonly(db, "main") == 0)
+    {
+        startWalCheckpointer();
+    }
+#endif
+}
+
+void SqliteDbTable::optimize()
+{
+    if (!db)
+    {
+        return;
+    }
+
+    // analysis_limit bounds the rows ANALYZE reads per index, so this stays quick on big DBs
+    int rc = sqlite3_exec(db, "PRAGMA analysis_limit=1000; PRAGMA optimize;", nullptr, nullptr, nullptr);
+    if (rc != SQLITE_OK)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(rc));
+        LOG_warn << "Unable to optimize database: " << dbfile << err;
+    }
+    else
+    {
+        LOG_debug << "DB optimized " << dbfile;
+    }
+}
+
+void SqliteDbTable::startWalCheckpointer()
+{
+    mWalCheckpointPages = mTuning.walCheckpointPages > 0 ? mTuning.walCheckpointPages : 1000;
+
+    // replaces the hook of automatic checkpoints
+    sqlite3_wal_hook(db, walHook, this);
+}
+
+void SqliteDbTable::stopWalCheckpointer()
+{
+    if (mWalCheckpointPages)
+    {
+        sqlite3_wal_hook(db, nullptr, nullptr);
+        WalCheckpointer::instance().cancel(this);
+        mWalCheckpointPages = 0;
+    }
+}
+
+int SqliteDbTable::walHook(void* param, sqlite3* db, const char* dbName, int pages)
+{
+    SqliteDbTable* table = static_cast<SqliteDbTable*>(param);
+    if (pages >= table->mWalCheckpointPages * 10)
+    {
+        // the worker can't keep up (it never completes while the WAL is never free of readers
+        // and writers): don't let the WAL grow without bounds
+        sqlite3_wal_checkpoint_v2(db, dbName, SQLITE_CHECKPOINT_PASSIVE, nullptr, nullptr);
+    }
+    else if (pages >= table->mWalCheckpointPages)
+    {
+        WalCheckpointer::instance().request(table, table->dbfile.toPath(false));
+    }
+    return SQLITE_OK;
+}
+
+SqliteDbTable::WalCheckpointer& SqliteDbTable::WalCheckpointer::instance()
+{
+    static WalCheckpointer checkpointer;
+    return checkpointer;
+}
+
+SqliteDbTable::WalCheckpointer::WalCheckpointer()
+    : mThread([this]() { loop(); })
+{
+}
+
+SqliteDbTable::WalCheckpointer::~WalCheckpointer()
+{
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mShutdown = true;
+    }
+    mConditionVariable.notify_all();
+    mThread.join();
+}
+
+void SqliteDbTable::WalCheckpointer::request(const SqliteDbTable* table, const string& path)
+{
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        for (auto& pending : mPending)
+        {
+            if (pending.first == table)
+            {
+                // already due
+                return;
+            }
+        }
+        mPending.emplace_back(table, path);
+    }
+    mConditionVariable.notify_all();
+}
+
+void SqliteDbTable::WalCheckpointer::cancel(const SqliteDbTable* table)
+{
+    std::unique_lock<std::mutex> g(mMutex);
+    mPending.erase(std::remove_if(mPending.begin(), mPending.end(),
+                                  [table](const std::pair<const SqliteDbTable*, string>& pending)
+                                  {
+                                      return pending.first == table;
+                                  }),
+                   mPending.end());
+    mConditionVariable.wait(g, [this, table]() { return mRunning != table; });
+}
+
+void SqliteDbTable::WalCheckpointer::loop()
+{
+    std::unique_lock<std::mutex> g(mMutex);
+    for (;;)
+    {
+        mConditionVariable.wait(g, [this]() { return !mPending.empty() || mShutdown; });
+        if (mShutdown)
+        {
+            return;
+        }
+        mRunning = mPending.front().first;
+        string path = std::move(mPending.front().second);
+        mPending.pop_front();
+        g.unlock();
+
+        checkpoint(path);
+
+        g.lock();
+        mRunning = nullptr;
+        mConditionVariable.notify_all();
+    }
+}
+
+void SqliteDbTable::WalCheckpointer::checkpoint(const string& path)
+{
+    sqlite3* checkpointDb = nullptr;
+    int result = sqlite3_open_v2(path.c_str(), &checkpointDb,
+        SQLITE_OPEN_READWRITE
+        | SQLITE_OPEN_FULLMUTEX
+        | SQLITE_OPEN_PRIVATECACHE
+        , nullptr);
+
+    if (result == SQLITE_OK)
+    {
+        // reads the WAL header: until then, checkpoints from this connection do nothing
+        result = sqlite3_exec(checkpointDb, "PRAGMA journal_mode=WAL;", nullptr, nullptr, nullptr);
+    }
+
+    if (result != SQLITE_OK)
+    {
+        // the committing thread checkpoints once the WAL grows ten times bigger
+        string err = string(" Error: ") + (checkpointDb && sqlite3_errmsg(checkpointDb) ? sqlite3_errmsg(checkpointDb) : std::to_string(result));
+        LOG_warn << "Unable to open a connection to checkpoint database: " << path << err;
+        sqlite3_close(checkpointDb);
+        return;
+    }
+
+    // PASSIVE neither waits for nor blocks the writer; frames still needed by a reader's
+    // snapshot are left for the next round
+    int logPages = 0;
+    int checkpointedPages = 0;
+    result = sqlite3_wal_checkpoint_v2(checkpointDb, nullptr, SQLITE_CHECKPOINT_PASSIVE, &logPages, &checkpointedPages);
+    if (result != SQLITE_OK && result != SQLITE_BUSY)
+    {
+        LOG_warn << "Unable to checkpoint database: " << sqlite3_errmsg(checkpointDb);
+    }
+    else
+    {
+        LOG_verbose << "DB checkpoint: " << checkpointedPages << " of " << logPages << " WAL pages";
+    }
+
+    sqlite3_close(checkpointDb);
+}
+
 bool SqliteDbTable::inTransaction() const
 {
     return sqlite3_get_autocommit(db) == 0;
@@ -489,8 +979,200 @@ bool SqliteDbTable::put(uint32_t index, char* data, unsigned len)
     return ok;
 }
 
-
-// delete record by index
+bool SqliteDbTable::put(const std::vector<Record>& records)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    checkTransaction();
+
+    int sqlResult = SQLITE_OK;
+    size_t i = 0;
+
+    // full batches in a cached statement, the remainder in one of its size
+    while (sqlResult == SQLITE_OK && i < records.size())
+    {
+        size_t rows = std::min(records.size() - i, size_t(PUT_BATCH_ROWS));
+        sqlite3_stmt* stmt = rows == PUT_BATCH_ROWS ? mPutBatchStmt : nullptr;
+
+        if (!stmt)
+        {
+            string sql = "INSERT OR REPLACE INTO statecache (id, parentid, content) VALUES (?, ?, ?)";
+            for (size_t row = 1; row < rows; ++row)
+            {
+                sql += ", (?, ?, ?)";
+            }
+            sqlResult = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
+
+            if (rows == PUT_BATCH_ROWS)
+            {
+                mPutBatchStmt = stmt;
+            }
+        }
+
+        for (size_t row = 0; sqlResult == SQLITE_OK && row < rows; ++row)
+        {
+            const Record& record = records[i + row];
+
+            // First bits at index are reserved for the type
+            assert((record.id & (DbTable::IDSPACING - 1)) != MegaClient::CACHEDNODE);
+
+            int column = int(3 * row);
+            sqlResult = sqlite3_bind_int(stmt, column + 1, record.id);
+            if (sqlResult == SQLITE_OK)
+            {
+                sqlResult = sqlite3_bind_int(stmt, column + 2, record.parentid);
+            }
+            if (sqlResult == SQLITE_OK)
+            {
+                sqlResult = sqlite3_bind_blob(stmt, column + 3, record.content.data(), int(record.content.size()), SQLITE_STATIC);
+            }
+        }
+
+        if (sqlResult == SQLITE_OK)
+        {
+            sqlResult = sqlite3_step(stmt);
+            if (sqlResult == SQLITE_DONE)
+            {
+                sqlResult = SQLITE_OK;
+            }
+        }
+
+        if (stmt == mPutBatchStmt)
+        {
+            sqlite3_reset(stmt);
+        }
+        else
+        {
+            sqlite3_finalize(stmt);
+        }
+
+        i += rows;
+    }
+
+    if (sqlResult != SQLITE_OK)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to put records into database: " << dbfile << err;
+        assert(!"Unable to put records into database.");
+        return false;
+    }
+
+    return true;
+}
+
+bool SqliteDbTable::getbyparent(uint32_t parentid, std::vector<std::pair<uint32_t, string>>& records)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    int sqlResult = SQLITE_OK;
+    if (!mGetByParentStmt)
+    {
+        sqlResult = sqlite3_prepare_v2(db, "SELECT id, content FROM statecache WHERE parentid = ?", -1, &mGetByParentStmt, nullptr);
+    }
+
+    if (sqlResult == SQLITE_OK)
+    {
+        sqlResult = sqlite3_bind_int(mGetByParentStmt, 1, parentid);
+        while (sqlResult == SQLITE_OK && (sqlResult = sqlite3_step(mGetByParentStmt)) == SQLITE_ROW)
+        {
+            records.emplace_back(uint32_t(sqlite3_column_int(mGetByParentStmt, 0)),
+                                 string((const char*)sqlite3_column_blob(mGetByParentStmt, 1), sqlite3_column_bytes(mGetByParentStmt, 1)));
+            sqlResult = SQLITE_OK;
+        }
+    }
+
+    sqlite3_reset(mGetByParentStmt);
+
+    if (sqlResult != SQLITE_DONE)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to get records by parent from database: " << dbfile << err;
+        assert(!"Unable to get records by parent from database.");
+        return false;
+    }
+
+    return true;
+}
+
+bool SqliteDbTable::indexedbyparent()
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = sqlite3_prepare_v2(db, "SELECT 1 FROM statecache WHERE parentid IS NULL LIMIT 1", -1, &stmt, nullptr);
+    if (sqlResult == SQLITE_OK)
+    {
+        sqlResult = sqlite3_step(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    return sqlResult == SQLITE_DONE;
+}
+
+uint32_t SqliteDbTable::maxid()
+{
+    if (!db)
+    {
+        return 0;
+    }
+
+    uint32_t id = 0;
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT MAX(id & 4294967295) FROM statecache", -1, &stmt, nullptr) == SQLITE_OK
+            && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        id = uint32_t(sqlite3_column_int(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+
+    return id;
+}
+
+bool SqliteDbTable::delbyparent(uint32_t parentid)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    checkTransaction();
+
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = sqlite3_prepare_v2(db, "WITH RECURSIVE below(id) AS (SELECT id FROM statecache WHERE parentid = ?1 "
+                                           "UNION ALL SELECT s.id FROM statecache s INNER JOIN below ON s.parentid = below.id) "
+                                           "DELETE FROM statecache WHERE id IN below", -1, &stmt, nullptr);
+    if (sqlResult == SQLITE_OK)
+    {
+        sqlResult = sqlite3_bind_int(stmt, 1, parentid);
+        if (sqlResult == SQLITE_OK)
+        {
+            sqlResult = sqlite3_step(stmt);
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    if (sqlResult != SQLITE_DONE)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to delete records by parent from database: " << dbfile << err;
+        assert(!"Unable to delete records by parent from database.");
+        return false;
+    }
+
+    return true;
+}
+
+
+// delete record by index
 bool SqliteDbTable::del(uint32_t index)
 {
     if (!db)
@@ -617,12 +1299,17 @@ void SqliteDbTable::remove()
     mDelStmt = nullptr;
     sqlite3_finalize(mPutStmt);
     mPutStmt = nullptr;
+    sqlite3_finalize(mPutBatchStmt);
+    mPutBatchStmt = nullptr;
+    sqlite3_finalize(mGetByParentStmt);
+    mGetByParentStmt = nullptr;
 
     if (inTransaction())
     {
         abort();
     }
 
+    stopWalCheckpointer();
     sqlite3_close(db);
 
     db = NULL;
@@ -630,9 +1317,20 @@ void SqliteDbTable::remove()
     fsaccess->unlinklocal(dbfile);
 }
 
-SqliteAccountState::SqliteAccountState(PrnGen &rng, sqlite3 *pdb, FileSystemAccess &fsAccess, const LocalPath &path, const bool checkAlwaysTransacted)
+SqliteAccountState::SqliteAccountState(PrnGen &rng, sqlite3 *pdb, FileSystemAccess &fsAccess, const LocalPath &path, const bool checkAlwaysTransacted, const bool nameIndex, const bool compactNodes)
     : SqliteDbTable(rng, pdb, fsAccess, path, checkAlwaysTransacted)
+    , mNameIndex(nameIndex)
+    , mCompactNodes(compactNodes)
+    , mRng(rng)
 {
+#if !(TARGET_OS_IPHONE)
+    // without WAL (see openDBAndCreateStatecache()), readers would block the client's commits
+    // readers don't have readers of their own
+    if (pdb && sqlite3_db_readonly(pdb, "main") == 0)
+    {
+        mReaders = std::make_shared<ReaderPool>();
+    }
+#endif
 }
 
 SqliteAccountState::~SqliteAccountState()
@@ -646,12 +1344,57 @@ int SqliteAccountState::progressHandler(void *param)
     return cancelFlag->isCancelled();
 }
 
+int SqliteAccountState::prepare(const std::string& sql, sqlite3_stmt*& stmt)
+{
+    auto it = mStatements.find(sql);
+    if (it != mStatements.end())
+    {
+        stmt = it->second;
+        sqlite3_reset(stmt);
+        return SQLITE_OK;
+    }
+
+    int sqlResult = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL);
+    if (sqlResult == SQLITE_OK)
+    {
+        mStatements.emplace(sql, stmt);
+#ifdef DEBUG
+        logQueryPlan(sql);
+#endif
+    }
+
+    return sqlResult;
+}
+
+void SqliteAccountState::logQueryPlan(const std::string& sql)
+{
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db, ("EXPLAIN QUERY PLAN " + sql).c_str(), -1, &stmt, NULL) == SQLITE_OK)
+    {
+        std::string plan;
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            // 'detail' is the 4th column in every SQLite version
+            const unsigned char* detail = sqlite3_column_text(stmt, 3);
+            plan.append("\n    ").append(detail ? reinterpret_cast<const char*>(detail) : "");
+        }
+
+        LOG_verbose << "Query plan of " << sql << ":" << plan;
+    }
+
+    sqlite3_finalize(stmt);
+}
+
 bool SqliteAccountState::processSqlQueryNodes(sqlite3_stmt *stmt, std::vector<std::pair<mega::NodeHandle, mega::NodeSerialized>>& nodes)
 {
     assert(stmt);
+    auto start = std::chrono::steady_clock::now();
+    size_t rows = 0;
     int sqlResult = SQLITE_ERROR;
     while ((sqlResult = sqlite3_step(stmt)) == SQLITE_ROW)
     {
+        ++rows;
+
         NodeHandle nodeHandle;
         nodeHandle.set6byte(sqlite3_column_int64(stmt, 0));
 
@@ -688,6 +1431,22 @@ bool SqliteAccountState::processSqlQueryNodes(sqlite3_stmt *stmt, std::vector<st
         }
     }
 
+    // the counters are reset, so they refer to this run only
+    long long elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    int fullScanSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+    int sorts = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1);
+    bool slow = elapsedMs >= SLOW_QUERY_MS;
+#ifdef DEBUG
+    bool logStats = true;
+#else
+    bool logStats = slow;
+#endif
+    if (logStats)
+    {
+        LOG_debug << (slow ? "Slow query: " : "Query: ") << sqlite3_sql(stmt) << " [" << elapsedMs << " ms, " << rows << " rows, "
+                  << fullScanSteps << " full scan steps, " << sorts << " sorts]";
+    }
+
     return sqlResult == SQLITE_DONE;
 }
 
@@ -699,6 +1458,7 @@ bool SqliteAccountState::remove(NodeHandle nodehandle)
     }
 
     checkTransaction();
+    ++mNodesWrites;
 
     char buf[64];
 
@@ -712,6 +1472,18 @@ bool SqliteAccountState::remove(NodeHandle nodehandle)
         assert(!"Unable to remove a node from database.");
     }
 
+    if (sqlResult == SQLITE_OK && mNameIndex)
+    {
+        sprintf(buf, "DELETE FROM nodesname WHERE rowid = %" PRId64, nodehandle.as8byte());
+        sqlResult = sqlite3_exec(db, buf, 0, 0, NULL);
+        if (sqlResult == SQLITE_ERROR)
+        {
+            string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+            LOG_err << "Unable to remove a node name from database: " << dbfile << err;
+            assert(!"Unable to remove a node name from database.");
+        }
+    }
+
     return sqlResult == SQLITE_OK;
 }
 
@@ -723,6 +1495,7 @@ bool SqliteAccountState::removeNodes()
     }
 
     checkTransaction();
+    ++mNodesWrites;
 
     int sqlResult = sqlite3_exec(db, "DELETE FROM nodes", 0, 0, NULL);
     if (sqlResult == SQLITE_ERROR)
@@ -732,31 +1505,163 @@ bool SqliteAccountState::removeNodes()
         assert(!"Unable to remove all nodes from database.");
     }
 
+    if (sqlResult == SQLITE_OK && mNameIndex)
+    {
+        sqlResult = sqlite3_exec(db, "DELETE FROM nodesname", 0, 0, NULL);
+        if (sqlResult == SQLITE_ERROR)
+        {
+            string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+            LOG_err << "Unable to remove all node names from database: " << dbfile << err;
+            assert(!"Unable to remove all node names from database.");
+        }
+    }
+
     return sqlResult == SQLITE_OK;
 }
 
-void SqliteAccountState::updateCounter(NodeHandle nodeHandle, const std::string& nodeCounterBlob)
+bool SqliteAccountState::removeSubtree(NodeHandle ancestorHandle)
+{
+    return removeInSubtree(ancestorHandle, std::string());
+}
+
+bool SqliteAccountState::removeVersions(NodeHandle ancestorHandle)
+{
+    uint64_t versionFlags = (1 << Node::FLAGS_IS_VERSION);
+    return removeInSubtree(ancestorHandle, " AND flags & " + std::to_string(versionFlags) + " != 0");
+}
+
+bool SqliteAccountState::removeInSubtree(NodeHandle ancestorHandle, const std::string& condition)
 {
     if (!db)
     {
-        return;
+        return false;
+    }
+
+    std::string lowerPath, upperPath;
+    if (!subtreePaths(ancestorHandle, lowerPath, upperPath))
+    {
+        return true;    // nothing below a node that isn't stored
     }
 
     checkTransaction();
+    ++mNodesWrites;
+
+    // the subtree is a range of the path index: its names go first, while they can still be found
+    std::string rows = "FROM nodes WHERE path > ? AND path < ?" + condition;
+    std::vector<std::string> queries;
+    if (mNameIndex)
+    {
+        queries.push_back("DELETE FROM nodesname WHERE rowid IN (SELECT nodehandle " + rows + ")");
+    }
+    queries.push_back("DELETE " + rows);
 
     int sqlResult = SQLITE_OK;
-    if (!mStmtUpdateNode)
+    for (const std::string& query : queries)
+    {
+        sqlite3_stmt* stmt = nullptr;
+        sqlResult = prepare(query, stmt);
+
+        if (sqlResult == SQLITE_OK)
+        {
+            if ((sqlResult = sqlite3_bind_text(stmt, 1, lowerPath.c_str(), static_cast<int>(lowerPath.length()), SQLITE_STATIC)) == SQLITE_OK
+                    && (sqlResult = sqlite3_bind_text(stmt, 2, upperPath.c_str(), static_cast<int>(upperPath.length()), SQLITE_STATIC)) == SQLITE_OK)
+            {
+                sqlResult = sqlite3_step(stmt);
+            }
+
+            sqlite3_reset(stmt);
+        }
+
+        if (sqlResult != SQLITE_DONE)
+        {
+            string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+            LOG_err << "Unable to remove nodes of a subtree from database: " << dbfile << err;
+            assert(!"Unable to remove nodes of a subtree from database.");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool SqliteAccountState::getVersions(NodeHandle ancestorHandle, std::vector<VersionsRecord>& versions)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    std::string lowerPath, upperPath;
+    if (!subtreePaths(ancestorHandle, lowerPath, upperPath))
+    {
+        return true;    // nothing below a node that isn't stored
+    }
+
+    // the newest version is the one whose parent, the file, isn't a version itself
+    uint64_t versionFlags = (1 << Node::FLAGS_IS_VERSION);
+    std::string sqlQuery = "SELECT v.parenthandle, v.nodehandle, v.counter FROM nodes v "
+                           "INNER JOIN nodes f ON f.nodehandle = v.parenthandle "
+                           "WHERE v.path > ? AND v.path < ? AND v.flags & " + std::to_string(versionFlags) + " != 0 "
+                           "AND f.flags & " + std::to_string(versionFlags) + " = 0";
+
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare(sqlQuery, stmt);
+
+    if (sqlResult == SQLITE_OK)
+    {
+        if ((sqlResult = sqlite3_bind_text(stmt, 1, lowerPath.c_str(), static_cast<int>(lowerPath.length()), SQLITE_STATIC)) == SQLITE_OK
+                && (sqlResult = sqlite3_bind_text(stmt, 2, upperPath.c_str(), static_cast<int>(upperPath.length()), SQLITE_STATIC)) == SQLITE_OK)
+        {
+            while ((sqlResult = sqlite3_step(stmt)) == SQLITE_ROW)
+            {
+                VersionsRecord record;
+                record.file.set6byte(sqlite3_column_int64(stmt, 0));
+                record.newestVersion.set6byte(sqlite3_column_int64(stmt, 1));
+
+                const void* data = sqlite3_column_blob(stmt, 2);
+                int size = sqlite3_column_bytes(stmt, 2);
+                if (data && size)
+                {
+                    record.counter.assign(static_cast<const char*>(data), size);
+                }
+
+                versions.push_back(std::move(record));
+            }
+        }
+    }
+
+    if (sqlResult != SQLITE_DONE)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to get versions from database: " << dbfile << err;
+        assert(!"Unable to get versions from database.");
+    }
+
+    sqlite3_reset(stmt);
+
+    return sqlResult == SQLITE_DONE;
+}
+
+void SqliteAccountState::updateCounter(NodeHandle nodeHandle, const std::string& nodeCounterBlob)
+{
+    if (!db)
     {
-        sqlResult = sqlite3_prepare_v2(db, "UPDATE nodes SET counter = ?  WHERE nodehandle = ?", -1, &mStmtUpdateNode, NULL);
+        return;
     }
 
+    checkTransaction();
+    ++mNodesWrites;
+
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare("UPDATE nodes SET counter = ?  WHERE nodehandle = ?", stmt);
+
     if (sqlResult == SQLITE_OK)
     {
-        if ((sqlResult = sqlite3_bind_blob(mStmtUpdateNode, 1, nodeCounterBlob.data(), static_cast<int>(nodeCounterBlob.size()), SQLITE_STATIC)) == SQLITE_OK)
+        if ((sqlResult = sqlite3_bind_blob(stmt, 1, nodeCounterBlob.data(), static_cast<int>(nodeCounterBlob.size()), SQLITE_STATIC)) == SQLITE_OK)
         {
-            if ((sqlResult = sqlite3_bind_int64(mStmtUpdateNode, 2, nodeHandle.as8byte())) == SQLITE_OK)
+            if ((sqlResult = sqlite3_bind_int64(stmt, 2, nodeHandle.as8byte())) == SQLITE_OK)
             {
-                sqlResult = sqlite3_step(mStmtUpdateNode);
+                sqlResult = sqlite3_step(stmt);
             }
         }
 
@@ -769,7 +1674,7 @@ void SqliteAccountState::updateCounter(NodeHandle nodeHandle, const std::string&
         assert(!"Unable to update counter in database: ");
     }
 
-    sqlite3_reset(mStmtUpdateNode);
+    sqlite3_reset(stmt);
 }
 
 void SqliteAccountState::updateCounterAndFlags(NodeHandle nodeHandle, uint64_t flags, const std::string& nodeCounterBlob)
@@ -780,22 +1685,20 @@ void SqliteAccountState::updateCounterAndFlags(NodeHandle nodeHandle, uint64_t f
     }
 
     checkTransaction();
+    ++mNodesWrites;
 
-    int sqlResult = SQLITE_OK;
-    if (!mStmtUpdateNodeAndFlags)
-    {
-        sqlResult = sqlite3_prepare_v2(db, "UPDATE nodes SET counter = ?, flags = ? WHERE nodehandle = ?", -1, &mStmtUpdateNodeAndFlags, NULL);
-    }
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare("UPDATE nodes SET counter = ?, flags = ? WHERE nodehandle = ?", stmt);
 
     if (sqlResult == SQLITE_OK)
     {
-        if ((sqlResult = sqlite3_bind_blob(mStmtUpdateNodeAndFlags, 1, nodeCounterBlob.data(), static_cast<int>(nodeCounterBlob.size()), SQLITE_STATIC)) == SQLITE_OK)
+        if ((sqlResult = sqlite3_bind_blob(stmt, 1, nodeCounterBlob.data(), static_cast<int>(nodeCounterBlob.size()), SQLITE_STATIC)) == SQLITE_OK)
         {
-            if ((sqlResult = sqlite3_bind_int64(mStmtUpdateNodeAndFlags, 2, flags)) == SQLITE_OK)
+            if ((sqlResult = sqlite3_bind_int64(stmt, 2, flags)) == SQLITE_OK)
             {
-                if ((sqlResult = sqlite3_bind_int64(mStmtUpdateNodeAndFlags, 3, nodeHandle.as8byte())) == SQLITE_OK)
+                if ((sqlResult = sqlite3_bind_int64(stmt, 3, nodeHandle.as8byte())) == SQLITE_OK)
                 {
-                    sqlResult = sqlite3_step(mStmtUpdateNodeAndFlags);
+                    sqlResult = sqlite3_step(stmt);
                 }
             }
         }
@@ -808,7 +1711,7 @@ void SqliteAccountState::updateCounterAndFlags(NodeHandle nodeHandle, uint64_t f
         assert(!"Unable to update counter and flags in database: ");
     }
 
-    sqlite3_reset(mStmtUpdateNodeAndFlags);
+    sqlite3_reset(stmt);
 }
 
 void SqliteAccountState::createIndexes()
@@ -856,156 +1759,587 @@ void SqliteAccountState::createIndexes()
         LOG_err << "Data base error while creating index (favindex): " << sqlite3_errmsg(db);
     }
 
-    sql = "CREATE INDEX IF NOT EXISTS ctimeindex on nodes (ctime)";
+    // Previous versions can outnumber the live nodes many times over, and the queries below skip
+    // them (getRecentNodes() skips the rubbish bin too): these partial indexes only hold the rows
+    // those queries can return. SQLite only uses them if the queries spell their WHERE the same way
+    uint64_t versionFlags = (1 << Node::FLAGS_IS_VERSION);
+    uint64_t recentExcludeFlags = (1 << Node::FLAGS_IS_VERSION | 1 << Node::FLAGS_IS_IN_RUBBISH);
+
+    // superseded by recentsindex
+    sqlite3_exec(db, "DROP INDEX IF EXISTS ctimeindex", nullptr, nullptr, nullptr);
+
+    sql = "CREATE INDEX IF NOT EXISTS recentsindex on nodes (ctime) WHERE type = " + std::to_string(FILENODE)
+            + " AND flags & " + std::to_string(recentExcludeFlags) + " = 0";
     result = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
     if (result)
     {
-        LOG_err << "Data base error while creating index (ctimeindex): " << sqlite3_errmsg(db);
+        LOG_err << "Data base error while creating index (recentsindex): " << sqlite3_errmsg(db);
     }
-}
 
-void SqliteAccountState::remove()
-{
-    finalise();
+    sql = "CREATE INDEX IF NOT EXISTS mimetypeindex on nodes (mimetype) WHERE flags & " + std::to_string(versionFlags) + " = 0";
+    result = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+    if (result)
+    {
+        LOG_err << "Data base error while creating index (mimetypeindex): " << sqlite3_errmsg(db);
+    }
+
+    // pages of children by creation time (see getChildrenPage()) are read in order from this one
+    sql = "CREATE INDEX IF NOT EXISTS childrenctimeindex on nodes (parenthandle, type, ctime)";
+    result = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+    if (result)
+    {
+        LOG_err << "Data base error while creating index (childrenctimeindex): " << sqlite3_errmsg(db);
+    }
+
+    // pages of children by name, folders first, are read in order from this one (the descending
+    // orders still sort, but comparing keys bytewise rather than parsing names)
+    sql = "CREATE INDEX IF NOT EXISTS childrennameindex on nodes (parenthandle, type DESC, namekey, nodehandle)";
+    result = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+    if (result)
+    {
+        LOG_err << "Data base error while creating index (childrennameindex): " << sqlite3_errmsg(db);
+    }
+}
+
+std::shared_ptr<DBTableNodes> SqliteAccountState::getReader()
+{
+    if (!db || !mReaders)
+    {
+        return nullptr;
+    }
+
+    if (!inTransaction())
+    {
+        mCommittedNodesWrites = mNodesWrites;
+    }
+    else if (mCommittedNodesWrites != mNodesWrites)
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<SqliteAccountState> reader;
+    {
+        std::lock_guard<std::mutex> g(mReaders->mMutex);
+        if (!mReaders->mIdle.empty())
+        {
+            reader = std::move(mReaders->mIdle.back());
+            mReaders->mIdle.pop_back();
+        }
+        else if (mReaders->mNumOpen >= MAX_READERS)
+        {
+            return nullptr;
+        }
+        else
+        {
+            ++mReaders->mNumOpen;
+        }
+    }
+
+    if (!reader)
+    {
+        sqlite3* rdb = nullptr;
+        int result = sqlite3_open_v2(dbfile.toPath(false).c_str(), &rdb,
+            SQLITE_OPEN_READONLY
+            | SQLITE_OPEN_FULLMUTEX
+            | SQLITE_OPEN_PRIVATECACHE // a shared cache would serialize it with the client's connection
+            , nullptr);
+
+#if __ANDROID__
+        if (result == SQLITE_OK)
+        {
+            // see openTableWithNodes()
+            result = sqlite3_exec(rdb, "PRAGMA temp_store=2;", nullptr, nullptr, nullptr);
+        }
+#endif
+
+        if (result != SQLITE_OK)
+        {
+            string err = string(" Error: ") + (rdb && sqlite3_errmsg(rdb) ? sqlite3_errmsg(rdb) : std::to_string(result));
+            LOG_err << "Unable to open a read-only connection to database: " << dbfile << err;
+            sqlite3_close(rdb);
+
+            std::lock_guard<std::mutex> g(mReaders->mMutex);
+            --mReaders->mNumOpen;
+            return nullptr;
+        }
+
+        reader.reset(new SqliteAccountState(mRng, rdb, *fsaccess, dbfile, false, mNameIndex, mCompactNodes));
+        reader->applyTuning(mTuning);
+    }
+
+    std::shared_ptr<ReaderPool> pool = mReaders;
+    return std::shared_ptr<DBTableNodes>(reader.release(), [pool](DBTableNodes* table)
+    {
+        std::unique_ptr<SqliteAccountState> reader(static_cast<SqliteAccountState*>(table));
+
+        std::lock_guard<std::mutex> g(pool->mMutex);
+        if (pool->mClosed)
+        {
+            --pool->mNumOpen;
+        }
+        else
+        {
+            pool->mIdle.push_back(std::move(reader));
+        }
+    });
+}
+
+uint64_t SqliteAccountState::getNodesWrites() const
+{
+    return mNodesWrites;
+}
+
+void SqliteAccountState::closeReaders()
+{
+    if (!mReaders)
+    {
+        return;
+    }
+
+    std::vector<std::unique_ptr<SqliteAccountState>> idle;
+    {
+        std::lock_guard<std::mutex> g(mReaders->mMutex);
+        mReaders->mClosed = true;
+        mReaders->mNumOpen -= mReaders->mIdle.size();
+        idle.swap(mReaders->mIdle);
+    }
+}
+
+void SqliteAccountState::commit()
+{
+    SqliteDbTable::commit();
+
+    mCommittedNodesWrites = mNodesWrites;
+}
+
+void SqliteAccountState::remove()
+{
+    finalise();
 
     SqliteDbTable::remove();
 }
 
+void SqliteAccountState::truncate()
+{
+    SqliteDbTable::truncate();
+
+    if (!db)
+    {
+        return;
+    }
+
+    int sqlResult = sqlite3_exec(db, "DELETE FROM alerts", nullptr, nullptr, nullptr);
+    if (sqlResult != SQLITE_OK)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to truncate alerts in database: " << dbfile << err;
+        assert(!"Unable to truncate alerts in database.");
+    }
+}
+
+uint32_t SqliteAccountState::maxid()
+{
+    uint32_t id = SqliteDbTable::maxid();
+
+    sqlite3_stmt* stmt = nullptr;
+    if (db && prepare("SELECT MAX(id & 4294967295) FROM alerts", stmt) == SQLITE_OK
+            && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        id = std::max(id, uint32_t(sqlite3_column_int64(stmt, 0)));
+    }
+    sqlite3_reset(stmt);
+
+    return id;
+}
+
+bool SqliteAccountState::putalert(const AlertRecord& alert)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    checkTransaction();
+
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare("INSERT OR REPLACE INTO alerts (id, ts, seen, content) VALUES (?, ?, ?, ?)", stmt);
+    if (sqlResult == SQLITE_OK)
+    {
+        sqlResult = sqlite3_bind_int(stmt, 1, alert.id);
+    }
+    if (sqlResult == SQLITE_OK)
+    {
+        sqlResult = sqlite3_bind_int64(stmt, 2, alert.ts);
+    }
+    if (sqlResult == SQLITE_OK)
+    {
+        sqlResult = sqlite3_bind_int(stmt, 3, alert.seen);
+    }
+    if (sqlResult == SQLITE_OK)
+    {
+        sqlResult = sqlite3_bind_blob(stmt, 4, alert.content.data(), int(alert.content.size()), SQLITE_STATIC);
+    }
+    if (sqlResult == SQLITE_OK)
+    {
+        sqlResult = sqlite3_step(stmt);
+    }
+    sqlite3_reset(stmt);
+
+    if (sqlResult != SQLITE_DONE)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to put alert into database: " << dbfile << err;
+        assert(!"Unable to put alert into database.");
+        return false;
+    }
+
+    return true;
+}
+
+bool SqliteAccountState::getalerts(uint64_t offset, uint64_t limit, std::vector<AlertRecord>& alerts)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare("SELECT id, ts, seen, content FROM alerts ORDER BY ts DESC, id DESC LIMIT ? OFFSET ?", stmt);
+    if (sqlResult == SQLITE_OK)
+    {
+        // LIMIT takes a signed value: cap it, rather than wrapping it to "no limit"
+        sqlResult = sqlite3_bind_int64(stmt, 1, int64_t(std::min<uint64_t>(limit, INT64_MAX)));
+    }
+    if (sqlResult == SQLITE_OK)
+    {
+        sqlResult = sqlite3_bind_int64(stmt, 2, int64_t(std::min<uint64_t>(offset, INT64_MAX)));
+    }
+    while (sqlResult == SQLITE_OK && (sqlResult = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        alerts.push_back(AlertRecord{uint32_t(sqlite3_column_int64(stmt, 0)),
+                                     sqlite3_column_int64(stmt, 1),
+                                     sqlite3_column_int(stmt, 2) != 0,
+                                     string((const char*)sqlite3_column_blob(stmt, 3), sqlite3_column_bytes(stmt, 3))});
+        sqlResult = SQLITE_OK;
+    }
+    sqlite3_reset(stmt);
+
+    if (sqlResult != SQLITE_DONE)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to get alerts from database: " << dbfile << err;
+        assert(!"Unable to get alerts from database.");
+        return false;
+    }
+
+    return true;
+}
+
+int64_t SqliteAccountState::countalerts(bool unseenOnly)
+{
+    if (!db)
+    {
+        return -1;
+    }
+
+    int64_t count = -1;
+    sqlite3_stmt* stmt = nullptr;
+    if (prepare(unseenOnly ? "SELECT COUNT(*) FROM alerts WHERE seen = 0" : "SELECT COUNT(*) FROM alerts", stmt) == SQLITE_OK
+            && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        count = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_reset(stmt);
+
+    return count;
+}
+
+bool SqliteAccountState::delalert(uint32_t id)
+{
+    return execalerts("DELETE FROM alerts WHERE id = ?", id);
+}
+
+bool SqliteAccountState::seealerts()
+{
+    return execalerts("UPDATE alerts SET seen = 1 WHERE seen = 0", 0);
+}
+
+bool SqliteAccountState::trimalerts(uint64_t keep)
+{
+    return execalerts("DELETE FROM alerts WHERE id IN (SELECT id FROM alerts ORDER BY ts DESC, id DESC LIMIT -1 OFFSET ?)",
+                      int64_t(std::min<uint64_t>(keep, INT64_MAX)));
+}
+
+bool SqliteAccountState::execalerts(const std::string& sql, int64_t value)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    checkTransaction();
+
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare(sql, stmt);
+    if (sqlResult == SQLITE_OK && sqlite3_bind_parameter_count(stmt))
+    {
+        sqlResult = sqlite3_bind_int64(stmt, 1, value);
+    }
+    if (sqlResult == SQLITE_OK)
+    {
+        sqlResult = sqlite3_step(stmt);
+    }
+    sqlite3_reset(stmt);
+
+    if (sqlResult != SQLITE_DONE)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to update alerts in database: " << dbfile << err;
+        assert(!"Unable to update alerts in database.");
+        return false;
+    }
+
+    return true;
+}
+
 void SqliteAccountState::finalise()
 {
-    sqlite3_finalize(mStmtPutNode);
-    mStmtPutNode = nullptr;
-    
-    sqlite3_finalize(mStmtUpdateNode);
-    mStmtUpdateNode = nullptr;
+    closeReaders();
+
+    for (auto& it : mStatements)
+    {
+        sqlite3_finalize(it.second);
+    }
+    mStatements.clear();
+}
+
+bool SqliteAccountState::put(Node *node)
+{
+    if (!db)
+    {
+        return false;
+    }
 
-    sqlite3_finalize(mStmtUpdateNodeAndFlags);
-    mStmtUpdateNodeAndFlags = nullptr;
- 
-    sqlite3_finalize(mStmtTypeAndSizeNode);
-    mStmtTypeAndSizeNode = nullptr;
+    string nodeSerialized;
+    serializeNode(node, &nodeSerialized);
 
-    sqlite3_finalize(mStmtGetNode);
-    mStmtGetNode = nullptr;
+    return putSerialized(node, nodeSerialized);
+}
+
+bool SqliteAccountState::put(const std::vector<Node*>& nodes, const std::vector<std::string>& serializedNodes)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    assert(nodes.size() == serializedNodes.size());
+
+    bool result = true;
+    for (size_t i = 0; i < nodes.size() && i < serializedNodes.size(); i++)
+    {
+        result = putSerialized(nodes[i], serializedNodes[i]) && result;
+    }
+
+    return result;
+}
+
+bool SqliteAccountState::putSerialized(Node* node, const std::string& nodeSerialized)
+{
+    checkTransaction();
+    ++mNodesWrites;
+
+    // not stored yet: descendants stored before it have its segment alone as prefix
+    std::string oldPath;
+    if (!getPath(NodeHandle().set6byte(node->nodehandle), oldPath))
+    {
+        oldPath = pathSegment(node->nodehandle);
+    }
+
+    std::string path;
+    if (node->parenthandle != UNDEF && !getPath(NodeHandle().set6byte(node->parenthandle), path))
+    {
+        path = pathSegment(node->parenthandle);
+    }
+    path.append(pathSegment(node->nodehandle));
+
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare("INSERT OR REPLACE INTO nodes (nodehandle, parenthandle, "
+                            "name, fingerprint, origFingerprint, type, size, share, fav, mimetype, ctime, flags, counter, node, path, namekey) "
+                            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)", stmt);
+
+    if (sqlResult == SQLITE_OK)
+    {
+        assert(nodeSerialized.size());
+
+        sqlite3_bind_int64(stmt, 1, node->nodehandle);
+        sqlite3_bind_int64(stmt, 2, node->parenthandle);
+
+        std::string name = node->displayname();
+        sqlite3_bind_text(stmt, 3, name.c_str(), static_cast<int>(name.length()), SQLITE_STATIC);
+
+        string fp;
+        node->FileFingerprint::serialize(&fp);
+        sqlite3_bind_blob(stmt, 4, fp.data(), static_cast<int>(fp.size()), SQLITE_STATIC);
+
+        std::string origFingerprint;
+        attr_map::const_iterator attrIt = node->attrs.map.find(MAKENAMEID2('c', '0'));
+        if (attrIt != node->attrs.map.end())
+        {
+           origFingerprint = attrIt->second;
+        }
+        sqlite3_bind_blob(stmt, 5, origFingerprint.data(), static_cast<int>(origFingerprint.size()), SQLITE_STATIC);
 
-    sqlite3_finalize(mStmtChildren);
-    mStmtChildren = nullptr;
+        sqlite3_bind_int(stmt, 6, node->type);
+        sqlite3_bind_int64(stmt, 7, node->size);
 
-    sqlite3_finalize(mStmtChildrenFromType);
-    mStmtChildrenFromType = nullptr;
+        int shareType = node->getShareType();
+        sqlite3_bind_int(stmt, 8, shareType);
 
-    sqlite3_finalize(mStmtNumChildren);
-    mStmtNumChildren = nullptr;
+        // node->attrstring has value => node is encrypted
+        nameid favId = AttrMap::string2nameid("fav");
+        auto favIt = node->attrs.map.find(favId);
+        bool fav = (favIt != node->attrs.map.end() && favIt->second == "1"); // test 'fav' attr value (only "1" is valid)
+        sqlite3_bind_int(stmt, 9, fav);
+        sqlite3_bind_int(stmt, 10, node->getMimeType());
+        sqlite3_bind_int64(stmt, 11, node->ctime);
+        sqlite3_bind_int64(stmt, 12, node->getDBFlag());
+        std::string nodeCountersBlob = node->getCounter().serialize();
+        sqlite3_bind_blob(stmt, 13, nodeCountersBlob.data(), static_cast<int>(nodeCountersBlob.size()), SQLITE_STATIC);
+        sqlite3_bind_blob(stmt, 14, nodeSerialized.data(), static_cast<int>(nodeSerialized.size()), SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 15, path.c_str(), static_cast<int>(path.length()), SQLITE_STATIC);
+        std::string nameKey = naturalsortingKey(name);
+        sqlite3_bind_blob(stmt, 16, nameKey.data(), static_cast<int>(nameKey.size()), SQLITE_STATIC);
 
-    sqlite3_finalize(mStmtNodeByName);
-    mStmtNodeByName = nullptr;
+        sqlResult = sqlite3_step(stmt);
+    }
 
-    sqlite3_finalize(mStmtNodeByNameNoRecursive);
-    mStmtNodeByNameNoRecursive = nullptr;
+    if (sqlResult != SQLITE_DONE)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to put a node from database: " << dbfile << err;
+        assert(!"Unable to put a node from database.");
+    }
+
+    sqlite3_reset(stmt);
+
+    if (sqlResult == SQLITE_DONE && path != oldPath)
+    {
+        sqlResult = movePaths(oldPath, path);
+    }
 
-    sqlite3_finalize(mStmtInShareOutShareByName);
-    mStmtInShareOutShareByName = nullptr;
+    if (sqlResult == SQLITE_DONE && mNameIndex)
+    {
+        sqlResult = putName(node);
+    }
+
+    return sqlResult == SQLITE_DONE;
+}
+
+std::string SqliteAccountState::pathSegment(handle h)
+{
+    return Base64Str<MegaClient::NODEHANDLE>(h).chars;
+}
+
+bool SqliteAccountState::getPath(NodeHandle nodeHandle, std::string& path)
+{
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare("SELECT path FROM nodes WHERE nodehandle = ?", stmt);
+
+    bool found = false;
+    if (sqlResult == SQLITE_OK)
+    {
+        if ((sqlResult = sqlite3_bind_int64(stmt, 1, nodeHandle.as8byte())) == SQLITE_OK)
+        {
+            if ((sqlResult = sqlite3_step(stmt)) == SQLITE_ROW)
+            {
+                const unsigned char* data = sqlite3_column_text(stmt, 0);
+                int size = sqlite3_column_bytes(stmt, 0);
+                if (data && size)
+                {
+                    path.assign(reinterpret_cast<const char*>(data), size);
+                    found = true;
+                }
+            }
+        }
+    }
 
-    sqlite3_finalize(mStmtNodeByMimeType);
-    mStmtNodeByMimeType = nullptr;
+    if (sqlResult != SQLITE_ROW && sqlResult != SQLITE_DONE)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to get the path of a node from database: " << dbfile << err;
+        assert(!"Unable to get the path of a node from database.");
+    }
 
-    sqlite3_finalize(mStmtNodesByFp);
-    mStmtNodesByFp = nullptr;
+    sqlite3_reset(stmt);
 
-    sqlite3_finalize(mStmtNodeByFp);
-    mStmtNodeByFp = nullptr;
+    return found;
+}
 
-    sqlite3_finalize(mStmtNodeByOrigFp);
-    mStmtNodeByOrigFp = nullptr;
+int SqliteAccountState::movePaths(const std::string& oldPath, const std::string& newPath)
+{
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare("UPDATE nodes SET path = ? || substr(path, ?) WHERE path > ? AND path < ?", stmt);
 
-    sqlite3_finalize(mStmtChildNode);
-    mStmtChildNode = nullptr;
+    if (sqlResult == SQLITE_OK)
+    {
+        // segments are Base64, so every path that extends 'oldPath' sorts before oldPath + '~'
+        std::string upper = oldPath + '~';
+        sqlite3_bind_text(stmt, 1, newPath.c_str(), static_cast<int>(newPath.length()), SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(oldPath.length() + 1));
+        sqlite3_bind_text(stmt, 3, oldPath.c_str(), static_cast<int>(oldPath.length()), SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 4, upper.c_str(), static_cast<int>(upper.length()), SQLITE_STATIC);
 
-    sqlite3_finalize(mStmtIsAncestor);
-    mStmtIsAncestor = nullptr;
+        sqlResult = sqlite3_step(stmt);
+    }
 
-    sqlite3_finalize(mStmtNumChild);
-    mStmtNumChild = nullptr;
+    if (sqlResult != SQLITE_DONE)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to move the paths of a subtree in database: " << dbfile << err;
+        assert(!"Unable to move the paths of a subtree in database.");
+    }
 
-    sqlite3_finalize(mStmtRecents);
-    mStmtRecents = nullptr;
+    sqlite3_reset(stmt);
 
-    sqlite3_finalize(mStmtFavourites);
-    mStmtFavourites = nullptr;
+    return sqlResult;
 }
 
-bool SqliteAccountState::put(Node *node)
+bool SqliteAccountState::subtreePaths(NodeHandle ancestorHandle, std::string& lower, std::string& upper)
 {
-    if (!db)
+    if (!getPath(ancestorHandle, lower))
     {
         return false;
     }
 
-    checkTransaction();
+    upper = lower + '~';
+    return true;
+}
 
-    int sqlResult = SQLITE_OK;
-    if (!mStmtPutNode)
-    {
-        sqlResult = sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO nodes (nodehandle, parenthandle, "
-                                           "name, fingerprint, origFingerprint, type, size, share, fav, mimetype, ctime, flags, counter, node) "
-                                           "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)", -1, &mStmtPutNode, NULL);
-    }
+int SqliteAccountState::putName(Node* node)
+{
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare("INSERT OR REPLACE INTO nodesname (rowid, name) VALUES (?, ?)", stmt);
 
     if (sqlResult == SQLITE_OK)
     {
-        string nodeSerialized;
-        node->serialize(&nodeSerialized);
-        assert(nodeSerialized.size());
-
-        sqlite3_bind_int64(mStmtPutNode, 1, node->nodehandle);
-        sqlite3_bind_int64(mStmtPutNode, 2, node->parenthandle);
+        std::string name = Utils::toLowerUtf8(node->displayname());
+        sqlite3_bind_int64(stmt, 1, node->nodehandle);
+        sqlite3_bind_text(stmt, 2, name.c_str(), static_cast<int>(name.length()), SQLITE_STATIC);
 
-        std::string name = node->displayname();
-        sqlite3_bind_text(mStmtPutNode, 3, name.c_str(), static_cast<int>(name.length()), SQLITE_STATIC);
-
-        string fp;
-        node->FileFingerprint::serialize(&fp);
-        sqlite3_bind_blob(mStmtPutNode, 4, fp.data(), static_cast<int>(fp.size()), SQLITE_STATIC);
-
-        std::string origFingerprint;
-        attr_map::const_iterator attrIt = node->attrs.map.find(MAKENAMEID2('c', '0'));
-        if (attrIt != node->attrs.map.end())
-        {
-           origFingerprint = attrIt->second;
-        }
-        sqlite3_bind_blob(mStmtPutNode, 5, origFingerprint.data(), static_cast<int>(origFingerprint.size()), SQLITE_STATIC);
-
-        sqlite3_bind_int(mStmtPutNode, 6, node->type);
-        sqlite3_bind_int64(mStmtPutNode, 7, node->size);
-
-        int shareType = node->getShareType();
-        sqlite3_bind_int(mStmtPutNode, 8, shareType);
-
-        // node->attrstring has value => node is encrypted
-        nameid favId = AttrMap::string2nameid("fav");
-        auto favIt = node->attrs.map.find(favId);
-        bool fav = (favIt != node->attrs.map.end() && favIt->second == "1"); // test 'fav' attr value (only "1" is valid)
-        sqlite3_bind_int(mStmtPutNode, 9, fav);
-        sqlite3_bind_int(mStmtPutNode, 10, node->getMimeType());
-        sqlite3_bind_int64(mStmtPutNode, 11, node->ctime);
-        sqlite3_bind_int64(mStmtPutNode, 12, node->getDBFlag());
-        std::string nodeCountersBlob = node->getCounter().serialize();
-        sqlite3_bind_blob(mStmtPutNode, 13, nodeCountersBlob.data(), static_cast<int>(nodeCountersBlob.size()), SQLITE_STATIC);
-        sqlite3_bind_blob(mStmtPutNode, 14, nodeSerialized.data(), static_cast<int>(nodeSerialized.size()), SQLITE_STATIC);
-
-        sqlResult = sqlite3_step(mStmtPutNode);
+        sqlResult = sqlite3_step(stmt);
     }
 
     if (sqlResult != SQLITE_DONE)
     {
         string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
-        LOG_err << "Unable to put a node from database: " << dbfile << err;
-        assert(!"Unable to put a node from database.");
+        LOG_err << "Unable to put a node name from database: " << dbfile << err;
+        assert(!"Unable to put a node name from database.");
     }
 
-    sqlite3_reset(mStmtPutNode);
+    sqlite3_reset(stmt);
 
-    return sqlResult == SQLITE_DONE;
+    return sqlResult;
 }
 
 bool SqliteAccountState::getNode(NodeHandle nodehandle, NodeSerialized &nodeSerialized)
@@ -1018,23 +2352,20 @@ bool SqliteAccountState::getNode(NodeHandle nodehandle, NodeSerialized &nodeSeri
 
     nodeSerialized.mNode.clear();
 
-    int sqlResult = SQLITE_OK;
-    if (!mStmtGetNode)
-    {
-        sqlResult = sqlite3_prepare_v2(db, "SELECT counter, node FROM nodes  WHERE nodehandle = ?", -1, &mStmtGetNode, NULL);
-    }
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare("SELECT counter, node FROM nodes  WHERE nodehandle = ?", stmt);
 
     if (sqlResult == SQLITE_OK)
     {
-        if ((sqlResult = sqlite3_bind_int64(mStmtGetNode, 1, nodehandle.as8byte())) == SQLITE_OK)
+        if ((sqlResult = sqlite3_bind_int64(stmt, 1, nodehandle.as8byte())) == SQLITE_OK)
         {
-            if((sqlResult = sqlite3_step(mStmtGetNode)) == SQLITE_ROW)
+            if((sqlResult = sqlite3_step(stmt)) == SQLITE_ROW)
             {
-                const void* dataNodeCounter = sqlite3_column_blob(mStmtGetNode, 0);
-                int sizeNodeCounter = sqlite3_column_bytes(mStmtGetNode, 0);
+                const void* dataNodeCounter = sqlite3_column_blob(stmt, 0);
+                int sizeNodeCounter = sqlite3_column_bytes(stmt, 0);
 
-                const void* dataNodeSerialized = sqlite3_column_blob(mStmtGetNode, 1);
-                int sizeNodeSerialized = sqlite3_column_bytes(mStmtGetNode, 1);
+                const void* dataNodeSerialized = sqlite3_column_blob(stmt, 1);
+                int sizeNodeSerialized = sqlite3_column_bytes(stmt, 1);
 
                 if (dataNodeCounter && sizeNodeCounter && dataNodeSerialized && sizeNodeSerialized)
                 {
@@ -1053,7 +2384,7 @@ bool SqliteAccountState::getNode(NodeHandle nodehandle, NodeSerialized &nodeSeri
         assert(!"Unable to get a node from database.");
     }
 
-    sqlite3_reset(mStmtGetNode);
+    sqlite3_reset(stmt);
 
     return success;
 }
@@ -1066,18 +2397,15 @@ bool SqliteAccountState::getNodesByOrigFingerprint(const std::string &fingerprin
         return false;
     }
 
-    int sqlResult = SQLITE_OK;
-    if (!mStmtNodeByOrigFp)
-    {
-        sqlResult = sqlite3_prepare_v2(db, "SELECT nodehandle, counter, node FROM nodes WHERE origfingerprint = ?", -1, &mStmtNodeByOrigFp, NULL);
-    }
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare("SELECT nodehandle, counter, node FROM nodes WHERE origfingerprint = ?", stmt);
 
     bool result = false;    
     if (sqlResult == SQLITE_OK)
     {
-        if ((sqlResult = sqlite3_bind_blob(mStmtNodeByOrigFp, 1, fingerprint.data(), (int)fingerprint.size(), SQLITE_STATIC)) == SQLITE_OK)
+        if ((sqlResult = sqlite3_bind_blob(stmt, 1, fingerprint.data(), (int)fingerprint.size(), SQLITE_STATIC)) == SQLITE_OK)
         {
-            result = processSqlQueryNodes(mStmtNodeByOrigFp, nodes);
+            result = processSqlQueryNodes(stmt, nodes);
         }
     }
 
@@ -1088,7 +2416,7 @@ bool SqliteAccountState::getNodesByOrigFingerprint(const std::string &fingerprin
         assert(!"Unable to get nodes by origfingerprint from database.");
     }
 
-    sqlite3_reset(mStmtNodeByOrigFp);
+    sqlite3_reset(stmt);
 
     return result;
 }
@@ -1102,7 +2430,7 @@ bool SqliteAccountState::getRootNodes(std::vector<std::pair<NodeHandle, NodeSeri
 
     sqlite3_stmt *stmt = nullptr;
     bool result = false;
-    int sqlResult = sqlite3_prepare_v2(db, "SELECT nodehandle, counter, node FROM nodes WHERE type >= ? AND type <= ?", -1, &stmt, NULL);
+    int sqlResult = prepare("SELECT nodehandle, counter, node FROM nodes WHERE type >= ? AND type <= ?", stmt);
     if (sqlResult == SQLITE_OK)
     {
         if ((sqlResult = sqlite3_bind_int(stmt, 1, nodetype_t::ROOTNODE)) == SQLITE_OK)
@@ -1121,7 +2449,7 @@ bool SqliteAccountState::getRootNodes(std::vector<std::pair<NodeHandle, NodeSeri
         assert(!"Unable to get root nodes from database.");
     }
 
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
 
     return result;
 }
@@ -1135,7 +2463,7 @@ bool SqliteAccountState::getNodesWithSharesOrLink(std::vector<std::pair<NodeHand
 
     sqlite3_stmt *stmt = nullptr;
     bool result = false;
-    int sqlResult = sqlite3_prepare_v2(db, "SELECT nodehandle, counter, node FROM nodes WHERE share & ? != 0", -1, &stmt, NULL);
+    int sqlResult = prepare("SELECT nodehandle, counter, node FROM nodes WHERE share & ? != 0", stmt);
     if (sqlResult == SQLITE_OK)
     {
         if ((sqlResult = sqlite3_bind_int(stmt, 1, static_cast<int>(shareType))) == SQLITE_OK)
@@ -1151,7 +2479,7 @@ bool SqliteAccountState::getNodesWithSharesOrLink(std::vector<std::pair<NodeHand
         assert(!"Unable to get root nodes from database.");
     }
 
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
 
     return result;
 }
@@ -1168,25 +2496,22 @@ bool SqliteAccountState::getChildren(NodeHandle parentHandle, std::vector<std::p
         sqlite3_progress_handler(db, NUM_VIRTUAL_MACHINE_INSTRUCTIONS, SqliteAccountState::progressHandler, static_cast<void*>(&cancelFlag));
     }
 
-    int sqlResult = SQLITE_OK;
-    if (!mStmtChildren)
-    {
-        sqlResult = sqlite3_prepare_v2(db, "SELECT nodehandle, counter, node FROM nodes WHERE parenthandle = ?", -1, &mStmtChildren, NULL);
-    }
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare("SELECT nodehandle, counter, node FROM nodes WHERE parenthandle = ?", stmt);
 
     bool result = false;
     if (sqlResult == SQLITE_OK)
     {
-        if ((sqlResult = sqlite3_bind_int64(mStmtChildren, 1, parentHandle.as8byte())) == SQLITE_OK)
+        if ((sqlResult = sqlite3_bind_int64(stmt, 1, parentHandle.as8byte())) == SQLITE_OK)
         {
-            result = processSqlQueryNodes(mStmtChildren, children);
+            result = processSqlQueryNodes(stmt, children);
         }
     }
 
     // unregister the handler (no-op if not registered)
     sqlite3_progress_handler(db, -1, nullptr, nullptr);
 
-    sqlite3_reset(mStmtChildren);
+    sqlite3_reset(stmt);
 
     if (sqlResult != SQLITE_OK)
     {
@@ -1210,21 +2535,17 @@ bool SqliteAccountState::getChildrenFromType(NodeHandle parentHandle, nodetype_t
         sqlite3_progress_handler(db, NUM_VIRTUAL_MACHINE_INSTRUCTIONS, SqliteAccountState::progressHandler, static_cast<void*>(&cancelFlag));
     }
 
-    int sqlResult = SQLITE_OK;
-
-    if (!mStmtChildrenFromType)
-    {
-        sqlResult = sqlite3_prepare_v2(db, "SELECT nodehandle, counter, node FROM nodes WHERE parenthandle = ? AND type = ?", -1, &mStmtChildrenFromType, NULL);
-    }
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare("SELECT nodehandle, counter, node FROM nodes WHERE parenthandle = ? AND type = ?", stmt);
 
     bool result = false;
     if (sqlResult == SQLITE_OK)
     {
-        if ((sqlResult = sqlite3_bind_int64(mStmtChildrenFromType, 1, parentHandle.as8byte())) == SQLITE_OK)
+        if ((sqlResult = sqlite3_bind_int64(stmt, 1, parentHandle.as8byte())) == SQLITE_OK)
         {
-            if ((sqlResult = sqlite3_bind_int(mStmtChildrenFromType, 2, nodeType)) == SQLITE_OK)
+            if ((sqlResult = sqlite3_bind_int(stmt, 2, nodeType)) == SQLITE_OK)
             {
-                result = processSqlQueryNodes(mStmtChildrenFromType, children);
+                result = processSqlQueryNodes(stmt, children);
             }
         }
     }
@@ -1232,7 +2553,7 @@ bool SqliteAccountState::getChildrenFromType(NodeHandle parentHandle, nodetype_t
     // unregister the handler (no-op if not registered)
     sqlite3_progress_handler(db, -1, nullptr, nullptr);
 
-    sqlite3_reset(mStmtChildrenFromType);
+    sqlite3_reset(stmt);
 
     if (sqlResult != SQLITE_OK)
     {
@@ -1244,32 +2565,100 @@ bool SqliteAccountState::getChildrenFromType(NodeHandle parentHandle, nodetype_t
     return result;
 }
 
-uint64_t SqliteAccountState::getNumberOfChildren(NodeHandle parentHandle)
+bool SqliteAccountState::getChildrenPage(NodeHandle parentHandle, ChildrenOrder order, uint64_t offset, uint64_t limit, std::vector<std::pair<NodeHandle, NodeSerialized>>& children, CancelToken cancelFlag)
 {
     if (!db)
     {
         return false;
     }
 
-    uint64_t numChildren = 0;
-    int sqlResult = SQLITE_OK;
-    if (!mStmtNumChildren)
+    if (cancelFlag.exists())
+    {
+        sqlite3_progress_handler(db, NUM_VIRTUAL_MACHINE_INSTRUCTIONS, SqliteAccountState::progressHandler, static_cast<void*>(&cancelFlag));
+    }
+
+    // folders first, as the listings' comparators do, and the handle last so the order is total
+    // and consecutive pages neither overlap nor skip nodes
+    auto orderBy = [order](const std::string& t)
+    {
+        std::string keys;
+        switch (order)
+        {
+            case ChildrenOrder::NAME_ASC:
+                keys = t + "namekey ASC";
+                break;
+            case ChildrenOrder::NAME_DESC:
+                keys = t + "namekey DESC";
+                break;
+            case ChildrenOrder::CTIME_ASC:
+                keys = t + "ctime ASC, " + t + "namekey ASC";
+                break;
+            case ChildrenOrder::CTIME_DESC:
+                keys = t + "ctime DESC, " + t + "namekey DESC";
+                break;
+        }
+        return " ORDER BY " + t + "type DESC, " + keys + ", " + t + "nodehandle";
+    };
+
+    // the page is sorted and sliced without reading the node blobs, which are only fetched for it
+    std::string sqlQuery = "SELECT n.nodehandle, n.counter, n.node FROM "
+                           "(SELECT nodehandle, type, namekey, ctime FROM nodes WHERE parenthandle = ?" + orderBy("") + " LIMIT ? OFFSET ?) AS page "
+                           "INNER JOIN nodes n ON n.nodehandle = page.nodehandle" + orderBy("page.");
+
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare(sqlQuery, stmt);
+
+    bool result = false;
+    if (sqlResult == SQLITE_OK)
+    {
+        // a negative LIMIT means no limit
+        sqlite3_int64 maxRows = limit > static_cast<uint64_t>(INT64_MAX) ? -1 : static_cast<sqlite3_int64>(limit);
+        if ((sqlResult = sqlite3_bind_int64(stmt, 1, parentHandle.as8byte())) == SQLITE_OK
+                && (sqlResult = sqlite3_bind_int64(stmt, 2, maxRows)) == SQLITE_OK
+                && (sqlResult = sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(offset))) == SQLITE_OK)
+        {
+            result = processSqlQueryNodes(stmt, children);
+        }
+    }
+
+    // unregister the handler (no-op if not registered)
+    sqlite3_progress_handler(db, -1, nullptr, nullptr);
+
+    sqlite3_reset(stmt);
+
+    if (sqlResult != SQLITE_OK)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to get a page of children from database: " << dbfile << err;
+        assert(!"Unable to get a page of children from database.");
+    }
+
+    return result;
+}
+
+uint64_t SqliteAccountState::getNumberOfChildren(NodeHandle parentHandle)
+{
+    if (!db)
     {
-        sqlResult = sqlite3_prepare_v2(db, "SELECT count(*) FROM nodes WHERE parenthandle = ?", -1, &mStmtNumChildren, NULL);
+        return false;
     }
 
+    uint64_t numChildren = 0;
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare("SELECT count(*) FROM nodes WHERE parenthandle = ?", stmt);
+
     if (sqlResult == SQLITE_OK)
     {
-        if ((sqlResult = sqlite3_bind_int64(mStmtNumChildren, 1, parentHandle.as8byte())) == SQLITE_OK)
+        if ((sqlResult = sqlite3_bind_int64(stmt, 1, parentHandle.as8byte())) == SQLITE_OK)
         {
-            if ((sqlResult = sqlite3_step(mStmtNumChildren)) == SQLITE_ROW)
+            if ((sqlResult = sqlite3_step(stmt)) == SQLITE_ROW)
             {
-               numChildren = sqlite3_column_int64(mStmtNumChildren, 0);
+               numChildren = sqlite3_column_int64(stmt, 0);
             }
         }
     }
 
-    sqlite3_reset(mStmtNumChildren);
+    sqlite3_reset(stmt);
 
     if (sqlResult != SQLITE_DONE && sqlResult != SQLITE_ROW)
     {
@@ -1281,7 +2670,18 @@ uint64_t SqliteAccountState::getNumberOfChildren(NodeHandle parentHandle)
     return numChildren;
 }
 
-bool SqliteAccountState::searchForNodesByName(const std::string &name, std::vector<std::pair<NodeHandle, NodeSerialized>> &nodes, CancelToken cancelFlag)
+std::string SqliteAccountState::nameMatch() const
+{
+    return mNameIndex ? "n1.nodehandle IN (SELECT rowid FROM nodesname WHERE name GLOB ?)"
+                      : "LOWER(n1.name) GLOB LOWER(?)";
+}
+
+std::string SqliteAccountState::namePattern(const std::string& name) const
+{
+    return "*" + (mNameIndex ? Utils::toLowerUtf8(name) : name) + "*";
+}
+
+bool SqliteAccountState::searchForNodesByName(const std::string &name, std::vector<std::pair<NodeHandle, NodeSerialized>> &nodes, NodeHandle ancestorHandle, CancelToken cancelFlag)
 {
     if (!db)
     {
@@ -1290,34 +2690,44 @@ bool SqliteAccountState::searchForNodesByName(const std::string &name, std::vect
 
     assert(name != "");
 
+    bool inSubtree = !ancestorHandle.isUndef();
+    std::string lowerPath, upperPath;
+    if (inSubtree && !subtreePaths(ancestorHandle, lowerPath, upperPath))
+    {
+        return true;    // nothing below a node that isn't stored
+    }
+
     if (cancelFlag.exists())
     {
         sqlite3_progress_handler(db, NUM_VIRTUAL_MACHINE_INSTRUCTIONS, SqliteAccountState::progressHandler, static_cast<void*>(&cancelFlag));
     }
 
-    int sqlResult = SQLITE_OK;
-    if (!mStmtNodeByName)
-    {
-        uint64_t excludeFlags = (1 << Node::FLAGS_IS_VERSION);
-        std::string sqlQuery = "SELECT n1.nodehandle, n1.counter, n1.node "
-                               "FROM nodes n1 "
-                               "WHERE n1.flags & " + std::to_string(excludeFlags) + " = 0 AND LOWER(n1.name) GLOB LOWER(?)";
-        // Leading and trailing '*' will be added to argument '?' so we are looking for a substring of name
-        // GLOB is case sensitive
-        //
-        // If we want to add support to names in UTF-8, a new
-        // test should be added, in example to search for 'ñam' when there is a node called 'Ñam'
+    uint64_t excludeFlags = (1 << Node::FLAGS_IS_VERSION);
+    std::string sqlQuery = "SELECT n1.nodehandle, n1.counter, n1.node "
+                           "FROM nodes n1 "
+                           "WHERE n1.flags & " + std::to_string(excludeFlags) + " = 0 AND " + nameMatch();
+    // Leading and trailing '*' will be added to argument '?' so we are looking for a substring of name
+    // GLOB is case sensitive: without the index, LOWER() only folds ASCII. With it, names and
+    // the pattern are folded by Utils::toLowerUtf8(), so a search for 'ñam' finds 'Ñam'
 
-        sqlResult = sqlite3_prepare_v2(db, sqlQuery.c_str(), -1, &mStmtNodeByName, NULL);
+    if (inSubtree)
+    {
+        sqlQuery.append(" AND n1.path > ? AND n1.path < ?");
     }
 
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare(sqlQuery, stmt);
+
     bool result = false;
     if (sqlResult == SQLITE_OK)
     {
-        string wildCardName = "*" + name + "*";
-        if ((sqlResult = sqlite3_bind_text(mStmtNodeByName, 1, wildCardName.c_str(), static_cast<int>(wildCardName.length()), SQLITE_STATIC)) == SQLITE_OK)
+        string wildCardName = namePattern(name);
+        if ((sqlResult = sqlite3_bind_text(stmt, 1, wildCardName.c_str(), static_cast<int>(wildCardName.length()), SQLITE_STATIC)) == SQLITE_OK
+                && (!inSubtree
+                    || ((sqlResult = sqlite3_bind_text(stmt, 2, lowerPath.c_str(), static_cast<int>(lowerPath.length()), SQLITE_STATIC)) == SQLITE_OK
+                        && (sqlResult = sqlite3_bind_text(stmt, 3, upperPath.c_str(), static_cast<int>(upperPath.length()), SQLITE_STATIC)) == SQLITE_OK)))
         {
-            result = processSqlQueryNodes(mStmtNodeByName, nodes);
+            result = processSqlQueryNodes(stmt, nodes);
         }
     }
 
@@ -1331,7 +2741,7 @@ bool SqliteAccountState::searchForNodesByName(const std::string &name, std::vect
         assert(!"Unable to get nodes by name from database.");
     }
 
-    sqlite3_reset(mStmtNodeByName);
+    sqlite3_reset(stmt);
 
     return result;
 }
@@ -1350,30 +2760,25 @@ bool SqliteAccountState::searchForNodesByNameNoRecursive(const std::string& name
         sqlite3_progress_handler(db, NUM_VIRTUAL_MACHINE_INSTRUCTIONS, SqliteAccountState::progressHandler, static_cast<void*>(&cancelFlag));
     }
 
-    int sqlResult = SQLITE_OK;
-    if (!mStmtNodeByNameNoRecursive)
-    {
-        std::string sqlQuery = "SELECT n1.nodehandle, n1.counter, n1.node "
-                               "FROM nodes n1 "
-                               "WHERE n1.parenthandle = ? AND LOWER(n1.name) GLOB LOWER(?)";
-        // Leading and trailing '*' will be added to argument '?' so we are looking for a substring of name
-        // GLOB is case sensitive
-        //
-        // If we want to add support to names in UTF-8, a new
-        // test should be added, in example to search for 'ñam' when there is a node called 'Ñam'
+    std::string sqlQuery = "SELECT n1.nodehandle, n1.counter, n1.node "
+                           "FROM nodes n1 "
+                           "WHERE n1.parenthandle = ? AND " + nameMatch();
+    // Leading and trailing '*' will be added to argument '?' so we are looking for a substring of name
+    // GLOB is case sensitive: without the index, LOWER() only folds ASCII. With it, names and
+    // the pattern are folded by Utils::toLowerUtf8(), so a search for 'ñam' finds 'Ñam'
 
-        sqlResult = sqlite3_prepare_v2(db, sqlQuery.c_str(), -1, &mStmtNodeByNameNoRecursive, NULL);
-    }
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare(sqlQuery, stmt);
 
     bool result = false;
     if (sqlResult == SQLITE_OK)
     {
-        if ((sqlResult = sqlite3_bind_int64(mStmtNodeByNameNoRecursive, 1, parentHandle.as8byte())) == SQLITE_OK)
+        if ((sqlResult = sqlite3_bind_int64(stmt, 1, parentHandle.as8byte())) == SQLITE_OK)
         {
-            string wildCardName = "*" + name + "*";
-            if ((sqlResult = sqlite3_bind_text(mStmtNodeByNameNoRecursive, 2, wildCardName.c_str(), static_cast<int>(wildCardName.length()), SQLITE_STATIC)) == SQLITE_OK)
+            string wildCardName = namePattern(name);
+            if ((sqlResult = sqlite3_bind_text(stmt, 2, wildCardName.c_str(), static_cast<int>(wildCardName.length()), SQLITE_STATIC)) == SQLITE_OK)
             {
-                result = processSqlQueryNodes(mStmtNodeByNameNoRecursive, nodes);
+                result = processSqlQueryNodes(stmt, nodes);
             }
         }
     }
@@ -1388,7 +2793,7 @@ bool SqliteAccountState::searchForNodesByNameNoRecursive(const std::string& name
         assert(!"Unable to get nodes by name from database without recursion.");
     }
 
-    sqlite3_reset(mStmtNodeByNameNoRecursive);
+    sqlite3_reset(stmt);
 
     return result;
 }
@@ -1407,30 +2812,25 @@ bool SqliteAccountState::searchInShareOrOutShareByName(const std::string& name,
         sqlite3_progress_handler(db, NUM_VIRTUAL_MACHINE_INSTRUCTIONS, SqliteAccountState::progressHandler, static_cast<void*>(&cancelFlag));
     }
 
-    int sqlResult = SQLITE_OK;
-    if (!mStmtInShareOutShareByName)
-    {
-        std::string sqlQuery = "SELECT n1.nodehandle, n1.counter, n1.node "
-                               "FROM nodes n1 "
-                               "WHERE n1.share = ? AND LOWER(n1.name) GLOB LOWER(?)";
-        // Leading and trailing '*' will be added to argument '?' so we are looking for a substring of name
-        // GLOB is case sensitive
-        //
-        // If we want to add support to names in UTF-8, a new
-        // test should be added, in example to search for 'ñam' when there is a node called 'Ñam'
+    std::string sqlQuery = "SELECT n1.nodehandle, n1.counter, n1.node "
+                           "FROM nodes n1 "
+                           "WHERE n1.share = ? AND " + nameMatch();
+    // Leading and trailing '*' will be added to argument '?' so we are looking for a substring of name
+    // GLOB is case sensitive: without the index, LOWER() only folds ASCII. With it, names and
+    // the pattern are folded by Utils::toLowerUtf8(), so a search for 'ñam' finds 'Ñam'
 
-        sqlResult = sqlite3_prepare_v2(db, sqlQuery.c_str(), -1, &mStmtInShareOutShareByName, NULL);
-    }
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare(sqlQuery, stmt);
 
     bool result = false;
     if (sqlResult == SQLITE_OK)
     {
-        if ((sqlResult = sqlite3_bind_int(mStmtInShareOutShareByName, 1, static_cast<int>(shareType))) == SQLITE_OK)
+        if ((sqlResult = sqlite3_bind_int(stmt, 1, static_cast<int>(shareType))) == SQLITE_OK)
         {
-            string wildCardName = "*" + name + "*";
-            if ((sqlResult = sqlite3_bind_text(mStmtInShareOutShareByName, 2, wildCardName.c_str(), static_cast<int>(wildCardName.length()), SQLITE_STATIC)) == SQLITE_OK)
+            string wildCardName = namePattern(name);
+            if ((sqlResult = sqlite3_bind_text(stmt, 2, wildCardName.c_str(), static_cast<int>(wildCardName.length()), SQLITE_STATIC)) == SQLITE_OK)
             {
-                result = processSqlQueryNodes(mStmtInShareOutShareByName, nodes);
+                result = processSqlQueryNodes(stmt, nodes);
             }
         }
     }
@@ -1445,7 +2845,7 @@ bool SqliteAccountState::searchInShareOrOutShareByName(const std::string& name,
         assert(!"Unable to get in-shares/out-shares by name from database: ");
     }
 
-    sqlite3_reset(mStmtInShareOutShareByName);
+    sqlite3_reset(stmt);
 
     return result;
 }
@@ -1457,18 +2857,15 @@ bool SqliteAccountState::getNodesByFingerprint(const std::string &fingerprint, s
         return false;
     }
 
-    int sqlResult = SQLITE_OK;
-    if (!mStmtNodesByFp)
-    {
-        sqlResult = sqlite3_prepare_v2(db, "SELECT nodehandle, counter, node FROM nodes WHERE fingerprint = ?", -1, &mStmtNodesByFp, NULL);
-    }
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare("SELECT nodehandle, counter, node FROM nodes WHERE fingerprint = ?", stmt);
 
     bool result = false;
     if (sqlResult == SQLITE_OK)
     {
-        if ((sqlResult = sqlite3_bind_blob(mStmtNodesByFp, 1, fingerprint.data(), (int)fingerprint.size(), SQLITE_STATIC)) == SQLITE_OK)
+        if ((sqlResult = sqlite3_bind_blob(stmt, 1, fingerprint.data(), (int)fingerprint.size(), SQLITE_STATIC)) == SQLITE_OK)
         {
-            result = processSqlQueryNodes(mStmtNodesByFp, nodes);
+            result = processSqlQueryNodes(stmt, nodes);
         }
     }
 
@@ -1479,7 +2876,7 @@ bool SqliteAccountState::getNodesByFingerprint(const std::string &fingerprint, s
         assert(!"Unable to get nodes by fingerprint from database.");
     }
 
-    sqlite3_reset(mStmtNodesByFp);
+    sqlite3_reset(stmt);
 
     return result;
 
@@ -1492,19 +2889,16 @@ bool SqliteAccountState::getNodeByFingerprint(const std::string &fingerprint, me
         return false;
     }
 
-    int sqlResult = SQLITE_OK;
-    if (!mStmtNodeByFp)
-    {
-        sqlResult = sqlite3_prepare_v2(db, "SELECT nodehandle, counter, node FROM nodes WHERE fingerprint = ? LIMIT 1", -1, &mStmtNodeByFp, NULL);
-    }
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare("SELECT nodehandle, counter, node FROM nodes WHERE fingerprint = ? LIMIT 1", stmt);
 
     bool result = false;
     if (sqlResult == SQLITE_OK)
     {
-        if ((sqlResult = sqlite3_bind_blob(mStmtNodeByFp, 1, fingerprint.data(), (int)fingerprint.size(), SQLITE_STATIC)) == SQLITE_OK)
+        if ((sqlResult = sqlite3_bind_blob(stmt, 1, fingerprint.data(), (int)fingerprint.size(), SQLITE_STATIC)) == SQLITE_OK)
         {
             std::vector<std::pair<NodeHandle, NodeSerialized>> nodes;
-            result = processSqlQueryNodes(mStmtNodeByFp, nodes);
+            result = processSqlQueryNodes(stmt, nodes);
             if (nodes.size())
             {
                 node = nodes.begin()->second;
@@ -1519,7 +2913,90 @@ bool SqliteAccountState::getNodeByFingerprint(const std::string &fingerprint, me
         assert(!"Unable to get nodes by fingerprint from database.");
     }
 
-    sqlite3_reset(mStmtNodeByFp);
+    sqlite3_reset(stmt);
+
+    return result;
+}
+
+bool SqliteAccountState::getNodesByFingerprints(const std::vector<std::string>& fingerprints, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    // stay well below SQLITE_MAX_VARIABLE_NUMBER (999 on older builds)
+    static const size_t MAX_FINGERPRINTS_PER_QUERY = 500;
+
+    bool result = true;
+    for (size_t first = 0; first < fingerprints.size() && result; first += MAX_FINGERPRINTS_PER_QUERY)
+    {
+        size_t count = std::min(MAX_FINGERPRINTS_PER_QUERY, fingerprints.size() - first);
+
+        std::string sql = "SELECT nodehandle, counter, node FROM nodes WHERE fingerprint IN (?";
+        for (size_t i = 1; i < count; i++)
+        {
+            sql += ",?";
+        }
+        sql += ")";
+
+        sqlite3_stmt *stmt = nullptr;
+        int sqlResult = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL);
+        for (size_t i = 0; i < count && sqlResult == SQLITE_OK; i++)
+        {
+            const std::string& fp = fingerprints[first + i];
+            sqlResult = sqlite3_bind_blob(stmt, int(i + 1), fp.data(), (int)fp.size(), SQLITE_STATIC);
+        }
+
+        if (sqlResult == SQLITE_OK)
+        {
+            result = processSqlQueryNodes(stmt, nodes);
+        }
+        else
+        {
+            string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+            LOG_err << "Unable to get nodes by fingerprints from database: " << dbfile << err;
+            assert(!"Unable to get nodes by fingerprints from database.");
+            result = false;
+        }
+
+        sqlite3_finalize(stmt);
+    }
+
+    return result;
+}
+
+bool SqliteAccountState::getAllFingerprints(std::function<void(const std::string&)> fingerprintCallback)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    // answered from 'fingerprintindex' when it exists, without reading the nodes
+    sqlite3_stmt *stmt = nullptr;
+    int sqlResult = prepare("SELECT DISTINCT fingerprint FROM nodes", stmt);
+    if (sqlResult == SQLITE_OK)
+    {
+        std::string fingerprint;
+        while ((sqlResult = sqlite3_step(stmt)) == SQLITE_ROW)
+        {
+            const char* data = static_cast<const char*>(sqlite3_column_blob(stmt, 0));
+            int size = sqlite3_column_bytes(stmt, 0);
+            fingerprint.assign(data ? data : "", data ? static_cast<size_t>(size) : 0);
+            fingerprintCallback(fingerprint);
+        }
+    }
+
+    bool result = sqlResult == SQLITE_DONE;
+    if (!result)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to get fingerprints from database: " << dbfile << err;
+        assert(!"Unable to get fingerprints from database.");
+    }
+
+    sqlite3_reset(stmt);
 
     return result;
 }
@@ -1531,6 +3008,7 @@ bool SqliteAccountState::getRecentNodes(unsigned maxcount, m_time_t since, std::
         return false;
     }
     
+    // the WHERE matches the one of recentsindex (see createIndexes()), so the newest are read off it
     const std::string filenode = std::to_string(FILENODE);
     uint64_t excludeFlags = (1 << Node::FLAGS_IS_VERSION | 1 << Node::FLAGS_IS_IN_RUBBISH);
     std::string sqlQuery =  "SELECT n1.nodehandle, n1.counter, n1.node "
@@ -1538,22 +3016,19 @@ bool SqliteAccountState::getRecentNodes(unsigned maxcount, m_time_t since, std::
                             "WHERE n1.flags & " + std::to_string(excludeFlags) + " = 0 AND n1.ctime >= ? AND n1.type = " + filenode + " "
                             "ORDER BY n1.ctime DESC LIMIT ?";
 
-    int sqlResult = SQLITE_OK;
-    if (!mStmtRecents)
-    {
-        sqlResult = sqlite3_prepare_v2(db, sqlQuery.c_str(), -1, &mStmtRecents, NULL);
-    }
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare(sqlQuery, stmt);
 
     bool stepResult = false;
     if (sqlResult == SQLITE_OK)
     {
-        if (sqlResult == sqlite3_bind_int64(mStmtRecents, 1, since))
+        if (sqlResult == sqlite3_bind_int64(stmt, 1, since))
         {
             // LIMIT expression evaluates to a negative value, then there is no upper bound on the number of rows returned
             int64_t nodeCount = (maxcount > 0) ? static_cast<int64_t>(maxcount) : -1;
-            if (sqlResult == sqlite3_bind_int64(mStmtRecents, 2, nodeCount))
+            if (sqlResult == sqlite3_bind_int64(stmt, 2, nodeCount))
             {
-                stepResult = processSqlQueryNodes(mStmtRecents, nodes);
+                stepResult = processSqlQueryNodes(stmt, nodes);
             }
         }
     }
@@ -1564,7 +3039,7 @@ bool SqliteAccountState::getRecentNodes(unsigned maxcount, m_time_t since, std::
         LOG_err << "Unable to get recent nodes from database: " << dbfile << err;
     }
 
-    sqlite3_reset(mStmtRecents);
+    sqlite3_reset(stmt);
 
     return stepResult;
 }
@@ -1576,26 +3051,23 @@ bool SqliteAccountState::getFavouritesHandles(NodeHandle node, uint32_t count, s
         return false;
     }
 
-    int sqlResult = SQLITE_OK;
-    if (!mStmtFavourites)
-    {
-        // exclude previous versions <- P.type != FILENODE
-        //   this is 1.6x faster than using the flags
-        std::string sqlQuery =  "WITH nodesCTE(nodehandle, parenthandle, fav, type) AS (SELECT nodehandle, parenthandle, fav, type "
-                                "FROM nodes WHERE parenthandle = ? UNION ALL SELECT N.nodehandle, N.parenthandle, N.fav, N.type "
-                                "FROM nodes AS N INNER JOIN nodesCTE AS P ON (N.parenthandle = P.nodehandle AND P.type != " + std::to_string(FILENODE) + ")) SELECT node.nodehandle "
-                                "FROM nodesCTE AS node WHERE node.fav = 1";
+    // exclude previous versions <- P.type != FILENODE
+    //   this is 1.6x faster than using the flags
+    std::string sqlQuery =  "WITH nodesCTE(nodehandle, parenthandle, fav, type) AS (SELECT nodehandle, parenthandle, fav, type "
+                            "FROM nodes WHERE parenthandle = ? UNION ALL SELECT N.nodehandle, N.parenthandle, N.fav, N.type "
+                            "FROM nodes AS N INNER JOIN nodesCTE AS P ON (N.parenthandle = P.nodehandle AND P.type != " + std::to_string(FILENODE) + ")) SELECT node.nodehandle "
+                            "FROM nodesCTE AS node WHERE node.fav = 1";
 
-        sqlResult = sqlite3_prepare_v2(db, sqlQuery.c_str(), -1, &mStmtFavourites, NULL);
-    }
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare(sqlQuery, stmt);
 
     if (sqlResult == SQLITE_OK)
     {
-        if ((sqlResult = sqlite3_bind_int64(mStmtFavourites, 1, node.as8byte())) == SQLITE_OK)
+        if ((sqlResult = sqlite3_bind_int64(stmt, 1, node.as8byte())) == SQLITE_OK)
         {
-            while ((sqlResult = sqlite3_step(mStmtFavourites)) == SQLITE_ROW && (nodes.size() < count || count == 0))
+            while ((sqlResult = sqlite3_step(stmt)) == SQLITE_ROW && (nodes.size() < count || count == 0))
             {
-                nodes.push_back(NodeHandle().set6byte(sqlite3_column_int64(mStmtFavourites, 0)));
+                nodes.push_back(NodeHandle().set6byte(sqlite3_column_int64(stmt, 0)));
             }
         }
     }
@@ -1607,7 +3079,7 @@ bool SqliteAccountState::getFavouritesHandles(NodeHandle node, uint32_t count, s
         assert(!"Unable to get favourites from database.");
     }
 
-    sqlite3_reset(mStmtFavourites);
+    sqlite3_reset(stmt);
 
     return sqlResult == SQLITE_DONE || sqlResult == SQLITE_ROW;
 }
@@ -1622,22 +3094,19 @@ bool SqliteAccountState::childNodeByNameType(NodeHandle parentHandle, const std:
 
     std::string sqlQuery = "SELECT nodehandle, counter, node FROM nodes WHERE parenthandle = ? AND name = ? AND type = ? limit 1";
 
-    int sqlResult = SQLITE_OK;
-    if (!mStmtChildNode)
-    {
-        sqlResult = sqlite3_prepare_v2(db, sqlQuery.c_str(), -1, &mStmtChildNode, NULL);
-    }
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare(sqlQuery, stmt);
 
     if (sqlResult == SQLITE_OK)
     {
-        if ((sqlResult = sqlite3_bind_int64(mStmtChildNode, 1, parentHandle.as8byte())) == SQLITE_OK)
+        if ((sqlResult = sqlite3_bind_int64(stmt, 1, parentHandle.as8byte())) == SQLITE_OK)
         {
-            if ((sqlResult = sqlite3_bind_text(mStmtChildNode, 2, name.c_str(), static_cast<int>(name.length()), SQLITE_STATIC)) == SQLITE_OK)
+            if ((sqlResult = sqlite3_bind_text(stmt, 2, name.c_str(), static_cast<int>(name.length()), SQLITE_STATIC)) == SQLITE_OK)
             {
-                if ((sqlResult = sqlite3_bind_int64(mStmtChildNode, 3, nodeType)) == SQLITE_OK)
+                if ((sqlResult = sqlite3_bind_int64(stmt, 3, nodeType)) == SQLITE_OK)
                 {
                     std::vector<std::pair<NodeHandle, NodeSerialized>> nodes;
-                    processSqlQueryNodes(mStmtChildNode, nodes);
+                    processSqlQueryNodes(stmt, nodes);
                     if (nodes.size())
                     {
                         node.first = nodes.begin()->first;
@@ -1656,7 +3125,7 @@ bool SqliteAccountState::childNodeByNameType(NodeHandle parentHandle, const std:
         assert(!"Unable to get node by name from database (Only search at first level).");
     }
 
-    sqlite3_reset(mStmtChildNode);
+    sqlite3_reset(stmt);
 
     return success;
 }
@@ -1668,21 +3137,18 @@ bool SqliteAccountState::getNodeSizeTypeAndFlags(NodeHandle node, m_off_t& size,
         return false;
     }
 
-    int sqlResult = SQLITE_OK;
-    if (!mStmtTypeAndSizeNode)
-    {
-        sqlResult = sqlite3_prepare_v2(db, "SELECT type, size, flags FROM nodes WHERE nodehandle = ?", -1, &mStmtTypeAndSizeNode, NULL);
-    }
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare("SELECT type, size, flags FROM nodes WHERE nodehandle = ?", stmt);
 
     if (sqlResult == SQLITE_OK)
     {
-        if ((sqlResult = sqlite3_bind_int64(mStmtTypeAndSizeNode, 1, node.as8byte())) == SQLITE_OK)
+        if ((sqlResult = sqlite3_bind_int64(stmt, 1, node.as8byte())) == SQLITE_OK)
         {
-            if ((sqlResult = sqlite3_step(mStmtTypeAndSizeNode)) == SQLITE_ROW)
+            if ((sqlResult = sqlite3_step(stmt)) == SQLITE_ROW)
             {
-               nodeType = (nodetype_t)sqlite3_column_int(mStmtTypeAndSizeNode, 0);
-               size = sqlite3_column_int64(mStmtTypeAndSizeNode, 1);
-               oldFlags = sqlite3_column_int64(mStmtTypeAndSizeNode, 2);
+               nodeType = (nodetype_t)sqlite3_column_int(stmt, 0);
+               size = sqlite3_column_int64(stmt, 1);
+               oldFlags = sqlite3_column_int64(stmt, 2);
             }
         }
     }
@@ -1694,69 +3160,70 @@ bool SqliteAccountState::getNodeSizeTypeAndFlags(NodeHandle node, m_off_t& size,
         assert(!"Unable to get node type and size from database.");
     }
 
-    sqlite3_reset(mStmtTypeAndSizeNode);
+    sqlite3_reset(stmt);
 
     return sqlResult == SQLITE_ROW;
 }
 
-bool SqliteAccountState::isAncestor(NodeHandle node, NodeHandle ancestor, CancelToken cancelFlag)
+bool SqliteAccountState::getNodeCounter(NodeHandle node, std::string& nodeCounterBlob)
 {
-    bool result = false;
     if (!db)
     {
-        return result;
+        return false;
     }
 
-    std::string sqlQuery = "WITH nodesCTE(nodehandle, parenthandle) "
-            "AS (SELECT nodehandle, parenthandle FROM nodes WHERE nodehandle = ? "
-            "UNION ALL SELECT A.nodehandle, A.parenthandle FROM nodes AS A INNER JOIN nodesCTE "
-            "AS E ON (A.nodehandle = E.parenthandle)) "
-            "SELECT * FROM nodesCTE WHERE parenthandle = ?";
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare("SELECT counter FROM nodes WHERE nodehandle = ?", stmt);
 
-    if (cancelFlag.exists())
+    if (sqlResult == SQLITE_OK)
     {
-        sqlite3_progress_handler(db, NUM_VIRTUAL_MACHINE_INSTRUCTIONS, SqliteAccountState::progressHandler, static_cast<void*>(&cancelFlag));
+        if ((sqlResult = sqlite3_bind_int64(stmt, 1, node.as8byte())) == SQLITE_OK)
+        {
+            if ((sqlResult = sqlite3_step(stmt)) == SQLITE_ROW)
+            {
+                const void* data = sqlite3_column_blob(stmt, 0);
+                int size = sqlite3_column_bytes(stmt, 0);
+                nodeCounterBlob.assign(static_cast<const char*>(data), data ? size_t(size) : 0u);
+            }
+        }
     }
 
-    int sqlResult = SQLITE_OK;
-    if (!mStmtIsAncestor)
+    if (sqlResult != SQLITE_ROW && sqlResult != SQLITE_DONE)
     {
-        sqlResult = sqlite3_prepare_v2(db, sqlQuery.c_str(), -1, &mStmtIsAncestor, NULL);
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to get node counter from database: " << dbfile << err;
+        assert(!"Unable to get node counter from database.");
     }
 
-    if (sqlResult == SQLITE_OK)
+    sqlite3_reset(stmt);
+
+    return sqlResult == SQLITE_ROW;
+}
+
+bool SqliteAccountState::isAncestor(NodeHandle node, NodeHandle ancestor, CancelToken)
+{
+    if (!db)
     {
-        if ((sqlResult = sqlite3_bind_int64(mStmtIsAncestor, 1, node.as8byte())) == SQLITE_OK)
-        {
-            if ((sqlResult = sqlite3_bind_int64(mStmtIsAncestor, 2, ancestor.as8byte())) == SQLITE_OK)
-            {
-                if ((sqlResult = sqlite3_step(mStmtIsAncestor)) == SQLITE_ROW)
-                {
-                    result = true;
-                }
-            }
-        }
+        return false;
     }
 
-    // unregister the handler (no-op if not registered)
-    sqlite3_progress_handler(db, -1, nullptr, nullptr);
+    std::string path;
+    if (!getPath(node, path))
+    {
+        return false;
+    }
 
-    if (sqlResult != SQLITE_ROW && sqlResult != SQLITE_DONE)
+    // any segment but the last one, which is the node's own
+    std::string segment = pathSegment(ancestor.as8byte());
+    for (size_t i = 0; i + segment.size() < path.size(); i += segment.size())
     {
-        if (sqlResult == SQLITE_INTERRUPT)
-        {
-            LOG_debug << "Unable to get `isAncestor`, running the query has been interrupted";
-        }
-        else
+        if (!path.compare(i, segment.size(), segment))
         {
-            string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
-            LOG_err << "Unable to get `isAncestor` from database: " << dbfile << err;
+            return true;
         }
     }
 
-    sqlite3_reset(mStmtIsAncestor);
-
-    return result;
+    return false;
 }
 
 uint64_t SqliteAccountState::getNumberOfNodes()
@@ -1768,7 +3235,7 @@ uint64_t SqliteAccountState::getNumberOfNodes()
     }
 
     sqlite3_stmt *stmt = nullptr;
-    int sqlResult = sqlite3_prepare_v2(db, "SELECT count(*) FROM nodes", -1, &stmt, NULL);
+    int sqlResult = prepare("SELECT count(*) FROM nodes", stmt);
     if (sqlResult == SQLITE_OK)
     {
         if ((sqlResult = sqlite3_step(stmt)) == SQLITE_ROW)
@@ -1784,7 +3251,7 @@ uint64_t SqliteAccountState::getNumberOfNodes()
         assert(!"Unable to get number of nodes from database.");
     }
 
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
 
     return count;
 }
@@ -1797,21 +3264,18 @@ uint64_t SqliteAccountState::getNumberOfChildrenByType(NodeHandle parentHandle,
         return count;
     }
 
-    int sqlResult = SQLITE_OK;
-    if (!mStmtNumChild)
-    {
-        sqlResult = sqlite3_prepare_v2(db, "SELECT count(*) FROM nodes where parenthandle = ? AND type = ?", -1, &mStmtNumChild, NULL);
-    }
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare("SELECT count(*) FROM nodes where parenthandle = ? AND type = ?", stmt);
 
     if (sqlResult == SQLITE_OK)
     {
-        if ((sqlResult = sqlite3_bind_int64(mStmtNumChild, 1, parentHandle.as8byte())) == SQLITE_OK)
+        if ((sqlResult = sqlite3_bind_int64(stmt, 1, parentHandle.as8byte())) == SQLITE_OK)
         {
-            if ((sqlResult = sqlite3_bind_int(mStmtNumChild, 2, nodeType)) == SQLITE_OK)
+            if ((sqlResult = sqlite3_bind_int(stmt, 2, nodeType)) == SQLITE_OK)
             {
-                if ((sqlResult = sqlite3_step(mStmtNumChild)) == SQLITE_ROW)
+                if ((sqlResult = sqlite3_step(stmt)) == SQLITE_ROW)
                 {
-                    count = sqlite3_column_int64(mStmtNumChild, 0);
+                    count = sqlite3_column_int64(stmt, 0);
                 }
             }
         }
@@ -1824,39 +3288,50 @@ uint64_t SqliteAccountState::getNumberOfChildrenByType(NodeHandle parentHandle,
         assert(!"Unable to get number of children of type from database.");
     }
 
-    sqlite3_reset(mStmtNumChild);
+    sqlite3_reset(stmt);
 
     return count;
 }
 
-bool SqliteAccountState::getNodesByMimetype(MimeType_t mimeType, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes, CancelToken cancelFlag)
+bool SqliteAccountState::getNodesByMimetype(MimeType_t mimeType, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodes, NodeHandle ancestorHandle, CancelToken cancelFlag)
 {
     if (!db)
     {
         return false;
     }
 
+    bool inSubtree = !ancestorHandle.isUndef();
+    std::string lowerPath, upperPath;
+    if (inSubtree && !subtreePaths(ancestorHandle, lowerPath, upperPath))
+    {
+        return true;    // nothing below a node that isn't stored
+    }
+
     if (cancelFlag.exists())
     {
         sqlite3_progress_handler(db, NUM_VIRTUAL_MACHINE_INSTRUCTIONS, SqliteAccountState::progressHandler, static_cast<void*>(&cancelFlag));
     }
 
-    bool result = false;
-    int sqlResult = SQLITE_OK;
-    if (!mStmtNodeByMimeType)
+    // exclude previous versions, as searchForNodesByName() does (and mimetypeindex, see createIndexes())
+    uint64_t excludeFlags = (1 << Node::FLAGS_IS_VERSION);
+    std::string query = "SELECT n1.nodehandle, n1.counter, n1.node FROM nodes n1 "
+                        "WHERE n1.mimetype = ? AND n1.flags & " + std::to_string(excludeFlags) + " = 0";
+    if (inSubtree)
     {
-        // exclude previous versions <- parent handle is of type != FILENODE
-        std::string query = "SELECT n1.nodehandle, n1.counter, n1.node FROM nodes n1 "
-                            "INNER JOIN nodes n2 on n2.nodehandle = n1.parenthandle where n1.mimetype = ? AND n2.type !=";
-        query.append(std::to_string(FILENODE));
-        sqlResult = sqlite3_prepare_v2(db, query.c_str(), -1, &mStmtNodeByMimeType, nullptr);
-
+        query.append(" AND n1.path > ? AND n1.path < ?");
     }
+
+    bool result = false;
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = prepare(query, stmt);
     if (sqlResult == SQLITE_OK)
     {
-        if ((sqlResult = sqlite3_bind_int(mStmtNodeByMimeType, 1, static_cast<int>(mimeType))) == SQLITE_OK)
+        if ((sqlResult = sqlite3_bind_int(stmt, 1, static_cast<int>(mimeType))) == SQLITE_OK
+                && (!inSubtree
+                    || ((sqlResult = sqlite3_bind_text(stmt, 2, lowerPath.c_str(), static_cast<int>(lowerPath.length()), SQLITE_STATIC)) == SQLITE_OK
+                        && (sqlResult = sqlite3_bind_text(stmt, 3, upperPath.c_str(), static_cast<int>(upperPath.length()), SQLITE_STATIC)) == SQLITE_OK)))
         {
-            result = processSqlQueryNodes(mStmtNodeByMimeType, nodes);
+            result = processSqlQueryNodes(stmt, nodes);
         }
     }
 
@@ -1870,7 +3345,7 @@ bool SqliteAccountState::getNodesByMimetype(MimeType_t mimeType, std::vector<std
         assert(!"Unable to get node by Mime type from database.");
     }
 
-    sqlite3_reset(mStmtNodeByMimeType);
+    sqlite3_reset(stmt);
 
     return result;
 }
@@ -406,12 +406,20 @@ void File::sendPutnodes(MegaClient* client, UploadHandle fileAttrMatchHandle, co
             }
         }
 
-        client->reqs.add(new CommandPutNodes(client,
-                                             th, NULL,
-                                             mVersioningOption,
-                                             move(newnodes),
-                                             tag,
-                                             source, nullptr, move(completion), canChangeVault));
+        if (!l && source == PUTNODES_APP)
+        {
+            // plain uploads finishing close together share a single putnodes
+            client->putnodesBatched(th, mVersioningOption, move(newnodes), tag, canChangeVault, move(completion));
+        }
+        else
+        {
+            client->reqs.add(new CommandPutNodes(client,
+                                                 th, NULL,
+                                                 mVersioningOption,
+                                                 move(newnodes),
+                                                 tag,
+                                                 source, nullptr, move(completion), canChangeVault));
+        }
     }
 }
 
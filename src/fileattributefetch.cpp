@@ -34,6 +34,7 @@ FileAttributeFetchChannel::FileAttributeFetchChannel(MegaClient* client)
     fahref = UNDEF;
     inbytes = 0;
     e = API_EINTERNAL;
+    nextseq = 0;
 }
 
 FileAttributeFetch::FileAttributeFetch(handle h, string key, fatype t, int ctag)
@@ -43,33 +44,32 @@ FileAttributeFetch::FileAttributeFetch(handle h, string key, fatype t, int ctag)
     type = t;
     retries = 0;
     tag = ctag;
+    seq = 0;
 }
 
 void FileAttributeFetchChannel::dispatch()
 {
-    faf_map::iterator it;
-
-    // reserve space
-    req.outbuf.clear();
-    req.outbuf.reserve((fafs[0].size() + fafs[1].size()) * sizeof(handle));
+    // move fresh to pending
+    for (faf_map::iterator it = fafs[0].begin(); it != fafs[0].end(); it++)
+    {
+        fafs[1][it->first] = it->second;
+    }
+    fafs[0].clear();
 
-    for (int i = 2; i--; )
+    // newest first
+    vector<pair<uint64_t, handle>> order;
+    order.reserve(fafs[1].size());
+    for (faf_map::iterator it = fafs[1].begin(); it != fafs[1].end(); it++)
     {
-        for (it = fafs[i].begin(); it != fafs[i].end(); )
-        {
-            req.outbuf.append((char*)&it->first, sizeof(handle));
+        order.push_back(std::make_pair(it->second->seq, it->first));
+    }
+    std::sort(order.begin(), order.end(), std::greater<pair<uint64_t, handle>>());
 
-            if (!i)
-            {
-                // move from fresh to pending
-                fafs[1][it->first] = it->second;
-                fafs[0].erase(it++);
-            }
-            else
-            {
-                it++;
-            }
-        }
+    req.outbuf.clear();
+    req.outbuf.reserve(order.size() * sizeof(handle));
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        req.outbuf.append((char*)&order[i].second, sizeof(handle));
     }
 
     if (req.outbuf.size())
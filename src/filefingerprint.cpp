@@ -189,26 +189,28 @@ bool FileFingerprint::genfingerprint(FileAccess* fa, bool ignoremtime)
     {
         // large file: sparse coverage, four sparse CRC32s
         HashCRC32 crc32;
-        byte block[4 * sizeof crc];
-        const unsigned blocks = MAXFULL / unsigned(sizeof block * crc.size());
+        const unsigned blocksize = 4 * sizeof crc;
+        const unsigned blocks = MAXFULL / unsigned(blocksize * crc.size());
+        const unsigned samples = unsigned(crc.size()) * blocks;
+        byte buf[MAXFULL];
+        m_off_t positions[MAXFULL / (4 * sizeof crc)];
 
-        for (unsigned i = 0; i < crc.size(); i++)
+        for (unsigned k = 0; k < samples; k++)
         {
-            for (unsigned j = 0; j < blocks; j++)
-            {
-                if (!fa->frawread(block, sizeof block,
-                                  (size - sizeof block)
-                                  * (i * blocks + j)
-                                  / (crc.size() * blocks - 1), true))
-                {
-                    size = -1;
-                    fa->closef();
-                    return true;
-                }
+            positions[k] = (size - blocksize) * k / (samples - 1);
+        }
 
-                crc32.add(block, sizeof block);
-            }
+        // fetch all samples in one go, so nearby ones don't cost a read each
+        if (!fa->frawreadv(buf, blocksize, positions, samples, true))
+        {
+            size = -1;
+            fa->closef();
+            return true;
+        }
 
+        for (unsigned i = 0; i < crc.size(); i++)
+        {
+            crc32.add(buf + i * blocks * blocksize, blocks * blocksize);
             crc32.get((byte*)&crcval);
             newcrc[i] = htonl(crcval);
         }
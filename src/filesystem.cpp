@@ -37,7 +37,7 @@
 
 namespace mega {
 
-CodeCounter::ScopeStats g_compareUtfTimings("compareUtfTimings");
+CodeCounter::ScopeStats g_compareUtfTimings("compareUtfTimings", 1024);  // very frequent: sampled
 
 namespace detail {
 
@@ -205,11 +205,75 @@ int compareUtf(UnicodeCodepointIterator<CharT> first1, bool unescaping1,
     return 1;
 }
 
+// can compareAscii() stand in for compareUtf() on s?
+bool asciiComparable(const string& s, bool unescaping)
+{
+#ifdef _WIN32
+    // skipPrefix() applies
+    if (!s.empty() && s[0] == '\\')
+    {
+        return false;
+    }
+#endif
+
+    return Utils::isAscii(s.data(), s.size())
+        && (!unescaping || s.find(static_cast<char>(escapeChar)) == string::npos);
+}
+
+// compareUtf() for ASCII strings without escapes: one code point per byte
+int compareAscii(const string& s1, const string& s2, bool caseInsensitive)
+{
+    CodeCounter::ScopeTimer rst(g_compareUtfTimings);
+
+    size_t n = std::min(s1.size(), s2.size());
+
+    if (!caseInsensitive)
+    {
+        if (memcmp(s1.data(), s2.data(), n))
+        {
+            size_t i = 0;
+            while (s1[i] == s2[i]) i++;
+            return int(static_cast<unsigned char>(s1[i])) - int(static_cast<unsigned char>(s2[i]));
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            int c1 = static_cast<unsigned char>(s1[i]);
+            int c2 = static_cast<unsigned char>(s2[i]);
+
+            if (c1 != c2)
+            {
+                c1 = (c1 >= 'a' && c1 <= 'z') ? c1 - 'a' + 'A' : c1;
+                c2 = (c2 >= 'a' && c2 <= 'z') ? c2 - 'a' + 'A' : c2;
+
+                if (c1 != c2)
+                {
+                    return c1 - c2;
+                }
+            }
+        }
+    }
+
+    if (s1.size() == s2.size())
+    {
+        return 0;
+    }
+
+    return s1.size() < s2.size() ? -1 : 1;
+}
+
 } // detail
 
 
 int compareUtf(const string& s1, bool unescaping1, const string& s2, bool unescaping2, bool caseInsensitive)
 {
+    if (detail::asciiComparable(s1, unescaping1) && detail::asciiComparable(s2, unescaping2))
+    {
+        return detail::compareAscii(s1, s2, caseInsensitive);
+    }
+
     return detail::compareUtf(
                 unicodeCodepointIterator(s1), unescaping1,
                 unicodeCodepointIterator(s2), unescaping2,
@@ -218,6 +282,13 @@ int compareUtf(const string& s1, bool unescaping1, const string& s2, bool unesca
 
 int compareUtf(const string& s1, bool unescaping1, const LocalPath& s2, bool unescaping2, bool caseInsensitive)
 {
+#ifndef _WIN32
+    if (detail::asciiComparable(s1, unescaping1) && detail::asciiComparable(s2.localpath, unescaping2))
+    {
+        return detail::compareAscii(s1, s2.localpath, caseInsensitive);
+    }
+#endif
+
     return detail::compareUtf(
         unicodeCodepointIterator(s1), unescaping1,
         unicodeCodepointIterator(s2.localpath), unescaping2,
@@ -226,6 +297,13 @@ int compareUtf(const string& s1, bool unescaping1, const LocalPath& s2, bool une
 
 int compareUtf(const LocalPath& s1, bool unescaping1, const string& s2, bool unescaping2, bool caseInsensitive)
 {
+#ifndef _WIN32
+    if (detail::asciiComparable(s1.localpath, unescaping1) && detail::asciiComparable(s2, unescaping2))
+    {
+        return detail::compareAscii(s1.localpath, s2, caseInsensitive);
+    }
+#endif
+
     return detail::compareUtf(
         unicodeCodepointIterator(s1.localpath), unescaping1,
         unicodeCodepointIterator(s2), unescaping2,
@@ -234,6 +312,13 @@ int compareUtf(const LocalPath& s1, bool unescaping1, const string& s2, bool une
 
 int compareUtf(const LocalPath& s1, bool unescaping1, const LocalPath& s2, bool unescaping2, bool caseInsensitive)
 {
+#ifndef _WIN32
+    if (detail::asciiComparable(s1.localpath, unescaping1) && detail::asciiComparable(s2.localpath, unescaping2))
+    {
+        return detail::compareAscii(s1.localpath, s2.localpath, caseInsensitive);
+    }
+#endif
+
     return detail::compareUtf(
         unicodeCodepointIterator(s1.localpath), unescaping1,
         unicodeCodepointIterator(s2.localpath), unescaping2,
@@ -761,6 +846,9 @@ void LocalPath::utf8_normalize(string* filename)
 {
     if (!filename) return;
 
+    // most names are plain ASCII, which NFC leaves as is
+    if (Utils::isAscii(filename->data(), filename->size())) return;
+
     const char* cfilename = filename->c_str();
     size_t fnsize = filename->size();
     string result;
@@ -820,8 +908,24 @@ bool FileSystemAccess::initFilesystemNotificationSystem()
     return true;
 }
 
+bool FileSystemAccess::changeJournalPosition(const LocalPath&, handle&, m_off_t&) const
+{
+    return false;
+}
+
+bool FileSystemAccess::readChangeJournal(const LocalPath&, handle, m_off_t,
+                                         std::function<void(handle, handle, const LocalPath&)>) const
+{
+    return false;
+}
+
 #endif // ENABLE_SYNC
 
+bool FileSystemAccess::cloneFile(const LocalPath& source, const LocalPath& target, m_time_t mtime)
+{
+    return copylocal(source, target, mtime);
+}
+
 bool FileSystemAccess::fileExistsAt(const LocalPath& path)
 {
     auto fa = newfileaccess(false);
@@ -874,6 +978,19 @@ bool DirNotify::empty()
     return true;
 }
 
+std::atomic<uint64_t> DirNotify::sReceived{0};
+std::atomic<uint64_t> DirNotify::sCoalesced{0};
+std::atomic<uint64_t> DirNotify::sCheckpaths{0};
+
+DirNotify::Stats DirNotify::stats(bool reset)
+{
+    Stats result;
+    result.received = reset ? sReceived.exchange(0) : sReceived.load();
+    result.coalesced = reset ? sCoalesced.exchange(0) : sCoalesced.load();
+    result.checkpaths = reset ? sCheckpaths.exchange(0) : sCheckpaths.load();
+    return result;
+}
+
 // notify base LocalNode + relative path/filename
 void DirNotify::notify(notifyqueue queue, LocalNode* node, LocalPath&& path, bool immediate, bool recursive)
 {
@@ -888,6 +1005,222 @@ void DirNotify::notify(notifyqueue queue, LocalNode* node, LocalPath&& path, boo
 #endif // ENABLE_SYNC
 }
 
+NotificationDeque::Key NotificationDeque::keyOf(const Notification& notification)
+{
+    return Key{notification.localnode, notification.path};
+}
+
+bool NotificationDeque::parentKeyOf(const Notification& notification, Key& parent)
+{
+    // Notifications for a LocalNode itself have no parent to fold into.
+    if (notification.path.empty())
+    {
+        return false;
+    }
+
+    size_t leaf = notification.path.getLeafnameByteIndex();
+    if (!leaf && !notification.localnode)
+    {
+        return false;
+    }
+
+    parent.localnode = notification.localnode;
+    parent.path = notification.path.subpathTo(leaf ? leaf - 1 : 0);
+    return true;
+}
+
+void NotificationDeque::skipDead()
+{
+    while (!mNotifications.empty() && !mNotifications.front().live)
+    {
+        mNotifications.pop_front();
+    }
+}
+
+void NotificationDeque::add(Notification&& notification, bool front)
+{
+    Key key = keyOf(notification);
+
+    auto it = mLive.find(key);
+    if (it != mLive.end())
+    {
+        // The queued one is replaced, keeping what either asked for.
+        Notification& queued = it->second->notification;
+        notification.recursive |= queued.recursive;
+        notification.folded |= queued.folded;
+        if (!notification.timestamp || !queued.timestamp)
+        {
+            notification.timestamp = 0;
+        }
+        else
+        {
+            notification.timestamp = std::max(notification.timestamp, queued.timestamp);
+        }
+        remove(*it->second);
+        ++DirNotify::sCoalesced;
+    }
+
+    Key parent;
+    bool hasParent = parentKeyOf(notification, parent);
+    dstime timestamp = notification.timestamp;
+
+    if (front)
+    {
+        mNotifications.push_front(Entry{std::move(notification), true});
+        mLive[key] = &mNotifications.front();
+    }
+    else
+    {
+        mNotifications.push_back(Entry{std::move(notification), true});
+        mLive[key] = &mNotifications.back();
+    }
+
+    if (hasParent && ++mChildren[parent] >= FOLD_CHILDREN_THRESHOLD)
+    {
+        fold(parent, timestamp);
+    }
+}
+
+void NotificationDeque::remove(Entry& entry)
+{
+    entry.live = false;
+    mLive.erase(keyOf(entry.notification));
+
+    Key parent;
+    if (parentKeyOf(entry.notification, parent))
+    {
+        auto it = mChildren.find(parent);
+        if (it != mChildren.end() && !--it->second)
+        {
+            mChildren.erase(it);
+        }
+    }
+}
+
+void NotificationDeque::fold(const Key& parent, dstime timestamp)
+{
+    LOG_debug << "Folding " << mChildren[parent] << " queued notifications into one for their folder: " << parent.path;
+
+    Key childParent;
+    for (auto& entry : mNotifications)
+    {
+        // Recursive ones ask for more than a rescan of the folder, so they stay.
+        if (entry.live && !entry.notification.recursive
+                && parentKeyOf(entry.notification, childParent) && childParent == parent)
+        {
+            remove(entry);
+            ++DirNotify::sCoalesced;
+        }
+    }
+
+    Notification folder(timestamp, parent.path, parent.localnode, false);
+    folder.folded = true;
+    add(std::move(folder), false);
+}
+
+bool NotificationDeque::peekFront(Notification& notification)
+{
+    std::lock_guard<std::mutex> g(m);
+    skipDead();
+    if (!mNotifications.empty())
+    {
+        notification = mNotifications.front().notification;
+        return true;
+    }
+    return false;
+}
+
+void NotificationDeque::peekFront(size_t max, std::vector<Notification>& notifications)
+{
+    std::lock_guard<std::mutex> g(m);
+    for (auto i = mNotifications.begin(); i != mNotifications.end() && notifications.size() < max; ++i)
+    {
+        if (i->live)
+        {
+            notifications.push_back(i->notification);
+        }
+    }
+}
+
+bool NotificationDeque::popFront(Notification& notification)
+{
+    std::lock_guard<std::mutex> g(m);
+    skipDead();
+    if (!mNotifications.empty())
+    {
+        remove(mNotifications.front());
+        notification = std::move(mNotifications.front().notification);
+        mNotifications.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void NotificationDeque::unpopFront(const Notification& notification)
+{
+    std::lock_guard<std::mutex> g(m);
+    add(Notification(notification), true);
+}
+
+void NotificationDeque::pushBack(Notification&& notification)
+{
+    std::lock_guard<std::mutex> g(m);
+    ++DirNotify::sReceived;
+
+    // The children of a folded folder are covered by its notification.
+    Key parent;
+    if (!notification.recursive && parentKeyOf(notification, parent))
+    {
+        auto it = mLive.find(parent);
+        if (it != mLive.end() && it->second->notification.folded)
+        {
+            ++DirNotify::sCoalesced;
+            return;
+        }
+    }
+
+    add(std::move(notification), false);
+}
+
+bool NotificationDeque::empty()
+{
+    std::lock_guard<std::mutex> g(m);
+    return mLive.empty();
+}
+
+size_t NotificationDeque::size()
+{
+    std::lock_guard<std::mutex> g(m);
+    return mLive.size();
+}
+
+void NotificationDeque::replaceLocalNodePointers(LocalNode* check, LocalNode* newvalue)
+{
+    std::lock_guard<std::mutex> g(m);
+    for (auto& entry : mNotifications)
+    {
+        if (entry.live && entry.notification.localnode == check)
+        {
+            // Rekeyed in place: if it now repeats a queued one, that one stays instead.
+            remove(entry);
+            entry.notification.localnode = newvalue;
+
+            Key key = keyOf(entry.notification);
+            if (!mLive.count(key))
+            {
+                entry.live = true;
+                mLive[key] = &entry;
+
+                Key parent;
+                if (parentKeyOf(entry.notification, parent))
+                {
+                    ++mChildren[parent];
+                }
+            }
+        }
+    }
+}
+
 DirNotify* FileSystemAccess::newdirnotify(const LocalPath& localpath, const LocalPath& ignore, Waiter*, LocalNode* syncroot)
 {
     return new DirNotify(localpath, ignore, syncroot->sync);
@@ -970,7 +1303,7 @@ void FileAccess::asyncopfinished(void *param)
     Waiter *waiter = (Waiter *)param;
     if (waiter)
     {
-        waiter->notify();
+        waiter->notifyBy(Waiter::NOTIFY_FILEIO);
     }
 }
 
@@ -1195,6 +1528,73 @@ bool FileAccess::frawread(byte* dst, unsigned len, m_off_t pos, bool caller_open
     return r;
 }
 
+bool FileAccess::fwritev(const byte* const* bufs, const unsigned* lens, unsigned count, m_off_t pos)
+{
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (!fwrite(bufs[i], lens[i], pos))
+        {
+            return false;
+        }
+        pos += lens[i];
+    }
+    return true;
+}
+
+bool FileAccess::frawreadv(byte* dst, unsigned len, const m_off_t* positions, unsigned count, bool caller_opened)
+{
+    // blocks closer than this are cheaper to read through than to fetch separately
+    const m_off_t MERGEGAP = 4096;
+    const m_off_t MAXRUN = 1024 * 1024;
+
+    if (!caller_opened && !openf())
+    {
+        return false;
+    }
+
+    bool r = true;
+    std::vector<byte> run;
+
+    for (unsigned i = 0; r && i < count; )
+    {
+        assert(!i || positions[i] >= positions[i - 1]);
+
+        // extend the run while the next block starts close to the end of the current one
+        unsigned j = i + 1;
+        m_off_t runend = positions[i] + len;
+        while (j < count
+               && positions[j] - runend <= MERGEGAP
+               && positions[j] + len - positions[i] <= MAXRUN)
+        {
+            runend = std::max<m_off_t>(runend, positions[j] + len);
+            ++j;
+        }
+
+        if (j == i + 1)
+        {
+            r = sysread(dst + size_t(i) * len, len, positions[i]);
+        }
+        else
+        {
+            run.resize(size_t(runend - positions[i]));
+            r = sysread(run.data(), unsigned(run.size()), positions[i]);
+            for (unsigned k = i; r && k < j; ++k)
+            {
+                memcpy(dst + size_t(k) * len, run.data() + (positions[k] - positions[i]), len);
+            }
+        }
+
+        i = j;
+    }
+
+    if (!caller_opened)
+    {
+        closef();
+    }
+
+    return r;
+}
+
 AsyncIOContext::~AsyncIOContext()
 {
     finish();
@@ -1400,6 +1800,41 @@ void LocalPath::prependWithSeparator(const LocalPath& additionalPath)
     assert(invariant());
 }
 
+void LocalPath::assignComponents(const vector<const LocalPath*>& components)
+{
+    assert(invariant());
+
+    size_t units = 0;
+    for (const LocalPath* component : components)
+    {
+        units += component->localpath.size() + 1;
+    }
+
+    localpath.clear();
+    localpath.reserve(units);
+    isFromRoot = !components.empty() && components.front()->isFromRoot;
+
+    for (const LocalPath* component : components)
+    {
+        assert(component == components.front() || !component->isFromRoot);
+
+        if (component->localpath.empty())
+        {
+            continue;
+        }
+
+        // same separator rules as prependWithSeparator
+        if (!localpath.empty() && !(endsInSeparator() || component->beginsWithSeparator()))
+        {
+            localpath.append(1, localPathSeparator);
+        }
+
+        localpath.append(component->localpath);
+    }
+
+    assert(invariant());
+}
+
 LocalPath LocalPath::prependNewWithSeparator(const LocalPath& additionalPath) const
 {
     assert(!isFromRoot);
@@ -1709,6 +2144,13 @@ void LocalPath::local2path(const std::wstring* local, string* path, bool normali
 void LocalPath::path2local(const string* path, string* local)
 {
 #ifdef __MACH__
+    // the filesystem representation (NFD) of ASCII is the same bytes
+    if (Utils::isAscii(path->data(), path->size()))
+    {
+        *local = *path;
+        return;
+    }
+
     path2localMac(path, local);
 #else
     *local = *path;
@@ -1849,6 +2291,8 @@ bool isNetworkFilesystem(FileSystemType type)
 std::atomic<size_t> ScanService::mNumServices(0);
 std::unique_ptr<ScanService::Worker> ScanService::mWorker;
 std::mutex ScanService::mWorkerLock;
+unsigned ScanService::mNumThreads = std::max(1u, std::min(8u, std::thread::hardware_concurrency()));
+unsigned ScanService::mNetworkScans = 2;
 
 ScanService::ScanService(Waiter& waiter)
     : mWaiter(waiter)
@@ -1859,7 +2303,8 @@ ScanService::ScanService(Waiter& waiter)
 
     if (++mNumServices == 1)
     {
-        mWorker.reset(new Worker());
+        unsigned numThreads = ThreadTopology::poolSize(ThreadTopology::SCAN, mNumThreads);
+        mWorker.reset(new Worker(numThreads, std::min(mNetworkScans, numThreads)));
     }
 }
 
@@ -1872,22 +2317,41 @@ ScanService::~ScanService()
     }
 }
 
-auto ScanService::queueScan(LocalPath targetPath, handle expectedFsid, bool followSymlinks, map<LocalPath, FSNode>&& priorScanChildren) -> RequestPtr
+auto ScanService::queueScan(LocalPath targetPath,
+                            handle expectedFsid,
+                            bool followSymlinks,
+                            map<LocalPath, FSNode>&& priorScanChildren,
+                            FileSystemType fsType,
+                            bool urgent) -> RequestPtr
 {
     // Create a request to represent the scan.
-    auto request = std::make_shared<ScanRequest>(mWaiter, followSymlinks, targetPath, expectedFsid, move(priorScanChildren));
+    auto request = std::make_shared<ScanRequest>(mWaiter,
+                                                 followSymlinks,
+                                                 targetPath,
+                                                 expectedFsid,
+                                                 move(priorScanChildren),
+                                                 isNetworkFilesystem(fsType));
 
     // Queue request for processing.
-    mWorker->queue(request);
+    mWorker->queue(request, urgent);
 
     return request;
 }
 
+void ScanService::setParallelism(unsigned numThreads, unsigned networkScans)
+{
+    std::lock_guard<std::mutex> lock(mWorkerLock);
+
+    mNumThreads = std::max(1u, numThreads);
+    mNetworkScans = std::max(1u, std::min(networkScans, mNumThreads));
+}
+
 ScanService::ScanRequest::ScanRequest(Waiter& waiter,
     bool followSymLinks,
     LocalPath targetPath,
     handle expectedFsid,
-    map<LocalPath, FSNode>&& priorScanChildren)
+    map<LocalPath, FSNode>&& priorScanChildren,
+    bool networkFilesystem)
     : mWaiter(waiter)
     , mScanResult(SCAN_INPROGRESS)
     , mFollowSymLinks(followSymLinks)
@@ -1895,27 +2359,30 @@ ScanService::ScanRequest::ScanRequest(Waiter& waiter,
     , mResults()
     , mTargetPath(std::move(targetPath))
     , mExpectedFsid(expectedFsid)
+    , mNetworkFilesystem(networkFilesystem)
 {
 }
 
-ScanService::Worker::Worker(size_t numThreads)
-    : mFsAccess(new FSACCESS_CLASS())
-    , mPending()
-    , mPendingLock()
-    , mPendingNotifier()
-    , mThreads()
+ScanService::Worker::Worker(size_t numThreads, size_t networkScans)
+    : mNetworkScans(networkScans)
 {
     // Always at least one thread.
     assert(numThreads > 0);
+    assert(networkScans > 0);
 
     LOG_debug << "Starting ScanService worker...";
 
+    for (size_t i = 0; i < numThreads; ++i)
+    {
+        mQueues.emplace_back(new Queue());
+    }
+
     // Start the threads.
-    while (numThreads--)
+    for (size_t i = 0; i < numThreads; ++i)
     {
         try
         {
-            mThreads.emplace_back([this]() { loop(); });
+            mThreads.emplace_back([this, i]() { loop(i); });
         }
         catch (std::system_error& e)
         {
@@ -1931,14 +2398,13 @@ ScanService::Worker::~Worker()
 {
     LOG_debug << "Stopping ScanService worker...";
 
-    // Queue the 'terminate' sentinel.
     {
-        std::unique_lock<std::mutex> lock(mPendingLock);
-        mPending.emplace_back();
+        std::lock_guard<std::mutex> lock(mStateLock);
+        mTerminating = true;
     }
 
     // Wake any sleeping threads.
-    mPendingNotifier.notify_all();
+    mStateNotifier.notify_all();
 
     LOG_debug << "Waiting for worker thread(s) to terminate...";
 
@@ -1948,53 +2414,184 @@ ScanService::Worker::~Worker()
         thread.join();
     }
 
+    // requests left behind
+    ThreadTopology::queued(ThreadTopology::SCAN, -static_cast<long long>(mLocalQueued + mNetworkQueued));
+
     LOG_debug << "ScanService worker stopped.";
 }
 
-void ScanService::Worker::queue(ScanRequestPtr request)
+void ScanService::Worker::queue(ScanRequestPtr request, bool urgent)
 {
+    bool network = request->mNetworkFilesystem;
+
+    ThreadTopology::queued(ThreadTopology::SCAN, 1);
+
     // Queue the request.
+    if (network)
     {
-        std::unique_lock<std::mutex> lock(mPendingLock);
-        mPending.emplace_back(std::move(request));
+        std::lock_guard<std::mutex> lock(mNetwork.mLock);
+
+        if (urgent)
+        {
+            mNetwork.mPending.emplace_front(std::move(request));
+        }
+        else
+        {
+            mNetwork.mPending.emplace_back(std::move(request));
+        }
+    }
+    else if (urgent)
+    {
+        std::lock_guard<std::mutex> lock(mUrgent.mLock);
+        mUrgent.mPending.emplace_back(std::move(request));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mStateLock);
+
+        if (network)
+        {
+            ++mNetworkQueued;
+        }
+        else
+        {
+            if (!urgent)
+            {
+                // Spread the work, idle threads steal what is left behind.
+                Queue& q = *mQueues[mNextQueue++ % mQueues.size()];
+
+                std::lock_guard<std::mutex> qlock(q.mLock);
+                q.mPending.emplace_back(std::move(request));
+            }
+
+            ++mLocalQueued;
+        }
     }
 
     // Tell the lucky thread it has something to do.
-    mPendingNotifier.notify_one();
+    mStateNotifier.notify_one();
 }
 
-void ScanService::Worker::loop()
+auto ScanService::Worker::popFront(Queue& queue) -> ScanRequestPtr
 {
-    // We're ready when we have some work to do.
-    auto ready = [this]() { return mPending.size(); };
+    std::lock_guard<std::mutex> lock(queue.mLock);
 
-    for ( ; ; )
+    if (queue.mPending.empty())
+    {
+        return nullptr;
+    }
+
+    auto request = std::move(queue.mPending.front());
+    queue.mPending.pop_front();
+    return request;
+}
+
+auto ScanService::Worker::popBack(Queue& queue) -> ScanRequestPtr
+{
+    std::lock_guard<std::mutex> lock(queue.mLock);
+
+    if (queue.mPending.empty())
+    {
+        return nullptr;
+    }
+
+    auto request = std::move(queue.mPending.back());
+    queue.mPending.pop_back();
+    return request;
+}
+
+auto ScanService::Worker::take(size_t index) -> ScanRequestPtr
+{
+    bool network;
+
+    {
+        // Wait for something we're allowed to run, and reserve it.
+        std::unique_lock<std::mutex> lock(mStateLock);
+
+        mStateNotifier.wait(lock, [this]() {
+            return mTerminating
+                   || mLocalQueued
+                   || (mNetworkQueued && mNetworkRunning < mNetworkScans);
+        });
+
+        if (mTerminating)
+        {
+            return nullptr;
+        }
+
+        network = !mLocalQueued;
+
+        if (network)
+        {
+            --mNetworkQueued;
+            ++mNetworkRunning;
+        }
+        else
+        {
+            --mLocalQueued;
+        }
+    }
+
+    ThreadTopology::queued(ThreadTopology::SCAN, -1);
+
+    if (network)
     {
-        ScanRequestPtr request;
+        auto request = popFront(mNetwork);
+        assert(request);
+        return request;
+    }
+
+    // The reserved request is in one of the local queues: urgent first,
+    // then our own, oldest first, then the newest of someone else's.
+    for (;;)
+    {
+        if (auto request = popFront(mUrgent))
+        {
+            return request;
+        }
 
+        if (auto request = popFront(*mQueues[index]))
         {
-            // Wait for something to do.
-            std::unique_lock<std::mutex> lock(mPendingLock);
-            mPendingNotifier.wait(lock, ready);
+            return request;
+        }
 
-            // Are we being told to terminate?
-            if (!mPending.front())
+        for (size_t i = 1; i < mQueues.size(); ++i)
+        {
+            if (auto request = popBack(*mQueues[(index + i) % mQueues.size()]))
             {
-                // Bail, don't deque the sentinel.
-                return;
+                return request;
             }
+        }
+    }
+}
+
+void ScanService::Worker::loop(size_t index)
+{
+    ThreadTopology::threadStarted(ThreadTopology::SCAN);
+
+    // Each thread has its own filesystem access.
+    std::unique_ptr<FileSystemAccess> fsAccess(new FSACCESS_CLASS());
+
+    for ( ; ; )
+    {
+        ScanRequestPtr request = take(index);
 
-            request = std::move(mPending.front());
-            mPending.pop_front();
+        // Are we being told to terminate?
+        if (!request)
+        {
+            ThreadTopology::threadStopped(ThreadTopology::SCAN);
+            return;
         }
 
+        ThreadTopology::Busy busy(ThreadTopology::SCAN);
+
         LOG_verbose << "Directory scan begins: " << request->mTargetPath;
         using namespace std::chrono;
         auto scanStart = high_resolution_clock::now();
 
         // Process the request.
         unsigned nFingerprinted = 0;
-        auto result = scan(request, nFingerprinted);
+        auto result = scan(*fsAccess, request, nFingerprinted);
         auto scanEnd = high_resolution_clock::now();
 
         if (result == SCAN_SUCCESS)
@@ -2009,20 +2606,29 @@ void ScanService::Worker::loop()
             LOG_verbose << "Directory scan FAILED (" << result << "): " << request->mTargetPath;
         }
 
+        if (request->mNetworkFilesystem)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mStateLock);
+                --mNetworkRunning;
+            }
+
+            // A network slot is free again.
+            mStateNotifier.notify_one();
+        }
+
         request->mScanResult = result;
-        request->mWaiter.notify();
+        request->mWaiter.notifyBy(Waiter::NOTIFY_SCAN);
     }
 }
 
-// Really we only have one worker despite the vector of threads - maybe we should just have one
-// regardless of multiple clients too - there is only one filesystem after all (but not singleton!!)
 CodeCounter::ScopeStats ScanService::syncScanTime = { "folderScan" };
 
-auto ScanService::Worker::scan(ScanRequestPtr request, unsigned& nFingerprinted) -> ScanResult
+auto ScanService::Worker::scan(FileSystemAccess& fsAccess, ScanRequestPtr request, unsigned& nFingerprinted) -> ScanResult
 {
     CodeCounter::ScopeTimer rst(syncScanTime);
 
-    auto result = mFsAccess->directoryScan(request->mTargetPath,
+    auto result = fsAccess.directoryScan(request->mTargetPath,
         request->mExpectedFsid,
         request->mKnown,
         request->mResults,
@@ -2036,5 +2642,61 @@ auto ScanService::Worker::scan(ScanRequestPtr request, unsigned& nFingerprinted)
 }
 
 
+LocalFingerprintIndex::LocalFingerprintIndex(size_t maxEntries)
+    : mMaxEntries(maxEntries)
+{
+}
+
+void LocalFingerprintIndex::add(const FileFingerprint& fingerprint, const LocalPath& path)
+{
+    if (!fingerprint.isvalid || path.empty())
+    {
+        return;
+    }
+
+    Entry& entry = mEntries[fingerprint];
+    entry.path = path;
+    entry.seq = ++mSeq;
+    mOrder.emplace_back(fingerprint, entry.seq);
+
+    while (mEntries.size() > mMaxEntries || mOrder.size() > 2 * mMaxEntries + 1)
+    {
+        auto it = mEntries.find(mOrder.front().first);
+        if (it != mEntries.end() && it->second.seq == mOrder.front().second)
+        {
+            mEntries.erase(it);
+        }
+        mOrder.pop_front();
+    }
+}
+
+void LocalFingerprintIndex::remove(const FileFingerprint& fingerprint)
+{
+    mEntries.erase(fingerprint);
+}
+
+bool LocalFingerprintIndex::find(const FileFingerprint& fingerprint, LocalPath& path) const
+{
+    auto it = mEntries.find(fingerprint);
+    if (it == mEntries.end())
+    {
+        return false;
+    }
+
+    path = it->second.path;
+    return true;
+}
+
+void LocalFingerprintIndex::clear()
+{
+    mEntries.clear();
+    mOrder.clear();
+}
+
+size_t LocalFingerprintIndex::size() const
+{
+    return mEntries.size();
+}
+
 } // namespace
 
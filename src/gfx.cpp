@@ -98,83 +98,99 @@ bool GfxProc::isvideo(const LocalPath& localfilename)
     return false;
 }
 
+bool GfxProc::isslow(const LocalPath& localfilename)
+{
+    const char* supported;
+
+    if (!mSlowLaneProvider || !(supported = mSlowLaneProvider->supportedslowformats()))
+    {
+        return false;
+    }
+
+    string ext;
+    if (client->fsaccess->getextension(localfilename, ext))
+    {
+        const char* ptr;
+
+        if ((ptr = strstr(supported, ext.c_str())) && ptr[ext.size()] == '.')
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 void *GfxProc::threadEntryPoint(void *param)
 {
-    GfxProc* gfxProcessor = (GfxProc*)param;
-    gfxProcessor->loop();
+    ThreadTopology::threadStarted(ThreadTopology::GFX);
+    Worker* worker = (Worker*)param;
+    worker->proc->loop(*worker->provider, worker->providerMutex, *worker->queue);
+    ThreadTopology::threadStopped(ThreadTopology::GFX);
     return NULL;
 }
 
-void GfxProc::loop()
+void GfxProc::loop(IGfxProvider& provider, std::mutex* providerMutex, GfxJobQueue& queue)
 {
     GfxJob *job = NULL;
-    while (!finished)
+    while ((job = queue.waitpop()))
     {
-        waiter.init(NEVER);
-        waiter.wait();
-        while ((job = requests.pop()))
+        ThreadTopology::queued(ThreadTopology::GFX, -1);
+
+        if (finished)
         {
-            if (finished)
-            {
-                delete job;
-                break;
-            }
+            delete job;
+            break;
+        }
 
-            mutex.lock();
-            LOG_debug << "Processing media file: " << job->h;
+        ThreadTopology::Busy busy(ThreadTopology::GFX);
+        if (providerMutex)
+        {
+            providerMutex->lock();
+        }
+        LOG_debug << "Processing media file: " << job->h;
 
-            // (this assumes that the width of the largest dimension is max)
-            if (mGfxProvider->readbitmap(client->fsaccess.get(), job->localfilename, dimensions[sizeof dimensions/sizeof dimensions[0]-1][0]))
+        // decode only as large as the largest size requested, which comes first (the providers
+        // able to, like FreeImage for JPEG, downscale while decoding)
+        if (provider.readbitmap(client->fsaccess.get(), job->localfilename, dimensions[job->imagetypes.front()][0]))
+        {
+            for (unsigned i = 0; i < job->imagetypes.size(); i++)
             {
-                for (unsigned i = 0; i < job->imagetypes.size(); i++)
-                {
-                    // successively downscale the original image
-                    string* jpeg = new string();
-                    int w = dimensions[job->imagetypes[i]][0];
-                    int h = dimensions[job->imagetypes[i]][1];
+                // successively downscale the original image: each size can be derived from the previous one
+                string* jpeg = new string();
+                int w = dimensions[job->imagetypes[i]][0];
+                int h = dimensions[job->imagetypes[i]][1];
 
-                    if (mGfxProvider->width() < w && mGfxProvider->height() < h)
-                    {
-                        LOG_debug << "Skipping upsizing of preview or thumbnail";
-                        w = mGfxProvider->width();
-                        h = mGfxProvider->height();
-                    }
+                if (provider.width() < w && provider.height() < h)
+                {
+                    LOG_debug << "Skipping upsizing of preview or thumbnail";
+                    w = provider.width();
+                    h = provider.height();
+                }
 
-                    if (!mGfxProvider->resizebitmap(w, h, jpeg))
-                    {
-                        delete jpeg;
-                        jpeg = NULL;
-                    }
-                    job->images.push_back(jpeg);
+                if (!provider.resizebitmap(w, h, jpeg))
+                {
+                    delete jpeg;
+                    jpeg = NULL;
                 }
-                mGfxProvider->freebitmap();
+                job->images.push_back(jpeg);
             }
-            else
+            provider.freebitmap();
+        }
+        else
+        {
+            for (unsigned i = 0; i < job->imagetypes.size(); i++)
             {
-                for (unsigned i = 0; i < job->imagetypes.size(); i++)
-                {
-                    job->images.push_back(NULL);
-                }
+                job->images.push_back(NULL);
             }
-
-            mutex.unlock();
-            responses.push(job);
-            client->waiter->notify();
         }
-    }
-
-    while ((job = requests.pop()))
-    {
-        delete job;
-    }
 
-    while ((job = responses.pop()))
-    {
-        for (unsigned i = 0; i < job->imagetypes.size(); i++)
+        if (providerMutex)
         {
-            delete job->images[i];
+            providerMutex->unlock();
         }
-        delete job;
+        responses.push(job);
+        client->waiter->notifyBy(Waiter::NOTIFY_GFX);
     }
 }
 
@@ -295,6 +311,7 @@ int GfxProc::gendimensionsputfa(FileAccess* /*fa*/, const LocalPath& localfilena
     memcpy(job->key, key->key, SymmCipher::KEYLENGTH);
     job->localfilename = localfilename;
 
+    // largest first, so that the provider can derive each size from the previous one
     int generatingAttrs = 0;
     for (fatype i = sizeof dimensions/sizeof dimensions[0]; i--; )
     {
@@ -311,8 +328,12 @@ int GfxProc::gendimensionsputfa(FileAccess* /*fa*/, const LocalPath& localfilena
         return 0;
     }
 
-    requests.push(job);
-    waiter.notify();
+    // uploads wait for their attributes to complete, while those of existing nodes are
+    // just restored: the former go first, and within each group jobs with a thumbnail
+    job->priority = (th.isNodeHandle() ? 2 : 0) + ((generatingAttrs & (1 << THUMBNAIL)) ? 0 : 1);
+
+    (isslow(localfilename) ? slowRequests : requests).push(job);
+    ThreadTopology::queued(ThreadTopology::GFX, 1);
     return generatingAttrs;
 }
 
@@ -371,20 +392,63 @@ GfxProc::GfxProc(std::unique_ptr<IGfxProvider> middleware)
     finished = false;
 }
 
+void GfxProc::addProvider(std::unique_ptr<IGfxProvider> provider)
+{
+    assert(!threadstarted);
+    mExtraProviders.push_back(std::move(provider));
+}
+
+void GfxProc::addSlowLaneProvider(std::unique_ptr<IGfxProvider> provider)
+{
+    assert(!threadstarted);
+    mSlowLaneProvider = std::move(provider);
+}
+
 void GfxProc::startProcessingThread()
 {
-    thread.start(threadEntryPoint, this);
+    // the main provider is also used by savefa() from other threads
+    mWorkers.emplace_back(new Worker(this, mGfxProvider.get(), &mutex, &requests));
+    for (auto& provider : mExtraProviders)
+    {
+        mWorkers.emplace_back(new Worker(this, provider.get(), nullptr, &requests));
+    }
+    if (mSlowLaneProvider)
+    {
+        mWorkers.emplace_back(new Worker(this, mSlowLaneProvider.get(), nullptr, &slowRequests));
+    }
+
+    for (auto& worker : mWorkers)
+    {
+        worker->thread.start(threadEntryPoint, worker.get());
+    }
     threadstarted = true;
 }
 
 GfxProc::~GfxProc()
 {
     finished = true;
-    waiter.notify();
+    requests.close();
+    slowRequests.close();
     assert(threadstarted);
-    if (threadstarted)
+    for (auto& worker : mWorkers)
+    {
+        worker->thread.join();
+    }
+
+    GfxJob *job = NULL;
+    while ((job = requests.pop()) || (job = slowRequests.pop()))
+    {
+        ThreadTopology::queued(ThreadTopology::GFX, -1);
+        delete job;
+    }
+
+    while ((job = responses.pop()))
     {
-        thread.join();
+        for (unsigned i = 0; i < job->images.size(); i++)
+        {
+            delete job->images[i];
+        }
+        delete job;
     }
 }
 
@@ -396,8 +460,14 @@ GfxJobQueue::GfxJobQueue()
 void GfxJobQueue::push(GfxJob *job)
 {
     mutex.lock();
-    jobs.push_back(job);
+    auto it = jobs.end();
+    while (it != jobs.begin() && (*(it - 1))->priority > job->priority)
+    {
+        --it;
+    }
+    jobs.insert(it, job);
     mutex.unlock();
+    cv.notify_one();
 }
 
 GfxJob *GfxJobQueue::pop()
@@ -414,6 +484,27 @@ GfxJob *GfxJobQueue::pop()
     return job;
 }
 
+GfxJob *GfxJobQueue::waitpop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this]() { return closed || !jobs.empty(); });
+    if (closed)
+    {
+        return NULL;
+    }
+    GfxJob *job = jobs.front();
+    jobs.pop_front();
+    return job;
+}
+
+void GfxJobQueue::close()
+{
+    mutex.lock();
+    closed = true;
+    mutex.unlock();
+    cv.notify_all();
+}
+
 GfxJob::GfxJob()
 {
 
@@ -506,11 +506,14 @@ bool GfxProviderFreeImage::isPdfFile(const string &ext)
 
 bool GfxProviderFreeImage::readbitmapPdf(FileSystemAccess* fa, const LocalPath& imagePath, int size)
 {
-    std::lock_guard<std::mutex> g(gfxMutex);
-    if (!pdfiumInitialized)
+    // the library stays initialized until this provider goes away, rendering is serialized by PdfiumReader
     {
-        pdfiumInitialized = true;
-        PdfiumReader::init();
+        std::lock_guard<std::mutex> g(gfxMutex);
+        if (!pdfiumInitialized)
+        {
+            pdfiumInitialized = true;
+            PdfiumReader::init();
+        }
     }
 
     int orientation;
@@ -528,9 +531,9 @@ bool GfxProviderFreeImage::readbitmapPdf(FileSystemAccess* fa, const LocalPath&
         workingDir = LocalPath::fromPlatformEncodedAbsolute(tmpPath.c_str());
     }
 
-    unique_ptr<char[]> data = PdfiumReader::readBitmapFromPdf(w, h, orientation, imagePath, fa, workingDir);
+    unique_ptr<char[]> data = PdfiumReader::readBitmapFromPdf(w, h, orientation, size, imagePath, fa, workingDir);
 #else
-    unique_ptr<char[]> data = PdfiumReader::readBitmapFromPdf(w, h, orientation, imagePath, fa);
+    unique_ptr<char[]> data = PdfiumReader::readBitmapFromPdf(w, h, orientation, size, imagePath, fa);
 #endif
 
     if (!data || !w || !h)
@@ -579,6 +582,15 @@ const char *GfxProviderFreeImage::supportedvideoformats()
     return NULL;
 }
 
+const char *GfxProviderFreeImage::supportedslowformats()
+{
+#ifdef HAVE_PDFIUM
+    return supportedformatsPDF();
+#else
+    return NULL;
+#endif
+}
+
 bool GfxProviderFreeImage::readbitmap(FileSystemAccess* fa, const LocalPath& localname, int size)
 {
 
@@ -640,17 +652,37 @@ bool GfxProviderFreeImage::resizebitmap(int rw, int rh, string* jpegout)
 
     jpegout->clear();
 
-    if ((tdib = FreeImage_Rescale(dib, w, h, FILTER_BILINEAR)))
+    // the resized bitmap replaces the original one, so the next (smaller) size starts from it
+    // instead of from the full resolution image, and no copy is made if no cropping is needed
+    if (static_cast<int>(FreeImage_GetWidth(dib)) == w && static_cast<int>(FreeImage_GetHeight(dib)) == h)
     {
-        FreeImage_Unload(dib);
-
-        dib = tdib;
+        tdib = dib;
+    }
+    else
+    {
+        tdib = FreeImage_Rescale(dib, w, h, FILTER_BILINEAR);
+    }
 
-        if ((tdib = FreeImage_Copy(dib, px, py, px + rw, py + rh)))
+    if (tdib)
+    {
+        if (tdib != dib)
         {
             FreeImage_Unload(dib);
-
             dib = tdib;
+        }
+
+        if (px || py || rw != w || rh != h)
+        {
+            tdib = FreeImage_Copy(dib, px, py, px + rw, py + rh);
+        }
+
+        if (tdib)
+        {
+            if (tdib != dib)
+            {
+                FreeImage_Unload(dib);
+                dib = tdib;
+            }
 
             WORD bpp = (WORD)FreeImage_GetBPP(dib);
             if (bpp != 24) {
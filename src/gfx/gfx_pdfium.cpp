@@ -22,11 +22,36 @@
 #include "mega/gfx/gfx_pdfium.h"
 
 #ifdef HAVE_PDFIUM
+#include <fpdf_progressive.h>
+#include <chrono>
 
 #define MAX_PDF_MEM_SIZE 1024*1024*100
+#define MAX_PDF_RENDER_SIZE 3500
+#define MAX_PDF_RENDER_SECONDS 10
 
 namespace mega {
 
+namespace {
+// tells PDFium to pause the rendering once the deadline has passed
+struct RenderDeadline : IFSDK_PAUSE
+{
+    std::chrono::steady_clock::time_point deadline;
+
+    explicit RenderDeadline(std::chrono::steady_clock::duration timeout)
+        : deadline(std::chrono::steady_clock::now() + timeout)
+    {
+        version = 1;
+        user = nullptr;
+        NeedToPauseNow = &needToPauseNow;
+    }
+
+    static FPDF_BOOL needToPauseNow(IFSDK_PAUSE* pause)
+    {
+        return std::chrono::steady_clock::now() >= static_cast<RenderDeadline*>(pause)->deadline;
+    }
+};
+}
+
 std::mutex PdfiumReader::pdfMutex;
 unsigned PdfiumReader::initialized = 0;
 
@@ -56,9 +81,9 @@ void PdfiumReader::destroy()
 }
 
 #ifdef _WIN32
-std::unique_ptr<char[]> PdfiumReader::readBitmapFromPdf(int &w, int &h, int &orientation, const LocalPath &path, FileSystemAccess* fa, const LocalPath &workingDirFolder)
+std::unique_ptr<char[]> PdfiumReader::readBitmapFromPdf(int &w, int &h, int &orientation, int size, const LocalPath &path, FileSystemAccess* fa, const LocalPath &workingDirFolder)
 #else
-std::unique_ptr<char[]> PdfiumReader::readBitmapFromPdf(int &w, int &h, int &orientation, const LocalPath &path, FileSystemAccess* fa)
+std::unique_ptr<char[]> PdfiumReader::readBitmapFromPdf(int &w, int &h, int &orientation, int size, const LocalPath &path, FileSystemAccess* fa)
 #endif
 {
 
@@ -112,15 +137,24 @@ std::unique_ptr<char[]> PdfiumReader::readBitmapFromPdf(int &w, int &h, int &ori
                 w = static_cast<int>(FPDF_GetPageWidth(page));
                 h = static_cast<int>(FPDF_GetPageHeight(page));
 
-                // we should restrict the maximum size of PDF pages to process, otherwise
+                // render straight at the size needed rather than at the page size followed by a downscale
+                // (one pixel per point at most, as before)
+                int shorter = std::min(w, h);
+                if (size > 0 && shorter > size)
+                {
+                    w = static_cast<int>((static_cast<long long>(w) * size + shorter - 1) / shorter);
+                    h = static_cast<int>((static_cast<long long>(h) * size + shorter - 1) / shorter);
+                }
+
+                // we should restrict the maximum size of PDF pages to render, otherwise
                 // it may require too much memory (and CPU).
                 // as a compromise, the A0 standarized size should be enough for most cases,
                 // A0: 841 x 1188 mm -> 2384 x 3368 points (as returned by FPDF_GetPageX())
-                // to allow some margins, and rotated ones, avoid larger than 3500 points in
+                // to allow some margins, and rotated ones, avoid larger than 3500 pixels in
                 // any dimension, which would require a buffer of maximum 3500x3500x4 = ~47MB
 
                 if ((!w || !h)  // error reading size
-                        || (w > 3500 || h > 3500))  // page too large
+                        || (w > MAX_PDF_RENDER_SIZE || h > MAX_PDF_RENDER_SIZE))  // page too large
                 {
                     if (!w || !h)
                     {
@@ -159,7 +193,11 @@ std::unique_ptr<char[]> PdfiumReader::readBitmapFromPdf(int &w, int &h, int &ori
                 }
 
                 FPDFBitmap_FillRect(bitmap, 0, 0, w, h, 0xFFFFFFFF);
-                FPDF_RenderPageBitmap(bitmap, page, 0, 0, w, h, 2, 0);
+
+                // rendered progressively, so that a page taking too long can be given up
+                RenderDeadline deadline(std::chrono::seconds(MAX_PDF_RENDER_SECONDS));
+                int status = FPDF_RenderPageBitmap_Start(bitmap, page, 0, 0, w, h, 2, 0, &deadline);
+                FPDF_RenderPage_Close(page);
                 FPDFBitmap_Destroy(bitmap);
                 FPDF_ClosePage(page);
                 FPDF_CloseDocument(pdf_doc);
@@ -169,6 +207,13 @@ std::unique_ptr<char[]> PdfiumReader::readBitmapFromPdf(int &w, int &h, int &ori
                     fa->unlinklocal(tmpFilePath);
                 }
 #endif
+                if (status != FPDF_RENDER_DONE)
+                {
+                    // paused (only done once the deadline has passed) or failed
+                    LOG_err << "Error rendering PDF page to create thumbnail for " << path << " " << status;
+                    return nullptr;
+                }
+
                 // Needed by Qt: ROTATION_DOWN = 3
                 orientation = 3;
                 return buffer;
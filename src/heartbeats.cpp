@@ -294,11 +294,11 @@ bool BackupInfoSync::operator!=(const BackupInfoSync &o) const
     return !(*this == o);
 }
 
-void BackupMonitor::beatBackupInfo(UnifiedSync& us)
+bool BackupMonitor::updateBackupInfo(UnifiedSync& us)
 {
     assert(syncs.onSyncThread());
 
-    if (us.mConfig.mSyncDeregisterSent) return;
+    if (us.mConfig.mSyncDeregisterSent) return false;
 
     // send registration or update in case we missed it
     updateOrRegisterSync(us);
@@ -306,7 +306,7 @@ void BackupMonitor::beatBackupInfo(UnifiedSync& us)
     if (ISUNDEF(us.mConfig.mBackupId))
     {
         LOG_warn << "Backup not registered yet. Skipping heartbeat...";
-        return;
+        return false;
     }
 
     std::shared_ptr<HeartBeatSyncInfo> hbs = us.mNextHeartbeat;
@@ -323,67 +323,118 @@ void BackupMonitor::beatBackupInfo(UnifiedSync& us)
     }
 
     hbs->updateSPHBStatus(us);
+    return true;
+}
 
-    auto elapsedSec = m_time(nullptr) - hbs->lastBeat();
+BackupMonitor::HeartBeat BackupMonitor::prepareBeat(UnifiedSync& us, m_time_t now)
+{
+    std::shared_ptr<HeartBeatSyncInfo> hbs = us.mNextHeartbeat;
 
-    if ( !hbs->mSending &&
-         (elapsedSec >= MAX_HEARBEAT_SECS_DELAY ||
-         (elapsedSec*10 >= FREQUENCY_HEARTBEAT_DS && hbs->mModified)))
-    {
+    hbs->setLastBeat(now);
 
-        hbs->setLastBeat(m_time(nullptr));
+    // spread the keep-alives, so backups registered together don't stay in lockstep
+    hbs->mKeepAliveJitter = int(syncs.rng.genuint32(HEARTBEAT_JITTER_SECS));
 
-        m_off_t inflightProgress = 0;
-        if (us.mSync)
-        {
-            inflightProgress = us.mSync->getInflightProgress();
-        }
+    m_off_t inflightProgress = 0;
+    if (us.mSync)
+    {
+        inflightProgress = us.mSync->getInflightProgress();
+    }
 
-        auto reportCounts = hbs->mSnapshotTransferCounts;
-        reportCounts -= hbs->mResolvedTransferCounts;
+    auto reportCounts = hbs->mSnapshotTransferCounts;
+    reportCounts -= hbs->mResolvedTransferCounts;
 
-        auto progress = uint8_t(100.0 * reportCounts.progress(inflightProgress));
+    auto progress = uint8_t(100.0 * reportCounts.progress(inflightProgress));
 
-        hbs->mSending = true;
+    hbs->mSending = true;
 
-        auto backupId = us.mConfig.mBackupId;
-        auto status = hbs->sphbStatus();
-        auto pendingUps = static_cast<uint32_t>(reportCounts.mUploads.mPending);
-        auto pendingDowns = static_cast<uint32_t>(reportCounts.mUploads.mPending);
-        auto lastAction = hbs->lastAction();
-        auto lastItemUpdated = hbs->lastItemUpdated();
+    HeartBeat beat;
+    beat.hbs = hbs;
+    beat.backupId = us.mConfig.mBackupId;
+    beat.status = hbs->sphbStatus();
+    beat.progress = int8_t(progress);
+    beat.pendingUps = static_cast<uint32_t>(reportCounts.mUploads.mPending);
+    beat.pendingDowns = static_cast<uint32_t>(reportCounts.mDownloads.mPending);
+    beat.lastAction = hbs->lastAction();
+    beat.lastItemUpdated = hbs->lastItemUpdated();
 
-        syncs.queueClient([=](MegaClient& mc, DBTableTransactionCommitter& committer)
-            {
-                mc.reqs.add(
-                    new CommandBackupPutHeartBeat(&mc, backupId, status,
-                        progress, pendingUps, pendingDowns,
-                        lastAction, lastItemUpdated,
-                        [hbs](Error){
-                            hbs->mSending = false;
-                        }));
-            });
-
-        if (progress >= 100)
-        {
-            // once we reach 100%, start counting again from 0 for any later sync activity.
-            hbs->mResolvedTransferCounts = hbs->mSnapshotTransferCounts;
-        }
+    if (progress >= 100)
+    {
+        // once we reach 100%, start counting again from 0 for any later sync activity.
+        hbs->mResolvedTransferCounts = hbs->mSnapshotTransferCounts;
     }
+
+    return beat;
 }
 
 void BackupMonitor::beat()
 {
     assert(syncs.onSyncThread());
 
+    // heartbeats are due with a granularity of seconds, no need to check more often
+    auto now = m_time(nullptr);
+    if (now == mLastScan) return;
+    mLastScan = now;
+
+    vector<UnifiedSync*> due;
+    vector<UnifiedSync*> keepAlives;
+
     // Only send heartbeats for enabled active syncs.
     for (auto& us : syncs.mSyncVec)
     {
-        if (us->mSync && us->mConfig.getEnabled())
+        if (!us->mSync || !us->mConfig.getEnabled() || !updateBackupInfo(*us))
         {
-            beatBackupInfo(*us);
+            continue;
         }
-    };
+
+        auto& hbs = *us->mNextHeartbeat;
+        if (hbs.mSending)
+        {
+            continue;
+        }
+
+        auto elapsedSec = now - hbs.lastBeat();
+        auto keepAliveSec = MAX_HEARBEAT_SECS_DELAY - hbs.mKeepAliveJitter;
+
+        if (elapsedSec >= keepAliveSec ||
+            (elapsedSec*10 >= FREQUENCY_HEARTBEAT_DS && hbs.mModified))
+        {
+            due.push_back(us.get());
+        }
+        else if (elapsedSec >= keepAliveSec - HEARTBEAT_BATCH_WINDOW_SECS)
+        {
+            keepAlives.push_back(us.get());
+        }
+    }
+
+    // unchanged backups stay quiet until their keep-alive
+    if (due.empty()) return;
+
+    // keep-alives that would be due shortly go out with this batch instead of on their own
+    due.insert(due.end(), keepAlives.begin(), keepAlives.end());
+
+    vector<HeartBeat> beats;
+    beats.reserve(due.size());
+    for (auto us : due)
+    {
+        beats.push_back(prepareBeat(*us, now));
+    }
+
+    // queued together, so they are dispatched to the API in the same request
+    syncs.queueClient([beats](MegaClient& mc, DBTableTransactionCommitter& committer)
+        {
+            for (auto& b : beats)
+            {
+                auto hbs = b.hbs;
+                mc.reqs.add(
+                    new CommandBackupPutHeartBeat(&mc, b.backupId, b.status,
+                        b.progress, b.pendingUps, b.pendingDowns,
+                        b.lastAction, b.lastItemUpdated,
+                        [hbs](Error){
+                            hbs->mSending = false;
+                        }));
+            }
+        });
 }
 
 #endif
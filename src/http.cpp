@@ -135,11 +135,13 @@ bool HttpIO::inetisback()
 
 void HttpIO::updatedownloadspeed(m_off_t size)
 {
+    downloadedBytes += size;
     downloadSpeed = downloadSpeedController.calculateSpeed(size);
 }
 
 void HttpIO::updateuploadspeed(m_off_t size)
 {
+    uploadedBytes += size;
     uploadSpeed = uploadSpeedController.calculateSpeed(size);
 }
 
@@ -373,6 +375,11 @@ bool HttpIO::setmaxdownloadspeed(m_off_t)
     return false;
 }
 
+bool HttpIO::setmultiplexing(bool)
+{
+    return false;
+}
+
 bool HttpIO::setmaxuploadspeed(m_off_t)
 {
     return false;
@@ -388,6 +395,403 @@ m_off_t HttpIO::getmaxuploadspeed()
     return 0;
 }
 
+EmulatedNetworkHttpIO::EmulatedNetworkHttpIO(std::unique_ptr<HttpIO> inner, unsigned seed)
+    : mInner(std::move(inner))
+    , mRandom(seed)
+{
+    APIURL = mInner->APIURL;
+    disablepkp = mInner->disablepkp;
+}
+
+EmulatedNetworkHttpIO::~EmulatedNetworkHttpIO()
+{
+    // whatever is still ours never reached the real network, or already finished there
+    for (auto& p : mPending)
+    {
+        p.first->httpstatus = 0;
+        p.first->status = REQ_FAILURE;
+        p.first->httpio = NULL;
+    }
+
+    for (auto& s : mSent)
+    {
+        if (s.second.held)
+        {
+            s.first->status = s.second.status;
+            s.first->httpio = NULL;
+        }
+        else
+        {
+            mInner->cancel(s.first);
+            s.first->httpio = NULL;
+        }
+    }
+}
+
+void EmulatedNetworkHttpIO::setConditions(const Conditions& conditions)
+{
+    lock_guard<mutex> g(mConditionsMutex);
+    mConditions = conditions;
+}
+
+void EmulatedNetworkHttpIO::setUrlConditions(const string& urlPart, const Conditions& conditions)
+{
+    lock_guard<mutex> g(mConditionsMutex);
+
+    for (auto& u : mUrlConditions)
+    {
+        if (u.first == urlPart)
+        {
+            u.second = conditions;
+            return;
+        }
+    }
+
+    mUrlConditions.emplace_back(urlPart, conditions);
+}
+
+void EmulatedNetworkHttpIO::clearUrlConditions()
+{
+    lock_guard<mutex> g(mConditionsMutex);
+    mUrlConditions.clear();
+}
+
+uint64_t EmulatedNetworkHttpIO::injectedFailures() const
+{
+    return mInjectedFailures.load();
+}
+
+EmulatedNetworkHttpIO::Conditions EmulatedNetworkHttpIO::conditionsFor(const string& url)
+{
+    lock_guard<mutex> g(mConditionsMutex);
+
+    for (auto& u : mUrlConditions)
+    {
+        if (url.find(u.first) != string::npos)
+        {
+            return u.second;
+        }
+    }
+
+    return mConditions;
+}
+
+void EmulatedNetworkHttpIO::post(HttpReq* req, const char* data, unsigned len)
+{
+    Conditions c = conditionsFor(req->posturl);
+
+    unsigned delayMs = c.latencyMs;
+    bool fail = false;
+    {
+        lock_guard<mutex> g(mConditionsMutex);   // for mRandom
+
+        if (c.jitterMs)
+        {
+            delayMs += std::uniform_int_distribution<unsigned>(0, c.jitterMs)(mRandom);
+        }
+
+        if (c.lossPercent)
+        {
+            fail = std::uniform_int_distribution<unsigned>(0, 99)(mRandom) < c.lossPercent;
+        }
+    }
+
+    req->status = REQ_INFLIGHT;
+    req->httpiohandle = NULL;
+    req->httpio = this;
+
+    Pending& p = mPending[req];
+    p.data = data;
+    p.len = len;
+    p.due = Clock::now() + std::chrono::milliseconds(delayMs);
+    p.fail = fail;
+}
+
+void EmulatedNetworkHttpIO::cancel(HttpReq* req)
+{
+    bool wasOurs = mPending.erase(req) > 0;
+
+    auto it = mSent.find(req);
+    if (it != mSent.end())
+    {
+        wasOurs = it->second.held;
+        mSent.erase(it);
+
+        if (!wasOurs)
+        {
+            mInner->cancel(req);
+        }
+    }
+
+    if (wasOurs)
+    {
+        req->httpstatus = 0;
+        req->status = REQ_FAILURE;
+    }
+}
+
+m_off_t EmulatedNetworkHttpIO::postpos(void* handle)
+{
+    return handle ? mInner->postpos(handle) : 0;
+}
+
+bool EmulatedNetworkHttpIO::releaseDue(Clock::time_point now)
+{
+    bool released = false;
+
+    for (auto it = mPending.begin(); it != mPending.end(); )
+    {
+        if (it->second.due > now)
+        {
+            ++it;
+            continue;
+        }
+
+        HttpReq* req = it->first;
+        Pending p = it->second;
+        it = mPending.erase(it);
+        released = true;
+
+        if (p.fail)
+        {
+            LOG_debug << "Emulated network: dropping request to " << req->posturl;
+            ++mInjectedFailures;
+            req->httpstatus = 0;
+            req->status = REQ_FAILURE;
+            req->httpio = NULL;
+            continue;
+        }
+
+        Sent& s = mSent[req];
+        s.sent = now;
+        s.bytesPerSecond = conditionsFor(req->posturl).bytesPerSecond;
+
+        mInner->post(req, p.data, p.len);
+
+        if (req->httpio == mInner.get())
+        {
+            req->httpio = this;
+        }
+    }
+
+    for (auto it = mSent.begin(); it != mSent.end(); )
+    {
+        if (it->second.held && it->second.heldUntil <= now)
+        {
+            it->first->status = it->second.status;
+            it->first->httpio = NULL;
+            it = mSent.erase(it);
+            released = true;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    return released;
+}
+
+void EmulatedNetworkHttpIO::holdCompleted(Clock::time_point now)
+{
+    for (auto it = mSent.begin(); it != mSent.end(); )
+    {
+        HttpReq* req = it->first;
+        Sent& s = it->second;
+
+        if (s.held || req->status == REQ_INFLIGHT)
+        {
+            if (req->httpio == mInner.get())
+            {
+                req->httpio = this;
+            }
+
+            ++it;
+            continue;
+        }
+
+        if (s.bytesPerSecond > 0)
+        {
+            m_off_t bytes = std::max<m_off_t>(req->contentlength, m_off_t(req->in.size())) + m_off_t(req->outpos);
+            auto until = s.sent + std::chrono::milliseconds(bytes * 1000 / s.bytesPerSecond);
+
+            if (until > now)
+            {
+                // keep it in flight until the capped link would have carried it
+                s.held = true;
+                s.heldUntil = until;
+                s.status = req->status;
+                req->status = REQ_INFLIGHT;
+                req->httpio = this;
+                ++it;
+                continue;
+            }
+        }
+
+        it = mSent.erase(it);
+    }
+}
+
+bool EmulatedNetworkHttpIO::nextDue(Clock::time_point& due) const
+{
+    bool found = false;
+
+    for (auto& p : mPending)
+    {
+        if (!found || p.second.due < due)
+        {
+            due = p.second.due;
+            found = true;
+        }
+    }
+
+    for (auto& s : mSent)
+    {
+        if (s.second.held && (!found || s.second.heldUntil < due))
+        {
+            due = s.second.heldUntil;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+void EmulatedNetworkHttpIO::pushState()
+{
+    mInner->APIURL = APIURL;
+    mInner->disablepkp = disablepkp;
+    mInner->success = success;
+}
+
+void EmulatedNetworkHttpIO::pullState()
+{
+    success = mInner->success;
+    noinetds = mInner->noinetds;
+
+    if (EVER(mInner->lastdata) && (!EVER(lastdata) || mInner->lastdata > lastdata))
+    {
+        lastdata = mInner->lastdata;
+    }
+
+    if (mInner->inetisback())
+    {
+        inetback = true;
+    }
+
+    downloadSpeed = mInner->downloadSpeed;
+    uploadSpeed = mInner->uploadSpeed;
+    downloadedBytes = mInner->downloadedBytes;
+    uploadedBytes = mInner->uploadedBytes;
+}
+
+bool EmulatedNetworkHttpIO::doio()
+{
+    pushState();
+
+    bool done = releaseDue(Clock::now());
+    done |= mInner->doio();
+    holdCompleted(Clock::now());
+
+    pullState();
+    return done;
+}
+
+void EmulatedNetworkHttpIO::addevents(Waiter* waiter, int flags)
+{
+    mInner->addevents(waiter, flags);
+
+    Clock::time_point due;
+    if (nextDue(due))
+    {
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(due - Clock::now()).count();
+        dstime ds = ms > 0 ? dstime((ms + 99) / 100) : 0;
+
+        if (ds < waiter->maxds)
+        {
+            waiter->maxds = ds;
+        }
+    }
+}
+
+int EmulatedNetworkHttpIO::checkevents(Waiter* waiter)
+{
+    int r = mInner->checkevents(waiter);
+
+    Clock::time_point due;
+    if (nextDue(due) && due <= Clock::now())
+    {
+        r |= Waiter::NEEDEXEC;
+    }
+
+    return r;
+}
+
+void EmulatedNetworkHttpIO::lock()
+{
+    mInner->lock();
+}
+
+void EmulatedNetworkHttpIO::unlock()
+{
+    mInner->unlock();
+}
+
+void EmulatedNetworkHttpIO::disconnect()
+{
+    mInner->disconnect();
+}
+
+void EmulatedNetworkHttpIO::setuseragent(string* useragent)
+{
+    mInner->setuseragent(useragent);
+}
+
+Proxy* EmulatedNetworkHttpIO::getautoproxy()
+{
+    return mInner->getautoproxy();
+}
+
+bool EmulatedNetworkHttpIO::setmaxdownloadspeed(m_off_t bpslimit)
+{
+    return mInner->setmaxdownloadspeed(bpslimit);
+}
+
+bool EmulatedNetworkHttpIO::setmaxuploadspeed(m_off_t bpslimit)
+{
+    return mInner->setmaxuploadspeed(bpslimit);
+}
+
+m_off_t EmulatedNetworkHttpIO::getmaxdownloadspeed()
+{
+    return mInner->getmaxdownloadspeed();
+}
+
+m_off_t EmulatedNetworkHttpIO::getmaxuploadspeed()
+{
+    return mInner->getmaxuploadspeed();
+}
+
+bool EmulatedNetworkHttpIO::setmultiplexing(bool enable)
+{
+    return mInner->setmultiplexing(enable);
+}
+
+bool EmulatedNetworkHttpIO::supportsincrementalresponses() const
+{
+    return mInner->supportsincrementalresponses();
+}
+
+bool EmulatedNetworkHttpIO::cacheresolvedurls(const std::vector<string>& urls, std::vector<string>&& ips)
+{
+    return mInner->cacheresolvedurls(urls, std::move(ips));
+}
+
+void EmulatedNetworkHttpIO::prefetchdns(const std::vector<string>& hosts)
+{
+    mInner->prefetchdns(hosts);
+}
+
 void HttpReq::post(MegaClient* client, const char* data, unsigned len)
 {
     if (httpio)
@@ -404,6 +808,9 @@ void HttpReq::post(MegaClient* client, const char* data, unsigned len)
     inpurge = 0;
     method = METHOD_POST;
     contentlength = -1;
+    timings = Timings();
+    contentencoded = false;
+    decodedlength = false;
     lastdata = Waiter::ds;
 
     DEBUG_TEST_HOOK_HTTPREQ_POST(this)
@@ -427,6 +834,9 @@ void HttpReq::get(MegaClient *client)
     inpurge = 0;
     method = METHOD_GET;
     contentlength = -1;
+    timings = Timings();
+    contentencoded = false;
+    decodedlength = false;
     lastdata = Waiter::ds;
 
     httpio->post(this);
@@ -448,6 +858,8 @@ void HttpReq::dns(MegaClient *client)
     inpurge = 0;
     method = METHOD_NONE;
     contentlength = -1;
+    contentencoded = false;
+    decodedlength = false;
     lastdata = Waiter::ds;
 
     httpio->post(this);
@@ -488,11 +900,24 @@ HttpReq::~HttpReq()
         httpio->cancel(this);
     }
 
-    delete[] buf;
+    BandwidthScheduler::instance().release(this);
+
+    for (auto segment : segments)
+    {
+        delete segment;
+    }
+
+    TransferBufferPool::release(buf);
 }
 
 void HttpReq::init()
 {
+    for (auto segment : segments)
+    {
+        delete segment;
+    }
+    segments.clear();
+
     httpstatus = 0;
     inpurge = 0;
     sslcheckfailed = false;
@@ -535,6 +960,39 @@ void HttpReq::setreq(const char* u, contenttype_t t)
 // add data to fixed or variable buffer
 void HttpReq::put(void* data, unsigned len, bool purge)
 {
+    if (segmentsize)
+    {
+        byte* src = static_cast<byte*>(data);
+        while (len)
+        {
+            if (!buf)
+            {
+                // padded as for FilePiece, so the data can be decrypted in place
+                buf = TransferBufferPool::allocate(segmentsize + SymmCipher::BLOCKSIZE);
+                buflen = segmentsize;
+                bufpos = 0;
+                inpurge = 0;
+            }
+
+            unsigned n = std::min<unsigned>(len, unsigned(buflen - bufpos));
+            memcpy(buf + bufpos, src, n);
+            bufpos += n;
+            src += n;
+            len -= n;
+
+            if (bufpos == buflen)
+            {
+                // keep contentlength comparable with what remains in buf
+                if (contentlength > 0)
+                {
+                    contentlength -= bufpos;
+                }
+                segments.push_back(releasesegment());
+            }
+        }
+        return;
+    }
+
     if (buf)
     {
         if (bufpos + len > buflen)
@@ -559,6 +1017,176 @@ void HttpReq::put(void* data, unsigned len, bool purge)
 }
 
 
+namespace {
+
+// each pooled block carries its capacity just ahead of the data; 16 bytes keeps the data SIMD aligned
+const size_t POOLHEADER = 16;
+const size_t MINPOOLCLASS = 4096;
+
+struct TransferBufferPoolState
+{
+    std::mutex m;
+    std::map<size_t, std::vector<byte*>> freeLists;  // by capacity
+    size_t maxCachedBytes = 256 * 1024 * 1024;
+    TransferBufferPool::Stats stats;
+
+    // frees cached blocks, largest first, until at most limit bytes remain
+    void trimTo(size_t limit)
+    {
+        while (stats.cachedBytes > limit && !freeLists.empty())
+        {
+            auto it = std::prev(freeLists.end());
+            while (!it->second.empty() && stats.cachedBytes > limit)
+            {
+                delete[] it->second.back();
+                it->second.pop_back();
+                stats.cachedBytes -= it->first;
+                --stats.cachedBuffers;
+            }
+            if (it->second.empty())
+            {
+                freeLists.erase(it);
+            }
+        }
+    }
+
+    ~TransferBufferPoolState()
+    {
+        trimTo(0);
+    }
+};
+
+TransferBufferPoolState& poolState()
+{
+    static TransferBufferPoolState state;
+    return state;
+}
+
+}
+
+size_t TransferBufferPool::capacityFor(size_t len)
+{
+    if (len <= MINPOOLCLASS)
+    {
+        return MINPOOLCLASS;
+    }
+
+    if (len > MAXPOOLEDSIZE)
+    {
+        return (len + POOLHEADER - 1) & ~(POOLHEADER - 1);
+    }
+
+    // four classes per power of two keeps rounding waste under 25%
+    size_t p = MINPOOLCLASS;
+    while (p * 2 < len)
+    {
+        p *= 2;
+    }
+    size_t step = p / 4;
+    return (len + step - 1) / step * step;
+}
+
+byte* TransferBufferPool::allocate(size_t len)
+{
+    if (!len)
+    {
+        return NULL;
+    }
+
+    size_t capacity = capacityFor(len);
+    byte* block = NULL;
+
+    {
+        TransferBufferPoolState& state = poolState();
+        lock_guard<mutex> g(state.m);
+        ++state.stats.allocations;
+        state.stats.outstandingBytes += capacity;
+
+        auto it = state.freeLists.find(capacity);
+        if (it != state.freeLists.end() && !it->second.empty())
+        {
+            block = it->second.back();
+            it->second.pop_back();
+            state.stats.cachedBytes -= capacity;
+            --state.stats.cachedBuffers;
+            ++state.stats.poolHits;
+        }
+    }
+
+    if (!block)
+    {
+        block = new byte[capacity + POOLHEADER];
+        memcpy(block, &capacity, sizeof capacity);
+    }
+
+    return block + POOLHEADER;
+}
+
+void TransferBufferPool::release(byte* b)
+{
+    if (!b)
+    {
+        return;
+    }
+
+    byte* block = b - POOLHEADER;
+    size_t capacity;
+    memcpy(&capacity, block, sizeof capacity);
+
+    {
+        TransferBufferPoolState& state = poolState();
+        lock_guard<mutex> g(state.m);
+        ++state.stats.releases;
+        state.stats.outstandingBytes -= capacity;
+
+        if (capacity <= MAXPOOLEDSIZE && state.stats.cachedBytes + capacity <= state.maxCachedBytes)
+        {
+            state.freeLists[capacity].push_back(block);
+            state.stats.cachedBytes += capacity;
+            ++state.stats.cachedBuffers;
+            return;
+        }
+
+        ++state.stats.discards;
+    }
+
+    delete[] block;
+}
+
+void TransferBufferPool::setMaxCachedBytes(size_t bytes)
+{
+    TransferBufferPoolState& state = poolState();
+    lock_guard<mutex> g(state.m);
+    state.maxCachedBytes = bytes;
+    state.trimTo(bytes);
+}
+
+size_t TransferBufferPool::maxCachedBytes()
+{
+    TransferBufferPoolState& state = poolState();
+    lock_guard<mutex> g(state.m);
+    return state.maxCachedBytes;
+}
+
+void TransferBufferPool::trim()
+{
+    TransferBufferPoolState& state = poolState();
+    lock_guard<mutex> g(state.m);
+    state.trimTo(0);
+}
+
+TransferBufferPool::Stats TransferBufferPool::stats(bool reset)
+{
+    TransferBufferPoolState& state = poolState();
+    lock_guard<mutex> g(state.m);
+    Stats result = state.stats;
+    if (reset)
+    {
+        state.stats.allocations = state.stats.poolHits = state.stats.releases = state.stats.discards = 0;
+    }
+    return result;
+}
+
 HttpReq::http_buf_t::http_buf_t(byte* b, size_t s, size_t e)
     : start(s), end(e), buf(b)
 {
@@ -566,7 +1194,7 @@ HttpReq::http_buf_t::http_buf_t(byte* b, size_t s, size_t e)
 
 HttpReq::http_buf_t::~http_buf_t()
 {
-    delete[] buf;
+    TransferBufferPool::release(buf);
 }
 
 void HttpReq::http_buf_t::swap(http_buf_t& other)
@@ -608,6 +1236,16 @@ struct HttpReq::http_buf_t* HttpReq::release_buf()
 }
 
 
+HttpReq::http_buf_t* HttpReq::releasesegment()
+{
+    HttpReq::http_buf_t* result = new HttpReq::http_buf_t(buf, inpurge, size_t(bufpos));
+    buf = NULL;
+    buflen = 0;
+    bufpos = 0;
+    inpurge = 0;
+    return result;
+}
+
 char* HttpReq::data()
 {
     return (char*)in.data() + inpurge;
@@ -618,6 +1256,20 @@ size_t HttpReq::size()
     return in.size() - inpurge;
 }
 
+size_t HttpReq::bufferedBytes() const
+{
+    size_t bytes = MemoryReport::heapBytes(in) + MemoryReport::heapBytes(outbuf);
+    if (out && out != &outbuf)
+    {
+        bytes += MemoryReport::heapBytes(*out);
+    }
+    if (buf)
+    {
+        bytes += static_cast<size_t>(buflen);
+    }
+    return bytes + segments.size() * segmentsize;
+}
+
 // set amount of purgeable in data at 0
 void HttpReq::purge(size_t numbytes)
 {
@@ -627,7 +1279,7 @@ void HttpReq::purge(size_t numbytes)
 // set total response size
 void HttpReq::setcontentlength(m_off_t len)
 {
-    if (!buf && type != REQ_BINARY)
+    if (!buf && type != REQ_BINARY && !incremental)
     {
         in.reserve(static_cast<size_t>(len));
     }
@@ -704,16 +1356,8 @@ void HttpReqDL::prepare(const char* tempurl, SymmCipher* /*key*/,
     if (!buf || buflen != size)
     {
         // (re)allocate buffer
-        if (buf)
-        {
-            delete[] buf;
-            buf = NULL;
-        }
-
-        if (size)
-        {
-            buf = new byte[(size + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE];
-        }
+        TransferBufferPool::release(buf);
+        buf = TransferBufferPool::allocate((size + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE);
         buflen = size;
     }
 }
@@ -783,7 +1427,7 @@ bool EncryptByChunks::encrypt(m_off_t pos, m_off_t npos, string& urlSuffix)
 
         // The chunk is fully encrypted but finished==false for now,
         // we only set finished after confirmation of the chunk uploading.
-        macs->ctr_encrypt(startpos, key, buf, unsigned(chunksize), startpos, ctriv, false);
+        macs->ctr_encrypt(startpos, key, buf, unsigned(chunksize), startpos, ctriv, false, nextsource(unsigned(chunksize)));
 
         LOG_debug << "Encrypted chunk: " << startpos << " - " << endpos << "   Size: " << chunksize;
 
@@ -804,9 +1448,10 @@ bool EncryptByChunks::encrypt(m_off_t pos, m_off_t npos, string& urlSuffix)
 }
 
 
-EncryptBufferByChunks::EncryptBufferByChunks(byte* b, SymmCipher* k, chunkmac_map* m, uint64_t iv)
+EncryptBufferByChunks::EncryptBufferByChunks(byte* b, SymmCipher* k, chunkmac_map* m, uint64_t iv, const byte* source)
     : EncryptByChunks(k, m, iv)
     , chunkstart(b)
+    , sourcestart(source)
 {
 }
 
@@ -817,15 +1462,27 @@ byte* EncryptBufferByChunks::nextbuffer(unsigned bufsize)
     return pos;
 }
 
+const byte* EncryptBufferByChunks::nextsource(unsigned bufsize)
+{
+    // nextbuffer() already moved on: this is the same chunk
+    const byte* pos = sourcestart;
+    if (sourcestart)
+    {
+        sourcestart += bufsize;
+    }
+    return pos;
+}
+
 // prepare chunk for uploading: mac and encrypt
 void HttpReqUL::prepare(const char* tempurl, SymmCipher* key,
                         uint64_t ctriv, m_off_t pos,
                         m_off_t npos)
 {
-    EncryptBufferByChunks eb((byte*)out->data(), key, &mChunkmacs, ctriv);
+    EncryptBufferByChunks eb((byte*)out->data(), key, &mChunkmacs, ctriv, mSource ? mSource->data : nullptr);
 
     string urlSuffix;
     eb.encrypt(pos, npos, urlSuffix);
+    mSource.reset();
 
     // unpad for POSTing
     size = (unsigned)(npos - pos);
@@ -834,6 +1491,10 @@ void HttpReqUL::prepare(const char* tempurl, SymmCipher* key,
     setreq((tempurl + urlSuffix).c_str(), REQ_BINARY);
 }
 
+HttpReqUL::~HttpReqUL()
+{
+}
+
 // number of bytes sent in this request
 m_off_t HttpReqUL::transferred(MegaClient* client)
 {
@@ -854,12 +1515,18 @@ void SpeedController::requestStarted()
 {
     mRequestPos = 0;
     mRequestStart = mLastRequestUpdate = Waiter::ds;
+    mRequestFirstByte = 0;
 }
 
 m_off_t SpeedController::requestProgressed(m_off_t newPos)
 {
     if (newPos > mRequestPos)
     {
+        if (!mRequestPos)
+        {
+            mRequestFirstByte = Waiter::ds - mRequestStart;
+        }
+
         m_off_t delta = newPos - mRequestPos;
         calculateSpeed(delta);
         mRequestPos = newPos;
@@ -927,6 +1594,177 @@ m_off_t SpeedController::getMeanSpeed()
     return mMeanSpeed;
 }
 
+const dstime BandwidthScheduler::BURST_DS;
+const m_off_t BandwidthScheduler::MIN_BURST;
+const dstime BandwidthScheduler::IDLE_DS;
+
+BandwidthScheduler::BandwidthScheduler()
+{
+    // interactive traffic first, backups only get a small part while anything else is running
+    mWeights[USER] = 4;
+    mWeights[SYNC] = 2;
+    mWeights[BACKUP] = 1;
+    mWeights[STREAMING] = 8;
+}
+
+BandwidthScheduler& BandwidthScheduler::instance()
+{
+    static BandwidthScheduler scheduler;
+    return scheduler;
+}
+
+void BandwidthScheduler::setlimit(direction_t d, m_off_t bps)
+{
+    assert(d == GET || d == PUT);
+
+    lock_guard<mutex> g(mMutex);
+    Bucket& bucket = mBuckets[d];
+    bucket.limit = std::max<m_off_t>(bps, 0);
+
+    // start from an empty bucket
+    bucket.spare = 0;
+    bucket.lastrefill = 0;
+    bucket.flows.clear();
+}
+
+m_off_t BandwidthScheduler::getlimit(direction_t d) const
+{
+    return d == GET || d == PUT ? mBuckets[d].limit.load() : 0;
+}
+
+void BandwidthScheduler::setweight(Category c, unsigned weight)
+{
+    lock_guard<mutex> g(mMutex);
+    mWeights[c] = weight;
+}
+
+unsigned BandwidthScheduler::getweight(Category c) const
+{
+    lock_guard<mutex> g(mMutex);
+    return mWeights[c];
+}
+
+size_t BandwidthScheduler::acquire(direction_t d, const void* request, Category c, size_t len, bool partial, dstime now)
+{
+    if (!len || !getlimit(d))
+    {
+        return len;
+    }
+
+    lock_guard<mutex> g(mMutex);
+    Bucket& bucket = mBuckets[d];
+
+    auto it = bucket.flows.find(request);
+    if (it == bucket.flows.end())
+    {
+        it = bucket.flows.emplace(request, Flow{c, 0, now}).first;
+    }
+
+    Flow& flow = it->second;
+    flow.category = c;
+    flow.lastactive = now;
+
+    m_off_t available = std::max<m_off_t>(flow.credit, 0) + bucket.spare;
+    if (available <= 0)
+    {
+        return 0;
+    }
+
+    m_off_t granted = partial ? std::min<m_off_t>(available, m_off_t(len)) : m_off_t(len);
+
+    // own credit first, then the pool; a whole grant may leave the request in debt
+    m_off_t fromspare = std::min<m_off_t>(bucket.spare, std::max<m_off_t>(granted - std::max<m_off_t>(flow.credit, 0), 0));
+    bucket.spare -= fromspare;
+    flow.credit -= granted - fromspare;
+
+    return size_t(granted);
+}
+
+void BandwidthScheduler::refill(direction_t d, dstime now)
+{
+    if (!getlimit(d))
+    {
+        return;
+    }
+
+    lock_guard<mutex> g(mMutex);
+    Bucket& bucket = mBuckets[d];
+
+    if (now <= bucket.lastrefill)
+    {
+        return;
+    }
+
+    m_off_t limit = bucket.limit;
+    dstime elapsed = bucket.lastrefill ? std::min(now - bucket.lastrefill, BURST_DS) : BURST_DS;
+    bucket.lastrefill = now;
+
+    m_off_t capacity = std::max(limit * BURST_DS / 10, MIN_BURST);
+    m_off_t tokens = limit * elapsed / 10;
+
+    // requests per category, forgetting the idle ones
+    std::array<unsigned, NUM_CATEGORIES> requests = {};
+    for (auto it = bucket.flows.begin(); it != bucket.flows.end(); )
+    {
+        if (now - it->second.lastactive > IDLE_DS)
+        {
+            bucket.flows.erase(it++);
+        }
+        else
+        {
+            requests[it->second.category]++;
+            it++;
+        }
+    }
+
+    m_off_t totalweight = 0;
+    for (int c = 0; c < NUM_CATEGORIES; c++)
+    {
+        if (requests[c])
+        {
+            totalweight += mWeights[c];
+        }
+    }
+
+    if (totalweight)
+    {
+        for (auto& f : bucket.flows)
+        {
+            Flow& flow = f.second;
+            m_off_t weight = mWeights[flow.category];
+            m_off_t shares = totalweight * requests[flow.category];
+            m_off_t cap = capacity * weight / shares;
+
+            flow.credit += tokens * weight / shares;
+            if (flow.credit > cap)
+            {
+                bucket.spare += flow.credit - cap;
+                flow.credit = cap;
+            }
+        }
+    }
+    else
+    {
+        bucket.spare += tokens;
+    }
+
+    bucket.spare = std::min(bucket.spare, capacity);
+}
+
+void BandwidthScheduler::release(const void* request)
+{
+    if (!getlimit(GET) && !getlimit(PUT))
+    {
+        return;
+    }
+
+    lock_guard<mutex> g(mMutex);
+    for (Bucket& bucket : mBuckets)
+    {
+        bucket.flows.erase(request);
+    }
+}
+
 GenericHttpReq::GenericHttpReq(PrnGen &rng, bool binary)
     : HttpReq(binary), bt(rng), maxbt(rng)
 {
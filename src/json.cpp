@@ -18,8 +18,11 @@
  * You should have received a copy of the license along with this
  * program.
  */
+#include <algorithm>
 #include <cctype>
 #include <cstdint>
+#include <cstring>
+#include <limits>
 
 #include "mega/json.h"
 #include "mega/base64.h"
@@ -34,7 +37,6 @@ bool JSON::storeobject(string* s)
 {
     int openobject[2] = { 0 };
     const char* ptr;
-    bool escaped = false;
 
     while (*(const signed char*)pos > 0 && *pos <= ' ')
     {
@@ -71,9 +73,14 @@ bool JSON::storeobject(string* s)
         {
             ptr++;
 
-            while (*ptr && (escaped || *ptr != '"'))
+            for (;;)
             {
-                escaped = *ptr == '\\' && !escaped;
+                // runs of plain characters at once
+                ptr += strcspn(ptr, "\"\\");
+                if (*ptr != '\\' || !*++ptr)
+                {
+                    break;
+                }
                 ptr++;
             }
 
@@ -220,13 +227,10 @@ std::string JSON::getname()
 
     if (*ptr++ == '"')
     {
-        while (*ptr && *ptr != '"')
-        {
-            name += *ptr;
-            ptr++;
-        }
+        const char* end = ptr + strcspn(ptr, "\"");
+        name.assign(ptr, end - ptr);
 
-        pos = ptr + 2;
+        pos = end + 2;
     }
 
     return name;
@@ -244,11 +248,7 @@ std::string JSON::getnameWithoutAdvance() const
 
     if (*ptr++ == '"')
     {
-        while (*ptr && *ptr != '"')
-        {
-            name += *ptr;
-            ptr++;
-        }
+        name.assign(ptr, strcspn(ptr, "\""));
     }
 
     return name;
@@ -357,8 +357,9 @@ bool JSON::storebinary(string* dst)
             return false;
         }
 
-        dst->resize((ptr - pos - 1) / 4 * 3 + 3);
-        dst->resize(Base64::atob(pos + 1, (byte*)dst->data(), int(dst->size())));
+        size_t len = size_t(ptr - pos - 1);
+        dst->resize(len / 4 * 3 + 3);
+        dst->resize(Base64::decode(pos + 1, len, (byte*)dst->data(), dst->size()));
 
         // skip string
         storeobject();
@@ -725,6 +726,19 @@ void JSON::begin(const char* json)
     pos = json;
 }
 
+// compare s with the remainder of quoted string without copying it (no unescaping)
+bool JSON::equalstring(const string& s, const char* p)
+{
+    if (!p)
+    {
+        return false;
+    }
+
+    const char* pp = strchr(p, '"');
+    size_t len = pp ? size_t(pp - p) : strlen(p);
+    return s.size() == len && !memcmp(s.data(), p, len);
+}
+
 // copy remainder of quoted string (no unescaping, use for base64 data only)
 void JSON::copystring(string* s, const char* p)
 {
@@ -837,13 +851,12 @@ void JSONWriter::arg(const char* name, NodeHandle h)
 
 void JSONWriter::arg(const char* name, const byte* value, int len)
 {
-    char* buf = new char[len * 4 / 3 + 4];
-
-    Base64::btoa(value, len, buf);
-
-    arg(name, buf);
-
-    delete[] buf;
+    addcomma();
+    mJson.append("\"");
+    mJson.append(name);
+    mJson.append("\":\"");
+    appendbase64(value, len);
+    mJson.append("\"");
 }
 
 void JSONWriter::arg_B64(const char* n, const string& data)
@@ -960,15 +973,8 @@ void JSONWriter::element(handle h, int len)
 
 void JSONWriter::element(const byte* data, int len)
 {
-    char* buf = new char[len * 4 / 3 + 4];
-
-    len = Base64::btoa(data, len, buf);
-
     mJson.append(elements() ? ",\"" : "\"");
-    mJson.append(buf, len);
-
-    delete[] buf;
-
+    appendbase64(data, len);
     mJson.append("\"");
 }
 
@@ -1014,6 +1020,43 @@ size_t JSONWriter::size() const
     return mJson.size();
 }
 
+void JSONWriter::appendbase64(const byte* data, int len)
+{
+    size_t at = mJson.size();
+    size_t n = len > 0 ? size_t(len) : 0;
+
+    mJson.resize(at + Base64::encodedLength(n));
+    Base64::encode(data, n, &mJson[at]);
+}
+
+void JSONWriter::reserve(size_t len)
+{
+    mJson.reserve(mJson.size() + len);
+}
+
+// buffers of finished commands, ready for the next ones built on the same thread
+static thread_local vector<string> recycledWriterBuffers;
+
+void JSONWriter::reusebuffer()
+{
+    if (mJson.empty() && !recycledWriterBuffers.empty())
+    {
+        mJson.swap(recycledWriterBuffers.back());
+        recycledWriterBuffers.pop_back();
+    }
+}
+
+void JSONWriter::recycle()
+{
+    if (recycledWriterBuffers.size() < MAX_RECYCLED && mJson.capacity() <= MAX_RECYCLED_CAPACITY)
+    {
+        mJson.clear();
+        recycledWriterBuffers.push_back(std::move(mJson));
+    }
+    mJson = string();
+    mLevel = -1;
+}
+
 int JSONWriter::elements()
 {
     assert(mLevel >= 0);
@@ -1066,5 +1109,103 @@ string JSONWriter::escape(const char* data, size_t length) const
     return result;
 }
 
-} // namespace
+JSONArrayScanner::JSONArrayScanner(const string& prefix)
+    : mPrefix(prefix)
+{
+}
 
+JSONArrayScanner::Status JSONArrayScanner::next(const char* data, size_t len, size_t& begin, size_t& end)
+{
+    if (!mStarted)
+    {
+        if (memcmp(data, mPrefix.data(), std::min(len, mPrefix.size())))
+        {
+            return MISMATCH;
+        }
+
+        if (len < mPrefix.size())
+        {
+            return INCOMPLETE;
+        }
+
+        mStarted = true;
+        mScan = mBegin = mLastEnd = mPrefix.size();
+    }
+
+    for (; !mEnded && mScan < len; mScan++)
+    {
+        char c = data[mScan];
+
+        if (mInString)
+        {
+            if (mEscape)
+            {
+                mEscape = false;
+            }
+            else if (c == '\\')
+            {
+                mEscape = true;
+            }
+            else if (c == '"')
+            {
+                mInString = false;
+            }
+        }
+        else if (c == '"')
+        {
+            mInString = true;
+        }
+        else if (c == '{' || c == '[')
+        {
+            mDepth++;
+        }
+        else if (c == '}' || c == ']')
+        {
+            if (!mDepth)
+            {
+                // closing bracket of the array itself
+                mEnded = true;
+                break;
+            }
+
+            if (!--mDepth)
+            {
+                mLastEnd = mScan + 1;
+            }
+        }
+    }
+
+    if (mLastEnd > mBegin)
+    {
+        begin = mBegin;
+        end = mLastEnd;
+        mBegin = mLastEnd;
+
+        if (data[begin] == ',')
+        {
+            begin++;
+        }
+
+        return ELEMENTS;
+    }
+
+    if (mEnded)
+    {
+        begin = mScan;
+        end = len;
+        return ENDED;
+    }
+
+    return INCOMPLETE;
+}
+
+void JSONArrayScanner::consumed(size_t n)
+{
+    assert(n <= mBegin);
+
+    mScan -= n;
+    mBegin -= n;
+    mLastEnd -= n;
+}
+
+} // namespace
@@ -24,7 +24,11 @@
 
 #include "mega/logging.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <ctime>
+#include <memory>
 
 namespace mega {
 
@@ -78,6 +82,197 @@ std::ostream& operator<< (std::ostream& ostr, const std::system_error &se)
 }
 
 
+void LogRecord::addText(const char* v, size_t len)
+{
+    Arg* a = nextArg(ARG_TEXT);
+    if (!a) return;
+    len = std::min(len, TEXT_CHARS - textUsed);
+    memcpy(text + textUsed, v, len);
+    a->u = textUsed;
+    a->textLength = static_cast<uint16_t>(len);
+    textUsed += static_cast<unsigned>(len);
+}
+
+std::string LogRecord::toString() const
+{
+    std::string out;
+    if (!format) return out;
+
+    out.reserve(strlen(format) + numArgs * 16);
+    unsigned next = 0;
+    char buf[32];
+    for (const char* c = format; *c; ++c)
+    {
+        if (c[0] != '{' || c[1] != '}')
+        {
+            out += *c;
+            continue;
+        }
+        ++c;
+
+        if (next >= numArgs)
+        {
+            out += "{}";
+            continue;
+        }
+
+        const Arg& a = args[next++];
+        switch (a.type)
+        {
+            case ARG_INT:
+                snprintf(buf, sizeof(buf), "%lld", a.i);
+                out += buf;
+                break;
+            case ARG_UINT:
+                snprintf(buf, sizeof(buf), "%llu", a.u);
+                out += buf;
+                break;
+            case ARG_DOUBLE:
+                snprintf(buf, sizeof(buf), "%g", a.d);
+                out += buf;
+                break;
+            case ARG_POINTER:
+                snprintf(buf, sizeof(buf), "%p", a.p);
+                out += buf;
+                break;
+            case ARG_TEXT:
+                out.append(text + a.u, a.textLength);
+                break;
+        }
+    }
+    return out;
+}
+
+namespace {
+
+// Bounded multi-producer queue (Vyukov): each cell carries a sequence number
+// telling producers and the consumer whose turn it is, so a push is one CAS
+// plus a copy, and never blocks or allocates.
+class LogRecordRing
+{
+    static const size_t CAPACITY = 4096;    // power of two
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        LogRecord record;
+    };
+
+    std::unique_ptr<Cell[]> mCells;
+    alignas(64) std::atomic<size_t> mEnqueuePos;
+    alignas(64) std::atomic<size_t> mDequeuePos;
+
+public:
+    LogRecordRing()
+        : mCells(new Cell[CAPACITY])
+        , mEnqueuePos(0)
+        , mDequeuePos(0)
+    {
+        for (size_t i = 0; i < CAPACITY; ++i)
+        {
+            mCells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(const LogRecord& r)
+    {
+        size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = mCells[pos & (CAPACITY - 1)];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.record = r;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;   // full
+            }
+            else
+            {
+                pos = mEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop(LogRecord& r)
+    {
+        size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+        Cell& cell = mCells[pos & (CAPACITY - 1)];
+        size_t seq = cell.sequence.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0)
+        {
+            return false;   // empty, or the producer of this cell is still copying
+        }
+        r = cell.record;
+        mDequeuePos.store(pos + 1, std::memory_order_relaxed);
+        cell.sequence.store(pos + CAPACITY, std::memory_order_release);
+        return true;
+    }
+};
+
+std::atomic<bool> g_structuredLogDrainer{false};
+std::atomic<unsigned long long> g_structuredLogOverflow{0};
+
+LogRecordRing& structuredLogRing()
+{
+    // allocated on first use, so it costs nothing unless a drainer is active
+    static LogRecordRing ring;
+    return ring;
+}
+
+}
+
+void StructuredLog::submit(LogRecord& r)
+{
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    r.timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+    r.thread = std::this_thread::get_id();
+
+    if (g_structuredLogDrainer.load(std::memory_order_acquire))
+    {
+        if (structuredLogRing().push(r)) return;
+        ++g_structuredLogOverflow;
+    }
+
+    SimpleLogger logger(r.level, r.file, r.line);
+    logger << r.toString();
+}
+
+size_t StructuredLog::drain(const std::function<void(const LogRecord&)>& f)
+{
+    size_t n = 0;
+    LogRecord r;
+    while (structuredLogRing().pop(r))
+    {
+        f(r);
+        ++n;
+    }
+    return n;
+}
+
+void StructuredLog::setDrainerActive(bool active)
+{
+    if (active) structuredLogRing();
+    g_structuredLogDrainer.store(active, std::memory_order_release);
+}
+
+bool StructuredLog::drainerActive()
+{
+    return g_structuredLogDrainer.load(std::memory_order_acquire);
+}
+
+unsigned long long StructuredLog::overflowCount()
+{
+    return g_structuredLogOverflow.load();
+}
 
 ExternalLogger::ExternalLogger()
 {
@@ -737,9 +737,16 @@ bool MediaFileInfo::timeToRetryMediaPropertyExtraction(const std::string& fileat
     return false;
 }
 
-bool mediaInfoOpenFileWithLimits(MediaInfoLib::MediaInfo& mi, LocalPath& filename, FileAccess* fa, unsigned maxBytesToRead, unsigned maxSeconds)
+// MediaInfo asks to seek to the regions it needs (the moov atom of an mp4 at the end of the file, the
+// seek head and cues of a matroska file), so these bound the bytes read, the time spent and the seeks made
+static const unsigned MEDIAINFO_MAX_BYTES = 10485760;   // we can read more off local disk
+static const unsigned MEDIAINFO_MAX_SECONDS = 3;
+static const unsigned MEDIAINFO_MAX_JUMPS = 16;
+
+bool mediaInfoOpenFileWithLimits(MediaInfoLib::MediaInfo& mi, LocalPath& filename, FileAccess* fa, unsigned maxBytesToRead, unsigned maxSeconds, unsigned maxJumps, bool verified = false)
 {
-    if (!fa->fopen(filename, true, false))
+    // a verified file is only opened if its size and mtime are still the ones it was verified with
+    if (verified ? !fa->openf() : !fa->fopen(filename, true, false))
     {
         LOG_err << "could not open local file for mediainfo";
         return false;
@@ -763,7 +770,7 @@ bool mediaInfoOpenFileWithLimits(MediaInfoLib::MediaInfo& mi, LocalPath& filenam
             break;
         }
 
-        if (totalBytesRead > maxBytesToRead || (startTime != 0 && ((m_time() - startTime) > maxSeconds)))
+        if (totalBytesRead > maxBytesToRead || jumps > maxJumps || (startTime != 0 && ((m_time() - startTime) > maxSeconds)))
         {
             if (hasVideo && vidDuration)
             {
@@ -828,15 +835,27 @@ bool mediaInfoOpenFileWithLimits(MediaInfoLib::MediaInfo& mi, LocalPath& filenam
     return true;
 }
 
-void MediaProperties::extractMediaPropertyFileAttributes(LocalPath& localFilename, FileSystemAccess* fsa)
+void MediaProperties::extractMediaPropertyFileAttributes(LocalPath& localFilename, FileSystemAccess* fsa, FileAccess* verifiedFile)
+{
+    if (verifiedFile)
+    {
+        extractMediaPropertyFileAttributes(localFilename, verifiedFile, true);
+    }
+    else if (auto fa = fsa->newfileaccess())
+    {
+        extractMediaPropertyFileAttributes(localFilename, fa.get(), false);
+    }
+}
+
+void MediaProperties::extractMediaPropertyFileAttributes(LocalPath& localFilename, FileAccess* tmpfa, bool verified)
 {
-    if (auto tmpfa = fsa->newfileaccess())
+    if (tmpfa)
     {
         try
         {
             MediaInfoLib::MediaInfo minfo;
 
-            if (mediaInfoOpenFileWithLimits(minfo, localFilename, tmpfa.get(), 10485760, 3))  // we can read more off local disk
+            if (mediaInfoOpenFileWithLimits(minfo, localFilename, tmpfa, MEDIAINFO_MAX_BYTES, MEDIAINFO_MAX_SECONDS, MEDIAINFO_MAX_JUMPS, verified))
             {
                 if (!minfo.Count_Get(MediaInfoLib::Stream_General, 0))
                 {
@@ -921,6 +940,109 @@ void MediaProperties::extractMediaPropertyFileAttributes(LocalPath& localFilenam
     }
 }
 
+MediaExtractionService& MediaExtractionService::instance()
+{
+    // extraction waits on the disk more than on the CPU, a couple of workers keep it off the client threads
+    static MediaExtractionService service(2);
+    return service;
+}
+
+MediaExtractionService::MediaExtractionService(unsigned threadCount)
+{
+    for (unsigned i = threadCount; i--; )
+    {
+        try
+        {
+            mThreads.emplace_back([this]()
+            {
+                threadLoop();
+            });
+        }
+        catch (std::system_error& e)
+        {
+            LOG_err << "Failed to start media extraction thread: " << e.what();
+            break;
+        }
+    }
+    LOG_debug << "Media extraction threads running: " << mThreads.size();
+}
+
+MediaExtractionService::~MediaExtractionService()
+{
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mShutdown = true;
+    }
+    mConditionVariable.notify_all();
+    for (auto& t : mThreads)
+    {
+        t.join();
+    }
+}
+
+MediaExtractionService::RequestPtr MediaExtractionService::extract(const LocalPath& localPath, std::unique_ptr<FileAccess> fileAccess, bool verified, Waiter* waiter)
+{
+    auto request = std::make_shared<Request>();
+    request->localPath = localPath;
+    request->fileAccess = std::move(fileAccess);
+    request->verified = verified;
+    request->waiter = waiter;
+
+    if (mThreads.empty())
+    {
+        // no workers could be started: extract right here
+        request->vp.extractMediaPropertyFileAttributes(request->localPath, request->fileAccess.get(), verified);
+        request->fileAccess.reset();
+        request->done = true;
+        return request;
+    }
+
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mQueue.push_back(request);
+    }
+    mConditionVariable.notify_one();
+    return request;
+}
+
+void MediaExtractionService::cancel(const RequestPtr& request)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    request->cancelled = true;
+    request->waiter = nullptr;
+    mQueue.erase(std::remove(mQueue.begin(), mQueue.end(), request), mQueue.end());
+}
+
+void MediaExtractionService::threadLoop()
+{
+    for (;;)
+    {
+        RequestPtr request;
+        {
+            std::unique_lock<std::mutex> g(mMutex);
+            mConditionVariable.wait(g, [this]() { return mShutdown || !mQueue.empty(); });
+            if (mShutdown) return;
+            request = std::move(mQueue.front());
+            mQueue.pop_front();
+        }
+
+        MediaProperties vp;
+        vp.extractMediaPropertyFileAttributes(request->localPath, request->fileAccess.get(), request->verified);
+        request->fileAccess.reset();
+
+        std::lock_guard<std::mutex> g(mMutex);
+        if (!request->cancelled)
+        {
+            request->vp = vp;
+            request->done = true;
+            if (request->waiter)
+            {
+                request->waiter->notifyBy(Waiter::NOTIFY_OTHER);
+            }
+        }
+    }
+}
+
 std::string MediaProperties::convertMediaPropertyFileAttributes(uint32_t fakey[4], MediaFileInfo& mediaInfo)
 {
     containerid = mediaInfo.Lookup(containerName, mediaInfo.mediaCodecs.containers, 0);
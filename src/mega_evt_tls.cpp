@@ -24,6 +24,24 @@
 #include "mega/mega_evt_tls.h"
 #ifdef ENABLE_EVT_TLS
 
+// kernel TLS needs the TLS PRF of OpenSSL 1.1.1 to derive the keys
+#if defined(__linux__) && !defined(__ANDROID__) && OPENSSL_VERSION_NUMBER >= 0x10101000L
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+#include <openssl/kdf.h>
+#if defined(TLS_TX) && defined(TLS_CIPHER_AES_GCM_128)
+#define EVT_TLS_KTLS 1
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#endif
+#endif
+
 /*
  *All the asserts used in the code are possible targets for error
  * handling/error reporting
@@ -234,6 +252,12 @@ static int evt__send_pending(evt_tls_t *conn)
     int p = BIO_read(conn->app_bio, buf, pending);
     assert(p == pending);
 
+    if ( conn->ktls_tx ) {
+        //records of OpenSSL (alerts) would be sent as data, drop them
+        delete [] (char *)buf;
+        return 0;
+    }
+
     assert( conn->writer != NULL && "You need to set network writer first");
     p = conn->writer(conn, buf, p);
     return p;
@@ -280,6 +304,17 @@ static int evt__tls__op(evt_tls_t *conn, enum tls_op_type op, void *buf, size_t
 
         case EVT_TLS_OP_WRITE: {
             assert( sz > 0 && "number of bytes to write should be positive");
+            if (conn->ktls_tx) {
+                //the kernel encrypts it, the writer takes the text as is
+                char *text = new char[sz];
+                memcpy(text, buf, sz);
+                assert( conn->writer != NULL && "You need to set network writer first");
+                r = conn->writer(conn, text, int(sz));
+                if ( r > 0 && conn->write_cb) {
+                    conn->write_cb(conn, r);
+                }
+                break;
+            }
             r = SSL_write(conn->ssl, buf, int(sz));
             if ( 0 == r) goto handle_shutdown;
             do {
@@ -377,6 +412,138 @@ int evt_tls_accept(evt_tls_t *tls, evt_handshake_cb cb)
     return 0;
 }
 
+int evt_ctx_prepare_ktls(evt_ctx_t *ctx)
+{
+#ifdef EVT_TLS_KTLS
+    //the kernel can't take over a renegotiation, and the record sequence of
+    //TLS 1.3 depends on the session tickets sent after the handshake
+    SSL_CTX_set_max_proto_version(ctx->ctx, TLS1_2_VERSION);
+#ifdef SSL_OP_NO_RENEGOTIATION
+    SSL_CTX_set_options(ctx->ctx, SSL_OP_NO_RENEGOTIATION);
+#endif
+    SSL_CTX_set_options(ctx->ctx, SSL_OP_CIPHER_SERVER_PREFERENCE);
+    SSL_CTX_set_cipher_list(ctx->ctx, "ECDHE+AESGCM:DHE+AESGCM:AESGCM:HIGH:!aNULL:!MD5");
+    return 1;
+#else
+    (void)ctx;
+    return 0;
+#endif
+}
+
+#ifdef EVT_TLS_KTLS
+//key block of a TLS 1.2 session (RFC 5246, 6.3)
+static int evt__tls12_key_block(SSL *ssl, unsigned char *out, size_t len)
+{
+    unsigned char master[SSL_MAX_MASTER_KEY_LENGTH];
+    size_t masterlen = SSL_SESSION_get_master_key(SSL_get_session(ssl), master, sizeof(master));
+
+    //seeded with the server random first
+    unsigned char seed[2 * SSL3_RANDOM_SIZE];
+    SSL_get_server_random(ssl, seed, SSL3_RANDOM_SIZE);
+    SSL_get_client_random(ssl, seed + SSL3_RANDOM_SIZE, SSL3_RANDOM_SIZE);
+
+    int r = 0;
+    EVP_PKEY_CTX *pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_TLS1_PRF, NULL);
+    if (pctx
+        && EVP_PKEY_derive_init(pctx) == 1
+        && EVP_PKEY_CTX_set_tls1_prf_md(pctx, SSL_CIPHER_get_handshake_digest(SSL_get_current_cipher(ssl))) == 1
+        && EVP_PKEY_CTX_set1_tls1_prf_secret(pctx, master, int(masterlen)) == 1
+        && EVP_PKEY_CTX_add1_tls1_prf_seed(pctx, (const unsigned char *)"key expansion", 13) == 1
+        && EVP_PKEY_CTX_add1_tls1_prf_seed(pctx, seed, int(sizeof(seed))) == 1
+        && EVP_PKEY_derive(pctx, out, &len) == 1) {
+        r = 1;
+    }
+    EVP_PKEY_CTX_free(pctx);
+    OPENSSL_cleanse(master, sizeof(master));
+    return r;
+}
+#endif
+
+int evt_tls_enable_ktls_tx(evt_tls_t *tls, int fd)
+{
+    assert(tls != NULL);
+#ifdef EVT_TLS_KTLS
+    if ( tls->ktls_tx ) {
+        return 1;
+    }
+
+    if ( !SSL_is_init_finished(tls->ssl) || SSL_version(tls->ssl) != TLS1_2_VERSION
+        || BIO_pending(tls->app_bio) > 0 ) {
+        return 0;
+    }
+
+    const SSL_CIPHER *cipher = SSL_get_current_cipher(tls->ssl);
+    int nid = cipher ? SSL_CIPHER_get_cipher_nid(cipher) : NID_undef;
+    size_t keylen = 0;
+    if ( nid == NID_aes_128_gcm ) {
+        keylen = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+    }
+#ifdef TLS_CIPHER_AES_GCM_256
+    else if ( nid == NID_aes_256_gcm ) {
+        keylen = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+    }
+#endif
+    if ( !keylen ) {
+        return 0;
+    }
+
+    //AEAD ciphers have no MAC keys: client key, server key, client salt, server salt
+    const size_t saltlen = TLS_CIPHER_AES_GCM_128_SALT_SIZE;
+    unsigned char block[2 * 32 + 2 * saltlen];
+    if ( !evt__tls12_key_block(tls->ssl, block, 2 * keylen + 2 * saltlen) ) {
+        return 0;
+    }
+    const unsigned char *key = block + keylen;
+    const unsigned char *salt = block + 2 * keylen + saltlen;
+
+    //the Finished message was the first record sent with these keys, and the
+    //explicit nonce only has to be unique, like the sequence number
+    unsigned char seq[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+    int r = setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls"));
+    if ( !r && keylen == TLS_CIPHER_AES_GCM_128_KEY_SIZE ) {
+        struct tls12_crypto_info_aes_gcm_128 info;
+        memset(&info, 0, sizeof(info));
+        info.info.version = TLS_1_2_VERSION;
+        info.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+        memcpy(info.key, key, TLS_CIPHER_AES_GCM_128_KEY_SIZE);
+        memcpy(info.salt, salt, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+        memcpy(info.iv, seq, TLS_CIPHER_AES_GCM_128_IV_SIZE);
+        memcpy(info.rec_seq, seq, TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE);
+        r = setsockopt(fd, SOL_TLS, TLS_TX, &info, sizeof(info));
+        OPENSSL_cleanse(&info, sizeof(info));
+    }
+#ifdef TLS_CIPHER_AES_GCM_256
+    else if ( !r ) {
+        struct tls12_crypto_info_aes_gcm_256 info;
+        memset(&info, 0, sizeof(info));
+        info.info.version = TLS_1_2_VERSION;
+        info.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+        memcpy(info.key, key, TLS_CIPHER_AES_GCM_256_KEY_SIZE);
+        memcpy(info.salt, salt, TLS_CIPHER_AES_GCM_256_SALT_SIZE);
+        memcpy(info.iv, seq, TLS_CIPHER_AES_GCM_256_IV_SIZE);
+        memcpy(info.rec_seq, seq, TLS_CIPHER_AES_GCM_256_REC_SEQ_SIZE);
+        r = setsockopt(fd, SOL_TLS, TLS_TX, &info, sizeof(info));
+        OPENSSL_cleanse(&info, sizeof(info));
+    }
+#endif
+    OPENSSL_cleanse(block, sizeof(block));
+
+    //without TLS_TX, the socket keeps sending what it gets as is
+    if ( r ) {
+        return 0;
+    }
+
+    //OpenSSL can't send records anymore: its sequence doesn't advance
+    tls->ktls_tx = 1;
+    SSL_set_quiet_shutdown(tls->ssl, 1);
+    return 1;
+#else
+    (void)fd;
+    return 0;
+#endif
+}
+
 int evt_tls_write(evt_tls_t *c, void *msg, size_t str_len, evt_write_cb on_write)
 {
     c->write_cb = on_write;
@@ -226,6 +226,61 @@ void MegaNodeList::addNode(MegaNode *node)
 
 }
 
+MegaHandle MegaNodeList::getHandle(int i) const
+{
+    MegaNode* node = get(i);
+    return node ? node->getHandle() : INVALID_HANDLE;
+}
+
+int MegaNodeList::getChanges(int i) const
+{
+    MegaNode* node = get(i);
+    return node ? node->getChanges() : 0;
+}
+
+MegaHandle MegaNodeList::getParentHandle(int i) const
+{
+    MegaNode* node = get(i);
+    return node ? node->getParentHandle() : INVALID_HANDLE;
+}
+
+MegaTransferProgressList::~MegaTransferProgressList() { }
+
+MegaTransferProgressList* MegaTransferProgressList::copy() const
+{
+    return NULL;
+}
+
+int MegaTransferProgressList::size() const
+{
+    return 0;
+}
+
+int MegaTransferProgressList::getTag(int) const
+{
+    return 0;
+}
+
+int MegaTransferProgressList::getType(int) const
+{
+    return -1;
+}
+
+long long MegaTransferProgressList::getTransferredBytes(int) const
+{
+    return 0;
+}
+
+long long MegaTransferProgressList::getTotalBytes(int) const
+{
+    return 0;
+}
+
+long long MegaTransferProgressList::getSpeed(int) const
+{
+    return 0;
+}
+
 MegaTransferList::~MegaTransferList() { }
 
 MegaTransfer *MegaTransferList::get(int)
@@ -1087,6 +1142,16 @@ MegaRecentActionBucketList *MegaRequest::getRecentActions() const
     return nullptr;
 }
 
+MegaNodeList* MegaRequest::getMegaNodeList() const
+{
+    return nullptr;
+}
+
+MegaIntegerList* MegaRequest::getMegaIntegerList() const
+{
+    return nullptr;
+}
+
 MegaStringMap *MegaRequest::getMegaStringMap() const
 {
     return NULL;
@@ -1354,6 +1419,11 @@ MegaCancelToken* MegaTransfer::getCancelToken()
     return NULL;
 }
 
+const char* MegaTransfer::getTimeline() const
+{
+    return "";
+}
+
 const char* MegaTransfer::stageToString(unsigned stage)
 {
     switch (stage)
@@ -1688,6 +1758,8 @@ bool MegaTransferListener::onTransferData(MegaApi *, MegaTransfer *, char *, siz
 { return true; }
 void MegaTransferListener::onTransferTemporaryError(MegaApi *, MegaTransfer *, MegaError*)
 { }
+void MegaTransferListener::onTransfersProgress(MegaApi *, MegaTransferProgressList *)
+{ }
 MegaTransferListener::~MegaTransferListener()
 { }
 
@@ -1790,6 +1862,8 @@ void MegaListener::onTransferUpdate(MegaApi *, MegaTransfer *)
 { }
 void MegaListener::onTransferTemporaryError(MegaApi *, MegaTransfer *, MegaError *)
 { }
+void MegaListener::onTransfersProgress(MegaApi *, MegaTransferProgressList *)
+{ }
 void MegaListener::onUsersUpdate(MegaApi *, MegaUserList *)
 { }
 void MegaListener::onUserAlertsUpdate(MegaApi *, MegaUserAlertList *)
@@ -1849,6 +1923,30 @@ bool MegaTreeProcessor::processMegaNode(MegaNode*)
 MegaTreeProcessor::~MegaTreeProcessor()
 { }
 
+MegaNodeView::~MegaNodeView()
+{ }
+MegaHandle MegaNodeView::getHandle() const
+{ return INVALID_HANDLE; }
+MegaHandle MegaNodeView::getParentHandle() const
+{ return INVALID_HANDLE; }
+int MegaNodeView::getType() const
+{ return MegaNode::TYPE_UNKNOWN; }
+const char* MegaNodeView::getName() const
+{ return NULL; }
+int64_t MegaNodeView::getSize() const
+{ return 0; }
+int64_t MegaNodeView::getCreationTime() const
+{ return 0; }
+int64_t MegaNodeView::getModificationTime() const
+{ return 0; }
+MegaNode* MegaNodeView::copy() const
+{ return NULL; }
+
+bool MegaNodeViewVisitor::visit(MegaNodeView*)
+{ return false; /* Stops the visit */ }
+MegaNodeViewVisitor::~MegaNodeViewVisitor()
+{ }
+
 MegaApi::MegaApi(const char *appKey, MegaGfxProcessor* processor, const char *basePath, const char *userAgent, unsigned workerThreadCount)
 {
     pImpl = new MegaApiImpl(this, appKey, processor, basePath, userAgent, workerThreadCount);
@@ -2449,6 +2547,11 @@ void MegaApi::moveNode(MegaNode *node, MegaNode *newParent, const char *newName,
     pImpl->moveNode(node, newParent, newName, listener);
 }
 
+void MegaApi::moveNodes(MegaNodeList *nodes, MegaNode *newParent, MegaRequestListener *listener)
+{
+    pImpl->moveNodes(nodes, newParent, listener);
+}
+
 void MegaApi::copyNode(MegaNode *node, MegaNode* target, MegaRequestListener *listener)
 {
     pImpl->copyNode(node, target, listener);
@@ -2584,6 +2687,21 @@ void MegaApi::cancelGetPreview(MegaNode* node, MegaRequestListener *listener)
 	pImpl->cancelGetPreview(node, listener);
 }
 
+void MegaApi::cancelGetThumbnailsExcept(MegaHandleList *nodeHandles, MegaRequestListener *listener)
+{
+    pImpl->cancelGetThumbnailsExcept(nodeHandles, listener);
+}
+
+void MegaApi::cancelGetPreviewsExcept(MegaHandleList *nodeHandles, MegaRequestListener *listener)
+{
+    pImpl->cancelGetPreviewsExcept(nodeHandles, listener);
+}
+
+bool MegaApi::setFileAttributesCache(const char *path, long long maxSize)
+{
+    return pImpl->setFileAttributesCache(path, maxSize);
+}
+
 void MegaApi::setPreview(MegaNode* node, const char *srcFilePath, MegaRequestListener *listener)
 {
     pImpl->setPreview(node, srcFilePath, listener);
@@ -2699,6 +2817,11 @@ void MegaApi::setCustomNodeAttribute(MegaNode *node, const char *attrName, const
     pImpl->setCustomNodeAttribute(node, attrName, value, listener);
 }
 
+void MegaApi::setNodesCustomAttribute(MegaNodeList *nodes, const char *attrName, const char *value, MegaRequestListener *listener)
+{
+    pImpl->setNodesCustomAttribute(nodes, attrName, value, listener);
+}
+
 void MegaApi::setNodeS4(MegaNode *node, const char *value, MegaRequestListener *listener)
 {
     pImpl->setNodeS4(node, value, listener);
@@ -3279,6 +3402,91 @@ bool MegaApi::setMaxUploadSpeed(long long bpslimit)
     return pImpl->setMaxUploadSpeed(bpslimit);
 }
 
+bool MegaApi::setHttp2Multiplexing(bool enable)
+{
+    return pImpl->setHttp2Multiplexing(enable);
+}
+
+void MegaApi::setRequestBatching(int maxCommands, long long maxBytes, int lingerMs)
+{
+    pImpl->setRequestBatching(maxCommands, maxBytes, lingerMs);
+}
+
+void MegaApi::setLocalCacheCommitGrouping(int maxLagMs, int maxPending)
+{
+    pImpl->setLocalCacheCommitGrouping(maxLagMs, maxPending);
+}
+
+void MegaApi::setLocalCacheTuning(long long mmapSizeBytes, long long cacheSizeKb, int walCheckpointPages)
+{
+    pImpl->setLocalCacheTuning(mmapSizeBytes, cacheSizeKb, walCheckpointPages);
+}
+
+void MegaApi::setParallelRequests(int count)
+{
+    pImpl->setParallelRequests(count);
+}
+
+void MegaApi::setFolderDownloadBatchSize(int nodes)
+{
+    pImpl->setFolderDownloadBatchSize(nodes);
+}
+
+void MegaApi::setNodesUpdateCoalescing(bool enable)
+{
+    pImpl->setNodesUpdateCoalescing(enable);
+}
+
+void MegaApi::setListenerDispatchThreads(int threads)
+{
+    pImpl->setListenerDispatchThreads(threads);
+}
+
+void MegaApi::setTransferUpdatePolicy(int minIntervalMs, long long minBytes, bool aggregate)
+{
+    pImpl->setTransferUpdatePolicy(minIntervalMs, minBytes, aggregate);
+}
+
+void MegaApi::setSlowLoopThreshold(int milliseconds)
+{
+    pImpl->setSlowLoopThreshold(milliseconds);
+}
+
+MegaMemoryReport *MegaApi::getMemoryReport()
+{
+    return pImpl->getMemoryReport();
+}
+
+bool MegaApi::setThreadPoolConfig(int pool, int size, MegaIntegerList *cpus, int niceLevel)
+{
+    return MegaApiImpl::setThreadPoolConfig(pool, size, cpus, niceLevel);
+}
+
+int MegaApi::getThreadPoolThreadCount(int pool)
+{
+    return MegaApiImpl::getThreadPoolThreadCount(pool);
+}
+
+long long MegaApi::getThreadPoolQueueDepth(int pool)
+{
+    return MegaApiImpl::getThreadPoolQueueDepth(pool);
+}
+
+double MegaApi::getThreadPoolUtilization(int pool, bool reset)
+{
+    return MegaApiImpl::getThreadPoolUtilization(pool, reset);
+}
+
+MegaMetricsSnapshot *MegaApi::getMetricsSnapshot()
+{
+    return MegaApiImpl::getMetricsSnapshot();
+}
+
+void MegaApi::setSharedWorkers(bool enable)
+{
+    MegaApiImpl::setSharedWorkers(enable);
+}
+
 int MegaApi::getCurrentDownloadSpeed()
 {
     return pImpl->getCurrentDownloadSpeed();
@@ -3398,6 +3606,16 @@ void MegaApi::startDownload(MegaNode* node, const char* localPath, const char *c
     pImpl->startDownload(startFirst, node, localPath, customName, 0 /*folderTransferTag*/, appData, convertToCancelToken(cancelToken), listener);
 }
 
+void MegaApi::startUploads(MegaStringList* localPaths, MegaNode* parent, const char* appData, bool startFirst, MegaCancelToken* cancelToken, MegaTransferListener* listener)
+{
+    pImpl->startUploads(localPaths, parent, appData, startFirst, convertToCancelToken(cancelToken), listener);
+}
+
+void MegaApi::startDownloads(MegaNodeList* nodes, const char* localFolder, const char* appData, bool startFirst, MegaCancelToken* cancelToken, MegaTransferListener* listener)
+{
+    pImpl->startDownloads(nodes, localFolder, appData, startFirst, convertToCancelToken(cancelToken), listener);
+}
+
 void MegaApi::cancelTransfer(MegaTransfer *t, MegaRequestListener *listener)
 {
     pImpl->cancelTransfer(t, listener);
@@ -3606,6 +3824,31 @@ MegaSync *MegaApi::getSyncByBackupId(MegaHandle backupId)
     return pImpl->getSyncByBackupId(backupId);
 }
 
+MegaSyncStats *MegaApi::getSyncStats(MegaHandle backupId)
+{
+    return pImpl->getSyncStats(backupId);
+}
+
+void MegaApi::setSyncTracing(bool enable)
+{
+    pImpl->setSyncTracing(enable);
+}
+
+char *MegaApi::exportSyncTrace()
+{
+    return pImpl->exportSyncTrace();
+}
+
+void MegaApi::setBackupUploadOrder(int order)
+{
+    pImpl->setBackupUploadOrder(order);
+}
+
+bool MegaApi::setMaxSyncNodesInRam(MegaHandle backupId, long long maxNodes)
+{
+    return pImpl->setMaxSyncNodesInRam(backupId, maxNodes);
+}
+
 MegaSync *MegaApi::getSyncByNode(MegaNode *node)
 {
     return pImpl->getSyncByNode(node);
@@ -3792,6 +4035,16 @@ MegaUserAlertList* MegaApi::getUserAlerts()
     return pImpl->getUserAlerts();
 }
 
+MegaUserAlertList* MegaApi::getUserAlerts(int offset, int count)
+{
+    return pImpl->getUserAlerts(offset, count);
+}
+
+MegaNodeList* MegaApi::getUserAlertNodes(MegaUserAlert* alert)
+{
+    return pImpl->getUserAlertNodes(alert);
+}
+
 int MegaApi::getNumUnreadUserAlerts()
 {
     return pImpl->getNumUnreadUserAlerts();
@@ -3922,6 +4175,11 @@ bool MegaApi::processMegaTree(MegaNode* n, MegaTreeProcessor* processor, bool re
     return pImpl->processMegaTree(n, processor, recursive);
 }
 
+bool MegaApi::processMegaTreeStreamed(MegaNode* n, MegaTreeProcessor* processor, int prefetch, int threads)
+{
+    return pImpl->processMegaTreeStreamed(n, processor, prefetch, threads);
+}
+
 MegaNode *MegaApi::createForeignFileNode(MegaHandle handle, const char *key,
                                     const char *name, int64_t size, int64_t mtime,
                                         MegaHandle parentHandle, const char *privateAuth, const char *publicAuth, const char *chatAuth)
@@ -4132,6 +4390,11 @@ MegaNodeList* MegaApi::searchByType(MegaNode *n, const char *searchString, MegaC
     return pImpl->search(n, searchString, convertToCancelToken(cancelToken), recursive, order, type, target);
 }
 
+void MegaApi::searchAsync(MegaNode *node, const char *searchString, bool recursive, int order, int type, int target, MegaRequestListener *listener)
+{
+    pImpl->searchAsync(node, searchString, recursive, order, type, target, listener);
+}
+
 long long MegaApi::getSize(MegaNode *n)
 {
     return pImpl->getSize(n);
@@ -4352,6 +4615,16 @@ MegaNodeList* MegaApi::getChildrenFromType(MegaNode* p, int type, int order, Meg
     return pImpl->getChildrenFromType(p, type, order, convertToCancelToken(cancelToken));
 }
 
+MegaNodeList* MegaApi::getChildrenPage(MegaNode *parent, int order, long long offset, int limit, MegaCancelToken *cancelToken)
+{
+    return pImpl->getChildrenPage(parent, order, offset, limit, convertToCancelToken(cancelToken));
+}
+
+bool MegaApi::visitChildren(MegaNode *parent, MegaNodeViewVisitor *visitor, int order)
+{
+    return pImpl->visitChildren(parent, visitor, order);
+}
+
 bool MegaApi::hasChildren(MegaNode *parent)
 {
     return pImpl->hasChildren(parent);
@@ -4407,6 +4680,16 @@ long long MegaApi::getNumNodes()
     return pImpl->getNumNodes();
 }
 
+void MegaApi::setMaxNodesInRam(long long maxNodes)
+{
+    pImpl->setMaxNodesInRam(maxNodes);
+}
+
+void MegaApi::setChildrenPrefetch(int folders)
+{
+    pImpl->setChildrenPrefetch(folders);
+}
+
 long long MegaApi::getTotalDownloadedBytes()
 {
     return pImpl->getTotalDownloadedBytes();
@@ -4639,6 +4922,26 @@ int MegaApi::httpServerGetMaxOutputSize()
     return pImpl->httpServerGetMaxOutputSize();
 }
 
+void MegaApi::httpServerSetEventLoops(int loops)
+{
+    pImpl->httpServerSetEventLoops(loops);
+}
+
+int MegaApi::httpServerGetEventLoops()
+{
+    return pImpl->httpServerGetEventLoops();
+}
+
+void MegaApi::httpServerEnableKernelTls(bool enable)
+{
+    pImpl->httpServerEnableKernelTls(enable);
+}
+
+bool MegaApi::httpServerIsKernelTlsEnabled()
+{
+    return pImpl->httpServerIsKernelTlsEnabled();
+}
+
 //FTP Server:
 bool MegaApi::ftpServerStart(bool localOnly, int port, int dataportBegin, int dataPortEnd, bool useTLS, const char * certificatepath, const char * keypath)
 {
@@ -4725,6 +5028,31 @@ int MegaApi::ftpServerGetMaxOutputSize()
     return pImpl->ftpServerGetMaxOutputSize();
 }
 
+void MegaApi::ftpServerSetUploadPipelining(bool enable)
+{
+    pImpl->ftpServerSetUploadPipelining(enable);
+}
+
+bool MegaApi::ftpServerIsUploadPipelining()
+{
+    return pImpl->ftpServerIsUploadPipelining();
+}
+
+void MegaApi::ftpServerEnableKernelTls(bool enable)
+{
+    pImpl->ftpServerEnableKernelTls(enable);
+}
+
+bool MegaApi::ftpServerIsKernelTlsEnabled()
+{
+    return pImpl->ftpServerIsKernelTlsEnabled();
+}
+
+bool MegaApi::setStreamingCache(const char *path, long long maxSize)
+{
+    return pImpl->setStreamingCache(path, maxSize);
+}
+
 #endif
 
 char *MegaApi::getMimeType(const char *extension)
@@ -5766,6 +6094,16 @@ void MegaApi::removeSetElement(MegaHandle sid, MegaHandle eid, MegaRequestListen
     pImpl->removeSetElement(sid, eid, listener);
 }
 
+void MegaApi::createSetElements(MegaHandle sid, const MegaHandleList* nodes, const MegaStringList* names, MegaRequestListener* listener)
+{
+    pImpl->createSetElements(sid, nodes, names, listener);
+}
+
+void MegaApi::removeSetElements(MegaHandle sid, const MegaHandleList* eids, MegaRequestListener* listener)
+{
+    pImpl->removeSetElements(sid, eids, listener);
+}
+
 MegaSetList* MegaApi::getSets()
 {
     return pImpl->getSets();
@@ -5791,6 +6129,11 @@ MegaSetElementList* MegaApi::getSetElements(MegaHandle sid)
     return pImpl->getSetElements(sid);
 }
 
+MegaSetElementList* MegaApi::getSetElements(MegaHandle sid, unsigned offset, unsigned count)
+{
+    return pImpl->getSetElements(sid, offset, count);
+}
+
 MegaSetElement* MegaApi::getSetElement(MegaHandle sid, MegaHandle eid)
 {
     return pImpl->getSetElement(sid, eid);
@@ -6314,6 +6657,61 @@ void MegaSyncList::addSync(MegaSync *sync)
 
 }
 
+MegaSyncStats::~MegaSyncStats()
+{
+
+}
+
+MegaSyncStats *MegaSyncStats::copy() const
+{
+    return NULL;
+}
+
+MegaHandle MegaSyncStats::getBackupId() const
+{
+    return INVALID_HANDLE;
+}
+
+long long MegaSyncStats::getNotificationsPending() const
+{
+    return 0;
+}
+
+long long MegaSyncStats::getRetriesPending() const
+{
+    return 0;
+}
+
+long long MegaSyncStats::getStateCachePending() const
+{
+    return 0;
+}
+
+long long MegaSyncStats::getUploadsPending() const
+{
+    return 0;
+}
+
+long long MegaSyncStats::getDownloadsPending() const
+{
+    return 0;
+}
+
+long long MegaSyncStats::getCallCount(int) const
+{
+    return 0;
+}
+
+long long MegaSyncStats::getTimeSpent(int) const
+{
+    return 0;
+}
+
+long long MegaSyncStats::getFullRescans() const
+{
+    return 0;
+}
+
 #endif
 
 
@@ -6576,6 +6974,11 @@ char *MegaBackgroundMediaUpload::encryptFile(const char* inputFilepath, int64_t
     return NULL;
 }
 
+MegaStringList* MegaBackgroundMediaUpload::encryptFileInPieces(const char* inputFilepath, int64_t pieceSize, const char* outputFilepathPrefix, int threads)
+{
+    return NULL;
+}
+
 char *MegaBackgroundMediaUpload::getUploadURL()
 {
     return NULL;
@@ -7427,6 +7830,91 @@ int MegaIntegerList::size() const
     return 0;
 }
 
+MegaMetricsSnapshot::~MegaMetricsSnapshot()
+{
+
+}
+
+MegaMetricsSnapshot *MegaMetricsSnapshot::copy() const
+{
+    return nullptr;
+}
+
+int MegaMetricsSnapshot::size() const
+{
+    return 0;
+}
+
+const char *MegaMetricsSnapshot::getName(int) const
+{
+    return nullptr;
+}
+
+int MegaMetricsSnapshot::getType(int) const
+{
+    return -1;
+}
+
+long long MegaMetricsSnapshot::getValue(int) const
+{
+    return 0;
+}
+
+long long MegaMetricsSnapshot::getSumMicroseconds(int) const
+{
+    return 0;
+}
+
+long long MegaMetricsSnapshot::getPercentileMicroseconds(int, double) const
+{
+    return 0;
+}
+
+char *MegaMetricsSnapshot::toOpenMetrics() const
+{
+    return nullptr;
+}
+
+MegaMemoryReport::~MegaMemoryReport()
+{
+
+}
+
+MegaMemoryReport *MegaMemoryReport::copy() const
+{
+    return nullptr;
+}
+
+int MegaMemoryReport::size() const
+{
+    return 0;
+}
+
+const char *MegaMemoryReport::getSubsystem(int) const
+{
+    return nullptr;
+}
+
+long long MegaMemoryReport::getObjects(int) const
+{
+    return 0;
+}
+
+long long MegaMemoryReport::getBytes(int) const
+{
+    return 0;
+}
+
+long long MegaMemoryReport::getTotalBytes() const
+{
+    return 0;
+}
+
+char *MegaMemoryReport::toJson() const
+{
+    return nullptr;
+}
+
 MegaBanner::MegaBanner()
 {
 }
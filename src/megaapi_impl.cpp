@@ -427,63 +427,7 @@ MegaNodePrivate::MegaNodePrivate(Node *node)
     this->fileattrstring = node->fileattrstring;
     this->nodekey = node->nodekeyUnchecked();
 
-    this->changed = 0;
-    if(node->changed.attrs)
-    {
-        this->changed |= MegaNode::CHANGE_TYPE_ATTRIBUTES;
-    }
-    if(node->changed.ctime)
-    {
-        this->changed |= MegaNode::CHANGE_TYPE_TIMESTAMP;
-    }
-    if(node->changed.fileattrstring)
-    {
-        this->changed |= MegaNode::CHANGE_TYPE_FILE_ATTRIBUTES;
-    }
-    if(node->changed.inshare)
-    {
-        this->changed |= MegaNode::CHANGE_TYPE_INSHARE;
-    }
-    if(node->changed.outshares)
-    {
-        this->changed |= MegaNode::CHANGE_TYPE_OUTSHARE;
-    }
-    if(node->changed.pendingshares)
-    {
-        this->changed |= MegaNode::CHANGE_TYPE_PENDINGSHARE;
-    }
-    if(node->changed.owner)
-    {
-        this->changed |= MegaNode::CHANGE_TYPE_OWNER;
-    }
-    if(node->changed.parent)
-    {
-        this->changed |= MegaNode::CHANGE_TYPE_PARENT;
-    }
-    if(node->changed.removed)
-    {
-        this->changed |= MegaNode::CHANGE_TYPE_REMOVED;
-    }
-    if(node->changed.publiclink)
-    {
-        this->changed |= MegaNode::CHANGE_TYPE_PUBLIC_LINK;
-    }
-    if(node->changed.newnode)
-    {
-        this->changed |= MegaNode::CHANGE_TYPE_NEW;
-    }
-    if (node->changed.name)
-    {
-        this->changed |= MegaNode::CHANGE_TYPE_NAME;
-    }
-    if (node->changed.favourite)
-    {
-        this->changed |= MegaNode::CHANGE_TYPE_FAVOURITE;
-    }
-    if (node->changed.counter)
-    {
-        this->changed |= MegaNode::CHANGE_TYPE_COUNTER;
-    }
+    this->changed = changesOf(node);
 
     this->thumbnailAvailable = (node->hasfileattribute(0) != 0);
     this->previewAvailable = (node->hasfileattribute(1) != 0);
@@ -1156,6 +1100,105 @@ char *MegaBackgroundMediaUploadPrivate::encryptFile(const char* inputFilepath, i
     return nullptr;
 }
 
+MegaStringList* MegaBackgroundMediaUploadPrivate::encryptFileInPieces(const char* inputFilepath, int64_t pieceSize, const char* outputFilepathPrefix, int threads)
+{
+    if (!inputFilepath || !outputFilepathPrefix || pieceSize <= 0 || threads < 1)
+    {
+        LOG_err << "invalid parameters to encrypt a file in pieces";
+        return nullptr;
+    }
+
+    auto localfilename = LocalPath::fromAbsolutePath(inputFilepath);
+    m_off_t size = 0;
+    {
+        std::unique_ptr<FileAccess> fain(api->fsAccess->newfileaccess());
+        if (!fain->fopen(localfilename, true, false) || fain->type != FILENODE)
+        {
+            LOG_err << "unable to open the file to encrypt";
+            return nullptr;
+        }
+        size = fain->size;
+    }
+
+    // consecutive pieces, each ending at a chunk boundary (or at the end of the file)
+    vector<std::pair<m_off_t, m_off_t>> pieces;
+    m_off_t pos = 0;
+    do
+    {
+        m_off_t end = ChunkedHash::chunkceil(pos + std::min<m_off_t>(pieceSize, size - pos), size);
+        pieces.emplace_back(pos, end);
+        pos = end;
+    } while (pos < size);
+
+    uint64_t ctriv = MemAccess::get<uint64_t>((const char*)filekey + SymmCipher::KEYLENGTH);
+
+    // the pieces share nothing but the file key: each one has its own macs,
+    // merged once they are all done, and each worker its own cipher and file handles
+    vector<chunkmac_map> macs(pieces.size());
+    string_vector suffixes(pieces.size());
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+
+    auto work = [&]()
+    {
+        std::unique_ptr<FileAccess> fain(api->fsAccess->newfileaccess());
+        if (!fain->fopen(localfilename, true, false))
+        {
+            failed = true;
+            return;
+        }
+
+        SymmCipher cipher;
+        cipher.setkey(filekey);
+
+        for (size_t i = next++; i < pieces.size() && !failed; i = next++)
+        {
+            auto localencryptedfilename = LocalPath::fromAbsolutePath(outputFilepathPrefix + std::to_string(i));
+            std::unique_ptr<FileAccess> faout(api->fsAccess->newfileaccess());
+            if (!faout->fopen(localencryptedfilename, false, true))
+            {
+                LOG_err << "unable to create the file for encrypted piece " << i;
+                failed = true;
+                break;
+            }
+
+            EncryptFilePieceByChunks ef(fain.get(), pieces[i].first, faout.get(), 0, &cipher, &macs[i], ctriv);
+            if (!ef.encrypt(pieces[i].first, pieces[i].second, suffixes[i]))
+            {
+                LOG_err << "failed to encrypt piece " << i;
+                failed = true;
+            }
+        }
+    };
+
+    vector<std::thread> workers;
+    for (size_t i = 1; i < std::min(size_t(threads), pieces.size()); i++)
+    {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    if (failed)
+    {
+        return nullptr;
+    }
+
+    for (auto& pieceMacs : macs)
+    {
+        pieceMacs.copyEntriesTo(chunkmacs);
+    }
+
+    SymmCipher cipher;
+    cipher.setkey(filekey);
+    ((int64_t*)filekey)[3] = chunkmacs.macsmac(&cipher);
+
+    return new MegaStringListPrivate(std::move(suffixes));
+}
+
 char *MegaBackgroundMediaUploadPrivate::getUploadURL()
 {
     return url.empty() ? nullptr : MegaApi::strdup(url.c_str());
@@ -1198,28 +1241,20 @@ byte *EncryptFilePieceByChunks::nextbuffer(unsigned bufsize)
 bool MegaApiImpl::is_syncable(Sync *sync, const char *, const LocalPath& localpath)
 {
     // Is this path excluded by any path filters?
-    if (!excludedPaths.empty())
+    for (const auto& xpath : excludedPaths)
     {
-        // Translate current path into something we can match.
-        auto temp = localpath.toPath(true);
-
-        // Is this path excluded by any path filters?
-        for (const auto& xpath : excludedPaths)
+        if (xpath.isContainingPathOf(localpath))
         {
-            auto xp = LocalPath::fromAbsolutePath(xpath);
-
-            if (xp.isContainingPathOf(localpath))
-            {
-                return false;
-            }
-
-            if (wildcardMatch(temp.c_str(), xpath.c_str()))
-            {
-                return false;
-            }
+            return false;
         }
     }
 
+    if (!excludedPathPatterns.empty()
+        && excludedPathPatterns.matches(localpath.toPath(true)))
+    {
+        return false;
+    }
+
     // Check whether any path components are excluded.
     auto path = localpath;
 
@@ -1241,12 +1276,9 @@ bool MegaApiImpl::is_syncable(Sync *sync, const char *, const LocalPath& localpa
         }
 
         // Is this component's name excluded by any filename filters?
-        for (const auto& xname : excludedNames)
+        if (excludedNames.matches(name))
         {
-            if (wildcardMatch(name.c_str(), xname.c_str()))
-            {
-                return false;
-            }
+            return false;
         }
 
         // Climb to the next component.
@@ -1374,6 +1406,48 @@ MegaSync *MegaApiImpl::getSyncByBackupId(mega::MegaHandle backupId)
     return nullptr;
 }
 
+MegaSyncStats *MegaApiImpl::getSyncStats(mega::MegaHandle backupId)
+{
+    SdkMutexGuard g(sdkMutex);
+
+    SyncStats stats;
+    if (client->syncs.syncStats(backupId, stats))
+    {
+        return new MegaSyncStatsPrivate(backupId, stats);
+    }
+    return nullptr;
+}
+
+void MegaApiImpl::setSyncTracing(bool enable)
+{
+    SdkMutexGuard g(sdkMutex);
+    client->syncs.mTrace.enable(enable);
+}
+
+char *MegaApiImpl::exportSyncTrace()
+{
+    SdkMutexGuard g(sdkMutex);
+    return MegaApi::strdup(client->syncs.mTrace.exportChromeTrace().c_str());
+}
+
+void MegaApiImpl::setBackupUploadOrder(int order)
+{
+    if (order < MegaApi::BACKUP_UPLOAD_ORDER_FIFO || order > MegaApi::BACKUP_UPLOAD_ORDER_WEIGHTED)
+    {
+        LOG_warn << "Invalid backup upload order: " << order;
+        return;
+    }
+
+    SdkMutexGuard g(sdkMutex);
+    client->syncs.mBackupUploadOrder = static_cast<BackupUploadOrder>(order);
+}
+
+bool MegaApiImpl::setMaxSyncNodesInRam(MegaHandle backupId, long long maxNodes)
+{
+    SdkMutexGuard g(sdkMutex);
+    return client->syncs.setMaxLocalNodesInRam(backupId, maxNodes > 0 ? static_cast<uint64_t>(maxNodes) : 0);
+}
+
 MegaSync *MegaApiImpl::getSyncByNode(MegaNode *node)
 {
     if (!node)
@@ -1939,8 +2013,8 @@ MegaUserAlertPrivate::MegaUserAlertPrivate(UserAlert::Base *b, MegaClient* mc)
         userHandle = p->user();
         email = p->email();
         nodeHandle = p->parentHandle;
-        numbers.push_back(p->folderNodeHandles.size());
-        numbers.push_back(p->fileNodeHandles.size());
+        numbers.push_back(p->folderCount());
+        numbers.push_back(p->fileCount());
         handles.assign(begin(p->folderNodeHandles), end(p->folderNodeHandles));
         handles.insert(end(handles), begin(p->fileNodeHandles), end(p->fileNodeHandles));
     }
@@ -1951,7 +2025,7 @@ MegaUserAlertPrivate::MegaUserAlertPrivate(UserAlert::Base *b, MegaClient* mc)
         type = TYPE_REMOVEDSHAREDNODES;
         userHandle = p->user();
         email = p->email();
-        numbers.push_back(p->nodeHandles.size());
+        numbers.push_back(p->count());
     }
     break;
     case UserAlert::type_u:
@@ -2244,6 +2318,74 @@ bool mega::MegaUserAlertPrivate::isRemoved() const
     return removed;
 }
 
+int MegaNodePrivate::changesOf(const Node *node)
+{
+    int changes = 0;
+    if(node->changed.attrs)
+    {
+        changes |= MegaNode::CHANGE_TYPE_ATTRIBUTES;
+    }
+    if(node->changed.ctime)
+    {
+        changes |= MegaNode::CHANGE_TYPE_TIMESTAMP;
+    }
+    if(node->changed.fileattrstring)
+    {
+        changes |= MegaNode::CHANGE_TYPE_FILE_ATTRIBUTES;
+    }
+    if(node->changed.inshare)
+    {
+        changes |= MegaNode::CHANGE_TYPE_INSHARE;
+    }
+    if(node->changed.outshares)
+    {
+        changes |= MegaNode::CHANGE_TYPE_OUTSHARE;
+    }
+    if(node->changed.pendingshares)
+    {
+        changes |= MegaNode::CHANGE_TYPE_PENDINGSHARE;
+    }
+    if(node->changed.owner)
+    {
+        changes |= MegaNode::CHANGE_TYPE_OWNER;
+    }
+    if(node->changed.parent)
+    {
+        changes |= MegaNode::CHANGE_TYPE_PARENT;
+    }
+    if(node->changed.removed)
+    {
+        changes |= MegaNode::CHANGE_TYPE_REMOVED;
+    }
+    if(node->changed.publiclink)
+    {
+        changes |= MegaNode::CHANGE_TYPE_PUBLIC_LINK;
+    }
+    if(node->changed.newnode)
+    {
+        changes |= MegaNode::CHANGE_TYPE_NEW;
+    }
+    if (node->changed.name)
+    {
+        changes |= MegaNode::CHANGE_TYPE_NAME;
+    }
+    if (node->changed.favourite)
+    {
+        changes |= MegaNode::CHANGE_TYPE_FAVOURITE;
+    }
+    if (node->changed.counter)
+    {
+        changes |= MegaNode::CHANGE_TYPE_COUNTER;
+    }
+
+    return changes;
+}
+
+void MegaNodePrivate::setChanges(int changes)
+{
+    changed = changes;
+}
+
 MegaNode *MegaNodePrivate::fromNode(Node *node)
 {
     if(!node) return NULL;
@@ -2340,6 +2482,7 @@ MegaTransferPrivate::MegaTransferPrivate(int type, MegaTransferListener *listene
     this->lastBytes = NULL;
     this->syncTransfer = false;
     this->streamingTransfer = false;
+    this->sequentialRead = false;
     this->temporarySourceFile = false;
     this->startFirst = false;
     this->backupTransfer = false;
@@ -2389,6 +2532,7 @@ MegaTransferPrivate::MegaTransferPrivate(const MegaTransferPrivate *transfer)
     this->setTransfer(transfer->getTransfer());
     this->setSyncTransfer(transfer->isSyncTransfer());
     this->setStreamingTransfer(transfer->isStreamingTransfer());
+    this->setSequentialRead(transfer->isSequentialRead());
     this->setSourceFileTemporary(transfer->isSourceFileTemporary());
     this->setStartFirst(transfer->shouldStartFirst());
     this->setBackupTransfer(transfer->isBackupTransfer());
@@ -2400,6 +2544,7 @@ MegaTransferPrivate::MegaTransferPrivate(const MegaTransferPrivate *transfer)
     this->setNotificationNumber(transfer->getNotificationNumber());
     mCancelToken = transfer->mCancelToken;
     this->setStage(transfer->getStage());
+    mTimeline = transfer->mTimeline;
 }
 
 MegaTransfer* MegaTransferPrivate::copy()
@@ -2917,6 +3062,16 @@ void MegaTransferPrivate::setStreamingTransfer(bool streamingTransfer)
     this->streamingTransfer = streamingTransfer;
 }
 
+void MegaTransferPrivate::setSequentialRead(bool sequentialRead)
+{
+    this->sequentialRead = sequentialRead;
+}
+
+bool MegaTransferPrivate::isSequentialRead() const
+{
+    return sequentialRead;
+}
+
 void MegaTransferPrivate::setStartTime(int64_t startTime)
 {
     if (!this->startTime)
@@ -3005,6 +3160,21 @@ MegaCancelToken* MegaTransferPrivate::getCancelToken()
     return mCancelToken.existencePtr();
 }
 
+void MegaTransferPrivate::setTimeline(const TransferTimeline& timeline)
+{
+    mTimeline = timeline;
+    mTimelineJson.clear();
+}
+
+const char* MegaTransferPrivate::getTimeline() const
+{
+    if (mTimelineJson.empty() && mTimeline.stages[TransferTimeline::QUEUED])
+    {
+        mTimelineJson = mTimeline.toJson(tag);
+    }
+    return mTimelineJson.c_str();
+}
+
 void MegaTransferPrivate::setPath(const char* path)
 {
     if(this->path) delete [] this->path;
@@ -3423,6 +3593,8 @@ MegaRequestPrivate::MegaRequestPrivate(MegaRequestPrivate *request)
     this->mRecentActions.reset(request->mRecentActions ? request->mRecentActions->copy() : nullptr);
     this->mMegaSet.reset(request->mMegaSet ? request->mMegaSet->copy() : nullptr);
     this->mMegaSetElementList.reset(request->mMegaSetElementList ? request->mMegaSetElementList->copy() : nullptr);
+    this->mNodeList.reset(request->mNodeList ? request->mNodeList->copy() : nullptr);
+    this->mIntegerList.reset(request->mIntegerList ? request->mIntegerList->copy() : nullptr);
 }
 
 std::shared_ptr<AccountDetails> MegaRequestPrivate::getAccountDetails() const
@@ -4026,6 +4198,26 @@ void MegaRequestPrivate::setMegaSetElementList(std::unique_ptr<MegaSetElementLis
     return mMegaSetElementList.swap(els);
 }
 
+MegaNodeList* MegaRequestPrivate::getMegaNodeList() const
+{
+    return mNodeList.get();
+}
+
+void MegaRequestPrivate::setMegaNodeList(std::unique_ptr<MegaNodeList> nodes)
+{
+    mNodeList = std::move(nodes);
+}
+
+MegaIntegerList* MegaRequestPrivate::getMegaIntegerList() const
+{
+    return mIntegerList.get();
+}
+
+void MegaRequestPrivate::setMegaIntegerList(std::unique_ptr<MegaIntegerList> integers)
+{
+    mIntegerList = std::move(integers);
+}
+
 const char *MegaRequestPrivate::getRequestString() const
 {
     switch(type)
@@ -4190,6 +4382,11 @@ const char *MegaRequestPrivate::getRequestString() const
         case TYPE_DEL_SCHEDULED_MEETING: return "DEL_SCHEDULED_MEETING";
         case TYPE_FETCH_SCHEDULED_MEETING: return "FETCH_SCHEDULED_MEETING";
         case TYPE_FETCH_SCHEDULED_MEETING_OCCURRENCES: return "FETCH_SCHEDULED_MEETING_EVENTS";
+        case TYPE_SET_ATTR_NODES: return "SET_ATTR_NODES";
+        case TYPE_MOVE_NODES: return "MOVE_NODES";
+        case TYPE_SEARCH: return "SEARCH";
+        case TYPE_PUT_SET_ELEMENTS: return "PUT_SET_ELEMENTS";
+        case TYPE_REMOVE_SET_ELEMENTS: return "REMOVE_SET_ELEMENTS";
     }
     return "UNKNOWN";
 }
@@ -4647,6 +4844,46 @@ MegaNodeListPrivate::~MegaNodeListPrivate()
     delete [] list;
 }
 
+MegaHandle MegaNodeViewPrivate::getHandle() const
+{
+    return mNode->nodehandle;
+}
+
+MegaHandle MegaNodeViewPrivate::getParentHandle() const
+{
+    return mNode->parent ? mNode->parent->nodehandle : mNode->parenthandle;
+}
+
+int MegaNodeViewPrivate::getType() const
+{
+    return mNode->type;
+}
+
+const char* MegaNodeViewPrivate::getName() const
+{
+    return mNode->displayname();
+}
+
+int64_t MegaNodeViewPrivate::getSize() const
+{
+    return mNode->size;
+}
+
+int64_t MegaNodeViewPrivate::getCreationTime() const
+{
+    return mNode->ctime;
+}
+
+int64_t MegaNodeViewPrivate::getModificationTime() const
+{
+    return mNode->type == FILENODE ? mNode->mtime : 0;
+}
+
+MegaNode* MegaNodeViewPrivate::copy() const
+{
+    return MegaNodePrivate::fromNode(mNode);
+}
+
 MegaNodeList *MegaNodeListPrivate::copy() const
 {
     return new MegaNodeListPrivate(this);
@@ -4702,6 +4939,81 @@ void MegaNodeListPrivate::addNode(MegaNode *node)
     }
 }
 
+MegaNodeUpdateListPrivate::MegaNodeUpdateListPrivate(Node** nodes, int size)
+{
+    mUpdates.resize(size_t(size));
+    for (int i = 0; i < size; i++)
+    {
+        Update& u = mUpdates[size_t(i)];
+        u.handle = nodes[i]->nodehandle;
+        u.parentHandle = nodes[i]->parent ? nodes[i]->parent->nodehandle : INVALID_HANDLE;
+        u.changes = MegaNodePrivate::changesOf(nodes[i]);
+        u.node = nodes[i];
+    }
+
+    s = size;
+    list = s ? new MegaNode*[s]() : NULL;
+}
+
+MegaNodeUpdateListPrivate::MegaNodeUpdateListPrivate(vector<Update>&& updates)
+    : mUpdates(std::move(updates))
+{
+    s = static_cast<int>(mUpdates.size());
+    list = s ? new MegaNode*[s]() : NULL;
+
+    for (int i = 0; i < s; i++)
+    {
+        list[i] = mUpdates[size_t(i)].snapshot.release();
+    }
+}
+
+MegaNode* MegaNodeUpdateListPrivate::get(int i) const
+{
+    if (!list || i < 0 || i >= s)
+    {
+        return NULL;
+    }
+
+    if (!list[i] && size_t(i) < mUpdates.size() && mUpdates[size_t(i)].node)
+    {
+        MegaNodePrivate* node = static_cast<MegaNodePrivate*>(MegaNodePrivate::fromNode(mUpdates[size_t(i)].node));
+        node->setChanges(mUpdates[size_t(i)].changes);
+        list[i] = node;
+    }
+
+    return list[i];
+}
+
+MegaHandle MegaNodeUpdateListPrivate::getHandle(int i) const
+{
+    if (i < 0 || size_t(i) >= mUpdates.size())
+    {
+        return MegaNodeListPrivate::getHandle(i);
+    }
+
+    return mUpdates[size_t(i)].handle;
+}
+
+int MegaNodeUpdateListPrivate::getChanges(int i) const
+{
+    if (i < 0 || size_t(i) >= mUpdates.size())
+    {
+        return MegaNodeListPrivate::getChanges(i);
+    }
+
+    return mUpdates[size_t(i)].changes;
+}
+
+MegaHandle MegaNodeUpdateListPrivate::getParentHandle(int i) const
+{
+    if (i < 0 || size_t(i) >= mUpdates.size())
+    {
+        return MegaNodeListPrivate::getParentHandle(i);
+    }
+
+    return mUpdates[size_t(i)].parentHandle;
+}
+
 MegaUserListPrivate::MegaUserListPrivate()
 {
     list = NULL;
@@ -4991,6 +5303,51 @@ int MegaShareListPrivate::size()
     return s;
 }
 
+MegaTransferProgressListPrivate::MegaTransferProgressListPrivate(vector<Entry>&& entries)
+    : mEntries(std::move(entries))
+{
+}
+
+MegaTransferProgressList* MegaTransferProgressListPrivate::copy() const
+{
+    return new MegaTransferProgressListPrivate(vector<Entry>(mEntries));
+}
+
+int MegaTransferProgressListPrivate::size() const
+{
+    return static_cast<int>(mEntries.size());
+}
+
+const MegaTransferProgressListPrivate::Entry* MegaTransferProgressListPrivate::entry(int i) const
+{
+    return i >= 0 && size_t(i) < mEntries.size() ? &mEntries[size_t(i)] : nullptr;
+}
+
+int MegaTransferProgressListPrivate::getTag(int i) const
+{
+    return entry(i) ? entry(i)->tag : 0;
+}
+
+int MegaTransferProgressListPrivate::getType(int i) const
+{
+    return entry(i) ? entry(i)->type : -1;
+}
+
+long long MegaTransferProgressListPrivate::getTransferredBytes(int i) const
+{
+    return entry(i) ? entry(i)->transferredBytes : 0;
+}
+
+long long MegaTransferProgressListPrivate::getTotalBytes(int i) const
+{
+    return entry(i) ? entry(i)->totalBytes : 0;
+}
+
+long long MegaTransferProgressListPrivate::getSpeed(int i) const
+{
+    return entry(i) ? entry(i)->speed : 0;
+}
+
 MegaTransferListPrivate::MegaTransferListPrivate()
 {
     list = NULL;
@@ -5469,8 +5826,10 @@ void *MegaApiImpl::threadEntryPoint(void *param)
     ::sigaction(SIGPIPE, &noaction, 0);
 #endif
 
+    ThreadTopology::threadStarted(ThreadTopology::CLIENT);
     MegaApiImpl *megaApiImpl = (MegaApiImpl *)param;
     megaApiImpl->loop();
+    ThreadTopology::threadStopped(ThreadTopology::CLIENT);
     return 0;
 }
 
@@ -5518,6 +5877,8 @@ void MegaApiImpl::init(MegaApi *api, const char *appKey, MegaGfxProcessor* proce
     httpServer = NULL;
     httpServerMaxBufferSize = 0;
     httpServerMaxOutputSize = 0;
+    httpServerEventLoops = 1;
+    httpServerKernelTls = false;
     httpServerEnableFiles = true;
     httpServerEnableFolders = false;
     httpServerOfflineAttributeEnabled = false;
@@ -5527,6 +5888,8 @@ void MegaApiImpl::init(MegaApi *api, const char *appKey, MegaGfxProcessor* proce
     ftpServer = NULL;
     ftpServerMaxBufferSize = 0;
     ftpServerMaxOutputSize = 0;
+    ftpServerUploadPipelining = false;
+    ftpServerKernelTls = false;
     ftpServerRestrictedMode = MegaApi::TCP_SERVER_ALLOW_CREATED_LOCAL_LINKS;
     const char *uvversion = uv_version_string();
     if (uvversion)
@@ -5561,6 +5924,18 @@ void MegaApiImpl::init(MegaApi *api, const char *appKey, MegaGfxProcessor* proce
     else
     {
         gfxAccess = new GfxProc(::mega::make_unique<MegaGfxProvider>());
+#if USE_FREEIMAGE
+        // each FreeImage provider keeps its own bitmap, so they can process jobs in parallel
+        unsigned gfxThreads = ThreadTopology::poolSize(ThreadTopology::GFX, 1);
+        for (unsigned i = 1; i < gfxThreads; i++)
+        {
+            gfxAccess->addProvider(::mega::make_unique<MegaGfxProvider>());
+        }
+#ifdef HAVE_PDFIUM
+        // PDF documents can take long to render, they get a thread of their own
+        gfxAccess->addSlowLaneProvider(::mega::make_unique<MegaGfxProvider>());
+#endif
+#endif
         gfxAccess->startProcessingThread();
     }
 
@@ -5588,6 +5963,13 @@ void MegaApiImpl::init(MegaApi *api, const char *appKey, MegaGfxProcessor* proce
 
 MegaApiImpl::~MegaApiImpl()
 {
+    // deliver what is queued to the app listeners while the SDK is still up, then go synchronous
+    mListenerDispatcher = nullptr;
+    {
+        std::lock_guard<std::mutex> g(mListenerDispatchersMutex);
+        mListenerDispatchers.clear();
+    }
+
     // the fireOnFinish won't be called for this one, so delete it ourselves
     auto shutdownRequest = ::mega::make_unique<MegaRequestPrivate>(MegaRequest::TYPE_DELETE);
 
@@ -5619,6 +6001,11 @@ MegaApiImpl* MegaApiImpl::ImplOf(MegaApi* api)
 
 void MegaApiImpl::loggedInStateChanged(sessiontype_t s, handle me)
 {
+    {
+        std::lock_guard<std::mutex> g(mNodeSnapshotMutex);
+        mNodeSnapshot.clear();
+    }
+
     std::lock_guard<std::mutex> g(mLastRecievedLoggedMeMutex);
     mLastReceivedLoggedInState = s;
     mLastReceivedLoggedInMeHandle = me;
@@ -6723,12 +7110,15 @@ void MegaApiImpl::loop()
 
         if (r & Waiter::NEEDEXEC)
         {
+            ThreadTopology::Busy busy(ThreadTopology::CLIENT);
             WAIT_CLASS::bumpds();
             updateBackups();
+            ExecLoopProfiler::Scope sendTransfersScope(client->loopProfiler, ExecLoopProfiler::TRANSFERS);
             if (sendPendingTransfers(nullptr))
             {
                 yield();
             }
+            sendTransfersScope.stop();
             sendPendingRequests();
             sendPendingScRequest();
             if (threadExit)
@@ -6739,6 +7129,8 @@ void MegaApiImpl::loop()
             {
                 SdkMutexGuard g(sdkMutex);
                 client->exec();
+                flushNodesUpdates();
+                fireOnTransfersProgress();
             }
         }
     }
@@ -6811,6 +7203,23 @@ void MegaApiImpl::moveNode(MegaNode *node, MegaNode *newParent, MegaRequestListe
     moveNode(node, newParent, nullptr, listener);
 }
 
+void MegaApiImpl::moveNodes(MegaNodeList *nodes, MegaNode *newParent, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_MOVE_NODES, listener);
+    if (nodes)
+    {
+        vector<handle> handles;
+        for (int i = 0; i < nodes->size(); i++)
+        {
+            handles.push_back(nodes->get(i)->getHandle());
+        }
+        request->setMegaHandleList(handles);
+    }
+    if(newParent) request->setParentHandle(newParent->getHandle());
+    requestQueue.push(request);
+    waiter->notify();
+}
+
 void MegaApiImpl::copyNode(MegaNode *node, MegaNode* target, MegaRequestListener *listener)
 {
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_COPY, listener);
@@ -7011,6 +7420,39 @@ void MegaApiImpl::cancelGetPreview(MegaNode* node, MegaRequestListener *listener
     cancelGetNodeAttribute(node, GfxProc::PREVIEW, listener);
 }
 
+void MegaApiImpl::cancelGetThumbnailsExcept(MegaHandleList* nodeHandles, MegaRequestListener *listener)
+{
+    cancelGetNodeAttributesExcept(nodeHandles, GfxProc::THUMBNAIL, listener);
+}
+
+void MegaApiImpl::cancelGetPreviewsExcept(MegaHandleList* nodeHandles, MegaRequestListener *listener)
+{
+    cancelGetNodeAttributesExcept(nodeHandles, GfxProc::PREVIEW, listener);
+}
+
+bool MegaApiImpl::setFileAttributesCache(const char* path, long long maxSize)
+{
+    shared_ptr<FileAttributeCache> cache;
+    if (path)
+    {
+        if (maxSize <= 0)
+        {
+            return false;
+        }
+
+        cache = std::make_shared<FileAttributeCache>(LocalPath::fromAbsolutePath(path), maxSize);
+        if (!cache->init())
+        {
+            LOG_err << "Unable to set the file attributes cache at " << path;
+            return false;
+        }
+    }
+
+    SdkMutexGuard g(sdkMutex);
+    mFileAttributeCache = std::move(cache);
+    return true;
+}
+
 void MegaApiImpl::setPreview(MegaNode* node, const char *srcFilePath, MegaRequestListener *listener)
 {
     setNodeAttribute(node, GfxProc::PREVIEW, srcFilePath, INVALID_HANDLE, listener);
@@ -7211,6 +7653,24 @@ void MegaApiImpl::setCustomNodeAttribute(MegaNode *node, const char *attrName, c
     waiter->notify();
 }
 
+void MegaApiImpl::setNodesCustomAttribute(MegaNodeList *nodes, const char *attrName, const char *value, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SET_ATTR_NODES, listener);
+    if (nodes)
+    {
+        vector<handle> handles;
+        for (int i = 0; i < nodes->size(); i++)
+        {
+            handles.push_back(nodes->get(i)->getHandle());
+        }
+        request->setMegaHandleList(handles);
+    }
+    request->setName(attrName);
+    request->setText(value);
+    requestQueue.push(request);
+    waiter->notify();
+}
+
 void MegaApiImpl::setNodeS4(MegaNode *node, const char *value, MegaRequestListener *listener)
 {
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SET_ATTR_NODE, listener);
@@ -7731,6 +8191,23 @@ void MegaApiImpl::cancelGetNodeAttribute(MegaNode *node, int type, MegaRequestLi
     waiter->notify();
 }
 
+void MegaApiImpl::cancelGetNodeAttributesExcept(MegaHandleList* nodeHandles, int type, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CANCEL_ATTR_FILE, listener);
+    request->setParamType(type);
+    request->setFlag(true);
+
+    vector<handle> handles;
+    for (int i = 0; nodeHandles && i < nodeHandles->size(); i++)
+    {
+        handles.push_back(nodeHandles->get(i));
+    }
+    request->setMegaHandleList(handles);
+
+    requestQueue.push(request);
+    waiter->notify();
+}
+
 void MegaApiImpl::setNodeAttribute(MegaNode *node, int type, const char *srcFilePath, MegaHandle attributehandle, MegaRequestListener *listener)
 {
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SET_ATTR_FILE, listener);
@@ -8222,6 +8699,181 @@ bool MegaApiImpl::setMaxDownloadSpeed(m_off_t bpslimit)
     return client->setmaxdownloadspeed(bpslimit);
 }
 
+bool MegaApiImpl::setHttp2Multiplexing(bool enable)
+{
+    SdkMutexGuard g(sdkMutex);
+    return client->setmultiplexing(enable);
+}
+
+void MegaApiImpl::setRequestBatching(int maxCommands, long long maxBytes, int lingerMs)
+{
+    RequestDispatcher::BatchPolicy policy;
+    policy.maxCommands = size_t(std::max(maxCommands, 1));
+    policy.maxBytes = size_t(std::max<long long>(maxBytes, 0));
+    policy.lingerDs = dstime(std::max(lingerMs, 0) + 99) / 100;
+
+    SdkMutexGuard g(sdkMutex);
+    client->reqs.setBatchPolicy(policy);
+    waiter->notify();
+}
+
+void MegaApiImpl::setLocalCacheCommitGrouping(int maxLagMs, int maxPending)
+{
+    SdkMutexGuard g(sdkMutex);
+    client->setScCommitGrouping(dstime(std::max(maxLagMs, 0) + 99) / 100, unsigned(std::max(maxPending, 0)));
+    waiter->notify();
+}
+
+void MegaApiImpl::setLocalCacheTuning(long long mmapSizeBytes, long long cacheSizeKb, int walCheckpointPages)
+{
+    SdkMutexGuard g(sdkMutex);
+    if (!client->dbaccess)
+    {
+        return;
+    }
+
+    DbAccess::Tuning& tuning = client->dbaccess->tuning;
+    tuning.mmapSize = std::max<long long>(mmapSizeBytes, -1);
+    tuning.cacheSizeKb = std::max<long long>(cacheSizeKb, 0);
+    tuning.walCheckpointPages = std::max(walCheckpointPages, 0);
+}
+
+void MegaApiImpl::setSlowLoopThreshold(int milliseconds)
+{
+    SdkMutexGuard g(sdkMutex);
+    client->loopProfiler.setSlowThreshold(std::chrono::milliseconds(std::max(milliseconds, 0)));
+}
+
+MegaMemoryReport* MegaApiImpl::getMemoryReport()
+{
+    MemoryReport report;
+    {
+        SdkMutexGuard g(sdkMutex);
+        client->addMemoryUsage(report);
+    }
+
+    // shared by all the MegaApi objects of the process
+    TransferBufferPool::Stats pool = TransferBufferPool::stats(false);
+    report.add("transferBufferPool", pool.cachedBuffers, pool.cachedBytes);
+    report.add("streamingBuffers", StreamingBuffer::totalBuffers(), StreamingBuffer::totalAllocated());
+
+    return new MegaMemoryReportPrivate(std::move(report));
+}
+
+void MegaApiImpl::setParallelRequests(int count)
+{
+    SdkMutexGuard g(sdkMutex);
+    client->reqs.setParallelBatches(size_t(std::max(count, 0)));
+    waiter->notify();
+}
+
+void MegaApiImpl::setFolderDownloadBatchSize(int nodes)
+{
+    mFolderDownloadBatchSize = std::max(nodes, 0);
+}
+
+void MegaApiImpl::setNodesUpdateCoalescing(bool enable)
+{
+    mCoalesceNodesUpdates = enable;
+}
+
+void MegaApiImpl::setListenerDispatchThreads(int threads)
+{
+    std::lock_guard<std::mutex> g(mListenerDispatchersMutex);
+    if (threads > 0)
+    {
+        mListenerDispatchers.emplace_back(new ListenerDispatcher(unsigned(threads)));
+        mListenerDispatcher = mListenerDispatchers.back().get();
+    }
+    else
+    {
+        mListenerDispatcher = nullptr;
+    }
+}
+
+// THREAD_POOL_* values are the ThreadTopology roles
+static_assert(MegaApi::THREAD_POOL_FINGERPRINT == ThreadTopology::FINGERPRINT && ThreadTopology::NUM_ROLES == 5,
+              "THREAD_POOL_* values don't match ThreadTopology::Role");
+
+static bool isThreadPool(int pool)
+{
+    return pool >= MegaApi::THREAD_POOL_CLIENT && pool < ThreadTopology::NUM_ROLES;
+}
+
+bool MegaApiImpl::setThreadPoolConfig(int pool, int size, MegaIntegerList *cpus, int niceLevel)
+{
+    if (!isThreadPool(pool) || size < 0)
+    {
+        return false;
+    }
+
+    ThreadTopology::Settings settings;
+    settings.poolSize = (pool == MegaApi::THREAD_POOL_CLIENT) ? 0u : unsigned(size);
+    settings.nice = niceLevel;
+    for (int i = 0; cpus && i < cpus->size(); i++)
+    {
+        settings.cpus.push_back(static_cast<int>(cpus->get(i)));
+    }
+
+    ThreadTopology::configure(static_cast<ThreadTopology::Role>(pool), settings);
+    return true;
+}
+
+int MegaApiImpl::getThreadPoolThreadCount(int pool)
+{
+    return isThreadPool(pool) ? static_cast<int>(ThreadTopology::stats(static_cast<ThreadTopology::Role>(pool), false).threads) : 0;
+}
+
+long long MegaApiImpl::getThreadPoolQueueDepth(int pool)
+{
+    return isThreadPool(pool) ? ThreadTopology::stats(static_cast<ThreadTopology::Role>(pool), false).queueDepth : 0;
+}
+
+double MegaApiImpl::getThreadPoolUtilization(int pool, bool reset)
+{
+    return isThreadPool(pool) ? ThreadTopology::stats(static_cast<ThreadTopology::Role>(pool), reset).utilization : 0;
+}
+
+// MegaMetricsSnapshot::TYPE_* values are the Metrics types
+static_assert(MegaMetricsSnapshot::TYPE_COUNTER == Metrics::COUNTER && MegaMetricsSnapshot::TYPE_GAUGE == Metrics::GAUGE
+              && MegaMetricsSnapshot::TYPE_HISTOGRAM == Metrics::HISTOGRAM,
+              "MegaMetricsSnapshot::TYPE_* values don't match Metrics::Type");
+
+MegaMetricsSnapshot* MegaApiImpl::getMetricsSnapshot()
+{
+    return new MegaMetricsSnapshotPrivate(Metrics::snapshot());
+}
+
+void MegaApiImpl::setSharedWorkers(bool enable)
+{
+    MegaClientAsyncQueue::setSharedWorkers(enable);
+}
+
+void MegaApiImpl::setTransferUpdatePolicy(int minIntervalMs, long long minBytes, bool aggregate)
+{
+    mTransferUpdateIntervalDs = dstime((std::max(minIntervalMs, 0) + 99) / 100);
+    mTransferUpdateMinBytes = std::max(minBytes, 0ll);
+    mTransferUpdatesAggregated = aggregate;
+}
+
+void MegaApiImpl::forgetListener(const void* listener)
+{
+    vector<ListenerDispatcher*> dispatchers;
+    {
+        std::lock_guard<std::mutex> g(mListenerDispatchersMutex);
+        for (auto& d : mListenerDispatchers)
+        {
+            dispatchers.push_back(d.get());
+        }
+    }
+
+    // without any lock: the running callback may be calling into the MegaApi
+    for (ListenerDispatcher* d : dispatchers)
+    {
+        d->forget(listener);
+    }
+}
+
 bool MegaApiImpl::setMaxUploadSpeed(m_off_t bpslimit)
 {
     SdkMutexGuard g(sdkMutex);
@@ -8688,6 +9340,70 @@ void MegaApiImpl::startDownload (bool startFirst, MegaNode *node, const char* lo
     waiter->notify();
 }
 
+void MegaApiImpl::startUploads(MegaStringList* localPaths, MegaNode* parent, const char* appData, bool startFirst, CancelToken cancelToken, MegaTransferListener* listener)
+{
+    if (!localPaths || !localPaths->size())
+    {
+        return;
+    }
+
+    std::vector<MegaTransferPrivate*> batch;
+    batch.reserve(size_t(localPaths->size()));
+
+    // sources are mostly siblings: only look up the filesystem type of each folder once
+    LocalPath lastFolder;
+    FileSystemType fsType = FS_UNKNOWN;
+
+    for (int i = 0; i < localPaths->size(); i++)
+    {
+        const char* localPath = localPaths->get(i);
+        if (localPath)
+        {
+            LocalPath folder = LocalPath::fromAbsolutePath(localPath);
+            folder = folder.parentPath();
+            if (batch.empty() || folder != lastFolder)
+            {
+                fsType = fsAccess->getlocalfstype(folder);
+                lastFolder = std::move(folder);
+            }
+        }
+
+        batch.push_back(createUploadTransfer(startFirst, localPath, parent, nullptr, nullptr, MegaApi::INVALID_CUSTOM_MOD_TIME,
+                                             0, false, appData, false, false, fsType, cancelToken, listener));
+    }
+
+    transferQueue.push(batch);
+    waiter->notify();
+}
+
+void MegaApiImpl::startDownloads(MegaNodeList* nodes, const char* localFolder, const char* appData, bool startFirst, CancelToken cancelToken, MegaTransferListener* listener)
+{
+    if (!nodes || !nodes->size())
+    {
+        return;
+    }
+
+    // every node goes inside the folder, named as in MEGA
+    string folder = localFolder ? localFolder : "";
+    if (!folder.empty() && folder.back() != LocalPath::localPathSeparator_utf8)
+    {
+        folder.push_back(LocalPath::localPathSeparator_utf8);
+    }
+
+    FileSystemType fsType = folder.empty() ? FS_UNKNOWN : fsAccess->getlocalfstype(LocalPath::fromAbsolutePath(folder));
+
+    std::vector<MegaTransferPrivate*> batch;
+    batch.reserve(size_t(nodes->size()));
+    for (int i = 0; i < nodes->size(); i++)
+    {
+        batch.push_back(createDownloadTransfer(startFirst, nodes->get(i), folder.empty() ? nullptr : folder.c_str(),
+                                               nullptr, 0, appData, cancelToken, listener, fsType));
+    }
+
+    transferQueue.push(batch);
+    waiter->notify();
+}
+
 MegaTransferPrivate* MegaApiImpl::createDownloadTransfer(bool startFirst, MegaNode *node, const char* localPath, const char *customName, int folderTransferTag, const char *appData, CancelToken cancelToken, MegaTransferListener *listener, FileSystemType fsType)
 {
     MegaTransferPrivate* transfer = new MegaTransferPrivate(MegaTransfer::TYPE_DOWNLOAD, listener);
@@ -8762,7 +9478,7 @@ void MegaApiImpl::cancelTransfers(int direction, MegaRequestListener *listener)
     waiter->notify();
 }
 
-void MegaApiImpl::startStreaming(MegaNode* node, m_off_t startPos, m_off_t size, MegaTransferListener *listener)
+void MegaApiImpl::startStreaming(MegaNode* node, m_off_t startPos, m_off_t size, MegaTransferListener *listener, bool sequential)
 {
     MegaTransferPrivate* transfer = new MegaTransferPrivate(MegaTransfer::TYPE_DOWNLOAD, listener);
 
@@ -8776,6 +9492,7 @@ void MegaApiImpl::startStreaming(MegaNode* node, m_off_t startPos, m_off_t size,
     }
 
     transfer->setStreamingTransfer(true);
+    transfer->setSequentialRead(sequential);
     transfer->setStartPos(startPos);
     transfer->setEndPos(startPos + size - 1);
     transfer->setMaxRetries(maxRetries);
@@ -9208,7 +9925,7 @@ void MegaApiImpl::setExcludedNames(vector<string> *excludedNames)
         LocalPath::utf8_normalize(&name);
         if (name.size())
         {
-            this->excludedNames.push_back(name);
+            this->excludedNames.add(name);
             LOG_debug << "Excluded name: " << name;
         }
         else
@@ -9224,17 +9941,21 @@ void MegaApiImpl::setExcludedPaths(vector<string> *excludedPaths)
     if (!excludedPaths)
     {
         this->excludedPaths.clear();
+        excludedPathPatterns.clear();
         return;
     }
 
     this->excludedPaths.clear();
+    excludedPathPatterns.clear();
     for (unsigned int i = 0; i < excludedPaths->size(); i++)
     {
         string path = excludedPaths->at(i);
         LocalPath::utf8_normalize(&path);
         if (path.size())
         {
-            this->excludedPaths.push_back(path);
+            // compiled once here, rather than for every path that is checked
+            this->excludedPaths.push_back(LocalPath::fromAbsolutePath(path));
+            excludedPathPatterns.add(path);
             LOG_debug << "Excluded path: " << path;
         }
         else
@@ -9717,6 +10438,8 @@ bool MegaApiImpl::httpServerStart(bool localOnly, int port, bool useTLS, const c
     httpServer = new MegaHTTPServer(this, basePath, useTLS, certificatepath ? certificatepath : string(), keypath ? keypath : string(), useIPv6);
     httpServer->setMaxBufferSize(httpServerMaxBufferSize);
     httpServer->setMaxOutputSize(httpServerMaxOutputSize);
+    httpServer->setEventLoops(httpServerEventLoops);
+    httpServer->setKernelTls(httpServerKernelTls);
     httpServer->enableFileServer(httpServerEnableFiles);
     httpServer->enableOfflineAttribute(httpServerOfflineAttributeEnabled);
     httpServer->enableFolderServer(httpServerEnableFolders);
@@ -9907,6 +10630,30 @@ int MegaApiImpl::httpServerGetMaxOutputSize()
     }
 }
 
+void MegaApiImpl::httpServerSetEventLoops(int loops)
+{
+    SdkMutexGuard g(sdkMutex);
+    httpServerEventLoops = loops < 1 ? 1 : loops;
+}
+
+int MegaApiImpl::httpServerGetEventLoops()
+{
+    SdkMutexGuard g(sdkMutex);
+    return httpServerEventLoops;
+}
+
+void MegaApiImpl::httpServerEnableKernelTls(bool enable)
+{
+    SdkMutexGuard g(sdkMutex);
+    httpServerKernelTls = enable;
+}
+
+bool MegaApiImpl::httpServerIsKernelTlsEnabled()
+{
+    SdkMutexGuard g(sdkMutex);
+    return httpServerKernelTls;
+}
+
 void MegaApiImpl::httpServerEnableFileServer(bool enable)
 {
     SdkMutexGuard g(sdkMutex);
@@ -10019,20 +10766,26 @@ void MegaApiImpl::httpServerRemoveListener(MegaTransferListener *listener)
         return;
     }
 
-    SdkMutexGuard g(sdkMutex);
-    httpServerListeners.erase(listener);
+    {
+        SdkMutexGuard g(sdkMutex);
+        httpServerListeners.erase(listener);
+    }
+    forgetListener(listener);
 }
 
 void MegaApiImpl::fireOnStreamingStart(MegaTransferPrivate *transfer)
 {
-    for(set<MegaTransferListener *>::iterator it = httpServerListeners.begin(); it != httpServerListeners.end() ; it++)
-        (*it)->onTransferStart(api, transfer);
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaTransfer> t = fanout.share<MegaTransfer>(transfer);
+    fanout.call(httpServerListeners, [this, t](MegaTransferListener* l) { l->onTransferStart(api, t.get()); });
 }
 
 void MegaApiImpl::fireOnStreamingTemporaryError(MegaTransferPrivate *transfer, unique_ptr<MegaErrorPrivate> e)
 {
-    for(set<MegaTransferListener *>::iterator it = httpServerListeners.begin(); it != httpServerListeners.end() ; it++)
-        (*it)->onTransferTemporaryError(api, transfer, e.get());
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaTransfer> t = fanout.share<MegaTransfer>(transfer);
+    std::shared_ptr<MegaError> error = fanout.share<MegaError>(e.get());
+    fanout.call(httpServerListeners, [this, t, error](MegaTransferListener* l) { l->onTransferTemporaryError(api, t.get(), error.get()); });
 }
 
 void MegaApiImpl::fireOnStreamingFinish(MegaTransferPrivate *transfer, unique_ptr<MegaErrorPrivate> e)
@@ -10046,10 +10799,12 @@ void MegaApiImpl::fireOnStreamingFinish(MegaTransferPrivate *transfer, unique_pt
         LOG_info << "Streaming request finished";
     }
 
-    for(set<MegaTransferListener *>::iterator it = httpServerListeners.begin(); it != httpServerListeners.end() ; it++)
-        (*it)->onTransferFinish(api, transfer, e.get());
+    ListenerFanout fanout(mListenerDispatcher.load());
 
-    delete transfer;
+    // the transfer goes once every listener has seen it
+    std::shared_ptr<MegaTransfer> t(transfer);
+    std::shared_ptr<MegaError> error = fanout.share<MegaError>(e.get());
+    fanout.call(httpServerListeners, [this, t, error](MegaTransferListener* l) { l->onTransferFinish(api, t.get(), error.get()); });
 }
 
 bool MegaApiImpl::ftpServerStart(bool localOnly, int port, int dataportBegin, int dataPortEnd, bool useTLS, const char *certificatepath, const char *keypath)
@@ -10075,6 +10830,8 @@ bool MegaApiImpl::ftpServerStart(bool localOnly, int port, int dataportBegin, in
     ftpServer->setRestrictedMode(ftpServerRestrictedMode);
     ftpServer->setMaxBufferSize(ftpServerMaxBufferSize);
     ftpServer->setMaxOutputSize(ftpServerMaxOutputSize);
+    ftpServer->setUploadPipelining(ftpServerUploadPipelining);
+    ftpServer->setKernelTls(ftpServerKernelTls);
 
     bool result = ftpServer->start(port, localOnly);
     if (!result)
@@ -10242,6 +10999,64 @@ int MegaApiImpl::ftpServerGetMaxOutputSize()
     }
 }
 
+void MegaApiImpl::ftpServerSetUploadPipelining(bool enable)
+{
+    SdkMutexGuard g(sdkMutex);
+    ftpServerUploadPipelining = enable;
+    if (ftpServer)
+    {
+        ftpServer->setUploadPipelining(enable);
+    }
+}
+
+bool MegaApiImpl::ftpServerIsUploadPipelining()
+{
+    SdkMutexGuard g(sdkMutex);
+    return ftpServerUploadPipelining;
+}
+
+void MegaApiImpl::ftpServerEnableKernelTls(bool enable)
+{
+    SdkMutexGuard g(sdkMutex);
+    ftpServerKernelTls = enable;
+}
+
+bool MegaApiImpl::ftpServerIsKernelTlsEnabled()
+{
+    SdkMutexGuard g(sdkMutex);
+    return ftpServerKernelTls;
+}
+
+bool MegaApiImpl::setStreamingCache(const char* path, long long maxSize)
+{
+    shared_ptr<StreamingCache> cache;
+    if (path)
+    {
+        if (maxSize <= 0)
+        {
+            return false;
+        }
+
+        cache = std::make_shared<StreamingCache>(LocalPath::fromAbsolutePath(path), maxSize);
+        if (!cache->init())
+        {
+            LOG_err << "Unable to set the streaming cache at " << path;
+            return false;
+        }
+    }
+
+    // ongoing streams keep the one they started with
+    SdkMutexGuard g(sdkMutex);
+    mStreamingCache = std::move(cache);
+    return true;
+}
+
+shared_ptr<StreamingCache> MegaApiImpl::getStreamingCache()
+{
+    SdkMutexGuard g(sdkMutex);
+    return mStreamingCache;
+}
+
 void MegaApiImpl::ftpServerSetRestrictedMode(int mode)
 {
     if (mode != MegaApi::TCP_SERVER_DENY_ALL
@@ -10294,22 +11109,28 @@ void MegaApiImpl::ftpServerRemoveListener(MegaTransferListener *listener)
         return;
     }
 
-    SdkMutexGuard g(sdkMutex);
-    ftpServerListeners.erase(listener);
+    {
+        SdkMutexGuard g(sdkMutex);
+        ftpServerListeners.erase(listener);
+    }
+    forgetListener(listener);
 }
 
 void MegaApiImpl::fireOnFtpStreamingStart(MegaTransferPrivate *transfer)
 {
     assert(threadId == std::this_thread::get_id());
-    for(set<MegaTransferListener *>::iterator it = ftpServerListeners.begin(); it != ftpServerListeners.end() ; it++)
-        (*it)->onTransferStart(api, transfer);
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaTransfer> t = fanout.share<MegaTransfer>(transfer);
+    fanout.call(ftpServerListeners, [this, t](MegaTransferListener* l) { l->onTransferStart(api, t.get()); });
 }
 
 void MegaApiImpl::fireOnFtpStreamingTemporaryError(MegaTransferPrivate *transfer, unique_ptr<MegaErrorPrivate> e)
 {
     assert(threadId == std::this_thread::get_id());
-    for(set<MegaTransferListener *>::iterator it = ftpServerListeners.begin(); it != ftpServerListeners.end() ; it++)
-        (*it)->onTransferTemporaryError(api, transfer, e.get());
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaTransfer> t = fanout.share<MegaTransfer>(transfer);
+    std::shared_ptr<MegaError> error = fanout.share<MegaError>(e.get());
+    fanout.call(ftpServerListeners, [this, t, error](MegaTransferListener* l) { l->onTransferTemporaryError(api, t.get(), error.get()); });
 }
 
 void MegaApiImpl::fireOnFtpStreamingFinish(MegaTransferPrivate *transfer, unique_ptr<MegaErrorPrivate> e)
@@ -10324,10 +11145,12 @@ void MegaApiImpl::fireOnFtpStreamingFinish(MegaTransferPrivate *transfer, unique
         LOG_info << "Streaming request finished";
     }
 
-    for(set<MegaTransferListener *>::iterator it = ftpServerListeners.begin(); it != ftpServerListeners.end() ; it++)
-        (*it)->onTransferFinish(api, transfer, e.get());
+    ListenerFanout fanout(mListenerDispatcher.load());
 
-    delete transfer;
+    // the transfer goes once every listener has seen it
+    std::shared_ptr<MegaTransfer> t(transfer);
+    std::shared_ptr<MegaError> error = fanout.share<MegaError>(e.get());
+    fanout.call(ftpServerListeners, [this, t, error](MegaTransferListener* l) { l->onTransferFinish(api, t.get(), error.get()); });
 }
 
 #endif
@@ -10990,29 +11813,87 @@ MegaUserAlertList* MegaApiImpl::getUserAlerts()
     SdkMutexGuard g(sdkMutex);
 
     vector<UserAlert::Base*> v;
-    v.reserve(client->useralerts.alerts.size());
-    for (UserAlerts::Alerts::iterator it = client->useralerts.alerts.begin(); it != client->useralerts.alerts.end(); ++it)
+    vector<unique_ptr<UserAlert::Base>> loaded;
+    client->useralerts.getAlerts(0, SIZE_MAX, v, loaded);
+    std::reverse(v.begin(), v.end());
+    return new MegaUserAlertListPrivate(v.data(), int(v.size()), client);
+}
+
+MegaUserAlertList* MegaApiImpl::getUserAlerts(int offset, int count)
+{
+    if (offset < 0 || count <= 0)
     {
-        if (!(*it)->removed())
-        {
-            v.push_back(*it);
-        }
+        return new MegaUserAlertListPrivate();
     }
+
+    SdkMutexGuard g(sdkMutex);
+
+    vector<UserAlert::Base*> v;
+    vector<unique_ptr<UserAlert::Base>> loaded;
+    client->useralerts.getAlerts(size_t(offset), size_t(count), v, loaded);
     return new MegaUserAlertListPrivate(v.data(), int(v.size()), client);
 }
 
-int MegaApiImpl::getNumUnreadUserAlerts()
+MegaNodeList* MegaApiImpl::getUserAlertNodes(MegaUserAlert* alert)
 {
-    int result = 0;
+    if (!alert || alert->getType() != MegaUserAlert::TYPE_NEWSHAREDNODES)
+    {
+        return new MegaNodeListPrivate();
+    }
+
     SdkMutexGuard g(sdkMutex);
-    for (UserAlerts::Alerts::iterator it = client->useralerts.alerts.begin(); it != client->useralerts.alerts.end(); ++it)
+
+    Node* parent = client->nodebyhandle(alert->getNodeHandle());
+    if (!parent)
+    {
+        return new MegaNodeListPrivate();
+    }
+
+    // getNumber(0) counts the folders, getNumber(1) the files, and the listed handles come in that order
+    vector<Node*> nodes;
+    std::set<handle> listed;
+    for (int i = 0; i < 2; ++i)
     {
-        if (!(*it)->removed() && !(*it)->seen())
+        nodetype_t type = i ? FILENODE : FOLDERNODE;
+        size_t count = size_t(std::max<int64_t>(alert->getNumber(unsigned(i)), 0));
+        size_t first = nodes.size();
+
+        for (unsigned j = 0; alert->getHandle(j) != INVALID_HANDLE; ++j)
         {
-            result++;
+            Node* n = client->nodebyhandle(alert->getHandle(j));
+            if (n && n->type == type && listed.insert(n->nodehandle).second)
+            {
+                nodes.push_back(n);
+            }
+        }
+
+        if (nodes.size() - first < count)
+        {
+            node_vector children = client->mNodeManager.getChildrenFromType(parent, type, CancelToken());
+            std::sort(children.begin(), children.end(), [](const Node* a, const Node* b) { return a->ctime < b->ctime; });
+            for (Node* n : children)
+            {
+                if (nodes.size() - first >= count)
+                {
+                    break;
+                }
+
+                if (n->owner == alert->getUserHandle() && n->ctime >= alert->getTimestamp(0)
+                    && listed.insert(n->nodehandle).second)
+                {
+                    nodes.push_back(n);
+                }
+            }
         }
     }
-    return result;
+
+    return new MegaNodeListPrivate(nodes.data(), int(nodes.size()));
+}
+
+int MegaApiImpl::getNumUnreadUserAlerts()
+{
+    SdkMutexGuard g(sdkMutex);
+    return int(client->useralerts.unseenCount());
 }
 
 MegaNodeList* MegaApiImpl::getInShares(MegaUser *megaUser, int order)
@@ -11374,7 +12255,7 @@ MegaRecentActionBucketList* MegaApiImpl::getRecentActions(unsigned days, unsigne
 {
     SdkMutexGuard g(sdkMutex);
     m_time_t since = m_time() - days * 86400;
-    recentactions_vector v = client->getRecentActions(maxnodes, since);
+    recentactions_vector v = client->getRecentActions(maxnodes, since, isCurrentThread() ? nullptr : &g);
     return new MegaRecentActionBucketListPrivate(v, client);
 }
 
@@ -11462,6 +12343,71 @@ bool MegaApiImpl::processMegaTree(MegaNode* n, MegaTreeProcessor* processor, boo
     return processor->processMegaNode(n);
 }
 
+bool MegaApiImpl::processMegaTreeStreamed(MegaNode* n, MegaTreeProcessor* processor, int prefetch, int threads)
+{
+    if (!n || !processor || n->isForeign() || n->isPublic())
+    {
+        return false;
+    }
+
+    SdkMutexGuard g(sdkMutex);
+    if (!client->nodebyhandle(n->getHandle()))
+    {
+        return false;
+    }
+
+    // the processor works on copies of the nodes, so the client can be unlocked meanwhile
+    NodeManager::ClientLock* unlockable = isCurrentThread() ? nullptr : &g;
+    size_t workers = threads > 1 ? size_t(threads) : 1;
+
+    return client->mNodeManager.walkTree(NodeHandle().set6byte(n->getHandle()), prefetch > 0 ? size_t(prefetch) : 1, CancelToken(),
+        [&](const node_vector& nodes) -> bool
+        {
+            vector<unique_ptr<MegaNode>> megaNodes;
+            megaNodes.reserve(nodes.size());
+            for (Node* node : nodes)
+            {
+                megaNodes.emplace_back(MegaNodePrivate::fromNode(node));
+            }
+
+            if (unlockable)
+            {
+                unlockable->unlock();
+            }
+
+            std::atomic<size_t> next(0);
+            std::atomic<bool> proceed(true);
+            auto work = [&]()
+            {
+                size_t i;
+                while (proceed && (i = next++) < megaNodes.size())
+                {
+                    if (!processor->processMegaNode(megaNodes[i].get()))
+                    {
+                        proceed = false;
+                    }
+                }
+            };
+
+            vector<std::thread> helpers;
+            for (size_t i = 1; i < std::min(workers, megaNodes.size()); i++)
+            {
+                helpers.emplace_back(work);
+            }
+            work();
+            for (auto& t : helpers)
+            {
+                t.join();
+            }
+
+            if (unlockable)
+            {
+                unlockable->lock();
+            }
+
+            return bool(proceed);
+        }, unlockable);
+}
 
 MegaNode *MegaApiImpl::createForeignFileNode(MegaHandle handle, const char *key, const char *name, m_off_t size, m_off_t mtime,
                                             MegaHandle parentHandle, const char* privateauth, const char *publicauth, const char *chatauth)
@@ -11891,18 +12837,18 @@ void MegaApiImpl::resumeActionPackets()
     client->scpaused = false;
 }
 
-node_vector MegaApiImpl::searchInNodeManager(MegaHandle nodeHandle, const char *searchString, int type, CancelToken cancelToken, bool recursive)
+node_vector MegaApiImpl::searchInNodeManager(MegaHandle nodeHandle, const char *searchString, int type, CancelToken cancelToken, bool recursive, NodeManager::ClientLock* unlockable)
 {
     node_vector nodeVector;
 
     if (!searchString || strcmp("", searchString) == 0)
     {
         assert(type != MegaApi::FILE_TYPE_DEFAULT);
-        nodeVector = client->mNodeManager.getNodesByMimeType(static_cast<MimeType_t>(type), NodeHandle().set6byte(nodeHandle), cancelToken);
+        nodeVector = client->mNodeManager.getNodesByMimeType(static_cast<MimeType_t>(type), NodeHandle().set6byte(nodeHandle), cancelToken, unlockable);
     }
     else
     {
-        nodeVector = client->mNodeManager.search(NodeHandle().set6byte(nodeHandle), searchString, cancelToken, recursive);
+        nodeVector = client->mNodeManager.search(NodeHandle().set6byte(nodeHandle), searchString, cancelToken, recursive, unlockable);
 
         auto it = nodeVector.begin();
         while (it != nodeVector.end() && !cancelToken.isCancelled())
@@ -12004,6 +12950,10 @@ MegaNodeList* MegaApiImpl::search(MegaNode *n, const char* searchString, CancelT
         return new MegaNodeListPrivate();
     }
 
+    // A query made from an app thread can run without blocking the client. Only single queries
+    // do so, since nodes gathered before releasing the lock could be gone after it
+    NodeManager::ClientLock* unlockable = isCurrentThread() ? nullptr : &g;
+
     MegaNodeList *nodeList = nullptr;
     if (n)
     {
@@ -12016,7 +12966,7 @@ MegaNodeList* MegaApiImpl::search(MegaNode *n, const char* searchString, CancelT
 
         // searchString and nodeType (if provided), are considered in search
         node_vector nodeVector;
-        nodeVector = searchInNodeManager(n->getHandle(), searchString, type, cancelToken, recursive);
+        nodeVector = searchInNodeManager(n->getHandle(), searchString, type, cancelToken, recursive, unlockable);
 
         sortByComparatorFunction(nodeVector, order, *client);
         nodeList = new MegaNodeListPrivate(nodeVector.data(), int(nodeVector.size()));
@@ -12100,7 +13050,7 @@ MegaNodeList* MegaApiImpl::search(MegaNode *n, const char* searchString, CancelT
 
         if (target == MegaApi::SEARCH_TARGET_ALL)
         {
-            result = searchInNodeManager(UNDEF, searchString, type, cancelToken, true);
+            result = searchInNodeManager(UNDEF, searchString, type, cancelToken, true, unlockable);
         }
 
         if (target == MegaApi::SEARCH_TARGET_OUTSHARE)
@@ -12154,6 +13104,320 @@ MegaNodeList* MegaApiImpl::search(MegaNode *n, const char* searchString, CancelT
     return nodeList;
 }
 
+void MegaApiImpl::searchAsync(MegaNode *node, const char *searchString, bool recursive, int order, int type, int target, MegaRequestListener *listener)
+{
+    MegaRequestPrivate* request = new MegaRequestPrivate(MegaRequest::TYPE_SEARCH, listener);
+    request->setNodeHandle(node ? node->getHandle() : INVALID_HANDLE);
+    request->setText(searchString);
+    request->setFlag(recursive);
+    request->setNumber(order);
+    request->setParamType(type);
+    request->setAccess(target);
+    requestQueue.push(request);
+    waiter->notify();
+}
+
+error MegaApiImpl::startSearch(unique_ptr<AsyncSearch> search)
+{
+    int superseded = 0;
+    {
+        std::lock_guard<std::mutex> g(mSearchMutex);
+        if (!mSearchThread.joinable())
+        {
+            try
+            {
+                mSearchThread = std::thread([this]() { searchThreadLoop(); });
+            }
+            catch (std::system_error& e)
+            {
+                LOG_err << "Failed to start search thread: " << e.what();
+                return API_EINTERNAL;
+            }
+        }
+
+        if (mNextSearch)
+        {
+            // it didn't even start
+            superseded = mNextSearch->tag;
+        }
+        mRunningSearch.cancel();
+        mNextSearch = std::move(search);
+    }
+    mSearchConditionVariable.notify_one();
+
+    auto it = requestMap.find(superseded);
+    if (superseded && it != requestMap.end())
+    {
+        fireOnRequestFinish(it->second, make_unique<MegaErrorPrivate>(API_EINCOMPLETE));
+    }
+    return API_OK;
+}
+
+void MegaApiImpl::stopSearchThread()
+{
+    {
+        std::lock_guard<std::mutex> g(mSearchMutex);
+        mSearchThreadExit = true;
+        mRunningSearch.cancel();
+    }
+    mSearchConditionVariable.notify_one();
+
+    if (mSearchThread.joinable())
+    {
+        mSearchThread.join();
+    }
+}
+
+void MegaApiImpl::searchThreadLoop()
+{
+    for (;;)
+    {
+        unique_ptr<AsyncSearch> search;
+        {
+            std::unique_lock<std::mutex> g(mSearchMutex);
+            mSearchConditionVariable.wait(g, [this]() { return mSearchThreadExit || mNextSearch; });
+            if (mSearchThreadExit)
+            {
+                // requests not run are finished with the rest of pending ones
+                return;
+            }
+            search = std::move(mNextSearch);
+            mRunningSearch = search->cancelToken;
+        }
+
+        runSearch(*search);
+    }
+}
+
+bool MegaApiImpl::refinesLastSearch(const AsyncSearch& search)
+{
+    if (!mLastSearch
+            || mLastSearch->node != search.node
+            || mLastSearch->recursive != search.recursive
+            || mLastSearch->type != search.type
+            || mLastSearch->target != search.target
+            || mLastSearch->searchString.empty())
+    {
+        return false;
+    }
+
+    // wildcards of the DB query have no simple containment rule
+    if (mLastSearch->searchString.find_first_of("*?[") != string::npos
+            || search.searchString.find_first_of("*?[") != string::npos)
+    {
+        return false;
+    }
+
+    // a node added or renamed since could match the new search only
+    if (mLastSearchTableVersion != client->mNodeManager.tableVersion() || client->mNodeManager.nodeNotifySize())
+    {
+        return false;
+    }
+
+    return Utils::toLowerUtf8(search.searchString).find(Utils::toLowerUtf8(mLastSearch->searchString)) != string::npos;
+}
+
+void MegaApiImpl::runSearch(AsyncSearch& search)
+{
+    int tag = search.tag;
+    vector<NodeHandle> found;
+
+    // the listeners are called from the SDK thread, in order, unless the request finished meanwhile (ie. logout)
+    auto update = [this, tag](shared_ptr<MegaNodeList> list, long long total)
+    {
+        executeOnThread(std::make_shared<ExecuteOnce>([this, tag, list, total]()
+        {
+            auto it = requestMap.find(tag);
+            if (it != requestMap.end())
+            {
+                it->second->setMegaNodeList(unique_ptr<MegaNodeList>(list->copy()));
+                it->second->setTransferredBytes(total);
+                fireOnRequestUpdate(it->second);
+            }
+        }), false);
+    };
+
+    auto deliver = [this, &search, &found, &update](const node_vector& nodes)
+    {
+        node_vector page;
+        for (Node* n : nodes)
+        {
+            if (isValidTypeNode(n, search.type))
+            {
+                page.push_back(n);
+                found.push_back(n->nodeHandle());
+            }
+        }
+
+        if (!page.empty())
+        {
+            update(std::make_shared<MegaNodeListPrivate>(page.data(), int(page.size())), static_cast<long long>(found.size()));
+        }
+    };
+
+    auto finish = [this, tag](shared_ptr<MegaNodeList> list, error e)
+    {
+        executeOnThread(std::make_shared<ExecuteOnce>([this, tag, list, e]()
+        {
+            auto it = requestMap.find(tag);
+            if (it != requestMap.end())
+            {
+                if (list)
+                {
+                    it->second->setMegaNodeList(unique_ptr<MegaNodeList>(list->copy()));
+                }
+                fireOnRequestFinish(it->second, make_unique<MegaErrorPrivate>(e));
+            }
+        }), false);
+    };
+
+    const string& searchString = search.searchString;
+    bool byName = !searchString.empty();
+    bool paged = byName && (search.node != INVALID_HANDLE || search.recursive
+                            || search.target == MegaApi::SEARCH_TARGET_ALL
+                            || search.target == MegaApi::SEARCH_TARGET_PUBLICLINK);
+    if (!paged)
+    {
+        // small enough (or not served by a single DB query), delivered in one go
+        unique_ptr<MegaNode> node(search.node != INVALID_HANDLE ? getNodeByHandle(search.node) : nullptr);
+        shared_ptr<MegaNodeList> list(MegaApiImpl::search(node.get(), byName ? searchString.c_str() : nullptr,
+                                                          search.cancelToken, search.recursive, search.order, search.type, search.target));
+        if (search.cancelToken.isCancelled())
+        {
+            finish(nullptr, API_EINCOMPLETE);
+            return;
+        }
+
+        if (list->size())
+        {
+            update(list, list->size());
+        }
+        finish(list, API_OK);
+        return;
+    }
+
+    // unlike search(), the lock is released during the DB queries and between pages
+    SdkMutexGuard g(sdkMutex);
+    bool completed = true;
+
+    // the results are valid for the next search to refine if no node is written meanwhile
+    std::pair<uint64_t, uint64_t> tableVersion = client->mNodeManager.tableVersion();
+
+    if (refinesLastSearch(search))
+    {
+        LOG_debug << "Search refines the results of the previous one: " << mLastSearchResults.size();
+        string lowerSearchString = Utils::toLowerUtf8(searchString);
+        node_vector page;
+        for (NodeHandle h : mLastSearchResults)
+        {
+            if (search.cancelToken.isCancelled())
+            {
+                completed = false;
+                break;
+            }
+
+            Node* n = client->nodeByHandle(h);
+            if (n && Utils::toLowerUtf8(n->displayname()).find(lowerSearchString) != string::npos)
+            {
+                page.push_back(n);
+                if (page.size() == ASYNC_SEARCH_PAGE_SIZE)
+                {
+                    deliver(page);
+                    page.clear();
+                }
+            }
+        }
+        if (completed)
+        {
+            deliver(page);
+        }
+    }
+    else
+    {
+        // the subtrees to search, as search() does for each target
+        vector<pair<NodeHandle, bool>> scopes;
+        if (search.node != INVALID_HANDLE)
+        {
+            scopes.emplace_back(NodeHandle().set6byte(search.node), search.recursive);
+        }
+        else if (search.target == MegaApi::SEARCH_TARGET_ALL)
+        {
+            scopes.emplace_back(NodeHandle(), true);
+        }
+        else if (search.target == MegaApi::SEARCH_TARGET_ROOTNODE)
+        {
+            scopes.emplace_back(client->mNodeManager.getRootNodeFiles(), true);
+            if (!client->mNodeManager.getRootNodeVault().isUndef())
+            {
+                scopes.emplace_back(client->mNodeManager.getRootNodeVault(), true);
+            }
+        }
+        else if (search.target == MegaApi::SEARCH_TARGET_INSHARE)
+        {
+            unique_ptr<MegaShareList> shares(getInSharesList(MegaApi::ORDER_NONE));
+            for (int i = 0; i < shares->size(); i++)
+            {
+                scopes.emplace_back(NodeHandle().set6byte(shares->get(i)->getNodeHandle()), true);
+            }
+        }
+        else if (search.target == MegaApi::SEARCH_TARGET_OUTSHARE)
+        {
+            // shares list includes an item per outshare AND per sharee/user
+            std::set<MegaHandle> outshares;
+            unique_ptr<MegaShareList> shares(getOutShares(MegaApi::ORDER_NONE));
+            for (int i = 0; i < shares->size(); i++)
+            {
+                if (outshares.insert(shares->get(i)->getNodeHandle()).second)
+                {
+                    scopes.emplace_back(NodeHandle().set6byte(shares->get(i)->getNodeHandle()), true);
+                }
+            }
+        }
+        else if (search.target == MegaApi::SEARCH_TARGET_PUBLICLINK)
+        {
+            for (Node* n : client->mNodeManager.getNodesWithLinks())
+            {
+                scopes.emplace_back(n->nodeHandle(), true);
+            }
+        }
+
+        for (auto& scope : scopes)
+        {
+            if (client->mNodeManager.getRootNodeFiles().isUndef()
+                    || !client->mNodeManager.searchPaged(scope.first, searchString.c_str(), search.cancelToken, scope.second,
+                                                         ASYNC_SEARCH_PAGE_SIZE, deliver, &g))
+            {
+                completed = false;
+                break;
+            }
+        }
+    }
+
+    if (!completed)
+    {
+        // superseded, or logged out meanwhile (then the request is already finished)
+        finish(nullptr, API_EINCOMPLETE);
+        return;
+    }
+
+    node_vector nodes;
+    nodes.reserve(found.size());
+    for (NodeHandle h : found)
+    {
+        if (Node* n = client->nodeByHandle(h))
+        {
+            nodes.push_back(n);
+        }
+    }
+    sortByComparatorFunction(nodes, search.order, *client);
+    finish(std::make_shared<MegaNodeListPrivate>(nodes.data(), int(nodes.size())), API_OK);
+
+    search.cancelToken = CancelToken();
+    mLastSearch = ::mega::make_unique<AsyncSearch>(search);
+    mLastSearchTableVersion = tableVersion;
+    mLastSearchResults = std::move(found);
+}
+
 long long MegaApiImpl::getSize(MegaNode *n)
 {
     if(!n) return 0;
@@ -12170,14 +13434,14 @@ long long MegaApiImpl::getSize(MegaNode *n)
         return megaSizeProcessor.getTotalBytes();
     }
 
+    // the counter is enough, so the node isn't loaded if it was evicted
     SdkMutexGuard g(sdkMutex);
-    Node *node = client->nodebyhandle(n->getHandle());
-    if(!node)
+    NodeCounter nodeCounter;
+    if (!client->mNodeManager.getCounterByHandle(NodeHandle().set6byte(n->getHandle()), nodeCounter))
     {
         return 0;
     }
 
-    NodeCounter nodeCounter = node->getCounter();
     return nodeCounter.storage;
 }
 
@@ -13953,6 +15217,7 @@ void MegaApiImpl::updatepcr_result(error e, ipcactions_t action)
 void MegaApiImpl::fa_complete(handle, fatype, const char* data, uint32_t len)
 {
     int tag = client->restag;
+    bool cached = false;
     while(tag)
     {
         if(requestMap.find(tag) == requestMap.end()) return;
@@ -13961,6 +15226,12 @@ void MegaApiImpl::fa_complete(handle, fatype, const char* data, uint32_t len)
 
         tag = int(request->getNumber());
 
+        if (!cached && mFileAttributeCache && request->getParentHandle() != UNDEF)
+        {
+            mFileAttributeCache->write(request->getParentHandle(), data, len);
+            cached = true;
+        }
+
         auto f = client->fsaccess->newfileaccess();
         string filePath(request->getFile());
         auto localPath = LocalPath::fromAbsolutePath(filePath);
@@ -14602,6 +15873,7 @@ void MegaApiImpl::logout_result(error e)
         waitingRequest = RETRY_NONE;
         excludedNames.clear();
         excludedPaths.clear();
+        excludedPathPatterns.clear();
         syncLowerSizeLimit = 0;
         syncUpperSizeLimit = 0;
 
@@ -14847,17 +16119,110 @@ void MegaApiImpl::nodes_updated(Node** n, int count)
         return;
     }
 
-    MegaNodeList *nodeList = NULL;
-    if (n != NULL)
     {
-        nodeList = new MegaNodeListPrivate(n, count);
-        fireOnNodesUpdate(nodeList);
+        lock_guard<mutex> g(mNodeSnapshotMutex);
+        if (n == NULL)
+        {
+            mNodeSnapshot.clear();
+        }
+        else
+        {
+            for (int i = 0; i < count; i++)
+            {
+                // a removed folder may stand for its whole subtree (see NodeManager::removeSubtree())
+                if (n[i]->changed.removed && n[i]->type != FILENODE)
+                {
+                    mNodeSnapshot.clear();
+                    break;
+                }
+                mNodeSnapshot.erase(n[i]->nodehandle);
+            }
+        }
     }
-    else
+
+    if (n == NULL)
     {
+        // the whole account is being reloaded: what was pending is stale
+        mPendingNodesUpdates.clear();
+        mPendingNodesUpdateIndex.clear();
         fireOnNodesUpdate(NULL);
+        return;
+    }
+
+    if (!mCoalesceNodesUpdates)
+    {
+        flushNodesUpdates();
+
+        MegaNodeUpdateListPrivate nodeList(n, count);
+        fireOnNodesUpdate(&nodeList);
+        return;
     }
-    delete nodeList;
+
+    for (int i = 0; i < count; i++)
+    {
+        auto it = mPendingNodesUpdateIndex.emplace(n[i]->nodehandle, mPendingNodesUpdates.size());
+        if (it.second)
+        {
+            mPendingNodesUpdates.emplace_back();
+            mPendingNodesUpdates.back().handle = n[i]->nodehandle;
+            mPendingNodesUpdates.back().changes = 0;
+        }
+
+        MegaNodeUpdateListPrivate::Update& u = mPendingNodesUpdates[it.first->second];
+        u.parentHandle = n[i]->parent ? n[i]->parent->nodehandle : INVALID_HANDLE;
+        u.changes |= MegaNodePrivate::changesOf(n[i]);
+
+        if (n[i]->changed.removed)
+        {
+            // the Node is deleted once this notification is over
+            u.snapshot.reset(MegaNodePrivate::fromNode(n[i]));
+        }
+        else
+        {
+            u.snapshot.reset();
+        }
+    }
+}
+
+void MegaApiImpl::flushNodesUpdates()
+{
+    if (mPendingNodesUpdates.empty())
+    {
+        return;
+    }
+
+    vector<MegaNodeUpdateListPrivate::Update> updates;
+    updates.swap(mPendingNodesUpdates);
+    mPendingNodesUpdateIndex.clear();
+
+    // resolve the nodes still alive as they are now
+    size_t kept = 0;
+    for (auto& u : updates)
+    {
+        if (u.snapshot)
+        {
+            static_cast<MegaNodePrivate*>(u.snapshot.get())->setChanges(u.changes);
+        }
+        else if (!(u.node = client->nodebyhandle(u.handle)))
+        {
+            continue;
+        }
+
+        if (&updates[kept] != &u)
+        {
+            updates[kept] = std::move(u);
+        }
+        kept++;
+    }
+    updates.resize(kept);
+
+    if (updates.empty())
+    {
+        return;
+    }
+
+    MegaNodeUpdateListPrivate nodeList(std::move(updates));
+    fireOnNodesUpdate(&nodeList);
 }
 
 void MegaApiImpl::account_details(AccountDetails*, bool, bool, bool, bool, bool, bool)
@@ -15443,6 +16808,12 @@ void MegaApiImpl::userattr_update(User*, int, const char*)
 {
 }
 
+void MegaApiImpl::nodes_cached()
+{
+    MegaEventPrivate *event = new MegaEventPrivate(MegaEvent::EVENT_NODES_CACHED);
+    fireOnEvent(event);
+}
+
 void MegaApiImpl::nodes_current()
 {
     MegaEventPrivate *event = new MegaEventPrivate(MegaEvent::EVENT_NODES_CURRENT);
@@ -16035,8 +17406,11 @@ void MegaApiImpl::removeListener(MegaListener* listener)
 {
     if(!listener) return;
 
-    SdkMutexGuard g(sdkMutex);
-    listeners.erase(listener);
+    {
+        SdkMutexGuard g(sdkMutex);
+        listeners.erase(listener);
+    }
+    forgetListener(listener);
 }
 
 void MegaApiImpl::removeRequestListener(MegaRequestListener* listener)
@@ -16057,6 +17431,9 @@ void MegaApiImpl::removeRequestListener(MegaRequestListener* listener)
     }
 
     requestQueue.removeListener(listener);
+
+    g.unlock();
+    forgetListener(listener);
 }
 
 void MegaApiImpl::removeTransferListener(MegaTransferListener* listener)
@@ -16077,6 +17454,9 @@ void MegaApiImpl::removeTransferListener(MegaTransferListener* listener)
     }
 
     transferQueue.removeListener(listener);
+
+    g.unlock();
+    forgetListener(listener);
 }
 
 void MegaApiImpl::removeScheduledCopyListener(MegaScheduledCopyListener* listener)
@@ -16103,8 +17483,11 @@ void MegaApiImpl::removeGlobalListener(MegaGlobalListener* listener)
 {
     if(!listener) return;
 
-    SdkMutexGuard g(sdkMutex);
-    globalListeners.erase(listener);
+    {
+        SdkMutexGuard g(sdkMutex);
+        globalListeners.erase(listener);
+    }
+    forgetListener(listener);
 }
 
 MegaRequest *MegaApiImpl::getCurrentRequest()
@@ -16137,15 +17520,10 @@ void MegaApiImpl::fireOnRequestStart(MegaRequestPrivate *request)
     assert(threadId == std::this_thread::get_id());
     activeRequest = request;
     LOG_info << client->clientname << "Request (" << request->getRequestString() << ") starting";
-    for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ;)
-    {
-        (*it++)->onRequestStart(api, request);
-    }
-
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onRequestStart(api, request);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaRequest> r = fanout.share<MegaRequest>(request);
+    fanout.call(requestListeners, [this, r](MegaRequestListener* l) { l->onRequestStart(api, r.get()); });
+    fanout.call(listeners, [this, r](MegaListener* l) { l->onRequestStart(api, r.get()); });
 
     MegaRequestListener* listener = request->getListener();
     if(listener)
@@ -16174,15 +17552,11 @@ void MegaApiImpl::fireOnRequestFinish(MegaRequestPrivate *request, unique_ptr<Me
         LOG_info << (client ? client->clientname : "") << "Request (" << request->getRequestString() << ") finished";
     }
 
-    for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ;)
-    {
-        (*it++)->onRequestFinish(api, request, e.get());
-    }
-
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onRequestFinish(api, request, e.get());
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaRequest> r = fanout.share<MegaRequest>(request);
+    std::shared_ptr<MegaError> error = fanout.share<MegaError>(e.get());
+    fanout.call(requestListeners, [this, r, error](MegaRequestListener* l) { l->onRequestFinish(api, r.get(), error.get()); });
+    fanout.call(listeners, [this, r, error](MegaListener* l) { l->onRequestFinish(api, r.get(), error.get()); });
 
     MegaRequestListener* listener = request->getListener();
     if(listener)
@@ -16202,15 +17576,10 @@ void MegaApiImpl::fireOnRequestUpdate(MegaRequestPrivate *request)
     assert(threadId == std::this_thread::get_id());
     activeRequest = request;
 
-    for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ;)
-    {
-        (*it++)->onRequestUpdate(api, request);
-    }
-
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onRequestUpdate(api, request);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaRequest> r = fanout.share<MegaRequest>(request);
+    fanout.call(requestListeners, [this, r](MegaRequestListener* l) { l->onRequestUpdate(api, r.get()); });
+    fanout.call(listeners, [this, r](MegaListener* l) { l->onRequestUpdate(api, r.get()); });
 
     MegaRequestListener* listener = request->getListener();
     if(listener)
@@ -16229,15 +17598,11 @@ void MegaApiImpl::fireOnRequestTemporaryError(MegaRequestPrivate *request, uniqu
 
     request->setNumRetry(request->getNumRetry() + 1);
 
-    for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ;)
-    {
-        (*it++)->onRequestTemporaryError(api, request, e.get());
-    }
-
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onRequestTemporaryError(api, request, e.get());
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaRequest> r = fanout.share<MegaRequest>(request);
+    std::shared_ptr<MegaError> error = fanout.share<MegaError>(e.get());
+    fanout.call(requestListeners, [this, r, error](MegaRequestListener* l) { l->onRequestTemporaryError(api, r.get(), error.get()); });
+    fanout.call(listeners, [this, r, error](MegaListener* l) { l->onRequestTemporaryError(api, r.get(), error.get()); });
 
     MegaRequestListener* listener = request->getListener();
     if(listener)
@@ -16256,15 +17621,10 @@ void MegaApiImpl::fireOnTransferStart(MegaTransferPrivate *transfer)
     notificationNumber++;
     transfer->setNotificationNumber(notificationNumber);
 
-    for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ;)
-    {
-        (*it++)->onTransferStart(api, transfer);
-    }
-
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onTransferStart(api, transfer);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaTransfer> t = fanout.share<MegaTransfer>(transfer);
+    fanout.call(transferListeners, [this, t](MegaTransferListener* l) { l->onTransferStart(api, t.get()); });
+    fanout.call(listeners, [this, t](MegaListener* l) { l->onTransferStart(api, t.get()); });
 
     MegaTransferListener* listener = transfer->getListener();
     if(listener)
@@ -16306,15 +17666,11 @@ void MegaApiImpl::fireOnTransferFinish(MegaTransferPrivate *transfer, unique_ptr
         LOG_info << "Transfer (" << transfer->getTransferString() << ") finished. File: " << transfer->getFileName();
     }
 
-    for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ;)
-    {
-        (*it++)->onTransferFinish(api, transfer, e.get());
-    }
-
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onTransferFinish(api, transfer, e.get());
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaTransfer> t = fanout.share<MegaTransfer>(transfer);
+    std::shared_ptr<MegaError> error = fanout.share<MegaError>(e.get());
+    fanout.call(transferListeners, [this, t, error](MegaTransferListener* l) { l->onTransferFinish(api, t.get(), error.get()); });
+    fanout.call(listeners, [this, t, error](MegaListener* l) { l->onTransferFinish(api, t.get(), error.get()); });
 
     MegaTransferListener* listener = transfer->getListener();
     if (listener)
@@ -16339,15 +17695,11 @@ void MegaApiImpl::fireOnTransferTemporaryError(MegaTransferPrivate *transfer, un
 
     transfer->setNumRetry(transfer->getNumRetry() + 1);
 
-    for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ;)
-    {
-        (*it++)->onTransferTemporaryError(api, transfer, e.get());
-    }
-
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onTransferTemporaryError(api, transfer, e.get());
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaTransfer> t = fanout.share<MegaTransfer>(transfer);
+    std::shared_ptr<MegaError> error = fanout.share<MegaError>(e.get());
+    fanout.call(transferListeners, [this, t, error](MegaTransferListener* l) { l->onTransferTemporaryError(api, t.get(), error.get()); });
+    fanout.call(listeners, [this, t, error](MegaListener* l) { l->onTransferTemporaryError(api, t.get(), error.get()); });
 
     MegaTransferListener* listener = transfer->getListener();
     if(listener)
@@ -16371,23 +17723,60 @@ void MegaApiImpl::fireOnTransferUpdate(MegaTransferPrivate *transfer)
     notificationNumber++;
     transfer->setNotificationNumber(notificationNumber);
 
-    for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ;)
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaTransfer> t = fanout.share<MegaTransfer>(transfer);
+    fanout.callCoalesced(transferListeners, transfer->getTag(), [this, t](MegaTransferListener* l) { l->onTransferUpdate(api, t.get()); });
+    fanout.callCoalesced(listeners, transfer->getTag(), [this, t](MegaListener* l) { l->onTransferUpdate(api, t.get()); });
+
+    MegaTransferListener* listener = transfer->getListener();
+    if(listener)
+    {
+        listener->onTransferUpdate(api, transfer);
+    }
+
+    activeTransfer = NULL;
+}
+
+void MegaApiImpl::fireOnTransfersProgress()
+{
+    assert(threadId == std::this_thread::get_id());
+    if (!mTransferUpdatesAggregated || Waiter::ds < mNextTransfersProgressDs)
     {
-        (*it++)->onTransferUpdate(api, transfer);
+        return;
     }
 
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
+    dstime interval = mTransferUpdateIntervalDs;
+    mNextTransfersProgressDs = Waiter::ds + (interval ? interval : 10);
+
+    if (transferListeners.empty() && listeners.empty())
     {
-        (*it++)->onTransferUpdate(api, transfer);
+        return;
     }
 
-    MegaTransferListener* listener = transfer->getListener();
-    if(listener)
+    vector<MegaTransferProgressListPrivate::Entry> entries;
+    for (TransferSlot* slot : client->tslots)
     {
-        listener->onTransferUpdate(api, transfer);
+        for (File* f : slot->transfer->files)
+        {
+            if (MegaTransferPrivate* transfer = getMegaTransferPrivate(f->tag))
+            {
+                entries.push_back({transfer->getTag(), transfer->getType(), transfer->getTransferredBytes(),
+                                   transfer->getTotalBytes(), transfer->getSpeed()});
+                transfer->progressNotifiedBytes = transfer->getTransferredBytes();
+                transfer->progressNotifiedTime = Waiter::ds;
+            }
+        }
     }
 
-    activeTransfer = NULL;
+    if (entries.empty())
+    {
+        return;
+    }
+
+    std::shared_ptr<MegaTransferProgressList> progress(new MegaTransferProgressListPrivate(std::move(entries)));
+    ListenerFanout fanout(mListenerDispatcher.load());
+    fanout.call(transferListeners, [this, progress](MegaTransferListener* l) { l->onTransfersProgress(api, progress.get()); });
+    fanout.call(listeners, [this, progress](MegaListener* l) { l->onTransfersProgress(api, progress.get()); });
 }
 
 void MegaApiImpl::fireOnFolderTransferUpdate(MegaTransferPrivate *transfer, int stage, uint32_t foldercount, uint32_t createdfoldercount, uint32_t filecount, const LocalPath* currentFolder, const LocalPath* currentFileLeafname)
@@ -16434,14 +17823,10 @@ void MegaApiImpl::fireOnUsersUpdate(MegaUserList *users)
     assert(threadId == std::this_thread::get_id());
     activeUsers = users;
 
-    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ;)
-    {
-        (*it++)->onUsersUpdate(api, users);
-    }
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onUsersUpdate(api, users);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaUserList> u = fanout.share<MegaUserList>(users);
+    fanout.call(globalListeners, [this, u](MegaGlobalListener* l) { l->onUsersUpdate(api, u.get()); });
+    fanout.call(listeners, [this, u](MegaListener* l) { l->onUsersUpdate(api, u.get()); });
 
     activeUsers = NULL;
 }
@@ -16451,14 +17836,10 @@ void MegaApiImpl::fireOnUserAlertsUpdate(MegaUserAlertList *userAlerts)
     assert(threadId == std::this_thread::get_id());
     activeUserAlerts = userAlerts;
 
-    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ;)
-    {
-        (*it++)->onUserAlertsUpdate(api, userAlerts);
-    }
-    for (set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end();)
-    {
-        (*it++)->onUserAlertsUpdate(api, userAlerts);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaUserAlertList> a = fanout.share<MegaUserAlertList>(userAlerts);
+    fanout.call(globalListeners, [this, a](MegaGlobalListener* l) { l->onUserAlertsUpdate(api, a.get()); });
+    fanout.call(listeners, [this, a](MegaListener* l) { l->onUserAlertsUpdate(api, a.get()); });
 
     activeUserAlerts = NULL;
 }
@@ -16468,14 +17849,10 @@ void MegaApiImpl::fireOnContactRequestsUpdate(MegaContactRequestList *requests)
     assert(threadId == std::this_thread::get_id());
     activeContactRequests = requests;
 
-    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ;)
-    {
-        (*it++)->onContactRequestsUpdate(api, requests);
-    }
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onContactRequestsUpdate(api, requests);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaContactRequestList> r = fanout.share<MegaContactRequestList>(requests);
+    fanout.call(globalListeners, [this, r](MegaGlobalListener* l) { l->onContactRequestsUpdate(api, r.get()); });
+    fanout.call(listeners, [this, r](MegaListener* l) { l->onContactRequestsUpdate(api, r.get()); });
 
     activeContactRequests = NULL;
 }
@@ -16485,14 +17862,10 @@ void MegaApiImpl::fireOnNodesUpdate(MegaNodeList *nodes)
     assert(threadId == std::this_thread::get_id());
     activeNodes = nodes;
 
-    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ;)
-    {
-        (*it++)->onNodesUpdate(api, nodes);
-    }
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onNodesUpdate(api, nodes);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaNodeList> n = fanout.share<MegaNodeList>(nodes);
+    fanout.call(globalListeners, [this, n](MegaGlobalListener* l) { l->onNodesUpdate(api, n.get()); });
+    fanout.call(listeners, [this, n](MegaListener* l) { l->onNodesUpdate(api, n.get()); });
 
     activeNodes = NULL;
 }
@@ -16500,72 +17873,48 @@ void MegaApiImpl::fireOnNodesUpdate(MegaNodeList *nodes)
 void MegaApiImpl::fireOnAccountUpdate()
 {
     assert(threadId == std::this_thread::get_id());
-    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ;)
-    {
-        (*it++)->onAccountUpdate(api);
-    }
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onAccountUpdate(api);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    fanout.call(globalListeners, [this](MegaGlobalListener* l) { l->onAccountUpdate(api); });
+    fanout.call(listeners, [this](MegaListener* l) { l->onAccountUpdate(api); });
 }
 
 void MegaApiImpl::fireOnSetsUpdate(MegaSetList* sets)
 {
     assert(threadId == std::this_thread::get_id());
 
-    for (set<MegaGlobalListener*>::iterator it = globalListeners.begin(); it != globalListeners.end();)
-    {
-        (*it++)->onSetsUpdate(api, sets);
-    }
-    for (set<MegaListener*>::iterator it = listeners.begin(); it != listeners.end();)
-    {
-        (*it++)->onSetsUpdate(api, sets);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaSetList> copy = fanout.share<MegaSetList>(sets);
+    fanout.call(globalListeners, [this, copy](MegaGlobalListener* l) { l->onSetsUpdate(api, copy.get()); });
+    fanout.call(listeners, [this, copy](MegaListener* l) { l->onSetsUpdate(api, copy.get()); });
 }
 
 void MegaApiImpl::fireOnSetElementsUpdate(MegaSetElementList* elements)
 {
     assert(threadId == std::this_thread::get_id());
 
-    for (set<MegaGlobalListener*>::iterator it = globalListeners.begin(); it != globalListeners.end();)
-    {
-        (*it++)->onSetElementsUpdate(api, elements);
-    }
-    for (set<MegaListener*>::iterator it = listeners.begin(); it != listeners.end();)
-    {
-        (*it++)->onSetElementsUpdate(api, elements);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaSetElementList> copy = fanout.share<MegaSetElementList>(elements);
+    fanout.call(globalListeners, [this, copy](MegaGlobalListener* l) { l->onSetElementsUpdate(api, copy.get()); });
+    fanout.call(listeners, [this, copy](MegaListener* l) { l->onSetElementsUpdate(api, copy.get()); });
 }
 
 void MegaApiImpl::fireOnReloadNeeded()
 {
     assert(threadId == std::this_thread::get_id());
-    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ;)
-    {
-        (*it++)->onReloadNeeded(api);
-    }
-
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onReloadNeeded(api);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    fanout.call(globalListeners, [this](MegaGlobalListener* l) { l->onReloadNeeded(api); });
+    fanout.call(listeners, [this](MegaListener* l) { l->onReloadNeeded(api); });
 }
 
 void MegaApiImpl::fireOnEvent(MegaEventPrivate *event)
 {
     LOG_debug << "Sending " << event->getEventString() << " to app." << event->getValidDataToString();
-    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ;)
-    {
-        (*it++)->onEvent(api, event);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
 
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onEvent(api, event);
-    }
-
-    delete event;
+    // the event goes once every listener has seen it
+    std::shared_ptr<MegaEvent> e(event);
+    fanout.call(globalListeners, [this, e](MegaGlobalListener* l) { l->onEvent(api, e.get()); });
+    fanout.call(listeners, [this, e](MegaListener* l) { l->onEvent(api, e.get()); });
 }
 
 #ifdef ENABLE_SYNC
@@ -16573,54 +17922,45 @@ void MegaApiImpl::fireOnSyncStateChanged(MegaSyncPrivate *sync)
 {
     assert(sync->getBackupId() != INVALID_HANDLE);
     assert(client->syncs.onSyncThread());
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onSyncStateChanged(api, sync);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaSync> s = fanout.share<MegaSync>(sync);
+    fanout.call(listeners, [this, s](MegaListener* l) { l->onSyncStateChanged(api, s.get()); });
 }
 
 void MegaApiImpl::fireOnSyncAdded(MegaSyncPrivate *sync)
 {
     assert(sync->getBackupId() != INVALID_HANDLE);
     assert(client->syncs.onSyncThread());
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onSyncAdded(api, sync);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaSync> s = fanout.share<MegaSync>(sync);
+    fanout.call(listeners, [this, s](MegaListener* l) { l->onSyncAdded(api, s.get()); });
 }
 
 void MegaApiImpl::fireOnSyncDeleted(MegaSyncPrivate *sync)
 {
     assert(sync->getBackupId() != INVALID_HANDLE);
     assert(client->syncs.onSyncThread());
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onSyncDeleted(api, sync);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaSync> s = fanout.share<MegaSync>(sync);
+    fanout.call(listeners, [this, s](MegaListener* l) { l->onSyncDeleted(api, s.get()); });
 }
 
 void MegaApiImpl::fireOnGlobalSyncStateChanged()
 {
     assert(client->syncs.onSyncThread());
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onGlobalSyncStateChanged(api);
-    }
-
-    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ;)
-    {
-        (*it++)->onGlobalSyncStateChanged(api);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    fanout.call(listeners, [this](MegaListener* l) { l->onGlobalSyncStateChanged(api); });
+    fanout.call(globalListeners, [this](MegaGlobalListener* l) { l->onGlobalSyncStateChanged(api); });
 }
 
 void MegaApiImpl::fireOnFileSyncStateChanged(MegaSyncPrivate *sync, string *localPath, int newState)
 {
     assert(sync->getBackupId() != INVALID_HANDLE);
     assert(client->syncs.onSyncThread());
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onSyncFileStateChanged(api, sync, localPath, newState);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaSync> s = fanout.share<MegaSync>(sync);
+    std::shared_ptr<string> path = fanout.share(localPath);
+    fanout.call(listeners, [this, s, path, newState](MegaListener* l) { l->onSyncFileStateChanged(api, s.get(), path.get(), newState); });
 }
 
 #endif
@@ -16628,10 +17968,9 @@ void MegaApiImpl::fireOnFileSyncStateChanged(MegaSyncPrivate *sync, string *loca
 void MegaApiImpl::fireOnBackupStateChanged(MegaScheduledCopyController *backup)
 {
     assert(threadId == std::this_thread::get_id());
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onBackupStateChanged(api, backup);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaScheduledCopy> b = fanout.share<MegaScheduledCopy>(backup);
+    fanout.call(listeners, [this, b](MegaListener* l) { l->onBackupStateChanged(api, b.get()); });
 
     for(set<MegaScheduledCopyListener *>::iterator it = backupListeners.begin(); it != backupListeners.end() ;)
     {
@@ -16653,10 +17992,9 @@ void MegaApiImpl::fireOnBackupStart(MegaScheduledCopyController *backup)
         (*it++)->onBackupStart(api, backup);
     }
 
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onBackupStart(api, backup);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaScheduledCopy> b = fanout.share<MegaScheduledCopy>(backup);
+    fanout.call(listeners, [this, b](MegaListener* l) { l->onBackupStart(api, b.get()); });
 
     MegaScheduledCopyListener* listener = backup->getBackupListener();
     if(listener)
@@ -16673,10 +18011,10 @@ void MegaApiImpl::fireOnBackupFinish(MegaScheduledCopyController *backup, unique
         (*it++)->onBackupFinish(api, backup, e.get());
     }
 
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onBackupFinish(api, backup, e.get());
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaScheduledCopy> b = fanout.share<MegaScheduledCopy>(backup);
+    std::shared_ptr<MegaError> error = fanout.share<MegaError>(e.get());
+    fanout.call(listeners, [this, b, error](MegaListener* l) { l->onBackupFinish(api, b.get(), error.get()); });
 
     MegaScheduledCopyListener* listener = backup->getBackupListener();
     if(listener)
@@ -16692,10 +18030,10 @@ void MegaApiImpl::fireOnBackupTemporaryError(MegaScheduledCopyController *backup
         (*it++)->onBackupTemporaryError(api, backup, e.get());
     }
 
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onBackupTemporaryError(api, backup, e.get());
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaScheduledCopy> b = fanout.share<MegaScheduledCopy>(backup);
+    std::shared_ptr<MegaError> error = fanout.share<MegaError>(e.get());
+    fanout.call(listeners, [this, b, error](MegaListener* l) { l->onBackupTemporaryError(api, b.get(), error.get()); });
 
     MegaScheduledCopyListener* listener = backup->getBackupListener();
     if(listener)
@@ -16714,10 +18052,9 @@ void MegaApiImpl::fireOnBackupUpdate(MegaScheduledCopyController *backup)
         (*it++)->onBackupUpdate(api, backup);
     }
 
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onBackupUpdate(api, backup);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaScheduledCopy> b = fanout.share<MegaScheduledCopy>(backup);
+    fanout.call(listeners, [this, b](MegaListener* l) { l->onBackupUpdate(api, b.get()); });
 
     MegaScheduledCopyListener* listener = backup->getBackupListener();
     if(listener)
@@ -16732,14 +18069,10 @@ void MegaApiImpl::fireOnBackupUpdate(MegaScheduledCopyController *backup)
 void MegaApiImpl::fireOnChatsUpdate(MegaTextChatList *chats)
 {
     assert(threadId == std::this_thread::get_id());
-    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ;)
-    {
-        (*it++)->onChatsUpdate(api, chats);
-    }
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ;)
-    {
-        (*it++)->onChatsUpdate(api, chats);
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::shared_ptr<MegaTextChatList> c = fanout.share<MegaTextChatList>(chats);
+    fanout.call(globalListeners, [this, c](MegaGlobalListener* l) { l->onChatsUpdate(api, c.get()); });
+    fanout.call(listeners, [this, c](MegaListener* l) { l->onChatsUpdate(api, c.get()); });
 }
 
 #endif
@@ -16755,15 +18088,22 @@ void MegaApiImpl::processTransferPrepare(Transfer *t, MegaTransferPrivate *trans
 void MegaApiImpl::processTransferUpdate(Transfer *tr, MegaTransferPrivate *transfer)
 {
     dstime currentTime = Waiter::ds;
+
+    // mere progress may be held back by the update policy
+    bool progressOnly = tr->slot
+            && transfer->getState() == tr->state
+            && transfer->getPriority() == tr->priority
+            && tr->slot->progressreported != tr->size;
+
     if (tr->slot)
     {
         m_off_t prevTransferredBytes = transfer->getTransferredBytes();
         m_off_t deltaSize = tr->slot->progressreported - prevTransferredBytes;
         transfer->setStartTime(currentTime);
         transfer->setTransferredBytes(tr->slot->progressreported);
-        transfer->setDeltaSize(deltaSize);
         transfer->setSpeed(tr->slot->speed);
         transfer->setMeanSpeed(tr->slot->meanSpeed);
+        transfer->setTimeline(tr->timeline);
 
         if (tr->type == GET)
         {
@@ -16773,6 +18113,14 @@ void MegaApiImpl::processTransferUpdate(Transfer *tr, MegaTransferPrivate *trans
         {
             totalUploadedBytes += deltaSize;
         }
+
+        if (progressOnly && throttleTransferProgress(transfer))
+        {
+            return;
+        }
+
+        // everything since the previous report, which may have been several ticks ago
+        transfer->setDeltaSize(tr->slot->progressreported - transfer->progressNotifiedBytes);
     }
     else
     {
@@ -16784,9 +18132,26 @@ void MegaApiImpl::processTransferUpdate(Transfer *tr, MegaTransferPrivate *trans
     transfer->setState(tr->state);
     transfer->setPriority(tr->priority);
     transfer->setUpdateTime(currentTime);
+    transfer->progressNotifiedBytes = transfer->getTransferredBytes();
+    transfer->progressNotifiedTime = currentTime;
     fireOnTransferUpdate(transfer);
 }
 
+bool MegaApiImpl::throttleTransferProgress(MegaTransferPrivate* transfer)
+{
+    if (mTransferUpdatesAggregated)
+    {
+        // reported by fireOnTransfersProgress instead
+        return true;
+    }
+
+    dstime interval = mTransferUpdateIntervalDs;
+    long long minBytes = mTransferUpdateMinBytes;
+
+    return (interval && Waiter::ds - transfer->progressNotifiedTime < interval)
+        || (minBytes && transfer->getTransferredBytes() - transfer->progressNotifiedBytes < minBytes);
+}
+
 void MegaApiImpl::processTransferComplete(Transfer *tr, MegaTransferPrivate *transfer)
 {
     dstime currentTime = Waiter::ds;
@@ -16798,6 +18163,7 @@ void MegaApiImpl::processTransferComplete(Transfer *tr, MegaTransferPrivate *tra
     transfer->setDeltaSize(deltaSize);
     transfer->setSpeed(tr->slot ? tr->slot->speed : 0);
     transfer->setMeanSpeed(tr->slot ? tr->slot->meanSpeed : 0);
+    transfer->setTimeline(tr->timeline);
 
     if (tr->type == GET)
     {
@@ -16831,6 +18197,7 @@ void MegaApiImpl::processTransferFailed(Transfer *tr, MegaTransferPrivate *trans
     transfer->setMeanSpeed(0);
     transfer->setLastError(megaError.get());
     transfer->setPriority(tr->priority);
+    transfer->setTimeline(tr->timeline);
     if (e == API_ETOOMANY && e.hasExtraInfo())
     {
         transfer->setState(MegaTransfer::STATE_FAILED);
@@ -16958,114 +18325,6 @@ bool MegaApiImpl::isFilesystemAvailable()
     return client->nodeByHandle(client->mNodeManager.getRootNodeFiles()) != NULL;
 }
 
-bool isDigit(const char *c)
-{
-    return (*c >= '0' && *c <= '9');
-}
-
-// returns 0 if i==j, +1 if i goes first, -1 if j goes first.
-int naturalsorting_compare (const char *i, const char *j)
-{
-    static uint64_t maxNumber = (ULONG_MAX - 57) / 10; // 57 --> ASCII code for '9'
-
-    bool stringMode = true;
-
-    while (*i && *j)
-    {
-        if (stringMode)
-        {
-            char char_i, char_j;
-            while ( (char_i = *i) && (char_j = *j) )
-            {
-                bool char_i_isDigit = isDigit(i);
-                bool char_j_isDigit = isDigit(j);
-
-                if (char_i_isDigit && char_j_isDigit)
-                {
-                    stringMode = false;
-                    break;
-                }
-
-                if(char_i_isDigit)
-                {
-                    return -1;
-                }
-
-                if(char_j_isDigit)
-                {
-                    return 1;
-                }
-
-                int difference = strncasecmp((char *)&char_i, (char *)&char_j, 1);
-                if (difference)
-                {
-                    return difference;
-                }
-
-                ++i;
-                ++j;
-            }
-        }
-        else    // we are comparing numbers on both strings
-        {
-            uint64_t number_i = 0;
-            unsigned int i_overflow_count = 0;
-            while (*i && isDigit(i))
-            {
-                number_i = number_i * 10 + (*i - 48); // '0' ASCII code is 48
-                ++i;
-
-                // check the number won't overflow upon addition of next char
-                if (number_i >= maxNumber)
-                {
-                    number_i -= maxNumber;
-                    i_overflow_count++;
-                }
-            }
-
-            uint64_t number_j = 0;
-            unsigned int j_overflow_count = 0;
-            while (*j && isDigit(j))
-            {
-                number_j = number_j * 10 + (*j - 48);
-                ++j;
-
-                // check the number won't overflow upon addition of next char
-                if (number_j >= maxNumber)
-                {
-                    number_j -= maxNumber;
-                    j_overflow_count++;
-                }
-            }
-
-            int difference = i_overflow_count - j_overflow_count;
-            if (difference)
-            {
-                return difference;
-            }
-
-            if (number_i != number_j)
-            {
-                return number_i > number_j ? 1 : -1;
-            }
-
-            stringMode = true;
-        }
-    }
-
-    if (*j)
-    {
-        return -1;
-    }
-
-    if (*i)
-    {
-        return 1;
-    }
-
-    return 0;
-}
-
 std::function<bool (Node*, Node*)> MegaApiImpl::getComparatorFunction(int order, MegaClient& mc)
 {
     switch (order)
@@ -17098,6 +18357,35 @@ std::function<bool (Node*, Node*)> MegaApiImpl::getComparatorFunction(int order,
 
 void MegaApiImpl::sortByComparatorFunction(node_vector& v, int order, MegaClient& mc)
 {
+    if (order == MegaApi::ORDER_DEFAULT_ASC || order == MegaApi::ORDER_DEFAULT_DESC
+            || order == MegaApi::ORDER_ALPHABETICAL_ASC || order == MegaApi::ORDER_ALPHABETICAL_DESC)
+    {
+        // same order as nodeComparatorDefaultASC/DESC, but each name is turned into its
+        // collation key once, rather than parsed again by every comparison
+        bool ascending = order == MegaApi::ORDER_DEFAULT_ASC || order == MegaApi::ORDER_ALPHABETICAL_ASC;
+        std::vector<std::pair<std::string, Node*>> keyed;
+        keyed.reserve(v.size());
+        for (Node* n : v)
+        {
+            keyed.emplace_back(naturalsortingKey(n->displayname()), n);
+        }
+
+        std::sort(keyed.begin(), keyed.end(), [ascending](const std::pair<std::string, Node*>& i, const std::pair<std::string, Node*>& j)
+        {
+            if (i.second->type != j.second->type)
+            {
+                return i.second->type > j.second->type;
+            }
+            return ascending ? i.first < j.first : j.first < i.first;
+        });
+
+        for (size_t i = 0; i < keyed.size(); ++i)
+        {
+            v[i] = keyed[i].second;
+        }
+        return;
+    }
+
     if (auto f = getComparatorFunction(order, mc))
     {
         std::sort(v.begin(), v.end(), f);
@@ -17628,10 +18916,10 @@ MegaNodeList *MegaApiImpl::getChildren(MegaNode* p, int order, CancelToken cance
         {
             childrenNodes.push_back(*it++);
         }
-        if (std::function<bool(Node*, Node*)> comparatorFunction = getComparatorFunction(order, *client))
-        {
-            std::sort(childrenNodes.begin(), childrenNodes.end(), comparatorFunction);
-        }
+        sortByComparatorFunction(childrenNodes, order, *client);
+
+        // the app is likely to open one of the listed folders next
+        client->mNodeManager.prefetchChildren(childrenNodes);
     }
     return new MegaNodeListPrivate(childrenNodes.data(), int(childrenNodes.size()));
 }
@@ -17663,12 +18951,103 @@ MegaNodeList *MegaApiImpl::getChildren(MegaNodeList *parentNodes, int order)
     }
 
     // sort all the children together
-    if (std::function<bool(Node*, Node*)> comparatorFunction = getComparatorFunction(order, *client))
+    sortByComparatorFunction(childrenNodes, order, *client);
+
+    return new MegaNodeListPrivate(childrenNodes.data(), int(childrenNodes.size()));
+}
+
+bool MegaApiImpl::visitChildren(MegaNode *parent, MegaNodeViewVisitor *visitor, int order)
+{
+    if (!parent || !visitor || parent->getType() == MegaNode::TYPE_FILE)
     {
-        std::sort(childrenNodes.begin(), childrenNodes.end(), comparatorFunction);
+        return false;
     }
 
-    return new MegaNodeListPrivate(childrenNodes.data(), int(childrenNodes.size()));
+    SdkMutexGuard guard(sdkMutex);
+
+    Node *p = client->nodebyhandle(parent->getHandle());
+    if (!p || p->type == FILENODE)
+    {
+        return false;
+    }
+
+    node_list nodeList = client->getChildren(p);
+    node_vector children(nodeList.begin(), nodeList.end());
+    sortByComparatorFunction(children, order, *client);
+
+    // the same view goes through all the children
+    MegaNodeViewPrivate view;
+    for (Node* child : children)
+    {
+        view.setNode(child);
+        if (!visitor->visit(&view))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+MegaNodeList* MegaApiImpl::getChildrenPage(MegaNode *parent, int order, long long offset, int limit, CancelToken cancelToken)
+{
+    if (!parent || parent->getType() == MegaNode::TYPE_FILE || offset < 0 || limit <= 0)
+    {
+        return new MegaNodeListPrivate();
+    }
+
+    SdkMutexGuard guard(sdkMutex);
+
+    Node *p = client->nodebyhandle(parent->getHandle());
+    if (!p || p->type == FILENODE)
+    {
+        return new MegaNodeListPrivate();
+    }
+
+    ChildrenOrder childrenOrder = ChildrenOrder::NAME_ASC;
+    bool sortedByDb = true;
+    switch (order)
+    {
+        case MegaApi::ORDER_DEFAULT_ASC:
+        case MegaApi::ORDER_ALPHABETICAL_ASC:
+            childrenOrder = ChildrenOrder::NAME_ASC;
+            break;
+        case MegaApi::ORDER_DEFAULT_DESC:
+        case MegaApi::ORDER_ALPHABETICAL_DESC:
+            childrenOrder = ChildrenOrder::NAME_DESC;
+            break;
+        case MegaApi::ORDER_CREATION_ASC:
+            childrenOrder = ChildrenOrder::CTIME_ASC;
+            break;
+        case MegaApi::ORDER_CREATION_DESC:
+            childrenOrder = ChildrenOrder::CTIME_DESC;
+            break;
+        default:
+            sortedByDb = false;
+            break;
+    }
+
+    node_vector page;
+    if (sortedByDb && client->mNodeManager.getChildrenPage(p, childrenOrder, static_cast<uint64_t>(offset), static_cast<uint64_t>(limit), page, cancelToken))
+    {
+        client->mNodeManager.prefetchChildren(page);
+        return new MegaNodeListPrivate(page.data(), int(page.size()));
+    }
+
+    // the order depends on data that isn't in DB: sort all the children, but only wrap the page
+    node_list nodeList = client->getChildren(p, cancelToken);
+    node_vector childrenNodes(nodeList.begin(), nodeList.end());
+    sortByComparatorFunction(childrenNodes, order, *client);
+
+    if (static_cast<size_t>(offset) >= childrenNodes.size())
+    {
+        return new MegaNodeListPrivate();
+    }
+
+    size_t count = std::min(childrenNodes.size() - static_cast<size_t>(offset), static_cast<size_t>(limit));
+    page.assign(childrenNodes.begin() + offset, childrenNodes.begin() + offset + count);
+    client->mNodeManager.prefetchChildren(page);
+    return new MegaNodeListPrivate(page.data(), int(page.size()));
 }
 
 MegaNodeList *MegaApiImpl::getVersions(MegaNode *node)
@@ -17755,10 +19134,7 @@ MegaNodeList* MegaApiImpl::getChildrenFromType(MegaNode* p, int type, int order,
     {
         childrenNodes = client->mNodeManager.getChildrenFromType(parent, static_cast<nodetype_t>(type), cancelToken);
 
-        if (std::function<bool(Node*, Node*)> comparatorFunction = getComparatorFunction(order, *client))
-        {
-            std::sort(childrenNodes.begin(), childrenNodes.end(), comparatorFunction);
-        }
+        sortByComparatorFunction(childrenNodes, order, *client);
     }
 
     return new MegaNodeListPrivate(childrenNodes.data(), int(childrenNodes.size()));
@@ -18006,8 +19382,36 @@ MegaNode* MegaApiImpl::getNodeByPath(const char *path, MegaNode* node)
 MegaNode* MegaApiImpl::getNodeByHandle(handle handle)
 {
     if(handle == UNDEF) return NULL;
+
+    // return without locking the main mutex if the node hasn't changed since it was last requested
+    // (always lock for folder links, as for the root node: they don't report a logged in state)
+    bool snapshot = isLoggedIn() != NOTLOGGEDIN;
+    if (snapshot)
+    {
+        lock_guard<mutex> g(mNodeSnapshotMutex);
+        auto it = mNodeSnapshot.find(handle);
+        if (it != mNodeSnapshot.end())
+        {
+            return it->second->copy();
+        }
+    }
+
     SdkMutexGuard g(sdkMutex);
-    return MegaNodePrivate::fromNode(client->nodebyhandle(handle));
+    MegaNode* node = MegaNodePrivate::fromNode(client->nodebyhandle(handle));
+
+    // a node with change flags (requested from onNodesUpdate, say) is only stored once they're cleared
+    if (node && snapshot && !node->getChanges())
+    {
+        // still holding sdkMutex, so nodes_updated() can't invalidate it before it is stored
+        lock_guard<mutex> sg(mNodeSnapshotMutex);
+        if (mNodeSnapshot.size() >= NODE_SNAPSHOT_MAX)
+        {
+            mNodeSnapshot.clear();
+        }
+        mNodeSnapshot[handle].reset(node->copy());
+    }
+
+    return node;
 }
 
 MegaContactRequest *MegaApiImpl::getContactRequestByHandle(MegaHandle handle)
@@ -18028,11 +19432,18 @@ void MegaApiImpl::updateBackups()
     }
 }
 
-void MegaApiImpl::executeOnThread(shared_ptr<ExecuteOnce> f)
+void MegaApiImpl::executeOnThread(shared_ptr<ExecuteOnce> f, bool first)
 {
     MegaRequestPrivate* request = new MegaRequestPrivate(MegaRequest::TYPE_EXECUTE_ON_THREAD, nullptr);
     request->functionToExecute = std::move(f);
-    requestQueue.push_front(request);  // these operations are part of requests that already queued, and should occur before other requests; queue at front
+    if (first)
+    {
+        requestQueue.push_front(request);  // these operations are part of requests that already queued, and should occur before other requests; queue at front
+    }
+    else
+    {
+        requestQueue.push(request);
+    }
     waiter->notify();
 }
 
@@ -18056,8 +19467,16 @@ unsigned MegaApiImpl::sendPendingTransfers(TransferQueue *queue, MegaRecursiveOp
     // passed to the SDK.
     bool canSplit = !queue;
 
+    // file uploads still covered by the last bulk fingerprint preload
+    size_t fingerprintsPreloaded = 0;
+
     while (MegaTransferPrivate *transfer = auxQueue.pop())
     {
+        // the transfer may be gone by the end of the iteration
+        int transferType = transfer->getType();
+        MegaHandle transferParent = transfer->getParentHandle();
+        string transferParentPath = transfer->getParentPath() ? transfer->getParentPath() : "";
+
         error e = API_OK;
         int nextTag = client->nextreqtag();
         transfer->setState(MegaTransfer::STATE_QUEUED);
@@ -18145,6 +19564,19 @@ unsigned MegaApiImpl::sendPendingTransfers(TransferQueue *queue, MegaRecursiveOp
                         fp_forCloud.mtime = mtime;
                     }
 
+                    if (!fingerprintsPreloaded && !auxQueue.empty())
+                    {
+                        // resolve this and the next uploads' fingerprints in one DB query rather than one each
+                        std::vector<FileFingerprint> fingerprints(1, fp_forCloud);
+                        auxQueue.peekUploadFingerprints(MAX_FINGERPRINT_PRELOAD - 1, fingerprints);
+                        client->mNodeManager.preloadFingerprints(fingerprints);
+                        fingerprintsPreloaded = fingerprints.size();
+                    }
+                    if (fingerprintsPreloaded)
+                    {
+                        fingerprintsPreloaded--;
+                    }
+
                     Node *previousNode = client->childnodebyname(parent, fileName, false);
 
                     bool forceToUpload = false;
@@ -18237,7 +19669,8 @@ unsigned MegaApiImpl::sendPendingTransfers(TransferQueue *queue, MegaRecursiveOp
                             }
                             else
                             {
-                                client->putnodes(parent->nodeHandle(), UseLocalVersioningFlag, move(tc.nn), nullptr, nextTag, false);
+                                // copies of files already in the cloud share putnodes with each other and with finished uploads
+                                client->putnodesBatched(parent->nodeHandle(), UseLocalVersioningFlag, move(tc.nn), nextTag, false);
                             }
 
                             transfer->setDeltaSize(transfer->fingerprint_onDisk.size);
@@ -18549,7 +19982,7 @@ unsigned MegaApiImpl::sendPendingTransfers(TransferQueue *queue, MegaRecursiveOp
                         transfer->setState(MegaTransfer::STATE_QUEUED);
 
                         fireOnTransferStart(transfer);
-                        client->pread(node, startPos, totalBytes, transfer);
+                        client->pread(node, startPos, totalBytes, transfer, transfer->isSequentialRead());
                         waiter->notify();
                     }
                     else
@@ -18574,7 +20007,7 @@ unsigned MegaApiImpl::sendPendingTransfers(TransferQueue *queue, MegaRecursiveOp
                                       startPos, totalBytes, transfer, publicNode->isForeign(),
                                       publicNode->getPrivateAuth()->c_str(),
                                       publicNode->getPublicAuth()->c_str(),
-                                      publicNode->getChatAuth());
+                                      publicNode->getChatAuth(), transfer->isSequentialRead());
                         waiter->notify();
                     }
                 }
@@ -18596,9 +20029,17 @@ unsigned MegaApiImpl::sendPendingTransfers(TransferQueue *queue, MegaRecursiveOp
             fireOnTransferFinish(transfer, make_unique<MegaErrorPrivate>(e));
         }
 
-        if (canSplit && (++count > 100 || std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count() > 100))
+        // the pass holds sdkMutex, so it always ends after 100 ms. Within that, a run of transfers
+        // to the same parent (thousands of startUpload calls for one folder) is kept together
+        // beyond the usual 100 transfers, up to a larger bound
+        if (canSplit)
         {
-            break;
+            ++count;
+            if (std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count() > 100
+                    || (count > 100 && (count > MAX_RELATED_TRANSFERS_PER_PASS || !auxQueue.nextIsRelated(transferType, transferParent, transferParentPath))))
+            {
+                break;
+            }
         }
     }
     return count;
@@ -18739,6 +20180,26 @@ static error updateAttributesMapWithCoordinates(attr_map& attrUpdates, int latit
     return API_OK;
 }
 
+// record the nodes of a bulk operation that failed, keyed by their Base64 handle, and return the
+// error the request finishes with: API_OK if none failed, otherwise the first failure
+static error bulkResultsToStringMap(const vector<pair<NodeHandle, Error>>& results, MegaStringMapPrivate& failed)
+{
+    error e = API_OK;
+    for (auto& result : results)
+    {
+        error resultError = result.second;
+        if (resultError != API_OK)
+        {
+            failed.set(Base64Str<MegaClient::NODEHANDLE>(result.first.as8byte()), std::to_string(resultError).c_str());
+            if (e == API_OK)
+            {
+                e = resultError;
+            }
+        }
+    }
+    return e;
+}
+
 void MegaApiImpl::sendPendingScRequest()
 {
     MegaRequestPrivate *request = scRequestQueue.front();
@@ -18916,6 +20377,62 @@ void MegaApiImpl::sendPendingRequests()
                 });
             break;
 
+        case MegaRequest::TYPE_PUT_SET_ELEMENTS:
+        {
+            const MegaHandleList* nodes = request->getMegaHandleList();
+            const MegaStringList* names = request->getMegaStringList();
+            if (!nodes || !nodes->size() || (names && names->size() != int(nodes->size())))
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            vector<SetElement> els(nodes->size());
+            for (unsigned i = 0; i < nodes->size(); ++i)
+            {
+                SetElement& el = els[i];
+                el.setSet(request->getTotalBytes());
+                el.setNode(nodes->get(i));
+                if (names && names->get(int(i)) && *names->get(int(i)))
+                {
+                    el.setName(names->get(int(i)));
+                }
+            }
+
+            client->putSetElements(move(els),
+                [this, request](Error e, const vector<const SetElement*>* els, const vector<int64_t>* results)
+                {
+                    if (e == API_OK && els && results)
+                    {
+                        request->setMegaSetElementList(::mega::make_unique<MegaSetElementListPrivate>(els->data(), int(els->size())));
+                        request->setMegaIntegerList(::mega::make_unique<MegaIntegerListPrivate>(*results));
+                    }
+                    fireOnRequestFinish(request, make_unique<MegaErrorPrivate>(e));
+                });
+            break;
+        }
+
+        case MegaRequest::TYPE_REMOVE_SET_ELEMENTS:
+        {
+            const MegaHandleList* eids = request->getMegaHandleList();
+            vector<handle> ids;
+            for (unsigned i = 0; eids && i < eids->size(); ++i)
+            {
+                ids.push_back(eids->get(i));
+            }
+
+            client->removeSetElements(request->getTotalBytes(), move(ids),
+                [this, request](Error e, const vector<int64_t>* results)
+                {
+                    if (e == API_OK && results)
+                    {
+                        request->setMegaIntegerList(::mega::make_unique<MegaIntegerListPrivate>(*results));
+                    }
+                    fireOnRequestFinish(request, make_unique<MegaErrorPrivate>(e));
+                });
+            break;
+        }
+
         case MegaRequest::TYPE_EXECUTE_ON_THREAD:
             request->functionToExecute->exec();
             //requestMap.erase(request->getTag());  // per the test for TYPE_EXECUTE_ON_THREAD above, we didn't add it to the map or assign it a tag
@@ -19245,6 +20762,62 @@ void MegaApiImpl::sendPendingRequests()
                 });
             break;
         }
+        case MegaRequest::TYPE_MOVE_NODES:
+        {
+            Node *newParent = client->nodebyhandle(request->getParentHandle());
+            const MegaHandleList *handles = request->getMegaHandleList();
+            if (!newParent || !handles || !handles->size())
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            // target must be a folder with enough permissions
+            if (newParent->type == FILENODE || !client->checkaccess(newParent, RDWR))
+            {
+                e = API_EACCESS;
+                break;
+            }
+
+            vector<Node*> nodes;
+            vector<pair<NodeHandle, Error>> rejected;
+            for (unsigned i = 0; i < handles->size(); i++)
+            {
+                NodeHandle h = NodeHandle().set6byte(handles->get(i));
+                Node *node = client->nodeByHandle(h);
+                if (!node)
+                {
+                    rejected.emplace_back(h, API_ENOENT);
+                }
+                else if (node->type == ROOTNODE
+                        || node->type == VAULTNODE
+                        || node->type == RUBBISHNODE
+                        || !node->parent        // rootnodes cannot be moved
+                        || node->parent->type == FILENODE)  // old versions cannot be moved
+                {
+                    rejected.emplace_back(h, API_EACCESS);
+                }
+                else
+                {
+                    nodes.push_back(node);
+                }
+            }
+
+            client->renames(nodes, newParent, false,
+                [request, this, rejected](vector<pair<NodeHandle, Error>>&& results)
+                {
+#ifdef ENABLE_SYNC
+                    client->syncdownrequired = true;
+#endif
+                    results.insert(results.end(), rejected.begin(), rejected.end());
+
+                    MegaStringMapPrivate failed;
+                    error e = bulkResultsToStringMap(results, failed);
+                    request->setMegaStringMap(&failed);
+                    fireOnRequestFinish(request, make_unique<MegaErrorPrivate>(e));
+                });
+            break;
+        }
         case MegaRequest::TYPE_COPY:
         {
             Node *node = NULL;
@@ -19882,6 +21455,21 @@ void MegaApiImpl::sendPendingRequests()
                 }
                 key.assign((const char *)nodekey, sizeof nodekey);
             }
+
+            handle fah;
+            int cluster;
+            if (mFileAttributeCache && MegaClient::fileattributehandle(&fileattrstring, (fatype) type, &fah, &cluster))
+            {
+                // to store it once received, see fa_complete
+                request->setParentHandle(fah);
+                if (mFileAttributeCache->copyTo(fah, LocalPath::fromAbsolutePath(dstFilePath)))
+                {
+                    LOG_debug << "File attribute found in the cache: " << toHandle(fah);
+                    fireOnRequestFinish(request, make_unique<MegaErrorPrivate>(API_OK));
+                    break;
+                }
+            }
+
             e = client->getfa(h, &fileattrstring, key, (fatype) type);
             if(e == API_EEXIST)
             {
@@ -20504,6 +22092,60 @@ void MegaApiImpl::sendPendingRequests()
             break;
         }
 
+        case MegaRequest::TYPE_SET_ATTR_NODES:
+        {
+            const MegaHandleList *handles = request->getMegaHandleList();
+            const char* attrName = request->getName();
+            const char* attrValue = request->getText();
+
+            if (!handles || !handles->size() || !attrName || !attrName[0] || strlen(attrName) > 7)
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            string sname = attrName;
+            LocalPath::utf8_normalize(&sname);
+            sname.insert(0, "_");
+            nameid attr = AttrMap::string2nameid(sname.c_str());
+
+            string svalue;
+            if (attrValue)
+            {
+                svalue = attrValue;
+                LocalPath::utf8_normalize(&svalue);
+            }
+
+            vector<pair<Node*, attr_map>> updates;
+            vector<pair<NodeHandle, Error>> rejected;
+            for (unsigned i = 0; i < handles->size(); i++)
+            {
+                NodeHandle h = NodeHandle().set6byte(handles->get(i));
+                Node *node = client->nodeByHandle(h);
+                if (!node)
+                {
+                    rejected.emplace_back(h, API_ENOENT);
+                    continue;
+                }
+
+                attr_map attrUpdates;
+                attrUpdates[attr] = svalue;
+                updates.emplace_back(node, std::move(attrUpdates));
+            }
+
+            client->setattrs(std::move(updates), false,
+                [request, this, rejected](vector<pair<NodeHandle, Error>>&& results)
+                {
+                    results.insert(results.end(), rejected.begin(), rejected.end());
+
+                    MegaStringMapPrivate failed;
+                    error e = bulkResultsToStringMap(results, failed);
+                    request->setMegaStringMap(&failed);
+                    fireOnRequestFinish(request, make_unique<MegaErrorPrivate>(e));
+                });
+            break;
+        }
+
         case MegaRequest::TYPE_GET_ATTR_NODE:
         {
             int type = request->getParamType();
@@ -20571,6 +22213,38 @@ void MegaApiImpl::sendPendingRequests()
             handle h = request->getNodeHandle();
             const char *fa = request->getText();
 
+            if (request->getFlag())
+            {
+                // all but the nodes in the list
+                std::set<handle> keep;
+                MegaHandleList* nodeHandles = request->getMegaHandleList();
+                for (int i = 0; nodeHandles && i < nodeHandles->size(); i++)
+                {
+                    keep.insert(nodeHandles->get(i));
+                }
+
+                vector<handle> cancelled;
+                client->cancelgetfaexcept((fatype) type, keep, cancelled);
+                std::set<handle> cancelledNodes(cancelled.begin(), cancelled.end());
+
+                std::map<int, MegaRequestPrivate*>::iterator it = requestMap.begin();
+                while(it != requestMap.end())
+                {
+                    MegaRequestPrivate *r = it->second;
+                    it++;
+                    if (r->getType() == MegaRequest::TYPE_GET_ATTR_FILE &&
+                        r->getParamType() == type &&
+                        cancelledNodes.count(r->getNodeHandle()))
+                    {
+                        fireOnRequestFinish(r, make_unique<MegaErrorPrivate>(API_EINCOMPLETE));
+                    }
+                }
+
+                request->setNumber(static_cast<long long>(cancelledNodes.size()));
+                fireOnRequestFinish(request, make_unique<MegaErrorPrivate>(API_OK));
+                break;
+            }
+
             Node *node = client->nodebyhandle(h);
 
             if((!fa && !node) || (fa && ISUNDEF(h)))
@@ -21844,12 +23518,13 @@ void MegaApiImpl::sendPendingRequests()
         }
         case MegaRequest::TYPE_DELETE:
         {
-#ifdef HAVE_LIBUV
             g.unlock();
+#ifdef HAVE_LIBUV
             httpServerStop();
             ftpServerStop();
-            g.lock();
 #endif
+            stopSearchThread();
+            g.lock();
             abortPendingActions();
             threadExit = 1;
             break;
@@ -23290,6 +24965,54 @@ void MegaApiImpl::sendPendingRequests()
            fireOnRequestFinish(request, make_unique<MegaErrorPrivate>(API_OK));
            break;
         }
+        case MegaRequest::TYPE_SEARCH:
+        {
+            const char* searchString = request->getText();
+            int order = static_cast<int>(request->getNumber());
+            int type = request->getParamType();
+            int target = request->getAccess();
+            MegaHandle nodeHandle = request->getNodeHandle();
+
+            // as search(), except that searches by type need a valid type
+            if ((!searchString || !*searchString) && (type < MegaApi::FILE_TYPE_PHOTO || type > MegaApi::FILE_TYPE_DOCUMENT))
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            if (type < MegaApi::FILE_TYPE_DEFAULT || type > MegaApi::FILE_TYPE_DOCUMENT
+                    || order < MegaApi::ORDER_NONE || order > MegaApi::ORDER_FAV_DESC
+                    || (type != MegaApi::FILE_TYPE_DEFAULT && order >= MegaApi::ORDER_PHOTO_ASC && order <= MegaApi::ORDER_VIDEO_DESC)
+                    || (nodeHandle == INVALID_HANDLE && (target < MegaApi::SEARCH_TARGET_INSHARE || target > MegaApi::SEARCH_TARGET_ALL)))
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            if (client->mNodeManager.getRootNodeFiles().isUndef())
+            {
+                e = API_EACCESS;
+                break;
+            }
+
+            if (nodeHandle != INVALID_HANDLE && !client->nodebyhandle(nodeHandle))
+            {
+                e = API_ENOENT;
+                break;
+            }
+
+            unique_ptr<AsyncSearch> search = ::mega::make_unique<AsyncSearch>();
+            search->tag = request->getTag();
+            search->node = nodeHandle;
+            search->searchString = searchString ? searchString : "";
+            search->recursive = request->getFlag();
+            search->order = order;
+            search->type = type;
+            search->target = target;
+            search->cancelToken = CancelToken(false);
+            e = startSearch(std::move(search));
+            break;
+        }
 
 #ifdef ENABLE_CHAT
         case MegaRequest::TYPE_ADD_UPDATE_SCHEDULED_MEETING:
@@ -23485,6 +25208,18 @@ long long MegaApiImpl::getNumNodes()
     return client->totalNodes;
 }
 
+void MegaApiImpl::setMaxNodesInRam(long long maxNodes)
+{
+    SdkMutexGuard g(sdkMutex);
+    client->mNodeManager.setMaxNodesInRam(maxNodes > 0 ? static_cast<uint64_t>(maxNodes) : 0);
+}
+
+void MegaApiImpl::setChildrenPrefetch(int folders)
+{
+    SdkMutexGuard g(sdkMutex);
+    client->mNodeManager.setChildrenPrefetch(folders > 0 ? static_cast<unsigned>(folders) : 0);
+}
+
 long long MegaApiImpl::getTotalDownloadedBytes()
 {
     return totalDownloadedBytes;
@@ -23772,10 +25507,9 @@ bool MegaApiImpl::requestStatusMonitorEnabled()
 #ifdef USE_DRIVE_NOTIFICATIONS
 void MegaApiImpl::drive_presence_changed(bool appeared, const LocalPath& driveRoot)
 {
-    for (auto it = globalListeners.begin(); it != globalListeners.end(); ++it)
-    {
-        (*it)->onDrivePresenceChanged(api, appeared, driveRoot.platformEncoded().c_str());
-    }
+    ListenerFanout fanout(mListenerDispatcher.load());
+    std::string root = driveRoot.platformEncoded();
+    fanout.call(globalListeners, [this, appeared, root](MegaGlobalListener* l) { l->onDrivePresenceChanged(api, appeared, root.c_str()); });
 }
 #endif
 
@@ -23832,6 +25566,25 @@ void MegaApiImpl::removeSetElement(MegaHandle sid, MegaHandle eid, MegaRequestLi
     waiter->notify();
 }
 
+void MegaApiImpl::createSetElements(MegaHandle sid, const MegaHandleList* nodes, const MegaStringList* names, MegaRequestListener* listener)
+{
+    MegaRequestPrivate* request = new MegaRequestPrivate(MegaRequest::TYPE_PUT_SET_ELEMENTS, listener);
+    request->setTotalBytes(sid);
+    request->mHandleList.reset(nodes ? nodes->copy() : nullptr);
+    request->mStringList.reset(names ? names->copy() : nullptr);
+    requestQueue.push(request);
+    waiter->notify();
+}
+
+void MegaApiImpl::removeSetElements(MegaHandle sid, const MegaHandleList* eids, MegaRequestListener* listener)
+{
+    MegaRequestPrivate* request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE_SET_ELEMENTS, listener);
+    request->setTotalBytes(sid);
+    request->mHandleList.reset(eids ? eids->copy() : nullptr);
+    requestQueue.push(request);
+    waiter->notify();
+}
+
 MegaSetList* MegaApiImpl::getSets()
 {
     SdkMutexGuard g(sdkMutex);
@@ -23874,6 +25627,14 @@ MegaSetElementList* MegaApiImpl::getSetElements(MegaHandle sid)
     return eList;
 }
 
+MegaSetElementList* MegaApiImpl::getSetElements(MegaHandle sid, unsigned offset, unsigned count)
+{
+    SdkMutexGuard g(sdkMutex);
+
+    vector<const SetElement*> page = client->getSetElements(sid, offset, count);
+    return new MegaSetElementListPrivate(page.data(), int(page.size()));
+}
+
 MegaSetElement* MegaApiImpl::getSetElement(MegaHandle sid, MegaHandle eid)
 {
     SdkMutexGuard g(sdkMutex);
@@ -23999,49 +25760,68 @@ void TreeProcCopy::proc(MegaClient* client, Node* n)
     else nc++;
 }
 
-int TransferQueue::getLastPushedTag() const
+TransferQueue::TransferQueue()
 {
-    return lastPushedTransferTag;
 }
 
-TransferQueue::TransferQueue()
+void TransferQueue::drainInbox()
 {
+    inbox.takeAll([this](MegaTransferPrivate* transfer)
+    {
+        transfers.push_back(transfer);
+    });
 }
 
 void TransferQueue::push(MegaTransferPrivate *transfer)
 {
-    std::lock_guard<std::mutex> g(mutex);
-    transfers.push_back(transfer);
     transfer->setPlaceInQueue(++lastPushedTransferTag);
+    inbox.push(transfer);
+}
+
+void TransferQueue::push(const std::vector<MegaTransferPrivate *>& batch)
+{
+    int tag = lastPushedTransferTag.fetch_add(static_cast<int>(batch.size()));
+    for (MegaTransferPrivate* transfer : batch)
+    {
+        transfer->setPlaceInQueue(++tag);
+    }
+    inbox.push(batch);
 }
 
 void TransferQueue::push_front(MegaTransferPrivate *transfer)
 {
     std::lock_guard<std::mutex> g(mutex);
+    drainInbox();
     transfers.push_front(transfer);
 }
 
 bool TransferQueue::empty()
 {
     std::lock_guard<std::mutex> g(mutex);
-    return transfers.empty();
+    return transfers.empty() && inbox.empty();
 }
 
 size_t TransferQueue::size()
 {
     std::lock_guard<std::mutex> g(mutex);
+    drainInbox();
     return transfers.size();
 }
 
 void TransferQueue::clear()
 {
     std::lock_guard<std::mutex> g(mutex);
+    drainInbox();
     return transfers.clear();
 }
 
 MegaTransferPrivate *TransferQueue::pop()
 {
     std::lock_guard<std::mutex> g(mutex);
+    if (transfers.empty())
+    {
+        drainInbox();
+    }
     if(transfers.empty())
     {
         return NULL;
@@ -24051,29 +25831,43 @@ MegaTransferPrivate *TransferQueue::pop()
     return transfer;
 }
 
-std::vector<MegaTransferPrivate *> TransferQueue::popUpTo(int lastQueuedTransfer, int direction)
+bool TransferQueue::nextIsRelated(int type, MegaHandle parentHandle, const string& parentPath)
 {
     std::lock_guard<std::mutex> g(mutex);
-    std::vector<MegaTransferPrivate*> toret;
-    for (auto it = transfers.begin(); it != transfers.end();)
+    if (transfers.empty())
     {
-        MegaTransferPrivate *transfer = *it;
-        if (transfer->getPlaceInQueue() > lastQueuedTransfer)
-        {
-            break;
-        }
+        drainInbox();
+    }
+    if (transfers.empty())
+    {
+        return false;
+    }
 
-        if (!transfer->isSyncTransfer() && transfer->getType() == direction)
-        {
-            toret.push_back(transfer);
-            it = transfers.erase(it);
-        }
-        else
+    MegaTransferPrivate* next = transfers.front();
+    return next->getType() == type
+        && next->getParentHandle() == parentHandle
+        && parentPath == (next->getParentPath() ? next->getParentPath() : "");
+}
+
+void TransferQueue::peekUploadFingerprints(size_t max, std::vector<FileFingerprint>& fingerprints)
+{
+    std::lock_guard<std::mutex> g(mutex);
+    drainInbox();
+    for (auto it = transfers.begin(); it != transfers.end() && max; ++it)
+    {
+        MegaTransferPrivate* transfer = *it;
+        if (transfer->getType() == MegaTransfer::TYPE_UPLOAD
+                && transfer->fingerprint_filetype == FILENODE
+                && transfer->fingerprint_onDisk.isvalid)
         {
-            it++;
+            fingerprints.push_back(transfer->fingerprint_onDisk);
+            if (transfer->getTime() != MegaApi::INVALID_CUSTOM_MOD_TIME)
+            {
+                fingerprints.back().mtime = transfer->getTime();
+            }
+            max--;
         }
     }
-    return toret;
 }
 
 void TransferQueue::removeWithFolderTag(int folderTag, std::function<void(MegaTransferPrivate *)> callback)
@@ -24084,6 +25878,7 @@ void TransferQueue::removeWithFolderTag(int folderTag, std::function<void(MegaTr
     // However the callback (including its calls to fireOnXYZ() ) must be careful not to lock any mutex which
     // may have been locked during other MegaApi function calls.
     std::lock_guard<std::mutex> g(mutex);
+    drainInbox();
 
     for (auto it = transfers.begin(); it != transfers.end();)
     {
@@ -24105,6 +25900,7 @@ void TransferQueue::removeWithFolderTag(int folderTag, std::function<void(MegaTr
 void TransferQueue::removeListener(MegaTransferListener *listener)
 {
     std::lock_guard<std::mutex> g(mutex);
+    drainInbox();
 
     std::deque<MegaTransferPrivate *>::iterator it = transfers.begin();
     while(it != transfers.end())
@@ -24119,6 +25915,7 @@ void TransferQueue::removeListener(MegaTransferListener *listener)
 void TransferQueue::setAllCancelled(CancelToken cancelled, int direction)
 {
     std::lock_guard<std::mutex> g(mutex);
+    drainInbox();
     for (auto& t : transfers)
     {
         if (t->getType() == direction
@@ -24134,21 +25931,33 @@ RequestQueue::RequestQueue()
 {
 }
 
+void RequestQueue::drainInbox()
+{
+    inbox.takeAll([this](MegaRequestPrivate* request)
+    {
+        requests.push_back(request);
+    });
+}
+
 void RequestQueue::push(MegaRequestPrivate *request)
 {
-    std::lock_guard<std::mutex> g(mutex);
-    requests.push_back(request);
+    inbox.push(request);
 }
 
 void RequestQueue::push_front(MegaRequestPrivate *request)
 {
     std::lock_guard<std::mutex> g(mutex);
+    drainInbox();
     requests.push_front(request);
 }
 
 MegaRequestPrivate *RequestQueue::pop()
 {
     std::lock_guard<std::mutex> g(mutex);
+    if (requests.empty())
+    {
+        drainInbox();
+    }
     if(requests.empty())
     {
         return NULL;
@@ -24161,6 +25970,10 @@ MegaRequestPrivate *RequestQueue::pop()
 MegaRequestPrivate *RequestQueue::front()
 {
     std::lock_guard<std::mutex> g(mutex);
+    if (requests.empty())
+    {
+        drainInbox();
+    }
     if(requests.empty())
     {
         return NULL;
@@ -24172,6 +25985,7 @@ MegaRequestPrivate *RequestQueue::front()
 void RequestQueue::removeListener(MegaRequestListener *listener)
 {
     std::lock_guard<std::mutex> g(mutex);
+    drainInbox();
 
     std::deque<MegaRequestPrivate *>::iterator it = requests.begin();
     while(it != requests.end())
@@ -24186,6 +26000,7 @@ void RequestQueue::removeListener(MegaRequestListener *listener)
 void RequestQueue::removeListener(MegaScheduledCopyListener *listener)
 {
     std::lock_guard<std::mutex> g(mutex);
+    drainInbox();
 
     std::deque<MegaRequestPrivate *>::iterator it = requests.begin();
     while(it != requests.end())
@@ -24197,6 +26012,143 @@ void RequestQueue::removeListener(MegaScheduledCopyListener *listener)
     }
 }
 
+ListenerDispatcher::ListenerDispatcher(unsigned threads)
+{
+    for (unsigned i = std::max(threads, 1u); i--; )
+    {
+        mThreads.emplace_back([this]() { run(); });
+    }
+}
+
+ListenerDispatcher::~ListenerDispatcher()
+{
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mStop = true;
+    }
+    mWork.notify_all();
+
+    for (auto& t : mThreads)
+    {
+        t.join();
+    }
+}
+
+void ListenerDispatcher::post(const void* listener, std::function<void()> f)
+{
+    push(listener, Callback{false, 0, std::move(f)});
+}
+
+void ListenerDispatcher::postCoalesced(const void* listener, int key, std::function<void()> f)
+{
+    push(listener, Callback{true, key, std::move(f)});
+}
+
+void ListenerDispatcher::push(const void* listener, Callback&& callback)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    Strand& strand = mStrands[listener];
+
+    if (callback.coalescable && strand.callbacks.size() >= COALESCE_BACKLOG)
+    {
+        // only the latest pending one can be replaced without reordering anything
+        for (auto it = strand.callbacks.rbegin(); it != strand.callbacks.rend(); ++it)
+        {
+            if (!it->coalescable || it->key != callback.key)
+            {
+                continue;
+            }
+
+            if (std::all_of(strand.callbacks.rbegin(), it, [&](const Callback& c) { return c.coalescable; }))
+            {
+                it->f = std::move(callback.f);
+                return;
+            }
+            break;
+        }
+    }
+
+    strand.callbacks.push_back(std::move(callback));
+    if (!strand.running && strand.callbacks.size() == 1)
+    {
+        mReady.push_back(listener);
+        mWork.notify_one();
+    }
+}
+
+void ListenerDispatcher::forget(const void* listener)
+{
+    std::unique_lock<std::mutex> g(mMutex);
+    auto it = mStrands.find(listener);
+    if (it == mStrands.end())
+    {
+        return;
+    }
+
+    it->second.callbacks.clear();
+    if (it->second.running && it->second.runningOn != std::this_thread::get_id())
+    {
+        mIdle.wait(g, [&]()
+        {
+            auto running = mStrands.find(listener);
+            return running == mStrands.end() || !running->second.running;
+        });
+    }
+}
+
+void ListenerDispatcher::run()
+{
+    std::unique_lock<std::mutex> g(mMutex);
+    for (;;)
+    {
+        mWork.wait(g, [this]() { return mStop || !mReady.empty(); });
+        if (mReady.empty())
+        {
+            // stopping, and nothing left to run
+            return;
+        }
+
+        const void* listener = mReady.front();
+        mReady.pop_front();
+
+        auto it = mStrands.find(listener);
+        if (it == mStrands.end() || it->second.running)
+        {
+            // queued again after a forget(): the running thread takes it from here
+            continue;
+        }
+        if (it->second.callbacks.empty())
+        {
+            // forgotten meanwhile
+            mStrands.erase(it);
+            continue;
+        }
+
+        std::function<void()> f = std::move(it->second.callbacks.front().f);
+        it->second.callbacks.pop_front();
+        it->second.running = true;
+        it->second.runningOn = std::this_thread::get_id();
+
+        g.unlock();
+        f();
+        g.lock();
+
+        // only this thread erases a running strand
+        it = mStrands.find(listener);
+        it->second.running = false;
+        if (it->second.callbacks.empty())
+        {
+            mStrands.erase(it);
+        }
+        else
+        {
+            mReady.push_back(listener);
+            mWork.notify_one();
+        }
+        mIdle.notify_all();
+    }
+}
+
 MegaHashSignatureImpl::MegaHashSignatureImpl(const char *base64Key)
 {
     hashSignature = new HashSignature(new Hash());
@@ -25120,6 +27072,76 @@ void MegaSyncListPrivate::addSync(MegaSync *sync)
         delete [] copyList;
     }
 }
+
+MegaSyncStatsPrivate::MegaSyncStatsPrivate(handle backupId, const SyncStats& stats)
+    : mBackupId(backupId)
+    , mStats(stats)
+{
+}
+
+MegaSyncStats *MegaSyncStatsPrivate::copy() const
+{
+    return new MegaSyncStatsPrivate(*this);
+}
+
+MegaHandle MegaSyncStatsPrivate::getBackupId() const
+{
+    return mBackupId;
+}
+
+long long MegaSyncStatsPrivate::getNotificationsPending() const
+{
+    return static_cast<long long>(mStats.notificationsPending);
+}
+
+long long MegaSyncStatsPrivate::getRetriesPending() const
+{
+    return static_cast<long long>(mStats.retriesPending);
+}
+
+long long MegaSyncStatsPrivate::getStateCachePending() const
+{
+    return static_cast<long long>(mStats.statecacheWritesPending + mStats.statecacheDeletesPending);
+}
+
+long long MegaSyncStatsPrivate::getUploadsPending() const
+{
+    return static_cast<long long>(mStats.uploadsPending);
+}
+
+long long MegaSyncStatsPrivate::getDownloadsPending() const
+{
+    return static_cast<long long>(mStats.downloadsPending);
+}
+
+long long MegaSyncStatsPrivate::getCallCount(int operation) const
+{
+    switch (operation)
+    {
+        case OPERATION_CHECKPATH: return static_cast<long long>(mStats.checkpathCalls);
+        case OPERATION_SYNCDOWN: return static_cast<long long>(mStats.syncdownCalls);
+        case OPERATION_SYNCUP: return static_cast<long long>(mStats.syncupCalls);
+        case OPERATION_STATECACHE: return static_cast<long long>(mStats.cachenodesCalls);
+    }
+    return 0;
+}
+
+long long MegaSyncStatsPrivate::getTimeSpent(int operation) const
+{
+    switch (operation)
+    {
+        case OPERATION_CHECKPATH: return static_cast<long long>(mStats.checkpathTime);
+        case OPERATION_SYNCDOWN: return static_cast<long long>(mStats.syncdownTime);
+        case OPERATION_SYNCUP: return static_cast<long long>(mStats.syncupTime);
+        case OPERATION_STATECACHE: return static_cast<long long>(mStats.cachenodesTime);
+    }
+    return 0;
+}
+
+long long MegaSyncStatsPrivate::getFullRescans() const
+{
+    return static_cast<long long>(mStats.fullRescans);
+}
 #endif
 
 
@@ -25536,6 +27558,7 @@ void MegaRecursiveOperation::onTransferStart(MegaApi *, MegaTransfer *t)
 
     ++transfersStartedCount;
     if (transfersStartedCount == transfersTotalCount &&
+        !mMoreSubtransfersExpected &&
         !transfer->accessCancelToken().isCancelled() &&
         !startedTransferring)
     {
@@ -25612,78 +27635,162 @@ MegaFolderUploadController::~MegaFolderUploadController()
 MegaFolderUploadController::scanFolder_result MegaFolderUploadController::scanFolder(Tree& tree, LocalPath& localPath, uint32_t& foldercount, uint32_t& filecount)
 {
     recursive++;
-    unique_ptr<DirAccess> da(fsaccess->newdiraccess());
-    if (!da->dopen(&localPath, nullptr, false))
+
+    // Folders are listed (and their files fingerprinted) on the ScanService's threads, many at once.
+    // Only this thread touches the Tree: it queues each subfolder as soon as its parent's listing arrives.
+    WAIT_CLASS waiter;
+    ScanService scanService(waiter);
+
+    struct PendingScan
+    {
+        ScanService::RequestPtr request;
+        Tree* tree;
+        LocalPath path;
+        bool fsidChecked;
+    };
+    vector<PendingScan> pending;
+
+    auto queueScan = [&](Tree& t, const LocalPath& path, handle fsid, bool fsidChecked) {
+        pending.push_back(PendingScan{
+            scanService.queueScan(path, fsid, false, map<LocalPath, FSNode>(), t.fsType), &t, path, fsidChecked});
+    };
+
+    handle rootFsid = fsaccess->fsidOf(localPath, false, false);
+    if (rootFsid == UNDEF)
     {
         LOG_err << "Can't open local directory" << localPath;
         recursive--;
         return scanFolder_failed;
     }
 
-    megaApi->fireOnFolderTransferUpdate(transfer, MegaTransfer::STAGE_SCAN, foldercount, 0, filecount, &localPath, nullptr);
-
-    LocalPath localname;
-    nodetype_t dirEntryType;
-    while (da->dnext(localPath, localname, false, &dirEntryType))
+    if (tree.fsType == FS_UNKNOWN)
     {
+        tree.fsType = fsaccess->getlocalfstype(localPath);
+    }
+    queueScan(tree, localPath, rootFsid, true);
 
-        if (isCancelledByFolderTransferToken())
+    scanFolder_result result = scanFolder_succeeded;
+
+    while (!pending.empty())
+    {
+        // requests in flight refer to our waiter, so even when stopping we wait for them to finish
+        if (result == scanFolder_succeeded)
         {
-            LOG_debug << "MegaFolderUploadController::scanFolder thread stopped by cancel token";
-            return scanFolder_cancelled;
+            if (isCancelledByFolderTransferToken())
+            {
+                LOG_debug << "MegaFolderUploadController::scanFolder thread stopped by cancel token";
+                result = scanFolder_cancelled;
+            }
+            else if (mWorkerThreadStopFlag)
+            {
+                LOG_debug << "MegaFolderUploadController::scanFolder thread stopped by flag";
+                result = scanFolder_cancelled;
+            }
         }
-        if (mWorkerThreadStopFlag)
+
+        auto done = std::partition(pending.begin(), pending.end(),
+                                   [](const PendingScan& p) { return !p.request->completed(); });
+
+        if (done == pending.end())
         {
-            LOG_debug << "MegaFolderUploadController::scanFolder thread stopped by flag";
-            return scanFolder_cancelled;
+            waiter.init(10);
+            waiter.wait();
+            continue;
         }
 
-        megaApi->fireOnFolderTransferUpdate(transfer, MegaTransfer::STAGE_SCAN, foldercount, 0, filecount, &localPath, &localname);
+        vector<PendingScan> completed(std::make_move_iterator(done), std::make_move_iterator(pending.end()));
+        pending.erase(done, pending.end());
 
-        ScopedLengthRestore restoreLen(localPath);
-        localPath.appendWithSeparator(localname, false);
-        if (dirEntryType == FILENODE)
+        for (auto& scan : completed)
         {
-            // Do the fingerprinting for uploads on the scan thread, so we don't lock the main mutex for so long
-            FileFingerprint fp;
-            auto fa = fsaccess->newfileaccess();
-            if (fa->fopen(localPath, true, false))
+            if (result != scanFolder_succeeded)
             {
-                fp.genfingerprint(fa.get());
+                break;
             }
 
-            // if we couldn't get the fingerprint, !isvalid and we'll fail the transfer
-            tree.files.emplace_back(localPath, fp);
-
-            filecount += 1;
-        }
-        else if (dirEntryType == FOLDERNODE)
-        {
-            // generate new subtree
-            unique_ptr<Tree> newTreeNode(new Tree);
-            newTreeNode->folderName = localname.toName(*fsaccess);
-            newTreeNode->fsType = fsaccess->getlocalfstype(localPath);
+            // a mount point's directory entry carries the id of the folder underneath
+            if (scan.request->completionResult() == SCAN_FSID_MISMATCH && !scan.fsidChecked)
+            {
+                handle fsid = fsaccess->fsidOf(scan.path, false, false);
+                if (fsid != UNDEF)
+                {
+                    queueScan(*scan.tree, scan.path, fsid, true);
+                    continue;
+                }
+            }
 
-            // generate fresh random key and node attributes
-            MegaClient::putnodes_prepareOneFolder(&newTreeNode->newnode, newTreeNode->folderName, rng, tmpnodecipher, false);
+            if (scan.request->completionResult() != SCAN_SUCCESS)
+            {
+                LOG_err << "Can't open local directory" << scan.path;
+                result = scanFolder_failed;
+                break;
+            }
 
-            // set nodeHandle
-            newTreeNode->newnode.nodehandle = nextUploadId();
-            newTreeNode->newnode.parenthandle = tree.newnode.nodehandle;
+            Tree& t = *scan.tree;
+            megaApi->fireOnFolderTransferUpdate(transfer, MegaTransfer::STAGE_SCAN, foldercount, 0, filecount, &scan.path, nullptr);
 
-            scanFolder_result sr = scanFolder(*newTreeNode, localPath, foldercount, filecount);
-            if (sr != scanFolder_succeeded)
+            for (auto& entry : scan.request->resultNodes())
             {
-                recursive--;
-                return sr;
-            }
-            tree.subtrees.push_back(std::move(newTreeNode));
+                LocalPath entryPath = scan.path;
+                entryPath.appendWithSeparator(entry.localname, false);
 
-            foldercount += 1;
+                if (entry.type == FILENODE)
+                {
+                    // fingerprinted by the scan: if that failed, !isvalid and we'll fail the transfer
+                    t.files.emplace_back(entryPath, entry.fingerprint);
+
+                    filecount += 1;
+                }
+                else if (entry.type == FOLDERNODE)
+                {
+                    // generate new subtree
+                    unique_ptr<Tree> newTreeNode(new Tree);
+                    newTreeNode->folderName = entry.localname.toName(*fsaccess);
+                    newTreeNode->fsType = fsaccess->getlocalfstype(entryPath);
+
+                    // generate fresh random key and node attributes
+                    MegaClient::putnodes_prepareOneFolder(&newTreeNode->newnode, newTreeNode->folderName, rng, tmpnodecipher, false);
+
+                    // set nodeHandle
+                    newTreeNode->newnode.nodehandle = nextUploadId();
+                    newTreeNode->newnode.parenthandle = t.newnode.nodehandle;
+
+                    queueScan(*newTreeNode, entryPath, entry.fsid, false);
+                    t.subtrees.push_back(std::move(newTreeNode));
+
+                    foldercount += 1;
+                }
+            }
         }
     }
+
     recursive--;
-    return scanFolder_succeeded;
+    return result;
+}
+
+bool MegaFolderUploadController::folderBatchFull(const vector<NewNode>& newnodes) const
+{
+    return newnodes.size() >= mFolderBatchSize || mFolderBatchBytes >= MAX_FOLDER_BATCH_BYTES;
+}
+
+void MegaFolderUploadController::adaptFolderBatchSize(size_t sent, std::chrono::milliseconds elapsed)
+{
+    size_t previous = mFolderBatchSize;
+    if (elapsed.count() < FOLDER_BATCH_TARGET_MS / 2 && sent >= mFolderBatchSize)
+    {
+        // a full batch came back quickly: fewer, bigger round trips
+        mFolderBatchSize = std::min(mFolderBatchSize * 2, size_t(MAX_FOLDER_BATCH));
+    }
+    else if (elapsed.count() > FOLDER_BATCH_TARGET_MS * 2)
+    {
+        // keep requests well away from timing out
+        mFolderBatchSize = std::max(mFolderBatchSize / 2, size_t(MIN_FOLDER_BATCH));
+    }
+
+    if (mFolderBatchSize != previous)
+    {
+        LOG_debug << "Folder batch of " << sent << " nodes took " << elapsed.count() << " ms. Batch size now " << mFolderBatchSize;
+    }
 }
 
 MegaFolderUploadController::batchResult MegaFolderUploadController::createNextFolderBatch(Tree& tree, vector<NewNode>& newnodes, bool isBatchRootLevel)
@@ -25700,11 +27807,15 @@ MegaFolderUploadController::batchResult MegaFolderUploadController::createNextFo
         tree.childrenLoaded = true;
     }
 
+    if (newnodes.empty())
+    {
+        mFolderBatchBytes = 0;
+    }
+
     // recurse until we find nodes not yet created
     for (auto& t : tree.subtrees)
     {
-        assert(newnodes.size() <= MAXNODESUPLOAD);
-        if (newnodes.size() >= MAXNODESUPLOAD)
+        if (folderBatchFull(newnodes))
         {
            // avoid iterating through tree structure when a batch has reached the limit of nodes
            break;
@@ -25716,7 +27827,7 @@ MegaFolderUploadController::batchResult MegaFolderUploadController::createNextFo
         }
 
         // if node doesn't exist yet and we haven't exceeded the limit per batch
-        if (!t->megaNode && newnodes.size() < MAXNODESUPLOAD)
+        if (!t->megaNode && !folderBatchFull(newnodes))
         {
             if (isBatchRootLevel)
             {
@@ -25725,6 +27836,7 @@ MegaFolderUploadController::batchResult MegaFolderUploadController::createNextFo
                 assert(tree.megaNode);
                 t->newnode.parenthandle = UNDEF;
             }
+            mFolderBatchBytes += t->newnode.nodekey.size() + (t->newnode.attrstring ? t->newnode.attrstring->size() : 0);
             newnodes.push_back(std::move(t->newnode));
         }
 
@@ -25748,8 +27860,10 @@ MegaFolderUploadController::batchResult MegaFolderUploadController::createNextFo
         // use a weak_ptr in case this operation was cancelled, and 'this' object doesn't exist
         // anymore when the request completes
         weak_ptr<MegaFolderUploadController> weak_this = shared_from_this();
+        size_t batchSize = newnodes.size();
+        auto sent = std::chrono::steady_clock::now();
         megaapiThreadClient()->putnodes(NodeHandle().set6byte(tree.megaNode->getHandle()), UseLocalVersioningFlag, std::move(newnodes), nullptr, megaapiThreadClient()->nextreqtag(), false,
-            [this, weak_this](const Error& e, targettype_t, vector<NewNode>&, bool, int tag)
+            [this, weak_this, batchSize, sent](const Error& e, targettype_t, vector<NewNode>&, bool, int tag)
             {
                 // double check our object still exists on request completion
                 if (!weak_this.lock()) return;
@@ -25763,6 +27877,8 @@ MegaFolderUploadController::batchResult MegaFolderUploadController::createNextFo
                 }
                 else
                 {
+                    adaptFolderBatchSize(batchSize, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - sent));
+
                     // start the next batch, if there are any left (or start transfers, if we are ready)
                     vector<NewNode> newnodes;
 #ifndef NDEBUG
@@ -25941,6 +28057,7 @@ MegaScheduledCopyController::MegaScheduledCopyController(MegaScheduledCopyContro
         this->failedTransfers.push_back(((MegaTransfer *)*it)->copy());
     }
     this->currentHandle = backup->currentHandle;
+    this->previousHandle = backup->previousHandle;
     this->currentBKStartTime = backup->currentBKStartTime;
     this->updateTime = backup->updateTime;
     this->transferredBytes = backup->transferredBytes;
@@ -26376,6 +28493,7 @@ void MegaScheduledCopyController::clearCurrentBackupData()
     }
     this->failedTransfers.clear();
     this->currentHandle = UNDEF;
+    this->previousHandle = UNDEF;
     this->currentBKStartTime = 0;
     this->updateTime = 0;
     this->transferredBytes = 0;
@@ -26408,6 +28526,9 @@ void MegaScheduledCopyController::start(bool skip)
 
     lastbackuptime = (std::max)(lastbackuptime,offsetds+startTime);
 
+    // files unchanged since then are copied from it instead of uploaded
+    previousHandle = getLastCompleteBackup();
+
     megaApi->fireOnBackupStart(this);
 
     MegaNode *parent = megaApi->getNodeByHandle(parenthandle);
@@ -26483,6 +28604,8 @@ void MegaScheduledCopyController::onFolderAvailable(MegaHandle handle)
         if (da->dopen(&localPath, NULL, false))
         {
             FileSystemType fsType = client->fsaccess->getlocalfstype(localPath);
+            std::unique_ptr<MegaNode> previous(getPreviousFolder(localPath));
+            vector<std::pair<MegaHandle, LocalPath>> unchanged;
 
             while (da->dnext(localPath, localname, false))
             {
@@ -26497,12 +28620,20 @@ void MegaScheduledCopyController::onFolderAvailable(MegaHandle handle)
                     string name = localname.toName(*client->fsaccess);
                     if(fa->type == FILENODE)
                     {
-                        pendingTransfers++;
-
                         totalFiles++;
-                        megaApi->startUpload(false, localPath.toPath(false).c_str(),
-                                                            parent, nullptr, nullptr, -1,folderTransferTag, true,
-                                                            nullptr, false, false, fsType, CancelToken(), this);
+
+                        std::unique_ptr<MegaNode> previousFile(previous ? megaApi->getChildNode(previous.get(), name.c_str()) : nullptr);
+                        if (previousFile && previousFile->isFile() && previousFile->getFingerprint())
+                        {
+                            std::unique_ptr<char[]> fingerprint(megaApi->getFingerprint(localPath.toPath(false).c_str()));
+                            if (fingerprint && !strcmp(fingerprint.get(), previousFile->getFingerprint()))
+                            {
+                                unchanged.emplace_back(previousFile->getHandle(), localPath);
+                                continue;
+                            }
+                        }
+
+                        uploadFile(localPath, parent, fsType);
                     }
                     else
                     {
@@ -26521,6 +28652,11 @@ void MegaScheduledCopyController::onFolderAvailable(MegaHandle handle)
                     }
                 }
             }
+
+            if (!unchanged.empty())
+            {
+                copyUnchangedFiles(handle, std::move(unchanged), fsType);
+            }
         }
     }
     else if (state == SCHEDULED_COPY_SKIPPING)
@@ -26538,6 +28674,129 @@ void MegaScheduledCopyController::onFolderAvailable(MegaHandle handle)
     checkCompletion();
 }
 
+handle MegaScheduledCopyController::getLastCompleteBackup()
+{
+    handle last = UNDEF;
+    int64_t lasttime = 0;
+
+    std::unique_ptr<MegaNode> parentNode(megaApi->getNodeByHandle(parenthandle));
+    std::unique_ptr<MegaNodeList> children(parentNode ? megaApi->getChildren(parentNode.get(), MegaApi::ORDER_NONE) : nullptr);
+    for (int i = 0; children && i < children->size(); i++)
+    {
+        MegaNode *childNode = children->get(i);
+        string childname = childNode->getName();
+        const char *backstvalue = childNode->getCustomAttr("BACKST");
+        if (isBackup(childname, backupName) && backstvalue && !strcmp(backstvalue, "COMPLETE"))
+        {
+            int64_t timeofbackup = getTimeOfBackup(childname);
+            if (timeofbackup > lasttime)
+            {
+                lasttime = timeofbackup;
+                last = childNode->getHandle();
+            }
+        }
+    }
+    return last;
+}
+
+MegaNode* MegaScheduledCopyController::getPreviousFolder(const LocalPath& localPath)
+{
+    size_t index = 0;
+    if (previousHandle == UNDEF || !LocalPath::fromAbsolutePath(basepath).isContainingPathOf(localPath, &index))
+    {
+        return nullptr;
+    }
+
+    // the same relative path, in the previous backup
+    std::unique_ptr<MegaNode> folder(megaApi->getNodeByHandle(previousHandle));
+    LocalPath component;
+    while (folder && localPath.nextPathComponent(index, component))
+    {
+        folder.reset(megaApi->getChildNode(folder.get(), component.toName(*client->fsaccess).c_str()));
+        if (folder && !folder->isFolder())
+        {
+            folder.reset();
+        }
+    }
+    return folder.release();
+}
+
+void MegaScheduledCopyController::uploadFile(const LocalPath& localPath, MegaNode* parent, FileSystemType fsType)
+{
+    pendingTransfers++;
+    megaApi->startUpload(false, localPath.toPath(false).c_str(),
+                         parent, nullptr, nullptr, -1,folderTransferTag, true,
+                         nullptr, false, false, fsType, CancelToken(), this);
+}
+
+void MegaScheduledCopyController::copyUnchangedFiles(handle parent, vector<std::pair<handle, LocalPath>>&& files, FileSystemType fsType)
+{
+    LOG_debug << "Copying " << files.size() << " unchanged files from the previous backup";
+
+    // all of them in a single putnodes, from the SDK thread
+    pendingTransfers++;
+    auto sharedFiles = std::make_shared<vector<std::pair<handle, LocalPath>>>(std::move(files));
+    megaApi->executeOnThread(std::make_shared<ExecuteOnce>([this, parent, sharedFiles, fsType]()
+    {
+        TreeProcCopy tc;
+        vector<Node*> nodes;
+        for (auto& file : *sharedFiles)
+        {
+            Node* n = client->nodebyhandle(file.first);
+            if (n && n->type == FILENODE && n->nodekey().size() && !n->attrstring)
+            {
+                nodes.push_back(n);
+                client->proctree(n, &tc, false, true);
+            }
+        }
+        tc.allocnodes();
+        for (Node* n : nodes)
+        {
+            client->proctree(n, &tc, false, true);
+        }
+        for (NewNode& nn : tc.nn)
+        {
+            nn.parenthandle = UNDEF;
+        }
+
+        auto done = [this, parent, sharedFiles, fsType](error e)
+        {
+            pendingTransfers--;
+            if (e == API_OK)
+            {
+                numberFiles += static_cast<long long>(sharedFiles->size());
+            }
+            else
+            {
+                // whatever could not be copied is uploaded as usual
+                LOG_warn << "Unable to copy unchanged files from the previous backup (" << e << "). Uploading them";
+                std::unique_ptr<MegaNode> parentNode(megaApi->getNodeByHandle(parent));
+                for (auto& file : *sharedFiles)
+                {
+                    if (parentNode)
+                    {
+                        uploadFile(file.second, parentNode.get(), fsType);
+                    }
+                }
+            }
+            megaApi->fireOnBackupUpdate(this);
+            checkCompletion();
+        };
+
+        if (nodes.size() != sharedFiles->size())
+        {
+            done(API_ENOENT);
+            return;
+        }
+
+        client->putnodes(NodeHandle().set6byte(parent), UseLocalVersioningFlag, std::move(tc.nn), nullptr, client->nextreqtag(), false,
+            [done](const Error& e, targettype_t, vector<NewNode>&, bool, int)
+            {
+                done(e);
+            });
+    }), false);
+}
+
 bool MegaScheduledCopyController::checkCompletion()
 {
     if(!recursive && !pendingFolders.size() && !pendingTransfers && !pendingTags)
@@ -27019,12 +29278,27 @@ void MegaFolderDownloadController::start(MegaNode *node)
     }
 
     notifyStage(MegaTransfer::STAGE_SCAN);
-    // for download scan is just checking nodes, we can do this all in one quick pass
-    unsigned fileAddedCount = 0;
-    scanFolder_result sr = scanFolder(node, path, fsType, fileAddedCount);
+
+    scanFolder_result sr;
+    mBatchSize = size_t(megaApi->mFolderDownloadBatchSize.load());
+
+    if (mBatchSize)
+    {
+        // streaming: explore a batch, and the rest as the earlier batches are already downloading
+        mPendingFolders.push_back(PendingFolder{unique_ptr<MegaNode>(node->copy()), path});
+        mMoreSubtransfersExpected = true;
+        sr = expandNextBatch(fsType);
+    }
+    else
+    {
+        // for download scan is just checking nodes, we can do this all in one quick pass
+        sr = scanFolder(node, path, fsType, mFileAddedCount);
+    }
 
     if (sr != scanFolder_succeeded)
     {
+        mMoreSubtransfersExpected = false;
+
         if (sr == scanFolder_cancelled)
         {
             complete(API_EINCOMPLETE, true);
@@ -27036,61 +29310,205 @@ void MegaFolderDownloadController::start(MegaNode *node)
     }
     else
     {
-        // it's mandatory to notify stage change from MegaApiImpl's thread to avoid deadlocks and other issues
-        notifyStage(MegaTransfer::STAGE_CREATE_TREE);
+        startBatch(fsType);
+    }
+}
 
-        // start worker thread to create local folder tree
-        mWorkerThread = std::thread([this, fsType](){
+void MegaFolderDownloadController::startBatch(FileSystemType fsType)
+{
+    assert(mMainThreadId == std::this_thread::get_id());
+
+    // it's mandatory to notify stage change from MegaApiImpl's thread to avoid deadlocks and other issues
+    notifyStage(MegaTransfer::STAGE_CREATE_TREE);
 
-            // local folder creation runs on the download worker thread (and checks the cancelled flag)
-            Error e = createFolder();
+    // start worker thread to create local folder tree
+    mWorkerThread = std::thread([this, fsType](){
 
-            // the thread always queues a function to execute on MegaApi thread for onFinish()
-            // we keep a pointer to it in case we need to cancel()
-            mCompletionForMegaApiThread.reset(new ExecuteOnce([this, fsType, e]() {
+        // local folder creation runs on the download worker thread (and checks the cancelled flag)
+        Error e = createFolder();
 
-                // these next parts must run on MegaApiImpl's thread again, as
-                // genUploadTransfersForFiles or checkCompletion may call the fireOnXYZ() functions
-                assert(mMainThreadId == std::this_thread::get_id());
+        // the thread always queues a function to execute on MegaApi thread for onFinish()
+        // we keep a pointer to it in case we need to cancel()
+        mCompletionForMegaApiThread.reset(new ExecuteOnce([this, fsType, e]() {
 
-                // make sure the thread is joined.  This lets us add error-catching asserts elsewhere.
-                if (mWorkerThread.joinable())
+            // these next parts must run on MegaApiImpl's thread again, as
+            // genUploadTransfersForFiles or checkCompletion may call the fireOnXYZ() functions
+            assert(mMainThreadId == std::this_thread::get_id());
+
+            // make sure the thread is joined.  This lets us add error-catching asserts elsewhere.
+            if (mWorkerThread.joinable())
+            {
+                mWorkerThread.join();
+            }
+
+            if (mBatchSize)
+            {
+                if (e)
                 {
-                    mWorkerThread.join();
+                    endBatches(e, false);
+                    return;
                 }
 
-                if (e)
+                // downloadFiles must run on the megaApi thread, as it may call fireOnTransferXYZ()
+                TransferQueue transferQueue;
+                if (!genDownloadTransfersForFiles(fsType, transferQueue))
                 {
-                    complete(e);
+                    endBatches(API_EINCOMPLETE, true);
+                    return;
                 }
-                else
+
+                // gather the next batch while this one downloads
+                mLocalTree.clear();
+                scanFolder_result sr = expandNextBatch(fsType);
+                bool last = sr == scanFolder_succeeded && mLocalTree.empty();
+
+                // on failure, endBatches() below still needs this object
+                mMoreSubtransfersExpected = !last;
+
+                if (!transferQueue.empty())
                 {
-                    // downloadFiles must run on the megaApi thread, as it may call fireOnTransferXYZ()
-                    TransferQueue transferQueue;
-                    if (!genDownloadTransfersForFiles(fsType, transferQueue))
-                    {
-                        complete(API_EINCOMPLETE, true);
-                    }
-                    else if (transferQueue.empty())
+                    transfersTotalCount += transferQueue.size();
+                    megaApi->sendPendingTransfers(&transferQueue, this);
+
+                    // with the last batch sent, this object may now be deleted
+                    if (last)
                     {
-                        complete(API_OK);
+                        return;
                     }
-                    else
-                    {
-                        // once we call sendPendingTransfers, we are guaranteed start/finish callbacks for each file transfer
-                        // the last callback of onFinish for one of these will also complete and destroy this MegaFolderUploadController
-                        transfersTotalCount = transferQueue.size();
-                        megaApi->sendPendingTransfers(&transferQueue, this);
-                        // no further code can be added here, this object may now be deleted (eg, due to cancel token activation)
+                }
 
-                        // complete() will finally be called when the last sub-transfer finishes
-                    }
+                if (sr != scanFolder_succeeded)
+                {
+                    endBatches(sr == scanFolder_cancelled ? API_EINCOMPLETE : API_EINTERNAL, sr == scanFolder_cancelled);
                 }
-            }));
+                else if (last)
+                {
+                    endBatches(API_OK, false);
+                }
+                else
+                {
+                    startBatch(fsType);
+                }
+            }
+            else if (e)
+            {
+                complete(e);
+            }
+            else
+            {
+                // downloadFiles must run on the megaApi thread, as it may call fireOnTransferXYZ()
+                TransferQueue transferQueue;
+                if (!genDownloadTransfersForFiles(fsType, transferQueue))
+                {
+                    complete(API_EINCOMPLETE, true);
+                }
+                else if (transferQueue.empty())
+                {
+                    complete(API_OK);
+                }
+                else
+                {
+                    // once we call sendPendingTransfers, we are guaranteed start/finish callbacks for each file transfer
+                    // the last callback of onFinish for one of these will also complete and destroy this MegaFolderUploadController
+                    transfersTotalCount = transferQueue.size();
+                    megaApi->sendPendingTransfers(&transferQueue, this);
+                    // no further code can be added here, this object may now be deleted (eg, due to cancel token activation)
 
-            // Queue that function.
-            megaApi->executeOnThread(mCompletionForMegaApiThread);
-        });
+                    // complete() will finally be called when the last sub-transfer finishes
+                }
+            }
+        }));
+
+        // Queue that function.
+        megaApi->executeOnThread(mCompletionForMegaApiThread);
+    });
+}
+
+MegaFolderDownloadController::scanFolder_result MegaFolderDownloadController::expandNextBatch(FileSystemType fsType)
+{
+    assert(mMainThreadId == std::this_thread::get_id());
+
+    size_t gathered = 0;
+
+    while (!mPendingFolders.empty() && gathered < mBatchSize)
+    {
+        if (isCancelledByFolderTransferToken())
+        {
+            return scanFolder_cancelled;
+        }
+
+        PendingFolder folder = std::move(mPendingFolders.back());
+        mPendingFolders.pop_back();
+
+        // parents are always explored (and so created) before their subfolders
+        mLocalTree.emplace_back(LocalTree(folder.localPath));
+        size_t index = mLocalTree.size() - 1;
+
+        megaApi->fireOnFolderTransferUpdate(transfer, MegaTransfer::STAGE_SCAN, unsigned(mLocalTree.size()), 0, mFileAddedCount, &folder.localPath, nullptr);
+
+        MegaNodeList *children = nullptr;
+        unique_ptr<MegaNodeList> autoDelChildren;
+        if (folder.node->isForeign())
+        {
+            children = folder.node->getChildren();
+        }
+        else
+        {
+            children = megaApi->getChildren(folder.node.get(), MegaApi::ORDER_NONE);
+            autoDelChildren.reset(children);
+        }
+
+        if (!children)
+        {
+            LOG_err << "Child nodes not found: " << folder.localPath;
+            return scanFolder_failed;
+        }
+
+        for (int i = 0; i < children->size(); i++)
+        {
+            MegaNode *child = children->get(i);
+            if (child->getType() == MegaNode::TYPE_FILE)
+            {
+                mLocalTree.at(index).childrenNodes.emplace_back(child->copy());
+                mFileAddedCount += 1;
+            }
+            else
+            {
+                LocalPath childPath = folder.localPath;
+                childPath.appendWithSeparator(LocalPath::fromRelativeName(child->getName(), *fsaccess, fsType), true);
+                mPendingFolders.push_back(PendingFolder{unique_ptr<MegaNode>(child->copy()), std::move(childPath)});
+            }
+        }
+
+        gathered += size_t(children->size()) + 1;
+    }
+
+    return scanFolder_succeeded;
+}
+
+void MegaFolderDownloadController::endBatches(Error e, bool cancelledByUser)
+{
+    assert(mMainThreadId == std::this_thread::get_id());
+
+    mMoreSubtransfersExpected = false;
+    mPendingFolders.clear();
+    mLocalTree.clear();
+
+    if (allSubtransfersResolved())
+    {
+        if (!e && mIncompleteTransfers)
+        {
+            e = API_EINCOMPLETE;
+        }
+        complete(e, cancelledByUser);
+        return;
+    }
+
+    // the downloads already sent complete this transfer when they finish
+    if (e && !cancelledByUser)
+    {
+        LOG_err << "Folder download stopped exploring the folder: " << e;
+        transfer->accessCancelToken().cancel();
     }
 }
 
@@ -27230,7 +29648,346 @@ bool MegaFolderDownloadController::genDownloadTransfersForFiles(FileSystemType f
     return true;
 }
 
+FileAttributeCache::FileAttributeCache(const LocalPath& folder, m_off_t maxSize)
+    : mFolder(folder)
+    , mMaxSize(maxSize)
+{
+}
+
+bool FileAttributeCache::init()
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    if (!mFsAccess.mkdirlocal(mFolder, false, false) && !mFsAccess.target_exists)
+    {
+        return false;
+    }
+
+    mEntries.clear();
+    mLru.clear();
+    mSize = 0;
+
+    // index the attributes of previous sessions, the oldest ones first
+    LocalPath folder = mFolder;
+    LocalPath name;
+    nodetype_t type;
+    auto da = mFsAccess.newdiraccess();
+    if (!da->dopen(&folder, nullptr, false))
+    {
+        return false;
+    }
+
+    std::multimap<m_time_t, pair<handle, m_off_t>> found;
+    while (da->dnext(folder, name, false, &type))
+    {
+        handle fah = UNDEF;
+        LocalPath file = mFolder;
+        file.appendWithSeparator(name, false);
+        auto fa = mFsAccess.newfileaccess();
+        if (type != FILENODE
+                || Base64::atob(name.toPath(false).c_str(), (byte*)&fah, sizeof(fah)) != sizeof(fah)
+                || !fa->fopen(file, true, false))
+        {
+            continue;
+        }
+        found.emplace(fa->mtime, std::make_pair(fah, fa->size));
+    }
+
+    for (auto& f : found)
+    {
+        add(f.second.first, f.second.second);
+    }
+    return true;
+}
+
+LocalPath FileAttributeCache::pathOf(handle fah) const
+{
+    char name[12];
+    Base64::btoa((const byte*)&fah, sizeof(fah), name);
+
+    LocalPath path = mFolder;
+    path.appendWithSeparator(LocalPath::fromRelativePath(name), false);
+    return path;
+}
+
+void FileAttributeCache::add(handle fah, m_off_t size)
+{
+    drop(fah);
+
+    // make room, the least recently used first
+    while (mSize + size > mMaxSize && !mLru.empty())
+    {
+        drop(mLru.back());
+    }
+
+    mLru.push_front(fah);
+    Entry& entry = mEntries[fah];
+    entry.size = size;
+    entry.lru = mLru.begin();
+    mSize += size;
+}
+
+void FileAttributeCache::drop(handle fah)
+{
+    auto it = mEntries.find(fah);
+    if (it == mEntries.end())
+    {
+        return;
+    }
+
+    mFsAccess.unlinklocal(pathOf(fah));
+    mSize -= it->second.size;
+    mLru.erase(it->second.lru);
+    mEntries.erase(it);
+}
+
+bool FileAttributeCache::copyTo(handle fah, const LocalPath& destination)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    auto it = mEntries.find(fah);
+    if (it == mEntries.end())
+    {
+        return false;
+    }
+
+    string data;
+    auto fa = mFsAccess.newfileaccess();
+    if (!fa->fopen(pathOf(fah), true, false) || !fa->fread(&data, unsigned(fa->size), 0, 0))
+    {
+        LOG_warn << "Unable to read the cached file attribute " << toHandle(fah);
+        drop(fah);
+        return false;
+    }
+    fa.reset();
+
+    mLru.splice(mLru.begin(), mLru, it->second.lru);
+
+    mFsAccess.unlinklocal(destination);
+    fa = mFsAccess.newfileaccess();
+    return fa->fopen(destination, false, true) && fa->fwrite((const byte*)data.data(), unsigned(data.size()), 0);
+}
+
+void FileAttributeCache::write(handle fah, const char* data, size_t len)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    if (!len || m_off_t(len) > mMaxSize)
+    {
+        return;
+    }
+
+    add(fah, m_off_t(len));
+
+    auto fa = mFsAccess.newfileaccess();
+    if (!fa->fopen(pathOf(fah), false, true) || !fa->fwrite((const byte*)data, unsigned(len), 0))
+    {
+        LOG_warn << "Unable to write the file attribute to the cache: " << toHandle(fah);
+        drop(fah);
+    }
+}
+
 #ifdef HAVE_LIBUV
+StreamingCache::StreamingCache(const LocalPath& folder, m_off_t maxSize)
+    : mFolder(folder)
+    , mMaxSize(maxSize)
+{
+}
+
+bool StreamingCache::init()
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    if (!mFsAccess.mkdirlocal(mFolder, false, false) && !mFsAccess.target_exists)
+    {
+        return false;
+    }
+
+    // the ranges of the files left by a previous cache are unknown
+    LocalPath folder = mFolder;
+    LocalPath name;
+    nodetype_t type;
+    auto da = mFsAccess.newdiraccess();
+    if (!da->dopen(&folder, nullptr, false))
+    {
+        return false;
+    }
+    while (da->dnext(folder, name, false, &type))
+    {
+        if (type == FILENODE)
+        {
+            LocalPath file = mFolder;
+            file.appendWithSeparator(name, false);
+            mFsAccess.unlinklocal(file);
+        }
+    }
+
+    mEntries.clear();
+    mLru.clear();
+    mSize = 0;
+    return true;
+}
+
+LocalPath StreamingCache::pathOf(MegaHandle h) const
+{
+    LocalPath path = mFolder;
+    path.appendWithSeparator(LocalPath::fromRelativePath(std::to_string(h)), false);
+    return path;
+}
+
+StreamingCache::Entry& StreamingCache::touch(MegaHandle h)
+{
+    auto it = mEntries.find(h);
+    if (it == mEntries.end())
+    {
+        it = mEntries.emplace(h, Entry()).first;
+        mLru.push_front(h);
+        it->second.lru = mLru.begin();
+    }
+    else
+    {
+        mLru.splice(mLru.begin(), mLru, it->second.lru);
+    }
+    return it->second;
+}
+
+void StreamingCache::drop(MegaHandle h)
+{
+    auto it = mEntries.find(h);
+    if (it == mEntries.end())
+    {
+        return;
+    }
+
+    mFsAccess.unlinklocal(pathOf(h));
+    mSize -= it->second.size;
+    mLru.erase(it->second.lru);
+    mEntries.erase(it);
+}
+
+size_t StreamingCache::read(MegaHandle h, m_off_t pos, char* buf, size_t len)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    auto it = mEntries.find(h);
+    if (it == mEntries.end())
+    {
+        return 0;
+    }
+
+    // the range holding 'pos', if any
+    auto& ranges = it->second.ranges;
+    auto range = ranges.upper_bound(pos);
+    if (range == ranges.begin() || (--range)->second <= pos)
+    {
+        return 0;
+    }
+
+    len = static_cast<size_t>(std::min<m_off_t>(len, range->second - pos));
+    auto fa = mFsAccess.newfileaccess();
+    if (!fa->fopen(pathOf(h), true, false) || !fa->frawread((byte*)buf, unsigned(len), pos, true))
+    {
+        LOG_warn << "[Streaming] Unable to read from the cache: " << toHandle(h);
+        drop(h);
+        return 0;
+    }
+
+    touch(h);
+    return len;
+}
+
+void StreamingCache::write(MegaHandle h, m_off_t pos, const char* buf, size_t len)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    if (!len || m_off_t(len) > mMaxSize)
+    {
+        return;
+    }
+
+    // make room, the least recently used first
+    while (mSize + m_off_t(len) > mMaxSize)
+    {
+        auto victim = std::find_if(mLru.rbegin(), mLru.rend(), [h](MegaHandle other) { return other != h; });
+        if (victim == mLru.rend())
+        {
+            break;
+        }
+        drop(*victim);
+    }
+    if (mSize + m_off_t(len) > mMaxSize)
+    {
+        return;     // this node takes it all already: keep what it has
+    }
+
+    auto fa = mFsAccess.newfileaccess();
+    if (!fa->fopen(pathOf(h), false, true) || !fa->fwrite((const byte*)buf, unsigned(len), pos))
+    {
+        LOG_warn << "[Streaming] Unable to write to the cache: " << toHandle(h);
+        drop(h);
+        return;
+    }
+
+    // merge [pos, pos + len) with the ranges it overlaps or touches
+    Entry& entry = touch(h);
+    m_off_t start = pos;
+    m_off_t end = pos + m_off_t(len);
+    auto it = entry.ranges.upper_bound(start);
+    if (it != entry.ranges.begin() && std::prev(it)->second >= start)
+    {
+        --it;
+    }
+    while (it != entry.ranges.end() && it->first <= end)
+    {
+        start = std::min(start, it->first);
+        end = std::max(end, it->second);
+        entry.size -= it->second - it->first;
+        mSize -= it->second - it->first;
+        it = entry.ranges.erase(it);
+    }
+    entry.ranges[start] = end;
+    entry.size += end - start;
+    mSize += end - start;
+}
+
+m_off_t StreamingCache::nextCached(MegaHandle h, m_off_t pos)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    auto it = mEntries.find(h);
+    if (it == mEntries.end())
+    {
+        return -1;
+    }
+
+    auto range = it->second.ranges.upper_bound(pos);
+    return range == it->second.ranges.end() ? -1 : range->first;
+}
+
+bool StreamingCache::cachedFile(MegaHandle h, m_off_t start, m_off_t end, LocalPath& path)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    auto it = mEntries.find(h);
+    if (it == mEntries.end())
+    {
+        return false;
+    }
+
+    auto& ranges = it->second.ranges;
+    auto range = ranges.upper_bound(start);
+    if (range == ranges.begin() || (--range)->second < end)
+    {
+        return false;
+    }
+
+    // the most recently used is the last to be evicted
+    touch(h);
+    path = pathOf(h);
+    return true;
+}
+
+m_off_t StreamingCache::cachedSize()
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    return mSize;
+}
+
+std::atomic<size_t> StreamingBuffer::sTotalAllocated(0);
+std::atomic<size_t> StreamingBuffer::sTotalBuffers(0);
+
 StreamingBuffer::StreamingBuffer()
 {
     this->capacity = 0;
@@ -27241,19 +29998,81 @@ StreamingBuffer::StreamingBuffer()
     this->free = 0;
     this->maxBufferSize = MAX_BUFFER_SIZE;
     this->maxOutputSize = MAX_OUTPUT_SIZE;
+    this->adaptiveBufferSize = false;
+    this->adaptiveOutputSize = false;
+    this->requestedCapacity = 0;
+    this->receivedBytes = 0;
     this->fileSize = 0;
     this->duration = 0;
 }
 
 StreamingBuffer::~StreamingBuffer()
 {
-    delete [] buffer;
+    release();
+}
+
+size_t StreamingBuffer::totalAllocated()
+{
+    return sTotalAllocated;
+}
+
+size_t StreamingBuffer::totalBuffers()
+{
+    return sTotalBuffers;
+}
+
+void StreamingBuffer::release()
+{
+    if (buffer)
+    {
+        sTotalAllocated -= capacity;
+        sTotalBuffers--;
+        delete [] buffer;
+        buffer = NULL;
+    }
+    capacity = 0;
+}
+
+void StreamingBuffer::allocate(size_t capacity)
+{
+    release();
+
+    if (adaptiveBufferSize && capacity > MAX_BUFFER_SIZE)
+    {
+        // buffers over the default size only take what is left in the global budget
+        size_t allocated = sTotalAllocated;
+        size_t available = allocated < MAX_TOTAL_BUFFER_SIZE ? MAX_TOTAL_BUFFER_SIZE - allocated : 0;
+        if (capacity > available)
+        {
+            LOG_debug << "[Streaming] Limiting capacity to the memory left for streaming: " << available << " bytes";
+            capacity = std::max<size_t>(available, MAX_BUFFER_SIZE);
+        }
+    }
+
+    sTotalAllocated += capacity;
+    sTotalBuffers++;
+    this->capacity = capacity;
+    this->buffer = new char[this->capacity];
+    this->inpos = 0;
+    this->outpos = 0;
+    this->size = 0;
+    this->free = this->capacity;
+
+    if (adaptiveOutputSize)
+    {
+        this->maxOutputSize = std::max<size_t>(MAX_OUTPUT_SIZE, this->capacity / 10);
+    }
 }
 
 void StreamingBuffer::init(size_t capacity)
 {
     assert(this->fileSize > 0);
     assert(capacity > 0);
+    requestedCapacity = capacity;
+    receivedBytes = 0;
+    receiveStart = std::chrono::steady_clock::now();
+
+    size_t maxBufferSize = targetCapacity();
     if (capacity > maxBufferSize)
     {
         LOG_warn << "[Streaming] Truncating requested capacity due to being greater than maxBufferSize. "
@@ -27275,12 +30094,31 @@ void StreamingBuffer::init(size_t capacity)
                  << "]";
     }
 
-    this->capacity = static_cast<unsigned>(capacity);
-    this->buffer = new char[this->capacity];
-    this->inpos = 0;
-    this->outpos = 0;
-    this->size = 0;
-    this->free = this->capacity;
+    allocate(capacity);
+}
+
+m_off_t StreamingBuffer::getThroughput() const
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - receiveStart).count();
+    if (elapsed < 1000)
+    {
+        // too early to have a meaningful value
+        return 0;
+    }
+    return receivedBytes * 1000 / elapsed;
+}
+
+size_t StreamingBuffer::targetCapacity() const
+{
+    if (!adaptiveBufferSize)
+    {
+        return maxBufferSize;
+    }
+
+    // keep some seconds of playback, or of download if the connection is faster than the bitrate
+    m_off_t rate = std::max(getBytesPerSecond(), getThroughput());
+    m_off_t target = rate * BUFFERED_SECONDS;
+    return static_cast<size_t>(std::min<m_off_t>(std::max<m_off_t>(target, MAX_BUFFER_SIZE), MAX_ADAPTIVE_BUFFER_SIZE));
 }
 
 size_t StreamingBuffer::append(const char *buf, size_t len)
@@ -27290,6 +30128,17 @@ size_t StreamingBuffer::append(const char *buf, size_t len)
         // initialize the buffer if it's not initialized yet
         init(len);
     }
+    else if (adaptiveBufferSize && !size && free == capacity && capacity < requestedCapacity)
+    {
+        // the consumer drained everything: grow if the throughput allows more read-ahead
+        size_t target = std::min(targetCapacity(), requestedCapacity);
+        if (target > capacity)
+        {
+            LOG_debug << "[Streaming] Growing buffer from " << capacity << " to " << target << " bytes";
+            allocate(target);
+        }
+    }
+    receivedBytes += len;
 
     if (free < len)
     {
@@ -27371,6 +30220,7 @@ void StreamingBuffer::freeData(size_t len)
 
 void StreamingBuffer::setMaxBufferSize(unsigned int bufferSize)
 {
+    this->adaptiveBufferSize = !bufferSize;
     if (bufferSize)
     {
         this->maxBufferSize = bufferSize;
@@ -27383,6 +30233,7 @@ void StreamingBuffer::setMaxBufferSize(unsigned int bufferSize)
 
 void StreamingBuffer::setMaxOutputSize(unsigned int outputSize)
 {
+    this->adaptiveOutputSize = !outputSize;
     if (outputSize)
     {
         this->maxOutputSize = outputSize;
@@ -27467,6 +30318,8 @@ MegaTCPServer::MegaTCPServer(MegaApiImpl *megaApi, string basePath, bool tls, st
     this->lastHandle = INVALID_HANDLE;
     this->remainingcloseevents = 0;
     this->closing = false;
+    this->eventLoops = 1;
+    this->kernelTls = false;
     this->thread = new MegaThread();
 #ifdef ENABLE_EVT_TLS
     this->certificatepath = certificatepath;
@@ -27583,16 +30436,27 @@ void MegaTCPServer::run()
             return;
         }
         evt_ctx_set_nio(&evtctx, NULL, uv_tls_writer);
+        if (kernelTls && !evt_ctx_prepare_ktls(&evtctx))
+        {
+            LOG_warn << "Kernel TLS is not supported in this build";
+        }
     }
 #endif
 
     uv_loop_init(&uv_loop);
+    uv_loop.data = NULL; // connections of the main loop don't belong to a MegaTCPLoop
 
     uv_async_init(&uv_loop, &exit_handle, onCloseRequested);
     exit_handle.data = this;
 
-    uv_tcp_init(&uv_loop, &server);
+    // the socket must exist before binding to allow other loops to share the port
+    uv_tcp_init_ex(&uv_loop, &server, useIPv6 ? AF_INET6 : AF_INET);
     server.data = this;
+    bool reusePort = eventLoops > 1 && enableReusePort(&server);
+    if (eventLoops > 1 && !reusePort)
+    {
+        LOG_warn << "Unable to share port " << port << " between event loops. Using only one";
+    }
 
     uv_tcp_keepalive(&server, 0, 0);
 
@@ -27653,6 +30517,10 @@ void MegaTCPServer::run()
     }
 
     LOG_info << "TCP" << (useTLS ? "(tls)" : "") << " server started on port " << port;
+    if (reusePort)
+    {
+        startExtraLoops((const struct sockaddr*)&address, onNewClientCB);
+    }
     started = true;
     uv_sem_post(&semaphoreStartup);
 
@@ -27688,10 +30556,15 @@ void MegaTCPServer::initializeAndStartListening()
         }
         evtrequirescleaning = true;
         evt_ctx_set_nio(&evtctx, NULL, uv_tls_writer);
+        if (kernelTls && !evt_ctx_prepare_ktls(&evtctx))
+        {
+            LOG_warn << "Kernel TLS is not supported in this build";
+        }
     }
 #endif
 
     uv_loop_init(&uv_loop);
+    uv_loop.data = NULL;
 
     uv_async_init(&uv_loop, &exit_handle, onCloseRequested);
     exit_handle.data = this;
@@ -27769,6 +30642,7 @@ void MegaTCPServer::stop(bool doNotWait)
     }
 
     LOG_debug << "Stopping MegaTCPServer port = " << port;
+    stopExtraLoops();
     uv_async_send(&exit_handle);
     if (!doNotWait)
     {
@@ -27819,6 +30693,137 @@ int MegaTCPServer::getMaxOutputSize()
     return StreamingBuffer::MAX_OUTPUT_SIZE;
 }
 
+int MegaTCPServer::getMaxBufferSizeSetting()
+{
+    return maxBufferSize;
+}
+
+int MegaTCPServer::getMaxOutputSizeSetting()
+{
+    return maxOutputSize;
+}
+
+void MegaTCPServer::setEventLoops(int loops)
+{
+    this->eventLoops = loops < 1 ? 1 : loops;
+}
+
+int MegaTCPServer::getEventLoops()
+{
+    return eventLoops;
+}
+
+void MegaTCPServer::setKernelTls(bool enable)
+{
+    kernelTls = enable;
+}
+
+bool MegaTCPServer::isKernelTls()
+{
+    return kernelTls;
+}
+
+bool MegaTCPServer::enableReusePort(uv_tcp_t *handle)
+{
+#ifdef SO_REUSEPORT
+    uv_os_fd_t fd;
+    if (uv_fileno((uv_handle_t*)handle, &fd))
+    {
+        return false;
+    }
+
+    int on = 1;
+    return !setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+#else
+    return false;
+#endif
+}
+
+void MegaTCPServer::startExtraLoops(const struct sockaddr *address, uv_connection_cb onNewClientCB)
+{
+    for (int i = 1; i < eventLoops; i++)
+    {
+        std::unique_ptr<MegaTCPLoop> loop = ::mega::make_unique<MegaTCPLoop>();
+        loop->server = this;
+        uv_loop_init(&loop->uv_loop);
+        loop->uv_loop.data = loop.get();
+
+        uv_async_init(&loop->uv_loop, &loop->exit_handle, onLoopCloseRequested);
+        loop->exit_handle.data = loop.get();
+
+        uv_tcp_init_ex(&loop->uv_loop, &loop->listener, address->sa_family);
+        loop->listener.data = this;
+
+        if (!enableReusePort(&loop->listener)
+            || uv_tcp_bind(&loop->listener, address, 0)
+            || uv_listen((uv_stream_t*)&loop->listener, 32, onNewClientCB))
+        {
+            LOG_warn << "Unable to start event loop " << i << " on port " << port;
+            uv_close((uv_handle_t *)&loop->exit_handle, NULL);
+            uv_close((uv_handle_t *)&loop->listener, NULL);
+            uv_run(&loop->uv_loop, UV_RUN_DEFAULT); // so that resources are cleaned peacefully
+            uv_loop_close(&loop->uv_loop);
+            break;
+        }
+
+        loop->thread.start(loopEntryPoint, loop.get());
+        extraLoops.push_back(std::move(loop));
+    }
+
+    LOG_info << "TCP server on port " << port << " running " << (extraLoops.size() + 1) << " event loops";
+}
+
+void MegaTCPServer::stopExtraLoops()
+{
+    for (auto& loop : extraLoops)
+    {
+        uv_async_send(&loop->exit_handle);
+        loop->thread.join();
+        uv_loop_close(&loop->uv_loop);
+    }
+    extraLoops.clear();
+}
+
+void *MegaTCPServer::loopEntryPoint(void *param)
+{
+#ifndef _WIN32
+    struct sigaction noaction;
+    memset(&noaction, 0, sizeof(noaction));
+    noaction.sa_handler = SIG_IGN;
+    ::sigaction(SIGPIPE, &noaction, 0);
+#endif
+
+    MegaTCPLoop *loop = (MegaTCPLoop *)param;
+    uv_run(&loop->uv_loop, UV_RUN_DEFAULT);
+    LOG_debug << "Extra UV loop thread exit";
+    return NULL;
+}
+
+void MegaTCPServer::onLoopCloseRequested(uv_async_t *handle)
+{
+    MegaTCPLoop *loop = (MegaTCPLoop*) handle->data;
+    LOG_debug << "TCP server event loop stopping port=" << loop->server->port;
+
+    for (MegaTCPContext *tcpctx : loop->connections)
+    {
+        closeTCPConnection(tcpctx);
+    }
+
+    // the loop ends when all its handles are closed
+    uv_close((uv_handle_t *)&loop->listener, NULL);
+    uv_close((uv_handle_t *)&loop->exit_handle, NULL);
+}
+
+list<MegaTCPContext*>& MegaTCPServer::connectionsOf(MegaTCPContext *tcpctx)
+{
+    return tcpctx->loop ? tcpctx->loop->connections : tcpctx->server->connections;
+}
+
+int& MegaTCPServer::closeEventsOf(MegaTCPContext *tcpctx)
+{
+    return tcpctx->loop ? tcpctx->loop->remainingcloseevents : tcpctx->server->remainingcloseevents;
+}
+
 void MegaTCPServer::setRestrictedMode(int mode)
 {
     this->restrictedMode = mode;
@@ -27966,6 +30971,16 @@ void MegaTCPServer::on_hd_complete( evt_tls_t *evt_tls, int status)
 
     if (status)
     {
+#ifndef _WIN32
+        // the kernel would encrypt the end of the handshake if it were still queued in libuv
+        uv_os_fd_t fd;
+        if (tcpctx->server->kernelTls && !tcpctx->tcphandle.write_queue_size
+                && !uv_fileno((uv_handle_t*)&tcpctx->tcphandle, &fd))
+        {
+            bool enabled = evt_tls_enable_ktls_tx(evt_tls, fd) == 1;
+            LOG_debug << "Kernel TLS " << (enabled ? "enabled" : "not available") << " in port = " << tcpctx->server->port;
+        }
+#endif
         evt_tls_read(evt_tls, evt_on_rd); //this only establish callback
         if ( tcpctx->server->respondNewConnection(tcpctx) )
         {
@@ -27989,16 +31004,18 @@ void MegaTCPServer::onNewClient_tls(uv_stream_t *server_handle, int status)
     // Create an object to save context information
     MegaTCPContext* tcpctx = ((MegaTCPServer *)server_handle->data)->initializeContext(server_handle);
 
-    LOG_debug << "Connection received at port " << tcpctx->server->port << " ! " << tcpctx->server->connections.size();
+    tcpctx->loop = (MegaTCPLoop*) server_handle->loop->data;
+
+    LOG_debug << "Connection received at port " << tcpctx->server->port << " ! " << connectionsOf(tcpctx).size();
 
     // Mutex to protect the data buffer
     uv_mutex_init(&tcpctx->mutex);
 
     // Async handle to perform writes
-    uv_async_init(&tcpctx->server->uv_loop, &tcpctx->asynchandle, onAsyncEvent);
+    uv_async_init(server_handle->loop, &tcpctx->asynchandle, onAsyncEvent);
 
     // Accept the connection
-    uv_tcp_init(&tcpctx->server->uv_loop, &tcpctx->tcphandle);
+    uv_tcp_init(server_handle->loop, &tcpctx->tcphandle);
     if (uv_accept(server_handle, (uv_stream_t*)&tcpctx->tcphandle))
     {
         LOG_err << "uv_accept failed";
@@ -28016,7 +31033,7 @@ void MegaTCPServer::onNewClient_tls(uv_stream_t *server_handle, int status)
         return;
     }
 
-    tcpctx->server->connections.push_back(tcpctx);
+    connectionsOf(tcpctx).push_back(tcpctx);
 
     tcpctx->server->readData(tcpctx);
 }
@@ -28048,16 +31065,18 @@ void MegaTCPServer::onNewClient(uv_stream_t* server_handle, int status)
     // Create an object to save context information
     MegaTCPContext* tcpctx = ((MegaTCPServer *)server_handle->data)->initializeContext(server_handle);
 
-    LOG_debug << "Connection received at port " << tcpctx->server->port << "! " << tcpctx->server->connections.size() << " tcpctx = " << tcpctx;
+    tcpctx->loop = (MegaTCPLoop*) server_handle->loop->data;
+
+    LOG_debug << "Connection received at port " << tcpctx->server->port << "! " << connectionsOf(tcpctx).size() << " tcpctx = " << tcpctx;
 
     // Mutex to protect the data buffer
     uv_mutex_init(&tcpctx->mutex);
 
     // Async handle to perform writes
-    uv_async_init(&tcpctx->server->uv_loop, &tcpctx->asynchandle, onAsyncEvent);
+    uv_async_init(server_handle->loop, &tcpctx->asynchandle, onAsyncEvent);
 
     // Accept the connection
-    uv_tcp_init(&tcpctx->server->uv_loop, &tcpctx->tcphandle);
+    uv_tcp_init(server_handle->loop, &tcpctx->tcphandle);
     if (uv_accept(server_handle, (uv_stream_t*)&tcpctx->tcphandle))
     {
         LOG_err << "uv_accept failed";
@@ -28065,7 +31084,7 @@ void MegaTCPServer::onNewClient(uv_stream_t* server_handle, int status)
         return;
     }
 
-    tcpctx->server->connections.push_back(tcpctx);
+    connectionsOf(tcpctx).push_back(tcpctx);
     if (tcpctx->server->respondNewConnection(tcpctx))
     {
         // Start reading
@@ -28128,8 +31147,8 @@ void MegaTCPServer::onClose(uv_handle_t* handle)
     tcpctx->megaApi->removeTransferListener(tcpctx);
     tcpctx->megaApi->removeRequestListener(tcpctx);
 
-    tcpctx->server->connections.remove(tcpctx);
-    LOG_debug << "Connection closed: " << tcpctx->server->connections.size() << " port = " << tcpctx->server->port << " closing async handle";
+    connectionsOf(tcpctx).remove(tcpctx);
+    LOG_debug << "Connection closed: " << connectionsOf(tcpctx).size() << " port = " << tcpctx->server->port << " closing async handle";
     uv_close((uv_handle_t *)&tcpctx->asynchandle, onAsyncEventClose);
 }
 
@@ -28140,12 +31159,13 @@ void MegaTCPServer::onAsyncEventClose(uv_handle_t *handle)
 
     int port = tcpctx->server->port;
 
-    tcpctx->server->remainingcloseevents--;
+    int& remainingcloseevents = closeEventsOf(tcpctx);
+    remainingcloseevents--;
     tcpctx->server->processOnAsyncEventClose(tcpctx);
 
-    LOG_verbose << "At onAsyncEventClose port = " << tcpctx->server->port << " remaining=" << tcpctx->server->remainingcloseevents;
+    LOG_verbose << "At onAsyncEventClose port = " << tcpctx->server->port << " remaining=" << remainingcloseevents;
 
-    if (!tcpctx->server->remainingcloseevents && tcpctx->server->closing && !tcpctx->server->semaphoresdestroyed)
+    if (!tcpctx->loop && !remainingcloseevents && tcpctx->server->closing && !tcpctx->server->semaphoresdestroyed)
     {
         uv_sem_post(&tcpctx->server->semaphoreStartup);
         uv_sem_post(&tcpctx->server->semaphoreEnd);
@@ -28253,6 +31273,49 @@ MegaTCPContext::~MegaTCPContext()
 #endif
 }
 
+bool MegaTCPServer::feedStreaming(MegaTCPContext* tcpctx, StreamingBuffer& buffer, MegaNode* node, m_off_t start, m_off_t end, bool sequential)
+{
+    StreamingCache* cache = tcpctx->streamingCache.get();
+    if (cache)
+    {
+        std::vector<char> chunk;
+        while (start < end)
+        {
+            size_t space = buffer.availableSpace();
+            if (!space)
+            {
+                LOG_debug << "[Streaming] Buffer full of cached data at " << start << " " << buffer.bufferStatus();
+                return false;
+            }
+
+            chunk.resize(static_cast<size_t>(std::min<m_off_t>(space, end - start)));
+            size_t len = cache->read(node->getHandle(), start, chunk.data(), chunk.size());
+            if (!len)
+            {
+                break;
+            }
+            buffer.append(chunk.data(), len);
+            start += len;
+        }
+    }
+
+    if (start < end)
+    {
+        // only up to the next cached range, the rest is requested when this part completes
+        m_off_t to = end;
+        m_off_t next = cache ? cache->nextCached(node->getHandle(), start) : -1;
+        if (next > start && next < end)
+        {
+            to = next;
+        }
+
+        LOG_debug << "Requesting range. From " << start << "  size " << (to - start);
+        tcpctx->streamingTo = to;
+        tcpctx->megaApi->startStreaming(node, start, to - start, tcpctx, sequential);
+    }
+    return true;
+}
+
 void MegaTCPServer::onAsyncEvent(uv_async_t* handle)
 {
     MegaTCPContext* tcpctx = (MegaTCPContext*) handle->data;
@@ -28329,8 +31392,9 @@ void MegaTCPServer::closeTCPConnection(MegaTCPContext *tcpctx)
     tcpctx->finished = true;
     if (!uv_is_closing((uv_handle_t*)&tcpctx->tcphandle))
     {
-        tcpctx->server->remainingcloseevents++;
-        LOG_verbose << "At closeTCPConnection port = " << tcpctx->server->port << " remainingcloseevent = " << tcpctx->server->remainingcloseevents;
+        int& remainingcloseevents = closeEventsOf(tcpctx);
+        remainingcloseevents++;
+        LOG_verbose << "At closeTCPConnection port = " << tcpctx->server->port << " remainingcloseevent = " << remainingcloseevents;
         uv_close((uv_handle_t*)&tcpctx->tcphandle, onClose);
     }
 }
@@ -28457,6 +31521,32 @@ void MegaHTTPServer::processWriteFinished(MegaTCPContext* tcpctx, int status)
         return;
     }
 
+#ifndef _WIN32
+    if (httpctx->localFile >= 0)
+    {
+        // the headers were written, the data goes from the file to the socket
+        httpctx->lastBufferLen = 0;
+        if (!httpctx->localFileSend)
+        {
+            // sendfile() runs in the threadpool on a blocking socket (so it waits for the client
+            // instead of spinning), hence the loop must stop reading from it
+            uv_os_fd_t sock;
+            struct timeval timeout = { LOCAL_FILE_SEND_TIMEOUT, 0 };
+            uv_read_stop((uv_stream_t*)&httpctx->tcphandle);
+            if (uv_fileno((uv_handle_t*)&httpctx->tcphandle, &sock)
+                || uv_stream_set_blocking((uv_stream_t*)&httpctx->tcphandle, 1)
+                || setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)))
+            {
+                LOG_warn << "Finishing request. Unable to prepare the socket to send a local file";
+                closeConnection(httpctx);
+                return;
+            }
+            sendLocalFile(httpctx);
+        }
+        return;
+    }
+#endif
+
     uv_mutex_lock(&httpctx->mutex);
     if (httpctx->lastBufferLen)
     {
@@ -28474,7 +31564,10 @@ void MegaHTTPServer::processWriteFinished(MegaTCPContext* tcpctx, int status)
 
             LOG_debug << "[Streaming] Resuming streaming from " << start << " len: " << len
                       << " " << httpctx->streamingBuffer.bufferStatus();
-            httpctx->megaApi->startStreaming(httpctx->node, start, len, httpctx);
+            if (!feedStreaming(httpctx, httpctx->streamingBuffer, httpctx->node, start, start + len))
+            {
+                httpctx->pause = true;
+            }
         }
     }
     httpctx->lastBufferLen = 0;
@@ -28500,6 +31593,20 @@ void MegaHTTPServer::processOnAsyncEventClose(MegaTCPContext* tcpctx)
 
     delete httpctx->node;
     httpctx->node = NULL;
+
+#ifndef _WIN32
+    if (httpctx->localFileSend)
+    {
+        // the file is closed when the ongoing sendfile() completes
+        httpctx->localFileSend->httpctx = nullptr;
+        httpctx->localFileSend = nullptr;
+    }
+    else if (httpctx->localFile >= 0)
+    {
+        closeLocalFile(httpctx->localFile);
+    }
+    httpctx->localFile = -1;
+#endif
 }
 
 bool MegaHTTPServer::respondNewConnection(MegaTCPContext* tcpctx)
@@ -28721,7 +31828,7 @@ int MegaHTTPServer::onHeaderValue(http_parser *parser, const char *at, size_t le
     LOG_verbose << " onHeaderValue: " << httpctx->lastheader << " = " << value;
     if (httpctx->lastheader == "depth")
     {
-        httpctx->depth = atoi(value.c_str());
+        httpctx->depth = !value.compare(0, 8, "infinity") ? PROPFIND_DEPTH_INFINITY : atoi(value.c_str());
     }
     else if (httpctx->lastheader == "host")
     {
@@ -28895,6 +32002,124 @@ string MegaHTTPServer::getWebDavPropFindResponseForNode(string baseURL, string s
     return response.str();
 }
 
+void MegaHTTPServer::startPropFind(string baseURL, string subnodepath, MegaNode *node, MegaHTTPContext* httpctx)
+{
+    string subbaseURL = baseURL + subnodepath;
+    if (subbaseURL.size() && subbaseURL.at(subbaseURL.size() - 1) != '/')
+    {
+        subbaseURL.append("/");
+    }
+    MegaHTTPServer* httpserver = dynamic_cast<MegaHTTPServer *>(httpctx->server);
+
+    string web = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n"
+                 "<d:multistatus xmlns:d=\"DAV:\" xmlns:Z=\"urn:schemas-microsoft-com::\">\r\n";
+    web.append(getWebDavProfFindNodeContents(node, subbaseURL, httpserver->isOfflineAttributeEnabled()));
+
+    // a missing Depth header lists the children, as before
+    int levels = httpctx->depth < 0 ? 1 : httpctx->depth;
+    httpctx->propFindFolders.clear();
+    httpctx->propFindFolders.push_back({ unique_ptr<MegaNode>(node->copy()), subbaseURL, levels, 0 });
+    httpctx->propFindPending.clear();
+    appendChunk(httpctx->propFindPending, web);
+    httpctx->propFindStreaming = true;
+
+    string headers = "HTTP/1.1 207 Multi-Status\r\n"
+                     "transfer-encoding: chunked\r\n"
+                     "content-type: application/xml; charset=utf-8\r\n"
+                     "server: MEGAsdk\r\n"
+                     "\r\n";
+
+    // the buffer holds some pages of the listing, whatever the size of the tree
+    httpctx->streamingBuffer.setFileSize(PROPFIND_BUFFER_SIZE);
+    httpctx->streamingBuffer.init(PROPFIND_BUFFER_SIZE);
+    httpctx->resultCode = API_OK;
+    httpctx->size = 0;
+    sendHeaders(httpctx, &headers);
+
+    // the length is unknown until the last page (see fillPropFind)
+    httpctx->size = std::numeric_limits<m_off_t>::max();
+}
+
+void MegaHTTPServer::appendChunk(string& out, const string& data)
+{
+    char length[20];
+    snprintf(length, sizeof(length), "%zx\r\n", data.size());
+    out.append(length);
+    out.append(data);
+    out.append("\r\n");
+}
+
+void MegaHTTPServer::fillPropFind(MegaHTTPContext* httpctx)
+{
+    MegaHTTPServer* httpserver = dynamic_cast<MegaHTTPServer *>(httpctx->server);
+
+    uv_mutex_lock(&httpctx->mutex);
+    for (;;)
+    {
+        // XML already generated goes first
+        if (httpctx->propFindPending.size())
+        {
+            size_t len = std::min(httpctx->propFindPending.size(), httpctx->streamingBuffer.availableSpace());
+            if (!len)
+            {
+                break;
+            }
+            httpctx->streamingBuffer.append(httpctx->propFindPending.data(), len);
+            httpctx->propFindPending.erase(0, len);
+            continue;
+        }
+
+        if (httpctx->propFindFolders.empty())
+        {
+            // all generated and buffered: now the length of the response is known
+            httpctx->propFindStreaming = false;
+            httpctx->size = httpctx->bytesWritten + (httpctx->lastBuffer ? m_off_t(httpctx->lastBufferLen) : 0)
+                    + m_off_t(httpctx->streamingBuffer.availableData());
+            LOG_debug << "PROPFIND response complete. Size: " << httpctx->size;
+            break;
+        }
+
+        MegaHTTPContext::PropFindFolder& folder = httpctx->propFindFolders.back();
+        unique_ptr<MegaNodeList> page(httpctx->megaApi->getChildrenPage(folder.node.get(), MegaApi::ORDER_DEFAULT_ASC, folder.offset, PROPFIND_PAGE_SIZE));
+        folder.offset += page->size();
+        string url = folder.url;
+        int levels = folder.levels;
+        if (!page->size())
+        {
+            httpctx->propFindFolders.pop_back();
+        }
+
+        string web;
+        for (int i = 0; i < page->size(); i++)
+        {
+            MegaNode *child = page->get(i);
+            string childURL = url + child->getName();
+            web.append(getWebDavProfFindNodeContents(child, childURL, httpserver->isOfflineAttributeEnabled()));
+            if (child->isFolder() && levels > 1)
+            {
+                int childLevels = levels == PROPFIND_DEPTH_INFINITY ? levels : levels - 1;
+                httpctx->propFindFolders.push_back({ unique_ptr<MegaNode>(child->copy()), childURL + "/", childLevels, 0 });
+            }
+        }
+
+        if (httpctx->propFindFolders.empty())
+        {
+            web.append("</d:multistatus>\r\n");
+        }
+
+        if (web.size())
+        {
+            appendChunk(httpctx->propFindPending, web);
+        }
+        if (httpctx->propFindFolders.empty())
+        {
+            // last chunk
+            httpctx->propFindPending.append("0\r\n\r\n");
+        }
+    }
+    uv_mutex_unlock(&httpctx->mutex);
+}
+
 string MegaHTTPServer::getResponseForNode(MegaNode *node, MegaHTTPContext* httpctx)
 {
     MegaNode *parent = httpctx->megaApi->getParentNode(node);
@@ -29250,8 +32475,8 @@ int MegaHTTPServer::onMessageComplete(http_parser *parser)
     MegaHTTPContext* httpctx = (MegaHTTPContext*) parser->data;
     httpctx->bytesWritten = 0;
     httpctx->size = 0;
-    httpctx->streamingBuffer.setMaxBufferSize(httpctx->server->getMaxBufferSize());
-    httpctx->streamingBuffer.setMaxOutputSize(httpctx->server->getMaxOutputSize());
+    httpctx->streamingBuffer.setMaxBufferSize(httpctx->server->getMaxBufferSizeSetting());
+    httpctx->streamingBuffer.setMaxOutputSize(httpctx->server->getMaxOutputSizeSetting());
 
     MegaHTTPServer* httpserver = dynamic_cast<MegaHTTPServer *>(httpctx->server);
 
@@ -29508,8 +32733,15 @@ int MegaHTTPServer::onMessageComplete(http_parser *parser)
     {
         string baseURL = string("http") + (httpctx->server->useTLS ? "s" : "") + "://"
                 + httpctx->host + "/" + httpctx->nodehandle + "/" + httpctx->nodename + "/";
-        string resstr = getWebDavPropFindResponseForNode(baseURL, httpctx->subpathrelative, node, httpctx);
-        sendHeaders(httpctx, &resstr);
+        if (node->isFolder() && httpctx->depth != 0)
+        {
+            startPropFind(baseURL, httpctx->subpathrelative, node, httpctx);
+        }
+        else
+        {
+            string resstr = getWebDavPropFindResponseForNode(baseURL, httpctx->subpathrelative, node, httpctx);
+            sendHeaders(httpctx, &resstr);
+        }
         delete node;
         delete baseNode;
         return 0;
@@ -30136,9 +33368,19 @@ int MegaHTTPServer::streamNode(MegaHTTPContext *httpctx)
     httpctx->streamingBuffer.setDuration(httpctx->node->getDuration());
 
     string resstr = response.str();
+    bool fromLocalFile = false;
+#ifndef _WIN32
+    if (httpctx->parser.method == HTTP_GET && len > 0 && !httpctx->server->useTLS)
+    {
+        httpctx->localFile = openLocalCopy(httpctx, start, start + len);
+        fromLocalFile = httpctx->localFile >= 0;
+    }
+#endif
+
     if (httpctx->parser.method != HTTP_HEAD)
     {
-        httpctx->streamingBuffer.init(len + resstr.size());
+        // the buffer only holds the headers if the data comes from a local file
+        httpctx->streamingBuffer.init((fromLocalFile ? 0 : len) + resstr.size());
         httpctx->size = len;
     }
 
@@ -30148,11 +33390,26 @@ int MegaHTTPServer::streamNode(MegaHTTPContext *httpctx)
         return 0;
     }
 
-    LOG_debug << "Requesting range. From " << start << "  size " << len;
+#ifndef _WIN32
+    if (fromLocalFile)
+    {
+        // sent by processWriteFinished when the headers are written
+        LOG_debug << "Sending local copy. From " << start << "  size " << len;
+        httpctx->localFileOffset = start;
+        return 0;
+    }
+#endif
+
     httpctx->rangeWritten = 0;
+    httpctx->streamingCache = httpctx->megaApi->getStreamingCache();
     if (start || len)
     {
-        httpctx->megaApi->startStreaming(node, start, len, httpctx);
+        uv_mutex_lock(&httpctx->mutex);
+        if (!feedStreaming(httpctx, httpctx->streamingBuffer, node, start, start + len))
+        {
+            httpctx->pause = true;
+        }
+        uv_mutex_unlock(&httpctx->mutex);
     }
     else
     {
@@ -30163,6 +33420,152 @@ int MegaHTTPServer::streamNode(MegaHTTPContext *httpctx)
     return 0;
 }
 
+#ifndef _WIN32
+struct MegaHTTPFileSend
+{
+    uv_fs_t req;
+    MegaHTTPContext *httpctx;
+    uv_file file;
+};
+
+uv_file MegaHTTPServer::openLocalCopy(MegaHTTPContext *httpctx, m_off_t start, m_off_t end)
+{
+    MegaNode *node = httpctx->node;
+    string path;
+    bool synced = false;
+
+    LocalPath cachePath;
+    shared_ptr<StreamingCache> cache = httpctx->megaApi->getStreamingCache();
+    if (cache && cache->cachedFile(node->getHandle(), start, end, cachePath))
+    {
+        path = cachePath.toPath(false);
+    }
+    else
+    {
+        path = httpctx->megaApi->getLocalPath(node).c_str();
+        synced = true;
+    }
+
+    if (path.empty())
+    {
+        return -1;
+    }
+
+    uv_fs_t req;
+    uv_file file = uv_fs_open(NULL, &req, path.c_str(), O_RDONLY, 0, NULL);
+    uv_fs_req_cleanup(&req);
+    if (file < 0)
+    {
+        return -1;
+    }
+
+    if (synced)
+    {
+        // only if the local file is still the content of the node
+        int err = uv_fs_fstat(NULL, &req, file, NULL);
+        bool matches = !err && m_off_t(req.statbuf.st_size) == node->getSize()
+                && m_time_t(req.statbuf.st_mtim.tv_sec) == node->getModificationTime();
+        uv_fs_req_cleanup(&req);
+        if (!matches)
+        {
+            LOG_debug << "Local copy of the node doesn't match it: " << path;
+            closeLocalFile(file);
+            return -1;
+        }
+    }
+
+    LOG_debug << "Serving local copy of the node: " << path;
+    return file;
+}
+
+void MegaHTTPServer::sendLocalFile(MegaHTTPContext *httpctx)
+{
+    uv_os_fd_t sock;
+    if (int err = uv_fileno((uv_handle_t*)&httpctx->tcphandle, &sock))
+    {
+        ((MegaHTTPServer *)httpctx->server)->processWriteFinished(httpctx, err);
+        return;
+    }
+
+    MegaHTTPFileSend *send = new MegaHTTPFileSend();
+    send->httpctx = httpctx;
+    send->file = httpctx->localFile;
+    send->req.data = send;
+    httpctx->localFileSend = send;
+
+    m_off_t maxChunk = LOCAL_FILE_CHUNK;
+    size_t len = static_cast<size_t>(std::min(httpctx->size - httpctx->bytesWritten, maxChunk));
+    if (int err = uv_fs_sendfile(httpctx->tcphandle.loop, &send->req, sock, send->file, httpctx->localFileOffset, len, onLocalFileSent))
+    {
+        httpctx->localFileSend = nullptr;
+        delete send;
+        LOG_warn << "Unable to send the local file: " << err;
+        ((MegaHTTPServer *)httpctx->server)->processWriteFinished(httpctx, err);
+    }
+}
+
+void MegaHTTPServer::onLocalFileSent(uv_fs_t *req)
+{
+    MegaHTTPFileSend *send = (MegaHTTPFileSend *)req->data;
+    ssize_t result = req->result;
+    uv_fs_req_cleanup(req);
+
+    MegaHTTPContext *httpctx = send->httpctx;
+    if (!httpctx)
+    {
+        LOG_debug << "HTTP link closed while sending a local file";
+        closeLocalFile(send->file);
+        delete send;
+        return;
+    }
+    httpctx->localFileSend = nullptr;
+    delete send;
+    if (httpctx->finished)
+    {
+        // the file is closed with the connection
+        return;
+    }
+
+    MegaHTTPServer *httpserver = (MegaHTTPServer *)httpctx->server;
+    if (result == UV_EAGAIN)
+    {
+        if (++httpctx->localFileTimeouts > LOCAL_FILE_MAX_TIMEOUTS)
+        {
+            httpserver->processWriteFinished(httpctx, UV_ETIMEDOUT);
+            return;
+        }
+        sendLocalFile(httpctx);
+        return;
+    }
+
+    if (result <= 0)
+    {
+        // nothing sent and no error: the file is shorter than expected
+        httpserver->processWriteFinished(httpctx, result ? int(result) : UV_EOF);
+        return;
+    }
+
+    LOG_verbose << "Local file bytes sent: " << result << " Remaining: " << (httpctx->size - httpctx->bytesWritten - result);
+    httpctx->localFileTimeouts = 0;
+    httpctx->localFileOffset += result;
+    httpctx->bytesWritten += result;
+    if (httpctx->bytesWritten < httpctx->size)
+    {
+        sendLocalFile(httpctx);
+        return;
+    }
+
+    httpserver->processWriteFinished(httpctx, 0);
+}
+
+void MegaHTTPServer::closeLocalFile(uv_file file)
+{
+    uv_fs_t req;
+    uv_fs_close(NULL, &req, file, NULL);
+    uv_fs_req_cleanup(&req);
+}
+#endif
+
 void MegaHTTPServer::sendHeaders(MegaHTTPContext *httpctx, string *headers)
 {
     LOG_debug << "Response headers: " << *headers;
@@ -30254,6 +33657,23 @@ void MegaHTTPServer::processAsyncEvent(MegaTCPContext* tcpctx)
         return;
     }
 
+    if (httpctx->propFindStreaming)
+    {
+        fillPropFind(httpctx);
+    }
+
+    uv_mutex_lock(&httpctx->mutex);
+    if (httpctx->streamingPartFinished)
+    {
+        // if paused, it continues when the buffer has space
+        httpctx->streamingPartFinished = false;
+        if (!httpctx->pause && !feedStreaming(httpctx, httpctx->streamingBuffer, httpctx->node, httpctx->streamingTo, httpctx->rangeEnd))
+        {
+            httpctx->pause = true;
+        }
+    }
+    uv_mutex_unlock(&httpctx->mutex);
+
     sendNextBytes(httpctx);
 }
 
@@ -30390,6 +33810,11 @@ bool MegaHTTPContext::onTransferData(MegaApi *, MegaTransfer *transfer, char *bu
         return false;
     }
 
+    if (streamingCache)
+    {
+        streamingCache->write(transfer->getNodeHandle(), transfer->getStartPos() + transfer->getTransferredBytes() - m_off_t(size), buffer, size);
+    }
+
     // append the data to the buffer
     uv_mutex_lock(&mutex);
     long long remaining = size + (transfer->getTotalBytes() - transfer->getTransferredBytes());
@@ -30436,6 +33861,13 @@ void MegaHTTPContext::onTransferFinish(MegaApi *, MegaTransfer *, MegaError *e)
         LOG_warn << "Transfer failed with error code: " << ecode;
         failed = true;
     }
+
+    if (ecode == API_OK && streamingTo >= 0 && streamingTo < rangeEnd)
+    {
+        uv_mutex_lock(&mutex);
+        streamingPartFinished = true;
+        uv_mutex_unlock(&mutex);
+    }
     uv_async_send(&asynchandle);
 }
 
@@ -30579,6 +34011,7 @@ MegaFTPServer::MegaFTPServer(MegaApiImpl *megaApi, string basePath, int dataport
     this->pport = dataportBegin;
     this->dataportBegin = dataportBegin;
     this->dataPortEnd = dataPortEnd;
+    uploadPipelining = false;
 
     crlfout = "\r\n";
 }
@@ -30590,6 +34023,16 @@ MegaFTPServer::~MegaFTPServer()
     stop();
 }
 
+void MegaFTPServer::setUploadPipelining(bool enable)
+{
+    uploadPipelining = enable;
+}
+
+bool MegaFTPServer::isUploadPipelining() const
+{
+    return uploadPipelining;
+}
+
 MegaTCPContext* MegaFTPServer::initializeContext(uv_stream_t *server_handle)
 {
     MegaFTPContext* ftpctx = new MegaFTPContext();
@@ -31509,6 +34952,7 @@ void MegaFTPServer::processReceivedData(MegaTCPContext *tcpctx, ssize_t nread, c
                 LOG_debug << "Creating new MegaFTPDataServer on port " << ftpctx->pasiveport;
 #ifdef ENABLE_EVT_TLS
                 MegaFTPDataServer *fds = new MegaFTPDataServer(megaApi, basePath, ftpctx, useTLS, certificatepath, keypath);
+                fds->setKernelTls(kernelTls);
 #else
                 MegaFTPDataServer *fds = new MegaFTPDataServer(megaApi, basePath, ftpctx, useTLS, string(), string());
 #endif
@@ -32465,7 +35909,10 @@ void MegaFTPDataServer::processWriteFinished(MegaTCPContext *tcpctx, int status)
 
                 LOG_debug << "[Streaming] Resuming streaming from " << start << " len: " << len
                           << " " << ftpdatactx->streamingBuffer.bufferStatus();
-                ftpdatactx->megaApi->startStreaming(ftpdatactx->node, start, len, ftpdatactx);
+                if (!feedStreaming(ftpdatactx, ftpdatactx->streamingBuffer, ftpdatactx->node, start, start + len, true))
+                {
+                    ftpdatactx->pause = true;
+                }
             }
         }
         uv_mutex_unlock(&ftpdatactx->mutex);
@@ -32590,13 +36037,25 @@ void MegaFTPDataServer::processReceivedData(MegaTCPContext *tcpctx, ssize_t nrea
             if (newParentNode)
             {
                 LOG_debug << "Starting upload of file " << fds->newNameToUpload;
-                fds->controlftpctx->tmpFileName = ftpdatactx->tmpFileName;
-
                 FileSystemType fsType = fds->fsAccess->getlocalfstype(LocalPath::fromAbsolutePath(ftpdatactx->tmpFileName));
-                ftpdatactx->megaApi->startUpload(false, ftpdatactx->tmpFileName.c_str(), newParentNode, fds->newNameToUpload.c_str(),
-                                                    nullptr, -1, 0, true, nullptr, false, false, fsType, CancelToken(), fds->controlftpctx);
+                MegaFTPServer* ftpControlServer = dynamic_cast<MegaFTPServer *>(fds->controlftpctx->server);
+                if (ftpControlServer->isUploadPipelining())
+                {
+                    // the client can go on with the next file: the SDK removes the temporary
+                    // file once the upload ends, and failures are only logged
+                    ftpdatactx->megaApi->startUpload(false, ftpdatactx->tmpFileName.c_str(), newParentNode, fds->newNameToUpload.c_str(),
+                                                        nullptr, -1, 0, true, nullptr, true, false, fsType, CancelToken(), nullptr);
 
-                ftpdatactx->controlRespondedElsewhere = true;
+                    ftpdatactx->setControlCodeUponDataClose(226);
+                }
+                else
+                {
+                    fds->controlftpctx->tmpFileName = ftpdatactx->tmpFileName;
+                    ftpdatactx->megaApi->startUpload(false, ftpdatactx->tmpFileName.c_str(), newParentNode, fds->newNameToUpload.c_str(),
+                                                        nullptr, -1, 0, true, nullptr, false, false, fsType, CancelToken(), fds->controlftpctx);
+
+                    ftpdatactx->controlRespondedElsewhere = true;
+                }
             }
             else
             {
@@ -32667,8 +36126,8 @@ void MegaFTPDataServer::processAsyncEvent(MegaTCPContext *tcpctx)
             rangeStartREST = 0;// so as not to start again
             ftpdatactx->bytesWritten = 0;
             ftpdatactx->size = 0;
-            ftpdatactx->streamingBuffer.setMaxBufferSize(ftpdatactx->server->getMaxBufferSize());
-            ftpdatactx->streamingBuffer.setMaxOutputSize(ftpdatactx->server->getMaxOutputSize());
+            ftpdatactx->streamingBuffer.setMaxBufferSize(ftpdatactx->server->getMaxBufferSizeSetting());
+            ftpdatactx->streamingBuffer.setMaxOutputSize(ftpdatactx->server->getMaxOutputSizeSetting());
 
             ftpdatactx->transfer = new MegaTransferPrivate(MegaTransfer::TYPE_LOCAL_TCP_DOWNLOAD);
 
@@ -32712,11 +36171,16 @@ void MegaFTPDataServer::processAsyncEvent(MegaTCPContext *tcpctx)
 
             ftpdatactx->megaApi->fireOnFtpStreamingStart(ftpdatactx->transfer);
 
-            LOG_debug << "Requesting range. From " << start << "  size " << len;
             ftpdatactx->rangeWritten = 0;
+            ftpdatactx->streamingCache = ftpdatactx->megaApi->getStreamingCache();
             if (start || len)
             {
-                ftpdatactx->megaApi->startStreaming(nodeToDownload, start, len, ftpdatactx);
+                uv_mutex_lock(&ftpdatactx->mutex);
+                if (!feedStreaming(ftpdatactx, ftpdatactx->streamingBuffer, nodeToDownload, start, start + len, true))
+                {
+                    ftpdatactx->pause = true;
+                }
+                uv_mutex_unlock(&ftpdatactx->mutex);
             }
             else
             {
@@ -32728,6 +36192,18 @@ void MegaFTPDataServer::processAsyncEvent(MegaTCPContext *tcpctx)
         }
         else
         {
+            uv_mutex_lock(&ftpdatactx->mutex);
+            if (ftpdatactx->streamingPartFinished)
+            {
+                // if paused, it continues when the buffer has space
+                ftpdatactx->streamingPartFinished = false;
+                if (!ftpdatactx->pause && !feedStreaming(ftpdatactx, ftpdatactx->streamingBuffer, ftpdatactx->node, ftpdatactx->streamingTo, ftpdatactx->rangeEnd, true))
+                {
+                    ftpdatactx->pause = true;
+                }
+            }
+            uv_mutex_unlock(&ftpdatactx->mutex);
+
             LOG_debug << "Calling sendNextBytes port = " << fds->port;
             sendNextBytes(ftpdatactx);
         }
@@ -32909,6 +36385,11 @@ bool MegaFTPDataContext::onTransferData(MegaApi *, MegaTransfer *transfer, char
         return false;
     }
 
+    if (streamingCache)
+    {
+        streamingCache->write(transfer->getNodeHandle(), transfer->getStartPos() + transfer->getTransferredBytes() - m_off_t(size), buffer, size);
+    }
+
     // append the data to the buffer
     uv_mutex_lock(&mutex);
     long long remaining = size + (transfer->getTotalBytes() - transfer->getTransferredBytes());
@@ -32940,6 +36421,13 @@ void MegaFTPDataContext::onTransferFinish(MegaApi *, MegaTransfer *, MegaError *
         LOG_warn << "Transfer failed with error code: " << ecode;
         failed = true;
     }
+
+    if (ecode == API_OK && streamingTo >= 0 && streamingTo < rangeEnd)
+    {
+        uv_mutex_lock(&mutex);
+        streamingPartFinished = true;
+        uv_mutex_unlock(&mutex);
+    }
     uv_async_send(&asynchandle);
 }
 
@@ -32970,12 +36458,7 @@ MegaTextChatPeerListPrivate::~MegaTextChatPeerListPrivate()
 MegaTextChatPeerList *MegaTextChatPeerListPrivate::copy() const
 {
     MegaTextChatPeerListPrivate *ret = new MegaTextChatPeerListPrivate;
-
-    for (int i = 0; i < size(); i++)
-    {
-        ret->addPeer(list.at(i).first, list.at(i).second);
-    }
-
+    ret->list = list;
     return ret;
 }
 
@@ -33034,17 +36517,8 @@ void MegaTextChatPeerListPrivate::setPeerPrivilege(handle uh, privilege_t priv)
 }
 
 MegaTextChatPeerListPrivate::MegaTextChatPeerListPrivate(userpriv_vector *userpriv)
+    : list(*userpriv)
 {
-    handle uh;
-    privilege_t priv;
-
-    for (unsigned i = 0; i < userpriv->size(); i++)
-    {
-        uh = userpriv->at(i).first;
-        priv = userpriv->at(i).second;
-
-        this->addPeer(uh, priv);
-    }
 }
 
 MegaTextChatPrivate::MegaTextChatPrivate(const MegaTextChat *chat)
@@ -33150,6 +36624,19 @@ MegaTextChatPrivate::MegaTextChatPrivate(const TextChat *chat)
         // in block (all occurrences for the chat)
         changed |= MegaTextChat::CHANGE_TYPE_SCHED_OCURR;
     }
+
+    if (chat->changed.peers)
+    {
+        changed |= MegaTextChat::CHANGE_TYPE_PARTICIPANTS;
+    }
+    if (chat->changed.title)
+    {
+        changed |= MegaTextChat::CHANGE_TYPE_TITLE;
+    }
+    if (chat->changed.ownPriv)
+    {
+        changed |= MegaTextChat::CHANGE_TYPE_OWN_PRIV;
+    }
 }
 
 MegaTextChat *MegaTextChatPrivate::copy() const
@@ -33751,6 +37238,7 @@ const char *MegaEventPrivate::getEventString(int type)
 #endif
         case MegaEvent::EVENT_REQSTAT_PROGRESS: return "REQSTAT_PROGRESS";
         case MegaEvent::EVENT_RELOADING: return "RELOADING";
+        case MegaEvent::EVENT_NODES_CACHED: return "NODES_CACHED";
     }
 
     return "UNKNOWN";
@@ -33888,6 +37376,109 @@ const vector<int64_t>* MegaIntegerListPrivate::getList() const
     return &mIntegers;
 }
 
+MegaMetricsSnapshotPrivate::MegaMetricsSnapshotPrivate(vector<Metrics::Entry>&& entries)
+    : mEntries(std::move(entries))
+{
+}
+
+MegaMetricsSnapshot* MegaMetricsSnapshotPrivate::copy() const
+{
+    return new MegaMetricsSnapshotPrivate(vector<Metrics::Entry>(mEntries));
+}
+
+const Metrics::Entry* MegaMetricsSnapshotPrivate::entry(int i) const
+{
+    return (i >= 0 && i < static_cast<int>(mEntries.size())) ? &mEntries[i] : nullptr;
+}
+
+int MegaMetricsSnapshotPrivate::size() const
+{
+    return static_cast<int>(mEntries.size());
+}
+
+const char* MegaMetricsSnapshotPrivate::getName(int i) const
+{
+    const Metrics::Entry* e = entry(i);
+    return e ? e->name.c_str() : nullptr;
+}
+
+int MegaMetricsSnapshotPrivate::getType(int i) const
+{
+    const Metrics::Entry* e = entry(i);
+    return e ? static_cast<int>(e->type) : -1;
+}
+
+long long MegaMetricsSnapshotPrivate::getValue(int i) const
+{
+    const Metrics::Entry* e = entry(i);
+    return e ? e->value : 0;
+}
+
+long long MegaMetricsSnapshotPrivate::getSumMicroseconds(int i) const
+{
+    const Metrics::Entry* e = entry(i);
+    return e ? static_cast<long long>(e->sumMicroseconds) : 0;
+}
+
+long long MegaMetricsSnapshotPrivate::getPercentileMicroseconds(int i, double percentile) const
+{
+    const Metrics::Entry* e = entry(i);
+    return e ? static_cast<long long>(e->percentileMicroseconds(percentile)) : 0;
+}
+
+char* MegaMetricsSnapshotPrivate::toOpenMetrics() const
+{
+    return MegaApi::strdup(Metrics::toOpenMetrics(mEntries).c_str());
+}
+
+MegaMemoryReportPrivate::MegaMemoryReportPrivate(MemoryReport&& report)
+    : mReport(std::move(report))
+{
+}
+
+MegaMemoryReport* MegaMemoryReportPrivate::copy() const
+{
+    return new MegaMemoryReportPrivate(MemoryReport(mReport));
+}
+
+const MemoryReport::Entry* MegaMemoryReportPrivate::entry(int i) const
+{
+    return (i >= 0 && i < static_cast<int>(mReport.entries.size())) ? &mReport.entries[i] : nullptr;
+}
+
+int MegaMemoryReportPrivate::size() const
+{
+    return static_cast<int>(mReport.entries.size());
+}
+
+const char* MegaMemoryReportPrivate::getSubsystem(int i) const
+{
+    const MemoryReport::Entry* e = entry(i);
+    return e ? e->subsystem.c_str() : nullptr;
+}
+
+long long MegaMemoryReportPrivate::getObjects(int i) const
+{
+    const MemoryReport::Entry* e = entry(i);
+    return e ? static_cast<long long>(e->objects) : 0;
+}
+
+long long MegaMemoryReportPrivate::getBytes(int i) const
+{
+    const MemoryReport::Entry* e = entry(i);
+    return e ? static_cast<long long>(e->bytes) : 0;
+}
+
+long long MegaMemoryReportPrivate::getTotalBytes() const
+{
+    return static_cast<long long>(mReport.totalBytes());
+}
+
+char* MegaMemoryReportPrivate::toJson() const
+{
+    return MegaApi::strdup(mReport.toJson().c_str());
+}
+
 MegaChildrenListsPrivate::MegaChildrenListsPrivate(MegaChildrenLists *list)
     : folders(list->getFolderList()->copy())
     , files(list->getFileList()->copy())
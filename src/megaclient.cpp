@@ -64,12 +64,17 @@ const string MegaClient::REQSTATURL = "https://reqstat.api.mega.co.nz";
 // MegaClient statics must be const or we get threading problems
 const string MegaClient::MEGAURL = "https://mega.nz";
 
+const string MegaClient::FETCHNODES_PREFIX = "[{\"f\":[";
+
 // maximum number of concurrent transfers (uploads + downloads)
 const unsigned MegaClient::MAXTOTALTRANSFERS = 48;
 
 // maximum number of concurrent transfers (uploads or downloads)
 const unsigned MegaClient::MAXTRANSFERS = 32;
 
+// max nodes coalesced into a single putnodes
+const size_t MegaClient::MAXPUTNODESBATCH = 100;
+
 // maximum number of queued putfa before halting the upload queue
 const int MegaClient::MAXQUEUEDFA = 30;
 
@@ -116,27 +121,36 @@ bool MegaClient::decryptkey(const char* sk, byte* tk, int tl, SymmCipher* sc, in
     if (sl > 4 * FILENODEKEYLENGTH / 3 + 1)
     {
         // RSA-encrypted key - decrypt and update on the server to save space & client CPU time
-        sl = sl / 4 * 3 + 3;
-
-        if (sl > 4096)
+        // already decrypted by predecryptrsakeys() (the key's most significant bytes, for any length)
+        auto it = tl <= FILENODEKEYLENGTH ? mPredecryptedRsaKeys.find(string(sk, size_t(sl))) : mPredecryptedRsaKeys.end();
+        if (it != mPredecryptedRsaKeys.end())
         {
-            return false;
+            memcpy(tk, it->second.data(), size_t(tl));
         }
+        else
+        {
+            sl = sl / 4 * 3 + 3;
+
+            if (sl > 4096)
+            {
+                return false;
+            }
 
-        byte* buf = new byte[sl];
+            byte* buf = new byte[sl];
 
-        sl = Base64::atob(sk, buf, sl);
+            sl = Base64::atob(sk, buf, sl);
+
+            // decrypt and set session ID for subsequent API communication
+            if (!asymkey.decrypt(buf, sl, tk, tl))
+            {
+                delete[] buf;
+                LOG_warn << "Corrupt or invalid RSA node key";
+                return false;
+            }
 
-        // decrypt and set session ID for subsequent API communication
-        if (!asymkey.decrypt(buf, sl, tk, tl))
-        {
             delete[] buf;
-            LOG_warn << "Corrupt or invalid RSA node key";
-            return false;
         }
 
-        delete[] buf;
-
         if (!ISUNDEF(node))
         {
             if (type)
@@ -179,6 +193,8 @@ void MegaClient::mergenewshares(bool notify, bool skipWriteInDb)
     }
 
     mNewKeyRepository.clear();
+
+    sendkeyrewrites();
 }
 
 void MegaClient::mergenewshare(NewShare *s, bool notify, bool skipWriteInDb)
@@ -289,7 +305,8 @@ void MegaClient::mergenewshare(NewShare *s, bool notify, bool skipWriteInDb)
             // Erase sharekey if no outgoing shares (incl pending) exist
             if (s->remove_key && !n->outshares && !n->pendingshares)
             {
-                rewriteforeignkeys(n);
+                // sent once for all the shares being merged
+                rewriteforeignkeys(n, false);
 
                 delete n->sharekey;
                 n->sharekey = NULL;
@@ -461,6 +478,7 @@ void MegaClient::mergenewshare(NewShare *s, bool notify, bool skipWriteInDb)
                 {
                     TreeProcApplyKey td;
                     proctree(n, &td);
+                    td.apply(this);
                 }
             }
         }
@@ -1210,6 +1228,8 @@ void MegaClient::init()
     syncextraretry = false;
     syncsup = true;
     syncdownrequired = false;
+    syncdownpartial = false;
+    mNextSyncdownFullWalkDs = 0;
     syncuprequired = false;
 
     if (syncscanstate)
@@ -1382,6 +1402,13 @@ MegaClient::MegaClient(MegaApp* a, Waiter* w, HttpIO* h, DbAccess* d, GfxProc* g
 
     reqtag = 0;
 
+    // commands that don't depend on others may skip the ordered batch, but only once enabled (MegaApi::setParallelRequests)
+    reqs.setParallelBatches(0);
+
+    // a big sc batch is applied over several iterations, so transfers and
+    // request completions aren't held up behind it
+    loopProfiler.setBudget(ExecLoopProfiler::SC, std::chrono::milliseconds(100));
+
     badhostcs = NULL;
 
     scsn.clear();
@@ -1415,6 +1442,7 @@ MegaClient::~MegaClient()
     locallogout(false, true);
 
     delete pendingcs;
+    parallelcs.clear();
     delete badhostcs;
     delete dbaccess;
     LOG_debug << clientname << "~MegaClient completing";
@@ -1498,6 +1526,223 @@ std::string MegaClient::getWritableLinkAuthKey(handle nodeHandle)
     return {};
 }
 
+// the error of a cs request that failed as a whole, and its text for the commands in it
+static error csrequesterror(const string& in, std::string& requestError)
+{
+    JSON json;
+    json.pos = in.c_str();
+    error e;
+    bool valid = json.storeobject(&requestError);
+    if (valid)
+    {
+        if (strncmp(requestError.c_str(), "{\"err\":", 7) == 0)
+        {
+            e = (error)atoi(requestError.c_str() + 7);
+        }
+        else
+        {
+            e = (error)atoi(requestError.c_str());
+        }
+    }
+    else
+    {
+        e = API_EINTERNAL;
+        requestError = std::to_string(e);
+    }
+
+    if (!e)
+    {
+        e = API_EINTERNAL;
+        requestError = std::to_string(e);
+    }
+    return e;
+}
+
+// why a cs request that didn't succeed is retried, as reported to the app
+static retryreason_t csretryreason(const HttpReq& req)
+{
+    if (req.status == REQ_SUCCESS)
+    {
+        return req.in == "-3" ? RETRY_API_LOCK : RETRY_RATE_LIMIT;
+    }
+
+    switch (req.httpstatus)
+    {
+        case 200:
+            return RETRY_NONE;
+        case 500:
+            return RETRY_SERVERS_BUSY;
+        case 0:
+            return RETRY_CONNECTIVITY;
+        default:
+            return RETRY_UNKNOWN;
+    }
+}
+
+string MegaClient::csurl(const char* id, size_t idlen, bool suppressSID)
+{
+    string url = httpio->APIURL;
+
+    url.append("cs?id=");
+    url.append(id, idlen);
+    url.append(getAuthURI(suppressSID));
+    url.append(appkey);
+
+    string version = "v=2";
+    url.append("&" + version);
+    if (lang.size())
+    {
+        url.append("&");
+        url.append(lang);
+    }
+    return url;
+}
+
+bool MegaClient::parallelcsready() const
+{
+    for (size_t i = 0; i < parallelcs.size() && i < reqs.parallelBatches(); i++)
+    {
+        if (!parallelcs[i]->req && parallelcs[i]->bt.armed()
+                && reqs.parallel(i).readyToSend(Waiter::ds))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MegaClient::parallelcsinflight() const
+{
+    for (auto& p : parallelcs)
+    {
+        if (p->req && p->req->status == REQ_INFLIGHT)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MegaClient::execparallelcs()
+{
+    while (parallelcs.size() < reqs.parallelBatches())
+    {
+        parallelcs.emplace_back(new ParallelCs(rng));
+    }
+
+    for (size_t i = 0; i < parallelcs.size(); i++)
+    {
+        ParallelCs& p = *parallelcs[i];
+        RequestDispatcher& batch = reqs.parallel(i);
+
+        if (p.req)
+        {
+            if (p.req->status == REQ_INFLIGHT && EVER(p.req->lastdata)
+                    && Waiter::ds >= p.req->lastdata + HttpIO::REQUESTTIMEOUT)
+            {
+                // these aren't worth a lock request: just try again
+                LOG_warn << clientname << "Parallel cs request timeout";
+                p.req->disconnect();
+                p.req->status = REQ_FAILURE;
+            }
+
+            if (p.req->status != REQ_SUCCESS && p.req->status != REQ_FAILURE)
+            {
+                continue;
+            }
+
+            // processing may log out, which resets p and the batch
+            unique_ptr<HttpReq> done = std::move(p.req);
+            performanceStats.csRequestWaitTime.stop(!parallelcsinflight()
+                                                    && !(pendingcs && pendingcs->status == REQ_INFLIGHT));
+
+            // errors and retries are handled as for the ordered requests in exec()
+            if (done->status == REQ_SUCCESS && done->in != "-3" && done->in != "-4")
+            {
+                p.id.clear();
+                p.bt.reset();
+
+                if (p.retrying)
+                {
+                    app->notify_retry(0, RETRY_NONE);
+                    p.retrying = false;
+                }
+
+                if (*done->in.c_str() == '[')
+                {
+                    batch.serverresponse(std::move(done->in), this);
+                }
+                else
+                {
+                    std::string requestError;
+                    error e = csrequesterror(done->in, requestError);
+
+                    if (e == API_EBLOCKED && sid.size())
+                    {
+                        block();
+                    }
+
+                    app->request_error(e);
+                    batch.servererror(requestError, this);
+                }
+                continue;
+            }
+
+            if (done->sslcheckfailed)
+            {
+                sendevent(99453, "Invalid public key");
+                sslfakeissuer = done->sslfakeissuer;
+                app->request_error(API_ESSL);
+                sslfakeissuer.clear();
+
+                if (!retryessl)
+                {
+                    p.id.clear();
+                    p.retrying = false;
+                    batch.servererror(std::to_string(API_ESSL), this);
+                    continue;
+                }
+            }
+
+            // API_EAGAIN, rate limit, server busy or no connectivity: repeat with capped exponential backoff
+            p.bt.backoff();
+            app->notify_retry(p.bt.retryin(), csretryreason(*done));
+            p.retrying = true;
+            LOG_warn << "Retrying parallel cs request in " << p.bt.retryin() << " ds";
+            batch.requeuerequest();
+            continue;
+        }
+
+        if (p.bt.armed() && batch.readyToSend(Waiter::ds))
+        {
+            if (p.id.empty())
+            {
+                // a distinct id, so as not to collide with the ordered requests
+                p.id.resize(sizeof reqid);
+                for (auto& c : p.id)
+                {
+                    c = char('a' + rng.genuint32(26));
+                }
+            }
+
+            p.req.reset(new HttpReq());
+            p.req->protect = true;
+            p.req->logname = clientname + "cs" + std::to_string(i + 1) + " ";
+
+            bool suppressSID = true;
+            bool includesFetchingNodes = false;
+            batch.serverrequest(p.req->out, suppressSID, includesFetchingNodes);
+            assert(!includesFetchingNodes);
+
+            p.req->posturl = csurl(p.id.data(), p.id.size(), suppressSID);
+            p.req->type = REQ_JSON;
+
+            performanceStats.csRequestWaitTime.start();
+            p.req->post(this);
+        }
+    }
+}
+
 // nonblocking state machine executing all operations currently in progress
 void MegaClient::exec()
 {
@@ -1557,6 +1802,14 @@ void MegaClient::exec()
         }
     }
 
+    // logins whose password derivation finished on the shared pool
+    checkKeyDerivations();
+
+#ifdef USE_MEDIAINFO
+    // media attributes of transfers whose extraction finished on the shared pool
+    checkMediaExtractions();
+#endif
+
     bool first = true;
     do
     {
@@ -1922,7 +2175,7 @@ void MegaClient::exec()
 
                 if (pendingcs->status == REQ_SUCCESS || pendingcs->status == REQ_FAILURE)
                 {
-                    performanceStats.csRequestWaitTime.stop();
+                    performanceStats.csRequestWaitTime.stop(!parallelcsinflight());
                 }
 
                 switch (static_cast<reqstatus_t>(pendingcs->status))
@@ -1947,17 +2200,44 @@ void MegaClient::exec()
                                 pendingcs->notifiedbufpos = pendingcs->bufpos;
                             }
                         }
+
+                        if (mFetchNodesScanner && !readfetchnodesstream())
+                        {
+                            // the input is gone, so fetch it again and parse it the usual way
+                            pendingcs->status = REQ_FAILURE;
+                            continue;
+                        }
                         break;
 
                     case REQ_SUCCESS:
                         abortlockrequest();
                         app->request_response_progress(pendingcs->bufpos, -1);
 
+                        if (mFetchNodesScanner)
+                        {
+                            if (!readfetchnodesstream())
+                            {
+                                pendingcs->status = REQ_FAILURE;
+                                continue;
+                            }
+
+                            if (mFetchNodesStreamed)
+                            {
+                                // what remains starts at the closing bracket of the node list:
+                                // restore the prefix so the command sees an empty one
+                                pendingcs->in.replace(0, pendingcs->inpurge, FETCHNODES_PREFIX);
+                                pendingcs->inpurge = 0;
+                            }
+
+                            mFetchNodesScanner.reset();
+                        }
+
                         if (pendingcs->in != "-3" && pendingcs->in != "-4")
                         {
                             if (*pendingcs->in.c_str() == '[')
                             {
                                 CodeCounter::ScopeTimer ccst(performanceStats.csSuccessProcessingTime);
+                                ExecLoopProfiler::Scope lps(loopProfiler, ExecLoopProfiler::CS);
 
                                 if (fetchingnodes && fnstats.timeToFirstByte == NEVER)
                                 {
@@ -1983,11 +2263,7 @@ void MegaClient::exec()
                                 if (sctable && pendingsccommit && !reqs.cmdspending())
                                 {
                                     LOG_debug << "Executing postponed DB commit 2";
-                                    sctable->commit();
-                                    assert(!sctable->inTransaction());
-                                    sctable->begin();
-                                    app->notify_dbcommit();
-                                    pendingsccommit = false;
+                                    commitsc();
                                 }
 
                                 // increment unique request ID
@@ -2013,33 +2289,8 @@ void MegaClient::exec()
                             else
                             {
                                 // request failed
-                                JSON json;
-                                json.pos = pendingcs->in.c_str();
                                 std::string requestError;
-                                error e;
-                                bool valid = json.storeobject(&requestError);
-                                if (valid)
-                                {
-                                    if (strncmp(requestError.c_str(), "{\"err\":", 7) == 0)
-                                    {
-                                        e = (error)atoi(requestError.c_str() + 7);
-                                    }
-                                    else
-                                    {
-                                        e = (error)atoi(requestError.c_str());
-                                    }
-                                }
-                                else
-                                {
-                                    e = API_EINTERNAL;
-                                    requestError = std::to_string(e);
-                                }
-
-                                if (!e)
-                                {
-                                    e = API_EINTERNAL;
-                                    requestError = std::to_string(e);
-                                }
+                                error e = csrequesterror(pendingcs->in, requestError);
 
                                 if (e == API_EBLOCKED && sid.size())
                                 {
@@ -2076,20 +2327,9 @@ void MegaClient::exec()
 
                     // fall through
                     case REQ_FAILURE:
-                        if (!reason && pendingcs->httpstatus != 200)
+                        if (!reason)
                         {
-                            if (pendingcs->httpstatus == 500)
-                            {
-                                reason = RETRY_SERVERS_BUSY;
-                            }
-                            else if (pendingcs->httpstatus == 0)
-                            {
-                                reason = RETRY_CONNECTIVITY;
-                            }
-                            else
-                            {
-                                reason = RETRY_UNKNOWN;
-                            }
+                            reason = csretryreason(*pendingcs);
                         }
 
                         if (fetchingnodes && pendingcs->httpstatus != 200)
@@ -2148,7 +2388,9 @@ void MegaClient::exec()
 
             if (btcs.armed())
             {
-                if (reqs.cmdspending())
+                flushPutnodesBatches();
+
+                if (reqs.readyToSend(Waiter::ds))
                 {
                     abortlockrequest();
                     pendingcs = new HttpReq();
@@ -2159,21 +2401,17 @@ void MegaClient::exec()
                     bool suppressSID = true;
                     reqs.serverrequest(pendingcs->out, suppressSID, pendingcs->includesFetchingNodes);
 
-                    pendingcs->posturl = httpio->APIURL;
-
-                    pendingcs->posturl.append("cs?id=");
-                    pendingcs->posturl.append(reqid, sizeof reqid);
-                    pendingcs->posturl.append(getAuthURI(suppressSID));
-                    pendingcs->posturl.append(appkey);
+                    pendingcs->posturl = csurl(reqid, sizeof reqid, suppressSID);
+                    pendingcs->type = REQ_JSON;
 
-                    string version = "v=2";
-                    pendingcs->posturl.append("&" + version);
-                    if (lang.size())
+                    mFetchNodesScanner.reset();
+                    mFetchNodesStreamed = false;
+                    if (pendingcs->includesFetchingNodes && httpio->supportsincrementalresponses()
+                            && !mFetchNodesStreamFailed)
                     {
-                        pendingcs->posturl.append("&");
-                        pendingcs->posturl.append(lang);
+                        mFetchNodesScanner = mega::make_unique<JSONArrayScanner>(FETCHNODES_PREFIX);
+                        pendingcs->incremental = true;
                     }
-                    pendingcs->type = REQ_JSON;
 
                     performanceStats.csRequestWaitTime.start();
                     pendingcs->post(this);
@@ -2187,6 +2425,9 @@ void MegaClient::exec()
             break;
         }
 
+        // independent commands don't wait for the ordered batch to come back
+        execparallelcs();
+
         // handle the request for the last 50 UserAlerts
         if (pendingscUserAlerts)
         {
@@ -2384,6 +2625,7 @@ void MegaClient::exec()
             syncops = true;
         }
         syncactivity = false;
+        syncstatecachepending = false;
 
         if (scsn.stopped() || mBlocked || scpaused || !statecurrent || !syncsup)
         {
@@ -2410,7 +2652,7 @@ void MegaClient::exec()
 
         // do not process the SC result until all preconfigured syncs are up and running
         // except if SC packets are required to complete a fetchnodes
-        if (!scpaused && jsonsc.pos && (syncsup || !statecurrent) && !syncdownrequired && !syncdownretry)
+        if (!scpaused && jsonsc.pos && (syncsup || !statecurrent) && !syncdownrequired && !syncdownpartial && !syncdownretry)
 #else
         if (!scpaused && jsonsc.pos)
 #endif
@@ -2428,8 +2670,9 @@ void MegaClient::exec()
 #ifdef ENABLE_SYNC
             else
             {
-                // remote changes require immediate attention of syncdown()
-                syncdownrequired = true;
+                // remote changes require immediate attention of syncdown(),
+                // notifypurge() flags the folders they touched
+                syncdownpartial = true;
                 syncactivity = true;
             }
 #endif
@@ -2587,6 +2830,12 @@ void MegaClient::exec()
             }
         }
 
+        // resume the next batch of cached transfers
+        if (cachedfilespending())
+        {
+            resumecachedfiles(RESUME_FILES_BATCH);
+        }
+
         // fill transfer slots from the queue
         if (nextDispatchTransfersDs <= Waiter::ds)
         {
@@ -2616,8 +2865,12 @@ void MegaClient::exec()
 
         if (!mBlocked) // handle active unpaused transfers
         {
+            ExecLoopProfiler::Scope lps(loopProfiler, ExecLoopProfiler::TRANSFERS);
             TransferDbCommitter committer(tctable);
 
+            // hand the crypto work of all slots to the workers together
+            MegaClientAsyncQueue::Batch cryptoBatch(mAsyncQueue);
+
             while (slotit != tslots.end())
             {
                 transferslot_list::iterator it = slotit;
@@ -2643,6 +2896,8 @@ void MegaClient::exec()
         }
 
 #ifdef ENABLE_SYNC
+        ExecLoopProfiler::Scope syncProfilerScope(loopProfiler, ExecLoopProfiler::SYNC);
+
         // verify filesystem fingerprints, disable deviating syncs
         // (this covers mountovers, some device removals and some failures)
         syncs.forEachRunningSync([&](Sync* sync){
@@ -2678,6 +2933,7 @@ void MegaClient::exec()
                         {
                             syncsup = false;
                             sync->initializing = false;
+                            sync->loadstatecachechildren(sync->localroot.get(), true);
                             LOG_debug << "Initial delayed scan finished. New / modified files: " << sync->dirnotify->notifyq[DirNotify::DIREVENTS].size();
                         }
                         else
@@ -2764,7 +3020,7 @@ void MegaClient::exec()
         // halt all syncing while the local filesystem is pending a lock-blocked operation
         // or while we are fetching nodes
         // FIXME: indicate by callback
-        if (!syncdownretry && !syncadding && statecurrent && !syncdownrequired && !fetchingnodes)
+        if (!syncdownretry && !syncadding && statecurrent && !syncdownrequired && !syncdownpartial && !fetchingnodes)
         {
             // process active syncs, stop doing so while transient local fs ops are pending
             if (syncs.hasRunningSyncs() || syncactivity)
@@ -2831,6 +3087,11 @@ void MegaClient::exec()
 
                         syncs.stopCancelledFailedDisabled();
 
+                        // get the files of all syncs read in the background while they are processed in turn
+                        syncs.forEachRunningSync([&](Sync* sync) {
+                            sync->prefetchfingerprints(q);
+                        });
+
                         syncs.forEachRunningSync_shortcircuit([&](Sync* sync) {
 
                             if (sync->state() == SYNC_ACTIVE || sync->state() == SYNC_INITIALSCAN)
@@ -2949,6 +3210,14 @@ void MegaClient::exec()
                 execsyncdeletions();
                 syncupdate();
 
+                // keep the syncs that have a budget within it
+                if (!totalpending)
+                {
+                    syncs.forEachRunningSync([](Sync* sync) {
+                        sync->unloadColdLocalNodes();
+                    });
+                }
+
                 // notify the app of the length of the pending scan queue
                 if (scanningpending < 4)
                 {
@@ -3116,12 +3385,21 @@ void MegaClient::exec()
                                                 }
                                                 scanfailed = true;
 
+                                                // the rescan tells deleted LocalNodes by their scanseqno, unloaded ones too
+                                                sync->loadstatecachechildren(sync->localroot.get(), true);
                                                 sync->localroot->setSubtreeNeedsRescan(true);
 
                                                 sync->scan(sync->localroot->getLocalname(), NULL);
                                                 sync->dirnotify->mErrorCount = 0;
                                                 sync->fullscan = true;
                                                 sync->scanseqno++;
+                                                sync->mFullRescans++;
+                                            }
+                                            else if (!failed && !fsaccess->notifyfailed
+                                                     && !sync->dirnotify->mErrorCount.load() && !fsaccess->notifyerr)
+                                            {
+                                                // notifications are keeping up, so the state cache follows the change journal
+                                                sync->recordChangeJournalPosition();
                                             }
                                         }
                                     }
@@ -3161,12 +3439,16 @@ void MegaClient::exec()
                 syncdownrequired = true;
             }
 
-            if (syncdownrequired)
+            if (syncdownrequired || syncdownpartial)
             {
+                // anything other than notified remote changes asks for a full walk
+                bool fullWalk = syncdownrequired || Waiter::ds >= mNextSyncdownFullWalkDs;
+
                 syncdownrequired = false;
+                syncdownpartial = false;
                 if (!fetchingnodes)
                 {
-                    LOG_verbose << "Running syncdown";
+                    LOG_verbose << "Running syncdown" << (fullWalk ? "" : " on flagged folders");
                     bool success = true;
                     syncs.forEachRunningSync([&](Sync* sync) {
                         // make sure that the remote synced folder still exists
@@ -3186,7 +3468,12 @@ void MegaClient::exec()
                                 LOG_debug << "Running syncdown on demand: "
                                           << toHandle(sync->getConfig().mBackupId);
 
-                                if (!syncdown(sync->localroot.get(), localpath))
+                                // the initial scan and backups are not left to the flags
+                                bool syncFullWalk = fullWalk
+                                        || sync->state() == SYNC_INITIALSCAN
+                                        || sync->isBackup();
+
+                                if (!syncdown(sync->localroot.get(), localpath, syncFullWalk))
                                 {
                                     // a local filesystem item was locked - schedule periodic retry
                                     // and force a full rescan afterwards as the local item may
@@ -3200,6 +3487,11 @@ void MegaClient::exec()
                         }
                     });
 
+                    if (fullWalk)
+                    {
+                        mNextSyncdownFullWalkDs = Waiter::ds + SYNCDOWN_FULL_WALK_INTERVAL_DS;
+                    }
+
                     // notify the app if a lock is being retried
                     if (success)
                     {
@@ -3243,10 +3535,38 @@ void MegaClient::exec()
             syncscanstate = false;
         }
 
+        syncProfilerScope.stop();
 #endif
 
         notifypurge();
 
+        // no Node* is held at this point of the loop
+        mNodeManager.applyChildrenPrefetch();
+        mNodeManager.evictNodes();
+
+        // a grouped statecache commit is due: no action packets or cs responses are half applied here
+        if (mScCommitsDeferred && sctable && !jsonsc.pos && !pendingcs && !csretrying && !reqs.cmdspending()
+                && Waiter::ds >= mScCommitDeferredSince + mScCommitMaxLagDs)
+        {
+            LOG_debug << "Executing grouped DB commit of " << mScCommitsDeferred << " scsn";
+            commitsc();
+        }
+
+        // refresh the query planner's statistics of the DB now and then, while nothing else is going on
+        if (sctable && statecurrent && !jsonsc.pos && !pendingcs && !reqs.cmdspending() && tslots.empty()
+                && Waiter::ds >= mNextDbOptimizeDs)
+        {
+            if (mNextDbOptimizeDs)
+            {
+                sctable->optimize();
+                mNextDbOptimizeDs = Waiter::ds + DB_OPTIMIZE_INTERVAL_DS;
+            }
+            else
+            {
+                mNextDbOptimizeDs = Waiter::ds + DB_OPTIMIZE_DELAY_DS;
+            }
+        }
+
         if (!badhostcs && badhosts.size() && btbadhost.armed())
         {
             // report hosts affected by failed requests
@@ -3319,7 +3639,7 @@ void MegaClient::exec()
 
         httpio->updatedownloadspeed();
         httpio->updateuploadspeed();
-    } while (httpio->doio() || execdirectreads() || (!pendingcs && reqs.cmdspending() && btcs.armed()) || looprequested);
+    } while (httpio->doio() || execdirectreads() || (!pendingcs && (reqs.readyToSend(Waiter::ds) || nextPutnodesBatchDs() <= Waiter::ds) && btcs.armed()) || parallelcsready() || looprequested);
 
 
     NodeCounter nc = mNodeManager.getCounterOfRootNodes();
@@ -3340,7 +3660,7 @@ void MegaClient::exec()
     if (Waiter::ds > lasttime + reportFreqDs)
     {
         lasttime = Waiter::ds;
-        LOG_info << performanceStats.report(false, httpio, waiter, reqs);
+        LOG_info << performanceStats.report(false, httpio, waiter, reqs, mAsyncQueue, mNodeManager);
 
         debugLogHeapUsage();
     }
@@ -3355,6 +3675,8 @@ void MegaClient::exec()
 #endif
 
     reportLoggedInChanges();
+
+    loopProfiler.endIteration();
 }
 
 // get next event time from all subsystems, then invoke the waiter if needed
@@ -3373,6 +3695,7 @@ int MegaClient::wait()
 
 int MegaClient::preparewait()
 {
+    loopProfiler.beginIteration();
     CodeCounter::ScopeTimer ccst(performanceStats.prepareWait);
 
     dstime nds;
@@ -3383,7 +3706,7 @@ int MegaClient::preparewait()
 #ifdef ENABLE_SYNC
     // sync directory scans in progress or still processing sc packet without having
     // encountered a locally locked item? don't wait.
-    if (syncactivity || syncdownrequired || (!scpaused && jsonsc.pos && (syncsup || !statecurrent) && !syncdownretry))
+    if (syncactivity || syncstatecachepending || syncdownrequired || syncdownpartial || (!scpaused && jsonsc.pos && (syncsup || !statecurrent) && !syncdownretry))
     {
         nds = Waiter::ds;
     }
@@ -3399,6 +3722,18 @@ int MegaClient::preparewait()
             nds = Waiter::ds;
         }
 
+        if (cachedfilespending())
+        {
+            // more cached transfers to resume
+            nds = Waiter::ds;
+        }
+
+        if (!scpaused && jsonsc.pos)
+        {
+            // the rest of a partially applied sc batch
+            nds = Waiter::ds;
+        }
+
         nexttransferretry(PUT, &nds);
         nexttransferretry(GET, &nds);
 
@@ -3411,6 +3746,16 @@ int MegaClient::preparewait()
             nds = nextDispatchTransfersDs > Waiter::ds ? nextDispatchTransfersDs : Waiter::ds;
         }
 
+        // grouped statecache commit
+        if (mScCommitsDeferred)
+        {
+            dstime commitds = std::max(mScCommitDeferredSince + mScCommitMaxLagDs, Waiter::ds);
+            if (commitds < nds)
+            {
+                nds = commitds;
+            }
+        }
+
         for (pendinghttp_map::iterator it = pendinghttp.begin(); it != pendinghttp.end(); it++)
         {
             if (it->second->isbtactive)
@@ -3428,6 +3773,55 @@ int MegaClient::preparewait()
         if (!pendingcs)
         {
             btcs.update(&nds);
+
+            // or send a batch that waited for more commands
+            if (reqs.cmdspending() && btcs.armed())
+            {
+                dstime sendds = std::max(reqs.nextSendDs(), Waiter::ds);
+                if (sendds < nds)
+                {
+                    nds = sendds;
+                }
+            }
+
+            // or complete uploads that waited for others to finish too
+            if (!mPutnodesBatches.empty() && btcs.armed())
+            {
+                dstime sendds = std::max(nextPutnodesBatchDs(), Waiter::ds);
+                if (sendds < nds)
+                {
+                    nds = sendds;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < parallelcs.size(); i++)
+        {
+            ParallelCs& p = *parallelcs[i];
+            if (p.req)
+            {
+                if (p.req->status == REQ_INFLIGHT && EVER(p.req->lastdata))
+                {
+                    dstime timeout = std::max(p.req->lastdata + HttpIO::REQUESTTIMEOUT, Waiter::ds);
+                    if (timeout < nds)
+                    {
+                        nds = timeout;
+                    }
+                }
+            }
+            else
+            {
+                p.bt.update(&nds);
+
+                if (reqs.parallel(i).cmdspending() && p.bt.armed())
+                {
+                    dstime sendds = std::max(reqs.parallel(i).nextSendDs(), Waiter::ds);
+                    if (sendds < nds)
+                    {
+                        nds = sendds;
+                    }
+                }
+            }
         }
 
         // retry failed server-client requests
@@ -3512,7 +3906,7 @@ int MegaClient::preparewait()
 
         // retrying of transient failed read ops
         if (syncfslockretry && !syncdownretry && !syncadding
-                && statecurrent && !syncdownrequired && !syncfsopsfailed)
+                && statecurrent && !syncdownrequired && !syncdownpartial && !syncfsopsfailed)
         {
             LOG_debug << "Waiting for a temporary error checking filesystem notification";
             syncfslockretrybt.update(&nds);
@@ -3675,6 +4069,7 @@ int MegaClient::preparewait()
 int MegaClient::dowait()
 {
     CodeCounter::ScopeTimer ccst(performanceStats.doWait);
+    ExecLoopProfiler::Scope lps(loopProfiler, ExecLoopProfiler::WAIT);
 
     return waiter->wait();
 }
@@ -3683,10 +4078,15 @@ int MegaClient::checkevents()
 {
     CodeCounter::ScopeTimer ccst(performanceStats.checkEvents);
 
-    int r =  httpio->checkevents(waiter);
+    int r;
+    {
+        ExecLoopProfiler::Scope lps(loopProfiler, ExecLoopProfiler::HTTPIO);
+        r = httpio->checkevents(waiter);
+    }
     r |= fsaccess->checkevents(waiter);
     if (gfx)
     {
+        ExecLoopProfiler::Scope lps(loopProfiler, ExecLoopProfiler::GFX);
         r |= gfx->checkevents(waiter);
     }
     return r;
@@ -3812,6 +4212,7 @@ void MegaClient::dispatchTransfers()
     }
 
     CodeCounter::ScopeTimer ccst(performanceStats.dispatchTransfers);
+    ExecLoopProfiler::Scope lps(loopProfiler, ExecLoopProfiler::TRANSFERS);
 
     struct counter
     {
@@ -3996,18 +4397,40 @@ void MegaClient::dispatchTransfers()
                 app->transfer_prepare(nexttransfer);
             }
 
-            bool openok = false;
-            bool openfinished = false;
-
-            // verify that a local path was given and start/resume transfer
-            if (!nexttransfer->localfilename.empty())
+            // a fresh download whose content is known locally is copied from there first, off this thread
+            if (nexttransfer->type == GET && localdownloaddedup && !nexttransfer->slot && !nexttransfer->progresscompleted)
             {
-                TransferSlot *ts = nullptr;
-
-                if (!nexttransfer->slot)
+                if (!nexttransfer->localcopy)
                 {
-                    // allocate transfer slot
-                    ts = new TransferSlot(nexttransfer);
+                    startDownloadFromLocalCopy(nexttransfer);
+                }
+
+                if (nexttransfer->localcopy && !nexttransfer->localcopy->done)
+                {
+                    // still copying: the transfer waits for it rather than taking a slot
+                    continue;
+                }
+
+                if (nexttransfer->localcopy && !nexttransfer->localcopy->copied)
+                {
+                    // stale hint, or the copy didn't match the node: download as usual, and don't offer that file again
+                    LOG_warn << "Local copy not usable, downloading instead: " << nexttransfer->localcopy->source;
+                    localFingerprints.remove(*nexttransfer);
+                }
+            }
+
+            bool openok = false;
+            bool openfinished = false;
+
+            // verify that a local path was given and start/resume transfer
+            if (!nexttransfer->localfilename.empty())
+            {
+                TransferSlot *ts = nullptr;
+
+                if (!nexttransfer->slot)
+                {
+                    // allocate transfer slot
+                    ts = new TransferSlot(nexttransfer);
                 }
                 else
                 {
@@ -4166,6 +4589,34 @@ void MegaClient::dispatchTransfers()
                         }
                     }
 
+                    if (nexttransfer->type == GET && nexttransfer->localcopy && nexttransfer->localcopy->copied
+                            && !nexttransfer->progresscompleted)
+                    {
+                        // same content already copied and verified: no need to fetch it, complete straight away
+                        nexttransfer->localcopy->copied = false;
+                        ts->slots_it = tslots.insert(tslots.begin(), ts);
+                        for (file_list::iterator it = nexttransfer->files.begin();
+                            it != nexttransfer->files.end(); it++)
+                        {
+                            (*it)->start();
+                        }
+                        nexttransfer->progresscompleted = nexttransfer->size;
+                        ts->progressreported = nexttransfer->size;
+                        app->transfer_update(nexttransfer);
+                        performanceStats.transferStarts += 1;
+
+                        nexttransfer->complete(committer);
+                        continue;
+                    }
+
+                    // claim the space before any bytes arrive, and lay the file out in one piece
+                    if (nexttransfer->type == GET && nexttransfer->size > 0 && !ts->fa->fpreallocate(nexttransfer->size))
+                    {
+                        LOG_err << "Insufficient space available for download: " << nexttransfer->localfilename;
+                        nexttransfer->failed(LOCAL_ENOSPC, committer);
+                        continue;
+                    }
+
                     // dispatch request for temporary source/target URL
                     if (nexttransfer->tempurls.size())
                     {
@@ -4174,6 +4625,7 @@ void MegaClient::dispatchTransfers()
                     }
                     else
                     {
+                        nexttransfer->timeline.mark(TransferTimeline::URL_REQUESTED);
                         reqs.add((ts->pendingcmd = (nexttransfer->type == PUT)
                             ? (Command*)new CommandPutFile(this, ts, putmbpscap)
                             : new CommandGetFile(this, ts->transfer->transferkey.data(), SymmCipher::KEYLENGTH,
@@ -4220,6 +4672,7 @@ void MegaClient::dispatchTransfers()
 
                             if ((tempurls.size() == 1 || tempurls.size() == RAIDPARTS) && s >= 0)
                             {
+                                tslot->transfer->timeline.mark(TransferTimeline::URL_RECEIVED);
                                 tslot->transfer->tempurls = tempurls;
                                 tslot->transferbuf.setIsRaid(tslot->transfer, tempurls, tslot->transfer->pos, tslot->maxRequestSize);
                                 tslot->progress();
@@ -4279,6 +4732,115 @@ void MegaClient::dispatchTransfers()
     }
 }
 
+void MegaClient::startDownloadFromLocalCopy(Transfer* t)
+{
+    LocalPath source;
+    if (!t->isvalid || t->size <= 0 || !localFingerprints.find(*t, source) || source == t->localfilename)
+    {
+        return;
+    }
+
+    auto job = std::make_shared<LocalDownloadCopy>();
+    job->source = source;
+    job->target = t->localfilename;
+    job->fingerprint = *t;
+    job->key = t->transferkey;
+    job->ctriv = t->ctriv;
+    job->metamac = t->metamac;
+    t->localcopy = job;
+
+    LOG_debug << "Download content found locally, copying from " << source;
+
+    // the whole file is read and maybe written: not something for the client thread
+    mAsyncQueue.push([job](SymmCipher&) { job->run(); }, false);
+}
+
+void LocalDownloadCopy::run()
+{
+    {
+        // worker threads share nothing with the client, so the job has its own filesystem access
+        std::unique_ptr<FileSystemAccess> fsAccess(new FSACCESS_CLASS());
+
+        copied = copy(*fsAccess);
+
+        if (!copied)
+        {
+            fsAccess->unlinklocal(target);
+        }
+    }
+
+    done = true;
+}
+
+bool LocalDownloadCopy::copy(FileSystemAccess& fsAccess)
+{
+    // the index only holds hints: the file must still have exactly this content
+    auto in = fsAccess.newfileaccess();
+    if (!in->fopen(source, true, false) || in->type != FILENODE)
+    {
+        return false;
+    }
+
+    FileFingerprint fp;
+    fp.genfingerprint(in.get());
+    if (!fp.isvalid || !(fp == fingerprint))
+    {
+        return false;
+    }
+
+    // share the blocks where the filesystem can; the MAC is then taken over the clone
+    bool cloned = fsAccess.cloneFile(source, target, fingerprint.mtime);
+
+    auto out = fsAccess.newfileaccess();
+    if (cloned)
+    {
+        in = fsAccess.newfileaccess();
+        if (!in->fopen(target, true, false))
+        {
+            return false;
+        }
+    }
+    else if (!out->fopen(target, false, true))
+    {
+        return false;
+    }
+
+    // the same chunk MACs a download computes, so that the content is checked against the node's MAC
+    SymmCipher cipher;
+    cipher.setkey(key.data());
+    chunkmac_map chunkmacs;
+
+    std::unique_ptr<byte[]> buf(new byte[size_t(std::min<m_off_t>(fingerprint.size, 1 << 20)) + SymmCipher::BLOCKSIZE]);
+    for (m_off_t pos = 0; pos < fingerprint.size; )
+    {
+        if (cancelled)
+        {
+            return false;
+        }
+
+        m_off_t end = ChunkedHash::chunkceil(pos, fingerprint.size);
+        unsigned n = unsigned(end - pos);
+
+        if (!in->frawread(buf.get(), n, pos, true) || (!cloned && !out->fwrite(buf.get(), n, pos)))
+        {
+            LOG_warn << "Local copy failed: " << source;
+            return false;
+        }
+
+        memset(buf.get() + n, 0, SymmCipher::BLOCKSIZE);
+        chunkmacs.ctr_encrypt(pos, &cipher, buf.get(), n, pos, ctriv, true);
+        pos = end;
+    }
+
+    if (chunkmacs.macsmac(&cipher) != metamac)
+    {
+        LOG_warn << "Local copy doesn't match the node's MAC: " << source;
+        return false;
+    }
+
+    return !cancelled;
+}
+
 // do we have an upload that is still waiting for file attributes before being completed?
 void MegaClient::checkfacompletion(UploadHandle th, Transfer* t, bool uploadCompleted)
 {
@@ -4373,6 +4935,16 @@ void MegaClient::disconnect()
         pendingcs->disconnect();
     }
 
+    for (auto& p : parallelcs)
+    {
+        if (p->req && p->req->status == REQ_INFLIGHT)
+        {
+            // sent again on a new connection
+            p->req->disconnect();
+            p->req->status = REQ_FAILURE;
+        }
+    }
+
     if (pendingsc)
     {
         pendingsc->disconnect();
@@ -4504,8 +5076,11 @@ void MegaClient::locallogout(bool removecaches, bool keepSyncsConfigFile)
     }
 
     sctable.reset();
+    mScStoredRecords.clear();
     mNodeManager.setTable(nullptr);
     pendingsccommit = false;
+    mScCommitsDeferred = 0;
+    mNextDbOptimizeDs = 0;
 
     statusTable.reset();
 
@@ -4544,6 +5119,13 @@ void MegaClient::locallogout(bool removecaches, bool keepSyncsConfigFile)
     mSfuid = sfu_invalid_id;
 #endif
 
+    // don't let a login that was still deriving its key start after logout
+    cancelKeyDerivations();
+
+#ifdef USE_MEDIAINFO
+    cancelMediaExtractions();
+#endif
+
     // remove any cached transfers older than two days that have not been resumed (updates transfer list)
     purgeOrphanTransfers();
 
@@ -4559,13 +5141,27 @@ void MegaClient::locallogout(bool removecaches, bool keepSyncsConfigFile)
     freeq(GET);  // freeq after closetc due to optimizations
     freeq(PUT);
 
+    // no transfers left, so hand the cached chunk buffers back to the OS
+    TransferBufferPool::trim();
+
+    // local copies seen by this session are not to be reused by the next account
+    localFingerprints.clear();
+
     purgenodesusersabortsc(false);
     mNodeManager.reset();
 
+    mPutnodesBatches.clear();
     reqs.clear();
+    mPendingGetUA.clear();
 
     delete pendingcs;
     pendingcs = NULL;
+    for (auto& p : parallelcs)
+    {
+        p->req.reset();
+        p->id.clear();
+        p->bt.reset();
+    }
     scsn.clear();
     mBlocked = false;
     mBlockedSet = false;
@@ -4674,6 +5270,7 @@ void MegaClient::removeCaches()
         mNodeManager.setTable(nullptr);
         sctable->remove();
         sctable.reset();
+        mScStoredRecords.clear();
         pendingsccommit = false;
     }
 
@@ -4790,6 +5387,11 @@ void MegaClient::httprequest(const char *url, int method, bool binary, const cha
 bool MegaClient::procsc()
 {
     CodeCounter::ScopeTimer ccst(performanceStats.scProcessingTime);
+    ExecLoopProfiler::Scope lps(loopProfiler, ExecLoopProfiler::SC);
+
+    // a batch of packets moving many nodes updates the same ancestors over and over:
+    // notify each of them once, when the batch is purged
+    NodeManager::CounterBatch counterBatch(mNodeManager);
 
     nameid name;
 
@@ -4800,6 +5402,7 @@ bool MegaClient::procsc()
     bool newnodes = false;
 #endif
     Node* dn = NULL;
+    size_t catchupPackets = 0;
 
     for (;;)
     {
@@ -4824,11 +5427,10 @@ bool MegaClient::procsc()
                     {
                         if (!pendingcs && !csretrying && !reqs.cmdspending())
                         {
-                            sctable->commit();
-                            assert(!sctable->inTransaction());
-                            sctable->begin();
-                            app->notify_dbcommit();
-                            pendingsccommit = false;
+                            if (!deferScCommit())
+                            {
+                                commitsc();
+                            }
                         }
                         else
                         {
@@ -4912,27 +5514,9 @@ bool MegaClient::procsc()
                             notifyStorageChangeOnStateCurrent = false;
                         }
 
-                        if (tctable && cachedfiles.size())
+                        if (cachedfilespending())
                         {
-                            TransferDbCommitter committer(tctable);
-                            for (unsigned int i = 0; i < cachedfiles.size(); i++)
-                            {
-                                direction_t type = NONE;
-                                File *file = app->file_resume(&cachedfiles.at(i), &type);
-                                if (!file || (type != GET && type != PUT))
-                                {
-                                    tctable->del(cachedfilesdbids.at(i));
-                                    continue;
-                                }
-                                file->dbid = cachedfilesdbids.at(i);
-                                if (!startxfer(type, file, committer, false, false, false, UseLocalVersioningFlag, nullptr, nextreqtag()))  // TODO: should we have serialized these flags and restored them?
-                                {
-                                    tctable->del(cachedfilesdbids.at(i));
-                                    continue;
-                                }
-                            }
-                            cachedfiles.clear();
-                            cachedfilesdbids.clear();
+                            resumecachedfiles(RESUME_FILES_BATCH);
                         }
 
                         WAIT_CLASS::bumpds();
@@ -5066,7 +5650,9 @@ bool MegaClient::procsc()
                                 dn = sc_deltree();
 
 #ifdef ENABLE_SYNC
-                                if (fetchingnodes)
+                                // nodes already removed (eg. versions, see NodeManager::removeVersions())
+                                // leave nothing for syncdown() to process
+                                if (fetchingnodes || !dn)
                                 {
                                     break;
                                 }
@@ -5236,6 +5822,18 @@ bool MegaClient::procsc()
                 }
 
                 jsonsc.leaveobject();
+
+                // while catching up, the cached nodes are already being served:
+                // apply the backlog a slice at a time so exec() keeps handling
+                // requests and transfers in between. Same for any batch that
+                // has used up the sc time budget of this iteration
+                if (!fetchingnodes
+                 && ((!statecurrent && ++catchupPackets >= MAX_CATCHUP_PACKETS_PER_EXEC)
+                  || loopProfiler.overBudget(ExecLoopProfiler::SC)))
+                {
+                    applykeys();
+                    return false;
+                }
             }
             else
             {
@@ -5363,6 +5961,8 @@ void MegaClient::initsc()
 
         assert(sctable->inTransaction());
         sctable->truncate();
+        mScStoredRecords.clear();
+        size_t unchanged = 0;
 
         // 1. write current scsn
         handle tscsn = scsn.getHandle();
@@ -5373,7 +5973,7 @@ void MegaClient::initsc()
             // 2. write all users
             for (user_map::iterator it = users.begin(); it != users.end(); it++)
             {
-                if (!(complete = sctable->put(CACHEDUSER, &it->second, &key)))
+                if (!(complete = putsc(CACHEDUSER, &it->second, unchanged)))
                 {
                     break;
                 }
@@ -5385,7 +5985,7 @@ void MegaClient::initsc()
             // 4. write new or modified pcrs, purge deleted pcrs
             for (handlepcr_map::iterator it = pcrindex.begin(); it != pcrindex.end(); it++)
             {
-                if (!(complete = sctable->put(CACHEDPCR, it->second.get(), &key)))
+                if (!(complete = putsc(CACHEDPCR, it->second.get(), unchanged)))
                 {
                     break;
                 }
@@ -5412,7 +6012,7 @@ void MegaClient::initsc()
             // 7. write new or modified chats
             for (textchat_map::iterator it = chats.begin(); it != chats.end(); it++)
             {
-                if (!(complete = sctable->put(CACHEDCHAT, it->second, &key)))
+                if (!(complete = putsc(CACHEDCHAT, it->second, unchanged)))
                 {
                     break;
                 }
@@ -5474,6 +6074,7 @@ void MegaClient::updatesc()
         }
 
         bool complete;
+        size_t unchanged = 0;
 
         // 1. update associated scsn
         handle tscsn = scsn.getHandle();
@@ -5490,7 +6091,7 @@ void MegaClient::updatesc()
                     if ((*it)->dbid)
                     {
                         LOG_verbose << clientname << "Removing inactive user from database: " << (Base64::btoa((byte*)&((*it)->userhandle),MegaClient::USERHANDLE,base64) ? base64 : "");
-                        if (!(complete = sctable->del((*it)->dbid)))
+                        if (!(complete = delsc((*it)->dbid)))
                         {
                             break;
                         }
@@ -5499,7 +6100,7 @@ void MegaClient::updatesc()
                 else
                 {
                     LOG_verbose << clientname << "Adding/updating user to database: " << (Base64::btoa((byte*)&((*it)->userhandle),MegaClient::USERHANDLE,base64) ? base64 : "");
-                    if (!(complete = sctable->put(CACHEDUSER, *it, &key)))
+                    if (!(complete = putsc(CACHEDUSER, *it, unchanged)))
                     {
                         break;
                     }
@@ -5521,7 +6122,7 @@ void MegaClient::updatesc()
                     if ((*it)->dbid)
                     {
                         LOG_verbose << "Removing pcr from database: " << (Base64::btoa((byte*)&((*it)->id),MegaClient::PCRHANDLE,base64) ? base64 : "");
-                        if (!(complete = sctable->del((*it)->dbid)))
+                        if (!(complete = delsc((*it)->dbid)))
                         {
                             break;
                         }
@@ -5530,7 +6131,7 @@ void MegaClient::updatesc()
                 else if (!(*it)->removed())
                 {
                     LOG_verbose << "Adding pcr to database: " << (Base64::btoa((byte*)&((*it)->id),MegaClient::PCRHANDLE,base64) ? base64 : "");
-                    if (!(complete = sctable->put(CACHEDPCR, *it, &key)))
+                    if (!(complete = putsc(CACHEDPCR, *it, unchanged)))
                     {
                         break;
                     }
@@ -5558,15 +6159,15 @@ void MegaClient::updatesc()
             {
                 char base64[12];
                 LOG_verbose << "Adding chat to database: " << (Base64::btoa((byte*)&(it->second->id),MegaClient::CHATHANDLE,base64) ? base64 : "");
-                if (!(complete = sctable->put(CACHEDCHAT, it->second, &key)))
+                if (!(complete = putsc(CACHEDCHAT, it->second, unchanged)))
                 {
                     break;
                 }
             }
         }
-        LOG_debug << "Saving SCSN " << scsn.text() << " with " << mNodeManager.nodeNotifySize() << " modified nodes, " << usernotify.size() << " users, " << pcrnotify.size() << " pcrs and " << chatnotify.size() << " chats to local cache (" << complete << ")";
+        LOG_debug << "Saving SCSN " << scsn.text() << " with " << mNodeManager.nodeNotifySize() << " modified nodes, " << usernotify.size() << " users, " << pcrnotify.size() << " pcrs and " << chatnotify.size() << " chats (" << unchanged << " unchanged) to local cache (" << complete << ")";
 #else
-        LOG_debug << "Saving SCSN " << scsn.text() << " with " << mNodeManager.nodeNotifySize() << " modified nodes, " << usernotify.size() << " users and " << pcrnotify.size() << " pcrs to local cache (" << complete << ")";
+        LOG_debug << "Saving SCSN " << scsn.text() << " with " << mNodeManager.nodeNotifySize() << " modified nodes, " << usernotify.size() << " users and " << pcrnotify.size() << " pcrs (" << unchanged << " unchanged) to local cache (" << complete << ")";
 #endif
         finalizesc(complete);
     }
@@ -5587,20 +6188,102 @@ void MegaClient::finalizesc(bool complete)
     }
 }
 
-// queue node file attribute for retrieval or cancel retrieval
-error MegaClient::getfa(handle h, string *fileattrstring, const string &nodekey, fatype t, int cancel)
+bool MegaClient::putsc(uint32_t type, Cacheable* record, size_t& unchanged)
 {
-    assert((cancel && nodekey.empty()) ||
-          (!cancel && !nodekey.empty()));
+    string data;
+    if (!record->serialize(&data))
+    {
+        // as DbTable::put(), skip it and keep saving the rest
+        LOG_warn << "Serialization failed: " << type;
+        return true;
+    }
+
+    std::pair<size_t, size_t> stored(data.size(), std::hash<string>()(data));
+    if (record->dbid)
+    {
+        auto it = mScStoredRecords.find(record->dbid);
+        if (it != mScStoredRecords.end() && it->second == stored)
+        {
+            ++unchanged;
+            return true;
+        }
+    }
+
+    if (!sctable->putserialized(type, record, &data, &key))
+    {
+        return false;
+    }
+
+    mScStoredRecords[record->dbid] = stored;
+    return true;
+}
+
+bool MegaClient::delsc(uint32_t dbid)
+{
+    mScStoredRecords.erase(dbid);
+    return sctable->del(dbid);
+}
+
+void MegaClient::notescrecord(uint32_t dbid, const string& data)
+{
+    mScStoredRecords[dbid] = std::make_pair(data.size(), std::hash<string>()(data));
+}
+
+void MegaClient::commitsc()
+{
+    ExecLoopProfiler::Scope lps(loopProfiler, ExecLoopProfiler::DB_COMMIT);
+    sctable->commit();
+    assert(!sctable->inTransaction());
+    sctable->begin();
+    app->notify_dbcommit();
+    pendingsccommit = false;
+    mScCommitsDeferred = 0;
+}
+
+bool MegaClient::deferScCommit()
+{
+    if (!mScCommitMaxLagDs)
+    {
+        return false;
+    }
+
+    if (!mScCommitsDeferred)
+    {
+        mScCommitDeferredSince = Waiter::ds;
+    }
+
+    ++mScCommitsDeferred;
+    if ((mScCommitMaxPending && mScCommitsDeferred >= mScCommitMaxPending)
+            || Waiter::ds >= mScCommitDeferredSince + mScCommitMaxLagDs)
+    {
+        return false;
+    }
+
+    return true;
+}
 
+void MegaClient::setScCommitGrouping(dstime maxLagDs, unsigned maxPending)
+{
+    mScCommitMaxLagDs = maxLagDs;
+    mScCommitMaxPending = maxPending;
+
+    // anything waiting is committed by the next exec() that can
+    if (!mScCommitMaxLagDs && mScCommitsDeferred)
+    {
+        mScCommitDeferredSince = Waiter::ds;
+    }
+}
+
+// queue node file attribute for retrieval or cancel retrieval
+bool MegaClient::fileattributehandle(const string *fileattrstring, fatype t, handle* fah, int* cluster)
+{
     // locate this file attribute type in the nodes's attribute string
-    handle fah;
     int p, pp;
 
     // find position of file attribute or 0 if not present
     if (!(p = Node::hasfileattribute(fileattrstring, t)))
     {
-        return API_ENOENT;
+        return false;
     }
 
     pp = p - 1;
@@ -5612,15 +6295,30 @@ error MegaClient::getfa(handle h, string *fileattrstring, const string &nodekey,
 
     if (p == pp)
     {
-        return API_ENOENT;
+        return false;
     }
 
-    if (Base64::atob(strchr(fileattrstring->c_str() + p, '*') + 1, (byte*)&fah, sizeof(fah)) != sizeof(fah))
+    if (Base64::atob(strchr(fileattrstring->c_str() + p, '*') + 1, (byte*)fah, sizeof(*fah)) != sizeof(*fah))
     {
-        return API_ENOENT;
+        return false;
     }
 
-    int c = atoi(fileattrstring->c_str() + pp);
+    *cluster = atoi(fileattrstring->c_str() + pp);
+    return true;
+}
+
+error MegaClient::getfa(handle h, string *fileattrstring, const string &nodekey, fatype t, int cancel)
+{
+    assert((cancel && nodekey.empty()) ||
+          (!cancel && !nodekey.empty()));
+
+    handle fah;
+    int c;
+
+    if (!fileattributehandle(fileattrstring, t, &fah, &c))
+    {
+        return API_ENOENT;
+    }
 
     if (cancel)
     {
@@ -5665,12 +6363,20 @@ error MegaClient::getfa(handle h, string *fileattrstring, const string &nodekey,
         {
             (*fafcp)->fahref = fah;
 
+            // an idle channel waits a moment for more fetches, to send them together
+            if (!(*fafcp)->fafs[0].size() && !(*fafcp)->fafs[1].size()
+                    && (*fafcp)->req.status != REQ_INFLIGHT && (*fafcp)->bt.armed())
+            {
+                (*fafcp)->bt.backoff(FileAttributeFetchChannel::COALESCE_DS);
+            }
+
             // map returned handle to type/node upon retrieval response
             FileAttributeFetch** fafp = &(*fafcp)->fafs[0][fah];
 
             if (!*fafp)
             {
                 *fafp = new FileAttributeFetch(h, nodekey, t, reqtag);
+                (*fafp)->seq = (*fafcp)->nextseq++;
             }
             else
             {
@@ -5689,6 +6395,39 @@ error MegaClient::getfa(handle h, string *fileattrstring, const string &nodekey,
     }
 }
 
+void MegaClient::cancelgetfaexcept(fatype t, const std::set<handle>& keep, std::vector<handle>& cancelled)
+{
+    for (fafc_map::iterator cit = fafcs.begin(); cit != fafcs.end(); cit++)
+    {
+        FileAttributeFetchChannel* fc = cit->second;
+        bool removed = false;
+
+        for (int i = 2; i--; )
+        {
+            for (faf_map::iterator it = fc->fafs[i].begin(); it != fc->fafs[i].end(); )
+            {
+                if (it->second->type == t && !keep.count(it->second->nodehandle))
+                {
+                    cancelled.push_back(it->second->nodehandle);
+                    delete it->second;
+                    fc->fafs[i].erase(it++);
+                    removed = true;
+                }
+                else
+                {
+                    it++;
+                }
+            }
+        }
+
+        // none left: tear down connection
+        if (removed && !fc->fafs[1].size() && fc->req.status == REQ_INFLIGHT)
+        {
+            fc->req.disconnect();
+        }
+    }
+}
+
 // build pending attribute string for this handle and remove
 void MegaClient::pendingattrstring(UploadHandle h, string* fa)
 {
@@ -5863,7 +6602,7 @@ void MegaClient::sc_updatenode()
                             notify = true;
                         }
 
-                        if (a && ((n->attrstring && strcmp(n->attrstring->c_str(), a)) || !n->attrstring))
+                        if (a && (!n->attrstring || !JSON::equalstring(*n->attrstring, a)))
                         {
                             if (!n->attrstring)
                             {
@@ -7188,12 +7927,27 @@ void MegaClient::sc_chatupdate(bool readingPublicChat)
                     }
 
                     TextChat *chat = chats[chatid];
+
+                    // the API resends the whole chat: only notify it when something did change
+                    bool modified = mustHaveUK
+                            || chat->shard != shard
+                            || chat->group != group
+                            || (ts != -1 && chat->ts != ts)
+                            || chat->meeting != meeting;
+                    bool changedOptions = chat->changed.options;
+                    bool changedMode = chat->changed.mode;
+
                     chat->id = chatid;
                     chat->shard = shard;
                     chat->group = group;
                     chat->priv = PRIV_UNKNOWN;
                     chat->ou = ou;
-                    chat->title = title;
+                    if (chat->title != title)
+                    {
+                        chat->title = title;
+                        chat->changed.title = true;
+                        modified = true;
+                    }
                     // chat->flags = ?; --> flags are received in other AP: mcfc
                     if (ts != -1)
                     {
@@ -7251,6 +8005,18 @@ void MegaClient::sc_chatupdate(bool readingPublicChat)
                         userpriv = NULL;
                     }
 
+                    if (chat->priv != oldPriv)
+                    {
+                        chat->changed.ownPriv = true;
+                        modified = true;
+                    }
+
+                    if (!chat->samePeers(userpriv))
+                    {
+                        chat->changed.peers = true;
+                        modified = true;
+                    }
+
                     delete chat->userpriv;  // discard any existing `userpriv`
                     chat->userpriv = userpriv;
 
@@ -7259,6 +8025,7 @@ void MegaClient::sc_chatupdate(bool readingPublicChat)
                         chat->setMode(publicchat);
                         if (!unifiedkey.empty())    // not all actionpackets include it
                         {
+                            modified = modified || chat->unifiedKey != unifiedkey;
                             chat->unifiedKey = unifiedkey;
                         }
                         else if (mustHaveUK)
@@ -7267,8 +8034,19 @@ void MegaClient::sc_chatupdate(bool readingPublicChat)
                         }
                     }
 
-                    chat->setTag(0);    // external change
-                    notifychat(chat);
+                    modified = modified
+                            || chat->changed.options != changedOptions
+                            || chat->changed.mode != changedMode;
+
+                    if (modified)
+                    {
+                        chat->setTag(0);    // external change
+                        notifychat(chat);
+                    }
+                    else
+                    {
+                        LOG_verbose << "Chat unchanged by action packet: " << Base64Str<MegaClient::CHATHANDLE>(chatid);
+                    }
                 }
 
                 delete upnotif;
@@ -7747,6 +8525,8 @@ void MegaClient::notifypurge(void)
 
     if (scsn.ready()) tscsn = scsn.getHandle();
 
+    mNodeManager.flushCounterNotifications();
+
     if (mNodeManager.nodeNotifySize() || usernotify.size() || pcrnotify.size()
             || setnotify.size() || setelementnotify.size()
             || !useralerts.useralertnotify.empty()
@@ -7878,9 +8658,10 @@ void MegaClient::persistAlert(UserAlert::Base* a)
     if (!sctable) return;
 
     // Alerts are not critical. There is no need to break execution if db ops failed for some (rare) reason
+    // They go to a store of their own where the table has one (see UserAlerts::loadStoredAlerts())
     if (a->removed())
     {
-        if (sctable->del(a->dbid))
+        if (sctable->delalert(a->dbid) || sctable->del(a->dbid))
         {
             LOG_verbose << "UserAlert of type " << a->type << " removed from db.";
         }
@@ -7891,7 +8672,7 @@ void MegaClient::persistAlert(UserAlert::Base* a)
     }
     else // insert or replace
     {
-        if (sctable->put(CACHEDALERT, a, &key))
+        if (sctable->putalert(CACHEDALERT, a->ts(), a->seen(), a, &key) || sctable->put(CACHEDALERT, a, &key))
         {
             LOG_verbose << "UserAlert of type " << a->type << " inserted or replaced in db.";
         }
@@ -7919,6 +8700,7 @@ Node* MegaClient::nodeByPath(const char* path, Node* node)
 {
     if (!path) return NULL;
 
+    const char* fullPath = path;
     Node *cwd = node;
     vector<string> c;
     string s;
@@ -8081,6 +8863,33 @@ Node* MegaClient::nodeByPath(const char* path, Node* node)
         }
     }
 
+    // resolutions are cached while no notification is pending (the cache doesn't know about those changes yet)
+    NodePathCache* cache = nullptr;
+    NodePathCache::Key cacheKey;
+    vector<NodeHandle> pathNodes;
+    vector<NodePathCache::Lookup> lookups;
+    if (n && !remote && !mNodeManager.nodeNotifySize())
+    {
+        cache = &mNodeManager.pathCache();
+        cacheKey = NodePathCache::Key(n->nodeHandle(), fullPath);
+
+        NodeHandle cached;
+        if (cache->get(cacheKey, cached))
+        {
+            if (cached.isUndef())
+            {
+                return NULL;
+            }
+
+            if (Node* cachedNode = nodeByHandle(cached))
+            {
+                return cachedNode;
+            }
+        }
+
+        pathNodes.push_back(n->nodeHandle());
+    }
+
     // parse relative path
     while (n && l < (int)c.size())
     {
@@ -8091,7 +8900,12 @@ Node* MegaClient::nodeByPath(const char* path, Node* node)
                 if (n->parent)
                 {
                     n = n->parent;
-                }
+
+                    if (cache)
+                    {
+                        pathNodes.push_back(n->nodeHandle());
+                    }
+                }
             }
             else
             {
@@ -8100,12 +8914,28 @@ Node* MegaClient::nodeByPath(const char* path, Node* node)
                 {
                     nn = childnodebyname(n, c[l].c_str());
 
+                    if (cache)
+                    {
+                        string name = c[l];
+                        LocalPath::utf8_normalize(&name);
+                        lookups.emplace_back(n->nodeHandle(), std::move(name));
+                    }
+
                     if (!nn)
                     {
+                        if (cache)
+                        {
+                            cache->put(cacheKey, NodeHandle(), pathNodes, lookups);
+                        }
                         return NULL;
                     }
 
                     n = nn;
+
+                    if (cache)
+                    {
+                        pathNodes.push_back(n->nodeHandle());
+                    }
                 }
             }
         }
@@ -8113,6 +8943,11 @@ Node* MegaClient::nodeByPath(const char* path, Node* node)
         l++;
     }
 
+    if (cache && n)
+    {
+        cache->put(cacheKey, n->nodeHandle(), pathNodes, lookups);
+    }
+
     return n;
 }
 
@@ -8140,6 +8975,20 @@ Node* MegaClient::sc_deltree()
                 break;
 
             case EOO:
+                if (n && originatingUser == me)
+                {
+                    // no alerts are noted for our own removals, so big ones needn't visit every node
+                    int creqtag = reqtag;
+                    reqtag = 0;
+                    bool removed = mNodeManager.removeSubtree(n);
+                    reqtag = creqtag;
+
+                    if (removed)
+                    {
+                        return n;
+                    }
+                }
+
                 if (n)
                 {
                     TreeProcDel td;
@@ -8247,6 +9096,58 @@ error MegaClient::setattr(Node* n, attr_map&& updates, CommandSetAttr::Completio
     return API_OK;
 }
 
+namespace {
+
+// collects the per-node results of a bulk operation, and reports them when the last one arrives
+struct BulkResults
+{
+    vector<pair<NodeHandle, Error>> results;
+    size_t pending;
+    MegaClient::BulkCompletion completion;
+
+    BulkResults(size_t count, MegaClient::BulkCompletion&& c)
+        : pending(count)
+        , completion(std::move(c))
+    {
+        results.reserve(count);
+    }
+
+    void add(NodeHandle h, Error e)
+    {
+        results.emplace_back(h, e);
+        if (!--pending && completion)
+        {
+            completion(std::move(results));
+        }
+    }
+};
+
+} // namespace
+
+void MegaClient::setattrs(vector<pair<Node*, attr_map>>&& updates, bool canChangeVault, BulkCompletion&& c)
+{
+    if (updates.empty())
+    {
+        if (c) c({});
+        return;
+    }
+
+    auto bulk = std::make_shared<BulkResults>(updates.size(), std::move(c));
+
+    for (auto& update : updates)
+    {
+        NodeHandle h = update.first->nodeHandle();
+        error e = setattr(update.first, std::move(update.second),
+                          [bulk](NodeHandle h, Error e) { bulk->add(h, e); },
+                          canChangeVault);
+
+        if (e != API_OK)
+        {
+            bulk->add(h, e);
+        }
+    }
+}
+
 error MegaClient::putnodes_prepareOneFile(NewNode* newnode, Node* parentNode, const char *utf8Name, const UploadToken& binaryUploadToken,
                                           byte *theFileKey, char *megafingerprint, const char *fingerprintOriginal,
                                           std::function<error(AttrMap&)> addNodeAttrsFunc, std::function<error(std::string *)> addFileAttrsFunc)
@@ -8355,6 +9256,100 @@ void MegaClient::putnodes(NodeHandle h, VersioningOption vo, vector<NewNode>&& n
     reqs.add(new CommandPutNodes(this, h, NULL, vo, move(newnodes), tag, PUTNODES_APP, cauth, move(resultFunction), canChangeVault));
 }
 
+// upload completions are held until the next cs request is assembled, so that bursts of
+// small files finishing together reach the API as one putnodes per target folder
+void MegaClient::putnodesBatched(NodeHandle h, VersioningOption vo, vector<NewNode>&& newnodes, int tag, bool canChangeVault, CommandPutNodes::Completion&& completion)
+{
+    assert(!newnodes.empty());
+
+    PutnodesBatch* batch = nullptr;
+    for (auto& b : mPutnodesBatches)
+    {
+        if (b.target == h && b.vo == vo && b.canChangeVault == canChangeVault)
+        {
+            batch = &b;
+            break;
+        }
+    }
+
+    if (!batch)
+    {
+        mPutnodesBatches.emplace_back();
+        batch = &mPutnodesBatches.back();
+        batch->target = h;
+        batch->vo = vo;
+        batch->canChangeVault = canChangeVault;
+        batch->startedDs = Waiter::ds;
+    }
+
+    CommandPutNodes::BatchedCompletion c;
+    c.tag = tag;
+    c.count = newnodes.size();
+    c.completion = move(completion);
+    batch->completions.push_back(move(c));
+
+    for (auto& n : newnodes)
+    {
+        batch->nodes.push_back(move(n));
+    }
+
+    if (batch->nodes.size() >= MAXPUTNODESBATCH)
+    {
+        sendPutnodesBatch(*batch);
+        mPutnodesBatches.erase(mPutnodesBatches.begin() + (batch - mPutnodesBatches.data()));
+    }
+}
+
+void MegaClient::flushPutnodesBatches()
+{
+    bool all = reqs.readyToSend(Waiter::ds);
+
+    for (auto it = mPutnodesBatches.begin(); it != mPutnodesBatches.end(); )
+    {
+        if (all || Waiter::ds - it->startedDs >= PUTNODES_BATCH_WINDOW_DS)
+        {
+            sendPutnodesBatch(*it);
+            it = mPutnodesBatches.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+dstime MegaClient::nextPutnodesBatchDs() const
+{
+    dstime next = NEVER;
+    for (auto& b : mPutnodesBatches)
+    {
+        next = std::min(next, b.startedDs + PUTNODES_BATCH_WINDOW_DS);
+    }
+    return next;
+}
+
+void MegaClient::sendPutnodesBatch(PutnodesBatch& batch)
+{
+    assert(!batch.completions.empty());
+
+    if (batch.completions.size() == 1)
+    {
+        // nothing to coalesce with, send exactly what would have been sent directly
+        CommandPutNodes::BatchedCompletion& c = batch.completions.front();
+        reqs.add(new CommandPutNodes(this, batch.target, NULL, batch.vo, move(batch.nodes), c.tag,
+                                     PUTNODES_APP, nullptr, move(c.completion), batch.canChangeVault));
+        return;
+    }
+
+    LOG_debug << "Coalescing " << batch.completions.size() << " upload completions into one putnodes ("
+              << batch.nodes.size() << " nodes)";
+
+    auto cmd = new CommandPutNodes(this, batch.target, NULL, batch.vo, move(batch.nodes), batch.completions.front().tag,
+                                   PUTNODES_APP, nullptr, nullptr, batch.canChangeVault);
+    cmd->mBatch = move(batch.completions);
+    reqs.add(cmd);
+}
+
 // drop nodes into a user's inbox (must have RSA keypair) - obsolete feature, kept for sending logs to helpdesk
 void MegaClient::putnodes(const char* user, vector<NewNode>&& newnodes, int tag, CommandPutNodes::Completion&& completion)
 {
@@ -8588,6 +9583,37 @@ error MegaClient::rename(Node* n, Node* p, syncdel_t syncdel, NodeHandle prevpar
     return API_OK;
 }
 
+void MegaClient::renames(const vector<Node*>& nodes, Node* p, bool canChangeVault, BulkCompletion&& c)
+{
+    if (nodes.empty())
+    {
+        if (c) c({});
+        return;
+    }
+
+    auto bulk = std::make_shared<BulkResults>(nodes.size(), std::move(c));
+
+    for (Node* n : nodes)
+    {
+        NodeHandle h = n->nodeHandle();
+
+        // already there: rename() would queue nothing, so there would be no completion
+        if (n->parent == p)
+        {
+            bulk->add(h, API_OK);
+            continue;
+        }
+
+        error e = rename(n, p, SYNCDEL_NONE, NodeHandle(), nullptr, canChangeVault,
+                         [bulk](NodeHandle h, Error e) { bulk->add(h, e); });
+
+        if (e != API_OK)
+        {
+            bulk->add(h, e);
+        }
+    }
+}
+
 void MegaClient::removeOutSharesFromSubtree(Node* n, int tag)
 {
     if (n->pendingshares)
@@ -8721,8 +9747,11 @@ error MegaClient::unlink(Node* n, bool keepversions, int tag, bool canChangeVaul
         }
     }
 
-    TreeProcDel td;
-    proctree(n, &td);
+    if (!mNodeManager.removeSubtree(n))
+    {
+        TreeProcDel td;
+        proctree(n, &td);
+    }
 
     return API_OK;
 }
@@ -8911,125 +9940,474 @@ uint64_t MegaClient::stringhash64(string* s, SymmCipher* c)
 }
 
 // read and add/verify node array
-int MegaClient::readnodes(JSON* j, int notify, putsource_t source, vector<NewNode>* nn, bool modifiedByThisClient, bool applykeys)
+void MegaClient::predecryptnodes(const JSON& j, vector<PredecryptedNode>& nodes)
 {
-    if (!j->enterarray())
+    CodeCounter::ScopeTimer ccst(performanceStats.predecryptNodes);
+
+    // locate the elements (a jump per element if the response is indexed)
+    JSON scan(j);
+    vector<const char*> objects;
+    for (;;)
     {
-        return 0;
+        if (*scan.pos == ',')
+        {
+            scan.pos++;
+        }
+        if (*scan.pos != '{')
+        {
+            break;
+        }
+        objects.push_back(scan.pos);
+        if (!scan.storeobject())
+        {
+            break;
+        }
     }
 
-    Node* n;
+    if (objects.size() < MIN_PREDECRYPTED_NODES)
+    {
+        return;
+    }
 
-    handle previousHandleForAlert = UNDEF;
-    while (j->enterobject())
+    nodes.resize(objects.size());
+
+    handle self = me;
+    const byte* masterKey = key.key;
+
+    parallelfor(objects.size(), [&objects, &nodes, self, masterKey](size_t begin, size_t end, SymmCipher& nodeCipher)
     {
-        handle h = UNDEF, ph = UNDEF;
-        handle u = 0, su = UNDEF;
-        nodetype_t t = TYPE_UNKNOWN;
-        const char* a = NULL;
-        const char* k = NULL;
-        const char* fa = NULL;
-        const char *sk = NULL;
-        accesslevel_t rl = ACCESS_UNKNOWN;
-        m_off_t s = NEVER;
-        m_time_t ts = -1, sts = -1;
-        nameid name;
-        int nni = -1;
+        SymmCipher master;
+        master.setkey(masterKey);
 
-        while ((name = j->getnameid()) != EOO)
+        for (size_t i = begin; i < end; i++)
         {
-            switch (name)
-            {
-                case 'h':   // new node: handle
-                    h = j->gethandle();
-                    break;
+            predecryptnode(objects[i], self, master, nodeCipher, nodes[i]);
+        }
+    });
+}
 
-                case 'p':   // parent node
-                    ph = j->gethandle();
-                    break;
+void MegaClient::parallelfor(size_t count, const std::function<void(size_t, size_t, SymmCipher&)>& work)
+{
+    // one share each for the workers and for this thread (which can't wait for pushes held by a batch)
+    size_t shares = mAsyncQueue.batching() ? 1 : mAsyncQueue.threadCount() + 1;
+    size_t perShare = (count + shares - 1) / shares;
 
-                case 'u':   // owner user
-                    u = j->gethandle(USERHANDLE);
-                    break;
+    struct Pending
+    {
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t remaining = 0;
+    };
+    auto pending = std::make_shared<Pending>();
 
-                case 't':   // type
-                    t = (nodetype_t)j->getint();
-                    break;
+    for (size_t begin = perShare; begin < count; begin += perShare)
+    {
+        size_t end = std::min(begin + perShare, count);
 
-                case 'a':   // attributes
-                    a = j->getvalue();
-                    break;
+        {
+            std::lock_guard<std::mutex> g(pending->mutex);
+            ++pending->remaining;
+        }
 
-                case 'k':   // key(s)
-                    k = j->getvalue();
-                    break;
+        mAsyncQueue.push([&work, begin, end, pending](SymmCipher& nodeCipher)
+        {
+            work(begin, end, nodeCipher);
 
-                case 's':   // file size
-                    s = j->getint();
-                    break;
+            std::lock_guard<std::mutex> g(pending->mutex);
+            if (!--pending->remaining)
+            {
+                pending->done.notify_one();
+            }
+        }, false);
+    }
 
-                case 'i':   // related source NewNode index
-                    nni = int(j->getint());
-                    break;
+    SymmCipher nodeCipher;
+    work(0, std::min(perShare, count), nodeCipher);
 
-                case MAKENAMEID2('t', 's'):  // actual creation timestamp
-                    ts = j->getint();
-                    break;
+    std::unique_lock<std::mutex> g(pending->mutex);
+    pending->done.wait(g, [&pending]() { return !pending->remaining; });
+}
 
-                case MAKENAMEID2('f', 'a'):  // file attributes
-                    fa = j->getvalue();
-                    break;
+// the key and attributes of a node whose first subkey is for our own user,
+// decrypted as Node::applykey() would do (anything else is left to it)
+void MegaClient::predecryptnode(const char* object, handle me, SymmCipher& masterKey, SymmCipher& nodeCipher, PredecryptedNode& node)
+{
+    JSON j(object);
+    if (!j.enterobject())
+    {
+        return;
+    }
 
-                    // inbound share attributes
-                case 'r':   // share access level
-                    rl = (accesslevel_t)j->getint();
-                    break;
+    nodetype_t t = TYPE_UNKNOWN;
+    const char* a = nullptr;
+    const char* k = nullptr;
+    nameid name;
 
-                case MAKENAMEID2('s', 'k'):  // share key
-                    sk = j->getvalue();
-                    break;
+    while ((name = j.getnameid()) != EOO)
+    {
+        switch (name)
+        {
+            case 'h':
+                node.h = j.gethandle();
+                break;
 
-                case MAKENAMEID2('s', 'u'):  // sharing user
-                    su = j->gethandle(USERHANDLE);
-                    break;
+            case 't':
+                t = (nodetype_t)j.getint();
+                break;
 
-                case MAKENAMEID3('s', 't', 's'):  // share timestamp
-                    sts = j->getint();
-                    break;
+            case 'a':
+                a = j.getvalue();
+                break;
 
-                default:
-                    if (!j->storeobject())
-                    {
-                        return 0;
-                    }
-            }
-        }
+            case 'k':
+                k = j.getvalue();
+                break;
 
-        if (ISUNDEF(h))
-        {
-            warn("Missing node handle");
-        }
-        else
-        {
-            if (t == TYPE_UNKNOWN)
-            {
-                warn("Unknown node type");
-            }
-            else if (t == FILENODE || t == FOLDERNODE)
-            {
-                if (ISUNDEF(ph))
-                {
-                    warn("Missing parent");
-                }
-                else if (!a)
-                {
-                    warn("Missing node attributes");
-                }
-                else if (!k)
+            default:
+                if (!j.storeobject())
                 {
-                    warn("Missing node key");
+                    return;
                 }
-
+        }
+    }
+
+    if ((t != FILENODE && t != FOLDERNODE) || !a || !k)
+    {
+        return;
+    }
+
+    string keys;
+    JSON::copystring(&keys, k);
+
+    size_t colon = keys.find(':');
+    handle h = 0;
+    if (colon == string::npos
+            || Base64::atob(keys.c_str(), (byte*)&h, sizeof h) != USERHANDLE
+            || h != me)
+    {
+        return;
+    }
+
+    // RSA-encrypted keys are rewritten by the client thread
+    const char* sk = keys.c_str() + colon + 1;
+    if (strcspn(sk, "/") > 4 * FILENODEKEYLENGTH / 3 + 1)
+    {
+        return;
+    }
+
+    string attrString;
+    JSON::copystring(&attrString, a);
+
+    decryptnode(sk, t, attrString, masterKey, nodeCipher, node);
+}
+
+bool MegaClient::decryptnode(const char* k, nodetype_t t, const string& attrString, SymmCipher& keyCipher, SymmCipher& nodeCipher, PredecryptedNode& node)
+{
+    byte nodeKey[FILENODEKEYLENGTH];
+    int keyLength = (t == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH;
+    if (Base64::atob(k, nodeKey, keyLength) != keyLength)
+    {
+        return false;
+    }
+    keyCipher.ecb_decrypt(nodeKey, size_t(keyLength));
+
+    nodeCipher.setkey(nodeKey, t);
+
+    static thread_local string arena;
+    byte* buf = Node::decryptattr(&nodeCipher, attrString.c_str(), attrString.size(), arena);
+    if (!buf)
+    {
+        return false;
+    }
+
+    JSON json;
+    nameid name;
+    string* v;
+    json.begin((char*)buf + 5);
+    while ((name = json.getnameid()) != EOO && json.storeobject((v = &node.attrs.map[name])))
+    {
+        JSON::unescape(v);
+
+        if (name == 'n')
+        {
+            LocalPath::utf8_normalize(v);
+        }
+    }
+
+    node.key.assign(reinterpret_cast<const char*>(nodeKey), size_t(keyLength));
+    node.decrypted = true;
+    return true;
+}
+
+void MegaClient::predecryptrsakeys(const JSON& j)
+{
+    vector<string> keys;
+
+    JSON scan(j);
+    for (;;)
+    {
+        if (*scan.pos == ',')
+        {
+            scan.pos++;
+        }
+        if (*scan.pos != '{')
+        {
+            break;
+        }
+        collectrsakeys(scan.pos, me, keys);
+        if (!scan.storeobject())
+        {
+            break;
+        }
+    }
+
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    if (keys.size() < MIN_PREDECRYPTED_RSA_KEYS || !asymkey.isvalid(AsymmCipher::PRIVKEY))
+    {
+        return;
+    }
+
+    LOG_debug << "Decrypting " << keys.size() << " RSA keys in parallel";
+
+    vector<string> decrypted(keys.size());
+    const AsymmCipher& privateKey = asymkey;
+
+    parallelfor(keys.size(), [&keys, &decrypted, &privateKey](size_t begin, size_t end, SymmCipher&)
+    {
+        AsymmCipher rsa(privateKey);
+        byte buf[4096];
+        byte plain[FILENODEKEYLENGTH];
+
+        for (size_t i = begin; i < end; i++)
+        {
+            int length = Base64::atob(keys[i].c_str(), buf, int(sizeof buf));
+            if (length > 0 && rsa.decrypt(buf, size_t(length), plain, sizeof plain))
+            {
+                decrypted[i].assign(reinterpret_cast<const char*>(plain), sizeof plain);
+            }
+        }
+    });
+
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (!decrypted[i].empty())
+        {
+            mPredecryptedRsaKeys[std::move(keys[i])] = std::move(decrypted[i]);
+        }
+    }
+}
+
+// the RSA-encrypted share key and our own RSA-encrypted node key of a node, if any
+void MegaClient::collectrsakeys(const char* object, handle me, vector<string>& keys)
+{
+    JSON j(object);
+    if (!j.enterobject())
+    {
+        return;
+    }
+
+    const char* k = nullptr;
+    const char* sk = nullptr;
+    nameid name;
+
+    while ((name = j.getnameid()) != EOO)
+    {
+        switch (name)
+        {
+            case 'k':
+                k = j.getvalue();
+                break;
+
+            case MAKENAMEID2('s', 'k'):
+                sk = j.getvalue();
+                break;
+
+            default:
+                if (!j.storeobject())
+                {
+                    return;
+                }
+        }
+    }
+
+    size_t rsaLength = 4 * FILENODEKEYLENGTH / 3 + 1;
+
+    if (sk)
+    {
+        size_t length = strcspn(sk, "\"/");
+        if (length > rsaLength)
+        {
+            keys.emplace_back(sk, length);
+        }
+    }
+
+    if (k)
+    {
+        // "handle:key/handle:key...", only the subkey for our user can be RSA-encrypted
+        for (const char* ptr = k; *ptr && *ptr != '"'; )
+        {
+            const char* colon = ptr + strcspn(ptr, "\":/");
+            if (*colon != ':')
+            {
+                break;
+            }
+
+            const char* subkey = colon + 1;
+            size_t length = strcspn(subkey, "\"/");
+
+            handle h = 0;
+            if (length > rsaLength
+                    && Base64::atob(string(ptr, size_t(colon - ptr)).c_str(), (byte*)&h, sizeof h) == USERHANDLE
+                    && h == me)
+            {
+                keys.emplace_back(subkey, length);
+            }
+
+            ptr = subkey + length;
+            if (*ptr == '/')
+            {
+                ptr++;
+            }
+        }
+    }
+}
+
+int MegaClient::readnodes(JSON* j, int notify, putsource_t source, vector<NewNode>* nn, bool modifiedByThisClient, bool applykeys, bool finishBatch)
+{
+    CodeCounter::ScopeTimer ccst(performanceStats.readNodes);
+
+    if (!j->enterarray())
+    {
+        return 0;
+    }
+
+    // while fetching, the keys and attributes of our own nodes are decrypted in parallel
+    vector<PredecryptedNode> predecrypted;
+    if (!notify && applykeys && fetchingnodes && loggedin() && !loggedIntoFolder()
+            && mAsyncQueue.threadCount() && !mAsyncQueue.batching())
+    {
+        predecryptnodes(*j, predecrypted);
+        predecryptrsakeys(*j);
+    }
+    size_t element = 0;
+
+    Node* n;
+
+    handle previousHandleForAlert = UNDEF;
+    while (j->enterobject())
+    {
+        PredecryptedNode* pre = element < predecrypted.size() ? &predecrypted[element] : nullptr;
+        element++;
+
+        handle h = UNDEF, ph = UNDEF;
+        handle u = 0, su = UNDEF;
+        nodetype_t t = TYPE_UNKNOWN;
+        const char* a = NULL;
+        const char* k = NULL;
+        const char* fa = NULL;
+        const char *sk = NULL;
+        accesslevel_t rl = ACCESS_UNKNOWN;
+        m_off_t s = NEVER;
+        m_time_t ts = -1, sts = -1;
+        nameid name;
+        int nni = -1;
+
+        while ((name = j->getnameid()) != EOO)
+        {
+            switch (name)
+            {
+                case 'h':   // new node: handle
+                    h = j->gethandle();
+                    break;
+
+                case 'p':   // parent node
+                    ph = j->gethandle();
+                    break;
+
+                case 'u':   // owner user
+                    u = j->gethandle(USERHANDLE);
+                    break;
+
+                case 't':   // type
+                    t = (nodetype_t)j->getint();
+                    break;
+
+                case 'a':   // attributes
+                    a = j->getvalue();
+                    break;
+
+                case 'k':   // key(s)
+                    k = j->getvalue();
+                    break;
+
+                case 's':   // file size
+                    s = j->getint();
+                    break;
+
+                case 'i':   // related source NewNode index
+                    nni = int(j->getint());
+                    break;
+
+                case MAKENAMEID2('t', 's'):  // actual creation timestamp
+                    ts = j->getint();
+                    break;
+
+                case MAKENAMEID2('f', 'a'):  // file attributes
+                    fa = j->getvalue();
+                    break;
+
+                    // inbound share attributes
+                case 'r':   // share access level
+                    rl = (accesslevel_t)j->getint();
+                    break;
+
+                case MAKENAMEID2('s', 'k'):  // share key
+                    sk = j->getvalue();
+                    break;
+
+                case MAKENAMEID2('s', 'u'):  // sharing user
+                    su = j->gethandle(USERHANDLE);
+                    break;
+
+                case MAKENAMEID3('s', 't', 's'):  // share timestamp
+                    sts = j->getint();
+                    break;
+
+                default:
+                    if (!j->storeobject())
+                    {
+                        return 0;
+                    }
+            }
+        }
+
+        if (ISUNDEF(h))
+        {
+            warn("Missing node handle");
+        }
+        else
+        {
+            if (t == TYPE_UNKNOWN)
+            {
+                warn("Unknown node type");
+            }
+            else if (t == FILENODE || t == FOLDERNODE)
+            {
+                if (ISUNDEF(ph))
+                {
+                    warn("Missing parent");
+                }
+                else if (!a)
+                {
+                    warn("Missing node attributes");
+                }
+                else if (!k)
+                {
+                    warn("Missing node key");
+                }
+
                 if (t == FILENODE && ISUNDEF(s))
                 {
                     warn("File node without file size");
@@ -9135,10 +10513,6 @@ int MegaClient::readnodes(JSON* j, int notify, putsource_t source, vector<NewNod
                     }
                 }
 
-                string fas;
-
-                JSON::copystring(&fas, fa);
-
                 // fallback timestamps
                 if (!(ts + 1))
                 {
@@ -9150,7 +10524,7 @@ int MegaClient::readnodes(JSON* j, int notify, putsource_t source, vector<NewNod
                     sts = ts;
                 }
 
-                n = new Node(*this, NodeHandle().set6byte(h), NodeHandle().set6byte(ph), t, s, u, fas.c_str(), ts);
+                n = new Node(*this, NodeHandle().set6byte(h), NodeHandle().set6byte(ph), t, s, u, fa, ts);
                 n->changed.newnode = true;
                 n->changed.modifiedByThisClient = modifiedByThisClient;
 
@@ -9255,7 +10629,14 @@ int MegaClient::readnodes(JSON* j, int notify, putsource_t source, vector<NewNod
 
             if (applykeys)
             {
-                n->applykey();
+                if (pre && pre->decrypted && pre->h == h && !n->keyApplied())
+                {
+                    n->setdecryptedkey(pre->key, pre->attrs);
+                }
+                else
+                {
+                    n->applykey();
+                }
             }
 
             if (notify)
@@ -9292,18 +10673,68 @@ int MegaClient::readnodes(JSON* j, int notify, putsource_t source, vector<NewNod
         }
     }
 
-    mergenewshares(notify);
-    mNodeManager.checkOrphanNodes();
+    mPredecryptedRsaKeys.clear();
+
+    if (finishBatch)
+    {
+        mergenewshares(notify);
+        mNodeManager.checkOrphanNodes();
+    }
 
     return j->leavearray();
 }
 
-// decrypt and set encrypted sharekey
-void MegaClient::setkey(SymmCipher* c, const char* k)
+bool MegaClient::readfetchnodesstream()
 {
-    byte newkey[SymmCipher::KEYLENGTH];
+    size_t begin, end;
 
-    if (Base64::atob(k, newkey, sizeof newkey) == sizeof newkey)
+    for (;;)
+    {
+        switch (mFetchNodesScanner->next(pendingcs->data(), pendingcs->size(), begin, end))
+        {
+            case JSONArrayScanner::ELEMENTS:
+                break;
+
+            case JSONArrayScanner::MISMATCH:
+                // an error code or an unexpected layout: parse the full response when complete
+                mFetchNodesScanner.reset();
+                return true;
+
+            default:
+                return true;
+        }
+
+        if (!mFetchNodesStreamed)
+        {
+            LOG_debug << "Loading nodes while the fetchnodes response is received";
+            purgenodesusersabortsc(true);
+            mFetchNodesStreamed = true;
+        }
+
+        string batch;
+        batch.reserve(end - begin + 2);
+        batch.append("[").append(pendingcs->data() + begin, end - begin).append("]");
+
+        JSON j(batch);
+        if (!readnodes(&j, 0, PUTNODES_APP, nullptr, false, true, false))
+        {
+            LOG_err << "Parse error (streamed fetchnodes)";
+            mFetchNodesScanner.reset();
+            mFetchNodesStreamFailed = true;
+            return false;
+        }
+
+        pendingcs->purge(end);
+        mFetchNodesScanner->consumed(end);
+    }
+}
+
+// decrypt and set encrypted sharekey
+void MegaClient::setkey(SymmCipher* c, const char* k)
+{
+    byte newkey[SymmCipher::KEYLENGTH];
+
+    if (Base64::atob(k, newkey, sizeof newkey) == sizeof newkey)
     {
         key.ecb_decrypt(newkey);
         c->setkey(newkey);
@@ -9761,18 +11192,111 @@ void MegaClient::applykeys()
     sendkeyrewrites();
 }
 
+void MegaClient::applynodekeys(const vector<Node*>& nodes)
+{
+    if (nodes.size() < MIN_PREDECRYPTED_NODES || !mAsyncQueue.threadCount() || mAsyncQueue.batching())
+    {
+        for (Node* n : nodes)
+        {
+            n->applykey();
+        }
+        return;
+    }
+
+    // the subkeys and their ciphers are looked up here (share keys live on this thread),
+    // the symmetric ones are decrypted in parallel, and the results installed in order
+    struct Job
+    {
+        Node* node;
+        const char* k;
+        const byte* cipherKey;
+        PredecryptedNode result;
+    };
+    vector<Job> jobs;
+    jobs.reserve(nodes.size());
+
+    for (Node* n : nodes)
+    {
+        if (n->type > FOLDERNODE || n->keyApplied() || n->nodekeyUnchecked().empty() || !n->attrstring)
+        {
+            n->applykey();
+            continue;
+        }
+
+        SymmCipher* sc;
+        const char* k = n->selectkey(sc);
+        if (!k)
+        {
+            continue;
+        }
+
+        // RSA-encrypted keys get decrypted and queued for rewriting by applykey()
+        if (strcspn(k, "/\"") > 4 * FILENODEKEYLENGTH / 3 + 1)
+        {
+            n->applykey();
+            continue;
+        }
+
+        jobs.push_back(Job{n, k, sc->key, PredecryptedNode()});
+    }
+
+    parallelfor(jobs.size(), [&jobs](size_t begin, size_t end, SymmCipher& nodeCipher)
+    {
+        SymmCipher keyCipher;
+
+        for (size_t i = begin; i < end; i++)
+        {
+            Job& job = jobs[i];
+            keyCipher.setkey(job.cipherKey);    // nodes under a share keep the same key, which is cheap to set again
+            decryptnode(job.k, job.node->type, *job.node->attrstring, keyCipher, nodeCipher, job.result);
+        }
+    });
+
+    for (Job& job : jobs)
+    {
+        if (job.result.decrypted)
+        {
+            job.node->setdecryptedkey(job.result.key, job.result.attrs);
+        }
+        else
+        {
+            // corrupt key or attributes: let applykey() report it as usual
+            job.node->applykey();
+        }
+    }
+}
+
 void MegaClient::sendkeyrewrites()
 {
+    // the same node can be queued from several shares (or several times from one)
+    auto chunks = [](handle_vector& v)
+    {
+        std::sort(v.begin(), v.end());
+        v.erase(std::unique(v.begin(), v.end()), v.end());
+
+        vector<handle_vector> result;
+        for (size_t i = 0; i < v.size(); i += MAX_KEY_REWRITES_PER_COMMAND)
+        {
+            result.emplace_back(v.begin() + ptrdiff_t(i), v.begin() + ptrdiff_t(std::min(v.size(), i + MAX_KEY_REWRITES_PER_COMMAND)));
+        }
+        v.clear();
+        return result;
+    };
+
     if (sharekeyrewrite.size())
     {
-        reqs.add(new CommandShareKeyUpdate(this, &sharekeyrewrite));
-        sharekeyrewrite.clear();
+        for (auto& chunk : chunks(sharekeyrewrite))
+        {
+            reqs.add(new CommandShareKeyUpdate(this, &chunk));
+        }
     }
 
     if (nodekeyrewrite.size())
     {
-        reqs.add(new CommandNodeKeyUpdate(this, &nodekeyrewrite));
-        nodekeyrewrite.clear();
+        for (auto& chunk : chunks(nodekeyrewrite))
+        {
+            reqs.add(new CommandNodeKeyUpdate(this, &chunk));
+        }
     }
 }
 
@@ -10072,13 +11596,98 @@ void MegaClient::login2(const char *email, const char *password, string *salt, c
     string bsalt;
     Base64::atob(*salt, bsalt);
 
-    byte derivedKey[2 * SymmCipher::KEYLENGTH];
-    CryptoPP::PKCS5_PBKDF2_HMAC<CryptoPP::SHA512> pbkdf2;
-    pbkdf2.DeriveKey(derivedKey, sizeof(derivedKey), 0, (byte *)password, strlen(password),
-                     (const byte *)bsalt.data(), bsalt.size(), 100000);
+    string lcemail(email);
+    string spin(pin ? pin : "");
+    bool haspin = pin != NULL;
+    int tag = reqtag;
+
+    deriveKeyAsync(password, bsalt, 100000, 2 * SymmCipher::KEYLENGTH,
+                   [this, lcemail, spin, haspin, tag](const string& derivedKey)
+    {
+        int creqtag = reqtag;
+        reqtag = tag;
+        login2(lcemail.c_str(), (const byte*)derivedKey.data(), haspin ? spin.c_str() : NULL);
+        reqtag = creqtag;
+    });
+}
+
+void MegaClient::deriveKeyAsync(const string& password, const string& salt, unsigned iterations, size_t keyLength,
+                                std::function<void(const string& derivedKey)> completion)
+{
+    PendingKeyDerivation p;
+    p.request = KeyDerivationService::instance().derive(password, salt, iterations, keyLength, waiter);
+    p.completion = std::move(completion);
+    mPendingKeyDerivations.push_back(std::move(p));
+
+    // may have been derived synchronously
+    checkKeyDerivations();
+}
+
+void MegaClient::checkKeyDerivations()
+{
+    while (!mPendingKeyDerivations.empty() && mPendingKeyDerivations.front().request->done)
+    {
+        PendingKeyDerivation p = std::move(mPendingKeyDerivations.front());
+        mPendingKeyDerivations.pop_front();
+        p.completion(p.request->derivedKey);
+    }
+}
+
+void MegaClient::cancelKeyDerivations()
+{
+    for (auto& p : mPendingKeyDerivations)
+    {
+        KeyDerivationService::instance().cancel(p.request);
+    }
+    mPendingKeyDerivations.clear();
+}
+
+#ifdef USE_MEDIAINFO
+void MegaClient::extractMediaPropertiesAsync(const LocalPath& localPath, std::unique_ptr<FileAccess> fileAccess, bool verified,
+                                             std::function<void(MediaProperties& vp)> completion)
+{
+    PendingMediaExtraction p;
+    p.request = MediaExtractionService::instance().extract(localPath, std::move(fileAccess), verified, waiter);
+    p.completion = std::move(completion);
+    mPendingMediaExtractions.push_back(std::move(p));
+
+    // may have been extracted synchronously
+    checkMediaExtractions();
+}
+
+void MegaClient::checkMediaExtractions()
+{
+    // extractions don't depend on each other: a large file doesn't hold back the ones queued after it
+    std::vector<PendingMediaExtraction> finished;
+    for (auto it = mPendingMediaExtractions.begin(); it != mPendingMediaExtractions.end(); )
+    {
+        if (it->request->done)
+        {
+            finished.push_back(std::move(*it));
+            it = mPendingMediaExtractions.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // completions may let transfers complete, which may queue further extractions
+    for (auto& p : finished)
+    {
+        p.completion(p.request->vp);
+    }
+}
 
-    login2(email, derivedKey, pin);
+void MegaClient::cancelMediaExtractions()
+{
+    for (auto& p : mPendingMediaExtractions)
+    {
+        MediaExtractionService::instance().cancel(p.request);
+    }
+    mPendingMediaExtractions.clear();
 }
+#endif
 
 void MegaClient::login2(const char *email, const byte *derivedKey, const char* pin)
 {
@@ -10380,6 +11989,7 @@ void MegaClient::opensctable()
             // recycle it (hence the flag DB_OPEN_FLAG_RECYCLE)
             int recycleDBVersion = (DbAccess::LEGACY_DB_VERSION == DbAccess::LAST_DB_VERSION_WITHOUT_NOD) ? DB_OPEN_FLAG_RECYCLE : 0;
             sctable.reset(dbaccess->openTableWithNodes(rng, *fsaccess, dbname, recycleDBVersion));
+            mScStoredRecords.clear();
             pendingsccommit = false;
 
             if (sctable)
@@ -10819,15 +12429,14 @@ void MegaClient::queuepubkeyreq(const char *uid, std::unique_ptr<PubKeyAction> p
 }
 
 // rewrite keys of foreign nodes due to loss of underlying shareufskey
-void MegaClient::rewriteforeignkeys(Node* n)
+void MegaClient::rewriteforeignkeys(Node* n, bool send)
 {
     TreeProcForeignKeys rewrite;
     proctree(n, &rewrite);
 
-    if (nodekeyrewrite.size())
+    if (send)
     {
-        reqs.add(new CommandNodeKeyUpdate(this, &nodekeyrewrite));
-        nodekeyrewrite.clear();
+        sendkeyrewrites();
     }
 }
 
@@ -11169,11 +12778,55 @@ void MegaClient::getua(User* u, const attr_t at, int ctag)
         }
         else
         {
-            reqs.add(new CommandGetUA(this, u->uid.c_str(), at, NULL, tag, nullptr, nullptr, nullptr));
+            // a retrieval of the same attribute is in flight already: wait for its result
+            auto key = std::make_pair(u->uid, at);
+            auto it = mPendingGetUA.find(key);
+            if (it != mPendingGetUA.end())
+            {
+                it->second.push_back(tag);
+                return;
+            }
+            mPendingGetUA[key];
+
+            reqs.add(new CommandGetUA(this, u->uid.c_str(), at, NULL, tag,
+                [this, key](error e)
+                {
+                    replyPendingGetUA(key, [this, e]() { app->getua_result(e); });
+                },
+                [this, key](byte* data, unsigned len, attr_t type)
+                {
+                    replyPendingGetUA(key, [this, data, len, type]() { app->getua_result(data, len, type); });
+                },
+                [this, key](TLVstore* tlv, attr_t type)
+                {
+                    replyPendingGetUA(key, [this, tlv, type]() { app->getua_result(tlv, type); });
+                }));
         }
     }
 }
 
+void MegaClient::replyPendingGetUA(const pair<string, attr_t>& key, std::function<void()> reply)
+{
+    vector<int> waiting;
+    auto it = mPendingGetUA.find(key);
+    if (it != mPendingGetUA.end())
+    {
+        // forget the request before replying, so a new getua() from the app goes to the server
+        waiting = std::move(it->second);
+        mPendingGetUA.erase(it);
+    }
+
+    reply();
+
+    int tag = restag;
+    for (int waitingTag : waiting)
+    {
+        restag = waitingTag;
+        reply();
+    }
+    restag = tag;
+}
+
 void MegaClient::getua(const char *email_handle, const attr_t at, const char *ph, int ctag)
 {
     if (email_handle && at != ATTR_UNKNOWN)
@@ -11212,6 +12865,14 @@ void NodeManager::notifyNode(Node* n)
 {
     n->applykey();
 
+#ifdef ENABLE_SYNC
+    // the sync sees this change through n->localnode, even if it was unloaded
+    if (!mClient.fetchingnodes)
+    {
+        mClient.syncs.loadUnloadedLocalNode(n);
+    }
+#endif
+
     if (!mClient.fetchingnodes)
     {
         if (n->changed.modifiedByThisClient && !n->changed.removed && n->attrstring)
@@ -11327,16 +12988,38 @@ void NodeManager::notifyNode(Node* n)
 
 void MegaClient::transfercacheadd(Transfer *transfer, TransferDbCommitter* committer)
 {
+    // state changes are persisted through here, so they may also make the transfer dispatchable
+    transferlist.schedulingChanged();
+
     if (tctable && !transfer->skipserialization)
     {
         if (committer) committer->addTransferCount += 1;
         tctable->checkCommitter(committer);
         tctable->put(MegaClient::CACHEDTRANSFER, transfer, &tckey);
     }
+
+    transfer->progressCachedDs = Waiter::ds;
+    transfer->progressNotCached = false;
+}
+
+void MegaClient::transfercacheprogress(Transfer *transfer, TransferDbCommitter* committer)
+{
+    // each write serializes the whole record, chunkmacs included, so with many transfers running
+    // progress alone is coalesced; state changes, completion and the end of the slot write it anyway
+    if (Waiter::ds - transfer->progressCachedDs < Transfer::PROGRESS_CACHE_INTERVAL_DS)
+    {
+        transfer->progressNotCached = true;
+        return;
+    }
+
+    transfercacheadd(transfer, committer);
 }
 
 void MegaClient::transfercachedel(Transfer *transfer, TransferDbCommitter* committer)
 {
+    // nothing left to write for a transfer that leaves the cache
+    transfer->progressNotCached = false;
+
     if (tctable && transfer->dbid)
     {
         if (committer) committer->removeTransferCount += 1;
@@ -12774,6 +14457,7 @@ bool MegaClient::fetchsc(DbTable* sctable)
                 break;
 
             case CACHEDPCR:
+                notescrecord(id, data);
                 if ((pcr = PendingContactRequest::unserialize(&data)))
                 {
                     mappcr(pcr->id, unique_ptr<PendingContactRequest>(pcr));
@@ -12787,6 +14471,7 @@ bool MegaClient::fetchsc(DbTable* sctable)
                 break;
 
             case CACHEDUSER:
+                notescrecord(id, data);
                 if ((u = User::unserialize(this, &data)))
                 {
                     u->dbid = id;
@@ -12812,6 +14497,7 @@ bool MegaClient::fetchsc(DbTable* sctable)
 #ifdef ENABLE_CHAT
                 {
                     TextChat *chat;
+                    notescrecord(id, data);
                     if ((chat = TextChat::unserialize(this, &data)))
                     {
                         chat->dbid = id;
@@ -12885,6 +14571,8 @@ bool MegaClient::fetchsc(DbTable* sctable)
     WAIT_CLASS::bumpds();
     fnstats.timeToLastByte = Waiter::ds - fnstats.startTime;
 
+    useralerts.loadStoredAlerts();
+
     // user alerts are restored from DB upon session resumption. No need to send the sc50 to catchup, it will
     // generate new alerts from action packets as usual, once the session is up and running
     useralerts.catchupdone = true;
@@ -12976,6 +14664,7 @@ void MegaClient::closetc(bool remove)
     pendingtcids.clear();
     cachedfiles.clear();
     cachedfilesdbids.clear();
+    cachedfilesresumed = 0;
 
     if (remove && tctable)
     {
@@ -13069,27 +14758,47 @@ void MegaClient::enabletransferresumption(const char *loggedoutid)
 
     // if we are logged in but the filesystem is not current yet
     // postpone the resumption until the filesystem is updated
-    if ((!sid.size() && !loggedinfolderlink()) || statecurrent)
+    if (cachedfilespending())
     {
-        TransferDbCommitter committer(tctable);
-        for (unsigned int i = 0; i < cachedfiles.size(); i++)
+        resumecachedfiles(RESUME_FILES_BATCH);
+    }
+}
+
+bool MegaClient::cachedfilespending() const
+{
+    return tctable
+        && cachedfilesresumed < cachedfiles.size()
+        && ((!sid.size() && !loggedinfolderlink()) || statecurrent);
+}
+
+void MegaClient::resumecachedfiles(size_t max)
+{
+    TransferDbCommitter committer(tctable);
+    size_t end = std::min(cachedfiles.size(), cachedfilesresumed + max);
+    for (; cachedfilesresumed < end; cachedfilesresumed++)
+    {
+        size_t i = cachedfilesresumed;
+        direction_t type = NONE;
+        File *file = app->file_resume(&cachedfiles.at(i), &type);
+        if (!file || (type != GET && type != PUT))
         {
-            direction_t type = NONE;
-            File *file = app->file_resume(&cachedfiles.at(i), &type);
-            if (!file || (type != GET && type != PUT))
-            {
-                tctable->del(cachedfilesdbids.at(i));
-                continue;
-            }
-            file->dbid = cachedfilesdbids.at(i);
-            if (!startxfer(type, file, committer, false, false, false, UseLocalVersioningFlag, nullptr, nextreqtag()))  // TODO: should we have serialized these flags and reused them here?
-            {
-                tctable->del(cachedfilesdbids.at(i));
-                continue;
-            }
+            tctable->del(cachedfilesdbids.at(i));
+            continue;
+        }
+        file->dbid = cachedfilesdbids.at(i);
+        if (!startxfer(type, file, committer, false, false, false, UseLocalVersioningFlag, nullptr, nextreqtag()))  // TODO: should we have serialized these flags and reused them here?
+        {
+            tctable->del(cachedfilesdbids.at(i));
+            continue;
         }
+    }
+
+    if (cachedfilesresumed == cachedfiles.size())
+    {
+        LOG_debug << "Cached files resumed: " << cachedfiles.size();
         cachedfiles.clear();
         cachedfilesdbids.clear();
+        cachedfilesresumed = 0;
     }
 }
 
@@ -13154,6 +14863,7 @@ void MegaClient::fetchnodes(bool nocache)
     {
         LOG_debug << "Cachedscsn is UNDEF so we will not load the account database (and we are truncating it, for clean operation)";
         sctable->truncate();
+        mScStoredRecords.clear();
     }
 
     // only initial load from local cache
@@ -13164,6 +14874,10 @@ void MegaClient::fetchnodes(bool nocache)
     {
         debugLogHeapUsage();
 
+        // the cached tree can be browsed right away, while user data is
+        // fetched and the action packets since cachedscsn are applied
+        app->nodes_cached();
+
         // Copy the current tag (the one from fetch nodes) so we can capture it in the lambda below.
         // ensuring no new request happens in between
         auto fetchnodesTag = reqtag;
@@ -14103,17 +15817,17 @@ void MegaClient::purgenodesusersabortsc(bool keepOwnUser)
 }
 
 // request direct read by node pointer
-void MegaClient::pread(Node* n, m_off_t offset, m_off_t count, void* appdata)
+void MegaClient::pread(Node* n, m_off_t offset, m_off_t count, void* appdata, bool sequential)
 {
     queueread(n->nodehandle, true, n->nodecipher(),
               MemAccess::get<int64_t>((const char*)n->nodekey().data() + SymmCipher::KEYLENGTH),
-              offset, count, appdata);
+              offset, count, appdata, NULL, NULL, NULL, sequential);
 }
 
 // request direct read by exported handle / key
-void MegaClient::pread(handle ph, SymmCipher* key, int64_t ctriv, m_off_t offset, m_off_t count, void* appdata, bool isforeign, const char *privauth, const char *pubauth, const char *cauth)
+void MegaClient::pread(handle ph, SymmCipher* key, int64_t ctriv, m_off_t offset, m_off_t count, void* appdata, bool isforeign, const char *privauth, const char *pubauth, const char *cauth, bool sequential)
 {
-    queueread(ph, isforeign, key, ctriv, offset, count, appdata, privauth, pubauth, cauth);
+    queueread(ph, isforeign, key, ctriv, offset, count, appdata, privauth, pubauth, cauth, sequential);
 }
 
 // since only the first six bytes of a handle are in use, we use the seventh to encode its type
@@ -14130,7 +15844,7 @@ bool MegaClient::isprivatehandle(handle* hp)
     return ((char*)hp)[NODEHANDLE] != 0;
 }
 
-void MegaClient::queueread(handle h, bool p, SymmCipher* key, int64_t ctriv, m_off_t offset, m_off_t count, void* appdata, const char* privauth, const char *pubauth, const char *cauth)
+void MegaClient::queueread(handle h, bool p, SymmCipher* key, int64_t ctriv, m_off_t offset, m_off_t count, void* appdata, const char* privauth, const char *pubauth, const char *cauth, bool sequential)
 {
     handledrn_map::iterator it;
 
@@ -14143,7 +15857,7 @@ void MegaClient::queueread(handle h, bool p, SymmCipher* key, int64_t ctriv, m_o
         // this handle is not being accessed yet: insert
         it = hdrns.insert(hdrns.end(), pair<handle, DirectReadNode*>(h, new DirectReadNode(this, h, p, key, ctriv, privauth, pubauth, cauth)));
         it->second->hdrn_it = it;
-        it->second->enqueue(offset, count, reqtag, appdata);
+        it->second->enqueue(offset, count, reqtag, appdata, sequential);
 
         if (overquotauntil && overquotauntil > Waiter::ds)
         {
@@ -14158,7 +15872,7 @@ void MegaClient::queueread(handle h, bool p, SymmCipher* key, int64_t ctriv, m_o
     }
     else
     {
-        it->second->enqueue(offset, count, reqtag, appdata);
+        it->second->enqueue(offset, count, reqtag, appdata, sequential);
         if (overquotauntil && overquotauntil > Waiter::ds)
         {
             dstime timeleft = dstime(overquotauntil - Waiter::ds);
@@ -14208,6 +15922,7 @@ void MegaClient::abortreads(handle h, bool p, m_off_t offset, m_off_t count)
 bool MegaClient::execdirectreads()
 {
     CodeCounter::ScopeTimer ccst(performanceStats.execdirectreads);
+    ExecLoopProfiler::Scope lps(loopProfiler, ExecLoopProfiler::TRANSFERS);
 
     bool r = false;
     DirectReadSlot* drs;
@@ -15067,11 +16782,14 @@ void MegaClient::addchild(remotenode_map* nchildren, string* name, Node* n, list
 // * attempt to execute renames, moves and deletions (deletions require the
 // rubbish flag to be set)
 // returns false if any local fs op failed transiently
-bool MegaClient::syncdown(LocalNode* l, LocalPath& localpath)
+bool MegaClient::syncdown(LocalNode* l, LocalPath& localpath, bool fullWalk)
 {
     static const dstime MONITOR_DELAY_SEC = 5;
 
     SyncdownContext cxt;
+    cxt.mFullWalk = fullWalk;
+
+    SyncOpTimer timer(*l->sync, l->sync->mSyncdownTime, "syncdown");
 
     if (!syncdown(l, localpath, cxt))
     {
@@ -15125,6 +16843,20 @@ bool MegaClient::syncdown(LocalNode* l, LocalPath& localpath)
     return true;
 }
 
+void MegaClient::setsyncdownpending(Node* n)
+{
+    // the folder it is (or was) in, and the one it is moving to
+    if (n->localnode && n->localnode->parent)
+    {
+        n->localnode->parent->setSyncdownPending();
+    }
+
+    if (n->parent && n->parent->localnode)
+    {
+        n->parent->localnode->setSyncdownPending();
+    }
+}
+
 bool MegaClient::syncdown(LocalNode* l, LocalPath& localpath, SyncdownContext& cxt)
 {
     // only use for LocalNodes with a corresponding and properly linked Node
@@ -15133,6 +16865,42 @@ bool MegaClient::syncdown(LocalNode* l, LocalPath& localpath, SyncdownContext& c
         return true;
     }
 
+    if (!cxt.mFullWalk && !l->syncdownPending)
+    {
+        if (!l->syncdownPendingBelow)
+        {
+            return true;
+        }
+
+        // nothing changed here: only descend towards the flagged folders
+        l->syncdownPendingBelow = false;
+
+        bool noTransientErrors = true;
+
+        for (auto& child : l->children)
+        {
+            LocalNode* ll = child.second;
+
+            if (ll->syncdownPending || ll->syncdownPendingBelow)
+            {
+                ScopedLengthRestore restoreLen(localpath);
+                localpath.appendWithSeparator(ll->getLocalname(), true);
+
+                noTransientErrors &= syncdown(ll, localpath, cxt);
+            }
+        }
+
+        return noTransientErrors;
+    }
+
+    // cleared up front: the retry after a transient error walks the whole tree
+    l->syncdownPending = false;
+    l->syncdownPendingBelow = false;
+
+    // files unloaded for the memory budget are needed to compare, and unloaded again once done
+    bool childrenUnloaded = l->childrenUnloaded;
+    l->sync->loadstatecachechildren(l, false);
+
     list<string> strings;
     remotenode_map nchildren;
     remotenode_map::iterator rit;
@@ -15592,6 +17360,9 @@ bool MegaClient::syncdown(LocalNode* l, LocalPath& localpath, SyncdownContext& c
                             ll->setnode(rit->second);
                             ll->sync->statecacheadd(ll);
 
+                            // the new folder's remote children are all still to be fetched
+                            ll->syncdownPending = true;
+
                             if (!syncdown(ll, localpath, cxt) && noTransientErrors)
                             {
                                 LOG_debug << "Syncdown not finished";
@@ -15618,6 +17389,11 @@ bool MegaClient::syncdown(LocalNode* l, LocalPath& localpath, SyncdownContext& c
         }
     }
 
+    if (childrenUnloaded && l->sync->overLocalNodeBudget())
+    {
+        l->sync->unloadchildren(l);
+    }
+
     return noTransientErrors;
 }
 
@@ -16041,14 +17817,16 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds, size_t& parentPending)
                 {
                     if (t)
                     {
+                        // only track size and mtime while the file keeps changing: its contents
+                        // are fingerprinted (and cached) once, when it has settled
                         ll->sync->localbytes -= ll->size;
-                        ll->genfingerprint(fa.get());
+                        ll->size = fa->size;
+                        ll->mtime = fa->mtime;
+                        ll->isvalid = false;
                         ll->sync->localbytes += ll->size;
-
-                        ll->sync->statecacheadd(ll);
                     }
 
-                    ll->bumpnagleds();
+                    ll->bumpunstableds();
 
                     LOG_debug << "Localnode not stable yet: " << ll->name << " " << t << " " << fa->size << " " << ll->size
                               << " " << fa->mtime << " " << ll->mtime << " " << ll->nagleds;
@@ -16061,6 +17839,25 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds, size_t& parentPending)
                     continue;
                 }
 
+                if (!ll->isvalid)
+                {
+                    // settled after changing under the stability check
+                    ll->genfingerprint(fa.get());
+                    ll->sync->statecacheadd(ll);
+
+                    if (!ll->isvalid)
+                    {
+                        ll->bumpunstableds();
+
+                        if (ll->nagleds < *nds)
+                        {
+                            *nds = ll->nagleds;
+                        }
+
+                        continue;
+                    }
+                }
+
                 ll->created = false;
             }
         }
@@ -16203,6 +18000,8 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds)
 {
     size_t numPending = 0;
 
+    SyncOpTimer timer(*l->sync, l->sync->mSyncupTime, "syncup");
+
     return syncup(l, nds, numPending) && numPending == 0;
 }
 
@@ -16225,6 +18024,21 @@ void MegaClient::syncupdate(localnode_vector& synccreate, bool canChangeVault)
     Node* n;
     LocalNode* l;
 
+    // uploads of backups that are still mirroring, queued last in the chosen order
+    localnode_vector backupUploads;
+
+    auto startUpload = [this](LocalNode* upload, TransferDbCommitter& committer)
+    {
+        upload->treestate(TREESTATE_PENDING);
+
+        // the overwrite (or replace) will happen upon PUT completion
+        startxfer(PUT, upload, committer, false, false, false, UseLocalVersioningFlag, nullptr, nextreqtag());
+
+        upload->sync->threadSafeState->transferBegin(PUT, upload->size);
+
+        LOG_debug << "Sync - sending file " << upload->getLocalPath();
+    };
+
     for (start = 0; start < synccreate.size(); start = end)
     {
         // determine length of distinct subtree beneath existing node
@@ -16323,14 +18137,15 @@ void MegaClient::syncupdate(localnode_vector& synccreate, bool canChangeVault)
             }
             else if (l->type == FILENODE)
             {
-                l->treestate(TREESTATE_PENDING);
-
-                // the overwrite (or replace) will happen upon PUT completion
-                startxfer(PUT, l, committer, false, false, false, UseLocalVersioningFlag, nullptr, nextreqtag());
-
-                l->sync->threadSafeState->transferBegin(PUT, l->size);
-
-                LOG_debug << "Sync - sending file " << l->getLocalPath();
+                if (syncs.mBackupUploadOrder != BACKUP_UPLOAD_ORDER_FIFO
+                    && l->sync->isBackupAndMirroring())
+                {
+                    backupUploads.push_back(l);
+                }
+                else
+                {
+                    startUpload(l, committer);
+                }
             }
         }
 
@@ -16363,6 +18178,17 @@ void MegaClient::syncupdate(localnode_vector& synccreate, bool canChangeVault)
         }
     }
 
+    if (!backupUploads.empty())
+    {
+        syncs.orderBackupUploads(backupUploads);
+
+        TransferDbCommitter committer(tctable);
+        for (LocalNode* upload : backupUploads)
+        {
+            startUpload(upload, committer);
+        }
+    }
+
     synccreate.clear();
 }
 
@@ -16849,7 +18675,7 @@ bool MegaClient::startxfer(direction_t d, File* f, TransferDbCommitter& committe
             }
             else if (d == PUT && ststatus == STORAGE_RED)
             {
-                t->failed(API_EOVERQUOTA, committer);
+                t->failed(API_EOVERQUOTA, committer, 0, true);
             }
             else if (ststatus == STORAGE_PAYWALL)
             {
@@ -16965,7 +18791,7 @@ bool MegaClient::startxfer(direction_t d, File* f, TransferDbCommitter& committe
             }
             else if (d == PUT && ststatus == STORAGE_RED)
             {
-                t->failed(API_EOVERQUOTA, committer);
+                t->failed(API_EOVERQUOTA, committer, 0, true);
             }
             else if (ststatus == STORAGE_PAYWALL)
             {
@@ -17017,6 +18843,7 @@ void MegaClient::pausexfers(direction_t d, bool pause, bool hard, TransferDbComm
     if (!pause || hard)
     {
         WAIT_CLASS::bumpds();
+        MegaClientAsyncQueue::Batch cryptoBatch(mAsyncQueue);
 
         for (transferslot_list::iterator it = tslots.begin(); it != tslots.end(); )
         {
@@ -17145,20 +18972,24 @@ static bool nodes_ctime_greater(const Node* a, const Node* b)
 
 namespace action_bucket_compare
 {
-    static bool compare(const Node* a, const Node* b, MegaClient* mc)
+    // what compare() looks at, worked out once per node rather than once per comparison
+    struct Key
+    {
+        Node* node;
+        size_t children;    // children of files represent previous versions
+        bool media;
+    };
+
+    static bool compare(const Key& a, const Key& b)
     {
-        if (a->owner != b->owner) return a->owner > b->owner;
-        if (a->parent != b->parent) return a->parent > b->parent;
+        if (a.node->owner != b.node->owner) return a.node->owner > b.node->owner;
+        if (a.node->parent != b.node->parent) return a.node->parent > b.node->parent;
 
         // added/updated - distinguish by versioning
-        size_t aChildrenCount = mc->getNumberOfChildren(a->nodeHandle());
-        size_t bChildrenCount = mc->getNumberOfChildren(b->nodeHandle());
-        if (aChildrenCount != bChildrenCount) return aChildrenCount > bChildrenCount;
+        if (a.children != b.children) return a.children > b.children;
 
         // media/nonmedia
-        bool a_media = mc->nodeIsMedia(a, nullptr, nullptr);
-        bool b_media = mc->nodeIsMedia(b, nullptr, nullptr);
-        if (a_media != b_media) return a_media && !b_media;
+        if (a.media != b.media) return a.media && !b.media;
 
         return false;
     }
@@ -17218,39 +19049,46 @@ bool MegaClient::nodeIsDocument(const Node *n) const
     return n->getMimeType() == MimeType_t::MIME_TYPE_DOCUMENT;
 }
 
-recentactions_vector MegaClient::getRecentActions(unsigned maxcount, m_time_t since)
+recentactions_vector MegaClient::getRecentActions(unsigned maxcount, m_time_t since, NodeManager::ClientLock* unlockable)
 {
     recentactions_vector rav;
-    node_vector v = mNodeManager.getRecentNodes(maxcount, since);
+    node_vector nodes = mNodeManager.getRecentNodes(maxcount, since, unlockable);
+
+    vector<action_bucket_compare::Key> v;
+    v.reserve(nodes.size());
+    for (Node* n : nodes)
+    {
+        v.push_back({n, getNumberOfChildren(n->nodeHandle()), nodeIsMedia(n, nullptr, nullptr)});
+    }
 
-    for (node_vector::iterator i = v.begin(); i != v.end(); )
+    for (auto i = v.begin(); i != v.end(); )
     {
         // find the oldest node, maximum 6h
-        node_vector::iterator bucketend = i + 1;
-        while (bucketend != v.end() && (*bucketend)->ctime > (*i)->ctime - 6 * 3600)
+        auto bucketend = i + 1;
+        while (bucketend != v.end() && bucketend->node->ctime > i->node->ctime - 6 * 3600)
         {
             ++bucketend;
         }
 
         // sort the defined bucket by owner, parent folder, added/updated and ismedia
-        std::sort(i, bucketend, [this](const Node* n1, const Node* n2) { return action_bucket_compare::compare(n1, n2, this); });
+        std::sort(i, bucketend, action_bucket_compare::compare);
 
         // split the 6h-bucket in different buckets according to their content
-        for (node_vector::iterator j = i; j != bucketend; ++j)
+        for (auto j = i; j != bucketend; ++j)
         {
-            if (i == j || action_bucket_compare::compare(*i, *j, this))
+            if (i == j || action_bucket_compare::compare(*i, *j))
             {
                 // add a new bucket
                 recentaction ra;
-                ra.time = (*j)->ctime;
-                ra.user = (*j)->owner;
-                ra.parent = (*j)->parent ? (*j)->parent->nodehandle : UNDEF;
-                ra.updated = getNumberOfChildren((*j)->nodeHandle());   // children of files represent previous versions
-                ra.media = nodeIsMedia(*j, nullptr, nullptr);
+                ra.time = j->node->ctime;
+                ra.user = j->node->owner;
+                ra.parent = j->node->parent ? j->node->parent->nodehandle : UNDEF;
+                ra.updated = j->children;
+                ra.media = j->media;
                 rav.push_back(ra);
             }
             // add the node to the bucket
-            rav.back().nodes.push_back(*j);
+            rav.back().nodes.push_back(j->node);
             i = j;
         }
         i = bucketend;
@@ -17314,6 +19152,11 @@ bool MegaClient::setmaxdownloadspeed(m_off_t bpslimit)
     return httpio->setmaxdownloadspeed(bpslimit >= 0 ? bpslimit : 0);
 }
 
+bool MegaClient::setmultiplexing(bool enable)
+{
+    return httpio->setmultiplexing(enable);
+}
+
 bool MegaClient::setmaxuploadspeed(m_off_t bpslimit)
 {
     return httpio->setmaxuploadspeed(bpslimit >= 0 ? bpslimit : 0);
@@ -18121,8 +19964,109 @@ const char* MegaClient::cancelLinkPrefix()
 }
 
 #ifdef MEGA_MEASURE_CODE
-std::string MegaClient::PerformanceStats::report(bool reset, HttpIO* httpio, Waiter* waiter, const RequestDispatcher& reqs)
+// how many parallel batches there are, and how many requests each one sent
+static std::string parallelBatchesReport(RequestDispatcher& reqs, bool reset)
+{
+    std::ostringstream s;
+    s << reqs.parallelBatches();
+    for (size_t i = 0; i < reqs.parallelBatches(); i++)
+    {
+        RequestDispatcher& batch = reqs.parallel(i);
+        uint64_t sent = 0;
+        for (auto n : batch.batchCommandsHistogram)
+        {
+            sent += n;
+        }
+        s << (i ? " " : " sent: ") << sent;
+
+        if (reset)
+        {
+            batch.batchCommandsHistogram.fill(0);
+            batch.batchBytesHistogram.fill(0);
+        }
+    }
+    return s.str();
+}
+
+void MegaClient::addMemoryUsage(MemoryReport& report)
+{
+    mNodeManager.addMemoryUsage(report);
+
+#ifdef ENABLE_SYNC
+    // measure a sample of the LocalNodes of each sync, breadth-first from its root
+    const size_t sampleSize = 1024;
+    syncs.forEachRunningSync([&report, sampleSize](Sync* sync)
+    {
+        uint64_t count = uint64_t(sync->localnodes[FILENODE]) + sync->localnodes[FOLDERNODE];
+        if (!count || !sync->localroot)
+        {
+            return;
+        }
+
+        vector<const LocalNode*> sample(1, sync->localroot.get());
+        uint64_t sampledBytes = 0;
+        for (size_t i = 0; i < sample.size(); i++)
+        {
+            sampledBytes += sample[i]->approximateSize();
+            for (auto& child : sample[i]->children)
+            {
+                if (sample.size() >= sampleSize)
+                {
+                    break;
+                }
+                sample.push_back(child.second);
+            }
+        }
+        report.add("localNodes", count, sampledBytes * count / sample.size());
+    });
+#endif
+
+    size_t pieces = 0;
+    size_t transferBytes = 0;
+    size_t requests = 0;
+    size_t requestBytes = 0;
+    auto addRequest = [&requests, &requestBytes](const HttpReq* req)
+    {
+        if (req)
+        {
+            requests++;
+            requestBytes += sizeof(HttpReq) + req->bufferedBytes();
+        }
+    };
+
+    for (TransferSlot* slot : tslots)
+    {
+        transferBytes += slot->transferbuf.bufferedBytes(pieces);
+        for (auto& req : slot->reqs)
+        {
+            addRequest(req.get());
+        }
+    }
+    for (DirectRead* dr : drq)
+    {
+        transferBytes += dr->drbuf.bufferedBytes(pieces);
+    }
+    for (DirectReadSlot* drs : drss)
+    {
+        for (HttpReq* req : drs->reqs)
+        {
+            addRequest(req);
+        }
+    }
+    addRequest(pendingcs);
+    addRequest(pendingsc.get());
+    addRequest(pendingscUserAlerts.get());
+
+    report.add("transferBuffers", pieces, transferBytes);
+    report.add("httpRequests", requests, requestBytes);
+
+    useralerts.addMemoryUsage(report);
+}
+
+std::string MegaClient::PerformanceStats::report(bool reset, HttpIO* httpio, Waiter* waiter, RequestDispatcher& reqs, MegaClientAsyncQueue& asyncQueue, NodeManager& nodeManager)
 {
+    TransferBufferPool::Stats pool = TransferBufferPool::stats(reset);
+    NodeManager::CacheStats nodeCache = nodeManager.getCacheStats(reset);
     std::ostringstream s;
     s << prepareWait.report(reset) << "\n"
         << doWait.report(reset) << "\n"
@@ -18139,10 +20083,31 @@ std::string MegaClient::PerformanceStats::report(bool reset, HttpIO* httpio, Wai
         << csSuccessProcessingTime.report(reset) << "\n"
         << " cs Request waiting time: " << csRequestWaitTime.report(reset) << "\n"
         << " cs requests sent/received: " << reqs.csRequestsSent << "/" << reqs.csRequestsCompleted << " batches: " << reqs.csBatchesSent << "/" << reqs.csBatchesReceived << "\n"
+        << reqs.batchSizeReport(reset)
+        << " parallel cs batches: " << parallelBatchesReport(reqs, reset) << "\n"
         << " transfers active time: " << transfersActiveTime.report(reset) << "\n"
         << " transfer starts/finishes: " << transferStarts << " " << transferFinishes << "\n"
         << " transfer temperror/fails: " << transferTempErrors << " " << transferFails << "\n"
-        << " nowait reason: immedate: " << prepwaitImmediate << " zero: " << prepwaitZero << " httpio: " << prepwaitHttpio << " fsaccess: " << prepwaitFsaccess << " nonzero waits: " << nonzeroWait << "\n";
+        << " nowait reason: immedate: " << prepwaitImmediate << " zero: " << prepwaitZero << " httpio: " << prepwaitHttpio << " fsaccess: " << prepwaitFsaccess << " nonzero waits: " << nonzeroWait << "\n"
+        << " worker threads: " << asyncQueue.threadCount() << " queue depth: " << asyncQueue.queueDepth() << " peak: " << asyncQueue.peakQueueDepth(reset) << "\n"
+        << " transfer buffers allocated/from pool: " << pool.allocations << "/" << pool.poolHits << " released/freed: " << pool.releases << "/" << pool.discards
+        << " cached: " << pool.cachedBuffers << " (" << pool.cachedBytes << " bytes) outstanding: " << pool.outstandingBytes << " bytes\n"
+        << " nodes in RAM: " << nodeManager.getNumberNodesInRam() << " hits/misses: " << nodeCache.hits << "/" << nodeCache.misses << " evictions: " << nodeCache.evictions << "\n";
+    if (waiter)
+    {
+        Waiter::NotifyStats wakeups = waiter->notifyStats(reset);
+        s << " waiter wakeups by source:";
+        for (int i = 0; i < Waiter::NOTIFY_SOURCES; i++)
+        {
+            s << " " << Waiter::notifySourceName(static_cast<Waiter::NotifySource>(i)) << ": " << wakeups.bySource[i];
+        }
+        s << " signalled: " << wakeups.signalled << "\n";
+    }
+#ifdef ENABLE_SYNC
+    DirNotify::Stats notifications = DirNotify::stats(reset);
+    s << " sync notifications received/coalesced: " << notifications.received << "/" << notifications.coalesced
+      << " checkpaths: " << notifications.checkpaths << "\n";
+#endif
 #ifdef USE_CURL
     if (auto curlhttpio = dynamic_cast<CurlHttpIO*>(httpio))
     {
@@ -18154,7 +20119,8 @@ std::string MegaClient::PerformanceStats::report(bool reset, HttpIO* httpio, Wai
 #ifdef MEGA_USE_C_ARES
             << curlhttpio->countProcessAresEventsCode.report(reset) << "\n"
 #endif
-            << curlhttpio->countProcessCurlEventsCode.report(reset) << "\n";
+            << curlhttpio->countProcessCurlEventsCode.report(reset) << "\n"
+            << curlhttpio->connectionStatsReport(reset);
     }
 #endif
 #ifdef WIN32
@@ -18390,6 +20356,94 @@ void MegaClient::removeSetElement(handle sid, handle eid, std::function<void(Err
     reqs.add(new CommandRemoveSetElement(this, sid, eid, completion));
 }
 
+void MegaClient::putSetElements(vector<SetElement>&& els, std::function<void(Error, const vector<const SetElement*>*, const vector<int64_t>*)> completion)
+{
+    // all Elements are new, and belong to the same Set
+    const Set* existingSet = els.empty() ? nullptr : getSet(els.front().set());
+    if (!existingSet)
+    {
+        LOG_err << "Sets: Set not found when adding Elements";
+        if (completion)
+            completion(API_ENOENT, nullptr, nullptr);
+        return;
+    }
+
+    vector<SetElement> toSend;
+    vector<pair<string, string>> encrDetails;
+    vector<int64_t> results(els.size(), API_OK);
+    toSend.reserve(els.size());
+    encrDetails.reserve(els.size());
+
+    for (size_t i = 0; i < els.size(); ++i)
+    {
+        SetElement& el = els[i];
+        Node* n = nullptr;
+        error e = API_OK;
+        if (el.set() != existingSet->id() || el.id() != UNDEF)
+        {
+            e = API_EARGS;
+        }
+        else
+        {
+            n = nodebyhandle(el.node());
+            e = !n ? API_ENOENT
+                   : (!n->keyApplied() || !n->nodecipher() || n->attrstring ? API_EKEY
+                      : (n->type != FILENODE ? API_EARGS : API_OK));
+        }
+
+        if (e != API_OK)
+        {
+            LOG_err << "Sets: Invalid node for Element: " << toNodeHandle(el.node());
+            results[i] = e;
+            continue;
+        }
+
+        // copy element.key from nodekey, and encrypt it with set.key
+        el.setKey(n->nodekey());
+        assert(el.key().size() == FILENODEKEYLENGTH);
+
+        byte encryptBuffer[FILENODEKEYLENGTH];
+        std::copy_n(el.key().begin(), sizeof(encryptBuffer), encryptBuffer);
+        tmpnodecipher.setkey(&existingSet->key());
+        tmpnodecipher.cbc_encrypt(encryptBuffer, sizeof(encryptBuffer));
+
+        string encrAttrs;
+        if (el.hasAttrs())
+        {
+            encrAttrs = el.encryptAttributes([this](const string_map& a, const string& k) { return encryptAttrs(a, k); });
+        }
+
+        encrDetails.emplace_back(string((char*)encryptBuffer, sizeof(encryptBuffer)), move(encrAttrs));
+        toSend.push_back(move(el));
+    }
+
+    if (toSend.empty())
+    {
+        if (completion)
+        {
+            vector<const SetElement*> none;
+            completion(API_OK, &none, &results);
+        }
+        return;
+    }
+
+    reqs.add(new CommandPutSetElements(this, move(toSend), encrDetails, move(results), completion));
+}
+
+void MegaClient::removeSetElements(handle sid, vector<handle>&& eids, std::function<void(Error, const vector<int64_t>*)> completion)
+{
+    if (!getSet(sid) || eids.empty())
+    {
+        if (completion)
+        {
+            completion(eids.empty() ? API_EARGS : API_ENOENT, nullptr);
+        }
+        return;
+    }
+
+    reqs.add(new CommandRemoveSetElements(this, sid, move(eids), completion));
+}
+
 bool MegaClient::procaesp()
 {
     bool ok = json.enterobject();
@@ -18859,6 +20913,35 @@ const map<handle, SetElement>* MegaClient::getSetElements(handle sid) const
     return itS == mSetElements.end() ? nullptr : &itS->second;
 }
 
+vector<const SetElement*> MegaClient::getSetElements(handle sid, size_t offset, size_t count) const
+{
+    vector<const SetElement*> page;
+
+    auto itS = mSetElements.find(sid);
+    if (itS == mSetElements.end() || offset >= itS->second.size() || !count)
+    {
+        return page;
+    }
+
+    page.reserve(itS->second.size());
+    for (const auto& e : itS->second)
+    {
+        page.push_back(&e.second);
+    }
+
+    // only the Elements up to the end of the page need to be in order
+    size_t end = offset + std::min(count, page.size() - offset);
+    std::partial_sort(page.begin(), page.begin() + end, page.end(),
+        [](const SetElement* a, const SetElement* b)
+        {
+            return a->order() < b->order() || (a->order() == b->order() && a->id() < b->id());
+        });
+
+    page.erase(page.begin() + end, page.end());
+    page.erase(page.begin(), page.begin() + offset);
+    return page;
+}
+
 bool MegaClient::deleteSetElement(handle sid, handle eid)
 {
     auto its = mSetElements.find(sid);
@@ -19273,13 +21356,9 @@ void MegaClient::notifypurgesetelements()
 
 void MegaClient::clearsetelementnotify(handle sid)
 {
-    for (size_t i = setelementnotify.size(); i; --i)
-    {
-        if (setelementnotify[i - 1]->set() == sid)
-        {
-            setelementnotify.erase(setelementnotify.begin() + i - 1);
-        }
-    }
+    setelementnotify.erase(std::remove_if(setelementnotify.begin(), setelementnotify.end(),
+                                          [sid](const SetElement* e) { return e->set() == sid; }),
+                           setelementnotify.end());
 }
 
 
@@ -19337,6 +21416,8 @@ NodeManager::NodeManager(MegaClient& client)
 void NodeManager::setTable(DBTableNodes *table)
 {
     mTable = table;
+    ++mTableGeneration;
+    mFingerprintFilter.invalidate();
 }
 
 void NodeManager::reset()
@@ -19572,17 +21653,141 @@ node_vector NodeManager::getChildrenFromType(const Node* parent, nodetype_t type
     return processUnserializedNodes(nodesFromTable, NodeHandle(), cancelToken);
 }
 
-node_vector NodeManager::getRecentNodes(unsigned maxcount, m_time_t since)
+bool NodeManager::getChildrenPage(const Node* parent, ChildrenOrder order, uint64_t offset, uint64_t limit, node_vector& children, CancelToken cancelToken)
+{
+    // nodes pending to be notified aren't in DB yet (or have changed since), so their order there is stale
+    if (!parent || !mTable || mNodes.empty() || !mNodeNotify.empty() || mNodeToWriteInDb)
+    {
+        return false;
+    }
+
+    std::vector<std::pair<NodeHandle, NodeSerialized>> nodesFromTable;
+    if (!mTable->getChildrenPage(parent->nodeHandle(), order, offset, limit, nodesFromTable, cancelToken))
+    {
+        return false;
+    }
+
+    if (cancelToken.isCancelled())
+    {
+        children.clear();
+        return true;
+    }
+
+    children = processUnserializedNodes(nodesFromTable, NodeHandle(), cancelToken);
+    return true;
+}
+
+node_vector NodeManager::getRecentNodes(unsigned maxcount, m_time_t since, ClientLock* unlockable)
 {
     if (!mTable || mNodes.empty())
     {
         return node_vector();
     }
 
-    std::vector<std::pair<NodeHandle, NodeSerialized>> nodesFromTable;
-    mTable->getRecentNodes(maxcount, since, nodesFromTable);
+    node_vector nodes;
+    if (getRecentNodesInMemory(maxcount, since, nodes))
+    {
+        return nodes;
+    }
 
-    return processUnserializedNodes(nodesFromTable);
+    nodes = getNodesFromTable([maxcount, since](DBTableNodes& table, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodesFromTable)
+    {
+        return table.getRecentNodes(maxcount, since, nodesFromTable);
+    }, unlockable, CancelToken());
+
+    if (!mTable)
+    {
+        // logged out while the lock was released
+        return nodes;
+    }
+
+    // the query returns every recent node from 'since' on, or the newest 'maxcount' of them: other
+    // nodes as old as the oldest of those might be missing, so they aren't covered
+    clearRecentNodes();
+    for (Node* n : nodes)
+    {
+        mRecentNodes.emplace(n->ctime, n->nodeHandle());
+    }
+    setRecentNodesFrom(nodes.size() < maxcount || nodes.empty() ? since : nodes.back()->ctime + 1);
+
+    return nodes;
+}
+
+bool NodeManager::getRecentNodesInMemory(unsigned maxcount, m_time_t since, node_vector& nodes)
+{
+    std::vector<NodeHandle> handles;
+    for (const auto& recent : mRecentNodes)
+    {
+        if (recent.first < since || handles.size() >= maxcount)
+        {
+            break;
+        }
+        handles.push_back(recent.second);
+    }
+
+    // nodes older than the index covers could be missing
+    if (handles.size() < maxcount && since < mRecentNodesFrom)
+    {
+        return false;
+    }
+
+    for (NodeHandle h : handles)
+    {
+        Node* n = getNodeByHandle(h);
+        if (!n)
+        {
+            assert(false);
+            clearRecentNodes();
+            nodes.clear();
+            return false;
+        }
+        nodes.push_back(n);
+    }
+
+    return true;
+}
+
+void NodeManager::updateRecentNodes(Node* n)
+{
+    if (n->type == FOLDERNODE && (n->changed.parent || n->changed.removed))
+    {
+        // the files below may have been moved into or out of the rubbish bin, without being notified
+        clearRecentNodes();
+        return;
+    }
+
+    if (n->type != FILENODE || mRecentNodesFrom == std::numeric_limits<m_time_t>::max())
+    {
+        return;
+    }
+
+    mRecentNodes.erase(std::make_pair(n->ctime, n->nodeHandle()));
+
+    uint64_t excludeFlags = (1 << Node::FLAGS_IS_VERSION | 1 << Node::FLAGS_IS_IN_RUBBISH);
+    if (!n->changed.removed && n->ctime >= mRecentNodesFrom && !(n->getDBFlag() & excludeFlags))
+    {
+        mRecentNodes.emplace(n->ctime, n->nodeHandle());
+
+        if (mRecentNodes.size() > MAX_RECENT_NODES)
+        {
+            setRecentNodesFrom(mRecentNodes.rbegin()->first + 1);
+        }
+    }
+}
+
+void NodeManager::setRecentNodesFrom(m_time_t from)
+{
+    mRecentNodesFrom = from;
+    while (!mRecentNodes.empty() && mRecentNodes.rbegin()->first < from)
+    {
+        mRecentNodes.erase(std::prev(mRecentNodes.end()));
+    }
+}
+
+void NodeManager::clearRecentNodes()
+{
+    mRecentNodes.clear();
+    mRecentNodesFrom = std::numeric_limits<m_time_t>::max();
 }
 
 uint64_t NodeManager::getNodeCount()
@@ -19620,7 +21825,7 @@ uint64_t NodeManager::getNodeCount()
     return count;
 }
 
-node_vector NodeManager::search(NodeHandle nodeHandle, const char *searchString, CancelToken cancelFlag, bool recursive)
+node_vector NodeManager::search(NodeHandle nodeHandle, const char *searchString, CancelToken cancelFlag, bool recursive, ClientLock* unlockable)
 {
     node_vector nodes;
     if (!mTable || mNodes.empty())
@@ -19629,69 +21834,267 @@ node_vector NodeManager::search(NodeHandle nodeHandle, const char *searchString,
         return nodes;
     }
 
-    std::vector<std::pair<NodeHandle, NodeSerialized>> nodesFromTable;
-    if (recursive)
-    {
-        mTable->searchForNodesByName(searchString, nodesFromTable, cancelFlag);
-    }
-    else
-    {
-        assert(!nodeHandle.isUndef());
-        mTable->searchForNodesByNameNoRecursive(searchString, nodesFromTable, nodeHandle, cancelFlag);
-    }
-
-    nodes = processUnserializedNodes(nodesFromTable, nodeHandle, cancelFlag);
+    assert(recursive || !nodeHandle.isUndef());
+    nodes = getNodesFromTable(searchQuery(nodeHandle, searchString, cancelFlag, recursive), unlockable, cancelFlag);
 
     return nodes;
 }
 
-node_vector NodeManager::getInSharesWithName(const char* searchString, CancelToken cancelFlag)
+bool NodeManager::searchPaged(NodeHandle nodeHandle, const char *searchString, CancelToken cancelFlag, bool recursive, size_t pageSize, const NodePage& onPage, ClientLock* unlockable)
 {
-    node_vector nodes;
     if (!mTable || mNodes.empty())
     {
         assert(false);
-        return nodes;
+        return false;
     }
 
-    std::vector<std::pair<NodeHandle, NodeSerialized>> nodesFromTable;
-    mTable->searchInShareOrOutShareByName(searchString, nodesFromTable, ShareType_t::IN_SHARES, cancelFlag);
-    nodes = processUnserializedNodes(nodesFromTable, NodeHandle(), cancelFlag);
-
-    return nodes;
-}
-
-node_vector NodeManager::getOutSharesWithName(const char* searchString, CancelToken cancelFlag)
-{
-    node_vector nodes;
-    if (!mTable || mNodes.empty())
-    {
-        assert(false);
-        return nodes;
-    }
+    assert(recursive || !nodeHandle.isUndef());
+    assert(pageSize);
+    TableQuery query = searchQuery(nodeHandle, searchString, cancelFlag, recursive);
 
     std::vector<std::pair<NodeHandle, NodeSerialized>> nodesFromTable;
-    mTable->searchInShareOrOutShareByName(searchString, nodesFromTable, ShareType_t::OUT_SHARES, cancelFlag);
-    nodes = processUnserializedNodes(nodesFromTable, NodeHandle(), cancelFlag);
-
-    return nodes;
-}
-
-node_vector NodeManager::getNodesByFingerprint(FileFingerprint &fingerprint)
-{
-    node_vector nodes;
-    if (!mTable || mNodes.empty())
+    if (!queryTable(query, unlockable, cancelFlag, nodesFromTable))
     {
-        assert(false);
-        return nodes;
+        return false;
     }
 
-    // Take first nodes in RAM
-    std::set<NodeHandle> fpLoaded;
-    auto p = mFingerPrints.equal_range(&fingerprint);
-    for (auto it = p.first; it != p.second; ++it)
+    std::set<NodeHandle> passed;
+    auto version = tableVersion();
+    size_t next = 0;
+    while (next < nodesFromTable.size())
     {
-        Node* node = static_cast<Node*>(*it);
+        std::vector<std::pair<NodeHandle, NodeSerialized>> page;
+        for (; next < nodesFromTable.size() && page.size() < pageSize; ++next)
+        {
+            if (passed.find(nodesFromTable[next].first) == passed.end())
+            {
+                page.push_back(std::move(nodesFromTable[next]));
+            }
+        }
+
+        node_vector nodes = processUnserializedNodes(page, NodeHandle(), cancelFlag);
+        if (cancelFlag.isCancelled() || nodes.size() != page.size())
+        {
+            return false;   // cancelled, or a node failed to unserialize
+        }
+
+        for (Node* n : nodes)
+        {
+            passed.insert(n->nodeHandle());
+        }
+        onPage(nodes);
+
+        if (unlockable && next < nodesFromTable.size())
+        {
+            // let the client in between pages
+            unlockable->unlock();
+            std::this_thread::yield();
+            unlockable->lock();
+
+            if (cancelFlag.isCancelled() || version.first != mTableGeneration || !mTable || mNodes.empty())
+            {
+                return false;
+            }
+
+            if (version != tableVersion())
+            {
+                // the remaining rows may be outdated
+                LOG_debug << "Nodes written during a paged search, running it again";
+                nodesFromTable.clear();
+                if (!queryTable(query, unlockable, cancelFlag, nodesFromTable))
+                {
+                    return false;
+                }
+                version = tableVersion();
+                next = 0;
+            }
+        }
+    }
+
+    return !cancelFlag.isCancelled();
+}
+
+bool NodeManager::walkTree(NodeHandle root, size_t prefetch, CancelToken cancelFlag, const NodeBatch& onBatch, ClientLock* unlockable)
+{
+    if (!mTable || mNodes.empty())
+    {
+        assert(false);
+        return false;
+    }
+
+    if (!prefetch)
+    {
+        prefetch = 1;
+    }
+
+    auto generation = mTableGeneration;
+    std::deque<NodeHandle> folders(1, root);
+
+    while (!folders.empty())
+    {
+        node_vector batch;
+        std::vector<NodeHandle> loaded;
+
+        for (size_t i = 0; i < prefetch && !folders.empty(); i++)
+        {
+            NodeHandle parent = folders.front();
+            folders.pop_front();
+
+            if (!mNodeNotify.empty() || mNodeToWriteInDb)
+            {
+                // changes not written to DB yet: go through the nodes in RAM
+                if (Node* p = getNodeByHandle(parent))
+                {
+                    node_list children = getChildren(p, cancelFlag);
+                    batch.insert(batch.end(), children.begin(), children.end());
+                }
+                continue;
+            }
+
+            std::vector<std::pair<NodeHandle, NodeSerialized>> children;
+            if (!mTable->getChildren(parent, children, cancelFlag))
+            {
+                return false;
+            }
+
+            for (const auto& child : children)
+            {
+                Node* n = getNodeInRAM(child.first);
+                if (!n)
+                {
+                    n = getNodeFromNodeSerialized(child.second);
+                    if (!n)
+                    {
+                        return false;
+                    }
+
+                    // folders stay, as parents of the next batches (evictNodes() takes care of them)
+                    if (n->type == FILENODE)
+                    {
+                        loaded.push_back(n->nodeHandle());
+                    }
+                }
+                batch.push_back(n);
+            }
+        }
+
+        if (cancelFlag.isCancelled())
+        {
+            return false;
+        }
+
+        for (Node* n : batch)
+        {
+            if (n->type != FILENODE)
+            {
+                folders.push_back(n->nodeHandle());
+            }
+        }
+
+        bool proceed = batch.empty() || onBatch(batch);
+
+        if (unlockable && (generation != mTableGeneration || !mTable || mNodes.empty()))
+        {
+            return false;   // logged out while the lock was released
+        }
+
+        if (!loaded.empty())
+        {
+            std::set<NodeHandle> pinned = getPinnedNodes();
+            for (NodeHandle h : loaded)
+            {
+                auto position = mNodes.find(h);
+                if (position != mNodes.end() && position->second.mNode && isEvictable(*position->second.mNode, pinned))
+                {
+                    evictNode(position);
+                }
+            }
+        }
+
+        if (!proceed || cancelFlag.isCancelled())
+        {
+            return false;
+        }
+
+        if (unlockable && !folders.empty())
+        {
+            // let the client in between batches
+            unlockable->unlock();
+            std::this_thread::yield();
+            unlockable->lock();
+
+            if (cancelFlag.isCancelled() || generation != mTableGeneration || !mTable || mNodes.empty())
+            {
+                return false;
+            }
+        }
+    }
+
+    return !cancelFlag.isCancelled();
+}
+
+std::pair<uint64_t, uint64_t> NodeManager::tableVersion() const
+{
+    return std::make_pair(mTableGeneration, mTable ? mTable->getNodesWrites() : 0);
+}
+
+NodeManager::TableQuery NodeManager::searchQuery(NodeHandle nodeHandle, const std::string& name, CancelToken cancelFlag, bool recursive)
+{
+    return [name, nodeHandle, cancelFlag, recursive](DBTableNodes& table, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodesFromTable)
+    {
+        // the table restricts the results to the subtree already
+        return recursive ? table.searchForNodesByName(name, nodesFromTable, nodeHandle, cancelFlag)
+                         : table.searchForNodesByNameNoRecursive(name, nodesFromTable, nodeHandle, cancelFlag);
+    };
+}
+
+node_vector NodeManager::getInSharesWithName(const char* searchString, CancelToken cancelFlag)
+{
+    node_vector nodes;
+    if (!mTable || mNodes.empty())
+    {
+        assert(false);
+        return nodes;
+    }
+
+    std::vector<std::pair<NodeHandle, NodeSerialized>> nodesFromTable;
+    mTable->searchInShareOrOutShareByName(searchString, nodesFromTable, ShareType_t::IN_SHARES, cancelFlag);
+    nodes = processUnserializedNodes(nodesFromTable, NodeHandle(), cancelFlag);
+
+    return nodes;
+}
+
+node_vector NodeManager::getOutSharesWithName(const char* searchString, CancelToken cancelFlag)
+{
+    node_vector nodes;
+    if (!mTable || mNodes.empty())
+    {
+        assert(false);
+        return nodes;
+    }
+
+    std::vector<std::pair<NodeHandle, NodeSerialized>> nodesFromTable;
+    mTable->searchInShareOrOutShareByName(searchString, nodesFromTable, ShareType_t::OUT_SHARES, cancelFlag);
+    nodes = processUnserializedNodes(nodesFromTable, NodeHandle(), cancelFlag);
+
+    return nodes;
+}
+
+node_vector NodeManager::getNodesByFingerprint(FileFingerprint &fingerprint)
+{
+    node_vector nodes;
+    if (!mTable || mNodes.empty())
+    {
+        assert(false);
+        return nodes;
+    }
+
+    // Take first nodes in RAM
+    std::set<NodeHandle> fpLoaded;
+    auto p = mFingerPrints.equal_range(&fingerprint);
+    for (auto it = p.first; it != p.second; ++it)
+    {
+        Node* node = static_cast<Node*>(*it);
         fpLoaded.emplace(node->nodeHandle());
         nodes.push_back(node);
     }
@@ -19702,10 +22105,15 @@ node_vector NodeManager::getNodesByFingerprint(FileFingerprint &fingerprint)
         return nodes;
     }
 
-    // Look for nodes at DB
-    std::vector<std::pair<NodeHandle, NodeSerialized>> nodesFromTable;
     std::string fingerprintString;
     fingerprint.FileFingerprint::serialize(&fingerprintString);
+    if (!fingerprintMayBeInDb(fingerprintString))
+    {
+        return nodes;
+    }
+
+    // Look for nodes at DB
+    std::vector<std::pair<NodeHandle, NodeSerialized>> nodesFromTable;
     mTable->getNodesByFingerprint(fingerprintString, nodesFromTable);
     if (nodesFromTable.size())
     {
@@ -19764,9 +22172,20 @@ Node *NodeManager::getNodeByFingerprint(FileFingerprint &fingerprint)
         return node;
     }
 
-    NodeSerialized nodeSerialized;
+    // all nodes with this fingerprint are already in RAM (and none matched)
+    if (mFingerPrints.allFingerprintsAreLoaded(&fingerprint))
+    {
+        return node;
+    }
+
     std::string fingerprintString;
     fingerprint.FileFingerprint::serialize(&fingerprintString);
+    if (!fingerprintMayBeInDb(fingerprintString))
+    {
+        return node;
+    }
+
+    NodeSerialized nodeSerialized;
     mTable->getNodeByFingerprint(fingerprintString, nodeSerialized);
     if (nodeSerialized.mNode.size()) // nodes with that fingerprint found in DB
     {
@@ -19776,6 +22195,57 @@ Node *NodeManager::getNodeByFingerprint(FileFingerprint &fingerprint)
     return node;
 }
 
+void NodeManager::preloadFingerprints(const std::vector<FileFingerprint>& fingerprints)
+{
+    if (!mTable || mNodes.empty())
+    {
+        return;
+    }
+
+    std::vector<const FileFingerprint*> pending;
+    std::vector<std::string> serialized;
+    for (const auto& fp : fingerprints)
+    {
+        if (fp.isvalid && !mFingerPrints.allFingerprintsAreLoaded(&fp))
+        {
+            FileFingerprint copy(fp);
+            std::string fingerprintString;
+            copy.FileFingerprint::serialize(&fingerprintString);
+            if (fingerprintMayBeInDb(fingerprintString))
+            {
+                pending.push_back(&fp);
+                serialized.push_back(std::move(fingerprintString));
+            }
+        }
+    }
+
+    if (pending.empty())
+    {
+        return;
+    }
+
+    std::vector<std::pair<NodeHandle, NodeSerialized>> nodesFromTable;
+    if (!mTable->getNodesByFingerprints(serialized, nodesFromTable))
+    {
+        return;
+    }
+
+    for (const auto& nodeIt : nodesFromTable)
+    {
+        if (!getNodeInRAM(nodeIt.first) && !getNodeFromNodeSerialized(nodeIt.second))
+        {
+            return;
+        }
+    }
+
+    for (auto fp : pending)
+    {
+        mFingerPrints.setAllFingerprintLoaded(fp);
+    }
+
+    LOG_debug << "Preloaded " << pending.size() << " fingerprints, " << nodesFromTable.size() << " nodes matched";
+}
+
 Node *NodeManager::childNodeByNameType(const Node* parent, const std::string &name, nodetype_t nodeType)
 {
     if (!mTable || mNodes.empty())
@@ -19911,7 +22381,7 @@ node_vector NodeManager::getNodesWithLinks()
     return getNodesWithSharesOrLink(ShareType_t::LINK);
 }
 
-node_vector NodeManager::getNodesByMimeType(MimeType_t mimeType, NodeHandle ancestorHandle, CancelToken cancelFlag)
+node_vector NodeManager::getNodesByMimeType(MimeType_t mimeType, NodeHandle ancestorHandle, CancelToken cancelFlag, ClientLock* unlockable)
 {
     if (!mTable || mNodes.empty())
     {
@@ -19919,10 +22389,10 @@ node_vector NodeManager::getNodesByMimeType(MimeType_t mimeType, NodeHandle ance
         return node_vector();
     }
 
-    std::vector<std::pair<NodeHandle, NodeSerialized>> nodesFromTable;
-    mTable->getNodesByMimetype(mimeType, nodesFromTable, cancelFlag);
-
-    return processUnserializedNodes(nodesFromTable, ancestorHandle, cancelFlag);
+    return getNodesFromTable([mimeType, ancestorHandle, cancelFlag](DBTableNodes& table, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodesFromTable)
+    {
+        return table.getNodesByMimetype(mimeType, nodesFromTable, ancestorHandle, cancelFlag);
+    }, unlockable, cancelFlag);
 }
 
 node_vector NodeManager::getNodesWithSharesOrLink(ShareType_t shareType)
@@ -19952,6 +22422,7 @@ Node *NodeManager::getNodeFromNodeSerialized(const NodeSerialized &nodeSerialize
     }
 
     node->setCounter(NodeCounter(nodeSerialized.mNodeCounter), false);
+    mCacheStats.misses++;
 
     return node;
 }
@@ -19972,11 +22443,46 @@ void NodeManager::updateTreeCounter(Node *origin, NodeCounter nc, OperationType
             break;
         }
 
-        origin->setCounter(ancestorCounter, true);
+        if (mBatchingCounters)
+        {
+            // 'changed.counter' stays set until the node is purged, so it's queued only once
+            if (!origin->changed.counter)
+            {
+                origin->changed.counter = true;
+                mCounterNotify.push_back(origin);
+            }
+            origin->setCounter(ancestorCounter, false);
+        }
+        else
+        {
+            origin->setCounter(ancestorCounter, true);
+        }
         origin = origin->parent;
     }
 }
 
+NodeManager::CounterBatch::CounterBatch(NodeManager& nodeManager)
+    : mNodeManager(nodeManager)
+    , mWasBatching(nodeManager.mBatchingCounters)
+{
+    mNodeManager.mBatchingCounters = true;
+}
+
+NodeManager::CounterBatch::~CounterBatch()
+{
+    mNodeManager.flushCounterNotifications();
+    mNodeManager.mBatchingCounters = mWasBatching;
+}
+
+void NodeManager::flushCounterNotifications()
+{
+    for (Node* n : mCounterNotify)
+    {
+        notifyNode(n);
+    }
+    mCounterNotify.clear();
+}
+
 NodeCounter NodeManager::calculateNodeCounter(const NodeHandle& nodehandle, nodetype_t parentType, Node* node, bool isInRubbish)
 {
     NodeCounter nc;
@@ -20101,6 +22607,11 @@ bool NodeManager::isAncestor(NodeHandle nodehandle, NodeHandle ancestor, CancelT
         return false;
     }
 
+    if (Node* node = getNodeInRAM(nodehandle))
+    {
+        return node->isAncestor(ancestor);
+    }
+
     return mTable->isAncestor(nodehandle, ancestor, cancelFlag);
 }
 
@@ -20118,11 +22629,16 @@ void NodeManager::removeChanges()
 void NodeManager::cleanNodes()
 {
     mFingerPrints.clear();
+    mFingerprintFilter.invalidate();
     mNodes.clear();
     mNodesInRam = 0;
     mNodeToWriteInDb.reset();
     mNodeNotify.clear();
+    mCounterNotify.clear();
     mNodesWithMissingParent.clear();
+    mEvictionHand = NodeHandle();
+    mPathCache.clear();
+    clearRecentNodes();
 
     mAccountReload = false;
 
@@ -20137,6 +22653,35 @@ Node *NodeManager::getNodeFromBlob(const std::string* nodeSerialized)
 
 // parse serialized node and return Node object - updates nodes hash and parent
 // mismatch vector
+NodeHandle NodeManager::parentHandleOf(const NodeSerialized& nodeSerialized)
+{
+    // size/type, handle, parent handle...
+    const string& d = nodeSerialized.mNode;
+    if (Node::isCompactBlob(d))
+    {
+        const char* data;
+        size_t length;
+        handle ph = 0;
+        if (!Node::blobField(d, Node::BLOB_PARENT, data, length) || length != MegaClient::NODEHANDLE)
+        {
+            return NodeHandle();
+        }
+
+        memcpy((char*)&ph, data, MegaClient::NODEHANDLE);
+        return NodeHandle().set6byte(ph);
+    }
+
+    if (d.size() < sizeof(m_off_t) + 2 * MegaClient::NODEHANDLE)
+    {
+        return NodeHandle();
+    }
+
+    handle ph = 0;
+    memcpy((char*)&ph, d.data() + sizeof(m_off_t) + MegaClient::NODEHANDLE, MegaClient::NODEHANDLE);
+
+    return ph ? NodeHandle().set6byte(ph) : NodeHandle();
+}
+
 Node *NodeManager::unserializeNode(const std::string *d, bool fromOldCache)
 {
     handle h, ph;
@@ -20154,137 +22699,305 @@ Node *NodeManager::unserializeNode(const std::string *d, bool fromOldCache)
     int i;
     char isExported = '\0';
     char hasLinkCreationTs = '\0';
+    const char* authKey = nullptr;
+    bool encrypted;
+    short numshares;
+    string fileAttrs;       // compact blobs only
+    string authKeyData;     // compact blobs only
+    string compactTail;     // compact blobs only
 
-    if (ptr + sizeof s + 2 * MegaClient::NODEHANDLE + MegaClient::USERHANDLE + 2 * sizeof ts + sizeof ll > end)
+    if (Node::isCompactBlob(*d))
     {
-        return NULL;
-    }
+        // the shares, attrs, link and encrypted data are gathered in 'compactTail'
+        // with the same layout as in legacy blobs, and read from there below
+        Node::BlobSpans fields;
+        if (!Node::blobFields(*d, fields))
+        {
+            return NULL;
+        }
 
-    s = MemAccess::get<m_off_t>(ptr);
-    ptr += sizeof s;
+        auto number = [&fields](Node::BlobField field, uint64_t& value) -> bool
+        {
+            const Node::BlobSpan& span = fields[field];
+            return span.first && span.second && Serialize64::unserialize((byte*)span.first, int(span.second), &value) == int(span.second);
+        };
 
-    if (s < 0 && s >= -RUBBISHNODE)
-    {
-        t = (nodetype_t)-s;
-    }
-    else
-    {
-        t = FILENODE;
-    }
+        auto copyHandle = [&fields](Node::BlobField field, handle& value, size_t size) -> bool
+        {
+            const Node::BlobSpan& span = fields[field];
+            if (!span.first || span.second != size)
+            {
+                return false;
+            }
 
-    h = 0;
-    memcpy((char*)&h, ptr, MegaClient::NODEHANDLE);
-    ptr += MegaClient::NODEHANDLE;
+            value = 0;
+            memcpy((char*)&value, span.first, size);
+            return true;
+        };
 
-    ph = 0;
-    memcpy((char*)&ph, ptr, MegaClient::NODEHANDLE);
-    ptr += MegaClient::NODEHANDLE;
+        uint64_t value;
+        if (!number(Node::BLOB_TYPE, value))
+        {
+            return NULL;
+        }
 
-    if (!ph)
-    {
-        ph = UNDEF;
-    }
+        t = static_cast<nodetype_t>(static_cast<int64_t>(value));
+        if (t < FILENODE || t > RUBBISHNODE)
+        {
+            return NULL;
+        }
+
+        if (t == FILENODE)
+        {
+            if (!number(Node::BLOB_SIZE, value))
+            {
+                return NULL;
+            }
+            s = static_cast<m_off_t>(value);
+        }
+        else
+        {
+            s = -t;
+        }
 
-    u = 0;
-    memcpy((char*)&u, ptr, MegaClient::USERHANDLE);
-    ptr += MegaClient::USERHANDLE;
+        if (!copyHandle(Node::BLOB_HANDLE, h, MegaClient::NODEHANDLE)
+                || !copyHandle(Node::BLOB_OWNER, u, MegaClient::USERHANDLE)
+                || !fields[Node::BLOB_ATTRS].first)
+        {
+            return NULL;
+        }
 
-    // FIME: use m_time_t / Serialize64 instead
-    ptr += sizeof(time_t);
+        ph = UNDEF;
+        if (fields[Node::BLOB_PARENT].first && !copyHandle(Node::BLOB_PARENT, ph, MegaClient::NODEHANDLE))
+        {
+            return NULL;
+        }
 
-    ts = (uint32_t)MemAccess::get<time_t>(ptr);
-    ptr += sizeof(time_t);
+        ts = 0;
+        if (fields[Node::BLOB_CTIME].first)
+        {
+            if (!number(Node::BLOB_CTIME, value))
+            {
+                return NULL;
+            }
+            ts = static_cast<m_time_t>(value);
+        }
 
-    if ((t == FILENODE) || (t == FOLDERNODE))
-    {
-        int keylen = ((t == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH);
+        encrypted = fields[Node::BLOB_ENCRYPTED].first != nullptr;
 
-        if (ptr + keylen + 8 + sizeof(short) > end)
+        const Node::BlobSpan& key = fields[Node::BLOB_KEY];
+        if (key.first)
+        {
+            int keylen = (t == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH;
+            if ((t != FILENODE && t != FOLDERNODE) || key.second != size_t(keylen))
+            {
+                return NULL;
+            }
+            k = (const byte*)key.first;
+        }
+        else if (!encrypted && (t == FILENODE || t == FOLDERNODE))
         {
             return NULL;
         }
 
-        k = (const byte*)ptr;
-        ptr += keylen;
-    }
+        if (t == FILENODE)
+        {
+            const Node::BlobSpan& fileAttrsSpan = fields[Node::BLOB_FILEATTRS];
+            if (fileAttrsSpan.first)
+            {
+                fileAttrs.assign(fileAttrsSpan.first, fileAttrsSpan.second);
+            }
+            fa = fileAttrs.c_str();
+        }
+        else
+        {
+            fa = NULL;
+        }
 
-    if (t == FILENODE)
-    {
-        ll = MemAccess::get<unsigned short>(ptr);
-        ptr += sizeof ll;
+        numshares = 0;
+        skey = NULL;
+        const Node::BlobSpan& shares = fields[Node::BLOB_SHARES];
+        if (shares.first)
+        {
+            size_t offset = sizeof numshares;
+            if (shares.second < offset)
+            {
+                return NULL;
+            }
+
+            numshares = MemAccess::get<short>(shares.first);
+            if (numshares)
+            {
+                if (shares.second < offset + SymmCipher::KEYLENGTH)
+                {
+                    return NULL;
+                }
+
+                skey = (const byte*)shares.first + offset;
+                offset += SymmCipher::KEYLENGTH;
+            }
+
+            compactTail.append(shares.first + offset, shares.second - offset);
+        }
+
+        compactTail.append(fields[Node::BLOB_ATTRS].first, fields[Node::BLOB_ATTRS].second);
 
-        if (ptr + ll > end)
+        const Node::BlobSpan& link = fields[Node::BLOB_LINK];
+        if (link.first)
         {
-            return NULL;
+            size_t authKeySize = link.second ? static_cast<unsigned char>(*link.first) : 0;
+            if (link.second < 1 + authKeySize)
+            {
+                return NULL;
+            }
+
+            authKeyData.assign(link.first + 1, authKeySize);
+            authKey = authKeyData.c_str();
+            isExported = 1;
+            hasLinkCreationTs = 1;
+            compactTail.append(link.first + 1 + authKeySize, link.second - 1 - authKeySize);
+        }
+
+        if (encrypted)
+        {
+            compactTail.append(fields[Node::BLOB_ENCRYPTED].first, fields[Node::BLOB_ENCRYPTED].second);
         }
 
-        fa = ptr;
-        ptr += ll;
+        ptr = compactTail.data();
+        end = ptr + compactTail.size();
     }
     else
     {
-        fa = NULL;
-    }
+        if (ptr + sizeof s + 2 * MegaClient::NODEHANDLE + MegaClient::USERHANDLE + 2 * sizeof ts + sizeof ll > end)
+        {
+            return NULL;
+        }
 
-    if (ptr + sizeof isExported + sizeof hasLinkCreationTs > end)
-    {
-        return NULL;
-    }
+        s = MemAccess::get<m_off_t>(ptr);
+        ptr += sizeof s;
 
-    isExported = MemAccess::get<char>(ptr);
-    ptr += sizeof(isExported);
+        if (s < 0 && s >= -RUBBISHNODE)
+        {
+            t = (nodetype_t)-s;
+        }
+        else
+        {
+            t = FILENODE;
+        }
 
-    hasLinkCreationTs = MemAccess::get<char>(ptr);
-    ptr += sizeof(hasLinkCreationTs);
+        h = 0;
+        memcpy((char*)&h, ptr, MegaClient::NODEHANDLE);
+        ptr += MegaClient::NODEHANDLE;
 
-    auto authKeySize = MemAccess::get<char>(ptr);
+        ph = 0;
+        memcpy((char*)&ph, ptr, MegaClient::NODEHANDLE);
+        ptr += MegaClient::NODEHANDLE;
 
-    ptr += sizeof authKeySize;
-    const char *authKey = nullptr;
-    if (authKeySize)
-    {
-        authKey = ptr;
-        ptr += authKeySize;
-    }
+        if (!ph)
+        {
+            ph = UNDEF;
+        }
 
-    if (ptr + (unsigned)*ptr > end)
-    {
-        return nullptr;
-    }
+        u = 0;
+        memcpy((char*)&u, ptr, MegaClient::USERHANDLE);
+        ptr += MegaClient::USERHANDLE;
 
-    auto encrypted = *ptr && ptr[1];
+        // FIME: use m_time_t / Serialize64 instead
+        ptr += sizeof(time_t);
 
-    ptr += (unsigned)*ptr + 1;
+        ts = (uint32_t)MemAccess::get<time_t>(ptr);
+        ptr += sizeof(time_t);
 
-    for (i = 4; i--;)
-    {
-        if (ptr + (unsigned char)*ptr < end)
+        if ((t == FILENODE) || (t == FOLDERNODE))
         {
-            ptr += (unsigned char)*ptr + 1;
+            int keylen = ((t == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH);
+
+            if (ptr + keylen + 8 + sizeof(short) > end)
+            {
+                return NULL;
+            }
+
+            k = (const byte*)ptr;
+            ptr += keylen;
         }
-    }
 
-    if (ptr + sizeof(short) > end)
-    {
-        return NULL;
-    }
+        if (t == FILENODE)
+        {
+            ll = MemAccess::get<unsigned short>(ptr);
+            ptr += sizeof ll;
+
+            if (ptr + ll > end)
+            {
+                return NULL;
+            }
 
-    short numshares = MemAccess::get<short>(ptr);
-    ptr += sizeof(numshares);
+            fa = ptr;
+            ptr += ll;
+        }
+        else
+        {
+            fa = NULL;
+        }
 
-    if (numshares)
-    {
-        if (ptr + SymmCipher::KEYLENGTH > end)
+        if (ptr + sizeof isExported + sizeof hasLinkCreationTs > end)
         {
             return NULL;
         }
 
-        skey = (const byte*)ptr;
-        ptr += SymmCipher::KEYLENGTH;
-    }
-    else
-    {
-        skey = NULL;
+        isExported = MemAccess::get<char>(ptr);
+        ptr += sizeof(isExported);
+
+        hasLinkCreationTs = MemAccess::get<char>(ptr);
+        ptr += sizeof(hasLinkCreationTs);
+
+        auto authKeySize = MemAccess::get<char>(ptr);
+
+        ptr += sizeof authKeySize;
+        if (authKeySize)
+        {
+            authKey = ptr;
+            ptr += authKeySize;
+        }
+
+        if (ptr + (unsigned)*ptr > end)
+        {
+            return nullptr;
+        }
+
+        encrypted = *ptr && ptr[1];
+
+        ptr += (unsigned)*ptr + 1;
+
+        for (i = 4; i--;)
+        {
+            if (ptr + (unsigned char)*ptr < end)
+            {
+                ptr += (unsigned char)*ptr + 1;
+            }
+        }
+
+        if (ptr + sizeof(short) > end)
+        {
+            return NULL;
+        }
+
+        numshares = MemAccess::get<short>(ptr);
+        ptr += sizeof(numshares);
+
+        if (numshares)
+        {
+            if (ptr + SymmCipher::KEYLENGTH > end)
+            {
+                return NULL;
+            }
+
+            skey = (const byte*)ptr;
+            ptr += SymmCipher::KEYLENGTH;
+        }
+        else
+        {
+            skey = NULL;
+        }
     }
 
     n = new Node(mClient, NodeHandle().set6byte(h), NodeHandle().set6byte(ph), t, s, u, fa, ts);
@@ -20292,7 +23005,8 @@ Node *NodeManager::unserializeNode(const std::string *d, bool fromOldCache)
     // The NodeManagerNode could have been added in the initial fetch nodes (without session)
     // Now, the node is loaded from DB, NodeManagerNode is updated with correct values
     mNodesInRam++;
-    auto& nodePosition = pair.first;
+    // loading the parent below may rehash mNodes: keep the element, not the iterator
+    NodePosition nodePosition = &*pair.first;
     assert(!nodePosition->second.mNode);
     nodePosition->second.mNode.reset(n);
     n->mNodePosition = nodePosition;
@@ -20344,7 +23058,7 @@ Node *NodeManager::unserializeNode(const std::string *d, bool fromOldCache)
     ptr = n->attrs.unserialize(ptr, end);
     if (!ptr)
     {
-        mNodes.erase(nodePosition);
+        mNodes.erase(NodeHandle().set6byte(h));
         LOG_err << "Failed to unserialize attrs";
         assert(false);
         return NULL;
@@ -20376,7 +23090,7 @@ Node *NodeManager::unserializeNode(const std::string *d, bool fromOldCache)
     {
         if (ptr + MegaClient::NODEHANDLE + sizeof(m_time_t) + sizeof(bool) > end)
         {
-            mNodes.erase(nodePosition);
+            mNodes.erase(NodeHandle().set6byte(h));
             return NULL;
         }
 
@@ -20404,7 +23118,7 @@ Node *NodeManager::unserializeNode(const std::string *d, bool fromOldCache)
         // Have we encoded the node key data's length?
         if (ptr + sizeof(uint32_t) > end)
         {
-            mNodes.erase(nodePosition);
+            mNodes.erase(NodeHandle().set6byte(h));
             return nullptr;
         }
 
@@ -20414,7 +23128,7 @@ Node *NodeManager::unserializeNode(const std::string *d, bool fromOldCache)
         // Have we encoded the node key data?
         if (ptr + length > end)
         {
-            mNodes.erase(nodePosition);
+            mNodes.erase(NodeHandle().set6byte(h));
             return nullptr;
         }
 
@@ -20424,7 +23138,7 @@ Node *NodeManager::unserializeNode(const std::string *d, bool fromOldCache)
         // Have we encoded the length of the attribute string?
         if (ptr + sizeof(uint32_t) > end)
         {
-            mNodes.erase(nodePosition);
+            mNodes.erase(NodeHandle().set6byte(h));
             return nullptr;
         }
 
@@ -20434,7 +23148,7 @@ Node *NodeManager::unserializeNode(const std::string *d, bool fromOldCache)
         // Have we encoded the attribute string?
         if (ptr + length > end)
         {
-            mNodes.erase(nodePosition);
+            mNodes.erase(NodeHandle().set6byte(h));
             return nullptr;
         }
 
@@ -20455,7 +23169,7 @@ Node *NodeManager::unserializeNode(const std::string *d, bool fromOldCache)
     }
     else
     {
-        mNodes.erase(nodePosition);
+        mNodes.erase(NodeHandle().set6byte(h));
         return NULL;
     }
 }
@@ -20464,22 +23178,40 @@ void NodeManager::applyKeys(uint32_t appliedKeys)
 {
     if (mNodes.size() > appliedKeys)
     {
+        vector<Node*> nodes;
         for (auto& it : mNodes)
         {
-            if (it.second.mNode)
+            Node* n = it.second.mNode;
+            if (n && (n->type > FOLDERNODE || !n->keyApplied()))
             {
-                it.second.mNode->applykey();
+                nodes.push_back(n);
             }
         }
+
+        mClient.applynodekeys(nodes);
     }
 }
 
 void NodeManager::notifyPurge()
 {
+    // nodes are deleted below, so none may be left pending
+    flushCounterNotifications();
+
     if (mNodeNotify.size())
     {
         mClient.applykeys();
 
+        for (Node* n : mNodeNotify)
+        {
+            if (n->changed.removed || n->changed.newnode || n->changed.parent
+                    || n->changed.attrs || n->changed.name)
+            {
+                mPathCache.invalidate(n->nodeHandle(), n->parentHandle(), n->displayname());
+            }
+
+            updateRecentNodes(n);
+        }
+
         if (!mClient.fetchingnodes)
         {
             mClient.app->nodes_updated(&mNodeNotify.data()[0], static_cast<int>(mNodeNotify.size()));
@@ -20666,6 +23398,9 @@ void NodeManager::notifyPurge()
         unsigned removed = 0;
         unsigned added = 0;
 
+        // nodes to write whole, all at once after the loop
+        node_vector nodesToPut;
+
         // check all notified nodes for removed status and purge
         for (size_t i = 0; i < mNodeNotify.size(); i++)
         {
@@ -20684,6 +23419,9 @@ void NodeManager::notifyPurge()
 #endif
             }
 
+            // the ancestors of a big moved or removed subtree only have their counter to update
+            bool counterOnly = false;
+
             if (n->changed.removed)
             {
                 // remove inbound share
@@ -20695,11 +23433,25 @@ void NodeManager::notifyPurge()
             }
             else
             {
+                counterOnly = n->changed.counter
+                        && !(n->changed.attrs || n->changed.owner || n->changed.ctime
+                             || n->changed.fileattrstring || n->changed.inshare
+                             || n->changed.outshares || n->changed.pendingshares
+                             || n->changed.parent || n->changed.publiclink
+                             || n->changed.newnode || n->changed.name || n->changed.favourite);
+
                 n->notified = false;
                 memset(&(n->changed), 0, sizeof(n->changed));
                 n->changed.modifiedByThisClient = false;
             }
 
+#ifdef ENABLE_SYNC
+            if (!counterOnly)
+            {
+                mClient.setsyncdownpending(n);
+            }
+#endif
+
             if (!mTable)
             {
                 assert(false);
@@ -20708,10 +23460,15 @@ void NodeManager::notifyPurge()
 
             if (n->changed.removed)
             {
+                // written first: below, the removal detaches the children of 'n'
+                saveNodesInDb(nodesToPut);
+                nodesToPut.clear();
+
                 NodeHandle h = n->nodeHandle();
 
                 // Decrease counters for all ancestor in the tree
                 updateTreeCounter(n->parent, n->getCounter(), DECREASE);
+                flushCounterNotifications();
 
                 if (n->parent)
                 {
@@ -20731,23 +23488,32 @@ void NodeManager::notifyPurge()
                 // effectively delete node from RAM
                 mNodesWithMissingParent.erase(h);
                 mNodesInRam--;
-                mNodes.erase(n->mNodePosition);
+                mNodes.erase(h);
 
                 mTable->remove(h);
 
                 removed += 1;
             }
+            else if (counterOnly)
+            {
+                // the rest of the row is unchanged: rewrite just the counter column
+                mTable->updateCounter(n->nodeHandle(), n->getCounter().serialize());
+
+                added += 1;
+            }
             else
             {
                 // TODO nodes on demand: avoid to write to DB if the only change
                 // is 'changed.newnode', since the node is already written to DB
                 // when it is received from API, in 'saveNodeInRam()'
-                mTable->put(n);
+                nodesToPut.push_back(n);
 
                 added += 1;
             }
         }
 
+        saveNodesInDb(nodesToPut);
+
         if (removed)
         {
             LOG_verbose << mClient.clientname << "Removed " << removed << " nodes from database";
@@ -20761,80 +23527,287 @@ void NodeManager::notifyPurge()
     }
 }
 
-bool NodeManager::hasCacheLoaded()
-{
-    return mNodes.size();
-}
-
-bool NodeManager::loadNodes()
+bool NodeManager::removeSubtree(Node* root)
 {
-    if (!mTable)
+    const NodeCounter& counter = root->getCounter();
+    if (!mTable || mClient.fetchingnodes || root->type != FOLDERNODE
+            || counter.files + counter.folders + counter.versions < MIN_BULK_REMOVED_NODES
+            || (root->notified && root->changed.newnode))
     {
-        assert(false);
         return false;
     }
 
-    node_vector rootnodes = getRootNodes();
-    // We can't base in `user.sharing` because it's set yet. We have to get from DB
-    node_vector inshares = getNodesWithInShares();  // it includes nested inshares
-
-    for (auto &node : rootnodes)
+    // the DB finds the subtree by the paths it stores: a move not written yet would mislead it
+    for (Node* n : mNodeNotify)
     {
-        getChildren(node);
+        if (n->changed.parent)
+        {
+            return false;
+        }
     }
 
-    return true;
-}
+#ifdef ENABLE_SYNC
+    // synced nodes are followed by their LocalNodes, even unloaded ones: leave them to TreeProcDel
+    bool synced = false;
+    mClient.syncs.forEachUnifiedSync([&](UnifiedSync& us)
+    {
+        NodeHandle remote = us.mConfig.mRemoteNode;
+        synced = synced || (!remote.isUndef()
+                            && (remote == root->nodeHandle()
+                                || mTable->isAncestor(remote, root->nodeHandle(), CancelToken())
+                                || mTable->isAncestor(root->nodeHandle(), remote, CancelToken())));
+    });
 
-Node* NodeManager::getNodeInRAM(NodeHandle handle)
-{
-    auto itNode = mNodes.find(handle);
-    if (itNode != mNodes.end() && itNode->second.mNode)
+    if (synced)
     {
-        return itNode->second.mNode.get();
+        return false;
     }
+#endif
 
-    return nullptr;
-}
+    std::set<NodeHandle> pinned = getPinnedNodes();
 
-void NodeManager::saveNodeInRAM(Node *node, bool isRootnode)
-{
-    auto pair = mNodes.emplace(node->nodeHandle(), NodeManagerNode());
-    // The NodeManagerNode could have been added by NodeManager::addChild() but, in that case, mNode would be invalid
-    mNodesInRam++;
-    auto& nodePosition = pair.first;
-    assert(!nodePosition->second.mNode);
-    nodePosition->second.mNode.reset(node);
-    nodePosition->second.mAllChildrenHandleLoaded = true; // Receive a new node, children aren't received yet or they are stored a mNodesWithMissingParents
-    node->mNodePosition = nodePosition;
+    // the descendants known in RAM (loaded or not), parents first
+    std::vector<NodeHandle> known;
+    std::unordered_map<NodeHandle, NodeHandle, NodeHandleHash> parents;
+    known.push_back(root->nodeHandle());
+    for (size_t i = 0; i < known.size(); i++)
+    {
+        auto it = mNodes.find(known[i]);
+        if (it != mNodes.end() && it->second.mChildren)
+        {
+            for (const auto& child : *it->second.mChildren)
+            {
+                known.push_back(child.first);
+                parents[child.first] = known[i];
+            }
+        }
+    }
 
-    // In case of rootnode, no need to add to mNodesWithMissingParent
-    if (!isRootnode)
+    // children first: a node is kept while it, or any descendant, has to be removed one by one
+    std::set<NodeHandle> withKeptChildren;
+    size_t dropped = 0;
+    size_t keptCount = 0;
+    for (size_t i = known.size(); i-- > 1; )
     {
-        Node *parent = nullptr;
-        if ((parent = getNodeByHandle(node->parentHandle())))
+        NodeHandle h = known[i];
+        NodeHandle parent = parents[h];
+        auto it = mNodes.find(h);
+        Node* n = it != mNodes.end() ? it->second.mNode.get() : nullptr;
+
+        bool keep = withKeptChildren.count(h) || (n && (n->notified || n->inshare || n->outshares || n->pendingshares
+                                                        || n->plink || n->appdata || pinned.count(h)));
+#ifdef ENABLE_SYNC
+        keep = keep || (n && (n->localnode || n->syncget
+                              || n->todebris_it != mClient.toDebris.end() || n->tounlink_it != mClient.toUnlink.end()));
+#endif
+
+        if (keep)
         {
-            node->setparent(parent);
+            withKeptChildren.insert(parent);
+            if (n)
+            {
+                n->changed.removed = true;
+                notifyNode(n);
+                keptCount++;
+            }
+            continue;
         }
-        else
+
+        // the parent may still be kept by a sibling not visited yet
+        auto parentIt = mNodes.find(parent);
+        if (parentIt != mNodes.end() && parentIt->second.mChildren)
         {
-            addNodeWithMissingParent(node);
+            parentIt->second.mChildren->erase(h);
         }
-    }
 
-    auto it = mNodesWithMissingParent.find(node->nodeHandle());
-    if (it != mNodesWithMissingParent.end())
-    {
-        for (Node* n : it->second)
+        if (it == mNodes.end())
         {
-            n->setparent(node);
+            continue;
         }
 
-        mNodesWithMissingParent.erase(it);
+        if (n)
+        {
+            if (n->type == FILENODE)
+            {
+                removeFingerprint(n);
+            }
+            mNodesInRam--;
+            dropped++;
+        }
+
+        if (mEvictionHand == h)
+        {
+            mEvictionHand = NodeHandle();
+        }
+
+        mNodesWithMissingParent.erase(h);
+        mNodes.erase(it);
     }
-}
 
-bool NodeManager::isRootNode(NodeHandle h) const
+    // the children left to 'root' are those kept: none is to be read from DB again
+    root->mNodePosition->second.mAllChildrenHandleLoaded = true;
+
+    mTable->removeSubtree(root->nodeHandle());
+
+    // cached paths may start anywhere below 'root'
+    mPathCache.clear();
+
+    root->changed.removed = true;
+    notifyNode(root);
+
+    LOG_debug << mClient.clientname << "Removed subtree " << root->nodeHandle() << " from database at once, "
+              << dropped << " nodes dropped from RAM, " << keptCount << " left to be notified";
+
+    return true;
+}
+
+void NodeManager::removeVersions()
+{
+    NodeHandle files = getRootNodeFiles();
+    if (!mTable || mClient.fetchingnodes || files.isUndef())
+    {
+        return;
+    }
+
+    // the DB finds the versions by the paths and flags it stores: a move not written yet would mislead it
+    for (Node* n : mNodeNotify)
+    {
+        if (n->changed.parent)
+        {
+            return;
+        }
+    }
+
+    std::vector<DBTableNodes::VersionsRecord> versions;
+    if (!mTable->getVersions(files, versions) || versions.empty())
+    {
+        return;
+    }
+
+    size_t dropped = 0;
+    {
+        CounterBatch batch(*this);
+
+        for (const auto& record : versions)
+        {
+            Node* file = getNodeByHandle(record.file);
+            if (!file)
+            {
+                continue;
+            }
+
+            if (Node* version = getNodeInRAM(record.newestVersion))
+            {
+                // its removal updates the counters when purged
+                TreeProcDel td;
+                mClient.proctree(version, &td);
+                continue;
+            }
+
+            // older versions aren't in RAM either, since nodes are loaded with their ancestors
+            updateTreeCounter(file, NodeCounter(record.counter), DECREASE);
+
+            NodeManagerNode& fileEntry = file->mNodePosition->second;
+            if (fileEntry.mChildren)
+            {
+                fileEntry.mChildren->erase(record.newestVersion);
+            }
+            fileEntry.mAllChildrenHandleLoaded = true;
+
+            auto it = mNodes.find(record.newestVersion);
+            if (it != mNodes.end() && !it->second.mNode)
+            {
+                mNodes.erase(it);
+            }
+
+            dropped++;
+        }
+    }
+
+    mTable->removeVersions(files);
+
+    LOG_debug << mClient.clientname << "Removed the versions of " << versions.size() << " files from database at once, "
+              << (versions.size() - dropped) << " left to be notified";
+}
+
+bool NodeManager::hasCacheLoaded()
+{
+    return mNodes.size();
+}
+
+bool NodeManager::loadNodes()
+{
+    if (!mTable)
+    {
+        assert(false);
+        return false;
+    }
+
+    node_vector rootnodes = getRootNodes();
+    // We can't base in `user.sharing` because it's set yet. We have to get from DB
+    node_vector inshares = getNodesWithInShares();  // it includes nested inshares
+
+    for (auto &node : rootnodes)
+    {
+        getChildren(node);
+    }
+
+    rebuildFingerprintFilter();
+
+    return true;
+}
+
+Node* NodeManager::getNodeInRAM(NodeHandle handle)
+{
+    auto itNode = mNodes.find(handle);
+    if (itNode != mNodes.end() && itNode->second.mNode)
+    {
+        itNode->second.mReferenced = true;
+        mCacheStats.hits++;
+        return itNode->second.mNode.get();
+    }
+
+    return nullptr;
+}
+
+void NodeManager::saveNodeInRAM(Node *node, bool isRootnode)
+{
+    auto pair = mNodes.emplace(node->nodeHandle(), NodeManagerNode());
+    // The NodeManagerNode could have been added by NodeManager::addChild() but, in that case, mNode would be invalid
+    mNodesInRam++;
+    NodePosition nodePosition = &*pair.first;
+    assert(!nodePosition->second.mNode);
+    nodePosition->second.mNode.reset(node);
+    nodePosition->second.mAllChildrenHandleLoaded = true; // Receive a new node, children aren't received yet or they are stored a mNodesWithMissingParents
+    node->mNodePosition = nodePosition;
+
+    // In case of rootnode, no need to add to mNodesWithMissingParent
+    if (!isRootnode)
+    {
+        Node *parent = nullptr;
+        if ((parent = getNodeByHandle(node->parentHandle())))
+        {
+            node->setparent(parent);
+        }
+        else
+        {
+            addNodeWithMissingParent(node);
+        }
+    }
+
+    auto it = mNodesWithMissingParent.find(node->nodeHandle());
+    if (it != mNodesWithMissingParent.end())
+    {
+        for (Node* n : it->second)
+        {
+            n->setparent(node);
+        }
+
+        mNodesWithMissingParent.erase(it);
+    }
+}
+
+bool NodeManager::isRootNode(NodeHandle h) const
 {
     return h == mClient.mNodeManager.getRootNodeFiles()
             || h == mClient.mNodeManager.getRootNodeVault()
@@ -20904,13 +23877,21 @@ void NodeManager::initCompleted()
         return;
     }
 
-    node_vector rootNodes = getRootNodesAndInshares();
-    for (Node* node : rootNodes)
     {
-        calculateNodeCounter(node->nodeHandle(), TYPE_UNKNOWN, node, node->type == RUBBISHNODE);
+        CodeCounter::ScopeTimer ccst(mClient.performanceStats.nodeCounters);
+        node_vector rootNodes = getRootNodesAndInshares();
+        for (Node* node : rootNodes)
+        {
+            calculateNodeCounter(node->nodeHandle(), TYPE_UNKNOWN, node, node->type == RUBBISHNODE);
+        }
     }
 
-    mTable->createIndexes();
+    {
+        CodeCounter::ScopeTimer ccst(mClient.performanceStats.createIndexes);
+        mTable->createIndexes();
+    }
+
+    rebuildFingerprintFilter();
 }
 
 void NodeManager::fatalError(ReasonsToReload reloadReason)
@@ -20970,6 +23951,30 @@ NodeCounter NodeManager::getCounterOfRootNodes()
     return c;
 }
 
+bool NodeManager::getCounterByHandle(NodeHandle handle, NodeCounter& counter)
+{
+    if (mNodes.empty() || !mTable)
+    {
+        return false;
+    }
+
+    // counters in memory may be ahead of the DB until the node is purged
+    if (Node* node = getNodeInRAM(handle))
+    {
+        counter = node->getCounter();
+        return true;
+    }
+
+    std::string blob;
+    if (!mTable->getNodeCounter(handle, blob))
+    {
+        return false;
+    }
+
+    counter = NodeCounter(blob);
+    return true;
+}
+
 void NodeManager::updateCounter(Node& n, Node* oldParent)
 {
     NodeCounter nc = n.getCounter();
@@ -21004,6 +24009,14 @@ void NodeManager::updateCounter(Node& n, Node* oldParent)
 
 mega::FingerprintPosition NodeManager::insertFingerprint(Node *node)
 {
+    // the node is (or will be) in DB with this fingerprint
+    if (node->type == FILENODE && mFingerprintFilter.isValid())
+    {
+        std::string fingerprintString;
+        node->FileFingerprint::serialize(&fingerprintString);
+        mFingerprintFilter.add(fingerprintString);
+    }
+
     // if node is not to be kept in memory, don't save the pointer in the set
     // since it will be invalid once node is written to DB
     if (node->type == FILENODE && mNodeToWriteInDb.get() != node)
@@ -21030,6 +24043,30 @@ FingerprintPosition NodeManager::invalidFingerprintPos()
     return mFingerPrints.end();
 }
 
+void NodeManager::rebuildFingerprintFilter()
+{
+    if (!mTable)
+    {
+        mFingerprintFilter.invalidate();
+        return;
+    }
+
+    uint64_t numNodes = mTable->getNumberOfNodes();
+    mFingerprintFilter.reset(numNodes);
+    if (!mTable->getAllFingerprints([this](const std::string& fingerprint) { mFingerprintFilter.add(fingerprint); }))
+    {
+        mFingerprintFilter.invalidate();
+        return;
+    }
+
+    LOG_debug << "Fingerprint filter built for " << numNodes << " nodes";
+}
+
+bool NodeManager::fingerprintMayBeInDb(const std::string& fingerprint) const
+{
+    return !mFingerprintFilter.isValid() || mFingerprintFilter.mayContain(fingerprint);
+}
+
 void NodeManager::dumpNodes()
 {
     if (!mTable)
@@ -21038,13 +24075,16 @@ void NodeManager::dumpNodes()
         return;
     }
 
+    node_vector nodes;
+    nodes.reserve(mNodes.size());
     for (auto &it : mNodes)
     {
         if (it.second.mNode)
         {
-            mTable->put(it.second.mNode.get());
+            nodes.push_back(it.second.mNode.get());
         }
     }
+    saveNodesInDb(nodes);
 
     mTable->createIndexes();
 }
@@ -21057,6 +24097,7 @@ void NodeManager::saveNodeInDb(Node *node)
         return;
     }
 
+    CodeCounter::ScopeTimer ccst(mClient.performanceStats.saveNodeInDb);
     mTable->put(node);
 
     if (mNodeToWriteInDb)   // not to be kept in memory
@@ -21066,118 +24107,796 @@ void NodeManager::saveNodeInDb(Node *node)
     }
 }
 
-uint64_t NodeManager::getNumberNodesInRam() const
-{
-    return mNodesInRam;
-}
-
-void NodeManager::addChild(NodeHandle parent, NodeHandle child, Node* node)
-{
-    auto pair = mNodes.emplace(parent, NodeManagerNode());
-    // The NodeManagerNode could have been added in add node, only update the child
-    assert(!pair.first->second.mChildren || !(*pair.first->second.mChildren)[child]);
-    if (!pair.first->second.mChildren)
-    {
-        pair.first->second.mChildren = ::mega::make_unique<std::map<NodeHandle, Node*>>();
-    }
-    (*pair.first->second.mChildren)[child] = node;
-}
-
-void NodeManager::removeChild(Node* parent, NodeHandle child)
-{
-    assert(parent->mNodePosition->second.mChildren);
-    if (parent->mNodePosition->second.mChildren)
-    {
-        parent->mNodePosition->second.mChildren->erase(child);
-    }
-}
-
-Node* NodeManager::getNodeFromDataBase(NodeHandle handle)
+void NodeManager::saveNodesInDb(const node_vector& nodes)
 {
     if (!mTable)
     {
-        assert(!mClient.loggedin());
-        return nullptr;
+        assert(false);
+        return;
     }
 
-    Node* node = nullptr;
-    NodeSerialized nodeSerialized;
-    if (mTable->getNode(handle, nodeSerialized))
+    if (nodes.empty())
     {
-        node = getNodeFromNodeSerialized(nodeSerialized);
+        return;
     }
 
-    return node;
-}
+    CodeCounter::ScopeTimer ccst(mClient.performanceStats.saveNodesInDb);
 
-node_vector NodeManager::getRootNodesAndInshares()
-{
-    node_vector rootnodes;
+    vector<string> serialized(nodes.size());
 
-    rootnodes = getRootNodes();
-    if (!mClient.loggedIntoFolder()) // logged into user's account: incoming shared folders
+    // serializing only reads the node, unless it's still encrypted: then it tries to
+    // apply the key, which needs the client, so those are left for this thread
+    vector<bool> encrypted(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++)
     {
-        node_vector inshares = mClient.getInShares();
-        rootnodes.insert(rootnodes.end(), inshares.begin(), inshares.end());
+        encrypted[i] = !!nodes[i]->attrstring;
     }
 
-    return rootnodes;
-}
-
-node_vector NodeManager::processUnserializedNodes(const std::vector<std::pair<NodeHandle, NodeSerialized> >& nodesFromTable, NodeHandle ancestorHandle, CancelToken cancelFlag)
-{
-    node_vector nodes;
+    // a Batch would hold the work back while this thread waits for it
+    bool parallel = nodes.size() >= MIN_PARALLEL_SERIALIZED_NODES && !mClient.mAsyncQueue.batching();
+    size_t shares = parallel ? mClient.mAsyncQueue.threadCount() + 1 : 1;
+    size_t perShare = (nodes.size() + shares - 1) / shares;
 
-    for (const auto& nodeIt : nodesFromTable)
+    struct Pending
     {
-        // Check pointer and value
-        if (cancelFlag.isCancelled()) break;
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t remaining = 0;
+    };
+    auto pending = std::make_shared<Pending>();
 
-        Node* n = getNodeInRAM(nodeIt.first);
+    for (size_t begin = perShare; begin < nodes.size(); begin += perShare)
+    {
+        size_t end = std::min(begin + perShare, nodes.size());
 
-        if (!ancestorHandle.isUndef())  // filter results by subtree (nodeHandle)
         {
-            bool skip = n ? !n->isAncestor(ancestorHandle)
-                          : !isAncestor(nodeIt.first, ancestorHandle, cancelFlag);
-
-            if (skip) continue;
+            std::lock_guard<std::mutex> g(pending->mutex);
+            ++pending->remaining;
         }
 
-        if (!n)
+        DBTableNodes* table = mTable;
+        mClient.mAsyncQueue.push([table, &nodes, &serialized, &encrypted, begin, end, pending](SymmCipher&)
         {
-            n = getNodeFromNodeSerialized(nodeIt.second);
-            if (!n)
+            for (size_t i = begin; i < end; i++)
             {
-                nodes.clear();
-                return nodes;
+                if (!encrypted[i])
+                {
+                    table->serializeNode(nodes[i], &serialized[i]);
+                }
+            }
+
+            std::lock_guard<std::mutex> g(pending->mutex);
+            if (!--pending->remaining)
+            {
+                pending->done.notify_one();
             }
+        }, false);
+    }
+
+    for (size_t i = 0; i < perShare && i < nodes.size(); i++)
+    {
+        if (!encrypted[i])
+        {
+            mTable->serializeNode(nodes[i], &serialized[i]);
         }
+    }
 
-        nodes.push_back(n);
+    {
+        std::unique_lock<std::mutex> g(pending->mutex);
+        pending->done.wait(g, [&pending]() { return !pending->remaining; });
     }
 
-    return nodes;
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        if (encrypted[i])
+        {
+            mTable->serializeNode(nodes[i], &serialized[i]);
+        }
+    }
+
+    mTable->put(nodes, serialized);
 }
 
-size_t NodeManager::nodeNotifySize() const
+uint64_t NodeManager::getNumberNodesInRam() const
 {
-    return mNodeNotify.size();
+    return mNodesInRam;
 }
 
-bool NodeManager::FingerprintContainer::allFingerprintsAreLoaded(const FileFingerprint *fingerprint) const
+void NodeManager::setMaxNodesInRam(uint64_t maxNodes)
 {
-    return mAllFingerprintsLoaded.find(*fingerprint) != mAllFingerprintsLoaded.end();
+    mMaxNodesInRam = maxNodes;
 }
 
-void NodeManager::FingerprintContainer::setAllFingerprintLoaded(const mega::FileFingerprint *fingerprint)
+void NodeManager::setChildrenPrefetch(unsigned folders)
 {
-    mAllFingerprintsLoaded.insert(*fingerprint);
+    mChildrenPrefetchFolders = folders;
 }
 
-void NodeManager::FingerprintContainer::clear()
+void NodeManager::prefetchChildren(const node_vector& listed)
+{
+    if (!mChildrenPrefetchFolders || !mTable || mNodes.empty()
+            || (mChildrenPrefetch && !mChildrenPrefetch->done)
+            || !mClient.mAsyncQueue.threadCount()
+            || (mMaxNodesInRam && mNodesInRam >= mMaxNodesInRam)
+            || !mNodeNotify.empty() || mNodeToWriteInDb)
+    {
+        return;
+    }
+
+    std::vector<NodeHandle> folders;
+    for (Node* n : listed)
+    {
+        if (n->type != FILENODE && !n->mNodePosition->second.mAllChildrenHandleLoaded)
+        {
+            folders.push_back(n->nodeHandle());
+            if (folders.size() >= mChildrenPrefetchFolders)
+            {
+                break;
+            }
+        }
+    }
+
+    if (folders.empty())
+    {
+        return;
+    }
+
+    std::shared_ptr<DBTableNodes> reader = mTable->getReader();
+    if (!reader)
+    {
+        return;
+    }
+
+    auto prefetch = std::make_shared<ChildrenPrefetch>();
+    prefetch->tableGeneration = mTableGeneration;
+    prefetch->nodesWrites = mTable->getNodesWrites();
+    mChildrenPrefetch = prefetch;
+
+    mClient.mAsyncQueue.push([prefetch, reader, folders](SymmCipher&)
+    {
+        for (NodeHandle h : folders)
+        {
+            std::vector<std::pair<NodeHandle, NodeSerialized>> children;
+            if (!reader->getChildren(h, children, CancelToken()))
+            {
+                break;
+            }
+            prefetch->children.emplace_back(h, std::move(children));
+        }
+        prefetch->done = true;
+    }, false);
+}
+
+void NodeManager::applyChildrenPrefetch()
+{
+    if (!mChildrenPrefetch || !mChildrenPrefetch->done)
+    {
+        return;
+    }
+
+    std::shared_ptr<ChildrenPrefetch> prefetch;
+    prefetch.swap(mChildrenPrefetch);
+
+    if (!mTable || mNodes.empty() || prefetch->tableGeneration != mTableGeneration
+            || prefetch->nodesWrites != mTable->getNodesWrites()
+            || !mNodeNotify.empty() || mNodeToWriteInDb)
+    {
+        LOG_debug << "Prefetched children discarded, nodes changed meanwhile";
+        return;
+    }
+
+    size_t loaded = 0;
+    for (const auto& folder : prefetch->children)
+    {
+        auto position = mNodes.find(folder.first);
+        if (position == mNodes.end() || !position->second.mNode || position->second.mAllChildrenHandleLoaded)
+        {
+            continue;
+        }
+
+        if (mMaxNodesInRam && mNodesInRam + folder.second.size() > mMaxNodesInRam)
+        {
+            break;
+        }
+
+        // as getChildren() would load them
+        bool complete = true;
+        for (const auto& child : folder.second)
+        {
+            auto itNode = mNodes.find(child.first);
+            if (itNode == mNodes.end() || !itNode->second.mNode)
+            {
+                if (!getNodeFromNodeSerialized(child.second))
+                {
+                    complete = false;
+                    break;
+                }
+                ++loaded;
+            }
+        }
+
+        if (!complete)
+        {
+            break;
+        }
+        position->second.mAllChildrenHandleLoaded = true;
+    }
+
+    LOG_debug << "Prefetched children of " << prefetch->children.size() << " folders, " << loaded << " nodes loaded";
+}
+
+void NodeManager::evictNodes()
+{
+    if (!mMaxNodesInRam || mNodesInRam <= mMaxNodesInRam
+            || !mTable || mClient.fetchingnodes || mBatchingCounters || !mNodeNotify.empty())
+    {
+        return;
+    }
+
+    // down to a margin below the limit, not to sweep again as soon as a few more are loaded
+    uint64_t target = mMaxNodesInRam - mMaxNodesInRam / 10;
+    std::set<NodeHandle> pinned = getPinnedNodes();
+    uint64_t evicted = 0;
+
+    // two rounds let referenced nodes be evicted too, once their reference is cleared
+    size_t steps = 2 * mNodes.size();
+    if (steps > MAX_EVICTION_STEPS)
+    {
+        steps = MAX_EVICTION_STEPS;
+    }
+
+    auto it = mNodes.find(mEvictionHand);
+    for (; steps && mNodesInRam > target; steps--)
+    {
+        if (it == mNodes.end())
+        {
+            it = mNodes.begin();
+        }
+
+        // erasing 'position' leaves 'it' valid
+        auto position = it++;
+
+        NodeManagerNode& entry = position->second;
+        if (!entry.mNode)
+        {
+            continue;
+        }
+
+        if (entry.mReferenced)
+        {
+            entry.mReferenced = false;
+            continue;
+        }
+
+        if (isEvictable(*entry.mNode, pinned))
+        {
+            evictNode(position);
+            evicted++;
+        }
+    }
+
+    // the next sweep starts here, unless this node is gone by then
+    mEvictionHand = it != mNodes.end() ? it->first : NodeHandle();
+
+    LOG_debug << "Evicted " << evicted << " nodes from RAM, " << mNodesInRam << " left (limit: " << mMaxNodesInRam << ")";
+}
+
+NodePathCache::NodePathCache(size_t maxEntries)
+    : mMaxEntries(maxEntries)
+{
+}
+
+bool NodePathCache::get(const Key& key, NodeHandle& result)
+{
+    auto it = mEntries.find(key);
+    if (it == mEntries.end())
+    {
+        return false;
+    }
+
+    mLru.splice(mLru.begin(), mLru, it->second.lru);
+    result = it->second.result;
+    return true;
+}
+
+void NodePathCache::put(const Key& key, NodeHandle result, const std::vector<NodeHandle>& nodes, const std::vector<Lookup>& lookups)
+{
+    erase(key);
+
+    if (!mMaxEntries)
+    {
+        return;
+    }
+
+    if (mEntries.size() >= mMaxEntries)
+    {
+        erase(mLru.back());
+    }
+
+    mLru.push_front(key);
+
+    Entry& entry = mEntries[key];
+    entry.result = result;
+    entry.nodes = nodes;
+    entry.lookups = lookups;
+    entry.lru = mLru.begin();
+
+    for (NodeHandle h : nodes)
+    {
+        mByNode[h].insert(key);
+    }
+    for (const Lookup& l : lookups)
+    {
+        mByLookup[l].insert(key);
+    }
+}
+
+void NodePathCache::invalidate(NodeHandle node, NodeHandle parent, const std::string& name)
+{
+    std::vector<Key> keys;
+
+    auto nodeIt = mByNode.find(node);
+    if (nodeIt != mByNode.end())
+    {
+        keys.insert(keys.end(), nodeIt->second.begin(), nodeIt->second.end());
+    }
+
+    string nname = name;
+    LocalPath::utf8_normalize(&nname);
+    auto lookupIt = mByLookup.find(Lookup(parent, nname));
+    if (lookupIt != mByLookup.end())
+    {
+        keys.insert(keys.end(), lookupIt->second.begin(), lookupIt->second.end());
+    }
+
+    for (const Key& key : keys)
+    {
+        erase(key);
+    }
+}
+
+void NodePathCache::clear()
+{
+    mEntries.clear();
+    mLru.clear();
+    mByNode.clear();
+    mByLookup.clear();
+}
+
+void NodePathCache::erase(const Key& key)
+{
+    auto it = mEntries.find(key);
+    if (it == mEntries.end())
+    {
+        return;
+    }
+
+    for (NodeHandle h : it->second.nodes)
+    {
+        auto nodeIt = mByNode.find(h);
+        if (nodeIt != mByNode.end() && nodeIt->second.erase(key) && nodeIt->second.empty())
+        {
+            mByNode.erase(nodeIt);
+        }
+    }
+    for (const Lookup& l : it->second.lookups)
+    {
+        auto lookupIt = mByLookup.find(l);
+        if (lookupIt != mByLookup.end() && lookupIt->second.erase(key) && lookupIt->second.empty())
+        {
+            mByLookup.erase(lookupIt);
+        }
+    }
+
+    mLru.erase(it->second.lru);
+    mEntries.erase(it);
+}
+
+size_t NodePathCache::approximateSize() const
+{
+    // every entry has its key copied in the LRU list and in the sets of the nodes and lookups it depends on
+    size_t size = mByNode.size() * (MemoryReport::CONTAINER_NODE_OVERHEAD + sizeof(decltype(mByNode)::value_type))
+                + mByLookup.size() * (MemoryReport::CONTAINER_NODE_OVERHEAD + sizeof(decltype(mByLookup)::value_type));
+    for (auto& it : mEntries)
+    {
+        const Key& key = it.first;
+        const Entry& entry = it.second;
+        size_t keySize = MemoryReport::CONTAINER_NODE_OVERHEAD + sizeof(Key) + MemoryReport::heapBytes(key.second);
+
+        size += MemoryReport::CONTAINER_NODE_OVERHEAD + sizeof(decltype(mEntries)::value_type) + MemoryReport::heapBytes(key.second)
+              + entry.nodes.capacity() * sizeof(NodeHandle)
+              + entry.lookups.capacity() * sizeof(Lookup)
+              + (1 + entry.nodes.size() + entry.lookups.size()) * keySize;
+
+        for (const Lookup& l : entry.lookups)
+        {
+            size += MemoryReport::heapBytes(l.second);
+        }
+    }
+    return size;
+}
+
+void NodeManager::addMemoryUsage(MemoryReport& report) const
+{
+    // there can be millions of nodes in RAM: measure a sample and extrapolate
+    const size_t sampleSize = 1024;
+    size_t sampled = 0;
+    uint64_t sampledBytes = 0;
+    for (auto it = mNodes.begin(); it != mNodes.end() && sampled < sampleSize; ++it, ++sampled)
+    {
+        const NodeManagerNode& entry = it->second;
+        sampledBytes += MemoryReport::CONTAINER_NODE_OVERHEAD + sizeof(NodeManagerNodes::value_type);
+        if (entry.mNode)
+        {
+            sampledBytes += entry.mNode->approximateSize();
+        }
+        if (entry.mChildren)
+        {
+            sampledBytes += sizeof(*entry.mChildren)
+                          + entry.mChildren->size() * (MemoryReport::CONTAINER_NODE_OVERHEAD + sizeof(std::map<NodeHandle, Node*>::value_type));
+        }
+    }
+
+    uint64_t nodesBytes = mNodes.bucket_count() * sizeof(void*)
+                        + (mNodeNotify.capacity() + mCounterNotify.capacity()) * sizeof(Node*);
+    if (sampled)
+    {
+        nodesBytes += sampledBytes * mNodes.size() / sampled;
+    }
+    for (auto& it : mNodesWithMissingParent)
+    {
+        nodesBytes += MemoryReport::CONTAINER_NODE_OVERHEAD + sizeof(it)
+                    + it.second.size() * (MemoryReport::CONTAINER_NODE_OVERHEAD + sizeof(Node*));
+    }
+    report.add("nodes", mNodesInRam, nodesBytes);
+
+    report.add("nodeFingerprints", mFingerPrints.size(),
+               mFingerPrints.size() * (MemoryReport::CONTAINER_NODE_OVERHEAD + sizeof(FileFingerprint*))
+               + mFingerprintFilter.sizeInBytes());
+
+    report.add("nodePathCache", mPathCache.size(), mPathCache.approximateSize());
+
+    report.add("recentNodes", mRecentNodes.size(),
+               mRecentNodes.size() * (MemoryReport::CONTAINER_NODE_OVERHEAD + sizeof(std::pair<m_time_t, NodeHandle>)));
+}
+
+NodeManager::CacheStats NodeManager::getCacheStats(bool reset)
+{
+    CacheStats stats = mCacheStats;
+    if (reset)
+    {
+        mCacheStats = CacheStats();
+    }
+
+    return stats;
+}
+
+std::set<NodeHandle> NodeManager::getPinnedNodes() const
+{
+    std::set<NodeHandle> pinned;
+
+    for (int d = GET; d == GET || d == PUT; d += PUT - GET)
+    {
+        for (auto& it : mClient.transfers[d])
+        {
+            for (File* f : it.second->files)
+            {
+                pinned.insert(f->h);
+                if (f->previousNode)
+                {
+                    pinned.insert(f->previousNode->nodeHandle());
+                }
+            }
+        }
+    }
+
+    for (auto& it : mClient.hdrns)
+    {
+        if (it.second->p)
+        {
+            pinned.insert(NodeHandle().set6byte(it.second->h));
+        }
+    }
+
+    return pinned;
+}
+
+bool NodeManager::isEvictable(const Node& node, const std::set<NodeHandle>& pinned) const
+{
+    // nodes without parent are roots: of the account, of in-shares or of a subtree whose parent is pending
+    if (!node.parent || isRootNode(node.nodeHandle())
+            || node.notified || node.attrstring || node.appdata
+            || node.inshare || node.outshares || node.pendingshares || node.plink || node.sharekey
+            || pinned.find(node.nodeHandle()) != pinned.end())
+    {
+        return false;
+    }
+
+#ifdef ENABLE_SYNC
+    if (node.localnode || node.syncget
+            || node.todebris_it != mClient.toDebris.end() || node.tounlink_it != mClient.toUnlink.end())
+    {
+        return false;
+    }
+#endif
+
+    // children in RAM point to their parent: nodes are evicted from the leaves up
+    if (const auto& children = node.mNodePosition->second.mChildren)
+    {
+        for (const auto& child : *children)
+        {
+            if (child.second)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void NodeManager::evictNode(NodeManagerNodes::iterator position)
+{
+    Node* node = position->second.mNode.get();
+
+    // the parent keeps the handle, so it still knows all its children if it did
+    auto& siblings = node->parent->mNodePosition->second.mChildren;
+    if (siblings)
+    {
+        auto it = siblings->find(position->first);
+        if (it != siblings->end())
+        {
+            it->second = nullptr;
+        }
+    }
+
+    if (node->type == FILENODE)
+    {
+        // the fingerprint needs a lookup in DB again
+        mFingerPrints.unsetAllFingerprintLoaded(node);
+        removeFingerprint(node);
+    }
+
+    // the children's handles go too: with no children in RAM, they are read from DB on demand
+    mNodesInRam--;
+    mNodes.erase(position);
+    mCacheStats.evictions++;
+}
+
+void NodeManager::addChild(NodeHandle parent, NodeHandle child, Node* node)
+{
+    auto pair = mNodes.emplace(parent, NodeManagerNode());
+    // The NodeManagerNode could have been added in add node, only update the child
+    assert(!pair.first->second.mChildren || !(*pair.first->second.mChildren)[child]);
+    if (!pair.first->second.mChildren)
+    {
+        pair.first->second.mChildren = ::mega::make_unique<std::map<NodeHandle, Node*>>();
+    }
+    (*pair.first->second.mChildren)[child] = node;
+}
+
+void NodeManager::removeChild(Node* parent, NodeHandle child)
+{
+    assert(parent->mNodePosition->second.mChildren);
+    if (parent->mNodePosition->second.mChildren)
+    {
+        parent->mNodePosition->second.mChildren->erase(child);
+    }
+}
+
+Node* NodeManager::getNodeFromDataBase(NodeHandle handle)
+{
+    if (!mTable)
+    {
+        assert(!mClient.loggedin());
+        return nullptr;
+    }
+
+    Node* node = nullptr;
+    NodeSerialized nodeSerialized;
+    if (mTable->getNode(handle, nodeSerialized))
+    {
+        node = getNodeFromNodeSerialized(nodeSerialized);
+    }
+
+    return node;
+}
+
+node_vector NodeManager::getRootNodesAndInshares()
+{
+    node_vector rootnodes;
+
+    rootnodes = getRootNodes();
+    if (!mClient.loggedIntoFolder()) // logged into user's account: incoming shared folders
+    {
+        node_vector inshares = mClient.getInShares();
+        rootnodes.insert(rootnodes.end(), inshares.begin(), inshares.end());
+    }
+
+    return rootnodes;
+}
+
+node_vector NodeManager::getNodesFromTable(const TableQuery& query, ClientLock* unlockable, CancelToken cancelFlag)
+{
+    std::vector<std::pair<NodeHandle, NodeSerialized>> nodesFromTable;
+    if (!queryTable(query, unlockable, cancelFlag, nodesFromTable))
+    {
+        return node_vector();
+    }
+
+    return processUnserializedNodes(nodesFromTable, NodeHandle(), cancelFlag);
+}
+
+bool NodeManager::queryTable(const TableQuery& query, ClientLock* unlockable, CancelToken cancelFlag, std::vector<std::pair<NodeHandle, NodeSerialized>>& nodesFromTable)
+{
+    std::shared_ptr<DBTableNodes> reader;
+    if (unlockable)
+    {
+        assert(unlockable->owns_lock());
+        reader = mTable->getReader();
+    }
+
+    if (reader)
+    {
+        uint64_t tableGeneration = mTableGeneration;
+        uint64_t nodesWrites = mTable->getNodesWrites();
+
+        unlockable->unlock();
+        bool result = query(*reader, nodesFromTable);
+        reader.reset();
+        unlockable->lock();
+
+        if (cancelFlag.isCancelled() || tableGeneration != mTableGeneration || !mTable || mNodes.empty())
+        {
+            nodesFromTable.clear();
+            return false;
+        }
+
+        if (result && nodesWrites == mTable->getNodesWrites())
+        {
+            return true;
+        }
+
+        LOG_debug << "Nodes written during an unlocked query, running it again";
+        nodesFromTable.clear();
+    }
+
+    query(*mTable, nodesFromTable);
+
+    return true;
+}
+
+node_vector NodeManager::processUnserializedNodes(const std::vector<std::pair<NodeHandle, NodeSerialized> >& nodesFromTable, NodeHandle ancestorHandle, CancelToken cancelFlag)
+{
+    node_vector nodes;
+
+    // results are mostly siblings: look up the ancestry of each parent once
+    std::map<NodeHandle, bool> parentInSubtree;
+
+    for (const auto& nodeIt : nodesFromTable)
+    {
+        // Check pointer and value
+        if (cancelFlag.isCancelled()) break;
+
+        Node* n = getNodeInRAM(nodeIt.first);
+
+        if (!ancestorHandle.isUndef())  // filter results by subtree (nodeHandle)
+        {
+            bool skip;
+            if (n)
+            {
+                skip = !n->isAncestor(ancestorHandle);
+            }
+            else
+            {
+                NodeHandle ph = parentHandleOf(nodeIt.second);
+                auto it = parentInSubtree.find(ph);
+                if (it == parentInSubtree.end())
+                {
+                    bool inSubtree = !ph.isUndef()
+                            && (ph == ancestorHandle || isAncestor(ph, ancestorHandle, cancelFlag));
+                    it = parentInSubtree.emplace(ph, inSubtree).first;
+                }
+                skip = !it->second;
+            }
+
+            if (skip) continue;
+        }
+
+        if (!n)
+        {
+            n = getNodeFromNodeSerialized(nodeIt.second);
+            if (!n)
+            {
+                nodes.clear();
+                return nodes;
+            }
+        }
+
+        nodes.push_back(n);
+    }
+
+    return nodes;
+}
+
+size_t NodeManager::nodeNotifySize() const
+{
+    return mNodeNotify.size();
+}
+
+bool NodeManager::FingerprintContainer::allFingerprintsAreLoaded(const FileFingerprint *fingerprint) const
+{
+    return mAllFingerprintsLoaded.find(*fingerprint) != mAllFingerprintsLoaded.end();
+}
+
+void NodeManager::FingerprintContainer::setAllFingerprintLoaded(const mega::FileFingerprint *fingerprint)
+{
+    mAllFingerprintsLoaded.insert(*fingerprint);
+}
+
+void NodeManager::FingerprintContainer::unsetAllFingerprintLoaded(const mega::FileFingerprint *fingerprint)
+{
+    mAllFingerprintsLoaded.erase(*fingerprint);
+}
+
+void NodeManager::FingerprintContainer::clear()
 {
     fingerprint_set::clear();
     mAllFingerprintsLoaded.clear();
 }
 
+void NodeManager::FingerprintFilter::reset(uint64_t expectedEntries)
+{
+    uint64_t numBits = std::max<uint64_t>(expectedEntries, 1) * BITS_PER_ENTRY;
+    mBits.assign(static_cast<size_t>((numBits + 63) / 64), 0);
+    mValid = true;
+}
+
+void NodeManager::FingerprintFilter::invalidate()
+{
+    mBits.clear();
+    mBits.shrink_to_fit();
+    mValid = false;
+}
+
+// double hashing: the k probes are h1 + i * h2, derived from a single string hash
+void NodeManager::FingerprintFilter::add(const std::string& fingerprint)
+{
+    if (!mValid)
+    {
+        return;
+    }
+
+    uint64_t numBits = mBits.size() * 64;
+    uint64_t h1 = std::hash<std::string>()(fingerprint);
+    uint64_t h2 = ((h1 * 0x9E3779B97F4A7C15ull) ^ (h1 >> 29)) | 1;
+    for (unsigned i = 0; i < NUM_HASHES; i++)
+    {
+        uint64_t bit = (h1 + i * h2) % numBits;
+        mBits[static_cast<size_t>(bit / 64)] |= uint64_t(1) << (bit % 64);
+    }
+}
+
+bool NodeManager::FingerprintFilter::mayContain(const std::string& fingerprint) const
+{
+    if (!mValid)
+    {
+        return true;
+    }
+
+    uint64_t numBits = mBits.size() * 64;
+    uint64_t h1 = std::hash<std::string>()(fingerprint);
+    uint64_t h2 = ((h1 * 0x9E3779B97F4A7C15ull) ^ (h1 >> 29)) | 1;
+    for (unsigned i = 0; i < NUM_HASHES; i++)
+    {
+        uint64_t bit = (h1 + i * h2) % numBits;
+        if (!(mBits[static_cast<size_t>(bit / 64)] & (uint64_t(1) << (bit % 64))))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 } // namespace
@@ -231,6 +231,43 @@ uint64_t Node::getDBFlag(uint64_t oldFlags, bool isInRubbish, bool isVersion)
     return flags.to_ulong();
 }
 
+size_t Node::approximateSize() const
+{
+    size_t size = sizeof(Node)
+                + MemoryReport::heapBytes(nodekeyUnchecked())
+                + MemoryReport::heapBytes(fileattrstring);
+
+    for (auto& attr : attrs.map)
+    {
+        size += sizeof(attr) + MemoryReport::heapBytes(attr.second);
+    }
+
+    if (attrstring)
+    {
+        size += sizeof(string) + MemoryReport::heapBytes(*attrstring);
+    }
+
+    size_t shares = (outshares ? outshares->size() : 0) + (pendingshares ? pendingshares->size() : 0);
+    size += shares * (MemoryReport::CONTAINER_NODE_OVERHEAD + sizeof(share_map::value_type) + sizeof(Share));
+
+    if (inshare)
+    {
+        size += sizeof(Share);
+    }
+
+    if (sharekey)
+    {
+        size += sizeof(SymmCipher);
+    }
+
+    if (plink)
+    {
+        size += sizeof(PublicLink);
+    }
+
+    return size;
+}
+
 bool Node::getExtension(std::string& ext) const
 {
     ext.clear();
@@ -369,6 +406,22 @@ void Node::setkeyfromjson(const char* k)
     assert(client->mAppliedKeyNodeCount >= 0);
 }
 
+void Node::setdecryptedkey(string& decryptedKey, AttrMap& decryptedAttrs)
+{
+    if (keyApplied()) --client->mAppliedKeyNodeCount;
+    nodekeydata.swap(decryptedKey);
+    if (keyApplied()) ++client->mAppliedKeyNodeCount;
+    assert(client->mAppliedKeyNodeCount >= 0);
+
+    changed.name = decryptedAttrs.hasDifferentValue('n', attrs.map);
+    changed.favourite = decryptedAttrs.hasDifferentValue(AttrMap::string2nameid("fav"), attrs.map);
+    attrs.map.swap(decryptedAttrs.map);
+
+    setfingerprint();
+
+    attrstring.reset();
+}
+
 void Node::setUndecryptedKey(const std::string& undecryptedKey)
 {
     nodekeydata = undecryptedKey;
@@ -389,7 +442,7 @@ void Node::setkey(const byte* newkey)
 }
 
 // serialize node - nodes with pending or RSA keys are unsupported
-bool Node::serialize(string* d)
+bool Node::serializable()
 {
     // do not serialize encrypted nodes
     if (attrstring)
@@ -429,8 +482,17 @@ bool Node::serialize(string* d)
             }
     }
 
+    return true;
+}
+
+bool Node::serialize(string* d)
+{
+    if (!serializable())
+    {
+        return false;
+    }
+
     unsigned short ll;
-    short numshares;
     m_off_t s;
 
     s = type ? -type : size;
@@ -511,6 +573,28 @@ bool Node::serialize(string* d)
     // Use these bytes for extensions.
     d->append(4, '\0');
 
+    serializeShares(d);
+
+    attrs.serialize(d);
+
+    if (isExported)
+    {
+        serializeLink(d);
+    }
+
+    // Write data necessary to thaw encrypted nodes.
+    if (attrstring)
+    {
+        serializeEncrypted(d);
+    }
+
+    return true;
+}
+
+void Node::serializeShares(string* d) const
+{
+    short numshares;
+
     if (inshare)
     {
         numshares = -1;
@@ -564,34 +648,227 @@ bool Node::serialize(string* d)
             }
         }
     }
+}
 
-    attrs.serialize(d);
+void Node::serializeLink(string* d) const
+{
+    d->append((char*) &plink->ph, MegaClient::NODEHANDLE);
+    d->append((char*) &plink->ets, sizeof(plink->ets));
+    d->append((char*) &plink->takendown, sizeof(plink->takendown));
+    d->append((char*) &plink->cts, sizeof(plink->cts));
+}
 
-    if (isExported)
+void Node::serializeEncrypted(string* d) const
+{
+    // Write node key data.
+    uint32_t length = static_cast<uint32_t>(nodekeydata.size());
+    d->append((char*)&length, sizeof(length));
+    d->append(nodekeydata, 0, length);
+
+    // Write attribute string data.
+    length = static_cast<uint32_t>(attrstring->size());
+    d->append((char*)&length, sizeof(length));
+    d->append(*attrstring, 0, length);
+}
+
+const m_off_t Node::COMPACT_BLOB_MARKER = std::numeric_limits<m_off_t>::min();
+
+bool Node::serializeCompact(string* d)
+{
+    if (!serializable())
+    {
+        return false;
+    }
+
+    std::vector<std::pair<BlobField, string>> fields;
+
+    auto addNumber = [&fields](BlobField field, uint64_t value)
+    {
+        byte buf[sizeof value + 1];
+        fields.emplace_back(field, string((const char*)buf, size_t(Serialize64::serialize(buf, value))));
+    };
+
+    addNumber(BLOB_TYPE, static_cast<uint64_t>(static_cast<int64_t>(type)));
+
+    if (type == FILENODE)
+    {
+        addNumber(BLOB_SIZE, static_cast<uint64_t>(size));
+    }
+
+    fields.emplace_back(BLOB_HANDLE, string((const char*)&nodehandle, MegaClient::NODEHANDLE));
+
+    if (parenthandle != UNDEF)
+    {
+        fields.emplace_back(BLOB_PARENT, string((const char*)&parenthandle, MegaClient::NODEHANDLE));
+    }
+
+    fields.emplace_back(BLOB_OWNER, string((const char*)&owner, MegaClient::USERHANDLE));
+
+    if (ctime)
+    {
+        addNumber(BLOB_CTIME, static_cast<uint64_t>(ctime));
+    }
+
+    if (!attrstring && !nodekeydata.empty())
+    {
+        fields.emplace_back(BLOB_KEY, nodekeydata);
+    }
+
+    if (type == FILENODE && !fileattrstring.empty())
+    {
+        fields.emplace_back(BLOB_FILEATTRS, fileattrstring);
+    }
+
+    if (inshare || outshares || pendingshares)
+    {
+        fields.emplace_back(BLOB_SHARES, string());
+        serializeShares(&fields.back().second);
+    }
+
+    fields.emplace_back(BLOB_ATTRS, string());
+    attrs.serialize(&fields.back().second);
+
+    if (plink)
+    {
+        fields.emplace_back(BLOB_LINK, string(1, static_cast<char>(plink->mAuthKey.size())));
+        fields.back().second.append(plink->mAuthKey);
+        serializeLink(&fields.back().second);
+    }
+
+    if (attrstring)
+    {
+        fields.emplace_back(BLOB_ENCRYPTED, string());
+        serializeEncrypted(&fields.back().second);
+    }
+
+    d->append((const char*)&COMPACT_BLOB_MARKER, sizeof COMPACT_BLOB_MARKER);
+
+    CacheableWriter w(*d);
+    w.serializecompressedu64(fields.size());
+    for (const auto& field : fields)
     {
-        d->append((char*) &plink->ph, MegaClient::NODEHANDLE);
-        d->append((char*) &plink->ets, sizeof(plink->ets));
-        d->append((char*) &plink->takendown, sizeof(plink->takendown));
-        if (hasLinkCreationTs)
+        w.serializecompressedu64(field.first);
+        w.serializecompressedu64(field.second.size());
+    }
+
+    for (const auto& field : fields)
+    {
+        d->append(field.second);
+    }
+
+    return true;
+}
+
+bool Node::isCompactBlob(const string& blob)
+{
+    return blob.size() >= sizeof COMPACT_BLOB_MARKER
+            && MemAccess::get<m_off_t>(blob.data()) == COMPACT_BLOB_MARKER;
+}
+
+bool Node::blobFields(const string& blob, BlobSpans& fields)
+{
+    if (!isCompactBlob(blob))
+    {
+        return false;
+    }
+
+    CacheableReader r(blob);
+    r.ptr += sizeof COMPACT_BLOB_MARKER;
+
+    uint64_t count;
+    if (!r.unserializecompressedu64(count))
+    {
+        return false;
+    }
+
+    fields.fill(BlobSpan(nullptr, 0));
+
+    // the fields follow the directory, in the same order: skip it once to find where they start
+    CacheableReader directory(r);
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint64_t id, size;
+        if (!r.unserializecompressedu64(id) || !r.unserializecompressedu64(size))
         {
-            d->append((char*) &plink->cts, sizeof(plink->cts));
+            return false;
         }
     }
 
-    // Write data necessary to thaw encrypted nodes.
-    if (attrstring)
+    for (uint64_t i = 0; i < count; i++)
     {
-        // Write node key data.
-        uint32_t length = static_cast<uint32_t>(nodekeydata.size());
-        d->append((char*)&length, sizeof(length));
-        d->append(nodekeydata, 0, length);
+        uint64_t id, size;
+        directory.unserializecompressedu64(id);
+        directory.unserializecompressedu64(size);
 
-        // Write attribute string data.
-        length = static_cast<uint32_t>(attrstring->size());
-        d->append((char*)&length, sizeof(length));
-        d->append(*attrstring, 0, length);
+        if (size > uint64_t(r.end - r.ptr))
+        {
+            return false;
+        }
+
+        // fields unknown to this version are skipped
+        if (id < BLOB_FIELDS)
+        {
+            fields[size_t(id)] = BlobSpan(r.ptr, size_t(size));
+        }
+        r.ptr += size;
+    }
+
+    return true;
+}
+
+bool Node::blobField(const string& blob, BlobField field, const char*& data, size_t& length)
+{
+    BlobSpans fields;
+    if (!blobFields(blob, fields) || !fields[field].first)
+    {
+        return false;
+    }
+
+    data = fields[field].first;
+    length = fields[field].second;
+    return true;
+}
+
+bool Node::blobNumber(const string& blob, BlobField field, uint64_t& value)
+{
+    const char* data;
+    size_t length;
+    return blobField(blob, field, data, length) && length
+            && Serialize64::unserialize((byte*)data, int(length), &value) == int(length);
+}
+
+bool Node::blobNameAndSize(const string& blob, string& name, m_off_t& size)
+{
+    uint64_t value;
+    if (!blobNumber(blob, BLOB_TYPE, value))
+    {
+        return false;
     }
 
+    nodetype_t t = static_cast<nodetype_t>(static_cast<int64_t>(value));
+    if (t == FILENODE)
+    {
+        if (!blobNumber(blob, BLOB_SIZE, value))
+        {
+            return false;
+        }
+        size = static_cast<m_off_t>(value);
+    }
+    else
+    {
+        size = -t;
+    }
+
+    const char* data;
+    size_t length;
+    AttrMap attrMap;
+    if (!blobField(blob, BLOB_ATTRS, data, length) || !attrMap.unserialize(data, data + length))
+    {
+        return false;
+    }
+
+    auto it = attrMap.map.find('n');
+    name = it != attrMap.map.end() ? it->second : string();
     return true;
 }
 
@@ -621,6 +898,33 @@ byte* Node::decryptattr(SymmCipher* key, const char* attrstring, size_t attrstrl
     return NULL;
 }
 
+byte* Node::decryptattr(SymmCipher* key, const char* attrstring, size_t attrstrlen, string& arena)
+{
+    if (attrstrlen)
+    {
+        size_t l = attrstrlen * 3 / 4 + 3;
+        if (arena.size() < l)
+        {
+            arena.resize(l);
+        }
+        byte* buf = (byte*)const_cast<char*>(arena.data());
+
+        int bl = Base64::atob(attrstring, buf, int(l));
+
+        if (!(bl & (SymmCipher::BLOCKSIZE - 1)))
+        {
+            key->cbc_decrypt(buf, bl);
+
+            if (!memcmp(buf, "MEGA{\"", 6))
+            {
+                return buf;
+            }
+        }
+    }
+
+    return NULL;
+}
+
 void Node::parseattr(byte *bufattr, AttrMap &attrs, m_off_t size, m_time_t &mtime , string &fileName, string &fingerprint, FileFingerprint &ffp)
 {
     JSON json;
@@ -675,10 +979,12 @@ SymmCipher* Node::nodecipher()
 // decrypt attributes and build attribute hash
 void Node::setattr()
 {
+    // reused across nodes, so fetching a large tree doesn't allocate a decryption buffer per node
+    static thread_local string arena;
     byte* buf;
     SymmCipher* cipher;
 
-    if (attrstring && (cipher = nodecipher()) && (buf = decryptattr(cipher, attrstring->c_str(), attrstring->size())))
+    if (attrstring && (cipher = nodecipher()) && (buf = decryptattr(cipher, attrstring->c_str(), attrstring->size(), arena)))
     {
         JSON json;
         nameid name;
@@ -703,8 +1009,6 @@ void Node::setattr()
 
         setfingerprint();
 
-        delete[] buf;
-
         attrstring.reset();
     }
 }
@@ -975,11 +1279,44 @@ bool Node::applykey()
         return false;
     }
 
+    SymmCipher* sc;
+    const char* k = selectkey(sc);
+    if (!k)
+    {
+        return false;
+    }
+
+    byte key[FILENODEKEYLENGTH];
+    unsigned keylength = (type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH;
+
+    if (client->decryptkey(k, key, keylength, sc, 0, nodehandle))
+    {
+        client->mAppliedKeyNodeCount++;
+        nodekeydata.assign((const char*)key, keylength);
+        setattr();
+    }
+
+    bool applied = keyApplied();
+    if (!applied)
+    {
+        LOG_warn << "Failed to apply key for node: " << Base64Str<MegaClient::NODEHANDLE>(nodehandle);
+        // keys could be missing due to nested inshares with multiple users: user A shares a folder 1
+        // with user B and folder 1 has a subfolder folder 1_1. User A shares folder 1_1 with user C
+        // and user C adds some files, which will be undecryptable for user B.
+        // The ticket SDK-1959 aims to mitigate the problem. Uncomment next line when done:
+        // assert(applied);
+    }
+
+    return applied;
+}
+
+const char* Node::selectkey(SymmCipher*& sc)
+{
     int l = -1;
     size_t t = 0;
     handle h;
     const char* k = NULL;
-    SymmCipher* sc = &client->key;
+    sc = &client->key;
     handle me = client->loggedin() ? client->me : client->mNodeManager.getRootNodeFiles().as8byte();
 
     while ((t = nodekeydata.find_first_of(':', t)) != string::npos)
@@ -1032,40 +1369,12 @@ bool Node::applykey()
 
     // no: found => personal key, use directly
     // otherwise, no suitable key available yet - bail (it might arrive soon)
-    if (!k)
+    if (!k && l < 0)
     {
-        if (l < 0)
-        {
-            k = nodekeydata.c_str();
-        }
-        else
-        {
-            return false;
-        }
-    }
-
-    byte key[FILENODEKEYLENGTH];
-    unsigned keylength = (type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH;
-
-    if (client->decryptkey(k, key, keylength, sc, 0, nodehandle))
-    {
-        client->mAppliedKeyNodeCount++;
-        nodekeydata.assign((const char*)key, keylength);
-        setattr();
+        k = nodekeydata.c_str();
     }
 
-    bool applied = keyApplied();
-    if (!applied)
-    {
-        LOG_warn << "Failed to apply key for node: " << Base64Str<MegaClient::NODEHANDLE>(nodehandle);
-        // keys could be missing due to nested inshares with multiple users: user A shares a folder 1
-        // with user B and folder 1 has a subfolder folder 1_1. User A shares folder 1_1 with user C
-        // and user C adds some files, which will be undecryptable for user B.
-        // The ticket SDK-1959 aims to mitigate the problem. Uncomment next line when done:
-        // assert(applied);
-    }
-
-    return applied;
+    return k;
 }
 
 NodeCounter Node::getCounter() const
@@ -1275,6 +1584,81 @@ bool PublicLink::isExpired()
 // set, change or remove LocalNode's parent and name/localname/slocalname.
 // newlocalpath must be a full path and must not point to an empty string.
 // no shortname allowed as the last path component.
+static void unindexchild(localnode_hashindex* index, size_t hash, LocalNode* l)
+{
+    if (!index)
+    {
+        return;
+    }
+
+    auto range = index->equal_range(hash);
+
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == l)
+        {
+            index->erase(it);
+            return;
+        }
+    }
+}
+
+// map[name] = l, keeping the hash index in step (a displaced node leaves both)
+static void addindexedchild(localnode_map& map, std::unique_ptr<localnode_hashindex>& index, const LocalPath& name, LocalNode* l)
+{
+    auto r = map.emplace(name, l);
+    size_t hash = name.hash();
+
+    if (!index)
+    {
+        index.reset(new localnode_hashindex());
+    }
+
+    if (!r.second)
+    {
+        unindexchild(index.get(), hash, r.first->second);
+        r.first->second = l;
+    }
+
+    index->emplace(hash, l);
+}
+
+// only if l is the node stored under name: a displaced duplicate must not unlink its replacement
+static void removeindexedchild(localnode_map& map, localnode_hashindex* index, const LocalPath& name, LocalNode* l)
+{
+    auto it = map.find(name);
+
+    if (it != map.end() && it->second == l)
+    {
+        map.erase(it);
+        unindexchild(index, name.hash(), l);
+    }
+}
+
+// one node per short name, as for children
+static void addshortchild(std::unique_ptr<localnode_hashindex>& index, const LocalPath& sname, LocalNode* l)
+{
+    size_t hash = sname.hash();
+
+    if (!index)
+    {
+        index.reset(new localnode_hashindex());
+    }
+
+    auto range = index->equal_range(hash);
+
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second->slocalname && *it->second->slocalname == sname)
+        {
+            index->erase(it);
+            break;
+        }
+    }
+
+    index->emplace(hash, l);
+}
+
 void LocalNode::setnameparent(LocalNode* newparent, const LocalPath* newlocalpath, std::unique_ptr<LocalPath> newshortname)
 {
     if (!sync)
@@ -1295,11 +1679,11 @@ void LocalNode::setnameparent(LocalNode* newparent, const LocalPath* newlocalpat
     if (parent)
     {
         // remove existing child linkage
-        parent->children.erase(getLocalname());
+        removeindexedchild(parent->children, parent->childrenhash.get(), getLocalname(), this);
 
         if (slocalname)
         {
-            parent->schildren.erase(*slocalname);
+            unindexchild(parent->schildren.get(), slocalname->hash(), this);
             slocalname.reset();
         }
     }
@@ -1350,7 +1734,7 @@ void LocalNode::setnameparent(LocalNode* newparent, const LocalPath* newlocalpat
         }
     }
 
-    if (parent && parent != newparent && !sync->mDestructorRunning)
+    if (parent && parent != newparent && !sync->mDestructorRunning && !sync->mUnloadingLocalNodes)
     {
         treestate(TREESTATE_NONE);
     }
@@ -1388,6 +1772,12 @@ void LocalNode::setnameparent(LocalNode* newparent, const LocalPath* newlocalpat
 
             if (todelete || oldsync)
             {
+                // all of them, including any unloaded from the state cache of this sync
+                if (type == FOLDERNODE)
+                {
+                    sync->loadstatecachechildren(this, true);
+                }
+
                 // prepare localnodes for a sync change or/and a copy operation
                 LocalTreeProcMove tp(parent->sync, todelete != NULL);
                 sync->client->proclocaltree(this, &tp);
@@ -1396,12 +1786,12 @@ void LocalNode::setnameparent(LocalNode* newparent, const LocalPath* newlocalpat
         }
 
         // (we don't construct a UTF-8 or sname for the root path)
-        parent->children[getLocalname()] = this;
+        addindexedchild(parent->children, parent->childrenhash, getLocalname(), this);
 
         if (newshortname && *newshortname != getLocalname())
         {
             slocalname = std::move(newshortname);
-            parent->schildren[*slocalname] = this;
+            addshortchild(parent->schildren, *slocalname, this);
         }
         else
         {
@@ -1455,6 +1845,19 @@ void LocalNode::bumpnagleds()
     nagleds = sync->client->waiter->ds + 11;
 }
 
+// a file that is still changing at the end of its upload delay (e.g. a large export being
+// written) waits twice as long on each check, up to 35.2 s, so that an upload only starts
+// once it has settled instead of being restarted every time the file grows
+void LocalNode::bumpunstableds()
+{
+    if (unstableChecks < 5)
+    {
+        unstableChecks++;
+    }
+
+    nagleds = sync->client->waiter->ds + (11 << unstableChecks);
+}
+
 LocalNode::LocalNode(Sync* csync)
 : sync(csync)
 , deleted{false}
@@ -1462,6 +1865,12 @@ LocalNode::LocalNode(Sync* csync)
 , reported{false}
 , checked{false}
 , needsRescan(false)
+, syncdownPending(false)
+, syncdownPendingBelow(false)
+, childrenUnloaded(false)
+, fsidIndexed(false)
+, childrenUsed(false)
+, unstableChecks(0)
 {}
 
 // initialize fresh LocalNode object - must be called exactly once
@@ -1474,6 +1883,9 @@ void LocalNode::init(nodetype_t ctype, LocalNode* cparent, const LocalPath& cful
     created = false;
     reported = false;
     needsRescan = false;
+    syncdownPending = false;
+    syncdownPendingBelow = false;
+    childrenUnloaded = false;
     syncxfer = true;
     newnode.reset();
     parent_dbid = 0;
@@ -1501,7 +1913,9 @@ void LocalNode::init(nodetype_t ctype, LocalNode* cparent, const LocalPath& cful
     scanseqno = sync->scanseqno;
 
     // mark fsid as not valid
-    fsid_it = sync->client->fsidnode.end();
+    fsidIndexed = false;
+    childrenUsed = false;
+    unstableChecks = 0;
 
     // enable folder notification
     if (type == FOLDERNODE && sync->dirnotify)
@@ -1631,27 +2045,27 @@ void LocalNode::setfsid(handle newfsid, handlelocalnode_map& fsidnodes)
         return;
     }
 
-    if (fsid_it != fsidnodes.end())
+    if (fsidIndexed)
     {
         if (newfsid == fsid)
         {
             return;
         }
 
-        fsidnodes.erase(fsid_it);
+        fsidnodes.erase(fsid);
     }
 
     fsid = newfsid;
 
     pair<handlelocalnode_map::iterator, bool> r = fsidnodes.insert(std::make_pair(fsid, this));
 
-    fsid_it = r.first;
+    fsidIndexed = true;
 
     if (!r.second)
     {
         // remove previous fsid assignment (the node is likely about to be deleted)
-        fsid_it->second->fsid_it = fsidnodes.end();
-        fsid_it->second = this;
+        r.first->second->fsidIndexed = false;
+        r.first->second = this;
     }
 }
 
@@ -1664,7 +2078,10 @@ LocalNode::~LocalNode()
         return;
     }
 
-    if (!sync->mDestructorRunning && (
+    // unloaded LocalNodes stay in the state cache, and their files in the cloud
+    bool unloading = sync->mUnloadingLocalNodes;
+
+    if (!sync->mDestructorRunning && !unloading && (
         sync->state() == SYNC_ACTIVE || sync->state() == SYNC_INITIALSCAN))
     {
         sync->statecachedel(this);
@@ -1693,15 +2110,15 @@ LocalNode::~LocalNode()
     }
 
     // remove from fsidnode map, if present
-    if (fsid_it != sync->client->fsidnode.end())
+    if (fsidIndexed)
     {
-        sync->client->fsidnode.erase(fsid_it);
+        sync->client->fsidnode.erase(fsid);
     }
 
     sync->client->totalLocalNodes--;
     sync->localnodes[type]--;
 
-    if (type == FILENODE && size > 0)
+    if (type == FILENODE && size > 0 && !unloading)
     {
         sync->localbytes -= size;
     }
@@ -1725,7 +2142,7 @@ LocalNode::~LocalNode()
         delete it++->second;
     }
 
-    if (node && !sync->mDestructorRunning)
+    if (node && !sync->mDestructorRunning && !unloading)
     {
         // move associated node to SyncDebris unless the sync is currently
         // shutting down
@@ -1736,6 +2153,36 @@ LocalNode::~LocalNode()
     }
 }
 
+size_t LocalNode::approximateSize() const
+{
+    size_t size = sizeof(LocalNode) + MemoryReport::heapBytes(name);
+
+    {
+        lock_guard<mutex> g(localname_mutex);
+        size += localname_multithreaded.reportSize();
+    }
+
+    if (slocalname)
+    {
+        size += sizeof(LocalPath) + slocalname->reportSize();
+    }
+
+    // the keys of 'children' are copies of the names of the children
+    size += children.size() * (MemoryReport::CONTAINER_NODE_OVERHEAD + sizeof(localnode_map::value_type));
+
+    for (const localnode_hashindex* index : { childrenhash.get(), schildren.get() })
+    {
+        if (index)
+        {
+            size += sizeof(*index)
+                  + index->size() * (MemoryReport::CONTAINER_NODE_OVERHEAD + sizeof(localnode_hashindex::value_type))
+                  + index->bucket_count() * sizeof(void*);
+        }
+    }
+
+    return size;
+}
+
 void LocalNode::detach(const bool recreate)
 {
     // Never detach the sync root.
@@ -1765,6 +2212,17 @@ void LocalNode::setSubtreeNeedsRescan(bool includeFiles)
     }
 }
 
+void LocalNode::setSyncdownPending()
+{
+    syncdownPending = true;
+
+    // stop at the first ancestor already on a marked path
+    for (LocalNode* p = parent; p && !p->syncdownPendingBelow; p = p->parent)
+    {
+        p->syncdownPendingBelow = true;
+    }
+}
+
 LocalPath LocalNode::getLocalPath() const
 {
     LocalPath lp;
@@ -1774,15 +2232,20 @@ LocalPath LocalNode::getLocalPath() const
 
 void LocalNode::getlocalpath(LocalPath& path) const
 {
-    path.clear();
+    // collect the leaf names up to the sync root and join them in one go:
+    // prepending them one at a time moves and regrows the whole path for every level
+    vector<const LocalPath*> components;
 
     for (const LocalNode* l = this; l != nullptr; l = l->parent)
     {
         assert(!l->parent || l->parent->sync == sync);
 
         // sync root has absolute path, the rest are just their leafname
-        path.prependWithSeparator(l->getLocalname());
+        components.push_back(&l->getLocalname());
     }
+
+    std::reverse(components.begin(), components.end());
+    path.assignComponents(components);
 }
 
 string LocalNode::debugGetParentList()
@@ -1799,14 +2262,61 @@ string LocalNode::debugGetParentList()
 // locate child by localname or slocalname
 LocalNode* LocalNode::childbyname(LocalPath* localname)
 {
-    localnode_map::iterator it;
-
-    if (!localname || ((it = children.find(*localname)) == children.end() && (it = schildren.find(*localname)) == schildren.end()))
+    if (!localname)
     {
         return NULL;
     }
 
-    return it->second;
+    if (childrenUnloaded)
+    {
+        sync->loadstatecachechildren(this, false);
+    }
+
+    childrenUsed = true;
+
+    LocalNode* l = findchild(*localname);
+
+    return l ? l : findschild(*localname);
+}
+
+LocalNode* LocalNode::findchild(const LocalPath& name) const
+{
+    if (!childrenhash)
+    {
+        return nullptr;
+    }
+
+    auto range = childrenhash->equal_range(name.hash());
+
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second->getLocalname() == name)
+        {
+            return it->second;
+        }
+    }
+
+    return nullptr;
+}
+
+LocalNode* LocalNode::findschild(const LocalPath& sname) const
+{
+    if (!schildren)
+    {
+        return nullptr;
+    }
+
+    auto range = schildren->equal_range(sname.hash());
+
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second->slocalname && *it->second->slocalname == sname)
+        {
+            return it->second;
+        }
+    }
+
+    return nullptr;
 }
 
 void LocalNode::prepare(FileSystemAccess&)
@@ -1837,6 +2347,9 @@ void LocalNode::completed(Transfer* t, putsource_t source)
 {
     sync->threadSafeState->transferComplete(PUT, size);
 
+    // the file held still long enough to be uploaded
+    unstableChecks = 0;
+
     // complete to rubbish for later retrieval if the parent node does not
     // exist or is newer
     if (!parent || !parent->node || (node && mtime < node->mtime))
@@ -1857,6 +2370,11 @@ void LocalNode::completed(Transfer* t, putsource_t source)
     sendPutnodes(t->client, t->uploadhandle, *t->ultoken, t->filekey, source, NodeHandle(), nullptr, this, nullptr, canChangeVault);
 }
 
+uint32_t LocalNode::parentdbid() const
+{
+    return parent ? parent->dbid : 0;
+}
+
 // serialize/unserialize the following LocalNode properties:
 // - type/size
 // - fsid
@@ -1867,20 +2385,24 @@ void LocalNode::completed(Transfer* t, putsource_t source)
 bool LocalNode::serialize(string* d)
 {
     CacheableWriter w(*d);
-    w.serializei64(type ? -type : size);
-    w.serializehandle(fsid);
-    w.serializeu32(parent ? parent->dbid : 0);
-    w.serializenodehandle(node ? node->nodehandle : UNDEF);
-    w.serializestring(getLocalname().platformEncoded());
+    w.serializefields(int64_t(type ? -type : size),
+                      fsid,
+                      uint32_t(parent ? parent->dbid : 0),
+                      CacheableWriter::NodeHandle{node ? node->nodehandle : UNDEF},
+                      getLocalname().platformEncoded());
     if (type == FILENODE)
     {
         w.serializebinary((byte*)crc.data(), sizeof(crc));
         w.serializecompressedi64(mtime);
     }
     w.serializebyte(mSyncable);
-    w.serializeexpansionflags(1);  // first flag indicates we are storing slocalname.  Storing it is much, much faster than looking it up on startup.
+    w.serializeexpansionflags(1, type == FILENODE);  // first flag indicates we are storing slocalname.  Storing it is much, much faster than looking it up on startup.
     auto tmpstr = slocalname ? slocalname->platformEncoded() : string();
     w.serializepstr(slocalname ? &tmpstr : nullptr);
+    if (type == FILENODE)
+    {
+        w.serializecompressedi64(ctime);
+    }
 
     return true;
 }
@@ -1920,20 +2442,19 @@ LocalNode* LocalNode::unserialize(Sync* sync, const string* d)
     handle h = 0;
     string localname, shortname;
     m_time_t mtime = 0;
+    m_time_t ctime = 0;
     int32_t crc[4];
     memset(crc, 0, sizeof crc);
     byte syncable = 1;
     unsigned char expansionflags[8] = { 0 };
 
-    if (!r.unserializehandle(fsid) ||
-        !r.unserializeu32(parent_dbid) ||
-        !r.unserializenodehandle(h) ||
-        !r.unserializestring(localname) ||
+    if (!r.unserializefields(fsid, parent_dbid, CacheableReader::NodeHandle{h}, localname) ||
         (type == FILENODE && !r.unserializebinary((byte*)crc, sizeof(crc))) ||
         (type == FILENODE && !r.unserializecompressedi64(mtime)) ||
         (r.hasdataleft() && !r.unserializebyte(syncable)) ||
-        (r.hasdataleft() && !r.unserializeexpansionflags(expansionflags, 1)) ||
-        (expansionflags[0] && !r.unserializecstr(shortname, false)))
+        (r.hasdataleft() && !r.unserializeexpansionflags(expansionflags, 2)) ||
+        (expansionflags[0] && !r.unserializecstr(shortname, false)) ||
+        (expansionflags[1] && !r.unserializecompressedi64(ctime)))
     {
         LOG_err << "LocalNode unserialization failed at field " << r.fieldnum;
         return nullptr;
@@ -1948,7 +2469,6 @@ LocalNode* LocalNode::unserialize(Sync* sync, const string* d)
     l->parent_dbid = parent_dbid;
 
     l->fsid = fsid;
-    l->fsid_it = sync->client->fsidnode.end();
 
     l->setLocalname(LocalPath::fromPlatformEncodedRelative(localname));
     l->slocalname.reset(shortname.empty() ? nullptr : new LocalPath(LocalPath::fromPlatformEncodedRelative(shortname)));
@@ -1957,6 +2477,7 @@ LocalNode* LocalNode::unserialize(Sync* sync, const string* d)
 
     memcpy(l->crc.data(), crc, sizeof crc);
     l->mtime = mtime;
+    l->ctime = ctime;
     l->isvalid = true;
 
     l->node.store_unchecked(sync->client->nodebyhandle(h));
@@ -1969,6 +2490,12 @@ LocalNode* LocalNode::unserialize(Sync* sync, const string* d)
     l->reported = false;
     l->checked = h != UNDEF; // TODO: Is this a bug? h will never be UNDEF
     l->needsRescan = false;
+    l->syncdownPending = false;
+    l->syncdownPendingBelow = false;
+    l->childrenUnloaded = false;
+    l->fsidIndexed = false;
+    l->childrenUsed = false;
+    l->unstableChecks = 0;
 
     return l;
 }
@@ -273,7 +273,7 @@ void MacDirNotify::callback(const FSEventStreamEventFlags* flags,
     }
 
     // Let the engine know it has events to process.
-    mWaiter.notify();
+    mWaiter.notifyBy(Waiter::NOTIFY_DIRNOTIFY);
 }
 
 void MacDirNotify::trampoline(ConstFSEventStreamRef,
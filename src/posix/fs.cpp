@@ -28,6 +28,11 @@
 #include <sys/ioctl.h>
 #include <sys/statvfs.h>
 #include <sys/resource.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#ifdef HAVE_LIBURING
+#include <sys/eventfd.h>
+#endif
 #ifdef TARGET_OS_MAC
 #include "mega/osx/osxutils.h"
 #endif
@@ -41,10 +46,16 @@ extern JavaVM *MEGAjvm;
 #include <uuid/uuid.h>
 #endif
 
+#ifdef __APPLE__
+#include <sys/clonefile.h>
+#endif
+
 #ifdef __linux__
 
 #ifndef __ANDROID__
 #include <linux/magic.h>
+#include <linux/fs.h>
+#include <sys/syscall.h>
 #endif /* ! __ANDROID__ */
 
 #include <sys/vfs.h>
@@ -157,10 +168,12 @@ int platformCompareUtf(const LocalPath& p1, bool unescape1, const LocalPath& p2,
     return compareUtf(p1, unescape1, p2, unescape2, false);
 }
 
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(HAVE_LIBURING)
 PosixAsyncIOContext::PosixAsyncIOContext() : AsyncIOContext()
 {
+#ifdef HAVE_AIO_RT
     aiocb = NULL;
+#endif
 }
 
 PosixAsyncIOContext::~PosixAsyncIOContext()
@@ -171,6 +184,24 @@ PosixAsyncIOContext::~PosixAsyncIOContext()
 
 void PosixAsyncIOContext::finish()
 {
+#ifdef HAVE_LIBURING
+    if (inRing)
+    {
+        if (!finished)
+        {
+            LOG_debug << "Synchronously waiting for io_uring operation";
+            // it may still be held back in the submission queue
+            if (PosixIoUring* ring = PosixIoUring::instance())
+            {
+                ring->flush();
+            }
+            AsyncIOContext::finish();
+        }
+        inRing = false;
+    }
+#endif
+
+#ifdef HAVE_AIO_RT
     if (aiocb)
     {
         if (!finished)
@@ -181,10 +212,189 @@ void PosixAsyncIOContext::finish()
         delete aiocb;
         aiocb = NULL;
     }
+#endif
     assert(finished);
 }
 #endif
 
+#ifdef HAVE_LIBURING
+// holds taken by this thread on the submissions to the ring
+static thread_local unsigned heldUringSubmissions = 0;
+
+PosixIoUring* PosixIoUring::instance()
+{
+    static PosixIoUring ring;
+    return ring.mReady && !ring.mAbandoned ? &ring : nullptr;
+}
+
+PosixIoUring::PosixIoUring()
+{
+    int e = io_uring_queue_init(QUEUE_DEPTH, &mRing, 0);
+    if (e < 0)
+    {
+        LOG_warn << "io_uring not available: " << -e;
+        return;
+    }
+
+    if ((mEventFd = eventfd(0, EFD_CLOEXEC)) < 0
+        || io_uring_register_eventfd(&mRing, mEventFd) < 0)
+    {
+        LOG_err << "Unable to signal io_uring completions: " << errno;
+        if (mEventFd >= 0)
+        {
+            close(mEventFd);
+            mEventFd = -1;
+        }
+        io_uring_queue_exit(&mRing);
+        return;
+    }
+
+    mReaper = std::thread([this]() { reap(); });
+    mReady = true;
+    LOG_debug << "Using io_uring for async file I/O";
+}
+
+PosixIoUring::~PosixIoUring()
+{
+    if (!mReady)
+    {
+        return;
+    }
+
+    mStop = true;
+    uint64_t one = 1;
+    if (::write(mEventFd, &one, sizeof one) < 0)
+    {
+        LOG_err << "Unable to stop the io_uring reaper: " << errno;
+    }
+    mReaper.join();
+
+    io_uring_queue_exit(&mRing);
+    close(mEventFd);
+}
+
+bool PosixIoUring::submit(PosixAsyncIOContext* context, int fd)
+{
+    lock_guard<mutex> g(mSubmitMutex);
+
+    if (mAbandoned)
+    {
+        return false;
+    }
+
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&mRing);
+    if (!sqe)
+    {
+        // full of operations not consumed by the kernel yet
+        if (!submitqueued() || !(sqe = io_uring_get_sqe(&mRing)))
+        {
+            return false;
+        }
+    }
+
+    if (context->op == AsyncIOContext::READ)
+    {
+        io_uring_prep_read(sqe, fd, context->dataBuffer, context->dataBufferLen, static_cast<uint64_t>(context->posOfBuffer));
+    }
+    else
+    {
+        io_uring_prep_write(sqe, fd, context->dataBuffer, context->dataBufferLen, static_cast<uint64_t>(context->posOfBuffer));
+    }
+    io_uring_sqe_set_data(sqe, context);
+
+    context->inRing = true;
+    mQueued.push_back(context);
+    if (!heldUringSubmissions)
+    {
+        // on failure the context has already finished
+        submitqueued();
+    }
+    return true;
+}
+
+bool PosixIoUring::submitqueued()
+{
+    for (int attempt = 1; !mQueued.empty(); attempt++)
+    {
+        int e = io_uring_submit(&mRing);
+        if (e >= 0)
+        {
+            // the kernel consumes them in order
+            mQueued.erase(mQueued.begin(), mQueued.begin() + std::min(static_cast<size_t>(e), mQueued.size()));
+            continue;
+        }
+
+        // out of resources, or the completion queue needs reaping first (the reaper does that)
+        if ((e == -EAGAIN || e == -EBUSY || e == -EINTR) && attempt < MAX_SUBMIT_ATTEMPTS)
+        {
+            LOG_warn << "io_uring submission deferred: " << -e;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1 << attempt));
+            continue;
+        }
+
+        LOG_err << "io_uring submission failed, no longer using io_uring: " << -e;
+        mAbandoned = true;
+
+        deque<PosixAsyncIOContext*> queued;
+        queued.swap(mQueued);
+        for (PosixAsyncIOContext* context : queued)
+        {
+            context->inRing = false;
+            PosixFileAccess::uringopfinished(context, -EAGAIN);
+        }
+        return false;
+    }
+    return true;
+}
+
+void PosixIoUring::hold()
+{
+    heldUringSubmissions++;
+}
+
+void PosixIoUring::release()
+{
+    assert(heldUringSubmissions);
+    if (!--heldUringSubmissions)
+    {
+        flush();
+    }
+}
+
+void PosixIoUring::flush()
+{
+    lock_guard<mutex> g(mSubmitMutex);
+
+    if (!mAbandoned)
+    {
+        submitqueued();
+    }
+}
+
+void PosixIoUring::reap()
+{
+    while (!mStop)
+    {
+        uint64_t count;
+        if (::read(mEventFd, &count, sizeof count) < 0 && errno != EINTR)
+        {
+            LOG_err << "io_uring eventfd read failed: " << errno;
+            return;
+        }
+
+        struct io_uring_cqe* cqe;
+        while (io_uring_peek_cqe(&mRing, &cqe) == 0)
+        {
+            PosixAsyncIOContext* context = static_cast<PosixAsyncIOContext*>(io_uring_cqe_get_data(cqe));
+            int res = cqe->res;
+            io_uring_cqe_seen(&mRing, cqe);
+
+            PosixFileAccess::uringopfinished(context, res);
+        }
+    }
+}
+#endif
+
 PosixFileAccess::PosixFileAccess(Waiter *w, int defaultfilepermissions, bool followSymLinks) : FileAccess(w)
 {
     fd = -1;
@@ -284,6 +494,13 @@ void PosixFileAccess::sysclose()
 
 bool PosixFileAccess::asyncavailable()
 {
+#ifdef HAVE_LIBURING
+    if (PosixIoUring::instance())
+    {
+        return true;
+    }
+#endif
+
 #ifdef HAVE_AIO_RT
     #ifdef __APPLE__
         return false;
@@ -295,11 +512,47 @@ bool PosixFileAccess::asyncavailable()
 #endif
 }
 
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(HAVE_LIBURING)
 AsyncIOContext *PosixFileAccess::newasynccontext()
 {
     return new PosixAsyncIOContext();
 }
+#endif
+
+#ifdef HAVE_LIBURING
+void PosixFileAccess::uringopfinished(PosixAsyncIOContext* context, int res)
+{
+    // a regular file only reads or writes short at its end, or on running out of space
+    context->retry = (res == -EAGAIN || res == -EINTR);
+    context->failed = res < 0 || static_cast<unsigned>(res) != context->dataBufferLen;
+    if (!context->failed)
+    {
+        if (context->op == AsyncIOContext::READ && context->pad)
+        {
+            memset(context->dataBuffer + context->dataBufferLen, 0, context->pad);
+            LOG_verbose << "io_uring read finished OK";
+        }
+        else
+        {
+            LOG_verbose << "io_uring write finished OK";
+        }
+    }
+    else
+    {
+        LOG_warn << "io_uring operation finished with error: " << res << " of " << context->dataBufferLen << " bytes";
+    }
+
+    asyncfscallback userCallback = context->userCallback;
+    void *userData = context->userData;
+    context->finished = true;
+    if (userCallback)
+    {
+        userCallback(userData);
+    }
+}
+#endif
+
+#ifdef HAVE_AIO_RT
 
 void PosixFileAccess::asyncopfinished(sigval sigev_value)
 {
@@ -338,7 +591,8 @@ void PosixFileAccess::asyncopfinished(sigval sigev_value)
 
 void PosixFileAccess::asyncsysopen(AsyncIOContext *context)
 {
-#ifdef HAVE_AIO_RT
+    // opens complete right away: the transfer dispatch does not handle pending ones yet
+#if defined(HAVE_AIO_RT) || defined(HAVE_LIBURING)
     context->failed = !fopen(context->openPath, context->access & AsyncIOContext::ACCESS_READ,
                              context->access & AsyncIOContext::ACCESS_WRITE);
     context->retry = retry;
@@ -354,7 +608,7 @@ void PosixFileAccess::asyncsysopen(AsyncIOContext *context)
 
 void PosixFileAccess::asyncsysread(AsyncIOContext *context)
 {
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(HAVE_LIBURING)
     if (!context)
     {
         return;
@@ -373,6 +627,26 @@ void PosixFileAccess::asyncsysread(AsyncIOContext *context)
         return;
     }
 
+#ifdef HAVE_LIBURING
+    if (PosixIoUring* ring = PosixIoUring::instance())
+    {
+        if (!ring->submit(posixContext, fd))
+        {
+            posixContext->retry = true;
+            posixContext->failed = true;
+            posixContext->finished = true;
+
+            LOG_warn << "io_uring read could not be queued";
+            if (posixContext->userCallback)
+            {
+                posixContext->userCallback(posixContext->userData);
+            }
+        }
+        return;
+    }
+#endif
+
+#ifdef HAVE_AIO_RT
     struct aiocb *aiocbp = new struct aiocb;
     memset(aiocbp, 0, sizeof (struct aiocb));
 
@@ -398,6 +672,7 @@ void PosixFileAccess::asyncsysread(AsyncIOContext *context)
             posixContext->userCallback(posixContext->userData);
         }
     }
+#endif
 #else
     (void)context; // avoid unused parameter warning
 #endif
@@ -405,7 +680,7 @@ void PosixFileAccess::asyncsysread(AsyncIOContext *context)
 
 void PosixFileAccess::asyncsyswrite(AsyncIOContext *context)
 {
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(HAVE_LIBURING)
     if (!context)
     {
         return;
@@ -424,6 +699,26 @@ void PosixFileAccess::asyncsyswrite(AsyncIOContext *context)
         return;
     }
 
+#ifdef HAVE_LIBURING
+    if (PosixIoUring* ring = PosixIoUring::instance())
+    {
+        if (!ring->submit(posixContext, fd))
+        {
+            posixContext->retry = true;
+            posixContext->failed = true;
+            posixContext->finished = true;
+
+            LOG_warn << "io_uring write could not be queued";
+            if (posixContext->userCallback)
+            {
+                posixContext->userCallback(posixContext->userData);
+            }
+        }
+        return;
+    }
+#endif
+
+#ifdef HAVE_AIO_RT
     struct aiocb *aiocbp = new struct aiocb;
     memset(aiocbp, 0, sizeof (struct aiocb));
 
@@ -450,6 +745,7 @@ void PosixFileAccess::asyncsyswrite(AsyncIOContext *context)
             posixContext->userCallback(posixContext->userData);
         }
     }
+#endif
 #else
     (void)context; // avoid unused parameter warning
 #endif
@@ -486,6 +782,150 @@ bool PosixFileAccess::fwrite(const byte* data, unsigned len, m_off_t pos)
 #endif
 }
 
+bool PosixFileAccess::fwritev(const byte* const* bufs, const unsigned* lens, unsigned count, m_off_t pos)
+{
+#if defined(__linux__) && !defined(__ANDROID__)
+    retry = false;
+
+    std::vector<struct iovec> iov(count);
+    size_t total = 0;
+    for (unsigned i = 0; i < count; i++)
+    {
+        iov[i].iov_base = const_cast<byte*>(bufs[i]);
+        iov[i].iov_len = lens[i];
+        total += lens[i];
+    }
+
+    // pwritev may write less than asked; carry on from where it stopped
+    size_t done = 0;
+    unsigned first = 0;
+    while (done < total)
+    {
+        ssize_t w = ::pwritev(fd, iov.data() + first, int(count - first), pos + m_off_t(done));
+        if (w <= 0)
+        {
+            return false;
+        }
+
+        done += size_t(w);
+        while (first < count && size_t(w) >= iov[first].iov_len)
+        {
+            w -= ssize_t(iov[first].iov_len);
+            first++;
+        }
+        if (first < count)
+        {
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + w;
+            iov[first].iov_len -= size_t(w);
+        }
+    }
+    return true;
+#else
+    return FileAccess::fwritev(bufs, lens, count, pos);
+#endif
+}
+
+bool PosixFileAccess::fpreallocate(m_off_t newsize)
+{
+    retry = false;
+
+#if defined(__linux__) && !defined(__ANDROID__)
+    // the blocks are reserved past the end of the file, so out of order writes don't extend it piecemeal
+    if (!fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, newsize))
+    {
+        return true;
+    }
+    int e = errno;
+#elif defined(__APPLE__)
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) || statbuf.st_size >= newsize)
+    {
+        return true;
+    }
+
+    // contiguous if possible, from the physical end of the file
+    fstore_t store = { F_ALLOCATECONTIG | F_ALLOCATEALL, F_PEOFPOSMODE, 0, newsize - statbuf.st_size, 0 };
+    if (fcntl(fd, F_PREALLOCATE, &store) != -1)
+    {
+        return true;
+    }
+
+    store.fst_flags = F_ALLOCATEALL;
+    if (fcntl(fd, F_PREALLOCATE, &store) != -1)
+    {
+        return true;
+    }
+    int e = errno;
+#else
+    (void)newsize;
+    return true;
+#endif
+
+#if (defined(__linux__) && !defined(__ANDROID__)) || defined(__APPLE__)
+    if (e == ENOSPC)
+    {
+        errorcode = e;
+        LOG_warn << "Not enough space to preallocate " << newsize << " bytes";
+        return false;
+    }
+
+    LOG_debug << "Unable to preallocate " << newsize << " bytes: " << e;
+    return true;
+#endif
+}
+
+namespace {
+struct PosixMappedFileRange : public MappedFileRange
+{
+    void* mAddress = MAP_FAILED;
+    size_t mLength = 0;
+
+    ~PosixMappedFileRange()
+    {
+        if (mAddress != MAP_FAILED)
+        {
+            munmap(mAddress, mLength);
+        }
+    }
+};
+} // namespace
+
+std::unique_ptr<MappedFileRange> PosixFileAccess::fmap(unsigned len, m_off_t pos)
+{
+    if (!len || !openf())
+    {
+        return nullptr;
+    }
+
+    // a mapping past the end of the file faults when read
+    if (pos < 0 || pos + len > size)
+    {
+        closef();
+        return nullptr;
+    }
+
+    static const m_off_t pagesize = sysconf(_SC_PAGESIZE);
+    m_off_t offset = pos % pagesize;
+
+    std::unique_ptr<PosixMappedFileRange> range(new PosixMappedFileRange);
+    range->mLength = size_t(offset + len);
+    range->mAddress = mmap(nullptr, range->mLength, PROT_READ, MAP_PRIVATE, fd, pos - offset);
+
+    // the mapping holds its own reference to the file
+    closef();
+
+    if (range->mAddress == MAP_FAILED)
+    {
+        LOG_warn << "Unable to map file range: " << errno;
+        return nullptr;
+    }
+
+    posix_madvise(range->mAddress, range->mLength, POSIX_MADV_SEQUENTIAL);
+    range->data = static_cast<const byte*>(range->mAddress) + offset;
+
+    return std::move(range);
+}
+
 bool PosixFileAccess::ftruncate()
 {
     retry = false;
@@ -594,6 +1034,7 @@ bool PosixFileAccess::fopen(const LocalPath& f, bool read, bool write, DirAccess
 
             size = 0;
             mtime = statbuf.st_mtime;
+            ctime = statbuf.st_ctime;
             type = FOLDERNODE;
             fsid = (handle)statbuf.st_ino;
             fsidvalid = true;
@@ -665,6 +1106,7 @@ bool PosixFileAccess::fopen(const LocalPath& f, bool read, bool write, DirAccess
             type = S_ISDIR(statbuf.st_mode) ? FOLDERNODE : FILENODE;
             size = (type == FILENODE || mIsSymLink) ? statbuf.st_size : 0;
             mtime = statbuf.st_mtime;
+            ctime = statbuf.st_ctime;
             // in the future we might want to add LINKNODE to type and set it here using S_ISLNK
             fsid = (handle)statbuf.st_ino;
             fsidvalid = true;
@@ -722,12 +1164,24 @@ PosixFileSystemAccess::~PosixFileSystemAccess()
     {
         close(notifyfd);
     }
-}
-
-bool PosixFileSystemAccess::cwd(LocalPath& path) const
-{
-    return cwd_static(path);
-}
+
+#if defined(ENABLE_SYNC) && defined(USE_FANOTIFY)
+    for (auto& fs : fanotifyfilesystems)
+    {
+        close(fs.second.mountfd);
+    }
+
+    if (fanotifyfd >= 0)
+    {
+        close(fanotifyfd);
+    }
+#endif
+}
+
+bool PosixFileSystemAccess::cwd(LocalPath& path) const
+{
+    return cwd_static(path);
+}
 
 bool PosixFileSystemAccess::cwd_static(LocalPath& path)
 {
@@ -757,143 +1211,509 @@ void PosixFileSystemAccess::addevents(Waiter* w, int /*flags*/)
     {
         PosixWaiter* pw = (PosixWaiter*)w;
 
-        MEGA_FD_SET(notifyfd, &pw->rfds);
-        MEGA_FD_SET(notifyfd, &pw->ignorefds);
+        MEGA_FD_SET(notifyfd, &pw->rfds);
+        MEGA_FD_SET(notifyfd, &pw->ignorefds);
+
+        pw->bumpmaxfd(notifyfd);
+    }
+
+#if defined(ENABLE_SYNC) && defined(USE_FANOTIFY)
+    if (fanotifyfd >= 0)
+    {
+        PosixWaiter* pw = (PosixWaiter*)w;
+
+        MEGA_FD_SET(fanotifyfd, &pw->rfds);
+        MEGA_FD_SET(fanotifyfd, &pw->ignorefds);
+
+        pw->bumpmaxfd(fanotifyfd);
+    }
+#endif
+}
+
+// read all pending inotify events and queue them for processing
+int PosixFileSystemAccess::checkevents(Waiter* w)
+{
+    int r = 0;
+
+#if defined(ENABLE_SYNC) && defined(USE_FANOTIFY)
+    if (fanotifyfd >= 0 && MEGA_FD_ISSET(fanotifyfd, &((PosixWaiter*)w)->rfds))
+    {
+        r |= fanotifyevents();
+    }
+#endif
+
+    if (notifyfd < 0)
+    {
+        return r;
+    }
+#ifdef ENABLE_SYNC
+#ifdef USE_INOTIFY
+    PosixWaiter* pw = (PosixWaiter*)w;
+    string *ignore;
+
+    if (MEGA_FD_ISSET(notifyfd, &pw->rfds))
+    {
+        char buf[sizeof(struct inotify_event) + NAME_MAX + 1];
+        ssize_t p, l;
+        inotify_event* in;
+        wdlocalnode_map::iterator it;
+        string localpath;
+
+        while ((l = read(notifyfd, buf, sizeof buf)) > 0)
+        {
+            for (p = 0; p < l; p += offsetof(inotify_event, name) + in->len)
+            {
+                in = (inotify_event*)(buf + p);
+
+                if (in->mask & (IN_Q_OVERFLOW | IN_UNMOUNT))
+                {
+                    notifyerr = true;
+                }
+
+// this flag was introduced in glibc 2.13 and Linux 2.6.36 (released October 20, 2010)
+#ifndef IN_EXCL_UNLINK
+#define IN_EXCL_UNLINK 0x04000000
+#endif
+                if (in->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM
+                              | IN_MOVED_TO | IN_CLOSE_WRITE | IN_EXCL_UNLINK))
+                {
+                    //if ((in->mask & (IN_CREATE | IN_ISDIR)) != IN_CREATE) //certain operations (e.g: QFile::copy, Qt 5.11) might produce IN_CREATE with no further IN_CLOSE_WRITE
+                    {
+                        it = wdnodes.find(in->wd);
+
+                        if (it != wdnodes.end())
+                        {
+                            if (lastcookie && lastcookie != in->cookie)
+                            {
+                                ignore = &lastlocalnode->sync->dirnotify->ignore.localpath;
+                                if (lastname.size() < ignore->size()
+                                 || memcmp(lastname.c_str(), ignore->data(), ignore->size())
+                                 || (lastname.size() > ignore->size()
+                                  && lastname[ignore->size()] != LocalPath::localPathSeparator))
+                                {
+                                    // previous IN_MOVED_FROM is not followed by the
+                                    // corresponding IN_MOVED_TO, so was actually a deletion
+                                    LOG_debug << "Filesystem notification (deletion). Root: " << lastlocalnode->name << "   Path: " << lastname;
+                                    lastlocalnode->sync->dirnotify->notify(DirNotify::DIREVENTS,
+                                                                           lastlocalnode,
+                                                                           LocalPath::fromPlatformEncodedRelative(lastname),
+                                                                           false,
+                                                                           false);
+
+                                    r |= Waiter::NEEDEXEC;
+                                }
+                            }
+
+                            if (in->mask & IN_MOVED_FROM)
+                            {
+                                // could be followed by the corresponding IN_MOVE_TO or not..
+                                // retain in case it's not (in which case it's a deletion)
+                                lastcookie = in->cookie;
+                                lastlocalnode = it->second;
+                                lastname = in->name;
+                            }
+                            else
+                            {
+                                lastcookie = 0;
+
+                                ignore = &it->second->sync->dirnotify->ignore.localpath;
+                                size_t insize = strlen(in->name);
+
+                                if (insize < ignore->size()
+                                 || memcmp(in->name, ignore->data(), ignore->size())
+                                 || (insize > ignore->size()
+                                  && in->name[ignore->size()] != LocalPath::localPathSeparator))
+                                {
+                                    LOG_debug << "Filesystem notification. Root: " << it->second->name << "   Path: " << in->name;
+                                    it->second->sync->dirnotify->notify(DirNotify::DIREVENTS,
+                                                                        it->second,
+                                                                        LocalPath::fromPlatformEncodedRelative(std::string(in->name, insize)),
+                                                                        false,
+                                                                        false);
+
+                                    r |= Waiter::NEEDEXEC;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // this assumes that corresponding IN_MOVED_FROM / IN_MOVED_FROM pairs are never notified separately
+        if (lastcookie)
+        {
+            ignore = &lastlocalnode->sync->dirnotify->ignore.localpath;
+
+            if (lastname.size() < ignore->size()
+             || memcmp(lastname.c_str(), ignore->data(), ignore->size())
+             || (lastname.size() > ignore->size()
+              && lastname[ignore->size()] != LocalPath::localPathSeparator))
+            {
+                LOG_debug << "Filesystem notification. Root: " << lastlocalnode->name << "   Path: " << lastname;
+                lastlocalnode->sync->dirnotify->notify(DirNotify::DIREVENTS,
+                                                       lastlocalnode,
+                                                       LocalPath::fromPlatformEncodedRelative(lastname),
+                                                       false,
+                                                       false);
+
+                r |= Waiter::NEEDEXEC;
+            }
+
+            lastcookie = 0;
+        }
+    }
+#endif
+#endif
+    return r;
+}
+
+#if defined(ENABLE_SYNC) && defined(USE_FANOTIFY)
+
+#define FANOTIFY_EVENTS (FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO | FAN_CLOSE_WRITE | FAN_ONDIR)
+
+// the handle fanotify reports for the directory at path
+static bool fanotifydirhandle(const char* path, string& handle)
+{
+    struct
+    {
+        file_handle fh;
+        unsigned char f_handle[MAX_HANDLE_SZ];
+    } h;
+    int mountid;
+    int flags = 0;
+
+#ifdef AT_HANDLE_FID
+    flags |= AT_HANDLE_FID;
+#endif
+
+    h.fh.handle_bytes = MAX_HANDLE_SZ;
+
+    if (name_to_handle_at(AT_FDCWD, path, &h.fh, &mountid, flags))
+    {
+        return false;
+    }
+
+    handle.assign((const char*)&h.fh, sizeof(file_handle) + h.fh.handle_bytes);
+    return true;
+}
+
+// covers the filesystem of rootpath with a single mark (shared by all roots on it)
+bool PosixFileSystemAccess::fanotifyadd(PosixDirNotify* dirnotify, LocalNode* root, const LocalPath& rootpath)
+{
+    if (fanotifyfd < 0)
+    {
+        return false;
+    }
+
+    const string& path = rootpath.localpath;
+    struct statfs sfs;
+
+    if (statfs(path.c_str(), &sfs))
+    {
+        LOG_warn << "Unable to statfs " << path << ". Error code: " << errno;
+        return false;
+    }
+
+    pair<int, int> fsid(sfs.f_fsid.__val[0], sfs.f_fsid.__val[1]);
+    auto it = fanotifyfilesystems.find(fsid);
+
+    if (it == fanotifyfilesystems.end())
+    {
+        int mountfd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+        if (mountfd < 0)
+        {
+            LOG_warn << "Unable to open " << path << ". Error code: " << errno;
+            return false;
+        }
+
+        // events only carry directory handles: the filesystem must be able to provide them
+        struct stat st;
+        string handle;
+
+        if (fstat(mountfd, &st)
+         || !fanotifydirhandle(path.c_str(), handle)
+         || fanotify_mark(fanotifyfd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, FANOTIFY_EVENTS, mountfd, nullptr))
+        {
+            LOG_warn << "Unable to add fanotify mark for " << path << ", using inotify. Error code: " << errno;
+            close(mountfd);
+            return false;
+        }
+
+        LOG_debug << "fanotify mark added for the filesystem of " << path;
+
+        it = fanotifyfilesystems.emplace(fsid, FanotifyFilesystem()).first;
+        it->second.mountfd = mountfd;
+        it->second.dev = st.st_dev;
+    }
+
+    FanotifyRoot r;
+    r.dirnotify = dirnotify;
+    r.root = root;
+    r.path = path;
+
+    if (r.path.size() > 1 && r.path.back() == LocalPath::localPathSeparator)
+    {
+        r.path.pop_back();
+    }
+    else if (r.path.size() == 1)
+    {
+        // "/": every absolute path is below it
+        r.path.clear();
+    }
+
+    fanotifyadddirs(it->second, r.path.empty() ? path : r.path);
+
+    it->second.roots.push_back(std::move(r));
+
+    return true;
+}
+
+void PosixFileSystemAccess::fanotifyremove(PosixDirNotify* dirnotify)
+{
+    for (auto it = fanotifyfilesystems.begin(); it != fanotifyfilesystems.end(); )
+    {
+        auto& fs = it->second;
+
+        for (auto& r : fs.roots)
+        {
+            if (r.dirnotify == dirnotify)
+            {
+                fanotifydeldirs(fs, r.path.empty() ? string(1, LocalPath::localPathSeparator) : r.path);
+            }
+        }
+
+        fs.roots.erase(std::remove_if(fs.roots.begin(), fs.roots.end(), [dirnotify](const FanotifyRoot& r)
+        {
+            return r.dirnotify == dirnotify;
+        }), fs.roots.end());
+
+        if (fs.roots.empty())
+        {
+            fanotify_mark(fanotifyfd, FAN_MARK_REMOVE | FAN_MARK_FILESYSTEM, FANOTIFY_EVENTS, fs.mountfd, nullptr);
+            close(fs.mountfd);
+            it = fanotifyfilesystems.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+}
+
+// done when a root is added and when a directory appears in one, which the sync scans anyway
+void PosixFileSystemAccess::fanotifyadddirs(FanotifyFilesystem& fs, const string& path)
+{
+    vector<string> pending(1, path);
+    string handle;
+
+    while (!pending.empty())
+    {
+        string dirpath = std::move(pending.back());
+        pending.pop_back();
+
+        struct stat st;
+
+        if (lstat(dirpath.c_str(), &st)
+         || !S_ISDIR(st.st_mode)
+         || st.st_dev != fs.dev
+         || !fanotifydirhandle(dirpath.c_str(), handle))
+        {
+            continue;
+        }
+
+        // another directory that had this path
+        auto pit = fs.dirhandles.find(dirpath);
+
+        if (pit != fs.dirhandles.end() && pit->second != handle)
+        {
+            fs.dirpaths.erase(pit->second);
+        }
+
+        // the same directory under an older path (a move we only saw one end of)
+        auto hit = fs.dirpaths.find(handle);
+
+        if (hit != fs.dirpaths.end())
+        {
+            fs.dirhandles.erase(hit->second);
+            hit->second = dirpath;
+        }
+        else
+        {
+            fs.dirpaths.emplace(handle, dirpath);
+        }
+
+        fs.dirhandles[dirpath] = handle;
+
+        if (DIR* dp = opendir(dirpath.c_str()))
+        {
+            while (dirent* d = readdir(dp))
+            {
+                if ((d->d_type != DT_DIR && d->d_type != DT_UNKNOWN)
+                 || !strcmp(d->d_name, ".") || !strcmp(d->d_name, ".."))
+                {
+                    continue;
+                }
+
+                pending.push_back(dirpath);
+
+                if (pending.back().back() != LocalPath::localPathSeparator)
+                {
+                    pending.back().push_back(LocalPath::localPathSeparator);
+                }
+
+                pending.back().append(d->d_name);
+            }
+
+            closedir(dp);
+        }
+    }
+}
+
+void PosixFileSystemAccess::fanotifydeldirs(FanotifyFilesystem& fs, const string& path)
+{
+    string prefix = path;
+
+    if (prefix.back() != LocalPath::localPathSeparator)
+    {
+        prefix.push_back(LocalPath::localPathSeparator);
+    }
+
+    auto it = fs.dirhandles.find(path);
+
+    if (it != fs.dirhandles.end())
+    {
+        fs.dirpaths.erase(it->second);
+        fs.dirhandles.erase(it);
+    }
+
+    // the paths below it sort together, from path + "/"
+    for (it = fs.dirhandles.lower_bound(prefix);
+         it != fs.dirhandles.end() && !it->first.compare(0, prefix.size(), prefix); )
+    {
+        fs.dirpaths.erase(it->second);
+        it = fs.dirhandles.erase(it);
+    }
+}
+
+// read all pending fanotify events, keep those below a sync root and queue them for processing
+int PosixFileSystemAccess::fanotifyevents()
+{
+    int r = 0;
+    alignas(fanotify_event_metadata) char buf[16384];
+    ssize_t l;
+
+    while ((l = read(fanotifyfd, buf, sizeof buf)) > 0)
+    {
+        for (auto m = (fanotify_event_metadata*)buf; FAN_EVENT_OK(m, l); m = FAN_EVENT_NEXT(m, l))
+        {
+            if (m->vers != FANOTIFY_METADATA_VERSION)
+            {
+                LOG_err << "Unexpected fanotify metadata version: " << (int)m->vers;
+                notifyerr = true;
+                return r;
+            }
+
+            if (m->mask & FAN_Q_OVERFLOW)
+            {
+                notifyerr = true;
+                continue;
+            }
+
+            auto fid = (fanotify_event_info_fid*)(m + 1);
+
+            if (m->event_len < m->metadata_len + sizeof(*fid) + sizeof(file_handle)
+             || fid->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME)
+            {
+                continue;
+            }
+
+            auto fsit = fanotifyfilesystems.find(pair<int, int>(fid->fsid.val[0], fid->fsid.val[1]));
+
+            if (fsit == fanotifyfilesystems.end())
+            {
+                continue;
+            }
 
-        pw->bumpmaxfd(notifyfd);
-    }
-}
+            auto& fs = fsit->second;
+            auto fh = (file_handle*)fid->handle;
+            const char* name = (const char*)(fh->f_handle + fh->handle_bytes);
 
-// read all pending inotify events and queue them for processing
-int PosixFileSystemAccess::checkevents(Waiter* w)
-{
-    int r = 0;
-    if (notifyfd < 0)
-    {
-        return r;
-    }
-#ifdef ENABLE_SYNC
-#ifdef USE_INOTIFY
-    PosixWaiter* pw = (PosixWaiter*)w;
-    string *ignore;
+            auto pit = fs.dirpaths.find(string((const char*)fh, sizeof(file_handle) + fh->handle_bytes));
 
-    if (MEGA_FD_ISSET(notifyfd, &pw->rfds))
-    {
-        char buf[sizeof(struct inotify_event) + NAME_MAX + 1];
-        ssize_t p, l;
-        inotify_event* in;
-        wdlocalnode_map::iterator it;
-        string localpath;
+            if (pit == fs.dirpaths.end())
+            {
+                // not below any root
+                continue;
+            }
 
-        while ((l = read(notifyfd, buf, sizeof buf)) > 0)
-        {
-            for (p = 0; p < l; p += offsetof(inotify_event, name) + in->len)
+            string dirpath = pit->second;
+
+            if ((m->mask & FAN_ONDIR) && strcmp(name, "."))
             {
-                in = (inotify_event*)(buf + p);
+                string path = dirpath;
 
-                if (in->mask & (IN_Q_OVERFLOW | IN_UNMOUNT))
+                if (path.back() != LocalPath::localPathSeparator)
                 {
-                    notifyerr = true;
+                    path.push_back(LocalPath::localPathSeparator);
                 }
 
-// this flag was introduced in glibc 2.13 and Linux 2.6.36 (released October 20, 2010)
-#ifndef IN_EXCL_UNLINK
-#define IN_EXCL_UNLINK 0x04000000
-#endif
-                if (in->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM
-                              | IN_MOVED_TO | IN_CLOSE_WRITE | IN_EXCL_UNLINK))
-                {
-                    //if ((in->mask & (IN_CREATE | IN_ISDIR)) != IN_CREATE) //certain operations (e.g: QFile::copy, Qt 5.11) might produce IN_CREATE with no further IN_CLOSE_WRITE
-                    {
-                        it = wdnodes.find(in->wd);
-
-                        if (it != wdnodes.end())
-                        {
-                            if (lastcookie && lastcookie != in->cookie)
-                            {
-                                ignore = &lastlocalnode->sync->dirnotify->ignore.localpath;
-                                if (lastname.size() < ignore->size()
-                                 || memcmp(lastname.c_str(), ignore->data(), ignore->size())
-                                 || (lastname.size() > ignore->size()
-                                  && lastname[ignore->size()] != LocalPath::localPathSeparator))
-                                {
-                                    // previous IN_MOVED_FROM is not followed by the
-                                    // corresponding IN_MOVED_TO, so was actually a deletion
-                                    LOG_debug << "Filesystem notification (deletion). Root: " << lastlocalnode->name << "   Path: " << lastname;
-                                    lastlocalnode->sync->dirnotify->notify(DirNotify::DIREVENTS,
-                                                                           lastlocalnode,
-                                                                           LocalPath::fromPlatformEncodedRelative(lastname),
-                                                                           false,
-                                                                           false);
+                path.append(name);
 
-                                    r |= Waiter::NEEDEXEC;
-                                }
-                            }
+                if (m->mask & (FAN_MOVED_FROM | FAN_DELETE))
+                {
+                    fanotifydeldirs(fs, path);
+                }
 
-                            if (in->mask & IN_MOVED_FROM)
-                            {
-                                // could be followed by the corresponding IN_MOVE_TO or not..
-                                // retain in case it's not (in which case it's a deletion)
-                                lastcookie = in->cookie;
-                                lastlocalnode = it->second;
-                                lastname = in->name;
-                            }
-                            else
-                            {
-                                lastcookie = 0;
+                if (m->mask & (FAN_MOVED_TO | FAN_CREATE))
+                {
+                    fanotifyadddirs(fs, path);
+                }
+            }
 
-                                ignore = &it->second->sync->dirnotify->ignore.localpath;
-                                size_t insize = strlen(in->name);
+            for (auto& root : fs.roots)
+            {
+                if (dirpath.size() < root.path.size()
+                 || memcmp(dirpath.data(), root.path.data(), root.path.size())
+                 || (dirpath.size() > root.path.size() && dirpath[root.path.size()] != LocalPath::localPathSeparator))
+                {
+                    continue;
+                }
 
-                                if (insize < ignore->size()
-                                 || memcmp(in->name, ignore->data(), ignore->size())
-                                 || (insize > ignore->size()
-                                  && in->name[ignore->size()] != LocalPath::localPathSeparator))
-                                {
-                                    LOG_debug << "Filesystem notification. Root: " << it->second->name << "   Path: " << in->name;
-                                    it->second->sync->dirnotify->notify(DirNotify::DIREVENTS,
-                                                                        it->second,
-                                                                        LocalPath::fromPlatformEncodedRelative(std::string(in->name, insize)),
-                                                                        false,
-                                                                        false);
+                string relative = dirpath.substr(std::min(dirpath.size(), root.path.size() + 1));
 
-                                    r |= Waiter::NEEDEXEC;
-                                }
-                            }
-                        }
+                if (strcmp(name, "."))
+                {
+                    if (!relative.empty())
+                    {
+                        relative.push_back(LocalPath::localPathSeparator);
                     }
+
+                    relative.append(name);
                 }
-            }
-        }
 
-        // this assumes that corresponding IN_MOVED_FROM / IN_MOVED_FROM pairs are never notified separately
-        if (lastcookie)
-        {
-            ignore = &lastlocalnode->sync->dirnotify->ignore.localpath;
+                auto localPath = LocalPath::fromPlatformEncodedRelative(relative);
 
-            if (lastname.size() < ignore->size()
-             || memcmp(lastname.c_str(), ignore->data(), ignore->size())
-             || (lastname.size() > ignore->size()
-              && lastname[ignore->size()] != LocalPath::localPathSeparator))
-            {
-                LOG_debug << "Filesystem notification. Root: " << lastlocalnode->name << "   Path: " << lastname;
-                lastlocalnode->sync->dirnotify->notify(DirNotify::DIREVENTS,
-                                                       lastlocalnode,
-                                                       LocalPath::fromPlatformEncodedRelative(lastname),
-                                                       false,
-                                                       false);
+                // is this notification coming from the debris directory?
+                if (!localPath.empty() && root.dirnotify->ignore.isContainingPathOf(localPath))
+                {
+                    continue;
+                }
+
+                LOG_debug << "Filesystem notification. Root: " << root.root->name << "   Path: " << relative;
+                root.dirnotify->notify(DirNotify::DIREVENTS, root.root, std::move(localPath), false, false);
 
                 r |= Waiter::NEEDEXEC;
             }
-
-            lastcookie = 0;
         }
     }
-#endif
-#endif
+
     return r;
 }
 
+#endif // ENABLE_SYNC && USE_FANOTIFY
+
 // no legacy DOS garbage here...
 bool PosixFileSystemAccess::getsname(const LocalPath&, LocalPath&) const
 {
@@ -1000,6 +1820,80 @@ bool PosixFileSystemAccess::copylocal(const LocalPath& oldname, const LocalPath&
     return !t;
 }
 
+bool PosixFileSystemAccess::cloneFile(const LocalPath& source, const LocalPath& target, m_time_t mtime)
+{
+#if defined(__APPLE__) || (defined(__linux__) && !defined(__ANDROID__))
+#ifdef USE_IOS
+    const string sourcestr = adjustBasePath(source);
+    const string targetstr = adjustBasePath(target);
+#else
+    const string& sourcestr = adjustBasePath(source);
+    const string& targetstr = adjustBasePath(target);
+#endif
+
+    bool cloned = false;
+
+#ifdef __APPLE__
+    // APFS: clonefile() won't replace an existing target
+    unlink(targetstr.c_str());
+    if (!clonefile(sourcestr.c_str(), targetstr.c_str(), CLONE_NOFOLLOW))
+    {
+        LOG_verbose << "Copying via clonefile";
+        cloned = true;
+    }
+#else
+    int sfd = open(sourcestr.c_str(), O_RDONLY);
+    if (sfd >= 0)
+    {
+        mode_t mode = umask(0);
+        int tfd = open(targetstr.c_str(), O_WRONLY | O_CREAT | O_TRUNC, defaultfilepermissions);
+        umask(mode);
+
+        if (tfd >= 0)
+        {
+#ifdef FICLONE
+            // btrfs, xfs: the target shares the extents of the source
+            if (!ioctl(tfd, FICLONE, sfd))
+            {
+                LOG_verbose << "Copying via FICLONE";
+                cloned = true;
+            }
+#endif
+#ifdef __NR_copy_file_range
+            if (!cloned)
+            {
+                // copied inside the kernel, or on the server by NFS and CIFS
+                ssize_t t;
+                while ((t = syscall(__NR_copy_file_range, sfd, nullptr, tfd, nullptr, size_t(1) << 30, 0u)) > 0);
+                if (!t)
+                {
+                    LOG_verbose << "Copying via copy_file_range";
+                    cloned = true;
+                }
+            }
+#endif
+            close(tfd);
+        }
+
+        close(sfd);
+    }
+#endif
+
+    if (cloned)
+    {
+#ifdef ENABLE_SYNC
+        return setmtimelocal(target, mtime);
+#else
+        // fails in setmtimelocal are allowed in non sync clients.
+        setmtimelocal(target, mtime);
+        return true;
+#endif
+    }
+#endif
+
+    return copylocal(source, target, mtime);
+}
+
 bool PosixFileSystemAccess::unlinklocal(const LocalPath& name)
 {
     if (!unlink(adjustBasePath(name).c_str()))
@@ -1582,8 +2476,25 @@ PosixDirNotify::PosixDirNotify(const LocalPath& localbasepath, const LocalPath&
     fsaccess = NULL;
 }
 
+PosixDirNotify::~PosixDirNotify()
+{
+#ifdef USE_FANOTIFY
+    if (fanotify)
+    {
+        fsaccess->fanotifyremove(this);
+    }
+#endif
+}
+
 void PosixDirNotify::addnotify(LocalNode* l, const LocalPath& path)
 {
+#ifdef USE_FANOTIFY
+    if (fanotify)
+    {
+        return;
+    }
+#endif
+
 #ifdef USE_INOTIFY
     int wd;
 
@@ -1605,6 +2516,13 @@ void PosixDirNotify::addnotify(LocalNode* l, const LocalPath& path)
 
 void PosixDirNotify::delnotify(LocalNode* l)
 {
+#ifdef USE_FANOTIFY
+    if (fanotify)
+    {
+        return;
+    }
+#endif
+
 #ifdef USE_INOTIFY
     if (fsaccess->wdnodes.erase((int)(long)l->dirnotifytag))
     {
@@ -1619,16 +2537,40 @@ void PosixDirNotify::delnotify(LocalNode* l)
 #define O_NOATIME 0x0
 #endif // !O_NOATIME
 
+// true for entries that readdir() already reports as neither file, folder nor symlink
+static bool skipDirentType(const dirent* d)
+{
+#ifdef DT_UNKNOWN
+    switch (d->d_type)
+    {
+        case DT_FIFO:
+        case DT_CHR:
+        case DT_BLK:
+        case DT_SOCK:
+            return true;
+        default:
+            return false;
+    }
+#else
+    return false;
+#endif
+}
+
 // Used by directoryScan(...) below to avoid extra stat(...) calls.
 class UnixStreamAccess
     : public InputStreamAccess
 {
 public:
-    UnixStreamAccess(const char* path, m_off_t size)
-      : mDescriptor(open(path, O_NOATIME | O_RDONLY))
+    UnixStreamAccess(int directory, const char* name, m_off_t size)
+      : mDescriptor(openat(directory, name, O_NOATIME | O_RDONLY | O_CLOEXEC))
       , mOffset(0)
       , mSize(size)
     {
+        // O_NOATIME is refused for files we don't own
+        if (mDescriptor < 0 && errno == EPERM && O_NOATIME)
+        {
+            mDescriptor = openat(directory, name, O_RDONLY | O_CLOEXEC);
+        }
     }
 
     MEGA_DISABLE_COPY_MOVE(UnixStreamAccess);
@@ -1685,11 +2627,13 @@ ScanResult PosixFileSystemAccess::directoryScan(const LocalPath& targetPath,
 
     // Whether we can reuse an existing fingerprint.
     // I.e. Can we avoid computing the CRC?
+    // (A known ctime must match too: it catches rewrites that restore the mtime.)
     auto reuse = [](const FSNode& lhs, const FSNode& rhs) {
         return lhs.type == rhs.type
                && lhs.fsid == rhs.fsid
                && lhs.fingerprint.mtime == rhs.fingerprint.mtime
-               && lhs.fingerprint.size == rhs.fingerprint.size;
+               && lhs.fingerprint.size == rhs.fingerprint.size
+               && (!lhs.ctime || !rhs.ctime || lhs.ctime == rhs.ctime);
     };
 
     // So we don't duplicate link chasing logic.
@@ -1702,6 +2646,36 @@ ScanResult PosixFileSystemAccess::directoryScan(const LocalPath& targetPath,
         return !::stat(path, &metadata);
     };
 
+    // Children are looked up relative to the open directory and, where
+    // statx(...) is available, only for the attributes we record.
+    auto statChild = [&](int directory, const char* name, struct stat& metadata) {
+#if defined(__linux__) && defined(STATX_TYPE)
+        auto statChildAt = [&](int flags) {
+            struct statx sx;
+
+            if (statx(directory, name, flags, STATX_TYPE | STATX_MODE | STATX_MTIME | STATX_CTIME | STATX_SIZE, &sx))
+                return false;
+
+            metadata.st_mode = sx.stx_mode;
+            metadata.st_size = static_cast<off_t>(sx.stx_size);
+            metadata.st_mtime = sx.stx_mtime.tv_sec;
+            metadata.st_ctime = sx.stx_ctime.tv_sec;
+
+            return true;
+        };
+#else
+        auto statChildAt = [&](int flags) {
+            return !fstatat(directory, name, &metadata, flags);
+        };
+#endif
+        auto result = statChildAt(AT_SYMLINK_NOFOLLOW);
+
+        if (!result || !followSymLinks || !S_ISLNK(metadata.st_mode))
+            return result;
+
+        return statChildAt(0);
+    };
+
     // Where we store file information.
     struct stat metadata;
 
@@ -1753,6 +2727,7 @@ ScanResult PosixFileSystemAccess::directoryScan(const LocalPath& targetPath,
 
     // Iterate over the directory's children.
     auto entry = readdir(directory);
+    auto descriptor = dirfd(directory);
     auto path = targetPath;
 
     for ( ; entry; entry = readdir(directory))
@@ -1775,8 +2750,15 @@ ScanResult PosixFileSystemAccess::directoryScan(const LocalPath& targetPath,
 
         path.appendWithSeparator(result.localname, false);
 
+        // Special files are reported without asking for their attributes.
+        if (skipDirentType(entry))
+        {
+            result.type = TYPE_SPECIAL;
+            continue;
+        }
+
         // Try and get information about this entry.
-        if (!stat(path.localpath.c_str(), metadata))
+        if (!statChild(descriptor, entry->d_name, metadata))
         {
             LOG_warn << "directoryScan: "
                      << "Unable to stat(...) file: "
@@ -1791,6 +2773,7 @@ ScanResult PosixFileSystemAccess::directoryScan(const LocalPath& targetPath,
 
         result.fingerprint.mtime = metadata.st_mtime;
         captimestamp(&result.fingerprint.mtime);
+        result.ctime = metadata.st_ctime;
 
         // Are we dealing with a directory?
         if (S_ISDIR(metadata.st_mode))
@@ -1855,7 +2838,8 @@ ScanResult PosixFileSystemAccess::directoryScan(const LocalPath& targetPath,
         }
 
         // Try and open the file for reading.
-        UnixStreamAccess isAccess(path.localpath.c_str(),
+        UnixStreamAccess isAccess(descriptor,
+                                  entry->d_name,
                                   result.fingerprint.size);
 
         // Only fingerprint the file if we could actually open it.
@@ -1923,7 +2907,24 @@ bool PosixFileSystemAccess::initFilesystemNotificationSystem()
     notifyfailed = notifyfd < 0;
 #endif // USE_INOTIFY
 
+#ifdef USE_FANOTIFY
+    // filesystem-wide marks require CAP_SYS_ADMIN: without it, syncs keep using inotify
+    fanotifyfd = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME | FAN_NONBLOCK | FAN_CLOEXEC,
+                               O_RDONLY | O_LARGEFILE);
+
+    if (fanotifyfd < 0)
+    {
+        LOG_debug << "fanotify not available, using inotify. Error code: " << errno;
+    }
+    else
+    {
+        notifyfailed = false;
+    }
+
+    return notifyfd >= 0 || fanotifyfd >= 0;
+#else
     return notifyfd >= 0;
+#endif
 }
 
 #endif // ENABLE_SYNC
@@ -1967,6 +2968,22 @@ DirNotify* PosixFileSystemAccess::newdirnotify(const LocalPath& localpath, const
 
     dirnotify->fsaccess = this;
 
+#ifdef USE_FANOTIFY
+    dirnotify->fanotify = fanotifyadd(dirnotify, syncroot, localpath);
+
+    if (dirnotify->fanotify)
+    {
+        dirnotify->setFailed(0, "");
+    }
+#ifdef USE_INOTIFY
+    else if (notifyfd < 0)
+    {
+        // fanotify was enough to start, but this root falls back to inotify, which isn't there
+        dirnotify->setFailed(ENOSYS, "Filesystem notifications are unavailable for this root");
+    }
+#endif
+#endif
+
     return dirnotify;
 }
 #endif
@@ -2138,26 +3155,25 @@ bool PosixDirAccess::dnext(LocalPath& path, LocalPath& name, bool followsymlinks
     dirent* d;
     struct stat &statbuf = currentItemStat;
 
+    // entries are looked up relative to the open directory, rather than
+    // resolving their full path component by component each time
+    int dfd = dirfd(dp);
+
     while ((d = readdir(dp)))
     {
-        ScopedLengthRestore restore(path);
-
         if (*d->d_name != '.' || (d->d_name[1] && (d->d_name[1] != '.' || d->d_name[2])))
         {
-            path.appendWithSeparator(LocalPath::fromPlatformEncodedRelative(d->d_name), true);
-
-#ifdef USE_IOS
-            const string pathStr = adjustBasePath(path);
-#else
-            // use the existing string if it's not iOS, no need for a copy
-            const string& pathStr = adjustBasePath(path);
-#endif
+            // only files and folders are returned: no need to stat anything else
+            if (skipDirentType(d))
+            {
+                continue;
+            }
 
-            bool statOk = !lstat(pathStr.c_str(), &statbuf);
+            bool statOk = !fstatat(dfd, d->d_name, &statbuf, AT_SYMLINK_NOFOLLOW);
             if (followsymlinks && statOk && S_ISLNK(statbuf.st_mode))
             {
                 currentItemFollowedSymlink = true;
-                statOk = !stat(pathStr.c_str(), &statbuf);
+                statOk = !fstatat(dfd, d->d_name, &statbuf, 0);
             }
             else
             {
@@ -2239,5 +3255,23 @@ m_off_t PosixFileSystemAccess::availableDiskSpace(const LocalPath& drivePath)
     return (m_off_t)availableBytes;
 }
 
+#ifdef HAVE_LIBURING
+void PosixFileSystemAccess::asyncwritesbegin()
+{
+    if (PosixIoUring* ring = PosixIoUring::instance())
+    {
+        ring->hold();
+    }
+}
+
+void PosixFileSystemAccess::asyncwritesend()
+{
+    if (PosixIoUring* ring = PosixIoUring::instance())
+    {
+        ring->release();
+    }
+}
+#endif
+
 } // namespace
 
@@ -25,6 +25,7 @@
 
 #if defined(USE_OPENSSL)
 #include <openssl/err.h>
+#include <openssl/sha.h>
 #endif
 
 #if defined(__ANDROID__) && ARES_VERSION >= 0x010F00
@@ -35,6 +36,7 @@ extern JavaVM *MEGAjvm;
 #define IPV6_RETRY_INTERVAL_DS 72000
 #define DNS_CACHE_TIMEOUT_DS 18000
 #define DNS_CACHE_EXPIRES 0
+#define DNS_PREFETCH_MIN_TTL_DS 300
 #define MAX_SPEED_CONTROL_TIMEOUT_MS 500
 
 namespace mega {
@@ -152,6 +154,23 @@ SockInfo::~SockInfo()
 #endif
 
 std::mutex CurlHttpIO::curlMutex;
+CURLSH* CurlHttpIO::curlsh = nullptr;
+std::mutex CurlHttpIO::curlshMutexes[CURL_LOCK_DATA_LAST];
+
+void CurlHttpIO::curlsh_lock(CURL*, curl_lock_data data, curl_lock_access, void*)
+{
+    curlshMutexes[data].lock();
+}
+
+void CurlHttpIO::curlsh_unlock(CURL*, curl_lock_data data, void*)
+{
+    curlshMutexes[data].unlock();
+}
+
+#ifdef USE_OPENSSL
+std::set<string> CurlHttpIO::pinnedkeys;
+std::mutex CurlHttpIO::pinnedkeysMutex;
+#endif
 
 #if defined(USE_OPENSSL) && !defined(OPENSSL_IS_BORINGSSL)
 
@@ -262,8 +281,6 @@ CurlHttpIO::CurlHttpIO()
     reset = false;
     statechange = false;
     disconnecting = false;
-    maxspeed[GET] = 0;
-    maxspeed[PUT] = 0;
     pkpErrors = 0;
 
     WAIT_CLASS::bumpds();
@@ -316,6 +333,12 @@ CurlHttpIO::CurlHttpIO()
         initialize_android();
 #endif
 #endif
+
+        curlsh = curl_share_init();
+        curl_share_setopt(curlsh, CURLSHOPT_LOCKFUNC, curlsh_lock);
+        curl_share_setopt(curlsh, CURLSHOPT_UNLOCKFUNC, curlsh_unlock);
+        curl_share_setopt(curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
     };
 
     curlMutex.unlock();
@@ -366,9 +389,10 @@ CurlHttpIO::CurlHttpIO()
     curltimeoutreset[PUT] = -1;
     arerequestspaused[PUT] = false;
 
-    curlsh = curl_share_init();
-    curl_share_setopt(curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
-    curl_share_setopt(curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#ifdef USE_EPOLL
+    curlsocketswatched[API] = curlsocketswatched[GET] = curlsocketswatched[PUT] = false;
+#endif
+    applymultiplexing();
 
     contenttypejson = curl_slist_append(NULL, "Content-Type: application/json");
     contenttypejson = curl_slist_append(contenttypejson, "Expect:");
@@ -510,9 +534,7 @@ void CurlHttpIO::filterDNSservers()
 
 void CurlHttpIO::addaresevents(Waiter *waiter)
 {
-#ifdef MEGA_MEASURE_CODE
     CodeCounter::ScopeTimer ccst(countAddAresEventsCode);
-#endif
 
     SockInfoMap prevAressockets;   // if there are SockInfo records that were in use, and won't be anymore, they will be deleted with this
     prevAressockets.swap(aressockets);
@@ -588,11 +610,41 @@ void CurlHttpIO::addaresevents(Waiter *waiter)
 
 #endif // #ifdef MEGA_USE_C_ARES
 
+#ifdef USE_EPOLL
+void CurlHttpIO::watchcurlsockets(direction_t d, bool watch)
+{
+    for (auto& socket : curlsockets[d])
+    {
+        SockInfo &info = socket.second;
+        if (!info.mode)
+        {
+            continue;
+        }
+
+        if (watch)
+        {
+            waiter->watchfd(info.fd, info.mode & SockInfo::READ, info.mode & SockInfo::WRITE);
+        }
+        else
+        {
+            waiter->unwatchfd(info.fd);
+        }
+    }
+    curlsocketswatched[d] = watch;
+}
+#endif
+
 void CurlHttpIO::addcurlevents(Waiter *waiter, direction_t d)
 {
-#ifdef MEGA_MEASURE_CODE
     CodeCounter::ScopeTimer ccst(countAddCurlEventsCode);
-#endif
+
+#ifdef USE_EPOLL
+    // registrations persist in the waiter and follow socket_callback; only a resume after a pause re-adds them
+    if (!curlsocketswatched[d])
+    {
+        watchcurlsockets(d, true);
+    }
+#else
 
 #if defined(_WIN32)
     bool anyWriters = false;
@@ -634,6 +686,7 @@ void CurlHttpIO::addcurlevents(Waiter *waiter, direction_t d)
         static_cast<WinWaiter*>(waiter)->maxds = 0;
     }
 #endif
+#endif // USE_EPOLL
 }
 
 int CurlHttpIO::checkevents(Waiter*)
@@ -667,6 +720,12 @@ void CurlHttpIO::closearesevents()
 void CurlHttpIO::closecurlevents(direction_t d)
 {
     SockInfoMap &socketmap = curlsockets[d];
+#ifdef USE_EPOLL
+    if (curlsocketswatched[d])
+    {
+        watchcurlsockets(d, false);
+    }
+#endif
 #if defined(_WIN32)
     for (SockInfoMap::iterator it = socketmap.begin(); it != socketmap.end(); it++)
     {
@@ -679,9 +738,7 @@ void CurlHttpIO::closecurlevents(direction_t d)
 #ifdef MEGA_USE_C_ARES
 void CurlHttpIO::processaresevents()
 {
-#ifdef MEGA_MEASURE_CODE
     CodeCounter::ScopeTimer ccst(countProcessAresEventsCode);
-#endif
 
 #ifndef _WIN32
     auto *rfds = &((PosixWaiter *)waiter)->rfds;
@@ -722,9 +779,7 @@ void CurlHttpIO::processaresevents()
 
 void CurlHttpIO::processcurlevents(direction_t d)
 {
-#ifdef MEGA_MEASURE_CODE
     CodeCounter::ScopeTimer ccst(countProcessCurlEventsCode);
-#endif
 
 #ifdef WIN32
     mSocketsWaitEvent_curl_call_needed = false;
@@ -795,7 +850,6 @@ CurlHttpIO::~CurlHttpIO()
     curl_multi_cleanup(curlm[API]);
     curl_multi_cleanup(curlm[GET]);
     curl_multi_cleanup(curlm[PUT]);
-    curl_share_cleanup(curlsh);
 
 #ifdef MEGA_USE_C_ARES
     closearesevents();
@@ -811,6 +865,9 @@ CurlHttpIO::~CurlHttpIO()
     curlMutex.lock();
     if (--instanceCount == 0)
     {
+        curl_share_cleanup(curlsh);
+        curlsh = nullptr;
+
 #ifdef MEGA_USE_C_ARES
         ares_library_cleanup();
 #endif
@@ -927,6 +984,13 @@ void CurlHttpIO::disconnect()
     curltimeoutreset[PUT] = -1;
     arerequestspaused[PUT] = false;
 
+#ifdef USE_EPOLL
+    curlsocketswatched[API] = curlsocketswatched[GET] = curlsocketswatched[PUT] = false;
+#endif
+    // the new handles start from libcurl's defaults
+    multiplexingset = false;
+    applymultiplexing();
+
     disconnecting = false;
 #ifdef MEGA_USE_C_ARES
     if (dnsservers.size())
@@ -947,26 +1011,79 @@ void CurlHttpIO::disconnect()
     }
 }
 
+// limits are shared with the other instances, see BandwidthScheduler
 bool CurlHttpIO::setmaxdownloadspeed(m_off_t bpslimit)
 {
-    maxspeed[GET] = bpslimit;
+    BandwidthScheduler::instance().setlimit(GET, bpslimit);
+    return true;
+}
+
+bool CurlHttpIO::setmultiplexing(bool enable)
+{
+#if LIBCURL_VERSION_NUM >= 0x072f00 // At least cURL 7.47.0
+    if (enable && !(curl_version_info(CURLVERSION_NOW)->features & CURL_VERSION_HTTP2))
+    {
+        LOG_warn << "HTTP/2 multiplexing requested, but libcurl was built without HTTP/2 support";
+        return false;
+    }
+
+    multiplexing = enable;
+    applymultiplexing();
     return true;
+#else
+    return !enable;
+#endif
+}
+
+void CurlHttpIO::applymultiplexing()
+{
+#if LIBCURL_VERSION_NUM >= 0x072f00 // At least cURL 7.47.0
+    // while off, the handles keep libcurl's own defaults: since 7.62.0 it multiplexes
+    // HTTP/2 connections by itself, and CURLPIPE_NOTHING would turn that off
+    if (!multiplexing && !multiplexingset)
+    {
+        return;
+    }
+
+    for (int d = API; d <= PUT; d++)
+    {
+        if (multiplexing)
+        {
+            curl_multi_setopt(curlm[d], CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        #if LIBCURL_VERSION_NUM >= 0x074300 // At least cURL 7.67.0
+            curl_multi_setopt(curlm[d], CURLMOPT_MAX_CONCURRENT_STREAMS, MULTIPLEX_MAX_STREAMS);
+        #endif
+        }
+        else
+        {
+        #if LIBCURL_VERSION_NUM >= 0x073e00 // At least cURL 7.62.0
+            curl_multi_setopt(curlm[d], CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        #else
+            curl_multi_setopt(curlm[d], CURLMOPT_PIPELINING, CURLPIPE_NOTHING);
+        #endif
+        #if LIBCURL_VERSION_NUM >= 0x074300 // At least cURL 7.67.0
+            curl_multi_setopt(curlm[d], CURLMOPT_MAX_CONCURRENT_STREAMS, 100L);
+        #endif
+        }
+    }
+    multiplexingset = multiplexing;
+#endif
 }
 
 bool CurlHttpIO::setmaxuploadspeed(m_off_t bpslimit)
 {
-    maxspeed[PUT] = bpslimit;
+    BandwidthScheduler::instance().setlimit(PUT, bpslimit);
     return true;
 }
 
 m_off_t CurlHttpIO::getmaxdownloadspeed()
 {
-    return maxspeed[GET];
+    return BandwidthScheduler::instance().getlimit(GET);
 }
 
 m_off_t CurlHttpIO::getmaxuploadspeed()
 {
-    return maxspeed[PUT];
+    return BandwidthScheduler::instance().getlimit(PUT);
 }
 
 bool CurlHttpIO::cacheresolvedurls(const std::vector<string>& urls, std::vector<string>&& ips)
@@ -993,18 +1110,64 @@ bool CurlHttpIO::cacheresolvedurls(const std::vector<string>& urls, std::vector<
         dnsEntry.ipv4timestamp = Waiter::ds;
         dnsEntry.ipv6 = move(ips[2 * i + 1]);
         dnsEntry.ipv6timestamp = Waiter::ds;
+        dnsEntry.ipv4ttl = dnsEntry.ipv6ttl = 0;
         dnsEntry.mNeedsResolvingAgain = false;
+        dnsEntry.mPrefetched = false;
     }
 
     return true;
 }
 
+void CurlHttpIO::prefetchdns(const std::vector<string>& urls)
+{
+#if defined(MEGA_USE_C_ARES) && ARES_VERSION >= 0x011000
+    if (proxyurl.size())
+    {
+        // names are resolved by the proxy
+        return;
+    }
+
+    for (const string& url : urls)
+    {
+        string host, dummyscheme;
+        int dummyport;
+
+        if (!crackurl(&url, &dummyscheme, &host, &dummyport))
+        {
+            continue;
+        }
+
+        auto it = dnscache.find(host);
+        if (it != dnscache.end() && !it->second.mNeedsResolvingAgain
+                && it->second.ipv4.size() && !it->second.isIPv4Expired()
+                && (!ipv6requestsenabled || (it->second.ipv6.size() && !it->second.isIPv6Expired())))
+        {
+            continue;
+        }
+
+        if (!dnsprefetches.insert(host).second)
+        {
+            continue;
+        }
+
+        NET_debug << "Prefetching the addresses of " << host;
+
+        struct ares_addrinfo_hints hints;
+        memset(&hints, 0, sizeof hints);
+        hints.ai_family = ipv6requestsenabled ? AF_UNSPEC : AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+
+        ares_getaddrinfo(ares, host.c_str(), nullptr, &hints, ares_prefetch_callback, new std::pair<CurlHttpIO*, string>(this, host));
+    }
+#else
+    (void)urls;
+#endif
+}
+
 // wake up from cURL I/O
 void CurlHttpIO::addevents(Waiter* w, int)
 {
-#ifdef MEGA_MEASURE_CODE
     CodeCounter::ScopeTimer ccst(countCurlHttpIOAddevents);
-#endif
 
     waiter = (WAIT_CLASS*)w;
     long curltimeoutms = -1;
@@ -1038,6 +1201,13 @@ void CurlHttpIO::addevents(Waiter* w, int)
     {
         if (arerequestspaused[d])
         {
+#ifdef USE_EPOLL
+            // stop waking up for sockets we won't read while paused
+            if (curlsocketswatched[d])
+            {
+                watchcurlsockets((direction_t)d, false);
+            }
+#endif
             if (curltimeoutms < 0 || curltimeoutms > 100)
             {
                 curltimeoutms = 100;
@@ -1427,6 +1597,65 @@ void CurlHttpIO::ares_completed_callback(void* arg, int status, int, struct host
         LOG_debug << "Waiting for the completion of the c-ares request";
     }
 }
+
+#if ARES_VERSION >= 0x011000
+void CurlHttpIO::ares_prefetch_callback(void* arg, int status, int, struct ares_addrinfo* result)
+{
+    std::unique_ptr<std::pair<CurlHttpIO*, string>> prefetch(static_cast<std::pair<CurlHttpIO*, string>*>(arg));
+    CurlHttpIO* httpio = prefetch->first;
+    const string& hostname = prefetch->second;
+
+    // also reached with ARES_EDESTRUCTION from reset or the destructor, with httpio still valid
+    httpio->dnsprefetches.erase(hostname);
+
+    if (status != ARES_SUCCESS || !result)
+    {
+        NET_debug << "Unable to prefetch the addresses of " << hostname << ". code: " << status;
+        if (result)
+        {
+            ares_freeaddrinfo(result);
+        }
+        return;
+    }
+
+    CurlDNSEntry& dnsEntry = httpio->dnscache[hostname];
+    bool ipv4 = false, ipv6 = false;
+
+    for (struct ares_addrinfo_node* node = result->nodes; node; node = node->ai_next)
+    {
+        char ip[INET6_ADDRSTRLEN];
+
+        // short TTLs would be gone before the transfer gets to use them
+        dstime ttl = std::max<dstime>(dstime(node->ai_ttl) * 10, DNS_PREFETCH_MIN_TTL_DS);
+
+        if (node->ai_family == AF_INET6 && !ipv6)
+        {
+            mega_inet_ntop(AF_INET6, &((struct sockaddr_in6*)node->ai_addr)->sin6_addr, ip, sizeof ip);
+            dnsEntry.ipv6 = ip;
+            dnsEntry.ipv6timestamp = Waiter::ds;
+            dnsEntry.ipv6ttl = ttl;
+            ipv6 = true;
+        }
+        else if (node->ai_family == AF_INET && !ipv4)
+        {
+            mega_inet_ntop(AF_INET, &((struct sockaddr_in*)node->ai_addr)->sin_addr, ip, sizeof ip);
+            dnsEntry.ipv4 = ip;
+            dnsEntry.ipv4timestamp = Waiter::ds;
+            dnsEntry.ipv4ttl = ttl;
+            ipv4 = true;
+        }
+    }
+
+    if (ipv4 || ipv6)
+    {
+        NET_debug << "Prefetched " << hostname << ": " << dnsEntry.ipv4 << " " << dnsEntry.ipv6;
+        dnsEntry.mNeedsResolvingAgain = false;
+        dnsEntry.mPrefetched = true;
+    }
+
+    ares_freeaddrinfo(result);
+}
+#endif
 #endif
 
 struct curl_slist* CurlHttpIO::clone_curl_slist(struct curl_slist* inlist)
@@ -1488,6 +1717,17 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
     {
         NET_debug << "Using the hostname instead of the IP";
     }
+    else if (httpctx->hostip.size() && httpctx->raceipv4.size())
+    {
+        // keep the hostname in the URL, resolved to both addresses. The entry goes into the
+        // DNS cache shared by all handles: "+" lets it expire like a resolved one, instead of
+        // overriding the addresses of the host for good
+        NET_debug << "Racing the IPs of the hostname: " << httpctx->hostip << " " << httpctx->raceipv4;
+        std::ostringstream oss;
+        oss << "+" << httpctx->hostname << ":" << httpctx->port << ":" << httpctx->hostip << "," << httpctx->raceipv4;
+        curl_slist_free_all(httpctx->resolve);
+        httpctx->resolve = curl_slist_append(NULL, oss.str().c_str());
+    }
     else if(httpctx->hostip.size())
     {
         NET_debug << "Using the IP of the hostname: " << httpctx->hostip;
@@ -1500,6 +1740,7 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
         req->status = REQ_FAILURE;
         req->httpiohandle = NULL;
         curl_slist_free_all(httpctx->headers);
+        curl_slist_free_all(httpctx->resolve);
 
         httpctx->req = NULL;
         if (!httpctx->ares_pending)
@@ -1540,7 +1781,13 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
         curl_easy_setopt(curl, CURLOPT_SEEKDATA, (void*)req);
         curl_easy_setopt(curl, CURLOPT_USERAGENT, httpio->useragent.c_str());
         curl_easy_setopt(curl, CURLOPT_HTTPHEADER, httpctx->headers);
-        curl_easy_setopt(curl, CURLOPT_ENCODING, "");
+        if (req->type == REQ_JSON)
+        {
+            // API and sc responses are compressible JSON: take any encoding cURL can decode
+            // on the fly, so only the decoded bytes reach write_data (and any incremental parser).
+            // Transfer data is encrypted, compressing it would only cost time.
+            curl_easy_setopt(curl, CURLOPT_ENCODING, "");
+        }
         curl_easy_setopt(curl, CURLOPT_SHARE, httpio->curlsh);
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data);
         curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*)req);
@@ -1557,10 +1804,36 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
         curl_easy_setopt(curl, CURLOPT_SOCKOPTDATA, (void*)req);
         curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
 
+    #if LIBCURL_VERSION_NUM >= 0x074b00 // At least cURL 7.75.0
+        if (httpctx->resolve)
+        {
+            curl_easy_setopt(curl, CURLOPT_RESOLVE, httpctx->resolve);
+            curl_easy_setopt(curl, CURLOPT_HAPPY_EYEBALLS_TIMEOUT_MS, HAPPY_EYEBALLS_DELAY_MS);
+        }
+    #endif
+
+    #if LIBCURL_VERSION_NUM >= 0x074100 // At least cURL 7.65.0
+        if (httpctx->d != API)
+        {
+            curl_easy_setopt(curl, CURLOPT_MAXAGE_CONN, WARMCONNECTION_MAXAGE_S);
+        }
+    #endif
+
+    #if LIBCURL_VERSION_NUM >= 0x072f00 // At least cURL 7.47.0
+        if (httpio->multiplexing)
+        {
+            // negotiate HTTP/2 over TLS (plain http stays on 1.1), and prefer waiting for a
+            // connection being set up to the same host over opening a parallel one
+            curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+            curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+        }
+    #endif
+
         // Some networks (eg vodafone UK) seem to block TLS 1.3 ClientHello.  1.2 is secure, and works:
         curl_easy_setopt(curl, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2 | CURL_SSLVERSION_MAX_TLSv1_2);
 
-        if (httpio->maxspeed[GET] && httpio->maxspeed[GET] <= 102400)
+        m_off_t maxdownloadspeed = BandwidthScheduler::instance().getlimit(GET);
+        if (maxdownloadspeed && maxdownloadspeed <= 102400)
         {
             curl_easy_setopt(curl, CURLOPT_BUFFERSIZE, 4096L);
         }
@@ -1666,6 +1939,7 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
         req->status = REQ_FAILURE;
         req->httpiohandle = NULL;
         curl_slist_free_all(httpctx->headers);
+        curl_slist_free_all(httpctx->resolve);
 
         httpctx->req = NULL;
 
@@ -1877,6 +2151,7 @@ void CurlHttpIO::post(HttpReq* req, const char* data, unsigned len)
     httpctx->len = len;
     httpctx->data = data;
     httpctx->headers = NULL;
+    httpctx->resolve = NULL;
     httpctx->isIPv6 = false;
     httpctx->isCachedIp = false;
 #ifdef MEGA_USE_C_ARES
@@ -2006,6 +2281,12 @@ void CurlHttpIO::post(HttpReq* req, const char* data, unsigned len)
     if (it != dnscache.end())
     {
         dnsEntry = &it->second;
+
+        if (dnsEntry->mPrefetched)
+        {
+            dnsEntry->mPrefetched = false;
+            dnsprefetchhits++;
+        }
     }
 
     if (ipv6requestsenabled)
@@ -2020,6 +2301,14 @@ void CurlHttpIO::post(HttpReq* req, const char* data, unsigned len)
             httpctx->hostip = oss.str();
 #ifdef MEGA_USE_C_ARES
             httpctx->ares_pending = 0;
+
+#if LIBCURL_VERSION_NUM >= 0x074b00 // At least cURL 7.75.0
+            if (req->method != METHOD_NONE && dnsEntry->ipv4.size() && !dnsEntry->isIPv4Expired())
+            {
+                // let cURL race both instead of trying IPv4 only after IPv6 failed
+                httpctx->raceipv4 = dnsEntry->ipv4;
+            }
+#endif
 #endif
             send_request(httpctx);
             return;
@@ -2113,6 +2402,7 @@ void CurlHttpIO::cancel(HttpReq* req)
             curl_multi_remove_handle(curlm[httpctx->d], httpctx->curl);
             curl_easy_cleanup(httpctx->curl);
             curl_slist_free_all(httpctx->headers);
+            curl_slist_free_all(httpctx->resolve);
         }
 
         httpctx->req = NULL;
@@ -2170,7 +2460,7 @@ bool CurlHttpIO::doio()
 
     for (int d = GET; d == GET || d == PUT; d += PUT - GET)
     {
-        partialdata[d] = 0;
+        BandwidthScheduler::instance().refill((direction_t)d, Waiter::ds);
         if (arerequestspaused[d])
         {
             arerequestspaused[d] = false;
@@ -2199,6 +2489,92 @@ bool CurlHttpIO::doio()
     return result;
 }
 
+void CurlHttpIO::recordconnection(CURL* curl, direction_t d, HttpReq* req)
+{
+    long newConnections = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &newConnections) != CURLE_OK)
+    {
+        return;
+    }
+
+    ConnectionStats& stats = connectionStats[d];
+
+    double startTransferTime = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &startTransferTime) == CURLE_OK
+            && startTransferTime > 0)
+    {
+        stats.firstByte++;
+        stats.firstByteMs += uint64_t(startTransferTime * 1000);
+        req->timings.firstByte = unsigned(startTransferTime * 1000);
+    }
+
+    if (!newConnections)
+    {
+        stats.warm++;
+        return;
+    }
+
+    // each time includes the previous ones; appconnect covers TLS on top of connect, and stays 0 for plain http
+    double nameLookupTime = 0, connectTime = 0, appConnectTime = 0;
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME, &nameLookupTime);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME, &connectTime);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME, &appConnectTime);
+
+    stats.cold++;
+    stats.coldSetupMs += uint64_t(std::max(connectTime, appConnectTime) * 1000);
+
+    req->timings.newConnection = true;
+    req->timings.dns = unsigned(nameLookupTime * 1000);
+    req->timings.connect = unsigned(std::max(connectTime - nameLookupTime, 0.0) * 1000);
+    req->timings.tls = unsigned(std::max(appConnectTime - connectTime, 0.0) * 1000);
+}
+
+std::string CurlHttpIO::connectionStatsReport(bool reset)
+{
+    std::ostringstream s;
+    static const char* names[] = { "GET", "PUT" };
+    for (int d = GET; d <= PUT; d++)
+    {
+        ConnectionStats& stats = connectionStats[d];
+        s << " " << names[d] << " connections warm/cold: " << stats.warm << "/" << stats.cold
+          << " cold setup avg: " << (stats.cold ? stats.coldSetupMs / stats.cold : 0) << " ms"
+          << " first byte avg: " << (stats.firstByte ? stats.firstByteMs / stats.firstByte : 0) << " ms\n";
+        if (reset)
+        {
+            stats = ConnectionStats();
+        }
+    }
+    s << " DNS prefetch hits: " << dnsprefetchhits << "\n";
+    s << " compressed API responses: " << encodedresponses
+      << " bytes received/decoded: " << encodedbytes << "/" << decodedbytes << "\n";
+    if (reset)
+    {
+        dnsprefetchhits = 0;
+        encodedresponses = 0;
+        encodedbytes = 0;
+        decodedbytes = 0;
+    }
+    return s.str();
+}
+
+void CurlHttpIO::recordencodedresponse(CURL* easy_handle, HttpReq* req)
+{
+    // cURL counts the body as received, before decoding it
+#if LIBCURL_VERSION_NUM >= 0x073700 // 7.55.0
+    curl_off_t received = 0;
+    curl_easy_getinfo(easy_handle, CURLINFO_SIZE_DOWNLOAD_T, &received);
+#else
+    double received = 0;
+    curl_easy_getinfo(easy_handle, CURLINFO_SIZE_DOWNLOAD, &received);
+#endif
+
+    encodedresponses++;
+    encodedbytes += uint64_t(received);
+    decodedbytes += uint64_t(req->bufpos);
+
+    LOG_debug << req->logname << "Compressed response: " << uint64_t(received) << " bytes for " << req->bufpos;
+}
+
 bool CurlHttpIO::multidoio(CURLM *curlmhandle)
 {
     int dummy = 0;
@@ -2210,6 +2586,7 @@ bool CurlHttpIO::multidoio(CURLM *curlmhandle)
         HttpReq* req = NULL;
         if (curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&req) == CURLE_OK && req)
         {
+            HttpIO* owner = req->httpio;    // this one, or a decorator of it
             req->httpio = NULL;
 
             if (msg->msg == CURLMSG_DONE)
@@ -2281,6 +2658,14 @@ bool CurlHttpIO::multidoio(CURLM *curlmhandle)
                 curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &httpstatus);
                 req->httpstatus = int(httpstatus);
 
+                if (CurlHttpContext* httpctx = (CurlHttpContext*)req->httpiohandle)
+                {
+                    if (httpctx->d == GET || httpctx->d == PUT)
+                    {
+                        recordconnection(msg->easy_handle, httpctx->d, req);
+                    }
+                }
+
                 LOG_debug << req->logname << "CURLMSG_DONE with HTTP status: " << req->httpstatus << " from "
                           << (req->httpiohandle ? (((CurlHttpContext*)req->httpiohandle)->hostname + " - " + ((CurlHttpContext*)req->httpiohandle)->hostip) : "(unknown) ");
                 if (req->httpstatus)
@@ -2338,7 +2723,7 @@ bool CurlHttpIO::multidoio(CURLM *curlmhandle)
                 req->status = ((req->httpstatus == 200 || (req->mExpectRedirect && req->isRedirection() && req->mRedirectURL.size()))
                                && errorCode != CURLE_PARTIAL_FILE
                                && (req->contentlength < 0
-                                   || req->contentlength == (req->buf ? req->bufpos : (int)req->in.size())))
+                                   || req->contentlength == (req->buf || req->incremental ? req->bufpos : (int)req->in.size())))
                         ? REQ_SUCCESS : REQ_FAILURE;
 
                 if (req->status == REQ_SUCCESS)
@@ -2346,6 +2731,11 @@ bool CurlHttpIO::multidoio(CURLM *curlmhandle)
                     dnsok = true;
                     lastdata = Waiter::ds;
                     req->lastdata = Waiter::ds;
+
+                    if (req->contentencoded)
+                    {
+                        recordencodedresponse(msg->easy_handle, req);
+                    }
                 }
                 else
                 {
@@ -2414,10 +2804,13 @@ bool CurlHttpIO::multidoio(CURLM *curlmhandle)
                             curl_multi_remove_handle(curlmhandle, msg->easy_handle);
                             curl_easy_cleanup(msg->easy_handle);
                             curl_slist_free_all(httpctx->headers);
+                            curl_slist_free_all(httpctx->resolve);
                             httpctx->isCachedIp = false;
                             httpctx->headers = NULL;
+                            httpctx->resolve = NULL;
+                            httpctx->raceipv4.clear();
                             httpctx->curl = NULL;
-                            req->httpio = this;
+                            req->httpio = owner;
                             req->in.clear();
                             req->status = REQ_INFLIGHT;
 
@@ -2458,6 +2851,7 @@ bool CurlHttpIO::multidoio(CURLM *curlmhandle)
                 pausedrequests[httpctx->d].erase(httpctx->curl);
 
                 curl_slist_free_all(httpctx->headers);
+                curl_slist_free_all(httpctx->resolve);
                 req->httpiohandle = NULL;
 
                 httpctx->req = NULL;
@@ -2525,7 +2919,7 @@ size_t CurlHttpIO::read_data(void* ptr, size_t size, size_t nmemb, void* source)
     HttpReq *req = (HttpReq*)source;
     CurlHttpContext* httpctx = (CurlHttpContext*)req->httpiohandle;
     size_t len = size * nmemb;
-    CurlHttpIO* httpio = (CurlHttpIO*)req->httpio;
+    CurlHttpIO* httpio = httpctx->httpio;   // req->httpio may be a decorator (see EmulatedNetworkHttpIO)
 
     if (httpctx->data)
     {
@@ -2552,24 +2946,14 @@ size_t CurlHttpIO::read_data(void* ptr, size_t size, size_t nmemb, void* source)
 
     req->lastdata = Waiter::ds;
 
-    if (httpio->maxspeed[PUT])
+    if (req->type != REQ_JSON)
     {
-        bool isApi = (req->type == REQ_JSON);
-        if (!isApi)
+        nread = BandwidthScheduler::instance().acquire(PUT, req, req->bandwidthcategory, nread, true, Waiter::ds);
+        if (!nread)
         {
-            long maxbytes = long( (httpio->maxspeed[PUT] - httpio->uploadSpeed) * (SpeedController::SPEED_MEAN_MAX_INTERVAL_DS / 10) - httpio->partialdata[PUT] );
-            if (maxbytes <= 0)
-            {
-                httpio->pausedrequests[PUT].insert(httpctx->curl);
-                httpio->arerequestspaused[PUT] = true;
-                return CURL_READFUNC_PAUSE;
-            }
-
-            if (nread > (size_t)maxbytes)
-            {
-                nread = maxbytes;
-            }
-            httpio->partialdata[PUT] += nread;
+            httpio->pausedrequests[PUT].insert(httpctx->curl);
+            httpio->arerequestspaused[PUT] = true;
+            return CURL_READFUNC_PAUSE;
         }
     }
 
@@ -2583,24 +2967,23 @@ size_t CurlHttpIO::write_data(void* ptr, size_t size, size_t nmemb, void* target
 {
     int len = int(size * nmemb);
     HttpReq *req = (HttpReq*)target;
-    CurlHttpIO* httpio = (CurlHttpIO*)req->httpio;
+    CurlHttpContext* httpctx = (CurlHttpContext*)req->httpiohandle;
+    CurlHttpIO* httpio = (req->httpio && httpctx) ? httpctx->httpio : nullptr;
     if (httpio)
     {
-        if (httpio->maxspeed[GET])
+        if (BandwidthScheduler::instance().getlimit(GET))
         {
-            CurlHttpContext* httpctx = (CurlHttpContext*)req->httpiohandle;
             bool isUpload = httpctx->data ? httpctx->len : req->out->size();
             bool isApi = (req->type == REQ_JSON);
             if (!isApi && !isUpload)
             {
-                if ((httpio->downloadSpeed + 10 * (httpio->partialdata[GET] + len) / SpeedController::SPEED_MEAN_MAX_INTERVAL_DS) > httpio->maxspeed[GET])
+                // the callback can't take part of the data, so it is all or nothing
+                if (!BandwidthScheduler::instance().acquire(GET, req, req->bandwidthcategory, size_t(len), false, Waiter::ds))
                 {
-                    CurlHttpContext* httpctx = (CurlHttpContext*)req->httpiohandle;
                     httpio->pausedrequests[GET].insert(httpctx->curl);
                     httpio->arerequestspaused[GET] = true;
                     return CURL_WRITEFUNC_PAUSE;
                 }
-                httpio->partialdata[GET] += len;
             }
         }
 
@@ -2641,7 +3024,8 @@ size_t CurlHttpIO::check_header(void* ptr, size_t size, size_t nmemb, void* targ
     }
     else if (len > 15 && !memcmp(ptr, "Content-Length:", 15))
     {
-        if (req->contentlength < 0)
+        // the length of an encoded body can't be checked against what we receive
+        if (req->contentlength < 0 && !req->contentencoded)
         {
             req->setcontentlength(atoll((char*)ptr + 15));
         }
@@ -2649,6 +3033,19 @@ size_t CurlHttpIO::check_header(void* ptr, size_t size, size_t nmemb, void* targ
     else if (len > 24 && !memcmp(ptr, "Original-Content-Length:", 24))
     {
         req->setcontentlength(atoll((char*)ptr + 24));
+        req->decodedlength = true;
+    }
+    else if (len > 17 && !memcmp(ptr, "Content-Encoding:", 17))
+    {
+        string encoding((char*)ptr + 17, len - 17);
+        if (encoding.find("identity") == string::npos)
+        {
+            req->contentencoded = true;
+            if (!req->decodedlength)
+            {
+                req->contentlength = -1;
+            }
+        }
     }
     else if (len > 17 && !memcmp(ptr, "X-MEGA-Time-Left:", 17))
     {
@@ -2729,6 +3126,12 @@ int CurlHttpIO::socket_callback(CURL *, curl_socket_t s, int what, void *userp,
 
 #if defined(_WIN32)
             it->second.closeEvent();
+#endif
+#ifdef USE_EPOLL
+            if (httpio->curlsocketswatched[d])
+            {
+                httpio->waiter->unwatchfd(s);
+            }
 #endif
             it->second.mode = 0;
         }
@@ -2762,6 +3165,12 @@ int CurlHttpIO::socket_callback(CURL *, curl_socket_t s, int what, void *userp,
         {
             info.signalledWrite = true;
         }
+#endif
+#ifdef USE_EPOLL
+        if (httpio->curlsocketswatched[d])
+        {
+            httpio->waiter->watchfd(s, what & CURL_POLL_IN, what & CURL_POLL_OUT);
+        }
 #endif
     }
 
@@ -2775,8 +3184,8 @@ int CurlHttpIO::sockopt_callback(void *clientp, curl_socket_t, curlsocktype)
 {
 #ifdef MEGA_USE_C_ARES
     HttpReq *req = (HttpReq*)clientp;
-    CurlHttpIO* httpio = (CurlHttpIO*)req->httpio;
     CurlHttpContext* httpctx = (CurlHttpContext*)req->httpiohandle;
+    CurlHttpIO* httpio = (req->httpio && httpctx) ? httpctx->httpio : nullptr;
     if (httpio && !httpio->disconnecting
             && httpctx && httpctx->isCachedIp && !httpctx->ares_pending && httpio->dnscache[httpctx->hostname].mNeedsResolvingAgain)
     {
@@ -2919,8 +3328,35 @@ int CurlHttpIO::cert_verify_callback(X509_STORE_CTX* ctx, void* req)
         return 1;
     }
 
-    if (EVP_PKEY_id(evp) == EVP_PKEY_RSA
-            && (evp = X509_PUBKEY_get(X509_get_X509_PUBKEY(X509_STORE_CTX_get0_cert(ctx)))))
+    // which pins apply to the URL of the connection
+    char pinset = !memcmp(request->posturl.data(), httpio->APIURL.data(), httpio->APIURL.size()) ? 'a'
+                : !memcmp(request->posturl.data(), MegaClient::SFUSTATSURL.data(), MegaClient::SFUSTATSURL.size()) ? 's'
+                : 0;
+
+    // a key that passed already, for any client in the process, needn't be examined again
+    string spkihash;
+    X509_PUBKEY* spki = X509_get_X509_PUBKEY(X509_STORE_CTX_get0_cert(ctx));
+    int spkilen = spki ? i2d_X509_PUBKEY(spki, nullptr) : 0;
+    if (pinset && spkilen > 0)
+    {
+        std::vector<unsigned char> der(static_cast<size_t>(spkilen));
+        unsigned char* derend = der.data();
+        i2d_X509_PUBKEY(spki, &derend);
+
+        spkihash.resize(SHA256_DIGEST_LENGTH + 1);
+        SHA256(der.data(), der.size(), reinterpret_cast<unsigned char*>(&spkihash[0]));
+        spkihash[SHA256_DIGEST_LENGTH] = pinset;
+
+        std::lock_guard<std::mutex> g(pinnedkeysMutex);
+        if (pinnedkeys.count(spkihash))
+        {
+            LOG_debug << "SSL public key OK (already verified)";
+            return 1;
+        }
+    }
+
+    if ((evp = X509_PUBKEY_get(spki))
+            && EVP_PKEY_id(evp) == EVP_PKEY_RSA)
     {
         if (BN_num_bytes(RSA_get0_n(EVP_PKEY_get0_RSA(evp))) == sizeof APISSLMODULUS1 - 1
                 && BN_num_bytes(RSA_get0_e(EVP_PKEY_get0_RSA(evp))) == sizeof APISSLEXPONENT - 1)
@@ -2928,9 +3364,9 @@ int CurlHttpIO::cert_verify_callback(X509_STORE_CTX* ctx, void* req)
             BN_bn2bin(RSA_get0_n(EVP_PKEY_get0_RSA(evp)), buf);
 
             // check the public key matches for the URL of the connection (API or SFU-stats)
-            if ((!memcmp(request->posturl.data(), httpio->APIURL.data(), httpio->APIURL.size())
+            if ((pinset == 'a'
                     && (!memcmp(buf, APISSLMODULUS1, sizeof APISSLMODULUS1 - 1) || !memcmp(buf, APISSLMODULUS2, sizeof APISSLMODULUS2 - 1)))
-                ||(!memcmp(request->posturl.data(), MegaClient::SFUSTATSURL.data(), MegaClient::SFUSTATSURL.size())
+                ||(pinset == 's'
                     && (!memcmp(buf, SFUSTATSSSLMODULUS, sizeof SFUSTATSSSLMODULUS - 1) || !memcmp(buf, SFUSTATSSSLMODULUS2, sizeof SFUSTATSSSLMODULUS2 - 1)))
                 )
             {
@@ -2940,6 +3376,12 @@ int CurlHttpIO::cert_verify_callback(X509_STORE_CTX* ctx, void* req)
                 {
                     LOG_debug << "SSL public key OK";
                     ok = 1;
+
+                    if (!spkihash.empty())
+                    {
+                        std::lock_guard<std::mutex> g(pinnedkeysMutex);
+                        pinnedkeys.insert(spkihash);
+                    }
                 }
             }
             else
@@ -2952,13 +3394,17 @@ int CurlHttpIO::cert_verify_callback(X509_STORE_CTX* ctx, void* req)
             LOG_warn << "Public key size mismatch " << BN_num_bytes(RSA_get0_n(EVP_PKEY_get0_RSA(evp))) << " " << BN_num_bytes(RSA_get0_e(EVP_PKEY_get0_RSA(evp)));
         }
 
-        EVP_PKEY_free(evp);
     }
     else
     {
         LOG_warn << "Public key not found";
     }
 
+    if (evp)
+    {
+        EVP_PKEY_free(evp);
+    }
+
     if (!ok)
     {
         httpio->pkpErrors++;
@@ -2992,12 +3438,14 @@ CurlDNSEntry::CurlDNSEntry()
 
 bool CurlDNSEntry::isIPv4Expired()
 {
-    return (DNS_CACHE_EXPIRES && (Waiter::ds - ipv4timestamp) >= DNS_CACHE_TIMEOUT_DS);
+    return (DNS_CACHE_EXPIRES && (Waiter::ds - ipv4timestamp) >= DNS_CACHE_TIMEOUT_DS)
+            || (ipv4ttl && (Waiter::ds - ipv4timestamp) >= ipv4ttl);
 }
 
 bool CurlDNSEntry::isIPv6Expired()
 {
-    return (DNS_CACHE_EXPIRES && (Waiter::ds - ipv6timestamp) >= DNS_CACHE_TIMEOUT_DS);
+    return (DNS_CACHE_EXPIRES && (Waiter::ds - ipv6timestamp) >= DNS_CACHE_TIMEOUT_DS)
+            || (ipv6ttl && (Waiter::ds - ipv6timestamp) >= ipv6ttl);
 }
 
 #ifdef MEGA_USE_C_ARES
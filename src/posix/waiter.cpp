@@ -26,31 +26,172 @@
     #include <poll.h> //poll
 #endif
 
+#ifdef USE_EPOLL
+    #include <climits>
+#endif
+
+#ifdef __linux__
+    #include <sys/eventfd.h>
+#endif
+
 namespace mega {
 dstime Waiter::ds;
 
 PosixWaiter::PosixWaiter()
 {
-    // pipe to be able to leave the select() call
-    if (pipe(m_pipe) < 0)
+#ifdef __linux__
+    mEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mEventFd < 0)
     {
-        LOG_fatal << "Error creating pipe";
-        throw std::runtime_error("Error creating pipe");
+        LOG_warn << "Unable to create eventfd: " << errno << ". Using a pipe";
     }
+#endif
 
-    if (fcntl(m_pipe[0], F_SETFL, O_NONBLOCK) < 0)
+    // pipe to be able to leave the select() call
+    if (mEventFd < 0)
     {
-        LOG_err << "fcntl error";
+        if (pipe(m_pipe) < 0)
+        {
+            LOG_fatal << "Error creating pipe";
+            throw std::runtime_error("Error creating pipe");
+        }
+
+        if (fcntl(m_pipe[0], F_SETFL, O_NONBLOCK) < 0)
+        {
+            LOG_err << "fcntl error";
+        }
     }
 
     maxfd = -1;
+
+#ifdef USE_EPOLL
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (mEpollFd < 0)
+    {
+        LOG_fatal << "Error creating epoll instance";
+        throw std::runtime_error("Error creating epoll instance");
+    }
+
+    watchfd(wakeupfd(), true, false);
+#endif
 }
 
 PosixWaiter::~PosixWaiter()
 {
-    close(m_pipe[0]);
-    close(m_pipe[1]);
+    if (mEventFd >= 0)
+    {
+        close(mEventFd);
+    }
+    else
+    {
+        close(m_pipe[0]);
+        close(m_pipe[1]);
+    }
+
+#ifdef USE_EPOLL
+    close(mEpollFd);
+#endif
+}
+
+#ifdef USE_EPOLL
+void PosixWaiter::watchfd(int fd, bool read, bool write)
+{
+    uint32_t events = (read ? uint32_t(EPOLLIN) : 0) | (write ? uint32_t(EPOLLOUT) : 0);
+    if (!events)
+    {
+        return unwatchfd(fd);
+    }
+
+    mWatched[fd] = events;
+    mPending.insert(fd);
+}
+
+void PosixWaiter::unwatchfd(int fd)
+{
+    mWatched.erase(fd);
+
+    // the fd is usually about to be closed, and its number may be reused by the next socket.
+    // drop the registration now so that a later watchfd() for the same number adds it again.
+    auto r = mRegistered.find(fd);
+    if (r != mRegistered.end())
+    {
+        // may fail if the fd was already closed, which removed it from the set anyway
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+        mRegistered.erase(r);
+    }
+
+    mPending.insert(fd);
+}
+
+// bring the epoll set in line with the persistent and per-wait events wanted for fd.
+// force re-applies registrations that may have been dropped by the kernel when an fd was closed and reused.
+void PosixWaiter::applyepoll(int fd, bool force)
+{
+    uint32_t events = 0;
+
+    auto w = mWatched.find(fd);
+    if (w != mWatched.end())
+    {
+        events |= w->second;
+    }
+
+    auto t = mTransient.find(fd);
+    if (t != mTransient.end())
+    {
+        events |= t->second;
+    }
+
+    auto r = mRegistered.find(fd);
+    if (!events)
+    {
+        if (r != mRegistered.end())
+        {
+            // may fail if the fd was already closed, which removed it from the set anyway
+            epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+            mRegistered.erase(r);
+        }
+        return;
+    }
+
+    if (r != mRegistered.end() && r->second == events && !force)
+    {
+        return;
+    }
+
+    epoll_event ev;
+    memset(&ev, 0, sizeof ev);
+    ev.events = events;
+    ev.data.fd = fd;
+
+    int result;
+    if (r != mRegistered.end())
+    {
+        result = epoll_ctl(mEpollFd, EPOLL_CTL_MOD, fd, &ev);
+        if (result < 0 && errno == ENOENT)
+        {
+            result = epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev);
+        }
+    }
+    else
+    {
+        result = epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev);
+        if (result < 0 && errno == EEXIST)
+        {
+            result = epoll_ctl(mEpollFd, EPOLL_CTL_MOD, fd, &ev);
+        }
+    }
+
+    if (result < 0)
+    {
+        LOG_warn << "Unable to register fd " << fd << " for polling: " << errno;
+        mRegistered.erase(fd);
+    }
+    else
+    {
+        mRegistered[fd] = events;
+    }
 }
+#endif
 
 void PosixWaiter::init(dstime ds)
 {
@@ -101,12 +242,78 @@ bool PosixWaiter::fd_filter(int nfds, mega_fd_set_t* fds, mega_fd_set_t* ignoref
 int PosixWaiter::wait()
 {
     int numfd = 0;
+
+#ifdef USE_EPOLL
+    // the per-wait fds replace the previous ones; only those and changed persistent registrations are touched
+    std::map<int, uint32_t> transient;
+    for (auto fd : rfds)
+    {
+        transient[fd] |= EPOLLIN;
+    }
+    for (auto fd : wfds)
+    {
+        transient[fd] |= EPOLLOUT;
+    }
+    for (auto fd : efds)
+    {
+        transient[fd] |= EPOLLPRI;
+    }
+    transient.swap(mTransient);
+
+    for (auto& previous : transient)
+    {
+        if (!mTransient.count(previous.first))
+        {
+            mPending.insert(previous.first);
+        }
+    }
+    for (auto fd : mPending)
+    {
+        applyepoll(fd, false);
+    }
+    mPending.clear();
+    for (auto& current : mTransient)
+    {
+        applyepoll(current.first, true);
+    }
+
+    int timeoutms = -1;
+    if (maxds + 1)
+    {
+        timeoutms = maxds > dstime(INT_MAX / 100) ? INT_MAX : int(maxds * 100);
+    }
+
+    mEvents.resize(std::max<size_t>(16, mRegistered.size()));
+    numfd = epoll_wait(mEpollFd, mEvents.data(), int(mEvents.size()), timeoutms);
+
+    // report readiness through the fd sets, as select() would
+    MEGA_FD_ZERO(&rfds);
+    MEGA_FD_ZERO(&wfds);
+    MEGA_FD_ZERO(&efds);
+    for (int i = 0; i < numfd; i++)
+    {
+        int fd = mEvents[i].data.fd;
+        uint32_t ev = mEvents[i].events;
+        if (ev & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        {
+            MEGA_FD_SET(fd, &rfds);
+        }
+        if (ev & (EPOLLOUT | EPOLLERR))
+        {
+            MEGA_FD_SET(fd, &wfds);
+        }
+        if (ev & EPOLLPRI)
+        {
+            MEGA_FD_SET(fd, &efds);
+        }
+    }
+#else
     timeval tv;
 
     //Pipe added to rfds to be able to leave select() when needed
-    MEGA_FD_SET(m_pipe[0], &rfds);
+    MEGA_FD_SET(wakeupfd(), &rfds);
 
-    bumpmaxfd(m_pipe[0]);
+    bumpmaxfd(wakeupfd());
 
     if (maxds + 1)
     {
@@ -147,19 +354,26 @@ int PosixWaiter::wait()
     numfd = poll(fds, total,  ms);
 #else
     numfd = select(maxfd + 1, &rfds, &wfds, &efds, maxds + 1 ? &tv : NULL);
+#endif
 #endif
 
-    // empty pipe
-    uint8_t buf;
-    bool external = false;
+    // cleared before emptying the fd: a notify() seeing it set has written, or will write, to the fd,
+    // so that write is either read now or leaves the next wait() at once
+    mNotified = false;
 
+    bool external = false;
+    if (mEventFd >= 0)
+    {
+        uint64_t count;
+        external = read(mEventFd, &count, sizeof count) == sizeof count;
+    }
+    else
     {
-        std::lock_guard<std::mutex> g(mMutex);
+        uint8_t buf;
         while (read(m_pipe[0], &buf, sizeof buf) > 0)
         {
             external = true;
         }
-        alreadyNotified = false;
     }
 
     // timeout or error
@@ -169,7 +383,16 @@ int PosixWaiter::wait()
     }
 
     // request exec() to be run only if a non-ignored fd was triggered
-#ifdef USE_POLL
+#if defined(USE_EPOLL)
+    for (int i = 0; i < numfd; i++)
+    {
+        if (!MEGA_FD_ISSET(mEvents[i].data.fd, &ignorefds))
+        {
+            return NEEDEXEC;
+        }
+    }
+    return 0;
+#elif defined(USE_POLL)
     for (unsigned int i = 0 ; i < total ; i++)
     {
         if  ((fds[i].revents & (POLLIN_SET | POLLOUT_SET | POLLEX_SET) )  && !MEGA_FD_ISSET(fds[i].fd, &ignorefds) )
@@ -188,11 +411,21 @@ int PosixWaiter::wait()
 
 void PosixWaiter::notify()
 {
-    std::lock_guard<std::mutex> g(mMutex);
-    if (!alreadyNotified)
+    // only the first notification of a wait cycle makes a syscall
+    if (mNotified.exchange(true))
+    {
+        return;
+    }
+
+    mSignalled++;
+    if (mEventFd >= 0)
+    {
+        uint64_t one = 1;
+        write(mEventFd, &one, sizeof one);
+    }
+    else
     {
         write(m_pipe[1], "0", 1);
-        alreadyNotified = true;
     }
 }
 } // namespace
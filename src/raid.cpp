@@ -27,6 +27,14 @@
 
 #undef min //avoids issues with std::min
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MEGA_RAID_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MEGA_RAID_NEON 1
+#endif
+
 namespace mega
 {
 
@@ -114,7 +122,7 @@ RaidBufferManager::FilePiece::FilePiece()
 
 RaidBufferManager::FilePiece::FilePiece(m_off_t p, size_t len)
     : pos(p)
-    , buf(new byte[len + std::min<size_t>(SymmCipher::BLOCKSIZE, RAIDSECTOR)], 0, len)   // SymmCipher::ctr_crypt requirement: decryption: data must be padded to BLOCKSIZE.  Also make sure we can xor up to RAIDSECTOR more for convenience
+    , buf(TransferBufferPool::allocate(len + std::min<size_t>(SymmCipher::BLOCKSIZE, RAIDSECTOR)), 0, len)   // SymmCipher::ctr_crypt requirement: decryption: data must be padded to BLOCKSIZE.  Also make sure we can xor up to RAIDSECTOR more for convenience
 {
 }
 
@@ -458,9 +466,23 @@ void RaidBufferManager::combineRaidParts(unsigned connectionNum)
 
     assert(!partslen || !processToEnd || sumdatalen - partslen * (RAIDPARTS - 1) <= RAIDLINE);
 
+    m_off_t macchunkpos = calcOutputChunkPos(newdatafilepos + partslen * (RAIDPARTS - 1));
+
+    if (!processToEnd && partslen > 0)
+    {
+        // Only combine the raid lines needed to reach the mac chunk boundary.  That way at most one
+        // partial raid line is held over in leftoverchunk, instead of copying up to a whole chunk out
+        // and then back into the next output piece. The rest stays in the input parts for next time.
+        // If the front pieces don't reach a boundary at all, combine them anyway so the input keeps moving.
+        if (macchunkpos > newdatafilepos)
+        {
+            size_t neededlines = size_t((macchunkpos - newdatafilepos + RAIDLINE - 1) / RAIDLINE);
+            partslen = std::min<size_t>(partslen, neededlines * RAIDSECTOR);
+        }
+    }
+
     if (partslen > 0 || processToEnd)
     {
-        m_off_t macchunkpos = calcOutputChunkPos(newdatafilepos + partslen * (RAIDPARTS - 1));
 
         size_t buflen = static_cast<size_t>(processToEnd ? sumdatalen : partslen * (RAIDPARTS - 1));
         FilePiece* outputrec = combineRaidParts(partslen, buflen, outputfilepos, leftoverchunk);  // includes a bit of extra space for non-full sectors if we are at the end of the file
@@ -542,50 +564,86 @@ RaidBufferManager::FilePiece* RaidBufferManager::combineRaidParts(size_t partsle
             inputbufs[i] = inputPiece->buf.isNull() ? NULL : inputPiece->buf.datastart();
         }
 
-        byte* b = result->buf.datastart() + prevleftoverchunk.buf.datalen();
-        byte* endpos = b + partslen * (RAIDPARTS-1);
+        byte* linestart = result->buf.datastart() + prevleftoverchunk.buf.datalen();
+        size_t lines = partslen / RAIDSECTOR;
+        unsigned missingPart = 0;
+        assert(linestart + lines * RAIDLINE <= result->buf.datastart() + result->buf.datalen());
 
-        for (unsigned i = 0; b < endpos; i += RAIDSECTOR)
+        // de-interleave one part (column) at a time, so each input is read sequentially
+        // and the null test is done once per part rather than once per sector
+        for (unsigned j = 1; j < RAIDPARTS; ++j)
         {
-            for (unsigned j = 1; j < RAIDPARTS; ++j)
+            if (!inputbufs[j])
             {
-                assert(b + RAIDSECTOR <= result->buf.datastart() + result->buf.datalen());
-                if (inputbufs[j])
-                {
-                    memcpy(b, inputbufs[j] + i, RAIDSECTOR);
-                }
-                else
-                {
-                    recoverSectorFromParity(b, inputbufs, i);
-                }
-                b += RAIDSECTOR;
+                missingPart = j;
+                continue;
+            }
+
+            const byte* src = inputbufs[j];
+            byte* dst = linestart + (j - 1) * RAIDSECTOR;
+            for (size_t l = lines; l--; src += RAIDSECTOR, dst += RAIDLINE)
+            {
+                memcpy(dst, src, RAIDSECTOR);
             }
         }
-        assert(b == endpos);
+
+        if (missingPart)
+        {
+            // rebuild the whole column of the missing part in one pass
+            recoverSectorsFromParity(linestart + (missingPart - 1) * RAIDSECTOR, RAIDLINE, inputbufs, 0, partslen / RAIDSECTOR);
+        }
     }
     return result;
 }
 
-void RaidBufferManager::recoverSectorFromParity(byte* dest, byte* inputbufs[], unsigned offset)
+void RaidBufferManager::recoverSectorsFromParity(byte* dest, size_t destStride, byte* const inputbufs[], size_t offset, size_t count)
 {
-    assert(sizeof(m_off_t)*2 == RAIDSECTOR);
-    bool set = false;
+    static_assert(RAIDSECTOR == 16, "the xor kernels work on 16 byte sectors");
+
+    // gather the present inputs once instead of testing each one for every sector
+    const byte* srcs[RAIDPARTS];
+    unsigned n = 0;
     for (unsigned i = RAIDPARTS; i--; )
     {
         if (inputbufs[i])
         {
-            if (!set)
-            {
-                memcpy(dest, inputbufs[i] + offset, RAIDSECTOR);
-                set = true;
-            }
-            else
-            {
-                *(m_off_t*)dest ^= *(m_off_t*)(inputbufs[i] + offset);
-                *(m_off_t*)(dest + sizeof(m_off_t)) ^= *(m_off_t*)(inputbufs[i] + offset + sizeof(m_off_t));
-            }
+            srcs[n++] = inputbufs[i] + offset;
         }
     }
+    assert(n > 0);
+    if (!n)
+    {
+        return;
+    }
+
+    for (size_t o = 0; o < count * RAIDSECTOR; o += RAIDSECTOR, dest += destStride)
+    {
+#if defined(MEGA_RAID_SSE2)
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcs[0] + o));
+        for (unsigned k = 1; k < n; ++k)
+        {
+            x = _mm_xor_si128(x, _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcs[k] + o)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), x);
+#elif defined(MEGA_RAID_NEON)
+        uint8x16_t x = vld1q_u8(srcs[0] + o);
+        for (unsigned k = 1; k < n; ++k)
+        {
+            x = veorq_u8(x, vld1q_u8(srcs[k] + o));
+        }
+        vst1q_u8(dest, x);
+#else
+        uint64_t x[2], y[2];
+        memcpy(x, srcs[0] + o, RAIDSECTOR);
+        for (unsigned k = 1; k < n; ++k)
+        {
+            memcpy(y, srcs[k] + o, RAIDSECTOR);
+            x[0] ^= y[0];
+            x[1] ^= y[1];
+        }
+        memcpy(dest, x, RAIDSECTOR);
+#endif
+    }
 }
 
 void RaidBufferManager::combineLastRaidLine(byte* dest, size_t remainingbytes)
@@ -805,6 +863,33 @@ m_off_t RaidBufferManager::progress() const
     return reportPos;
 }
 
+size_t RaidBufferManager::bufferedBytes(size_t& pieces) const
+{
+    size_t bytes = 0;
+    auto add = [&bytes, &pieces](const FilePiece& p)
+    {
+        // the data of a buffer ends at 'end' (0 without a buffer)
+        bytes += sizeof(FilePiece) + p.chunkmacs.size() * sizeof(ChunkMAC) + p.buf.end;
+        pieces++;
+    };
+
+    for (unsigned j = RAIDPARTS; j--; )
+    {
+        for (FilePiece* p : raidinputparts[j])
+        {
+            add(*p);
+        }
+    }
+    for (auto& it : asyncoutputbuffers)
+    {
+        if (it.second)
+        {
+            add(*it.second);
+        }
+    }
+    add(leftoverchunk);
+    return bytes;
+}
 
 TransferBufferManager::TransferBufferManager()
     : transfer(NULL)
@@ -822,7 +907,222 @@ m_off_t& TransferBufferManager::transferPos(unsigned connectionNum)
 {
     return isRaid() ? RaidBufferManager::transferPos(connectionNum) : transfer->pos;
 }
-std::pair<m_off_t, m_off_t> TransferBufferManager::nextNPosForConnection(unsigned connectionNum, m_off_t maxRequestSize, unsigned connectionCount, bool& newInputBufferSupplied, bool& pauseConnectionForRaid, m_off_t uploadSpeed)
+const m_off_t RequestSizeController::MIN_REQ_SIZE = 256 * 1024;
+const m_off_t RequestSizeController::MAX_REQ_SIZE = 64 * 1024 * 1024;
+const dstime RequestSizeController::MIN_REQ_DURATION_DS = 20;
+const dstime RequestSizeController::MIN_FLAKY_DURATION_DS = 5;
+const unsigned RequestSizeController::RTT_MULTIPLE = 20;
+
+void RequestSizeController::setConnections(unsigned connections)
+{
+    mChannels.resize(connections);
+}
+
+void RequestSizeController::requestStarted(unsigned connectionNum)
+{
+    assert(connectionNum < mChannels.size());
+    mChannels[connectionNum].inflight = true;
+}
+
+void RequestSizeController::requestCompleted(unsigned connectionNum, m_off_t bytes, dstime elapsedDs, dstime firstByteDs)
+{
+    assert(connectionNum < mChannels.size());
+    Channel& c = mChannels[connectionNum];
+    if (!c.inflight)
+    {
+        return;
+    }
+    c.inflight = false;
+
+    m_off_t rate = bytes * 10 / std::max<dstime>(elapsedDs, 1);
+    c.throughput = c.throughput ? (c.throughput * 3 + rate) / 4 : rate;
+    c.rtt = c.rtt ? (c.rtt * 3 + firstByteDs) / 4 : firstByteDs;
+
+    if (c.failures)
+    {
+        --c.failures;
+    }
+}
+
+void RequestSizeController::requestFailed(unsigned connectionNum)
+{
+    assert(connectionNum < mChannels.size());
+    Channel& c = mChannels[connectionNum];
+    c.inflight = false;
+    c.failures = std::min(c.failures + 1, 4u);
+    c.lastSize /= 2;
+}
+
+m_off_t RequestSizeController::nextRequestSize(unsigned connectionNum, m_off_t ceiling)
+{
+    assert(connectionNum < mChannels.size());
+    Channel& c = mChannels[connectionNum];
+
+    if (!c.throughput)
+    {
+        return 0;
+    }
+
+    dstime duration = std::max<dstime>(MIN_REQ_DURATION_DS, RTT_MULTIPLE * std::max<dstime>(c.rtt, 1));
+    duration = std::max<dstime>(MIN_FLAKY_DURATION_DS, duration >> c.failures);
+
+    m_off_t target = c.throughput * m_off_t(duration) / 10;
+    m_off_t size = target;
+    if (c.lastSize && size > 2 * c.lastSize)
+    {
+        size = 2 * c.lastSize;
+    }
+    size = std::max<m_off_t>(MIN_REQ_SIZE, std::min<m_off_t>(size, std::min<m_off_t>(ceiling, MAX_REQ_SIZE)));
+
+    if (size != c.lastSize)
+    {
+        std::ostringstream d;
+        d << "connection " << connectionNum << ": " << c.throughput << " B/s, rtt " << c.rtt << " ds, "
+          << c.failures << " recent failures -> aim for " << duration << " ds = " << target
+          << " bytes, limited to " << size << " (previous " << c.lastSize << ", ceiling " << ceiling << ")";
+        c.decision = d.str();
+        LOG_debug << "Adaptive request size for " << c.decision;
+    }
+
+    c.lastSize = size;
+    return size;
+}
+
+const std::string& RequestSizeController::lastDecision(unsigned connectionNum) const
+{
+    assert(connectionNum < mChannels.size());
+    return mChannels[connectionNum].decision;
+}
+
+const unsigned RaidHedgeController::PERCENTILE = 95;
+const size_t RaidHedgeController::MIN_SAMPLES = 12;
+const size_t RaidHedgeController::MAX_SAMPLES = 64;
+const dstime RaidHedgeController::MIN_STALL_DS = 30;
+const unsigned RaidHedgeController::MAX_HEDGES = 4;
+
+void RaidHedgeController::setConnections(unsigned connections)
+{
+    mInflight.resize(connections);
+}
+
+void RaidHedgeController::requestStarted(unsigned connectionNum)
+{
+    assert(connectionNum < mInflight.size());
+    mInflight[connectionNum] = true;
+}
+
+void RaidHedgeController::requestCompleted(unsigned connectionNum, dstime elapsedDs)
+{
+    assert(connectionNum < mInflight.size());
+    if (!mInflight[connectionNum])
+    {
+        return;
+    }
+    mInflight[connectionNum] = false;
+
+    mDurations.push_back(elapsedDs);
+    if (mDurations.size() > MAX_SAMPLES)
+    {
+        mDurations.pop_front();
+    }
+}
+
+dstime RaidHedgeController::stallThresholdDs() const
+{
+    if (mDurations.size() < MIN_SAMPLES)
+    {
+        return 0;
+    }
+
+    std::vector<dstime> sorted(mDurations.begin(), mDurations.end());
+    size_t index = std::min(sorted.size() - 1, sorted.size() * PERCENTILE / 100);
+    std::nth_element(sorted.begin(), sorted.begin() + ptrdiff_t(index), sorted.end());
+    return std::max<dstime>(sorted[index], MIN_STALL_DS);
+}
+
+bool RaidHedgeController::shouldHedge(dstime stalledDs)
+{
+    if (mHedges >= MAX_HEDGES)
+    {
+        return false;
+    }
+
+    dstime threshold = stallThresholdDs();
+    if (!threshold || stalledDs <= threshold)
+    {
+        return false;
+    }
+
+    ++mHedges;
+    return true;
+}
+
+void RaidHedgeController::progressed()
+{
+    mHedges = 0;
+}
+
+const dstime ConnectionCountController::SETTLE_DS = 60;
+const dstime ConnectionCountController::HOLD_DS = 300;
+const unsigned ConnectionCountController::MIN_GAIN_PERCENT = 10;
+
+unsigned ConnectionCountController::evaluate(unsigned current, m_off_t speed, unsigned limit, dstime now)
+{
+    limit = std::max(limit, 1u);
+
+    if (current > limit)
+    {
+        // the budget shrank under us
+        mCountBefore = 0;
+        mLastChange = now;
+        return limit;
+    }
+
+    if (now - mLastChange < SETTLE_DS)
+    {
+        return current;
+    }
+
+    if (mCountBefore)
+    {
+        // judge the probe in progress
+        bool keep = current > mCountBefore
+                  ? speed * 100 >= mSpeedBefore * (100 + MIN_GAIN_PERCENT)
+                  : speed * 100 > mSpeedBefore * (100 - MIN_GAIN_PERCENT);
+
+        LOG_debug << "Connection probe " << mCountBefore << " -> " << current << ": speed " << mSpeedBefore << " -> " << speed
+                  << (keep ? ", keeping it" : ", reverting");
+
+        unsigned result = keep ? current : mCountBefore;
+        if (!keep)
+        {
+            mHoldUntil = now + HOLD_DS;
+            mProbeUp = !mProbeUp;
+        }
+        mCountBefore = 0;
+        mLastChange = now;
+        return std::min(result, limit);
+    }
+
+    if (now < mHoldUntil || !speed)
+    {
+        return current;
+    }
+
+    unsigned probe = mProbeUp ? current + 1 : current - 1;
+    if (probe < 1 || probe > limit)
+    {
+        mProbeUp = !mProbeUp;
+        return current;
+    }
+
+    mSpeedBefore = speed;
+    mCountBefore = current;
+    mLastChange = now;
+    return probe;
+}
+
+std::pair<m_off_t, m_off_t> TransferBufferManager::nextNPosForConnection(unsigned connectionNum, m_off_t maxRequestSize, unsigned connectionCount, bool& newInputBufferSupplied, bool& pauseConnectionForRaid, m_off_t uploadSpeed, m_off_t adaptiveRequestSize)
 {
     // returning a pair for clarity - specifying the beginning and end position of the next data block, as the 'current pos' may be updated during this function
     newInputBufferSupplied = false;
@@ -855,10 +1155,22 @@ std::pair<m_off_t, m_off_t> TransferBufferManager::nextNPosForConnection(unsigne
                 maxsize /= 2;
             if (npos + maxsize > transfer->size)
                 maxsize /= 2;
-            m_off_t speedsize = std::min<m_off_t>(maxsize, uploadSpeed * 2 / 3);        // two seconds of data over 3 connections
-            m_off_t sizesize = transfer->size > largeSize ? 8 * 1024 * 1024 : 0; // start with large-ish portions for large files.
-            m_off_t targetsize = std::max<m_off_t>(sizesize, speedsize);
-            maxReqSize = targetsize;
+            if (adaptiveRequestSize)
+            {
+                maxReqSize = std::min<m_off_t>(maxsize, adaptiveRequestSize);
+            }
+            else
+            {
+                m_off_t speedsize = std::min<m_off_t>(maxsize, uploadSpeed * 2 / 3);        // two seconds of data over 3 connections
+                m_off_t sizesize = transfer->size > largeSize ? 8 * 1024 * 1024 : 0; // start with large-ish portions for large files.
+                m_off_t targetsize = std::max<m_off_t>(sizesize, speedsize);
+                maxReqSize = targetsize;
+            }
+        }
+        else if (transfer->type == GET && adaptiveRequestSize)
+        {
+            // still leave the tail of the file to be fetched in parallel
+            maxReqSize = std::min<m_off_t>(adaptiveRequestSize, (transfer->size - transfer->progresscompleted) / connectionCount / 2);
         }
         else if (transfer->type == GET)
         {
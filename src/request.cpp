@@ -34,6 +34,10 @@ bool Request::isFetchNodes() const
 void Request::add(Command* c)
 {
     cmds.push_back(c);
+
+    // the command object plus its separator
+    bytes += strlen(c->getstring()) + 3;
+    interactive = interactive || c->interactive;
 }
 
 size_t Request::size() const
@@ -178,6 +182,7 @@ void Request::clear()
     {
         if (!cmds[i]->persistent)
         {
+            cmds[i]->recyclebuffer();
             delete cmds[i];
         }
     }
@@ -186,6 +191,9 @@ void Request::clear()
     json.pos = NULL;
     processindex = 0;
     stopProcessing = false;
+    bytes = 0;
+    queuedDs = 0;
+    interactive = false;
 }
 
 bool Request::empty() const
@@ -197,6 +205,9 @@ void Request::swap(Request& r)
 {
     // we use swap to move between queues, but process only after it gets into the completedreqs
     cmds.swap(r.cmds);
+    std::swap(bytes, r.bytes);
+    std::swap(queuedDs, r.queuedDs);
+    std::swap(interactive, r.interactive);
 
     // Although swap would usually swap all fields, these must be empty anyway
     // If swap was used when these were active, we would be moving needed info out of the request-in-progress
@@ -233,9 +244,30 @@ void RequestDispatcher::add(Command *c)
     }
 #endif
 
-    if (nextreqs.back().size() >= MAX_COMMANDS)
+    if (c->independent && mParallelUsed)
+    {
+        // the least busy of the parallel batches
+        RequestDispatcher* best = mParallel[0].get();
+        for (size_t i = 1; i < mParallelUsed; i++)
+        {
+            if (mParallel[i]->load() < best->load())
+            {
+                best = mParallel[i].get();
+            }
+        }
+        best->add(c);
+        return;
+    }
+
+    if (nextreqs.back().size() >= mPolicy.maxCommands)
     {
-        LOG_debug << "Starting an additional Request due to MAX_COMMANDS";
+        LOG_debug << "Starting an additional Request due to the command limit";
+        nextreqs.push_back(Request());
+    }
+    else if (mPolicy.maxBytes && !nextreqs.back().empty()
+             && nextreqs.back().byteSize() + strlen(c->getstring()) > mPolicy.maxBytes)
+    {
+        LOG_debug << "Starting an additional Request due to the size limit";
         nextreqs.push_back(Request());
     }
     if (c->batchSeparately && !nextreqs.back().empty())
@@ -244,6 +276,10 @@ void RequestDispatcher::add(Command *c)
         nextreqs.push_back(Request());
     }
 
+    if (nextreqs.back().empty())
+    {
+        nextreqs.back().queuedDs = Waiter::ds;
+    }
     nextreqs.back().add(c);
     if (c->batchSeparately)
     {
@@ -261,6 +297,107 @@ bool RequestDispatcher::cmdsInflight() const
     return !inflightreq.empty();
 }
 
+bool RequestDispatcher::idle() const
+{
+    if (load())
+    {
+        return false;
+    }
+
+    for (auto& p : mParallel)
+    {
+        if (p->load())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void RequestDispatcher::setBatchPolicy(const BatchPolicy& policy)
+{
+    mPolicy = policy;
+    mPolicy.maxCommands = std::max<size_t>(1, std::min<size_t>(mPolicy.maxCommands, MAX_COMMANDS));
+    for (auto& p : mParallel)
+    {
+        p->setBatchPolicy(mPolicy);
+    }
+}
+
+void RequestDispatcher::setParallelBatches(size_t n)
+{
+    mParallelUsed = std::min<size_t>(n, MAX_PARALLEL_BATCHES);
+
+    // batches no longer used are kept until the client has drained them
+    while (mParallel.size() < mParallelUsed)
+    {
+        mParallel.emplace_back(new RequestDispatcher());
+        mParallel.back()->setBatchPolicy(mPolicy);
+    }
+}
+
+size_t RequestDispatcher::load() const
+{
+    size_t n = inflightreq.size();
+    for (auto& r : nextreqs)
+    {
+        n += r.size();
+    }
+    return n;
+}
+
+bool RequestDispatcher::readyToSend(dstime now) const
+{
+    const Request& next = nextreqs.front();
+
+    // anything queued behind it means the batch was closed
+    return !next.empty()
+           && (!mPolicy.lingerDs
+               || nextreqs.size() > 1
+               || next.interactive
+               || now - next.queuedDs >= mPolicy.lingerDs);
+}
+
+dstime RequestDispatcher::nextSendDs() const
+{
+    const Request& next = nextreqs.front();
+
+    if (next.empty())
+    {
+        return NEVER;
+    }
+
+    if (!mPolicy.lingerDs || nextreqs.size() > 1 || next.interactive)
+    {
+        return next.queuedDs;
+    }
+
+    return next.queuedDs + mPolicy.lingerDs;
+}
+
+std::string RequestDispatcher::batchSizeReport(bool reset)
+{
+    std::ostringstream s;
+    s << " cs batch commands histogram (<=2^i):";
+    for (auto n : batchCommandsHistogram)
+    {
+        s << " " << n;
+    }
+    s << "\n cs batch bytes histogram (<=2^i KB):";
+    for (auto n : batchBytesHistogram)
+    {
+        s << " " << n;
+    }
+    s << "\n";
+
+    if (reset)
+    {
+        batchCommandsHistogram.fill(0);
+        batchBytesHistogram.fill(0);
+    }
+    return s.str();
+}
+
 void RequestDispatcher::serverrequest(string *out, bool& suppressSID, bool &includesFetchingNodes)
 {
     assert(inflightreq.empty());
@@ -272,6 +409,20 @@ void RequestDispatcher::serverrequest(string *out, bool& suppressSID, bool &incl
     }
     inflightreq.get(out, suppressSID);
     includesFetchingNodes = inflightreq.isFetchNodes();
+
+    // bucket i counts batches of up to 2^i commands / KB
+    size_t kbytes = (out->size() + 1023) / 1024;
+    int ci = 0, bi = 0;
+    while (ci < BATCH_HISTOGRAM_BUCKETS - 1 && (size_t(1) << ci) < inflightreq.size())
+    {
+        ci++;
+    }
+    while (bi < BATCH_HISTOGRAM_BUCKETS - 1 && (size_t(1) << bi) < kbytes)
+    {
+        bi++;
+    }
+    batchCommandsHistogram[ci]++;
+    batchBytesHistogram[bi]++;
 #ifdef MEGA_MEASURE_CODE
     csRequestsSent += inflightreq.size();
     csBatchesSent += 1;
@@ -294,6 +445,7 @@ void RequestDispatcher::requeuerequest()
 void RequestDispatcher::serverresponse(std::string&& movestring, MegaClient *client)
 {
     CodeCounter::ScopeTimer ccst(client->performanceStats.csResponseProcessingTime);
+    ExecLoopProfiler::Scope lps(client->loopProfiler, ExecLoopProfiler::CS);
 
 #ifdef MEGA_MEASURE_CODE
     csBatchesReceived += 1;
@@ -327,6 +479,11 @@ void RequestDispatcher::servererror(const std::string& e, MegaClient *client)
 
 void RequestDispatcher::clear()
 {
+    for (auto& p : mParallel)
+    {
+        p->clear();
+    }
+
     if (processing)
     {
         // we are being called from a command that is in progress (eg. logout) - delay wiping the data structure until that call ends.
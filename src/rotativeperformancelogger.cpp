@@ -35,6 +35,7 @@
 #include <thread>
 #include <condition_variable>
 #include <future>
+#include <deque>
 
 #include <zlib.h>
 
@@ -45,6 +46,12 @@
 #include <windows.h>
 #endif
 
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #define MAX_MESSAGE_SIZE 4096
 
 #define LOG_TIME_CHARS 25
@@ -54,6 +61,8 @@
 #define MAX_ROTATE_LOGS 50   // So we expect to keep 42MB or so in compressed logs
 #define MAX_ROTATE_LOGS_TODELETE 50   // If ever reducing the number of logs, we should remove the older ones anyway. This number should be the historical maximum of that value
 
+#define LOG_SEGMENT_MAP_STEP (1024*1024)  // compressed segments are grown (and mapped) this much at a time
+
 #define SSTR( x ) static_cast< const std::ostringstream & >( \
         (  std::ostringstream() << std::dec << x ) ).str()
 
@@ -122,6 +131,328 @@ struct LogLinkedList
 
 };
 
+// One file of compressed log output. On Linux (and so Android) the file is
+// preallocated in LOG_SEGMENT_MAP_STEP chunks and mapped, so appending is a
+// memcpy into the page cache and the kernel writes it back on its own schedule.
+// Preallocating with posix_fallocate means a full disk shows up as a failed
+// write here rather than as SIGBUS later. Elsewhere it uses plain FileAccess writes.
+class LogSegmentFile
+{
+public:
+    ~LogSegmentFile()
+    {
+        close();
+    }
+
+    bool open(const LocalPath& path, FileSystemAccess& fsAccess)
+    {
+        close();
+        mUsed = 0;
+#ifdef __linux__
+        (void)fsAccess;
+        mFd = ::open(path.platformEncoded().c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        return mFd >= 0 && remap(LOG_SEGMENT_MAP_STEP);
+#else
+        fsAccess.unlinklocal(path);
+        mFile = fsAccess.newfileaccess();
+        if (!mFile->fopen(path, false, true))
+        {
+            mFile.reset();
+        }
+        return mFile != nullptr;
+#endif
+    }
+
+    bool write(const char* data, size_t len)
+    {
+#ifdef __linux__
+        if (!mMap)
+        {
+            return false;
+        }
+        if (mUsed + len > mCapacity && !remap(std::max(mCapacity + LOG_SEGMENT_MAP_STEP, mUsed + len)))
+        {
+            return false;
+        }
+        memcpy(mMap + mUsed, data, len);
+#else
+        if (!mFile || !mFile->fwrite(reinterpret_cast<const byte*>(data), static_cast<unsigned>(len), static_cast<m_off_t>(mUsed)))
+        {
+            return false;
+        }
+#endif
+        mUsed += len;
+        return true;
+    }
+
+    void flush()
+    {
+#ifdef __linux__
+        if (mMap)
+        {
+            msync(mMap, mUsed, MS_ASYNC);
+        }
+#endif
+    }
+
+    void close()
+    {
+#ifdef __linux__
+        if (mMap)
+        {
+            munmap(mMap, mCapacity);
+            mMap = nullptr;
+            mCapacity = 0;
+        }
+        if (mFd >= 0)
+        {
+            // drop the preallocated tail
+            if (ftruncate(mFd, static_cast<off_t>(mUsed))) {}
+            ::close(mFd);
+            mFd = -1;
+        }
+#else
+        mFile.reset();
+#endif
+    }
+
+    size_t size() const
+    {
+        return mUsed;
+    }
+
+private:
+#ifdef __linux__
+    bool remap(size_t capacity)
+    {
+        if (mMap)
+        {
+            munmap(mMap, mCapacity);
+            mMap = nullptr;
+            mCapacity = 0;
+        }
+        if (posix_fallocate(mFd, 0, static_cast<off_t>(capacity)))
+        {
+            return false;
+        }
+        void* p = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+        if (p == MAP_FAILED)
+        {
+            return false;
+        }
+        mMap = static_cast<char*>(p);
+        mCapacity = capacity;
+        return true;
+    }
+
+    int mFd = -1;
+    char* mMap = nullptr;
+    size_t mCapacity = 0;
+#else
+    std::unique_ptr<FileAccess> mFile;
+#endif
+    size_t mUsed = 0;
+};
+
+struct LogSegment
+{
+    uint64_t sequence = 0;
+    LocalPath path;
+    size_t size = 0;
+};
+
+// Log output for ring mode: text is deflated as it arrives into gzip segment
+// files named <logfile>.<sequence>.seg.gz, so there is no separate compression
+// pass on rotation. When a segment reaches its size it is finished and a new one
+// started, and the oldest segments are deleted to keep the total under the
+// retention limit. Each segment is a complete gzip file once finished; the live
+// one is decodable up to its last flushToDisk().
+// Used as the streambuf of the ostream the logging thread writes to.
+class CompressedLogRing : public std::streambuf
+{
+public:
+    CompressedLogRing(const LocalPath& logsPath, const LocalPath& fileName, size_t segmentBytes, size_t retainBytes,
+                      std::deque<LogSegment> existing, FileSystemAccess& fsAccess)
+        : mLogsPath(logsPath)
+        , mFileName(fileName)
+        , mSegmentBytes(segmentBytes)
+        , mRetainBytes(retainBytes)
+        , mClosed(std::move(existing))
+        , mFsAccess(fsAccess)
+    {
+        mNextSequence = mClosed.empty() ? 0 : mClosed.back().sequence + 1;
+        startSegment();
+    }
+
+    ~CompressedLogRing()
+    {
+        finishSegment();
+    }
+
+    size_t segmentBytes() const { return mSegmentBytes; }
+    size_t retainBytes() const { return mRetainBytes; }
+
+    // call between messages, so a line never spans two segments
+    void rotateIfFull()
+    {
+        if (mCurrent.size() >= mSegmentBytes)
+        {
+            finishSegment();
+            startSegment();
+        }
+    }
+
+    void flushToDisk()
+    {
+        compress(Z_SYNC_FLUSH);
+        mCurrent.flush();
+    }
+
+    void removeAll()
+    {
+        finishSegment();
+        for (auto& segment : mClosed)
+        {
+            if (!mFsAccess.unlinklocal(segment.path))
+            {
+                mErrors += "Error removing log segment " + segment.path.toPath(true) + "\n";
+            }
+        }
+        mClosed.clear();
+        startSegment();
+    }
+
+    void finish()
+    {
+        finishSegment();
+    }
+
+    std::string takeErrors()
+    {
+        std::string e;
+        e.swap(mErrors);
+        return e;
+    }
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        compress(Z_NO_FLUSH);
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override
+    {
+        compress(Z_NO_FLUSH);
+        return 0;
+    }
+
+private:
+    void startSegment()
+    {
+        mCurrentPath = mLogsPath;
+        mCurrentPath.appendWithSeparator(mFileName, false);
+        mCurrentPath.append(LocalPath::fromRelativePath("." + SSTR(mNextSequence) + ".seg.gz"));
+
+        memset(&mZ, 0, sizeof(mZ));
+        mStreamOpen = mCurrent.open(mCurrentPath, mFsAccess) &&
+                      deflateInit2(&mZ, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+        if (!mStreamOpen)
+        {
+            mErrors += "Unable to open log segment " + mCurrentPath.toPath(true) + "\n";
+            mCurrent.close();
+        }
+        ++mNextSequence;
+        setp(mIn, mIn + sizeof(mIn));
+    }
+
+    void finishSegment()
+    {
+        if (!mStreamOpen)
+        {
+            return;
+        }
+        compress(Z_FINISH);
+        deflateEnd(&mZ);
+        mStreamOpen = false;
+
+        LogSegment segment;
+        segment.sequence = mNextSequence - 1;
+        segment.path = mCurrentPath;
+        segment.size = mCurrent.size();
+        mCurrent.close();
+        mClosed.push_back(std::move(segment));
+
+        enforceRetention();
+    }
+
+    // leave room for the next segment, so the total stays under the limit while it fills
+    void enforceRetention()
+    {
+        size_t total = mSegmentBytes;
+        for (auto& segment : mClosed)
+        {
+            total += segment.size;
+        }
+        while (total > mRetainBytes && !mClosed.empty())
+        {
+            if (!mFsAccess.unlinklocal(mClosed.front().path))
+            {
+                mErrors += "Error removing log segment " + mClosed.front().path.toPath(true) + "\n";
+            }
+            total -= mClosed.front().size;
+            mClosed.pop_front();
+        }
+    }
+
+    void compress(int flush)
+    {
+        if (mStreamOpen)
+        {
+            mZ.next_in = reinterpret_cast<Bytef*>(pbase());
+            mZ.avail_in = static_cast<uInt>(pptr() - pbase());
+            do
+            {
+                mZ.next_out = reinterpret_cast<Bytef*>(mOut);
+                mZ.avail_out = sizeof(mOut);
+                if (deflate(&mZ, flush) == Z_STREAM_ERROR)
+                {
+                    break;
+                }
+                size_t n = sizeof(mOut) - mZ.avail_out;
+                if (n && !mCurrent.write(mOut, n))
+                {
+                    mErrors += "Unable to write log segment " + mCurrentPath.toPath(true) + "\n";
+                    break;
+                }
+            } while (mZ.avail_out == 0);
+        }
+        setp(mIn, mIn + sizeof(mIn));
+    }
+
+    LocalPath mLogsPath;
+    LocalPath mFileName;
+    size_t mSegmentBytes;
+    size_t mRetainBytes;
+    std::deque<LogSegment> mClosed;
+    FileSystemAccess& mFsAccess;
+    uint64_t mNextSequence = 0;
+
+    LogSegmentFile mCurrent;
+    LocalPath mCurrentPath;
+    z_stream mZ;
+    bool mStreamOpen = false;
+    std::string mErrors;
+
+    char mIn[64 * 1024];
+    char mOut[64 * 1024];
+};
+
 class RotativePerformanceLoggerLoggingThread
 {
     std::unique_ptr<std::thread> mLogThread;
@@ -140,6 +471,8 @@ class RotativePerformanceLoggerLoggingThread
     unique_ptr<MegaFileSystemAccess> mFsAccess;
     ArchiveType mArchiveType = archiveTypeTimestamp;
     long int archiveMaxFileAgeSeconds = 30 * 86400; // one month
+    size_t mRingSegmentBytes = 0;
+    size_t mRingRetainBytes = 0;    // 0: plain log file with rotation; otherwise ring mode
 
     friend RotativePerformanceLogger;
 
@@ -373,6 +706,39 @@ private:
         }
     }
 
+    // existing ring segments, oldest first
+    std::deque<LogSegment> logRing_findSegments(const LocalPath& logsPath, const LocalPath& fileName)
+    {
+        std::vector<LogSegment> segments;
+        logArchiveTimestamp_walkArchivedFiles(
+                    logsPath, fileName,
+                    [this, &segments](const LocalPath& logsPath, const LocalPath& leafNamePath)
+        {
+            std::string leafName = leafNamePath.toPath(true);
+            std::regex rgx(".*\\.([0-9]+)\\.seg\\.gz");
+            std::smatch match;
+            if (std::regex_match(leafName, match, rgx) && match.size() == 2)
+            {
+                LogSegment segment;
+                segment.sequence = std::stoull(match[1].str());
+                segment.path = logsPath;
+                segment.path.appendWithSeparator(leafNamePath, false);
+                auto fileAccess = mFsAccess->newfileaccess();
+                if (fileAccess->fopen(segment.path, true, false))
+                {
+                    segment.size = static_cast<size_t>(fileAccess->size);
+                }
+                segments.push_back(std::move(segment));
+            }
+        });
+
+        std::sort(segments.begin(), segments.end(), [](const LogSegment& a, const LogSegment& b)
+        {
+            return a.sequence < b.sequence;
+        });
+        return std::deque<LogSegment>(segments.begin(), segments.end());
+    }
+
     LocalPath logArchive_getNewFilename(const LocalPath& fileName)
     {
         return mArchiveType == archiveTypeNumbered
@@ -421,15 +787,55 @@ private:
         outputFile << "----------------------------- program start -----------------------------\n";
         long long outFileSize = outputFile.tellp();
 
+        // ring mode: compressed segments with bounded retention, see CompressedLogRing
+        std::unique_ptr<CompressedLogRing> ring;
+        std::unique_ptr<std::ostream> ringStream;
+
         while (!mLogExit)
         {
+            size_t ringSegmentBytes, ringRetainBytes;
+            {
+                std::lock_guard<std::mutex> g(mLogMutex);
+                ringSegmentBytes = mRingSegmentBytes;
+                ringRetainBytes = mRingRetainBytes;
+            }
+            if (ringRetainBytes && !ring)
+            {
+                outputFile.close();
+                ring.reset(new CompressedLogRing(logsPath, fileName, ringSegmentBytes, ringRetainBytes,
+                                                 logRing_findSegments(logsPath, fileName), *mFsAccess));
+                ringStream.reset(new std::ostream(ring.get()));
+                *ringStream << "----------------------------- program start -----------------------------\n";
+            }
+            else if (!ringRetainBytes && ring)
+            {
+                ringStream.reset();
+                ring->finish();
+                threadErrors += ring->takeErrors();
+                ring.reset();
+                outputFile.open(fileNameFullPath.localpath.c_str(), std::ofstream::out | std::ofstream::app);
+                outFileSize = outputFile.tellp();
+            }
+
+            std::ostream& out = ring ? *ringStream : outputFile;
+
+            if (ring)
+            {
+                threadErrors += ring->takeErrors();
+            }
+
             if (!threadErrors.empty())
             {
-                outputFile  << threadErrors << std::endl;
+                out << threadErrors << std::endl;
                 threadErrors.clear();
             }
 
-            if (mForceRenew)
+            if (mForceRenew && ring)
+            {
+                ring->removeAll();
+                mForceRenew = false;
+            }
+            else if (mForceRenew)
             {
                 std::lock_guard<std::mutex> g(mLogRotationMutex);
                 logArchive_cleanUpFiles(logsPath, fileName);
@@ -448,7 +854,7 @@ private:
 
                 mForceRenew = false;
             }
-            else if (outFileSize > MAX_FILESIZE_MB*1024*1024)
+            else if (!ring && outFileSize > MAX_FILESIZE_MB*1024*1024)
             {
                 std::lock_guard<std::mutex> g(mLogRotationMutex);
                 logArchive_rotateFiles(logsPath, fileName);
@@ -482,7 +888,9 @@ private:
             bool topLevelMemoryGap = false;
             {
                 std::unique_lock<std::mutex> lock(mLogMutex);
-                mLogConditionVariable.wait_for(lock, std::chrono::milliseconds(500), [this, &newMessages, &topLevelMemoryGap]() {
+                // structured records don't signal us, so poll the ring more often while it's in use
+                auto waitPeriod = std::chrono::milliseconds(StructuredLog::drainerActive() ? 50 : 500);
+                mLogConditionVariable.wait_for(lock, waitPeriod, [this, &newMessages, &topLevelMemoryGap]() {
                         if (mForceRenew || mLogListFirst.mNext || mLogExit || mFlushLog || mCloseLog)
                         {
                             newMessages = mLogListFirst.mNext;
@@ -498,9 +906,9 @@ private:
 
             if (topLevelMemoryGap)
             {
-                if (outputFile)
+                if (out)
                 {
-                    outputFile << "<log gap - out of logging memory at this point>\n";
+                    out << "<log gap - out of logging memory at this point>\n";
                 }
             }
 
@@ -508,21 +916,25 @@ private:
             {
                 auto p = newMessages;
                 newMessages = newMessages->mNext;
-                if (outputFile)
+                if (out)
                 {
                     if (p->needsDirectOutput())
                     {
-                        (*p->mDirectLoggingFunction)(&outputFile);
+                        (*p->mDirectLoggingFunction)(&out);
                     }
                     else
                     {
-                        outputFile << p->mMessage;
+                        out << p->mMessage;
                         outFileSize += p->mUsed;
                         if (p->mOomGap)
                         {
-                            outputFile << "<log gap - out of logging memory at this point>\n";
+                            out << "<log gap - out of logging memory at this point>\n";
                         }
                     }
+                    if (ring)
+                    {
+                        ring->rotateIfFull();
+                    }
                 }
 
                 if (RotativePerformanceLogger::Instance().mLogToStdout)
@@ -540,10 +952,31 @@ private:
                 p->notifyWaiter();
                 free(p);
             }
+
+            StructuredLog::drain([&](const LogRecord& r) {
+                std::string line = structuredLogLine(r);
+                if (out)
+                {
+                    out << line;
+                    outFileSize += static_cast<long long>(line.size());
+                    if (ring)
+                    {
+                        ring->rotateIfFull();
+                    }
+                }
+                if (RotativePerformanceLogger::Instance().mLogToStdout)
+                {
+                    std::cout << line << std::flush;
+                }
+            });
             if (mFlushLog || mNextFlushTime <= std::chrono::steady_clock::now())
             {
                 mFlushLog = false;
-                outputFile.flush();
+                out.flush();
+                if (ring)
+                {
+                    ring->flushToDisk();
+                }
                 if (RotativePerformanceLogger::Instance().mLogToStdout)
                 {
                     std::cout << std::flush;
@@ -553,12 +986,50 @@ private:
 
             if (mCloseLog)
             {
+                if (ring)
+                {
+                    ring->finish();
+                }
                 outputFile.close();
                 return;  // This request means we have received a termination signal; close and exit the thread as quick & clean as possible
             }
         }
     }
 
+    static const char* logLevelString(int loglevel)
+    {
+        switch (loglevel) // keeping these at 4 chars makes nice columns, easy to read
+        {
+        case MegaApi::LOG_LEVEL_FATAL: return "CRIT ";
+        case MegaApi::LOG_LEVEL_ERROR: return "ERR  ";
+        case MegaApi::LOG_LEVEL_WARNING: return "WARN ";
+        case MegaApi::LOG_LEVEL_INFO: return "INFO ";
+        case MegaApi::LOG_LEVEL_DEBUG: return "DBG  ";
+        case MegaApi::LOG_LEVEL_MAX: return "DTL  ";
+        }
+        return "     ";
+    }
+
+    // same line layout as log(), but using the time and thread captured in the record
+    static std::string structuredLogLine(const LogRecord& r)
+    {
+        char timebuf[LOG_TIME_CHARS + 1];
+        time_t t = static_cast<time_t>(r.timestampUs / 1000000);
+        struct tm gmt;
+        memset(&gmt, 0, sizeof(struct tm));
+        m_gmtime(t, &gmt);
+        filltime(timebuf, &gmt, static_cast<int>(r.timestampUs % 1000000));
+
+        std::ostringstream oss;
+        oss << timebuf << r.thread << " " << logLevelString(r.level) << r.toString();
+        if (r.file)
+        {
+            oss << " [" << r.file << ":" << r.line << "]";
+        }
+        oss << "\n";
+        return oss.str();
+    }
+
     static std::string currentThreadName()
     {
         std::ostringstream s;
@@ -615,6 +1086,7 @@ void RotativePerformanceLogger::stopLogger()
     // this mLoggingThread is about to be deleted, and the currently
     // logging threads call into it
     MegaApi::removeLoggerObject(this, true);
+    StructuredLog::setDrainerActive(false);
 
     {
         std::lock_guard<std::mutex> g(mLoggingThread->mLogMutex);
@@ -652,6 +1124,7 @@ void RotativePerformanceLogger::initialize(const char * logsPath, const char * l
 
     MegaApi::setLogLevel(MegaApi::LOG_LEVEL_MAX);
     MegaApi::addLoggerObject(this, true);
+    StructuredLog::setDrainerActive(true);
 }
 
 RotativePerformanceLogger& RotativePerformanceLogger::Instance() {
@@ -670,6 +1143,14 @@ void RotativePerformanceLogger::setArchiveTimestamps(long int maxFileAgeSeconds)
     mLoggingThread->archiveMaxFileAgeSeconds = maxFileAgeSeconds;
 }
 
+void RotativePerformanceLogger::setCompressedRing(size_t retainBytes, size_t segmentBytes)
+{
+    std::lock_guard<std::mutex> g(mLoggingThread->mLogMutex);
+    mLoggingThread->mRingSegmentBytes = std::max<size_t>(segmentBytes, 64 * 1024);
+    mLoggingThread->mRingRetainBytes = retainBytes ? std::max(retainBytes, 2 * mLoggingThread->mRingSegmentBytes) : 0;
+    mLoggingThread->mLogConditionVariable.notify_one();
+}
+
 void RotativePerformanceLogger::log(const char*, int loglevel, const char*, const char *message
 #ifdef ENABLE_LOG_PERFORMANCE
                          , const char **directMessages, size_t *directMessagesSizes, int numberMessages
@@ -700,16 +1181,7 @@ void RotativePerformanceLoggerLoggingThread::log(int loglevel, const char *messa
     auto microsec = std::chrono::duration_cast<std::chrono::microseconds>(now - std::chrono::system_clock::from_time_t(t));
     filltime(timebuf, &gmt, (int)microsec.count() % 1000000);
 
-    const char* loglevelstring = "     ";
-    switch (loglevel) // keeping these at 4 chars makes nice columns, easy to read
-    {
-    case MegaApi::LOG_LEVEL_FATAL: loglevelstring = "CRIT "; break;
-    case MegaApi::LOG_LEVEL_ERROR: loglevelstring = "ERR  "; break;
-    case MegaApi::LOG_LEVEL_WARNING: loglevelstring = "WARN "; break;
-    case MegaApi::LOG_LEVEL_INFO: loglevelstring = "INFO "; break;
-    case MegaApi::LOG_LEVEL_DEBUG: loglevelstring = "DBG  "; break;
-    case MegaApi::LOG_LEVEL_MAX: loglevelstring = "DTL  "; break;
-    }
+    const char* loglevelstring = logLevelString(loglevel);
 
     auto messageLen = strlen(message);
     auto threadnameLen = threadname.size();
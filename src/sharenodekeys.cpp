@@ -52,11 +52,24 @@ void ShareNodeKeys::add(Node* n, Node* sn, int specific)
     add(n->nodekey(), n->nodehandle, sn, specific);
 }
 
-// add a nodecore (!sn: all relevant shares, otherwise starting from sn, fixed: only sn)
-void ShareNodeKeys::add(const string& nodekey, handle nodehandle, Node* sn, int specific, const byte* item, int itemlen)
+// append a share/item/key triple for the item about to be added
+void ShareNodeKeys::appendkey(int share, const byte* key, int keylen)
 {
     char buf[96];
     char* ptr;
+
+    sprintf(buf, ",%d,%d,\"", share, (int)items.size());
+
+    ptr = strchr(buf + 5, 0);
+    ptr += Base64::btoa(key, keylen, ptr);
+    *ptr++ = '"';
+
+    keys.append(buf, ptr - buf);
+}
+
+// add a nodecore (!sn: all relevant shares, otherwise starting from sn, fixed: only sn)
+void ShareNodeKeys::add(const string& nodekey, handle nodehandle, Node* sn, int specific, const byte* item, int itemlen)
+{
     byte key[FILENODEKEYLENGTH];
 
     int addnode = 0;
@@ -65,15 +78,9 @@ void ShareNodeKeys::add(const string& nodekey, handle nodehandle, Node* sn, int
     do {
         if (sn->sharekey)
         {
-            sprintf(buf, ",%d,%d,\"", addshare(sn), (int)items.size());
-
             sn->sharekey->ecb_encrypt((byte*)nodekey.data(), key, nodekey.size());
 
-            ptr = strchr(buf + 5, 0);
-            ptr += Base64::btoa(key, int(nodekey.size()), ptr);
-            *ptr++ = '"';
-
-            keys.append(buf, ptr - buf);
+            appendkey(addshare(sn), key, int(nodekey.size()));
             addnode = 1;
         }
     } while (!specific && (sn = sn->parent));
@@ -93,6 +100,14 @@ void ShareNodeKeys::add(const string& nodekey, handle nodehandle, Node* sn, int
     }
 }
 
+void ShareNodeKeys::addencrypted(Node* sn, handle nodehandle, const string& encryptedkey)
+{
+    appendkey(addshare(sn), (const byte*)encryptedkey.data(), int(encryptedkey.size()));
+
+    items.resize(items.size() + 1);
+    items.back().assign((const char*)&nodehandle, MegaClient::NODEHANDLE);
+}
+
 void ShareNodeKeys::get(Command* c, bool skiphandles)
 {
     if (keys.size())
@@ -19,6 +19,7 @@
  * program.
  */
 #include <cctype>
+#include <cmath>
 #include <memory>
 #include <type_traits>
 #include <unordered_set>
@@ -236,12 +237,12 @@ void collectAllLocalNodes(FingerprintCache& fingerprints, FingerprintLocalNodeMa
                           LocalNode& l, handlelocalnode_map& fsidnodes)
 {
     // invalidate fsid of `l`
-    l.fsid = mega::UNDEF;
-    if (l.fsid_it != fsidnodes.end())
+    if (l.fsidIndexed)
     {
-        fsidnodes.erase(l.fsid_it);
-        l.fsid_it = fsidnodes.end();
+        fsidnodes.erase(l.fsid);
+        l.fsidIndexed = false;
     }
+    l.fsid = mega::UNDEF;
     // collect fingerprint
     LightFileFingerprint ffp;
     if (computeFingerprint(ffp, l))
@@ -580,6 +581,8 @@ bool SyncConfig::operator==(const SyncConfig& rhs) const
            && mRemoteNode == rhs.mRemoteNode
            && mOriginalPathOfRemoteRootNode == rhs.mOriginalPathOfRemoteRootNode
            && mFilesystemFingerprint == rhs.mFilesystemFingerprint
+           && mChangeJournalId == rhs.mChangeJournalId
+           && mChangeJournalPosition == rhs.mChangeJournalPosition
            && mSyncType == rhs.mSyncType
            && mError == rhs.mError
            && mBackupId == rhs.mBackupId
@@ -946,6 +949,8 @@ Sync::~Sync()
         client->proctree(localroot->node, &tdsg);
     }
 
+    syncs.mFingerprintPrefetcher.cancel(this);
+
     // Close the database so that deleting localnodes will not remove them
     statecachetable.reset();
 
@@ -1018,13 +1023,12 @@ void Sync::addstatecachechildren(uint32_t parent_dbid, idlocalnode_map* tmap, Lo
     {
         LocalNode* const l = it->second;
 
-        auto preExisting = p->children.find(l->getLocalname());
-        if (preExisting != p->children.end())
+        if (LocalNode* preExisting = p->findchild(l->getLocalname()))
         {
             // tidying up from prior versions of the SDK which might have duplicate LocalNodes
-            LOG_debug << "Removing duplicate LocalNode: " << preExisting->second->debugGetParentList();
-            delete preExisting->second;   // also detaches and preps removal from db
-            assert(p->children.find(l->getLocalname()) == p->children.end());
+            LOG_debug << "Removing duplicate LocalNode: " << preExisting->debugGetParentList();
+            delete preExisting;   // also detaches and preps removal from db
+            assert(!p->findchild(l->getLocalname()));
             // l will be added in its place.  Later entries were the ones used by the old algorithm
         }
 
@@ -1068,8 +1072,10 @@ void Sync::addstatecachechildren(uint32_t parent_dbid, idlocalnode_map* tmap, Lo
         l->size = size;
         l->setfsid(fsid, client->fsidnode);
         l->setnode(node);
+        l->childrenUnloaded = statecachelazy && l->type == FOLDERNODE;
 
-        if (!l->slocalname_in_db)
+        // records from before the parent index are written again to get it
+        if (!l->slocalname_in_db || !statecachelazy)
         {
             statecacheadd(l);
             if (insertq.size() > 50000)
@@ -1090,6 +1096,22 @@ void Sync::readstatecache()
 {
     if (statecachetable && state() == SYNC_INITIALSCAN)
     {
+        if (statecachetable->indexedbyparent())
+        {
+            // each folder's LocalNodes are loaded when first looked up, the rest once the initial scan is done
+            statecachelazy = true;
+            statecachetable->nextid = statecachetable->maxid() & -DbTable::IDSPACING;
+            localroot->childrenUnloaded = true;
+            loadstatecachechildren(localroot.get(), false);
+
+            LOG_debug << syncname << "Sync " << toHandle(getConfig().mBackupId) << " loading from db on demand";
+
+            // trigger a single-pass full scan to identify deleted nodes
+            fullscan = true;
+            scanseqno++;
+            return;
+        }
+
         string cachedata;
         idlocalnode_map tmap;
         uint32_t cid;
@@ -1135,6 +1157,191 @@ void Sync::readstatecache()
     }
 }
 
+void Sync::loadstatecachechildren(LocalNode* p, bool recurse)
+{
+    assert(syncs.onSyncThread());
+
+    if (p->childrenUnloaded)
+    {
+        p->childrenUnloaded = false;
+        p->childrenUsed = true;
+
+        uint32_t parent_dbid = p == localroot.get() ? 0 : p->dbid;
+        std::vector<std::pair<uint32_t, string>> records;
+
+        if (statecachetable && statecachetable->getbyparent(parent_dbid, records, &client->key))
+        {
+            idlocalnode_map tmap;
+
+            // after unloadchildren(), the subfolders (and busy files) are still here
+            std::set<uint32_t> loaded;
+            for (auto& child : p->children)
+            {
+                loaded.insert(child.second->dbid);
+            }
+
+            for (auto& record : records)
+            {
+                if (loaded.count(record.first))
+                {
+                    continue;
+                }
+
+                if (LocalNode* l = LocalNode::unserialize(this, &record.second))
+                {
+                    l->dbid = record.first;
+                    tmap.emplace(parent_dbid, l);
+                }
+            }
+
+            DBTableTransactionCommitter committer(statecachetable);
+            LocalPath pathBuffer = p->getLocalPath();
+            addstatecachechildren(parent_dbid, &tmap, pathBuffer, p, 0);
+        }
+
+        if (!mUnloadedFiles.empty())
+        {
+            for (auto& child : p->children)
+            {
+                if (child.second->type == FILENODE && child.second->node)
+                {
+                    mUnloadedFiles.erase(child.second->node->nodeHandle());
+                }
+            }
+        }
+    }
+
+    if (recurse)
+    {
+        for (auto& child : p->children)
+        {
+            if (child.second->type == FOLDERNODE)
+            {
+                loadstatecachechildren(child.second, true);
+            }
+        }
+    }
+}
+
+bool Sync::overLocalNodeBudget() const
+{
+    uint64_t maxNodes = mUnifiedSync.mMaxLocalNodesInRam;
+    return maxNodes && uint64_t(localnodes[FILENODE]) + localnodes[FOLDERNODE] > maxNodes;
+}
+
+void Sync::unloadColdLocalNodes()
+{
+    assert(syncs.onSyncThread());
+
+    // folders are loaded a whole at a time (see syncdown), and backups walk all of them
+    if (!overLocalNodeBudget() || Waiter::ds < mNextUnloadDs
+        || state() != SYNC_ACTIVE || initializing || fullscan || isBackup()
+        || !statecachetable || !statecachetable->indexedbyparent()
+        || !insertq.empty() || !deleteq.empty() || !dirnotify->empty())
+    {
+        return;
+    }
+
+    mNextUnloadDs = Waiter::ds + UNLOAD_INTERVAL_DS;
+
+    // down to a margin below the limit, not to sweep again as soon as a few more are loaded
+    uint64_t maxNodes = mUnifiedSync.mMaxLocalNodesInRam;
+    uint64_t target = maxNodes - maxNodes / 10;
+    uint64_t inRam = uint64_t(localnodes[FILENODE]) + localnodes[FOLDERNODE];
+    size_t unloaded = 0;
+
+    std::vector<LocalNode*> folders(1, localroot.get());
+    for (size_t steps = MAX_UNLOAD_STEPS; steps && !folders.empty() && inRam > target; steps--)
+    {
+        LocalNode* folder = folders.back();
+        folders.pop_back();
+
+        for (auto& child : folder->children)
+        {
+            if (child.second->type == FOLDERNODE)
+            {
+                folders.push_back(child.second);
+            }
+        }
+
+        if (folder->childrenUsed)
+        {
+            folder->childrenUsed = false;
+            continue;
+        }
+
+        size_t n = unloadchildren(folder);
+        unloaded += n;
+        inRam -= n;
+    }
+
+    if (unloaded)
+    {
+        LOG_debug << syncname << "Unloaded " << unloaded << " LocalNodes, " << inRam << " left in RAM";
+    }
+}
+
+size_t Sync::unloadchildren(LocalNode* folder)
+{
+    if (folder->type != FOLDERNODE || !folder->node || folder->deleted || folder->syncdownPending
+        || (folder != localroot.get() && !folder->dbid))
+    {
+        return 0;
+    }
+
+    // synced files that nothing is waiting on
+    std::vector<LocalNode*> cold;
+    for (auto& child : folder->children)
+    {
+        LocalNode* l = child.second;
+
+        if (l->type == FILENODE && l->dbid && l->node
+            && !l->transfer && !l->newnode && !l->notseen && !l->deleted
+            && static_cast<const FileFingerprint&>(*l) == *l->node
+            && !insertq.count(l))
+        {
+            cold.push_back(l);
+        }
+    }
+
+    if (cold.empty())
+    {
+        return 0;
+    }
+
+    mUnloadingLocalNodes = true;
+    for (LocalNode* l : cold)
+    {
+        mUnloadedFiles[l->node->nodeHandle()] = folder->node->nodeHandle();
+        delete l;
+    }
+    mUnloadingLocalNodes = false;
+
+    folder->childrenUnloaded = true;
+    folder->childrenUsed = false;
+    syncs.mLocalNodesUnloaded = true;
+
+    return cold.size();
+}
+
+void Sync::loadunloadedfile(NodeHandle h)
+{
+    auto it = mUnloadedFiles.find(h);
+    if (it == mUnloadedFiles.end())
+    {
+        return;
+    }
+
+    Node* folder = client->nodeByHandle(it->second);
+    mUnloadedFiles.erase(it);
+
+    // (gone with its folder otherwise)
+    if (folder && folder->localnode && folder->localnode->sync == this)
+    {
+        loadstatecachechildren(folder->localnode, false);
+    }
+}
+
 SyncConfig& Sync::getConfig()
 {
     return mUnifiedSync.mConfig;
@@ -1165,6 +1372,12 @@ void Sync::statecachedel(LocalNode* l)
     if (l->dbid && statecachetable)
     {
         statecachetable->del(l->dbid);
+
+        // nothing else knows about the records below a folder that wasn't loaded
+        if (l->childrenUnloaded)
+        {
+            statecachetable->delbyparent(l->dbid);
+        }
     }
     l->dbid = 0;
 
@@ -1212,6 +1425,7 @@ void Sync::cachenodes()
         (state() == SYNC_INITIALSCAN && insertq.size() > 100)) && (deleteq.size() || insertq.size()))
     {
         LOG_debug << "Saving LocalNode database with " << insertq.size() << " additions and " << deleteq.size() << " deletions";
+        SyncOpTimer timer(*this, mCachenodesTime, "cachenodes");
         statecachetable->begin();
 
         // deletions
@@ -1222,27 +1436,58 @@ void Sync::cachenodes()
 
         deleteq.clear();
 
-        // additions - we iterate until completion or until we get stuck
-        bool added;
+        // additions - a node is written after its ancestors, as it refers to its parent's dbid.
+        // while the sync is active, the writes are capped per call so that the client thread
+        // is not held for long after a big scan: the rest goes out on the next calls
+        size_t budget = state() == SYNC_ACTIVE ? STATECACHE_WRITES_PER_CALL : insertq.size();
+        vector<Cacheable*> batch;
+        vector<LocalNode*> chain;
+        localnode_set batched;
+        size_t stuck = 0;
+
+        // dbids are only assigned when the batch is put, so batched nodes count as written
+        auto written = [&](LocalNode* l) {
+            return l == localroot.get() || l->dbid || batched.count(l);
+        };
 
-        do {
-            added = false;
+        for (auto it = insertq.begin(); it != insertq.end() && batch.size() < budget; )
+        {
+            // unwritten ancestors that are queued too go first, topmost first
+            chain.clear();
+            LocalNode* l = *it;
+            while (!written(l->parent) && insertq.count(l->parent))
+            {
+                l = l->parent;
+                chain.push_back(l);
+            }
 
-            for (set<LocalNode*>::iterator it = insertq.begin(); it != insertq.end(); )
+            if (!written(l->parent))
             {
-                if ((*it)->parent->dbid || (*it)->parent == localroot.get())
-                {
-                    statecachetable->put(MegaClient::CACHEDLOCALNODE, *it, &client->key);
-                    insertq.erase(it++);
-                    added = true;
-                }
-                else it++;
+                // an ancestor is neither written nor queued
+                ++stuck;
+                ++it;
+                continue;
             }
-        } while (added);
+
+            for (auto ancestor = chain.rbegin(); ancestor != chain.rend(); ++ancestor)
+            {
+                batch.push_back(*ancestor);
+                batched.insert(*ancestor);
+                insertq.erase(*ancestor);
+            }
+
+            batch.push_back(*it);
+            batched.insert(*it);
+            insertq.erase(it++);
+        }
+
+        statecachetable->put(MegaClient::CACHEDLOCALNODE, batch, &client->key);
 
         statecachetable->commit();
 
-        if (insertq.size())
+        client->syncstatecachepending |= insertq.size() > stuck;
+
+        if (stuck)
         {
             LOG_err << "LocalNode caching did not complete";
         }
@@ -1374,9 +1619,8 @@ LocalNode* Sync::localnodebypath(LocalNode* l, const LocalPath& localpath, Local
             *parent = l;
         }
 
-        localnode_map::iterator it;
-        if ((it = l->children.find(component)) == l->children.end()
-            && (it = l->schildren.find(component)) == l->schildren.end())
+        LocalNode* child = l->childbyname(&component);
+        if (!child)
         {
             // no full match: store residual path, return NULL with the
             // matching component LocalNode in parent
@@ -1393,7 +1637,7 @@ LocalNode* Sync::localnodebypath(LocalNode* l, const LocalPath& localpath, Local
             return NULL;
         }
 
-        l = it->second;
+        l = child;
     }
 
     // full match: no residual path, return corresponding LocalNode
@@ -1473,6 +1717,138 @@ bool Sync::scan(LocalPath localpath, FileAccess* fa)
     else return false;
 }
 
+bool Sync::replayChangeJournal()
+{
+    auto& config = getConfig();
+    handle journalId;
+    m_off_t position;
+
+    // read before replaying: whatever happens from here on is notified as well
+    if (!fsstableids
+        || !syncs.fsaccess->changeJournalPosition(localroot->getLocalname(), journalId, position))
+    {
+        return false;
+    }
+
+    mPendingJournalId = journalId;
+    mPendingJournalPosition = position;
+
+    if (!config.mChangeJournalPosition || config.mChangeJournalId != journalId)
+    {
+        return false;
+    }
+
+    // the journal names items by fsid: all the cached LocalNodes are needed to map them to paths
+    loadstatecachechildren(localroot.get(), true);
+
+    if (!localnodes[FILENODE] && !localnodes[FOLDERNODE])
+    {
+        return false;
+    }
+
+    auto lookup = [this](handle fsid) -> LocalNode* {
+        if (fsid == localroot->fsid)
+        {
+            return localroot.get();
+        }
+
+        auto it = client->fsidnode.find(fsid);
+        return it != client->fsidnode.end() && it->second->sync == this ? it->second : nullptr;
+    };
+
+    vector<LocalPath> changed;
+
+    if (!syncs.fsaccess->readChangeJournal(localroot->getLocalname(), journalId, config.mChangeJournalPosition,
+            [&](handle fsid, handle parentFsid, const LocalPath& name) {
+                // where the item was known to be: changes, deletions and moves away
+                if (LocalNode* l = lookup(fsid))
+                {
+                    changed.emplace_back(l->getLocalPath());
+                }
+
+                // where the record places it: additions and moves in
+                LocalNode* parent = lookup(parentFsid);
+
+                if (parent && parent->type == FOLDERNODE)
+                {
+                    changed.emplace_back(parent->getLocalPath());
+                    changed.back().appendWithSeparator(name, true);
+                }
+            }))
+    {
+        return false;
+    }
+
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+    for (auto& path : changed)
+    {
+        if (!localdebris.isContainingPathOf(path))
+        {
+            dirnotify->notify(DirNotify::DIREVENTS, NULL, std::move(path), false, false);
+        }
+    }
+
+    // what the scan would have counted
+    std::function<void(LocalNode*)> account = [&](LocalNode* l) {
+        for (auto& child : l->children)
+        {
+            if (child.second->type == FILENODE)
+            {
+                localbytes += child.second->size;
+            }
+            else
+            {
+                account(child.second);
+            }
+        }
+    };
+    account(localroot.get());
+
+    // nothing is left unvisited that deletemissing() should remove: deletions were replayed too
+    fullscan = false;
+
+    LOG_info << syncname << "Replayed the change journal from " << config.mChangeJournalPosition
+             << " instead of scanning: " << changed.size() << " paths to check";
+
+    return true;
+}
+
+void Sync::recordChangeJournalPosition()
+{
+    if (Waiter::ds < mNextJournalCheckDs)
+    {
+        return;
+    }
+
+    mNextJournalCheckDs = Waiter::ds + JOURNAL_CHECK_INTERVAL_DS;
+
+    handle journalId;
+    m_off_t position;
+
+    if (!fsstableids
+        || !syncs.fsaccess->changeJournalPosition(localroot->getLocalname(), journalId, position))
+    {
+        return;
+    }
+
+    // the changes made before the previous reading have been notified and processed since
+    auto& config = getConfig();
+
+    if (mPendingJournalPosition && !fullscan && insertq.empty() && deleteq.empty()
+        && (config.mChangeJournalId != mPendingJournalId
+            || config.mChangeJournalPosition != mPendingJournalPosition))
+    {
+        config.mChangeJournalId = mPendingJournalId;
+        config.mChangeJournalPosition = mPendingJournalPosition;
+        syncs.saveSyncConfig(config);
+    }
+
+    mPendingJournalId = journalId;
+    mPendingJournalPosition = position;
+}
+
 // check local path - if !localname, localpath is relative to l, with l == NULL
 // being the root of the sync
 // if localname is set, localpath is absolute and localname its last component
@@ -1601,12 +1977,20 @@ LocalNode* Sync::checkpath(LocalNode* l, LocalPath* input_localpath, string* con
                 l->deleted = false;
                 l->setnotseen(0);
 
-                // if it's a file, size and mtime must match to qualify
-                if (l->type != FILENODE || (l->size == fa->size && l->mtime == fa->mtime))
+                // if it's a file, size and mtime must match to qualify, and ctime too if both are known
+                if (l->type != FILENODE || (l->size == fa->size && l->mtime == fa->mtime
+                                            && (!l->ctime || !fa->ctime || l->ctime == fa->ctime)))
                 {
                     LOG_verbose << "Cached localnode is still valid. Type: " << l->type << "  Size: " << l->size << "  Mtime: " << l->mtime << " fsid " << (fa->fsidvalid ? toHandle(fa->fsid) : "NO");
                     l->scanseqno = scanseqno;
 
+                    // nodes cached before ctime was recorded pick it up here
+                    if (l->type == FILENODE && !l->ctime && fa->ctime)
+                    {
+                        l->ctime = fa->ctime;
+                        statecacheadd(l);
+                    }
+
                     if (l->type == FOLDERNODE)
                     {
                         scan(*localpathNew, fa.get());
@@ -1631,12 +2015,12 @@ LocalNode* Sync::checkpath(LocalNode* l, LocalPath* input_localpath, string* con
         {
             if (cl)
             {
-                LOG_verbose << "Outdated localnode. Type: " << cl->type << "  Size: " << cl->size << "  Mtime: " << cl->mtime
-                            << "    FaType: " << fa->type << "  FaSize: " << fa->size << "  FaMtime: " << fa->mtime;
+                LOGF_verbose("Outdated localnode. Type: {}  Size: {}  Mtime: {}    FaType: {}  FaSize: {}  FaMtime: {}",
+                             cl->type, cl->size, cl->mtime, fa->type, fa->size, fa->mtime);
             }
             else
             {
-                LOG_verbose << "New file. FaType: " << fa->type << "  FaSize: " << fa->size << "  FaMtime: " << fa->mtime;
+                LOGF_verbose("New file. FaType: {}  FaSize: {}  FaMtime: {}", fa->type, fa->size, fa->mtime);
             }
             return NULL;
         }
@@ -1698,6 +2082,8 @@ LocalNode* Sync::checkpath(LocalNode* l, LocalPath* input_localpath, string* con
                                     }
                                     else
                                     {
+                                        LocalNode* moved = it->second;
+
                                         LOG_debug << "File move/overwrite detected";
 
                                         if (parent && !parent->node)
@@ -1716,17 +2102,17 @@ LocalNode* Sync::checkpath(LocalNode* l, LocalPath* input_localpath, string* con
                                             client->execsyncdeletions();
 
                                             // ...and atomically replace with moved one
-                                            LOG_debug << "Sync - local rename/move " << it->second->getLocalPath() << " -> " << path;
+                                            LOG_debug << "Sync - local rename/move " << moved->getLocalPath() << " -> " << path;
 
                                             // (in case of a move, this synchronously updates l->parent and l->node->parent)
-                                            it->second->setnameparent(parent, localpathNew, syncs.fsaccess->fsShortname(*localpathNew));
+                                            moved->setnameparent(parent, localpathNew, syncs.fsaccess->fsShortname(*localpathNew));
 
                                             // mark as seen / undo possible deletion
-                                            it->second->setnotseen(0);
+                                            moved->setnotseen(0);
 
-                                            statecacheadd(it->second);
+                                            statecacheadd(moved);
 
-                                            return it->second;
+                                            return moved;
                                         }
                                     }
                                 }
@@ -1747,11 +2133,16 @@ LocalNode* Sync::checkpath(LocalNode* l, LocalPath* input_localpath, string* con
 
                             m_off_t dsize = l->size > 0 ? l->size : 0;
 
-                            if (l->genfingerprint(fa.get()) && l->size >= 0)
+                            if (genfingerprint(l, fa.get(), *localpathNew) && l->size >= 0)
                             {
                                 localbytes -= dsize - l->size;
                             }
 
+                            if (client->localdownloaddedup && l->isvalid)
+                            {
+                                client->localFingerprints.add(*l, *localpathNew);
+                            }
+
                             LOG_debug << "Sync - local file change detected: " << path;
 
                             TransferDbCommitter committer(client->tctable);
@@ -1822,7 +2213,10 @@ LocalNode* Sync::checkpath(LocalNode* l, LocalPath* input_localpath, string* con
                     && ((it->second->type != FILENODE && !wejustcreatedthisfolder)
                         || (it->second->mtime == fa->mtime && it->second->size == fa->size)))
                 {
-                    LOG_debug << client->clientname << "Move detected by fsid " << toHandle(fa->fsid) << " in checkpath. Type: " << it->second->type << " new path: " << path << " old localnode: " << it->second->getLocalPath();
+                    // the index may grow (and rehash) below, so hold on to the node rather than the iterator
+                    LocalNode* moved = it->second;
+
+                    LOG_debug << client->clientname << "Move detected by fsid " << toHandle(fa->fsid) << " in checkpath. Type: " << moved->type << " new path: " << path << " old localnode: " << moved->getLocalPath();
 
                     if (fa->type == FILENODE && backoffds)
                     {
@@ -1840,7 +2234,7 @@ LocalNode* Sync::checkpath(LocalNode* l, LocalPath* input_localpath, string* con
                             if (currentsecs - updatedfileinitialts <= FILE_UPDATE_MAX_DELAY_SECS)
                             {
                                 bool waitforupdate = false;
-                                auto local = it->second->getLocalPath();
+                                auto local = moved->getLocalPath();
                                 auto prevfa = syncs.fsaccess->newfileaccess(false);
 
                                 bool exists = prevfa->fopen(local);
@@ -1931,7 +2325,7 @@ LocalNode* Sync::checkpath(LocalNode* l, LocalPath* input_localpath, string* con
                         }
                     }
 
-                    LOG_debug << "Sync - local rename/move " << it->second->getLocalPath() << " -> " << path.c_str();
+                    LOG_debug << "Sync - local rename/move " << moved->getLocalPath() << " -> " << path.c_str();
 
                     if (parent && !parent->node)
                     {
@@ -1944,11 +2338,11 @@ LocalNode* Sync::checkpath(LocalNode* l, LocalPath* input_localpath, string* con
                     {
                         // (in case of a move, this synchronously updates l->parent
                         // and l->node->parent)
-                        it->second->setnameparent(parent, localpathNew, syncs.fsaccess->fsShortname(*localpathNew));
+                        moved->setnameparent(parent, localpathNew, syncs.fsaccess->fsShortname(*localpathNew));
                     }
 
                     // Has the move (rename) resulted in a filename anomaly?
-                    if (Node* node = it->second->node)
+                    if (Node* node = moved->node)
                     {
                         auto type = isFilenameAnomaly(*localpathNew, node);
 
@@ -1964,15 +2358,15 @@ LocalNode* Sync::checkpath(LocalNode* l, LocalPath* input_localpath, string* con
                     // make sure that active PUTs receive their updated filenames
                     client->updateputs();
 
-                    statecacheadd(it->second);
+                    statecacheadd(moved);
 
                     // unmark possible deletion
-                    it->second->setnotseen(0);
+                    moved->setnotseen(0);
 
                     if (fa->type == FOLDERNODE)
                     {
                         // mark this and folders below to be rescanned
-                        it->second->setSubtreeNeedsRescan(fullscan);
+                        moved->setSubtreeNeedsRescan(fullscan);
 
                         if (fullscan)
                         {
@@ -1980,12 +2374,12 @@ LocalNode* Sync::checkpath(LocalNode* l, LocalPath* input_localpath, string* con
                             scan(*localpathNew, fa.get());
 
                             // consider this folder scanned.
-                            it->second->needsRescan = false;
+                            moved->needsRescan = false;
                         }
                         else
                         {
                             // queue this one to be scanned, recursion is by notify of subdirs
-                            dirnotify->notify(DirNotify::DIREVENTS, it->second, LocalPath(), true, false);
+                            dirnotify->notify(DirNotify::DIREVENTS, moved, LocalPath(), true, false);
                         }
                     }
                 }
@@ -2056,13 +2450,22 @@ LocalNode* Sync::checkpath(LocalNode* l, LocalPath* input_localpath, string* con
                         localbytes -= l->size;
                     }
 
-                    if (l->genfingerprint(fa.get()))
+                    if (genfingerprint(l, fa.get(), *localpathNew))
                     {
                         changed = true;
                         l->bumpnagleds();
                         l->deleted = false;
                     }
 
+                    // the fingerprint is current as of this ctime
+                    bool ctimechanged = l->ctime != fa->ctime;
+                    l->ctime = fa->ctime;
+
+                    if (client->localdownloaddedup && l->isvalid)
+                    {
+                        client->localFingerprints.add(*l, *localpathNew);
+                    }
+
                     if (l->size > 0)
                     {
                         localbytes += l->size;
@@ -2081,7 +2484,7 @@ LocalNode* Sync::checkpath(LocalNode* l, LocalPath* input_localpath, string* con
 
                     l->needsRescan = false;
 
-                    if (newnode || changed)
+                    if (newnode || changed || ctimechanged)
                     {
                         statecacheadd(l);
                     }
@@ -2141,25 +2544,7 @@ LocalNode* Sync::checkpath(LocalNode* l, LocalPath* input_localpath, string* con
 bool Sync::checkValidNotification(int q, Notification& notification)
 {
     // This code moved from filtering before going on notifyq, to filtering after when it's thread-safe to do so
-
-    if (q == DirNotify::DIREVENTS || q == DirNotify::EXTRA)
-    {
-        Notification next;
-        while (dirnotify->notifyq[q].peekFront(next)
-            && next.localnode == notification.localnode && next.path == notification.path)
-        {
-            dirnotify->notifyq[q].popFront(next);  // this is the only thread removing from the queue so it will be the same item
-            if (!notification.timestamp || !next.timestamp)
-            {
-                notification.timestamp = 0;  // immediate
-            }
-            else
-            {
-                notification.timestamp = std::max(notification.timestamp, next.timestamp);
-            }
-            LOG_debug << "Next notification repeats, skipping duplicate";
-        }
-    }
+    // (repeats of a queued notification are coalesced by the queue itself)
 
     if (notification.timestamp && !initializing && q == DirNotify::DIREVENTS)
     {
@@ -2185,7 +2570,7 @@ bool Sync::checkValidNotification(int q, Notification& notification)
 
         if (deleted
             || (ll && success && ll->node && ll->node->localnode == ll
-                && !(notification.recursive | ll->needsRescan)
+                && !(notification.recursive | notification.folded | ll->needsRescan)
                 && (ll->type != FILENODE || (*(FileFingerprint *)ll) == (*(FileFingerprint *)ll->node))
                 && (ait = ll->node->attrs.map.find('n')) != ll->node->attrs.map.end()
                 && ait->second == ll->name
@@ -2215,7 +2600,7 @@ dstime Sync::procscanq(int q)
             continue;
         }
 
-        LOG_verbose << "Scanning... Remaining files: " << dirnotify->notifyq[q].size();
+        LOGF_verbose("Scanning... Remaining files: {}", dirnotify->notifyq[q].size());
 
         if (notification.timestamp > dsmin)
         {
@@ -2264,7 +2649,36 @@ dstime Sync::procscanq(int q)
                 }
             }
 
-            l = checkpath(l, &notification.path, NULL, &backoffds, false, nullptr);
+            // The queue folded the notifications of this folder's children into this one:
+            // check the children we know of, and rescan it for new ones.
+            if (notification.folded)
+            {
+                auto remainder = LocalPath();
+                auto node = localnodebypath(notification.localnode,
+                                            notification.path,
+                                            nullptr,
+                                            &remainder);
+
+                if (node && remainder.empty() && node->type == FOLDERNODE)
+                {
+                    LOG_debug << "Rescanning folder with folded notifications: " << node->getLocalPath();
+
+                    loadstatecachechildren(node, false);
+
+                    for (auto& child : node->children)
+                    {
+                        dirnotify->notify(DirNotify::notifyqueue(q), nullptr, child.second->getLocalPath(), false, false);
+                    }
+
+                    node->needsRescan = true;
+                }
+            }
+
+            ++DirNotify::sCheckpaths;
+            {
+                SyncOpTimer timer(*this, mCheckpathTime, "checkpath");
+                l = checkpath(l, &notification.path, NULL, &backoffds, false, nullptr);
+            }
             if (backoffds)
             {
                 LOG_verbose << "Scanning deferred during " << backoffds << " ds";
@@ -2305,6 +2719,12 @@ dstime Sync::procscanq(int q)
         {
             client->syncactivity = true;
         }
+
+        // fingerprints prefetched for notifications that were skipped
+        if (dirnotify->notifyq[DirNotify::DIREVENTS].empty() && dirnotify->notifyq[DirNotify::RETRY].empty())
+        {
+            syncs.mFingerprintPrefetcher.cancel(this);
+        }
     }
     else if (dirnotify->notifyq[!q].empty())
     {
@@ -2314,6 +2734,71 @@ dstime Sync::procscanq(int q)
     return dstime(~0);
 }
 
+bool Sync::genfingerprint(LocalNode* l, FileAccess* fa, const LocalPath& path)
+{
+    FileFingerprint prefetched;
+
+    if (!syncs.mFingerprintPrefetcher.take(path, *fa, prefetched))
+    {
+        return l->genfingerprint(fa);
+    }
+
+    // same outcome as genfingerprint() reading the file here
+    bool changed = l->mtime != prefetched.mtime
+                || l->size != prefetched.size
+                || l->crc != prefetched.crc
+                || !l->isvalid;
+
+    l->FileFingerprint::operator=(prefetched);
+
+    fa->closef();
+    return changed;
+}
+
+void Sync::prefetchfingerprints(int q)
+{
+    // scans match most files against the cached state without reading them
+    if (state() != SYNC_ACTIVE || fullscan)
+    {
+        return;
+    }
+
+    dstime dsmin = Waiter::ds - SCANNING_DELAY_DS;
+
+    std::vector<Notification> notifications;
+    dirnotify->notifyq[q].peekFront(PREFETCH_NOTIFICATIONS, notifications);
+
+    for (auto& notification : notifications)
+    {
+        // leave files that are still being written, and rescans, to checkpath()
+        if (notification.timestamp > dsmin)
+        {
+            break;
+        }
+
+        if (notification.localnode == (LocalNode*)~0 || notification.recursive || notification.folded)
+        {
+            continue;
+        }
+
+        LocalPath path;
+        if (notification.localnode)
+        {
+            path = notification.localnode->getLocalPath();
+            path.appendWithSeparator(notification.path, false);
+        }
+        else
+        {
+            path = notification.path;
+        }
+
+        if (!syncs.mFingerprintPrefetcher.queue(this, path))
+        {
+            break;
+        }
+    }
+}
+
 // delete all child LocalNodes that have been missing for two consecutive scans (*l must still exist)
 void Sync::deletemissing(LocalNode* l)
 {
@@ -2613,6 +3098,9 @@ void Syncs::startSync_inThread(UnifiedSync& us, const string& debris, const Loca
 
     if (!us.mSync->fsstableids)
     {
+        // matching fsids up needs all the LocalNodes
+        us.mSync->loadstatecachechildren(us.mSync->localroot.get(), true);
+
         if (us.mSync->assignfsids())
         {
             LOG_info << "Successfully assigned fs IDs for filesystem with unstable IDs";
@@ -2625,11 +3113,19 @@ void Syncs::startSync_inThread(UnifiedSync& us, const string& debris, const Loca
 
     LOG_debug << "Initial scan sync: " << us.mConfig.getLocalPath();
 
-    if (us.mSync->scan(rootpath, openedLocalFolder.get()))
+    // where the filesystem journals its changes, those since the sync last ran are enough
+    bool replayed = us.mSync->replayChangeJournal();
+
+    if (replayed || us.mSync->scan(rootpath, openedLocalFolder.get()))
     {
         mClient.syncsup = false;
         us.mSync->initializing = false;
-        LOG_debug << "Initial scan finished. New / modified files: " << us.mSync->dirnotify->notifyq[DirNotify::DIREVENTS].size();
+
+        // what the scan didn't reach (deleted, moved or excluded), so that it's accounted for
+        us.mSync->loadstatecachechildren(us.mSync->localroot.get(), true);
+
+        LOG_debug << (replayed ? "Change journal replayed" : "Initial scan finished")
+                  << ". New / modified files: " << us.mSync->dirnotify->notifyq[DirNotify::DIREVENTS].size();
 
         // Sync constructor now receives the syncConfig as reference, to be able to write -at least- fingerprints for new syncs
         saveSyncConfig(us.mConfig);
@@ -2673,6 +3169,290 @@ void UnifiedSync::changedConfigState(bool save, bool notifyApp)
     }
 }
 
+void SyncTrace::enable(bool enable)
+{
+    if (enable && !mEnabled)
+    {
+        mEvents.clear();
+        mEpoch = std::chrono::high_resolution_clock::now();
+    }
+
+    mEnabled = enable;
+}
+
+void SyncTrace::add(const char* name, handle backupId, std::chrono::high_resolution_clock::time_point start,
+                    std::chrono::high_resolution_clock::duration timeSpent)
+{
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+
+    if (!mEnabled)
+    {
+        return;
+    }
+
+    if (mEvents.size() >= MAX_EVENTS)
+    {
+        mEvents.pop_front();
+    }
+
+    mEvents.push_back(Event{name,
+                            backupId,
+                            int64_t(duration_cast<microseconds>(start - mEpoch).count()),
+                            int64_t(duration_cast<microseconds>(timeSpent).count())});
+}
+
+string SyncTrace::exportChromeTrace() const
+{
+    // syncs are shown as threads, numbered in order of appearance and named by backup id
+    map<handle, m_off_t> threads;
+    for (auto& event : mEvents)
+    {
+        threads.emplace(event.backupId, m_off_t(threads.size() + 1));
+    }
+
+    JSONWriter writer;
+    writer.beginobject();
+    writer.beginarray("traceEvents");
+
+    for (auto& thread : threads)
+    {
+        writer.beginobject();
+        writer.arg("name", "thread_name");
+        writer.arg("ph", "M");
+        writer.arg("pid", m_off_t(1));
+        writer.arg("tid", thread.second);
+        writer.beginobject("args");
+        writer.arg("name", toHandle(thread.first));
+        writer.endobject();
+        writer.endobject();
+    }
+
+    for (auto& event : mEvents)
+    {
+        writer.beginobject();
+        writer.arg("name", event.name);
+        writer.arg("ph", "X");
+        writer.arg("pid", m_off_t(1));
+        writer.arg("tid", threads[event.backupId]);
+        writer.arg("ts", m_off_t(event.start));
+        writer.arg("dur", m_off_t(event.duration));
+        writer.endobject();
+    }
+
+    writer.endarray();
+    writer.endobject();
+    return writer.getstring();
+}
+
+SyncOpTimer::SyncOpTimer(Sync& sync, CodeCounter::CallStats& stats, const char* name)
+  : mSync(sync)
+  , mName(name)
+  , mTimer(stats)
+{
+}
+
+SyncOpTimer::~SyncOpTimer()
+{
+    if (mSync.syncs.mTrace.enabled())
+    {
+        mSync.syncs.mTrace.add(mName,
+                               mSync.getConfig().mBackupId,
+                               mTimer.blockStart,
+                               std::chrono::high_resolution_clock::now() - mTimer.blockStart);
+    }
+}
+
+FingerprintPrefetcher::~FingerprintPrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> g(mLock);
+        mTerminating = true;
+    }
+
+    mNotifier.notify_all();
+
+    for (auto& thread : mThreads)
+    {
+        thread.join();
+    }
+
+    ThreadTopology::queued(ThreadTopology::FINGERPRINT, -static_cast<long long>(mPending.size()));
+}
+
+bool FingerprintPrefetcher::queue(Sync* sync, const LocalPath& path)
+{
+    std::lock_guard<std::mutex> g(mLock);
+
+    if (mEntries.size() >= MAX_ENTRIES)
+    {
+        return false;
+    }
+
+    if (!mEntries.emplace(path, Entry{sync, false, -1, 0, UNDEF, false, FileFingerprint()}).second)
+    {
+        // already pending or computed
+        return true;
+    }
+
+    mPending.push_back(path);
+    ThreadTopology::queued(ThreadTopology::FINGERPRINT, 1);
+
+    // start the threads as they are needed
+    unsigned numThreads = std::max(1u, std::min(std::thread::hardware_concurrency(), unsigned(MAX_THREADS)));
+    numThreads = ThreadTopology::poolSize(ThreadTopology::FINGERPRINT, numThreads);
+
+    if (mThreads.size() < numThreads && mThreads.size() < mPending.size())
+    {
+        try
+        {
+            mThreads.emplace_back([this]() { loop(); });
+        }
+        catch (std::system_error& e)
+        {
+            LOG_err << "Failed to start fingerprint thread: " << e.what();
+
+            if (mThreads.empty())
+            {
+                mPending.pop_back();
+                ThreadTopology::queued(ThreadTopology::FINGERPRINT, -1);
+                mEntries.erase(path);
+                return false;
+            }
+        }
+    }
+
+    mNotifier.notify_one();
+    return true;
+}
+
+bool FingerprintPrefetcher::take(const LocalPath& path, const FileAccess& fa, FileFingerprint& fingerprint)
+{
+    std::lock_guard<std::mutex> g(mLock);
+
+    auto it = mEntries.find(path);
+    if (it == mEntries.end())
+    {
+        return false;
+    }
+
+    // if still pending, the caller computes it: the thread drops the path when it gets to it
+    Entry& entry = it->second;
+    bool match = entry.done
+              && entry.size == fa.size
+              && entry.mtime == fa.mtime
+              && entry.fsidvalid == fa.fsidvalid
+              && (!fa.fsidvalid || entry.fsid == fa.fsid);
+
+    if (match)
+    {
+        fingerprint = entry.fingerprint;
+    }
+
+    mEntries.erase(it);
+    return match;
+}
+
+void FingerprintPrefetcher::cancel(Sync* sync)
+{
+    std::lock_guard<std::mutex> g(mLock);
+
+    for (auto it = mEntries.begin(); it != mEntries.end(); )
+    {
+        if (it->second.sync == sync)
+        {
+            it = mEntries.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // queued paths of the sync are skipped when taken
+    if (mEntries.empty())
+    {
+        ThreadTopology::queued(ThreadTopology::FINGERPRINT, -static_cast<long long>(mPending.size()));
+        mPending.clear();
+    }
+}
+
+void FingerprintPrefetcher::loop()
+{
+    ThreadTopology::threadStarted(ThreadTopology::FINGERPRINT);
+
+    // Each thread has its own filesystem access.
+    std::unique_ptr<FileSystemAccess> fsAccess(new FSACCESS_CLASS());
+
+    for ( ; ; )
+    {
+        LocalPath path;
+
+        {
+            std::unique_lock<std::mutex> g(mLock);
+
+            for ( ; ; )
+            {
+                if (mTerminating)
+                {
+                    ThreadTopology::threadStopped(ThreadTopology::FINGERPRINT);
+                    return;
+                }
+
+                if (mPending.empty())
+                {
+                    mNotifier.wait(g);
+                    continue;
+                }
+
+                path = std::move(mPending.front());
+                mPending.pop_front();
+                ThreadTopology::queued(ThreadTopology::FINGERPRINT, -1);
+
+                auto it = mEntries.find(path);
+                if (it != mEntries.end() && !it->second.done)
+                {
+                    break;
+                }
+            }
+        }
+
+        // read the file without holding the lock
+        auto fa = fsAccess->newfileaccess(false);
+        Entry entry{nullptr, true, -1, 0, UNDEF, false, FileFingerprint()};
+
+        if (fa->fopen(path, true, false) && fa->type == FILENODE)
+        {
+            ThreadTopology::Busy busy(ThreadTopology::FINGERPRINT);
+            entry.size = fa->size;
+            entry.mtime = fa->mtime;
+            entry.fsid = fa->fsid;
+            entry.fsidvalid = fa->fsidvalid;
+            entry.fingerprint.genfingerprint(fa.get());
+        }
+
+        std::lock_guard<std::mutex> g(mLock);
+
+        auto it = mEntries.find(path);
+        if (it == mEntries.end() || it->second.done)
+        {
+            // taken or cancelled meanwhile
+            continue;
+        }
+
+        if (entry.fingerprint.isvalid && entry.fingerprint.size >= 0)
+        {
+            entry.sync = it->second.sync;
+            it->second = std::move(entry);
+        }
+        else
+        {
+            // not a file, or unreadable: checkpath() finds out for itself
+            mEntries.erase(it);
+        }
+    }
+}
+
 Syncs::Syncs(MegaClient& mc, unique_ptr<FileSystemAccess>& fsa)
   : mClient(mc)
   , fsaccess(fsa)  // reference to MegaClient's for now, for linux we need it that way ofr notifications.  In sync rework, this will be a separate instance
@@ -3894,6 +4674,108 @@ bool Syncs::syncConfigByBackupId(handle backupId, SyncConfig& c) const
     return false;
 }
 
+bool Syncs::syncStats(handle backupId, SyncStats& stats) const
+{
+    lock_guard<mutex> g(mSyncVecMutex);
+    for (auto& s : mSyncVec)
+    {
+        if (s->mConfig.mBackupId != backupId || !s->mSync)
+        {
+            continue;
+        }
+
+        Sync& sync = *s->mSync;
+
+        stats = SyncStats();
+        stats.notificationsPending = sync.dirnotify->notifyq[DirNotify::DIREVENTS].size()
+                                   + sync.dirnotify->notifyq[DirNotify::EXTRA].size();
+        stats.retriesPending = sync.dirnotify->notifyq[DirNotify::RETRY].size();
+        stats.statecacheWritesPending = sync.insertq.size();
+        stats.statecacheDeletesPending = sync.deleteq.size();
+
+        SyncTransferCounts counts = sync.threadSafeState->transferCounts();
+        stats.uploadsPending = counts.mUploads.mPending;
+        stats.downloadsPending = counts.mDownloads.mPending;
+
+        stats.checkpathCalls = sync.mCheckpathTime.count;
+        stats.checkpathTime = sync.mCheckpathTime.milliseconds();
+        stats.syncdownCalls = sync.mSyncdownTime.count;
+        stats.syncdownTime = sync.mSyncdownTime.milliseconds();
+        stats.syncupCalls = sync.mSyncupTime.count;
+        stats.syncupTime = sync.mSyncupTime.milliseconds();
+        stats.cachenodesCalls = sync.mCachenodesTime.count;
+        stats.cachenodesTime = sync.mCachenodesTime.milliseconds();
+        stats.fullRescans = sync.mFullRescans;
+        return true;
+    }
+
+    return false;
+}
+
+bool Syncs::setMaxLocalNodesInRam(handle backupId, uint64_t maxNodes)
+{
+    assert(onSyncThread());
+
+    lock_guard<mutex> g(mSyncVecMutex);
+    for (auto& s : mSyncVec)
+    {
+        if (s->mConfig.mBackupId == backupId)
+        {
+            s->mMaxLocalNodesInRam = maxNodes;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Syncs::loadUnloadedLocalNode(Node* n)
+{
+    if (!mLocalNodesUnloaded || n->localnode || n->type != FILENODE)
+    {
+        return;
+    }
+
+    forEachRunningSync([n](Sync* sync) {
+        sync->loadunloadedfile(n->nodeHandle());
+    });
+}
+
+void Syncs::orderBackupUploads(localnode_vector& uploads) const
+{
+    if (mBackupUploadOrder == BACKUP_UPLOAD_ORDER_FIFO)
+    {
+        return;
+    }
+
+    m_time_t now = m_time();
+    BackupUploadOrder order = mBackupUploadOrder;
+
+    // lower goes first.  logarithms, so that an hour against a day
+    // weighs the same as a megabyte against 24 megabytes
+    auto weight = [now, order](const LocalNode* l) -> double
+    {
+        double age = double(std::max<m_time_t>(now - l->mtime, 0));
+        double size = double(std::max<m_off_t>(l->size, 0));
+
+        switch (order)
+        {
+            case BACKUP_UPLOAD_ORDER_NEWEST_FIRST:
+                return age;
+            case BACKUP_UPLOAD_ORDER_SMALLEST_FIRST:
+                return size;
+            default:
+                return std::log2(age + 1) + std::log2(size + 1);
+        }
+    };
+
+    // stable, so that equally weighted files keep the order of the scan
+    std::stable_sort(uploads.begin(), uploads.end(), [&weight](const LocalNode* a, const LocalNode* b)
+    {
+        return weight(a) < weight(b);
+    });
+}
+
 void Syncs::forEachUnifiedSync(std::function<void(UnifiedSync&)> f)
 {
     for (auto& s : mSyncVec)
@@ -5168,6 +6050,8 @@ bool SyncConfigIOContext::deserialize(SyncConfig& config, JSON& reader, bool isE
     const auto TYPE_BACKUP_STATE    = MAKENAMEID2('b', 's');
     const auto TYPE_ENABLED         = MAKENAMEID2('e', 'n');
     const auto TYPE_FINGERPRINT     = MAKENAMEID2('f', 'p');
+    const auto TYPE_JOURNAL_ID      = MAKENAMEID2('j', 'i');
+    const auto TYPE_JOURNAL_POS     = MAKENAMEID2('j', 'p');
     const auto TYPE_LAST_ERROR      = MAKENAMEID2('l', 'e');
     const auto TYPE_LAST_WARNING    = MAKENAMEID2('l', 'w');
     const auto TYPE_NAME            = MAKENAMEID1('n');
@@ -5192,6 +6076,14 @@ bool SyncConfigIOContext::deserialize(SyncConfig& config, JSON& reader, bool isE
             config.mFilesystemFingerprint = reader.getfp();
             break;
 
+        case TYPE_JOURNAL_ID:
+            config.mChangeJournalId = reader.gethandle(sizeof(handle));
+            break;
+
+        case TYPE_JOURNAL_POS:
+            config.mChangeJournalPosition = reader.getint();
+            break;
+
         case TYPE_LAST_ERROR:
             config.mError =
               static_cast<SyncError>(reader.getint32());
@@ -5304,6 +6196,11 @@ void SyncConfigIOContext::serialize(const SyncConfig& config,
     writer.arg_B64("n", config.mName);
     writer.arg_B64("tp", config.mOriginalPathOfRemoteRootNode);
     writer.arg_fsfp("fp", config.mFilesystemFingerprint);
+    if (config.mChangeJournalPosition)
+    {
+        writer.arg("ji", config.mChangeJournalId, sizeof(handle));
+        writer.arg("jp", config.mChangeJournalPosition);
+    }
     writer.arg("th", config.mRemoteNode);
     writer.arg("le", config.mError);
     writer.arg("lw", config.mWarning);
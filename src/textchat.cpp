@@ -24,6 +24,8 @@
 #include "mega/megaclient.h"
 #include "mega/base64.h"
 
+#include <algorithm>
+
 namespace mega {
 
 #ifdef ENABLE_CHAT
@@ -660,6 +662,10 @@ bool TextChat::serialize(string *d)
 {
     unsigned short ll;
 
+    // the peers take most of the record in large chats
+    d->reserve(d->size() + 64 + title.size() + unifiedKey.size()
+               + (userpriv ? userpriv->size() * (sizeof(handle) + sizeof(privilege_t)) : 0));
+
     d->append((char*)&id, sizeof id);
     d->append((char*)&priv, sizeof priv);
     d->append((char*)&shard, sizeof shard);
@@ -815,6 +821,7 @@ TextChat* TextChat::unserialize(class MegaClient *client, string *d)
         }
 
         userpriv = new userpriv_vector();
+        userpriv->reserve(ll);
 
         for (unsigned short i = 0; i < ll; i++)
         {
@@ -1256,6 +1263,26 @@ bool TextChat::addOrUpdateSchedMeeting(std::unique_ptr<ScheduledMeeting> sm, boo
             : updateSchedMeeting(std::move(sm));
 }
 
+bool TextChat::samePeers(const userpriv_vector* other) const
+{
+    size_t count = userpriv ? userpriv->size() : 0;
+    if (count != (other ? other->size() : 0))
+    {
+        return false;
+    }
+
+    if (!count)
+    {
+        return true;
+    }
+
+    userpriv_vector mine(*userpriv);
+    userpriv_vector theirs(*other);
+    std::sort(mine.begin(), mine.end());
+    std::sort(theirs.begin(), theirs.end());
+    return mine == theirs;
+}
+
 bool TextChat::setMode(bool publicchat)
 {
     if (this->publicchat == publicchat)
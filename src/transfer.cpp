@@ -58,6 +58,137 @@ unsigned TransferCategory::directionIndex()
     return direction;
 }
 
+int64_t TransferTimeline::now()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+const char* TransferTimeline::stageName(int stage)
+{
+    static const char* names[NUM_STAGES] = { "queued", "started", "urlRequested", "urlReceived", "connected", "firstByte", "completed" };
+    return stage >= 0 && stage < NUM_STAGES ? names[stage] : "unknown";
+}
+
+void TransferTimeline::mark(Stage stage, int64_t when)
+{
+    if (!stages[stage] || when < stages[stage])
+    {
+        stages[stage] = when;
+    }
+}
+
+void TransferTimeline::restart()
+{
+    int64_t queued = stages[QUEUED];
+    stages.fill(0);
+    stages[QUEUED] = queued;
+    mark(STARTED);
+
+    connections.clear();
+    attempts++;
+}
+
+void TransferTimeline::requestCompleted(int i, const HttpReqXfer& req, m_off_t speed)
+{
+    if (i < 0 || size_t(i) >= connections.size())
+    {
+        return;
+    }
+
+    // a completed request can be looked at again (downloaded pieces waiting for their turn)
+    Connection& c = connections[size_t(i)];
+    if (!c.requestStart)
+    {
+        return;
+    }
+
+    // the HttpIO only tells once the request is done: place the stages where they happened
+    if (req.timings.newConnection)
+    {
+        mark(CONNECTED, c.requestStart + req.timings.dns + req.timings.connect + req.timings.tls);
+    }
+    if (req.timings.firstByte)
+    {
+        mark(FIRST_BYTE, c.requestStart + req.timings.firstByte);
+    }
+
+    c.requestMs += uint64_t(std::max<int64_t>(now() - c.requestStart, 0));
+    c.requestStart = 0;
+    c.requests++;
+    c.bytes += req.size;
+    c.dnsMs += req.timings.dns;
+    c.connectMs += req.timings.connect;
+    c.tlsMs += req.timings.tls;
+    c.firstByteMs += req.timings.firstByte;
+    c.newConnections += req.timings.newConnection;
+    c.lastSpeed = speed;
+}
+
+string TransferTimeline::toJson(int tag) const
+{
+    JSONWriter writer;
+    writer.beginobject();
+
+    writer.beginobject("stages");
+    for (int i = 0; i < NUM_STAGES; i++)
+    {
+        writer.arg(stageName(i), m_off_t(stages[size_t(i)]));
+    }
+    writer.endobject();
+
+    writer.arg("attempts", m_off_t(attempts));
+    writer.arg("cryptoUs", m_off_t(cryptoUs));
+    writer.arg("diskUs", m_off_t(diskUs));
+
+    writer.beginarray("connections");
+    for (auto& c : connections)
+    {
+        writer.beginobject();
+        writer.arg("requests", m_off_t(c.requests));
+        writer.arg("bytes", m_off_t(c.bytes));
+        writer.arg("requestMs", m_off_t(c.requestMs));
+        writer.arg("dnsMs", m_off_t(c.dnsMs));
+        writer.arg("connectMs", m_off_t(c.connectMs));
+        writer.arg("tlsMs", m_off_t(c.tlsMs));
+        writer.arg("firstByteMs", m_off_t(c.firstByteMs));
+        writer.arg("newConnections", m_off_t(c.newConnections));
+        writer.arg("slowResets", m_off_t(c.slowResets));
+        writer.arg("lastSpeed", c.lastSpeed);
+        writer.endobject();
+    }
+    writer.endarray();
+
+    // each stage lasts until the next one reached, as complete ("X") events in microseconds
+    writer.beginarray("traceEvents");
+    for (int i = 0; i < NUM_STAGES - 1; i++)
+    {
+        int next = i + 1;
+        while (next < COMPLETED && !stages[size_t(next)])
+        {
+            next++;
+        }
+
+        if (!stages[size_t(i)] || !stages[size_t(next)])
+        {
+            continue;
+        }
+
+        writer.beginobject();
+        writer.arg("name", stageName(i));
+        writer.arg("ph", "X");
+        writer.arg("pid", m_off_t(1));
+        writer.arg("tid", m_off_t(tag));
+        writer.arg("ts", m_off_t(stages[size_t(i)] * 1000));
+        writer.arg("dur", m_off_t(std::max<int64_t>(stages[size_t(next)] - stages[size_t(i)], 0) * 1000));
+        writer.endobject();
+    }
+    writer.endarray();
+
+    writer.endobject();
+    return writer.getstring();
+}
+
 Transfer::Transfer(MegaClient* cclient, direction_t ctype)
     : bt(cclient->rng, cclient->transferRetryBackoffs[ctype])
 {
@@ -82,6 +213,8 @@ Transfer::Transfer(MegaClient* cclient, direction_t ctype)
     skipserialization = false;
 
     transfers_it = client->transfers[type].end();
+
+    timeline.mark(TransferTimeline::QUEUED);
 }
 
 // delete transfer with underlying slot, notify files
@@ -129,6 +262,11 @@ Transfer::~Transfer()
         client->asyncfopens--;
     }
 
+    if (localcopy)
+    {
+        localcopy->cancelled = true;
+    }
+
     if (finished)
     {
         if (type == GET && !localfilename.empty())
@@ -423,7 +561,7 @@ void Transfer::removeAndDeleteSelf(transferstate_t finalState)
 
 // transfer attempt failed, notify all related files, collect request on
 // whether to abort the transfer, kill transfer if unanimous
-void Transfer::failed(const Error& e, TransferDbCommitter& committer, dstime timeleft)
+void Transfer::failed(const Error& e, TransferDbCommitter& committer, dstime timeleft, bool keepUploadSession)
 {
     bool defer = false;
 
@@ -530,19 +668,29 @@ void Transfer::failed(const Error& e, TransferDbCommitter& committer, dstime tim
         it++;
     }
 
-    tempurls.clear();
-    if (type == PUT)
+    bool modified = false;
+    if (type == PUT && slot && slot->fa && (slot->fa->mtime != mtime || slot->fa->size != size))
     {
-        chunkmacs.clear();
-        progresscompleted = 0;
-        ultoken.reset();
-        pos = 0;
+        LOG_warn << "Modification detected during active upload. Size: " << size << "  Mtime: " << mtime
+                 << "    FaSize: " << slot->fa->size << "  FaMtime: " << slot->fa->mtime;
+        defer = false;
+        modified = true;
+    }
 
-        if (slot && slot->fa && (slot->fa->mtime != mtime || slot->fa->size != size))
+    if (type == PUT && keepUploadSession && !modified && !tempurls.empty())
+    {
+        // the next slot resumes at the first chunk not confirmed by the server
+        LOG_debug << "Keeping the upload URL, " << progresscompleted << " of " << size << " bytes uploaded";
+    }
+    else
+    {
+        tempurls.clear();
+        if (type == PUT)
         {
-            LOG_warn << "Modification detected during active upload. Size: " << size << "  Mtime: " << mtime
-                     << "    FaSize: " << slot->fa->size << "  FaMtime: " << slot->fa->mtime;
-            defer = false;
+            chunkmacs.clear();
+            progresscompleted = 0;
+            ultoken.reset();
+            pos = 0;
         }
     }
 
@@ -599,7 +747,30 @@ static uint32_t* fileAttributeKeyPtr(byte filekey[FILENODEKEYLENGTH])
 }
 #endif
 
-void Transfer::addAnyMissingMediaFileAttributes(Node* node, /*const*/ LocalPath& localpath)
+BandwidthScheduler::Category Transfer::bandwidthcategory() const
+{
+    BandwidthScheduler::Category category = BandwidthScheduler::BACKUP;
+
+    for (file_list::const_iterator it = files.begin(); it != files.end(); it++)
+    {
+        if (!(*it)->syncxfer)
+        {
+            return BandwidthScheduler::USER;
+        }
+
+#ifdef ENABLE_SYNC
+        LocalNode* l = type == PUT ? dynamic_cast<LocalNode*>(*it) : nullptr;
+        if (!l || !l->sync || !l->sync->isBackup())
+#endif
+        {
+            category = BandwidthScheduler::SYNC;
+        }
+    }
+
+    return files.empty() ? BandwidthScheduler::USER : category;
+}
+
+void Transfer::addAnyMissingMediaFileAttributes(Node* node, /*const*/ LocalPath& localpath, std::unique_ptr<FileAccess> verifiedFile)
 {
     assert(type == PUT || (node && node->type == FILENODE));
 
@@ -618,17 +789,52 @@ void Transfer::addAnyMissingMediaFileAttributes(Node* node, /*const*/ LocalPath&
             // if we don't have the codec id mappings yet, send the request
             client->mediaFileInfo.requestCodecMappingsOneTime(client, LocalPath());
 
-            // always get the attribute string; it may indicate this version of the mediaInfo library was unable to interpret the file
-            MediaProperties vp;
-            vp.extractMediaPropertyFileAttributes(localpath, client->fsaccess.get());
+            // the transfer may be gone by the time the properties are extracted, so the completion keeps its own copies
+            std::array<uint32_t, 4> fakey;
+            std::copy(attrKey, attrKey + 4, fakey.begin());
 
+            bool verified = verifiedFile != nullptr;
+            if (!verifiedFile)
+            {
+                verifiedFile = client->fsaccess->newfileaccess();
+            }
+
+            // always get the attribute string; it may indicate this version of the mediaInfo library was unable to interpret the file
+            MegaClient* c = client;
             if (type == PUT)
             {
-                client->mediaFileInfo.queueMediaPropertiesFileAttributesForUpload(vp, attrKey, client, uploadhandle, this);
+                // hold the putnodes until the properties are known
+                UploadHandle th = uploadhandle;
+                client->fileAttributesUploading.setFileAttributePending(th, fatype(fa_media), this, false);
+
+                client->extractMediaPropertiesAsync(localpath, std::move(verifiedFile), verified, [c, th, fakey](MediaProperties& vp)
+                {
+                    auto uploadFAPtr = c->fileAttributesUploading.lookupExisting(th);
+                    if (!uploadFAPtr)
+                    {
+                        return;  // the upload was cancelled meanwhile
+                    }
+
+                    uint32_t key[4] = { fakey[0], fakey[1], fakey[2], fakey[3] };
+                    if (!c->mediaFileInfo.queueMediaPropertiesFileAttributesForUpload(vp, key, c, th, uploadFAPtr->transfer))
+                    {
+                        // no codec mappings to encode them with: let the upload complete without them
+                        uploadFAPtr->pendingfa.erase(fatype(fa_media));
+                    }
+                    c->checkfacompletion(th);
+                });
             }
             else
             {
-                client->mediaFileInfo.sendOrQueueMediaPropertiesFileAttributesForExistingFile(vp, attrKey, client, node->nodeHandle());
+                NodeHandle nh = node->nodeHandle();
+                client->extractMediaPropertiesAsync(localpath, std::move(verifiedFile), verified, [c, nh, fakey](MediaProperties& vp)
+                {
+                    if (c->nodeByHandle(nh))
+                    {
+                        uint32_t key[4] = { fakey[0], fakey[1], fakey[2], fakey[3] };
+                        c->mediaFileInfo.sendOrQueueMediaPropertiesFileAttributesForExistingFile(vp, key, c, nh);
+                    }
+                });
             }
         }
     }
@@ -641,6 +847,7 @@ void Transfer::complete(TransferDbCommitter& committer)
 {
     CodeCounter::ScopeTimer ccst(client->performanceStats.transferComplete);
 
+    timeline.mark(TransferTimeline::COMPLETED);
     state = TRANSFERSTATE_COMPLETING;
     client->app->transfer_update(this);
 
@@ -893,7 +1100,7 @@ void Transfer::complete(TransferDbCommitter& committer)
                         LOG_debug << "Identical node downloaded to the same folder";
                         success = true;
                     }
-                    else if (client->fsaccess->copylocal(!tmplocalname.empty() ? tmplocalname : localfilename,
+                    else if (client->fsaccess->cloneFile(!tmplocalname.empty() ? tmplocalname : localfilename,
                                                    localname, mtime))
                     {
                         success = true;
@@ -904,6 +1111,11 @@ void Transfer::complete(TransferDbCommitter& committer)
                     }
                 }
 
+                if (success && client->localdownloaddedup && fingerprint.isvalid)
+                {
+                    client->localFingerprints.add(fingerprint, localname);
+                }
+
                 if (success)
                 {
                     // set missing node attributes
@@ -1027,6 +1239,10 @@ void Transfer::complete(TransferDbCommitter& committer)
             slot->fa.reset();
         }
 
+        // the check of localfilename is kept for the media attributes probe, so the file is opened once for both
+        std::unique_ptr<FileAccess> verifiedfa;
+        FileFingerprint verifiedfp;
+
         // files must not change during a PUT transfer
         for (file_list::iterator it = files.begin(); it != files.end(); )
         {
@@ -1065,6 +1281,13 @@ void Transfer::complete(TransferDbCommitter& committer)
                 LOG_debug << "Verifying regular upload";
             }
 
+            if (verifiedfa && localpath == localfilename && f->fingerprint() == verifiedfp)
+            {
+                // same file, same expectations: verified already
+                it++;
+                continue;
+            }
+
             auto fa = client->fsaccess->newfileaccess();
             bool isOpen = fa->fopen(localpath);
             if (!isOpen)
@@ -1100,6 +1323,12 @@ void Transfer::complete(TransferDbCommitter& committer)
             }
             else
             {
+                if (!verifiedfa && localpath == localfilename)
+                {
+                    verifiedfp = f->fingerprint();
+                    verifiedfa = std::move(fa);
+                }
+
                 it++;
             }
         }
@@ -1113,7 +1342,7 @@ void Transfer::complete(TransferDbCommitter& committer)
         if (!client->gfxdisabled)
         {
             // prepare file attributes for video/audio files if the file is suitable
-            addAnyMissingMediaFileAttributes(NULL, localfilename);
+            addAnyMissingMediaFileAttributes(NULL, localfilename, std::move(verifiedfa));
         }
 
         // if this transfer is put on hold, do not complete
@@ -1149,6 +1378,9 @@ void Transfer::completefiles()
     ids.push_back(dbid);
 }
 
+const m_off_t DirectReadNode::MIN_READAHEAD;
+const m_off_t DirectReadNode::MAX_READAHEAD;
+
 DirectReadNode::DirectReadNode(MegaClient* cclient, handle ch, bool cp, SymmCipher* csymmcipher, int64_t cctriv, const char *privauth, const char *pubauth, const char *cauth)
 {
     client = cclient;
@@ -1177,6 +1409,9 @@ DirectReadNode::DirectReadNode(MegaClient* cclient, handle ch, bool cp, SymmCiph
     retries = 0;
     size = 0;
 
+    readahead = MIN_READAHEAD;
+    lastreadend = -1;
+
     pendingcmd = NULL;
 
     dsdrn_it = client->dsdrns.end();
@@ -1308,10 +1543,16 @@ void DirectReadNode::cmdresult(const Error &e, dstime timeleft)
             DirectRead* dr = *it;
             assert(dr->drq_it == client->drq.end());
 
+            if (dr->leader)
+            {
+                // served by the read it follows
+                continue;
+            }
+
             if (dr->drbuf.tempUrlVector().empty())
             {
                 // DirectRead starting
-                dr->drbuf.setIsRaid(dr->drn->tempurls, dr->offset, dr->offset + dr->count, dr->drn->size, 2097152);  // 2 MB max buffer usage approx for streaming
+                dr->startbuffering();
             }
             else
             {
@@ -1348,9 +1589,114 @@ void DirectReadNode::schedule(dstime deltads)
     }
 }
 
-void DirectReadNode::enqueue(m_off_t offset, m_off_t count, int reqtag, void* appdata)
+void DirectReadNode::enqueue(m_off_t offset, m_off_t count, int reqtag, void* appdata, bool sequential)
+{
+    new DirectRead(this, count, offset, reqtag, appdata, sequential);
+}
+
+m_off_t DirectReadNode::readaheadfor(m_off_t offset)
+{
+    if (lastreadend >= 0 && offset == lastreadend)
+    {
+        readahead = std::min<m_off_t>(readahead * 2, MAX_READAHEAD);
+    }
+    else
+    {
+        readahead = MIN_READAHEAD;
+    }
+    return readahead;
+}
+
+m_off_t DirectReadNode::sequentialreadahead(m_off_t offset)
+{
+    readahead = MAX_READAHEAD;
+    return ChunkedHash::chunkceil(offset + MAX_READAHEAD) - offset;
+}
+
+DirectReadCache::DirectReadCache(size_t maxBytes)
+    : mMaxBytes(maxBytes)
 {
-    new DirectRead(this, count, offset, reqtag, appdata);
+}
+
+void DirectReadCache::add(m_off_t pos, const byte* data, size_t len)
+{
+    if (!len || len > mMaxBytes)
+    {
+        return;
+    }
+
+    // skip what the range starting before pos already covers
+    auto it = mRanges.upper_bound(pos);
+    if (it != mRanges.begin())
+    {
+        auto prev = std::prev(it);
+        m_off_t prevEnd = prev->first + m_off_t(prev->second.size());
+        if (prevEnd > pos)
+        {
+            size_t skip = size_t(std::min<m_off_t>(prevEnd - pos, m_off_t(len)));
+            pos += skip;
+            data += skip;
+            len -= skip;
+            if (!len)
+            {
+                return;
+            }
+        }
+    }
+
+    // and stop at the next cached range
+    if (it != mRanges.end() && it->first < pos + m_off_t(len))
+    {
+        len = size_t(it->first - pos);
+    }
+
+    mRanges.emplace_hint(it, pos, string(reinterpret_cast<const char*>(data), len));
+    mOrder.push_back(pos);
+    mBytes += len;
+
+    while (mBytes > mMaxBytes && !mOrder.empty())
+    {
+        auto victim = mRanges.find(mOrder.front());
+        mOrder.pop_front();
+        if (victim != mRanges.end())
+        {
+            mBytes -= victim->second.size();
+            mRanges.erase(victim);
+        }
+    }
+}
+
+size_t DirectReadCache::read(m_off_t pos, size_t maxLen, string& out) const
+{
+    size_t copied = 0;
+    while (copied < maxLen)
+    {
+        auto it = mRanges.upper_bound(pos);
+        if (it == mRanges.begin())
+        {
+            break;
+        }
+        --it;
+
+        m_off_t rangeEnd = it->first + m_off_t(it->second.size());
+        if (rangeEnd <= pos)
+        {
+            break;
+        }
+
+        size_t n = size_t(std::min<m_off_t>(rangeEnd - pos, m_off_t(maxLen - copied)));
+        out.append(it->second, size_t(pos - it->first), n);
+        pos += n;
+        copied += n;
+    }
+    return copied;
+}
+
+void DirectReadCache::clear()
+{
+    mRanges.clear();
+    mOrder.clear();
+    mBytes = 0;
 }
 
 bool DirectReadSlot::processAnyOutputPieces()
@@ -1365,6 +1711,9 @@ bool DirectReadSlot::processAnyOutputPieces()
         dr->drn->client->httpio->updatedownloadspeed(len);
         continueDirectRead = dr->drn->client->app->pread_data(outputPiece->buf.datastart(), len, pos, speed, meanSpeed, dr->appdata);
 
+        dr->drn->cache.add(pos, outputPiece->buf.datastart(), len);
+        dr->drn->lastreadend = pos + m_off_t(len);
+        dr->fanout(outputPiece->buf.datastart(), m_off_t(len), pos, speed, meanSpeed);
         dr->drbuf.bufferWriteCompleted(0, true);
 
         if (continueDirectRead)
@@ -1377,52 +1726,105 @@ bool DirectReadSlot::processAnyOutputPieces()
     return continueDirectRead;
 }
 
+bool DirectReadSlot::processCachedPrefix()
+{
+    if (dr->cachedprefix.empty())
+    {
+        return true;
+    }
+
+    string prefix;
+    prefix.swap(dr->cachedprefix);
+
+    LOG_debug << "Serving " << prefix.size() << " streaming bytes from cache at " << pos;
+    bool continueDirectRead = dr->drn->client->app->pread_data((byte*)prefix.data(), m_off_t(prefix.size()), pos, speed, meanSpeed, dr->appdata);
+    dr->drn->lastreadend = pos + m_off_t(prefix.size());
+
+    if (continueDirectRead)
+    {
+        pos += prefix.size();
+        dr->progress += prefix.size();
+    }
+    return continueDirectRead;
+}
+
 bool DirectReadSlot::doio()
 {
+    if (!processCachedPrefix())
+    {
+        // app-requested abort
+        delete dr;
+        return true;
+    }
+
+    if (dr->count && dr->progress == dr->count)
+    {
+        // the whole range came from the cache
+        dr->drn->schedule(DirectReadSlot::TEMPURL_TIMEOUT_DS);
+        delete dr;
+        return true;
+    }
+
     for (unsigned connectionNum = unsigned(reqs.size()); connectionNum--; )
     {
         HttpReq* req = reqs[connectionNum];
 
         if (req->status == REQ_INFLIGHT || req->status == REQ_SUCCESS)
         {
-            if (req->in.size())
+            bool submitted = false;
+
+            // full receive segments become pieces as they are
+            for (auto segment : req->segments)
             {
-                unsigned n = unsigned(req->in.size());
+                m_off_t n = m_off_t(segment->datalen());
+                dr->drbuf.submitBuffer(connectionNum, new RaidBufferManager::FilePiece(req->pos, segment));
+                req->pos += n;
+                submitted = true;
+            }
+            req->segments.clear();
 
-                if (req->status == REQ_INFLIGHT)
+            // at the end of the response, so does the rest of the current one.  While in flight, only copy out
+            // a partial segment when data is trickling in, so streaming latency stays bounded.
+            unsigned pending = unsigned(req->bufpos - m_off_t(req->inpurge));
+            if (pending && req->status == REQ_SUCCESS)
+            {
+                dr->drbuf.submitBuffer(connectionNum, new RaidBufferManager::FilePiece(req->pos, req->releasesegment()));
+                req->pos += pending;
+                submitted = true;
+            }
+            else if (pending && !submitted && Waiter::ds - lastHandoffDs[connectionNum] >= PARTIAL_SEGMENT_DELAY_DS)
+            {
+                // raid reassembly logic needs to operate on whole raidlines
+                pending -= pending % RAIDSECTOR;
+                if (pending)
                 {
-                    // raid reassembly logic needs to operate on whole raidlines
-                    n -= n % RAIDSECTOR;
+                    RaidBufferManager::FilePiece* np = new RaidBufferManager::FilePiece(req->pos, pending);
+                    memcpy(np->buf.datastart(), req->buf + req->inpurge, pending);
+                    req->inpurge += pending;
+                    req->pos += pending;
+                    dr->drbuf.submitBuffer(connectionNum, np);
+                    submitted = true;
                 }
+            }
 
-                if (n)
-                {
-
-                    RaidBufferManager::FilePiece* np = new RaidBufferManager::FilePiece(req->pos, n);
-                    memcpy(np->buf.datastart(), req->in.data(), n);
-
-                    req->in.erase(0, n);
-                    req->contentlength -= n;
-                    req->bufpos = 0;
-                    req->pos += n;
-
-                    dr->drbuf.submitBuffer(connectionNum, np);
+            if (submitted)
+            {
+                lastHandoffDs[connectionNum] = Waiter::ds;
 
-                    if (req->httpio)
-                    {
-                        req->httpio->lastdata = Waiter::ds;
-                        req->lastdata = Waiter::ds;
-                    }
+                if (req->httpio)
+                {
+                    req->httpio->lastdata = Waiter::ds;
+                    req->lastdata = Waiter::ds;
+                }
 
-                    dr->drn->schedule(DirectReadSlot::TIMEOUT_DS);
+                dr->drn->schedule(DirectReadSlot::TIMEOUT_DS);
 
-                    // we might have a raid-reassembled block to write now, or this very block in non-raid
-                    if (!processAnyOutputPieces())
-                    {
-                        // app-requested abort
-                        delete dr;
-                        return true;
-                    }
+                // we might have a raid-reassembled block to write now, or this very block in non-raid
+                if (!processAnyOutputPieces())
+                {
+                    // app-requested abort
+                    delete dr;
+                    return true;
                 }
             }
 
@@ -1526,12 +1928,71 @@ bool DirectReadSlot::doio()
     return false;
 }
 
+m_off_t DirectRead::nextpos() const
+{
+    return offset + progress + m_off_t(cachedprefix.size());
+}
+
+m_off_t DirectRead::endpos() const
+{
+    return count ? offset + count : drn->size;
+}
+
+void DirectRead::fanout(byte* data, m_off_t len, m_off_t pos, m_off_t speed, m_off_t meanSpeed)
+{
+    // followers may end (and leave the list) as they are served
+    std::vector<DirectRead*> waiting(followers);
+    for (DirectRead* follower : waiting)
+    {
+        m_off_t from = follower->nextpos();
+        if (from < pos || from >= pos + len)
+        {
+            continue;
+        }
+
+        m_off_t n = std::min(pos + len, follower->endpos()) - from;
+        if (!drn->client->app->pread_data(data + (from - pos), n, from, speed, meanSpeed, follower->appdata))
+        {
+            // app-requested abort
+            delete follower;
+            continue;
+        }
+
+        follower->progress += n;
+        if (follower->nextpos() >= follower->endpos())
+        {
+            delete follower;
+        }
+    }
+}
+
+void DirectRead::queuefetch()
+{
+    if (!drn->tempurls.empty() && drq_it == drn->client->drq.end() && !drs)
+    {
+        startbuffering();
+        drq_it = drn->client->drq.insert(drn->client->drq.end(), this);
+    }
+}
+
 // abort active read, remove from pending queue
 void DirectRead::abort()
 {
     delete drs;
     drs = NULL;
 
+    // neither follow nor lead other reads: all of them fetch on their own when restarted
+    if (leader)
+    {
+        leader->followers.erase(std::find(leader->followers.begin(), leader->followers.end(), this));
+        leader = nullptr;
+    }
+    for (DirectRead* follower : followers)
+    {
+        follower->leader = nullptr;
+    }
+    followers.clear();
+
     if (drq_it != drn->client->drq.end())
     {
         drn->client->drq.erase(drq_it);
@@ -1539,7 +2000,7 @@ void DirectRead::abort()
     }
 }
 
-DirectRead::DirectRead(DirectReadNode* cdrn, m_off_t ccount, m_off_t coffset, int creqtag, void* cappdata)
+DirectRead::DirectRead(DirectReadNode* cdrn, m_off_t ccount, m_off_t coffset, int creqtag, void* cappdata, bool sequential)
     : drbuf(this)
 {
     drn = cdrn;
@@ -1551,13 +2012,40 @@ DirectRead::DirectRead(DirectReadNode* cdrn, m_off_t ccount, m_off_t coffset, in
     appdata = cappdata;
 
     drs = NULL;
+    leader = nullptr;
+
+    maxrequestsize = sequential ? drn->sequentialreadahead(offset) : drn->readaheadfor(offset);
+    if (count > 0)
+    {
+        drn->cache.read(offset, size_t(count), cachedprefix);
+    }
+
+    // a read starting inside the range still to be fetched by another read of the node just waits for
+    // those bytes, so concurrent readers of nearby ranges share the requests
+    if (cachedprefix.empty())
+    {
+        for (DirectRead* other : drn->reads)
+        {
+            if (!other->leader && other->nextpos() <= offset && offset < other->endpos())
+            {
+                LOG_debug << "Streaming read at " << offset << " joins the one fetching up to " << other->endpos();
+                leader = other;
+                other->followers.push_back(this);
+                break;
+            }
+        }
+    }
 
     reads_it = drn->reads.insert(drn->reads.end(), this);
 
-    if (!drn->tempurls.empty())
+    if (leader)
+    {
+        drq_it = drn->client->drq.end();
+    }
+    else if (!drn->tempurls.empty())
     {
         // we already have tempurl(s): queue for immediate fetching
-        drbuf.setIsRaid(drn->tempurls, offset, offset + count, drn->size, 2097152);  // 2 MB max buffer usage approx
+        startbuffering();
         drq_it = drn->client->drq.insert(drn->client->drq.end(), this);
     }
     else
@@ -1567,10 +2055,23 @@ DirectRead::DirectRead(DirectReadNode* cdrn, m_off_t ccount, m_off_t coffset, in
     }
 }
 
+void DirectRead::startbuffering()
+{
+    drbuf.setIsRaid(drn->tempurls, nextpos(), offset + count, drn->size, maxrequestsize);
+}
+
 DirectRead::~DirectRead()
 {
+    std::vector<DirectRead*> released(followers);
+
     abort();
 
+    // what this read didn't get to fetch for its followers, they fetch themselves
+    for (DirectRead* follower : released)
+    {
+        follower->queuefetch();
+    }
+
     if (reads_it != drn->reads.end())
     {
         drn->reads.erase(reads_it);
@@ -1623,7 +2124,10 @@ DirectReadSlot::DirectReadSlot(DirectRead* cdr)
         reqs.push_back(new HttpReq(true));
         reqs.back()->status = REQ_READY;
         reqs.back()->type = REQ_BINARY;
+        reqs.back()->segmentsize = RECEIVE_SEGMENT_SIZE;
+        reqs.back()->bandwidthcategory = BandwidthScheduler::STREAMING;
     }
+    lastHandoffDs.assign(reqs.size(), Waiter::ds);
 
     drs_it = dr->drn->client->drss.insert(dr->drn->client->drss.end(), this);
 
@@ -1654,6 +2158,8 @@ TransferList::TransferList()
 
 void TransferList::addtransfer(Transfer *transfer, TransferDbCommitter& committer, bool startFirst)
 {
+    schedulingChanged();
+
     if (transfer->state != TRANSFERSTATE_PAUSED)
     {
         transfer->state = TRANSFERSTATE_QUEUED;
@@ -1690,6 +2196,8 @@ void TransferList::addtransfer(Transfer *transfer, TransferDbCommitter& committe
 
 void TransferList::removetransfer(Transfer *transfer)
 {
+    schedulingChanged();
+
     transfer_list::iterator it;
     if (getIterator(transfer, it, true))
     {
@@ -1736,6 +2244,8 @@ void TransferList::movetransfer(Transfer *transfer, transfer_list::iterator dsti
 
 void TransferList::movetransfer(transfer_list::iterator it, transfer_list::iterator dstit, TransferDbCommitter& committer)
 {
+    schedulingChanged();
+
     if (it == dstit)
     {
         LOG_warn << "Trying to move before the same transfer";
@@ -1910,6 +2420,8 @@ error TransferList::pause(Transfer *transfer, bool enable, TransferDbCommitter&
         return API_OK;
     }
 
+    schedulingChanged();
+
     if (!enable)
     {
         transfer->state = TRANSFERSTATE_QUEUED;
@@ -1991,6 +2503,21 @@ std::array<vector<Transfer*>, 6> TransferList::nexttransfers(std::function<bool(
 
     for (direction_t direction : putget)
     {
+        // nothing could be started last time and nothing relevant happened since: skip the walk
+        if (mIdle[direction] && mIdleChanges[direction] == mSchedulingChanges && Waiter::ds < mIdleUntilDs[direction])
+        {
+            continue;
+        }
+        mIdle[direction] = false;
+
+        // per category: stop offering once the category is full (both full ends the walk)
+        bool continueLarge = true;
+        bool continueSmall = true;
+
+        bool candidates = false;
+        bool walkedAll = true;
+        dstime nextRetryDs = Waiter::ds + MAX_IDLE_DS;
+
         for (Transfer *transfer : transfers[direction])
         {
             if (!transfer->slot)
@@ -2005,15 +2532,30 @@ std::array<vector<Transfer*>, 6> TransferList::nexttransfers(std::function<bool(
             }
 
             // don't traverse the whole list if we already have as many as we are going to get
-            if (!directionContinuefunction(direction)) break;
+            if (!directionContinuefunction(direction))
+            {
+                walkedAll = false;
+                break;
+            }
 
-            bool continueLarge = true;
-            bool continueSmall = true;
+            if (transfer->asyncopencontext)
+            {
+                // its completion is polled, not notified
+                candidates = true;
+            }
+            else if (!transfer->slot
+                     && (transfer->state == TRANSFERSTATE_QUEUED || transfer->state == TRANSFERSTATE_RETRYING)
+                     && !transfer->bt.armed() && transfer->bt.nextset() && transfer->bt.nextset() < nextRetryDs)
+            {
+                nextRetryDs = transfer->bt.nextset();
+            }
 
             if ((!transfer->slot && isReady(transfer))
                 || (transfer->asyncopencontext
                     && transfer->asyncopencontext->finished))
             {
+                candidates = true;
+
                 TransferCategory tc(transfer);
 
                 if (tc.sizetype == LARGEFILE && continueLarge)
@@ -2034,10 +2576,18 @@ std::array<vector<Transfer*>, 6> TransferList::nexttransfers(std::function<bool(
                 }
                 if (!continueLarge && !continueSmall)
                 {
+                    walkedAll = false;
                     break;
                 }
             }
         }
+
+        if (walkedAll && !candidates)
+        {
+            mIdle[direction] = true;
+            mIdleChanges[direction] = mSchedulingChanges;
+            mIdleUntilDs[direction] = nextRetryDs;
+        }
     }
     return chosenTransfers;
 }
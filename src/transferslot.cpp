@@ -33,6 +33,12 @@
 
 namespace mega {
 
+// for the transfer timeline
+static uint64_t elapsedUs(std::chrono::steady_clock::time_point start)
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
 TransferSlotFileAccess::TransferSlotFileAccess(std::unique_ptr<FileAccess>&& p, Transfer* t)
     : transfer(t)
 {
@@ -71,6 +77,10 @@ const dstime TransferSlot::PROGRESSTIMEOUT = 10;
 
 const m_off_t TransferSlot::MAX_GAP_SIZE = 256 * 1024 * 1024; // 256 MB
 
+const m_off_t TransferSlot::MAX_COALESCED_WRITE = 32 * 1024 * 1024; // 32 MB
+
+const m_off_t TransferSlot::MIN_MAPPED_UPLOAD = 16 * 1024 * 1024; // 16 MB
+
 TransferSlot::TransferSlot(Transfer* ctransfer)
     : fa(ctransfer->client->fsaccess->newfileaccess(), ctransfer)
     , retrybt(ctransfer->client->rng, ctransfer->client->transferSlotsBackoff)
@@ -94,6 +104,7 @@ TransferSlot::TransferSlot(Transfer* ctransfer)
     transfer = ctransfer;
     transfer->slot = this;
     transfer->state = TRANSFERSTATE_ACTIVE;
+    transfer->timeline.restart();
 
     slots_it = transfer->client->tslots.end();
 
@@ -152,11 +163,83 @@ bool TransferSlot::createconnectionsonce()
         LOG_debug << "Populating transfer slot with " << connections << " connections, max request size of " << maxRequestSize << " bytes";
         reqs.resize(connections);
         mReqSpeeds.resize(connections);
+        mRequestSizes.setConnections(unsigned(connections));
+        mRaidHedges.setConnections(unsigned(connections));
+        transfer->timeline.connections.resize(size_t(connections));
         asyncIO = new AsyncIOContext*[connections]();
+
+        MegaClient* client = transfer->client;
+        if (transfer->type == PUT && client->mapuploadsources && transfer->size >= MIN_MAPPED_UPLOAD)
+        {
+            // page faults on a network share can stall for as long as the server does
+            mMappedReads = !isNetworkFilesystem(client->fsaccess->getlocalfstype(transfer->localfilename));
+            LOG_debug << "Upload chunks " << (mMappedReads ? "mapped" : "read (network filesystem)");
+        }
     }
     return true;
 }
 
+void TransferSlot::adjustconnections(MegaClient* client)
+{
+    if (transferbuf.isRaid() || !client->autoconnections[transfer->type] || transfer->size <= 131072)
+    {
+        return;
+    }
+
+    if (connections == mWantedConnections || !mWantedConnections)
+    {
+        unsigned others = 0;
+        for (TransferSlot* ts : client->tslots)
+        {
+            if (ts != this)
+            {
+                others += unsigned(ts->connections);
+            }
+        }
+
+        unsigned limit = client->connectionbudget > others ? client->connectionbudget - others : 1;
+        limit = std::min<unsigned>(limit, unsigned(MegaClient::MAX_NUM_CONNECTIONS));
+        mWantedConnections = int(mConnectionCount.evaluate(unsigned(connections), mTransferSpeed.calculateSpeed(), limit, Waiter::ds));
+    }
+
+    while (connections < mWantedConnections)
+    {
+        AsyncIOContext** grown = new AsyncIOContext*[connections + 1]();
+        std::copy(asyncIO, asyncIO + connections, grown);
+        delete[] asyncIO;
+        asyncIO = grown;
+
+        ++connections;
+        reqs.resize(connections);
+        mReqSpeeds.resize(connections);
+        mRequestSizes.setConnections(unsigned(connections));
+        if (transfer->timeline.connections.size() < size_t(connections))
+        {
+            // those that go keep their figures, for the timeline
+            transfer->timeline.connections.resize(size_t(connections));
+        }
+        LOG_debug << "Transfer slot now using " << connections << " connections";
+    }
+
+    // only a connection with nothing in flight or waiting to be written can go
+    while (connections > mWantedConnections)
+    {
+        int last = connections - 1;
+        if ((reqs[last] && reqs[last]->status != REQ_READY)
+                || asyncIO[last]
+                || transferbuf.getAsyncOutputBufferPointer(unsigned(last)))
+        {
+            break;
+        }
+
+        --connections;
+        reqs.resize(connections);
+        mReqSpeeds.resize(connections);
+        mRequestSizes.setConnections(unsigned(connections));
+        LOG_debug << "Transfer slot now using " << connections << " connections";
+    }
+}
+
 // delete slot and associated resources, but keep transfer intact (can be
 // reused on a new slot)
 TransferSlot::~TransferSlot()
@@ -273,7 +356,14 @@ TransferSlot::~TransferSlot()
         }
     }
 
+    // progress coalesced by transfercacheprogress() that did not reach the cache yet
+    if (transfer->progressNotCached)
+    {
+        transfer->client->transfercacheadd(transfer, nullptr);
+    }
+
     transfer->slot = NULL;
+    transfer->client->transferlist.schedulingChanged();
 
     if (slots_it != transfer->client->tslots.end())
     {
@@ -307,6 +397,34 @@ TransferSlot::~TransferSlot()
     delete[] asyncIO;
 }
 
+void TransferSlot::queueUploadEncryption(MegaClient* client, int i, m_off_t pos, m_off_t npos)
+{
+    string finaltempurl = transferbuf.tempURL(i);
+    if (client->usealtupport && !memcmp(finaltempurl.c_str(), "http:", 5))
+    {
+        size_t index = finaltempurl.find("/", 8);
+        if(index != string::npos && finaltempurl.find(":", 8) == string::npos)
+        {
+            finaltempurl.insert(index, ":8080");
+        }
+    }
+
+    auto req = reqs[i];    // shared_ptr so no object is deleted out from under the worker
+    auto transferkey = transfer->transferkey;
+    auto ctriv = transfer->ctriv;
+    req->pos = pos;
+    req->status = REQ_ENCRYPTING;
+
+    client->mAsyncQueue.push([req, transferkey, ctriv, finaltempurl, pos, npos](SymmCipher& sc)
+        {
+            auto start = std::chrono::steady_clock::now();
+            sc.setkey(transferkey.data());
+            req->prepare(finaltempurl.c_str(), &sc, ctriv, pos, npos);
+            req->cryptoUs += elapsedUs(start);
+            req->status = REQ_PREPARED;
+        }, true);   // discardable - if the transfer or client are being destroyed, we won't be sending that data.
+}
+
 void TransferSlot::toggleport(HttpReqXfer *req)
 {
     if (!memcmp(req->posturl.c_str(), "http:", 5))
@@ -452,6 +570,17 @@ bool TransferSlot::testForSlowRaidConnection(unsigned connectionNum, bool& incre
             return true;
         }
 
+        // a part that went quiet for longer than almost all the part requests so far took to complete
+        // is most likely stalled: rebuild its lines from the other five rather than wait for it
+        dstime stalledDs = Waiter::ds - reqs[connectionNum]->lastdata;
+        if (!transferbuf.isUnusedRaidConection(connectionNum) && mRaidHedges.shouldHedge(stalledDs))
+        {
+            LOG_warn << "Raid connection " << connectionNum << " has not received data for " << stalledDs
+                     << " deciseconds, beyond the usual request time of " << mRaidHedges.stallThresholdDs() << " deciseconds";
+            incrementErrors = false;
+            return true;
+        }
+
         if (!transferbuf.isUnusedRaidConection(connectionNum)           // connection in use
                 && mReqSpeeds[connectionNum].requestElapsedDs() > 50    // enough elapsed time to be considered
                 && mRaidChannelSwapsForSlowness < 2)                    // no more than 2 swaps due to slown connections
@@ -545,6 +674,8 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
         return;
     }
 
+    adjustconnections(client);
+
     dstime backoff = 0;
     m_off_t p = 0;
     bool earliestUploadCompleted = false;
@@ -555,6 +686,9 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
         return transfer->failed(lasterror, committer);
     }
 
+    // async writes of the pieces decrypted on several connections go to the OS together
+    AsyncWriteBatch asyncWrites(*client->fsaccess);
+
     // main loop over connections
     for (int i = connections; i--; )
     {
@@ -564,6 +698,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
             if (transfer->type == GET && reqs[i]->contentlength == reqs[i]->size && transferbuf.detectSlowestRaidConnection(i, slowestStartConnection))
             {
                 LOG_debug << "Connection " << slowestStartConnection << " is the slowest to reply, using the other 5.";
+                transfer->timeline.connections[slowestStartConnection].slowResets++;
                 reqs[slowestStartConnection].reset();
                 transferbuf.resetPart(slowestStartConnection);
                 i = connections;
@@ -602,6 +737,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                         if (tryRaidRecoveryFromHttpGetError(i, incrementErrors))
                         {
                             LOG_warn << "Connection " << i << " is slow or stalled, trying the other 5 cloudraid connections";
+                            transfer->timeline.connections[size_t(i)].slowResets++;
                             reqs[i]->disconnect();
                             reqs[i]->status = REQ_READY;
                         }
@@ -619,6 +755,12 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                 {
                     m_off_t delta = mReqSpeeds[i].requestProgressed(reqs[i]->size);
                     mTransferSpeed.calculateSpeed(delta);
+                    mRequestSizes.requestCompleted(i, reqs[i]->size, mReqSpeeds[i].requestElapsedDs(), mReqSpeeds[i].requestFirstByteDs());
+                    if (transferbuf.isRaid())
+                    {
+                        mRaidHedges.requestCompleted(unsigned(i), mReqSpeeds[i].requestElapsedDs());
+                    }
+                    transfer->timeline.requestCompleted(i, *reqs[i], mReqSpeeds[i].lastRequestSpeed());
 
                     if (client->orderdownloadedchunks && transfer->type == GET && !transferbuf.isRaid() && transfer->progresscompleted != static_cast<HttpReqDL*>(reqs[i].get())->dlpos)
                     {
@@ -632,13 +774,15 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
 
                     if (!transferbuf.isRaid())
                     {
-                        LOG_debug << "Transfer request finished (" << transfer->type << ") Position: " << transferbuf.transferPos(i) << " (" << transfer->pos << ") Size: " << reqs[i]->size
-                            << " Completed: " << (transfer->progresscompleted + reqs[i]->size) << " of " << transfer->size << " speed " << mReqSpeeds[i].lastRequestSpeed();
+                        LOGF_debug("Transfer request finished ({}) Position: {} ({}) Size: {} Completed: {} of {} speed {}",
+                                   transfer->type, transferbuf.transferPos(i), transfer->pos, reqs[i]->size,
+                                   transfer->progresscompleted + reqs[i]->size, transfer->size, mReqSpeeds[i].lastRequestSpeed());
                     }
                     else
                     {
-                        LOG_debug << "Transfer request finished (" << transfer->type << ") " << " on connection " << i << " part pos: " << transferbuf.transferPos(i) << " of part size " << transferbuf.raidPartSize(i, transfer->size)
-                            << " Overall Completed: " << (transfer->progresscompleted) << " of " << transfer->size << " speed " << mReqSpeeds[i].lastRequestSpeed();
+                        LOGF_debug("Transfer request finished ({})  on connection {} part pos: {} of part size {} Overall Completed: {} of {} speed {}",
+                                   transfer->type, i, transferbuf.transferPos(i), transferbuf.raidPartSize(i, transfer->size),
+                                   transfer->progresscompleted, transfer->size, mReqSpeeds[i].lastRequestSpeed());
                     }
 
                     if (transfer->type == PUT)
@@ -754,8 +898,8 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                                 return transfer->failed(API_EAGAIN, committer);
                             }
 
-                            // fail with returned error
-                            return transfer->failed(e, committer);
+                            // fail with returned error (the upload can continue once there is storage again)
+                            return transfer->failed(e, committer, 0, e == API_EOVERQUOTA);
                         }
 
                         transfer->chunkmacs.finishedUploadChunks(static_cast<HttpReqUL*>(reqs[i].get())->mChunkmacs);
@@ -772,7 +916,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
 
                         errorcount = 0;
                         transfer->failcount = 0;
-                        client->transfercacheadd(transfer, &committer);
+                        client->transfercacheprogress(transfer, &committer);
                         reqs[i]->status = REQ_READY;
 
                         DEBUG_TEST_HOOK_UPLOADCHUNK_SUCCEEDED(transfer, committer);  // this will return if the hook returns false
@@ -812,7 +956,10 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                             if (outputPiece)
                             {
                                 mRaidChannelSwapsForSlowness = 0;
+                                mRaidHedges.progressed();
+                                auto start = std::chrono::steady_clock::now();
                                 bool parallelNeeded = outputPiece->finalize(false, transfer->size, transfer->ctriv, transfer->transfercipher(), &transfer->chunkmacs);
+                                transfer->timeline.cryptoUs += elapsedUs(start);
 
                                 if (parallelNeeded)
                                 {
@@ -825,8 +972,10 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
 
                                     client->mAsyncQueue.push([req, outputPiece, transferkey, ctriv, filesize](SymmCipher& sc)
                                     {
+                                        auto start = std::chrono::steady_clock::now();
                                         sc.setkey(transferkey.data());
                                         outputPiece->finalize(true, filesize, ctriv, &sc, nullptr);
+                                        req->cryptoUs += elapsedUs(start);
                                         req->status = REQ_DECRYPTED;
                                     }, false);  // not discardable:  if we downloaded the data, don't waste it - decrypt and write as much as we can to file
                                 }
@@ -880,6 +1029,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
 
                         // this must return the same piece we just decrypted, since we have not asked the transferbuf to discard it yet.
                         auto outputPiece = transferbuf.getAsyncOutputBufferPointer(i);
+                        transfer->timeline.cryptoUs += reqs[i]->cryptoUs.exchange(0);
 
                         if (fa->asyncavailable())
                         {
@@ -892,15 +1042,59 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
 
                             p += outputPiece->buf.datalen();
 
-                            LOG_debug << "Writing data asynchronously at " << outputPiece->pos << " to " << (outputPiece->pos + outputPiece->buf.datalen());
+                            LOGF_debug("Writing data asynchronously at {} to {}", outputPiece->pos, outputPiece->pos + outputPiece->buf.datalen());
                             asyncIO[i] = fa->asyncfwrite(outputPiece->buf.datastart(), static_cast<unsigned>(outputPiece->buf.datalen()), outputPiece->pos);
                             reqs[i]->status = REQ_ASYNCIO;
                         }
                         else
                         {
-                            if (fa->fwrite(outputPiece->buf.datastart(), static_cast<unsigned>(outputPiece->buf.datalen()), outputPiece->pos))
+                            // write-behind: pieces decrypted on other connections that continue this one
+                            // on disk go out in the same gather write, so raid stripes land as one large write
+                            std::vector<int> writeGroup(1, i);
+                            std::vector<const byte*> writeBufs(1, outputPiece->buf.datastart());
+                            std::vector<unsigned> writeLens(1, static_cast<unsigned>(outputPiece->buf.datalen()));
+                            m_off_t writeEnd = outputPiece->pos + outputPiece->buf.datalen();
+                            m_off_t writeSize = outputPiece->buf.datalen();
+
+                            for (bool extended = true; extended && writeSize < MAX_COALESCED_WRITE; )
+                            {
+                                extended = false;
+                                for (int j = 0; j < connections; j++)
+                                {
+                                    if (j == i || !reqs[j] || reqs[j]->status != REQ_DECRYPTED
+                                            || std::find(writeGroup.begin(), writeGroup.end(), j) != writeGroup.end())
+                                    {
+                                        continue;
+                                    }
+
+                                    auto nextPiece = transferbuf.getAsyncOutputBufferPointer(j);
+                                    if (nextPiece && nextPiece->pos == writeEnd && nextPiece->buf.datalen())
+                                    {
+                                        writeGroup.push_back(j);
+                                        writeBufs.push_back(nextPiece->buf.datastart());
+                                        writeLens.push_back(static_cast<unsigned>(nextPiece->buf.datalen()));
+                                        writeEnd += nextPiece->buf.datalen();
+                                        writeSize += nextPiece->buf.datalen();
+                                        extended = true;
+                                        break;
+                                    }
+                                }
+                            }
+
+                            auto writeStart = std::chrono::steady_clock::now();
+                            bool written = writeGroup.size() == 1
+                                ? fa->fwrite(writeBufs[0], writeLens[0], outputPiece->pos)
+                                : fa->fwritev(writeBufs.data(), writeLens.data(), unsigned(writeGroup.size()), outputPiece->pos);
+                            transfer->timeline.diskUs += elapsedUs(writeStart);
+
+                            if (written)
                             {
-                                LOG_verbose << "Sync write succeeded";
+                                LOGF_verbose("Sync write succeeded ({} pieces, {} bytes)", writeGroup.size(), writeSize);
+                                for (size_t k = 1; k < writeGroup.size(); k++)
+                                {
+                                    transferbuf.bufferWriteCompleted(writeGroup[k], true);
+                                    reqs[writeGroup[k]]->status = REQ_READY;
+                                }
                                 transferbuf.bufferWriteCompleted(i, true);
                                 errorcount = 0;
                                 transfer->failcount = 0;
@@ -924,7 +1118,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                                 return;
                             }
 
-                            client->transfercacheadd(transfer, &committer);
+                            client->transfercacheprogress(transfer, &committer);
                             reqs[i]->status = REQ_READY;
                         }
                     }
@@ -939,30 +1133,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                             if (transfer->type == PUT)
                             {
                                 LOG_verbose << "Async read succeeded";
-                                m_off_t npos = asyncIO[i]->posOfBuffer + asyncIO[i]->dataBufferLen;
-                                string finaltempurl = transferbuf.tempURL(i);
-                                if (client->usealtupport && !memcmp(finaltempurl.c_str(), "http:", 5))
-                                {
-                                    size_t index = finaltempurl.find("/", 8);
-                                    if(index != string::npos && finaltempurl.find(":", 8) == string::npos)
-                                    {
-                                        finaltempurl.insert(index, ":8080");
-                                    }
-                                }
-
-                                auto pos = asyncIO[i]->posOfBuffer;
-                                auto req = reqs[i];    // shared_ptr so no object is deleted out from under the worker
-                                auto transferkey = transfer->transferkey;
-                                auto ctriv = transfer->ctriv;
-                                req->pos = pos;
-                                req->status = REQ_ENCRYPTING;
-
-                                client->mAsyncQueue.push([req, transferkey, ctriv, finaltempurl, pos, npos](SymmCipher& sc)
-                                    {
-                                        sc.setkey(transferkey.data());
-                                        req->prepare(finaltempurl.c_str(), &sc, ctriv, pos, npos);
-                                        req->status = REQ_PREPARED;
-                                    }, true);   // discardable - if the transfer or client are being destroyed, we won't be sending that data.
+                                queueUploadEncryption(client, i, asyncIO[i]->posOfBuffer, asyncIO[i]->posOfBuffer + asyncIO[i]->dataBufferLen);
                             }
                             else
                             {
@@ -978,7 +1149,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                                     return;
                                 }
 
-                                client->transfercacheadd(transfer, &committer);
+                                client->transfercacheprogress(transfer, &committer);
                                 reqs[i]->status = REQ_READY;
 
                                 if (client->orderdownloadedchunks && !transferbuf.isRaid())
@@ -1026,6 +1197,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
 
                 case REQ_FAILURE:
                     LOG_warn << "Failed chunk. HTTP status: " << reqs[i]->httpstatus << " on channel " << i;
+                    mRequestSizes.requestFailed(i);
                     if (reqs[i]->httpstatus && reqs[i]->contenttype.find("text/html") != string::npos
                             && !memcmp(reqs[i]->posturl.c_str(), "http:", 5))
                     {
@@ -1116,7 +1288,12 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
             {
                 bool newInputBufferSupplied = false;
                 bool pauseConnectionInputForRaid = false;
-                std::pair<m_off_t, m_off_t> posrange = transferbuf.nextNPosForConnection(i, maxRequestSize, connections, newInputBufferSupplied, pauseConnectionInputForRaid, client->httpio->uploadSpeed);
+                m_off_t adaptiveRequestSize = 0;
+                if (client->requestSizePolicy == RequestSizeController::POLICY_ADAPTIVE && !transferbuf.isRaid())
+                {
+                    adaptiveRequestSize = mRequestSizes.nextRequestSize(i, std::min<m_off_t>(maxRequestSize * 4, RequestSizeController::MAX_REQ_SIZE));
+                }
+                std::pair<m_off_t, m_off_t> posrange = transferbuf.nextNPosForConnection(i, maxRequestSize, connections, newInputBufferSupplied, pauseConnectionInputForRaid, client->httpio->uploadSpeed, adaptiveRequestSize);
 
                 // we might have a raid-reassembled block to write, or a previously loaded block, or a skip block to process.
                 bool newOutputBufferSupplied = false;
@@ -1140,6 +1317,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                     if (!reqs[i])
                     {
                         reqs[i].reset(transfer->type == PUT ? (HttpReqXfer*)new HttpReqUL() : (HttpReqXfer*)new HttpReqDL());
+                        reqs[i]->bandwidthcategory = transfer->bandwidthcategory();
                         reqs[i]->logname = client->clientname + (transfer->type == PUT ? "U" : "D") + std::to_string(++client->transferHttpCounter) + " ";
                     }
 
@@ -1153,7 +1331,21 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                         // For uploads, these are always on chunk boundaries so no need to worry about partials.
                         static_cast<HttpReqUL*>(reqs[i].get())->mChunkmacs.clear();
 
-                        if (fa->asyncavailable())
+                        std::unique_ptr<MappedFileRange> mapped;
+                        if (mMappedReads && !asyncIO[i])
+                        {
+                            mapped = fa->fmap(size, pos);
+                        }
+
+                        if (mapped)
+                        {
+                            // the worker encrypts from the mapping into out: no read copy
+                            reqs[i]->out->resize(size + ((-(int)size) & (SymmCipher::BLOCKSIZE - 1)));
+                            static_cast<HttpReqUL*>(reqs[i].get())->mSource = std::move(mapped);
+                            queueUploadEncryption(client, i, posrange.first, posrange.second);
+                            prepare = false;
+                        }
+                        else if (fa->asyncavailable())
                         {
                             if (asyncIO[i])
                             {
@@ -1171,7 +1363,11 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                         }
                         else
                         {
-                            if (!fa->fread(reqs[i]->out, size, (-(int)size) & (SymmCipher::BLOCKSIZE - 1), transfer->pos))
+                            auto readStart = std::chrono::steady_clock::now();
+                            bool read = fa->fread(reqs[i]->out, size, (-(int)size) & (SymmCipher::BLOCKSIZE - 1), transfer->pos);
+                            transfer->timeline.diskUs += elapsedUs(readStart);
+
+                            if (!read)
                             {
                                 LOG_warn << "Error preparing transfer: " << fa->retry;
                                 if (!fa->retry)
@@ -1182,8 +1378,14 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                                 // retry the read shortly
                                 backoff = 2;
                                 posrange.second = transfer->pos;
-                                prepare = false;
                             }
+                            else
+                            {
+                                // encrypt off the exec thread, as for async reads, so several connections
+                                // can have their chunks encrypted and MACed in parallel
+                                queueUploadEncryption(client, i, posrange.first, posrange.second);
+                            }
+                            prepare = false;
                         }
                     }
 
@@ -1265,13 +1467,13 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                     (numInflight && !earliestUploadCompleted &&
                     earliestPosInFlight + MAX_GAP_SIZE < (reqs[i]->pos + reqs[i]->size)))
                 {
-                    LOG_debug << "Connection " << i << " delaying until earliest completes. pos=" << reqs[i]->pos;
+                    LOGF_debug("Connection {} delaying until earliest completes. pos={}", i, reqs[i]->pos);
                     reqs[i]->status = REQ_UPLOAD_PREPARED_BUT_WAIT;
                 }
                 else if (reqs[i]->status == REQ_UPLOAD_PREPARED_BUT_WAIT &&
                     (!numInflight || earliestUploadCompleted))
                 {
-                    LOG_debug << "Connection " << i << " resumes. pos=" << reqs[i]->pos;
+                    LOGF_debug("Connection {} resumes. pos={}", i, reqs[i]->pos);
                     reqs[i]->status = REQ_PREPARED;
                 }
             }
@@ -1284,7 +1486,14 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
         {
             if ((reqs[i]->status == REQ_PREPARED) && !backoff)
             {
+                transfer->timeline.cryptoUs += reqs[i]->cryptoUs.exchange(0);
+                transfer->timeline.connections[size_t(i)].requestStart = TransferTimeline::now();
                 mReqSpeeds[i].requestStarted();
+                mRequestSizes.requestStarted(i);
+                if (transferbuf.isRaid())
+                {
+                    mRaidHedges.requestStarted(unsigned(i));
+                }
                 reqs[i]->minspeed = true;
                 reqs[i]->post(client); // status becomes either REQ_INFLIGHT or REQ_FAILED
             }
@@ -1363,7 +1572,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
         if (!chunkfailed)
         {
             LOG_warn << "Transfer failed due to a timeout";
-            return transfer->failed(API_EAGAIN, committer);  // either the (this) slot has been deleted, or the whole transfer including slot has been deleted
+            return transfer->failed(API_EAGAIN, committer, 0, true);  // either the (this) slot has been deleted, or the whole transfer including slot has been deleted
         }
         else
         {
@@ -1422,16 +1631,30 @@ m_off_t TransferSlot::updatecontiguousprogress()
 {
     m_off_t contiguousProgress = transfer->chunkmacs.updateContiguousProgress(transfer->size);
 
-    // Since that is updated, we may have a chance to consolidate the macsmac calculation so far also
-    transfer->chunkmacs.updateMacsmacProgress(transfer->transfercipher());
+    // Since that is updated, we may have a chance to consolidate the macsmac calculation so far also.
+    // The fold itself runs on a worker thread; we pick up the result on a later call.
+    transfer->chunkmacs.applyMacsmacSegment();
+
+    if (auto segment = transfer->chunkmacs.nextMacsmacSegment())
+    {
+        auto transferkey = transfer->transferkey;
+        transfer->client->mAsyncQueue.push([segment, transferkey](SymmCipher& sc)
+        {
+            sc.setkey(transferkey.data());
+            segment->fold(sc);
+        }, false);  // cheap, and not discardable so that the segment always completes
+
+        // with no worker threads the fold has already happened synchronously
+        transfer->chunkmacs.applyMacsmacSegment();
+    }
 
     if (!transferbuf.tempUrlVector().empty() && transferbuf.isRaid())
     {
-        LOG_debug << "Contiguous progress: " << contiguousProgress;
+        LOGF_debug("Contiguous progress: {}", contiguousProgress);
     }
     else
     {
-        LOG_debug << "Contiguous progress: " << contiguousProgress << " (" << (transfer->pos - contiguousProgress) << ")";
+        LOGF_debug("Contiguous progress: {} ({})", contiguousProgress, transfer->pos - contiguousProgress);
     }
 
     return contiguousProgress;
@@ -32,12 +32,59 @@ TreeProcShareKeys::TreeProcShareKeys(Node* n)
 
 void TreeProcShareKeys::proc(MegaClient*, Node* n)
 {
-    snk.add(n, sn, sn != NULL);
+    nodes.push_back(n);
 }
 
-void TreeProcShareKeys::get(Command* c)
+vector<handle> TreeProcShareKeys::get(Command* c, MegaClient* client)
 {
+    size_t first = std::min(nodes.size(), size_t(MAX_NODES_PER_COMMAND));
+
+    ShareNodeKeys snk;
+    add(client, snk, sn, nodes.data(), first);
     snk.get(c);
+
+    vector<handle> rest;
+    rest.reserve(nodes.size() - first);
+    for (size_t i = first; i < nodes.size(); i++)
+    {
+        rest.push_back(nodes[i]->nodehandle);
+    }
+
+    return rest;
+}
+
+void TreeProcShareKeys::add(MegaClient* client, ShareNodeKeys& snk, Node* sn, Node* const* nodes, size_t count)
+{
+    if (!sn || !sn->sharekey || count < MegaClient::MIN_PREDECRYPTED_NODES)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            snk.add(nodes[i], sn, sn != NULL);
+        }
+        return;
+    }
+
+    vector<string> encrypted(count);
+    const byte* shareKey = sn->sharekey->key;
+
+    client->parallelfor(count, [nodes, shareKey, &encrypted](size_t begin, size_t end, SymmCipher&)
+    {
+        SymmCipher cipher;
+        cipher.setkey(shareKey);
+
+        byte key[FILENODEKEYLENGTH];
+        for (size_t i = begin; i < end; i++)
+        {
+            const string& nodekey = nodes[i]->nodekey();
+            cipher.ecb_encrypt((byte*)nodekey.data(), key, nodekey.size());
+            encrypted[i].assign((const char*)key, nodekey.size());
+        }
+    });
+
+    for (size_t i = 0; i < count; i++)
+    {
+        snk.addencrypted(sn, nodes[i]->nodehandle, encrypted[i]);
+    }
 }
 
 void TreeProcForeignKeys::proc(MegaClient* client, Node* n)
@@ -68,17 +115,28 @@ void TreeProcDel::setOriginatingUser(const handle &handle)
     mOriginatingUser = handle;
 }
 
-void TreeProcApplyKey::proc(MegaClient *client, Node *n)
+void TreeProcApplyKey::proc(MegaClient*, Node *n)
 {
     if (n->attrstring)
     {
-        n->applykey();
+        mNodes.push_back(n);
+    }
+}
+
+void TreeProcApplyKey::apply(MegaClient* client)
+{
+    client->applynodekeys(mNodes);
+
+    for (Node* n : mNodes)
+    {
         if (!n->attrstring)
         {
             n->changed.attrs = true;
             client->notifynode(n);
         }
     }
+
+    mNodes.clear();
 }
 
 #ifdef ENABLE_SYNC
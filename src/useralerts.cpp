@@ -711,6 +711,14 @@ UserAlert::DeletedShare* UserAlert::DeletedShare::unserialize(string* d, unsigne
     return nullptr;
 }
 
+void UserAlert::appendListed(vector<handle>& listed, size_t& notListed, const vector<handle>& handles)
+{
+    size_t room = listed.size() < MAX_LISTED_NODES ? MAX_LISTED_NODES - listed.size() : 0;
+    size_t n = std::min(room, handles.size());
+    listed.insert(listed.end(), handles.begin(), handles.begin() + n);
+    notListed += handles.size() - n;
+}
+
 UserAlert::NewSharedNodes::NewSharedNodes(UserAlertRaw& un, unsigned int id)
     : Base(un, id)
 {
@@ -723,11 +731,25 @@ UserAlert::NewSharedNodes::NewSharedNodes(UserAlertRaw& un, unsigned int id)
     {
         if (f[n].t == FOLDERNODE)
         {
-            folderNodeHandles.push_back(f[n].h);
+            if (folderNodeHandles.size() < MAX_LISTED_NODES)
+            {
+                folderNodeHandles.push_back(f[n].h);
+            }
+            else
+            {
+                ++folderNodesNotListed;
+            }
         }
         else if (f[n].t == FILENODE)
         {
-            fileNodeHandles.push_back(f[n].h);
+            if (fileNodeHandles.size() < MAX_LISTED_NODES)
+            {
+                fileNodeHandles.push_back(f[n].h);
+            }
+            else
+            {
+                ++fileNodesNotListed;
+            }
         }
         // else should not be happening, we can add a sanity check
     }
@@ -747,8 +769,8 @@ void UserAlert::NewSharedNodes::text(string& header, string& title, MegaClient*
     ostringstream notificationText;
 
     // Get wording for the number of files and folders added
-    const auto folderCount = folderNodeHandles.size();
-    const auto fileCount = fileNodeHandles.size();
+    const auto folderCount = this->folderCount();
+    const auto fileCount = this->fileCount();
     if ((folderCount > 1) && (fileCount > 1)) {
         notificationText << folderCount << " folders and " << fileCount << " files";
     }
@@ -810,7 +832,13 @@ bool UserAlert::NewSharedNodes::serialize(string* d)
         w.serializehandle(h);
     }
 
-    w.serializeexpansionflags();
+    bool notListed = fileNodesNotListed || folderNodesNotListed;
+    w.serializeexpansionflags(notListed);
+    if (notListed)
+    {
+        w.serializecompressedu64(fileNodesNotListed);
+        w.serializecompressedu64(folderNodesNotListed);
+    }
     return true;
 }
 
@@ -858,12 +886,18 @@ UserAlert::NewSharedNodes* UserAlert::NewSharedNodes::unserialize(string* d, uns
                 }
 
                 unsigned char expF[8];
-                if (!r.unserializeexpansionflags(expF, 0))
+                uint64_t filesNotListed = 0;
+                uint64_t foldersNotListed = 0;
+                if (!r.unserializeexpansionflags(expF, 1)
+                    || (expF[0] && (!r.unserializecompressedu64(filesNotListed)
+                                    || !r.unserializecompressedu64(foldersNotListed))))
                 {
                     return nullptr;
                 }
 
                 auto* nsn = new NewSharedNodes(p->userHandle, ph, p->timestamp, id, move(vh1), move(vh2));
+                nsn->fileNodesNotListed = size_t(filesNotListed);
+                nsn->folderNodesNotListed = size_t(foldersNotListed);
                 nsn->setRelevant(p->relevant);
                 nsn->setSeen(p->seen);
                 return nsn;
@@ -882,7 +916,14 @@ UserAlert::RemovedSharedNode::RemovedSharedNode(UserAlertRaw& un, unsigned int i
 
     for (const auto& handleAndType: handlesAndNodeTypes)
     {
-        nodeHandles.push_back(handleAndType.h);
+        if (nodeHandles.size() < MAX_LISTED_NODES)
+        {
+            nodeHandles.push_back(handleAndType.h);
+        }
+        else
+        {
+            ++nodesNotListed;
+        }
     }
 }
 
@@ -896,7 +937,7 @@ void UserAlert::RemovedSharedNode::text(string& header, string& title, MegaClien
 {
     updateEmail(mc);
     ostringstream s;
-    const auto itemsNumber = nodeHandles.size();
+    const auto itemsNumber = count();
     if (itemsNumber > 1)
     {
         s << "Removed " << itemsNumber << " items from a share"; // 8913
@@ -920,7 +961,11 @@ bool UserAlert::RemovedSharedNode::serialize(string* d)
         w.serializehandle(h);
     }
 
-    w.serializeexpansionflags();
+    w.serializeexpansionflags(nodesNotListed > 0);
+    if (nodesNotListed)
+    {
+        w.serializecompressedu64(nodesNotListed);
+    }
     return true;
 }
 
@@ -950,12 +995,15 @@ UserAlert::RemovedSharedNode* UserAlert::RemovedSharedNode::unserialize(string*
         }
 
         unsigned char expF[8];
-        if (!r.unserializeexpansionflags(expF, 0))
+        uint64_t notListed = 0;
+        if (!r.unserializeexpansionflags(expF, 1)
+            || (expF[0] && !r.unserializecompressedu64(notListed)))
         {
             return nullptr;
         }
 
         auto* rsn = new RemovedSharedNode(p->userHandle, p->timestamp, id, move(vh));
+        rsn->nodesNotListed = size_t(notListed);
         rsn->setRelevant(p->relevant);
         rsn->setSeen(p->seen);
         return rsn;
@@ -1897,9 +1945,10 @@ void UserAlerts::add(UserAlert::Base* unb)
             if (np->user() == op->user() && np->ts() - op->ts() < 300 &&
                 np->parentHandle == op->parentHandle && !ISUNDEF(np->parentHandle))
             {
-                op->fileNodeHandles.insert(end(op->fileNodeHandles), begin(np->fileNodeHandles), end(np->fileNodeHandles));
-                op->folderNodeHandles.insert(end(op->folderNodeHandles),
-                                             begin(np->folderNodeHandles), end(np->folderNodeHandles));
+                UserAlert::appendListed(op->fileNodeHandles, op->fileNodesNotListed, np->fileNodeHandles);
+                UserAlert::appendListed(op->folderNodeHandles, op->folderNodesNotListed, np->folderNodeHandles);
+                op->fileNodesNotListed += np->fileNodesNotListed;
+                op->folderNodesNotListed += np->folderNodesNotListed;
                 LOG_debug << "Merged user alert, type " << np->type << " ts " << np->ts();
 
                 notifyAlert(op, false, 0);
@@ -1921,7 +1970,8 @@ void UserAlerts::add(UserAlert::Base* unb)
         {
             if (nd->user() == od->user() && nd->ts() - od->ts() < 300)
             {
-                od->nodeHandles.insert(end(od->nodeHandles), begin(nd->nodeHandles), end(nd->nodeHandles));
+                UserAlert::appendListed(od->nodeHandles, od->nodesNotListed, nd->nodeHandles);
+                od->nodesNotListed += nd->nodesNotListed;
                 LOG_debug << "Merged user alert, type " << nd->type << " ts " << nd->ts();
 
                 notifyAlert(od, false, 0);
@@ -2020,14 +2070,19 @@ void UserAlerts::noteSharedNode(handle user, int type, m_time_t ts, Node* n, nam
             }
         }
 
-        ff& f = notedSharedNodes[make_pair(user, n ? n->parenthandle : UNDEF)];
-        if (n && type == FOLDERNODE)
+        ff& f = notedSharedNodes[make_pair(n ? n->parenthandle : UNDEF, user)];
+        if (n && (type == FOLDERNODE || type == FILENODE))
         {
-            f.alertTypePerFolderNode[n->nodehandle] = alertType;
-        }
-        else if (n && type == FILENODE)
-        {
-            f.alertTypePerFileNode[n->nodehandle] = alertType;
+            auto& listed = type == FOLDERNODE ? f.alertTypePerFolderNode : f.alertTypePerFileNode;
+            if (listed.size() < UserAlert::MAX_LISTED_NODES || listed.find(n->nodehandle) != listed.end())
+            {
+                listed[n->nodehandle] = alertType;
+            }
+            else
+            {
+                ++(type == FOLDERNODE ? f.foldersNotListed : f.filesNotListed);
+                f.alertTypeNotListed = alertType;
+            }
         }
         // there shouldn't be any other types
 
@@ -2046,19 +2101,29 @@ bool UserAlerts::isConvertReadyToAdd(handle originatingUser) const
 void UserAlerts::convertNotedSharedNodes(bool added)
 {
     using namespace UserAlert;
-    for (notedShNodesMap::iterator i = notedSharedNodes.begin(); i != notedSharedNodes.end(); ++i)
-    {
-        auto&& fileHandles = i->second.fileHandles();
-        auto&& folderHandles = i->second.folderHandles();
+    // each noted entry is released as soon as its alert is made
+    for (notedShNodesMap::iterator i = notedSharedNodes.begin(); i != notedSharedNodes.end(); i = notedSharedNodes.erase(i))
+    {
+        const ff& f = i->second;
+        vector<handle> fileHandles;
+        vector<handle> folderHandles;
+        ff::appendHandles(f.alertTypePerFileNode, fileHandles);
+        ff::appendHandles(f.alertTypePerFolderNode, folderHandles);
         if (added)
         {
-            add(new NewSharedNodes(i->first.first, i->first.second, i->second.timestamp, nextId(),
-                                   move(fileHandles), move(folderHandles)));
+            auto alert = new NewSharedNodes(i->first.second, i->first.first, f.timestamp, nextId(),
+                                            move(fileHandles), move(folderHandles));
+            alert->fileNodesNotListed = f.filesNotListed;
+            alert->folderNodesNotListed = f.foldersNotListed;
+            add(alert);
         }
         else
         {
-            std::move(folderHandles.begin(), folderHandles.end(), std::back_inserter(fileHandles));
-            add(new RemovedSharedNode(i->first.first, m_time(), nextId(), move(fileHandles)));
+            size_t notListed = f.filesNotListed + f.foldersNotListed;
+            appendListed(fileHandles, notListed, folderHandles);
+            auto alert = new RemovedSharedNode(i->first.second, m_time(), nextId(), move(fileHandles));
+            alert->nodesNotListed = notListed;
+            add(alert);
         }
     }
 }
@@ -2085,19 +2150,30 @@ void UserAlerts::ignoreNextSharedNodesUnder(handle h)
     ignoreNodesUnderShare = h;
 }
 
-pair<bool, UserAlert::handle_alerttype_map_t::difference_type>
-UserAlerts::findNotedSharedNodeIn(handle nodeHandle, const notedShNodesMap& notedSharedNodesMap) const
+UserAlerts::notedShNodesMap::const_iterator UserAlerts::findNotedSharedNode(const Node* n, const notedShNodesMap& notedSharedNodesMap) const
 {
-    auto it = find_if(begin(notedSharedNodesMap), end(notedSharedNodesMap),
-                        [nodeHandle](const pair<pair<handle, handle>, ff>& element)
-                        {
-                            const auto& fileAlertTypes = element.second.alertTypePerFileNode;
-                            const auto& folderAlertTypes = element.second.alertTypePerFolderNode;
-                            return (std::distance(fileAlertTypes.find(nodeHandle), end(fileAlertTypes))
-                                || std::distance(folderAlertTypes.find(nodeHandle), end(folderAlertTypes)));
-                        });
+    bool isFolder = n->type == FOLDERNODE;
 
-    return make_pair(it != end(notedSharedNodesMap), std::distance(begin(notedSharedNodesMap), it));
+    // the entries of its parent, one per user
+    auto it = notedSharedNodesMap.lower_bound(make_pair(n->parenthandle, handle(0)));
+    for (; it != notedSharedNodesMap.end() && it->first.first == n->parenthandle; ++it)
+    {
+        const ff& f = it->second;
+        const auto& listed = isFolder ? f.alertTypePerFolderNode : f.alertTypePerFileNode;
+        if (listed.find(n->nodehandle) != listed.end())
+        {
+            return it;
+        }
+
+        // the nodes not listed were noted as they changed, in this round of changes
+        if ((isFolder ? f.foldersNotListed : f.filesNotListed)
+            && (f.alertTypeNotListed == UserAlert::type_d ? n->changed.removed : n->changed.newnode))
+        {
+            return it;
+        }
+    }
+
+    return notedSharedNodesMap.end();
 }
 
 bool UserAlerts::containsRemovedNodeAlert(handle nh, const UserAlert::Base* a) const
@@ -2109,30 +2185,41 @@ bool UserAlerts::containsRemovedNodeAlert(handle nh, const UserAlert::Base* a) c
             != end(delNodeAlert->nodeHandles));
 }
 
-UserAlert::NewSharedNodes* UserAlerts::eraseNodeHandleFromNewShareNodeAlert(handle nh, UserAlert::Base* a)
+UserAlert::NewSharedNodes* UserAlerts::eraseNodeHandleFromNewShareNodeAlert(Node* n, UserAlert::Base* a)
 {
     UserAlert::NewSharedNodes* nsna = dynamic_cast<UserAlert::NewSharedNodes*>(a);
 
     if (nsna)
     {
-        auto it = find(begin(nsna->fileNodeHandles), end(nsna->fileNodeHandles), nh);
+        auto it = find(begin(nsna->fileNodeHandles), end(nsna->fileNodeHandles), n->nodehandle);
         if (it != end(nsna->fileNodeHandles))
         {
             nsna->fileNodeHandles.erase(it);
             return nsna;
         }
         // no need to check nsna->folderNodeHandles since folders do not support versioning
+
+        // the files not listed are those of the user's added to the parent since the alert
+        // (nodes still new are from changes after the alert was made)
+        if (nsna->fileNodesNotListed && n->type == FILENODE && !n->changed.newnode
+            && n->parenthandle == nsna->parentHandle && n->owner == nsna->user() && n->ctime >= nsna->ts())
+        {
+            --nsna->fileNodesNotListed;
+            return nsna;
+        }
     }
 
     return nullptr;
 }
 
-UserAlert::RemovedSharedNode* UserAlerts::eraseNodeHandleFromRemovedSharedNode(handle nh, UserAlert::Base* a)
+UserAlert::RemovedSharedNode* UserAlerts::eraseNodeHandleFromRemovedSharedNode(Node* n, UserAlert::Base* a)
 {
     UserAlert::RemovedSharedNode* rsna = dynamic_cast<UserAlert::RemovedSharedNode*>(a);
 
+    // only the listed ones can be told apart: a node still around doesn't say it was removed
     if (rsna)
     {
+        handle nh = n->nodehandle;
         auto it = find(begin(rsna->nodeHandles), end(rsna->nodeHandles), nh);
         if (it != end(rsna->nodeHandles))
         {
@@ -2146,38 +2233,32 @@ UserAlert::RemovedSharedNode* UserAlerts::eraseNodeHandleFromRemovedSharedNode(h
 
 bool UserAlerts::isSharedNodeNotedAsRemoved(handle nodeHandleToFind) const
 {
+    Node* n = catchupdone && notingSharedNodes ? mc.nodebyhandle(nodeHandleToFind) : nullptr;
+    if (!n)
+    {
+        return false;
+    }
+
     // check first in the stash
-    return isSharedNodeNotedAsRemovedFrom(nodeHandleToFind, deletedSharedNodesStash)
-        || isSharedNodeNotedAsRemovedFrom(nodeHandleToFind, notedSharedNodes);
+    return isSharedNodeNotedAsRemovedFrom(n, deletedSharedNodesStash)
+        || isSharedNodeNotedAsRemovedFrom(n, notedSharedNodes);
 }
 
-bool UserAlerts::isSharedNodeNotedAsRemovedFrom(handle nodeHandleToFind,
-                                                const notedShNodesMap& notedSharedNodesMap) const
+bool UserAlerts::isSharedNodeNotedAsRemovedFrom(const Node* n, const notedShNodesMap& notedSharedNodesMap) const
 {
-    using handletoalert_t = UserAlert::handle_alerttype_map_t;
     if (catchupdone && notingSharedNodes)
     {
-        auto itToNotedSharedNodes = find_if(begin(notedSharedNodesMap),
-                                                 end(notedSharedNodesMap),
-        [nodeHandleToFind](const pair<pair<handle, handle>, ff>& element)
+        auto it = findNotedSharedNode(n, notedSharedNodesMap);
+        if (it == end(notedSharedNodesMap))
         {
-            const handletoalert_t& fileAlertTypes = element.second.alertTypePerFileNode;
-            auto itToFileNodeHandleAndAlertType = fileAlertTypes.find(nodeHandleToFind);
-            const handletoalert_t& folderAlertTypes = element.second.alertTypePerFolderNode;
-            auto itToFolderNodeHandleAndAlertType = folderAlertTypes.find(nodeHandleToFind);
-
-            bool isInFileNodes = ((itToFileNodeHandleAndAlertType != end(fileAlertTypes))
-                                  && (itToFileNodeHandleAndAlertType->second == UserAlert::type_d));
-
-            // shortcircuit in case it was already found
-            bool isInFolderNodes = isInFileNodes ||
-                ((itToFolderNodeHandleAndAlertType != end(folderAlertTypes))
-                  && (itToFolderNodeHandleAndAlertType->second == UserAlert::type_d));
-
-            return (isInFileNodes || isInFolderNodes);
-        });
+            return false;
+        }
 
-        return itToNotedSharedNodes != end(notedSharedNodesMap);
+        const ff& f = it->second;
+        const auto& listed = n->type == FOLDERNODE ? f.alertTypePerFolderNode : f.alertTypePerFileNode;
+        auto itToNodeHandleAndAlertType = listed.find(n->nodehandle);
+        nameid alertType = itToNodeHandleAndAlertType != end(listed) ? itToNodeHandleAndAlertType->second : f.alertTypeNotListed;
+        return alertType == UserAlert::type_d;
     }
     return false;
 }
@@ -2189,15 +2270,21 @@ bool UserAlerts::removeNotedSharedNodeFrom(notedShNodesMap::iterator itToStashed
         ff& f = itToStashedNodeToRemove->second;
         if (nodeToRemove->type == FOLDERNODE)
         {
-            f.alertTypePerFolderNode.erase(nodeToRemove->nodehandle);
+            if (!f.alertTypePerFolderNode.erase(nodeToRemove->nodehandle) && f.foldersNotListed)
+            {
+                --f.foldersNotListed;
+            }
         }
         else if (nodeToRemove->type == FILENODE)
         {
-            f.alertTypePerFileNode.erase(nodeToRemove->nodehandle);
+            if (!f.alertTypePerFileNode.erase(nodeToRemove->nodehandle) && f.filesNotListed)
+            {
+                --f.filesNotListed;
+            }
         }
         // there shouldn't be any other type
 
-        if (f.alertTypePerFolderNode.empty() && f.alertTypePerFileNode.empty())
+        if (f.empty())
         {
             notedSharedNodesMap.erase(itToStashedNodeToRemove);
         }
@@ -2210,12 +2297,10 @@ bool UserAlerts::removeNotedSharedNodeFrom(Node* n, notedShNodesMap& notedShared
 {
     if (catchupdone && notingSharedNodes)
     {
-        auto found = findNotedSharedNodeIn(n->nodehandle, notedSharedNodesMap);
-        if (found.first)
+        auto found = findNotedSharedNode(n, notedSharedNodesMap);
+        if (found != notedSharedNodesMap.end())
         {
-            auto it = notedSharedNodesMap.begin();
-            std::advance(it, found.second);
-            return removeNotedSharedNodeFrom(it, n, notedSharedNodesMap);
+            return removeNotedSharedNodeFrom(notedSharedNodesMap.find(found->first), n, notedSharedNodesMap);
         }
     }
     return false;
@@ -2226,13 +2311,11 @@ bool UserAlerts::setNotedSharedNodeToUpdate(Node* nodeToChange)
     // noted nodes stash contains only deleted noted nodes, thus, we only check noted nodes map
     if (catchupdone && notingSharedNodes && !notedSharedNodes.empty())
     {
-        auto found = findNotedSharedNodeIn(nodeToChange->nodehandle, notedSharedNodes);
-        if (!found.first) return false;
-        auto itToNotedSharedNodes = notedSharedNodes.begin();
-        std::advance(itToNotedSharedNodes, found.second);
-        if (itToNotedSharedNodes == end(notedSharedNodes)) return false;
+        auto found = findNotedSharedNode(nodeToChange, notedSharedNodes);
+        if (found == end(notedSharedNodes)) return false;
+        auto itToNotedSharedNodes = notedSharedNodes.find(found->first);
 
-        add(new UserAlert::UpdatedSharedNode(itToNotedSharedNodes->first.first,
+        add(new UserAlert::UpdatedSharedNode(itToNotedSharedNodes->first.second,
                                              itToNotedSharedNodes->second.timestamp,
                                              nextId(),
                                              {nodeToChange->nodehandle}));
@@ -2293,20 +2376,20 @@ void UserAlerts::removeNodeAlerts(Node* nodeToRemoveAlert)
         + toNodeHandle(nodeHandleToRemove) + "| found as a ";
     for (UserAlert::Base* alertToCheck : alerts)
     {
-        if (auto pNewSN = eraseNodeHandleFromNewShareNodeAlert(nodeHandleToRemove, alertToCheck))
+        if (auto pNewSN = eraseNodeHandleFromNewShareNodeAlert(nodeToRemoveAlert, alertToCheck))
         {
             LOG_debug << debug_msg << "new-alert type";
-            if (pNewSN->fileNodeHandles.empty() && pNewSN->folderNodeHandles.empty())
+            if (!pNewSN->fileCount() && !pNewSN->folderCount())
             {
                 pNewSN->setRemoved();
             }
 
             notifyAlert(pNewSN, pNewSN->seen(), pNewSN->tag);
         }
-        else if (auto pRemovedSN = eraseNodeHandleFromRemovedSharedNode(nodeHandleToRemove, alertToCheck))
+        else if (auto pRemovedSN = eraseNodeHandleFromRemovedSharedNode(nodeToRemoveAlert, alertToCheck))
         {
             LOG_debug << debug_msg << "removal-alert type";
-            if (pRemovedSN->nodeHandles.empty())
+            if (!pRemovedSN->count())
             {
                 pRemovedSN->setRemoved();
             }
@@ -2343,9 +2426,9 @@ void UserAlerts::setNewNodeAlertToUpdateNodeAlert(Node* nodeToUpdate)
     for (UserAlert::Base* alertToCheck : alerts)
     {
         bool ret = false;
-        if (auto pNewSN = eraseNodeHandleFromNewShareNodeAlert(nodeHandleToUpdate, alertToCheck))
+        if (auto pNewSN = eraseNodeHandleFromNewShareNodeAlert(nodeToUpdate, alertToCheck))
         {
-            bool emptyAlert = pNewSN->fileNodeHandles.empty() && pNewSN->folderNodeHandles.empty();
+            bool emptyAlert = !pNewSN->fileCount() && !pNewSN->folderCount();
             LOG_debug << debug_msg << " there are " << (ret ? "no " : "") << " remaining alters for this folder";
 
             if (emptyAlert) pNewSN->setRemoved();
@@ -2370,7 +2453,7 @@ void UserAlerts::setNewNodeAlertToUpdateNodeAlert(Node* nodeToUpdate)
 
 void UserAlerts::convertStashedDeletedSharedNodes()
 {
-    notedSharedNodes = deletedSharedNodesStash;
+    notedSharedNodes.swap(deletedSharedNodesStash);
     deletedSharedNodesStash.clear();
 
     convertNotedSharedNodes(false);
@@ -2388,7 +2471,7 @@ void UserAlerts::stashDeletedNotedSharedNodes(handle originatingUser)
 {
     if (isConvertReadyToAdd(originatingUser))
     {
-        deletedSharedNodesStash = notedSharedNodes;
+        deletedSharedNodesStash.swap(notedSharedNodes);
     }
 
     clearNotedSharedMembers();
@@ -2565,6 +2648,11 @@ void UserAlerts::acknowledgeAll()
 
 void UserAlerts::acknowledgeAllSucceeded()
 {
+    if (mc.sctable)
+    {
+        mc.sctable->seealerts(); // those out of `alerts`
+    }
+
     for (auto& a : alerts)
     {
         if (!a->seen())
@@ -2576,6 +2664,11 @@ void UserAlerts::acknowledgeAllSucceeded()
 
 void UserAlerts::onAcknowledgeReceived()
 {
+    if (mc.sctable)
+    {
+        mc.sctable->seealerts(); // those out of `alerts`
+    }
+
     for (auto& a : alerts)
     {
         if (!a->seen())
@@ -2609,13 +2702,57 @@ UserAlerts::~UserAlerts()
     clear();
 }
 
+void UserAlerts::addMemoryUsage(MemoryReport& report) const
+{
+    // there are a few hundred alerts at most: the size of their serialization
+    // is a good approximation of their variable-length content
+    size_t bytes = alerts.size() * sizeof(UserAlert::Base*) + useralertnotify.capacity() * sizeof(UserAlert::Base*);
+    string serialized;
+    for (UserAlert::Base* a : alerts)
+    {
+        serialized.clear();
+        bytes += sizeof(UserAlert::Base) + (a->serialize(&serialized) ? serialized.size() : 0);
+    }
+
+    for (const notedShNodesMap* noted : { &notedSharedNodes, &deletedSharedNodesStash })
+    {
+        for (auto& it : *noted)
+        {
+            bytes += MemoryReport::CONTAINER_NODE_OVERHEAD + sizeof(it)
+                   + (it.second.alertTypePerFileNode.size() + it.second.alertTypePerFolderNode.size())
+                     * (MemoryReport::CONTAINER_NODE_OVERHEAD + sizeof(UserAlert::handle_alerttype_map_t::value_type));
+        }
+    }
+
+    for (auto& it : pendingContactUsers)
+    {
+        bytes += MemoryReport::CONTAINER_NODE_OVERHEAD + sizeof(it)
+               + MemoryReport::heapBytes(it.second.m) + MemoryReport::heapBytes(it.second.n)
+               + it.second.m2.capacity() * sizeof(string);
+    }
+
+    report.add("userAlerts", alerts.size(), bytes);
+}
+
 bool UserAlerts::unserializeAlert(string* d, uint32_t dbid)
+{
+    UserAlert::Base* a = unserialize(d, dbid);
+    if (!a)
+    {
+        return false;
+    }
+
+    add(a); // takes ownership of a
+    return true;
+}
+
+UserAlert::Base* UserAlerts::unserialize(string* d, uint32_t dbid)
 {
     nameid type = 0;
     CacheableReader r(*d);
     if (!r.unserializecompressedu64(type))
     {
-        return false;
+        return nullptr;
     }
     r.eraseused(*d);
 
@@ -2687,11 +2824,118 @@ bool UserAlerts::unserializeAlert(string* d, uint32_t dbid)
     if (a)
     {
         a->dbid = dbid;
-        add(a); // takes ownership of a
-        return true;
     }
 
-    return false;
+    return a;
+}
+
+bool UserAlerts::storedApart() const
+{
+    return mc.sctable && mc.sctable->countalerts(false) >= 0;
+}
+
+void UserAlerts::loadStoredAlerts()
+{
+    if (!storedApart())
+    {
+        return;
+    }
+
+    // ids of the store are not seen by DbTable::next()
+    mc.sctable->nextid = std::max(mc.sctable->nextid, mc.sctable->maxid() & - DbTable::IDSPACING);
+
+    // alerts read from `statecache` predate the store: move them
+    if (!alerts.empty())
+    {
+        LOG_info << "Moving " << alerts.size() << " user alerts to their own table";
+        for (UserAlert::Base* a : alerts)
+        {
+            mc.sctable->del(a->dbid);
+            a->dbid = 0;
+            mc.persistAlert(a);
+            delete a;
+        }
+        alerts.clear();
+        mc.sctable->trimalerts(MAX_STORED_ALERTS);
+    }
+
+    vector<DbTable::AlertRecord> records;
+    if (!mc.sctable->getalerts(0, ALERTS_IN_MEMORY, records, &mc.key))
+    {
+        return;
+    }
+
+    // oldest first, as add() expects them
+    for (auto it = records.rbegin(); it != records.rend(); ++it)
+    {
+        if (UserAlert::Base* a = unserialize(&it->content, it->id))
+        {
+            a->setSeen(a->seen() || it->seen);
+            add(a);
+        }
+        else
+        {
+            LOG_err << "Failed - user notification read error";
+        }
+    }
+}
+
+void UserAlerts::getAlerts(size_t offset, size_t count, vector<UserAlert::Base*>& result, vector<unique_ptr<UserAlert::Base>>& loaded)
+{
+    if (!storedApart())
+    {
+        for (auto it = alerts.rbegin(); it != alerts.rend() && result.size() < count; ++it)
+        {
+            if ((*it)->removed())
+            {
+                continue;
+            }
+
+            if (offset)
+            {
+                --offset;
+            }
+            else
+            {
+                result.push_back(*it);
+            }
+        }
+        return;
+    }
+
+    // the alerts in `alerts` were persisted as the app was notified of them, so the
+    // store has them all: theirs are used, as they are the ones that may have changed since
+    vector<DbTable::AlertRecord> records;
+    mc.sctable->getalerts(offset, count, records, &mc.key);
+    for (auto& record : records)
+    {
+        auto it = std::find_if(alerts.begin(), alerts.end(), [&record](UserAlert::Base* a) { return a->dbid == record.id; });
+        if (it != alerts.end())
+        {
+            if (!(*it)->removed())
+            {
+                result.push_back(*it);
+            }
+        }
+        else if (UserAlert::Base* a = unserialize(&record.content, record.id))
+        {
+            a->setSeen(a->seen() || record.seen);
+            a->updateEmail(&mc);
+            result.push_back(a);
+            loaded.emplace_back(a);
+        }
+    }
+}
+
+size_t UserAlerts::unseenCount() const
+{
+    int64_t stored = storedApart() ? mc.sctable->countalerts(true) : -1;
+    if (stored >= 0)
+    {
+        return size_t(stored);
+    }
+
+    return size_t(std::count_if(alerts.begin(), alerts.end(), [](UserAlert::Base* a) { return !a->removed() && !a->seen(); }));
 }
 
 void UserAlerts::initscalerts() // called after sc50 response has been received
@@ -2701,6 +2945,12 @@ void UserAlerts::initscalerts() // called after sc50 response has been received
     {
         mc.persistAlert(a);
     }
+
+    if (storedApart())
+    {
+        mc.sctable->trimalerts(MAX_STORED_ALERTS);
+        evictAlerts();
+    }
 }
 
 void UserAlerts::purgescalerts() // called from MegaClient::notifypurge()
@@ -2711,7 +2961,21 @@ void UserAlerts::purgescalerts() // called from MegaClient::notifypurge()
     }
     assert(catchupdone);
 
-    trimAlertsToMaxCount();
+    bool stored = storedApart();
+    if (stored)
+    {
+        // persist first, so that the store the app pages through has what it's notified of
+        for (auto a : useralertnotify)
+        {
+            mc.persistAlert(a); // persist to db (add/update/remove)
+        }
+
+        mc.sctable->trimalerts(MAX_STORED_ALERTS);
+    }
+    else
+    {
+        trimAlertsToMaxCount();
+    }
 
     // send notification for all current alerts, even if some overflowed already
     LOG_debug << "Notifying " << useralertnotify.size() << " user alerts";
@@ -2719,7 +2983,10 @@ void UserAlerts::purgescalerts() // called from MegaClient::notifypurge()
 
     for (auto a : useralertnotify)
     {
-        mc.persistAlert(a); // persist to db (add/update/remove)
+        if (!stored)
+        {
+            mc.persistAlert(a); // persist to db (add/update/remove)
+        }
 
         if (a->removed())
         {
@@ -2736,6 +3003,21 @@ void UserAlerts::purgescalerts() // called from MegaClient::notifypurge()
     }
 
     useralertnotify.clear();
+
+    if (stored)
+    {
+        evictAlerts();
+    }
+}
+
+void UserAlerts::evictAlerts()
+{
+    // they stay in the store, where getAlerts() reads them from
+    while (alerts.size() > ALERTS_IN_MEMORY && !alerts.front()->notified)
+    {
+        delete alerts.front();
+        alerts.pop_front();
+    }
 }
 
 void UserAlerts::trimAlertsToMaxCount()
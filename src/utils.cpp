@@ -28,6 +28,8 @@
 
 #include <iomanip>
 #include <cctype>
+#include <climits>
+#include <cmath>
 
 #if defined(_WIN32) && defined(_MSC_VER)
 #include <sys/timeb.h>
@@ -42,6 +44,12 @@
 #include <sys/resource.h>
 #endif // ! WIN32
 
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 namespace mega {
 
 std::atomic<uint32_t> CancelToken::tokensCancelledCount{0};
@@ -141,6 +149,8 @@ void RemoveHiddenFileAttribute(mega::LocalPath& path)
 }
 
 
+static_assert(CacheableWriter::NodeHandle::SIZE == MegaClient::NODEHANDLE, "node handles are serialized in 6 bytes");
+
 CacheableWriter::CacheableWriter(string& d)
     : dest(d)
 {
@@ -337,11 +347,13 @@ bool CacheableReader::unserializebinary(byte* data, size_t len)
 void chunkmac_map::serialize(string& d) const
 {
     unsigned short ll = (unsigned short)size();
+    d.reserve(d.size() + sizeof(ll) + ll * (sizeof(m_off_t) + sizeof(ChunkMAC)));
     d.append((char*)&ll, sizeof(ll));
-    for (auto& it : mMacMap)
+    for (size_t i = nextPresent(0); i < mMacs.size(); i = nextPresent(i + 1))
     {
-        d.append((char*)&it.first, sizeof(it.first));
-        d.append((char*)&it.second, sizeof(it.second));
+        m_off_t pos = ChunkedHash::chunkpos(mFirstIndex + i);
+        d.append((char*)&pos, sizeof(pos));
+        d.append((char*)&mMacs[i], sizeof(mMacs[i]));
     }
 }
 
@@ -360,10 +372,17 @@ bool chunkmac_map::unserialize(const char*& ptr, const char* end)
         m_off_t pos = MemAccess::get<m_off_t>(ptr);
         ptr += sizeof(m_off_t);
 
-        memcpy(&(mMacMap[pos]), ptr, sizeof(ChunkMAC));
+        if (pos < 0 || pos != ChunkedHash::chunkfloor(pos))
+        {
+            LOG_err << "Invalid chunk mac position: " << pos;
+            return false;
+        }
+
+        ChunkMAC& chunk = entryAt(pos);
+        memcpy(&chunk, ptr, sizeof(ChunkMAC));
         ptr += sizeof(ChunkMAC);
 
-        if (mMacMap[pos].isMacsmacSoFar())
+        if (chunk.isMacsmacSoFar())
         {
             macsmacSoFarPos = pos;
             assert(i == 0);
@@ -376,39 +395,127 @@ bool chunkmac_map::unserialize(const char*& ptr, const char* end)
     return true;
 }
 
+chunkmac_map::ChunkMAC& chunkmac_map::entryAt(m_off_t pos)
+{
+    assert(pos >= 0 && pos == ChunkedHash::chunkfloor(pos));
+
+    size_t index = ChunkedHash::chunkindex(pos);
+
+    if (mMacs.empty())
+    {
+        mFirstIndex = index;
+    }
+    else if (index < mFirstIndex)
+    {
+        // rare: entries are almost always added at or after the front
+        size_t grow = mFirstIndex - index;
+        mMacs.insert(mMacs.begin(), grow, ChunkMAC());
+        mPresent.insert(mPresent.begin(), grow, false);
+        mFirstIndex = index;
+    }
+
+    size_t i = index - mFirstIndex;
+    if (i >= mMacs.size())
+    {
+        mMacs.resize(i + 1);
+        mPresent.resize(i + 1, false);
+    }
+
+    if (!mPresent[i])
+    {
+        mPresent[i] = true;
+        mMacs[i] = ChunkMAC();
+        ++mCount;
+    }
+    return mMacs[i];
+}
+
+chunkmac_map::ChunkMAC* chunkmac_map::findEntry(m_off_t pos)
+{
+    if (pos < 0 || pos != ChunkedHash::chunkfloor(pos))
+    {
+        return nullptr;
+    }
+
+    size_t index = ChunkedHash::chunkindex(pos);
+    if (index < mFirstIndex || index - mFirstIndex >= mMacs.size() || !mPresent[index - mFirstIndex])
+    {
+        return nullptr;
+    }
+    return &mMacs[index - mFirstIndex];
+}
+
+void chunkmac_map::eraseEntry(m_off_t pos)
+{
+    size_t index = ChunkedHash::chunkindex(pos);
+    if (index >= mFirstIndex && index - mFirstIndex < mMacs.size() && mPresent[index - mFirstIndex])
+    {
+        mPresent[index - mFirstIndex] = false;
+        --mCount;
+    }
+}
+
+size_t chunkmac_map::nextPresent(size_t i) const
+{
+    while (i < mPresent.size() && !mPresent[i])
+    {
+        ++i;
+    }
+    return i;
+}
+
+void chunkmac_map::trimFront()
+{
+    size_t n = nextPresent(0);
+    if (n == mMacs.size())
+    {
+        mMacs.clear();
+        mPresent.clear();
+        mFirstIndex = 0;
+    }
+    else if (n)
+    {
+        mMacs.erase(mMacs.begin(), mMacs.begin() + static_cast<ptrdiff_t>(n));
+        mPresent.erase(mPresent.begin(), mPresent.begin() + static_cast<ptrdiff_t>(n));
+        mFirstIndex += n;
+    }
+}
+
 void chunkmac_map::calcprogress(m_off_t size, m_off_t& chunkpos, m_off_t& progresscompleted, m_off_t* sumOfPartialChunks)
 {
     chunkpos = 0;
     progresscompleted = 0;
 
-    for (auto& it : mMacMap)
+    for (size_t i = nextPresent(0); i < mMacs.size(); i = nextPresent(i + 1))
     {
-        m_off_t chunkceil = ChunkedHash::chunkceil(it.first, size);
+        m_off_t pos = ChunkedHash::chunkpos(mFirstIndex + i);
+        ChunkMAC& chunk = mMacs[i];
+        m_off_t chunkceil = ChunkedHash::chunkceil(pos, size);
 
-        if (it.second.isMacsmacSoFar())
+        if (chunk.isMacsmacSoFar())
         {
             assert(chunkpos == 0);
-            macsmacSoFarPos = it.first;
+            macsmacSoFarPos = pos;
 
             chunkpos = chunkceil;
             progresscompleted = chunkceil;
         }
-        else if (chunkpos == it.first && it.second.finished)
+        else if (chunkpos == pos && chunk.finished)
         {
             chunkpos = chunkceil;
             progresscompleted = chunkceil;
         }
-        else if (it.second.finished)
+        else if (chunk.finished)
         {
-            m_off_t chunksize = chunkceil - ChunkedHash::chunkfloor(it.first);
+            m_off_t chunksize = chunkceil - pos;
             progresscompleted += chunksize;
         }
         else
         {
-            progresscompleted += it.second.offset;  // sum of completed portions
+            progresscompleted += chunk.offset;  // sum of completed portions
             if (sumOfPartialChunks)
             {
-                *sumOfPartialChunks += it.second.offset;
+                *sumOfPartialChunks += chunk.offset;
             }
         }
     }
@@ -420,17 +527,17 @@ m_off_t chunkmac_map::nextUnprocessedPosFrom(m_off_t pos)
 {
     assert(pos > macsmacSoFarPos);
 
-    for (auto it = mMacMap.find(ChunkedHash::chunkfloor(pos));
-        it != mMacMap.end();
-        it = mMacMap.find(ChunkedHash::chunkfloor(pos)))
+    for (ChunkMAC* chunk = findEntry(ChunkedHash::chunkfloor(pos));
+        chunk;
+        chunk = findEntry(ChunkedHash::chunkfloor(pos)))
     {
-        if (it->second.finished)
+        if (chunk->finished)
         {
             pos = ChunkedHash::chunkceil(pos);
         }
         else
         {
-            pos += it->second.offset;
+            pos += chunk->offset;
             break;
         }
     }
@@ -441,11 +548,11 @@ m_off_t chunkmac_map::expandUnprocessedPiece(m_off_t pos, m_off_t npos, m_off_t
 {
     assert(pos > macsmacSoFarPos);
 
-    for (auto it = mMacMap.find(npos);
+    for (ChunkMAC* chunk = findEntry(npos);
         npos < fileSize &&
         (npos - pos) < maxReqSize &&
-        (it == mMacMap.end() || it->second.notStarted());
-        it = mMacMap.find(npos))
+        (!chunk || chunk->notStarted());
+        chunk = findEntry(npos))
     {
         npos = ChunkedHash::chunkceil(npos, fileSize);
     }
@@ -456,24 +563,23 @@ m_off_t chunkmac_map::hasUnfinishedGap(m_off_t fileSize)
 {
     bool sawUnfinished = false;
 
-    for (auto it = mMacMap.begin();
-        it != mMacMap.end(); )
+    for (size_t i = nextPresent(0); i < mMacs.size(); )
     {
-        if (!it->second.finished)
+        if (!mMacs[i].finished)
         {
             sawUnfinished = true;
         }
 
-        auto nextpos = ChunkedHash::chunkceil(it->first, fileSize);
-        auto expected_it = mMacMap.find(nextpos);
+        auto nextpos = ChunkedHash::chunkceil(ChunkedHash::chunkpos(mFirstIndex + i), fileSize);
+        ChunkMAC* expected = findEntry(nextpos);
 
-        if (sawUnfinished && expected_it != mMacMap.end() && expected_it->second.finished)
+        if (sawUnfinished && expected && expected->finished)
         {
             return true;
         }
 
-        ++it;
-        if (it != expected_it)
+        i = nextPresent(i + 1);
+        if (i < mMacs.size() ? &mMacs[i] != expected : expected != nullptr)
         {
             sawUnfinished = true;
         }
@@ -482,14 +588,14 @@ m_off_t chunkmac_map::hasUnfinishedGap(m_off_t fileSize)
 }
 
 
-void chunkmac_map::ctr_encrypt(m_off_t chunkid, SymmCipher *cipher, byte *chunkstart, unsigned chunksize, m_off_t startpos, int64_t ctriv, bool finishesChunk)
+void chunkmac_map::ctr_encrypt(m_off_t chunkid, SymmCipher *cipher, byte *chunkstart, unsigned chunksize, m_off_t startpos, int64_t ctriv, bool finishesChunk, const byte* plain)
 {
     assert(chunkid == startpos);
     assert(startpos > macsmacSoFarPos);
 
     // encrypt is always done on whole chunks
-    auto& chunk = mMacMap[chunkid];
-    cipher->ctr_crypt(chunkstart, unsigned(chunksize), startpos, ctriv, chunk.mac, true, true);
+    auto& chunk = entryAt(chunkid);
+    cipher->ctr_crypt(plain ? plain : chunkstart, chunkstart, unsigned(chunksize), startpos, ctriv, chunk.mac, true, true);
     chunk.offset = 0;
     chunk.finished = finishesChunk;  // when encrypting for uploads, only set finished after confirmation of the chunk uploading.
 }
@@ -500,7 +606,7 @@ void chunkmac_map::ctr_decrypt(m_off_t chunkid, SymmCipher *cipher, byte *chunks
     assert(chunkid > macsmacSoFarPos);
     assert(startpos >= chunkid);
     assert(startpos + chunksize <= ChunkedHash::chunkceil(chunkid));
-    ChunkMAC& chunk = mMacMap[chunkid];
+    ChunkMAC& chunk = entryAt(chunkid);
 
     cipher->ctr_crypt(chunkstart, chunksize, startpos, ctriv, chunk.mac, false, chunk.notStarted());
 
@@ -519,14 +625,15 @@ void chunkmac_map::ctr_decrypt(m_off_t chunkid, SymmCipher *cipher, byte *chunks
 
 void chunkmac_map::finishedUploadChunks(chunkmac_map& macs)
 {
-    for (auto& m : macs.mMacMap)
+    for (size_t i = macs.nextPresent(0); i < macs.mMacs.size(); i = macs.nextPresent(i + 1))
     {
-        assert(m.first > macsmacSoFarPos);
-        assert(mMacMap.find(m.first) == mMacMap.end() || !mMacMap[m.first].isMacsmacSoFar());
+        m_off_t pos = ChunkedHash::chunkpos(macs.mFirstIndex + i);
+        assert(pos > macsmacSoFarPos);
+        assert(!findEntry(pos) || !findEntry(pos)->isMacsmacSoFar());
 
-        m.second.finished = true;
-        mMacMap[m.first] = m.second;
-        LOG_verbose << "Upload chunk completed: " << m.first;
+        macs.mMacs[i].finished = true;
+        entryAt(pos) = macs.mMacs[i];
+        LOG_verbose << "Upload chunk completed: " << pos;
     }
 }
 
@@ -534,9 +641,8 @@ bool chunkmac_map::finishedAt(m_off_t pos)
 {
     assert(pos > macsmacSoFarPos);
 
-    auto pcit = mMacMap.find(pos);
-    return pcit != mMacMap.end()
-        && pcit->second.finished;
+    ChunkMAC* chunk = findEntry(pos);
+    return chunk && chunk->finished;
 }
 
 m_off_t chunkmac_map::updateContiguousProgress(m_off_t fileSize)
@@ -556,33 +662,35 @@ void chunkmac_map::updateMacsmacProgress(SymmCipher *cipher)
     while (macsmacSoFarPos + 1024 * 1024 * 5 < progresscontiguous  // never go past contiguous-from-start section
            && size() > 32 * 3 + 5)   // leave enough room for the mac-with-late-gaps corrective calculation to occur
     {
-        if (mMacMap.begin()->second.isMacsmacSoFar())
+        size_t first = nextPresent(0);
+
+        if (mMacs[first].isMacsmacSoFar())
         {
-            auto it = mMacMap.begin();
-            auto& calcSoFar = it->second;
-            auto& next = (++it)->second;
+            size_t second = nextPresent(first + 1);
+            auto& calcSoFar = mMacs[first];
+            auto& next = mMacs[second];
 
-            assert(it->first == ChunkedHash::chunkfloor(it->first));
             SymmCipher::xorblock(next.mac, calcSoFar.mac);
             cipher->ecb_encrypt(calcSoFar.mac);
             memcpy(next.mac, calcSoFar.mac, sizeof(next.mac));
 
-            macsmacSoFarPos = it->first;
+            macsmacSoFarPos = ChunkedHash::chunkpos(mFirstIndex + second);
             next.offset = unsigned(-1);
             assert(next.isMacsmacSoFar());
-            mMacMap.erase(mMacMap.begin());
+            mPresent[first] = false;
+            --mCount;
         }
-        else if (mMacMap.begin()->first == 0 && finishedAt(0))
+        else if (ChunkedHash::chunkpos(mFirstIndex + first) == 0 && finishedAt(0))
         {
-            auto& first = mMacMap.begin()->second;
+            auto& firstmac = mMacs[first];
 
             byte mac[SymmCipher::BLOCKSIZE] = { 0 };
-            SymmCipher::xorblock(first.mac, mac);
+            SymmCipher::xorblock(firstmac.mac, mac);
             cipher->ecb_encrypt(mac);
-            memcpy(first.mac, mac, sizeof(mac));
+            memcpy(firstmac.mac, mac, sizeof(mac));
 
-            first.offset = unsigned(-1);
-            assert(first.isMacsmacSoFar());
+            firstmac.offset = unsigned(-1);
+            assert(firstmac.isMacsmacSoFar());
             macsmacSoFarPos = 0;
         }
         updated = true;
@@ -590,30 +698,137 @@ void chunkmac_map::updateMacsmacProgress(SymmCipher *cipher)
 
     if (updated)
     {
-        LOG_verbose << "Macsmac calculation advanced to " << mMacMap.begin()->first;
+        trimFront();
+        LOG_verbose << "Macsmac calculation advanced to " << macsmacSoFarPos;
+    }
+}
+
+std::shared_ptr<chunkmac_map::MacsmacSegment> chunkmac_map::nextMacsmacSegment()
+{
+    if (mPendingSegment)
+    {
+        return nullptr;
+    }
+
+    // same limits as updateMacsmacProgress(), simulated over the entries without modifying them
+    m_off_t soFarPos = macsmacSoFarPos;
+    size_t count = size();
+    size_t i = nextPresent(0);
+
+    if (soFarPos + 1024 * 1024 * 5 >= progresscontiguous || count <= 32 * 3 + 5 || i == mMacs.size())
+    {
+        return nullptr;
+    }
+
+    auto segment = std::make_shared<MacsmacSegment>();
+    segment->prevSoFarPos = macsmacSoFarPos;
+
+    if (mMacs[i].isMacsmacSoFar())
+    {
+        memcpy(segment->mac, mMacs[i].mac, sizeof(segment->mac));
+    }
+    else if (ChunkedHash::chunkpos(mFirstIndex + i) == 0 && mMacs[i].finished)
+    {
+        memset(segment->mac, 0, sizeof(segment->mac));
+        segment->macs.emplace_back();
+        memcpy(segment->macs.back().data(), mMacs[i].mac, SymmCipher::BLOCKSIZE);
+        soFarPos = 0;
+    }
+    else
+    {
+        return nullptr;
+    }
+
+    while (soFarPos + 1024 * 1024 * 5 < progresscontiguous && count > 32 * 3 + 5)
+    {
+        i = nextPresent(i + 1);
+        if (i == mMacs.size() || !mMacs[i].finished)
+        {
+            break;
+        }
+
+        segment->macs.emplace_back();
+        memcpy(segment->macs.back().data(), mMacs[i].mac, SymmCipher::BLOCKSIZE);
+        soFarPos = ChunkedHash::chunkpos(mFirstIndex + i);
+        --count;
+    }
+
+    if (soFarPos == macsmacSoFarPos)
+    {
+        return nullptr;
+    }
+
+    segment->endPos = soFarPos;
+    mPendingSegment = segment;
+    return segment;
+}
+
+void chunkmac_map::MacsmacSegment::fold(SymmCipher& cipher)
+{
+    for (auto& m : macs)
+    {
+        SymmCipher::xorblock(m.data(), mac);
+        cipher.ecb_encrypt(mac);
+    }
+    done = true;
+}
+
+bool chunkmac_map::applyMacsmacSegment()
+{
+    if (!mPendingSegment || !mPendingSegment->done)
+    {
+        return false;
+    }
+
+    std::shared_ptr<MacsmacSegment> segment;
+    segment.swap(mPendingSegment);
+
+    // the folded chunks must still be exactly what was snapshotted
+    ChunkMAC* end = findEntry(segment->endPos);
+    if (macsmacSoFarPos != segment->prevSoFarPos || !end || !end->finished)
+    {
+        LOG_debug << "Discarding stale macsmac segment up to " << segment->endPos;
+        return false;
+    }
+
+    for (size_t i = nextPresent(0); i < mMacs.size() && ChunkedHash::chunkpos(mFirstIndex + i) < segment->endPos; i = nextPresent(i + 1))
+    {
+        mPresent[i] = false;
+        --mCount;
     }
+
+    memcpy(end->mac, segment->mac, sizeof(end->mac));
+    end->offset = unsigned(-1);
+    assert(end->isMacsmacSoFar());
+    macsmacSoFarPos = segment->endPos;
+    trimFront();
+
+    LOG_verbose << "Macsmac calculation advanced to " << macsmacSoFarPos;
+    return true;
 }
 
 void chunkmac_map::copyEntriesTo(chunkmac_map& other)
 {
-    for (auto& e : mMacMap)
+    for (size_t i = nextPresent(0); i < mMacs.size(); i = nextPresent(i + 1))
     {
-        assert(e.first > macsmacSoFarPos);
-        other.mMacMap[e.first] = e.second;
+        m_off_t pos = ChunkedHash::chunkpos(mFirstIndex + i);
+        assert(pos > macsmacSoFarPos);
+        other.entryAt(pos) = mMacs[i];
     }
 }
 
 void chunkmac_map::copyEntryTo(m_off_t pos, chunkmac_map& other)
 {
     assert(pos > macsmacSoFarPos);
-    mMacMap[pos] = other.mMacMap[pos];
+    ChunkMAC copy = other.entryAt(pos);
+    entryAt(pos) = copy;
 }
 
 void chunkmac_map::debugLogOuputMacs()
 {
-    for (auto& it : mMacMap)
+    for (size_t i = nextPresent(0); i < mMacs.size(); i = nextPresent(i + 1))
     {
-        LOG_debug << "macs: " << it.first << " " << Base64Str<SymmCipher::BLOCKSIZE>(it.second.mac) << " " << it.second.finished;
+        LOG_debug << "macs: " << ChunkedHash::chunkpos(mFirstIndex + i) << " " << Base64Str<SymmCipher::BLOCKSIZE>(mMacs[i].mac) << " " << mMacs[i].finished;
     }
 }
 
@@ -622,17 +837,16 @@ int64_t chunkmac_map::macsmac(SymmCipher *cipher)
 {
     byte mac[SymmCipher::BLOCKSIZE] = { 0 };
 
-    for (auto& it : mMacMap)
+    for (size_t i = nextPresent(0); i < mMacs.size(); i = nextPresent(i + 1))
     {
-        if (it.second.isMacsmacSoFar())
+        if (mMacs[i].isMacsmacSoFar())
         {
-            assert(it.first == mMacMap.begin()->first);
-            memcpy(mac, it.second.mac, sizeof(mac));
+            assert(i == nextPresent(0));
+            memcpy(mac, mMacs[i].mac, sizeof(mac));
         }
         else
         {
-            assert(it.first == ChunkedHash::chunkfloor(it.first));
-            SymmCipher::xorblock(it.second.mac, mac);
+            SymmCipher::xorblock(mMacs[i].mac, mac);
             cipher->ecb_encrypt(mac);
         }
     }
@@ -650,22 +864,20 @@ int64_t chunkmac_map::macsmac_gaps(SymmCipher *cipher, size_t g1, size_t g2, siz
     byte mac[SymmCipher::BLOCKSIZE] = { 0 };
 
     size_t n = 0;
-    for (auto it = mMacMap.begin(); it != mMacMap.end(); it++, n++)
+    for (size_t i = nextPresent(0); i < mMacs.size(); i = nextPresent(i + 1), n++)
     {
-        if (it->second.isMacsmacSoFar())
+        if (mMacs[i].isMacsmacSoFar())
         {
-            memcpy(mac, it->second.mac, sizeof(mac));
-            for (m_off_t pos = 0; pos <= it->first; pos = ChunkedHash::chunkceil(pos))
-            {
-                ++n;
-            }
+            memcpy(mac, mMacs[i].mac, sizeof(mac));
+
+            // the collapsed entry stands for every chunk up to and including its own
+            n += mFirstIndex + i + 1;
         }
         else
         {
             if ((n >= g1 && n < g2) || (n >= g3 && n < g4)) continue;
 
-            assert(it->first == ChunkedHash::chunkfloor(it->first));
-            SymmCipher::xorblock(it->second.mac, mac);
+            SymmCipher::xorblock(mMacs[i].mac, mac);
             cipher->ecb_encrypt(mac);
         }
     }
@@ -1002,6 +1214,33 @@ m_off_t ChunkedHash::chunkfloor(m_off_t p)
     return ((p - cp) & - (8 * SEGSIZE)) + cp;
 }
 
+size_t ChunkedHash::chunkindex(m_off_t p)
+{
+    m_off_t cp = 0;
+
+    for (unsigned i = 1; i <= 8; i++)
+    {
+        cp += i * SEGSIZE;
+
+        if (p < cp)
+        {
+            return i - 1;
+        }
+    }
+
+    return 8 + static_cast<size_t>((p - cp) / (8 * SEGSIZE));
+}
+
+m_off_t ChunkedHash::chunkpos(size_t i)
+{
+    if (i <= 8)
+    {
+        return static_cast<m_off_t>(i * (i + 1) / 2) * SEGSIZE;
+    }
+
+    return 36 * static_cast<m_off_t>(SEGSIZE) + static_cast<m_off_t>(i - 8) * 8 * SEGSIZE;
+}
+
 // end of chunk (== start of next chunk)
 m_off_t ChunkedHash::chunkceil(m_off_t p, m_off_t limit)
 {
@@ -1605,6 +1844,36 @@ string  Utils::toLowerUtf8(const string& text)
 }
 
 
+bool Utils::isAscii(const char* data, size_t size)
+{
+    // a word at a time: the OR of 8 bytes has a high bit set if any of them does
+    const uint64_t highBits = 0x8080808080808080ULL;
+    uint64_t acc = 0;
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        uint64_t w[4];
+        memcpy(w, data + i, sizeof w);
+        acc |= w[0] | w[1] | w[2] | w[3];
+    }
+
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t w;
+        memcpy(&w, data + i, sizeof w);
+        acc |= w;
+    }
+
+    uint8_t tail = 0;
+    for (; i < size; i++)
+    {
+        tail |= uint8_t(data[i]);
+    }
+
+    return !(acc & highBits) && !(tail & 0x80);
+}
+
 bool Utils::utf8toUnicode(const uint8_t *src, unsigned srclen, string *result)
 {
     uint8_t utf8cp1;
@@ -2282,6 +2551,169 @@ void tolower_string(std::string& str)
     std::transform(str.begin(), str.end(), str.begin(), [](char c) {return static_cast<char>(::tolower(c)); });
 }
 
+static bool isDigit(const char *c)
+{
+    return (*c >= '0' && *c <= '9');
+}
+
+// returns 0 if i==j, +1 if i goes first, -1 if j goes first.
+int naturalsorting_compare (const char *i, const char *j)
+{
+    static uint64_t maxNumber = (ULONG_MAX - 57) / 10; // 57 --> ASCII code for '9'
+
+    bool stringMode = true;
+
+    while (*i && *j)
+    {
+        if (stringMode)
+        {
+            char char_i, char_j;
+            while ( (char_i = *i) && (char_j = *j) )
+            {
+                bool char_i_isDigit = isDigit(i);
+                bool char_j_isDigit = isDigit(j);
+
+                if (char_i_isDigit && char_j_isDigit)
+                {
+                    stringMode = false;
+                    break;
+                }
+
+                if(char_i_isDigit)
+                {
+                    return -1;
+                }
+
+                if(char_j_isDigit)
+                {
+                    return 1;
+                }
+
+                int difference = strncasecmp((char *)&char_i, (char *)&char_j, 1);
+                if (difference)
+                {
+                    return difference;
+                }
+
+                ++i;
+                ++j;
+            }
+        }
+        else    // we are comparing numbers on both strings
+        {
+            uint64_t number_i = 0;
+            unsigned int i_overflow_count = 0;
+            while (*i && isDigit(i))
+            {
+                number_i = number_i * 10 + (*i - 48); // '0' ASCII code is 48
+                ++i;
+
+                // check the number won't overflow upon addition of next char
+                if (number_i >= maxNumber)
+                {
+                    number_i -= maxNumber;
+                    i_overflow_count++;
+                }
+            }
+
+            uint64_t number_j = 0;
+            unsigned int j_overflow_count = 0;
+            while (*j && isDigit(j))
+            {
+                number_j = number_j * 10 + (*j - 48);
+                ++j;
+
+                // check the number won't overflow upon addition of next char
+                if (number_j >= maxNumber)
+                {
+                    number_j -= maxNumber;
+                    j_overflow_count++;
+                }
+            }
+
+            int difference = i_overflow_count - j_overflow_count;
+            if (difference)
+            {
+                return difference;
+            }
+
+            if (number_i != number_j)
+            {
+                return number_i > number_j ? 1 : -1;
+            }
+
+            stringMode = true;
+        }
+    }
+
+    if (*j)
+    {
+        return -1;
+    }
+
+    if (*i)
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+std::string naturalsortingKey(const std::string& name)
+{
+    // Layout, chosen so that a plain byte comparison (memcmp) of two keys
+    // orders them like naturalsorting_compare():
+    //  - a run of digits becomes 0x01, the number of significant digits as
+    //    two big-endian bytes, and the digits without leading zeros. The
+    //    marker sorts before any other character, and the length prefix makes
+    //    longer numbers sort after shorter ones.
+    //  - any other byte is lowercased (ASCII only, like strncasecmp in the C
+    //    locale). Bytes 0x01 and 0x02 are escaped with a 0x02 prefix so they
+    //    can't be confused with the digit marker.
+    std::string key;
+    key.reserve(name.size() + 4);
+
+    for (size_t pos = 0; pos < name.size(); )
+    {
+        unsigned char c = static_cast<unsigned char>(name[pos]);
+        if (isDigit(&name[pos]))
+        {
+            size_t end = pos;
+            while (end < name.size() && isDigit(&name[end]))
+            {
+                ++end;
+            }
+
+            size_t first = pos;
+            while (first < end && name[first] == '0')
+            {
+                ++first;
+            }
+
+            size_t digits = std::min<size_t>(end - first, 0xFFFF);
+            key.push_back('\x01');
+            key.push_back(static_cast<char>((digits >> 8) & 0xFF));
+            key.push_back(static_cast<char>(digits & 0xFF));
+            key.append(name, first, digits);
+            pos = end;
+            continue;
+        }
+
+        if (c == 0x01 || c == 0x02)
+        {
+            key.push_back('\x02');
+        }
+        else if (c >= 'A' && c <= 'Z')
+        {
+            c = static_cast<unsigned char>(c - 'A' + 'a');
+        }
+        key.push_back(static_cast<char>(c));
+        ++pos;
+    }
+
+    return key;
+}
+
 #ifdef __APPLE__
 int macOSmajorVersion()
 {
@@ -2429,80 +2861,1273 @@ std::pair<bool, int64_t> generateMetaMac(SymmCipher &cipher, InputStreamAccess &
 
 void MegaClientAsyncQueue::push(std::function<void(SymmCipher&)> f, bool discardable)
 {
-    if (mThreads.empty())
+    if (mThreads.empty() && !mShared)
     {
         if (f)
         {
             f(mZeroThreadsCipher);
         }
     }
+    else if (mBatchDepth)
+    {
+        mBatched.emplace_back(discardable, std::move(f));
+    }
     else
     {
+        if (f)
+        {
+            ThreadTopology::queued(ThreadTopology::CRYPTO, 1);
+        }
         {
             std::lock_guard<std::mutex> g(mMutex);
             mQueue.emplace_back(discardable, std::move(f));
+            mPeakQueueDepth = std::max(mPeakQueueDepth, mQueue.size());
         }
-        mConditionVariable.notify_one();
-    }
-}
 
-MegaClientAsyncQueue::MegaClientAsyncQueue(Waiter& w, unsigned threadCount)
-    : mWaiter(w)
-{
-    for (int i = threadCount; i--; )
-    {
-        try
+        if (mShared)
         {
-            mThreads.emplace_back([this]()
-            {
-                asyncThreadLoop();
-            });
+            SharedAsyncWorkers::instance().ready(*this);
         }
-        catch (std::system_error& e)
+        else
         {
-            LOG_err << "Failed to start worker thread: " << e.what();
-            break;
+            mConditionVariable.notify_one();
         }
     }
-    LOG_debug << "MegaClient Worker threads running: " << mThreads.size();
 }
 
-MegaClientAsyncQueue::~MegaClientAsyncQueue()
+void MegaClientAsyncQueue::flushBatch()
 {
-    clearDiscardable();
-    push(nullptr, false);
-    mConditionVariable.notify_all();
-    LOG_warn << "~MegaClientAsyncQueue() joining threads";
-    for (auto& t : mThreads)
+    if (mBatched.empty())
     {
-        t.join();
+        return;
     }
-    LOG_warn << "~MegaClientAsyncQueue() ends";
-}
-
-void MegaClientAsyncQueue::clearDiscardable()
-{
-    std::lock_guard<std::mutex> g(mMutex);
-    auto newEnd = std::remove_if(mQueue.begin(), mQueue.end(), [](Entry& entry){ return entry.discardable; });
-    mQueue.erase(newEnd, mQueue.end());
-}
+
+    size_t n = mBatched.size();
+    ThreadTopology::queued(ThreadTopology::CRYPTO, std::count_if(mBatched.begin(), mBatched.end(), [](const Entry& e) { return bool(e.f); }));
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        for (auto& e : mBatched)
+        {
+            mQueue.emplace_back(e.discardable, std::move(e.f));
+        }
+        mPeakQueueDepth = std::max(mPeakQueueDepth, mQueue.size());
+    }
+    mBatched.clear();
+
+    if (mShared)
+    {
+        SharedAsyncWorkers::instance().ready(*this);
+    }
+    else if (n > 1)
+    {
+        mConditionVariable.notify_all();
+    }
+    else
+    {
+        mConditionVariable.notify_one();
+    }
+}
+
+MegaClientAsyncQueue::Batch::Batch(MegaClientAsyncQueue& q)
+    : mQueue(q)
+{
+    ++mQueue.mBatchDepth;
+}
+
+MegaClientAsyncQueue::Batch::~Batch()
+{
+    if (!--mQueue.mBatchDepth)
+    {
+        mQueue.flushBatch();
+    }
+}
+
+size_t MegaClientAsyncQueue::queueDepth()
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    return mQueue.size();
+}
+
+size_t MegaClientAsyncQueue::peakQueueDepth(bool reset)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    size_t peak = mPeakQueueDepth;
+    if (reset)
+    {
+        mPeakQueueDepth = mQueue.size();
+    }
+    return peak;
+}
+
+size_t MegaClientAsyncQueue::threadCount() const
+{
+    return mShared ? SharedAsyncWorkers::instance().threadCount() : mThreads.size();
+}
+
+std::atomic<bool> MegaClientAsyncQueue::sSharedWorkers{false};
+
+void MegaClientAsyncQueue::setSharedWorkers(bool shared)
+{
+    sSharedWorkers = shared;
+}
+
+MegaClientAsyncQueue::MegaClientAsyncQueue(Waiter& w, unsigned threadCount)
+    : mWaiter(w)
+{
+    // no threads is a choice of the owner (work is done synchronously), the topology only resizes the pool
+    if (threadCount)
+    {
+        threadCount = ThreadTopology::poolSize(ThreadTopology::CRYPTO, threadCount);
+
+        if (sSharedWorkers && SharedAsyncWorkers::instance().threadCount())
+        {
+            mShared = true;
+            LOG_debug << "MegaClient Worker threads shared: " << SharedAsyncWorkers::instance().threadCount();
+            return;
+        }
+    }
+
+    for (int i = threadCount; i--; )
+    {
+        try
+        {
+            mThreads.emplace_back([this]()
+            {
+                asyncThreadLoop();
+            });
+        }
+        catch (std::system_error& e)
+        {
+            LOG_err << "Failed to start worker thread: " << e.what();
+            break;
+        }
+    }
+    LOG_debug << "MegaClient Worker threads running: " << mThreads.size();
+}
+
+MegaClientAsyncQueue::~MegaClientAsyncQueue()
+{
+    clearDiscardable();
+
+    if (mShared)
+    {
+        // like the own threads would, the shared workers run what's left before it goes
+        flushBatch();
+        {
+            std::unique_lock<std::mutex> g(mMutex);
+            mConditionVariable.wait(g, [this]() { return mQueue.empty() && !mRunning; });
+        }
+        SharedAsyncWorkers::instance().remove(*this);
+        return;
+    }
+
+    push(nullptr, false);
+    mConditionVariable.notify_all();
+    LOG_warn << "~MegaClientAsyncQueue() joining threads";
+    for (auto& t : mThreads)
+    {
+        t.join();
+    }
+    LOG_warn << "~MegaClientAsyncQueue() ends";
+}
+
+void MegaClientAsyncQueue::clearDiscardable()
+{
+    mBatched.erase(std::remove_if(mBatched.begin(), mBatched.end(), [](Entry& entry){ return entry.discardable; }), mBatched.end());
+
+    std::lock_guard<std::mutex> g(mMutex);
+    ThreadTopology::queued(ThreadTopology::CRYPTO, -std::count_if(mQueue.begin(), mQueue.end(), [](const Entry& e) { return e.discardable && e.f; }));
+    auto newEnd = std::remove_if(mQueue.begin(), mQueue.end(), [](Entry& entry){ return entry.discardable; });
+    mQueue.erase(newEnd, mQueue.end());
+}
+
+void MegaClientAsyncQueue::pin()
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    ++mRunning;
+}
+
+void MegaClientAsyncQueue::runOne(SymmCipher& cipher)
+{
+    std::function<void(SymmCipher&)> f;
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        if (mQueue.empty())
+        {
+            // discarded meanwhile
+            return;
+        }
+        f = std::move(mQueue.front().f);
+        mQueue.pop_front();
+    }
+
+    ThreadTopology::queued(ThreadTopology::CRYPTO, -1);
+    {
+        ThreadTopology::Busy busy(ThreadTopology::CRYPTO);
+        f(cipher);
+    }
+    mWaiter.notifyBy(Waiter::NOTIFY_ASYNCQUEUE);
+}
+
+bool MegaClientAsyncQueue::unpin()
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    --mRunning;
+    // notified under the lock: the destructor may be waiting for this, to delete the queue
+    mConditionVariable.notify_all();
+    return !mQueue.empty();
+}
+
+SharedAsyncWorkers& SharedAsyncWorkers::instance()
+{
+    static SharedAsyncWorkers workers(ThreadTopology::poolSize(ThreadTopology::CRYPTO, std::max(1u, std::thread::hardware_concurrency())));
+    return workers;
+}
+
+SharedAsyncWorkers::SharedAsyncWorkers(unsigned threadCount)
+{
+    for (unsigned i = threadCount; i--; )
+    {
+        try
+        {
+            mThreads.emplace_back([this]()
+            {
+                threadLoop();
+            });
+        }
+        catch (std::system_error& e)
+        {
+            LOG_err << "Failed to start shared worker thread: " << e.what();
+            break;
+        }
+    }
+    LOG_debug << "Shared worker threads running: " << mThreads.size();
+}
+
+SharedAsyncWorkers::~SharedAsyncWorkers()
+{
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mShutdown = true;
+    }
+    mConditionVariable.notify_all();
+    for (auto& t : mThreads)
+    {
+        t.join();
+    }
+}
+
+void SharedAsyncWorkers::ready(MegaClientAsyncQueue& queue)
+{
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        if (queue.mReady)
+        {
+            return;
+        }
+        queue.mReady = true;
+        mReady.push_back(&queue);
+    }
+    mConditionVariable.notify_one();
+}
+
+void SharedAsyncWorkers::remove(MegaClientAsyncQueue& queue)
+{
+    std::unique_lock<std::mutex> g(mMutex);
+    auto it = std::find(mReady.begin(), mReady.end(), &queue);
+    if (it != mReady.end())
+    {
+        mReady.erase(it);
+    }
+
+    // a worker may have taken it right before it ran dry (pin and unpin happen under this lock)
+    ++mRemoving;
+    mConditionVariable.wait(g, [&queue]() { return !queue.mRunning; });
+    --mRemoving;
+    queue.mReady = false;
+}
+
+void SharedAsyncWorkers::threadLoop()
+{
+    ThreadTopology::threadStarted(ThreadTopology::CRYPTO);
+
+    SymmCipher cipher;
+    std::unique_lock<std::mutex> g(mMutex);
+    for (;;)
+    {
+        mConditionVariable.wait(g, [this]() { return mShutdown || !mReady.empty(); });
+        if (mShutdown)
+        {
+            break;
+        }
+
+        // while it's running, the queue stays out of the list: its entries run one at a time,
+        // in order, and another worker takes the next client meanwhile
+        MegaClientAsyncQueue* queue = mReady.front();
+        mReady.pop_front();
+        queue->pin();
+
+        g.unlock();
+        queue->runOne(cipher);
+        g.lock();
+
+        // entries pushed meanwhile found it out of the list, but still marked ready.
+        // Once unpinned and empty, the queue may only be deleted after this lock is released
+        if (queue->unpin())
+        {
+            mReady.push_back(queue);
+            mConditionVariable.notify_one();
+        }
+        else
+        {
+            queue->mReady = false;
+        }
+
+        if (mRemoving)
+        {
+            mConditionVariable.notify_all();
+        }
+    }
+
+    ThreadTopology::threadStopped(ThreadTopology::CRYPTO);
+}
 
 void MegaClientAsyncQueue::asyncThreadLoop()
 {
-    SymmCipher cipher;
+    ThreadTopology::threadStarted(ThreadTopology::CRYPTO);
+
+    SymmCipher cipher;
+    for (;;)
+    {
+        std::function<void(SymmCipher&)> f;
+        {
+            std::unique_lock<std::mutex> g(mMutex);
+            mConditionVariable.wait(g, [this]() { return !mQueue.empty(); });
+            f = std::move(mQueue.front().f);
+            if (!f) break;   // nullptr is not popped, and causes all the threads to exit
+            mQueue.pop_front();
+        }
+        ThreadTopology::queued(ThreadTopology::CRYPTO, -1);
+        {
+            ThreadTopology::Busy busy(ThreadTopology::CRYPTO);
+            f(cipher);
+        }
+        mWaiter.notifyBy(Waiter::NOTIFY_ASYNCQUEUE);
+    }
+
+    ThreadTopology::threadStopped(ThreadTopology::CRYPTO);
+}
+
+namespace {
+
+struct ThreadRole
+{
+    std::mutex mutex;
+    ThreadTopology::Settings settings;
+    std::chrono::steady_clock::time_point since = std::chrono::steady_clock::now();
+    // thread time accumulated by the threads that stopped since the previous reset
+    std::chrono::steady_clock::duration stoppedTime{0};
+
+    std::atomic<unsigned> threads{0};
+    std::atomic<long long> queueDepth{0};
+    std::atomic<long long> busyNs{0};
+};
+
+ThreadRole& threadRole(ThreadTopology::Role role)
+{
+    static ThreadRole roles[ThreadTopology::NUM_ROLES];
+    assert(role >= 0 && role < ThreadTopology::NUM_ROLES);
+    return roles[role];
+}
+
+} // namespace
+
+void ThreadTopology::configure(Role role, const Settings& settings)
+{
+    ThreadRole& r = threadRole(role);
+    std::lock_guard<std::mutex> g(r.mutex);
+    r.settings = settings;
+}
+
+ThreadTopology::Settings ThreadTopology::settings(Role role)
+{
+    ThreadRole& r = threadRole(role);
+    std::lock_guard<std::mutex> g(r.mutex);
+    return r.settings;
+}
+
+unsigned ThreadTopology::poolSize(Role role, unsigned defaultSize)
+{
+    unsigned size = settings(role).poolSize;
+    return size ? size : defaultSize;
+}
+
+void ThreadTopology::threadStarted(Role role)
+{
+    ThreadRole& r = threadRole(role);
+    Settings s = settings(role);
+
+#ifdef __linux__
+    pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+
+    if (!s.cpus.empty())
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu : s.cpus)
+        {
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+            {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+
+        if (sched_setaffinity(tid, sizeof(cpus), &cpus))
+        {
+            LOG_warn << "Unable to set the CPU affinity of a thread of role " << role << ": " << errno;
+        }
+    }
+
+    if (s.nice && setpriority(PRIO_PROCESS, static_cast<id_t>(tid), s.nice))
+    {
+        LOG_warn << "Unable to set the nice level of a thread of role " << role << ": " << errno;
+    }
+#endif
+
+    std::lock_guard<std::mutex> g(r.mutex);
+    // account its time from now on, as if it had been running since the last reset
+    r.stoppedTime -= std::chrono::steady_clock::now() - r.since;
+    ++r.threads;
+}
+
+void ThreadTopology::threadStopped(Role role)
+{
+    ThreadRole& r = threadRole(role);
+    std::lock_guard<std::mutex> g(r.mutex);
+    r.stoppedTime += std::chrono::steady_clock::now() - r.since;
+    --r.threads;
+}
+
+ThreadTopology::Busy::Busy(Role role)
+    : mRole(role)
+    , mStart(std::chrono::steady_clock::now())
+{
+}
+
+ThreadTopology::Busy::~Busy()
+{
+    auto busy = std::chrono::steady_clock::now() - mStart;
+    threadRole(mRole).busyNs += std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count();
+}
+
+void ThreadTopology::queued(Role role, long long delta)
+{
+    threadRole(role).queueDepth += delta;
+}
+
+ThreadTopology::Stats ThreadTopology::stats(Role role, bool reset)
+{
+    ThreadRole& r = threadRole(role);
+    std::lock_guard<std::mutex> g(r.mutex);
+
+    auto now = std::chrono::steady_clock::now();
+    auto threadTime = (now - r.since) * r.threads.load() + r.stoppedTime;
+    long long threadNs = std::chrono::duration_cast<std::chrono::nanoseconds>(threadTime).count();
+
+    Stats stats;
+    stats.threads = r.threads;
+    stats.queueDepth = r.queueDepth;
+    stats.utilization = threadNs > 0 ? std::min(1.0, double(r.busyNs.load()) / double(threadNs)) : 0;
+
+    if (reset)
+    {
+        r.since = now;
+        r.stoppedTime = std::chrono::steady_clock::duration(0);
+        r.busyNs = 0;
+    }
+
+    return stats;
+}
+
+namespace {
+// counters and histograms of one thread: only that thread writes them (no read-modify-write needed),
+// snapshots read them under the registry mutex
+struct MetricsShard
+{
+    std::atomic<uint64_t> values[Metrics::MAX_METRICS];     // counter value, or number of histogram samples
+    std::atomic<uint64_t> sums[Metrics::MAX_METRICS];       // histogram, microseconds
+    std::atomic<std::atomic<uint64_t>*> buckets[Metrics::MAX_METRICS];  // histogram, allocated on first use
+    unsigned ticks[Metrics::MAX_METRICS];                   // histogram sampling, owner thread only
+
+    MetricsShard()
+    {
+        for (unsigned i = 0; i < Metrics::MAX_METRICS; i++)
+        {
+            values[i].store(0, std::memory_order_relaxed);
+            sums[i].store(0, std::memory_order_relaxed);
+            buckets[i].store(nullptr, std::memory_order_relaxed);
+            ticks[i] = 0;
+        }
+    }
+
+    ~MetricsShard()
+    {
+        for (unsigned i = 0; i < Metrics::MAX_METRICS; i++)
+        {
+            delete[] buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    static void add(std::atomic<uint64_t>& v, uint64_t n)
+    {
+        v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t>* histogramBuckets(unsigned id)
+    {
+        std::atomic<uint64_t>* b = buckets[id].load(std::memory_order_relaxed);
+        if (!b)
+        {
+            b = new std::atomic<uint64_t>[Metrics::HISTOGRAM_BUCKETS];
+            for (unsigned i = 0; i < Metrics::HISTOGRAM_BUCKETS; i++)
+            {
+                b[i].store(0, std::memory_order_relaxed);
+            }
+            buckets[id].store(b, std::memory_order_release);
+        }
+        return b;
+    }
+
+    // into 'to', under the registry mutex
+    void addTo(MetricsShard& to)
+    {
+        for (unsigned i = 0; i < Metrics::MAX_METRICS; i++)
+        {
+            add(to.values[i], values[i].load(std::memory_order_relaxed));
+            add(to.sums[i], sums[i].load(std::memory_order_relaxed));
+            if (std::atomic<uint64_t>* b = buckets[i].load(std::memory_order_acquire))
+            {
+                std::atomic<uint64_t>* tb = to.histogramBuckets(i);
+                for (unsigned j = 0; j < Metrics::HISTOGRAM_BUCKETS; j++)
+                {
+                    add(tb[j], b[j].load(std::memory_order_relaxed));
+                }
+            }
+        }
+    }
+};
+
+struct MetricsRegistry
+{
+    struct Info
+    {
+        string name;
+        string help;
+        Metrics::Type type;
+        unsigned sampleEvery;
+    };
+
+    std::mutex mutex;
+    std::atomic<unsigned> count { 0 };
+    Info infos[Metrics::MAX_METRICS];
+    std::atomic<int64_t> gauges[Metrics::MAX_METRICS];
+    std::vector<MetricsShard*> shards;
+    MetricsShard retired;   // figures of the threads that ended
+
+    MetricsRegistry()
+    {
+        for (auto& g : gauges)
+        {
+            g.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // never destroyed: threads may still update metrics while the process exits
+    static MetricsRegistry& instance()
+    {
+        static MetricsRegistry* registry = new MetricsRegistry;
+        return *registry;
+    }
+
+    unsigned add(const string& name, const string& help, Metrics::Type type, unsigned sampleEvery)
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        unsigned n = count.load(std::memory_order_relaxed);
+        for (unsigned i = 0; i < n; i++)
+        {
+            if (infos[i].name == name && infos[i].type == type)
+            {
+                return i;
+            }
+        }
+        if (n == Metrics::MAX_METRICS)
+        {
+            LOG_err << "Too many metrics, not collecting " << name;
+            return Metrics::MAX_METRICS;
+        }
+        infos[n].name = name;
+        infos[n].help = help;
+        infos[n].type = type;
+        infos[n].sampleEvery = std::max(1u, sampleEvery);
+        count.store(n + 1, std::memory_order_release);
+        return n;
+    }
+};
+
+struct MetricsShardHolder
+{
+    MetricsShard* shard = nullptr;
+
+    MetricsShard& get()
+    {
+        if (!shard)
+        {
+            shard = new MetricsShard;
+            MetricsRegistry& r = MetricsRegistry::instance();
+            std::lock_guard<std::mutex> g(r.mutex);
+            r.shards.push_back(shard);
+        }
+        return *shard;
+    }
+
+    ~MetricsShardHolder()
+    {
+        if (shard)
+        {
+            MetricsRegistry& r = MetricsRegistry::instance();
+            std::lock_guard<std::mutex> g(r.mutex);
+            shard->addTo(r.retired);
+            r.shards.erase(std::remove(r.shards.begin(), r.shards.end(), shard), r.shards.end());
+            delete shard;
+        }
+    }
+};
+
+thread_local MetricsShardHolder metricsShard;
+
+string openMetricsName(const string& name)
+{
+    string s = "mega_";
+    for (char c : name)
+    {
+        s += isalnum(static_cast<unsigned char>(c)) ? static_cast<char>(tolower(static_cast<unsigned char>(c))) : '_';
+    }
+    return s;
+}
+
+string openMetricsEscape(const string& help)
+{
+    string s;
+    for (char c : help)
+    {
+        if (c == '\\' || c == '"') s += '\\';
+        if (c == '\n') { s += "\\n"; continue; }
+        s += c;
+    }
+    return s;
+}
+}
+
+const unsigned Metrics::MAX_METRICS;
+const unsigned Metrics::HISTOGRAM_BUCKETS;
+
+void Metrics::Counter::add(uint64_t n) const
+{
+    if (mId < MAX_METRICS)
+    {
+        MetricsShard::add(metricsShard.get().values[mId], n);
+    }
+}
+
+void Metrics::Gauge::set(int64_t value) const
+{
+    if (mId < MAX_METRICS)
+    {
+        MetricsRegistry::instance().gauges[mId].store(value, std::memory_order_relaxed);
+    }
+}
+
+void Metrics::Gauge::add(int64_t delta) const
+{
+    if (mId < MAX_METRICS)
+    {
+        MetricsRegistry::instance().gauges[mId].fetch_add(delta, std::memory_order_relaxed);
+    }
+}
+
+bool Metrics::Histogram::sample() const
+{
+    if (mId >= MAX_METRICS)
+    {
+        return false;
+    }
+    if (mSampleEvery == 1)
+    {
+        return true;
+    }
+    unsigned& ticks = metricsShard.get().ticks[mId];
+    if (++ticks < mSampleEvery)
+    {
+        return false;
+    }
+    ticks = 0;
+    return true;
+}
+
+void Metrics::Histogram::record(std::chrono::steady_clock::duration d) const
+{
+    if (sample())
+    {
+        recordSampled(static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(d).count())));
+    }
+}
+
+void Metrics::Histogram::recordSampled(uint64_t microseconds) const
+{
+    MetricsShard& shard = metricsShard.get();
+    MetricsShard::add(shard.values[mId], 1);
+    MetricsShard::add(shard.sums[mId], microseconds);
+    MetricsShard::add(shard.histogramBuckets(mId)[bucketOf(microseconds)], 1);
+}
+
+Metrics::Timer::Timer(const Histogram& h)
+    : mHistogram(h)
+    , mSampled(h.sample())
+{
+    if (mSampled)
+    {
+        mStart = std::chrono::steady_clock::now();
+    }
+}
+
+void Metrics::Timer::stop()
+{
+    if (mSampled)
+    {
+        mSampled = false;
+        auto d = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - mStart);
+        mHistogram.recordSampled(static_cast<uint64_t>(d.count()));
+    }
+}
+
+Metrics::Counter Metrics::counter(const string& name, const string& help)
+{
+    Counter c;
+    c.mId = MetricsRegistry::instance().add(name, help, COUNTER, 1);
+    return c;
+}
+
+Metrics::Gauge Metrics::gauge(const string& name, const string& help)
+{
+    Gauge g;
+    g.mId = MetricsRegistry::instance().add(name, help, GAUGE, 1);
+    return g;
+}
+
+Metrics::Histogram Metrics::histogram(const string& name, const string& help, unsigned sampleEvery)
+{
+    Histogram h;
+    h.mId = MetricsRegistry::instance().add(name, help, HISTOGRAM, sampleEvery);
+    if (h.mId < MAX_METRICS)
+    {
+        // the one of the first registration
+        std::lock_guard<std::mutex> g(MetricsRegistry::instance().mutex);
+        h.mSampleEvery = MetricsRegistry::instance().infos[h.mId].sampleEvery;
+    }
+    return h;
+}
+
+unsigned Metrics::bucketOf(uint64_t microseconds)
+{
+    const uint64_t subBuckets = 1u << HISTOGRAM_SUB_BITS;
+    if (microseconds < subBuckets)
+    {
+        return static_cast<unsigned>(microseconds);
+    }
+
+    const uint64_t largest = (uint64_t(1) << (HISTOGRAM_MAX_EXPONENT + 1)) - 1;
+    microseconds = std::min(microseconds, largest);
+
+    unsigned exponent = HISTOGRAM_SUB_BITS;
+    while (microseconds >> (exponent + 1))
+    {
+        ++exponent;
+    }
+    return static_cast<unsigned>(((exponent - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+                                 | ((microseconds >> (exponent - HISTOGRAM_SUB_BITS)) & (subBuckets - 1)));
+}
+
+uint64_t Metrics::bucketLowerBound(unsigned bucket)
+{
+    const unsigned subBuckets = 1u << HISTOGRAM_SUB_BITS;
+    if (bucket < subBuckets)
+    {
+        return bucket;
+    }
+    unsigned exponent = (bucket >> HISTOGRAM_SUB_BITS) + HISTOGRAM_SUB_BITS - 1;
+    return uint64_t(subBuckets + (bucket & (subBuckets - 1))) << (exponent - HISTOGRAM_SUB_BITS);
+}
+
+uint64_t Metrics::Entry::percentileMicroseconds(double percentile) const
+{
+    if (type != HISTOGRAM || value <= 0 || buckets.empty())
+    {
+        return 0;
+    }
+
+    uint64_t total = 0;
+    for (uint64_t b : buckets)
+    {
+        total += b;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(std::ceil(std::min(std::max(percentile, 0.0), 100.0) / 100 * static_cast<double>(total)));
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < buckets.size(); i++)
+    {
+        seen += buckets[i];
+        if (buckets[i] && seen >= rank)
+        {
+            return i + 1 < HISTOGRAM_BUCKETS ? bucketLowerBound(i + 1) : bucketLowerBound(i);
+        }
+    }
+    return bucketLowerBound(HISTOGRAM_BUCKETS - 1);
+}
+
+std::vector<Metrics::Entry> Metrics::snapshot()
+{
+    MetricsRegistry& r = MetricsRegistry::instance();
+    std::lock_guard<std::mutex> g(r.mutex);
+
+    MetricsShard total;
+    r.retired.addTo(total);
+    for (MetricsShard* shard : r.shards)
+    {
+        shard->addTo(total);
+    }
+
+    std::vector<Entry> entries;
+    unsigned n = r.count.load(std::memory_order_acquire);
+    for (unsigned i = 0; i < n; i++)
+    {
+        const MetricsRegistry::Info& info = r.infos[i];
+        Entry e;
+        e.name = info.name;
+        e.help = info.help;
+        e.type = info.type;
+        switch (info.type)
+        {
+            case COUNTER:
+                e.value = static_cast<int64_t>(total.values[i].load(std::memory_order_relaxed));
+                break;
+
+            case GAUGE:
+                e.value = r.gauges[i].load(std::memory_order_relaxed);
+                break;
+
+            case HISTOGRAM:
+                e.value = static_cast<int64_t>(total.values[i].load(std::memory_order_relaxed) * info.sampleEvery);
+                e.sumMicroseconds = total.sums[i].load(std::memory_order_relaxed) * info.sampleEvery;
+                e.buckets.resize(HISTOGRAM_BUCKETS);
+                if (std::atomic<uint64_t>* b = total.buckets[i].load(std::memory_order_relaxed))
+                {
+                    for (unsigned j = 0; j < HISTOGRAM_BUCKETS; j++)
+                    {
+                        e.buckets[j] = b[j].load(std::memory_order_relaxed) * info.sampleEvery;
+                    }
+                }
+                break;
+        }
+        entries.push_back(std::move(e));
+    }
+    return entries;
+}
+
+std::string Metrics::toOpenMetrics(const std::vector<Entry>& entries)
+{
+    std::ostringstream s;
+    for (const Entry& e : entries)
+    {
+        string name = openMetricsName(e.name);
+        switch (e.type)
+        {
+            case COUNTER:
+                s << "# TYPE " << name << " counter\n"
+                  << "# HELP " << name << " " << openMetricsEscape(e.help) << "\n"
+                  << name << "_total " << e.value << "\n";
+                break;
+
+            case GAUGE:
+                s << "# TYPE " << name << " gauge\n"
+                  << "# HELP " << name << " " << openMetricsEscape(e.help) << "\n"
+                  << name << " " << e.value << "\n";
+                break;
+
+            case HISTOGRAM:
+            {
+                // cumulative counts at each power of two microseconds, where the buckets are aligned
+                name += "_seconds";
+                s << "# TYPE " << name << " histogram\n"
+                  << "# HELP " << name << " " << openMetricsEscape(e.help) << "\n";
+                uint64_t cumulative = 0;
+                unsigned next = 0;
+                for (unsigned exponent = 0; exponent <= HISTOGRAM_MAX_EXPONENT; exponent++)
+                {
+                    uint64_t bound = uint64_t(1) << exponent;
+                    for (; next < e.buckets.size() && bucketLowerBound(next) < bound; next++)
+                    {
+                        cumulative += e.buckets[next];
+                    }
+                    s << name << "_bucket{le=\"" << static_cast<double>(bound) / 1000000 << "\"} " << cumulative << "\n";
+                }
+                s << name << "_bucket{le=\"+Inf\"} " << e.value << "\n"
+                  << name << "_sum " << static_cast<double>(e.sumMicroseconds) / 1000000 << "\n"
+                  << name << "_count " << e.value << "\n";
+                break;
+            }
+        }
+    }
+    s << "# EOF\n";
+    return s.str();
+}
+
+size_t MemoryReport::heapBytes(const std::string& s)
+{
+    uintptr_t data = reinterpret_cast<uintptr_t>(s.data());
+    uintptr_t self = reinterpret_cast<uintptr_t>(&s);
+    return (data >= self && data < self + sizeof(s)) ? 0 : s.capacity() + 1;
+}
+
+void MemoryReport::add(const std::string& subsystem, uint64_t objects, uint64_t bytes)
+{
+    for (Entry& e : entries)
+    {
+        if (e.subsystem == subsystem)
+        {
+            e.objects += objects;
+            e.bytes += bytes;
+            return;
+        }
+    }
+
+    Entry e;
+    e.subsystem = subsystem;
+    e.objects = objects;
+    e.bytes = bytes;
+    entries.push_back(std::move(e));
+}
+
+uint64_t MemoryReport::totalBytes() const
+{
+    uint64_t total = 0;
+    for (const Entry& e : entries)
+    {
+        total += e.bytes;
+    }
+    return total;
+}
+
+std::string MemoryReport::toJson() const
+{
+    // subsystem names are identifiers chosen by the SDK, they need no escaping
+    std::ostringstream s;
+    s << "{\"subsystems\":[";
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        s << (i ? "," : "") << "{\"name\":\"" << entries[i].subsystem << "\",\"objects\":" << entries[i].objects
+          << ",\"bytes\":" << entries[i].bytes << "}";
+    }
+    s << "],\"bytes\":" << totalBytes() << "}";
+    return s.str();
+}
+
+KeyDerivationService& KeyDerivationService::instance()
+{
+    static KeyDerivationService service(std::max(1u, std::thread::hardware_concurrency()));
+    return service;
+}
+
+KeyDerivationService::KeyDerivationService(unsigned threadCount)
+{
+    for (unsigned i = threadCount; i--; )
+    {
+        try
+        {
+            mThreads.emplace_back([this]()
+            {
+                threadLoop();
+            });
+        }
+        catch (std::system_error& e)
+        {
+            LOG_err << "Failed to start key derivation thread: " << e.what();
+            break;
+        }
+    }
+    LOG_debug << "Key derivation threads running: " << mThreads.size();
+}
+
+KeyDerivationService::~KeyDerivationService()
+{
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mShutdown = true;
+    }
+    mConditionVariable.notify_all();
+    for (auto& t : mThreads)
+    {
+        t.join();
+    }
+}
+
+// overwrite the password before its memory is released: through a volatile pointer, so the
+// stores aren't dropped as dead
+static void wipePassword(string& password)
+{
+    volatile char* p = &password[0];
+    for (size_t i = password.size(); i--; )
+    {
+        p[i] = 0;
+    }
+    password.clear();
+}
+
+KeyDerivationService::RequestPtr KeyDerivationService::derive(const string& password, const string& salt, unsigned iterations, size_t keyLength, Waiter* waiter)
+{
+    auto request = std::make_shared<Request>();
+    request->password = password;
+    request->salt = salt;
+    request->iterations = iterations;
+    request->keyLength = keyLength;
+    request->waiter = waiter;
+
+    if (mThreads.empty())
+    {
+        // no workers could be started: derive right here
+        PBKDF2_HMAC_SHA512 pbkdf2;
+        request->derivedKey.resize(keyLength);
+        pbkdf2.deriveKey((byte*)request->derivedKey.data(), keyLength,
+                         (const byte*)password.data(), password.size(),
+                         (const byte*)salt.data(), salt.size(), iterations);
+        wipePassword(request->password);
+        request->done = true;
+        return request;
+    }
+
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mQueue.push_back(request);
+    }
+    mConditionVariable.notify_one();
+    return request;
+}
+
+void KeyDerivationService::cancel(const RequestPtr& request)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    request->cancelled = true;
+    request->waiter = nullptr;
+
+    auto it = std::find(mQueue.begin(), mQueue.end(), request);
+    if (it != mQueue.end())
+    {
+        // not picked up by a worker, which would wipe it once done
+        mQueue.erase(it);
+        wipePassword(request->password);
+    }
+}
+
+size_t KeyDerivationService::queueDepth()
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    return mQueue.size();
+}
+
+void KeyDerivationService::threadLoop()
+{
+    PBKDF2_HMAC_SHA512 pbkdf2;
     for (;;)
     {
-        std::function<void(SymmCipher&)> f;
+        RequestPtr request;
         {
             std::unique_lock<std::mutex> g(mMutex);
-            mConditionVariable.wait(g, [this]() { return !mQueue.empty(); });
-            f = std::move(mQueue.front().f);
-            if (!f) return;   // nullptr is not popped, and causes all the threads to exit
+            mConditionVariable.wait(g, [this]() { return mShutdown || !mQueue.empty(); });
+            if (mShutdown) return;
+            request = std::move(mQueue.front());
             mQueue.pop_front();
         }
-        f(cipher);
-        mWaiter.notify();
+
+        string key(request->keyLength, '\0');
+        pbkdf2.deriveKey((byte*)key.data(), key.size(),
+                         (const byte*)request->password.data(), request->password.size(),
+                         (const byte*)request->salt.data(), request->salt.size(),
+                         request->iterations);
+        wipePassword(request->password);
+
+        std::lock_guard<std::mutex> g(mMutex);
+        if (!request->cancelled)
+        {
+            request->derivedKey = std::move(key);
+            request->done = true;
+            if (request->waiter)
+            {
+                request->waiter->notifyBy(Waiter::NOTIFY_OTHER);
+            }
+        }
+    }
+}
+
+ExecLoopProfiler::Scope::Scope(ExecLoopProfiler& profiler, Section section)
+    : mProfiler(profiler)
+    , mPrevious(profiler.mCurrent)
+{
+    mProfiler.switchTo(section);
+}
+
+void ExecLoopProfiler::Scope::stop()
+{
+    if (!mStopped)
+    {
+        mProfiler.switchTo(mPrevious);
+        mStopped = true;
+    }
+}
+
+ExecLoopProfiler::ExecLoopProfiler()
+    : mSectionStart(std::chrono::steady_clock::now())
+    , mHistogram(Metrics::histogram("MegaClient_loop", "Time of each iteration of the client loop, not counting waits"))
+{
+    for (int i = 0; i < NUM_SECTIONS; ++i)
+    {
+        string name = sectionName(Section(i));
+        std::replace(name.begin(), name.end(), ' ', '_');
+        mSlowCounters[i] = Metrics::counter("MegaClient_slowLoop_" + name,
+                                            string("Microseconds spent in ") + sectionName(Section(i)) + " during slow client loop iterations");
+    }
+}
+
+const char* ExecLoopProfiler::sectionName(Section section)
+{
+    switch (section)
+    {
+        case OTHER: return "other";
+        case TRANSFERS: return "transfers";
+        case SC: return "sc";
+        case CS: return "cs";
+        case SYNC: return "sync";
+        case GFX: return "gfx";
+        case DB_COMMIT: return "db commit";
+        case HTTPIO: return "httpio";
+        case WAIT: return "wait";
+        case NUM_SECTIONS: break;
+    }
+    return "";
+}
+
+void ExecLoopProfiler::switchTo(Section section)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (mInIteration)
+    {
+        mIteration.sections[mCurrent] += now - mSectionStart;
+    }
+    mSectionStart = now;
+    mCurrent = section;
+}
+
+bool ExecLoopProfiler::overBudget(Section section) const
+{
+    if (!mInIteration || mBudgets[section].count() <= 0)
+    {
+        return false;
+    }
+
+    auto spent = mIteration.sections[section];
+    if (mCurrent == section)
+    {
+        spent += std::chrono::steady_clock::now() - mSectionStart;
+    }
+    return spent >= mBudgets[section];
+}
+
+void ExecLoopProfiler::beginIteration()
+{
+    if (mInIteration)
+    {
+        return;
+    }
+    mIteration = Iteration();
+    mSectionStart = std::chrono::steady_clock::now();
+    mInIteration = true;
+}
+
+void ExecLoopProfiler::endIteration()
+{
+    if (!mInIteration)
+    {
+        return;
+    }
+    switchTo(mCurrent);
+    mInIteration = false;
+
+    for (int i = 0; i < NUM_SECTIONS; ++i)
+    {
+        if (i != WAIT)
+        {
+            mIteration.total += mIteration.sections[i];
+        }
+    }
+
+    ++mIterations;
+    mHistogram.record(mIteration.total);
+
+    if (mSlowThreshold.count() <= 0 || mIteration.total < mSlowThreshold)
+    {
+        return;
+    }
+
+    ++mSlowIterations;
+    for (int i = 0; i < NUM_SECTIONS; ++i)
+    {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(mIteration.sections[i]).count();
+        if (i != WAIT && us > 0)
+        {
+            mSlowCounters[i].add(uint64_t(us));
+        }
+    }
+
+    LOG_warn << "Slow client loop iteration: " << mIteration.describe();
+
+    mRecentSlow.push_back(mIteration);
+    if (mRecentSlow.size() > 16)
+    {
+        mRecentSlow.pop_front();
+    }
+}
+
+string ExecLoopProfiler::Iteration::describe(unsigned topContributors) const
+{
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+
+    std::vector<int> order;
+    for (int i = 0; i < NUM_SECTIONS; ++i)
+    {
+        if (i != WAIT && duration_cast<milliseconds>(sections[i]).count() > 0)
+        {
+            order.push_back(i);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) { return sections[a] > sections[b]; });
+
+    std::ostringstream s;
+    s << duration_cast<milliseconds>(total).count() << " ms";
+    for (size_t i = 0; i < order.size() && i < topContributors; ++i)
+    {
+        s << (i ? ", " : ": ") << sectionName(Section(order[i])) << " "
+          << duration_cast<milliseconds>(sections[order[i]]).count() << " ms";
     }
+    return s.str();
 }
 
 bool islchex_high(const int c)
@@ -2653,6 +4278,73 @@ bool wildcardMatch(const char *pszString, const char *pszMatch)
     return !*pszMatch;
 }
 
+void WildcardPatterns::add(const string& pattern)
+{
+    auto wildcard = pattern.find_first_of("*?");
+    if (wildcard == string::npos)
+    {
+        mLiterals.insert(pattern);
+        return;
+    }
+
+    PrefixNode* node = &mPrefixes;
+    for (size_t i = 0; i < wildcard; ++i)
+    {
+        auto& child = node->children[pattern[i]];
+        if (!child)
+        {
+            child.reset(new PrefixNode);
+        }
+        node = child.get();
+    }
+    node->patterns.push_back(pattern);
+}
+
+void WildcardPatterns::clear()
+{
+    mLiterals.clear();
+    mPrefixes.children.clear();
+    mPrefixes.patterns.clear();
+}
+
+bool WildcardPatterns::empty() const
+{
+    return mLiterals.empty() && mPrefixes.children.empty() && mPrefixes.patterns.empty();
+}
+
+bool WildcardPatterns::matches(const string& text) const
+{
+    if (mLiterals.count(text))
+    {
+        return true;
+    }
+
+    const PrefixNode* node = &mPrefixes;
+    for (size_t i = 0; ; ++i)
+    {
+        // the first i characters of these patterns match already
+        for (const auto& pattern : node->patterns)
+        {
+            if (wildcardMatch(text.c_str() + i, pattern.c_str() + i))
+            {
+                return true;
+            }
+        }
+
+        if (i == text.size())
+        {
+            return false;
+        }
+
+        auto it = node->children.find(text[i]);
+        if (it == node->children.end())
+        {
+            return false;
+        }
+        node = it->second.get();
+    }
+}
+
 UploadHandle UploadHandle::next()
 {
     do
@@ -32,4 +32,36 @@ void Waiter::wakeupby(EventTrigger* et, int flags)
 {
     et->addevents(this, flags);
 }
+
+void Waiter::notifyBy(NotifySource source)
+{
+    mNotifyCount[source]++;
+    notify();
+}
+
+Waiter::NotifyStats Waiter::notifyStats(bool reset)
+{
+    NotifyStats result;
+    for (int i = 0; i < NOTIFY_SOURCES; i++)
+    {
+        result.bySource[i] = reset ? mNotifyCount[i].exchange(0) : mNotifyCount[i].load();
+    }
+    result.signalled = reset ? mSignalled.exchange(0) : mSignalled.load();
+    return result;
+}
+
+const char* Waiter::notifySourceName(NotifySource source)
+{
+    switch (source)
+    {
+        case NOTIFY_ASYNCQUEUE: return "asyncqueue";
+        case NOTIFY_GFX: return "gfx";
+        case NOTIFY_SCAN: return "scan";
+        case NOTIFY_DIRNOTIFY: return "dirnotify";
+        case NOTIFY_FILEIO: return "fileio";
+        case NOTIFY_OTHER: return "other";
+        case NOTIFY_SOURCES: break;
+    }
+    return "unknown";
+}
 } // namespace
@@ -229,6 +229,30 @@ bool WinFileAccess::ftruncate()
     return false;
 }
 
+bool WinFileAccess::fpreallocate(m_off_t newsize)
+{
+    retry = false;
+
+    // unlike SetFileValidData(), this needs no privilege and exposes no stale data
+    FILE_ALLOCATION_INFO info;
+    info.AllocationSize.QuadPart = newsize;
+    if (SetFileInformationByHandle(hFile, FileAllocationInfo, &info, sizeof info))
+    {
+        return true;
+    }
+
+    DWORD e = GetLastError();
+    if (e == ERROR_DISK_FULL)
+    {
+        errorcode = int(e);
+        LOG_warn << "Not enough space to preallocate " << newsize << " bytes";
+        return false;
+    }
+
+    LOG_debug << "Unable to preallocate " << newsize << " bytes: " << e;
+    return true;
+}
+
 m_time_t FileTime_to_POSIX(FILETIME* ft)
 {
     LARGE_INTEGER date;
@@ -642,6 +666,14 @@ bool WinFileAccess::fopen_impl(const LocalPath& namePath, bool read, bool write,
         fsid = ((handle)bhfi.nFileIndexHigh << 32) | (handle)bhfi.nFileIndexLow;
     }
 
+    // NTFS and ReFS track a change time that also moves on metadata updates (FAT reports 0)
+    FILE_BASIC_INFO fbi;
+    ctime = 0;
+    if (!write && GetFileInformationByHandleEx(hFile, FileBasicInfo, &fbi, sizeof(fbi)) && fbi.ChangeTime.QuadPart)
+    {
+        ctime = FileTime_to_POSIX((FILETIME*)&fbi.ChangeTime);
+    }
+
     if (type == FOLDERNODE)
     {
         LocalPath withStar = namePath;
@@ -1235,6 +1267,148 @@ bool WinFileSystemAccess::fsStableIDs(const LocalPath& path) const
     return true;
 }
 
+// The USN journal is read through the volume, which takes an administrator, or else
+// through any folder on it with the unprivileged FSCTL (Windows 10 1709 onwards).
+static ScopedFileHandle openChangeJournal(const LocalPath& path, bool& privileged)
+{
+    wchar_t mountPoint[MAX_PATH + 1];
+    wchar_t volumeName[MAX_PATH + 1];
+
+    if (GetVolumePathNameW(path.localpath.c_str(), mountPoint, MAX_PATH + 1)
+        && GetVolumeNameForVolumeMountPointW(mountPoint, volumeName, MAX_PATH + 1))
+    {
+        // without the trailing separator, \\?\Volume{...} names the volume rather than its root folder
+        wstring volume(volumeName);
+        if (!volume.empty() && volume.back() == L'\\')
+        {
+            volume.pop_back();
+        }
+
+        ScopedFileHandle h = CreateFileW(volume.c_str(), GENERIC_READ,
+                                         FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                         NULL, OPEN_EXISTING, 0, NULL);
+        if (h.get() != INVALID_HANDLE_VALUE)
+        {
+            privileged = true;
+            return h;
+        }
+    }
+
+    privileged = false;
+
+#ifdef FSCTL_READ_UNPRIVILEGED_USN_JOURNAL
+    return CreateFileW(path.localpath.c_str(), GENERIC_READ,
+                       FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                       NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+#else
+    return ScopedFileHandle();
+#endif
+}
+
+static bool queryChangeJournal(HANDLE h, USN_JOURNAL_DATA_V0& journal)
+{
+    DWORD bytes = 0;
+
+    return h != INVALID_HANDLE_VALUE
+           && DeviceIoControl(h, FSCTL_QUERY_USN_JOURNAL, NULL, 0,
+                              &journal, sizeof(journal), &bytes, NULL);
+}
+
+bool WinFileSystemAccess::changeJournalPosition(const LocalPath& path, handle& journalId, m_off_t& position) const
+{
+    bool privileged;
+    ScopedFileHandle h = openChangeJournal(path, privileged);
+    USN_JOURNAL_DATA_V0 journal;
+
+    if (!queryChangeJournal(h.get(), journal))
+    {
+        return false;
+    }
+
+    journalId = (handle)journal.UsnJournalID;
+    position = (m_off_t)journal.NextUsn;
+    return true;
+}
+
+bool WinFileSystemAccess::readChangeJournal(const LocalPath& path, handle journalId, m_off_t position,
+                                            std::function<void(handle, handle, const LocalPath&)> f) const
+{
+    bool privileged;
+    ScopedFileHandle h = openChangeJournal(path, privileged);
+    USN_JOURNAL_DATA_V0 journal;
+
+    if (!queryChangeJournal(h.get(), journal))
+    {
+        return false;
+    }
+
+    if ((handle)journal.UsnJournalID != journalId
+        || position < (m_off_t)journal.FirstUsn
+        || position > (m_off_t)journal.NextUsn)
+    {
+        LOG_debug << "Change journal can't be replayed from " << position
+                  << " (journal " << toHandle((handle)journal.UsnJournalID)
+                  << " first " << journal.FirstUsn << " next " << journal.NextUsn << ")";
+        return false;
+    }
+
+    READ_USN_JOURNAL_DATA_V0 request = {};
+    request.StartUsn = position;
+    request.ReasonMask = 0xFFFFFFFF;
+    request.UsnJournalID = journal.UsnJournalID;
+
+#ifdef FSCTL_READ_UNPRIVILEGED_USN_JOURNAL
+    DWORD readCode = privileged ? FSCTL_READ_USN_JOURNAL : FSCTL_READ_UNPRIVILEGED_USN_JOURNAL;
+#else
+    DWORD readCode = FSCTL_READ_USN_JOURNAL;
+#endif
+
+    alignas(8) byte buffer[64 * 1024];
+
+    // only replay up to where the journal was when we started: later changes come as notifications
+    while (request.StartUsn < journal.NextUsn)
+    {
+        DWORD bytes = 0;
+
+        if (!DeviceIoControl(h.get(), readCode, &request, sizeof(request),
+                             buffer, sizeof(buffer), &bytes, NULL))
+        {
+            LOG_warn << "Unable to read the change journal. Error code: " << GetLastError();
+            return false;
+        }
+
+        // the buffer starts with the USN to continue from
+        if (bytes <= sizeof(USN))
+        {
+            break;
+        }
+
+        for (DWORD offset = sizeof(USN); offset < bytes; )
+        {
+            auto record = reinterpret_cast<USN_RECORD_V2*>(buffer + offset);
+
+            // ReFS reports 128 bit file ids (version 3 records), which don't match our fsids
+            if (record->MajorVersion != 2)
+            {
+                LOG_debug << "Unsupported change journal record version: " << record->MajorVersion;
+                return false;
+            }
+
+            auto name = reinterpret_cast<const wchar_t*>(reinterpret_cast<byte*>(record) + record->FileNameOffset);
+
+            f((handle)record->FileReferenceNumber,
+              (handle)record->ParentFileReferenceNumber,
+              LocalPath::fromPlatformEncodedRelative(wstring(name, record->FileNameLength / sizeof(wchar_t))));
+
+            offset += record->RecordLength;
+        }
+
+        request.StartUsn = *reinterpret_cast<USN*>(buffer);
+    }
+
+    return true;
+}
+
 VOID CALLBACK WinDirNotify::completion(DWORD dwErrorCode, DWORD dwBytes, LPOVERLAPPED lpOverlapped)
 {
     assert( std::this_thread::get_id() == smNotifierThread->get_id());
@@ -1309,7 +1483,7 @@ void WinDirNotify::process(DWORD dwBytes)
             ptr += fni->NextEntryOffset;
         }
     }
-    clientWaiter->notify();
+    clientWaiter->notifyBy(Waiter::NOTIFY_DIRNOTIFY);
 }
 
 // request change notifications on the subtree under hDirectory
@@ -1628,10 +1802,12 @@ bool reuseFingerprint(const FSNode& lhs, const FSNode& rhs)
     // nothing we can see from outside the file had changed,
     // mtime is the same, and no notifications arrived
     // for this particular file.
+    // A known change time must match too: it catches rewrites that restore the mtime.
     return lhs.type == rhs.type
         && lhs.fsid == rhs.fsid
         && lhs.fingerprint.mtime == rhs.fingerprint.mtime
-        && lhs.fingerprint.size == rhs.fingerprint.size;
+        && lhs.fingerprint.size == rhs.fingerprint.size
+        && (!lhs.ctime || !rhs.ctime || lhs.ctime == rhs.ctime);
 };
 
 bool  WinFileSystemAccess::checkForSymlink(const LocalPath& lp)
@@ -1806,6 +1982,7 @@ ScanResult WinFileSystemAccess::directoryScan(const LocalPath& path, handle expe
 
                 result.fingerprint.mtime = FileTime_to_POSIX((FILETIME*)&info->LastWriteTime);
                 result.fingerprint.size = (m_off_t)info->EndOfFile.QuadPart;
+                result.ctime = info->ChangeTime.QuadPart ? FileTime_to_POSIX((FILETIME*)&info->ChangeTime) : 0;
 
                 if (info->ShortNameLength > 0)
                 {
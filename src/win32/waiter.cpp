@@ -128,6 +128,7 @@ bool WinWaiter::addhandle(HANDLE handle, int flag)
 
 void WinWaiter::notify()
 {
+    mSignalled++;
     SetEvent(externalEvent);
 }
 } // namespace
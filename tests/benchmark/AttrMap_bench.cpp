@@ -0,0 +1,81 @@
+/**
+ * (c) 2026 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <mega.h>
+
+namespace {
+
+using namespace mega;
+
+// the attributes of a typical file node, plus range(0) app specific ones
+AttrMap makeAttrMap(int extra)
+{
+    AttrMap attrs;
+    attrs.map['n'] = "IMG_20200101_120000.jpg";
+    attrs.map['c'] = "Aa0Bb1Cc2Dd3Ee4Ff5Gg6HhAw8gyV8";
+    attrs.map[AttrMap::string2nameid("lbl")] = "3";
+    attrs.map[AttrMap::string2nameid("fav")] = "1";
+    for (int i = 0; i < extra; ++i)
+    {
+        attrs.map[AttrMap::string2nameid(("x" + std::to_string(i)).c_str())] = string(40, char('a' + i % 26));
+    }
+    return attrs;
+}
+
+void BM_AttrMap_serialize(benchmark::State& state)
+{
+    AttrMap attrs = makeAttrMap(int(state.range(0)));
+
+    for (auto _ : state)
+    {
+        string d;
+        attrs.serialize(&d);
+        benchmark::DoNotOptimize(d.data());
+    }
+}
+BENCHMARK(BM_AttrMap_serialize)->Arg(0)->Arg(20);
+
+void BM_AttrMap_unserialize(benchmark::State& state)
+{
+    string d;
+    makeAttrMap(int(state.range(0))).serialize(&d);
+
+    for (auto _ : state)
+    {
+        AttrMap attrs;
+        benchmark::DoNotOptimize(attrs.unserialize(d.data(), d.data() + d.size()));
+    }
+}
+BENCHMARK(BM_AttrMap_unserialize)->Arg(0)->Arg(20);
+
+void BM_AttrMap_getjson(benchmark::State& state)
+{
+    AttrMap attrs = makeAttrMap(int(state.range(0)));
+
+    for (auto _ : state)
+    {
+        string json;
+        attrs.getjson(&json);
+        benchmark::DoNotOptimize(json.data());
+    }
+}
+BENCHMARK(BM_AttrMap_getjson)->Arg(0)->Arg(20);
+
+} // anonymous
@@ -0,0 +1,131 @@
+/**
+ * (c) 2026 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <mega.h>
+
+namespace {
+
+using namespace mega;
+
+const byte transferKey[SymmCipher::KEYLENGTH] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+
+// one transfer buffer's worth of data, encrypted in place with a running mac
+void BM_SymmCipher_ctr_crypt(benchmark::State& state)
+{
+    SymmCipher cipher(transferKey);
+    std::vector<byte> data(size_t(state.range(0)), 0x5a);
+    byte mac[SymmCipher::BLOCKSIZE];
+
+    for (auto _ : state)
+    {
+        cipher.ctr_crypt(data.data(), unsigned(data.size()), 0, 0x0102030405060708, mac, true);
+        benchmark::DoNotOptimize(mac);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_SymmCipher_ctr_crypt)->Arg(128 * 1024)->Arg(1024 * 1024)->Arg(16 * 1024 * 1024);
+
+// encrypt a file of range(0) bytes chunk by chunk, as an upload does
+void BM_chunkmac_map_ctr_encrypt(benchmark::State& state)
+{
+    SymmCipher cipher(transferKey);
+    m_off_t size = m_off_t(state.range(0));
+    std::vector<byte> data(size_t(size), 0x5a);
+
+    for (auto _ : state)
+    {
+        chunkmac_map macs;
+        for (m_off_t pos = 0; pos < size; )
+        {
+            m_off_t next = std::min(ChunkedHash::chunkceil(pos, size), size);
+            macs.ctr_encrypt(pos, &cipher, data.data() + pos, unsigned(next - pos), pos, 0x0102030405060708, true);
+            pos = next;
+        }
+        benchmark::DoNotOptimize(macs.macsmac(&cipher));
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_chunkmac_map_ctr_encrypt)->Arg(1024 * 1024)->Arg(64 * 1024 * 1024);
+
+// fill a map with range(0) finished chunks, for the bookkeeping benchmarks below
+void fillChunkMacs(chunkmac_map& macs, SymmCipher& cipher, size_t count)
+{
+    byte block[SymmCipher::BLOCKSIZE] = {};
+    for (size_t i = 0; i < count; ++i)
+    {
+        m_off_t pos = ChunkedHash::chunkpos(i);
+        macs.ctr_encrypt(pos, &cipher, block, sizeof block, pos, 0, true);
+    }
+}
+
+void BM_chunkmac_map_macsmac(benchmark::State& state)
+{
+    SymmCipher cipher(transferKey);
+    chunkmac_map macs;
+    fillChunkMacs(macs, cipher, size_t(state.range(0)));
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(macs.macsmac(&cipher));
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_chunkmac_map_macsmac)->Arg(1000)->Arg(100000);
+
+void BM_chunkmac_map_serialize(benchmark::State& state)
+{
+    SymmCipher cipher(transferKey);
+    chunkmac_map macs;
+    fillChunkMacs(macs, cipher, size_t(state.range(0)));
+
+    for (auto _ : state)
+    {
+        string d;
+        macs.serialize(d);
+
+        chunkmac_map restored;
+        const char* ptr = d.data();
+        benchmark::DoNotOptimize(restored.unserialize(ptr, d.data() + d.size()));
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_chunkmac_map_serialize)->Arg(1000)->Arg(100000);
+
+void BM_chunkmac_map_calcprogress(benchmark::State& state)
+{
+    SymmCipher cipher(transferKey);
+    chunkmac_map macs;
+    size_t count = size_t(state.range(0));
+    fillChunkMacs(macs, cipher, count);
+    m_off_t size = ChunkedHash::chunkpos(count);
+
+    for (auto _ : state)
+    {
+        m_off_t chunkpos = 0, progress = 0;
+        macs.calcprogress(size, chunkpos, progress);
+        benchmark::DoNotOptimize(progress);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_chunkmac_map_calcprogress)->Arg(1000)->Arg(100000);
+
+} // anonymous
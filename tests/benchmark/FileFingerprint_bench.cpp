@@ -0,0 +1,76 @@
+/**
+ * (c) 2026 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <cstring>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <mega.h>
+
+namespace {
+
+using namespace mega;
+
+class MemoryInputStream : public InputStreamAccess
+{
+public:
+    explicit MemoryInputStream(const std::vector<byte>& content)
+        : mContent(content)
+    {
+    }
+
+    m_off_t size() override
+    {
+        return m_off_t(mContent.size());
+    }
+
+    bool read(byte* buffer, unsigned size) override
+    {
+        if (buffer)
+        {
+            memcpy(buffer, mContent.data() + mPos, size);
+        }
+        mPos += size;
+        return true;
+    }
+
+private:
+    const std::vector<byte>& mContent;
+    size_t mPos = 0;
+};
+
+// small files are read in full, large ones are sampled
+void BM_FileFingerprint_genfingerprint(benchmark::State& state)
+{
+    std::vector<byte> content(size_t(state.range(0)));
+    for (size_t i = 0; i < content.size(); ++i)
+    {
+        content[i] = byte(i * 7);
+    }
+
+    for (auto _ : state)
+    {
+        MemoryInputStream is(content);
+        FileFingerprint fp;
+        benchmark::DoNotOptimize(fp.genfingerprint(&is, 1600000000));
+    }
+}
+BENCHMARK(BM_FileFingerprint_genfingerprint)->Arg(4 * 1024)->Arg(1024 * 1024)->Arg(64 * 1024 * 1024);
+
+} // anonymous
@@ -0,0 +1,216 @@
+/**
+ * (c) 2026 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <mega.h>
+
+namespace {
+
+using namespace mega;
+
+// the shape of a fetchnodes response: range(0) nodes, then the share keys
+string makeFetchnodes(int nodes)
+{
+    string doc = "[{\"f\":[";
+    for (int i = 0; i < nodes; i++)
+    {
+        doc.append(i ? "," : "").append("{\"h\":\"Aa0Bb1Cc\",\"p\":\"Dd2Ee3Ff\",\"u\":\"Gg4Hh5Ii6Jj\",\"t\":0,"
+                   "\"a\":\"").append(64, 'Q').append("\",\"k\":\"Gg4Hh5Ii6Jj:").append(22, 'K')
+           .append("\",\"s\":1048576,\"fa\":\"123:0*").append(11, 'F').append("\",\"ts\":1600000000}");
+    }
+    doc.append("],\"ok\":[{\"h\":\"Aa0Bb1Cc\",\"ha\":\"").append(22, 'H').append("\",\"k\":\"").append(22, 'K').append("\"}]}]");
+    return doc;
+}
+
+// the shape of an sc response: a batch of range(0) mixed action packets
+string makeScBatch(int packets)
+{
+    static const char* packetsByType[] = {
+        "{\"a\":\"u\",\"n\":\"Aa0Bb1Cc\",\"u\":\"Gg4Hh5Ii6Jj\",\"at\":\"QQQQQQQQQQQQQQQQQQQQQQ\",\"ts\":1600000000}",
+        "{\"a\":\"t\",\"t\":{\"f\":[{\"h\":\"Aa0Bb1Cc\",\"p\":\"Dd2Ee3Ff\",\"u\":\"Gg4Hh5Ii6Jj\",\"t\":0,\"a\":\"QQQQ\",\"k\":\"Gg4Hh5Ii6Jj:KKKK\",\"s\":1,\"ts\":1600000000}]},\"ou\":\"Gg4Hh5Ii6Jj\"}",
+        "{\"a\":\"d\",\"n\":\"Aa0Bb1Cc\",\"ou\":\"Gg4Hh5Ii6Jj\"}",
+        "{\"a\":\"ua\",\"st\":\"!abc\",\"u\":\"Gg4Hh5Ii6Jj\",\"ua\":[\"^!prd\"],\"v\":[\"Zz9Yy8\"]}",
+        "{\"a\":\"fa\",\"n\":\"Aa0Bb1Cc\",\"fa\":\"123:0*FFFFFFFFFFF/456:1*FFFFFFFFFFF\"}",
+    };
+
+    string doc = "{\"w\":\"https://g.api.mega.co.nz/wsc/abc\",\"sn\":\"Ss7Tt8Uu9Vv\",\"a\":[";
+    for (int i = 0; i < packets; i++)
+    {
+        doc.append(i ? "," : "").append(packetsByType[i % 5]);
+    }
+    doc.append("]}");
+    return doc;
+}
+
+// visit every field of every node, the way readnodes() does
+void BM_JSON_fetchnodes(benchmark::State& state)
+{
+    string doc = makeFetchnodes(int(state.range(0)));
+
+    for (auto _ : state)
+    {
+        JSON j(doc);
+        j.enterarray();
+        j.enterobject();
+        j.getnameid();
+        j.enterarray();
+        m_off_t total = 0;
+        while (j.enterobject())
+        {
+            for (nameid name; (name = j.getnameid()) != EOO; )
+            {
+                switch (name)
+                {
+                    case 't':
+                    case 's':
+                    case MAKENAMEID2('t', 's'):
+                        total += j.getint();
+                        break;
+                    default:
+                        j.storeobject();
+                }
+            }
+            j.leaveobject();
+        }
+        benchmark::DoNotOptimize(total);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(doc.size()));
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_JSON_fetchnodes)->Arg(1000)->Arg(100000);
+
+// skip every node whole, as a client does with the sections it doesn't need
+void BM_JSON_fetchnodesSkip(benchmark::State& state)
+{
+    string doc = makeFetchnodes(int(state.range(0)));
+
+    for (auto _ : state)
+    {
+        JSON j(doc);
+        j.enterarray();
+        j.enterobject();
+        j.getnameid();
+        j.enterarray();
+        size_t skipped = 0;
+        while (j.storeobject())
+        {
+            skipped++;
+        }
+        benchmark::DoNotOptimize(skipped);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(doc.size()));
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_JSON_fetchnodesSkip)->Arg(1000)->Arg(100000);
+
+// dispatch each action packet on its type and skip its body, as procsc() does
+void BM_JSON_sc(benchmark::State& state)
+{
+    string doc = makeScBatch(int(state.range(0)));
+
+    for (auto _ : state)
+    {
+        JSON j(doc);
+        j.enterobject();
+        size_t handled = 0;
+        for (nameid name; (name = j.getnameid()) != EOO; )
+        {
+            if (name != 'a')
+            {
+                j.storeobject();
+                continue;
+            }
+
+            j.enterarray();
+            while (j.enterobject())
+            {
+                for (nameid field; (field = j.getnameid()) != EOO; )
+                {
+                    if (field == 'a')
+                    {
+                        handled += j.getnameid() != EOO;
+                    }
+                    else
+                    {
+                        j.storeobject();
+                    }
+                }
+                j.leaveobject();
+            }
+            j.leavearray();
+        }
+        benchmark::DoNotOptimize(handled);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(doc.size()));
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_JSON_sc)->Arg(100)->Arg(10000);
+
+int dispatchScType(nameid name)
+{
+    switch (name)
+    {
+        case 'u': return 1;
+        case 't': return 2;
+        case 'd': return 3;
+        case 's': return 4;
+        case MAKENAMEID2('s', '2'): return 5;
+        case 'c': return 6;
+        case 'k': return 7;
+        case MAKENAMEID2('f', 'a'): return 8;
+        case MAKENAMEID2('u', 'a'): return 9;
+        case MAKENAMEID4('p', 's', 't', 's'): return 10;
+        case MAKENAMEID4('p', 's', 'e', 's'): return 11;
+        case MAKENAMEID2('p', 'h'): return 12;
+        case MAKENAMEID2('s', 'e'): return 13;
+        case MAKENAMEID5('m', 'c', 's', 'm', 'p'): return 14;
+        case MAKENAMEID3('a', 's', 'p'): return 15;
+        case MAKENAMEID3('a', 'e', 'p'): return 16;
+        case MAKENAMEID3('u', 'a', 'c'): return 17;
+        default: return 0;
+    }
+}
+
+// the share of BM_JSON_sc that is the switch on the packet type, with types in no predictable order
+void BM_JSON_scDispatch(benchmark::State& state)
+{
+    static const char* types[] = { "u", "t", "d", "s", "s2", "c", "k", "fa", "ua", "psts", "pses", "ph", "se", "mcsmp", "asp", "aep", "uac" };
+    const size_t numTypes = sizeof types / sizeof *types;
+
+    JSON j;
+    vector<nameid> names;
+    for (size_t i = 0; i < numTypes; i++)
+    {
+        names.push_back(j.getnameid(types[i]));
+    }
+
+    for (auto _ : state)
+    {
+        int sum = 0;
+        for (int64_t i = 0; i < state.range(0); i++)
+        {
+            sum += dispatchScType(names[size_t(i * 7919) % numTypes]);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_JSON_scDispatch)->Arg(100)->Arg(10000);
+
+} // anonymous
@@ -0,0 +1,135 @@
+/**
+ * (c) 2026 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <cstring>
+#include <random>
+
+#include <benchmark/benchmark.h>
+
+#include <mega.h>
+
+namespace {
+
+using namespace mega;
+
+class BenchRaidBufferManager : public RaidBufferManager
+{
+    void finalize(FilePiece&) override {}
+
+    m_off_t calcOutputChunkPos(m_off_t acquiredpos) override
+    {
+        return ChunkedHash::chunkfloor(acquiredpos);
+    }
+};
+
+// reassemble a file from its raid parts, with range(0) the part not downloaded
+void BM_Raid_combineRaidParts(benchmark::State& state)
+{
+    const size_t pieceLen = 40000 * RAIDSECTOR;
+    const unsigned missing = unsigned(state.range(0));
+
+    std::mt19937 rng(42);
+    string file(16 * 1024 * 1024, '\0');
+    for (auto& c : file)
+    {
+        c = static_cast<char>(rng());
+    }
+    m_off_t filesize = m_off_t(file.size());
+
+    string parts[RAIDPARTS];
+    for (unsigned j = 0; j < RAIDPARTS; ++j)
+    {
+        parts[j].assign(size_t(RaidBufferManager::raidPartSize(j, filesize)), '\0');
+    }
+    for (size_t filepos = 0; filepos < file.size(); ++filepos)
+    {
+        size_t line = filepos / RAIDLINE;
+        size_t j = 1 + filepos % RAIDLINE / RAIDSECTOR;
+        size_t b = filepos % RAIDSECTOR;
+        parts[j][line * RAIDSECTOR + b] = file[filepos];
+        parts[0][line * RAIDSECTOR + b] = char(parts[0][line * RAIDSECTOR + b] ^ file[filepos]);
+    }
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        BenchRaidBufferManager rbm;
+        rbm.setIsRaid(std::vector<string>(RAIDPARTS, "http://localhost/"), 0, filesize, filesize, 1024 * 1024);
+        for (unsigned j = 0; j < RAIDPARTS; ++j)
+        {
+            for (size_t pos = 0; pos < parts[j].size(); pos += pieceLen)
+            {
+                size_t len = std::min(pieceLen, parts[j].size() - pos);
+                byte* data = nullptr;
+                if (j != missing)
+                {
+                    data = TransferBufferPool::allocate(len);
+                    memcpy(data, parts[j].data() + pos, len);
+                }
+                rbm.submitBuffer(j, new RaidBufferManager::FilePiece(m_off_t(pos), new HttpReq::http_buf_t(data, 0, len)));
+            }
+        }
+        state.ResumeTiming();
+
+        m_off_t out = 0;
+        for (size_t i = 0; i < 10 * file.size() / pieceLen && out < filesize; ++i)
+        {
+            if (auto piece = rbm.getAsyncOutputBufferPointer(0))
+            {
+                out += m_off_t(piece->buf.datalen());
+                rbm.bufferWriteCompleted(0, true);
+            }
+        }
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(file.size()));
+}
+BENCHMARK(BM_Raid_combineRaidParts)->Arg(0)->Arg(3);
+
+// rebuild 16MB worth of raid lines from the other parts, as when running 5 of 6 connections,
+// with range(0) the part not downloaded
+void BM_Raid_recoverSectorsFromParity(benchmark::State& state)
+{
+    const size_t sectors = 16 * 1024 * 1024 / RAIDLINE;
+    const unsigned missing = unsigned(state.range(0));
+
+    std::mt19937 rng(1234);
+    std::vector<std::vector<byte>> parts(RAIDPARTS);
+    byte* inputbufs[RAIDPARTS];
+    for (unsigned i = 0; i < RAIDPARTS; ++i)
+    {
+        parts[i].resize(sectors * RAIDSECTOR);
+        for (auto& b : parts[i])
+        {
+            b = static_cast<byte>(rng());
+        }
+        inputbufs[i] = i == missing ? nullptr : parts[i].data();
+    }
+    std::vector<byte> out(sectors * RAIDLINE);
+
+    for (auto _ : state)
+    {
+        RaidBufferManager::recoverSectorsFromParity(out.data(), RAIDLINE, inputbufs, 0, sectors);
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(sectors * RAIDSECTOR));
+}
+BENCHMARK(BM_Raid_recoverSectorsFromParity)->Arg(0)->Arg(3);
+
+} // anonymous
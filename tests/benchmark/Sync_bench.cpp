@@ -0,0 +1,465 @@
+/**
+ * (c) 2026 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// The stages of bringing up a large sync, on a synthetic tree of range(0) files in a complete
+// tree of folders range(1) levels deep with range(2) subfolders each. Trees are made on a real
+// filesystem, under $MEGA_BENCH_DIR (a tmpfs is best, /dev/shm by default), and kept there so
+// that the big shapes are only paid for once.
+
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include <benchmark/benchmark.h>
+
+#include <mega.h>
+
+#if defined(ENABLE_SYNC) && defined(USE_SQLITE)
+
+namespace {
+
+using namespace mega;
+
+struct BenchTree
+{
+    LocalPath root;
+    size_t files = 0;
+    size_t folders = 0;
+};
+
+LocalPath benchRoot(FileSystemAccess& fsAccess)
+{
+    const char* dir = getenv("MEGA_BENCH_DIR");
+    LocalPath root = LocalPath::fromAbsolutePath(dir ? dir : "/dev/shm");
+    if (!dir && fsAccess.fsidOf(root, false, false) == UNDEF)
+    {
+        fsAccess.cwd(root);
+    }
+    return root;
+}
+
+// peak resident set of the process so far, reported with each result
+void reportPeakRss(benchmark::State& state)
+{
+#ifndef _WIN32
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    state.counters["peakRssBytes"] = double(usage.ru_maxrss);
+#else
+    state.counters["peakRssBytes"] = double(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+// the tree for the benchmark's arguments, made the first time it is asked for
+const BenchTree& benchTree(FileSystemAccess& fsAccess, const benchmark::State& state)
+{
+    static std::map<std::vector<int64_t>, BenchTree> trees;
+
+    size_t files = size_t(state.range(0));
+    size_t depth = size_t(state.range(1));
+    size_t fanout = size_t(state.range(2));
+
+    auto& tree = trees[{state.range(0), state.range(1), state.range(2)}];
+    if (!tree.root.empty())
+    {
+        return tree;
+    }
+
+    tree.root = benchRoot(fsAccess);
+    tree.root.appendWithSeparator(LocalPath::fromRelativePath(
+        "megabench-sync-" + std::to_string(files) + "-" + std::to_string(depth) + "-" + std::to_string(fanout)), true);
+
+    // breadth first, so that files are spread over every level
+    std::vector<LocalPath> folders(1, tree.root);
+    std::vector<size_t> levels(1, 0);
+    for (size_t i = 0; i < folders.size(); ++i)
+    {
+        for (size_t j = 0; levels[i] < depth && j < fanout; ++j)
+        {
+            LocalPath child = folders[i];
+            child.appendWithSeparator(LocalPath::fromRelativePath("d" + std::to_string(j)), true);
+            folders.push_back(child);
+            levels.push_back(levels[i] + 1);
+        }
+    }
+    tree.folders = folders.size();
+    tree.files = files;
+
+    // a previous run left it complete
+    LocalPath marker = tree.root;
+    marker.appendWithSeparator(LocalPath::fromRelativePath("complete"), true);
+    if (fsAccess.fileExistsAt(marker))
+    {
+        return tree;
+    }
+
+    for (auto& folder : folders)
+    {
+        fsAccess.mkdirlocal(folder, false, false);
+    }
+
+    string content(64, 'x');
+    auto fa = fsAccess.newfileaccess(false);
+    for (size_t i = 0; i < files; ++i)
+    {
+        LocalPath file = folders[i % folders.size()];
+        file.appendWithSeparator(LocalPath::fromRelativePath("f" + std::to_string(i)), true);
+        content.replace(0, 8, std::to_string(10000000 + i % 90000000));
+        if (fa->fopen(file, false, true))
+        {
+            fa->fwrite(reinterpret_cast<const byte*>(content.data()), unsigned(content.size()), 0);
+            fa->closef();
+        }
+    }
+
+    if (fa->fopen(marker, false, true))
+    {
+        fa->closef();
+    }
+    return tree;
+}
+
+// scan the whole tree as the sync does, one request per folder, many in flight on the scan threads.
+// with `known` the prior listing of each folder is passed in, so unchanged files are not fingerprinted again
+size_t scanTree(ScanService& scanService, Waiter& waiter, const LocalPath& root, handle rootFsid,
+                std::map<LocalPath, std::vector<FSNode>>* known, std::map<LocalPath, std::vector<FSNode>>* results)
+{
+    struct PendingScan
+    {
+        ScanService::RequestPtr request;
+        LocalPath path;
+    };
+    std::vector<PendingScan> pending;
+    size_t entries = 0;
+
+    auto queueScan = [&](const LocalPath& path, handle fsid)
+    {
+        map<LocalPath, FSNode> prior;
+        if (known)
+        {
+            for (auto& node : (*known)[path])
+            {
+                prior.emplace(node.localname, node.clone());
+            }
+        }
+        pending.push_back(PendingScan{scanService.queueScan(path, fsid, false, std::move(prior)), path});
+    };
+
+    queueScan(root, rootFsid);
+
+    while (!pending.empty())
+    {
+        auto done = std::partition(pending.begin(), pending.end(),
+                                   [](const PendingScan& p) { return !p.request->completed(); });
+
+        if (done == pending.end())
+        {
+            waiter.init(10);
+            waiter.wait();
+            continue;
+        }
+
+        std::vector<PendingScan> completed(std::make_move_iterator(done), std::make_move_iterator(pending.end()));
+        pending.erase(done, pending.end());
+
+        for (auto& scan : completed)
+        {
+            auto nodes = scan.request->resultNodes();
+            for (auto& node : nodes)
+            {
+                if (node.type == FOLDERNODE)
+                {
+                    LocalPath child = scan.path;
+                    child.appendWithSeparator(node.localname, true);
+                    queueScan(child, node.fsid);
+                }
+            }
+            entries += nodes.size();
+
+            if (results)
+            {
+                (*results)[scan.path] = std::move(nodes);
+            }
+        }
+    }
+
+    return entries;
+}
+
+// a whole tree seen for the first time: every file is fingerprinted
+void BM_Sync_initialScan(benchmark::State& state)
+{
+    FSACCESS_CLASS fsAccess;
+    const BenchTree& tree = benchTree(fsAccess, state);
+    WAIT_CLASS waiter;
+    ScanService scanService(waiter);
+    handle rootFsid = fsAccess.fsidOf(tree.root, false, false);
+
+    size_t entries = 0;
+    for (auto _ : state)
+    {
+        entries = scanTree(scanService, waiter, tree.root, rootFsid, nullptr, nullptr);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations() * entries));
+    reportPeakRss(state);
+}
+
+// the rescan of an unchanged tree, which reuses the fingerprints of the previous scan
+void BM_Sync_rescan(benchmark::State& state)
+{
+    FSACCESS_CLASS fsAccess;
+    const BenchTree& tree = benchTree(fsAccess, state);
+    WAIT_CLASS waiter;
+    ScanService scanService(waiter);
+    handle rootFsid = fsAccess.fsidOf(tree.root, false, false);
+
+    std::map<LocalPath, std::vector<FSNode>> known;
+    scanTree(scanService, waiter, tree.root, rootFsid, nullptr, &known);
+
+    size_t entries = 0;
+    for (auto _ : state)
+    {
+        entries = scanTree(scanService, waiter, tree.root, rootFsid, &known, nullptr);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations() * entries));
+    reportPeakRss(state);
+}
+
+// a LocalNode's worth of statecache record: its parent's dbid, then the name and attributes
+struct BenchRecord : public Cacheable
+{
+    BenchRecord* parent = nullptr;
+    string name;
+
+    bool serialize(string* d) override
+    {
+        byte crc[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+
+        CacheableWriter w(*d);
+        w.serializeu32(parentdbid());
+        w.serializei64(64);                      // size
+        w.serializehandle(0x0102030405060708);   // fsid
+        w.serializenodehandle(0x0000a1b2c3d4e5f6);
+        w.serializestring(name);
+        w.serializestring(string());             // short name
+        w.serializebinary(crc, sizeof crc);
+        w.serializecompressedi64(1700000000);    // mtime
+        w.serializeexpansionflags();
+        return true;
+    }
+
+    uint32_t parentdbid() const override { return parent ? parent->dbid : 0; }
+};
+
+// the statecache of a sync of the benchmark's shape, written the first time it is asked for
+struct BenchStatecache
+{
+    FSACCESS_CLASS fsAccess;
+    PrnGen rng;
+    SymmCipher key;
+    std::unique_ptr<DbTable> table;
+    std::set<uint32_t> folderIds;
+};
+
+BenchStatecache& benchStatecache(const benchmark::State& state)
+{
+    static std::map<std::vector<int64_t>, std::unique_ptr<BenchStatecache>> caches;
+
+    auto& cache = caches[{state.range(0), state.range(1), state.range(2)}];
+    if (cache)
+    {
+        return *cache;
+    }
+    cache = ::mega::make_unique<BenchStatecache>();
+
+    byte keyData[SymmCipher::KEYLENGTH] = { 1 };
+    cache->key.setkey(keyData);
+
+    const BenchTree& tree = benchTree(cache->fsAccess, state);
+    SqliteDbAccess dbAccess(benchRoot(cache->fsAccess));
+    cache->table.reset(dbAccess.open(cache->rng, cache->fsAccess,
+        "megabench_statecache_" + std::to_string(state.range(0)) + "_" + std::to_string(state.range(1)) + "_" + std::to_string(state.range(2)),
+        DB_OPEN_FLAG_RECYCLE));
+
+    // folders first, each under the folder it was made in, then the files round-robin over them.
+    // parents come before their children, so they have their dbid by the time the children are put
+    std::vector<BenchRecord> records(tree.folders + tree.files);
+    size_t fanout = size_t(state.range(2));
+    for (size_t i = 1; i < tree.folders; ++i)
+    {
+        records[i].parent = &records[(i - 1) / fanout];
+        records[i].name = "d" + std::to_string((i - 1) % fanout);
+    }
+    for (size_t i = 0; i < tree.files; ++i)
+    {
+        records[tree.folders + i].parent = &records[i % tree.folders];
+        records[tree.folders + i].name = "f" + std::to_string(i);
+    }
+
+    std::vector<Cacheable*> batch;
+    for (auto& record : records)
+    {
+        batch.push_back(&record);
+    }
+
+    cache->table->truncate();
+    cache->table->begin();
+    cache->table->put(MegaClient::CACHEDLOCALNODE, batch, &cache->key);
+    cache->table->commit();
+
+    for (size_t i = 0; i < tree.folders; ++i)
+    {
+        cache->folderIds.insert(records[i].dbid);
+    }
+    return *cache;
+}
+
+// restart of a sync that loads its whole statecache: every record decrypted, then grouped by parent
+void BM_Sync_readstatecache(benchmark::State& state)
+{
+    BenchStatecache& cache = benchStatecache(state);
+
+    size_t loaded = 0;
+    for (auto _ : state)
+    {
+        std::multimap<uint32_t, std::pair<uint32_t, string>> byParent;
+        uint32_t id;
+        string data;
+
+        cache.table->rewind();
+        while (cache.table->next(&id, &data, &cache.key))
+        {
+            CacheableReader r(data);
+            uint32_t parent = 0;
+            r.unserializeu32(parent);
+            byParent.emplace(parent, std::make_pair(id, std::move(data)));
+        }
+        loaded = byParent.size();
+        benchmark::DoNotOptimize(byParent);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations() * loaded));
+    reportPeakRss(state);
+}
+
+// restart of a sync that loads its statecache by parent, here all of it, a folder at a time
+void BM_Sync_readstatecacheByParent(benchmark::State& state)
+{
+    BenchStatecache& cache = benchStatecache(state);
+
+    if (!cache.table->indexedbyparent())
+    {
+        state.SkipWithError("statecache not indexed by parent");
+        return;
+    }
+
+    size_t loaded = 0;
+    for (auto _ : state)
+    {
+        loaded = 0;
+        std::vector<uint32_t> folders(1, 0);
+        while (!folders.empty())
+        {
+            uint32_t parent = folders.back();
+            folders.pop_back();
+
+            std::vector<std::pair<uint32_t, string>> children;
+            cache.table->getbyparent(parent, children, &cache.key);
+            for (auto& child : children)
+            {
+                if (cache.folderIds.count(child.first))
+                {
+                    folders.push_back(child.first);
+                }
+            }
+            loaded += children.size();
+        }
+    }
+    state.SetItemsProcessed(int64_t(state.iterations() * loaded));
+    reportPeakRss(state);
+}
+
+// a storm of notifications for every file of the tree, several times over, as a bulk copy into
+// the sync produces: coalesced and folded as they are queued, then drained
+void BM_Sync_notificationStorm(benchmark::State& state)
+{
+    FSACCESS_CLASS fsAccess;
+    const BenchTree& tree = benchTree(fsAccess, state);
+    size_t fanout = size_t(state.range(2));
+
+    std::vector<LocalPath> folders(1, LocalPath::fromRelativePath(""));
+    for (size_t i = 1; i < tree.folders; ++i)
+    {
+        LocalPath child = folders[(i - 1) / fanout];
+        child.appendWithSeparator(LocalPath::fromRelativePath("d" + std::to_string((i - 1) % fanout)), false);
+        folders.push_back(child);
+    }
+
+    std::vector<LocalPath> paths;
+    paths.reserve(tree.files);
+    for (size_t i = 0; i < tree.files; ++i)
+    {
+        LocalPath file = folders[i % folders.size()];
+        file.appendWithSeparator(LocalPath::fromRelativePath("f" + std::to_string(i)), false);
+        paths.push_back(file);
+    }
+
+    const int repeats = 3;
+    size_t drained = 0;
+    for (auto _ : state)
+    {
+        NotificationDeque queue;
+        for (int r = 0; r < repeats; ++r)
+        {
+            for (auto& path : paths)
+            {
+                queue.pushBack(Notification(Waiter::ds, path, nullptr, false));
+            }
+        }
+
+        Notification notification;
+        drained = 0;
+        while (queue.popFront(notification))
+        {
+            ++drained;
+        }
+        benchmark::DoNotOptimize(drained);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * repeats * int64_t(paths.size()));
+    state.counters["drained"] = double(drained);
+    reportPeakRss(state);
+}
+
+// wide, deep, and a million files
+#define SYNC_BENCH_SHAPES ->Args({100000, 2, 16})->Args({100000, 10, 2})->Args({1000000, 3, 32})->Unit(benchmark::kMillisecond)->UseRealTime()
+
+BENCHMARK(BM_Sync_initialScan) SYNC_BENCH_SHAPES->Iterations(1);
+BENCHMARK(BM_Sync_rescan) SYNC_BENCH_SHAPES->Iterations(1);
+BENCHMARK(BM_Sync_readstatecache) SYNC_BENCH_SHAPES;
+BENCHMARK(BM_Sync_readstatecacheByParent) SYNC_BENCH_SHAPES;
+BENCHMARK(BM_Sync_notificationStorm) SYNC_BENCH_SHAPES;
+
+} // anonymous
+
+#endif
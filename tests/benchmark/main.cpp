@@ -0,0 +1,48 @@
+/**
+ * (c) 2026 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <cstring>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+int main(int argc, char* argv[])
+{
+    // results are compared between releases, so report JSON unless told otherwise
+    std::vector<char*> args(argv, argv + argc);
+    bool formatGiven = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        formatGiven = formatGiven || !strncmp(argv[i], "--benchmark_format", 18);
+    }
+
+    char jsonFormat[] = "--benchmark_format=json";
+    if (!formatGiven)
+    {
+        args.push_back(jsonFormat);
+    }
+
+    int count = int(args.size());
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data()))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
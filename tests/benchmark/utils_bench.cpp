@@ -0,0 +1,97 @@
+/**
+ * (c) 2026 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <mega.h>
+
+namespace {
+
+using namespace mega;
+
+void BM_Base64_btoa(benchmark::State& state)
+{
+    string binary(size_t(state.range(0)), '\0');
+    for (size_t i = 0; i < binary.size(); ++i)
+    {
+        binary[i] = char(i * 13);
+    }
+
+    for (auto _ : state)
+    {
+        string encoded;
+        Base64::btoa(binary, encoded);
+        benchmark::DoNotOptimize(encoded.data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_Base64_btoa)->Arg(16)->Arg(4096)->Arg(1024 * 1024);
+
+void BM_Base64_atob(benchmark::State& state)
+{
+    string binary(size_t(state.range(0)), '\0');
+    for (size_t i = 0; i < binary.size(); ++i)
+    {
+        binary[i] = char(i * 13);
+    }
+    string encoded = Base64::btoa(binary);
+
+    for (auto _ : state)
+    {
+        string decoded;
+        Base64::atob(encoded, decoded);
+        benchmark::DoNotOptimize(decoded.data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_Base64_atob)->Arg(16)->Arg(4096)->Arg(1024 * 1024);
+
+// names that only differ near the end, the worst case when sorting a folder
+void BM_compareUtf(benchmark::State& state)
+{
+    bool caseInsensitive = state.range(0) != 0;
+    bool unescaping = state.range(1) != 0;
+    string a = "Photos from the summer holiday %25 2020 - IMG_0001.jpg";
+    string b = "Photos from the summer holiday %25 2020 - img_0002.jpg";
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(compareUtf(a, unescaping, b, unescaping, caseInsensitive));
+    }
+}
+BENCHMARK(BM_compareUtf)->Args({0, 0})->Args({1, 0})->Args({1, 1});
+
+// cost of accounting a work item as busy time, with the utilization it reports for a
+// thread that does nothing else
+void BM_ThreadTopology_busy(benchmark::State& state)
+{
+    ThreadTopology::threadStarted(ThreadTopology::FINGERPRINT);
+    ThreadTopology::stats(ThreadTopology::FINGERPRINT, true);
+
+    for (auto _ : state)
+    {
+        ThreadTopology::Busy busy(ThreadTopology::FINGERPRINT);
+        benchmark::ClobberMemory();
+    }
+
+    state.counters["utilization"] = ThreadTopology::stats(ThreadTopology::FINGERPRINT, true).utilization;
+    ThreadTopology::threadStopped(ThreadTopology::FINGERPRINT);
+}
+BENCHMARK(BM_ThreadTopology_busy);
+
+} // anonymous
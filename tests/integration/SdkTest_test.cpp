@@ -6312,6 +6312,125 @@ TEST_F(SdkTest, SdkFavouriteNodes)
     ASSERT_EQ(favNode->getName(), subFolder) << "synchronousGetFavourites failed with node passed nullptr";
 }
 
+TEST_F(SdkTest, SdkBulkNodeOperations)
+{
+    ASSERT_NO_FATAL_FAILURE(getAccountsForTest(1));
+    LOG_info << "___TEST SdkBulkNodeOperations___";
+
+    unique_ptr<MegaNode> rootnode(megaApi[0]->getRootNode());
+    ASSERT_TRUE(rootnode);
+
+    auto nh = createFolder(0, "bulk-target", rootnode.get());
+    ASSERT_NE(nh, UNDEF);
+    unique_ptr<MegaNode> target(megaApi[0]->getNodeByHandle(nh));
+    ASSERT_TRUE(!!target);
+
+    vector<unique_ptr<MegaNode>> folders;
+    for (const char* name : { "bulk-1", "bulk-2", "bulk-3" })
+    {
+        nh = createFolder(0, name, rootnode.get());
+        ASSERT_NE(nh, UNDEF);
+        folders.emplace_back(megaApi[0]->getNodeByHandle(nh));
+        ASSERT_TRUE(!!folders.back());
+    }
+
+    // a node that is gone by the time the bulk requests run
+    nh = createFolder(0, "bulk-removed", rootnode.get());
+    ASSERT_NE(nh, UNDEF);
+    unique_ptr<MegaNode> removed(megaApi[0]->getNodeByHandle(nh));
+    ASSERT_TRUE(!!removed);
+    ASSERT_EQ(API_OK, doDeleteNode(0, removed.get()));
+
+    auto base64 = [](MegaHandle h)
+    {
+        unique_ptr<char[]> b64(MegaApi::handleToBase64(h));
+        return string(b64.get());
+    };
+
+    // --- Set a custom attribute on every node, all of them existing ---
+
+    unique_ptr<MegaNodeList> nodes(MegaNodeList::createInstance());
+    for (auto& folder : folders)
+    {
+        nodes->addNode(folder.get());
+    }
+
+    RequestTracker setAttrs(megaApi[0].get());
+    megaApi[0]->setNodesCustomAttribute(nodes.get(), "bulk", "value1", &setAttrs);
+    ASSERT_EQ(API_OK, setAttrs.waitForResult());
+    ASSERT_EQ(MegaRequest::TYPE_SET_ATTR_NODES, setAttrs.request->getType());
+    ASSERT_TRUE(!setAttrs.request->getMegaStringMap() || !setAttrs.request->getMegaStringMap()->size());
+
+    for (auto& folder : folders)
+    {
+        unique_ptr<MegaNode> n(megaApi[0]->getNodeByHandle(folder->getHandle()));
+        ASSERT_TRUE(!!n);
+        ASSERT_STREQ("value1", n->getCustomAttr("bulk")) << folder->getName();
+    }
+
+    // --- Set it again, with one node that no longer exists ---
+
+    nodes->addNode(removed.get());
+
+    RequestTracker setAttrsPartly(megaApi[0].get());
+    megaApi[0]->setNodesCustomAttribute(nodes.get(), "bulk", "value2", &setAttrsPartly);
+    ASSERT_EQ(API_ENOENT, setAttrsPartly.waitForResult());
+
+    const MegaStringMap* failed = setAttrsPartly.request->getMegaStringMap();
+    ASSERT_TRUE(failed);
+    ASSERT_EQ(1, failed->size());
+    ASSERT_STREQ(std::to_string(API_ENOENT).c_str(), failed->get(base64(removed->getHandle()).c_str()));
+
+    // the other nodes still got the new value
+    for (auto& folder : folders)
+    {
+        unique_ptr<MegaNode> n(megaApi[0]->getNodeByHandle(folder->getHandle()));
+        ASSERT_TRUE(!!n);
+        ASSERT_STREQ("value2", n->getCustomAttr("bulk")) << folder->getName();
+    }
+
+    // --- Move the nodes, with one that doesn't exist and one that can't be moved ---
+
+    unique_ptr<MegaNode> rubbish(megaApi[0]->getRubbishNode());
+    ASSERT_TRUE(!!rubbish);
+    nodes->addNode(rubbish.get());
+
+    RequestTracker moveNodes(megaApi[0].get());
+    megaApi[0]->moveNodes(nodes.get(), target.get(), &moveNodes);
+    int moveResult = moveNodes.waitForResult();
+    ASSERT_TRUE(moveResult == API_ENOENT || moveResult == API_EACCESS) << moveResult;
+    ASSERT_EQ(MegaRequest::TYPE_MOVE_NODES, moveNodes.request->getType());
+
+    failed = moveNodes.request->getMegaStringMap();
+    ASSERT_TRUE(failed);
+    ASSERT_EQ(2, failed->size());
+    ASSERT_STREQ(std::to_string(API_ENOENT).c_str(), failed->get(base64(removed->getHandle()).c_str()));
+    ASSERT_STREQ(std::to_string(API_EACCESS).c_str(), failed->get(base64(rubbish->getHandle()).c_str()));
+
+    for (auto& folder : folders)
+    {
+        unique_ptr<MegaNode> n(megaApi[0]->getNodeByHandle(folder->getHandle()));
+        ASSERT_TRUE(!!n);
+        ASSERT_EQ(target->getHandle(), n->getParentHandle()) << folder->getName();
+    }
+
+    unique_ptr<MegaNodeList> children(megaApi[0]->getChildren(target.get()));
+    ASSERT_TRUE(children && children->size() == int(folders.size()));
+
+    // --- Moving them where they already are succeeds for all of them ---
+
+    unique_ptr<MegaNodeList> moved(MegaNodeList::createInstance());
+    for (auto& folder : folders)
+    {
+        moved->addNode(folder.get());
+    }
+
+    RequestTracker moveAgain(megaApi[0].get());
+    megaApi[0]->moveNodes(moved.get(), target.get(), &moveAgain);
+    ASSERT_EQ(API_OK, moveAgain.waitForResult());
+    ASSERT_TRUE(!moveAgain.request->getMegaStringMap() || !moveAgain.request->getMegaStringMap()->size());
+}
+
 TEST_F(SdkTest, SdkDeviceNames)
 {
     /// Run this before other tests that use device name, like SdkBackupFolder
@@ -0,0 +1,285 @@
+/**
+ * @file main.cpp
+ * @brief replays recorded API traffic into a MegaClient, for comparing SDK versions
+ *
+ * (c) 2013-2026 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "replay.h"
+
+using namespace std;
+using namespace ::mega;
+using namespace ::replay;
+
+namespace {
+
+struct ReplayApp : public MegaApp
+{
+    bool fetchnodesDone = false;
+    error fetchnodesError = API_OK;
+
+    void fetchnodes_result(const Error& e) override
+    {
+        fetchnodesDone = true;
+        fetchnodesError = e;
+    }
+};
+
+size_t currentRss()
+{
+    size_t pages = 0, resident = 0;
+    if (FILE* f = fopen("/proc/self/statm", "r"))
+    {
+        if (fscanf(f, "%zu %zu", &pages, &resident) != 2)
+        {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return resident * size_t(sysconf(_SC_PAGESIZE));
+}
+
+size_t peakRss()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return size_t(usage.ru_maxrss);
+#else
+    return size_t(usage.ru_maxrss) * 1024;
+#endif
+}
+
+// time spent per instrumented scope, in microseconds
+map<string, uint64_t> scopeTimes()
+{
+    map<string, uint64_t> times;
+    for (auto& e : Metrics::snapshot())
+    {
+        if (e.type == Metrics::HISTOGRAM)
+        {
+            times[e.name] = e.sumMicroseconds;
+        }
+    }
+    return times;
+}
+
+// one step of the replay: wall clock, memory, and the time of each phase of node processing
+struct Stage
+{
+    string name;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    map<string, uint64_t> startTimes = scopeTimes();
+    size_t startRss = currentRss();
+
+    string report() const
+    {
+        auto times = scopeTimes();
+        auto delta = [&](const char* scope) -> int64_t
+        {
+            auto it = startTimes.find(scope);
+            return int64_t(times[scope]) - int64_t(it == startTimes.end() ? 0 : it->second);
+        };
+
+        // the node database is written, and keys applied if not done in parallel, while nodes are read
+        int64_t decrypt = delta("MegaClient_predecryptnodes") + delta("MegaClient_applyKeys");
+        int64_t dbInsert = delta("NodeManager_saveNodeInDb") + delta("NodeManager_saveNodesInDb") + delta("NodeManager_createIndexes");
+        int64_t parse = delta("MegaClient_readnodes") - delta("MegaClient_predecryptnodes") - delta("NodeManager_saveNodeInDb");
+
+        size_t rss = currentRss();
+        auto seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        return "{\"name\":\"" + name + "\""
+             + ",\"seconds\":" + to_string(seconds)
+             + ",\"rssBytes\":" + to_string(rss)
+             + ",\"rssDeltaBytes\":" + to_string(int64_t(rss) - int64_t(startRss))
+             + ",\"peakRssBytes\":" + to_string(peakRss())
+             + ",\"phasesMicroseconds\":{"
+             + "\"parse\":" + to_string(std::max<int64_t>(parse, 0))
+             + ",\"decrypt\":" + to_string(decrypt)
+             + ",\"dbInsert\":" + to_string(dbInsert)
+             + ",\"counters\":" + to_string(delta("NodeManager_initCounters"))
+             + ",\"actionPackets\":" + to_string(delta("sc processing"))
+             + "}}";
+    }
+};
+
+// run the client until `done`, checking the time limit at least once a second
+bool runUntil(MegaClient& client, Waiter& waiter, const function<bool()>& done, chrono::seconds limit)
+{
+    auto deadline = chrono::steady_clock::now() + limit;
+    for (;;)
+    {
+        client.exec();
+        if (done())
+        {
+            return true;
+        }
+        if (chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        if (!client.preparewait())
+        {
+            if (waiter.maxds > 10)
+            {
+                waiter.maxds = 10;
+            }
+            client.dowait();
+            client.checkevents();
+        }
+    }
+}
+
+void usage()
+{
+    cerr << "usage: tool_replay [options] <recording>\n"
+            "       tool_replay [options] --generate <nodes>\n"
+            "options:\n"
+            "  --db <dir>          where to create the node database (default: current directory)\n"
+            "  --batches <n>       sc responses to generate (default: 100)\n"
+            "  --packets <n>       action packets per generated sc response (default: 100)\n"
+            "  --seed <n>          seed for the generator (default: 1)\n"
+            "  --save <file>       write the generated recording, for replay by other SDK versions\n"
+            "  --timeout <s>       give up after this many seconds per stage (default: 3600)\n"
+            "  --verbose           log at debug level\n";
+}
+
+} // anonymous
+
+int main(int argc, char* argv[])
+{
+    string recordingPath, savePath, dbPath;
+    size_t generateNodes = 0, batches = 100, packets = 100;
+    unsigned seed = 1;
+    long timeout = 3600;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--generate" && hasValue) generateNodes = size_t(strtoull(argv[++i], nullptr, 10));
+        else if (arg == "--batches" && hasValue) batches = size_t(strtoull(argv[++i], nullptr, 10));
+        else if (arg == "--packets" && hasValue) packets = size_t(strtoull(argv[++i], nullptr, 10));
+        else if (arg == "--seed" && hasValue) seed = unsigned(strtoul(argv[++i], nullptr, 10));
+        else if (arg == "--save" && hasValue) savePath = argv[++i];
+        else if (arg == "--db" && hasValue) dbPath = argv[++i];
+        else if (arg == "--timeout" && hasValue) timeout = strtol(argv[++i], nullptr, 10);
+        else if (arg == "--verbose") verbose = true;
+        else if (arg[0] != '-' && recordingPath.empty()) recordingPath = arg;
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    if (recordingPath.empty() == !generateNodes)
+    {
+        usage();
+        return 2;
+    }
+
+    SimpleLogger::setLogLevel(verbose ? logDebug : logWarning);
+
+    Recording recording;
+    if (generateNodes)
+    {
+        recording = generate(generateNodes, batches, packets, seed);
+        if (!savePath.empty() && !recording.save(savePath))
+        {
+            cerr << "cannot write " << savePath << endl;
+            return 1;
+        }
+    }
+    else
+    {
+        string error;
+        if (!recording.load(recordingPath, error))
+        {
+            cerr << error << endl;
+            return 1;
+        }
+    }
+
+    if (dbPath.empty())
+    {
+        char cwd[4096];
+        dbPath = getcwd(cwd, sizeof cwd) ? cwd : ".";
+    }
+
+    WAIT_CLASS waiter;
+    ReplayHttpIO httpio(recording, waiter);
+    ReplayApp app;
+
+    MegaClient client(&app, &waiter, &httpio, new SqliteDbAccess(LocalPath::fromAbsolutePath(dbPath)),
+                      nullptr, "replay", "tool_replay", 2);
+
+    // a logged in session, as far as processing the responses goes
+    client.key.setkey(recording.masterKey);
+    client.me = recording.me;
+    client.uid = Base64Str<MegaClient::USERHANDLE>(client.me).chars;
+    client.sid.assign(SymmCipher::KEYLENGTH, '\0');
+    client.sid.append(client.uid);
+    client.sid.append("replay-session-id").resize(MegaClient::SIDLEN, '\0');
+    client.finduser(client.me, 1);
+
+    string report = "{\"nodesGenerated\":" + to_string(recording.nodeCount) + ",\"stages\":[";
+    bool ok = true;
+
+    {
+        // the fetchnodes response, until the client asks for action packets
+        Stage stage;
+        stage.name = "fetchnodes";
+        client.fetchnodes(true);
+        ok = runUntil(client, waiter, [&]() { return httpio.scWaiting() || app.fetchnodesDone; }, chrono::seconds(timeout));
+        report += stage.report();
+    }
+
+    if (ok && !app.fetchnodesDone)
+    {
+        Stage stage;
+        stage.name = "actionpackets";
+        httpio.releaseSc(client.scsn.text());
+        ok = runUntil(client, waiter, [&]()
+        {
+            return app.fetchnodesDone && recording.sc.empty() && httpio.scWaiting() && !client.pendingcs;
+        }, chrono::seconds(timeout));
+        report += "," + stage.report();
+    }
+
+    report += "],\"nodes\":" + to_string(client.mNodeManager.getNodeCount())
+            + ",\"csBatches\":" + to_string(httpio.csBatches())
+            + ",\"scResponses\":" + to_string(httpio.scResponses())
+            + ",\"result\":\"" + (!ok ? "timeout" : app.fetchnodesError != API_OK ? "error " + to_string(app.fetchnodesError) : "ok") + "\"}";
+    cout << report << endl;
+
+    client.locallogout(true, true);
+    return ok && app.fetchnodesError == API_OK ? 0 : 1;
+}
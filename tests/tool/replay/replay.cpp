@@ -0,0 +1,455 @@
+/**
+ * @file replay.cpp
+ * @brief replays recorded API traffic into a MegaClient, for comparing SDK versions
+ *
+ * (c) 2013-2026 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "replay.h"
+
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace replay {
+
+namespace {
+
+bool readPayload(std::istream& in, size_t length, std::string& payload)
+{
+    payload.resize(length);
+    if (length && !in.read(&payload[0], std::streamsize(length)))
+    {
+        return false;
+    }
+    return in.get() == '\n';
+}
+
+// generates nodes the way the API returns them, encrypted for the account's master key
+class NodeGenerator
+{
+public:
+    NodeGenerator(Recording& recording, unsigned seed)
+        : mRng(seed)
+    {
+        for (auto& b : recording.masterKey)
+        {
+            b = static_cast<byte>(mRng());
+        }
+        recording.me = mRng();
+        mMaster.setkey(recording.masterKey);
+        mMe = Base64Str<MegaClient::USERHANDLE>(recording.me).chars;
+    }
+
+    handle newHandle()
+    {
+        return mNextHandle++;
+    }
+
+    m_time_t nextTimestamp()
+    {
+        return mTimestamp += 7;
+    }
+
+    std::mt19937_64& rng()
+    {
+        return mRng;
+    }
+
+    const std::string& me() const
+    {
+        return mMe;
+    }
+
+    std::string node(handle h, handle parent, nodetype_t type, const std::string& name)
+    {
+        std::string json = "{\"h\":\"";
+        json.append(Base64Str<MegaClient::NODEHANDLE>(h).chars);
+        if (!ISUNDEF(parent))
+        {
+            json.append("\",\"p\":\"").append(Base64Str<MegaClient::NODEHANDLE>(parent).chars);
+        }
+        json.append("\",\"u\":\"").append(mMe);
+        json.append("\",\"t\":").append(std::to_string(type));
+
+        if (type == FILENODE || type == FOLDERNODE)
+        {
+            size_t keyLength = type == FILENODE ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH;
+            byte key[FILENODEKEYLENGTH];
+            for (size_t i = 0; i < keyLength; i++)
+            {
+                key[i] = static_cast<byte>(mRng());
+            }
+
+            json.append(",\"a\":\"").append(attributes(key, type, name));
+
+            byte encryptedKey[FILENODEKEYLENGTH];
+            mMaster.ecb_encrypt(key, encryptedKey, keyLength);
+            json.append("\",\"k\":\"").append(mMe).append(":")
+                .append(Base64::btoa(std::string(reinterpret_cast<char*>(encryptedKey), keyLength)));
+            json.append("\"");
+
+            // node keys are kept for renames
+            mKeys[h].assign(reinterpret_cast<char*>(key), keyLength);
+        }
+
+        if (type == FILENODE)
+        {
+            json.append(",\"s\":").append(std::to_string(mRng() % (64 << 20)));
+        }
+        json.append(",\"ts\":").append(std::to_string(nextTimestamp())).append("}");
+        return json;
+    }
+
+    std::string attributes(handle h, const std::string& name)
+    {
+        const std::string& key = mKeys[h];
+        return attributes(reinterpret_cast<const byte*>(key.data()), key.size() == FILENODEKEYLENGTH ? FILENODE : FOLDERNODE, name);
+    }
+
+    void forget(handle h)
+    {
+        mKeys.erase(h);
+    }
+
+private:
+    std::string attributes(const byte* key, nodetype_t type, const std::string& name)
+    {
+        SymmCipher cipher;
+        cipher.setkey(key, type);
+
+        std::string attrs;
+        MegaClient::makeattr(&cipher, &attrs, ("\"n\":\"" + name + "\"").c_str());
+        return Base64::btoa(attrs);
+    }
+
+    std::mt19937_64 mRng;
+    SymmCipher mMaster;
+    std::string mMe;
+    handle mNextHandle = 0x100000;
+    m_time_t mTimestamp = 1500000000;
+    std::map<handle, std::string> mKeys;
+};
+
+} // anonymous
+
+bool Recording::load(const std::string& path, std::string& error)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    std::string line;
+    for (unsigned lineNumber = 1; std::getline(in, line); lineNumber++)
+    {
+        std::istringstream header(line);
+        std::string kind;
+        header >> kind;
+
+        if (kind.empty() || kind[0] == '#')
+        {
+            continue;
+        }
+
+        std::string value;
+        size_t length = 0;
+        bool ok = true;
+        if (kind == "key")
+        {
+            ok = header >> value && Base64::atob(value.c_str(), masterKey, int(sizeof masterKey)) == int(sizeof masterKey);
+        }
+        else if (kind == "me")
+        {
+            ok = header >> value && Base64::atob(value.c_str(), reinterpret_cast<byte*>(&me), MegaClient::USERHANDLE) == MegaClient::USERHANDLE;
+        }
+        else if (kind == "cs")
+        {
+            std::string command;
+            ok = header >> command >> length && readPayload(in, length, value);
+            if (ok)
+            {
+                cs[command].push_back(std::move(value));
+            }
+        }
+        else if (kind == "sc")
+        {
+            ok = header >> length && readPayload(in, length, value);
+            if (ok)
+            {
+                sc.push_back(std::move(value));
+            }
+        }
+        else
+        {
+            ok = false;
+        }
+
+        if (!ok)
+        {
+            error = path + ":" + std::to_string(lineNumber) + ": bad " + kind + " record";
+            return false;
+        }
+    }
+
+    if (ISUNDEF(me) || cs["f"].empty())
+    {
+        error = path + ": the recording needs `me` and a fetchnodes (`cs f`) response";
+        return false;
+    }
+    return true;
+}
+
+bool Recording::save(const std::string& path) const
+{
+    std::ofstream out(path, std::ios::binary);
+
+    out << "key " << Base64::btoa(std::string(reinterpret_cast<const char*>(masterKey), sizeof masterKey)) << "\n";
+    out << "me " << Base64Str<MegaClient::USERHANDLE>(me).chars << "\n";
+    for (auto& command : cs)
+    {
+        for (auto& response : command.second)
+        {
+            out << "cs " << command.first << " " << response.size() << "\n" << response << "\n";
+        }
+    }
+    for (auto& response : sc)
+    {
+        out << "sc " << response.size() << "\n" << response << "\n";
+    }
+    return bool(out);
+}
+
+Recording generate(size_t nodes, size_t scBatches, size_t packetsPerBatch, unsigned seed)
+{
+    Recording recording;
+    NodeGenerator gen(recording, seed);
+    handle scsn = 0x1000;
+
+    handle root = gen.newHandle();
+    std::vector<handle> folders(1, root);
+
+    std::string f = "{\"f\":[";
+    f.append(gen.node(root, UNDEF, ROOTNODE, "")).append(",");
+    f.append(gen.node(gen.newHandle(), UNDEF, VAULTNODE, "")).append(",");
+    f.append(gen.node(gen.newHandle(), UNDEF, RUBBISHNODE, ""));
+    f.reserve(nodes * 280);
+
+    for (size_t i = 0; i < nodes; i++)
+    {
+        // parents always precede their children, as in a real response
+        handle parent = folders[gen.rng()() % folders.size()];
+        handle h = gen.newHandle();
+        bool folder = i % 10 == 0;
+        f.append(",").append(gen.node(h, parent, folder ? FOLDERNODE : FILENODE,
+                                      (folder ? "folder " : "file ") + std::to_string(i)));
+        if (folder)
+        {
+            folders.push_back(h);
+        }
+    }
+    f.append("],\"sn\":\"").append(Base64Str<MegaClient::USERHANDLE>(scsn++).chars).append("\"}");
+    recording.cs["f"].push_back(std::move(f));
+    recording.nodeCount = nodes + 3;
+
+    recording.cs["ug"].push_back("{\"u\":\"" + gen.me() + "\",\"since\":1500000000}");
+
+    // files added by the action packets, which are the ones later renamed and deleted
+    std::deque<handle> added;
+    for (size_t batch = 0; batch < scBatches; batch++)
+    {
+        std::string sc = "{\"a\":[";
+        for (size_t i = 0; i < packetsPerBatch; i++)
+        {
+            if (i)
+            {
+                sc.append(",");
+            }
+
+            size_t kind = (batch * packetsPerBatch + i) % 4;
+            if (kind == 1 && !added.empty())
+            {
+                handle h = added[gen.rng()() % added.size()];
+                sc.append("{\"a\":\"u\",\"n\":\"").append(Base64Str<MegaClient::NODEHANDLE>(h).chars)
+                  .append("\",\"u\":\"").append(gen.me())
+                  .append("\",\"at\":\"").append(gen.attributes(h, "renamed " + std::to_string(i)))
+                  .append("\",\"ts\":").append(std::to_string(gen.nextTimestamp())).append("}");
+            }
+            else if (kind == 3 && !added.empty())
+            {
+                handle h = added.front();
+                added.pop_front();
+                gen.forget(h);
+                sc.append("{\"a\":\"d\",\"n\":\"").append(Base64Str<MegaClient::NODEHANDLE>(h).chars)
+                  .append("\",\"ou\":\"").append(gen.me()).append("\"}");
+            }
+            else
+            {
+                handle parent = folders[gen.rng()() % folders.size()];
+                handle h = gen.newHandle();
+                added.push_back(h);
+                sc.append("{\"a\":\"t\",\"t\":{\"f\":[")
+                  .append(gen.node(h, parent, FILENODE, "new file " + std::to_string(i)))
+                  .append("]},\"ou\":\"").append(gen.me()).append("\"}");
+            }
+        }
+        sc.append("],\"sn\":\"").append(Base64Str<MegaClient::USERHANDLE>(scsn++).chars).append("\"}");
+        recording.sc.push_back(std::move(sc));
+    }
+
+    return recording;
+}
+
+ReplayHttpIO::ReplayHttpIO(Recording& recording, Waiter& waiter)
+    : mRecording(recording)
+    , mWaiter(waiter)
+{
+}
+
+void ReplayHttpIO::post(HttpReq* req, const char* data, unsigned len)
+{
+    req->status = REQ_INFLIGHT;
+    req->httpiohandle = this;
+
+    if (req->posturl.find("/cs?") != string::npos)
+    {
+        // a batch of commands: answer each with its next recorded response
+        string body = data ? string(data, len) : req->out;
+        JSON json(body);
+        string response = "[";
+        if (json.enterarray())
+        {
+            while (json.enterobject())
+            {
+                string command;
+                for (nameid name; (name = json.getnameid()) != EOO; )
+                {
+                    if (name == 'a')
+                    {
+                        json.storeobject(&command);
+                    }
+                    else
+                    {
+                        json.storeobject();
+                    }
+                }
+                json.leaveobject();
+
+                auto it = mRecording.cs.find(command);
+                response.append(response.size() > 1 ? "," : "");
+                if (it != mRecording.cs.end() && !it->second.empty())
+                {
+                    response.append(it->second.front());
+                    it->second.pop_front();
+                }
+                else
+                {
+                    response.append("0");
+                }
+            }
+        }
+        response.append("]");
+
+        mCsBatches++;
+        complete(req, std::move(response));
+    }
+    else if (req->posturl.find("?sn=") != string::npos)
+    {
+        mParkedSc = req;
+        if (mScReleased && !mRecording.sc.empty())
+        {
+            mParkedSc = nullptr;
+            mScResponses++;
+            string response = std::move(mRecording.sc.front());
+            mRecording.sc.pop_front();
+            complete(req, std::move(response));
+        }
+    }
+}
+
+void ReplayHttpIO::complete(HttpReq* req, std::string&& response)
+{
+    req->in = std::move(response);
+    req->bufpos = m_off_t(req->in.size());
+    req->contentlength = req->bufpos;
+    req->httpstatus = 200;
+    req->lastdata = Waiter::ds;
+    req->status = REQ_SUCCESS;
+    success = true;
+    lastdata = Waiter::ds;
+    mWaiter.notify();
+}
+
+void ReplayHttpIO::releaseSc(const std::string& scsn)
+{
+    mScReleased = true;
+    if (mRecording.sc.empty())
+    {
+        mRecording.sc.push_back("{\"a\":[],\"sn\":\"" + scsn + "\"}");
+    }
+
+    if (HttpReq* req = mParkedSc)
+    {
+        mParkedSc = nullptr;
+        mScResponses++;
+        string response = std::move(mRecording.sc.front());
+        mRecording.sc.pop_front();
+        complete(req, std::move(response));
+    }
+}
+
+bool ReplayHttpIO::scWaiting() const
+{
+    return mParkedSc != nullptr;
+}
+
+void ReplayHttpIO::cancel(HttpReq* req)
+{
+    if (mParkedSc == req)
+    {
+        mParkedSc = nullptr;
+    }
+    req->httpiohandle = nullptr;
+    req->httpstatus = 0;
+    if (req->status != REQ_SUCCESS)
+    {
+        req->status = REQ_FAILURE;
+    }
+}
+
+m_off_t ReplayHttpIO::postpos(void*)
+{
+    return 0;
+}
+
+bool ReplayHttpIO::doio()
+{
+    return false;
+}
+
+void ReplayHttpIO::addevents(Waiter*, int)
+{
+}
+
+void ReplayHttpIO::setuseragent(string*)
+{
+}
+
+} // namespace replay
@@ -0,0 +1,97 @@
+/**
+ * @file replay.h
+ * @brief replays recorded API traffic into a MegaClient, for comparing SDK versions
+ *
+ * (c) 2013-2026 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <deque>
+#include <map>
+#include <string>
+
+#include <mega.h>
+
+namespace replay {
+
+using namespace ::mega;
+
+// The traffic of one session: the keys needed to decrypt it, the responses to `cs` commands (by command
+// name, in the order they were issued) and the `sc` responses (in order).
+//
+// On disk, a sequence of records, each a header line optionally followed by a payload of <length> bytes and a newline:
+//   # comment
+//   key <master key in base64>
+//   me <own user handle in base64>
+//   cs <command> <length>
+//   sc <length>
+struct Recording
+{
+    byte masterKey[SymmCipher::KEYLENGTH] = {};
+    handle me = UNDEF;
+    std::map<std::string, std::deque<std::string>> cs;
+    std::deque<std::string> sc;
+
+    // number of nodes in the fetchnodes response, for reporting
+    size_t nodeCount = 0;
+
+    bool load(const std::string& path, std::string& error);
+    bool save(const std::string& path) const;
+};
+
+// An account of `nodes` nodes (a tenth of them folders) followed by `scBatches` sc responses
+// of `packetsPerBatch` action packets each (new files, renames and deletions).
+Recording generate(size_t nodes, size_t scBatches, size_t packetsPerBatch, unsigned seed);
+
+// Answers the client's requests from a Recording instead of the network.  cs batches get the next recorded
+// response of each of their commands (or 0 for commands not recorded).  sc requests are parked until
+// releaseSc(), then get the recorded responses in turn, and are parked again when there are no more.
+// Anything else (user alert catch-up, wait requests) is left in flight.
+class ReplayHttpIO : public HttpIO
+{
+public:
+    ReplayHttpIO(Recording& recording, Waiter& waiter);
+
+    void post(HttpReq*, const char* = NULL, unsigned = 0) override;
+    void cancel(HttpReq*) override;
+    m_off_t postpos(void*) override;
+    bool doio(void) override;
+    void addevents(Waiter*, int) override;
+    void setuseragent(string*) override;
+
+    // start answering sc requests; an empty catch-up at `scsn` is made up if nothing was recorded
+    void releaseSc(const std::string& scsn);
+
+    // an sc request is waiting for a response (and none is left, once released)
+    bool scWaiting() const;
+
+    size_t csBatches() const { return mCsBatches; }
+    size_t scResponses() const { return mScResponses; }
+
+private:
+    void complete(HttpReq* req, std::string&& response);
+
+    Recording& mRecording;
+    Waiter& mWaiter;
+    HttpReq* mParkedSc = nullptr;
+    bool mScReleased = false;
+    size_t mCsBatches = 0;
+    size_t mScResponses = 0;
+};
+
+} // namespace replay
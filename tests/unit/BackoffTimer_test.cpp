@@ -0,0 +1,116 @@
+/**
+ * (c) 2019 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <mega/backofftimer.h>
+#include <mega/utils.h>
+#include <mega/waiter.h>
+
+using namespace mega;
+
+TEST(BackoffTimerGroupTracker, TracksOnlyPendingEnabledTimers)
+{
+    PrnGen rng;
+    BackoffTimerGroupTracker tracker;
+    Waiter::ds = 1000;
+
+    BackoffTimerTracked a(rng, tracker);
+    BackoffTimerTracked b(rng, tracker);
+    ASSERT_EQ(tracker.size(), 0u);
+
+    a.backoff(50);
+    b.backoff(NEVER);
+    ASSERT_EQ(tracker.size(), 1u);
+
+    a.enable(false);
+    ASSERT_EQ(tracker.size(), 0u);
+
+    a.enable(true);
+    ASSERT_EQ(tracker.size(), 1u);
+
+    a.reset();
+    ASSERT_EQ(tracker.size(), 0u);
+}
+
+TEST(BackoffTimerGroupTracker, ReportsTheSoonestTimeout)
+{
+    PrnGen rng;
+    BackoffTimerGroupTracker tracker;
+    Waiter::ds = 1000;
+
+    BackoffTimerTracked soon(rng, tracker);
+    BackoffTimerTracked later(rng, tracker);
+    soon.backoff(30);
+    later.backoff(5000000);
+
+    // wake-ups may come early for a distant bucket, but never late, and end up at the exact timeout
+    dstime waituntil = NEVER;
+    while (!soon.armed())
+    {
+        waituntil = NEVER;
+        tracker.update(&waituntil, false);
+        ASSERT_GT(waituntil, Waiter::ds);
+        ASSERT_LE(waituntil, 1030u);
+        Waiter::ds = waituntil;
+    }
+    ASSERT_EQ(Waiter::ds, 1030u);
+    ASSERT_FALSE(later.armed());
+
+    soon.reset();
+    waituntil = NEVER;
+    tracker.update(&waituntil, false);
+    ASSERT_GT(waituntil, 1030u);
+    ASSERT_LE(waituntil, 5001000u);
+}
+
+TEST(BackoffTimerGroupTracker, FiresExpiredTransferTimersOnce)
+{
+    PrnGen rng;
+    BackoffTimerGroupTracker tracker;
+    Waiter::ds = 1000;
+
+    std::vector<std::unique_ptr<BackoffTimerTracked>> timers;
+    for (dstime i = 0; i < 1000; i++)
+    {
+        timers.emplace_back(new BackoffTimerTracked(rng, tracker));
+        timers.back()->backoff(1 + i * 997);
+    }
+
+    // jump well past half of them, as after a long sleep
+    Waiter::ds = 1000 + 500 * 997;
+
+    dstime waituntil = NEVER;
+    tracker.update(&waituntil, true);
+    ASSERT_EQ(waituntil, 0u);
+    ASSERT_EQ(tracker.size(), 500u);
+
+    for (dstime i = 0; i < 1000; i++)
+    {
+        ASSERT_EQ(timers[i]->armed(), i < 500) << i;
+    }
+
+    // the rest keep waiting for their own timeout
+    waituntil = NEVER;
+    tracker.update(&waituntil, true);
+    ASSERT_GT(waituntil, Waiter::ds);
+    ASSERT_LE(waituntil, 1000u + 1 + 500 * 997);
+}
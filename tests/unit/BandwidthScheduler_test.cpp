@@ -0,0 +1,240 @@
+/**
+ * (c) 2019 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <mega/http.h>
+
+using namespace mega;
+
+TEST(BandwidthScheduler, UnlimitedGrantsEverything)
+{
+    BandwidthScheduler scheduler;
+    int request;
+
+    ASSERT_EQ(scheduler.acquire(GET, &request, BandwidthScheduler::USER, 12345, true, 1), 12345u);
+    ASSERT_EQ(scheduler.acquire(PUT, &request, BandwidthScheduler::BACKUP, 12345, false, 1), 12345u);
+}
+
+TEST(BandwidthScheduler, SharesRefillsByCategoryWeight)
+{
+    BandwidthScheduler scheduler;
+    scheduler.setlimit(GET, 10000);
+    scheduler.setweight(BandwidthScheduler::USER, 4);
+    scheduler.setweight(BandwidthScheduler::BACKUP, 1);
+
+    int user, backup;
+
+    // nothing until the first refill, which registers both as active
+    ASSERT_EQ(scheduler.acquire(GET, &user, BandwidthScheduler::USER, 100000, true, 1), 0u);
+    ASSERT_EQ(scheduler.acquire(GET, &backup, BandwidthScheduler::BACKUP, 100000, true, 1), 0u);
+
+    // half a second of the limit, split 4:1
+    scheduler.refill(GET, 1);
+    ASSERT_EQ(scheduler.acquire(GET, &user, BandwidthScheduler::USER, 100000, true, 1), 4000u);
+    ASSERT_EQ(scheduler.acquire(GET, &backup, BandwidthScheduler::BACKUP, 100000, true, 1), 1000u);
+    ASSERT_EQ(scheduler.acquire(GET, &user, BandwidthScheduler::USER, 100000, true, 1), 0u);
+
+    // a whole grant overdraws, and the debt is paid from later refills
+    scheduler.refill(GET, 2);
+    ASSERT_EQ(scheduler.acquire(GET, &user, BandwidthScheduler::USER, 2000, false, 2), 2000u);
+    ASSERT_EQ(scheduler.acquire(GET, &user, BandwidthScheduler::USER, 100, false, 2), 0u);
+
+    // once the backup request goes idle, the user one gets the whole refill
+    ASSERT_EQ(scheduler.acquire(GET, &user, BandwidthScheduler::USER, 100, true, 25), 0u);
+    scheduler.refill(GET, 30);
+    ASSERT_EQ(scheduler.acquire(GET, &user, BandwidthScheduler::USER, 100000, true, 30), 5000u - 1200u);
+    ASSERT_EQ(scheduler.acquire(GET, &backup, BandwidthScheduler::BACKUP, 100000, true, 30), 0u);
+}
+
+TEST(BandwidthScheduler, UnusedShareGoesToOthers)
+{
+    BandwidthScheduler scheduler;
+    scheduler.setlimit(PUT, 200000);
+
+    int streaming, sync;
+    scheduler.acquire(PUT, &streaming, BandwidthScheduler::STREAMING, 1, true, 1);
+    scheduler.acquire(PUT, &sync, BandwidthScheduler::SYNC, 1, true, 1);
+
+    // the streaming request doesn't use its share: beyond what it can hold, that goes to the sync one
+    for (dstime ds = 1; ds <= 16; ds += 5)
+    {
+        scheduler.acquire(PUT, &sync, BandwidthScheduler::SYNC, 1000000, true, ds);
+        scheduler.refill(PUT, ds);
+    }
+
+    // its own 2/10 of a refill, plus the spill
+    ASSERT_EQ(scheduler.acquire(PUT, &sync, BandwidthScheduler::SYNC, 1000000, true, 16), 20000u + 80000u);
+}
+
+namespace {
+
+// completes every request it's given on the next doio(), with a fixed response
+struct InstantHttpIO : HttpIO
+{
+    std::set<HttpReq*> inflight;
+    size_t posted = 0;
+
+    void addevents(Waiter*, int) override {}
+    void post(HttpReq* req, const char* = NULL, unsigned = 0) override
+    {
+        ++posted;
+        req->status = REQ_INFLIGHT;
+        inflight.insert(req);
+    }
+    void cancel(HttpReq* req) override { inflight.erase(req); }
+    m_off_t postpos(void*) override { return 0; }
+    bool doio(void) override
+    {
+        for (auto req : inflight)
+        {
+            req->in.assign(1000, 'x');
+            req->httpstatus = 200;
+            req->status = REQ_SUCCESS;
+            req->httpio = NULL;
+        }
+        bool any = !inflight.empty();
+        inflight.clear();
+        return any;
+    }
+    void setuseragent(string*) override {}
+};
+
+bool pollUntilDone(HttpIO& httpio, HttpReq& req, int maxMs)
+{
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(maxMs);
+    do
+    {
+        httpio.doio();
+        if (req.status != REQ_INFLIGHT)
+        {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    while (std::chrono::steady_clock::now() < until);
+
+    return false;
+}
+
+} // namespace
+
+TEST(EmulatedNetworkHttpIO, DelaysThrottlesAndDropsRequests)
+{
+    auto inner = new InstantHttpIO;
+    EmulatedNetworkHttpIO emulated{std::unique_ptr<HttpIO>(inner), 1};
+
+    EmulatedNetworkHttpIO::Conditions slow;
+    slow.latencyMs = 100;
+    emulated.setConditions(slow);
+
+    HttpReq req;
+    req.posturl = "https://g.api.mega.co.nz/cs";
+    req.httpio = &emulated;
+    emulated.post(&req);
+
+    // not sent until the latency is over
+    emulated.doio();
+    ASSERT_EQ(inner->posted, 0u);
+    ASSERT_EQ(req.status, REQ_INFLIGHT);
+    ASSERT_TRUE(pollUntilDone(emulated, req, 2000));
+    ASSERT_EQ(inner->posted, 1u);
+    ASSERT_EQ(req.status, REQ_SUCCESS);
+    ASSERT_EQ(req.httpio, nullptr);
+
+    // 1000 bytes at 10 KB/s: the finished response is held for about 100 ms
+    EmulatedNetworkHttpIO::Conditions capped;
+    capped.bytesPerSecond = 10000;
+    emulated.setUrlConditions("gfs", capped);
+
+    req.init();
+    req.posturl = "https://gfs270n001.userstorage.mega.co.nz/dl/x";
+    req.httpio = &emulated;
+    auto start = std::chrono::steady_clock::now();
+    emulated.post(&req);
+    emulated.doio();
+    ASSERT_EQ(inner->posted, 2u);
+    ASSERT_EQ(req.status, REQ_INFLIGHT);
+    ASSERT_EQ(req.httpio, &emulated);
+    ASSERT_TRUE(pollUntilDone(emulated, req, 2000));
+    ASSERT_EQ(req.status, REQ_SUCCESS);
+    ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(90));
+
+    // losses fail without reaching the inner HttpIO
+    EmulatedNetworkHttpIO::Conditions lossy;
+    lossy.lossPercent = 100;
+    emulated.clearUrlConditions();
+    emulated.setConditions(lossy);
+
+    req.init();
+    req.httpio = &emulated;
+    emulated.post(&req);
+    ASSERT_TRUE(pollUntilDone(emulated, req, 2000));
+    ASSERT_EQ(req.status, REQ_FAILURE);
+    ASSERT_EQ(req.httpstatus, 0);
+    ASSERT_EQ(inner->posted, 2u);
+    ASSERT_EQ(emulated.injectedFailures(), 1u);
+
+    // cancelling a request that hasn't been sent yet
+    emulated.setConditions(slow);
+    req.init();
+    req.httpio = &emulated;
+    emulated.post(&req);
+    req.disconnect();
+    emulated.doio();
+    ASSERT_EQ(inner->posted, 2u);
+}
+
+TEST(HttpReq, SegmentedReceiveHandsOverWholeBuffers)
+{
+    HttpReq req(true);
+    req.segmentsize = 64;
+    req.setcontentlength(150);
+
+    std::vector<byte> data(150);
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        data[i] = byte(i);
+    }
+
+    req.put(data.data(), 100);
+    ASSERT_EQ(1u, req.segments.size());
+    ASSERT_EQ(64u, req.segments[0]->datalen());
+    ASSERT_EQ(0, memcmp(req.segments[0]->datastart(), data.data(), 64));
+
+    // the caller takes part of the current segment, the next put fills it and starts another
+    req.inpurge = 16;
+    req.put(data.data() + 100, 50);
+    ASSERT_EQ(2u, req.segments.size());
+    ASSERT_EQ(48u, req.segments[1]->datalen());
+    ASSERT_EQ(0, memcmp(req.segments[1]->datastart(), data.data() + 80, 48));
+
+    // what is left in the current segment matches the remaining content length
+    ASSERT_EQ(22, req.bufpos);
+    ASSERT_EQ(req.contentlength, req.bufpos);
+
+    std::unique_ptr<HttpReq::http_buf_t> rest(req.releasesegment());
+    ASSERT_EQ(22u, rest->datalen());
+    ASSERT_EQ(0, memcmp(rest->datastart(), data.data() + 128, 22));
+}
@@ -22,6 +22,173 @@
 
 namespace mega {
 
+namespace {
+
+// builds the db representation of `count` finished chunks, each with a distinct mac
+std::string finishedChunksBlob(size_t count)
+{
+    // matches the layout of chunkmac_map::ChunkMAC: mac, offset, finished (+ padding)
+    struct Record
+    {
+        byte mac[SymmCipher::BLOCKSIZE];
+        unsigned int offset;
+        bool finished;
+    };
+
+    std::string d;
+    unsigned short ll = (unsigned short)count;
+    d.append((char*)&ll, sizeof(ll));
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        m_off_t pos = ChunkedHash::chunkpos(i);
+
+        Record r;
+        memset(&r, 0, sizeof(r));
+        memset(r.mac, int(i + 1), sizeof(r.mac));
+        r.finished = true;
+
+        d.append((char*)&pos, sizeof(pos));
+        d.append((char*)&r, sizeof(r));
+    }
+    return d;
+}
+
+} // anonymous
+
+TEST(ChunkedHash, chunkindexMatchesChunkBoundaries)
+{
+    m_off_t pos = 0;
+    for (size_t i = 0; i < 100; ++i)
+    {
+        ASSERT_EQ(pos, ChunkedHash::chunkpos(i));
+        ASSERT_EQ(i, ChunkedHash::chunkindex(pos));
+        ASSERT_EQ(i, ChunkedHash::chunkindex(ChunkedHash::chunkceil(pos) - 1));
+        pos = ChunkedHash::chunkceil(pos);
+    }
+}
+
+TEST(ChunkMacMap, serializeRoundTrip)
+{
+    std::string blob = finishedChunksBlob(20);
+
+    chunkmac_map macs;
+    const char* ptr = blob.data();
+    ASSERT_TRUE(macs.unserialize(ptr, blob.data() + blob.size()));
+    ASSERT_EQ(ptr, blob.data() + blob.size());
+    ASSERT_EQ(20u, macs.size());
+
+    std::string out;
+    macs.serialize(out);
+    ASSERT_EQ(blob.size(), out.size());
+
+    chunkmac_map copy;
+    ptr = out.data();
+    ASSERT_TRUE(copy.unserialize(ptr, out.data() + out.size()));
+    ASSERT_EQ(macs.size(), copy.size());
+
+    SymmCipher cipher;
+    byte key[SymmCipher::KEYLENGTH] = { 1, 2, 3 };
+    cipher.setkey(key);
+    ASSERT_EQ(macs.macsmac(&cipher), copy.macsmac(&cipher));
+}
+
+TEST(ChunkMacMap, progressAndGaps)
+{
+    std::string blob = finishedChunksBlob(10);
+
+    chunkmac_map macs;
+    const char* ptr = blob.data();
+    ASSERT_TRUE(macs.unserialize(ptr, blob.data() + blob.size()));
+
+    m_off_t fileSize = ChunkedHash::chunkpos(12);
+    m_off_t chunkpos = 0, completed = 0;
+    macs.calcprogress(fileSize, chunkpos, completed);
+    ASSERT_EQ(ChunkedHash::chunkpos(10), chunkpos);
+    ASSERT_EQ(ChunkedHash::chunkpos(10), completed);
+
+    ASSERT_TRUE(macs.finishedAt(ChunkedHash::chunkpos(9)));
+    ASSERT_FALSE(macs.finishedAt(ChunkedHash::chunkpos(10)));
+    ASSERT_EQ(ChunkedHash::chunkpos(10), macs.nextUnprocessedPosFrom(ChunkedHash::chunkpos(3)));
+    ASSERT_FALSE(macs.hasUnfinishedGap(fileSize));
+}
+
+TEST(ChunkMacMap, macsmacCollapsingKeepsResult)
+{
+    // enough finished chunks for the leading ones to be collapsed
+    const size_t count = 200;
+    std::string blob = finishedChunksBlob(count);
+
+    SymmCipher cipher;
+    byte key[SymmCipher::KEYLENGTH] = { 9, 8, 7 };
+    cipher.setkey(key);
+
+    chunkmac_map reference;
+    const char* ptr = blob.data();
+    ASSERT_TRUE(reference.unserialize(ptr, blob.data() + blob.size()));
+    int64_t expected = reference.macsmac(&cipher);
+
+    chunkmac_map macs;
+    ptr = blob.data();
+    ASSERT_TRUE(macs.unserialize(ptr, blob.data() + blob.size()));
+
+    m_off_t fileSize = ChunkedHash::chunkpos(count);
+    m_off_t chunkpos = 0, completed = 0;
+    macs.calcprogress(fileSize, chunkpos, completed);
+    macs.updateMacsmacProgress(&cipher);
+
+    ASSERT_LT(macs.size(), count);
+    ASSERT_EQ(expected, macs.macsmac(&cipher));
+
+    // the collapsed form also survives a trip through the db
+    std::string out;
+    macs.serialize(out);
+    chunkmac_map restored;
+    ptr = out.data();
+    ASSERT_TRUE(restored.unserialize(ptr, out.data() + out.size()));
+    ASSERT_EQ(macs.size(), restored.size());
+    ASSERT_EQ(expected, restored.macsmac(&cipher));
+    ASSERT_EQ(reference.macsmac_gaps(&cipher, 0, 0, 0, 0), restored.macsmac_gaps(&cipher, 0, 0, 0, 0));
+}
+
+TEST(ChunkMacMap, macsmacSegmentMatchesSynchronousCollapsing)
+{
+    const size_t count = 200;
+    std::string blob = finishedChunksBlob(count);
+    m_off_t fileSize = ChunkedHash::chunkpos(count);
+
+    SymmCipher cipher;
+    byte key[SymmCipher::KEYLENGTH] = { 4, 5, 6 };
+    cipher.setkey(key);
+
+    chunkmac_map sync, async;
+    for (chunkmac_map* m : { &sync, &async })
+    {
+        const char* ptr = blob.data();
+        ASSERT_TRUE(m->unserialize(ptr, blob.data() + blob.size()));
+        m_off_t chunkpos = 0, completed = 0;
+        m->calcprogress(fileSize, chunkpos, completed);
+    }
+    int64_t expected = sync.macsmac(&cipher);
+    sync.updateMacsmacProgress(&cipher);
+
+    auto segment = async.nextMacsmacSegment();
+    ASSERT_TRUE(segment);
+    ASSERT_FALSE(async.nextMacsmacSegment()) << "only one segment in flight at a time";
+    ASSERT_FALSE(async.applyMacsmacSegment()) << "not folded yet";
+    ASSERT_EQ(count, async.size());
+    ASSERT_EQ(expected, async.macsmac(&cipher));
+
+    segment->fold(cipher);
+    ASSERT_TRUE(async.applyMacsmacSegment());
+    ASSERT_EQ(sync.size(), async.size());
+    ASSERT_EQ(expected, async.macsmac(&cipher));
+
+    std::string syncBlob, asyncBlob;
+    sync.serialize(syncBlob);
+    async.serialize(asyncBlob);
+    ASSERT_EQ(syncBlob, asyncBlob);
+}
 
 }
 
@@ -24,8 +24,12 @@
 #include <mega/json.h>
 #include <mega/megaapp.h>
 #include <mega/megaclient.h>
+#include <mega/sharenodekeys.h>
+#include <mega/treeproc.h>
 #include <mega/types.h>
 
+#include "utils.h"
+
 using namespace std;
 using namespace mega;
 
@@ -254,3 +258,256 @@ TEST(Commands, CommandGetCountryCallingCodes_processResult_invalidResponse)
     ASSERT_EQ(ptrdiff_t(jsonLength), std::distance(jsonBegin, json.pos)); // assert json has been parsed all the way
 }*/
 
+
+namespace {
+
+class BatchedCommand : public Command
+{
+public:
+    BatchedCommand(size_t payload, bool isInteractive = false, bool isIndependent = false)
+    {
+        cmd("x");
+        arg("p", string(payload, 'a').c_str());
+        interactive = isInteractive;
+        independent = isIndependent;
+    }
+
+    bool procresult(Result) override
+    {
+        return true;
+    }
+};
+
+} // anonymous
+
+TEST(RequestDispatcher, BatchesLingerUntilFullOrInteractive)
+{
+    RequestDispatcher reqs;
+    RequestDispatcher::BatchPolicy policy;
+    policy.maxCommands = 2;
+    policy.lingerDs = 5;
+    reqs.setBatchPolicy(policy);
+
+    Waiter::ds = 100;
+    reqs.add(new BatchedCommand(10));
+    ASSERT_FALSE(reqs.readyToSend(100));
+    ASSERT_EQ(reqs.nextSendDs(), 105u);
+    ASSERT_TRUE(reqs.readyToSend(105));
+
+    // a third command closes the batch
+    reqs.add(new BatchedCommand(10));
+    reqs.add(new BatchedCommand(10));
+    ASSERT_TRUE(reqs.readyToSend(100));
+
+    string out;
+    bool suppressSID, includesFetchingNodes;
+    reqs.serverrequest(&out, suppressSID, includesFetchingNodes);
+    ASSERT_EQ(reqs.batchCommandsHistogram[1], 1u);
+    ASSERT_EQ(reqs.batchBytesHistogram[0], 1u);
+
+    // the remaining one lingers, unless someone waits for a command in its batch
+    ASSERT_FALSE(reqs.readyToSend(100));
+    reqs.add(new BatchedCommand(10, true));
+    ASSERT_TRUE(reqs.readyToSend(100));
+
+    reqs.clear();
+}
+
+TEST(RequestDispatcher, BatchesAreSplitBySize)
+{
+    RequestDispatcher reqs;
+    RequestDispatcher::BatchPolicy policy;
+    policy.maxBytes = 150;
+    policy.lingerDs = 5;
+    reqs.setBatchPolicy(policy);
+
+    Waiter::ds = 100;
+    reqs.add(new BatchedCommand(80));
+    ASSERT_FALSE(reqs.readyToSend(100));
+    reqs.add(new BatchedCommand(80));
+    ASSERT_TRUE(reqs.readyToSend(100));
+
+    string out;
+    bool suppressSID, includesFetchingNodes;
+    reqs.serverrequest(&out, suppressSID, includesFetchingNodes);
+    ASSERT_LT(out.size(), 150u);
+
+    reqs.clear();
+}
+
+TEST(RequestDispatcher, IndependentCommandsGoInParallelBatches)
+{
+    RequestDispatcher reqs;
+
+    // without parallel batches, everything keeps its order
+    reqs.add(new BatchedCommand(10, false, true));
+    ASSERT_TRUE(reqs.cmdspending());
+    reqs.clear();
+
+    reqs.setParallelBatches(2);
+    ASSERT_EQ(reqs.parallelBatches(), 2u);
+
+    reqs.add(new BatchedCommand(10));
+    reqs.add(new BatchedCommand(10, false, true));
+    reqs.add(new BatchedCommand(10, false, true));
+
+    string out;
+    bool suppressSID, includesFetchingNodes;
+    reqs.serverrequest(&out, suppressSID, includesFetchingNodes);
+    ASSERT_EQ(reqs.batchCommandsHistogram[0], 1u);
+    ASSERT_FALSE(reqs.cmdspending());
+
+    // spread over the parallel batches, which go while the ordered one is in flight
+    for (size_t i = 0; i < reqs.parallelBatches(); i++)
+    {
+        ASSERT_TRUE(reqs.parallel(i).readyToSend(Waiter::ds));
+        reqs.parallel(i).serverrequest(&out, suppressSID, includesFetchingNodes);
+        ASSERT_EQ(reqs.parallel(i).batchCommandsHistogram[0], 1u);
+    }
+
+    // batches no longer in use are kept, but get no new commands
+    reqs.setParallelBatches(0);
+    ASSERT_EQ(reqs.parallelBatches(), 2u);
+    reqs.add(new BatchedCommand(10, false, true));
+    ASSERT_TRUE(reqs.cmdspending());
+
+    reqs.clear();
+}
+
+TEST(Commands, ShareNodeKeysEncryptedInParallelMatchSerialOnes)
+{
+    MegaApp app;
+    auto client = mt::makeClient(app);
+
+    auto& share = mt::makeNode(*client, FOLDERNODE, NodeHandle().set6byte(1));
+    byte shareKey[SymmCipher::KEYLENGTH];
+    for (int i = 0; i < SymmCipher::KEYLENGTH; ++i)
+    {
+        shareKey[i] = byte(i * 13 + 5);
+    }
+    share.sharekey = new SymmCipher(shareKey);
+
+    // enough nodes for the parallel path
+    vector<Node*> nodes;
+    for (unsigned i = 0; i < MegaClient::MIN_PREDECRYPTED_NODES + 44; ++i)
+    {
+        auto& n = mt::makeNode(*client, (i % 3) ? FILENODE : FOLDERNODE, NodeHandle().set6byte(100 + i), &share);
+        byte key[FILENODEKEYLENGTH];
+        for (int j = 0; j < FILENODEKEYLENGTH; ++j)
+        {
+            key[j] = byte(i + j * 31);
+        }
+        n.setkey(key);
+        nodes.push_back(&n);
+    }
+
+    ShareNodeKeys serial;
+    for (Node* n : nodes)
+    {
+        serial.add(n, &share, 1);
+    }
+
+    ShareNodeKeys parallel;
+    TreeProcShareKeys::add(client.get(), parallel, &share, nodes.data(), nodes.size());
+
+    BatchedCommand a(0), b(0);
+    serial.get(&a);
+    parallel.get(&b);
+    ASSERT_FALSE(parallel.empty());
+    ASSERT_STREQ(a.getstring(), b.getstring());
+}
+
+namespace {
+
+// an upload completion for putnodesBatched(), with thumbnail and preview attributes on the NewNode
+void putnodesBatchedUpload(MegaClient& client, int tag, const string& fileAttributes, vector<pair<int, error>>& results)
+{
+    vector<NewNode> nn(1);
+    nn[0].source = NEW_UPLOAD;
+    nn[0].type = FILENODE;
+    nn[0].nodekey.assign(FILENODEKEYLENGTH, char(tag));
+    nn[0].attrstring.reset(new string("attributes"));
+    nn[0].fileattributes.reset(new string(fileAttributes));
+
+    client.putnodesBatched(NodeHandle().set6byte(1), NoVersioning, std::move(nn), tag, false,
+        [&results](const Error& e, targettype_t, vector<NewNode>&, bool, int resultTag)
+        {
+            results.emplace_back(resultTag, error(e));
+        });
+}
+
+size_t occurrences(const string& s, const string& what)
+{
+    size_t n = 0;
+    for (size_t pos = s.find(what); pos != string::npos; pos = s.find(what, pos + 1))
+    {
+        ++n;
+    }
+    return n;
+}
+
+} // anonymous
+
+TEST(Commands, FailedPutnodesBatchIsResentWithFileAttributes)
+{
+    MegaApp app;
+    auto client = mt::makeClient(app);
+    byte masterKey[SymmCipher::KEYLENGTH] = {};
+    client->key.setkey(masterKey);
+
+    vector<pair<int, error>> results;
+    putnodesBatchedUpload(*client, 1, "0*AAAAAAAAAAA/1*BBBBBBBBBBB", results);
+    putnodesBatchedUpload(*client, 2, "0*CCCCCCCCCCC/1*DDDDDDDDDDD", results);
+
+    Waiter::ds += MegaClient::PUTNODES_BATCH_WINDOW_DS;
+    client->flushPutnodesBatches();
+
+    string out;
+    bool suppressSID, includesFetchingNodes;
+    client->reqs.serverrequest(&out, suppressSID, includesFetchingNodes);
+    ASSERT_EQ(occurrences(out, "\"a\":\"p\""), 1u);
+    ASSERT_EQ(occurrences(out, "\"fa\":"), 2u);
+
+    // the batch fails as a whole: each upload goes again on its own, attributes included
+    client->reqs.servererror(std::to_string(API_EFAILED), client.get());
+    ASSERT_TRUE(results.empty());
+    ASSERT_TRUE(client->reqs.cmdspending());
+
+    out.clear();
+    client->reqs.serverrequest(&out, suppressSID, includesFetchingNodes);
+    ASSERT_EQ(occurrences(out, "\"a\":\"p\""), 2u);
+    ASSERT_EQ(occurrences(out, "\"fa\":\"0*AAAAAAAAAAA/1*BBBBBBBBBBB\""), 1u);
+    ASSERT_EQ(occurrences(out, "\"fa\":\"0*CCCCCCCCCCC/1*DDDDDDDDDDD\""), 1u);
+
+    // and gets the result of its own putnodes
+    client->reqs.servererror(std::to_string(API_EACCESS), client.get());
+    ASSERT_EQ(results.size(), 2u);
+    ASSERT_EQ(results[0], make_pair(1, API_EACCESS));
+    ASSERT_EQ(results[1], make_pair(2, API_EACCESS));
+}
+
+TEST(Commands, OverquotaPutnodesBatchIsNotResent)
+{
+    MegaApp app;
+    auto client = mt::makeClient(app);
+    byte masterKey[SymmCipher::KEYLENGTH] = {};
+    client->key.setkey(masterKey);
+
+    vector<pair<int, error>> results;
+    putnodesBatchedUpload(*client, 1, "0*AAAAAAAAAAA", results);
+    putnodesBatchedUpload(*client, 2, "0*CCCCCCCCCCC", results);
+
+    Waiter::ds += MegaClient::PUTNODES_BATCH_WINDOW_DS;
+    client->flushPutnodesBatches();
+
+    string out;
+    bool suppressSID, includesFetchingNodes;
+    client->reqs.serverrequest(&out, suppressSID, includesFetchingNodes);
+    client->reqs.servererror(std::to_string(API_EOVERQUOTA), client.get());
+
+    // none of them would fit on its own either
+    ASSERT_FALSE(client->reqs.cmdspending());
+    ASSERT_EQ(results.size(), 2u);
+    ASSERT_EQ(results[0], make_pair(1, API_EOVERQUOTA));
+    ASSERT_EQ(results[1], make_pair(2, API_EOVERQUOTA));
+}
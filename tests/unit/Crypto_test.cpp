@@ -355,3 +355,288 @@ TEST(Crypto, SymmCipher_xorblock_block_unaligned)
     
     ASSERT_EQ(memcmp(dest, result, sizeof(dest)), 0);
 }
+
+namespace {
+
+// block-at-a-time CTR + CBC-MAC, as ctr_crypt() used to do it
+void referenceCtrCrypt(SymmCipher& cipher, byte* data, unsigned len, m_off_t pos, SymmCipher::ctr_iv ctriv, byte* mac, bool encrypt)
+{
+    byte ctr[SymmCipher::BLOCKSIZE], tmp[SymmCipher::BLOCKSIZE];
+
+    MemAccess::set<int64_t>(ctr, ctriv);
+    SymmCipher::setint64(pos / SymmCipher::BLOCKSIZE, ctr + sizeof ctriv);
+    memcpy(mac, ctr, sizeof ctriv);
+    memcpy(mac + sizeof ctriv, ctr, sizeof ctriv);
+
+    while ((int)len > 0)
+    {
+        if (encrypt)
+        {
+            SymmCipher::xorblock(data, mac);
+            cipher.ecb_encrypt(mac);
+            cipher.ecb_encrypt(ctr, tmp);
+            SymmCipher::xorblock(tmp, data);
+        }
+        else
+        {
+            cipher.ecb_encrypt(ctr, tmp);
+            SymmCipher::xorblock(tmp, data);
+            SymmCipher::xorblock(data, mac, len >= (unsigned)SymmCipher::BLOCKSIZE ? SymmCipher::BLOCKSIZE : (int)len);
+            cipher.ecb_encrypt(mac);
+        }
+
+        len -= SymmCipher::BLOCKSIZE;
+        data += SymmCipher::BLOCKSIZE;
+        SymmCipher::incblock(ctr);
+    }
+}
+
+} // anonymous
+
+TEST(Crypto, SymmCipher_ctr_crypt_matches_block_by_block)
+{
+    PrnGen rng;
+    byte key[SymmCipher::KEYLENGTH];
+    rng.genblock(key, sizeof key);
+    SymmCipher cipher(key);
+
+    const SymmCipher::ctr_iv ctriv = 0x0123456789abcdefULL;
+    const m_off_t pos = 128 * 1024;
+
+    // lengths around and across the internal batch size, plus a partial trailing block
+    for (unsigned len : { 16u, 48u, 128u, 144u, 1024u, 16u * 19 + 5 })
+    {
+        std::string plain = rng.genstring(len + SymmCipher::BLOCKSIZE);
+
+        std::string bulk = plain, reference = plain;
+        byte bulkMac[SymmCipher::BLOCKSIZE], referenceMac[SymmCipher::BLOCKSIZE];
+
+        // encryption is only ever called on whole blocks
+        unsigned encLen = len & ~(unsigned)(SymmCipher::BLOCKSIZE - 1);
+        cipher.ctr_crypt((byte*)&bulk[0], encLen, pos, ctriv, bulkMac, true);
+        referenceCtrCrypt(cipher, (byte*)&reference[0], encLen, pos, ctriv, referenceMac, true);
+        ASSERT_EQ(bulk, reference) << "encrypt, len " << len;
+        ASSERT_EQ(0, memcmp(bulkMac, referenceMac, sizeof bulkMac)) << "encrypt mac, len " << len;
+
+        bulk = plain;
+        reference = plain;
+        cipher.ctr_crypt((byte*)&bulk[0], len, pos, ctriv, bulkMac, false);
+        referenceCtrCrypt(cipher, (byte*)&reference[0], len, pos, ctriv, referenceMac, false);
+        ASSERT_EQ(bulk.substr(0, len), reference.substr(0, len)) << "decrypt, len " << len;
+        ASSERT_EQ(0, memcmp(bulkMac, referenceMac, sizeof bulkMac)) << "decrypt mac, len " << len;
+    }
+}
+
+TEST(Crypto, SymmCipher_ctr_crypt_out_of_place_matches_in_place)
+{
+    PrnGen rng;
+    byte key[SymmCipher::KEYLENGTH];
+    rng.genblock(key, sizeof key);
+    SymmCipher cipher(key);
+
+    const SymmCipher::ctr_iv ctriv = 0x0123456789abcdefULL;
+    const m_off_t pos = 128 * 1024;
+
+    for (bool encrypt : { true, false })
+    {
+        for (unsigned len : { 5u, 16u, 144u, 1024u, 16u * 19 + 5 })
+        {
+            // in place needs NUL padding, out of place must not read past len
+            std::string plain = rng.genstring(len);
+            std::string inPlace = plain + std::string(SymmCipher::BLOCKSIZE, '\0');
+            std::vector<byte> src(plain.begin(), plain.end()), dst(len);
+            byte inPlaceMac[SymmCipher::BLOCKSIZE], outOfPlaceMac[SymmCipher::BLOCKSIZE];
+
+            cipher.ctr_crypt((byte*)&inPlace[0], len, pos, ctriv, inPlaceMac, encrypt);
+            cipher.ctr_crypt(src.data(), dst.data(), len, pos, ctriv, outOfPlaceMac, encrypt);
+
+            ASSERT_EQ(inPlace.substr(0, len), std::string(dst.begin(), dst.end())) << encrypt << ", len " << len;
+            ASSERT_EQ(0, memcmp(inPlaceMac, outOfPlaceMac, sizeof inPlaceMac)) << encrypt << " mac, len " << len;
+            ASSERT_EQ(plain, std::string(src.begin(), src.end()));
+        }
+    }
+}
+
+namespace {
+
+uint32_t referenceCRC32(const byte* data, size_t len)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; ++i)
+    {
+        crc ^= data[i];
+        for (int k = 0; k < 8; ++k)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+} // anonymous
+
+TEST(Crypto, HashCRC32_matches_bitwise_reference)
+{
+    HashCRC32 crc32;
+    uint32_t value;
+
+    crc32.add(reinterpret_cast<const byte*>("123456789"), 9);
+    crc32.get(reinterpret_cast<byte*>(&value));
+    ASSERT_EQ(value, 0xCBF43926u);
+
+    std::vector<byte> data(8192 + 64);
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        data[i] = byte(i * 131 + (i >> 7));
+    }
+
+    // every length around the fold boundaries, from unaligned starts, fed in one or two pieces
+    for (size_t offset = 0; offset < 3; ++offset)
+    {
+        for (size_t len = 0; len <= 300; ++len)
+        {
+            crc32.add(data.data() + offset, unsigned(len));
+            crc32.get(reinterpret_cast<byte*>(&value));
+            ASSERT_EQ(value, referenceCRC32(data.data() + offset, len)) << offset << " " << len;
+
+            crc32.add(data.data() + offset, unsigned(len / 3));
+            crc32.add(data.data() + offset + len / 3, unsigned(len - len / 3));
+            crc32.get(reinterpret_cast<byte*>(&value));
+            ASSERT_EQ(value, referenceCRC32(data.data() + offset, len)) << offset << " " << len;
+        }
+    }
+
+    crc32.add(data.data() + 1, 8192);
+    crc32.get(reinterpret_cast<byte*>(&value));
+    ASSERT_EQ(value, referenceCRC32(data.data() + 1, 8192));
+}
+
+TEST(Crypto, SymmCipher_rekeying_matches_fresh_cipher)
+{
+    byte k1[SymmCipher::KEYLENGTH], k2[SymmCipher::KEYLENGTH];
+    for (int i = 0; i < SymmCipher::KEYLENGTH; ++i)
+    {
+        k1[i] = byte(i);
+        k2[i] = byte(0xF0 ^ i);
+    }
+
+    byte plain[4 * SymmCipher::BLOCKSIZE];
+    for (size_t i = 0; i < sizeof plain; ++i)
+    {
+        plain[i] = byte(i * 7 + 3);
+    }
+
+    SymmCipher recycled;
+    for (int round = 0; round < 4; ++round)
+    {
+        const byte* k = (round & 1) ? k2 : k1;
+        SymmCipher fresh(k);
+
+        // rekey with the same key twice in a row too, which keeps the expanded schedules
+        recycled.setkey(k);
+        if (round == 2)
+        {
+            recycled.setkey(k);
+        }
+
+        byte a[sizeof plain], b[sizeof plain];
+        memcpy(a, plain, sizeof plain);
+        memcpy(b, plain, sizeof plain);
+        recycled.cbc_encrypt(a, sizeof a);
+        fresh.cbc_encrypt(b, sizeof b);
+        ASSERT_EQ(0, memcmp(a, b, sizeof a));
+
+        recycled.cbc_decrypt(a, sizeof a);
+        ASSERT_EQ(0, memcmp(a, plain, sizeof a));
+
+        memcpy(a, plain, sizeof plain);
+        memcpy(b, plain, sizeof plain);
+        recycled.ecb_encrypt(a, nullptr, sizeof a);
+        fresh.ecb_encrypt(b, nullptr, sizeof b);
+        ASSERT_EQ(0, memcmp(a, b, sizeof a));
+    }
+}
+
+TEST(Crypto, predecryptnode_decrypts_own_nodes_only)
+{
+    byte master[SymmCipher::KEYLENGTH], nodeKey[FILENODEKEYLENGTH];
+    for (int i = 0; i < SymmCipher::KEYLENGTH; ++i)
+    {
+        master[i] = byte(0x5A ^ i);
+    }
+    for (int i = 0; i < FILENODEKEYLENGTH; ++i)
+    {
+        nodeKey[i] = byte(i * 11 + 1);
+    }
+
+    SymmCipher masterKey(master);
+    SymmCipher nodeCipher;
+    nodeCipher.setkey(nodeKey, FILENODE);
+
+    string attrs;
+    MegaClient::makeattr(&nodeCipher, &attrs, "\"n\":\"photo.jpg\"");
+    string attrs64;
+    Base64::btoa(attrs, attrs64);
+
+    byte encryptedKey[FILENODEKEYLENGTH];
+    memcpy(encryptedKey, nodeKey, sizeof encryptedKey);
+    masterKey.ecb_encrypt(encryptedKey, nullptr, sizeof encryptedKey);
+    string key64 = Base64::btoa(string(reinterpret_cast<char*>(encryptedKey), sizeof encryptedKey));
+
+    handle me = 0x0102030405060708ull;
+    string me64 = Base64Str<MegaClient::USERHANDLE>(me).chars;
+
+    string json = "{\"h\":\"AAAAAAAA\",\"t\":0,\"a\":\"" + attrs64 + "\",\"s\":5,\"k\":\"" + me64 + ":" + key64 + "\"}";
+
+    MegaClient::PredecryptedNode node;
+    SymmCipher scratch;
+    MegaClient::predecryptnode(json.c_str(), me, masterKey, scratch, node);
+    ASSERT_TRUE(node.decrypted);
+    EXPECT_EQ(node.key, string(reinterpret_cast<char*>(nodeKey), sizeof nodeKey));
+    EXPECT_EQ(node.attrs.map['n'], "photo.jpg");
+
+    // keyed to someone else (or a share) first: left to Node::applykey()
+    string other = "{\"h\":\"AAAAAAAA\",\"t\":0,\"a\":\"" + attrs64 + "\",\"s\":5,\"k\":\"AAAAAAAA:" + key64 + "/" + me64 + ":" + key64 + "\"}";
+    MegaClient::PredecryptedNode skipped;
+    MegaClient::predecryptnode(other.c_str(), me, masterKey, scratch, skipped);
+    EXPECT_FALSE(skipped.decrypted);
+}
+
+TEST(Crypto, decryptnode_uses_the_share_key_it_is_given)
+{
+    byte share[SymmCipher::KEYLENGTH], nodeKey[FOLDERNODEKEYLENGTH];
+    for (int i = 0; i < SymmCipher::KEYLENGTH; ++i)
+    {
+        share[i] = byte(0xA5 ^ (i * 3));
+    }
+    for (int i = 0; i < FOLDERNODEKEYLENGTH; ++i)
+    {
+        nodeKey[i] = byte(i * 7 + 2);
+    }
+
+    SymmCipher shareKey(share);
+    SymmCipher nodeCipher;
+    nodeCipher.setkey(nodeKey, FOLDERNODE);
+
+    string attrs;
+    MegaClient::makeattr(&nodeCipher, &attrs, "\"n\":\"shared folder\"");
+    string attrs64;
+    Base64::btoa(attrs, attrs64);
+
+    byte encryptedKey[FOLDERNODEKEYLENGTH];
+    memcpy(encryptedKey, nodeKey, sizeof encryptedKey);
+    shareKey.ecb_encrypt(encryptedKey, nullptr, sizeof encryptedKey);
+    string key64 = Base64::btoa(string(reinterpret_cast<char*>(encryptedKey), sizeof encryptedKey));
+
+    MegaClient::PredecryptedNode node;
+    SymmCipher scratch;
+    ASSERT_TRUE(MegaClient::decryptnode(key64.c_str(), FOLDERNODE, attrs64, shareKey, scratch, node));
+    EXPECT_EQ(node.key, string(reinterpret_cast<char*>(nodeKey), sizeof nodeKey));
+    EXPECT_EQ(node.attrs.map['n'], "shared folder");
+
+    // with the wrong key the attributes don't decrypt, and nothing is installed
+    SymmCipher wrongKey(nodeKey);
+    MegaClient::PredecryptedNode failed;
+    EXPECT_FALSE(MegaClient::decryptnode(key64.c_str(), FOLDERNODE, attrs64, wrongKey, scratch, failed));
+    EXPECT_FALSE(failed.decrypted);
+}
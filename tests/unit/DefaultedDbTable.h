@@ -59,6 +59,14 @@ public:
     {
         return false;
     }
+    bool getNodesByFingerprints(const std::vector<std::string>&, std::vector<std::pair<mega::NodeHandle, mega::NodeSerialized>>&) override
+    {
+        return false;
+    }
+    bool getAllFingerprints(std::function<void(const std::string&)>) override
+    {
+        return false;
+    }
     bool getNodesByOrigFingerprint(const std::string&, std::vector<std::pair<mega::NodeHandle, mega::NodeSerialized>>&) override
     {
         return false;
@@ -81,11 +89,15 @@ public:
     {
         return false;
     }
+    bool getChildrenPage(mega::NodeHandle, mega::ChildrenOrder, uint64_t, uint64_t, std::vector<std::pair<mega::NodeHandle, mega::NodeSerialized>>&, mega::CancelToken) override
+    {
+        return false;
+    }
     uint64_t getNumberOfChildren(mega::NodeHandle parentHandle) override
     {
         return 0;
     }
-    bool searchForNodesByName(const std::string&, std::vector<std::pair<mega::NodeHandle, mega::NodeSerialized>>&, mega::CancelToken cancelFlag) override
+    bool searchForNodesByName(const std::string&, std::vector<std::pair<mega::NodeHandle, mega::NodeSerialized>>&, mega::NodeHandle, mega::CancelToken cancelFlag) override
     {
         return false;
         //throw NotImplemented(__func__);
@@ -114,6 +126,10 @@ public:
     {
         return false;
     }
+    bool getNodeCounter(mega::NodeHandle node, std::string& nodeCounterBlob) override
+    {
+        return false;
+    }
     bool isAncestor(mega::NodeHandle, mega::NodeHandle, mega::CancelToken) override
     {
         return false;
@@ -126,7 +142,7 @@ public:
     {
       return 0;
     }
-    bool getNodesByMimetype(mega::MimeType_t mimeType, std::vector<std::pair<mega::NodeHandle, mega::NodeSerialized>>& nodes, mega::CancelToken cancelFlag) override
+    bool getNodesByMimetype(mega::MimeType_t mimeType, std::vector<std::pair<mega::NodeHandle, mega::NodeSerialized>>& nodes, mega::NodeHandle ancestorHandle, mega::CancelToken cancelFlag) override
     {
         return false;
     }
@@ -141,6 +157,18 @@ public:
     void createIndexes() override
     {
 
+    }
+    bool compactNodes() const override
+    {
+        return true;
+    }
+    std::shared_ptr<mega::DBTableNodes> getReader() override
+    {
+        return nullptr;
+    }
+    uint64_t getNodesWrites() const override
+    {
+        return 0;
     }
     bool put(uint32_t, char*, unsigned) override
     {
@@ -152,6 +180,10 @@ public:
         return false;
         //throw NotImplemented{__func__};
     }
+    bool put(const std::vector<mega::Node*>&, const std::vector<std::string>&) override
+    {
+        return false;
+    }
     bool del(uint32_t) override
     {
         return false;
@@ -167,6 +199,18 @@ public:
         return false;
         //throw NotImplemented{__func__};
     }
+    bool removeSubtree(mega::NodeHandle) override
+    {
+        return false;
+    }
+    bool getVersions(mega::NodeHandle, std::vector<VersionsRecord>&) override
+    {
+        return false;
+    }
+    bool removeVersions(mega::NodeHandle) override
+    {
+        return false;
+    }
     void truncate() override
     {
         //throw NotImplemented{__func__};
@@ -187,6 +231,10 @@ public:
     {
         //throw NotImplemented{__func__};
     }
+    void optimize() override
+    {
+        //throw NotImplemented{__func__};
+    }
     bool inTransaction() const override
     {
         return false;
@@ -517,3 +517,42 @@ TEST(Logging, Extract_file_name_from_full_path)
     ASSERT_EQ(0, strcmp(::mega::log_file_leafname("include/mega/logging.h"), "logging.h"));
     ASSERT_EQ(0, strcmp(::mega::log_file_leafname("include\\mega\\logging.h"), "logging.h" ));
 }
+
+TEST(Logging, structuredRecord_formatsArguments)
+{
+    mega::LogRecord r(mega::logDebug, "file.cpp", 7, "a={} b={} c={} d={} e={} f={} missing={}");
+    mega::addLogRecordArgs(r, -3, 42u, 1.5, "text", std::string("str"), mega::logInfo);
+    ASSERT_EQ(6u, r.numArgs);
+    ASSERT_EQ("a=-3 b=42 c=1.5 d=text e=str f=3 missing={}", r.toString());
+
+    mega::LogRecord big(mega::logDebug, "file.cpp", 8, "{}");
+    big.add(std::string(500, 'x'));
+    ASSERT_EQ(std::string(mega::LogRecord::TEXT_CHARS, 'x'), big.toString());
+}
+
+TEST(Logging, structuredRecord_queuedUntilDrained)
+{
+    const auto previousLevel = mega::SimpleLogger::logCurrentLevel;
+    mega::SimpleLogger::setLogLevel(mega::logDebug);
+    mega::StructuredLog::setDrainerActive(true);
+
+    LOGF_debug("queued {} of {}", 1, 2);
+    LOGF_verbose("filtered by the runtime level {}", 3);
+
+    std::vector<std::string> lines;
+    auto drained = mega::StructuredLog::drain([&lines](const mega::LogRecord& r) {
+        EXPECT_EQ(mega::logDebug, r.level);
+        EXPECT_EQ(0, strcmp("Logging_test.cpp", r.file));
+        EXPECT_EQ(std::this_thread::get_id(), r.thread);
+        EXPECT_GT(r.timestampUs, 0);
+        lines.push_back(r.toString());
+    });
+
+    mega::StructuredLog::setDrainerActive(false);
+    mega::SimpleLogger::setLogLevel(previousLevel);
+
+    ASSERT_EQ(1u, drained);
+    ASSERT_EQ(1u, lines.size());
+    ASSERT_EQ("queued 1 of 2", lines[0]);
+    ASSERT_EQ(0u, mega::StructuredLog::drain([](const mega::LogRecord&) {}));
+}
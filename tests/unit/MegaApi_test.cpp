@@ -16,6 +16,7 @@
  * program.
  */
 
+#include <algorithm>
 #include <atomic>
 #include <memory>
 #include <thread>
@@ -218,3 +219,53 @@ TEST(MegaApi, getMimeType)
 
     ASSERT_EQ(600, successCount);
 }
+
+TEST(MegaApi, ListenerDispatcher_keepsOrderPerListener)
+{
+    int listeners[3];
+    vector<vector<int>> seen(3);
+
+    {
+        ::mega::ListenerDispatcher dispatcher(4);
+        for (int i = 0; i < 1000; ++i)
+        {
+            for (int l = 0; l < 3; ++l)
+            {
+                dispatcher.post(&listeners[l], [&seen, l, i]() { seen[size_t(l)].push_back(i); });
+            }
+        }
+    }
+
+    for (auto& s : seen)
+    {
+        ASSERT_EQ(1000u, s.size());
+        ASSERT_TRUE(std::is_sorted(s.begin(), s.end()));
+    }
+}
+
+TEST(MegaApi, ListenerDispatcher_coalescesUpdatesOfBusyListener)
+{
+    int listener;
+    vector<int> seen;
+    std::mutex m;
+    m.lock();
+
+    {
+        ::mega::ListenerDispatcher dispatcher(1);
+
+        // hold the listener up while its updates pile up
+        dispatcher.post(&listener, [&m]() { std::lock_guard<std::mutex> g(m); });
+        for (int i = 0; i < 1000; ++i)
+        {
+            dispatcher.postCoalesced(&listener, 7, [&seen, i]() { seen.push_back(i); });
+        }
+        dispatcher.post(&listener, [&seen]() { seen.push_back(-1); });
+
+        m.unlock();
+    }
+
+    ASSERT_LT(seen.size(), 1000u);
+    ASSERT_TRUE(std::is_sorted(seen.begin(), seen.end() - 1));
+    ASSERT_EQ(999, seen[seen.size() - 2]);
+    ASSERT_EQ(-1, seen.back());
+}
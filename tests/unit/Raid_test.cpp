@@ -0,0 +1,342 @@
+/**
+ * (c) 2026 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include <mega/raid.h>
+
+namespace {
+
+using namespace mega;
+
+// byte at a time, one sector at a time: the way sectors used to be recovered
+void referenceRecover(byte* dest, size_t destStride, byte* const inputbufs[], size_t offset, size_t count)
+{
+    for (size_t s = 0; s < count; ++s, dest += destStride)
+    {
+        memset(dest, 0, RAIDSECTOR);
+        for (unsigned i = RAIDPARTS; i--; )
+        {
+            if (inputbufs[i])
+            {
+                for (unsigned b = 0; b < RAIDSECTOR; ++b)
+                {
+                    dest[b] = static_cast<byte>(dest[b] ^ inputbufs[i][offset + s * RAIDSECTOR + b]);
+                }
+            }
+        }
+    }
+}
+
+struct RaidParts
+{
+    std::vector<std::vector<byte>> parts;
+    byte* inputbufs[RAIDPARTS];
+
+    RaidParts(size_t sectors, unsigned missing)
+    {
+        std::mt19937 rng(1234);
+        parts.resize(RAIDPARTS);
+        for (unsigned i = 0; i < RAIDPARTS; ++i)
+        {
+            // odd sized prefix so the kernels see unaligned input
+            parts[i].resize(sectors * RAIDSECTOR + 1);
+            for (auto& b : parts[i])
+            {
+                b = static_cast<byte>(rng());
+            }
+            inputbufs[i] = i == missing ? nullptr : parts[i].data() + 1;
+        }
+    }
+};
+
+class TestRaidBufferManager : public RaidBufferManager
+{
+    void finalize(FilePiece&) override {}
+
+    // hold data over at mac chunk boundaries, like a transfer does
+    m_off_t calcOutputChunkPos(m_off_t acquiredpos) override
+    {
+        return ChunkedHash::chunkfloor(acquiredpos);
+    }
+};
+
+// split a file into its six raid parts, and reassemble it via RaidBufferManager (with `missing` not downloaded)
+std::string reassembleRaidFile(const std::string& file, unsigned missing, size_t pieceLen)
+{
+    m_off_t filesize = m_off_t(file.size());
+
+    std::string parts[RAIDPARTS];
+    for (unsigned j = 0; j < RAIDPARTS; ++j)
+    {
+        parts[j].assign(size_t(RaidBufferManager::raidPartSize(j, filesize)), '\0');
+    }
+    for (size_t line = 0; line * RAIDLINE < file.size(); ++line)
+    {
+        for (unsigned j = 1; j < RAIDPARTS; ++j)
+        {
+            for (size_t b = 0; b < RAIDSECTOR; ++b)
+            {
+                size_t filepos = line * RAIDLINE + (j - 1) * RAIDSECTOR + b;
+                if (filepos < file.size())
+                {
+                    parts[j][line * RAIDSECTOR + b] = file[filepos];
+                    parts[0][line * RAIDSECTOR + b] = char(parts[0][line * RAIDSECTOR + b] ^ file[filepos]);
+                }
+            }
+        }
+    }
+
+    TestRaidBufferManager rbm;
+    rbm.setIsRaid(std::vector<std::string>(RAIDPARTS, "http://localhost/"), 0, filesize, filesize, 1024 * 1024);
+
+    for (unsigned j = 0; j < RAIDPARTS; ++j)
+    {
+        for (size_t pos = 0; pos < parts[j].size(); pos += pieceLen)
+        {
+            size_t len = std::min(pieceLen, parts[j].size() - pos);
+            byte* data = nullptr;
+            if (j != missing)
+            {
+                data = TransferBufferPool::allocate(len);
+                memcpy(data, parts[j].data() + pos, len);
+            }
+            rbm.submitBuffer(j, new RaidBufferManager::FilePiece(m_off_t(pos), new HttpReq::http_buf_t(data, 0, len)));
+        }
+    }
+
+    // some combines only feed the held-over piece and produce no output
+    std::string out;
+    for (size_t i = 0; i < 10 * file.size() / pieceLen && out.size() < file.size(); ++i)
+    {
+        if (auto piece = rbm.getAsyncOutputBufferPointer(0))
+        {
+            EXPECT_EQ(m_off_t(out.size()), piece->pos);
+            out.append(reinterpret_cast<const char*>(piece->buf.datastart()), piece->buf.datalen());
+            rbm.bufferWriteCompleted(0, true);
+        }
+    }
+    return out;
+}
+
+} // anonymous
+
+TEST(Raid, combineRaidPartsReassemblesFile)
+{
+    std::mt19937 rng(42);
+    std::string file(3 * 1024 * 1024 + 37, '\0');
+    for (auto& c : file)
+    {
+        c = static_cast<char>(rng());
+    }
+
+    // small pieces that don't reach a chunk boundary, and large ones that span several
+    for (size_t pieceLen : { size_t(1000 * RAIDSECTOR), size_t(40000 * RAIDSECTOR) })
+    {
+        for (unsigned missing = 0; missing < RAIDPARTS; ++missing)
+        {
+            std::string out = reassembleRaidFile(file, missing, pieceLen);
+            ASSERT_EQ(file.size(), out.size()) << "missing part " << missing;
+            ASSERT_TRUE(file == out) << "missing part " << missing << " differs at " << std::mismatch(file.begin(), file.end(), out.begin()).first - file.begin();
+        }
+    }
+}
+
+TEST(Raid, recoverSectorsFromParityMatchesReference)
+{
+    const size_t sectors = 1000;
+
+    for (unsigned missing = 0; missing < RAIDPARTS; ++missing)
+    {
+        RaidParts p(sectors, missing);
+
+        std::vector<byte> expected(sectors * RAIDLINE + 1), actual(sectors * RAIDLINE + 1);
+        referenceRecover(expected.data() + 1, RAIDLINE, p.inputbufs, 0, sectors);
+        RaidBufferManager::recoverSectorsFromParity(actual.data() + 1, RAIDLINE, p.inputbufs, 0, sectors);
+        ASSERT_EQ(expected, actual) << "missing part " << missing;
+
+        // contiguous output, starting part way through the inputs
+        std::vector<byte> expected2(10 * RAIDSECTOR), actual2(10 * RAIDSECTOR);
+        referenceRecover(expected2.data(), RAIDSECTOR, p.inputbufs, 7 * RAIDSECTOR, 10);
+        RaidBufferManager::recoverSectorsFromParity(actual2.data(), RAIDSECTOR, p.inputbufs, 7 * RAIDSECTOR, 10);
+        ASSERT_EQ(expected2, actual2) << "missing part " << missing;
+    }
+}
+
+TEST(Raid, TransferBufferPoolReusesReleasedBuffers)
+{
+    TransferBufferPool::trim();
+    size_t oldMax = TransferBufferPool::maxCachedBytes();
+    TransferBufferPool::stats(true);
+
+    ASSERT_EQ(TransferBufferPool::capacityFor(1), size_t(4096));
+    ASSERT_EQ(TransferBufferPool::capacityFor(5000), size_t(5120));
+    ASSERT_EQ(TransferBufferPool::capacityFor(1024 * 1024), size_t(1024 * 1024));
+    ASSERT_GE(TransferBufferPool::capacityFor(1024 * 1024 + 1), size_t(1024 * 1024 + 1));
+    ASSERT_LE(TransferBufferPool::capacityFor(1024 * 1024 + 1), size_t(1024 * 1024 * 5 / 4));
+    ASSERT_EQ(TransferBufferPool::allocate(0), nullptr);
+
+    byte* a = TransferBufferPool::allocate(100000);
+    ASSERT_NE(a, nullptr);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(a) % 16, uintptr_t(0));
+    memset(a, 0xAA, 100000);
+    TransferBufferPool::release(a);
+
+    // a request in the same size class gets the cached block back
+    byte* b = TransferBufferPool::allocate(99000);
+    ASSERT_EQ(a, b);
+
+    TransferBufferPool::Stats s = TransferBufferPool::stats();
+    ASSERT_EQ(s.allocations, 2u);
+    ASSERT_EQ(s.poolHits, 1u);
+    ASSERT_EQ(s.cachedBuffers, 0u);
+    ASSERT_EQ(s.outstandingBytes, TransferBufferPool::capacityFor(100000));
+
+    // with no room in the cache, released buffers go straight back to the heap
+    TransferBufferPool::setMaxCachedBytes(0);
+    TransferBufferPool::release(b);
+    s = TransferBufferPool::stats();
+    ASSERT_EQ(s.discards, 1u);
+    ASSERT_EQ(s.cachedBytes, 0u);
+    ASSERT_EQ(s.outstandingBytes, 0u);
+
+    TransferBufferPool::setMaxCachedBytes(oldMax);
+    {
+        HttpReq::http_buf_t hb(TransferBufferPool::allocate(5000), 0, 5000);
+    }
+    s = TransferBufferPool::stats();
+    ASSERT_EQ(s.cachedBuffers, 1u);
+    ASSERT_EQ(s.cachedBytes, size_t(5120));
+
+    TransferBufferPool::trim();
+    ASSERT_EQ(TransferBufferPool::stats().cachedBytes, 0u);
+}
+
+TEST(Raid, RequestSizeControllerFollowsThroughputAndFailures)
+{
+    RequestSizeController rsc;
+    rsc.setConnections(2);
+
+    // nothing measured yet: the static heuristics apply
+    ASSERT_EQ(rsc.nextRequestSize(0, RequestSizeController::MAX_REQ_SIZE), 0);
+
+    // a completion that was never started is ignored
+    rsc.requestCompleted(0, 4 * 1024 * 1024, 10, 1);
+    ASSERT_EQ(rsc.nextRequestSize(0, RequestSizeController::MAX_REQ_SIZE), 0);
+
+    // 4MB in 1s with 1ds to first byte: aim for 2s of data
+    rsc.requestStarted(0);
+    rsc.requestCompleted(0, 4 * 1024 * 1024, 10, 1);
+    ASSERT_EQ(rsc.nextRequestSize(0, RequestSizeController::MAX_REQ_SIZE), 8 * 1024 * 1024);
+    ASSERT_FALSE(rsc.lastDecision(0).empty());
+
+    // a high-latency link aims for more round trips per request, but grows at most 2x per request
+    rsc.requestStarted(0);
+    rsc.requestCompleted(0, 40 * 1024 * 1024, 10, 10);
+    m_off_t grown = rsc.nextRequestSize(0, RequestSizeController::MAX_REQ_SIZE);
+    ASSERT_EQ(grown, 16 * 1024 * 1024);
+    ASSERT_EQ(rsc.nextRequestSize(0, 5 * 1024 * 1024), 5 * 1024 * 1024);
+
+    // failures shrink the requests
+    m_off_t before = rsc.nextRequestSize(0, RequestSizeController::MAX_REQ_SIZE);
+    rsc.requestFailed(0);
+    rsc.requestFailed(0);
+    m_off_t after = rsc.nextRequestSize(0, RequestSizeController::MAX_REQ_SIZE);
+    ASSERT_LT(after, before);
+    ASSERT_GE(after, RequestSizeController::MIN_REQ_SIZE);
+
+    // channels are independent
+    ASSERT_EQ(rsc.nextRequestSize(1, RequestSizeController::MAX_REQ_SIZE), 0);
+}
+
+TEST(Raid, ConnectionCountControllerKeepsOnlyProbesThatPay)
+{
+    ConnectionCountController ccc;
+    dstime now = 1000;
+
+    // nothing measured yet
+    ASSERT_EQ(ccc.evaluate(2, 0, 6, now), 2u);
+
+    // probe up, and keep it when throughput rises enough
+    ASSERT_EQ(ccc.evaluate(2, 1000000, 6, now), 3u);
+    ASSERT_EQ(ccc.evaluate(3, 1500000, 6, now + 1), 3u);   // still settling
+    now += ConnectionCountController::SETTLE_DS;
+    ASSERT_EQ(ccc.evaluate(3, 1500000, 6, now), 3u);
+    now += ConnectionCountController::SETTLE_DS;
+    ASSERT_EQ(ccc.evaluate(3, 1500000, 6, now), 4u);
+
+    // the next connection adds almost nothing: revert and hold
+    now += ConnectionCountController::SETTLE_DS;
+    ASSERT_EQ(ccc.evaluate(4, 1550000, 6, now), 3u);
+    now += ConnectionCountController::SETTLE_DS;
+    ASSERT_EQ(ccc.evaluate(3, 1500000, 6, now), 3u);
+
+    // after the hold it probes downwards, and keeps one fewer if nothing is lost
+    now += ConnectionCountController::HOLD_DS;
+    ASSERT_EQ(ccc.evaluate(3, 1500000, 6, now), 2u);
+    now += ConnectionCountController::SETTLE_DS;
+    ASSERT_EQ(ccc.evaluate(2, 1490000, 6, now), 2u);
+
+    // a budget below the current count applies at once
+    ASSERT_EQ(ccc.evaluate(2, 1490000, 1, now + 1), 1u);
+}
+
+TEST(Raid, RaidHedgeControllerSwapsPartsStalledBeyondTheUsualRequestTime)
+{
+    RaidHedgeController rhc;
+    rhc.setConnections(RAIDPARTS);
+
+    // no threshold until enough requests completed
+    ASSERT_EQ(rhc.stallThresholdDs(), 0u);
+    ASSERT_FALSE(rhc.shouldHedge(1000));
+
+    for (unsigned i = 0; i < RaidHedgeController::MIN_SAMPLES; ++i)
+    {
+        rhc.requestStarted(i % RAIDPARTS);
+        rhc.requestCompleted(i % RAIDPARTS, 40 + i);
+
+        // a finished request revisited doesn't count twice
+        rhc.requestCompleted(i % RAIDPARTS, 1000);
+    }
+
+    dstime threshold = rhc.stallThresholdDs();
+    ASSERT_GE(threshold, 40 + dstime(RaidHedgeController::MIN_SAMPLES) * 9 / 10);
+    ASSERT_LT(threshold, 40 + dstime(RaidHedgeController::MIN_SAMPLES));
+
+    ASSERT_FALSE(rhc.shouldHedge(threshold));
+    for (unsigned i = 0; i < RaidHedgeController::MAX_HEDGES; ++i)
+    {
+        ASSERT_TRUE(rhc.shouldHedge(threshold + 1));
+    }
+    ASSERT_FALSE(rhc.shouldHedge(threshold + 1));
+
+    rhc.progressed();
+    ASSERT_TRUE(rhc.shouldHedge(threshold + 1));
+
+    // fast requests still leave a minimum grace period
+    RaidHedgeController fast;
+    fast.setConnections(RAIDPARTS);
+    for (unsigned i = 0; i < RaidHedgeController::MIN_SAMPLES; ++i)
+    {
+        fast.requestStarted(0);
+        fast.requestCompleted(0, 1);
+    }
+    ASSERT_EQ(fast.stallThresholdDs(), RaidHedgeController::MIN_STALL_DS);
+}
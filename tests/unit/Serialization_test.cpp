@@ -206,6 +206,55 @@ TEST(Serialization, CacheableReaderWriter_fsfp_t)
     ASSERT_EQ(42u, fsfp);
 }
 
+TEST(Serialization, CacheableReaderWriter_fields)
+{
+    std::string expected;
+    {
+        mega::CacheableWriter writer{expected};
+        writer.serializei64(-2);
+        writer.serializehandle(0x0102030405060708);
+        writer.serializeu32(7);
+        writer.serializenodehandle(0x0000112233445566);
+        writer.serializestring("name");
+        writer.serializebool(true);
+    }
+
+    std::string data;
+    {
+        mega::CacheableWriter writer{data};
+        writer.serializefields(int64_t(-2), mega::handle(0x0102030405060708), uint32_t(7),
+                               mega::CacheableWriter::NodeHandle{0x0000112233445566}, std::string("name"), true);
+    }
+    ASSERT_EQ(expected, data);
+
+    int64_t i = 0;
+    mega::handle h = 0, nh = 0;
+    uint32_t u = 0;
+    std::string name;
+    bool b = false;
+
+    mega::CacheableReader reader{data};
+    ASSERT_TRUE(reader.unserializefields(i, h, u, mega::CacheableReader::NodeHandle{nh}, name, b));
+    ASSERT_EQ(6u, reader.fieldnum);
+    ASSERT_EQ(reader.ptr, data.c_str() + data.size());
+    ASSERT_EQ(-2, i);
+    ASSERT_EQ(0x0102030405060708u, h);
+    ASSERT_EQ(7u, u);
+    ASSERT_EQ(0x0000112233445566u, nh);
+    ASSERT_EQ("name", name);
+    ASSERT_TRUE(b);
+
+    // a string running into the fields after it is rejected, as is a short fixed part
+    std::string truncated = data.substr(0, data.size() - 1);
+    mega::CacheableReader shortReader{truncated};
+    ASSERT_FALSE(shortReader.unserializefields(i, h, u, mega::CacheableReader::NodeHandle{nh}, name, b));
+
+    std::string fixedOnly = data.substr(0, 8);
+    mega::CacheableReader fixedReader{fixedOnly};
+    ASSERT_FALSE(fixedReader.unserializefields(i, h));
+    ASSERT_EQ(fixedReader.ptr, fixedOnly.c_str());
+}
+
 namespace {
 
 //struct MockFileSystemAccess : mt::DefaultedFileSystemAccess
@@ -583,3 +632,141 @@ TEST(Serialization, Node_forFolder_withoutShares_32bit)
     auto dn = client.cli->mNodeManager.getNodeFromBlob(&data);
     checkDeserializedNode(*dn, *n, true);
 }
+
+TEST(Serialization, Node_compact_forFile_withAuthKey)
+{
+    MockClient client;
+    auto& parent = mt::makeNode(*client.cli, mega::FOLDERNODE, ::mega::NodeHandle().set6byte(43));
+    std::unique_ptr<mega::Node> n{&mt::makeNode(*client.cli, mega::FILENODE, ::mega::NodeHandle().set6byte(42), &parent)};
+    n->size = 12;
+    n->owner = 88;
+    n->ctime = 44;
+    n->attrs.map = std::map<mega::nameid, std::string>{
+        {101, "foo"},
+        {102, "bar"},
+    };
+    n->fileattrstring = "blah";
+    n->plink = new mega::PublicLink{n->nodehandle, 1, 2, false, "someAuthKey"};
+
+    std::string legacy, data;
+    ASSERT_TRUE(n->serialize(&legacy));
+    ASSERT_TRUE(n->serializeCompact(&data));
+    ASSERT_TRUE(mega::Node::isCompactBlob(data));
+    ASSERT_FALSE(mega::Node::isCompactBlob(legacy));
+    ASSERT_LT(data.size(), legacy.size());
+
+    auto dn = client.cli->mNodeManager.getNodeFromBlob(&data);
+    ASSERT_TRUE(dn);
+    checkDeserializedNode(*dn, *n);
+    ASSERT_EQ(n->plink->mAuthKey, dn->plink->mAuthKey);
+}
+
+TEST(Serialization, Node_compact_forFolder_withoutParent_withoutAttrs)
+{
+    MockClient client;
+    std::unique_ptr<mega::Node> n{&mt::makeNode(*client.cli, mega::FOLDERNODE, ::mega::NodeHandle().set6byte(42))};
+    n->size = -1;
+    n->owner = 43;
+
+    std::string data;
+    ASSERT_TRUE(n->serializeCompact(&data));
+
+    const char* field;
+    size_t length;
+    ASSERT_FALSE(mega::Node::blobField(data, mega::Node::BLOB_PARENT, field, length));
+    ASSERT_FALSE(mega::Node::blobField(data, mega::Node::BLOB_CTIME, field, length));
+
+    auto dn = client.cli->mNodeManager.getNodeFromBlob(&data);
+    ASSERT_TRUE(dn);
+    checkDeserializedNode(*dn, *n);
+}
+
+TEST(Serialization, Node_compact_whenFileIsEncrypted)
+{
+    MockClient client;
+    auto& n = mt::makeNode(*client.cli, mega::FILENODE, ::mega::NodeHandle().set6byte(42));
+
+    n.attrstring.reset(new std::string("attrstring"));
+    n.setUndecryptedKey("nodekeydata");
+    n.size = 16;
+
+    std::string data;
+    ASSERT_TRUE(n.serializeCompact(&data));
+
+    auto dn = client.cli->mNodeManager.getNodeFromBlob(&data);
+    ASSERT_TRUE(dn);
+
+    checkDeserializedNode(*dn, n);
+}
+
+TEST(Serialization, Node_compact_readsSingleFields)
+{
+    MockClient client;
+    auto& parent = mt::makeNode(*client.cli, mega::FOLDERNODE, ::mega::NodeHandle().set6byte(43));
+    std::unique_ptr<mega::Node> n{&mt::makeNode(*client.cli, mega::FILENODE, ::mega::NodeHandle().set6byte(42), &parent)};
+    n->size = 123456789;
+    n->owner = 88;
+    n->ctime = 44;
+    n->attrs.map = std::map<mega::nameid, std::string>{
+        {'n', "name.txt"},
+        {102, "bar"},
+    };
+
+    std::string data;
+    ASSERT_TRUE(n->serializeCompact(&data));
+
+    std::string name;
+    mega::m_off_t size;
+    ASSERT_TRUE(mega::Node::blobNameAndSize(data, name, size));
+    ASSERT_EQ("name.txt", name);
+    ASSERT_EQ(123456789, size);
+
+    uint64_t ctime;
+    ASSERT_TRUE(mega::Node::blobNumber(data, mega::Node::BLOB_CTIME, ctime));
+    ASSERT_EQ(44u, ctime);
+
+    const char* field;
+    size_t length;
+    ASSERT_TRUE(mega::Node::blobField(data, mega::Node::BLOB_PARENT, field, length));
+    ASSERT_EQ(size_t(mega::MegaClient::NODEHANDLE), length);
+    mega::handle ph = 0;
+    memcpy(&ph, field, length);
+    ASSERT_EQ(parent.nodehandle, ph);
+
+    // legacy blobs have no field directory
+    std::string legacy;
+    ASSERT_TRUE(n->serialize(&legacy));
+    ASSERT_FALSE(mega::Node::blobNameAndSize(legacy, name, size));
+}
+
+TEST(Serialization, UserAlert_NewSharedNodes_keepsTheCountOfNodesNotListed)
+{
+    using namespace mega;
+
+    // as merging an alert of many nodes leaves it
+    UserAlert::NewSharedNodes alert(88, 42, 1000, 1, {}, {});
+    std::vector<handle> files(UserAlert::MAX_LISTED_NODES + 5);
+    std::iota(files.begin(), files.end(), handle(1));
+    UserAlert::appendListed(alert.fileNodeHandles, alert.fileNodesNotListed, files);
+    UserAlert::appendListed(alert.folderNodeHandles, alert.folderNodesNotListed, {7, 8});
+    ASSERT_EQ(alert.fileNodeHandles.size(), UserAlert::MAX_LISTED_NODES);
+    ASSERT_EQ(alert.fileCount(), files.size());
+
+    std::string data;
+    ASSERT_TRUE(alert.serialize(&data));
+
+    // the type is read by UserAlerts::unserializeAlert()
+    nameid type = 0;
+    CacheableReader r(data);
+    ASSERT_TRUE(r.unserializecompressedu64(type));
+    ASSERT_EQ(type, UserAlert::type_put);
+    r.eraseused(data);
+
+    std::unique_ptr<UserAlert::NewSharedNodes> read(UserAlert::NewSharedNodes::unserialize(&data, 2));
+    ASSERT_TRUE(read);
+    EXPECT_EQ(read->parentHandle, handle(42));
+    EXPECT_EQ(read->fileNodeHandles, alert.fileNodeHandles);
+    EXPECT_EQ(read->fileCount(), files.size());
+    EXPECT_EQ(read->folderNodeHandles, std::vector<handle>({7, 8}));
+    EXPECT_EQ(read->folderCount(), 2u);
+}
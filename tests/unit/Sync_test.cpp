@@ -655,6 +655,8 @@ TEST_F(SyncConfigIOContextTest, Serialize)
         config.mEnabled = true;
         config.mError = UNKNOWN_ERROR;
         config.mFilesystemFingerprint = 2;
+        config.mChangeJournalId = 3;
+        config.mChangeJournalPosition = 4;
         config.mLocalPath = Utilities::randomPathAbsolute();
         config.mName = Utilities::randomBase64();
         config.mOriginalPathOfRemoteRootNode = Utilities::randomBase64();
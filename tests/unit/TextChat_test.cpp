@@ -124,4 +124,26 @@ TEST(TextChat, unserialize_32bit)
     auto newTc = mega::TextChat::unserialize(client.get(), &d);
     checkTextChats(tc, *newTc);
 }
+
+TEST(TextChat, samePeers_ignoresTheOrderOfThePeers)
+{
+    mega::TextChat tc;
+    ASSERT_TRUE(tc.samePeers(nullptr));
+
+    tc.userpriv = new mega::userpriv_vector;
+    tc.userpriv->emplace_back(3, mega::PRIV_MODERATOR);
+    tc.userpriv->emplace_back(4, mega::PRIV_RO);
+
+    mega::userpriv_vector peers;
+    peers.emplace_back(4, mega::PRIV_RO);
+    peers.emplace_back(3, mega::PRIV_MODERATOR);
+    ASSERT_TRUE(tc.samePeers(&peers));
+
+    peers[0].second = mega::PRIV_STANDARD;
+    ASSERT_FALSE(tc.samePeers(&peers));
+
+    peers.pop_back();
+    ASSERT_FALSE(tc.samePeers(&peers));
+    ASSERT_FALSE(tc.samePeers(nullptr));
+}
 #endif
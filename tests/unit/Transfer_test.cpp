@@ -87,3 +87,83 @@ TEST(Transfer, serialize_unserialize)
 }
 
 
+
+TEST(DirectReadCache, ServesContiguousRangesAndEvictsOldest)
+{
+    mega::DirectReadCache cache(8);
+
+    const mega::byte a[] = "abcd";
+    const mega::byte b[] = "efgh";
+    cache.add(0, a, 4);
+    cache.add(4, b, 4);
+    ASSERT_EQ(8u, cache.size());
+
+    std::string out;
+    ASSERT_EQ(6u, cache.read(1, 6, out));
+    ASSERT_EQ("bcdefg", out);
+
+    // overlapping data is not stored twice
+    cache.add(2, b, 4);
+    ASSERT_EQ(8u, cache.size());
+
+    // exceeding the limit drops the oldest range first
+    const mega::byte c[] = "ij";
+    cache.add(8, c, 2);
+    out.clear();
+    ASSERT_EQ(0u, cache.read(0, 4, out));
+    out.clear();
+    ASSERT_EQ(6u, cache.read(4, 10, out));
+    ASSERT_EQ("efghij", out);
+}
+
+TEST(TransferTimeline, RecordsStagesAndConnections)
+{
+    mega::TransferTimeline timeline;
+    timeline.mark(mega::TransferTimeline::QUEUED, 1000);
+    timeline.restart();
+    ASSERT_EQ(1000, timeline.stages[mega::TransferTimeline::QUEUED]);
+    ASSERT_NE(0, timeline.stages[mega::TransferTimeline::STARTED]);
+    ASSERT_EQ(1u, timeline.attempts);
+
+    // the earliest time of a stage is kept
+    timeline.mark(mega::TransferTimeline::URL_REQUESTED, 3000);
+    timeline.mark(mega::TransferTimeline::URL_REQUESTED, 2000);
+    timeline.mark(mega::TransferTimeline::URL_REQUESTED, 4000);
+    ASSERT_EQ(2000, timeline.stages[mega::TransferTimeline::URL_REQUESTED]);
+
+    timeline.connections.resize(2);
+    timeline.connections[1].requestStart = 5000;
+
+    mega::HttpReqDL req;
+    req.size = 100;
+    req.timings.newConnection = true;
+    req.timings.dns = 10;
+    req.timings.connect = 20;
+    req.timings.tls = 30;
+    req.timings.firstByte = 100;
+    timeline.requestCompleted(1, req, 42);
+
+    // the HttpIO's figures place the stages from when the request was sent
+    ASSERT_EQ(5060, timeline.stages[mega::TransferTimeline::CONNECTED]);
+    ASSERT_EQ(5100, timeline.stages[mega::TransferTimeline::FIRST_BYTE]);
+    ASSERT_EQ(1u, timeline.connections[1].requests);
+    ASSERT_EQ(100u, timeline.connections[1].bytes);
+    ASSERT_EQ(1u, timeline.connections[1].newConnections);
+    ASSERT_EQ(42, timeline.connections[1].lastSpeed);
+
+    // a completed request seen again isn't counted twice
+    timeline.requestCompleted(1, req, 42);
+    ASSERT_EQ(1u, timeline.connections[1].requests);
+
+    const std::string json = timeline.toJson(7);
+    ASSERT_NE(std::string::npos, json.find("\"urlRequested\":2000"));
+    ASSERT_NE(std::string::npos, json.find("\"traceEvents\":["));
+    ASSERT_NE(std::string::npos, json.find("\"tid\":7"));
+
+    // a new attempt keeps when the transfer was queued
+    timeline.restart();
+    ASSERT_EQ(1000, timeline.stages[mega::TransferTimeline::QUEUED]);
+    ASSERT_EQ(0, timeline.stages[mega::TransferTimeline::URL_REQUESTED]);
+    ASSERT_TRUE(timeline.connections.empty());
+    ASSERT_EQ(2u, timeline.attempts);
+}
@@ -17,6 +17,8 @@
  */
 
 #include <array>
+#include <chrono>
+#include <thread>
 #include <tuple>
 
 #include <gtest/gtest.h>
@@ -25,10 +27,14 @@
 #include <mega/filesystem.h>
 #include <mega/utils.h>
 #include "megafs.h"
+#include "megawaiter.h"
+#include "utils.h"
 
 #include <mega/db.h>
 #include <mega/db/sqlite.h>
 #include <mega/json.h>
+#include <mega/logging.h>
+#include <mega/megaclient.h>
 
 TEST(utils, hashCombine_integer)
 {
@@ -478,6 +484,66 @@ TEST(URLCodec, UnescapeShortEscape)
     EXPECT_EQ(output, "a%a");
 }
 
+TEST(Base64, BulkConversionsMatchTheByteByByteOnes)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+    // lengths around the vector block sizes, so both the kernels and the tails run
+    for (size_t len = 0; len < 300; len += (len < 100) ? 1 : 37)
+    {
+        string binary;
+        for (size_t i = 0; i < len; i++)
+        {
+            binary.push_back(char(i * 151 + len));
+        }
+
+        string expected;
+        for (size_t i = 0; i < len; i += 3)
+        {
+            unsigned bits = unsigned(byte(binary[i])) << 16;
+            bits |= (i + 1 < len) ? unsigned(byte(binary[i + 1])) << 8 : 0;
+            bits |= (i + 2 < len) ? unsigned(byte(binary[i + 2])) : 0;
+
+            for (unsigned j = 0; j < 4; j++)
+            {
+                expected.push_back(alphabet[(bits >> (18 - 6 * j)) & 63]);
+            }
+        }
+        expected.resize(Base64::encodedLength(len));
+        ASSERT_EQ(Base64::btoa(binary), expected) << len;
+
+        string buffer(Base64::encodedLength(len), '*');
+        ASSERT_EQ(Base64::encode((const byte*)binary.data(), len, &buffer[0]), expected.size());
+        ASSERT_EQ(buffer, expected);
+
+        ASSERT_EQ(Base64::atob(expected), binary) << len;
+
+        // the standard alphabet's extra characters are accepted too
+        string standard = expected;
+        for (auto& c : standard)
+        {
+            c = (c == '-') ? '+' : (c == '_') ? '/' : c;
+        }
+        ASSERT_EQ(Base64::atob(standard), binary) << len;
+
+        // decoding stops at the first invalid character, wherever it is, and at the output size
+        for (size_t bad = 0; bad < expected.size(); bad += 7)
+        {
+            string broken = expected;
+            broken[bad] = (bad & 1) ? '=' : char(0xC3);
+
+            byte scalar[512], vector[512];
+            int n = Base64::atob(broken.c_str(), scalar, int(sizeof scalar));
+            ASSERT_EQ(Base64::decode(broken.data(), broken.size(), vector, sizeof vector), size_t(n));
+            ASSERT_EQ(memcmp(scalar, vector, size_t(n)), 0);
+
+            n = Base64::atob(expected.c_str(), scalar, int(bad));
+            ASSERT_EQ(Base64::decode(expected.data(), expected.size(), vector, bad), size_t(n));
+            ASSERT_EQ(memcmp(scalar, vector, size_t(n)), 0);
+        }
+    }
+}
+
 
 TEST(Filesystem, isContainingPathOf)
 {
@@ -661,6 +727,45 @@ TEST_F(SqliteDBTest, OpenCurrent)
     EXPECT_EQ(dbAccess.currentDbVersion, DbAccess::DB_VERSION);
 }
 
+TEST_F(SqliteDBTest, LegacyKeepsLegacyNodes)
+{
+    // A DB created by a version that can't read compact nodes.
+    {
+        SqliteDbAccess dbAccess(rootPath);
+
+        auto dbFile =
+          dbAccess.databasePath(fsAccess,
+                                name,
+                                DbAccess::LEGACY_DB_VERSION);
+
+        auto fileAccess = fsAccess.newfileaccess(false);
+        EXPECT_TRUE(fileAccess->fopen(dbFile, false, true));
+    }
+
+    {
+        SqliteDbAccess dbAccess(rootPath);
+        DbTablePtr dbTable(dbAccess.openTableWithNodes(rng, fsAccess, name));
+        ASSERT_TRUE(!!dbTable);
+
+        // It's still in use, so its nodes keep their format.
+        EXPECT_EQ(dbAccess.currentDbVersion, DbAccess::LEGACY_DB_VERSION);
+        auto nodeTable = dynamic_cast<DBTableNodes*>(dbTable.get());
+        ASSERT_TRUE(nodeTable);
+        EXPECT_FALSE(nodeTable->compactNodes());
+
+        dbTable->remove();
+    }
+
+    // New databases store compact nodes.
+    SqliteDbAccess dbAccess(rootPath);
+    DbTablePtr dbTable(dbAccess.openTableWithNodes(rng, fsAccess, name));
+    ASSERT_TRUE(!!dbTable);
+
+    auto nodeTable = dynamic_cast<DBTableNodes*>(dbTable.get());
+    ASSERT_TRUE(nodeTable);
+    EXPECT_TRUE(nodeTable->compactNodes());
+}
+
 TEST_F(SqliteDBTest, ProbeCurrent)
 {
     SqliteDbAccess dbAccess(rootPath);
@@ -710,6 +815,197 @@ TEST_F(SqliteDBTest, RootPath)
     EXPECT_EQ(dbAccess.rootPath(), rootPath);
 }
 
+TEST_F(SqliteDBTest, AlertsArePagedNewestFirst)
+{
+    SqliteDbAccess dbAccess(rootPath);
+    DbTablePtr dbTable(dbAccess.openTableWithNodes(rng, fsAccess, name));
+    ASSERT_TRUE(!!dbTable);
+
+    // ids don't follow the timestamps, as alerts may come out of order
+    for (uint32_t i = 1; i <= 5; ++i)
+    {
+        ASSERT_TRUE(dbTable->putalert(DbTable::AlertRecord{(6 - i) * DbTable::IDSPACING, int64_t(i * 100), i == 1, std::to_string(i)}));
+    }
+    EXPECT_EQ(dbTable->countalerts(false), 5);
+    EXPECT_EQ(dbTable->countalerts(true), 4);
+    EXPECT_EQ(dbTable->maxid(), 5u * DbTable::IDSPACING);
+
+    std::vector<DbTable::AlertRecord> page;
+    ASSERT_TRUE(dbTable->getalerts(1, 2, page));
+    ASSERT_EQ(page.size(), 2u);
+    EXPECT_EQ(page[0].content, "4");
+    EXPECT_EQ(page[0].ts, 400);
+    EXPECT_EQ(page[1].content, "3");
+
+    ASSERT_TRUE(dbTable->seealerts());
+    EXPECT_EQ(dbTable->countalerts(true), 0);
+
+    // only the newest 3 are kept
+    ASSERT_TRUE(dbTable->trimalerts(3));
+    ASSERT_TRUE(dbTable->delalert(1 * DbTable::IDSPACING)); // the newest
+    page.clear();
+    ASSERT_TRUE(dbTable->getalerts(0, 10, page));
+    ASSERT_EQ(page.size(), 2u);
+    EXPECT_EQ(page[0].content, "4");
+    EXPECT_TRUE(page[0].seen);
+    EXPECT_EQ(page[1].content, "3");
+
+    dbTable->truncate();
+    EXPECT_EQ(dbTable->countalerts(false), 0);
+}
+
+TEST_F(SqliteDBTest, RemoveSubtreeKeepsItsRootAndSiblings)
+{
+    SqliteDbAccess dbAccess(rootPath);
+    DbTablePtr dbTable(dbAccess.openTableWithNodes(rng, fsAccess, name));
+    ASSERT_TRUE(!!dbTable);
+
+    auto nodeTable = dynamic_cast<DBTableNodes*>(dbTable.get());
+    ASSERT_TRUE(nodeTable);
+
+    MegaApp app;
+    auto client = mt::makeClient(app);
+    auto& top = mt::makeNode(*client, FOLDERNODE, NodeHandle().set6byte(1));
+    auto& root = mt::makeNode(*client, FOLDERNODE, NodeHandle().set6byte(2), &top);
+    auto& folder = mt::makeNode(*client, FOLDERNODE, NodeHandle().set6byte(3), &root);
+    auto& file = mt::makeNode(*client, FILENODE, NodeHandle().set6byte(4), &folder);
+    auto& sibling = mt::makeNode(*client, FOLDERNODE, NodeHandle().set6byte(5), &top);
+
+    for (Node* n : {&top, &root, &folder, &file, &sibling})
+    {
+        ASSERT_TRUE(nodeTable->put(n));
+    }
+
+    ASSERT_TRUE(nodeTable->removeSubtree(root.nodeHandle()));
+
+    NodeSerialized node;
+    EXPECT_TRUE(nodeTable->getNode(root.nodeHandle(), node));
+    EXPECT_TRUE(nodeTable->getNode(sibling.nodeHandle(), node));
+    EXPECT_FALSE(nodeTable->getNode(folder.nodeHandle(), node));
+    EXPECT_FALSE(nodeTable->getNode(file.nodeHandle(), node));
+    EXPECT_EQ(nodeTable->getNumberOfNodes(), 3u);
+
+    // nothing is stored below a node that isn't stored
+    EXPECT_TRUE(nodeTable->removeSubtree(folder.nodeHandle()));
+    EXPECT_EQ(nodeTable->getNumberOfNodes(), 3u);
+}
+
+TEST_F(SqliteDBTest, VersionsAreFoundAndRemovedAtOnce)
+{
+    SqliteDbAccess dbAccess(rootPath);
+    DbTablePtr dbTable(dbAccess.openTableWithNodes(rng, fsAccess, name));
+    ASSERT_TRUE(!!dbTable);
+
+    auto nodeTable = dynamic_cast<DBTableNodes*>(dbTable.get());
+    ASSERT_TRUE(nodeTable);
+
+    MegaApp app;
+    auto client = mt::makeClient(app);
+    auto& top = mt::makeNode(*client, FOLDERNODE, NodeHandle().set6byte(1));
+    auto& file = mt::makeNode(*client, FILENODE, NodeHandle().set6byte(2), &top);
+    auto& newest = mt::makeNode(*client, FILENODE, NodeHandle().set6byte(3), &file);
+    auto& oldest = mt::makeNode(*client, FILENODE, NodeHandle().set6byte(4), &newest);
+    auto& other = mt::makeNode(*client, FILENODE, NodeHandle().set6byte(5), &top);
+
+    // versions are told apart by their parent
+    newest.parent = &file;
+    oldest.parent = &newest;
+
+    for (Node* n : {&top, &file, &newest, &oldest, &other})
+    {
+        ASSERT_TRUE(nodeTable->put(n));
+    }
+
+    std::vector<DBTableNodes::VersionsRecord> versions;
+    ASSERT_TRUE(nodeTable->getVersions(top.nodeHandle(), versions));
+    ASSERT_EQ(versions.size(), 1u);
+    EXPECT_EQ(versions[0].file, file.nodeHandle());
+    EXPECT_EQ(versions[0].newestVersion, newest.nodeHandle());
+
+    ASSERT_TRUE(nodeTable->removeVersions(top.nodeHandle()));
+
+    NodeSerialized node;
+    EXPECT_TRUE(nodeTable->getNode(file.nodeHandle(), node));
+    EXPECT_TRUE(nodeTable->getNode(other.nodeHandle(), node));
+    EXPECT_FALSE(nodeTable->getNode(newest.nodeHandle(), node));
+    EXPECT_FALSE(nodeTable->getNode(oldest.nodeHandle(), node));
+
+    newest.parent = nullptr;
+    oldest.parent = nullptr;
+}
+
+TEST_F(SqliteDBTest, NameSearchFoldsUtf8Case)
+{
+    SqliteDbAccess dbAccess(rootPath);
+    DbTablePtr dbTable(dbAccess.openTableWithNodes(rng, fsAccess, name));
+    ASSERT_TRUE(!!dbTable);
+
+    auto nodeTable = dynamic_cast<DBTableNodes*>(dbTable.get());
+    ASSERT_TRUE(nodeTable);
+
+    // without FTS5's trigram tokenizer there's no index of names, and only ASCII is folded
+    bool nameIndex = false;
+    sqlite3* db = nullptr;
+    auto dbFile = dbAccess.databasePath(fsAccess, name, DbAccess::DB_VERSION);
+    if (sqlite3_open_v2(dbFile.toPath(false).c_str(), &db, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK)
+    {
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'nodesname'", -1, &stmt, nullptr) == SQLITE_OK)
+        {
+            nameIndex = sqlite3_step(stmt) == SQLITE_ROW;
+        }
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(db);
+
+    if (!nameIndex)
+    {
+        LOG_warn << "No index of node names in this SQLite build, UTF-8 case folding not tested";
+        return;
+    }
+
+    MegaApp app;
+    auto client = mt::makeClient(app);
+    auto& top = mt::makeNode(*client, FOLDERNODE, NodeHandle().set6byte(1));
+    auto& upper = mt::makeNode(*client, FILENODE, NodeHandle().set6byte(2), &top);
+    auto& lower = mt::makeNode(*client, FILENODE, NodeHandle().set6byte(3), &top);
+    auto& other = mt::makeNode(*client, FILENODE, NodeHandle().set6byte(4), &top);
+    top.attrs.map['n'] = "top";
+    upper.attrs.map['n'] = "\xC3\x91" "am.txt";    // Ñam.txt
+    lower.attrs.map['n'] = "\xC3\xB1" "am.jpg";    // ñam.jpg
+    other.attrs.map['n'] = "nam.txt";
+
+    for (Node* n : {&top, &upper, &lower, &other})
+    {
+        ASSERT_TRUE(nodeTable->put(n));
+    }
+
+    for (const char* search : { "\xC3\xB1" "am", "\xC3\x91" "AM", "\xC3\x91" "am" })
+    {
+        std::vector<std::pair<NodeHandle, NodeSerialized>> found;
+        ASSERT_TRUE(nodeTable->searchForNodesByName(search, found, NodeHandle(), CancelToken()));
+
+        std::set<NodeHandle> handles;
+        for (auto& f : found)
+        {
+            handles.insert(f.first);
+        }
+        EXPECT_EQ(handles, (std::set<NodeHandle>{upper.nodeHandle(), lower.nodeHandle()})) << search;
+
+        found.clear();
+        ASSERT_TRUE(nodeTable->searchForNodesByNameNoRecursive(search, found, top.nodeHandle(), CancelToken()));
+        EXPECT_EQ(found.size(), 2u) << search;
+    }
+
+    // the index follows renames
+    upper.attrs.map['n'] = "Other.txt";
+    ASSERT_TRUE(nodeTable->put(&upper));
+    std::vector<std::pair<NodeHandle, NodeSerialized>> found;
+    ASSERT_TRUE(nodeTable->searchForNodesByName("\xC3\x91" "AM", found, NodeHandle(), CancelToken()));
+    ASSERT_EQ(found.size(), 1u);
+    EXPECT_EQ(found[0].first, lower.nodeHandle());
+}
+
 #ifdef WIN32
 #define SEP "\\"
 #else // WIN32
@@ -775,6 +1071,31 @@ TEST(LocalPath, PrependWithSeparator)
     EXPECT_EQ(target.toPath(false), "b" SEP "a");
 }
 
+TEST(LocalPath, AssignComponents)
+{
+    LocalPath a = LocalPath::fromRelativePath("a");
+    LocalPath b = LocalPath::fromRelativePath("b" SEP);
+    LocalPath c = LocalPath::fromRelativePath(SEP "c");
+    LocalPath d = LocalPath::fromRelativePath("d");
+
+    // Joins components the same way as prepending them from the leaf up.
+    LocalPath expected;
+    expected.prependWithSeparator(d);
+    expected.prependWithSeparator(c);
+    expected.prependWithSeparator(b);
+    expected.prependWithSeparator(a);
+
+    LocalPath target = LocalPath::fromRelativePath("x");
+    target.assignComponents({&a, &b, &c, &d});
+
+    EXPECT_EQ(target.toPath(false), "a" SEP "b" SEP "c" SEP "d");
+    EXPECT_EQ(target, expected);
+
+    // No components leaves an empty path.
+    target.assignComponents({});
+    EXPECT_TRUE(target.empty());
+}
+
 #undef SEP
 
 TEST(JSONWriter, arg_stringWithEscapes)
@@ -800,6 +1121,39 @@ TEST(JSONWriter, escape)
     EXPECT_EQ(writer.escape(input.c_str(), input.size()), expected);
 }
 
+TEST(JSONWriter, base64IsWrittenInPlace)
+{
+    for (int len = 0; len < 8; len++)
+    {
+        string data(static_cast<size_t>(len), '\xA5');
+        JSONWriter writer;
+        writer.arg_B64("k", data);
+        writer.beginarray("e");
+        writer.element_B64(data);
+        writer.endarray();
+
+        string b64 = Base64::btoa(data);
+        EXPECT_EQ(writer.getstring(), "\"k\":\"" + b64 + "\",\"e\":[\"" + b64 + "\"]");
+    }
+}
+
+TEST(JSONWriter, buffersAreRecycled)
+{
+    JSONWriter first;
+    first.reserve(4096);
+    first.arg("a", "b");
+    const char* buffer = first.getstring().data();
+    first.recycle();
+    EXPECT_EQ(first.size(), 0u);
+
+    JSONWriter second;
+    second.reusebuffer();
+    EXPECT_EQ(second.getstring().data(), buffer);
+    EXPECT_EQ(second.size(), 0u);
+    second.arg("c", "d");
+    EXPECT_EQ(second.getstring(), "\"c\":\"d\"");
+}
+
 TEST(JSON, stripWhitespace)
 {
     auto input = string(" a\rb\n c\r{\"a\":\"q\\r \\\" s\"\n} x y\n z\n");
@@ -815,6 +1169,99 @@ TEST(JSON, stripWhitespace)
     ASSERT_EQ(computed, expected);
 }
 
+TEST(JSON, equalstringComparesInPlace)
+{
+    JSON j("{\"at\":\"abc\",\"n\":\"longer than SSO\"}");
+    ASSERT_TRUE(j.enterobject());
+    ASSERT_EQ(j.getnameid(), MAKENAMEID2('a', 't'));
+    const char* a = j.getvalue();
+    EXPECT_TRUE(JSON::equalstring("abc", a));
+    EXPECT_FALSE(JSON::equalstring("ab", a));
+    EXPECT_FALSE(JSON::equalstring("abcd", a));
+    EXPECT_FALSE(JSON::equalstring("abc", nullptr));
+    EXPECT_TRUE(JSON::equalstring("tail", "tail"));
+
+    EXPECT_EQ(j.getnameWithoutAdvance(), "n");
+    EXPECT_EQ(j.getname(), "n");
+    EXPECT_TRUE(JSON::equalstring("longer than SSO", j.getvalue()));
+}
+
+TEST(JSONArrayScanner, DelimitsElementsAsTheyArrive)
+{
+    const string response = "[{\"f\":[{\"h\":\"a]}\\\"\",\"k\":{}},{\"h\":\"b\"}],\"ok\":[]}]";
+    JSONArrayScanner scanner("[{\"f\":[");
+    string input;
+    size_t begin = 0, end = 0;
+    vector<string> elements;
+
+    for (char c : response)
+    {
+        input.push_back(c);
+
+        auto status = scanner.next(input.data(), input.size(), begin, end);
+        ASSERT_NE(status, JSONArrayScanner::MISMATCH);
+
+        if (status == JSONArrayScanner::ELEMENTS)
+        {
+            elements.emplace_back(input, begin, end - begin);
+            input.erase(0, end);
+            scanner.consumed(end);
+        }
+    }
+
+    ASSERT_EQ(elements.size(), 2u);
+    EXPECT_EQ(elements[0], "{\"h\":\"a]}\\\"\",\"k\":{}}");
+    EXPECT_EQ(elements[1], "{\"h\":\"b\"}");
+
+    ASSERT_EQ(scanner.next(input.data(), input.size(), begin, end), JSONArrayScanner::ENDED);
+    EXPECT_EQ(input.substr(begin), "],\"ok\":[]}]");
+
+    JSONArrayScanner other("[{\"f\":[");
+    EXPECT_EQ(other.next("-3", 2, begin, end), JSONArrayScanner::MISMATCH);
+}
+
+TEST(Utils, isAscii)
+{
+    string s(100, 'a');
+    ASSERT_TRUE(Utils::isAscii(s.data(), 0));
+    ASSERT_TRUE(Utils::isAscii(s.data(), s.size()));
+
+    // a high bit in the word-at-a-time part and in the tail
+    for (size_t i : { size_t(0), size_t(31), size_t(40), size_t(99) })
+    {
+        string t = s;
+        t[i] = '\xc3';
+        ASSERT_FALSE(Utils::isAscii(t.data(), t.size())) << i;
+    }
+}
+
+TEST_F(ComparatorTest, AsciiComparisonsAreConsistent)
+{
+    // ASCII against ASCII takes the fast path, the rest walk code points: the orders must agree
+    const string names[] = { "", "a", "A", "ab", "aB", "abc", "b", "a0", "a%30", "_x", "\xc3\xa9", "a\xc3\xa9" };
+
+    for (auto& a : names)
+    {
+        for (auto& b : names)
+        {
+            for (bool ci : { false, true })
+            {
+                int r = compareUtf(a, true, b, true, ci);
+                int rl = compareUtf(fromRelPath(a), true, b, true, ci);
+                ASSERT_EQ(r < 0, rl < 0) << a << " " << b;
+                ASSERT_EQ(r == 0, rl == 0) << a << " " << b;
+                ASSERT_EQ(r == 0, compareUtf(b, true, a, true, ci) == 0) << a << " " << b;
+            }
+        }
+    }
+
+    EXPECT_EQ(ciCompare(string("abc"), string("ABC")), 0);
+    EXPECT_LT(compare(string("ABC"), string("abc")), 0);
+    EXPECT_LT(compare(string("ab"), string("abc")), 0);
+    EXPECT_GT(ciCompare(string("abd"), string("ABC")), 0);
+    EXPECT_EQ(compare(string("a%30"), string("a0")), 0);
+}
+
 TEST(Utils, replace_char)
 {
     ASSERT_EQ(Utils::replace(string(""), '*', '@'), "");
@@ -1028,3 +1475,494 @@ TEST_F(TooLongNameTest, Rename)
         ASSERT_FALSE(mFsAccess.target_name_too_long);
     }
 }
+
+TEST(MegaClientAsyncQueue, BatchQueuesWhenScopeEnds)
+{
+    WAIT_CLASS waiter;
+    MegaClientAsyncQueue queue(waiter, 2);
+    ASSERT_EQ(2u, queue.threadCount());
+
+    std::atomic<int> count{0};
+    {
+        MegaClientAsyncQueue::Batch batch(queue);
+        for (int i = 0; i < 10; ++i)
+        {
+            queue.push([&count](SymmCipher&) { ++count; }, false);
+        }
+
+        // nothing reaches the workers until the batch ends
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        ASSERT_EQ(0, count.load());
+        ASSERT_EQ(0u, queue.queueDepth());
+    }
+
+    for (int i = 0; i < 500 && count.load() < 10; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(10, count.load());
+    ASSERT_LE(queue.peakQueueDepth(true), 10u);
+}
+
+TEST(MegaClientAsyncQueue, SharedWorkersServeEveryQueue)
+{
+    MegaClientAsyncQueue::setSharedWorkers(true);
+    WAIT_CLASS waiter;
+    std::atomic<int> count{0};
+    {
+        MegaClientAsyncQueue first(waiter, 2);
+        MegaClientAsyncQueue second(waiter, 2);
+        MegaClientAsyncQueue::setSharedWorkers(false);
+        ASSERT_TRUE(first.sharedWorkers());
+        ASSERT_TRUE(second.sharedWorkers());
+        ASSERT_EQ(first.threadCount(), SharedAsyncWorkers::instance().threadCount());
+
+        for (int i = 0; i < 10; ++i)
+        {
+            first.push([&count](SymmCipher&) { ++count; }, false);
+            second.push([&count](SymmCipher&) { ++count; }, false);
+        }
+
+        for (int i = 0; i < 500 && count.load() < 20; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        ASSERT_EQ(20, count.load());
+
+        // the destructors wait for what's still queued
+        for (int i = 0; i < 10; ++i)
+        {
+            second.push([&count](SymmCipher&) { ++count; }, false);
+        }
+    }
+    ASSERT_EQ(30, count.load());
+
+    MegaClientAsyncQueue queue(waiter, 2);
+    ASSERT_FALSE(queue.sharedWorkers());
+}
+
+TEST(MegaClientAsyncQueue, ZeroThreadsRunsInline)
+{
+    WAIT_CLASS waiter;
+    MegaClientAsyncQueue queue(waiter, 0);
+
+    int count = 0;
+    MegaClientAsyncQueue::Batch batch(queue);
+    queue.push([&count](SymmCipher&) { ++count; }, false);
+    ASSERT_EQ(1, count);
+}
+
+TEST(Waiter, NotificationsCoalesceUntilTheNextWait)
+{
+    WAIT_CLASS waiter;
+    for (int i = 0; i < 100; ++i)
+    {
+        waiter.notifyBy(Waiter::NOTIFY_ASYNCQUEUE);
+    }
+    waiter.notifyBy(Waiter::NOTIFY_GFX);
+
+    waiter.init(NEVER);
+    ASSERT_EQ(Waiter::NEEDEXEC, waiter.wait() & Waiter::NEEDEXEC);
+
+    Waiter::NotifyStats stats = waiter.notifyStats(true);
+    ASSERT_EQ(100u, stats.bySource[Waiter::NOTIFY_ASYNCQUEUE]);
+    ASSERT_EQ(1u, stats.bySource[Waiter::NOTIFY_GFX]);
+    ASSERT_EQ(0u, stats.bySource[Waiter::NOTIFY_SCAN]);
+#ifndef _WIN32
+    ASSERT_EQ(1u, stats.signalled);
+
+    // the next wait cycle gets its own wakeup
+    waiter.notify();
+    waiter.init(NEVER);
+    ASSERT_EQ(Waiter::NEEDEXEC, waiter.wait() & Waiter::NEEDEXEC);
+    ASSERT_EQ(1u, waiter.notifyStats(false).signalled);
+#endif
+}
+
+TEST(KeyDerivationService, DerivesOnWorkersAndNotifies)
+{
+    KeyDerivationService service(2);
+
+    std::string expected(32, '\0');
+    PBKDF2_HMAC_SHA512 pbkdf2;
+    pbkdf2.deriveKey((byte*)expected.data(), expected.size(), (const byte*)"password", 8, (const byte*)"salt", 4, 1000);
+
+    WAIT_CLASS waiter;
+    std::vector<KeyDerivationService::RequestPtr> requests;
+    for (int i = 0; i < 8; ++i)
+    {
+        requests.push_back(service.derive("password", "salt", 1000, 32, &waiter));
+    }
+
+    for (auto& r : requests)
+    {
+        for (int i = 0; i < 500 && !r->done; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        ASSERT_TRUE(r->done);
+        ASSERT_EQ(expected, r->derivedKey);
+        ASSERT_TRUE(r->password.empty());
+    }
+    ASSERT_EQ(0u, service.queueDepth());
+}
+
+TEST(KeyDerivationService, CancelledRequestIsNotCompleted)
+{
+    KeyDerivationService service(1);
+
+    // keep the single worker busy so the second request is still queued when cancelled
+    auto busy = service.derive("password", "salt", 200000, 64, nullptr);
+    auto cancelled = service.derive("password", "salt", 1, 64, nullptr);
+    service.cancel(cancelled);
+
+    for (int i = 0; i < 3000 && !busy->done; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(busy->done);
+    ASSERT_FALSE(cancelled->done);
+    ASSERT_TRUE(cancelled->derivedKey.empty());
+    ASSERT_TRUE(cancelled->password.empty());
+}
+
+TEST(Filesystem, fwritevWritesBuffersBackToBack)
+{
+    FSACCESS_CLASS fsAccess;
+
+    LocalPath path;
+    ASSERT_TRUE(fsAccess.cwd(path));
+    path.appendWithSeparator(LocalPath::fromRelativePath("fwritev_test.bin"), false);
+
+    string a(100000, 'a'), b(3, 'b'), c(70000, 'c');
+    const ::mega::byte* bufs[] = { (const ::mega::byte*)a.data(), (const ::mega::byte*)b.data(), (const ::mega::byte*)c.data() };
+    const unsigned lens[] = { unsigned(a.size()), unsigned(b.size()), unsigned(c.size()) };
+
+    {
+        auto fileAccess = fsAccess.newfileaccess(false);
+        ASSERT_TRUE(fileAccess->fopen(path, false, true));
+        ASSERT_TRUE(fileAccess->fwrite((const ::mega::byte*)"x", 1, 0));
+        ASSERT_TRUE(fileAccess->fwritev(bufs, lens, 3, 1));
+    }
+
+    string expected = "x" + a + b + c;
+    string content(expected.size(), '\0');
+    {
+        auto fileAccess = fsAccess.newfileaccess(false);
+        ASSERT_TRUE(fileAccess->fopen(path, true, false));
+        ASSERT_EQ(fileAccess->size, m_off_t(expected.size()));
+        ASSERT_TRUE(fileAccess->frawread((::mega::byte*)&content[0], unsigned(content.size()), 0, true));
+    }
+    EXPECT_EQ(content, expected);
+
+    fsAccess.unlinklocal(path);
+}
+
+TEST(LocalFingerprintIndex, FindsLatestPathAndEvictsOldest)
+{
+    auto makeFingerprint = [](m_off_t size) {
+        FileFingerprint fp;
+        fp.size = size;
+        fp.mtime = 1000;
+        fp.crc.fill(int32_t(size));
+        fp.isvalid = true;
+        return fp;
+    };
+
+    LocalFingerprintIndex index(2);
+    LocalPath path;
+
+    index.add(makeFingerprint(1), LocalPath::fromRelativePath("a"));
+    index.add(makeFingerprint(2), LocalPath::fromRelativePath("b"));
+    index.add(makeFingerprint(1), LocalPath::fromRelativePath("c"));   // refresh: now newest
+
+    ASSERT_TRUE(index.find(makeFingerprint(1), path));
+    EXPECT_EQ(path.toPath(false), "c");
+
+    index.add(makeFingerprint(3), LocalPath::fromRelativePath("d"));   // evicts 2, the oldest
+    EXPECT_EQ(index.size(), 2u);
+    EXPECT_FALSE(index.find(makeFingerprint(2), path));
+    EXPECT_TRUE(index.find(makeFingerprint(1), path));
+    EXPECT_TRUE(index.find(makeFingerprint(3), path));
+
+    index.remove(makeFingerprint(3));
+    EXPECT_FALSE(index.find(makeFingerprint(3), path));
+
+    FileFingerprint invalid;
+    index.add(invalid, LocalPath::fromRelativePath("e"));
+    EXPECT_EQ(index.size(), 1u);
+}
+
+TEST(Utils, naturalsortingKeyOrdersLikeNaturalCompare)
+{
+    std::vector<std::string> names = { "file10", "File9", "file009", "file", "file9a", "a", "10", "2", "b1", "B01", "\x01", "z\x02" };
+
+    for (const std::string& i : names)
+    {
+        for (const std::string& j : names)
+        {
+            int compare = mega::naturalsorting_compare(i.c_str(), j.c_str());
+            int keyCompare = mega::naturalsortingKey(i).compare(mega::naturalsortingKey(j));
+            EXPECT_EQ((compare > 0) - (compare < 0), (keyCompare > 0) - (keyCompare < 0)) << i << " vs " << j;
+        }
+    }
+
+    // leading zeros and case don't matter
+    EXPECT_EQ(mega::naturalsortingKey("File009"), mega::naturalsortingKey("file9"));
+}
+
+TEST(ThreadTopology, sizesPoolsAndReportsStats)
+{
+    using mega::ThreadTopology;
+
+    EXPECT_EQ(ThreadTopology::poolSize(ThreadTopology::FINGERPRINT, 4), 4u);
+
+    ThreadTopology::Settings settings;
+    settings.poolSize = 2;
+    ThreadTopology::configure(ThreadTopology::FINGERPRINT, settings);
+    EXPECT_EQ(ThreadTopology::poolSize(ThreadTopology::FINGERPRINT, 4), 2u);
+    ThreadTopology::configure(ThreadTopology::FINGERPRINT, ThreadTopology::Settings());
+
+    ThreadTopology::stats(ThreadTopology::FINGERPRINT, true);
+    ThreadTopology::queued(ThreadTopology::FINGERPRINT, 3);
+
+    // utilization depends on timing, see BM_ThreadTopology_busy in mega_bench
+    ThreadTopology::threadStarted(ThreadTopology::FINGERPRINT);
+    EXPECT_EQ(ThreadTopology::stats(ThreadTopology::FINGERPRINT, false).threads, 1u);
+
+    ThreadTopology::queued(ThreadTopology::FINGERPRINT, -1);
+    {
+        ThreadTopology::Busy busy(ThreadTopology::FINGERPRINT);
+    }
+    ThreadTopology::threadStopped(ThreadTopology::FINGERPRINT);
+
+    ThreadTopology::Stats stats = ThreadTopology::stats(ThreadTopology::FINGERPRINT, true);
+    EXPECT_EQ(stats.threads, 0u);
+    EXPECT_EQ(stats.queueDepth, 2);
+
+    // leave the process-wide counters as they were
+    ThreadTopology::queued(ThreadTopology::FINGERPRINT, -2);
+    EXPECT_EQ(ThreadTopology::stats(ThreadTopology::FINGERPRINT, true).queueDepth, 0);
+}
+
+TEST(Metrics, bucketsAreLogLinear)
+{
+    using mega::Metrics;
+
+    for (uint64_t v = 0; v < 8; v++)
+    {
+        EXPECT_EQ(Metrics::bucketOf(v), v);
+        EXPECT_EQ(Metrics::bucketLowerBound(static_cast<unsigned>(v)), v);
+    }
+
+    // every value falls in the bucket starting at or below it, and before the next one
+    for (uint64_t v : { 8ull, 9ull, 15ull, 16ull, 17ull, 1000ull, 123456ull, 1ull << 36 })
+    {
+        unsigned b = Metrics::bucketOf(v);
+        EXPECT_LE(Metrics::bucketLowerBound(b), v);
+        EXPECT_GT(Metrics::bucketLowerBound(b + 1), v);
+    }
+
+    EXPECT_EQ(Metrics::bucketOf(~0ull), Metrics::HISTOGRAM_BUCKETS - 1);
+}
+
+TEST(Metrics, addsUpThreadsAndExportsOpenMetrics)
+{
+    using mega::Metrics;
+
+    auto find = [](const std::vector<Metrics::Entry>& entries, const std::string& name) -> const Metrics::Entry*
+    {
+        for (auto& e : entries)
+        {
+            if (e.name == name) return &e;
+        }
+        return nullptr;
+    };
+
+    Metrics::Counter counter = Metrics::counter("test_counter", "Test counter");
+    Metrics::Gauge gauge = Metrics::gauge("test_gauge", "Test gauge");
+    Metrics::Histogram histogram = Metrics::histogram("test histogram", "Test histogram", 2);
+
+    auto before = Metrics::snapshot();
+    int64_t counted = find(before, "test_counter")->value;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++)
+    {
+        threads.emplace_back([&]()
+        {
+            for (int j = 0; j < 1000; j++)
+            {
+                counter.add();
+                histogram.record(std::chrono::microseconds(100));
+            }
+        });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    counter.add(5);
+    gauge.set(42);
+
+    // the same name gets the same metric
+    Metrics::counter("test_counter", "Test counter").add();
+
+    auto after = Metrics::snapshot();
+    EXPECT_EQ(find(after, "test_counter")->value - counted, 4006);
+    EXPECT_EQ(find(after, "test_gauge")->value, 42);
+
+    const Metrics::Entry* h = find(after, "test histogram");
+    ASSERT_NE(h, nullptr);
+    EXPECT_EQ(h->value, 4000);  // 2000 sampled, scaled back
+    EXPECT_EQ(h->sumMicroseconds, 400000u);
+    EXPECT_GE(h->percentileMicroseconds(50), 100u);
+    EXPECT_LE(h->percentileMicroseconds(99), 113u);
+
+    std::string text = Metrics::toOpenMetrics(after);
+    EXPECT_NE(text.find("# TYPE mega_test_counter counter\n"), std::string::npos);
+    EXPECT_NE(text.find("mega_test_gauge 42\n"), std::string::npos);
+    EXPECT_NE(text.find("mega_test_histogram_seconds_bucket{le=\"+Inf\"} 4000\n"), std::string::npos);
+    EXPECT_NE(text.find("mega_test_histogram_seconds_count 4000\n"), std::string::npos);
+    EXPECT_EQ(text.substr(text.size() - 6), "# EOF\n");
+}
+
+TEST(ExecLoopProfiler, chargesInnermostSectionAndReportsSlowIterations)
+{
+    using mega::ExecLoopProfiler;
+    using std::chrono::milliseconds;
+
+    ExecLoopProfiler profiler;
+    profiler.setSlowThreshold(milliseconds(30));
+
+    profiler.beginIteration();
+    {
+        ExecLoopProfiler::Scope sc(profiler, ExecLoopProfiler::SC);
+        std::this_thread::sleep_for(milliseconds(40));
+        {
+            ExecLoopProfiler::Scope commit(profiler, ExecLoopProfiler::DB_COMMIT);
+            std::this_thread::sleep_for(milliseconds(10));
+        }
+    }
+    {
+        ExecLoopProfiler::Scope wait(profiler, ExecLoopProfiler::WAIT);
+        std::this_thread::sleep_for(milliseconds(100));
+    }
+    profiler.endIteration();
+
+    ASSERT_EQ(profiler.iterations(), 1u);
+    ASSERT_EQ(profiler.slowIterations(), 1u);
+    const ExecLoopProfiler::Iteration& slow = profiler.recentSlowIterations().back();
+    EXPECT_GE(slow.sections[ExecLoopProfiler::SC], milliseconds(40));
+    EXPECT_GE(slow.sections[ExecLoopProfiler::DB_COMMIT], milliseconds(10));
+    EXPECT_GE(slow.sections[ExecLoopProfiler::WAIT], milliseconds(100));
+
+    // the wait is not part of the iteration
+    EXPECT_LT(slow.total, slow.sections[ExecLoopProfiler::WAIT]);
+    EXPECT_EQ(slow.describe(1).find(" ms: sc "), slow.describe(1).find(" ms"));
+
+    // a quick iteration, and one while disabled, aren't reported
+    profiler.beginIteration();
+    profiler.endIteration();
+    profiler.setSlowThreshold(milliseconds(0));
+    profiler.beginIteration();
+    {
+        ExecLoopProfiler::Scope sync(profiler, ExecLoopProfiler::SYNC);
+        std::this_thread::sleep_for(milliseconds(40));
+    }
+    profiler.endIteration();
+    EXPECT_EQ(profiler.iterations(), 3u);
+    EXPECT_EQ(profiler.slowIterations(), 1u);
+}
+
+TEST(ExecLoopProfiler, sectionsRunOutOfBudgetPerIteration)
+{
+    using mega::ExecLoopProfiler;
+    using std::chrono::milliseconds;
+
+    ExecLoopProfiler profiler;
+    profiler.setBudget(ExecLoopProfiler::SC, milliseconds(20));
+
+    // only within an iteration
+    EXPECT_FALSE(profiler.overBudget(ExecLoopProfiler::SC));
+
+    profiler.beginIteration();
+    {
+        ExecLoopProfiler::Scope sc(profiler, ExecLoopProfiler::SC);
+        EXPECT_FALSE(profiler.overBudget(ExecLoopProfiler::SC));
+        std::this_thread::sleep_for(milliseconds(25));
+
+        // the running section counts too
+        EXPECT_TRUE(profiler.overBudget(ExecLoopProfiler::SC));
+
+        // sections without a budget never run out
+        EXPECT_FALSE(profiler.overBudget(ExecLoopProfiler::SYNC));
+    }
+    EXPECT_TRUE(profiler.overBudget(ExecLoopProfiler::SC));
+    profiler.endIteration();
+
+    // the next iteration starts afresh
+    profiler.beginIteration();
+    EXPECT_FALSE(profiler.overBudget(ExecLoopProfiler::SC));
+    profiler.endIteration();
+}
+
+TEST(MemoryReport, addsUpSubsystemsAndExportsJson)
+{
+    mega::MemoryReport report;
+    report.add("nodes", 10, 1000);
+    report.add("userAlerts", 2, 300);
+    report.add("nodes", 5, 500);
+
+    ASSERT_EQ(report.entries.size(), 2u);
+    EXPECT_EQ(report.entries[0].objects, 15u);
+    EXPECT_EQ(report.entries[0].bytes, 1500u);
+    EXPECT_EQ(report.totalBytes(), 1800u);
+    EXPECT_EQ(report.toJson(), "{\"subsystems\":[{\"name\":\"nodes\",\"objects\":15,\"bytes\":1500},"
+                               "{\"name\":\"userAlerts\",\"objects\":2,\"bytes\":300}],\"bytes\":1800}");
+
+    // short strings live in the string object itself
+    std::string shortString("abc");
+    std::string longString(1000, 'x');
+    EXPECT_EQ(mega::MemoryReport::heapBytes(shortString), 0u);
+    EXPECT_GT(mega::MemoryReport::heapBytes(longString), 1000u);
+}
+
+TEST(NodePathCache, invalidatesThroughPathNodesAndLookedUpNames)
+{
+    using mega::NodeHandle;
+    using mega::NodePathCache;
+
+    NodeHandle root = NodeHandle().set6byte(1);
+    NodeHandle dir = NodeHandle().set6byte(2);
+    NodeHandle file = NodeHandle().set6byte(3);
+
+    NodePathCache cache(2);
+    cache.put({root, "/dir/file"}, file, {root, dir, file}, {{root, "dir"}, {dir, "file"}});
+    cache.put({root, "/dir/missing"}, NodeHandle(), {root, dir}, {{root, "dir"}, {dir, "missing"}});
+
+    NodeHandle result;
+    ASSERT_TRUE(cache.get({root, "/dir/file"}, result));
+    EXPECT_EQ(result, file);
+    ASSERT_TRUE(cache.get({root, "/dir/missing"}, result));
+    EXPECT_TRUE(result.isUndef());
+
+    // a node named like the failed lookup appears
+    cache.invalidate(NodeHandle().set6byte(4), dir, "missing");
+    EXPECT_FALSE(cache.get({root, "/dir/missing"}, result));
+    EXPECT_TRUE(cache.get({root, "/dir/file"}, result));
+
+    // an ancestor is renamed or moved
+    cache.invalidate(dir, root, "dir2");
+    EXPECT_FALSE(cache.get({root, "/dir/file"}, result));
+    EXPECT_EQ(cache.size(), 0u);
+
+    // bounded, least recently used first out
+    cache.put({root, "a"}, file, {root, file}, {{root, "a"}});
+    cache.put({root, "b"}, file, {root, file}, {{root, "b"}});
+    EXPECT_TRUE(cache.get({root, "a"}, result));
+    cache.put({root, "c"}, file, {root, file}, {{root, "c"}});
+    EXPECT_TRUE(cache.get({root, "a"}, result));
+    EXPECT_FALSE(cache.get({root, "b"}, result));
+    EXPECT_EQ(cache.size(), 2u);
+}